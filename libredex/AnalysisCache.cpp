@@ -0,0 +1,82 @@
+/*
+ * Copyright (c) Facebook, Inc. and its affiliates.
+ *
+ * This source code is licensed under the MIT license found in the
+ * LICENSE file in the root directory of this source tree.
+ */
+
+#include "AnalysisCache.h"
+
+#include "CallGraph.h"
+#include "MethodOverrideGraph.h"
+#include "Purity.h"
+#include "Timer.h"
+
+std::shared_ptr<const method_override_graph::Graph>
+AnalysisCache::method_override_graph(const Scope& scope) {
+  std::lock_guard<std::mutex> lock(m_lock);
+  return method_override_graph_locked(scope);
+}
+
+std::shared_ptr<const method_override_graph::Graph>
+AnalysisCache::method_override_graph_locked(const Scope& scope) {
+  if (!m_method_override_graph.valid_for(scope)) {
+    Timer t("AnalysisCache: method override graph");
+    m_method_override_graph.set(scope,
+                                method_override_graph::build_graph(scope));
+  }
+  return m_method_override_graph.value;
+}
+
+std::shared_ptr<const call_graph::Graph> AnalysisCache::single_callee_graph(
+    const Scope& scope) {
+  std::lock_guard<std::mutex> lock(m_lock);
+  if (!m_single_callee_graph.valid_for(scope)) {
+    auto mog = method_override_graph_locked(scope);
+    Timer t("AnalysisCache: single callee graph");
+    m_single_callee_graph.set(
+        scope,
+        std::make_shared<const call_graph::Graph>(
+            call_graph::single_callee_graph(*mog, scope)));
+  }
+  return m_single_callee_graph.value;
+}
+
+std::shared_ptr<const call_graph::Graph> AnalysisCache::complete_call_graph(
+    const Scope& scope) {
+  std::lock_guard<std::mutex> lock(m_lock);
+  if (!m_complete_call_graph.valid_for(scope)) {
+    auto mog = method_override_graph_locked(scope);
+    Timer t("AnalysisCache: complete call graph");
+    m_complete_call_graph.set(
+        scope,
+        std::make_shared<const call_graph::Graph>(
+            call_graph::complete_call_graph(*mog, scope)));
+  }
+  return m_complete_call_graph.value;
+}
+
+std::shared_ptr<const AnalysisCache::NoSideEffectsMethods>
+AnalysisCache::no_side_effects_methods(
+    const Scope& scope, const std::unordered_set<DexMethodRef*>& pure_methods) {
+  std::lock_guard<std::mutex> lock(m_lock);
+  if (!m_no_side_effects_methods.valid_for(scope) ||
+      m_no_side_effects_pure_methods != pure_methods) {
+    auto mog = method_override_graph_locked(scope);
+    auto value = std::make_shared<NoSideEffectsMethods>();
+    value->iterations = compute_no_side_effects_methods(
+        scope, mog.get(), pure_methods, &value->methods);
+    m_no_side_effects_methods.set(scope, std::move(value));
+    m_no_side_effects_pure_methods = pure_methods;
+  }
+  return m_no_side_effects_methods.value;
+}
+
+void AnalysisCache::invalidate() {
+  std::lock_guard<std::mutex> lock(m_lock);
+  m_method_override_graph = {};
+  m_single_callee_graph = {};
+  m_complete_call_graph = {};
+  m_no_side_effects_methods = {};
+  m_no_side_effects_pure_methods.clear();
+}
@@ -0,0 +1,89 @@
+/*
+ * Copyright (c) Facebook, Inc. and its affiliates.
+ *
+ * This source code is licensed under the MIT license found in the
+ * LICENSE file in the root directory of this source tree.
+ */
+
+#pragma once
+
+#include <memory>
+#include <mutex>
+#include <unordered_set>
+#include <vector>
+
+class DexClass;
+class DexMethod;
+class DexMethodRef;
+using Scope = std::vector<DexClass*>;
+
+namespace call_graph {
+class Graph;
+} // namespace call_graph
+
+namespace method_override_graph {
+class Graph;
+} // namespace method_override_graph
+
+/**
+ * Whole-program graphs and summaries that several passes would otherwise
+ * build from the same scope over and over. Each one is built on first request
+ * and handed out until the cache is invalidated, or until it is asked for a
+ * different scope.
+ *
+ * The PassManager owns one cache and invalidates it after every pass that
+ * does not preserve the cached graphs, see AnalysisUsage. A pass that changes
+ * code or the class hierarchy and then needs the graphs again must call
+ * invalidate() itself: the call graphs hold iterators into the code of their
+ * callers.
+ */
+class AnalysisCache {
+ public:
+  std::shared_ptr<const method_override_graph::Graph> method_override_graph(
+      const Scope& scope);
+
+  std::shared_ptr<const call_graph::Graph> single_callee_graph(
+      const Scope& scope);
+
+  std::shared_ptr<const call_graph::Graph> complete_call_graph(
+      const Scope& scope);
+
+  struct NoSideEffectsMethods {
+    std::unordered_set<const DexMethod*> methods;
+    // See compute_no_side_effects_methods.
+    size_t iterations{0};
+  };
+
+  // The methods without side effects given the pure methods, see
+  // compute_no_side_effects_methods. Passes usually derive the pure methods
+  // from the same configuration, in which case they share the result.
+  std::shared_ptr<const NoSideEffectsMethods> no_side_effects_methods(
+      const Scope& scope,
+      const std::unordered_set<DexMethodRef*>& pure_methods);
+
+  void invalidate();
+
+ private:
+  template <typename T>
+  struct Entry {
+    Scope scope;
+    std::shared_ptr<const T> value;
+
+    bool valid_for(const Scope& s) const { return value && scope == s; }
+
+    void set(const Scope& s, std::shared_ptr<const T> v) {
+      scope = s;
+      value = std::move(v);
+    }
+  };
+
+  std::shared_ptr<const method_override_graph::Graph>
+  method_override_graph_locked(const Scope& scope);
+
+  std::mutex m_lock;
+  Entry<method_override_graph::Graph> m_method_override_graph;
+  Entry<call_graph::Graph> m_single_callee_graph;
+  Entry<call_graph::Graph> m_complete_call_graph;
+  Entry<NoSideEffectsMethods> m_no_side_effects_methods;
+  std::unordered_set<DexMethodRef*> m_no_side_effects_pure_methods;
+};
@@ -31,6 +31,15 @@ class AnalysisUsage {
 
   bool get_preserve_status() const { return m_preserve_all; }
 
+  // Declares that the pass changes neither code nor the class hierarchy, so
+  // that the graphs in the PassManager's AnalysisCache remain valid. Passes
+  // that preserve all analyses preserve those too.
+  void set_preserve_cached_graphs() { m_preserve_cached_graphs = true; }
+
+  bool get_preserve_cached_graphs() const {
+    return m_preserve_all || m_preserve_cached_graphs;
+  }
+
   // A required pass is used by (thus should precede) this current pass.
   template <typename AnalysisPassType>
   void add_required() {
@@ -44,5 +53,6 @@ class AnalysisUsage {
 
  private:
   bool m_preserve_all = false;
+  bool m_preserve_cached_graphs = false;
   std::unordered_set<AnalysisID> m_required_passes;
 };
@@ -0,0 +1,56 @@
+/*
+ * Copyright (c) Facebook, Inc. and its affiliates.
+ *
+ * This source code is licensed under the MIT license found in the
+ * LICENSE file in the root directory of this source tree.
+ */
+
+#pragma once
+
+#include <atomic>
+#include <cstddef>
+#include <cstdint>
+#include <memory>
+
+#include "Debug.h"
+
+/*
+ * A fixed-size vector of bits that threads can set concurrently without
+ * locking. Bits can only be set, never cleared.
+ */
+class AtomicBitVector {
+ public:
+  explicit AtomicBitVector(size_t size)
+      : m_size(size),
+        m_words(std::make_unique<std::atomic<uint64_t>[]>(num_words(size))) {
+    for (size_t i = 0; i < num_words(size); ++i) {
+      m_words[i].store(0, std::memory_order_relaxed);
+    }
+  }
+
+  size_t size() const { return m_size; }
+
+  bool test(size_t i) const {
+    if (i >= m_size) {
+      return false;
+    }
+    return (m_words[i / 64].load() & mask(i)) != 0;
+  }
+
+  /*
+   * Sets bit i in a single atomic operation, and returns whether this call
+   * changed it, i.e. whether it was clear before.
+   */
+  bool test_and_set(size_t i) {
+    always_assert_log(i < m_size, "Bit %zu out of range %zu", i, m_size);
+    return (m_words[i / 64].fetch_or(mask(i)) & mask(i)) == 0;
+  }
+
+ private:
+  static size_t num_words(size_t size) { return (size + 63) / 64; }
+
+  static uint64_t mask(size_t i) { return uint64_t(1) << (i % 64); }
+
+  size_t m_size;
+  std::unique_ptr<std::atomic<uint64_t>[]> m_words;
+};
@@ -13,15 +13,19 @@
 
 namespace ir_analyzer {
 
-template <typename Domain>
-class BaseIRAnalyzer
-    : public sparta::MonotonicFixpointIterator<cfg::GraphInterface, Domain> {
+/*
+ * The Iterator parameter selects the iteration strategy, e.g.,
+ * sparta::WorklistMonotonicFixpointIterator instead of the default one.
+ */
+template <typename Domain,
+          template <typename...> class Iterator =
+              sparta::MonotonicFixpointIterator>
+class BaseIRAnalyzer : public Iterator<cfg::GraphInterface, Domain> {
  public:
   using NodeId = cfg::Block*;
 
   explicit BaseIRAnalyzer(const cfg::ControlFlowGraph& cfg)
-      : sparta::MonotonicFixpointIterator<cfg::GraphInterface, Domain>(
-            cfg, cfg.blocks().size()) {}
+      : Iterator<cfg::GraphInterface, Domain>(cfg, cfg.blocks().size()) {}
 
   void analyze_node(const NodeId& node, Domain* current_state) const override {
     for (auto& mie : ir_list::InstructionIterable(node)) {
@@ -38,18 +42,19 @@ class BaseIRAnalyzer
                                    Domain* current_state) const = 0;
 };
 
-template <typename Domain>
+template <typename Domain,
+          template <typename...> class Iterator =
+              sparta::MonotonicFixpointIterator>
 class BaseBackwardsIRAnalyzer
-    : public sparta::MonotonicFixpointIterator<
+    : public Iterator<
           sparta::BackwardsFixpointIterationAdaptor<cfg::GraphInterface>,
           Domain> {
  public:
   using NodeId = cfg::Block*;
 
   explicit BaseBackwardsIRAnalyzer(const cfg::ControlFlowGraph& cfg)
-      : sparta::MonotonicFixpointIterator<
-            sparta::BackwardsFixpointIterationAdaptor<cfg::GraphInterface>,
-            Domain>(cfg, cfg.blocks().size()) {}
+      : Iterator<sparta::BackwardsFixpointIterationAdaptor<cfg::GraphInterface>,
+                 Domain>(cfg, cfg.blocks().size()) {}
 
   void analyze_node(const NodeId& node, Domain* current_state) const override {
     for (auto it = node->rbegin(); it != node->rend(); ++it) {
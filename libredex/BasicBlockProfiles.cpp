@@ -0,0 +1,128 @@
+/*
+ * Copyright (c) Facebook, Inc. and its affiliates.
+ *
+ * This source code is licensed under the MIT license found in the
+ * LICENSE file in the root directory of this source tree.
+ */
+
+#include "BasicBlockProfiles.h"
+
+#include <cstdlib>
+#include <fstream>
+#include <iostream>
+
+#include "ControlFlow.h"
+#include "IRCode.h"
+#include "Trace.h"
+
+namespace basic_block_profiles {
+
+namespace {
+
+// Parses "<number>,<rest>", where rest may be empty.
+bool parse_leading_number(const std::string& line,
+                          size_t* number,
+                          std::string* rest) {
+  auto comma = line.find(',');
+  if (comma == 0 || comma == std::string::npos) {
+    return false;
+  }
+  char* end = nullptr;
+  *number = std::strtoull(line.c_str(), &end, 10);
+  if (end != line.c_str() + comma) {
+    return false;
+  }
+  *rest = line.substr(comma + 1);
+  return true;
+}
+
+} // namespace
+
+bool BasicBlockProfiles::initialize(const std::string& index_filename,
+                                    const std::string& stats_filename) {
+  std::ifstream stats_file(stats_filename);
+  if (!stats_file) {
+    std::cerr << "FAILED to open " << stats_filename << "\n";
+    return false;
+  }
+  std::vector<uint16_t> stats;
+  std::string line;
+  while (std::getline(stats_file, line)) {
+    size_t index;
+    std::string value;
+    if (line.empty()) {
+      continue;
+    }
+    if (!parse_leading_number(line, &index, &value) || value.empty()) {
+      std::cerr << "Bad line in " << stats_filename << ": " << line << "\n";
+      return false;
+    }
+    if (index >= stats.size()) {
+      stats.resize(index + 1);
+    }
+    // The array holds ints, but only their low 16 bits are used.
+    stats[index] = static_cast<uint16_t>(std::strtoll(value.c_str(), nullptr,
+                                                      10));
+  }
+
+  std::ifstream index_file(index_filename);
+  if (!index_file) {
+    std::cerr << "FAILED to open " << index_filename << "\n";
+    return false;
+  }
+  while (std::getline(index_file, line)) {
+    size_t index;
+    std::string rest;
+    if (line.empty()) {
+      continue;
+    }
+    // Method names don't contain commas.
+    size_t comma;
+    if (!parse_leading_number(line, &index, &rest) ||
+        (comma = rest.rfind(',')) == std::string::npos) {
+      std::cerr << "Bad line in " << index_filename << ": " << line << "\n";
+      return false;
+    }
+    auto name = rest.substr(0, comma);
+    MethodCoverage coverage;
+    coverage.num_blocks = std::strtoull(rest.c_str() + comma + 1, nullptr, 10);
+    for (size_t i = 0; i < (coverage.num_blocks + 14) / 15; ++i) {
+      coverage.vectors.push_back(index + i < stats.size() ? stats[index + i]
+                                                          : 0);
+    }
+    auto ref = DexMethod::get_method</*kCheckFormat=*/true>(name);
+    if (ref == nullptr) {
+      TRACE(METH_PROF, 6, "failed to resolve %s", name.c_str());
+      continue;
+    }
+    m_coverage[ref] = std::move(coverage);
+  }
+  TRACE(METH_PROF, 1, "BasicBlockProfiles successfully parsed %zu methods",
+        m_coverage.size());
+  return true;
+}
+
+bool gather_cold_instructions(
+    IRCode* code,
+    const MethodCoverage& coverage,
+    std::unordered_set<const IRInstruction*>* cold_insns) {
+  // InstrumentPass doesn't probe the blocks without opcodes, so nothing is
+  // known about them.
+  code->build_cfg(/* editable */ false);
+  const auto& blocks = code->cfg().blocks();
+  bool matches = blocks.size() == coverage.num_blocks;
+  if (matches) {
+    for (cfg::Block* block : blocks) {
+      if (block->num_opcodes() < 1 || coverage.ran(block->id())) {
+        continue;
+      }
+      for (const auto& mie : InstructionIterable(block)) {
+        cold_insns->insert(mie.insn);
+      }
+    }
+  }
+  code->clear_cfg();
+  return matches;
+}
+
+} // namespace basic_block_profiles
@@ -0,0 +1,82 @@
+/*
+ * Copyright (c) Facebook, Inc. and its affiliates.
+ *
+ * This source code is licensed under the MIT license found in the
+ * LICENSE file in the root directory of this source tree.
+ */
+
+#pragma once
+
+#include <string>
+#include <unordered_map>
+#include <unordered_set>
+#include <vector>
+
+#include "DexClass.h"
+
+class IRInstruction;
+
+namespace basic_block_profiles {
+
+// The basic blocks of a method that ran, as recorded by the
+// basic_block_tracing strategy of InstrumentPass. The blocks are numbered
+// like the ids of the non-editable CFG that the instrumentation used.
+struct MethodCoverage {
+  size_t num_blocks{0};
+  // 15 blocks per vector, with the MSB as the continuation marker.
+  std::vector<uint16_t> vectors;
+
+  bool ran(size_t block_id) const {
+    return (vectors.at(block_id / 15) >> (block_id % 15)) & 1;
+  }
+
+  // A method that never ran says nothing about its blocks.
+  bool any_ran() const {
+    for (size_t i = 0; i < num_blocks; ++i) {
+      if (ran(i)) {
+        return true;
+      }
+    }
+    return false;
+  }
+};
+
+/*
+ * Adds the instructions of the blocks of the code that didn't run to
+ * cold_insns. The instructions are the same in the editable CFG, unlike the
+ * blocks. The code must not have a CFG. Returns false, and adds nothing, if the
+ * blocks of the code don't match the profile anymore.
+ */
+bool gather_cold_instructions(
+    IRCode* code,
+    const MethodCoverage& coverage,
+    std::unordered_set<const IRInstruction*>* cold_insns);
+
+class BasicBlockProfiles {
+ public:
+  /*
+   * Reads the basic block index file written by InstrumentPass, whose lines
+   * are "<stats index>,<method>,<number of blocks>", and the collected
+   * sBasicBlockStats array, whose lines are "<stats index>,<value>". Missing
+   * stats are zeros. Returns false if either file can't be read or parsed.
+   */
+  bool initialize(const std::string& index_filename,
+                  const std::string& stats_filename);
+
+  // For testing purposes.
+  void add(const DexMethodRef* method, MethodCoverage coverage) {
+    m_coverage[method] = std::move(coverage);
+  }
+
+  const MethodCoverage* get(const DexMethodRef* method) const {
+    auto it = m_coverage.find(method);
+    return it == m_coverage.end() ? nullptr : &it->second;
+  }
+
+  size_t size() const { return m_coverage.size(); }
+
+ private:
+  std::unordered_map<const DexMethodRef*, MethodCoverage> m_coverage;
+};
+
+} // namespace basic_block_profiles
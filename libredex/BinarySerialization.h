@@ -5,11 +5,20 @@
  * LICENSE file in the root directory of this source tree.
  */
 
+#pragma once
+
+#include <algorithm>
 #include <boost/bimap/bimap.hpp>
 #include <boost/bimap/unordered_set_of.hpp>
+#include <cstdint>
+#include <functional>
 #include <limits>
 #include <ostream>
+#include <string>
 #include <type_traits>
+#include <unordered_map>
+#include <utility>
+#include <vector>
 
 #include "Debug.h"
 
@@ -113,4 +122,215 @@ class GraphWriter {
   SuccessorFunction m_successors;
 };
 
+/*
+ * Append value to out as an unsigned LEB128 varint.
+ */
+inline void append_uleb128(std::vector<uint8_t>& out, uint64_t value) {
+  do {
+    uint8_t byte = value & 0x7f;
+    value >>= 7;
+    if (value != 0) {
+      byte |= 0x80;
+    }
+    out.push_back(byte);
+  } while (value != 0);
+}
+
+/*
+ * Serialize a graph in a form that readers can memory-map and query without
+ * decoding it first (format version 2). Integers are in host byte order, which
+ * readers check with the magic number, and every table starts at a multiple of
+ * 8 bytes:
+ *
+ *   u32 magic, u32 version          (see write_header)
+ *   u32 node_count, u32 string_count
+ *   u64 string_data_size, u64 edge_data_size, u64 reverse_edge_data_size
+ *   u64 string_offsets[string_count + 1]
+ *   u32 node_strings[node_count]    (index into the string table)
+ *   u8  node_kinds[node_count]
+ *   u64 edge_offsets[node_count + 1]
+ *   u64 reverse_edge_offsets[node_count + 1]
+ *   string data, edge data, reverse edge data
+ *
+ * The string table holds each distinct label once, sorted bytewise. Nodes are
+ * sorted by label, then kind, so a reader can binary search for a node by
+ * name. ID ties keep the order in which the nodes were reached from `nodes`.
+ * Edges are stored in compressed sparse row layout: the successors of node n
+ * are at edge data [edge_offsets[n], edge_offsets[n + 1]), as ascending IDs,
+ * each encoded as a ULEB128 delta from the previous one. The predecessors are
+ * stored the same way in the reverse edge tables.
+ */
+template <class Node, class NodeHash = std::hash<Node>>
+class CompactGraphWriter {
+  using SuccessorFunction = std::function<std::vector<Node>(const Node&)>;
+  // Returns the kind and the label of a node.
+  using NodeLabeler =
+      std::function<std::pair<uint8_t, std::string>(const Node&)>;
+
+ public:
+  static constexpr uint32_t VERSION = 2;
+
+  CompactGraphWriter(NodeLabeler labeler, SuccessorFunction successors)
+      : m_labeler(labeler), m_successors(successors) {}
+
+  template <class NodeContainer>
+  void write(std::ostream& os, const NodeContainer& roots) {
+    // Number the nodes in the order we reach them.
+    std::vector<Node> nodes;
+    std::unordered_map<Node, uint32_t, NodeHash> ids;
+    std::vector<std::vector<uint32_t>> succs;
+    std::vector<uint32_t> stack;
+    auto number = [&](const Node& node) {
+      auto it = ids.find(node);
+      if (it != ids.end()) {
+        return it->second;
+      }
+      always_assert(nodes.size() < std::numeric_limits<uint32_t>::max());
+      uint32_t id = nodes.size();
+      ids.emplace(node, id);
+      nodes.push_back(node);
+      stack.push_back(id);
+      return id;
+    };
+    for (const auto& root : roots) {
+      number(root);
+      while (!stack.empty()) {
+        uint32_t id = stack.back();
+        stack.pop_back();
+        std::vector<uint32_t> node_succs;
+        for (const auto& succ : m_successors(Node(nodes[id]))) {
+          node_succs.push_back(number(succ));
+        }
+        if (succs.size() <= id) {
+          succs.resize(id + 1);
+        }
+        succs[id] = std::move(node_succs);
+      }
+    }
+    uint32_t node_count = nodes.size();
+    succs.resize(node_count);
+
+    // Sort the nodes by label and build the string table.
+    std::vector<std::pair<uint8_t, std::string>> labels;
+    labels.reserve(node_count);
+    for (const auto& node : nodes) {
+      labels.push_back(m_labeler(node));
+    }
+    nodes.clear();
+    ids.clear();
+    std::vector<uint32_t> order(node_count);
+    for (uint32_t i = 0; i < node_count; ++i) {
+      order[i] = i;
+    }
+    std::stable_sort(order.begin(), order.end(), [&](uint32_t a, uint32_t b) {
+      if (labels[a].second != labels[b].second) {
+        return labels[a].second < labels[b].second;
+      }
+      return labels[a].first < labels[b].first;
+    });
+    std::vector<uint32_t> new_id(node_count);
+    std::vector<uint64_t> string_offsets{0};
+    std::string string_data;
+    std::vector<uint32_t> node_strings(node_count);
+    std::vector<uint8_t> node_kinds(node_count);
+    for (uint32_t i = 0; i < node_count; ++i) {
+      const auto& label = labels[order[i]];
+      new_id[order[i]] = i;
+      if (i == 0 || label.second != labels[order[i - 1]].second) {
+        string_data += label.second;
+        string_offsets.push_back(string_data.size());
+      }
+      always_assert(string_offsets.size() - 2 <=
+                    std::numeric_limits<uint32_t>::max());
+      node_strings[i] = string_offsets.size() - 2;
+      node_kinds[i] = label.first;
+    }
+    labels.clear();
+    uint32_t string_count = string_offsets.size() - 1;
+
+    // Renumber the edges and encode both directions.
+    std::vector<std::vector<uint32_t>> forward(node_count);
+    std::vector<std::vector<uint32_t>> reverse(node_count);
+    for (uint32_t i = 0; i < node_count; ++i) {
+      for (auto succ : succs[i]) {
+        forward[new_id[i]].push_back(new_id[succ]);
+        reverse[new_id[succ]].push_back(new_id[i]);
+      }
+      std::vector<uint32_t>().swap(succs[i]);
+    }
+    std::vector<uint64_t> edge_offsets;
+    std::vector<uint8_t> edge_data;
+    encode_edges(&forward, &edge_offsets, &edge_data);
+    std::vector<uint64_t> reverse_edge_offsets;
+    std::vector<uint8_t> reverse_edge_data;
+    encode_edges(&reverse, &reverse_edge_offsets, &reverse_edge_data);
+
+    m_written = 0;
+    write_header(os, VERSION);
+    m_written += 8;
+    put(os, node_count);
+    put(os, string_count);
+    put<uint64_t>(os, string_data.size());
+    put<uint64_t>(os, edge_data.size());
+    put<uint64_t>(os, reverse_edge_data.size());
+    put_all(os, string_offsets);
+    put_all(os, node_strings);
+    pad(os);
+    put_all(os, node_kinds);
+    pad(os);
+    put_all(os, edge_offsets);
+    put_all(os, reverse_edge_offsets);
+    put_bytes(os, string_data.data(), string_data.size());
+    pad(os);
+    put_bytes(os, edge_data.data(), edge_data.size());
+    pad(os);
+    put_bytes(os, reverse_edge_data.data(), reverse_edge_data.size());
+  }
+
+ private:
+  static void encode_edges(std::vector<std::vector<uint32_t>>* adjacency,
+                           std::vector<uint64_t>* offsets,
+                           std::vector<uint8_t>* data) {
+    offsets->push_back(0);
+    for (auto& targets : *adjacency) {
+      std::sort(targets.begin(), targets.end());
+      targets.erase(std::unique(targets.begin(), targets.end()),
+                    targets.end());
+      uint32_t prev = 0;
+      for (auto target : targets) {
+        append_uleb128(*data, target - prev);
+        prev = target;
+      }
+      offsets->push_back(data->size());
+      std::vector<uint32_t>().swap(targets);
+    }
+  }
+
+  template <class V>
+  void put(std::ostream& os, const V& value) {
+    binary_serialization::write(os, value);
+    m_written += sizeof(value);
+  }
+
+  template <class V>
+  void put_all(std::ostream& os, const std::vector<V>& values) {
+    put_bytes(os, values.data(), values.size() * sizeof(V));
+  }
+
+  void put_bytes(std::ostream& os, const void* data, size_t size) {
+    os.write(static_cast<const char*>(data), size);
+    m_written += size;
+  }
+
+  void pad(std::ostream& os) {
+    while (m_written % 8 != 0) {
+      put<uint8_t>(os, 0);
+    }
+  }
+
+  NodeLabeler m_labeler;
+  SuccessorFunction m_successors;
+  uint64_t m_written{0};
+};
+
 } // namespace binary_serialization
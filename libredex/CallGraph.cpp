@@ -11,6 +11,7 @@
 
 #include "MethodOverrideGraph.h"
 #include "Walkers.h"
+#include "WorkQueue.h"
 
 namespace mog = method_override_graph;
 
@@ -20,8 +21,11 @@ using namespace call_graph;
 
 class SingleCalleeStrategy final : public BuildStrategy {
  public:
-  explicit SingleCalleeStrategy(const Scope& scope) : m_scope(scope) {
-    auto non_virtual_vec = mog::get_non_true_virtuals(scope);
+  SingleCalleeStrategy(const mog::Graph& method_override_graph,
+                       const Scope& scope)
+      : m_scope(scope) {
+    auto non_virtual_vec =
+        mog::get_non_true_virtuals(method_override_graph, scope);
     m_non_virtual.insert(non_virtual_vec.begin(), non_virtual_vec.end());
   }
 
@@ -68,13 +72,14 @@ class SingleCalleeStrategy final : public BuildStrategy {
 
   const Scope& m_scope;
   std::unordered_set<DexMethod*> m_non_virtual;
-  mutable MethodRefCache m_resolved_refs;
+  mutable ConcurrentMethodRefCache m_resolved_refs;
 };
 
 class CompleteCallGraphStrategy final : public BuildStrategy {
  public:
-  explicit CompleteCallGraphStrategy(const Scope& scope)
-      : m_scope(scope), m_method_override_graph(mog::build_graph(scope)) {}
+  CompleteCallGraphStrategy(const mog::Graph& method_override_graph,
+                            const Scope& scope)
+      : m_scope(scope), m_method_override_graph(method_override_graph) {}
 
   CallSites get_callsites(const DexMethod* method) const override {
     CallSites callsites;
@@ -96,7 +101,7 @@ class CompleteCallGraphStrategy final : public BuildStrategy {
           callsites.emplace_back(callee, code->iterator_to(mie));
         }
         auto overriding =
-            mog::get_overriding_methods(*m_method_override_graph, callee);
+            mog::get_overriding_methods(m_method_override_graph, callee);
 
         for (auto m : overriding) {
           callsites.emplace_back(m, code->iterator_to(mie));
@@ -119,81 +124,164 @@ class CompleteCallGraphStrategy final : public BuildStrategy {
 
  private:
   const Scope& m_scope;
-  mutable MethodRefCache m_resolved_refs;
-  std::unique_ptr<const mog::Graph> m_method_override_graph;
+  mutable ConcurrentMethodRefCache m_resolved_refs;
+  const mog::Graph& m_method_override_graph;
 };
 } // namespace
 
 namespace call_graph {
 
 Graph single_callee_graph(const Scope& scope) {
-  return Graph(SingleCalleeStrategy(scope));
+  return single_callee_graph(*mog::build_graph(scope), scope);
+}
+
+Graph single_callee_graph(const mog::Graph& method_override_graph,
+                          const Scope& scope) {
+  return Graph(SingleCalleeStrategy(method_override_graph, scope));
 }
 
 Graph complete_call_graph(const Scope& scope) {
-  return Graph(CompleteCallGraphStrategy(scope));
+  return complete_call_graph(*mog::build_graph(scope), scope);
+}
+
+Graph complete_call_graph(const mog::Graph& method_override_graph,
+                          const Scope& scope) {
+  return Graph(CompleteCallGraphStrategy(method_override_graph, scope));
 }
 
-Edge::Edge(NodeId caller, NodeId callee, const IRList::iterator& invoke_it)
-    : m_caller(std::move(caller)),
-      m_callee(std::move(callee)),
-      m_invoke_it(invoke_it) {}
+constexpr uint32_t Graph::ENTRY_ID;
+constexpr uint32_t Graph::EXIT_ID;
 
-Graph::Graph(const BuildStrategy& strat)
-    : m_entry(std::make_shared<Node>(Node::GHOST_ENTRY)),
-      m_exit(std::make_shared<Node>(Node::GHOST_EXIT)) {
-  // Add edges from the single "ghost" entry node to all the "real" entry
-  // nodes in the graph.
+Graph::Graph(const BuildStrategy& strat) {
   auto roots = strat.get_roots();
+
+  // Obtain the callsites of all reachable methods in parallel. Whoever first
+  // inserts a method into the map schedules the task that fills in its
+  // callsites; the entries never move, so that needs no further locking.
+  InsertOnlyConcurrentMap<const DexMethod*, CallSites> callsites_map;
+  auto wq = workqueue_foreach<const DexMethod*>(
+      [&](sparta::SpartaWorkerState<const DexMethod*>* worker_state,
+          const DexMethod* caller) {
+        auto callsites = strat.get_callsites(caller);
+        for (const auto& callsite : callsites) {
+          if (callsites_map.emplace(callsite.callee).second) {
+            worker_state->push_task(callsite.callee);
+          }
+        }
+        *callsites_map.get(caller) = std::move(callsites);
+        return nullptr;
+      },
+      redex_parallel::default_num_threads(),
+      /*push_tasks_while_running=*/true);
   for (const DexMethod* root : roots) {
-    auto edge =
-        std::make_shared<Edge>(m_entry, make_node(root), IRList::iterator());
-    m_entry->m_successors.emplace_back(edge);
-    make_node(root)->m_predecessors.emplace_back(edge);
+    if (callsites_map.emplace(root).second) {
+      wq.add_item(root);
+    }
   }
+  wq.run_all();
 
-  // Obtain the callsites of each method recursively, building the graph in the
-  // process.
+  // Number the nodes and lay out the edges in the order of a depth-first
+  // traversal from the roots, which keeps the graph deterministic.
+  auto storage = std::make_shared<Storage>();
+  auto& nodes = storage->nodes;
+  auto& ids = storage->ids;
+  nodes.reserve(callsites_map.size() + 2);
+  nodes.emplace_back(Node::GHOST_ENTRY, ENTRY_ID);
+  nodes.emplace_back(Node::GHOST_EXIT, EXIT_ID);
+  auto id_of = [&](const DexMethod* m) {
+    auto it = ids.find(m);
+    if (it != ids.end()) {
+      return it->second;
+    }
+    auto id = static_cast<uint32_t>(nodes.size());
+    nodes.emplace_back(m, id);
+    ids.emplace(m, id);
+    return id;
+  };
+
+  struct EdgeInfo {
+    uint32_t caller;
+    uint32_t callee;
+    IRList::iterator invoke;
+  };
+  std::vector<EdgeInfo> edge_infos;
+  for (const DexMethod* root : roots) {
+    edge_infos.push_back({ENTRY_ID, id_of(root), IRList::iterator()});
+  }
   std::unordered_set<const DexMethod*> visited;
-  auto visit = [&](const auto* caller) {
-    auto visit_impl = [&](const auto* caller, auto& visit_fn) {
-      if (visited.count(caller) != 0) {
+  auto visit = [&](const DexMethod* caller) {
+    auto visit_impl = [&](const DexMethod* caller, auto& visit_fn) {
+      if (!visited.emplace(caller).second) {
         return;
       }
-      visited.emplace(caller);
-      auto callsites = strat.get_callsites(caller);
+      const auto& callsites = *callsites_map.get(caller);
       if (callsites.empty()) {
-        this->add_edge(make_node(caller), m_exit, IRList::iterator());
+        edge_infos.push_back({id_of(caller), EXIT_ID, IRList::iterator()});
       }
       for (const auto& callsite : callsites) {
-        this->add_edge(
-            make_node(caller), make_node(callsite.callee), callsite.invoke);
+        edge_infos.push_back(
+            {id_of(caller), id_of(callsite.callee), callsite.invoke});
         visit_fn(callsite.callee, visit_fn);
       }
     };
     visit_impl(caller, visit_impl);
   };
-
   for (const DexMethod* root : roots) {
     visit(root);
   }
-}
+  always_assert(nodes.size() == callsites_map.size() + 2);
 
-NodeId Graph::make_node(const DexMethod* m) {
-  auto it = m_nodes.find(m);
-  if (it != m_nodes.end()) {
-    return it->second;
+  // Freeze the edges into compressed sparse rows. A counting sort by caller
+  // and by callee keeps the discovery order within each row.
+  size_t num_nodes = nodes.size();
+  std::vector<size_t> succ_offsets(num_nodes + 1);
+  std::vector<size_t> pred_offsets(num_nodes + 1);
+  for (const auto& info : edge_infos) {
+    ++succ_offsets[info.caller + 1];
+    ++pred_offsets[info.callee + 1];
+  }
+  for (size_t i = 0; i < num_nodes; ++i) {
+    succ_offsets[i + 1] += succ_offsets[i];
+    pred_offsets[i + 1] += pred_offsets[i];
+  }
+  std::vector<EdgeInfo> by_caller(edge_infos.size());
+  {
+    auto next = succ_offsets;
+    for (const auto& info : edge_infos) {
+      by_caller[next[info.caller]++] = info;
+    }
+  }
+  auto& edges = storage->edges;
+  edges.reserve(by_caller.size());
+  for (const auto& info : by_caller) {
+    edges.emplace_back(&nodes[info.caller], &nodes[info.callee], info.invoke);
+  }
+
+  auto& successors = storage->successors;
+  auto& predecessors = storage->predecessors;
+  successors.reserve(edges.size());
+  for (const auto& edge : edges) {
+    successors.push_back(&edge);
+  }
+  // Visiting the edges by caller reorders the incoming edges, so go back to
+  // the discovery order through the position of each edge in its row.
+  predecessors.resize(edges.size());
+  {
+    auto next_succ = succ_offsets;
+    auto next_pred = pred_offsets;
+    for (const auto& info : edge_infos) {
+      predecessors[next_pred[info.callee]++] =
+          &edges[next_succ[info.caller]++];
+    }
   }
-  m_nodes.emplace(m, std::make_shared<Node>(m));
-  return m_nodes.at(m);
-}
 
-void Graph::add_edge(const NodeId& caller,
-                     const NodeId& callee,
-                     const IRList::iterator& invoke_it) {
-  auto edge = std::make_shared<Edge>(caller, callee, invoke_it);
-  caller->m_successors.emplace_back(edge);
-  callee->m_predecessors.emplace_back(edge);
+  for (size_t i = 0; i < num_nodes; ++i) {
+    nodes[i].m_successors = Edges(successors.data() + succ_offsets[i],
+                                  successors.data() + succ_offsets[i + 1]);
+    nodes[i].m_predecessors = Edges(predecessors.data() + pred_offsets[i],
+                                    predecessors.data() + pred_offsets[i + 1]);
+  }
+  m_storage = std::move(storage);
 }
 
 } // namespace call_graph
@@ -7,7 +7,9 @@
 
 #pragma once
 
+#include <memory>
 #include <unordered_map>
+#include <vector>
 
 #include "DexClass.h"
 #include "IRCode.h"
@@ -19,6 +21,10 @@
  * API for use with fixpoint iteration algorithms.
  */
 
+namespace method_override_graph {
+class Graph;
+} // namespace method_override_graph
+
 namespace call_graph {
 
 class Graph;
@@ -37,6 +43,13 @@ Graph single_callee_graph(const Scope&);
 
 Graph complete_call_graph(const Scope&);
 
+/*
+ * Same as above, but reuse the given method override graph of the scope.
+ */
+Graph single_callee_graph(const method_override_graph::Graph&, const Scope&);
+
+Graph complete_call_graph(const method_override_graph::Graph&, const Scope&);
+
 struct CallSite {
   const DexMethod* callee;
   IRList::iterator invoke;
@@ -53,6 +66,9 @@ using CallSites = std::vector<CallSite>;
  * recursively until the graph is fully mapped out. One can think of the
  * BuildStrategy as implicitly encoding the graph structure, with the Graph
  * constructor reifying it.
+ *
+ * get_callsites() is called concurrently for different methods, so it must be
+ * thread-safe.
  */
 class BuildStrategy {
  public:
@@ -63,9 +79,31 @@ class BuildStrategy {
   virtual CallSites get_callsites(const DexMethod*) const = 0;
 };
 
+class Node;
 class Edge;
-using EdgeId = std::shared_ptr<Edge>;
-using Edges = std::vector<std::shared_ptr<Edge>>;
+using NodeId = const Node*;
+using EdgeId = const Edge*;
+
+/*
+ * A contiguous slice of the edge arrays of a Graph.
+ */
+class Edges {
+ public:
+  using iterator = const EdgeId*;
+  using const_iterator = iterator;
+
+  Edges() = default;
+  Edges(iterator begin, iterator end) : m_begin(begin), m_end(end) {}
+
+  iterator begin() const { return m_begin; }
+  iterator end() const { return m_end; }
+  size_t size() const { return m_end - m_begin; }
+  bool empty() const { return m_begin == m_end; }
+
+ private:
+  iterator m_begin{nullptr};
+  iterator m_end{nullptr};
+};
 
 class Node {
   enum NodeType {
@@ -75,31 +113,36 @@ class Node {
   };
 
  public:
-  explicit Node(const DexMethod* m) : m_method(m), m_type(REAL_METHOD) {}
-  explicit Node(NodeType type) : m_method(nullptr), m_type(type) {}
+  Node(const DexMethod* m, uint32_t id)
+      : m_method(m), m_type(REAL_METHOD), m_id(id) {}
+  Node(NodeType type, uint32_t id)
+      : m_method(nullptr), m_type(type), m_id(id) {}
 
   const DexMethod* method() const { return m_method; }
   bool operator==(const Node& that) const { return method() == that.method(); }
-  const Edges& callers() const { return m_predecessors; }
-  const Edges& callees() const { return m_successors; }
+  Edges callers() const { return m_predecessors; }
+  Edges callees() const { return m_successors; }
+
+  bool is_entry() const { return m_type == GHOST_ENTRY; }
+  bool is_exit() const { return m_type == GHOST_EXIT; }
 
-  bool is_entry() { return m_type == GHOST_ENTRY; }
-  bool is_exit() { return m_type == GHOST_EXIT; }
+  // Dense index of this node in [0, Graph::num_nodes()).
+  uint32_t id() const { return m_id; }
 
  private:
   const DexMethod* m_method;
   Edges m_predecessors;
   Edges m_successors;
   NodeType m_type;
+  uint32_t m_id;
 
   friend class Graph;
 };
 
-using NodeId = std::shared_ptr<Node>;
-
 class Edge {
  public:
-  Edge(NodeId caller, NodeId callee, const IRList::iterator& invoke_it);
+  Edge(NodeId caller, NodeId callee, const IRList::iterator& invoke_it)
+      : m_caller(caller), m_callee(callee), m_invoke_it(invoke_it) {}
   IRList::iterator invoke_iterator() const { return m_invoke_it; }
   NodeId caller() const { return m_caller; }
   NodeId callee() const { return m_callee; }
@@ -110,42 +153,58 @@ class Edge {
   IRList::iterator m_invoke_it;
 };
 
+/*
+ * The graph is immutable once built. Nodes are numbered densely and kept in a
+ * single array, and the edges are laid out in compressed sparse row form: the
+ * outgoing edges of a node are adjacent in one array, and the incoming ones
+ * in another. Copies of a Graph share that storage; NodeIds and EdgeIds are
+ * plain pointers into it and stay valid as long as one of the copies does.
+ */
 class Graph final {
  public:
   explicit Graph(const BuildStrategy&);
 
-  NodeId entry() const { return m_entry; }
-  NodeId exit() const { return m_exit; }
+  NodeId entry() const { return &m_storage->nodes[ENTRY_ID]; }
+  NodeId exit() const { return &m_storage->nodes[EXIT_ID]; }
 
   bool has_node(const DexMethod* m) const {
-    return m_nodes.count(const_cast<DexMethod*>(m)) != 0;
+    return m_storage->ids.count(m) != 0;
   }
 
   NodeId node(const DexMethod* m) const {
     if (m == nullptr) {
-      return m_entry;
+      return entry();
     }
-    return m_nodes.at(m);
+    return &m_storage->nodes[m_storage->ids.at(m)];
   }
 
- private:
-  NodeId make_node(const DexMethod*);
+  size_t num_nodes() const { return m_storage->nodes.size(); }
 
-  void add_edge(const NodeId& caller,
-                const NodeId& callee,
-                const IRList::iterator& invoke_it);
+  NodeId node_by_id(uint32_t id) const { return &m_storage->nodes.at(id); }
+
+ private:
+  static constexpr uint32_t ENTRY_ID = 0;
+  static constexpr uint32_t EXIT_ID = 1;
+
+  struct Storage {
+    std::vector<Node> nodes;
+    std::unordered_map<const DexMethod*, uint32_t> ids;
+    // All edges, grouped by caller.
+    std::vector<Edge> edges;
+    // The rows of the outgoing and incoming edges of each node.
+    std::vector<EdgeId> successors;
+    std::vector<EdgeId> predecessors;
+  };
 
-  std::shared_ptr<Node> m_entry;
-  std::shared_ptr<Node> m_exit;
-  std::unordered_map<const DexMethod*, NodeId> m_nodes;
+  std::shared_ptr<const Storage> m_storage;
 };
 
 // A static-method-only API for use with the monotonic fixpoint iterator.
 class GraphInterface {
  public:
   using Graph = call_graph::Graph;
-  using NodeId = std::shared_ptr<Node>;
-  using EdgeId = std::shared_ptr<Edge>;
+  using NodeId = call_graph::NodeId;
+  using EdgeId = call_graph::EdgeId;
 
   static NodeId entry(const Graph& graph) { return graph.entry(); }
   static NodeId exit(const Graph& graph) { return graph.exit(); }
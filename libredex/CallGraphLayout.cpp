@@ -0,0 +1,121 @@
+/*
+ * Copyright (c) Facebook, Inc. and its affiliates.
+ *
+ * This source code is licensed under the MIT license found in the
+ * LICENSE file in the root directory of this source tree.
+ */
+
+#include "CallGraphLayout.h"
+
+#include <algorithm>
+#include <limits>
+#include <unordered_map>
+
+#include "Debug.h"
+
+namespace call_graph_layout {
+
+namespace {
+
+constexpr uint32_t NONE = std::numeric_limits<uint32_t>::max();
+
+struct Cluster {
+  std::vector<uint32_t> nodes;
+  uint64_t size{0};
+  uint64_t weight{0};
+
+  double density() const {
+    return static_cast<double>(weight) / std::max<uint64_t>(size, 1);
+  }
+};
+
+} // namespace
+
+std::vector<uint32_t> cluster(const std::vector<Node>& nodes,
+                              const std::vector<Edge>& edges,
+                              uint32_t max_cluster_size) {
+  const uint32_t n = nodes.size();
+
+  // Sum up the weights of the edges from the same caller to the same callee.
+  std::unordered_map<uint64_t, uint64_t> edge_weights;
+  for (const auto& edge : edges) {
+    always_assert(edge.caller < n && edge.callee < n);
+    if (edge.caller != edge.callee) {
+      edge_weights[(uint64_t)edge.caller << 32 | edge.callee] += edge.weight;
+    }
+  }
+  std::vector<uint32_t> hottest_caller(n, NONE);
+  std::vector<uint64_t> hottest_caller_weight(n, 0);
+  for (const auto& p : edge_weights) {
+    uint32_t caller = p.first >> 32;
+    uint32_t callee = p.first & 0xffffffff;
+    auto& best = hottest_caller[callee];
+    auto& best_weight = hottest_caller_weight[callee];
+    if (p.second > best_weight ||
+        (p.second == best_weight && best != NONE && caller < best)) {
+      best = caller;
+      best_weight = p.second;
+    }
+  }
+
+  std::vector<Cluster> clusters(n);
+  std::vector<uint32_t> cluster_of(n);
+  for (uint32_t i = 0; i < n; ++i) {
+    clusters[i].nodes.push_back(i);
+    clusters[i].size = nodes[i].size;
+    clusters[i].weight = nodes[i].weight;
+    cluster_of[i] = i;
+  }
+
+  std::vector<uint32_t> by_weight(n);
+  for (uint32_t i = 0; i < n; ++i) {
+    by_weight[i] = i;
+  }
+  std::stable_sort(by_weight.begin(), by_weight.end(),
+                   [&nodes](uint32_t a, uint32_t b) {
+                     return nodes[a].weight > nodes[b].weight;
+                   });
+  for (auto callee : by_weight) {
+    auto caller = hottest_caller[callee];
+    if (caller == NONE) {
+      continue;
+    }
+    auto& caller_cluster = clusters[cluster_of[caller]];
+    auto& callee_cluster = clusters[cluster_of[callee]];
+    if (&caller_cluster == &callee_cluster ||
+        caller_cluster.size + callee_cluster.size > max_cluster_size) {
+      continue;
+    }
+    for (auto node : callee_cluster.nodes) {
+      cluster_of[node] = cluster_of[caller];
+    }
+    caller_cluster.nodes.insert(caller_cluster.nodes.end(),
+                                callee_cluster.nodes.begin(),
+                                callee_cluster.nodes.end());
+    caller_cluster.size += callee_cluster.size;
+    caller_cluster.weight += callee_cluster.weight;
+    callee_cluster = Cluster();
+  }
+
+  std::vector<const Cluster*> ordered;
+  for (const auto& c : clusters) {
+    if (!c.nodes.empty()) {
+      ordered.push_back(&c);
+    }
+  }
+  // Clusters are created by increasing node index, and their first node never
+  // changes, so a stable sort keeps ties deterministic.
+  std::stable_sort(ordered.begin(), ordered.end(),
+                   [](const Cluster* a, const Cluster* b) {
+                     return a->density() > b->density();
+                   });
+
+  std::vector<uint32_t> order;
+  order.reserve(n);
+  for (auto c : ordered) {
+    order.insert(order.end(), c->nodes.begin(), c->nodes.end());
+  }
+  return order;
+}
+
+} // namespace call_graph_layout
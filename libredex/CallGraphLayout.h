@@ -0,0 +1,50 @@
+/*
+ * Copyright (c) Facebook, Inc. and its affiliates.
+ *
+ * This source code is licensed under the MIT license found in the
+ * LICENSE file in the root directory of this source tree.
+ */
+
+#pragma once
+
+#include <cstdint>
+#include <vector>
+
+namespace call_graph_layout {
+
+// The pages of the code section are typically 4KB.
+constexpr uint32_t DEFAULT_MAX_CLUSTER_SIZE = 4096;
+
+struct Node {
+  // Size in bytes of the code of the method.
+  uint32_t size;
+  // How hot the method is; only the relative order matters.
+  uint64_t weight;
+};
+
+struct Edge {
+  uint32_t caller;
+  uint32_t callee;
+  // How often the callee was sampled being called by the caller.
+  uint64_t weight;
+};
+
+/*
+ * Orders the nodes with call-chain clustering [C3], so that callees end up in
+ * the same page as their hottest caller, and the hottest pages come first.
+ *
+ * Nodes are visited from the hottest one. Each node's cluster is appended to
+ * the cluster of its hottest caller, unless the merged cluster would exceed
+ * max_cluster_size bytes. The clusters are then ordered by decreasing density,
+ * i.e. weight per byte. Ties are broken by node index, so the result is
+ * deterministic.
+ *
+ *  [C3] G. Ottoni and B. Maher. Optimizing Function Placement for Large-Scale
+ *    Data-Center Applications. CGO 2017.
+ */
+std::vector<uint32_t> cluster(
+    const std::vector<Node>& nodes,
+    const std::vector<Edge>& edges,
+    uint32_t max_cluster_size = DEFAULT_MAX_CLUSTER_SIZE);
+
+} // namespace call_graph_layout
@@ -0,0 +1,122 @@
+/*
+ * Copyright (c) Facebook, Inc. and its affiliates.
+ *
+ * This source code is licensed under the MIT license found in the
+ * LICENSE file in the root directory of this source tree.
+ */
+
+#include "CallSiteIndex.h"
+
+#include <algorithm>
+#include <unordered_set>
+
+#include "Walkers.h"
+#include "WorkQueue.h"
+
+namespace call_site_index {
+
+CallSiteIndex::CallSiteIndex(const Scope& scope) {
+  std::vector<DexMethod*> callers;
+  walk::methods(scope, [&](DexMethod* method) {
+    if (method->get_code() != nullptr) {
+      callers.push_back(method);
+    }
+  });
+  add_callers(callers);
+}
+
+void CallSiteIndex::add_callers(const std::vector<DexMethod*>& callers) {
+  // Each caller is scanned on its own, and the call sites are then added in
+  // the order of the callers, so that the index is deterministic.
+  std::vector<std::vector<std::pair<DexMethodRef*, IRList::iterator>>>
+      invokes(callers.size());
+  auto wq = workqueue_foreach<size_t>([&](size_t i) {
+    auto& code = *callers[i]->get_code();
+    always_assert(!code.editable_cfg_built());
+    for (auto it = code.begin(); it != code.end(); ++it) {
+      if (it->type == MFLOW_OPCODE && is_invoke(it->insn->opcode())) {
+        invokes[i].emplace_back(it->insn->get_method(), it);
+      }
+    }
+  });
+  for (size_t i = 0; i < callers.size(); ++i) {
+    wq.add_item(i);
+  }
+  wq.run_all();
+
+  for (size_t i = 0; i < callers.size(); ++i) {
+    auto caller = callers[i];
+    auto& callees = m_callees[caller];
+    for (auto& p : invokes[i]) {
+      m_call_sites[p.first].emplace_back(caller, p.second);
+      callees.push_back(p.first);
+    }
+    std::sort(callees.begin(), callees.end());
+    callees.erase(std::unique(callees.begin(), callees.end()), callees.end());
+  }
+}
+
+const CallSites& CallSiteIndex::get_call_sites(DexMethodRef* callee) const {
+  static const CallSites no_call_sites;
+  auto it = m_call_sites.find(callee);
+  return it == m_call_sites.end() ? no_call_sites : it->second;
+}
+
+std::vector<DexMethodRef*> CallSiteIndex::get_callees() const {
+  std::vector<DexMethodRef*> callees;
+  callees.reserve(m_call_sites.size());
+  for (auto& p : m_call_sites) {
+    callees.push_back(p.first);
+  }
+  return callees;
+}
+
+void CallSiteIndex::update_callers(const std::vector<DexMethod*>& callers) {
+  for (auto caller : callers) {
+    auto it = m_callees.find(caller);
+    if (it == m_callees.end()) {
+      continue;
+    }
+    for (auto callee : it->second) {
+      auto& call_sites = m_call_sites.at(callee);
+      call_sites.erase(std::remove_if(call_sites.begin(),
+                                      call_sites.end(),
+                                      [caller](const CallSite& call_site) {
+                                        return call_site.caller == caller;
+                                      }),
+                       call_sites.end());
+      if (call_sites.empty()) {
+        m_call_sites.erase(callee);
+      }
+    }
+    m_callees.erase(it);
+  }
+  std::vector<DexMethod*> callers_with_code;
+  std::unordered_set<DexMethod*> seen;
+  for (auto caller : callers) {
+    if (caller->get_code() != nullptr && seen.insert(caller).second) {
+      callers_with_code.push_back(caller);
+    }
+  }
+  add_callers(callers_with_code);
+}
+
+void CallSiteIndex::move_call_sites(DexMethodRef* from, DexMethodRef* to) {
+  auto it = m_call_sites.find(from);
+  if (it == m_call_sites.end() || from == to) {
+    return;
+  }
+  auto call_sites = std::move(it->second);
+  m_call_sites.erase(it);
+  for (auto& call_site : call_sites) {
+    auto& callees = m_callees.at(call_site.caller);
+    std::replace(callees.begin(), callees.end(), from, to);
+    std::sort(callees.begin(), callees.end());
+    callees.erase(std::unique(callees.begin(), callees.end()), callees.end());
+  }
+  auto& to_call_sites = m_call_sites[to];
+  to_call_sites.insert(to_call_sites.end(), call_sites.begin(),
+                       call_sites.end());
+}
+
+} // namespace call_site_index
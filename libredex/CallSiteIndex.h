@@ -0,0 +1,80 @@
+/*
+ * Copyright (c) Facebook, Inc. and its affiliates.
+ *
+ * This source code is licensed under the MIT license found in the
+ * LICENSE file in the root directory of this source tree.
+ */
+
+#pragma once
+
+#include <unordered_map>
+#include <vector>
+
+#include "DexClass.h"
+#include "IRCode.h"
+
+namespace call_site_index {
+
+struct CallSite {
+  DexMethod* caller;
+  IRList::iterator invoke;
+
+  CallSite(DexMethod* caller, const IRList::iterator& invoke)
+      : caller(caller), invoke(invoke) {}
+};
+
+using CallSites = std::vector<CallSite>;
+
+/*
+ * Maps the method references of a scope to the invoke instructions that refer
+ * to them, so that passes which change a method or its invokes can visit its
+ * call sites without walking all the code of the scope again.
+ *
+ * The index is built in parallel, and the call sites of every method ref are
+ * in the order of the scope. It holds iterators into the IRLists of the
+ * callers, hence it cannot be built while a caller has an editable cfg, and it
+ * must be kept in sync with the code:
+ * - Changing the sources of an indexed invoke needs nothing.
+ * - After making all the invokes of a method ref refer to another one, call
+ *   move_call_sites().
+ * - After any other change to the code of a caller, e.g. removing or adding
+ *   instructions, call update_callers().
+ */
+class CallSiteIndex {
+ public:
+  explicit CallSiteIndex(const Scope& scope);
+
+  /*
+   * The call sites of the given method ref, which is empty for the method refs
+   * that aren't invoked.
+   */
+  const CallSites& get_call_sites(DexMethodRef* callee) const;
+
+  /*
+   * All the method refs which are invoked in the scope, in no particular
+   * order.
+   */
+  std::vector<DexMethodRef*> get_callees() const;
+
+  /*
+   * Drops the call sites of the given callers and indexes their current code
+   * again.
+   */
+  void update_callers(const std::vector<DexMethod*>& callers);
+
+  /*
+   * Records that the invokes of all the call sites of `from` now refer to
+   * `to`.
+   */
+  void move_call_sites(DexMethodRef* from, DexMethodRef* to);
+
+ private:
+  // Indexes the code of callers which have no call sites in the index yet.
+  void add_callers(const std::vector<DexMethod*>& callers);
+
+  std::unordered_map<DexMethodRef*, CallSites> m_call_sites;
+  // The method refs invoked by each caller, to drop its call sites.
+  std::unordered_map<const DexMethod*, std::vector<DexMethodRef*>> m_callees;
+};
+
+} // namespace call_site_index
@@ -117,6 +117,22 @@ ClassHierarchy build_type_hierarchy(const Scope& scope) {
   return hierarchy;
 }
 
+void build_extends_or_implements_hierarchy(const Scope& scope,
+                                           ClassHierarchy* hierarchy) {
+  for (const auto& cls : scope) {
+    const auto* type = cls->get_type();
+    // ensure an entry for the DexClass is created
+    (*hierarchy)[type];
+    const auto* super = cls->get_super_class();
+    if (super != nullptr) {
+      (*hierarchy)[super].insert(type);
+    }
+    for (const auto& impl : cls->get_interfaces()->get_type_list()) {
+      (*hierarchy)[impl].insert(type);
+    }
+  }
+}
+
 InterfaceMap build_interface_map(const ClassHierarchy& hierarchy) {
   InterfaceMap interfaces;
   // build the type hierarchy
@@ -143,8 +159,9 @@ void get_all_children(const ClassHierarchy& hierarchy,
                       TypeSet& children) {
   const auto& direct = get_children(hierarchy, type);
   for (const auto& child : direct) {
-    children.insert(child);
-    get_all_children(hierarchy, child, children);
+    if (children.insert(child).second) {
+      get_all_children(hierarchy, child, children);
+    }
   }
 }
 
@@ -27,6 +27,15 @@ using ClassHierarchy = std::unordered_map<const DexType*, TypeSet>;
  */
 ClassHierarchy build_type_hierarchy(const Scope& scope);
 
+/**
+ * Adds class -> subclass and interface -> implementor (or extending interface)
+ * edges for the classes in scope. Unlike build_type_hierarchy, this does not
+ * distinguish between subclasses and implementors, which is what ProGuard's
+ * `extends`/`implements` clauses need.
+ */
+void build_extends_or_implements_hierarchy(const Scope& scope,
+                                           ClassHierarchy* hierarchy);
+
 /**
  * Return the direct children of a type.
  */
@@ -34,7 +43,9 @@ const TypeSet& get_children(const ClassHierarchy& hierarchy,
                             const DexType* type);
 
 /**
- * Return all children down the hierarchy of a given type.
+ * Return all children down the hierarchy of a given type. Each child is only
+ * descended into once, even when it is reachable along several paths, as with
+ * interfaces.
  */
 void get_all_children(const ClassHierarchy& hierarchy,
                       const DexType* type,
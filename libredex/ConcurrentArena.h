@@ -0,0 +1,92 @@
+/*
+ * Copyright (c) Facebook, Inc. and its affiliates.
+ *
+ * This source code is licensed under the MIT license found in the
+ * LICENSE file in the root directory of this source tree.
+ */
+
+#pragma once
+
+#include <algorithm>
+#include <atomic>
+#include <cstddef>
+#include <memory>
+#include <mutex>
+#include <vector>
+
+/**
+ * A thread-safe bump-pointer allocator for objects that live as long as the
+ * arena itself, such as interned strings.
+ *
+ * Memory is carved out of large chunks that are shared by all threads;
+ * allocating is a single atomic increment in the common case, and only
+ * starting a new chunk takes a lock. Individual allocations are never freed,
+ * and the arena does not run destructors: all memory is released at once when
+ * the arena is destroyed.
+ */
+class ConcurrentArena {
+ public:
+  // All allocations are aligned to this.
+  static constexpr size_t ALIGNMENT = alignof(std::max_align_t);
+
+  explicit ConcurrentArena(size_t chunk_size = 1 << 20)
+      : m_chunk_size(chunk_size) {
+    add_chunk(m_chunk_size);
+  }
+
+  ConcurrentArena(const ConcurrentArena&) = delete;
+  ConcurrentArena& operator=(const ConcurrentArena&) = delete;
+
+  /*
+   * Returns uninitialized memory of the given size. This operation is always
+   * thread-safe.
+   */
+  void* allocate(size_t size) {
+    size = (size + ALIGNMENT - 1) & ~(ALIGNMENT - 1);
+    while (true) {
+      Chunk* chunk = m_current.load(std::memory_order_acquire);
+      size_t offset = chunk->used.fetch_add(size, std::memory_order_relaxed);
+      if (offset + size <= chunk->size) {
+        return chunk->data() + offset;
+      }
+      std::lock_guard<std::mutex> lock(m_mutex);
+      if (m_current.load(std::memory_order_relaxed) == chunk) {
+        add_chunk(std::max(m_chunk_size, size));
+      }
+    }
+  }
+
+  // Total size of all chunks. This operation is always thread-safe.
+  size_t reserved_bytes() const {
+    std::lock_guard<std::mutex> lock(m_mutex);
+    size_t res = 0;
+    for (auto& chunk : m_chunks) {
+      res += chunk->size;
+    }
+    return res;
+  }
+
+ private:
+  struct Chunk {
+    explicit Chunk(size_t size)
+        : storage(new std::max_align_t[(size + ALIGNMENT - 1) / ALIGNMENT]),
+          size(size) {}
+
+    char* data() { return reinterpret_cast<char*>(storage.get()); }
+
+    std::unique_ptr<std::max_align_t[]> storage;
+    const size_t size;
+    std::atomic<size_t> used{0};
+  };
+
+  // Must be called while holding m_mutex (or from the constructor).
+  void add_chunk(size_t size) {
+    m_chunks.emplace_back(new Chunk(size));
+    m_current.store(m_chunks.back().get(), std::memory_order_release);
+  }
+
+  const size_t m_chunk_size;
+  std::atomic<Chunk*> m_current{nullptr};
+  mutable std::mutex m_mutex;
+  std::vector<std::unique_ptr<Chunk>> m_chunks;
+};
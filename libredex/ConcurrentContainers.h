@@ -7,12 +7,19 @@
 
 #pragma once
 
+#include <atomic>
+#include <cstdint>
 #include <functional>
 #include <initializer_list>
 #include <iterator>
+#include <memory>
+#include <mutex>
+#include <thread>
+#include <tuple>
 #include <unordered_map>
 #include <unordered_set>
 #include <utility>
+#include <vector>
 
 #include <boost/thread.hpp>
 
@@ -461,6 +468,276 @@ class InsertOnlyConcurrentSet final
   size_t erase(const Key& key) = delete;
 };
 
+/**
+ * A concurrent map that only accepts insertions, implemented as a lock-free
+ * open-addressing hash table.
+ *
+ * Entries live in individually allocated nodes that never move, so pointers to
+ * values remain valid for the lifetime of the map. This allows mutable values
+ * to be updated in place, e.g. when they are atomics.
+ *
+ * Lookups and insertions never take a lock. Only growing the table is
+ * serialized: the thread that grows it freezes all empty slots of the old
+ * table, so that no insertion can succeed there anymore, and copies all nodes
+ * into a table twice as large. Threads that run into a frozen slot move on to
+ * the new table once it has been published. Old tables are retired but only
+ * freed when the map is destroyed.
+ *
+ * In contrast to the other concurrent containers, a lookup does not need to
+ * hash into a locked slot, which makes this suitable for heavily shared
+ * interning tables.
+ */
+template <typename Key,
+          typename Value,
+          typename Hash = std::hash<Key>,
+          typename Equal = std::equal_to<Key>>
+class InsertOnlyConcurrentMap final {
+ public:
+  using value_type = std::pair<const Key, Value>;
+
+ private:
+  struct Node {
+    template <typename... Args>
+    Node(size_t hash, const Key& key, Args&&... args)
+        : entry(std::piecewise_construct,
+                std::forward_as_tuple(key),
+                std::forward_as_tuple(std::forward<Args>(args)...)),
+          hash(hash) {}
+
+    value_type entry;
+    const size_t hash;
+    // All nodes form a list, which supports iteration and destruction.
+    Node* next_inserted{nullptr};
+  };
+
+  struct Table {
+    explicit Table(size_t capacity)
+        : mask(capacity - 1),
+          max_used(capacity / 2),
+          slots(new std::atomic<Node*>[capacity]) {
+      for (size_t i = 0; i < capacity; ++i) {
+        slots[i].store(nullptr, std::memory_order_relaxed);
+      }
+    }
+
+    const size_t mask;
+    const size_t max_used;
+    std::unique_ptr<std::atomic<Node*>[]> slots;
+    std::atomic<size_t> used{0};
+    std::atomic<Table*> next{nullptr};
+  };
+
+  // Marks an empty slot of a table that has been superseded.
+  static Node* frozen() { return reinterpret_cast<Node*>(uintptr_t(1)); }
+
+ public:
+  class const_iterator {
+   public:
+    using difference_type = std::ptrdiff_t;
+    using value_type = typename InsertOnlyConcurrentMap::value_type;
+    using pointer = const value_type*;
+    using reference = const value_type&;
+    using iterator_category = std::forward_iterator_tag;
+
+    explicit const_iterator(const Node* node) : m_node(node) {}
+
+    reference operator*() const { return m_node->entry; }
+    pointer operator->() const { return &m_node->entry; }
+
+    const_iterator& operator++() {
+      m_node = m_node->next_inserted;
+      return *this;
+    }
+
+    const_iterator operator++(int) {
+      const_iterator retval = *this;
+      ++(*this);
+      return retval;
+    }
+
+    bool operator==(const const_iterator& other) const {
+      return m_node == other.m_node;
+    }
+
+    bool operator!=(const const_iterator& other) const {
+      return !(*this == other);
+    }
+
+   private:
+    const Node* m_node;
+  };
+
+  explicit InsertOnlyConcurrentMap(size_t initial_capacity = 1024) {
+    size_t capacity = 16;
+    while (capacity < initial_capacity) {
+      capacity *= 2;
+    }
+    m_tables.emplace_back(new Table(capacity));
+    m_table.store(m_tables.back().get(), std::memory_order_relaxed);
+  }
+
+  InsertOnlyConcurrentMap(const InsertOnlyConcurrentMap&) = delete;
+  InsertOnlyConcurrentMap& operator=(const InsertOnlyConcurrentMap&) = delete;
+
+  ~InsertOnlyConcurrentMap() {
+    for (Node* node = m_nodes.load(); node != nullptr;) {
+      Node* next = node->next_inserted;
+      delete node;
+      node = next;
+    }
+  }
+
+  /*
+   * Iterating while the map is concurrently modified is thread-safe, but may
+   * or may not observe the concurrent insertions.
+   */
+  const_iterator begin() const {
+    return const_iterator(m_nodes.load(std::memory_order_acquire));
+  }
+
+  const_iterator end() const { return const_iterator(nullptr); }
+
+  size_t size() const { return m_size.load(); }
+
+  /*
+   * Return a pointer on the value, or `nullptr` if the key is not in the map.
+   * This operation is always thread-safe.
+   */
+  const Value* get(const Key& key) const {
+    const Node* node = find(key, Hash()(key));
+    return node == nullptr ? nullptr : &node->entry.second;
+  }
+
+  Value* get(const Key& key) {
+    Node* node = find(key, Hash()(key));
+    return node == nullptr ? nullptr : &node->entry.second;
+  }
+
+  size_t count(const Key& key) const { return get(key) == nullptr ? 0 : 1; }
+
+  /*
+   * If the key is not in the map yet, insert it with a value constructed from
+   * `args`. Returns a pair consisting of a pointer on the inserted value (or
+   * the value that prevented the insertion) and a boolean denoting whether the
+   * insertion took place. This operation is always thread-safe.
+   */
+  template <typename... Args>
+  std::pair<Value*, bool> emplace(const Key& key, Args&&... args) {
+    size_t hash = Hash()(key);
+    std::unique_ptr<Node> node;
+    Table* table = m_table.load(std::memory_order_acquire);
+    while (true) {
+      for (size_t i = hash & table->mask;; i = (i + 1) & table->mask) {
+        Node* current = table->slots[i].load(std::memory_order_acquire);
+        if (current == nullptr) {
+          if (table->used.load(std::memory_order_relaxed) >= table->max_used) {
+            grow(table);
+            break;
+          }
+          if (!node) {
+            node = std::make_unique<Node>(hash, key,
+                                          std::forward<Args>(args)...);
+          }
+          if (table->slots[i].compare_exchange_strong(
+                  current, node.get(), std::memory_order_acq_rel,
+                  std::memory_order_acquire)) {
+            table->used.fetch_add(1, std::memory_order_relaxed);
+            Node* inserted = node.release();
+            link(inserted);
+            return {&inserted->entry.second, true};
+          }
+          // Somebody else claimed (or froze) the slot; look at what's there.
+        }
+        if (current == frozen()) {
+          break;
+        }
+        if (current->hash == hash && Equal()(current->entry.first, key)) {
+          return {&current->entry.second, false};
+        }
+      }
+      table = next_table(table);
+    }
+  }
+
+ private:
+  Node* find(const Key& key, size_t hash) const {
+    Table* table = m_table.load(std::memory_order_acquire);
+    while (true) {
+      for (size_t i = hash & table->mask;; i = (i + 1) & table->mask) {
+        Node* current = table->slots[i].load(std::memory_order_acquire);
+        if (current == nullptr) {
+          return nullptr;
+        }
+        if (current == frozen()) {
+          break;
+        }
+        if (current->hash == hash && Equal()(current->entry.first, key)) {
+          return current;
+        }
+      }
+      table = next_table(table);
+    }
+  }
+
+  static Table* next_table(Table* table) {
+    Table* next;
+    // The next table is being filled right now.
+    while ((next = table->next.load(std::memory_order_acquire)) == nullptr) {
+      std::this_thread::yield();
+    }
+    return next;
+  }
+
+  void link(Node* node) {
+    m_size.fetch_add(1, std::memory_order_relaxed);
+    Node* head = m_nodes.load(std::memory_order_relaxed);
+    do {
+      node->next_inserted = head;
+    } while (!m_nodes.compare_exchange_weak(head, node,
+                                            std::memory_order_release,
+                                            std::memory_order_relaxed));
+  }
+
+  void grow(Table* table) {
+    std::lock_guard<std::mutex> lock(m_grow_mutex);
+    if (table->next.load(std::memory_order_acquire) != nullptr) {
+      // Somebody else beat us to it.
+      return;
+    }
+    size_t capacity = (table->mask + 1) * 2;
+    auto bigger = std::make_unique<Table>(capacity);
+    size_t used = 0;
+    for (size_t i = 0; i <= table->mask; ++i) {
+      Node* current = nullptr;
+      if (table->slots[i].compare_exchange_strong(current, frozen(),
+                                                  std::memory_order_acq_rel,
+                                                  std::memory_order_acquire)) {
+        continue;
+      }
+      // Occupied slots never change again; move the node over. Nobody else
+      // can access the new table yet.
+      size_t j = current->hash & bigger->mask;
+      while (bigger->slots[j].load(std::memory_order_relaxed) != nullptr) {
+        j = (j + 1) & bigger->mask;
+      }
+      bigger->slots[j].store(current, std::memory_order_relaxed);
+      ++used;
+    }
+    bigger->used.store(used, std::memory_order_relaxed);
+    Table* next = bigger.get();
+    m_tables.push_back(std::move(bigger));
+    table->next.store(next, std::memory_order_release);
+    m_table.store(next, std::memory_order_release);
+  }
+
+  std::atomic<Table*> m_table;
+  std::atomic<Node*> m_nodes{nullptr};
+  std::atomic<size_t> m_size{0};
+  // Guards growing, and m_tables.
+  std::mutex m_grow_mutex;
+  std::vector<std::unique_ptr<Table>> m_tables;
+};
+
 namespace cc_impl {
 
 template <typename Container, size_t n_slots>
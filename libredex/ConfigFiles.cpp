@@ -18,10 +18,20 @@
 ConfigFiles::ConfigFiles(const Json::Value& config, const std::string& outdir)
     : m_json(config),
       outdir(outdir),
-      m_proguard_map(config.get("proguard_map", "").asString()),
       m_profiled_methods_filename(
           config.get("profiled_methods_file", "").asString()),
+      m_call_graph_profile_filename(
+          config.get("call_graph_profile_file", "").asString()),
       m_printseeds(config.get("printseeds", "").asString()) {
+  auto proguard_map_filename = config.get("proguard_map", "").asString();
+  m_proguard_map =
+      std::async(proguard_map_filename.empty() ? std::launch::deferred
+                                               : std::launch::async,
+                 [proguard_map_filename] {
+                   return std::make_shared<const ProguardMap>(
+                       proguard_map_filename);
+                 })
+          .share();
 
   m_coldstart_class_filename = config.get("coldstart_classes", "").asString();
   if (m_coldstart_class_filename.empty()) {
@@ -33,6 +43,9 @@ ConfigFiles::ConfigFiles(const Json::Value& config, const std::string& outdir)
     load_method_to_weight();
   }
   load_method_sorting_whitelisted_substrings();
+  if (!m_call_graph_profile_filename.empty()) {
+    load_call_graph_profile();
+  }
   uint32_t instruction_size_bitwidth_limit =
       config.get("instruction_size_bitwidth_limit", 0).asUInt();
   always_assert_log(
@@ -44,6 +57,23 @@ ConfigFiles::ConfigFiles(const Json::Value& config, const std::string& outdir)
 
 ConfigFiles::ConfigFiles(const Json::Value& config) : ConfigFiles(config, "") {}
 
+void ConfigFiles::prefetch() {
+  always_assert(!m_load_class_lists_attempted && m_coldstart_classes.empty() &&
+                !m_method_profiles.is_initialized());
+  m_coldstart_classes_future = std::async(
+      std::launch::async, [this] { return load_coldstart_classes(); });
+  m_class_lists_future =
+      std::async(std::launch::async, [this] { return read_class_lists(); });
+  auto csv_filename =
+      get_json_config().get("agg_method_stats_file", std::string());
+  if (!csv_filename.empty()) {
+    m_method_profiles_parsed =
+        std::async(std::launch::async, [this, csv_filename] {
+          return m_method_profiles.parse(csv_filename);
+        });
+  }
+}
+
 /**
  * This function relies on the g_redex.
  */
@@ -110,24 +140,37 @@ std::vector<std::string> ConfigFiles::load_coldstart_classes() {
                       clzname.c_str(), file);
     clzname.replace(position, lentail, ";");
     coldstart_classes.emplace_back(
-        m_proguard_map.translate_class("L" + clzname));
+        get_proguard_map().translate_class("L" + clzname));
   }
   return coldstart_classes;
 }
 
-/**
- * Read a map of {list_name : class_list} from json
- */
 std::unordered_map<std::string, std::vector<std::string>>
 ConfigFiles::load_class_lists() {
-  std::unordered_map<std::string, std::vector<std::string>> lists;
+  auto lists = m_class_lists_future.valid() ? m_class_lists_future.get()
+                                            : read_class_lists();
+  if (!lists) {
+    return {};
+  }
+  (*lists)["secondary_dex_head.list"] = get_coldstart_classes();
+  return std::move(*lists);
+}
+
+/**
+ * Read a map of {list_name : class_list} from json, or none if there is no
+ * class_lists file.
+ */
+boost::optional<std::unordered_map<std::string, std::vector<std::string>>>
+ConfigFiles::read_class_lists() const {
   std::string class_lists_filename;
   this->m_json.get("class_lists", "", class_lists_filename);
 
   if (class_lists_filename.empty()) {
-    return lists;
+    return boost::none;
   }
 
+  std::unordered_map<std::string, std::vector<std::string>> lists;
+
   std::ifstream input(class_lists_filename);
   Json::Reader reader;
   Json::Value root;
@@ -145,9 +188,6 @@ ConfigFiles::load_class_lists() {
       lists[it.key().asString()].push_back((*list_it).asString());
     }
   }
-
-  lists["secondary_dex_head.list"] = get_coldstart_classes();
-
   return lists;
 }
 
@@ -172,8 +212,29 @@ void ConfigFiles::load_method_to_weight() {
   TRACE(CUSTOMSORT, 2, "Preset sort weight count=%d", count);
 }
 
+/**
+ * Each line of the file is a caller, a callee, and how many times the call
+ * was sampled, separated by whitespace.
+ */
+void ConfigFiles::load_call_graph_profile() {
+  std::ifstream infile(m_call_graph_profile_filename.c_str());
+  assert_log(infile, "Can't open call graph profile file: %s\n",
+             m_call_graph_profile_filename.c_str());
+
+  CallGraphProfileEdge edge;
+  while (infile >> edge.caller >> edge.callee >> edge.weight) {
+    m_call_graph_profile.push_back(edge);
+  }
+
+  assert_log(!m_call_graph_profile.empty(),
+             "Call graph profile file %s didn't contain valid entries\n",
+             m_call_graph_profile_filename.c_str());
+  TRACE(CUSTOMSORT, 2, "Call graph profile edge count=%zu",
+        m_call_graph_profile.size());
+}
+
 void ConfigFiles::load_method_sorting_whitelisted_substrings() {
-  const auto json_cfg = get_json_config();
+  const auto& json_cfg = get_json_config();
   Json::Value json_result;
   json_cfg.get("method_sorting_whitelisted_substrings", Json::nullValue,
                json_result);
@@ -191,10 +252,32 @@ void ConfigFiles::ensure_agg_method_stats_loaded() {
   if (csv_filename == empty_str || m_method_profiles.is_initialized()) {
     return;
   }
-  bool success = m_method_profiles.initialize(csv_filename);
+  bool success =
+      m_method_profiles_parsed.valid()
+          ? m_method_profiles.initialize_parsed(m_method_profiles_parsed.get())
+          : m_method_profiles.initialize(csv_filename);
   if (!success) {
     std::cerr << "WARNING: Unable to initialize method stats!\n";
+    return;
+  }
+
+  Json::Value weights;
+  get_json_config().get("method_profile_weights", Json::nullValue, weights);
+  if (weights.empty()) {
+    return;
+  }
+  method_profiles::WeightedStatsConfig weighted_config;
+  const auto& interactions = weights["interactions"];
+  for (auto it = interactions.begin(); it != interactions.end(); ++it) {
+    weighted_config.interaction_weights.emplace(it.name(), it->asDouble());
   }
+  weighted_config.warm_percentile =
+      weights.get("warm_percentile", weighted_config.warm_percentile)
+          .asDouble();
+  weighted_config.hot_percentile =
+      weights.get("hot_percentile", weighted_config.hot_percentile)
+          .asDouble();
+  m_method_profiles.set_weighted_stats_config(weighted_config);
 }
 
 void ConfigFiles::load_inliner_config(inliner::InlinerConfig* inliner_config) {
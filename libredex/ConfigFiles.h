@@ -7,6 +7,7 @@
 
 #pragma once
 
+#include <future>
 #include <map>
 #include <string>
 #include <unordered_set>
@@ -22,6 +23,17 @@
 #include "ProguardMap.h"
 
 class DexType;
+
+/**
+ * A caller-callee edge of a sampled call-graph profile, by deobfuscated
+ * method names.
+ */
+struct CallGraphProfileEdge {
+  std::string caller;
+  std::string callee;
+  unsigned int weight;
+};
+
 using MethodTuple = std::tuple<DexString*, DexString*, DexString*>;
 using MethodMap = std::map<MethodTuple, DexClass*>;
 
@@ -32,7 +44,22 @@ struct ConfigFiles {
   explicit ConfigFiles(const Json::Value& config);
   ConfigFiles(const Json::Value& config, const std::string& outdir);
 
+  /**
+   * Starts reading the coldstart classes, the class lists and the method
+   * profiles on background threads, so that it overlaps with loading the
+   * dexes, like the ProGuard map always does. The accessors then only wait
+   * for the reads still in flight. The method names of the profiles are
+   * resolved on first access, so that has to come after the dexes are
+   * loaded, as without prefetching.
+   *
+   * Must be called before any of those accessors.
+   */
+  void prefetch();
+
   const std::vector<std::string>& get_coldstart_classes() {
+    if (m_coldstart_classes_future.valid()) {
+      m_coldstart_classes = m_coldstart_classes_future.get();
+    }
     if (m_coldstart_classes.empty()) {
       m_coldstart_classes = load_coldstart_classes();
     }
@@ -67,6 +94,14 @@ struct ConfigFiles {
     return m_method_profiles;
   }
 
+  /**
+   * Doesn't load the method profiles, so that it can be used concurrently;
+   * they are empty unless get_method_profiles was called before.
+   */
+  const method_profiles::MethodProfiles& get_loaded_method_profiles() const {
+    return m_method_profiles;
+  }
+
   const std::unordered_set<DexType*>& get_no_optimizations_annos();
   const std::unordered_set<DexMethodRef*>& get_pure_methods();
 
@@ -80,6 +115,10 @@ struct ConfigFiles {
     return m_method_sorting_whitelisted_substrings;
   }
 
+  const std::vector<CallGraphProfileEdge>& get_call_graph_profile() const {
+    return m_call_graph_profile;
+  }
+
   std::string metafile(const std::string& basename) const {
     if (basename.empty()) {
       return std::string();
@@ -89,7 +128,13 @@ struct ConfigFiles {
 
   std::string get_outdir() const { return outdir; }
 
-  const ProguardMap& get_proguard_map() const { return m_proguard_map; }
+  /**
+   * The map is parsed on a background thread started by the constructor, so
+   * this waits for it the first time.
+   */
+  const ProguardMap& get_proguard_map() const {
+    return *m_proguard_map.get();
+  }
 
   const std::string& get_printseeds() const { return m_printseeds; }
 
@@ -181,22 +226,34 @@ struct ConfigFiles {
 
   std::vector<std::string> load_coldstart_classes();
   std::unordered_map<std::string, std::vector<std::string>> load_class_lists();
+  boost::optional<std::unordered_map<std::string, std::vector<std::string>>>
+  read_class_lists() const;
   void load_method_to_weight();
   void load_method_sorting_whitelisted_substrings();
+  void load_call_graph_profile();
   void ensure_agg_method_stats_loaded();
   void load_inliner_config(inliner::InlinerConfig*);
 
   bool m_load_class_lists_attempted{false};
-  ProguardMap m_proguard_map;
+  std::shared_future<std::shared_ptr<const ProguardMap>> m_proguard_map;
   std::string m_coldstart_class_filename;
   std::string m_profiled_methods_filename;
+  std::string m_call_graph_profile_filename;
   std::vector<std::string> m_coldstart_classes;
   std::unordered_map<std::string, std::vector<std::string>> m_class_lists;
   std::unordered_map<std::string, unsigned int> m_method_to_weight;
   std::unordered_set<std::string> m_method_sorting_whitelisted_substrings;
+  std::vector<CallGraphProfileEdge> m_call_graph_profile;
   std::string m_printseeds; // Filename to dump computed seeds.
   method_profiles::MethodProfiles m_method_profiles;
 
+  // The reads started by prefetch(), until they are waited for.
+  std::future<std::vector<std::string>> m_coldstart_classes_future;
+  std::future<boost::optional<
+      std::unordered_map<std::string, std::vector<std::string>>>>
+      m_class_lists_future;
+  std::future<bool> m_method_profiles_parsed;
+
   // limits the output instruction size of any DexMethod to 2^n
   // 0 when limit is not present
   uint32_t m_instruction_size_bitwidth_limit;
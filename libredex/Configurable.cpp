@@ -53,9 +53,9 @@ void Configurable::parse_config(const JsonWrapper& json) {
          const Json::Value& default_value) {};
   m_trait_reflector = [](const std::string&, const Json::Value&) {};
   m_parser = [&json](const std::string& name) {
-    // TODO: add std::string API for contains
-    if (json.contains(name.c_str())) {
-      return boost::optional<const Json::Value&>(json[name.c_str()]);
+    auto value = json.find(name.c_str());
+    if (value != nullptr) {
+      return boost::optional<const Json::Value&>(*value);
     } else {
       return boost::optional<const Json::Value&>{};
     }
@@ -15,7 +15,9 @@
 
 #include "CppUtil.h"
 #include "DexUtil.h"
+#include "Dominators.h"
 #include "GraphUtil.h"
+#include "MonotonicFixpointIterator.h"
 #include "Transform.h"
 #include "WeakTopologicalOrdering.h"
 
@@ -790,8 +792,7 @@ void ControlFlowGraph::add_catch_edges(TryEnds& try_ends,
 BlockId ControlFlowGraph::next_block_id() const {
   // Choose the next largest id. Note that we can't use m_block.size() because
   // we may have deleted some blocks from the cfg.
-  const auto& rbegin = m_blocks.rbegin();
-  return (rbegin == m_blocks.rend()) ? 0 : (rbegin->first + 1);
+  return m_blocks.id_bound();
 }
 
 void ControlFlowGraph::remove_unreachable_succ_edges() {
@@ -966,7 +967,7 @@ void ControlFlowGraph::remove_empty_blocks() {
       }
 
       if (b == entry_block()) {
-        m_entry_block = succ;
+        set_entry_block(succ);
       }
     }
     if (b == m_entry_block) {
@@ -1354,7 +1355,7 @@ void ControlFlowGraph::deep_copy(ControlFlowGraph* new_cfg) const {
   cloner.fix_parent_positions();
 
   // patch the edge pointers in the blocks to their new cfg counterparts
-  for (auto& entry : new_cfg->m_blocks) {
+  for (const auto& entry : new_cfg->m_blocks) {
     Block* b = entry.second;
     for (Edge*& e : b->m_preds) {
       e = old_edge_to_new.at(e);
@@ -1401,6 +1402,11 @@ std::vector<Block*> ControlFlowGraph::order() {
   // We must simplify first to remove any unreachable blocks
   simplify();
 
+  // Simplification invalidates the cached order if it changes the graph.
+  if (cached_order_is_valid()) {
+    return m_order;
+  }
+
   // This is a modified Weak Topological Ordering (WTO). We create "chains" of
   // blocks that will be kept together, then feed these chains to WTO for it to
   // choose the ordering of the chains. Then, we deconstruct the chains to get
@@ -1410,24 +1416,48 @@ std::vector<Block*> ControlFlowGraph::order() {
   // map
   std::vector<std::unique_ptr<Chain>> chains;
   // keep track of which blocks are in each chain, for quick lookup.
-  std::unordered_map<Block*, Chain*> block_to_chain;
-  block_to_chain.reserve(m_blocks.size());
+  BlockToChain block_to_chain(m_blocks.id_bound(), nullptr);
 
+  if (!m_cold_blocks.empty()) {
+    invert_branches_to_cold_blocks();
+  }
   build_chains(&chains, &block_to_chain);
-  const auto& result = wto_chains(block_to_chain);
+  m_order = wto_chains(block_to_chain);
+  if (!m_cold_blocks.empty()) {
+    move_cold_chains_to_end(block_to_chain);
+  }
 
-  always_assert_log(result.size() == m_blocks.size(),
-                    "result has %lu blocks, m_blocks has %lu", result.size(),
+  always_assert_log(m_order.size() == m_blocks.size(),
+                    "result has %lu blocks, m_blocks has %lu", m_order.size(),
                     m_blocks.size());
-  return result;
+  return m_order;
+}
+
+bool ControlFlowGraph::cached_order_is_valid() const {
+  if (m_order.size() != m_blocks.size()) {
+    return false;
+  }
+  // Instructions may have been edited since the order was computed. The only
+  // edit that breaks the order is one that puts a move-result at the start of
+  // a block that does not follow its predecessor anymore.
+  for (size_t i = 1; i < m_order.size(); ++i) {
+    Block* b = m_order[i];
+    if (b->starts_with_move_result()) {
+      auto goto_edge = get_succ_edge_of_type(m_order[i - 1], EDGE_GOTO);
+      if (goto_edge == nullptr || goto_edge->target() != b) {
+        return false;
+      }
+    }
+  }
+  return !m_order.empty() && !m_order.front()->starts_with_move_result();
 }
 
 void ControlFlowGraph::build_chains(
     std::vector<std::unique_ptr<Chain>>* chains,
-    std::unordered_map<Block*, Chain*>* block_to_chain) {
+    BlockToChain* block_to_chain) {
   for (const auto& entry : m_blocks) {
     Block* b = entry.second;
-    if (block_to_chain->count(b) != 0) {
+    if ((*block_to_chain)[b->id()] != nullptr) {
       continue;
     }
 
@@ -1438,7 +1468,7 @@ void ControlFlowGraph::build_chains(
     chains->push_back(std::move(unique));
 
     chain->push_back(b);
-    block_to_chain->emplace(b, chain);
+    (*block_to_chain)[b->id()] = chain;
 
     auto goto_edge = get_succ_edge_of_type(b, EDGE_GOTO);
     while (goto_edge != nullptr) {
@@ -1447,7 +1477,8 @@ void ControlFlowGraph::build_chains(
       always_assert_log(!DEBUG || m_blocks.count(goto_block->id()) > 0,
                         "bogus block reference %d -> %d in %s",
                         goto_edge->src()->id(), goto_block->id(), SHOW(*this));
-      if (goto_block->starts_with_move_result() || goto_block->same_try(b)) {
+      if (goto_block->starts_with_move_result() || goto_block->same_try(b) ||
+          (!m_cold_blocks.empty() && !is_cold(goto_block))) {
         // If the goto edge leads to a block with a move-result(-pseudo), then
         // that block must be placed immediately after this one because we can't
         // insert anything between an instruction and its move-result(-pseudo).
@@ -1456,11 +1487,14 @@ void ControlFlowGraph::build_chains(
         // instructions (by using fallthroughs) without adding another try
         // region. This is not required, but empirical evidence shows that it
         // generates smaller dex files.
-        const auto& pair = block_to_chain->emplace(goto_block, chain);
-        bool was_already_there = !pair.second;
-        if (was_already_there) {
+        //
+        // With a profile, the hot gotos are fallthroughs too, even across try
+        // regions.
+        auto& goto_chain = (*block_to_chain)[goto_block->id()];
+        if (goto_chain != nullptr) {
           break;
         }
+        goto_chain = chain;
         chain->push_back(goto_block);
         goto_edge = get_succ_edge_of_type(goto_block, EDGE_GOTO);
       } else {
@@ -1470,10 +1504,61 @@ void ControlFlowGraph::build_chains(
   }
 }
 
+void ControlFlowGraph::invert_branches_to_cold_blocks() {
+  if (!m_editable) {
+    return;
+  }
+  for (const auto& entry : m_blocks) {
+    Block* b = entry.second;
+    auto goto_edge = get_succ_edge_of_type(b, EDGE_GOTO);
+    auto branch_edge = get_succ_edge_of_type(b, EDGE_BRANCH);
+    if (goto_edge == nullptr || branch_edge == nullptr ||
+        !is_cold(goto_edge->target()) || is_cold(branch_edge->target())) {
+      continue;
+    }
+    auto branch_it = b->get_conditional_branch();
+    if (branch_it == b->end() ||
+        !is_conditional_branch(branch_it->insn->opcode())) {
+      continue;
+    }
+    // Swap the successors so that the hot one is the fallthrough.
+    IRInstruction* insn = branch_it->insn;
+    insn->set_opcode(opcode::invert_conditional_branch(insn->opcode()));
+    goto_edge->set_type(EDGE_BRANCH);
+    branch_edge->set_type(EDGE_GOTO);
+  }
+}
+
+void ControlFlowGraph::move_cold_chains_to_end(
+    const BlockToChain& block_to_chain) {
+  if (!m_editable) {
+    return;
+  }
+  // The chains follow each other in the order. Keep the entry chain, and the
+  // relative order within the hot and the cold chains.
+  const Chain* entry_chain = block_to_chain.at(entry_block()->id());
+  std::vector<Block*> hot;
+  std::vector<Block*> cold;
+  hot.reserve(m_order.size());
+  for (auto it = m_order.begin(); it != m_order.end();) {
+    const Chain* chain = block_to_chain.at((*it)->id());
+    bool chain_is_cold =
+        chain != entry_chain &&
+        std::all_of(chain->begin(), chain->end(),
+                    [this](const Block* b) { return is_cold(b); });
+    auto& out = chain_is_cold ? cold : hot;
+    out.insert(out.end(), it, it + chain->size());
+    it += chain->size();
+  }
+  hot.insert(hot.end(), cold.begin(), cold.end());
+  m_order = std::move(hot);
+}
+
 std::vector<Block*> ControlFlowGraph::wto_chains(
-    const std::unordered_map<Block*, Chain*>& block_to_chain) {
+    const BlockToChain& block_to_chain) {
   sparta::WeakTopologicalOrdering<Chain*> wto(
-      block_to_chain.at(entry_block()), [&block_to_chain](Chain* const& chain) {
+      block_to_chain.at(entry_block()->id()),
+      [&block_to_chain](Chain* const& chain) {
         // The chain successor function returns all the outgoing edges' target
         // chains. Where outgoing means that the edge does not go to this chain.
         //
@@ -1496,10 +1581,10 @@ std::vector<Block*> ControlFlowGraph::wto_chains(
             if (e->target() == next) {
               // The most common intra-chain edge is a GOTO to the very next
               // block. Let's cheaply detect this case and filter it early,
-              // before we have to do an expensive map lookup.
+              // before we have to look up its chain.
               continue;
             }
-            const auto& succ_chain = block_to_chain.at(e->target());
+            const auto& succ_chain = block_to_chain.at(e->target()->id());
             // Filter out any edges within this chain. We don't want to
             // erroneously create infinite loops in the chain graph that don't
             // exist in the block graph.
@@ -1770,10 +1855,41 @@ std::vector<Block*> ControlFlowGraph::blocks_reverse_post_deprecated() const {
 
 ControlFlowGraph::~ControlFlowGraph() { free_all_blocks_and_edges(); }
 
+std::shared_ptr<const ControlFlowGraph::BlockOrdering>
+ControlFlowGraph::weak_partial_ordering() const {
+  std::lock_guard<std::mutex> lock(m_orderings_mutex);
+  if (m_weak_partial_ordering == nullptr) {
+    m_weak_partial_ordering = sparta::make_weak_partial_ordering<
+        GraphInterface, std::hash<Block*>>(*this);
+  }
+  return m_weak_partial_ordering;
+}
+
+std::shared_ptr<const ControlFlowGraph::BlockOrdering>
+ControlFlowGraph::backwards_weak_partial_ordering() const {
+  std::lock_guard<std::mutex> lock(m_orderings_mutex);
+  if (m_backwards_weak_partial_ordering == nullptr) {
+    m_backwards_weak_partial_ordering = sparta::make_weak_partial_ordering<
+        sparta::BackwardsFixpointIterationAdaptor<GraphInterface>,
+        std::hash<Block*>>(*this);
+  }
+  return m_backwards_weak_partial_ordering;
+}
+
+std::shared_ptr<const ControlFlowGraph::Dominators>
+ControlFlowGraph::dominators() const {
+  std::lock_guard<std::mutex> lock(m_orderings_mutex);
+  if (m_dominators == nullptr) {
+    m_dominators = std::make_shared<const Dominators>(*this);
+  }
+  return m_dominators;
+}
+
 Block* ControlFlowGraph::create_block() {
   size_t id = next_block_id();
   Block* b = new Block(this, id);
   m_blocks.emplace(id, b);
+  m_order.clear();
   return b;
 }
 
@@ -1900,16 +2016,16 @@ void ControlFlowGraph::calculate_exit_block() {
       // Need to clear old exit block before recomputing the exit of a CFG
       // with multiple exit points
       remove_block(m_exit_block);
-      m_exit_block = nullptr;
+      set_exit_block(nullptr);
     }
   }
 
   ExitBlocks eb;
   eb.visit(entry_block());
   if (eb.exit_blocks.size() == 1) {
-    m_exit_block = eb.exit_blocks[0];
+    set_exit_block(eb.exit_blocks[0]);
   } else {
-    m_exit_block = create_block();
+    set_exit_block(create_block());
     for (Block* b : eb.exit_blocks) {
       add_edge(b, m_exit_block, EDGE_GHOST);
     }
@@ -1968,6 +2084,7 @@ void ControlFlowGraph::clear() {
 
   m_entry_block = nullptr;
   m_exit_block = nullptr;
+  invalidate_orderings();
 
   m_editable = true;
 }
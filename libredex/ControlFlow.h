@@ -10,12 +10,17 @@
 #include <boost/dynamic_bitset.hpp>
 #include <boost/optional/optional.hpp>
 #include <boost/range/sub_range.hpp>
+#include <iterator>
+#include <limits>
+#include <memory>
+#include <mutex>
 #include <type_traits>
 #include <unordered_set>
 #include <utility>
 #include <vector>
 
 #include "IRCode.h"
+#include "ObjectPool.h"
 
 /**
  * A Control Flow Graph is a directed graph of Basic Blocks.
@@ -59,6 +64,16 @@
  * TODO?: make MethodItemEntry's fields private?
  */
 
+namespace sparta {
+template <typename NodeId, typename NodeHash>
+class WeakPartialOrdering;
+} // namespace sparta
+
+namespace dominators {
+template <class GraphInterface>
+class SimpleFastDominators;
+} // namespace dominators
+
 namespace inliner {
 namespace impl {
 struct BlockAccessor;
@@ -83,6 +98,7 @@ enum EdgeType : uint8_t {
 class Block;
 class ControlFlowGraph;
 class CFGInliner;
+class GraphInterface;
 
 struct ThrowInfo {
   // nullptr means catch all
@@ -137,6 +153,8 @@ class Edge final {
         m_throw_info(new ThrowInfo(catch_type, index)),
         m_type(EDGE_THROW) {}
 
+  REDEX_POOLED_ALLOCATION(Edge)
+
   /*
    * Copy constructor.
    * Notice that this shallowly copies the block pointers!
@@ -229,6 +247,8 @@ class Block final {
   explicit Block(ControlFlowGraph* parent, BlockId id)
       : m_id(id), m_parent(parent) {}
 
+  REDEX_POOLED_ALLOCATION(Block)
+
   ~Block() { m_entries.clear_and_dispose(); }
   // This is different from the destructor. It also frees MethodItemEntry
   // payload that is not deleted on MIE deletion.
@@ -407,6 +427,167 @@ struct DominatorInfo {
   size_t postorder;
 };
 
+/*
+ * The blocks of a graph, indexed by their ids in a dense vector. Since ids are
+ * allocated in increasing order and rarely freed, there are few holes, and
+ * iterating over the blocks in the order of their ids only skips a few of
+ * them. Erasing a block leaves a hole, so iterators to other blocks remain
+ * valid. Iterators also remain valid when blocks are added, since they refer
+ * to blocks by their ids, and the end iterator does not move.
+ *
+ * This has the subset of the interface of std::map<BlockId, Block*> that is
+ * used by ControlFlowGraph. The elements cannot be modified in place.
+ */
+class BlockMap final {
+ public:
+  using value_type = std::pair<const BlockId, Block*>;
+
+  class iterator {
+   public:
+    using iterator_category = std::bidirectional_iterator_tag;
+    using value_type = BlockMap::value_type;
+    using difference_type = std::ptrdiff_t;
+    using reference = value_type;
+
+    struct pointer {
+      value_type value;
+      const value_type* operator->() const { return &value; }
+    };
+
+    iterator() = default;
+
+    value_type operator*() const {
+      return value_type(m_id, (*m_blocks)[m_id]);
+    }
+
+    pointer operator->() const { return pointer{**this}; }
+
+    iterator& operator++() {
+      do {
+        ++m_id;
+      } while (m_id < m_blocks->size() && (*m_blocks)[m_id] == nullptr);
+      if (m_id >= m_blocks->size()) {
+        m_id = END;
+      }
+      return *this;
+    }
+
+    iterator operator++(int) {
+      auto result = *this;
+      ++(*this);
+      return result;
+    }
+
+    iterator& operator--() {
+      if (m_id == END) {
+        m_id = m_blocks->size();
+      }
+      do {
+        --m_id;
+      } while ((*m_blocks)[m_id] == nullptr);
+      return *this;
+    }
+
+    iterator operator--(int) {
+      auto result = *this;
+      --(*this);
+      return result;
+    }
+
+    bool operator==(const iterator& that) const { return m_id == that.m_id; }
+
+    bool operator!=(const iterator& that) const { return m_id != that.m_id; }
+
+   private:
+    iterator(const std::vector<Block*>* blocks, BlockId id)
+        : m_blocks(blocks), m_id(id) {}
+
+    const std::vector<Block*>* m_blocks{nullptr};
+    BlockId m_id{0};
+
+    friend class BlockMap;
+  };
+
+  using const_iterator = iterator;
+
+  iterator begin() const {
+    if (m_blocks.empty()) {
+      return end();
+    }
+    iterator it(&m_blocks, 0);
+    if (m_blocks[0] == nullptr) {
+      ++it;
+    }
+    return it;
+  }
+
+  iterator end() const { return iterator(&m_blocks, END); }
+
+  size_t size() const { return m_size; }
+
+  bool empty() const { return m_size == 0; }
+
+  // One more than the largest id of the blocks.
+  BlockId id_bound() const { return m_blocks.size(); }
+
+  size_t count(BlockId id) const {
+    return id < m_blocks.size() && m_blocks[id] != nullptr ? 1 : 0;
+  }
+
+  iterator find(BlockId id) const {
+    return count(id) != 0 ? iterator(&m_blocks, id) : end();
+  }
+
+  Block* at(BlockId id) const {
+    always_assert_log(count(id) != 0, "Block %zu is not in the CFG", id);
+    return m_blocks[id];
+  }
+
+  std::pair<iterator, bool> emplace(BlockId id, Block* block) {
+    if (count(id) != 0) {
+      return std::make_pair(iterator(&m_blocks, id), false);
+    }
+    if (id >= m_blocks.size()) {
+      m_blocks.resize(id + 1, nullptr);
+    }
+    m_blocks[id] = block;
+    ++m_size;
+    return std::make_pair(iterator(&m_blocks, id), true);
+  }
+
+  size_t erase(BlockId id) {
+    if (count(id) == 0) {
+      return 0;
+    }
+    m_blocks[id] = nullptr;
+    --m_size;
+    // Keep id_bound() tight, as the next id is allocated from it.
+    while (!m_blocks.empty() && m_blocks.back() == nullptr) {
+      m_blocks.pop_back();
+    }
+    return 1;
+  }
+
+  iterator erase(iterator it) {
+    auto next = std::next(it);
+    erase(it.m_id);
+    return next;
+  }
+
+  void clear() {
+    m_blocks.clear();
+    m_size = 0;
+  }
+
+ private:
+  // The id of the end iterator.
+  static constexpr BlockId END = std::numeric_limits<BlockId>::max();
+
+  // Holes are null.
+  std::vector<Block*> m_blocks;
+  size_t m_size{0};
+};
+
 class ControlFlowGraph {
 
  public:
@@ -458,8 +639,14 @@ class ControlFlowGraph {
 
   Block* entry_block() const { return m_entry_block; }
   Block* exit_block() const { return m_exit_block; }
-  void set_entry_block(Block* b) { m_entry_block = b; }
-  void set_exit_block(Block* b) { m_exit_block = b; }
+  void set_entry_block(Block* b) {
+    m_entry_block = b;
+    invalidate_orderings();
+  }
+  void set_exit_block(Block* b) {
+    m_exit_block = b;
+    invalidate_orderings();
+  }
 
   /*
    * If there is a single method exit point, this returns a vector holding the
@@ -490,6 +677,7 @@ class ControlFlowGraph {
   }
 
   void add_edge(Edge* e) {
+    invalidate_orderings();
     m_edges.insert(e);
     e->src()->m_succs.emplace_back(e);
     e->target()->m_preds.emplace_back(e);
@@ -730,6 +918,27 @@ class ControlFlowGraph {
   // Do writes to this CFG propagate back to IR and Dex code?
   bool editable() const { return m_editable; }
 
+  using BlockOrdering = sparta::WeakPartialOrdering<Block*, std::hash<Block*>>;
+
+  /*
+   * The weak partial orderings of the blocks reachable from the entry block,
+   * and of the blocks that reach the exit block. They are computed on demand
+   * and shared by all the fixpoint iterators that run on this CFG, until its
+   * edges or its entry and exit blocks change.
+   */
+  std::shared_ptr<const BlockOrdering> weak_partial_ordering() const;
+  std::shared_ptr<const BlockOrdering> backwards_weak_partial_ordering() const;
+
+  using Dominators = dominators::SimpleFastDominators<GraphInterface>;
+
+  /*
+   * The dominator tree of the blocks reachable from the entry block. Like the
+   * orderings above, it is computed on demand and kept until the edges or the
+   * entry block change, so that passes that edit instructions in between
+   * dominator queries do not compute it again.
+   */
+  std::shared_ptr<const Dominators> dominators() const;
+
   size_t num_blocks() const { return m_blocks.size(); }
 
   /*
@@ -802,8 +1011,19 @@ class ControlFlowGraph {
   InstructionIterator find_insn(IRInstruction* insn, Block* hint = nullptr);
 
   // choose an order of blocks for output
+  //  * The order is cached until the next structural change of the graph, so
+  //    that calling this function again after editing instructions, or
+  //    before `linearize`, does not compute it again.
   std::vector<Block*> order();
 
+  // Mark blocks as cold, e.g. from a profile. `order` then prefers the other
+  // successor of a conditional branch as the fallthrough, and places the cold
+  // blocks after all the others. Only an editable CFG honors this.
+  void set_cold_blocks(std::unordered_set<BlockId> cold_blocks) {
+    m_cold_blocks = std::move(cold_blocks);
+    m_order.clear();
+  }
+
   /*
    * Find the first debug position preceding an instruction
    */
@@ -814,7 +1034,7 @@ class ControlFlowGraph {
       std::unordered_map<MethodItemEntry*, std::vector<Block*>>;
   using TryEnds = std::vector<std::pair<TryEntry*, Block*>>;
   using TryCatches = std::unordered_map<CatchEntry*, Block*>;
-  using Blocks = std::map<BlockId, Block*>;
+  using Blocks = BlockMap;
   friend class InstructionIteratorImpl<false>;
   friend class InstructionIteratorImpl<true>;
   friend class CFGInliner;
@@ -848,10 +1068,18 @@ class ControlFlowGraph {
 
   // helper functions
   using Chain = std::vector<Block*>;
+  // The chain of each block, indexed by block id.
+  using BlockToChain = std::vector<Chain*>;
   void build_chains(std::vector<std::unique_ptr<Chain>>* chains,
-                    std::unordered_map<Block*, Chain*>* block_to_chain);
-  std::vector<Block*> wto_chains(
-      const std::unordered_map<Block*, Chain*>& block_to_chain);
+                    BlockToChain* block_to_chain);
+  std::vector<Block*> wto_chains(const BlockToChain& block_to_chain);
+  bool is_cold(const Block* b) const { return m_cold_blocks.count(b->id()); }
+  // Helpers of `order` for the cold blocks.
+  void invert_branches_to_cold_blocks();
+  void move_cold_chains_to_end(const BlockToChain& block_to_chain);
+
+  // Whether the order computed by a previous call to `order` can be reused.
+  bool cached_order_is_valid() const;
 
   // Materialize target instructions and gotos corresponding to control-flow
   // edges. Used while turning back into a linear representation.
@@ -922,6 +1150,7 @@ class ControlFlowGraph {
                          Block* target,
                          EdgePredicate predicate,
                          bool cleanup = true) {
+    invalidate_orderings();
     auto& forward_edges = source->m_succs;
     EdgeSet to_remove;
     forward_edges.erase(
@@ -954,6 +1183,7 @@ class ControlFlowGraph {
   EdgeSet remove_pred_edge_if(Block* block,
                               EdgePredicate predicate,
                               bool cleanup = true) {
+    invalidate_orderings();
     auto& reverse_edges = block->m_preds;
 
     std::vector<Block*> source_blocks;
@@ -990,6 +1220,7 @@ class ControlFlowGraph {
   EdgeSet remove_succ_edge_if(Block* block,
                               EdgePredicate predicate,
                               bool cleanup = true) {
+    invalidate_orderings();
     auto& forward_edges = block->m_succs;
 
     std::vector<Block*> target_blocks;
@@ -1051,6 +1282,14 @@ class ControlFlowGraph {
 
   std::vector<Block*> blocks_post_helper(bool reverse) const;
 
+  // Called upon every structural change of the graph.
+  void invalidate_orderings() {
+    m_weak_partial_ordering.reset();
+    m_backwards_weak_partial_ordering.reset();
+    m_dominators.reset();
+    m_order.clear();
+  }
+
   // The memory of all blocks and edges in this graph are owned here
   Blocks m_blocks;
   EdgeSet m_edges;
@@ -1059,6 +1298,19 @@ class ControlFlowGraph {
   Block* m_exit_block{nullptr};
   reg_t m_registers_size{0};
   bool m_editable{true};
+
+  // Protects the lazily computed orderings, since analyses of the same CFG
+  // may run concurrently.
+  mutable std::mutex m_orderings_mutex;
+  mutable std::shared_ptr<const BlockOrdering> m_weak_partial_ordering;
+  mutable std::shared_ptr<const BlockOrdering>
+      m_backwards_weak_partial_ordering;
+  mutable std::shared_ptr<const Dominators> m_dominators;
+
+  // The output order of the blocks, or empty if it must be computed again.
+  std::vector<Block*> m_order;
+
+  std::unordered_set<BlockId> m_cold_blocks;
 };
 
 // A static-method-only API for use with the monotonic fixpoint iterator.
@@ -1082,6 +1334,14 @@ class GraphInterface {
   }
   static NodeId source(const Graph&, const EdgeId& e) { return e->src(); }
   static NodeId target(const Graph&, const EdgeId& e) { return e->target(); }
+  static std::shared_ptr<const ControlFlowGraph::BlockOrdering>
+  weak_partial_ordering(const Graph& graph) {
+    return graph.weak_partial_ordering();
+  }
+  static std::shared_ptr<const ControlFlowGraph::BlockOrdering>
+  backwards_weak_partial_ordering(const Graph& graph) {
+    return graph.backwards_weak_partial_ordering();
+  }
 };
 
 template <bool is_const>
@@ -40,6 +40,38 @@ int32_t DexString::java_hashcode() const {
   return java_hashcode_of_utf8_string(c_str());
 }
 
+size_t DexString::compute_content_hash(const std::string& str) {
+  return boost::hash_value(str);
+}
+
+uint64_t DexString::compute_sort_key(const std::string& str) {
+  // compare_dexstrings orders strings by their UTF-16 code units. We pack one
+  // byte per leading character, most significant byte first, mapping the end
+  // of the string to 0, an embedded NUL (encoded as 0xC0 0x80) to 1, an ASCII
+  // character c to c + 1 and everything else to 0xFF. The mapping preserves
+  // the order of code units. We stop after mapping the first non-ASCII
+  // character, as only its rough range is known; strings which agree up to
+  // there end up with equal keys and get compared in full.
+  if (str.empty()) {
+    return 0;
+  }
+  uint64_t key = 0;
+  size_t i = 0;
+  for (; i < sizeof(key) && i < str.size(); ++i) {
+    auto c = static_cast<uint8_t>(str[i]);
+    if (c < 0x80) {
+      key = (key << 8) | (c + 1);
+      continue;
+    }
+    bool is_nul = c == 0xC0 && i + 1 < str.size() &&
+                  static_cast<uint8_t>(str[i + 1]) == 0x80;
+    key = (key << 8) | (is_nul ? 1 : 0xFF);
+    ++i;
+    break;
+  }
+  return i == sizeof(key) ? key : key << (8 * (sizeof(key) - i));
+}
+
 int DexTypeList::encode(DexOutputIdx* dodx, uint32_t* output) const {
   uint16_t* typep = (uint16_t*)(output + 1);
   *output = (uint32_t)m_list.size();
@@ -64,6 +96,9 @@ DexField* DexFieldRef::make_concrete(DexAccessFlags access_flags,
 }
 
 DexFieldRef* DexField::get_field(const std::string& full_descriptor) {
+  if (auto field = g_redex->find_indexed_field(full_descriptor)) {
+    return field;
+  }
   auto fdt = dex_member_refs::parse_field(full_descriptor);
   auto cls = DexType::get_type(fdt.cls.c_str());
   auto name = DexString::get_string(fdt.name);
@@ -104,68 +139,62 @@ DexDebugEntry::~DexDebugEntry() {
 
 /*
  * Evaluate the debug opcodes to figure out their absolute addresses and line
- * numbers.
+ * numbers. The opcodes that only advance the address or the line are applied
+ * as they are read, so that only the entries that are kept are allocated.
  */
-static std::vector<DexDebugEntry> eval_debug_instructions(
-    DexDebugItem* dbg,
-    std::vector<std::unique_ptr<DexDebugInstruction>>& insns,
-    uint32_t absolute_line) {
-  std::vector<DexDebugEntry> entries;
+DexDebugItem::DexDebugItem(DexIdx* idx, uint32_t offset)
+    : m_source_checksum(idx->get_checksum()), m_source_offset(offset) {
+  const uint8_t* encdata = idx->get_uleb_data(offset);
+  const uint8_t* base_encdata = encdata;
+  uint32_t absolute_line = read_uleb128(&encdata);
+  uint32_t paramcount = read_uleb128(&encdata);
+  while (paramcount--) {
+    // We intentionally drop the parameter string name here because we don't
+    // have a convenient representation of it, and our internal tooling doesn't
+    // use this info anyway.
+    // We emit matching number of nulls as method arguments at the end.
+    decode_noindexable_string(idx, encdata);
+  }
   uint32_t pc = 0;
-  for (auto& opcode : insns) {
-    auto op = opcode->opcode();
+  while (*encdata != DBG_END_SEQUENCE) {
+    uint8_t op = *encdata;
     switch (op) {
     case DBG_ADVANCE_LINE: {
-      absolute_line += opcode->value();
-      continue;
+      ++encdata;
+      absolute_line += read_sleb128(&encdata);
+      break;
+    }
+    case DBG_ADVANCE_PC: {
+      ++encdata;
+      pc += read_uleb128(&encdata);
+      break;
     }
     case DBG_END_LOCAL:
     case DBG_RESTART_LOCAL:
     case DBG_START_LOCAL:
     case DBG_START_LOCAL_EXTENDED:
     case DBG_SET_FILE:
-    case DBG_END_SEQUENCE:
     case DBG_SET_PROLOGUE_END:
     case DBG_SET_EPILOGUE_BEGIN: {
-      entries.emplace_back(pc, std::move(opcode));
+      m_dbg_entries.emplace_back(
+          pc,
+          std::unique_ptr<DexDebugInstruction>(
+              DexDebugInstruction::make_instruction(idx, &encdata)));
       break;
     }
-    case DBG_ADVANCE_PC: {
-      pc += opcode->uvalue();
-      continue;
-    }
     default: {
+      ++encdata;
       uint8_t adjustment = op - DBG_FIRST_SPECIAL;
       absolute_line += DBG_LINE_BASE + (adjustment % DBG_LINE_RANGE);
       pc += adjustment / DBG_LINE_RANGE;
-      entries.emplace_back(pc, std::make_unique<DexPosition>(absolute_line));
+      m_dbg_entries.emplace_back(pc,
+                                 std::make_unique<DexPosition>(absolute_line));
       break;
     }
     }
   }
-  return entries;
-}
-
-DexDebugItem::DexDebugItem(DexIdx* idx, uint32_t offset)
-    : m_source_checksum(idx->get_checksum()), m_source_offset(offset) {
-  const uint8_t* encdata = idx->get_uleb_data(offset);
-  const uint8_t* base_encdata = encdata;
-  uint32_t line_start = read_uleb128(&encdata);
-  uint32_t paramcount = read_uleb128(&encdata);
-  while (paramcount--) {
-    // We intentionally drop the parameter string name here because we don't
-    // have a convenient representation of it, and our internal tooling doesn't
-    // use this info anyway.
-    // We emit matching number of nulls as method arguments at the end.
-    decode_noindexable_string(idx, encdata);
-  }
-  std::vector<std::unique_ptr<DexDebugInstruction>> insns;
-  DexDebugInstruction* dbgp;
-  while ((dbgp = DexDebugInstruction::make_instruction(idx, &encdata)) !=
-         nullptr) {
-    insns.emplace_back(dbgp);
-  }
-  m_dbg_entries = eval_debug_instructions(this, insns, line_start);
+  // Skip the DBG_END_SEQUENCE.
+  ++encdata;
   m_on_disk_size = encdata - base_encdata;
 }
 
@@ -358,6 +387,7 @@ std::unique_ptr<DexCode> DexCode::get_dex_code(DexIdx* idx, uint32_t offset) {
   uint32_t tries = code->tries_size;
   if (code->insns_size) {
     const uint16_t* end = cdata + code->insns_size;
+    dc->m_insns->reserve(DexInstruction::count_instructions(cdata, end));
     while (cdata < end) {
       DexInstruction* dop = DexInstruction::make_instruction(idx, &cdata);
       always_assert_log(dop != nullptr,
@@ -465,6 +495,20 @@ int DexCode::encode(DexOutputIdx* dodx, uint32_t* output) {
   return (int)(hemit - ((uint8_t*)output));
 }
 
+size_t DexCode::encode_size_bound() const {
+  size_t bound = sizeof(dex_code_item) + size() * sizeof(uint16_t);
+  if (m_tries.empty()) {
+    return bound;
+  }
+  // The padding, the tries, and the handler list, where every uleb128 and
+  // sleb128 takes up at most 5 bytes.
+  bound += sizeof(uint16_t) + m_tries.size() * sizeof(dex_tries_item) + 5;
+  for (auto& dextry : m_tries) {
+    bound += 5 + dextry->m_catches.size() * 10;
+  }
+  return bound;
+}
+
 DexMethod::DexMethod(DexType* type, DexString* name, DexProto* proto)
     : DexMethodRef(type, name, proto) {
   m_virtual = false;
@@ -569,6 +613,9 @@ DexMethod* DexMethod::make_method_from(DexMethod* that,
 
 template <bool kCheckFormat>
 DexMethodRef* DexMethod::get_method(const std::string& full_descriptor) {
+  if (auto method = g_redex->find_indexed_method(full_descriptor)) {
+    return method;
+  }
   auto mdt = dex_member_refs::parse_method<kCheckFormat>(full_descriptor);
   auto cls = DexType::get_type(mdt.cls.c_str());
   auto name = DexString::get_string(mdt.name);
@@ -1060,7 +1107,8 @@ DexClass::DexClass(DexIdx* idx,
       m_location(location),
       m_access_flags((DexAccessFlags)cdef->access_flags),
       m_external(false),
-      m_perf_sensitive(false) {}
+      m_perf_sensitive(false),
+      m_id(g_redex->next_class_id()) {}
 
 void DexTypeList::gather_types(std::vector<DexType*>& ltype) const {
   for (auto const& type : m_list) {
@@ -1416,14 +1464,45 @@ void gather_components(std::vector<DexString*>& lstring,
                        std::vector<DexMethodHandle*>& lmethodhandle,
                        const DexClasses& classes,
                        bool exclude_loads) {
-  // Gather references reachable from each class.
-  for (auto const& cls : classes) {
-    cls->gather_strings(lstring, exclude_loads);
-    cls->gather_types(ltype);
-    cls->gather_fields(lfield);
-    cls->gather_methods(lmethod);
-    cls->gather_callsites(lcallsite);
-    cls->gather_methodhandles(lmethodhandle);
+  // Gather references reachable from each class. Each worker collects into
+  // its own vectors; as everything gets sorted and uniqued below, the order in
+  // which the per-worker results are concatenated doesn't matter.
+  struct Components {
+    std::vector<DexString*> lstring;
+    std::vector<DexType*> ltype;
+    std::vector<DexFieldRef*> lfield;
+    std::vector<DexMethodRef*> lmethod;
+    std::vector<DexCallSite*> lcallsite;
+    std::vector<DexMethodHandle*> lmethodhandle;
+  };
+  size_t num_threads = redex_parallel::default_num_threads();
+  std::vector<CacheAligned<Components>> components(num_threads);
+  auto wq = workqueue_foreach<DexClass*>(
+      [&](sparta::SpartaWorkerState<DexClass*>* state, DexClass* cls) {
+        Components& c = components[state->worker_id()];
+        cls->gather_strings(c.lstring, exclude_loads);
+        cls->gather_types(c.ltype);
+        cls->gather_fields(c.lfield);
+        cls->gather_methods(c.lmethod);
+        cls->gather_callsites(c.lcallsite);
+        cls->gather_methodhandles(c.lmethodhandle);
+      },
+      num_threads);
+  for (auto* cls : classes) {
+    wq.add_item(cls);
+  }
+  wq.run_all();
+
+  auto append = [](auto& to, const auto& from) {
+    to.insert(to.end(), from.begin(), from.end());
+  };
+  for (Components& c : components) {
+    append(lstring, c.lstring);
+    append(ltype, c.ltype);
+    append(lfield, c.lfield);
+    append(lmethod, c.lmethod);
+    append(lcallsite, c.lcallsite);
+    append(lmethodhandle, c.lmethodhandle);
   }
 
   // Remove duplicates to speed up the later loops.
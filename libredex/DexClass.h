@@ -30,6 +30,7 @@
 #include "RedexContext.h"
 #include "ReferencedState.h"
 #include "Show.h"
+#include "StrcmpLess.h"
 #include "Trace.h"
 #include "Util.h"
 
@@ -61,19 +62,23 @@ class DexType;
 
 using Scope = std::vector<DexClass*>;
 
-#if defined(__SSE4_2__) && defined(__linux__) && defined(__STRCMP_LESS__)
-extern "C" bool strcmp_less(const char* str1, const char* str2);
-#endif
-
 class DexString {
   friend struct RedexContext;
 
   std::string m_storage;
   uint32_t m_utfsize;
+  size_t m_content_hash;
+  uint64_t m_sort_key;
+
+  static size_t compute_content_hash(const std::string& str);
+  static uint64_t compute_sort_key(const std::string& str);
 
   // See UNIQUENESS above for the rationale for the private constructor pattern.
   DexString(std::string nstr, uint32_t utfsize)
-      : m_storage(std::move(nstr)), m_utfsize(utfsize) {}
+      : m_storage(std::move(nstr)),
+        m_utfsize(utfsize),
+        m_content_hash(compute_content_hash(m_storage)),
+        m_sort_key(compute_sort_key(m_storage)) {}
 
  public:
   uint32_t size() const { return static_cast<uint32_t>(m_storage.size()); }
@@ -83,6 +88,15 @@ class DexString {
 
   int32_t java_hashcode() const;
 
+  // Equal to boost::hash_value(str()), computed once at creation, as strings
+  // are immutable. Unlike the string's address, this is stable across runs.
+  size_t content_hash() const { return m_content_hash; }
+
+  // A summary of the first few characters of the string, such that whenever
+  // two strings have different sort keys, comparing the keys gives the same
+  // answer as compare_dexstrings. Equal keys say nothing.
+  uint64_t sort_key() const { return m_sort_key; }
+
   // DexString retrieval/creation
 
   // If the DexString exists, return it, otherwise create it and return it.
@@ -138,12 +152,11 @@ inline bool compare_dexstrings(const DexString* a, const DexString* b) {
   } else if (b == nullptr) {
     return false;
   }
+  if (a->sort_key() != b->sort_key()) {
+    return a->sort_key() < b->sort_key();
+  }
   if (a->is_simple() && b->is_simple())
-#if defined(__SSE4_2__) && defined(__linux__) && defined(__STRCMP_LESS__)
     return strcmp_less(a->c_str(), b->c_str());
-#else
-    return (strcmp(a->c_str(), b->c_str()) < 0);
-#endif
   /*
    * Bother, need to do code-point character-by-character
    * comparison.
@@ -273,9 +286,11 @@ class DexFieldRef {
   DexFieldSpec m_spec;
   bool m_concrete;
   bool m_external;
+  uint32_t m_id;
 
   ~DexFieldRef() {}
-  DexFieldRef(DexType* container, DexString* name, DexType* type) {
+  DexFieldRef(DexType* container, DexString* name, DexType* type)
+      : m_id(g_redex->next_field_id()) {
     m_spec.cls = container;
     m_spec.name = name;
     m_spec.type = type;
@@ -290,6 +305,10 @@ class DexFieldRef {
   const DexField* as_def() const;
   DexField* as_def();
 
+  // Unique among the fields of this RedexContext, and dense, so it can index
+  // into a bit vector sized by RedexContext::num_field_ids().
+  uint32_t id() const { return m_id; }
+
   DexType* get_class() const { return m_spec.cls; }
   DexString* get_name() const { return m_spec.name; }
   const char* c_str() const { return get_name()->c_str(); }
@@ -784,6 +803,12 @@ class DexCode {
    */
   int encode(DexOutputIdx* dodx, uint32_t* output);
 
+  /*
+   * Returns an upper bound of the number of bytes that encode() writes, to
+   * size scratch buffers for encoding ahead of time.
+   */
+  size_t encode_size_bound() const;
+
   /*
    * Returns the number of 2-byte code units needed to encode all the
    * instructions.
@@ -816,10 +841,11 @@ class DexMethodRef {
   DexMethodSpec m_spec;
   bool m_concrete;
   bool m_external;
+  uint32_t m_id;
 
   ~DexMethodRef() {}
   DexMethodRef(DexType* type, DexString* name, DexProto* proto)
-      : m_spec(type, name, proto) {
+      : m_spec(type, name, proto), m_id(g_redex->next_method_id()) {
     m_concrete = false;
     m_external = false;
   }
@@ -831,6 +857,10 @@ class DexMethodRef {
   const DexMethod* as_def() const;
   DexMethod* as_def();
 
+  // Unique among the methods of this RedexContext, and dense, so it can index
+  // into a bit vector sized by RedexContext::num_method_ids().
+  uint32_t id() const { return m_id; }
+
   DexType* get_class() const { return m_spec.cls; }
   DexString* get_name() const { return m_spec.name; }
   const char* c_str() const { return get_name()->c_str(); }
@@ -1121,8 +1151,10 @@ class DexClass {
   DexAccessFlags m_access_flags;
   bool m_external;
   bool m_perf_sensitive;
+  uint32_t m_id;
 
-  explicit DexClass(const std::string& location) : m_location(location){};
+  explicit DexClass(const std::string& location)
+      : m_location(location), m_id(g_redex->next_class_id()){};
   void load_class_annotations(DexIdx* idx, uint32_t anno_off);
   void load_class_data_item(DexIdx* idx,
                             uint32_t cdi_off,
@@ -1231,6 +1263,10 @@ class DexClass {
   // Returns the location of this class - can be dex/jar file.
   const std::string& get_location() const { return m_location; }
 
+  // Unique among the classes of this RedexContext, and dense, so it can index
+  // into a bit vector sized by RedexContext::num_class_ids().
+  uint32_t id() const { return m_id; }
+
   void set_access(DexAccessFlags access) {
     always_assert_log(!m_external, "Unexpected external class %s\n",
                       SHOW(m_self));
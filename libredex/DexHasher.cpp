@@ -24,6 +24,45 @@ std::string hash_to_string(size_t hash) {
   return result.str();
 }
 
+size_t hash_method(const DexMethod* method) {
+  DexClassHasher hasher(type_class(method->get_class()));
+  hasher.hash(method);
+  // The code is hashed separately from the rest of the method.
+  boost::hash_combine(hasher.m_hash, hasher.m_code_hash);
+  return hasher.m_hash;
+}
+
+size_t hash_code_structure(const IRCode* code) {
+  DexClassHasher hasher(nullptr);
+  for (const MethodItemEntry& mie : *code) {
+    if (mie.type == MFLOW_DEBUG || mie.type == MFLOW_POSITION) {
+      continue;
+    }
+    hasher.hash((uint8_t)mie.type);
+    switch (mie.type) {
+    case MFLOW_OPCODE:
+      hasher.hash(mie.insn);
+      break;
+    case MFLOW_TRY:
+      hasher.hash((uint8_t)mie.tentry->type);
+      break;
+    case MFLOW_CATCH:
+      if (mie.centry->catch_type) hasher.hash(mie.centry->catch_type);
+      break;
+    case MFLOW_TARGET:
+      hasher.hash((uint8_t)mie.target->type);
+      if (mie.target->type == BRANCH_MULTI) {
+        hasher.hash(mie.target->case_key);
+      }
+      break;
+    default:
+      break;
+    }
+  }
+  boost::hash_combine(hasher.m_hash, hasher.m_registers_hash);
+  return hasher.m_hash;
+}
+
 DexHash DexScopeHasher::run() {
   std::unordered_map<DexClass*, size_t> class_indices;
   walk::classes(m_scope, [&](DexClass* cls) {
@@ -51,7 +90,12 @@ void DexClassHasher::hash(const std::string& str) {
   boost::hash_combine(m_hash, str);
 }
 
-void DexClassHasher::hash(const DexString* s) { hash(s->str()); }
+void DexClassHasher::hash(const DexString* s) {
+  TRACE(HASHER, 4, "[hasher] %s", s->c_str());
+  // Same as hashing the string contents, but without walking its characters
+  // over and over again for commonly referenced strings such as type names.
+  boost::hash_combine(m_hash, s->content_hash());
+}
 
 void DexClassHasher::hash(bool value) {
   TRACE(HASHER, 4, "[hasher] %u", value);
@@ -29,6 +29,19 @@ namespace hashing {
 
 std::string hash_to_string(size_t hash);
 
+/*
+ * Hashes the signature, attributes and code of a method. The hash only
+ * depends on the contents of the method, so it is stable across builds.
+ */
+size_t hash_method(const DexMethod* method);
+
+/*
+ * Hashes code the way IRCode::structural_equals compares it: the debug and
+ * position entries and the number of registers are ignored, so structurally
+ * equal code has the same hash.
+ */
+size_t hash_code_structure(const IRCode* code);
+
 struct DexHash {
   size_t registers_hash;
   size_t code_hash;
@@ -50,6 +63,9 @@ class DexClassHasher final {
   DexHash run();
 
  private:
+  friend size_t hash_method(const DexMethod* method);
+  friend size_t hash_code_structure(const IRCode* code);
+
   void hash(const std::string& str);
   void hash(int value);
   void hash(uint64_t value);
@@ -12,6 +12,7 @@
 #include "DexCallSite.h"
 #include "DexClass.h"
 #include "DexMethodHandle.h"
+#include "WorkQueue.h"
 
 #define INIT_DMAP_ID(TYPE, CACHETYPE)                                  \
   always_assert_log(dh->TYPE##_ids_off < dh->file_size,                \
@@ -67,6 +68,25 @@ DexIdx::~DexIdx() {
   }
 }
 
+void DexIdx::intern_all_strings() {
+  // The string map of the RedexContext is sharded by hash already, so the
+  // workers mostly interns into different shards at the same time. Chunks
+  // make sure that two workers don't write to the same line of the cache.
+  constexpr uint32_t CHUNK_SIZE = 1024;
+  auto wq = workqueue_foreach<uint32_t>([this](uint32_t begin) {
+    auto end = std::min(begin + CHUNK_SIZE, m_string_ids_size);
+    for (auto stridx = begin; stridx < end; ++stridx) {
+      if (m_string_cache[stridx] == nullptr) {
+        m_string_cache[stridx] = get_stringidx_fromdex(stridx);
+      }
+    }
+  });
+  for (uint32_t begin = 0; begin < m_string_ids_size; begin += CHUNK_SIZE) {
+    wq.add_item(begin);
+  }
+  wq.run_all();
+}
+
 DexCallSite* DexIdx::get_callsiteidx_fromdex(uint32_t csidx) {
   redex_assert(csidx < m_callsite_ids_size);
   // callsites are indirected through the callsite_id table, because
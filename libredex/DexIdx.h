@@ -63,6 +63,12 @@ class DexIdx {
   explicit DexIdx(const dex_header* dh);
   ~DexIdx();
 
+  /*
+   * Decodes and interns all the strings of the dex up front, in parallel, so
+   * that get_stringidx only reads the cache afterwards.
+   */
+  void intern_all_strings();
+
   DexString* get_stringidx(uint32_t stridx) {
     if (m_string_cache[stridx] == nullptr) {
       m_string_cache[stridx] = get_stringidx_fromdex(stridx);
@@ -773,6 +773,87 @@ void DexInstruction::encode(DexOutputIdx* /* unused */,
 
 uint16_t DexInstruction::size() const { return m_count + 1; }
 
+namespace {
+
+// The first digit of the name of a format is the number of code units that
+// its instructions take.
+constexpr uint8_t format_code_units(OpcodeFormat fmt) {
+  // clang-format off
+  switch (fmt) {
+  case FMT_f00x: return 0;
+  case FMT_f10x: case FMT_f12x: case FMT_f12x_2: case FMT_f11n:
+  case FMT_f11x_d: case FMT_f11x_s: case FMT_f10t:
+    return 1;
+  case FMT_f20t: case FMT_f20bc: case FMT_f22x: case FMT_f21t: case FMT_f21s:
+  case FMT_f21h: case FMT_f21c_d: case FMT_f21c_s: case FMT_f23x_d:
+  case FMT_f23x_s: case FMT_f22b: case FMT_f22t: case FMT_f22s:
+  case FMT_f22c_d: case FMT_f22c_s: case FMT_f22cs:
+    return 2;
+  case FMT_f30t: case FMT_f32x: case FMT_f31i: case FMT_f31t: case FMT_f31c:
+  case FMT_f35c: case FMT_f35ms: case FMT_f35mi: case FMT_f3rc:
+  case FMT_f3rms: case FMT_f3rmi:
+    return 3;
+  case FMT_f41c_d: case FMT_f41c_s: case FMT_f45cc: case FMT_f4rcc:
+    return 4;
+  case FMT_f51l: case FMT_f52c_d: case FMT_f52c_s: case FMT_f5rc:
+  case FMT_f57c:
+    return 5;
+  case FMT_fopcode: case FMT_iopcode:
+    return 0;
+  }
+  // clang-format on
+  return 0;
+}
+
+struct CodeUnitsTable {
+  uint8_t units[256];
+};
+
+// The number of code units of the instructions of each (non-quick) opcode,
+// 0 for the unused ones.
+constexpr CodeUnitsTable make_code_units_table() {
+  CodeUnitsTable table{};
+#define OP(op, code, fmt, ...) table.units[code] = format_code_units(FMT_##fmt);
+  DOPS
+#undef OP
+  return table;
+}
+
+constexpr CodeUnitsTable s_code_units = make_code_units_table();
+
+} // namespace
+
+uint32_t DexInstruction::code_units(const uint16_t* insns) {
+  // The payloads are encoded as nops, and their size depends on their data.
+  switch (*insns) {
+  case FOPCODE_PACKED_SWITCH:
+    return insns[1] * 2 + 4;
+  case FOPCODE_SPARSE_SWITCH:
+    return insns[1] * 4 + 2;
+  case FOPCODE_FILLED_ARRAY: {
+    uint16_t ewidth = insns[1];
+    uint32_t size = *((const uint32_t*)(insns + 2));
+    return (ewidth * size + 1) / 2 + 4;
+  }
+  default:
+    return s_code_units.units[*insns & 0xff];
+  }
+}
+
+size_t DexInstruction::count_instructions(const uint16_t* insns,
+                                          const uint16_t* end) {
+  size_t count = 0;
+  while (insns < end) {
+    auto units = code_units(insns);
+    if (units == 0) {
+      break;
+    }
+    insns += units;
+    ++count;
+  }
+  return count;
+}
+
 DexInstruction* DexInstruction::make_instruction(DexIdx* idx,
                                                  const uint16_t** insns_ptr) {
   auto& insns = *insns_ptr;
@@ -85,6 +85,18 @@ class DexInstruction : public Gatherable {
  public:
   static DexInstruction* make_instruction(DexIdx* idx,
                                           const uint16_t** insns_ptr);
+  /*
+   * The number of code units of the encoded instruction or payload at
+   * `insns`, or 0 if its opcode is unknown. Unlike make_instruction, this
+   * neither allocates nor resolves any reference.
+   */
+  static uint32_t code_units(const uint16_t* insns);
+  /*
+   * The number of instructions encoded in [insns, end), counting each
+   * payload as one. Stops at the first unknown opcode.
+   */
+  static size_t count_instructions(const uint16_t* insns,
+                                   const uint16_t* end);
   /* Creates the right subclass of DexInstruction for the given opcode */
   static DexInstruction* make_instruction(DexOpcode);
   virtual void encode(DexOutputIdx* dodx, uint16_t*& insns) const;
@@ -14,6 +14,7 @@
 #include "Trace.h"
 #include "Walkers.h"
 #include "WorkQueue.h"
+#include "ZipReader.h"
 
 #include <exception>
 #include <stdexcept>
@@ -82,77 +83,26 @@ void DexLoader::gather_input_stats(dex_stats_t* stats, const dex_header* dh) {
   stats->num_callsites += 0;
   stats->num_methodhandles += 0;
 
+  // Merge what the workers gathered while loading the classes.
   std::unordered_set<DexEncodedValueArray, boost::hash<DexEncodedValueArray>>
       enc_arrays;
   std::set<DexTypeList*, dextypelists_comparator> type_lists;
   std::unordered_set<uint32_t> anno_offsets;
-
-  for (uint32_t cidx = 0; cidx < dh->class_defs_size; ++cidx) {
-    auto* clz = m_classes->at(cidx);
-    if (clz == nullptr) {
-      // Skip nulls, they may have been introduced by benign duplicate classes
-      continue;
-    }
-    auto* class_def = &m_class_defs[cidx];
-    auto anno_off = class_def->annotations_off;
-    if (anno_off) {
-      const dex_annotations_directory_item* anno_dir =
-          (const dex_annotations_directory_item*)m_idx->get_uint_data(anno_off);
-      auto class_anno_off = anno_dir->class_annotations_off;
-      if (class_anno_off) {
-        const uint32_t* anno_data = m_idx->get_uint_data(class_anno_off);
-        uint32_t count = *anno_data++;
-        for (uint32_t aidx = 0; aidx < count; ++aidx) {
-          anno_offsets.insert(anno_data[aidx]);
-        }
-      }
-      const uint32_t* anno_data = (uint32_t*)(anno_dir + 1);
-      for (uint32_t fidx = 0; fidx < anno_dir->fields_size; ++fidx) {
-        anno_data++;
-        anno_offsets.insert(*anno_data++);
-      }
-      for (uint32_t midx = 0; midx < anno_dir->methods_size; ++midx) {
-        anno_data++;
-        anno_offsets.insert(*anno_data++);
-      }
-      for (uint32_t pidx = 0; pidx < anno_dir->parameters_size; ++pidx) {
-        anno_data++;
-        uint32_t xrefoff = *anno_data++;
-        if (xrefoff != 0) {
-          const uint32_t* annoxref = m_idx->get_uint_data(xrefoff);
-          uint32_t count = *annoxref++;
-          for (uint32_t j = 0; j < count; j++) {
-            uint32_t off = annoxref[j];
-            anno_offsets.insert(off);
-          }
-        }
-      }
-    }
-    auto* interfaces_type_list = clz->get_interfaces();
-    type_lists.insert(interfaces_type_list);
-    std::unique_ptr<DexEncodedValueArray> deva(clz->get_static_values());
-    if (deva) {
-      if (!enc_arrays.count(*deva)) {
-        enc_arrays.emplace(std::move(*deva));
-        stats->num_static_values++;
-      }
-    }
-    stats->num_fields += clz->get_ifields().size() + clz->get_sfields().size();
-    stats->num_methods +=
-        clz->get_vmethods().size() + clz->get_dmethods().size();
-    for (auto* meth : clz->get_vmethods()) {
-      DexCode* code = meth->get_dex_code();
-      if (code) {
-        stats->num_instructions += code->get_instructions().size();
-      }
-    }
-    for (auto* meth : clz->get_dmethods()) {
-      DexCode* code = meth->get_dex_code();
-      if (code) {
-        stats->num_instructions += code->get_instructions().size();
-      }
+  for (auto& class_stats : m_class_stats) {
+    for (auto& deva : class_stats.static_values) {
+      enc_arrays.emplace(std::move(*deva));
     }
+    type_lists.insert(class_stats.type_lists.begin(),
+                      class_stats.type_lists.end());
+    anno_offsets.insert(class_stats.anno_offsets.begin(),
+                        class_stats.anno_offsets.end());
+    stats->num_fields += class_stats.num_fields;
+    stats->num_methods += class_stats.num_methods;
   }
+  m_class_stats.clear();
+  stats->num_static_values += enc_arrays.size();
+  // Counted while loading, as the DexCode may already have been ballooned.
+  stats->num_instructions += m_num_instructions.load();
   for (uint32_t meth_idx = 0; meth_idx < dh->method_ids_size; ++meth_idx) {
     auto* meth = m_idx->get_methodidx(meth_idx);
     DexProto* proto = meth->get_proto();
@@ -167,7 +117,7 @@ void DexLoader::gather_input_stats(dex_stats_t* stats, const dex_header* dh) {
   }
 
   const dex_map_list* map_list =
-      reinterpret_cast<const dex_map_list*>(m_file->const_data() + dh->map_off);
+      reinterpret_cast<const dex_map_list*>((const char*)dh + dh->map_off);
   bool header_seen = false;
   uint32_t header_index = 0;
   for (uint32_t i = 0; i < map_list->size; i++) {
@@ -452,7 +402,57 @@ void DexLoader::gather_input_stats(dex_stats_t* stats, const dex_header* dh) {
   }
 }
 
-void DexLoader::load_dex_class(int num) {
+void DexLoader::gather_class_stats(int num,
+                                   DexClass* cls,
+                                   ClassStats* class_stats) {
+  auto* class_def = &m_class_defs[num];
+  auto anno_off = class_def->annotations_off;
+  auto& anno_offsets = class_stats->anno_offsets;
+  if (anno_off) {
+    const dex_annotations_directory_item* anno_dir =
+        (const dex_annotations_directory_item*)m_idx->get_uint_data(anno_off);
+    auto class_anno_off = anno_dir->class_annotations_off;
+    if (class_anno_off) {
+      const uint32_t* anno_data = m_idx->get_uint_data(class_anno_off);
+      uint32_t count = *anno_data++;
+      for (uint32_t aidx = 0; aidx < count; ++aidx) {
+        anno_offsets.insert(anno_data[aidx]);
+      }
+    }
+    const uint32_t* anno_data = (uint32_t*)(anno_dir + 1);
+    for (uint32_t fidx = 0; fidx < anno_dir->fields_size; ++fidx) {
+      anno_data++;
+      anno_offsets.insert(*anno_data++);
+    }
+    for (uint32_t midx = 0; midx < anno_dir->methods_size; ++midx) {
+      anno_data++;
+      anno_offsets.insert(*anno_data++);
+    }
+    for (uint32_t pidx = 0; pidx < anno_dir->parameters_size; ++pidx) {
+      anno_data++;
+      uint32_t xrefoff = *anno_data++;
+      if (xrefoff != 0) {
+        const uint32_t* annoxref = m_idx->get_uint_data(xrefoff);
+        uint32_t count = *annoxref++;
+        for (uint32_t j = 0; j < count; j++) {
+          uint32_t off = annoxref[j];
+          anno_offsets.insert(off);
+        }
+      }
+    }
+  }
+  class_stats->type_lists.insert(cls->get_interfaces());
+  std::unique_ptr<DexEncodedValueArray> deva(cls->get_static_values());
+  if (deva) {
+    class_stats->static_values.push_back(std::move(deva));
+  }
+  class_stats->num_fields +=
+      cls->get_ifields().size() + cls->get_sfields().size();
+  class_stats->num_methods +=
+      cls->get_vmethods().size() + cls->get_dmethods().size();
+}
+
+void DexLoader::load_dex_class(int num, ClassStats* class_stats) {
   const dex_class_def* cdef = m_class_defs + num;
   DexClass* dc = DexClass::create(m_idx.get(), cdef, m_dex_location);
   // We may be inserting a nullptr here. Need to remove them later
@@ -460,6 +460,29 @@ void DexLoader::load_dex_class(int num) {
   // We're inserting nullptr because we can't mess up the indices of the other
   // classes in the vector. This vector is used via random access.
   m_classes->at(num) = dc;
+  if (dc == nullptr) {
+    return;
+  }
+  if (class_stats != nullptr) {
+    gather_class_stats(num, dc, class_stats);
+  }
+  size_t num_instructions = 0;
+  auto process_method = [&](DexMethod* method) {
+    DexCode* code = method->get_dex_code();
+    if (code) {
+      num_instructions += code->get_instructions().size();
+      if (m_balloon) {
+        method->balloon();
+      }
+    }
+  };
+  for (auto* meth : dc->get_dmethods()) {
+    process_method(meth);
+  }
+  for (auto* meth : dc->get_vmethods()) {
+    process_method(meth);
+  }
+  m_num_instructions += num_instructions;
 }
 
 const dex_header* DexLoader::get_dex_header(const char* location) {
@@ -473,17 +496,25 @@ const dex_header* DexLoader::get_dex_header(const char* location) {
 
 DexClasses DexLoader::load_dex(const char* location,
                                dex_stats_t* stats,
-                               int support_dex_version) {
+                               int support_dex_version,
+                               bool balloon) {
   const dex_header* dh = get_dex_header(location);
   validate_dex_header(dh, m_file->size(), support_dex_version);
-  return load_dex(dh, stats);
+  return load_dex(dh, stats, balloon);
 }
 
-DexClasses DexLoader::load_dex(const dex_header* dh, dex_stats_t* stats) {
+DexClasses DexLoader::load_dex(const dex_header* dh,
+                               dex_stats_t* stats,
+                               bool balloon) {
   if (dh->class_defs_size == 0) {
     return DexClasses(0);
   }
+  m_balloon = balloon;
+  m_num_instructions = 0;
   m_idx = std::make_unique<DexIdx>(dh);
+  // Loading the classes resolves the ids of the strings from all threads;
+  // interning them all first makes those lookups plain array reads.
+  m_idx->intern_all_strings();
   auto off = (uint64_t)dh->class_defs_off;
   m_class_defs =
       reinterpret_cast<const dex_class_def*>((const uint8_t*)dh + off);
@@ -493,11 +524,21 @@ DexClasses DexLoader::load_dex(const dex_header* dh, dex_stats_t* stats) {
   auto lwork = new class_load_work[dh->class_defs_size];
   auto num_threads = redex_parallel::default_num_threads();
   std::vector<std::vector<std::exception_ptr>> exceptions_vec(num_threads);
+  // Only gather the input stats if asked for, as they recreate the static
+  // values of each class.
+  m_class_stats.clear();
+  if (stats != nullptr) {
+    m_class_stats.resize(num_threads);
+  }
   auto wq = workqueue_foreach<class_load_work*>(
       [&exceptions_vec](sparta::SpartaWorkerState<class_load_work*>* state,
                         class_load_work* clw) {
         try {
-          clw->dl->load_dex_class(clw->num);
+          auto& class_stats = clw->dl->m_class_stats;
+          clw->dl->load_dex_class(clw->num,
+                                  class_stats.empty()
+                                      ? nullptr
+                                      : &class_stats[state->worker_id()]);
         } catch (const std::exception& exc) {
           TRACE(MAIN, 1, "Worker throw the exception:%s", exc.what());
           exceptions_vec[state->worker_id()].emplace_back(
@@ -558,22 +599,43 @@ DexClasses load_classes_from_dex(const char* location,
                                  int support_dex_version) {
   TRACE(MAIN, 1, "Loading classes from dex from %s", location);
   DexLoader dl(location);
-  auto classes = dl.load_dex(location, stats, support_dex_version);
-  if (balloon) {
-    balloon_all(classes);
-  }
-  return classes;
+  return dl.load_dex(location, stats, support_dex_version, balloon);
 }
 
 DexClasses load_classes_from_dex(const dex_header* dh,
                                  const char* location,
                                  bool balloon) {
   DexLoader dl(location);
-  auto classes = dl.load_dex(dh, nullptr);
-  if (balloon) {
-    balloon_all(classes);
+  return dl.load_dex(dh, nullptr, balloon);
+}
+
+DexClasses load_classes_from_dex(const ZipReader& archive,
+                                 const std::string& entry_name,
+                                 const char* location,
+                                 dex_stats_t* stats,
+                                 bool balloon,
+                                 int support_dex_version) {
+  TRACE(MAIN, 1, "Loading classes from dex %s in %s", entry_name.c_str(),
+        location);
+  auto entry = archive.find_entry(entry_name);
+  always_assert_log(entry != nullptr, "No %s in %s", entry_name.c_str(),
+                    location);
+  // A stored dex that is suitably aligned can be used in place.
+  const uint8_t* data = archive.get_stored_contents(*entry);
+  std::unique_ptr<uint8_t[]> inflated;
+  if (data == nullptr || align_ptr(data, 4) != data) {
+    inflated = std::make_unique<uint8_t[]>(entry->ucomp_size);
+    always_assert_log(archive.read_entry(*entry, inflated.get()),
+                      "Cannot read %s in %s", entry_name.c_str(), location);
+    data = inflated.get();
   }
-  return classes;
+  always_assert_log(entry->ucomp_size >= sizeof(dex_header),
+                    "%s in %s is too small to be a dex", entry_name.c_str(),
+                    location);
+  auto dh = reinterpret_cast<const dex_header*>(data);
+  validate_dex_header(dh, entry->ucomp_size, support_dex_version);
+  DexLoader dl(location);
+  return dl.load_dex(dh, stats, balloon);
 }
 
 std::string load_dex_magic_from_dex(const char* location) {
@@ -7,7 +7,12 @@
 
 #pragma once
 
+#include <atomic>
 #include <boost/iostreams/device/mapped_file.hpp>
+#include <memory>
+#include <set>
+#include <unordered_set>
+#include <vector>
 
 #include "DexClass.h"
 #include "DexDefs.h"
@@ -15,12 +20,31 @@
 #include "DexStats.h"
 #include "DexUtil.h"
 
+class ZipReader;
+
 class DexLoader {
   std::unique_ptr<DexIdx> m_idx;
   const dex_class_def* m_class_defs;
   DexClasses* m_classes;
   std::unique_ptr<boost::iostreams::mapped_file> m_file;
   std::string m_dex_location;
+  // Whether to turn the DexCode of each class into IRCode as soon as the class
+  // is loaded, so that the DexCode can be freed right away.
+  bool m_balloon{false};
+  std::atomic<size_t> m_num_instructions{0};
+
+  // The input stats of the classes, gathered by each worker for the classes
+  // it loads, and merged once all classes are loaded.
+  struct ClassStats {
+    std::vector<std::unique_ptr<DexEncodedValueArray>> static_values;
+    std::set<DexTypeList*, dextypelists_comparator> type_lists;
+    std::unordered_set<uint32_t> anno_offsets;
+    size_t num_fields{0};
+    size_t num_methods{0};
+  };
+  std::vector<ClassStats> m_class_stats;
+
+  void gather_class_stats(int num, DexClass* cls, ClassStats* class_stats);
 
  public:
   explicit DexLoader(const char* location);
@@ -28,9 +52,12 @@ class DexLoader {
   const dex_header* get_dex_header(const char* location);
   DexClasses load_dex(const char* location,
                       dex_stats_t* stats,
-                      int support_dex_version);
-  DexClasses load_dex(const dex_header* hdr, dex_stats_t* stats);
-  void load_dex_class(int num);
+                      int support_dex_version,
+                      bool balloon = false);
+  DexClasses load_dex(const dex_header* hdr,
+                      dex_stats_t* stats,
+                      bool balloon = false);
+  void load_dex_class(int num, ClassStats* class_stats = nullptr);
   void gather_input_stats(dex_stats_t* stats, const dex_header* dh);
   DexIdx* get_idx() { return m_idx.get(); }
 };
@@ -45,6 +72,18 @@ DexClasses load_classes_from_dex(const char* location,
 DexClasses load_classes_from_dex(const dex_header* dh,
                                  const char* location,
                                  bool balloon = true);
+/*
+ * Loads the classes of a dex file in a zip archive, e.g. classes2.dex in an
+ * APK, without extracting it first: a stored dex is read from the mapped
+ * archive, and a compressed one is inflated in memory. The classes are given
+ * the location, which is usually the path of the archive.
+ */
+DexClasses load_classes_from_dex(const ZipReader& archive,
+                                 const std::string& entry_name,
+                                 const char* location,
+                                 dex_stats_t* stats,
+                                 bool balloon = true,
+                                 int support_dex_version = 35);
 std::string load_dex_magic_from_dex(const char* location);
 void balloon_for_test(const Scope& scope);
 
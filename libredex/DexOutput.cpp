@@ -11,8 +11,10 @@
 #include <fcntl.h>
 #include <fstream>
 #include <functional>
+#include <limits>
 #include <list>
 #include <memory>
+#include <numeric>
 #include <stdlib.h>
 #include <sys/stat.h>
 #include <unordered_set>
@@ -30,6 +32,8 @@
 #define O_WRONLY _O_WRONLY
 #endif
 
+#include "Adler32.h"
+#include "CallGraphLayout.h"
 #include "Debug.h"
 #include "DexCallSite.h"
 #include "DexClass.h"
@@ -45,11 +49,10 @@
 #include "Trace.h"
 #include "Walkers.h"
 #include "WorkQueue.h"
-
-/*
- * For adler32...
- */
-#include <zlib.h>
+#include "ZipWriter.h"
+#ifndef _MSC_VER
+#include "mmap.h"
+#endif
 
 template <class T, class U>
 class CustomSort {
@@ -117,6 +120,71 @@ std::vector<DexString*> GatheredTypes::keep_cls_strings_together_emitlist() {
       CustomSort<DexString, cmp_dstring>(m_cls_strings, compare_dexstrings));
 }
 
+/*
+ * The strings that the methods which run during cold start use come first, in
+ * the order in which those methods run: their const strings, and the names of
+ * the types, fields and methods they reference. When method_profile_weights
+ * is set, the methods of all the weighted interactions are used instead.
+ */
+std::vector<DexString*> GatheredTypes::get_cold_start_dexstring_emitlist(
+    const method_profiles::StatsMap& cold_start_stats) {
+  std::vector<std::pair<double, const DexMethod*>> hot_methods;
+  auto add_methods = [&](const std::vector<DexMethod*>& methods) {
+    for (const DexMethod* m : methods) {
+      auto it = cold_start_stats.find(m);
+      if (it != cold_start_stats.end()) {
+        hot_methods.emplace_back(it->second.order_percent, m);
+      }
+    }
+  };
+  for (const auto& cls : *m_classes) {
+    add_methods(cls->get_dmethods());
+    add_methods(cls->get_vmethods());
+  }
+  std::stable_sort(
+      hot_methods.begin(), hot_methods.end(),
+      [](const std::pair<double, const DexMethod*>& a,
+         const std::pair<double, const DexMethod*>& b) {
+        return a.first < b.first;
+      });
+
+  std::unordered_map<const DexString*, unsigned int> hot_strings;
+  auto add_string = [&hot_strings](const DexString* s) {
+    hot_strings.emplace(s, hot_strings.size());
+  };
+  for (const auto& p : hot_methods) {
+    const DexMethod* m = p.second;
+    add_string(m->get_name());
+    std::vector<DexString*> strings;
+    m->gather_strings(strings);
+    for (auto* s : strings) {
+      add_string(s);
+    }
+    std::vector<DexType*> types;
+    m->gather_types(types);
+    for (auto* t : types) {
+      add_string(t->get_name());
+    }
+    std::vector<DexFieldRef*> fields;
+    m->gather_fields(fields);
+    for (auto* f : fields) {
+      add_string(f->get_class()->get_name());
+      add_string(f->get_name());
+    }
+    std::vector<DexMethodRef*> methods;
+    m->gather_methods(methods);
+    for (auto* callee : methods) {
+      add_string(callee->get_class()->get_name());
+      add_string(callee->get_name());
+      add_string(callee->get_proto()->get_shorty());
+    }
+  }
+  TRACE(CUSTOMSORT, 3, "%zu cold start methods use %zu strings",
+        hot_methods.size(), hot_strings.size());
+  return get_dexstring_emitlist(
+      CustomSort<DexString, cmp_dstring>(hot_strings, compare_dexstrings));
+}
+
 std::vector<DexMethodHandle*> GatheredTypes::get_dexmethodhandle_emitlist() {
   return m_lmethodhandle;
 }
@@ -169,6 +237,90 @@ void GatheredTypes::sort_dexmethod_emitlist_profiled_order(
                                      &cache));
 }
 
+/*
+ * Puts the profiled methods first, clustered with their hottest callers, so
+ * that the code that runs during cold start spans as few pages as possible.
+ * The call graph comes from the call graph profile if there is one, and
+ * from the call sites between the profiled methods otherwise. The order of the
+ * other methods is kept.
+ */
+void GatheredTypes::sort_dexmethod_emitlist_call_graph_order(
+    std::vector<DexMethod*>& lmeth) {
+  std::vector<DexMethod*> methods;
+  std::vector<call_graph_layout::Node> nodes;
+  std::unordered_map<const DexMethodRef*, uint32_t> node_of;
+  auto add_node = [&](DexMethod* m, unsigned int weight) {
+    auto p = node_of.emplace(m, methods.size());
+    if (p.second) {
+      methods.push_back(m);
+      nodes.push_back({(uint32_t)m->get_dex_code()->encode_size_bound(),
+                       weight});
+    }
+    return p.first->second;
+  };
+
+  std::unordered_map<std::string, DexMethod*> by_name;
+  for (DexMethod* m : lmeth) {
+    if (m->get_dex_code() == nullptr) {
+      continue;
+    }
+    auto w = get_method_weight_if_available(m, &m_method_to_weight);
+    if (w == 0) {
+      w = get_method_weight_override(m,
+                                     &m_method_sorting_whitelisted_substrings);
+    }
+    if (w != 0) {
+      add_node(m, w);
+    }
+    if (!m_call_graph_profile.empty()) {
+      by_name.emplace(m->get_fully_deobfuscated_name(), m);
+    }
+  }
+
+  std::vector<call_graph_layout::Edge> edges;
+  if (!m_call_graph_profile.empty()) {
+    // Sampled methods are hot even if they are not in the profiled methods.
+    for (const auto& edge : m_call_graph_profile) {
+      auto caller = by_name.find(edge.caller);
+      auto callee = by_name.find(edge.callee);
+      if (caller != by_name.end() && callee != by_name.end()) {
+        edges.push_back({add_node(caller->second, 0),
+                         add_node(callee->second, 0), edge.weight});
+      }
+    }
+  } else {
+    for (uint32_t caller = 0; caller < methods.size(); ++caller) {
+      for (auto insn : methods[caller]->get_dex_code()->get_instructions()) {
+        if (!insn->has_method()) {
+          continue;
+        }
+        auto callee = node_of.find(
+            static_cast<DexOpcodeMethod*>(insn)->get_method());
+        if (callee != node_of.end()) {
+          edges.push_back({caller, callee->second, 1});
+        }
+      }
+    }
+  }
+  TRACE(CUSTOMSORT, 3, "Clustering %zu methods with %zu call edges",
+        methods.size(), edges.size());
+
+  std::unordered_map<const DexMethod*, uint32_t> rank;
+  uint32_t next_rank = 0;
+  for (auto node : call_graph_layout::cluster(nodes, edges)) {
+    rank.emplace(methods[node], next_rank++);
+  }
+  auto get_rank = [&rank](const DexMethod* m) {
+    auto it = rank.find(m);
+    return it == rank.end() ? std::numeric_limits<uint32_t>::max()
+                            : it->second;
+  };
+  std::stable_sort(lmeth.begin(), lmeth.end(),
+                   [&get_rank](const DexMethod* a, const DexMethod* b) {
+                     return get_rank(a) < get_rank(b);
+                   });
+}
+
 void GatheredTypes::sort_dexmethod_emitlist_clinit_order(
     std::vector<DexMethod*>& lmeth) {
   std::stable_sort(lmeth.begin(), lmeth.end(),
@@ -447,14 +599,33 @@ DexOutput::DexOutput(
   m_iodi_metadata = iodi_metadata;
   // Required because the BytecodeDebugger setting creates huge amounts
   // of debug information (multiple dex debug entries per instruction)
-  if (debug_info_kind == DebugInfoKind::BytecodeDebugger) {
-    m_output = (uint8_t*)malloc(k_max_dex_size * 2);
-  } else {
-    m_output = (uint8_t*)malloc(k_max_dex_size);
+  size_t output_size = debug_info_kind == DebugInfoKind::BytecodeDebugger
+                           ? k_max_dex_size * 2
+                           : k_max_dex_size;
+  m_output = nullptr;
+#ifndef _MSC_VER
+  if (config_files.get_json_config().get("write_dexes_with_mmap", false)) {
+    // A freshly created file reads as zeros, and only the pages we touch ever
+    // get written back.
+    std::string error_msg;
+    m_output_file =
+        MappedFile::create_writable_file(output_size, path, &error_msg);
+    if (m_output_file != nullptr) {
+      m_output = m_output_file->begin();
+    } else {
+      fprintf(stderr, "warning: falling back to buffered dex writing: %s\n",
+              error_msg.c_str());
+    }
+  }
+#endif
+  if (m_output == nullptr) {
+    m_output = (uint8_t*)malloc(output_size);
+    memset(m_output, 0, k_max_dex_size);
   }
-  memset(m_output, 0, k_max_dex_size);
   m_offset = 0;
   m_force_class_data_end_of_file = post_lowering != nullptr;
+  m_pack_hot_code_items =
+      config_files.get_json_config().get("pack_hot_code_items", false);
   m_gtypes = new GatheredTypes(classes, post_lowering);
   dodx = m_gtypes->get_dodx(m_output);
   m_filename = path;
@@ -475,6 +646,12 @@ DexOutput::DexOutput(
 DexOutput::~DexOutput() {
   delete m_gtypes;
   delete dodx;
+#ifndef _MSC_VER
+  if (m_output_file != nullptr) {
+    delete m_output_file;
+    return;
+  }
+#endif
   free(m_output);
 }
 
@@ -594,11 +771,11 @@ std::unique_ptr<Locator> DexOutput::locator_for_descriptor(
       return nullptr;
     }
 
-    auto locator_it = locator_index->find(descriptor);
-    if (locator_it != locator_index->end()) {
+    auto entry = locator_index->find(descriptor);
+    if (entry != nullptr) {
       // This string is the name of a type we define in one of our
       // dex files.
-      return std::unique_ptr<Locator>(new Locator(locator_it->second));
+      return std::unique_ptr<Locator>(new Locator(entry->locator()));
     }
 
     if (type_names.count(descriptor)) {
@@ -610,9 +787,9 @@ std::unique_ptr<Locator> DexOutput::locator_for_descriptor(
         }
         DexString* elementDescriptor = DexString::get_string(s);
         if (elementDescriptor != nullptr) {
-          locator_it = locator_index->find(elementDescriptor);
-          if (locator_it != locator_index->end()) {
-            return std::unique_ptr<Locator>(new Locator(locator_it->second));
+          entry = locator_index->find(elementDescriptor);
+          if (entry != nullptr) {
+            return std::unique_ptr<Locator>(new Locator(entry->locator()));
           }
         }
       }
@@ -643,6 +820,10 @@ void DexOutput::generate_string_data(SortMode mode) {
   } else if (mode == SortMode::CLASS_STRINGS) {
     TRACE(CUSTOMSORT, 2, "using class names pack for string pool sorting");
     string_order = m_gtypes->keep_cls_strings_together_emitlist();
+  } else if (mode == SortMode::COLD_START_STRINGS) {
+    TRACE(CUSTOMSORT, 2, "using cold start order for string pool sorting");
+    string_order = m_gtypes->get_cold_start_dexstring_emitlist(
+        m_config_files.get_loaded_method_profiles().weighted_stats());
   } else {
     TRACE(CUSTOMSORT, 2, "using default string pool sorting");
     string_order = m_gtypes->get_dexstring_emitlist();
@@ -947,6 +1128,11 @@ void DexOutput::generate_code_items(const std::vector<SortMode>& mode) {
       TRACE(CUSTOMSORT, 2, "using method profiled order for bytecode sorting");
       m_gtypes->sort_dexmethod_emitlist_profiled_order(lmeth);
       break;
+    case SortMode::METHOD_CALL_GRAPH_ORDER:
+      TRACE(CUSTOMSORT, 2,
+            "using method call graph order for bytecode sorting");
+      m_gtypes->sort_dexmethod_emitlist_call_graph_order(lmeth);
+      break;
     case SortMode::CLINIT_FIRST:
       TRACE(CUSTOMSORT, 2,
             "sorting <clinit> sections before all other bytecode");
@@ -957,26 +1143,83 @@ void DexOutput::generate_code_items(const std::vector<SortMode>& mode) {
       TRACE(CUSTOMSORT, 2,
             "Unsupport bytecode sorting method SortMode::CLASS_STRINGS");
       break;
+    case SortMode::COLD_START_STRINGS:
+      TRACE(CUSTOMSORT, 2,
+            "Unsupport bytecode sorting method SortMode::COLD_START_STRINGS");
+      break;
     case SortMode::DEFAULT:
       TRACE(CUSTOMSORT, 2, "using default sorting order");
       m_gtypes->sort_dexmethod_emitlist_default_order(lmeth);
       break;
     }
   }
+  std::vector<DexMethod*> code_methods;
+  code_methods.reserve(lmeth.size());
   for (DexMethod* meth : lmeth) {
     if (meth->get_access() & (ACC_ABSTRACT | ACC_NATIVE)) {
       // There is no code item for ABSTRACT or NATIVE methods.
       continue;
     }
-    TRACE(CUSTOMSORT, 3, "method emit %s %s", SHOW(meth->get_class()),
-          SHOW(meth));
-    DexCode* code = meth->get_dex_code();
     always_assert_log(
-        meth->is_concrete() && code != nullptr,
+        meth->is_concrete() && meth->get_dex_code() != nullptr,
         "Undefined method in generate_code_items()\n\t prototype: %s\n",
         SHOW(meth));
+    code_methods.push_back(meth);
+  }
+
+  // Encoding is independent of where a code item ends up, so we encode all of
+  // them into scratch buffers in parallel, and then copy them into place in
+  // emission order.
+  std::vector<std::vector<uint32_t>> encoded(code_methods.size());
+  std::vector<uint32_t> encoded_sizes(code_methods.size());
+  auto wq = workqueue_foreach<size_t>([&](size_t i) {
+    DexCode* code = code_methods[i]->get_dex_code();
+    auto& buffer = encoded[i];
+    // Zero-initialized, as the padding bytes are not written by encode().
+    buffer.resize((code->encode_size_bound() + sizeof(uint32_t) - 1) /
+                  sizeof(uint32_t));
+    encoded_sizes[i] = code->encode(dodx, buffer.data());
+    always_assert(encoded_sizes[i] <= buffer.size() * sizeof(uint32_t));
+  });
+  for (size_t i = 0; i < code_methods.size(); i++) {
+    wq.add_item(i);
+  }
+  wq.run_all();
+
+  // The methods that run during cold start, or during any of the interactions
+  // that method_profile_weights combines.
+  const auto& cold_start_stats =
+      m_config_files.get_loaded_method_profiles().weighted_stats();
+  std::vector<bool> is_hot(code_methods.size(), false);
+  for (size_t i = 0; i < code_methods.size(); i++) {
+    is_hot[i] = cold_start_stats.count(code_methods[i]) != 0;
+  }
+  std::vector<size_t> emit_order;
+  if (m_pack_hot_code_items && !cold_start_stats.empty()) {
+    emit_order = pack_hot_code_items(m_offset, encoded_sizes, is_hot);
+  } else {
+    emit_order.resize(code_methods.size());
+    std::iota(emit_order.begin(), emit_order.end(), 0);
+  }
+  std::unordered_set<uint32_t> hot_pages;
+
+  for (size_t i : emit_order) {
+    DexMethod* meth = code_methods[i];
+    TRACE(CUSTOMSORT, 3, "method emit %s %s", SHOW(meth->get_class()),
+          SHOW(meth));
+    DexCode* code = meth->get_dex_code();
     align_output();
-    int size = code->encode(dodx, (uint32_t*)(m_output + m_offset));
+    uint32_t size = encoded_sizes[i];
+    if (is_hot[i]) {
+      ++m_stats.num_hot_code_items;
+      for (uint32_t page = m_offset / k_code_page_size;
+           page <= (m_offset + size - 1) / k_code_page_size;
+           ++page) {
+        hot_pages.insert(page);
+      }
+    }
+    memcpy(m_output + m_offset, encoded[i].data(), size);
+    std::vector<uint32_t>().swap(encoded[i]);
     check_method_instruction_size_limit(m_config_files, size, SHOW(meth));
     m_method_bytecode_offsets.emplace_back(meth->get_name()->c_str(), m_offset);
     m_code_item_emits.emplace_back(meth, code,
@@ -986,10 +1229,53 @@ void DexOutput::generate_code_items(const std::vector<SortMode>& mode) {
     m_stats.num_instructions += code->get_instructions().size();
     m_stats.instruction_bytes += insns_size * 2;
   }
+  m_stats.num_hot_code_pages = hot_pages.size();
   insert_map_item(TYPE_CODE_ITEM, (uint32_t)m_code_item_emits.size(), ci_start,
                   m_offset - ci_start);
 }
 
+std::vector<size_t> pack_hot_code_items(uint32_t start,
+                                        const std::vector<uint32_t>& sizes,
+                                        const std::vector<bool>& is_hot,
+                                        uint32_t page_size) {
+  // Code items are 4-byte aligned.
+  auto aligned_size = [&sizes](size_t i) { return (sizes[i] + 3) & ~3u; };
+  start = (start + 3) & ~3u;
+  uint64_t hot_size = 0;
+  for (size_t i = 0; i < sizes.size(); i++) {
+    if (is_hot[i]) {
+      hot_size += aligned_size(i);
+    }
+  }
+
+  std::vector<size_t> order;
+  order.reserve(sizes.size());
+  std::vector<bool> emitted(sizes.size(), false);
+  uint32_t gap = (page_size - start % page_size) % page_size;
+  if (hot_size > gap) {
+    // First fit of the cold items into the rest of the first page.
+    for (size_t i = 0; i < sizes.size() && gap > 0; i++) {
+      if (!is_hot[i] && aligned_size(i) <= gap) {
+        order.push_back(i);
+        emitted[i] = true;
+        gap -= aligned_size(i);
+      }
+    }
+  }
+  for (size_t i = 0; i < sizes.size(); i++) {
+    if (is_hot[i]) {
+      order.push_back(i);
+      emitted[i] = true;
+    }
+  }
+  for (size_t i = 0; i < sizes.size(); i++) {
+    if (!emitted[i]) {
+      order.push_back(i);
+    }
+  }
+  return order;
+}
+
 void DexOutput::generate_callsite_data() {
   uint32_t offset =
       hdr.class_defs_off + hdr.class_defs_size * sizeof(dex_class_def);
@@ -1967,10 +2253,9 @@ void DexOutput::finalize_header() {
   sha1_update(&context, m_output + skip, hdr.file_size - skip);
   sha1_final(hdr.signature, &context);
   memcpy(m_output, &hdr, sizeof(hdr));
-  uint32_t adler = (uint32_t)adler32(0L, Z_NULL, 0);
   skip = sizeof(hdr.magic) + sizeof(hdr.checksum);
-  adler = (uint32_t)adler32(adler, (const Bytef*)(m_output + skip),
-                            hdr.file_size - skip);
+  uint32_t adler =
+      adler32_update(ADLER32_INIT, m_output + skip, hdr.file_size - skip);
   hdr.checksum = adler;
   memcpy(m_output, &hdr, sizeof(hdr));
 }
@@ -2322,17 +2607,29 @@ void GatheredTypes::set_method_to_weight(
   m_method_to_weight = method_to_weight;
 }
 
+void GatheredTypes::set_call_graph_profile(
+    const std::vector<CallGraphProfileEdge>& call_graph_profile) {
+  m_call_graph_profile = call_graph_profile;
+}
+
 void DexOutput::prepare(SortMode string_mode,
                         const std::vector<SortMode>& code_mode,
                         const ConfigFiles& conf,
                         const std::string& dex_magic) {
 
-  if (std::find(code_mode.begin(), code_mode.end(),
+  bool call_graph_order =
+      std::find(code_mode.begin(), code_mode.end(),
+                SortMode::METHOD_CALL_GRAPH_ORDER) != code_mode.end();
+  if (call_graph_order ||
+      std::find(code_mode.begin(), code_mode.end(),
                 SortMode::METHOD_PROFILED_ORDER) != code_mode.end()) {
     m_gtypes->set_method_to_weight(conf.get_method_to_weight());
     m_gtypes->set_method_sorting_whitelisted_substrings(
         conf.get_method_sorting_whitelisted_substrings());
   }
+  if (call_graph_order) {
+    m_gtypes->set_call_graph_profile(conf.get_call_graph_profile());
+  }
 
   fix_jumbos(m_classes, dodx);
   init_header_offsets(dex_magic);
@@ -2362,6 +2659,22 @@ void DexOutput::prepare(SortMode string_mode,
 }
 
 void DexOutput::write() {
+  write_dex_file();
+  write_symbol_files();
+}
+
+void DexOutput::write_dex_file() {
+#ifndef _MSC_VER
+  if (m_output_file != nullptr) {
+    // The data is already in the file, it only needs to shrink to its size.
+    always_assert_log(m_output_file->truncate(m_offset),
+                      "Error truncating dex %s: %s\n", m_filename,
+                      strerror(errno));
+    m_output = nullptr;
+    m_stats.num_bytes = m_offset;
+    return;
+  }
+#endif
   struct stat st;
   int fd = open(m_filename, O_CREAT | O_TRUNC | O_WRONLY, 0660);
   if (fd == -1) {
@@ -2373,8 +2686,11 @@ void DexOutput::write() {
     m_stats.num_bytes = st.st_size;
   }
   close(fd);
+}
 
-  write_symbol_files();
+void DexOutput::write_dex_to_archive(ZipWriter* archive) {
+  archive->add_entry(m_filename, m_output, m_offset);
+  m_stats.num_bytes = m_offset;
 }
 
 class UniqueReferences {
@@ -2451,11 +2767,55 @@ static SortMode make_sort_bytecode(const std::string& sort_bytecode) {
     return SortMode::CLINIT_FIRST;
   } else if (sort_bytecode == "method_profiled_order") {
     return SortMode::METHOD_PROFILED_ORDER;
+  } else if (sort_bytecode == "method_call_graph_order") {
+    return SortMode::METHOD_CALL_GRAPH_ORDER;
   } else {
     return SortMode::DEFAULT;
   }
 }
 
+namespace {
+
+struct DexWritingConfig {
+  bool normal_primary_dex;
+  SortMode string_sort_mode;
+  std::vector<SortMode> code_sort_mode;
+};
+
+DexWritingConfig get_dex_writing_config(const ConfigFiles& conf) {
+  const JsonWrapper& json_cfg = conf.get_json_config();
+  DexWritingConfig config;
+  auto sort_strings = json_cfg.get("string_sort_mode", std::string());
+  config.string_sort_mode = SortMode::DEFAULT;
+  if (sort_strings == "class_strings") {
+    config.string_sort_mode = SortMode::CLASS_STRINGS;
+  } else if (sort_strings == "class_order") {
+    config.string_sort_mode = SortMode::CLASS_ORDER;
+  } else if (sort_strings == "cold_start_strings") {
+    config.string_sort_mode = SortMode::COLD_START_STRINGS;
+  }
+
+  auto interdex_config = json_cfg.get("InterDexPass", Json::Value());
+  config.normal_primary_dex =
+      interdex_config.get("normal_primary_dex", false).asBool();
+  auto sort_bytecode_cfg = json_cfg.get("bytecode_sort_mode", Json::Value());
+
+  if (sort_bytecode_cfg.isString()) {
+    config.code_sort_mode.push_back(
+        make_sort_bytecode(sort_bytecode_cfg.asString()));
+  } else if (sort_bytecode_cfg.isArray()) {
+    for (const auto& val : sort_bytecode_cfg) {
+      config.code_sort_mode.push_back(make_sort_bytecode(val.asString()));
+    }
+  }
+  if (config.code_sort_mode.empty()) {
+    config.code_sort_mode.push_back(SortMode::DEFAULT);
+  }
+  return config;
+}
+
+} // namespace
+
 dex_stats_t write_classes_to_dex(
     const RedexOptions& redex_options,
     const std::string& filename,
@@ -2475,37 +2835,14 @@ dex_stats_t write_classes_to_dex(
   if (force_single_dex) {
     always_assert_log(dex_number == 0, "force_single_dex requires one dex");
   }
-  auto sort_strings = json_cfg.get("string_sort_mode", std::string());
-  SortMode string_sort_mode = SortMode::DEFAULT;
-  if (sort_strings == "class_strings") {
-    string_sort_mode = SortMode::CLASS_STRINGS;
-  } else if (sort_strings == "class_order") {
-    string_sort_mode = SortMode::CLASS_ORDER;
-  }
-
-  auto interdex_config = json_cfg.get("InterDexPass", Json::Value());
-  auto normal_primary_dex =
-      interdex_config.get("normal_primary_dex", false).asBool();
-  auto sort_bytecode_cfg = json_cfg.get("bytecode_sort_mode", Json::Value());
-  std::vector<SortMode> code_sort_mode;
-
-  if (sort_bytecode_cfg.isString()) {
-    code_sort_mode.push_back(make_sort_bytecode(sort_bytecode_cfg.asString()));
-  } else if (sort_bytecode_cfg.isArray()) {
-    for (const auto& val : sort_bytecode_cfg) {
-      code_sort_mode.push_back(make_sort_bytecode(val.asString()));
-    }
-  }
-  if (code_sort_mode.empty()) {
-    code_sort_mode.push_back(SortMode::DEFAULT);
-  }
+  auto config = get_dex_writing_config(conf);
 
   TRACE(OPUT, 2, "[write_classes_to_dex][filename] %s", filename.c_str());
 
   DexOutput dout = DexOutput(filename.c_str(),
                              classes,
                              locator_index,
-                             normal_primary_dex,
+                             config.normal_primary_dex,
                              store_number,
                              dex_number,
                              redex_options.debug_info_kind,
@@ -2516,46 +2853,156 @@ dex_stats_t write_classes_to_dex(
                              code_debug_lines,
                              post_lowering);
 
-  dout.prepare(string_sort_mode, code_sort_mode, conf, dex_magic);
+  dout.prepare(config.string_sort_mode, config.code_sort_mode, conf, dex_magic);
   dout.write();
   dout.metrics();
   return dout.m_stats;
 }
 
-LocatorIndex make_locator_index(DexStoresVector& stores) {
-  LocatorIndex index;
+std::vector<dex_stats_t> write_classes_to_dexes(
+    const RedexOptions& redex_options,
+    const std::vector<std::string>& filenames,
+    DexClassesVector* dexen,
+    LocatorIndex* locator_index,
+    size_t store_number,
+    const ConfigFiles& conf,
+    PositionMapper* pos_mapper,
+    const std::string& dex_magic,
+    PostLowering const* post_lowering,
+    size_t num_threads,
+    ZipWriter* archive) {
+  always_assert(filenames.size() == dexen->size());
+  const JsonWrapper& json_cfg = conf.get_json_config();
+  // The mmap'ed output buffers would create the dex files themselves.
+  always_assert_log(archive == nullptr ||
+                        !json_cfg.get("write_dexes_with_mmap", false),
+                    "write_dexes_with_mmap can't write into an archive");
+  bool force_single_dex = json_cfg.get("force_single_dex", false);
+  if (force_single_dex) {
+    always_assert_log(dexen->size() <= 1, "force_single_dex requires one dex");
+  }
+  auto config = get_dex_writing_config(conf);
+  num_threads = std::max<size_t>(num_threads, 1);
+
+  std::vector<dex_stats_t> dexes_stats;
+  // Every in-flight dex holds a full output buffer, so we go in batches of at
+  // most num_threads dexes.
+  for (size_t begin = 0; begin < dexen->size(); begin += num_threads) {
+    size_t end = std::min(begin + num_threads, dexen->size());
+    std::vector<std::unique_ptr<DexOutput>> outputs(end - begin);
+    auto wq = workqueue_foreach<size_t>(
+        [&](size_t dex_number) {
+          const auto& filename = filenames[dex_number];
+          TRACE(OPUT, 2, "[write_classes_to_dexes][filename] %s",
+                filename.c_str());
+          auto dout = std::make_unique<DexOutput>(filename.c_str(),
+                                                  &dexen->at(dex_number),
+                                                  locator_index,
+                                                  config.normal_primary_dex,
+                                                  store_number,
+                                                  dex_number,
+                                                  redex_options.debug_info_kind,
+                                                  nullptr /* iodi_metadata */,
+                                                  conf,
+                                                  pos_mapper,
+                                                  nullptr /* method_to_id */,
+                                                  nullptr /* code_debug_lines */,
+                                                  post_lowering);
+          dout->prepare(config.string_sort_mode, config.code_sort_mode, conf,
+                        dex_magic);
+          if (archive != nullptr) {
+            dout->write_dex_to_archive(archive);
+          } else {
+            dout->write_dex_file();
+          }
+          outputs[dex_number - begin] = std::move(dout);
+        },
+        end - begin);
+    for (size_t i = begin; i < end; i++) {
+      wq.add_item(i);
+    }
+    wq.run_all();
+    for (auto& dout : outputs) {
+      dout->write_symbol_files();
+      dout->metrics();
+      dexes_stats.push_back(dout->m_stats);
+    }
+  }
+  return dexes_stats;
+}
 
+LocatorIndex::LocatorIndex(std::vector<Entry> entries)
+    : m_entries(std::move(entries)) {
+  std::sort(m_entries.begin(), m_entries.end(),
+            [](const Entry& a, const Entry& b) { return a.name < b.name; });
+  auto dup = std::adjacent_find(
+      m_entries.begin(), m_entries.end(),
+      [](const Entry& a, const Entry& b) { return a.name == b.name; });
+  // We shouldn't see the same class defined in two dexen
+  always_assert_log(dup == m_entries.end(), "This was already inserted %s\n",
+                    dup == m_entries.end() ? "" : dup->name->c_str());
+}
+
+const LocatorIndex::Entry* LocatorIndex::find(const DexString* name) const {
+  auto it = std::lower_bound(
+      m_entries.begin(), m_entries.end(), name,
+      [](const Entry& entry, const DexString* n) { return entry.name < n; });
+  return it != m_entries.end() && it->name == name ? &*it : nullptr;
+}
+
+LocatorIndex make_locator_index(DexStoresVector& stores) {
+  struct Dex {
+    uint32_t strnr;
+    uint32_t dexnr;
+    const DexClasses* classes;
+  };
+  std::vector<Dex> dexes;
   for (uint32_t strnr = 0; strnr < stores.size(); strnr++) {
     DexClassesVector& dexen = stores[strnr].get_dexen();
     uint32_t dexnr = 1; // Zero is reserved for Android classes
     for (auto dexit = dexen.begin(); dexit != dexen.end(); ++dexit, ++dexnr) {
-      const DexClasses& classes = *dexit;
-      uint32_t clsnr = 0;
-      for (auto clsit = classes.begin(); clsit != classes.end();
-           ++clsit, ++clsnr) {
-        DexString* clsname = (*clsit)->get_type()->get_name();
-        const auto cstr = clsname->c_str();
-        uint32_t global_clsnr = Locator::decodeGlobalClassIndex(cstr);
-        if (global_clsnr != Locator::invalid_global_class_index) {
-          TRACE(LOC, 3,
-                "%s (%u, %u, %u) needs no locator; global class index=%u", cstr,
-                strnr, dexnr, clsnr, global_clsnr);
-          // This prefix is followed by the global class index; this case
-          // doesn't need a locator.
-          continue;
-        }
+      dexes.push_back(Dex{strnr, dexnr, &*dexit});
+    }
+  }
 
-        bool inserted = index
-                            .insert(std::make_pair(
-                                clsname, Locator::make(strnr, dexnr, clsnr)))
-                            .second;
-        // We shouldn't see the same class defined in two dexen
-        always_assert_log(inserted, "This was already inserted %s\n",
-                          (*clsit)->get_deobfuscated_name().c_str());
-        (void)inserted; // Shut up compiler when defined(NDEBUG)
+  // The dexes are independent, so collect their entries in parallel.
+  std::vector<std::vector<LocatorIndex::Entry>> dex_entries(dexes.size());
+  auto wq = workqueue_foreach<size_t>([&](size_t i) {
+    const auto& dex = dexes[i];
+    auto& entries = dex_entries[i];
+    entries.reserve(dex.classes->size());
+    uint32_t clsnr = 0;
+    for (auto clsit = dex.classes->begin(); clsit != dex.classes->end();
+         ++clsit, ++clsnr) {
+      DexString* clsname = (*clsit)->get_type()->get_name();
+      const auto cstr = clsname->c_str();
+      uint32_t global_clsnr = Locator::decodeGlobalClassIndex(cstr);
+      if (global_clsnr != Locator::invalid_global_class_index) {
+        TRACE(LOC, 3, "%s (%u, %u, %u) needs no locator; global class index=%u",
+              cstr, dex.strnr, dex.dexnr, clsnr, global_clsnr);
+        // This prefix is followed by the global class index; this case
+        // doesn't need a locator.
+        continue;
       }
+      // Checks the limits of the encoding.
+      Locator::make(dex.strnr, dex.dexnr, clsnr);
+      entries.push_back(
+          LocatorIndex::Entry{clsname, dex.strnr, dex.dexnr, clsnr});
     }
+  });
+  for (size_t i = 0; i < dexes.size(); i++) {
+    wq.add_item(i);
   }
+  wq.run_all();
 
-  return index;
+  size_t size = 0;
+  for (const auto& entries : dex_entries) {
+    size += entries.size();
+  }
+  std::vector<LocatorIndex::Entry> all_entries;
+  all_entries.reserve(size);
+  for (const auto& entries : dex_entries) {
+    all_entries.insert(all_entries.end(), entries.begin(), entries.end());
+  }
+  return LocatorIndex(std::move(all_entries));
 }
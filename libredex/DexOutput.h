@@ -25,6 +25,7 @@ using facebook::Locator;
 
 class DexCallSite;
 class DexMethodHandle;
+class ZipWriter;
 
 using dexstring_to_idx = std::unordered_map<DexString*, uint32_t>;
 using dextype_to_idx = std::unordered_map<DexType*, uint16_t>;
@@ -34,7 +35,34 @@ using dexmethod_to_idx = std::unordered_map<DexMethodRef*, uint32_t>;
 using dexcallsite_to_idx = std::unordered_map<DexCallSite*, uint32_t>;
 using dexmethodhandle_to_idx = std::unordered_map<DexMethodHandle*, uint32_t>;
 
-using LocatorIndex = std::unordered_map<DexString*, Locator>;
+/*
+ * The locators of the classes we define, by name. It is built once and then
+ * only queried while the dexes are written, so it is a sorted array rather than
+ * a hash map.
+ */
+class LocatorIndex {
+ public:
+  struct Entry {
+    const DexString* name;
+    uint32_t strnr;
+    uint32_t dexnr;
+    uint32_t clsnr;
+
+    Locator locator() const { return Locator(strnr, dexnr, clsnr); }
+  };
+
+  // Asserts that no name appears twice.
+  explicit LocatorIndex(std::vector<Entry> entries);
+
+  // Returns nullptr if the name isn't one of our classes.
+  const Entry* find(const DexString* name) const;
+
+  size_t size() const { return m_entries.size(); }
+
+ private:
+  std::vector<Entry> m_entries;
+};
+
 LocatorIndex make_locator_index(DexStoresVector& stores);
 
 enum class SortMode {
@@ -42,6 +70,8 @@ enum class SortMode {
   CLASS_STRINGS,
   CLINIT_FIRST,
   METHOD_PROFILED_ORDER,
+  METHOD_CALL_GRAPH_ORDER,
+  COLD_START_STRINGS,
   DEFAULT
 };
 
@@ -140,6 +170,46 @@ dex_stats_t write_classes_to_dex(
     const std::string& dex_magic,
     PostLowering const* post_lowering = nullptr);
 
+/*
+ * Same as calling write_classes_to_dex for every dex of a store in order, but
+ * up to num_threads dexes are prepared and written concurrently, each with its
+ * own output buffer. The symbol files and the cumulative metrics are still
+ * produced in dex order, so the results do not change.
+ *
+ * This is only possible when the emission order of the dexes doesn't matter
+ * otherwise, i.e. when line_mapper doesn't renumber positions, and no method
+ * ids, debug line items or IODI metadata have to be collected.
+ *
+ * When an archive is given, the dexes are compressed into it as they are
+ * produced, with the filenames as entry names, instead of being written out.
+ */
+std::vector<dex_stats_t> write_classes_to_dexes(
+    const RedexOptions&,
+    const std::vector<std::string>& filenames,
+    DexClassesVector* dexen,
+    LocatorIndex* locator_index /* nullable */,
+    size_t store_number,
+    const ConfigFiles& conf,
+    PositionMapper* line_mapper,
+    const std::string& dex_magic,
+    PostLowering const* post_lowering,
+    size_t num_threads,
+    ZipWriter* archive = nullptr);
+
+constexpr uint32_t k_code_page_size = 4096;
+
+/*
+ * Returns the order in which to emit the code items with the given sizes,
+ * starting at offset start, so that the hot ones touch as few pages as
+ * possible. The hot items are emitted back to back. Unless they all fit before
+ * the next page boundary, it is filled with cold items first. The relative
+ * order of the hot items, and of the remaining cold items, is kept.
+ */
+std::vector<size_t> pack_hot_code_items(uint32_t start,
+                                        const std::vector<uint32_t>& sizes,
+                                        const std::vector<bool>& is_hot,
+                                        uint32_t page_size = k_code_page_size);
+
 using cmp_dstring = bool (*)(const DexString*, const DexString*);
 using cmp_dtype = bool (*)(const DexType*, const DexType*);
 using cmp_dproto = bool (*)(const DexProto*, const DexProto*);
@@ -221,6 +291,7 @@ class GatheredTypes {
   std::unordered_map<const DexMethod*, unsigned int> m_methods_in_cls_order;
   std::unordered_map<std::string, unsigned int> m_method_to_weight;
   std::unordered_set<std::string> m_method_sorting_whitelisted_substrings;
+  std::vector<CallGraphProfileEdge> m_call_graph_profile;
 
   void gather_components(PostLowering const* post_lowering);
   dexstring_to_idx* get_string_index(cmp_dstring cmp = compare_dexstrings);
@@ -248,6 +319,8 @@ class GatheredTypes {
   std::vector<DexString*> get_dexstring_emitlist(T cmp = compare_dexstrings);
   std::vector<DexString*> get_cls_order_dexstring_emitlist();
   std::vector<DexString*> keep_cls_strings_together_emitlist();
+  std::vector<DexString*> get_cold_start_dexstring_emitlist(
+      const method_profiles::StatsMap& cold_start_stats);
   std::vector<DexMethod*> get_dexmethod_emitlist();
   std::vector<DexMethodHandle*> get_dexmethodhandle_emitlist();
   std::vector<DexCallSite*> get_dexcallsite_emitlist();
@@ -258,10 +331,14 @@ class GatheredTypes {
   void sort_dexmethod_emitlist_cls_order(std::vector<DexMethod*>& lmeth);
   void sort_dexmethod_emitlist_clinit_order(std::vector<DexMethod*>& lmeth);
   void sort_dexmethod_emitlist_profiled_order(std::vector<DexMethod*>& lmeth);
+  void sort_dexmethod_emitlist_call_graph_order(
+      std::vector<DexMethod*>& lmeth);
   void set_method_sorting_whitelisted_substrings(
       const std::unordered_set<std::string>& whitelisted_substrings);
   void set_method_to_weight(
       const std::unordered_map<std::string, unsigned int>& method_to_weight);
+  void set_call_graph_profile(
+      const std::vector<CallGraphProfileEdge>& call_graph_profile);
 
   std::unordered_set<DexString*> index_type_names();
 };
@@ -287,6 +364,7 @@ struct CodeItemEmit {
 };
 
 struct DexOutputTestHelper;
+class MappedFile;
 
 class DexOutput {
  public:
@@ -297,6 +375,9 @@ class DexOutput {
   DexOutputIdx* dodx;
   GatheredTypes* m_gtypes;
   uint8_t* m_output;
+  // When set, m_output is a writable mapping of the output file itself, so
+  // that writing the dex doesn't need another copy.
+  MappedFile* m_output_file{nullptr};
   uint32_t m_offset;
   const char* m_filename;
   size_t m_store_number;
@@ -322,6 +403,7 @@ class DexOutput {
   const ConfigFiles& m_config_files;
   std::unordered_set<std::string> m_method_sorting_whitelisted_substrings;
   bool m_force_class_data_end_of_file;
+  bool m_pack_hot_code_items;
 
   void insert_map_item(uint16_t typeidx,
                        uint32_t size,
@@ -361,7 +443,6 @@ class DexOutput {
   void generate_map();
   void finalize_header();
   void init_header_offsets(const std::string& dex_magic);
-  void write_symbol_files();
   void align_output() { m_offset = (m_offset + 3) & ~3; }
   void emit_locator(Locator locator);
   void emit_magic_locators();
@@ -391,6 +472,12 @@ class DexOutput {
                const ConfigFiles& conf,
                const std::string& dex_magic);
   void write();
+  // write() is the same as write_dex_file() followed by write_symbol_files().
+  void write_dex_file();
+  // Adds the dex to the archive instead of writing its file, with the path it
+  // was created with as the entry name.
+  void write_dex_to_archive(ZipWriter* archive);
+  void write_symbol_files();
   void metrics();
   static void check_method_instruction_size_limit(const ConfigFiles& conf,
                                                   int size,
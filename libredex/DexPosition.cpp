@@ -5,6 +5,7 @@
  * LICENSE file in the root directory of this source tree.
  */
 
+#include <boost/functional/hash.hpp>
 #include <fstream>
 #include <iostream>
 #include <json/json.h>
@@ -48,19 +49,49 @@ std::unique_ptr<DexPosition> DexPosition::make_synthetic_entry_position(
   return std::make_unique<DexPosition>(method_str, source, 0);
 }
 
+size_t PositionTable::EntryHash::operator()(const Entry& entry) const {
+  size_t seed = 0;
+  boost::hash_combine(seed, entry.method);
+  boost::hash_combine(seed, entry.file);
+  boost::hash_combine(seed, entry.line);
+  boost::hash_combine(seed, entry.parent);
+  return seed;
+}
+
+uint32_t PositionTable::intern(const DexPosition* pos) {
+  auto it = m_interned.find(pos);
+  if (it != m_interned.end()) {
+    return it->second;
+  }
+  uint32_t parent = pos->parent == nullptr ? NO_PARENT : intern(pos->parent);
+  Entry entry{pos->method, pos->file, pos->line, parent};
+  auto pair = m_indices.emplace(entry, m_entries.size());
+  if (pair.second) {
+    m_entries.push_back(entry);
+  }
+  uint32_t index = pair.first->second;
+  m_interned.emplace(pos, index);
+  return index;
+}
+
 void RealPositionMapper::register_position(DexPosition* pos) {
-  m_pos_line_map[pos] = -1;
+  m_table.intern(pos);
 }
 
-uint32_t RealPositionMapper::get_line(DexPosition* pos) {
-  return m_pos_line_map.at(pos) + 1;
+uint32_t RealPositionMapper::get_line(uint32_t index) {
+  return m_lines.at(index) + 1;
 }
 
 uint32_t RealPositionMapper::position_to_line(DexPosition* pos) {
-  auto idx = m_positions.size();
-  m_positions.emplace_back(pos);
-  m_pos_line_map[pos] = idx;
-  return get_line(pos);
+  auto index = m_table.intern(pos);
+  if (m_lines.size() < m_table.size()) {
+    m_lines.resize(m_table.size(), -1);
+  }
+  if (m_lines[index] == -1) {
+    m_lines[index] = m_positions.size();
+    m_positions.push_back(index);
+  }
+  return get_line(index);
 }
 
 void RealPositionMapper::write_map() {
@@ -72,49 +103,62 @@ void RealPositionMapper::write_map() {
 void RealPositionMapper::write_map_v2() {
   // to ensure that the line numbers in the Dex are as compact as possible,
   // we put the emitted positions at the start of the list and rest at the end
-  for (auto item : m_pos_line_map) {
-    auto line = item.second;
-    if (line == -1) {
-      auto idx = m_positions.size();
-      m_positions.emplace_back(item.first);
-      m_pos_line_map[item.first] = idx;
+  m_lines.resize(m_table.size(), -1);
+  for (uint32_t index = 0; index < m_table.size(); ++index) {
+    if (m_lines[index] == -1) {
+      m_lines[index] = m_positions.size();
+      m_positions.push_back(index);
     }
   }
   /*
-   * Map file layout:
-   * 0xfaceb000 (magic number)
-   * version (4 bytes)
-   * string_pool_size (4 bytes)
-   * string_pool[string_pool_size]
-   * positions_size (4 bytes)
+   * Map file layout, version 3. It is meant to be mapped and used in place:
+   * all the fields are little-endian uint32s at 4-byte aligned offsets.
+   *
+   * header:
+   *   0xfaceb000 (magic number)
+   *   version
+   *   string_pool_size
+   *   positions_size
+   *   string_offsets_offset
+   *   string_data_offset
+   *   string_data_size
+   *   positions_offset
+   * string_offsets[string_pool_size + 1]
+   * string_data[string_data_size], padded to 4 bytes
    * positions[positions_size]
    *
-   * Each member of the string pool is encoded as follows:
-   * string_length (4 bytes)
-   * char[string_length]
+   * The offsets are relative to the start of the file, except the string
+   * offsets, which are relative to the string data: string i covers
+   * [string_offsets[i], string_offsets[i + 1]).
+   *
+   * Each position is encoded as class_id, method_id, file_id, line and
+   * parent, where parent is the 1-based index of the parent position, or 0.
    */
-  std::ostringstream pos_out;
+  std::vector<uint32_t> pos_out;
+  pos_out.reserve(m_positions.size() * 5);
   std::unordered_map<std::string, uint32_t> string_ids;
-  std::vector<std::string> string_pool;
+  std::vector<uint32_t> string_offsets{0};
+  std::string string_data;
 
   auto id_of_string = [&](const std::string& s) -> uint32_t {
-    if (string_ids.find(s) == string_ids.end()) {
-      string_ids[s] = string_pool.size();
-      string_pool.push_back(s);
+    auto it = string_ids.find(s);
+    if (it != string_ids.end()) {
+      return it->second;
     }
-    return string_ids.at(s);
+    uint32_t id = string_offsets.size() - 1;
+    string_ids.emplace(s, id);
+    string_data += s;
+    string_offsets.push_back(string_data.size());
+    return id;
   };
 
-  for (auto pos : m_positions) {
-    uint32_t parent_line = 0;
-    try {
-      parent_line = pos->parent == nullptr ? 0 : get_line(pos->parent);
-    } catch (std::out_of_range& e) {
-      std::cerr << "Parent position " << show(pos->parent) << " of "
-                << show(pos) << " was not registered" << std::endl;
-    }
+  for (auto index : m_positions) {
+    const auto& pos = m_table.at(index);
+    uint32_t parent_line = pos.parent == PositionTable::NO_PARENT
+                               ? 0
+                               : get_line(pos.parent);
     // of the form "class_name.method_name:(arg_types)return_type"
-    const auto& full_method_name = pos->method->str();
+    const auto& full_method_name = pos.method->str();
     // strip out the args and return type
     auto qualified_method_name =
         full_method_name.substr(0, full_method_name.find(':'));
@@ -124,30 +168,40 @@ void RealPositionMapper::write_map_v2() {
         qualified_method_name.substr(qualified_method_name.rfind('.') + 1);
     auto class_id = id_of_string(class_name);
     auto method_id = id_of_string(method_name);
-    auto file_id = id_of_string(pos->file->c_str());
-    pos_out.write((const char*)&class_id, sizeof(class_id));
-    pos_out.write((const char*)&method_id, sizeof(method_id));
-    pos_out.write((const char*)&file_id, sizeof(file_id));
-    pos_out.write((const char*)&pos->line, sizeof(pos->line));
-    pos_out.write((const char*)&parent_line, sizeof(parent_line));
+    auto file_id = id_of_string(pos.file->c_str());
+    pos_out.insert(pos_out.end(),
+                   {class_id, method_id, file_id, pos.line, parent_line});
   }
 
-  std::ofstream ofs(m_filename_v2.c_str(),
-                    std::ofstream::out | std::ofstream::trunc);
-  uint32_t magic = 0xfaceb000; // serves as endianess check
-  ofs.write((const char*)&magic, sizeof(magic));
-  uint32_t version = 2;
-  ofs.write((const char*)&version, sizeof(version));
-  uint32_t spool_count = string_pool.size();
-  ofs.write((const char*)&spool_count, sizeof(spool_count));
-  for (const auto& s : string_pool) {
-    uint32_t ssize = s.size();
-    ofs.write((const char*)&ssize, sizeof(ssize));
-    ofs << s;
-  }
+  constexpr uint32_t kHeaderSize = 8 * sizeof(uint32_t);
+  uint32_t spool_count = string_offsets.size() - 1;
   uint32_t pos_count = m_positions.size();
-  ofs.write((const char*)&pos_count, sizeof(pos_count));
-  ofs << pos_out.str();
+  uint32_t string_offsets_offset = kHeaderSize;
+  uint32_t string_data_offset =
+      string_offsets_offset + string_offsets.size() * sizeof(uint32_t);
+  uint32_t string_data_size = string_data.size();
+  uint32_t positions_offset = (string_data_offset + string_data_size + 3) & ~3;
+  uint32_t header[] = {
+      0xfaceb000, // serves as endianess check
+      3,          // version
+      spool_count,
+      pos_count,
+      string_offsets_offset,
+      string_data_offset,
+      string_data_size,
+      positions_offset,
+  };
+  static_assert(sizeof(header) == kHeaderSize, "Unexpected header size");
+  string_data.resize(positions_offset - string_data_offset, '\0');
+
+  std::ofstream ofs(m_filename_v2.c_str(),
+                    std::ofstream::out | std::ofstream::trunc |
+                        std::ofstream::binary);
+  ofs.write((const char*)header, sizeof(header));
+  ofs.write((const char*)string_offsets.data(),
+            string_offsets.size() * sizeof(uint32_t));
+  ofs.write(string_data.data(), string_data.size());
+  ofs.write((const char*)pos_out.data(), pos_out.size() * sizeof(uint32_t));
 }
 
 PositionMapper* PositionMapper::make(const std::string& map_filename_v2) {
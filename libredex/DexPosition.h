@@ -8,11 +8,14 @@
 #pragma once
 
 #include <cstdint>
+#include <limits>
 #include <string>
 #include <unordered_map>
 #include <utility>
 #include <vector>
 
+#include "ObjectPool.h"
+
 class DexClass;
 class DexMethod;
 class DexString;
@@ -28,6 +31,8 @@ struct DexPosition final {
   explicit DexPosition(uint32_t line);
   DexPosition(DexString* method, DexString* file, uint32_t line);
 
+  REDEX_POOLED_ALLOCATION(DexPosition)
+
   void bind(DexString* method_, DexString* file_);
   bool operator==(const DexPosition&) const;
 
@@ -35,6 +40,49 @@ struct DexPosition final {
       const DexMethod* method);
 };
 
+/*
+ * An interned table of positions. Positions are equal if they have the same
+ * method, file and line, and equal parents, so the parent chains that the
+ * inliner clones at each call site are stored once. Entries are immutable and
+ * referenced by their index, which is assigned in the order in which
+ * positions are first interned.
+ */
+class PositionTable final {
+ public:
+  struct Entry {
+    DexString* method;
+    DexString* file;
+    uint32_t line;
+    // The index of the parent entry, or NO_PARENT.
+    uint32_t parent;
+
+    bool operator==(const Entry& that) const {
+      return method == that.method && file == that.file &&
+             line == that.line && parent == that.parent;
+    }
+  };
+
+  static constexpr uint32_t NO_PARENT = std::numeric_limits<uint32_t>::max();
+
+  // Interns the position and its parent chain, and returns its index.
+  uint32_t intern(const DexPosition* pos);
+
+  const Entry& at(uint32_t index) const { return m_entries.at(index); }
+
+  size_t size() const { return m_entries.size(); }
+
+ private:
+  struct EntryHash {
+    size_t operator()(const Entry& entry) const;
+  };
+
+  std::vector<Entry> m_entries;
+  std::unordered_map<Entry, uint32_t, EntryHash> m_indices;
+  // Positions that have been interned already, so that their parent chains
+  // are only walked once.
+  std::unordered_map<const DexPosition*, uint32_t> m_interned;
+};
+
 class PositionMapper {
  public:
   virtual ~PositionMapper(){};
@@ -54,11 +102,14 @@ class PositionMapper {
  */
 class RealPositionMapper : public PositionMapper {
   std::string m_filename_v2;
-  std::vector<DexPosition*> m_positions;
-  std::unordered_map<DexPosition*, int64_t> m_pos_line_map;
+  PositionTable m_table;
+  // The table indices of the positions in the order of their lines in the
+  // map, and the line of each table entry that has one.
+  std::vector<uint32_t> m_positions;
+  std::vector<int64_t> m_lines;
 
  protected:
-  uint32_t get_line(DexPosition*);
+  uint32_t get_line(uint32_t index);
   void write_map_v2();
 
  public:
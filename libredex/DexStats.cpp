@@ -34,6 +34,8 @@ dex_stats_t& operator+=(dex_stats_t& lhs, const dex_stats_t& rhs) {
   lhs.num_dbg_items += rhs.num_dbg_items;
   lhs.dbg_total_size += rhs.dbg_total_size;
   lhs.instruction_bytes += rhs.instruction_bytes;
+  lhs.num_hot_code_items += rhs.num_hot_code_items;
+  lhs.num_hot_code_pages += rhs.num_hot_code_pages;
 
   lhs.header_item_count += rhs.header_item_count;
   lhs.header_item_bytes += rhs.header_item_bytes;
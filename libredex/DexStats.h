@@ -41,6 +41,11 @@ struct dex_stats_t {
 
   int instruction_bytes = 0;
 
+  // The code items of the methods in the cold start method profile, and the
+  // number of pages they touch.
+  int num_hot_code_items = 0;
+  int num_hot_code_pages = 0;
+
   /* Stats collected from the Map List section of a Dex. */
   int header_item_count = 0;
   int header_item_bytes = 0;
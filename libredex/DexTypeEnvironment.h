@@ -14,6 +14,7 @@
 #include "AbstractDomain.h"
 #include "DexUtil.h"
 #include "FiniteAbstractDomain.h"
+#include "FlatPatriciaTreeMapAbstractEnvironment.h"
 #include "NullnessDomain.h"
 #include "PatriciaTreeMapAbstractEnvironment.h"
 #include "PatriciaTreeSet.h"
@@ -359,10 +360,11 @@ class DexTypeDomain
 
 /*
  * We model the register to DexTypeDomain mapping using an Environment. A
- * write to a register always overwrites the existing mapping.
+ * write to a register always overwrites the existing mapping. Most methods use
+ * only a handful of registers, which a flat environment stores in an array.
  */
 using RegTypeEnvironment =
-    sparta::PatriciaTreeMapAbstractEnvironment<reg_t, DexTypeDomain>;
+    sparta::FlatPatriciaTreeMapAbstractEnvironment<reg_t, DexTypeDomain>;
 
 /*
  * We model the field to DexTypeDomain mapping using an Environment. But we
@@ -5,6 +5,8 @@
  * LICENSE file in the root directory of this source tree.
  */
 
+#pragma once
+
 #include <boost/optional/optional.hpp>
 #include <unordered_map>
 
@@ -69,7 +71,7 @@ class SimpleFastDominators {
   NodeId get_idom(NodeId node) const { return m_idoms.at(node); }
 
   // Find the common dominator block that is closest to both blocks.
-  NodeId intersect(NodeId finger1, NodeId finger2) {
+  NodeId intersect(NodeId finger1, NodeId finger2) const {
     while (finger1 != finger2) {
       while (m_postorder_map.at(finger1) < m_postorder_map.at(finger2)) {
         finger1 = m_idoms.at(finger1);
@@ -82,28 +82,50 @@ NonZeroWrittenFields analyze_non_zero_writes(const Scope& scope) {
                               concurrent_non_zero_written_fields.end());
 }
 
-FieldStatsMap analyze(const Scope& scope) {
-  FieldStatsMap field_stats;
-  // Gather the read/write counts.
-  walk::opcodes(scope, [&](const DexMethod* method, const IRInstruction* insn) {
-    auto op = insn->opcode();
-    if (!insn->has_field()) {
-      return;
-    }
-    auto field = resolve_field(insn->get_field());
-    if (field == nullptr) {
-      return;
-    }
-    if (is_sget(op) || is_iget(op)) {
-      ++field_stats[field].reads;
-      if (!is_own_init(field, method)) {
-        ++field_stats[field].reads_outside_init;
-      }
-    } else if (is_sput(op) || is_iput(op)) {
-      ++field_stats[field].writes;
+namespace {
+
+struct MergeFieldStats {
+  void operator()(const FieldStatsMap& addend,
+                  FieldStatsMap* accumulator) const {
+    for (const auto& pair : addend) {
+      (*accumulator)[pair.first] += pair.second;
     }
-  });
-  return field_stats;
+  }
+};
+
+} // namespace
+
+FieldStatsMap analyze(const Scope& scope) {
+  // Gather the read/write counts. Each worker counts into its own map, and
+  // the maps are merged at the end.
+  return walk::parallel::methods<FieldStatsMap, MergeFieldStats>(
+      scope, [](DexMethod* method, FieldStatsMap* field_stats) {
+        auto code = method->get_code();
+        if (code == nullptr) {
+          return;
+        }
+        editable_cfg_adapter::iterate(code, [&](MethodItemEntry& mie) {
+          auto insn = mie.insn;
+          auto op = insn->opcode();
+          if (!insn->has_field()) {
+            return editable_cfg_adapter::LOOP_CONTINUE;
+          }
+          auto field = resolve_field(insn->get_field());
+          if (field == nullptr) {
+            return editable_cfg_adapter::LOOP_CONTINUE;
+          }
+          if (is_sget(op) || is_iget(op)) {
+            auto& stats = (*field_stats)[field];
+            ++stats.reads;
+            if (!is_own_init(field, method)) {
+              ++stats.reads_outside_init;
+            }
+          } else if (is_sput(op) || is_iput(op)) {
+            ++(*field_stats)[field].writes;
+          }
+          return editable_cfg_adapter::LOOP_CONTINUE;
+        });
+      });
 }
 
 } // namespace field_op_tracker
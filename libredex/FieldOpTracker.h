@@ -21,6 +21,13 @@ struct FieldStats {
   size_t reads_outside_init{0};
   // Number of instructions which write a field in the entire program.
   size_t writes{0};
+
+  FieldStats& operator+=(const FieldStats& that) {
+    reads += that.reads;
+    reads_outside_init += that.reads_outside_init;
+    writes += that.writes;
+    return *this;
+  }
 };
 
 using FieldStatsMap = std::unordered_map<DexField*, FieldStats>;
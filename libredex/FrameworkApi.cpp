@@ -16,10 +16,15 @@ bool FrameworkAPI::has_method(const std::string& simple_deobfuscated_name,
                               DexProto* meth_proto,
                               DexAccessFlags meth_access_flags,
                               bool relax_access_flags_matching) const {
+  // The names are interned, so when no string of that name exists, no method
+  // has it, and otherwise the names compare as pointers.
+  auto* name = DexString::get_string(simple_deobfuscated_name);
+  if (name == nullptr) {
+    return false;
+  }
   for (const MRefInfo& mref_info : mrefs_info) {
     auto* mref = mref_info.mref;
-    if (mref->get_proto() != meth_proto ||
-        mref->get_name()->str() != simple_deobfuscated_name) {
+    if (mref->get_proto() != meth_proto || mref->get_name() != name) {
       continue;
     }
 
@@ -104,8 +109,8 @@ void AndroidSDK::load_framework_classes() {
                                             DexAccessFlags(f_access_flags));
     }
 
-    auto& map_entry = m_framework_classes[framework_api.cls];
-    map_entry = std::move(framework_api);
+    auto type = framework_api.cls;
+    m_framework_classes.emplace(type, std::move(framework_api));
   }
 }
 
@@ -52,7 +52,8 @@ class AndroidSDK {
     }
   }
 
-  std::unordered_map<DexType*, FrameworkAPI> get_framework_classes() {
+  const std::unordered_map<DexType*, FrameworkAPI>& get_framework_classes()
+      const {
     return m_framework_classes;
   }
 
@@ -59,6 +59,7 @@ void GlobalConfig::bind_config() {
   std::string string_param;
   std::vector<std::string> string_vector_param;
   uint32_t uint32_param;
+  Json::Value json_param;
   // Sorted alphabetically
   bind("agg_method_stats_file", "", string_param);
   bind("android_sdk_api_16_file", "", string_param);
@@ -73,6 +74,7 @@ void GlobalConfig::bind_config() {
   bind("android_sdk_api_28_file", "", string_param);
   bind("android_sdk_api_29_file", "", string_param);
   bind("bytecode_sort_mode", {}, string_vector_param);
+  bind("call_graph_profile_file", "", string_param);
   bind("coldstart_classes", "", string_param);
   bind("compute_xml_reachability", false, bool_param);
   bind("debug_info_kind", "", string_param);
@@ -90,9 +92,11 @@ void GlobalConfig::bind_config() {
   bind("keep_packages", {}, string_vector_param);
   bind("legacy_reflection_reachability", false, bool_param);
   bind("lower_with_cfg", {}, bool_param);
+  bind("method_profile_weights", Json::Value(), json_param);
   bind("method_sorting_whitelisted_substrings", {}, string_vector_param);
   bind("no_optimizations_annotations", {}, string_vector_param);
   bind("opt_decisions", OptDecisionsConfig(), opt_decisions_param);
+  bind("pack_hot_code_items", false, bool_param);
   bind("profiled_methods_file", "", string_param);
   bind("proguard_map", "", string_param);
   bind("prune_unexported_components", {}, string_vector_param);
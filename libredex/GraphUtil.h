@@ -7,7 +7,11 @@
 
 #pragma once
 
+#include <algorithm>
+#include <cstdint>
+#include <limits>
 #include <unordered_map>
+#include <utility>
 #include <vector>
 
 #include "Debug.h"
@@ -58,4 +62,65 @@ std::vector<typename GraphInterface::NodeId> postorder_sort(
   return postorder;
 }
 
+/*
+ * Iterative implementation of Tarjan's algorithm, over a graph whose nodes are
+ * numbered from 0 to successors.size() - 1. Every component is returned after
+ * all the components that it can reach, i.e. in reverse topological order.
+ */
+inline std::vector<std::vector<uint32_t>> strongly_connected_components(
+    const std::vector<std::vector<uint32_t>>& successors) {
+  constexpr uint32_t NONE = std::numeric_limits<uint32_t>::max();
+  const auto n = static_cast<uint32_t>(successors.size());
+  std::vector<uint32_t> order(n, NONE);
+  std::vector<uint32_t> low(n);
+  std::vector<bool> on_stack(n, false);
+  std::vector<uint32_t> stack;
+  // The nodes being visited, with the index of their next successor.
+  std::vector<std::pair<uint32_t, size_t>> call_stack;
+  std::vector<std::vector<uint32_t>> components;
+  uint32_t counter = 0;
+  auto visit = [&](uint32_t v) {
+    order[v] = low[v] = counter++;
+    stack.push_back(v);
+    on_stack[v] = true;
+    call_stack.emplace_back(v, 0);
+  };
+  for (uint32_t root = 0; root < n; ++root) {
+    if (order[root] != NONE) {
+      continue;
+    }
+    visit(root);
+    while (!call_stack.empty()) {
+      auto v = call_stack.back().first;
+      auto i = call_stack.back().second++;
+      if (i < successors[v].size()) {
+        auto w = successors[v][i];
+        if (order[w] == NONE) {
+          visit(w);
+        } else if (on_stack[w]) {
+          low[v] = std::min(low[v], order[w]);
+        }
+        continue;
+      }
+      call_stack.pop_back();
+      if (!call_stack.empty()) {
+        auto& parent_low = low[call_stack.back().first];
+        parent_low = std::min(parent_low, low[v]);
+      }
+      if (low[v] != order[v]) {
+        continue;
+      }
+      components.emplace_back();
+      uint32_t w;
+      do {
+        w = stack.back();
+        stack.pop_back();
+        on_stack[w] = false;
+        components.back().push_back(w);
+      } while (w != v);
+    }
+  }
+  return components;
+}
+
 } // namespace graph
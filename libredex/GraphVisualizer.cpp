@@ -16,6 +16,7 @@
 #include "ControlFlow.h"
 #include "Debug.h"
 #include "IRCode.h"
+#include "WorkQueue.h"
 
 // The "Hotspot Client Compiler Visualizer" (c1visualizer) is a tool consuming
 // Hotspot C1 compiler debug info to display control flow graphs of compilation
@@ -629,7 +630,9 @@ std::vector<DexMethod*> get_all_methods(DexClass* klass) {
 // the CFG did not change.
 MethodCFGStream::MethodCFGStream(DexMethod* m) : m_method(m) {
   m_orig_name = vshow(m, false);
-  print_compilation_header(m_ss, m_orig_name, m_orig_name);
+  std::ostringstream header;
+  print_compilation_header(header, m_orig_name, m_orig_name);
+  m_output = header.str();
 }
 
 void MethodCFGStream::add_pass(const std::string& pass_name,
@@ -662,15 +665,16 @@ void MethodCFGStream::add_pass(const std::string& pass_name,
   }
 
   std::string new_pass = tmp.str();
-  if (new_pass != m_last || !(o & SKIP_NO_CHANGE)) {
-    m_last = new_pass;
+  auto new_hash = std::hash<std::string>()(new_pass);
+  if (new_hash != m_last_hash || !(o & SKIP_NO_CHANGE)) {
+    m_last_hash = new_hash;
 
     // Replace pass name.
     auto pos = new_pass.find(FAKE_PASS_NAME);
     redex_assert(pos != std::string::npos);
     new_pass.replace(pos, strlen(FAKE_PASS_NAME), pass_name);
 
-    m_ss << new_pass;
+    m_output += new_pass;
   }
 }
 
@@ -681,6 +685,13 @@ ClassCFGStream::ClassCFGStream(DexClass* klass) : m_class(klass) {
 }
 
 void ClassCFGStream::add_pass(const std::string& pass_name, Options o) {
+  for (const auto& method_pass : prepare_pass(o)) {
+    method_pass.add(pass_name);
+  }
+}
+
+std::vector<ClassCFGStream::MethodPass> ClassCFGStream::prepare_pass(
+    Options o) {
   auto all_methods = get_all_methods(m_class);
   for (auto& m : m_methods) {
     auto it = std::find(all_methods.begin(), all_methods.end(), m.method);
@@ -694,17 +705,22 @@ void ClassCFGStream::add_pass(const std::string& pass_name, Options o) {
     m_methods.push_back(MethodState{method, MethodCFGStream(method), false});
   }
 
+  std::vector<MethodPass> method_passes;
+  method_passes.reserve(m_methods.size());
   for (auto& m : m_methods) {
-    m.stream.add_pass(pass_name,
-                      (Options)(o | (!m.removed ? Options::PRINT_CODE : 0)),
-                      m.removed ? optional<std::string>("REMOVED ")
-                                : boost::none);
+    method_passes.push_back(
+        MethodPass{&m.stream,
+                   (Options)(o | (!m.removed ? Options::PRINT_CODE : 0)),
+                   m.removed ? optional<std::string>("REMOVED ")
+                             : boost::none});
   }
+  return method_passes;
 }
 
 void ClassCFGStream::write(std::ostream& os) const {
   for (auto& m : m_methods) {
-    os << m.stream.get_output();
+    const auto& output = m.stream.get_output();
+    os.write(output.data(), output.size());
   }
 }
 
@@ -742,9 +758,21 @@ void Classes::add(DexClass* klass) {
 }
 
 void Classes::add_pass(const std::string& pass_name, Options o) {
+  std::vector<ClassCFGStream::MethodPass> method_passes;
   for (auto& class_cfg : m_class_cfgs) {
-    class_cfg.add_pass(pass_name, o);
-  }
+    auto class_passes = class_cfg.prepare_pass(o);
+    method_passes.insert(method_passes.end(), class_passes.begin(),
+                         class_passes.end());
+  }
+  // Each method has its own stream, so they are printed in parallel.
+  auto wq = workqueue_foreach<const ClassCFGStream::MethodPass*>(
+      [&pass_name](const ClassCFGStream::MethodPass* method_pass) {
+        method_pass->add(pass_name);
+      });
+  for (const auto& method_pass : method_passes) {
+    wq.add_item(&method_pass);
+  }
+  wq.run_all();
   if (m_write_after_each_pass) {
     write();
   }
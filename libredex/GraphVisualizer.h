@@ -56,13 +56,14 @@ class MethodCFGStream {
                 Options o = (Options)(SKIP_NO_CHANGE | PRINT_CODE),
                 const optional<std::string>& prefix_block = boost::none);
 
-  std::string get_output() const { return m_ss.str(); }
+  const std::string& get_output() const { return m_output; }
 
  private:
   DexMethod* m_method;
   std::string m_orig_name;
-  std::string m_last;
-  std::stringstream m_ss;
+  // Hash of the last pass, to tell whether the method changed.
+  size_t m_last_hash{0};
+  std::string m_output;
 };
 
 // A wrapper managing CFG streams of all methods in a class. Detects when
@@ -77,10 +78,25 @@ class ClassCFGStream {
   };
 
  public:
+  // A pass of one method, which can be added independently of the others.
+  struct MethodPass {
+    MethodCFGStream* stream;
+    Options options;
+    optional<std::string> prefix_block;
+
+    void add(const std::string& pass_name) const {
+      stream->add_pass(pass_name, options, prefix_block);
+    }
+  };
+
   explicit ClassCFGStream(DexClass* klass);
 
   void add_pass(const std::string& pass_name, Options o = SKIP_NO_CHANGE);
 
+  // Tracks the added and removed methods, and returns the passes to add for
+  // all methods.
+  std::vector<MethodPass> prepare_pass(Options o = SKIP_NO_CHANGE);
+
   void write(std::ostream& os) const;
 
  private:
@@ -8,13 +8,15 @@
 #include "IODIMetadata.h"
 
 #include "DexUtil.h"
+#include "Show.h"
 #include "Trace.h"
+#include "WorkQueue.h"
 
 namespace {
-// Returns com.foo.Bar. for the DexClass Lcom/foo/Bar;. Note the trailing
+// Returns com.foo.Bar. for the DexType Lcom/foo/Bar;. Note the trailing
 // '.'.
-std::string pretty_prefix_for_cls(const DexClass* cls) {
-  std::string pretty_name = java_names::internal_to_external(cls->str());
+std::string pretty_prefix_for_type(const DexType* type) {
+  std::string pretty_name = java_names::internal_to_external(type->str());
   // Include the . separator
   pretty_name.push_back('.');
   return pretty_name;
@@ -30,48 +32,80 @@ void IODIMetadata::mark_methods(DexStoresVector& scope) {
   // offsets in stack traces, then we cannot leverage proguard mappings anymore,
   // so we must disable IODI for any methods whose stack trace may be ambiguous.
   //
-  // We do this linearly for now because otherwise we need locks
-
-  auto emplace_entry = [&](const std::string& str, DexMethod* m) {
-    auto iter = m_iodi_methods.find(str);
-    if (iter != m_iodi_methods.end()) {
-      auto name_iter = m_method_to_name.find(iter->second);
-      if (name_iter != m_method_to_name.end()) {
-        m_method_to_name.erase(name_iter);
-      }
-      iter->second = nullptr;
-    } else {
-      m_iodi_methods.emplace(str, m);
-      m_method_to_name.emplace(m, str);
-    }
-  };
+  // Stack trace names are the external name of the class followed by the
+  // name of the method. Neither can contain a '.', so two methods collide
+  // exactly when they have the same class and the same interned name. Classes
+  // are grouped by type, which only merges the rare duplicate classes, and
+  // the groups are then checked in parallel.
+  std::vector<std::vector<const DexClass*>> groups;
+  std::vector<uint32_t> group_base_ids;
+  std::unordered_map<const DexType*, size_t> group_of_type;
+  uint32_t num_methods = 0;
   for (auto& store : scope) {
     for (auto& classes : store.get_dexen()) {
       for (auto& cls : classes) {
-        auto pretty_prefix = pretty_prefix_for_cls(cls);
-        // First we need to mark all entries...
-        for (DexMethod* m : cls->get_dmethods()) {
-          emplace_entry(pretty_prefix + m->str(), m);
-        }
-        for (DexMethod* m : cls->get_vmethods()) {
-          emplace_entry(pretty_prefix + m->str(), m);
+        auto p = group_of_type.emplace(cls->get_type(), groups.size());
+        if (p.second) {
+          groups.emplace_back();
         }
+        groups[p.first->second].push_back(cls);
       }
     }
   }
-  for (auto it = m_iodi_methods.begin(); it != m_iodi_methods.end();) {
-    if (it->second == nullptr) {
-      TRACE(IODI, 3, "[IODI] Method cannot use IODI due to name collisions: %s",
-            it->first.c_str());
-      it = m_iodi_methods.erase(it);
-    } else {
-      it++;
+  group_base_ids.reserve(groups.size());
+  for (const auto& group : groups) {
+    group_base_ids.push_back(num_methods);
+    for (auto cls : group) {
+      num_methods += cls->get_dmethods().size() + cls->get_vmethods().size();
     }
   }
+
+  m_methods.assign(num_methods, nullptr);
+  // std::vector<bool> packs its bits, so the groups write into bytes first.
+  std::vector<uint8_t> unique_names(num_methods, 0);
+  auto wq = workqueue_foreach<size_t>([&](size_t g) {
+    uint32_t id = group_base_ids[g];
+    std::unordered_map<const DexString*, uint32_t> name_counts;
+    for (auto cls : groups[g]) {
+      for (const auto* methods : {&cls->get_dmethods(), &cls->get_vmethods()}) {
+        for (DexMethod* m : *methods) {
+          m_methods[id++] = m;
+          ++name_counts[m->get_name()];
+        }
+      }
+    }
+    uint32_t end = id;
+    for (id = group_base_ids[g]; id < end; ++id) {
+      auto m = m_methods[id];
+      unique_names[id] = name_counts.at(m->get_name()) == 1;
+      if (!unique_names[id]) {
+        TRACE(IODI, 3,
+              "[IODI] Method cannot use IODI due to name collisions: %s",
+              SHOW(m));
+      }
+    }
+  });
+  for (size_t g = 0; g < groups.size(); ++g) {
+    wq.add_item(g);
+  }
+  wq.run_all();
+
+  m_unique_names.assign(unique_names.begin(), unique_names.end());
+  m_method_ids.reserve(num_methods);
+  for (uint32_t id = 0; id < num_methods; ++id) {
+    m_method_ids.emplace(m_methods[id], id);
+  }
+  m_huge_methods.reset(new std::atomic<bool>[num_methods]);
+  for (uint32_t id = 0; id < num_methods; ++id) {
+    m_huge_methods[id].store(false, std::memory_order_relaxed);
+  }
 }
 
 void IODIMetadata::mark_method_huge(const DexMethod* method) {
-  m_huge_methods.insert(method);
+  auto it = m_method_ids.find(method);
+  if (it != m_method_ids.end()) {
+    m_huge_methods[it->second].store(true, std::memory_order_relaxed);
+  }
 }
 
 // Returns whether we can symbolicate using IODI for the given method.
@@ -81,25 +115,14 @@ bool IODIMetadata::can_safely_use_iodi(const DexMethod* method) const {
   //
   // It turns out for some methods using IODI isn't beneficial. See
   // comment in emit_instruction_offset_debug_info for more info.
-  if (m_huge_methods.count(method) > 0) {
+  auto it = m_method_ids.find(method);
+  if (it == m_method_ids.end()) {
+    TRACE(IODI, 4, "[IODI] Warning: didn't find %s in pretty map in %s",
+          SHOW(method), __PRETTY_FUNCTION__);
     return false;
   }
-
-  std::string pretty_name;
-  {
-    auto iter = m_method_to_name.find(method);
-    if (iter == m_method_to_name.end()) {
-      TRACE(IODI, 4, "[IODI] Warning: didn't find %s in pretty map in %s",
-            SHOW(method), __PRETTY_FUNCTION__);
-      auto cls = type_class(method->get_class());
-      always_assert(cls);
-      pretty_name = pretty_prefix_for_cls(cls);
-      pretty_name += method->str();
-    } else {
-      pretty_name = iter->second;
-    }
-  }
-  return m_iodi_methods.find(pretty_name) != m_iodi_methods.end();
+  return m_unique_names[it->second] &&
+         !m_huge_methods[it->second].load(std::memory_order_relaxed);
 }
 
 void IODIMetadata::write(
@@ -153,20 +176,26 @@ void IODIMetadata::write(
   uint32_t count = 0;
   uint32_t huge_count = 0;
 
-  for (const auto& it : m_iodi_methods) {
-    if (!can_safely_use_iodi(it.second)) {
+  for (uint32_t id = 0; id < m_methods.size(); ++id) {
+    if (!m_unique_names[id]) {
+      continue;
+    }
+    if (m_huge_methods[id].load(std::memory_order_relaxed)) {
       // This will occur if at some point a method was marked as huge during
       // encoding.
       huge_count += 1;
       continue;
     }
+    auto method = m_methods[id];
+    auto name = pretty_prefix_for_type(method->get_class());
+    name += method->str();
     count += 1;
     always_assert_log(count != 0, "Too many entries found, overflowed");
-    always_assert(it.first.size() < UINT16_MAX);
-    entry_hdr.klen = it.first.size();
-    entry_hdr.method_id = method_to_id.at(const_cast<DexMethod*>(it.second));
+    always_assert(name.size() < UINT16_MAX);
+    entry_hdr.klen = name.size();
+    entry_hdr.method_id = method_to_id.at(const_cast<DexMethod*>(method));
     ofs.write((const char*)&entry_hdr, sizeof(EntryHeader));
-    ofs << it.first;
+    ofs << name;
   }
   // Rewind and write the header now that we know single/dup counts
   ofs.seekp(0);
@@ -7,6 +7,8 @@
 
 #pragma once
 
+#include <atomic>
+#include <memory>
 #include <unordered_map>
 
 #include "DexClass.h"
@@ -34,12 +36,13 @@ class IODIMetadata {
   // invoke the methods below.
   IODIMetadata() {}
 
-  // This fills the internal map of stack trace name -> method. This must be
+  // This finds the methods whose stack trace name is unique. This must be
   // called after the last pass and before anything starts to get lowered.
   void mark_methods(DexStoresVector& scope);
 
   // This is called while lowering to dex to note that a method has been
-  // determined to be too big for a given dex.
+  // determined to be too big for a given dex. It may be called concurrently
+  // with itself and can_safely_use_iodi, e.g. while writing several dexes.
   void mark_method_huge(const DexMethod* method);
 
   // Returns whether we can symbolicate using IODI for the given method.
@@ -54,8 +57,13 @@ class IODIMetadata {
   void write(std::ostream& ofs, const MethodToIdMap& method_to_id);
 
  private:
-  std::unordered_map<std::string, const DexMethod*> m_iodi_methods;
-  // These exists for can_safely_use_iodi
-  std::unordered_map<const DexMethod*, std::string> m_method_to_name;
-  std::unordered_set<const DexMethod*> m_huge_methods;
+  // The methods of the stores, by dense id, in the order of the stores.
+  std::vector<const DexMethod*> m_methods;
+  std::unordered_map<const DexMethod*, uint32_t> m_method_ids;
+  // Whether the stack trace name of each method is unique. These are only
+  // written by mark_methods.
+  std::vector<bool> m_unique_names;
+  // Whether each method was marked huge; atomic so that dexes may be written
+  // concurrently.
+  std::unique_ptr<std::atomic<bool>[]> m_huge_methods;
 };
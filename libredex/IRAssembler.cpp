@@ -836,8 +836,7 @@ std::unique_ptr<IRCode> ircode_from_s_expr(const s_expr& e) {
 }
 
 std::unique_ptr<IRCode> ircode_from_string(const std::string& s) {
-  std::istringstream input(s);
-  s_expr_istream s_expr_input(input);
+  s_expr_parser s_expr_input(s);
   s_expr expr;
   while (s_expr_input.good()) {
     s_expr_input >> expr;
@@ -885,8 +884,7 @@ DexMethod* method_from_s_expr(const s_expr& e) {
 }
 
 DexMethod* method_from_string(const std::string& s) {
-  std::istringstream input(s);
-  s_expr_istream s_expr_input(input);
+  s_expr_parser s_expr_input(s);
   s_expr expr;
   while (s_expr_input.good()) {
     s_expr_input >> expr;
@@ -601,6 +601,9 @@ IRCode::IRCode(const IRCode& code) {
 void IRCode::cleanup_debug() { m_ir_list->cleanup_debug(); }
 
 void IRCode::build_cfg(bool editable) {
+  if (editable && editable_cfg_built()) {
+    return;
+  }
   clear_cfg();
   m_cfg = std::make_unique<cfg::ControlFlowGraph>(
       m_ir_list, m_registers_size, editable);
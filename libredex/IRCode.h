@@ -152,6 +152,9 @@ class IRCode {
   //    MethodItemEntries taken from IRCode)
   // Changes to an editable CFG are reflected in IRCode after `clear_cfg` is
   // called
+  //  * Building an editable CFG when one is already built keeps it, since
+  //    passes may leave the code in editable CFG form (see
+  //    `Pass::is_cfg_legal`)
   void build_cfg(bool editable = true);
 
   // if the cfg was editable, linearize it back into m_ir_list
@@ -10,37 +10,33 @@
 #include "DexClass.h"
 #include "DexUtil.h"
 
+#include <algorithm>
 #include <boost/range/any_range.hpp>
 #include <cstring>
 #include <iterator>
 
 IRInstruction::IRInstruction(IROpcode op) : m_opcode(op) {
   auto count = opcode_impl::min_srcs_size(op);
-  if (count <= MAX_NUM_INLINE_SRCS) {
-    m_num_inline_srcs = count;
-  } else {
-    m_num_inline_srcs = MAX_NUM_INLINE_SRCS + 1;
-    m_srcs = new std::vector<reg_t>(count);
+  m_num_srcs = count;
+  if (!has_inline_srcs()) {
+    m_srcs = new reg_t[count]();
   }
 }
 
 IRInstruction::IRInstruction(const IRInstruction& other)
     : m_opcode(other.m_opcode),
-      m_num_inline_srcs(other.m_num_inline_srcs),
+      m_num_srcs(other.m_num_srcs),
       m_dest(other.m_dest),
       m_literal(other.m_literal) {
-  if (m_num_inline_srcs <= MAX_NUM_INLINE_SRCS) {
-    for (auto i = 0; i < m_num_inline_srcs; ++i) {
-      m_inline_srcs[i] = other.m_inline_srcs[i];
-    }
-  } else {
-    m_srcs = new std::vector<reg_t>(*other.m_srcs);
+  if (!has_inline_srcs()) {
+    m_srcs = new reg_t[m_num_srcs];
   }
+  std::copy_n(other.srcs_data(), m_num_srcs, srcs_data());
 }
 
 IRInstruction::~IRInstruction() {
-  if (m_num_inline_srcs > MAX_NUM_INLINE_SRCS) {
-    delete m_srcs;
+  if (!has_inline_srcs()) {
+    delete[] m_srcs;
   }
 }
 
@@ -48,100 +44,59 @@ IRInstruction::~IRInstruction() {
 // because they are unknown until we sync back to DexInstructions.
 bool IRInstruction::operator==(const IRInstruction& that) const {
   bool simple_fields_match =
-      m_opcode == that.m_opcode &&
-      m_num_inline_srcs == that.m_num_inline_srcs && m_dest == that.m_dest &&
+      m_opcode == that.m_opcode && m_num_srcs == that.m_num_srcs &&
+      m_dest == that.m_dest &&
       m_literal == that.m_literal; // just test one member of the union
   if (!simple_fields_match) {
     return false;
   }
-  // Check the source registers union
-  if (m_num_inline_srcs <= MAX_NUM_INLINE_SRCS) {
-    for (auto i = 0; i < m_num_inline_srcs; ++i) {
-      if (m_inline_srcs[i] != that.m_inline_srcs[i]) {
-        return false;
-      }
-    }
-    return true;
-  } else {
-    return *m_srcs == *that.m_srcs;
-  }
+  return std::equal(srcs_data(), srcs_data() + m_num_srcs, that.srcs_data());
 }
 
-reg_t IRInstruction::src(size_t i) const {
-  if (m_num_inline_srcs <= MAX_NUM_INLINE_SRCS) {
-    always_assert(i < m_num_inline_srcs);
-    return m_inline_srcs[i];
-  }
-  return m_srcs->at(i);
+std::vector<reg_t> IRInstruction::srcs_vec() const {
+  return std::vector<reg_t>(srcs_data(), srcs_data() + m_num_srcs);
 }
 
-IRInstruction::reg_range IRInstruction::srcs() const {
-  if (m_num_inline_srcs <= MAX_NUM_INLINE_SRCS) {
-    const reg_t* begin = std::begin(m_inline_srcs);
-    const reg_t* end = begin + m_num_inline_srcs;
-    return reg_range(begin, end);
-  }
-  const reg_t* begin = m_srcs->data();
-  const reg_t* end = begin + m_srcs->size();
-  return reg_range(begin, end);
+IRInstruction* IRInstruction::set_src(size_t i, reg_t reg) {
+  always_assert(i < m_num_srcs);
+  srcs_data()[i] = reg;
+  return this;
 }
 
-std::vector<reg_t> IRInstruction::srcs_vec() const {
-  std::vector<reg_t> result;
-  result.reserve(srcs_size());
-  for (reg_t src : srcs()) {
-    result.push_back(src);
+IRInstruction* IRInstruction::set_srcs_size(uint16_t count) {
+  if (count == m_num_srcs) {
+    return this;
   }
-  return result;
-}
-
-IRInstruction* IRInstruction::set_src(size_t i, reg_t reg) {
-  if (m_num_inline_srcs <= MAX_NUM_INLINE_SRCS) {
-    always_assert(i < m_num_inline_srcs);
-    m_inline_srcs[i] = reg;
+  if (has_inline_srcs() && count <= MAX_NUM_INLINE_SRCS) {
+    // staying in the inline state
+    m_num_srcs = count;
+    return this;
+  }
+  // The new registers are zero-initialized.
+  reg_t srcs[MAX_NUM_INLINE_SRCS] = {0};
+  reg_t* new_srcs = count <= MAX_NUM_INLINE_SRCS ? srcs : new reg_t[count]();
+  std::copy_n(srcs_data(), std::min(count, m_num_srcs), new_srcs);
+  if (!has_inline_srcs()) {
+    delete[] m_srcs;
+  }
+  m_num_srcs = count;
+  if (has_inline_srcs()) {
+    std::copy_n(srcs, count, m_inline_srcs);
   } else {
-    m_srcs->at(i) = reg;
+    m_srcs = new_srcs;
   }
   return this;
 }
 
-size_t IRInstruction::srcs_size() const {
-  if (m_num_inline_srcs <= MAX_NUM_INLINE_SRCS) {
-    return m_num_inline_srcs;
+void IRInstruction::assign_srcs(const reg_t* srcs, uint16_t count) {
+  if (!has_inline_srcs()) {
+    delete[] m_srcs;
   }
-  return m_srcs->size();
-}
-
-IRInstruction* IRInstruction::set_srcs_size(uint16_t count) {
-  if (m_num_inline_srcs <= MAX_NUM_INLINE_SRCS) {
-    if (count <= MAX_NUM_INLINE_SRCS) {
-      // staying in the inline state
-      m_num_inline_srcs = count;
-    } else {
-      // inline regs -> vector
-      auto srcs = new std::vector<reg_t>();
-      srcs->reserve(count);
-      for (auto i = 0; i < m_num_inline_srcs; ++i) {
-        srcs->push_back(m_inline_srcs[i]);
-      }
-      srcs->resize(count);
-      m_num_inline_srcs = MAX_NUM_INLINE_SRCS + 1;
-      m_srcs = srcs;
-    }
-  } else {
-    if (count <= MAX_NUM_INLINE_SRCS) {
-      // vector -> inline regs
-      auto old_srcs_ptr = m_srcs;
-      m_num_inline_srcs = count;
-      always_assert(count <= old_srcs_ptr->size());
-      std::memcpy(m_inline_srcs, old_srcs_ptr->data(), count * sizeof(reg_t));
-      delete old_srcs_ptr;
-    } else {
-      // staying in the vector state
-      m_srcs->resize(count);
-    }
+  m_num_srcs = count;
+  if (!has_inline_srcs()) {
+    m_srcs = new reg_t[count];
   }
-  return this;
+  std::copy_n(srcs, count, srcs_data());
 }
 
 uint16_t IRInstruction::size() const {
@@ -326,19 +281,7 @@ void IRInstruction::denormalize_registers() {
       }
     }
 
-    // update m_inline_srcs or m_srcs
-    if (m_num_inline_srcs > MAX_NUM_INLINE_SRCS) {
-      delete m_srcs;
-    }
-    if (srcs.size() <= MAX_NUM_INLINE_SRCS) {
-      m_num_inline_srcs = srcs.size();
-      for (size_t i = 0; i < srcs.size(); ++i) {
-        m_inline_srcs[i] = srcs.at(i);
-      }
-    } else {
-      m_num_inline_srcs = MAX_NUM_INLINE_SRCS + 1;
-      m_srcs = new std::vector<reg_t>(std::move(srcs));
-    }
+    assign_srcs(srcs.data(), srcs.size());
   }
 }
 
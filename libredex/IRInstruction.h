@@ -10,6 +10,7 @@
 #include "DexCallSite.h"
 #include "DexInstruction.h"
 #include "DexMethodHandle.h"
+#include "ObjectPool.h"
 #include "Show.h"
 
 #include <boost/range/any_range.hpp>
@@ -126,6 +127,8 @@ class IRInstruction final {
   IRInstruction(const IRInstruction&);
   ~IRInstruction();
 
+  REDEX_POOLED_ALLOCATION(IRInstruction)
+
   /*
    * Ensures that wide registers only have their first register referenced
    * in the srcs list. This only affects invoke-* instructions.
@@ -177,7 +180,7 @@ class IRInstruction final {
    */
   bool has_dest() const { return opcode_impl::has_dest(m_opcode); }
 
-  size_t srcs_size() const;
+  size_t srcs_size() const { return m_num_srcs; }
 
   bool has_move_result_pseudo() const {
     return opcode_impl::has_move_result_pseudo(m_opcode);
@@ -227,7 +230,10 @@ class IRInstruction final {
     always_assert_log(has_dest(), "No dest for %s", SHOW(m_opcode));
     return m_dest;
   }
-  reg_t src(size_t i) const;
+  reg_t src(size_t i) const {
+    always_assert(i < m_num_srcs);
+    return srcs_data()[i];
+  }
 
  private:
   using reg_range_super = boost::iterator_range<const reg_t*>;
@@ -240,7 +246,10 @@ class IRInstruction final {
     using reg_range_super::reg_range_super;
   };
   // Provides a read-only view into the source registers
-  reg_range srcs() const;
+  reg_range srcs() const {
+    const reg_t* begin = srcs_data();
+    return reg_range(begin, begin + m_num_srcs);
+  }
   // Provides a copy of the source registers
   std::vector<reg_t> srcs_vec() const;
 
@@ -402,21 +411,28 @@ class IRInstruction final {
   // 2 is chosen because it's the maximum number of registers (32 bits each) we
   // can fit in the size of a pointer (on a 64bit system).
   // In practice, most IRInstructions have 2 or fewer source registers, so we
-  // can avoid a vector allocation most of the time.
+  // can avoid an allocation most of the time.
   static constexpr uint8_t MAX_NUM_INLINE_SRCS = 2;
 
+  bool has_inline_srcs() const { return m_num_srcs <= MAX_NUM_INLINE_SRCS; }
+
+  const reg_t* srcs_data() const {
+    return has_inline_srcs() ? m_inline_srcs : m_srcs;
+  }
+
+  reg_t* srcs_data() { return has_inline_srcs() ? m_inline_srcs : m_srcs; }
+
+  // Replaces the source registers with the given ones.
+  void assign_srcs(const reg_t* srcs, uint16_t count);
+
   // The fields of IRInstruction are carefully selected and ordered to avoid
   // empty packing bytes and minimize total size. This is optimized for 8 byte
   // alignment on a 64bit system.
 
   IROpcode m_opcode; // 2 bytes
-  // m_num_inline_srcs can take a small set of possible values:
-  //   * 0, ..., MAX_NUM_INLINE_SRCS: the size of the valid section of
-  //     m_inline_srcs
-  //   * MAX_NUM_INLINE_SRCS + 1: indicates that m_srcs should be used, not
-  //     m_inline_srcs
-  uint16_t m_num_inline_srcs{0}; // 2 bytes. Could be 1 byte
-                                 // but extra byte would just be padding
+  // The number of source registers. They are stored in m_inline_srcs if there
+  // are at most MAX_NUM_INLINE_SRCS of them, and in m_srcs otherwise.
+  uint16_t m_num_srcs{0}; // 2 bytes
   reg_t m_dest{0}; // 4 bytes
   // 8 bytes so far
   union {
@@ -433,11 +449,10 @@ class IRInstruction final {
   };
   // 16 bytes so far
   union {
-    // m_num_inline_srcs indicates how to interpret the union. See comment above
+    // m_num_srcs indicates how to interpret the union. See comment above
     reg_t m_inline_srcs[MAX_NUM_INLINE_SRCS] = {0};
-    // Use a pointer here because it's 8 bytes instead of ~24.
-    // Be careful to new and delete it correctly!
-    std::vector<reg_t>* m_srcs;
+    // An array of exactly m_num_srcs registers, allocated with new[].
+    reg_t* m_srcs;
   };
   // 24 bytes total
 };
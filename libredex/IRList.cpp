@@ -241,21 +241,29 @@ opcode::Branchingness MethodItemEntry::branchingness() const {
   }
 }
 
-MethodItemEntryCloner::MethodItemEntryCloner() {
-  m_entry_map[nullptr] = nullptr;
-  m_pos_map[nullptr] = nullptr;
-}
+MethodItemEntryCloner::MethodItemEntryCloner() { m_pos_map[nullptr] = nullptr; }
 
 MethodItemEntry* MethodItemEntryCloner::clone(const MethodItemEntry* mie) {
-
-  const auto& pair = m_entry_map.emplace(mie, nullptr);
-  auto& it = pair.first;
-  bool was_already_there = !pair.second;
-  if (was_already_there) {
-    return it->second;
+  if (mie == nullptr) {
+    return nullptr;
+  }
+
+  // Only remember the entries that other entries can point to, which saves a
+  // map insertion for most entries.
+  MethodItemEntry** memoized = nullptr;
+  if (mie->type == MFLOW_CATCH ||
+      (mie->type == MFLOW_OPCODE && is_branch(mie->insn->opcode()))) {
+    const auto& pair = m_entry_map.emplace(mie, nullptr);
+    bool was_already_there = !pair.second;
+    if (was_already_there) {
+      return pair.first->second;
+    }
+    memoized = &pair.first->second;
   }
   auto cloned_mie = new MethodItemEntry(*mie);
-  it->second = cloned_mie;
+  if (memoized != nullptr) {
+    *memoized = cloned_mie;
+  }
 
   switch (cloned_mie->type) {
   case MFLOW_TRY:
@@ -24,7 +24,7 @@ enum TryEntryType {
 
 std::string show(TryEntryType t);
 
-struct TryEntry {
+struct TryEntry final {
   TryEntryType type;
   MethodItemEntry* catch_start;
   TryEntry(TryEntryType type, MethodItemEntry* catch_start)
@@ -32,15 +32,19 @@ struct TryEntry {
     always_assert(catch_start != nullptr);
   }
 
+  REDEX_POOLED_ALLOCATION(TryEntry)
+
   bool operator==(const TryEntry& other) const;
 };
 
-struct CatchEntry {
+struct CatchEntry final {
   DexType* catch_type;
   MethodItemEntry* next; // always null for catchall
   explicit CatchEntry(DexType* catch_type)
       : catch_type(catch_type), next(nullptr) {}
 
+  REDEX_POOLED_ALLOCATION(CatchEntry)
+
   bool operator==(const CatchEntry& other) const;
 };
 
@@ -68,7 +72,7 @@ enum BranchTargetType {
   BRANCH_MULTI = 1,
 };
 
-struct BranchTarget {
+struct BranchTarget final {
   MethodItemEntry* src;
   BranchTargetType type;
 
@@ -81,6 +85,8 @@ struct BranchTarget {
   BranchTarget(MethodItemEntry* src, int32_t case_key)
       : src(src), type(BRANCH_MULTI), case_key(case_key) {}
 
+  REDEX_POOLED_ALLOCATION(BranchTarget)
+
   bool operator==(const BranchTarget& other) const;
 };
 
@@ -117,7 +123,7 @@ enum MethodItemType {
   MFLOW_FALLTHROUGH,
 };
 
-struct MethodItemEntry {
+struct MethodItemEntry final {
   boost::intrusive::list_member_hook<> list_hook_;
   MethodItemType type;
 
@@ -154,6 +160,10 @@ struct MethodItemEntry {
   explicit MethodItemEntry(std::unique_ptr<DexPosition> pos)
       : type(MFLOW_POSITION), pos(std::move(pos)) {}
 
+  // The entries, instructions and payloads of IRLists are pooled, since there
+  // are so many of them.
+  REDEX_POOLED_ALLOCATION(MethodItemEntry)
+
   bool operator==(const MethodItemEntry&) const;
 
   bool operator!=(const MethodItemEntry& that) const {
@@ -185,7 +195,10 @@ struct MethodItemEntry {
 
 class MethodItemEntryCloner {
   // We need a map of MethodItemEntry we have created because a branch
-  // points to another MethodItemEntry which may have been created or not
+  // points to another MethodItemEntry which may have been created or not.
+  // Only the entries that can be pointed to are in it: the branches, which
+  // are the sources of branch targets, and the catches, which try markers
+  // and other catches point to.
   std::unordered_map<const MethodItemEntry*, MethodItemEntry*> m_entry_map;
   // for remapping the parent position pointers
   std::unordered_map<DexPosition*, DexPosition*> m_pos_map;
@@ -8,84 +8,168 @@
 #include "InlineForSpeed.h"
 
 #include "ControlFlow.h"
+#include "DexInstruction.h"
 #include "IRCode.h"
 #include "MethodProfiles.h"
 #include "Resolver.h"
+#include "WeakTopologicalOrdering.h"
 
+#include <cmath>
+#include <functional>
 #include <queue>
 
 using namespace method_profiles;
 
 constexpr double MIN_APPEAR_PERCENT = 80.0;
 
+// Methods in the top PERCENTILE of call counts will be considered warm/hot.
+constexpr double WARM_PERCENTILE = 0.25;
+constexpr double HOT_PERCENTILE = 0.1;
+
+// Each loop around a call site multiplies its weight, as if it iterated that
+// many times, up to a maximal depth.
+constexpr double LOOP_WEIGHT = 8.0;
+constexpr size_t MAX_LOOP_DEPTH = 3;
+
 void InlineForSpeed::compute_hot_methods() {
   if (m_method_profiles == nullptr || !m_method_profiles->has_stats()) {
     return;
   }
+  if (m_method_profiles->has_weighted_stats()) {
+    const auto& config = m_method_profiles->weighted_stats_config();
+    add_interaction("weighted", m_method_profiles->weighted_stats(),
+                    config.warm_percentile, config.hot_percentile);
+    return;
+  }
   for (const auto& pair : m_method_profiles->all_interactions()) {
-    const std::string& interaction_id = pair.first;
-    const auto& method_stats = pair.second;
-    size_t popular_set_size = 0;
-    for (const auto& entry : method_stats) {
-      if (entry.second.appear_percent >= MIN_APPEAR_PERCENT) {
-        ++popular_set_size;
-      }
+    add_interaction(pair.first, pair.second, WARM_PERCENTILE, HOT_PERCENTILE);
+  }
+}
+
+void InlineForSpeed::add_interaction(const std::string& interaction_id,
+                                     const StatsMap& method_stats,
+                                     double warm_percentile,
+                                     double hot_percentile) {
+  size_t popular_set_size = 0;
+  for (const auto& entry : method_stats) {
+    if (entry.second.appear_percent >= MIN_APPEAR_PERCENT) {
+      ++popular_set_size;
     }
-    // Methods in the top PERCENTILE of call counts will be considered warm/hot.
-    constexpr double WARM_PERCENTILE = 0.25;
-    constexpr double HOT_PERCENTILE = 0.1;
-    // Find the lowest score that is within the given percentile
-    constexpr size_t MIN_SIZE = 1;
-    size_t warm_size = std::max(
-        MIN_SIZE, static_cast<size_t>(popular_set_size * WARM_PERCENTILE));
-    size_t hot_size = std::max(
-        MIN_SIZE, static_cast<size_t>(popular_set_size * HOT_PERCENTILE));
-    // the "top" of the queue is actually the minimum warm/hot score
-    using pq =
-        std::priority_queue<double, std::vector<double>, std::greater<double>>;
-    pq warm_scores;
-    pq hot_scores;
-    auto maybe_push = [](pq& q, size_t size, double value) {
-      if (q.size() < size) {
-        q.push(value);
-      } else if (value > q.top()) {
-        q.push(value);
-        q.pop();
-      }
-    };
-    for (const auto& entry : method_stats) {
-      const auto& stat = entry.second;
-      if (stat.appear_percent >= MIN_APPEAR_PERCENT) {
-        auto score = stat.call_count;
-        maybe_push(warm_scores, warm_size, score);
-        maybe_push(hot_scores, hot_size, score);
-      }
+  }
+  // Find the lowest score that is within the given percentile
+  constexpr size_t MIN_SIZE = 1;
+  size_t warm_size = std::max(
+      MIN_SIZE, static_cast<size_t>(popular_set_size * warm_percentile));
+  size_t hot_size = std::max(
+      MIN_SIZE, static_cast<size_t>(popular_set_size * hot_percentile));
+  // the "top" of the queue is actually the minimum warm/hot score
+  using pq =
+      std::priority_queue<double, std::vector<double>, std::greater<double>>;
+  pq warm_scores;
+  pq hot_scores;
+  auto maybe_push = [](pq& q, size_t size, double value) {
+    if (q.size() < size) {
+      q.push(value);
+    } else if (value > q.top()) {
+      q.push(value);
+      q.pop();
+    }
+  };
+  for (const auto& entry : method_stats) {
+    const auto& stat = entry.second;
+    if (stat.appear_percent >= MIN_APPEAR_PERCENT) {
+      auto score = stat.call_count;
+      maybe_push(warm_scores, warm_size, score);
+      maybe_push(hot_scores, hot_size, score);
     }
-    double min_warm_score = std::max(50.0, warm_scores.top());
-    double min_hot_score = std::max(100.0, hot_scores.top());
-    TRACE(METH_PROF,
-          2,
-          "%s min scores = %f, %f",
-          interaction_id.c_str(),
-          min_warm_score,
-          min_hot_score);
-    std::pair<double, double> p(min_warm_score, min_hot_score);
-    m_min_scores.emplace(interaction_id, std::move(p));
   }
+  if (warm_scores.empty()) {
+    // No method is popular enough to be warm.
+    return;
+  }
+  double min_warm_score = std::max(50.0, warm_scores.top());
+  double min_hot_score = std::max(100.0, hot_scores.top());
+  TRACE(METH_PROF,
+        2,
+        "%s min scores = %f, %f",
+        interaction_id.c_str(),
+        min_warm_score,
+        min_hot_score);
+  m_interactions.emplace(
+      interaction_id,
+      Interaction{&method_stats, min_warm_score, min_hot_score});
 }
 
-InlineForSpeed::InlineForSpeed(const MethodProfiles* method_profiles)
-    : m_method_profiles(method_profiles) {
+InlineForSpeed::InlineForSpeed(
+    const MethodProfiles* method_profiles,
+    const std::unordered_set<const IRInstruction*>* cold_insns)
+    : m_method_profiles(method_profiles), m_cold_insns(cold_insns) {
   compute_hot_methods();
 }
 
+std::unordered_map<const DexMethodRef*, double>
+InlineForSpeed::get_call_site_weights(const DexMethod* caller_method) const {
+  const auto& cfg = caller_method->get_code()->cfg();
+  // The nested components of the weak topological ordering are the loops, as
+  // in LoopInfo, which would also add preheaders to the CFG.
+  sparta::WeakTopologicalOrdering<cfg::Block*> wto(
+      cfg.entry_block(), [](const cfg::Block* block) {
+        std::vector<cfg::Block*> succs;
+        for (auto edge : block->succs()) {
+          succs.emplace_back(edge->target());
+        }
+        return succs;
+      });
+  std::unordered_map<const cfg::Block*, size_t> loop_depths;
+  std::function<void(const sparta::WtoComponent<cfg::Block*>&, size_t)> visit;
+  visit = [&](const sparta::WtoComponent<cfg::Block*>& component,
+              size_t depth) {
+    if (!component.is_scc()) {
+      loop_depths[component.head_node()] = depth;
+      return;
+    }
+    loop_depths[component.head_node()] = depth + 1;
+    for (const auto& inner : component) {
+      visit(inner, depth + 1);
+    }
+  };
+  for (const auto& component : wto) {
+    visit(component, 0);
+  }
+
+  std::unordered_map<const DexMethodRef*, double> weights;
+  for (auto block : cfg.blocks()) {
+    // Unreachable blocks are not in the ordering.
+    auto it = loop_depths.find(block);
+    auto depth = it == loop_depths.end() ? 0 : it->second;
+    auto block_weight = std::pow(LOOP_WEIGHT, std::min(depth, MAX_LOOP_DEPTH));
+    for (const auto& mie : InstructionIterable(block)) {
+      auto insn = mie.insn;
+      if (!is_invoke(insn->opcode())) {
+        continue;
+      }
+      auto callee = resolve_method(insn->get_method(), opcode_to_search(insn));
+      if (callee == nullptr) {
+        continue;
+      }
+      auto weight =
+          m_cold_insns != nullptr && m_cold_insns->count(insn) ? 0.0
+                                                               : block_weight;
+      auto& callee_weight = weights[callee];
+      callee_weight = std::max(callee_weight, weight);
+    }
+  }
+  return weights;
+}
+
 bool InlineForSpeed::enabled() const {
   return m_method_profiles != nullptr && m_method_profiles->has_stats();
 }
 
 bool InlineForSpeed::should_inline(const DexMethod* caller_method,
-                                   const DexMethod* callee_method) const {
-  if (!enabled()) {
+                                   const DexMethod* callee_method,
+                                   double site_weight) const {
+  if (!enabled() || site_weight == 0) {
     return false;
   }
 
@@ -101,11 +185,12 @@ bool InlineForSpeed::should_inline(const DexMethod* caller_method,
   }
 
   // If the pair is hot under any interaction, inline it.
-  for (const auto& pair : m_method_profiles->all_interactions()) {
+  for (const auto& pair : m_interactions) {
     bool should = should_inline_per_interaction(caller_method,
                                                 callee_method,
                                                 caller_insns,
                                                 callee_insns,
+                                                site_weight,
                                                 pair.first,
                                                 pair.second);
     if (should) {
@@ -120,17 +205,19 @@ bool InlineForSpeed::should_inline_per_interaction(
     const DexMethod* callee_method,
     uint32_t caller_insns,
     uint32_t callee_insns,
+    double site_weight,
     const std::string& interaction_id,
-    const StatsMap& method_stats) const {
+    const Interaction& interaction) const {
+  const auto& method_stats = *interaction.method_stats;
   const auto& caller_search = method_stats.find(caller_method);
   if (caller_search == method_stats.end()) {
     return false;
   }
-  const auto& scores = m_min_scores.at(interaction_id);
-  double warm_score = scores.first;
-  double hot_score = scores.second;
+  double warm_score = interaction.min_warm_score;
+  double hot_score = interaction.min_hot_score;
   const auto& caller_stats = caller_search->second;
-  auto caller_hits = caller_stats.call_count;
+  // How often the call site runs, rather than the caller.
+  auto caller_hits = caller_stats.call_count * site_weight;
   auto caller_appears = caller_stats.appear_percent;
   if (caller_hits < warm_score || caller_appears < MIN_APPEAR_PERCENT) {
     return false;
@@ -7,28 +7,65 @@
 
 #pragma once
 
+#include <unordered_map>
+#include <unordered_set>
+
 #include "DexClass.h"
 #include "MethodProfiles.h"
 
 class InlineForSpeed final {
  public:
+  /*
+   * The call sites among cold_insns, the instructions of the blocks that never
+   * ran according to the basic block profiles, are never worth inlining.
+   */
   explicit InlineForSpeed(
-      const method_profiles::MethodProfiles* method_profiles);
+      const method_profiles::MethodProfiles* method_profiles,
+      const std::unordered_set<const IRInstruction*>* cold_insns = nullptr);
+
+  /*
+   * The weight of the hottest call site of each callee in the caller, which
+   * must have an editable CFG: call sites weigh more the deeper they are
+   * nested in loops, and nothing when they are cold.
+   */
+  std::unordered_map<const DexMethodRef*, double> get_call_site_weights(
+      const DexMethod* caller_method) const;
+
+  /*
+   * The hotness of the call site is that of the caller, scaled by the weight
+   * of the call site.
+   */
   bool should_inline(const DexMethod* caller_method,
-                     const DexMethod* callee_method) const;
+                     const DexMethod* callee_method,
+                     double site_weight = 1) const;
 
   bool enabled() const;
 
  private:
+  struct Interaction {
+    const method_profiles::StatsMap* method_stats;
+    double min_warm_score;
+    double min_hot_score;
+  };
+
   void compute_hot_methods();
   bool should_inline_per_interaction(
       const DexMethod* caller_method,
       const DexMethod* callee_method,
       uint32_t caller_insns,
       uint32_t callee_insns,
+      double site_weight,
       const std::string& interaction_id,
-      const method_profiles::StatsMap& method_stats) const;
+      const Interaction& interaction) const;
+
+  void add_interaction(const std::string& interaction_id,
+                       const method_profiles::StatsMap& method_stats,
+                       double warm_percentile,
+                       double hot_percentile);
 
   const method_profiles::MethodProfiles* m_method_profiles;
-  std::map<std::string, std::pair<double, double>> m_min_scores;
+  const std::unordered_set<const IRInstruction*>* m_cold_insns;
+  // The interactions under which a pair may be hot, which are either the
+  // interactions of the profiles, or their weighted combination.
+  std::map<std::string, Interaction> m_interactions;
 };
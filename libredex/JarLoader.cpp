@@ -5,12 +5,18 @@
  * LICENSE file in the root directory of this source tree.
  */
 
+#include <boost/filesystem.hpp>
 #include <boost/iostreams/device/mapped_file.hpp>
 
+#include <algorithm>
+#include <atomic>
 #include <cstdint>
+#include <cstdlib>
+#include <fstream>
+#include <memory>
+#include <unordered_map>
 #include <utility>
 #include <vector>
-#include <zlib.h>
 
 #ifdef _MSC_VER
 #include <Winsock2.h>
@@ -23,8 +29,11 @@
 #include "DexClass.h"
 #include "DuplicateClasses.h"
 #include "JarLoader.h"
+#include "Sha1.h"
 #include "Trace.h"
 #include "Util.h"
+#include "WorkQueue.h"
+#include "ZipReader.h"
 
 /******************
  * Begin Class Loading code.
@@ -69,17 +78,6 @@ struct cp_entry {
     };
   };
 };
-
-struct cp_field_info {
-  uint16_t aflags;
-  uint16_t nameNdx;
-  uint16_t descNdx;
-};
-struct cp_method_info {
-  uint16_t aflags;
-  uint16_t nameNdx;
-  uint16_t descNdx;
-};
 } // namespace
 
 /* clang-format off */
@@ -152,60 +150,75 @@ static void skip_attributes(uint8_t*& buffer) {
   }
 }
 #define MAX_CLASS_NAMELEN (8 * 1024)
-static DexType* make_dextype_from_cref(std::vector<cp_entry>& cpool,
-                                       uint16_t cref) {
-  char nbuffer[MAX_CLASS_NAMELEN];
+
+namespace {
+/*
+ * The parts of a class file that we turn into an external DexClass. This is
+ * also what the jar cache stores.
+ */
+struct jar_member {
+  uint16_t aflags;
+  std::string name;
+  std::string desc;
+  // Name and start of each attribute. Only collected for attribute hooks.
+  std::vector<std::pair<std::string, uint8_t*>> attributes;
+};
+
+struct jar_class {
+  uint16_t aflags;
+  std::string type;
+  // Empty if the class has no superclass.
+  std::string super;
+  std::vector<std::string> interfaces;
+  std::vector<jar_member> fields;
+  std::vector<jar_member> methods;
+};
+} // namespace
+
+static bool extract_class_descriptor(std::vector<cp_entry>& cpool,
+                                     uint16_t cref,
+                                     std::string* out) {
   if (cpool[cref].tag != CP_CONST_CLASS) {
     fprintf(stderr, "Non-class ref in get_class_name, Bailing\n");
-    return nullptr;
+    return false;
   }
   uint16_t utf8ref = cpool[cref].s0;
   const cp_entry& utf8cpe = cpool[utf8ref];
   if (utf8cpe.tag != CP_CONST_UTF8) {
     fprintf(stderr, "Non-utf8 ref in get_utf8, Bailing\n");
-    return nullptr;
+    return false;
   }
   if (utf8cpe.len > (MAX_CLASS_NAMELEN + 3)) {
     fprintf(stderr, "classname is greater than max, bailing");
-    return nullptr;
+    return false;
   }
-  nbuffer[0] = 'L';
-  memcpy(nbuffer + 1, utf8cpe.data, utf8cpe.len);
-  nbuffer[1 + utf8cpe.len] = ';';
-  nbuffer[2 + utf8cpe.len] = '\0';
-  return DexType::make_type(nbuffer);
+  out->reserve(utf8cpe.len + 2);
+  *out = 'L';
+  out->append(reinterpret_cast<const char*>(utf8cpe.data), utf8cpe.len);
+  *out += ';';
+  return true;
 }
 
 static bool extract_utf8(std::vector<cp_entry>& cpool,
                          uint16_t utf8ref,
-                         char* out,
-                         uint32_t size) {
+                         std::string* out) {
   const cp_entry& utf8cpe = cpool[utf8ref];
   if (utf8cpe.tag != CP_CONST_UTF8) {
     fprintf(stderr, "Non-utf8 ref in get_utf8, bailing\n");
     return false;
   }
-  if (utf8cpe.len > (size - 1)) {
+  if (utf8cpe.len > (MAX_CLASS_NAMELEN - 1)) {
     fprintf(stderr, "Name is greater (%hu) than max (%u), bailing\n",
-            utf8cpe.len, size);
+            utf8cpe.len, MAX_CLASS_NAMELEN);
     return false;
   }
-  memcpy(out, utf8cpe.data, utf8cpe.len);
-  out[utf8cpe.len] = '\0';
+  out->assign(reinterpret_cast<const char*>(utf8cpe.data), utf8cpe.len);
   return true;
 }
 
-static DexField* make_dexfield(std::vector<cp_entry>& cpool,
-                               DexType* self,
-                               cp_field_info& finfo) {
-  char dbuffer[MAX_CLASS_NAMELEN];
-  char nbuffer[MAX_CLASS_NAMELEN];
-  if (!extract_utf8(cpool, finfo.nameNdx, nbuffer, MAX_CLASS_NAMELEN) ||
-      !extract_utf8(cpool, finfo.descNdx, dbuffer, MAX_CLASS_NAMELEN)) {
-    return nullptr;
-  }
-  DexString* name = DexString::make_string(nbuffer);
-  DexType* desc = DexType::make_type(dbuffer);
+static DexField* make_dexfield(DexType* self, const jar_member& finfo) {
+  DexString* name = DexString::make_string(finfo.name);
+  DexType* desc = DexType::make_type(finfo.desc.c_str());
   DexField* field =
       static_cast<DexField*>(DexField::make_field(self, name, desc));
   field->set_access((DexAccessFlags)finfo.aflags);
@@ -310,17 +323,9 @@ static DexTypeList* extract_arguments(const char*& buf) {
   return DexTypeList::make_type_list(std::move(args));
 }
 
-static DexMethod* make_dexmethod(std::vector<cp_entry>& cpool,
-                                 DexType* self,
-                                 cp_method_info& finfo) {
-  char dbuffer[MAX_CLASS_NAMELEN];
-  char nbuffer[MAX_CLASS_NAMELEN];
-  if (!extract_utf8(cpool, finfo.nameNdx, nbuffer, MAX_CLASS_NAMELEN) ||
-      !extract_utf8(cpool, finfo.descNdx, dbuffer, MAX_CLASS_NAMELEN)) {
-    return nullptr;
-  }
-  DexString* name = DexString::make_string(nbuffer);
-  const char* ptr = dbuffer;
+static DexMethod* make_dexmethod(DexType* self, const jar_member& finfo) {
+  DexString* name = DexString::make_string(finfo.name);
+  const char* ptr = finfo.desc.c_str();
   DexTypeList* tlist = extract_arguments(ptr);
   if (tlist == nullptr) return nullptr;
   DexType* rtype = parse_type(ptr);
@@ -335,9 +340,9 @@ static DexMethod* make_dexmethod(std::vector<cp_entry>& cpool,
   }
   uint32_t access = finfo.aflags;
   bool is_virt = true;
-  if (nbuffer[0] == '<') {
+  if (finfo.name[0] == '<') {
     is_virt = false;
-    if (nbuffer[1] == 'i') {
+    if (finfo.name[1] == 'i') {
       access |= ACC_CONSTRUCTOR;
     }
   } else if (access & (ACC_PRIVATE | ACC_STATIC))
@@ -348,10 +353,43 @@ static DexMethod* make_dexmethod(std::vector<cp_entry>& cpool,
   return method;
 }
 
-static bool parse_class(uint8_t* buffer,
-                        Scope* classes,
-                        attribute_hook_t attr_hook,
-                        const std::string& jar_location = "") {
+static bool parse_member(uint8_t*& buffer,
+                         std::vector<cp_entry>& cpool,
+                         bool keep_attributes,
+                         jar_member* member) {
+  member->aflags = read16(buffer);
+  uint16_t nameNdx = read16(buffer);
+  uint16_t descNdx = read16(buffer);
+  if (!extract_utf8(cpool, nameNdx, &member->name) ||
+      !extract_utf8(cpool, descNdx, &member->desc)) {
+    return false;
+  }
+  if (!keep_attributes) {
+    skip_attributes(buffer);
+    return true;
+  }
+  uint16_t attributes_count = read16(buffer);
+  for (uint16_t j = 0; j < attributes_count; j++) {
+    uint16_t attribute_name_index = read16(buffer);
+    uint32_t attribute_length = read32(buffer);
+    std::string attribute_name;
+    always_assert_log(
+        extract_utf8(cpool, attribute_name_index, &attribute_name),
+        "attribute hook was specified, but failed to load the "
+        "attribute name due to insufficient name buffer");
+    member->attributes.emplace_back(std::move(attribute_name), buffer);
+    buffer += attribute_length;
+  }
+  return true;
+}
+
+/*
+ * Extracts the class model from a class file. With keep_attributes, the
+ * model points into the buffer, which then has to outlive it.
+ */
+static bool parse_class_model(uint8_t* buffer,
+                              bool keep_attributes,
+                              jar_class* model) {
   uint32_t magic = read32(buffer);
   uint16_t vminor DEBUG_ONLY = read16(buffer);
   uint16_t vmajor DEBUG_ONLY = read16(buffer);
@@ -370,11 +408,39 @@ static bool parse_class(uint8_t* buffer,
       i++;
     }
   }
-  uint16_t aflags = read16(buffer);
+  model->aflags = read16(buffer);
   uint16_t clazz = read16(buffer);
   uint16_t super = read16(buffer);
   uint16_t ifcount = read16(buffer);
-  DexType* self = make_dextype_from_cref(cpool, clazz);
+  if (!extract_class_descriptor(cpool, clazz, &model->type)) return false;
+  if (super != 0 &&
+      !extract_class_descriptor(cpool, super, &model->super)) {
+    return false;
+  }
+  model->interfaces.resize(ifcount);
+  for (auto& iface : model->interfaces) {
+    if (!extract_class_descriptor(cpool, read16(buffer), &iface)) {
+      return false;
+    }
+  }
+  uint16_t fcount = read16(buffer);
+  model->fields.resize(fcount);
+  for (auto& field : model->fields) {
+    if (!parse_member(buffer, cpool, keep_attributes, &field)) return false;
+  }
+  uint16_t mcount = read16(buffer);
+  model->methods.resize(mcount);
+  for (auto& method : model->methods) {
+    if (!parse_member(buffer, cpool, keep_attributes, &method)) return false;
+  }
+  return true;
+}
+
+static bool create_class(const jar_class& model,
+                         DexClass** created,
+                         const attribute_hook_t& attr_hook,
+                         const std::string& jar_location = "") {
+  DexType* self = DexType::make_type(model.type.c_str());
   DexClass* cls = type_class(self);
   if (cls) {
     // We are seeing duplicate classes when parsing jar file
@@ -407,76 +473,40 @@ static bool parse_class(uint8_t* buffer,
 
   ClassCreator cc(self, jar_location);
   cc.set_external();
-  if (super != 0) {
-    DexType* sclazz = make_dextype_from_cref(cpool, super);
-    cc.set_super(sclazz);
+  if (!model.super.empty()) {
+    cc.set_super(DexType::make_type(model.super.c_str()));
   }
-  cc.set_access((DexAccessFlags)aflags);
-  if (ifcount) {
-    for (int i = 0; i < ifcount; i++) {
-      uint16_t iface = read16(buffer);
-      DexType* iftype = make_dextype_from_cref(cpool, iface);
-      cc.add_interface(iftype);
-    }
+  cc.set_access((DexAccessFlags)model.aflags);
+  for (const auto& iface : model.interfaces) {
+    cc.add_interface(DexType::make_type(iface.c_str()));
   }
-  uint16_t fcount = read16(buffer);
 
   auto invoke_attr_hook =
       [&](const boost::variant<DexField*, DexMethod*>& field_or_method,
-          uint8_t* attrPtr) {
+          const jar_member& member) {
         if (attr_hook == nullptr) {
           return;
         }
-        uint16_t attributes_count = read16(attrPtr);
-        for (uint16_t j = 0; j < attributes_count; j++) {
-          uint16_t attribute_name_index = read16(attrPtr);
-          uint32_t attribute_length = read32(attrPtr);
-          char attribute_name[MAX_CLASS_NAMELEN];
-          if (extract_utf8(cpool, attribute_name_index, attribute_name,
-                           MAX_CLASS_NAMELEN)) {
-            attr_hook(field_or_method, attribute_name, attrPtr);
-          } else {
-            always_assert_log(
-                false,
-                "attribute hook was specified, but failed to load the "
-                "attribute name due to insufficient name buffer");
-          }
-          attrPtr += attribute_length;
+        for (const auto& attribute : member.attributes) {
+          attr_hook(field_or_method, attribute.first.c_str(), attribute.second);
         }
       };
 
-  for (int i = 0; i < fcount; i++) {
-    cp_field_info cpfield;
-    cpfield.aflags = read16(buffer);
-    cpfield.nameNdx = read16(buffer);
-    cpfield.descNdx = read16(buffer);
-    uint8_t* attrPtr = buffer;
-    skip_attributes(buffer);
-    DexField* field = make_dexfield(cpool, self, cpfield);
-    if (field == nullptr) return false;
+  for (const auto& finfo : model.fields) {
+    DexField* field = make_dexfield(self, finfo);
     cc.add_field(field);
-    invoke_attr_hook({field}, attrPtr);
+    invoke_attr_hook({field}, finfo);
   }
 
-  uint16_t mcount = read16(buffer);
-  if (mcount) {
-    for (int i = 0; i < mcount; i++) {
-      cp_method_info cpmethod;
-      cpmethod.aflags = read16(buffer);
-      cpmethod.nameNdx = read16(buffer);
-      cpmethod.descNdx = read16(buffer);
-
-      uint8_t* attrPtr = buffer;
-      skip_attributes(buffer);
-      DexMethod* method = make_dexmethod(cpool, self, cpmethod);
-      if (method == nullptr) return false;
-      cc.add_method(method);
-      invoke_attr_hook({method}, attrPtr);
-    }
+  for (const auto& minfo : model.methods) {
+    DexMethod* method = make_dexmethod(self, minfo);
+    if (method == nullptr) return false;
+    cc.add_method(method);
+    invoke_attr_hook({method}, minfo);
   }
   DexClass* dc = cc.create();
-  if (classes != nullptr) {
-    classes->emplace_back(dc);
+  if (created != nullptr) {
+    *created = dc;
   }
   //#define DEBUG_PRINT
 #ifdef DEBUG_PRINT
@@ -510,6 +540,15 @@ static bool parse_class(uint8_t* buffer,
   return true;
 }
 
+static bool parse_class(uint8_t* buffer,
+                        DexClass** created,
+                        const attribute_hook_t& attr_hook,
+                        const std::string& jar_location = "") {
+  jar_class model;
+  if (!parse_class_model(buffer, attr_hook != nullptr, &model)) return false;
+  return create_class(model, created, attr_hook, jar_location);
+}
+
 bool load_class_file(const std::string& filename, Scope* classes) {
   // It's not exactly efficient to call init_basic_types repeatedly for each
   // class file that we load, but load_class_file should typically only be used
@@ -522,8 +561,15 @@ bool load_class_file(const std::string& filename, Scope* classes) {
   buf->pubseekpos(0, ifs.in);
   auto buffer = std::make_unique<char[]>(size);
   buf->sgetn(buffer.get(), size);
-  return parse_class(reinterpret_cast<uint8_t*>(buffer.get()), classes,
-                     /* attr_hook */ nullptr);
+  DexClass* created = nullptr;
+  if (!parse_class(reinterpret_cast<uint8_t*>(buffer.get()), &created,
+                   /* attr_hook */ nullptr)) {
+    return false;
+  }
+  if (classes != nullptr && created != nullptr) {
+    classes->emplace_back(created);
+  }
+  return true;
 }
 
 /******************
@@ -531,299 +577,417 @@ bool load_class_file(const std::string& filename, Scope* classes) {
  *
  */
 
-namespace {
-static const int kSignatureSize = 4;
+static bool is_class_entry(const ZipReader::Entry& file) {
+  static const std::string class_end_string = ".class";
+  if (file.ucomp_size == 0) return false;
+  if (file.name.size() < (class_end_string.size() + 1)) return false;
+  return file.name.compare(file.name.size() - class_end_string.size(),
+                           class_end_string.size(),
+                           class_end_string) == 0;
+}
 
-/* CDFile
- * Central directory file header entry structures.
- */
-static const uint16_t kCompMethodDeflate(8);
-static const uint8_t kCDFile[] = {'P', 'K', 0x01, 0x02};
-
-PACKED(struct pk_cd_file {
-  uint32_t signature;
-  uint16_t vmade;
-  uint16_t vextract;
-  uint16_t flags;
-  uint16_t comp_method;
-  uint16_t mod_time;
-  uint16_t mod_date;
-  uint32_t crc32;
-  uint32_t comp_size;
-  uint32_t ucomp_size;
-  uint16_t fname_len;
-  uint16_t extra_len;
-  uint16_t comment_len;
-  uint16_t diskno;
-  uint16_t interal_attr;
-  uint32_t external_attr;
-  uint32_t disk_offset;
-});
-
-/* CDirEnd:
- * End of central directory record structures.
- */
-static const int kMaxCDirEndSearch = 100;
-static const uint8_t kCDirEnd[] = {'P', 'K', 0x05, 0x06};
-
-PACKED(struct pk_cdir_end {
-  uint32_t signature;
-  uint16_t diskno;
-  uint16_t cd_diskno;
-  uint16_t cd_disk_entries;
-  uint16_t cd_entries;
-  uint32_t cd_size;
-  uint32_t cd_disk_offset;
-  uint16_t comment_len;
-});
-
-/* LFile:
- * Local file header structures.
- * (Yes, this made more sense in the world of floppies and tapes.)
+/******************
+ * Begin Jar Cache code.
+ *
+ * When REDEX_JAR_CACHE_DIR is set, we store the class models of each jar we
+ * load in that directory, keyed by the SHA-1 of the jar's contents, and
+ * read them back instead of inflating and parsing the jar the next time.
+ * The cache is best-effort: any problem with it just means a cache miss.
  */
-static const uint8_t kLFile[] = {'P', 'K', 0x03, 0x04};
-
-PACKED(struct pk_lfile {
-  uint32_t signature;
-  uint16_t vextract;
-  uint16_t flags;
-  uint16_t comp_method;
-  uint16_t mod_time;
-  uint16_t mod_date;
-  uint32_t crc32;
-  uint32_t comp_size;
-  uint32_t ucomp_size;
-  uint16_t fname_len;
-  uint16_t extra_len;
-});
-
-struct jar_entry {
-  struct pk_cd_file cd_entry;
-  uint8_t* filename;
-  ~jar_entry() {
-    if (filename != nullptr) {
-      free(filename);
-      filename = nullptr;
+
+namespace {
+static const char kJarCacheMagic[] = {'R', 'D', 'X', 'J', 'A', 'R', 'C', 0};
+// Bump whenever jar_class or its encoding changes. Also catches caches
+// written on a machine with a different byte order.
+static const uint32_t kJarCacheVersion = 1;
+
+class jar_cache_writer {
+ public:
+  void u16(uint16_t v) { append(&v, sizeof(v)); }
+  void u32(uint32_t v) { append(&v, sizeof(v)); }
+  void str(const std::string& v) {
+    u32(v.size());
+    append(v.data(), v.size());
+  }
+  void member(const jar_member& m) {
+    u16(m.aflags);
+    str(m.name);
+    str(m.desc);
+  }
+  const std::string& data() const { return m_data; }
+
+ private:
+  void append(const void* p, size_t len) {
+    m_data.append(static_cast<const char*>(p), len);
+  }
+  std::string m_data;
+};
+
+class jar_cache_reader {
+ public:
+  jar_cache_reader(const uint8_t* begin, const uint8_t* end)
+      : m_ptr(begin), m_end(end) {}
+  uint16_t u16() {
+    uint16_t v = 0;
+    read(&v, sizeof(v));
+    return v;
+  }
+  uint32_t u32() {
+    uint32_t v = 0;
+    read(&v, sizeof(v));
+    return v;
+  }
+  std::string str() {
+    uint32_t len = u32();
+    if (!ensure(len)) return std::string();
+    std::string v(reinterpret_cast<const char*>(m_ptr), len);
+    m_ptr += len;
+    return v;
+  }
+  void member(jar_member* m) {
+    m->aflags = u16();
+    m->name = str();
+    m->desc = str();
+  }
+  bool ok() const { return m_ok; }
+  bool at_end() const { return m_ptr == m_end; }
+
+ private:
+  bool ensure(size_t len) {
+    if (static_cast<size_t>(m_end - m_ptr) < len) {
+      m_ok = false;
     }
+    return m_ok;
+  }
+  void read(void* p, size_t len) {
+    if (!ensure(len)) return;
+    memcpy(p, m_ptr, len);
+    m_ptr += len;
   }
+  const uint8_t* m_ptr;
+  const uint8_t* m_end;
+  bool m_ok{true};
 };
 } // namespace
 
-static bool find_central_directory(const uint8_t* mapping,
-                                   ssize_t size,
-                                   pk_cdir_end& pce) {
-  ssize_t soffset = (size - sizeof(pk_cdir_end));
-  ssize_t eoffset = soffset - kMaxCDirEndSearch;
-  if (soffset < 0) return false;
-  if (eoffset < 0) eoffset = 0;
-  do {
-    const uint8_t* cdsearch = mapping + soffset;
-    if (memcmp(cdsearch, kCDirEnd, kSignatureSize) == 0) {
-      memcpy(&pce, cdsearch, sizeof(pk_cdir_end));
-      return true;
-    }
-  } while (soffset-- > eoffset);
-  fprintf(stderr, "End of central directory record not found, bailing\n");
-  return false;
+static const char* get_jar_cache_dir() {
+  const char* dir = getenv("REDEX_JAR_CACHE_DIR");
+  return dir != nullptr && *dir != '\0' ? dir : nullptr;
 }
 
-static bool validate_pce(pk_cdir_end& pce, ssize_t size) {
-  /* We only support a limited feature set.  We
-   * don't support disk-spanning, so bail if that's the case.
-   */
-  if (pce.cd_diskno != pce.diskno || pce.cd_diskno != 0 ||
-      pce.cd_entries != pce.cd_disk_entries) {
-    fprintf(stderr, "Disk spanning is not supported, bailing\n");
+static std::string get_jar_cache_path(const std::string& cache_dir,
+                                      const uint8_t* mapping,
+                                      size_t size) {
+  Sha1Context context;
+  sha1_init(&context);
+  constexpr size_t kChunkSize = 1 << 30;
+  for (size_t offset = 0; offset < size; offset += kChunkSize) {
+    size_t len = std::min(kChunkSize, size - offset);
+    sha1_update(&context, mapping + offset, static_cast<unsigned int>(len));
+  }
+  unsigned char digest[20];
+  sha1_final(digest, &context);
+  std::string path = cache_dir + "/";
+  static const char kHexDigits[] = "0123456789abcdef";
+  for (auto byte : digest) {
+    path += kHexDigits[byte >> 4];
+    path += kHexDigits[byte & 0xf];
+  }
+  return path + ".jarcache";
+}
+
+static bool read_jar_cache(const std::string& path,
+                           std::vector<jar_class>* models) {
+  boost::system::error_code ec;
+  if (!boost::filesystem::exists(path, ec)) {
     return false;
   }
-  ssize_t data_size = size - sizeof(pk_cdir_end);
-  if (pce.cd_disk_offset + pce.cd_size > data_size) {
-    fprintf(stderr, "Central directory overflow, invalid pce structure\n");
+  boost::iostreams::mapped_file_source file;
+  try {
+    file.open(path);
+  } catch (const std::exception& e) {
+    TRACE(MAIN, 1, "Cannot open jar cache %s: %s", path.c_str(), e.what());
     return false;
   }
-  return true;
-}
-
-static bool extract_jar_entry(const uint8_t*& mapping, jar_entry& je) {
-  if (memcmp(mapping, kCDFile, kSignatureSize) != 0) {
-    fprintf(stderr, "Invalid central directory entry, bailing\n");
+  auto begin = reinterpret_cast<const uint8_t*>(file.data());
+  if (file.size() < sizeof(kJarCacheMagic) ||
+      memcmp(begin, kJarCacheMagic, sizeof(kJarCacheMagic)) != 0) {
+    TRACE(MAIN, 1, "Not a jar cache: %s", path.c_str());
+    return false;
+  }
+  jar_cache_reader reader(begin + sizeof(kJarCacheMagic), begin + file.size());
+  if (reader.u32() != kJarCacheVersion) {
+    TRACE(MAIN, 1, "Jar cache version mismatch: %s", path.c_str());
+    return false;
+  }
+  models->resize(reader.u32());
+  for (auto& model : *models) {
+    model.aflags = reader.u16();
+    model.type = reader.str();
+    model.super = reader.str();
+    model.interfaces.resize(reader.u16());
+    for (auto& iface : model.interfaces) {
+      iface = reader.str();
+    }
+    model.fields.resize(reader.u16());
+    for (auto& field : model.fields) {
+      reader.member(&field);
+    }
+    model.methods.resize(reader.u16());
+    for (auto& method : model.methods) {
+      reader.member(&method);
+    }
+    if (!reader.ok()) break;
+  }
+  if (!reader.ok() || !reader.at_end()) {
+    TRACE(MAIN, 1, "Corrupt jar cache: %s", path.c_str());
+    models->clear();
     return false;
   }
-  memcpy(&je.cd_entry, mapping, sizeof(pk_cd_file));
-  mapping += sizeof(pk_cd_file);
-  je.filename = (uint8_t*)malloc(je.cd_entry.fname_len + 1);
-  memcpy(je.filename, mapping, je.cd_entry.fname_len);
-  je.filename[je.cd_entry.fname_len] = '\0';
-  mapping += je.cd_entry.fname_len;
-  mapping += je.cd_entry.extra_len;
-  mapping += je.cd_entry.comment_len;
   return true;
 }
 
-static bool get_jar_entries(const uint8_t* mapping,
-                            pk_cdir_end& pce,
-                            std::vector<jar_entry>& files) {
-  const uint8_t* cdir = mapping + pce.cd_disk_offset;
-  files.resize(pce.cd_entries);
-  for (int entry = 0; entry < pce.cd_entries; entry++) {
-    if (!extract_jar_entry(cdir, files[entry])) return false;
+static void write_jar_cache(const std::string& path,
+                            const std::vector<const jar_class*>& models) {
+  jar_cache_writer writer;
+  writer.u32(kJarCacheVersion);
+  writer.u32(models.size());
+  for (const auto* model : models) {
+    writer.u16(model->aflags);
+    writer.str(model->type);
+    writer.str(model->super);
+    writer.u16(model->interfaces.size());
+    for (const auto& iface : model->interfaces) {
+      writer.str(iface);
+    }
+    writer.u16(model->fields.size());
+    for (const auto& field : model->fields) {
+      writer.member(field);
+    }
+    writer.u16(model->methods.size());
+    for (const auto& method : model->methods) {
+      writer.member(method);
+    }
   }
-  return true;
-}
 
-static int jar_uncompress(Bytef* dest,
-                          uLongf* destLen,
-                          const Bytef* source,
-                          uLong sourceLen) {
-  z_stream stream;
-  int err;
+  // Concurrent builds may race to fill the cache, so we write to a unique
+  // file and atomically rename it into place.
+  boost::system::error_code ec;
+  boost::filesystem::path target(path);
+  boost::filesystem::create_directories(target.parent_path(), ec);
+  auto tmp = boost::filesystem::unique_path(path + ".%%%%-%%%%-%%%%.tmp", ec);
+  if (ec) {
+    TRACE(MAIN, 1, "Cannot write jar cache %s: %s", path.c_str(),
+          ec.message().c_str());
+    return;
+  }
+  {
+    std::ofstream out(tmp.string(), std::ofstream::binary);
+    out.write(kJarCacheMagic, sizeof(kJarCacheMagic));
+    out.write(writer.data().data(), writer.data().size());
+    if (!out) {
+      TRACE(MAIN, 1, "Cannot write jar cache %s", tmp.string().c_str());
+      out.close();
+      boost::filesystem::remove(tmp, ec);
+      return;
+    }
+  }
+  boost::filesystem::rename(tmp, target, ec);
+  if (ec) {
+    TRACE(MAIN, 1, "Cannot write jar cache %s: %s", path.c_str(),
+          ec.message().c_str());
+    boost::filesystem::remove(tmp, ec);
+  }
+}
 
-  stream.next_in = (Bytef*)source;
-  stream.avail_in = (uInt)sourceLen;
-  stream.next_out = dest;
-  stream.avail_out = (uInt)*destLen;
-  stream.zalloc = (alloc_func)0;
-  stream.zfree = (free_func)0;
+namespace {
+struct class_entry {
+  size_t jar_index;
+  // The class file in the jar, or nullptr if the model came from the cache.
+  const ZipReader::Entry* file;
+  std::unique_ptr<uint8_t[]> data;
+  jar_class model;
+  DexType* type{nullptr};
+  bool is_dup{false};
+  DexClass* created{nullptr};
+};
+} // namespace
 
-  err = inflateInit2(&stream, -MAX_WBITS);
-  if (err != Z_OK) return err;
+struct ParsedJars {
+  std::vector<std::string> locations;
+  attribute_hook_t attr_hook;
+  // The entries point into the jars.
+  std::vector<std::unique_ptr<ZipReader>> jars;
+  std::vector<class_entry> entries;
+};
 
-  err = inflate(&stream, Z_FINISH);
-  if (err != Z_STREAM_END) {
-    inflateEnd(&stream);
-    return err;
-  }
-  *destLen = stream.total_out;
+bool load_jar_file(const char* location,
+                   Scope* classes,
+                   const attribute_hook_t& attr_hook) {
+  return load_jar_files({location}, classes, attr_hook);
+}
 
-  err = inflateEnd(&stream);
-  return err;
+bool load_jar_files(const std::vector<std::string>& locations,
+                    Scope* classes,
+                    const attribute_hook_t& attr_hook) {
+  auto parsed = parse_jar_files(locations, attr_hook);
+  return parsed != nullptr && create_jar_classes(parsed.get(), classes);
 }
 
-static bool decompress_class(jar_entry& file,
-                             const uint8_t* mapping,
-                             uint8_t* outbuffer,
-                             ssize_t bufsize) {
-  if (file.cd_entry.comp_method != kCompMethodDeflate) {
-    fprintf(stderr, "Unknown compression method %d, Bailing\n",
-            file.cd_entry.comp_method);
-    return false;
-  }
-  const uint8_t* lfile = mapping + file.cd_entry.disk_offset;
-  if (memcmp(lfile, kLFile, kSignatureSize) != 0) {
-    fprintf(stderr, "Invalid local file entry, bailing\n");
-    return false;
-  }
-  pk_lfile pkf;
-  memcpy(&pkf, lfile, sizeof(pk_lfile));
-  if (pkf.comp_size == 0 && pkf.ucomp_size == 0 &&
-      pkf.comp_size != file.cd_entry.comp_size &&
-      pkf.ucomp_size != file.cd_entry.ucomp_size) {
-    pkf.comp_size = file.cd_entry.comp_size;
-    pkf.ucomp_size = file.cd_entry.ucomp_size;
-  }
-  lfile += sizeof(pk_lfile);
-  if (pkf.fname_len != file.cd_entry.fname_len ||
-      pkf.comp_size != file.cd_entry.comp_size ||
-      pkf.ucomp_size != file.cd_entry.ucomp_size ||
-      pkf.comp_method != file.cd_entry.comp_method ||
-      memcmp(lfile, file.filename, pkf.fname_len) != 0) {
-    fprintf(stderr,
-            "Directory entry doesn't match local file header, "
-            "Bailing %d %d %d %d, %d %d %d %d extra %d\n",
-            pkf.fname_len, pkf.comp_size, pkf.ucomp_size, pkf.comp_method,
-            file.cd_entry.fname_len, file.cd_entry.comp_size,
-            file.cd_entry.ucomp_size, file.cd_entry.comp_method, pkf.extra_len);
-    return false;
+std::shared_ptr<ParsedJars> parse_jar_files(
+    const std::vector<std::string>& locations,
+    const attribute_hook_t& attr_hook) {
+  auto parsed = std::make_shared<ParsedJars>();
+  parsed->locations = locations;
+  parsed->attr_hook = attr_hook;
+  auto& jars = parsed->jars;
+  jars.resize(locations.size());
+  for (size_t i = 0; i < locations.size(); i++) {
+    try {
+      jars[i] = std::make_unique<ZipReader>(locations[i]);
+    } catch (const std::exception& e) {
+      fprintf(stderr, "error: cannot process jar: %s: %s\n",
+              locations[i].c_str(), e.what());
+      return nullptr;
+    }
   }
-  lfile += pkf.fname_len;
-  lfile += pkf.extra_len;
-  uLongf dlen = bufsize;
-  int zlibrv = jar_uncompress(outbuffer, &dlen, lfile, pkf.comp_size);
-  if (zlibrv != Z_OK) {
-    fprintf(stderr, "uncompress failed with code %d, Bailing\n", zlibrv);
-    return false;
+
+  // Attribute hooks need the actual class files.
+  const char* cache_dir = attr_hook == nullptr ? get_jar_cache_dir() : nullptr;
+  std::vector<std::string> cache_paths(locations.size());
+  std::vector<std::vector<jar_class>> cached_models(locations.size());
+  std::vector<uint8_t> is_cached(locations.size(), false);
+  if (cache_dir != nullptr) {
+    auto wq = workqueue_foreach<size_t>([&](size_t i) {
+      cache_paths[i] =
+          get_jar_cache_path(cache_dir, jars[i]->data(), jars[i]->size());
+      is_cached[i] = read_jar_cache(cache_paths[i], &cached_models[i]);
+      TRACE(MAIN, 2, "Jar cache %s for %s: %s",
+            is_cached[i] ? "hit" : "miss", locations[i].c_str(),
+            cache_paths[i].c_str());
+    });
+    for (size_t i = 0; i < locations.size(); i++) {
+      wq.add_item(i);
+    }
+    wq.run_all();
   }
-  if (dlen != pkf.ucomp_size) {
-    fprintf(stderr, "mis-match on uncompressed size, Bailing\n");
-    return false;
+
+  auto& entries = parsed->entries;
+  for (size_t i = 0; i < locations.size(); i++) {
+    if (is_cached[i]) {
+      for (auto& model : cached_models[i]) {
+        entries.push_back(class_entry{i, nullptr});
+        entries.back().model = std::move(model);
+      }
+      cached_models[i].clear();
+      continue;
+    }
+    for (auto& file : jars[i]->entries()) {
+      if (is_class_entry(file)) {
+        entries.push_back(class_entry{i, &file});
+      }
+    }
   }
-  return true;
-}
 
-static const int kStartBufferSize = 128 * 1024;
-
-static bool process_jar_entries(const char* location,
-                                std::vector<jar_entry>& files,
-                                const uint8_t* mapping,
-                                Scope* classes,
-                                const attribute_hook_t& attr_hook) {
-  ssize_t bufsize = kStartBufferSize;
-  uint8_t* outbuffer = (uint8_t*)malloc(bufsize);
-  static char classEndString[] = ".class";
-  static size_t classEndStringLen = strlen(classEndString);
   init_basic_types();
-  for (auto& file : files) {
-    if (file.cd_entry.ucomp_size == 0) continue;
-    if (file.cd_entry.fname_len < (classEndStringLen + 1)) continue;
-
-    // Skip non-class files
-    uint8_t* endcomp =
-        file.filename + (file.cd_entry.fname_len - classEndStringLen);
-    if (memcmp(endcomp, classEndString, classEndStringLen) != 0) continue;
-
-    // Resize output if necessary.
-    if (bufsize < file.cd_entry.ucomp_size) {
-      while (bufsize < file.cd_entry.ucomp_size)
-        bufsize *= 2;
-      free(outbuffer);
-      outbuffer = (uint8_t*)malloc(bufsize);
+  std::atomic<bool> failed{false};
+  // Inflating and parsing the class files doesn't depend on anything else,
+  // so we do it for all the jars at once.
+  auto inflate_wq = workqueue_foreach<class_entry*>([&](class_entry* entry) {
+    if (entry->file != nullptr) {
+      entry->data = std::make_unique<uint8_t[]>(entry->file->ucomp_size);
+      if (!jars[entry->jar_index]->read_entry(*entry->file,
+                                              entry->data.get()) ||
+          !parse_class_model(entry->data.get(), attr_hook != nullptr,
+                             &entry->model)) {
+        fprintf(stderr, "error: cannot process jar: %s\n",
+                locations[entry->jar_index].c_str());
+        failed = true;
+        return;
+      }
+      if (attr_hook == nullptr) {
+        entry->data.reset();
+      }
     }
+    entry->type = DexType::make_type(entry->model.type.c_str());
+  });
+  for (auto& entry : entries) {
+    inflate_wq.add_item(&entry);
+  }
+  inflate_wq.run_all();
+  if (failed) {
+    return nullptr;
+  }
 
-    if (!decompress_class(file, mapping, outbuffer, bufsize)) {
-      free(outbuffer);
-      return false;
+  if (cache_dir != nullptr) {
+    std::vector<std::vector<const jar_class*>> to_cache(locations.size());
+    for (const auto& entry : entries) {
+      if (!is_cached[entry.jar_index]) {
+        to_cache[entry.jar_index].push_back(&entry.model);
+      }
     }
-
-    if (!parse_class(outbuffer, classes, attr_hook, location)) {
-      free(outbuffer);
-      return false;
+    for (size_t i = 0; i < locations.size(); i++) {
+      if (!is_cached[i]) {
+        write_jar_cache(cache_paths[i], to_cache[i]);
+      }
     }
   }
-  free(outbuffer);
-  return true;
+  return parsed;
 }
 
-static bool process_jar(const char* location,
-                        const uint8_t* mapping,
-                        ssize_t size,
-                        Scope* classes,
-                        const attribute_hook_t& attr_hook) {
-  pk_cdir_end pce;
-  std::vector<jar_entry> files;
-  if (!find_central_directory(mapping, size, pce)) return false;
-  if (!validate_pce(pce, size)) return false;
-  if (!get_jar_entries(mapping, pce, files)) return false;
-  if (!process_jar_entries(location, files, mapping, classes, attr_hook)) {
-    return false;
+bool create_jar_classes(ParsedJars* parsed, Scope* classes) {
+  const auto& locations = parsed->locations;
+  const auto& attr_hook = parsed->attr_hook;
+  auto& entries = parsed->entries;
+
+  // The first definition of a class wins, as if the jars had been loaded one
+  // after the other. That leaves at most one entry per class, so the classes
+  // can be created concurrently.
+  std::unordered_map<DexType*, const class_entry*> first_definitions;
+  for (auto& entry : entries) {
+    auto it = first_definitions.emplace(entry.type, &entry).first;
+    if (it->second != &entry) {
+      TRACE(MAIN, 1,
+            "Warning: Found a duplicate class '%s' in two .jar files:\n "
+            "  Current: '%s'\n"
+            "  Previous: '%s'",
+            SHOW(entry.type), locations[entry.jar_index].c_str(),
+            locations[it->second->jar_index].c_str());
+      entry.is_dup = true;
+      entry.data.reset();
+    }
   }
-  return true;
-}
 
-bool load_jar_file(const char* location,
-                   Scope* classes,
-                   const attribute_hook_t& attr_hook) {
-  boost::iostreams::mapped_file file;
-  try {
-    file.open(location, boost::iostreams::mapped_file::readonly);
-  } catch (const std::exception& e) {
-    fprintf(stderr, "error: cannot open jar file: %s\n", location);
+  std::atomic<bool> failed{false};
+  auto create_entry = [&](class_entry* entry) {
+    if (!create_class(entry->model, &entry->created, attr_hook,
+                      locations[entry->jar_index])) {
+      fprintf(stderr, "error: cannot process jar: %s\n",
+              locations[entry->jar_index].c_str());
+      failed = true;
+    }
+    entry->data.reset();
+  };
+  // We don't know whether the attribute hook is thread-safe.
+  size_t num_threads =
+      attr_hook == nullptr ? redex_parallel::default_num_threads() : 1;
+  auto create_wq = workqueue_foreach<class_entry*>(create_entry, num_threads);
+  for (auto& entry : entries) {
+    if (!entry.is_dup) {
+      create_wq.add_item(&entry);
+    }
+  }
+  create_wq.run_all();
+  if (failed) {
     return false;
   }
 
-  auto mapping = reinterpret_cast<const uint8_t*>(file.const_data());
-  if (!process_jar(location, mapping, file.size(), classes, attr_hook)) {
-    fprintf(stderr, "error: cannot process jar: %s\n", location);
-    return false;
+  if (classes != nullptr) {
+    for (auto& entry : entries) {
+      if (entry.created != nullptr) {
+        classes->push_back(entry.created);
+      }
+    }
   }
   return true;
 }
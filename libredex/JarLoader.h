@@ -15,6 +15,9 @@ class DexMethod;
 #include "ConfigFiles.h"
 
 #include <functional>
+#include <memory>
+#include <string>
+#include <vector>
 
 namespace JarLoaderUtil {
 uint32_t read32(uint8_t*& buffer);
@@ -30,4 +33,31 @@ bool load_jar_file(const char* location,
                    Scope* classes = nullptr,
                    const attribute_hook_t& = nullptr);
 
+/*
+ * Loads the given jars with the same result as calling load_jar_file on each
+ * of them in order, but inflates and parses their class files in parallel.
+ *
+ * If the REDEX_JAR_CACHE_DIR environment variable names a directory, the
+ * parsed classes of each jar are cached there, keyed by the jar's content
+ * hash, and later loads of the same jar read the cache instead. The cache
+ * isn't used with an attribute hook, as it doesn't store attributes.
+ */
+bool load_jar_files(const std::vector<std::string>& locations,
+                    Scope* classes = nullptr,
+                    const attribute_hook_t& = nullptr);
+
+/*
+ * load_jar_files in two steps. Reading and parsing the class files doesn't
+ * depend on any other class, so parse_jar_files can run while the dexes are
+ * loading. create_jar_classes must come after that though, since the classes
+ * of the dexes take precedence over those of the jars.
+ *
+ * parse_jar_files returns nullptr if a jar can't be read.
+ */
+struct ParsedJars;
+std::shared_ptr<ParsedJars> parse_jar_files(
+    const std::vector<std::string>& locations,
+    const attribute_hook_t& = nullptr);
+bool create_jar_classes(ParsedJars* parsed, Scope* classes = nullptr);
+
 bool load_class_file(const std::string& filename, Scope* classes = nullptr);
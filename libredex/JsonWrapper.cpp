@@ -10,26 +10,51 @@
 #include <string>
 #include <vector>
 
+void JsonWrapper::build_index() {
+  m_index.clear();
+  if (!m_config.isObject()) {
+    return;
+  }
+  m_index.reserve(m_config.size());
+  for (auto it = m_config.begin(); it != m_config.end(); ++it) {
+    m_index.emplace(it.name(), &*it);
+  }
+}
+
+const Json::Value* JsonWrapper::find(const char* name) const {
+  auto it = m_index.find(name);
+  return it == m_index.end() ? nullptr : it->second;
+}
+
 void JsonWrapper::get(const char* name, int64_t dflt, int64_t& param) const {
-  param = m_config.get(name, (Json::Int64)dflt).asInt();
+  auto val = find(name);
+  param = val ? val->asInt() : dflt;
 }
 
 void JsonWrapper::get(const char* name, size_t dflt, size_t& param) const {
-  param = m_config.get(name, (Json::UInt)dflt).asUInt();
+  auto val = find(name);
+  param = val ? val->asUInt() : dflt;
 }
 
 void JsonWrapper::get(const char* name,
                       const std::string& dflt,
                       std::string& param) const {
-  param = m_config.get(name, dflt).asString();
+  auto val = find(name);
+  param = val ? val->asString() : dflt;
 }
 
 std::string JsonWrapper::get(const char* name, const std::string& dflt) const {
-  return m_config.get(name, dflt).asString();
+  auto val = find(name);
+  return val ? val->asString() : dflt;
 }
 
 void JsonWrapper::get(const char* name, bool dflt, bool& param) const {
-  auto val = m_config.get(name, dflt);
+  auto found = find(name);
+  if (found == nullptr) {
+    param = dflt;
+    return;
+  }
+  const auto& val = *found;
 
   // Do some simple type conversions that folly used to do
   if (val.isBool()) {
@@ -66,13 +91,12 @@ bool JsonWrapper::get(const char* name, bool dflt) const {
 void JsonWrapper::get(const char* name,
                       const std::vector<std::string>& dflt,
                       std::vector<std::string>& param) const {
-  auto it = m_config[name];
-  // NOLINTNEXTLINE(readability-container-size-empty)
-  if (it == Json::nullValue) {
+  auto it = find(name);
+  if (it == nullptr || it->isNull()) {
     param = dflt;
   } else {
     param.clear();
-    for (auto const& str : it) {
+    for (auto const& str : *it) {
       param.emplace_back(str.asString());
     }
   }
@@ -81,13 +105,12 @@ void JsonWrapper::get(const char* name,
 void JsonWrapper::get(const char* name,
                       const std::vector<std::string>& dflt,
                       std::unordered_set<std::string>& param) const {
-  auto it = m_config[name];
+  auto it = find(name);
   param.clear();
-  // NOLINTNEXTLINE(readability-container-size-empty)
-  if (it == Json::nullValue) {
+  if (it == nullptr || it->isNull()) {
     param.insert(dflt.begin(), dflt.end());
   } else {
-    for (auto const& str : it) {
+    for (auto const& str : *it) {
       param.emplace(str.asString());
     }
   }
@@ -97,12 +120,12 @@ void JsonWrapper::get(
     const char* name,
     const std::unordered_map<std::string, std::vector<std::string>>& dflt,
     std::unordered_map<std::string, std::vector<std::string>>& param) const {
-  auto cfg = m_config[name];
+  auto found = find(name);
   param.clear();
-  // NOLINTNEXTLINE(readability-container-size-empty)
-  if (cfg == Json::nullValue) {
+  if (found == nullptr || found->isNull()) {
     param = dflt;
   } else {
+    const auto& cfg = *found;
     if (!cfg.isObject()) {
       throw std::runtime_error("Cannot convert JSON value to object: " +
                                cfg.asString());
@@ -132,17 +155,20 @@ void JsonWrapper::get(
 void JsonWrapper::get(const char* name,
                       const Json::Value& dflt,
                       Json::Value& param) const {
-  param = m_config.get(name, dflt);
+  auto val = find(name);
+  param = val ? *val : dflt;
 }
 
 Json::Value JsonWrapper::get(const char* name, const Json::Value& dflt) const {
-  return m_config.get(name, dflt);
+  auto val = find(name);
+  return val ? *val : dflt;
 }
 
 const Json::Value& JsonWrapper::operator[](const char* name) const {
-  return m_config[name];
+  auto val = find(name);
+  return val ? *val : Json::Value::nullSingleton();
 }
 
 bool JsonWrapper::contains(const char* name) const {
-  return m_config.isMember(name);
+  return find(name) != nullptr;
 }
@@ -18,7 +18,20 @@ class JsonWrapper {
  public:
   JsonWrapper() = default;
 
-  explicit JsonWrapper(const Json::Value& config) : m_config(config) {}
+  explicit JsonWrapper(const Json::Value& config) : m_config(config) {
+    build_index();
+  }
+
+  // The index points into m_config, so it is rebuilt for every copy.
+  JsonWrapper(const JsonWrapper& that) : m_config(that.m_config) {
+    build_index();
+  }
+
+  JsonWrapper& operator=(const JsonWrapper& that) {
+    m_config = that.m_config;
+    build_index();
+    return *this;
+  }
 
   void get(const char* name, int64_t dflt, int64_t& param) const;
 
@@ -53,6 +66,16 @@ class JsonWrapper {
 
   bool contains(const char* name) const;
 
+  /*
+   * The value of the top-level key `name`, or nullptr if there is none. It is
+   * one hash lookup, so it is cheap enough to be called from hot code.
+   */
+  const Json::Value* find(const char* name) const;
+
  private:
+  void build_index();
+
   Json::Value m_config;
+  // The members of the config, when it is an object.
+  std::unordered_map<std::string, const Json::Value*> m_index;
 };
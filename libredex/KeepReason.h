@@ -10,6 +10,7 @@
 #include <boost/functional/hash.hpp>
 #include <ostream>
 #include <unordered_set>
+#include <vector>
 
 #include "Debug.h"
 
@@ -78,7 +79,9 @@ struct ReasonPtrEqual {
   }
 };
 
-using ReasonPtrSet =
-    std::unordered_set<const Reason*, ReasonPtrHash, ReasonPtrEqual>;
+// The reasons of a single member. The reasons are interned, and a member has
+// few of them, so a vector of distinct pointers is much more compact than a
+// hash set.
+using ReasonPtrSet = std::vector<const Reason*>;
 
 } // namespace keep_reason
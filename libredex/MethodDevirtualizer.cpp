@@ -7,10 +7,12 @@
 
 #include "MethodDevirtualizer.h"
 
+#include "CallSiteIndex.h"
 #include "MethodOverrideGraph.h"
 #include "Mutators.h"
 #include "Resolver.h"
 #include "Walkers.h"
+#include "WorkQueue.h"
 
 namespace mog = method_override_graph;
 
@@ -52,31 +54,31 @@ void patch_call_site(DexMethod* callee,
   method_inst->set_method(callee);
 }
 
-void fix_call_sites(const std::vector<DexClass*>& scope,
+void fix_call_sites(call_site_index::CallSiteIndex& call_sites,
                     const std::unordered_set<DexMethod*>& target_methods,
                     DevirtualizerMetrics& metrics,
                     bool drop_this = false) {
-  const auto fixer = [&target_methods, drop_this](DexMethod* m) -> CallCounter {
-    CallCounter call_counter;
-    IRCode* code = m->get_code();
-    if (code == nullptr) {
-      return call_counter;
+  if (target_methods.empty()) {
+    return;
+  }
+  // All the invokes of a method ref resolve to the same method, so each ref is
+  // resolved once, and only the call sites of the refs to the targets are
+  // visited.
+  std::vector<DexMethodRef*> callees = call_sites.get_callees();
+  std::vector<DexMethod*> resolved(callees.size());
+  std::vector<CallCounter> call_counters(callees.size());
+  auto wq = workqueue_foreach<size_t>([&](size_t idx) {
+    MethodSearch type = drop_this ? MethodSearch::Any : MethodSearch::Virtual;
+    auto method = resolve_method(callees[idx], type);
+    if (method == nullptr || !target_methods.count(method)) {
+      return;
     }
+    resolved[idx] = method;
 
-    for (const MethodItemEntry& mie : InstructionIterable(code)) {
-      IRInstruction* insn = mie.insn;
-      if (!insn->has_method()) {
-        continue;
-      }
-
-      MethodSearch type = drop_this ? MethodSearch::Any : MethodSearch::Virtual;
-      auto method = resolve_method(insn->get_method(), type);
-      if (method == nullptr || !target_methods.count(method)) {
-        continue;
-      }
-
+    for (const auto& call_site : call_sites.get_call_sites(callees[idx])) {
+      IRInstruction* insn = call_site.invoke->insn;
       always_assert(drop_this || !is_invoke_static(insn->opcode()));
-      patch_call_site(method, insn, call_counter);
+      patch_call_site(method, insn, call_counters[idx]);
 
       if (drop_this) {
         auto nargs = insn->srcs_size();
@@ -86,11 +88,19 @@ void fix_call_sites(const std::vector<DexClass*>& scope,
         insn->set_srcs_size(nargs - 1);
       }
     }
+  });
+  for (size_t i = 0; i < callees.size(); ++i) {
+    wq.add_item(i);
+  }
+  wq.run_all();
 
-    return call_counter;
-  };
-
-  CallCounter call_counter = walk::parallel::methods<CallCounter>(scope, fixer);
+  CallCounter call_counter;
+  for (size_t i = 0; i < callees.size(); ++i) {
+    if (resolved[i] != nullptr) {
+      call_sites.move_call_sites(callees[i], resolved[i]);
+      call_counter += call_counters[i];
+    }
+  }
 
   metrics.num_virtual_calls += call_counter.virtuals;
   metrics.num_super_calls += call_counter.supers;
@@ -200,18 +210,18 @@ void MethodDevirtualizer::verify_and_split(
 }
 
 void MethodDevirtualizer::staticize_methods_not_using_this(
-    const std::vector<DexClass*>& scope,
+    call_site_index::CallSiteIndex& call_sites,
     const std::unordered_set<DexMethod*>& methods) {
-  fix_call_sites(scope, methods, m_metrics, true /* drop_this */);
+  fix_call_sites(call_sites, methods, m_metrics, true /* drop_this */);
   make_methods_static(methods, false);
   TRACE(VIRT, 1, "Staticized %lu methods not using this", methods.size());
   m_metrics.num_methods_not_using_this += methods.size();
 }
 
 void MethodDevirtualizer::staticize_methods_using_this(
-    const std::vector<DexClass*>& scope,
+    call_site_index::CallSiteIndex& call_sites,
     const std::unordered_set<DexMethod*>& methods) {
-  fix_call_sites(scope, methods, m_metrics, false /* drop_this */);
+  fix_call_sites(call_sites, methods, m_metrics, false /* drop_this */);
   make_methods_static(methods, true);
   TRACE(VIRT, 1, "Staticized %lu methods using this", methods.size());
   m_metrics.num_methods_using_this += methods.size();
@@ -220,6 +230,9 @@ void MethodDevirtualizer::staticize_methods_using_this(
 DevirtualizerMetrics MethodDevirtualizer::devirtualize_methods(
     const Scope& scope, const std::vector<DexClass*>& target_classes) {
   reset_metrics();
+  // The invokes of the whole scope are indexed once, for all the call sites
+  // that need to be fixed below.
+  call_site_index::CallSiteIndex call_sites(scope);
   auto vmethods = get_devirtualizable_vmethods(scope, target_classes);
   std::unordered_set<DexMethod*> using_this, not_using_this;
   verify_and_split(vmethods, using_this, not_using_this);
@@ -230,11 +243,11 @@ DevirtualizerMetrics MethodDevirtualizer::devirtualize_methods(
         not_using_this.size());
 
   if (m_config.vmethods_not_using_this) {
-    staticize_methods_not_using_this(scope, not_using_this);
+    staticize_methods_not_using_this(call_sites, not_using_this);
   }
 
   if (m_config.vmethods_using_this) {
-    staticize_methods_using_this(scope, using_this);
+    staticize_methods_using_this(call_sites, using_this);
   }
 
   auto dmethods = get_devirtualizable_dmethods(scope, target_classes);
@@ -248,11 +261,11 @@ DevirtualizerMetrics MethodDevirtualizer::devirtualize_methods(
         not_using_this.size());
 
   if (m_config.dmethods_not_using_this) {
-    staticize_methods_not_using_this(scope, not_using_this);
+    staticize_methods_not_using_this(call_sites, not_using_this);
   }
 
   if (m_config.dmethods_using_this) {
-    staticize_methods_using_this(scope, using_this);
+    staticize_methods_using_this(call_sites, using_this);
   }
 
   return m_metrics;
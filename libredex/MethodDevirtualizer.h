@@ -7,6 +7,7 @@
 
 #pragma once
 
+#include "CallSiteIndex.h"
 #include "Pass.h"
 
 struct DevirtualizerConfigs {
@@ -52,11 +53,11 @@ class MethodDevirtualizer {
   void reset_metrics() { m_metrics = DevirtualizerMetrics(); }
 
   void staticize_methods_using_this(
-      const std::vector<DexClass*>& scope,
+      call_site_index::CallSiteIndex& call_sites,
       const std::unordered_set<DexMethod*>& methods);
 
   void staticize_methods_not_using_this(
-      const std::vector<DexClass*>& scope,
+      call_site_index::CallSiteIndex& call_sites,
       const std::unordered_set<DexMethod*>& methods);
 
   void verify_and_split(const std::vector<DexMethod*>& candidates,
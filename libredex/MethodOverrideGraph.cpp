@@ -7,13 +7,18 @@
 
 #include "MethodOverrideGraph.h"
 
+#include <algorithm>
+#include <tuple>
+
 #include <boost/range/adaptor/map.hpp>
 
 #include "BinarySerialization.h"
+#include "ConcurrentContainers.h"
 #include "PatriciaTreeMap.h"
 #include "PatriciaTreeSet.h"
 #include "Timer.h"
 #include "Walkers.h"
+#include "WorkQueue.h"
 
 using namespace method_override_graph;
 
@@ -71,41 +76,135 @@ void unify_signature_maps(const SignatureMap& to_add, SignatureMap* target) {
       to_add);
 }
 
+using EdgeList = std::vector<Graph::Edge>;
+
 class GraphBuilder {
  public:
   explicit GraphBuilder(const Scope& scope) : m_scope(scope) {}
 
   std::unique_ptr<Graph> run() {
-    m_graph = std::make_unique<Graph>();
-    walk::parallel::classes(m_scope, [&](const DexClass* cls) {
+    // Index the classes of the scope by their superclass. Each class whose
+    // superclass is not in the scope is the root of a hierarchy that we can
+    // analyze top-down, independently of the others. Interfaces may extend
+    // several interfaces, so we memoize their analysis instead.
+    std::unordered_set<const DexClass*> in_scope(m_scope.begin(),
+                                                 m_scope.end());
+    std::vector<Task> seeds;
+    for (const auto* cls : m_scope) {
       if (is_interface(cls)) {
-        analyze_interface(cls);
+        seeds.push_back({cls, nullptr});
+        continue;
+      }
+      auto super_cls = cls->get_super_class() == nullptr
+                           ? nullptr
+                           : type_class(cls->get_super_class());
+      if (super_cls != nullptr && in_scope.count(super_cls) != 0) {
+        m_subclasses[super_cls].push_back(cls);
       } else {
-        analyze_non_interface(cls);
+        seeds.push_back({cls, nullptr});
       }
-    });
-    return std::move(m_graph);
+    }
+
+    size_t num_threads = redex_parallel::default_num_threads();
+    std::vector<EdgeList> edges(num_threads);
+    auto wq = workqueue_foreach<Task>(
+        [&](sparta::SpartaWorkerState<Task>* worker_state, const Task& task) {
+          auto* worker_edges = &edges[worker_state->worker_id()];
+          if (is_interface(task.cls)) {
+            analyze_interface(task.cls, worker_edges);
+            return;
+          }
+          ClassSignatureMap inherited;
+          if (task.inherited != nullptr) {
+            inherited = *task.inherited;
+          } else if (task.cls->get_super_class() != nullptr) {
+            auto super_cls = type_class(task.cls->get_super_class());
+            if (super_cls != nullptr) {
+              inherited = analyze_non_interface(super_cls, worker_edges);
+            }
+          }
+          auto subclasses = m_subclasses.find(task.cls);
+          if (subclasses == m_subclasses.end()) {
+            analyze_class(task.cls, std::move(inherited), worker_edges,
+                          worker_edges);
+            return;
+          }
+          auto signatures = std::make_shared<const ClassSignatureMap>(
+              analyze_class(task.cls, std::move(inherited), worker_edges,
+                            worker_edges));
+          for (const auto* subclass : subclasses->second) {
+            worker_state->push_task({subclass, signatures});
+          }
+        },
+        num_threads,
+        /*push_tasks_while_running=*/true);
+    for (auto& seed : seeds) {
+      wq.add_item(std::move(seed));
+    }
+    wq.run_all();
+
+    EdgeList all_edges;
+    size_t num_edges = 0;
+    for (const auto& worker_edges : edges) {
+      num_edges += worker_edges.size();
+    }
+    all_edges.reserve(num_edges);
+    for (auto& worker_edges : edges) {
+      all_edges.insert(all_edges.end(), worker_edges.begin(),
+                       worker_edges.end());
+      EdgeList().swap(worker_edges);
+    }
+    return std::make_unique<Graph>(std::move(all_edges));
   }
 
  private:
-  ClassSignatureMap analyze_non_interface(const DexClass* cls) {
+  struct Task {
+    const DexClass* cls;
+    // The signature maps of the superclass, if it has been analyzed by the
+    // task that pushed this one.
+    std::shared_ptr<const ClassSignatureMap> inherited;
+  };
+
+  /*
+   * Analyzes a class outside of the scope, or the superclass of one. Several
+   * threads may do so at the same time; only the one that gets to record the
+   * result reports the edges it found.
+   */
+  ClassSignatureMap analyze_non_interface(const DexClass* cls,
+                                          EdgeList* worker_edges) {
     always_assert(!is_interface(cls));
     if (m_class_signature_maps.count(cls) != 0) {
       return m_class_signature_maps.at(cls);
     }
 
-    // Initialize the signature maps from those of the superclass.
-    ClassSignatureMap class_signatures;
+    ClassSignatureMap inherited;
     if (cls->get_super_class() != nullptr) {
       auto super_cls = type_class(cls->get_super_class());
       if (super_cls != nullptr) {
-        class_signatures = analyze_non_interface(super_cls);
+        inherited = analyze_non_interface(super_cls, worker_edges);
       }
     }
+    EdgeList own_edges;
+    auto class_signatures =
+        analyze_class(cls, std::move(inherited), &own_edges, worker_edges);
+    if (m_class_signature_maps.emplace(cls, class_signatures)) {
+      worker_edges->insert(worker_edges->end(), own_edges.begin(),
+                           own_edges.end());
+    }
+    return class_signatures;
+  }
 
+  /*
+   * Adds the methods of a class to the signature maps of its superclass, and
+   * records the edges of those methods in `own_edges`.
+   */
+  ClassSignatureMap analyze_class(const DexClass* cls,
+                                  ClassSignatureMap class_signatures,
+                                  EdgeList* own_edges,
+                                  EdgeList* worker_edges) {
     // Add all methods from the interfaces that the current class directly
     // implements to the set of unimplemented methods.
-    unify_signature_maps(unify_super_interface_signatures(cls),
+    unify_signature_maps(unify_super_interface_signatures(cls, worker_edges),
                          &class_signatures.unimplemented);
 
     // Mark all overriding methods as reachable via their parent method ref.
@@ -113,7 +212,7 @@ class GraphBuilder {
       auto overridden_set = class_signatures.implemented.at(method->get_name())
                                 .at(method->get_proto());
       for (auto overridden : overridden_set) {
-        m_graph->add_edge(overridden, method);
+        own_edges->emplace_back(overridden, method);
       }
       // Replace the overridden methods by the overriding ones.
       update_signature_map(
@@ -132,7 +231,7 @@ class GraphBuilder {
             class_signatures.unimplemented.at(implementation->get_name())
                 .at(implementation->get_proto());
         for (auto unimplemented : unimplemented_set) {
-          m_graph->add_edge(unimplemented, implementation);
+          own_edges->emplace_back(unimplemented, implementation);
         }
         // Remove the method from the set of unimplemented interface methods.
         update_signature_map(
@@ -140,17 +239,18 @@ class GraphBuilder {
       }
     }
 
-    m_class_signature_maps.emplace(cls, class_signatures);
     return class_signatures;
   }
 
-  SignatureMap analyze_interface(const DexClass* cls) {
+  SignatureMap analyze_interface(const DexClass* cls, EdgeList* worker_edges) {
     always_assert(is_interface(cls));
     if (m_interface_signature_maps.count(cls) != 0) {
       return m_interface_signature_maps.at(cls);
     }
 
-    SignatureMap interface_signatures = unify_super_interface_signatures(cls);
+    SignatureMap interface_signatures =
+        unify_super_interface_signatures(cls, worker_edges);
+    EdgeList own_edges;
     for (auto* method : cls->get_vmethods()) {
       auto overridden_set =
           interface_signatures.at(method->get_name()).at(method->get_proto());
@@ -172,28 +272,33 @@ class GraphBuilder {
       // to find them. This design reduces the number of edges necessary for
       // building the graph.
       for (auto overridden : overridden_set) {
-        m_graph->add_edge(overridden, method);
+        own_edges.emplace_back(overridden, method);
       }
       update_signature_map(method, MethodSet{method}, &interface_signatures);
     }
 
-    m_interface_signature_maps.emplace(cls, interface_signatures);
+    if (m_interface_signature_maps.emplace(cls, interface_signatures)) {
+      worker_edges->insert(worker_edges->end(), own_edges.begin(),
+                           own_edges.end());
+    }
     return interface_signatures;
   }
 
-  SignatureMap unify_super_interface_signatures(const DexClass* cls) {
+  SignatureMap unify_super_interface_signatures(const DexClass* cls,
+                                                EdgeList* worker_edges) {
     SignatureMap super_interface_signatures;
     for (auto* intf : cls->get_interfaces()->get_type_list()) {
       auto intf_cls = type_class(intf);
       if (intf_cls != nullptr) {
-        unify_signature_maps(analyze_interface(intf_cls),
+        unify_signature_maps(analyze_interface(intf_cls, worker_edges),
                              &super_interface_signatures);
       }
     }
     return super_interface_signatures;
   }
 
-  std::unique_ptr<Graph> m_graph;
+  std::unordered_map<const DexClass*, std::vector<const DexClass*>>
+      m_subclasses;
   ClassSignatureMaps m_class_signature_maps;
   InterfaceSignatureMaps m_interface_signature_maps;
   const Scope& m_scope;
@@ -213,15 +318,47 @@ const Node& Graph::get_node(const DexMethod* method) const {
   return it->second;
 }
 
+Graph::Graph(std::vector<Edge> edges) {
+  // Sort the edges by overridden method to get the children lists, and by
+  // overriding method to get the parent lists.
+  std::sort(edges.begin(), edges.end());
+  edges.erase(std::unique(edges.begin(), edges.end()), edges.end());
+  m_nodes.reserve(edges.size());
+  for (auto it = edges.begin(); it != edges.end();) {
+    auto end = std::find_if(it, edges.end(), [&](const Edge& edge) {
+      return edge.first != it->first;
+    });
+    auto& children = m_nodes[it->first].children;
+    children.reserve(end - it);
+    for (; it != end; ++it) {
+      children.push_back(it->second);
+    }
+  }
+  std::sort(edges.begin(), edges.end(), [](const Edge& a, const Edge& b) {
+    return std::tie(a.second, a.first) < std::tie(b.second, b.first);
+  });
+  for (auto it = edges.begin(); it != edges.end();) {
+    auto end = std::find_if(it, edges.end(), [&](const Edge& edge) {
+      return edge.second != it->second;
+    });
+    auto& parents = m_nodes[it->second].parents;
+    parents.reserve(end - it);
+    for (; it != end; ++it) {
+      parents.push_back(it->first);
+    }
+  }
+}
+
 void Graph::add_edge(const DexMethod* overridden, const DexMethod* overriding) {
-  m_nodes.update(overridden,
-                 [&](const DexMethod*, Node& node, bool /* exists */) {
-                   node.children.insert(overriding);
-                 });
-  m_nodes.update(overriding,
-                 [&](const DexMethod*, Node& node, bool /* exists */) {
-                   node.parents.insert(overridden);
-                 });
+  auto insert_sorted = [](std::vector<const DexMethod*>& methods,
+                          const DexMethod* method) {
+    auto it = std::lower_bound(methods.begin(), methods.end(), method);
+    if (it == methods.end() || *it != method) {
+      methods.insert(it, method);
+    }
+  };
+  insert_sorted(m_nodes[overridden].children, overriding);
+  insert_sorted(m_nodes[overriding].parents, overridden);
 }
 
 void Graph::dump(std::ostream& os) const {
@@ -234,10 +371,7 @@ void Graph::dump(std::ostream& os) const {
         os << s;
       },
       [&](const DexMethod* method) -> std::vector<const DexMethod*> {
-        const auto& node = get_node(method);
-        std::vector<const DexMethod*> succs(node.children.begin(),
-                                            node.children.end());
-        return succs;
+        return get_node(method).children;
       });
   gw.write(os, boost::adaptors::keys(m_nodes));
 }
@@ -247,48 +381,55 @@ std::unique_ptr<const Graph> build_graph(const Scope& scope) {
   return GraphBuilder(scope).run();
 }
 
+namespace {
+
+/*
+ * Collects the methods reachable from `method` along the given adjacency
+ * lists, optionally skipping interface methods.
+ */
+template <typename Neighbors>
+std::unordered_set<const DexMethod*> collect_transitively(
+    const Graph& graph,
+    const DexMethod* method,
+    bool include_interfaces,
+    const Neighbors& neighbors) {
+  std::unordered_set<const DexMethod*> result;
+  std::unordered_set<const DexMethod*> visited{method};
+  std::vector<const DexMethod*> stack{method};
+  while (!stack.empty()) {
+    const auto* current = stack.back();
+    stack.pop_back();
+    for (const auto* next : neighbors(graph.get_node(current))) {
+      if (!visited.emplace(next).second) {
+        continue;
+      }
+      if (include_interfaces || !is_interface(type_class(next->get_class()))) {
+        result.emplace(next);
+      }
+      stack.push_back(next);
+    }
+  }
+  return result;
+}
+
+} // namespace
+
 std::unordered_set<const DexMethod*> get_overriding_methods(
     const Graph& graph, const DexMethod* method, bool include_interfaces) {
-  std::unordered_set<const DexMethod*> overrides;
-  std::unordered_set<const DexMethod*> visited;
-  std::function<void(const DexMethod*, const Node&)> visit =
-      [&](const DexMethod* current, const Node& node) {
-        if (visited.count(current)) {
-          return;
-        }
-        visited.emplace(current);
-        for (const auto* child : node.children) {
-          auto child_cls = type_class(child->get_class());
-          if (include_interfaces || !is_interface(child_cls)) {
-            overrides.emplace(child);
-          }
-          visit(child, graph.get_node(child));
-        }
-      };
-  visit(method, graph.get_node(method));
-  return overrides;
+  return collect_transitively(
+      graph, method, include_interfaces,
+      [](const Node& node) -> const std::vector<const DexMethod*>& {
+        return node.children;
+      });
 }
 
 std::unordered_set<const DexMethod*> get_overridden_methods(
     const Graph& graph, const DexMethod* method, bool include_interfaces) {
-  std::unordered_set<const DexMethod*> overridden;
-  std::unordered_set<const DexMethod*> visited;
-  std::function<void(const DexMethod*, const Node&)> visit =
-      [&](const DexMethod* current, const Node& node) {
-        if (visited.count(current)) {
-          return;
-        }
-        visited.emplace(current);
-        for (const auto* parent : node.parents) {
-          auto parent_cls = type_class(parent->get_class());
-          if (include_interfaces || !is_interface(parent_cls)) {
-            overridden.emplace(parent);
-          }
-          visit(parent, graph.get_node(parent));
-        }
-      };
-  visit(method, graph.get_node(method));
-  return overridden;
+  return collect_transitively(
+      graph, method, include_interfaces,
+      [](const Node& node) -> const std::vector<const DexMethod*>& {
+        return node.parents;
+      });
 }
 
 bool is_true_virtual(const Graph& graph, const DexMethod* method) {
@@ -7,7 +7,10 @@
 
 #pragma once
 
-#include "ConcurrentContainers.h"
+#include <unordered_map>
+#include <utility>
+#include <vector>
+
 #include "DexClass.h"
 #include "DexStore.h"
 
@@ -64,18 +67,28 @@ inline std::unordered_set<DexMethod*> get_non_true_virtuals(
 
 /*
  * The `children` edges point to the overriders / implementors of the current
- * Node's method.
+ * Node's method. Both lists are sorted by address and free of duplicates.
  */
 struct Node {
-  std::unordered_set<const DexMethod*> parents;
-  std::unordered_set<const DexMethod*> children;
+  std::vector<const DexMethod*> parents;
+  std::vector<const DexMethod*> children;
 };
 
 class Graph {
  public:
+  using Edge = std::pair<const DexMethod* /* overridden */,
+                         const DexMethod* /* overriding */>;
+
+  Graph() = default;
+
+  // Builds the graph with the given edges, which may contain duplicates.
+  explicit Graph(std::vector<Edge> edges);
+
   const Node& get_node(const DexMethod* method) const;
 
-  const ConcurrentMap<const DexMethod*, Node>& nodes() const { return m_nodes; }
+  const std::unordered_map<const DexMethod*, Node>& nodes() const {
+    return m_nodes;
+  }
 
   void add_edge(const DexMethod* overridden, const DexMethod* overriding);
 
@@ -83,7 +96,7 @@ class Graph {
 
  private:
   static Node empty_node;
-  ConcurrentMap<const DexMethod*, Node> m_nodes;
+  std::unordered_map<const DexMethod*, Node> m_nodes;
 };
 
 } // namespace method_override_graph
@@ -7,17 +7,22 @@
 
 #include "MethodProfiles.h"
 
+#include <boost/filesystem.hpp>
+#include <boost/functional/hash.hpp>
+#include <boost/iostreams/device/mapped_file.hpp>
+#include <boost/utility/string_view.hpp>
+#include <fstream>
 #include <iostream>
-#include <stdio.h>
+#include <limits>
 #include <stdlib.h>
+#include <string.h>
 
 #include "Timer.h"
 #include "Trace.h"
+#include "WorkQueue.h"
 
 using namespace method_profiles;
 
-extern int errno;
-
 const StatsMap& MethodProfiles::method_stats(
     const std::string& interaction_id) const {
   const auto& search1 = m_method_stats.find(interaction_id);
@@ -38,147 +43,516 @@ const StatsMap& MethodProfiles::method_stats(
   return empty_map;
 }
 
-bool MethodProfiles::parse_stats_file(const std::string& csv_filename) {
-  TRACE(METH_PROF, 3, "input csv filename: %s", csv_filename.c_str());
-  if (csv_filename.empty()) {
-    TRACE(METH_PROF, 2, "No csv file given");
-    return false;
+void MethodProfiles::set_weighted_stats_config(
+    const WeightedStatsConfig& config) {
+  m_weighted_stats_config = config;
+  m_weighted_stats.clear();
+  double total_weight = 0;
+  for (const auto& pair : config.interaction_weights) {
+    total_weight += pair.second;
   }
-  Timer t("Parsing agg_method_stats_file");
-
-  auto cleanup = [](FILE* fp, char* line = nullptr) {
-    if (fp) {
-      fclose(fp);
+  if (total_weight <= 0) {
+    return;
+  }
+  // The weights of the interactions in which each method appears, to average
+  // its order percent.
+  std::unordered_map<const DexMethodRef*, double> order_weights;
+  for (const auto& pair : config.interaction_weights) {
+    const auto& stats = method_stats(pair.first);
+    double weight = pair.second / total_weight;
+    for (const auto& entry : stats) {
+      const auto& stat = entry.second;
+      auto it = m_weighted_stats.find(entry.first);
+      if (it == m_weighted_stats.end()) {
+        it = m_weighted_stats.emplace(entry.first, Stats()).first;
+        it->second.min_api_level = stat.min_api_level;
+      }
+      auto& weighted = it->second;
+      weighted.appear_percent += weight * stat.appear_percent;
+      weighted.call_count += weight * stat.call_count;
+      weighted.order_percent += pair.second * stat.order_percent;
+      weighted.min_api_level =
+          std::min(weighted.min_api_level, stat.min_api_level);
+      order_weights[entry.first] += pair.second;
     }
-    if (line) {
-      // getline allocates buffer space and expects us to free it
-      free(line);
+  }
+  for (auto& entry : m_weighted_stats) {
+    auto order_weight = order_weights.at(entry.first);
+    if (order_weight > 0) {
+      entry.second.order_percent /= order_weight;
     }
+  }
+  TRACE(METH_PROF, 1, "MethodProfiles combined %zu interactions into %zu rows",
+        config.interaction_weights.size(), m_weighted_stats.size());
+}
+
+namespace method_profiles {
+
+struct ParsedProfile {
+  struct Row {
+    uint32_t interaction;
+    uint32_t name;
+    Stats stats;
   };
+  std::vector<std::string> interactions;
+  std::vector<boost::string_view> names;
+  std::vector<Row> rows;
+};
 
-  // Using C-style file reading and parsing because it's faster than the
-  // iostreams equivalent and we expect to read very large csv files.
-  FILE* fp = fopen(csv_filename.c_str(), "r");
-  if (fp == nullptr) {
-    std::cerr << "FAILED to open " << csv_filename << ": " << strerror(errno)
-              << "\n";
-    cleanup(fp);
-    return false;
-  }
+struct PendingProfile {
+  // The names of parsed point into the file.
+  boost::iostreams::mapped_file_source file;
+  ParsedProfile parsed;
+};
 
-  // getline will allocate a buffer and put a pointer to it here
-  char* line = nullptr;
-  size_t len = 0;
-  bool first = true;
-  while (getline(&line, &len, fp) != -1) {
-    bool success = parse_line(line, first);
-    if (!success) {
-      cleanup(fp, line);
-      return false;
-    }
-    first = false;
-  }
-  if (errno != 0) {
-    std::cerr << "FAILED to read a line: " << strerror(errno) << "\n";
-    cleanup(fp, line);
-    return false;
-  }
+} // namespace method_profiles
 
-  size_t total_rows = 0;
-  for (const auto& pair : m_method_stats) {
-    total_rows += pair.second.size();
+namespace {
+
+// The binary format is, in host byte order:
+//   magic, uint32 version,
+//   uint32 count, then count interactions as uint32 size and chars,
+//   uint32 count, then count method names as uint32 size and chars,
+//   uint32 count, then count rows as uint32 interaction index, uint32 name
+//     index, double appear_percent, double call_count, double order_percent
+//     and uint8 min_api_level.
+constexpr char BINARY_MAGIC[] = "RDXMPROF";
+constexpr size_t BINARY_MAGIC_SIZE = sizeof(BINARY_MAGIC) - 1;
+constexpr uint32_t BINARY_VERSION = 1;
+
+// The csv rows are split in chunks of about this many bytes, which are parsed
+// in parallel.
+constexpr size_t CSV_CHUNK_SIZE = 1 << 20;
+
+constexpr uint32_t NO_COLUMN = std::numeric_limits<uint32_t>::max();
+
+struct StringViewHash {
+  size_t operator()(boost::string_view str) const {
+    return boost::hash_range(str.begin(), str.end());
   }
-  TRACE(METH_PROF, 1, "MethodProfiles successfully parsed %zu rows",
-        total_rows);
-  cleanup(fp, line);
-  return true;
+};
+
+// A csv row, whose cells point into the mapped file.
+struct CsvRow {
+  boost::string_view interaction;
+  boost::string_view name;
+  Stats stats;
+};
+
+struct CsvChunk {
+  const char* begin;
+  const char* end;
+  std::vector<CsvRow> rows;
+  bool success{true};
+};
+
+// The numbers are copied out of the mapped file, which isn't NUL-terminated.
+template <class T, class Parse>
+T parse_number(boost::string_view tok, const char* type, const Parse& parse) {
+  char buf[64];
+  always_assert_log(tok.size() < sizeof(buf), "can't parse %s into a %s",
+                    tok.to_string().c_str(), type);
+  memcpy(buf, tok.data(), tok.size());
+  buf[tok.size()] = '\0';
+  char* rest = nullptr;
+  auto result = parse(buf, &rest);
+  always_assert_log(rest != buf && *rest == '\0', "can't parse %s into a %s",
+                    buf, type);
+  return result;
 }
 
-bool MethodProfiles::parse_line(char* line, bool first) {
-  if (first) {
-    return parse_header(line);
-  }
+uint8_t parse_byte(boost::string_view tok) {
+  return parse_number<uint8_t>(tok, "uint8_t", [](const char* s, char** rest) {
+    return static_cast<uint8_t>(strtoul(s, rest, 10));
+  });
+}
 
-  auto parse_byte = [](const char* tok) -> uint8_t {
-    char* rest = nullptr;
-    const auto result = static_cast<uint8_t>(strtoul(tok, &rest, 10));
-    const auto len = strlen(rest);
-    always_assert_log(rest != tok, "can't parse %s into a uint8_t", tok);
-    always_assert_log(len == 0 || (len == 1 && rest[0] == '\n'),
-                      "can't parse %s into a uint8_t", tok);
-    return result;
-  };
-  auto parse_double = [](const char* tok) -> double {
-    char* rest = nullptr;
-    const auto result = strtod(tok, &rest);
-    const auto len = strlen(rest);
-    always_assert_log(rest != tok, "can't parse %s into a double", tok);
-    always_assert_log(len == 0 || (len == 1 && rest[0] == '\n'),
-                      "can't parse %s into a double", tok);
-    return result;
-  };
+double parse_double(boost::string_view tok) {
+  return parse_number<double>(tok, "double", [](const char* s, char** rest) {
+    return strtod(s, rest);
+  });
+}
 
-  Stats stats;
-  std::string interaction_id = "";
-  DexMethodRef* ref = nullptr;
-  auto parse_cell = [&](char* tok, uint32_t i) -> bool {
-    switch (i) {
+// Returns false if the row has an unknown extra column. Rows without a name
+// are left with an empty one.
+bool parse_csv_row(boost::string_view line,
+                   uint32_t interaction_column,
+                   CsvRow* row) {
+  uint32_t i = 0;
+  size_t pos = 0;
+  while (pos < line.size()) {
+    size_t comma = line.find(',', pos);
+    if (comma == boost::string_view::npos) {
+      comma = line.size();
+    }
+    auto tok = line.substr(pos, comma - pos);
+    pos = comma + 1;
+    if (tok.empty()) {
+      // Like strtok, consecutive commas delimit a single column.
+      continue;
+    }
+    switch (i++) {
     case INDEX:
       // Don't need this raw data. It's an arbitrary index (the line number in
       // the file)
-      return true;
+      break;
     case NAME:
-      ref = DexMethod::get_method</*kCheckFormat=*/true>(tok);
-      if (ref == nullptr) {
-        TRACE(METH_PROF, 6, "failed to resolve %s", tok);
-      }
-      return true;
+      row->name = tok;
+      break;
     case APPEAR100:
-      stats.appear_percent = parse_double(tok);
-      return true;
+      row->stats.appear_percent = parse_double(tok);
+      break;
     case APPEAR_NUMBER:
       // Don't need this raw data. appear_percent is the same thing but
       // normalized
-      return true;
+      break;
     case AVG_CALL:
-      stats.call_count = parse_double(tok);
-      return true;
+      row->stats.call_count = parse_double(tok);
+      break;
     case AVG_ORDER:
       // Don't need this raw data. order_percent is the same thing but
       // normalized
-      return true;
+      break;
     case AVG_RANK100:
-      stats.order_percent = parse_double(tok);
-      return true;
+      row->stats.order_percent = parse_double(tok);
+      break;
     case MIN_API_LEVEL:
-      stats.min_api_level = parse_byte(tok);
-      return true;
+      row->stats.min_api_level = parse_byte(tok);
+      break;
     default:
-      const auto& search = m_optional_columns.find(i);
-      if (search != m_optional_columns.end()) {
-        if (search->second == "interaction") {
-          interaction_id = tok;
-          if (interaction_id.back() == '\n') {
-            interaction_id.resize(interaction_id.size() - 1);
-          }
-          return true;
-        }
+      if (i - 1 == interaction_column) {
+        row->interaction = tok;
+        break;
       }
       std::cerr << "FAILED to parse line. Unknown extra column\n";
       return false;
     }
-  };
+  }
+  return true;
+}
 
-  bool success = parse_cells(line, parse_cell);
-  if (!success) {
+void parse_csv_chunk(uint32_t interaction_column, CsvChunk* chunk) {
+  const char* line = chunk->begin;
+  while (line < chunk->end) {
+    auto line_end =
+        static_cast<const char*>(memchr(line, '\n', chunk->end - line));
+    if (line_end == nullptr) {
+      line_end = chunk->end;
+    }
+    CsvRow row;
+    if (!parse_csv_row(boost::string_view(line, line_end - line),
+                       interaction_column, &row)) {
+      chunk->success = false;
+      return;
+    }
+    if (!row.name.empty()) {
+      chunk->rows.push_back(row);
+    }
+    line = line_end + 1;
+  }
+}
+
+// Reads the binary format, checking that it doesn't run past the end.
+class BinaryReader {
+ public:
+  BinaryReader(const char* data, size_t size)
+      : m_pos(data), m_end(data + size) {}
+
+  template <class T>
+  bool read(T* value) {
+    if (static_cast<size_t>(m_end - m_pos) < sizeof(T)) {
+      return false;
+    }
+    memcpy(value, m_pos, sizeof(T));
+    m_pos += sizeof(T);
+    return true;
+  }
+
+  bool read(boost::string_view* str) {
+    uint32_t size;
+    if (!read(&size) || static_cast<size_t>(m_end - m_pos) < size) {
+      return false;
+    }
+    *str = boost::string_view(m_pos, size);
+    m_pos += size;
+    return true;
+  }
+
+ private:
+  const char* m_pos;
+  const char* m_end;
+};
+
+bool is_binary_profile(const char* data, size_t size) {
+  return size >= BINARY_MAGIC_SIZE &&
+         memcmp(data, BINARY_MAGIC, BINARY_MAGIC_SIZE) == 0;
+}
+
+bool parse_binary_profile(const char* data,
+                          size_t size,
+                          ParsedProfile* parsed) {
+  BinaryReader reader(data + BINARY_MAGIC_SIZE, size - BINARY_MAGIC_SIZE);
+  uint32_t version;
+  if (!reader.read(&version) || version != BINARY_VERSION) {
+    std::cerr << "FAILED to parse binary profile. Unsupported version\n";
+    return false;
+  }
+  uint32_t count;
+  if (!reader.read(&count)) {
+    return false;
+  }
+  parsed->interactions.reserve(count);
+  for (uint32_t i = 0; i < count; ++i) {
+    boost::string_view interaction;
+    if (!reader.read(&interaction)) {
+      return false;
+    }
+    parsed->interactions.push_back(interaction.to_string());
+  }
+  if (!reader.read(&count)) {
     return false;
   }
-  if (ref != nullptr) {
+  parsed->names.resize(count);
+  for (auto& name : parsed->names) {
+    if (!reader.read(&name)) {
+      return false;
+    }
+  }
+  if (!reader.read(&count)) {
+    return false;
+  }
+  parsed->rows.resize(count);
+  for (auto& row : parsed->rows) {
+    if (!reader.read(&row.interaction) || !reader.read(&row.name) ||
+        !reader.read(&row.stats.appear_percent) ||
+        !reader.read(&row.stats.call_count) ||
+        !reader.read(&row.stats.order_percent) ||
+        !reader.read(&row.stats.min_api_level)) {
+      return false;
+    }
+    if (row.interaction >= parsed->interactions.size() ||
+        row.name >= parsed->names.size()) {
+      std::cerr << "FAILED to parse binary profile. Index out of bounds\n";
+      return false;
+    }
+  }
+  return true;
+}
+
+template <class T>
+void write_binary(std::ostream& os, const T& value) {
+  os.write(reinterpret_cast<const char*>(&value), sizeof(T));
+}
+
+void write_binary(std::ostream& os, boost::string_view str) {
+  write_binary<uint32_t>(os, str.size());
+  os.write(str.data(), str.size());
+}
+
+} // namespace
+
+// Read a "simple" csv file (no quoted commas or extra spaces), or a binary
+// profile.
+bool MethodProfiles::parse(const std::string& profile_filename) {
+  TRACE(METH_PROF, 3, "input profile filename: %s", profile_filename.c_str());
+  if (profile_filename.empty()) {
+    TRACE(METH_PROF, 2, "No csv file given");
+    return false;
+  }
+  Timer t("Parsing agg_method_stats_file");
+
+  // The file is mapped rather than read, and its names are resolved in place,
+  // since we expect to read very large csv files.
+  auto pending = std::make_shared<PendingProfile>();
+  auto& file = pending->file;
+  try {
+    if (boost::filesystem::file_size(profile_filename) != 0) {
+      // Empty files can't be mapped.
+      file.open(profile_filename);
+    }
+  } catch (const std::exception& e) {
+    std::cerr << "FAILED to open " << profile_filename << ": " << e.what()
+              << "\n";
+    return false;
+  }
+  if (file.is_open() &&
+      !parse_profile(file.data(), file.size(), &pending->parsed)) {
+    return false;
+  }
+  m_pending = std::move(pending);
+  return true;
+}
+
+bool MethodProfiles::resolve_parsed() {
+  always_assert(m_pending != nullptr);
+  Timer t("Resolving agg_method_stats_file");
+  const auto& parsed = m_pending->parsed;
+
+  // Resolve each distinct name once. The lookups don't create anything, so
+  // they can run in parallel.
+  std::vector<DexMethodRef*> refs(parsed.names.size());
+  auto wq = workqueue_foreach<size_t>([&](size_t i) {
+    refs[i] = DexMethod::get_method</*kCheckFormat=*/true>(
+        parsed.names[i].to_string());
+    if (refs[i] == nullptr) {
+      TRACE(METH_PROF, 6, "failed to resolve %s",
+            parsed.names[i].to_string().c_str());
+    }
+  });
+  for (size_t i = 0; i < refs.size(); ++i) {
+    wq.add_item(i);
+  }
+  wq.run_all();
+
+  for (const auto& row : parsed.rows) {
+    auto ref = refs[row.name];
+    if (ref == nullptr) {
+      continue;
+    }
+    const auto& interaction_id = parsed.interactions[row.interaction];
+    const auto& stats = row.stats;
     TRACE(METH_PROF, 6, "(%s, %s) -> {%f, %f, %f, %u}", SHOW(ref),
           interaction_id.c_str(), stats.appear_percent, stats.call_count,
           stats.order_percent, stats.min_api_level);
     m_method_stats[interaction_id].emplace(ref, stats);
   }
+
+  size_t total_rows = 0;
+  for (const auto& pair : m_method_stats) {
+    total_rows += pair.second.size();
+  }
+  TRACE(METH_PROF, 1, "MethodProfiles successfully parsed %zu rows",
+        total_rows);
+  return true;
+}
+
+bool MethodProfiles::parse_profile(const char* data,
+                                   size_t size,
+                                   ParsedProfile* parsed) {
+  if (is_binary_profile(data, size)) {
+    if (!parse_binary_profile(data, size, parsed)) {
+      std::cerr << "FAILED to parse binary profile\n";
+      return false;
+    }
+    return true;
+  }
+  const char* end = data + size;
+  auto header_end = static_cast<const char*>(memchr(data, '\n', size));
+  if (header_end == nullptr) {
+    header_end = end;
+  }
+  std::string header(data, header_end);
+  if (!parse_header(&header[0])) {
+    return false;
+  }
+  if (header_end == end) {
+    return true;
+  }
+  return parse_csv_rows(header_end + 1, end, parsed);
+}
+
+bool MethodProfiles::parse_csv_rows(const char* begin,
+                                    const char* end,
+                                    ParsedProfile* parsed) const {
+  uint32_t interaction_column = NO_COLUMN;
+  for (const auto& pair : m_optional_columns) {
+    if (pair.second == "interaction") {
+      interaction_column = pair.first;
+    }
+  }
+
+  // Split the rows on line boundaries.
+  std::vector<CsvChunk> chunks;
+  while (begin < end) {
+    const char* chunk_end = end;
+    if (static_cast<size_t>(end - begin) > CSV_CHUNK_SIZE) {
+      auto newline = static_cast<const char*>(
+          memchr(begin + CSV_CHUNK_SIZE, '\n', end - begin - CSV_CHUNK_SIZE));
+      if (newline != nullptr) {
+        chunk_end = newline + 1;
+      }
+    }
+    chunks.push_back(CsvChunk{begin, chunk_end, {}});
+    begin = chunk_end;
+  }
+  auto wq = workqueue_foreach<CsvChunk*>([interaction_column](CsvChunk* chunk) {
+    parse_csv_chunk(interaction_column, chunk);
+  });
+  for (auto& chunk : chunks) {
+    wq.add_item(&chunk);
+  }
+  wq.run_all();
+
+  // Keep the rows in file order, so that the first row wins when a method
+  // appears twice in an interaction.
+  std::unordered_map<boost::string_view, uint32_t, StringViewHash>
+      interaction_index;
+  std::unordered_map<boost::string_view, uint32_t, StringViewHash> name_index;
+  for (const auto& chunk : chunks) {
+    if (!chunk.success) {
+      return false;
+    }
+    for (const auto& row : chunk.rows) {
+      auto interaction = interaction_index.emplace(
+          row.interaction, parsed->interactions.size());
+      if (interaction.second) {
+        parsed->interactions.push_back(row.interaction.to_string());
+      }
+      auto name = name_index.emplace(row.name, parsed->names.size());
+      if (name.second) {
+        parsed->names.push_back(row.name);
+      }
+      parsed->rows.push_back(
+          {interaction.first->second, name.first->second, row.stats});
+    }
+  }
+  return true;
+}
+
+bool MethodProfiles::write_binary_profile(const std::string& profile_filename,
+                                          const std::string& binary_filename) {
+  boost::iostreams::mapped_file_source file;
+  try {
+    if (boost::filesystem::file_size(profile_filename) != 0) {
+      file.open(profile_filename);
+    }
+  } catch (const std::exception& e) {
+    std::cerr << "FAILED to open " << profile_filename << ": " << e.what()
+              << "\n";
+    return false;
+  }
+  MethodProfiles profiles;
+  ParsedProfile parsed;
+  if (file.is_open() &&
+      !profiles.parse_profile(file.data(), file.size(), &parsed)) {
+    return false;
+  }
+
+  std::ofstream os(binary_filename, std::ios::binary);
+  os.write(BINARY_MAGIC, BINARY_MAGIC_SIZE);
+  write_binary(os, BINARY_VERSION);
+  write_binary<uint32_t>(os, parsed.interactions.size());
+  for (const auto& interaction : parsed.interactions) {
+    write_binary(os, boost::string_view(interaction));
+  }
+  write_binary<uint32_t>(os, parsed.names.size());
+  for (const auto& name : parsed.names) {
+    write_binary(os, name);
+  }
+  write_binary<uint32_t>(os, parsed.rows.size());
+  for (const auto& row : parsed.rows) {
+    write_binary(os, row.interaction);
+    write_binary(os, row.name);
+    write_binary(os, row.stats.appear_percent);
+    write_binary(os, row.stats.call_count);
+    write_binary(os, row.stats.order_percent);
+    write_binary(os, row.stats.min_api_level);
+  }
+  os.close();
+  if (!os) {
+    std::cerr << "FAILED to write " << binary_filename << "\n";
+    return false;
+  }
   return true;
 }
 
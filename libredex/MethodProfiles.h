@@ -8,6 +8,7 @@
 #pragma once
 
 #include <boost/optional.hpp>
+#include <memory>
 
 #include "DexClass.h"
 
@@ -46,16 +47,47 @@ using StatsMap = std::unordered_map<const DexMethodRef*, Stats>;
 using AllInteractions = std::map<std::string, StatsMap>;
 const std::string COLD_START = "ColdStart";
 
+// How the interactions are combined into a single stat per method, for the
+// consumers that optimize for several latency metrics at once. It is read
+// from the method_profile_weights config, e.g.
+//   {"interactions": {"ColdStart": 1, "Scroll": 0.5}, "hot_percentile": 0.05}
+struct WeightedStatsConfig {
+  // The interactions that are combined, and how much each of them counts.
+  std::map<std::string, double> interaction_weights;
+  // Methods whose weighted call count is in the top warm_percentile (resp.
+  // hot_percentile) of the popular methods are warm (resp. hot).
+  double warm_percentile{0.25};
+  double hot_percentile{0.1};
+};
+
+// The rows of a profile file, before the method names are resolved.
+struct ParsedProfile;
+// A mapped profile file and its parsed rows.
+struct PendingProfile;
+
 class MethodProfiles {
  public:
   MethodProfiles() {}
 
-  bool initialize(const std::string& csv_filename) {
+  // The file is either a csv or a binary profile, see write_binary_profile.
+  bool initialize(const std::string& profile_filename) {
+    return initialize_parsed(parse(profile_filename));
+  }
+
+  // The first half of initialize: reads the file without resolving its
+  // method names, so that it doesn't need the dexes and can run on a
+  // background thread while they load.
+  bool parse(const std::string& profile_filename);
+
+  // The second half of initialize: resolves the names of what parse read,
+  // given whether it succeeded.
+  bool initialize_parsed(bool parsed) {
     m_initialized = true;
-    bool success = parse_stats_file(csv_filename);
+    bool success = parsed && resolve_parsed();
     if (!success) {
       m_method_stats.clear();
     }
+    m_pending.reset();
     return success;
   }
 
@@ -69,6 +101,12 @@ class MethodProfiles {
     return ret;
   }
 
+  // Convert a profile file to the binary format, which loads faster than the
+  // csv since its numbers are not text and its method names are deduplicated.
+  // The names are kept unresolved, so this doesn't need the dexes.
+  static bool write_binary_profile(const std::string& profile_filename,
+                                   const std::string& binary_filename);
+
   bool is_initialized() const { return m_initialized; }
 
   bool has_stats() const { return !m_method_stats.empty(); }
@@ -79,6 +117,30 @@ class MethodProfiles {
 
   const AllInteractions& all_interactions() const { return m_method_stats; }
 
+  // Combine the interactions with the given weights. The result is computed
+  // once here, so that the consumers can share it, even concurrently.
+  //
+  // For each method, the appear percent and call count are the weighted
+  // averages over the interactions, counting the interactions in which the
+  // method doesn't appear as zeros. The order percent is the weighted average
+  // over the interactions in which it appears, and the min api level is the
+  // minimum over those.
+  void set_weighted_stats_config(const WeightedStatsConfig& config);
+
+  bool has_weighted_stats() const {
+    return m_weighted_stats_config != boost::none;
+  }
+
+  const WeightedStatsConfig& weighted_stats_config() const {
+    return *m_weighted_stats_config;
+  }
+
+  // The combined stats if weights were configured, and the cold start ones
+  // otherwise.
+  const StatsMap& weighted_stats() const {
+    return has_weighted_stats() ? m_weighted_stats : method_stats(COLD_START);
+  }
+
   boost::optional<Stats> get_method_stat(const std::string& interaction_id,
                                          const DexMethodRef* m) const {
     const auto& stats = method_stats(interaction_id);
@@ -91,16 +153,23 @@ class MethodProfiles {
 
  private:
   AllInteractions m_method_stats;
+  boost::optional<WeightedStatsConfig> m_weighted_stats_config;
+  StatsMap m_weighted_stats;
   bool m_initialized{false};
   // A map from column index to column header
   std::unordered_map<uint32_t, std::string> m_optional_columns;
-
-  // Read a "simple" csv file (no quoted commas or extra spaces) and populate
-  // m_method_stats
-  bool parse_stats_file(const std::string& csv_filename);
-  // Read a line from the "simple" csv file and put an entry into
-  // m_method_stats
-  bool parse_line(char* line, bool first);
+  // What parse read, until initialize_parsed resolves it.
+  std::shared_ptr<PendingProfile> m_pending;
+
+  // Populate m_method_stats from m_pending
+  bool resolve_parsed();
+  // Parse the rows of a mapped profile file. The names in parsed point into
+  // the data.
+  bool parse_profile(const char* data, size_t size, ParsedProfile* parsed);
+  // Parse the rows that follow the header of a csv file, in parallel
+  bool parse_csv_rows(const char* begin,
+                      const char* end,
+                      ParsedProfile* parsed) const;
   // Parse the first line and make sure it matches our expectations
   bool parse_header(char* line);
 
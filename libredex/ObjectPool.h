@@ -0,0 +1,216 @@
+/*
+ * Copyright (c) Facebook, Inc. and its affiliates.
+ *
+ * This source code is licensed under the MIT license found in the
+ * LICENSE file in the root directory of this source tree.
+ */
+
+#pragma once
+
+#include <algorithm>
+#include <cstddef>
+#include <memory>
+#include <mutex>
+#include <new>
+#include <vector>
+
+#if defined(__SANITIZE_ADDRESS__)
+#define REDEX_OBJECT_POOL_DISABLED
+#elif defined(__has_feature)
+#if __has_feature(address_sanitizer)
+#define REDEX_OBJECT_POOL_DISABLED
+#endif
+#endif
+
+/**
+ * An allocator for the objects of a single type that are created by the
+ * million, such as the instructions of an IRList. Objects are carved out of
+ * large slabs, so that the objects of a method are mostly contiguous, and the
+ * memory of deleted objects is recycled for new ones instead of being
+ * returned to the heap.
+ *
+ * Each thread allocates from and frees to its own cache of slots, so neither
+ * operation takes a lock in the common case. A thread returns its free slots
+ * to a shared list when it holds too many of them and when it exits. Slabs
+ * are only released when the process exits.
+ *
+ * A class opts in with the REDEX_POOLED_ALLOCATION macro. Address sanitizer
+ * builds fall back to the heap, so that uses after free are still detected.
+ */
+template <typename T>
+class ObjectPool final {
+ public:
+  static void* allocate() {
+#ifdef REDEX_OBJECT_POOL_DISABLED
+    return ::operator new(sizeof(T));
+#else
+    return cache().allocate();
+#endif
+  }
+
+  static void deallocate(void* p) {
+#ifdef REDEX_OBJECT_POOL_DISABLED
+    ::operator delete(p);
+#else
+    cache().deallocate(p);
+#endif
+  }
+
+ private:
+  union Slot {
+    Slot* next;
+    alignas(T) char storage[sizeof(T)];
+  };
+
+  static constexpr size_t SLOTS_PER_SLAB =
+      std::max<size_t>(1, (64 << 10) / sizeof(Slot));
+
+  // A thread that frees more objects than it allocates gives the excess back.
+  static constexpr size_t MAX_CACHED_SLOTS = 4 * SLOTS_PER_SLAB;
+
+  struct FreeList {
+    Slot* head{nullptr};
+    Slot* tail{nullptr};
+    size_t size{0};
+
+    void push(Slot* slot) {
+      slot->next = head;
+      if (head == nullptr) {
+        tail = slot;
+      }
+      head = slot;
+      ++size;
+    }
+
+    Slot* pop() {
+      Slot* slot = head;
+      head = slot->next;
+      if (head == nullptr) {
+        tail = nullptr;
+      }
+      --size;
+      return slot;
+    }
+
+    // Moves all the slots of the other list to this one.
+    void splice(FreeList* other) {
+      if (other->head == nullptr) {
+        return;
+      }
+      other->tail->next = head;
+      if (head == nullptr) {
+        tail = other->tail;
+      }
+      head = other->head;
+      size += other->size;
+      *other = FreeList();
+    }
+  };
+
+  struct Shared {
+    std::mutex mutex;
+    FreeList free_slots;
+    std::vector<std::unique_ptr<Slot[]>> slabs;
+  };
+
+  // Never destroyed, since threads may still return their slots while static
+  // objects are being destroyed.
+  static Shared& shared() {
+    static auto* shared = new Shared();
+    return *shared;
+  }
+
+  // Trivially destructible, so that objects deleted by the destructors of
+  // other thread-local objects can still use it after it has been released.
+  class Cache {
+   public:
+    // Gives all the slots back when the thread exits.
+    void release() {
+      while (m_slab_begin != m_slab_end) {
+        m_free_slots.push(m_slab_begin++);
+      }
+      give_back();
+      m_released = true;
+    }
+
+    void* allocate() {
+      if (m_released) {
+        return shared_allocate();
+      }
+      if (m_free_slots.head == nullptr) {
+        take_shared_slots();
+      }
+      if (m_free_slots.head != nullptr) {
+        return m_free_slots.pop();
+      }
+      if (m_slab_begin == m_slab_end) {
+        new_slab();
+      }
+      return m_slab_begin++;
+    }
+
+    void deallocate(void* p) {
+      m_free_slots.push(static_cast<Slot*>(p));
+      if (m_released || m_free_slots.size > MAX_CACHED_SLOTS) {
+        give_back();
+      }
+    }
+
+   private:
+    void* shared_allocate() {
+      auto& s = shared();
+      std::lock_guard<std::mutex> lock(s.mutex);
+      if (s.free_slots.head == nullptr) {
+        s.slabs.emplace_back(new Slot[SLOTS_PER_SLAB]);
+        for (size_t i = 0; i < SLOTS_PER_SLAB; ++i) {
+          s.free_slots.push(&s.slabs.back()[i]);
+        }
+      }
+      return s.free_slots.pop();
+    }
+
+    void take_shared_slots() {
+      auto& s = shared();
+      std::lock_guard<std::mutex> lock(s.mutex);
+      m_free_slots.splice(&s.free_slots);
+    }
+
+    void give_back() {
+      auto& s = shared();
+      std::lock_guard<std::mutex> lock(s.mutex);
+      s.free_slots.splice(&m_free_slots);
+    }
+
+    void new_slab() {
+      auto& s = shared();
+      std::lock_guard<std::mutex> lock(s.mutex);
+      s.slabs.emplace_back(new Slot[SLOTS_PER_SLAB]);
+      m_slab_begin = s.slabs.back().get();
+      m_slab_end = m_slab_begin + SLOTS_PER_SLAB;
+    }
+
+    FreeList m_free_slots;
+    // The slots of the current slab that have never been allocated.
+    Slot* m_slab_begin{nullptr};
+    Slot* m_slab_end{nullptr};
+    bool m_released{false};
+  };
+
+  struct CacheReleaser {
+    Cache* cache;
+    ~CacheReleaser() { cache->release(); }
+  };
+
+  static Cache& cache() {
+    static thread_local Cache cache;
+    static thread_local CacheReleaser releaser{&cache};
+    return cache;
+  }
+};
+
+/*
+ * Allocates the objects of a final class from its ObjectPool.
+ */
+#define REDEX_POOLED_ALLOCATION(T)                                        \
+  static void* operator new(size_t) { return ObjectPool<T>::allocate(); }   \
+  static void operator delete(void* p) { ObjectPool<T>::deallocate(p); }
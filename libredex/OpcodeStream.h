@@ -0,0 +1,132 @@
+/*
+ * Copyright (c) Facebook, Inc. and its affiliates.
+ *
+ * This source code is licensed under the MIT license found in the
+ * LICENSE file in the root directory of this source tree.
+ */
+
+#pragma once
+
+#include <bitset>
+#include <cstdint>
+#include <cstring>
+#include <vector>
+
+#include "IRInstruction.h"
+#include "IROpcode.h"
+
+// The number of IR opcodes, which all fit in a byte.
+constexpr size_t NUM_IR_OPCODES =
+    static_cast<size_t>(IOPCODE_MOVE_RESULT_PSEUDO_WIDE) + 1;
+static_assert(NUM_IR_OPCODES <= 256, "IR opcodes must fit in a byte");
+
+/*
+ * A set of opcodes, e.g., the opcodes that can start a pattern.
+ */
+class OpcodeSet final {
+ public:
+  OpcodeSet() = default;
+
+  template <typename Opcodes>
+  explicit OpcodeSet(const Opcodes& opcodes) {
+    for (auto op : opcodes) {
+      insert(static_cast<IROpcode>(op));
+    }
+  }
+
+  void insert(IROpcode op) {
+    if (!m_bits.test(op)) {
+      m_bits.set(op);
+      if (m_size++ == 0) {
+        m_first = static_cast<uint8_t>(op);
+      }
+    }
+  }
+
+  bool contains(IROpcode op) const { return m_bits.test(op); }
+
+  size_t size() const { return m_size; }
+
+  bool intersects(const OpcodeSet& other) const {
+    return (m_bits & other.m_bits).any();
+  }
+
+  OpcodeSet& operator|=(const OpcodeSet& other) {
+    m_bits |= other.m_bits;
+    m_size = m_bits.count();
+    if (m_size == 1) {
+      for (size_t op = 0; op < NUM_IR_OPCODES; ++op) {
+        if (m_bits.test(op)) {
+          m_first = static_cast<uint8_t>(op);
+        }
+      }
+    }
+    return *this;
+  }
+
+ private:
+  friend class OpcodeStream;
+
+  std::bitset<NUM_IR_OPCODES> m_bits;
+  size_t m_size{0};
+  // The opcode of a singleton set, which is searched for with memchr.
+  uint8_t m_first{0};
+};
+
+/*
+ * A contiguous view of the opcodes of a sequence of instructions, e.g., of a
+ * basic block. Pattern matchers use it to find the instructions at which a
+ * match can start, and to skip the sequences that contain none of them,
+ * without walking the linked list of the IRList. The view is a snapshot: it
+ * must be built again after the instructions are edited.
+ */
+class OpcodeStream final {
+ public:
+  template <typename InstructionIterable>
+  explicit OpcodeStream(InstructionIterable&& iterable) {
+    for (auto& mie : iterable) {
+      auto op = mie.insn->opcode();
+      m_opcodes.push_back(static_cast<uint8_t>(op));
+      m_insns.push_back(mie.insn);
+      m_present.insert(op);
+    }
+  }
+
+  size_t size() const { return m_insns.size(); }
+
+  IRInstruction* insn(size_t i) const { return m_insns[i]; }
+
+  IROpcode opcode(size_t i) const {
+    return static_cast<IROpcode>(m_opcodes[i]);
+  }
+
+  // The opcodes of all the instructions of the stream.
+  const OpcodeSet& opcodes() const { return m_present; }
+
+  /*
+   * Returns the index of the first instruction at or after `from` whose
+   * opcode is in the set, or size() if there is none.
+   */
+  size_t find_first_of(const OpcodeSet& set, size_t from) const {
+    const size_t n = m_opcodes.size();
+    if (from >= n || !set.intersects(m_present)) {
+      return n;
+    }
+    const uint8_t* data = m_opcodes.data();
+    if (set.size() == 1) {
+      const void* found = std::memchr(data + from, set.m_first, n - from);
+      return found == nullptr ? n : static_cast<const uint8_t*>(found) - data;
+    }
+    for (size_t i = from; i < n; ++i) {
+      if (set.m_bits.test(data[i])) {
+        return i;
+      }
+    }
+    return n;
+  }
+
+ private:
+  std::vector<uint8_t> m_opcodes;
+  std::vector<IRInstruction*> m_insns;
+  OpcodeSet m_present;
+};
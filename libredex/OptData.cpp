@@ -7,12 +7,13 @@
 
 #include "OptData.h"
 
+#include <algorithm>
+#include <boost/functional/hash.hpp>
 #include <cstdarg>
 #include <cstdio>
 #include <cstdlib>
 #include <cstring>
 #include <fstream>
-#include <json/json.h>
 #include <mutex>
 #include <string>
 #include <unordered_map>
@@ -127,58 +128,45 @@ void log_nopt(NoptReason nopt, const DexClass* cls) {
   OptDataMapper::get_instance().log_nopt(nopt, cls);
 }
 
-InsnOptData::InsnOptData(const DexMethod* method, const IRInstruction* insn)
-    : m_method(method) {
-  m_insn_orig = SHOW(insn);
-  m_has_line_num = get_line_num(method, insn, &m_line_num);
-}
-
-MethodOptData::MethodOptData(const DexMethod* method) : m_method(method) {
-  m_method_orig = SHOW(method);
-  m_has_line_num = get_line_num(method, nullptr, &m_line_num);
-}
-
-std::shared_ptr<InsnOptData> MethodOptData::get_insn_opt_data(
-    const IRInstruction* insn) {
-  const auto& kv_pair = m_insn_opt_map.find(insn);
-  if (kv_pair == m_insn_opt_map.end()) {
-    auto insn_opt_data = std::make_shared<InsnOptData>(m_method, insn);
-    m_insn_opt_map.emplace(insn, insn_opt_data);
-    return insn_opt_data;
+std::vector<OptRecord>& OptDataMapper::thread_log() {
+  // The mapper is a singleton, so a single pointer per thread suffices.
+  thread_local std::vector<OptRecord>* log = nullptr;
+  if (log == nullptr) {
+    std::lock_guard<std::mutex> guard(m_logs_mutex);
+    m_logs.push_back(std::make_unique<std::vector<OptRecord>>());
+    log = m_logs.back().get();
   }
-  return kv_pair->second;
+  return *log;
 }
 
-ClassOptData::ClassOptData(const DexClass* cls) : m_cls(cls) {
-  m_package = type::get_package_name(cls->get_type());
-  auto source_file = cls->get_source_file();
-  if (source_file != nullptr) {
-    m_has_srcfile = true;
-    m_filename = source_file->str();
+void OptDataMapper::log(bool is_opt,
+                        int reason,
+                        const DexClass* cls,
+                        const DexMethod* method,
+                        const IRInstruction* insn) {
+  OptRecord record;
+  record.seq = m_next_seq.fetch_add(1, std::memory_order_relaxed);
+  record.cls = cls;
+  record.method = method;
+  record.insn = insn;
+  record.reason = reason;
+  record.is_opt = is_opt;
+  record.has_method_line_num = false;
+  record.has_insn_line_num = false;
+  record.method_line_num = 0;
+  record.insn_line_num = 0;
+  if (method != nullptr) {
+    size_t line_num;
+    record.has_method_line_num = get_line_num(method, nullptr, &line_num);
+    record.method_line_num = line_num;
   }
-}
-
-std::shared_ptr<MethodOptData> ClassOptData::get_meth_opt_data(
-    const DexMethod* method) {
-  const auto& kv_pair = m_meth_opt_map.find(method);
-  if (kv_pair == m_meth_opt_map.end()) {
-    auto meth_opt_data = std::make_shared<MethodOptData>(method);
-    m_meth_opt_map.emplace(method, meth_opt_data);
-    return meth_opt_data;
+  if (insn != nullptr) {
+    record.insn_orig = SHOW(insn);
+    size_t line_num;
+    record.has_insn_line_num = get_line_num(method, insn, &line_num);
+    record.insn_line_num = line_num;
   }
-  return kv_pair->second;
-}
-
-std::shared_ptr<ClassOptData> OptDataMapper::get_cls_opt_data(
-    DexType* cls_type) {
-  auto cls = type_class(cls_type);
-  const auto& kv_pair = m_cls_opt_map.find(cls);
-  if (kv_pair == m_cls_opt_map.end()) {
-    auto cls_opt_data = std::make_shared<ClassOptData>(cls);
-    m_cls_opt_map.emplace(cls, cls_opt_data);
-    return cls_opt_data;
-  }
-  return kv_pair->second;
+  thread_log().push_back(std::move(record));
 }
 
 void OptDataMapper::log_opt(OptReason opt,
@@ -187,13 +175,9 @@ void OptDataMapper::log_opt(OptReason opt,
   if (!m_logs_enabled) {
     return;
   }
-  std::lock_guard<std::mutex> guard(s_opt_log_mutex);
   always_assert_log(method != nullptr, "Can't log null method\n");
   always_assert_log(insn != nullptr, "Can't log null instruction\n");
-  auto cls_opt_data = get_cls_opt_data(method->get_class());
-  auto meth_opt_data = cls_opt_data->get_meth_opt_data(method);
-  auto insn_opt_data = meth_opt_data->get_insn_opt_data(insn);
-  insn_opt_data->m_opts.emplace_back(opt);
+  log(true, opt, type_class(method->get_class()), method, insn);
 }
 
 void OptDataMapper::log_nopt(NoptReason nopt,
@@ -202,218 +186,228 @@ void OptDataMapper::log_nopt(NoptReason nopt,
   if (!m_logs_enabled) {
     return;
   }
-  std::lock_guard<std::mutex> guard(s_opt_log_mutex);
   always_assert_log(method != nullptr, "Can't log null method\n");
   always_assert_log(insn != nullptr, "Can't log null instruction\n");
-  auto cls_opt_data = get_cls_opt_data(method->get_class());
-  auto meth_opt_data = cls_opt_data->get_meth_opt_data(method);
-  auto insn_opt_data = meth_opt_data->get_insn_opt_data(insn);
-  insn_opt_data->m_nopts.emplace_back(nopt);
+  log(false, nopt, type_class(method->get_class()), method, insn);
 }
 
 void OptDataMapper::log_opt(OptReason opt, const DexMethod* method) {
   if (!m_logs_enabled) {
     return;
   }
-  std::lock_guard<std::mutex> guard(s_opt_log_mutex);
   always_assert_log(method != nullptr, "Can't log null method\n");
-  auto cls_opt_data = get_cls_opt_data(method->get_class());
-  auto meth_opt_data = cls_opt_data->get_meth_opt_data(method);
-  meth_opt_data->m_opts.emplace_back(opt);
+  log(true, opt, type_class(method->get_class()), method, nullptr);
 }
 
 void OptDataMapper::log_nopt(NoptReason nopt, const DexMethod* method) {
   if (!m_logs_enabled) {
     return;
   }
-  std::lock_guard<std::mutex> guard(s_opt_log_mutex);
   always_assert_log(method != nullptr, "Can't log null method\n");
-  auto cls_opt_data = get_cls_opt_data(method->get_class());
-  auto meth_opt_data = cls_opt_data->get_meth_opt_data(method);
-  meth_opt_data->m_nopts.emplace_back(nopt);
+  log(false, nopt, type_class(method->get_class()), method, nullptr);
 }
 
 void OptDataMapper::log_opt(OptReason opt, const DexClass* cls) {
   if (!m_logs_enabled) {
     return;
   }
-  std::lock_guard<std::mutex> guard(s_opt_log_mutex);
   always_assert_log(cls != nullptr, "Can't log null class\n");
-  auto cls_opt_data = get_cls_opt_data(cls->get_type());
-  cls_opt_data->m_opts.emplace_back(opt);
+  log(true, opt, cls, nullptr, nullptr);
 }
 
 void OptDataMapper::log_nopt(NoptReason nopt, const DexClass* cls) {
   if (!m_logs_enabled) {
     return;
   }
-  std::lock_guard<std::mutex> guard(s_opt_log_mutex);
   always_assert_log(cls != nullptr, "Can't log null class\n");
-  auto cls_opt_data = get_cls_opt_data(cls->get_type());
-  cls_opt_data->m_nopts.emplace_back(nopt);
+  log(false, nopt, cls, nullptr, nullptr);
 }
 
-Json::Value OptDataMapper::serialize_sql() {
-  constexpr const char* CLASS_OPTS = "class_opts";
-  constexpr const char* METHOD_OPTS = "method_opts";
-  constexpr const char* INSTRUCTION_OPTS = "instruction_opts";
-  constexpr const char* CLASS_NOPTS = "class_nopts";
-  constexpr const char* METHOD_NOPTS = "method_nopts";
-  constexpr const char* INSTRUCTION_NOPTS = "instruction_nopts";
-  constexpr const char* INSTRUCTIONS = "instructions";
-  constexpr const char* METHODS = "methods";
-  constexpr const char* CLASSES = "classes";
-  constexpr const char* OPT_MESSAGES = "opt_messages";
-  constexpr const char* NOPT_MESSAGES = "nopt_messages";
-  Json::Value top;
-
-  Json::Value opt_msg_arr;
-  Json::Value nopt_msg_arr;
-  serialize_messages_helper(m_opt_msg_map, &opt_msg_arr);
-  serialize_messages_helper(m_nopt_msg_map, &nopt_msg_arr);
-  top[OPT_MESSAGES] = opt_msg_arr;
-  top[NOPT_MESSAGES] = nopt_msg_arr;
-
-  size_t cls_id{0};
-  size_t meth_id{0};
-  size_t insn_id{0};
-  Json::Value cls_arr;
-  Json::Value cls_opt_arr;
-  Json::Value cls_nopt_arr;
-  Json::Value meth_arr;
-  Json::Value meth_opt_arr;
-  Json::Value meth_nopt_arr;
-  Json::Value insn_arr;
-  Json::Value insn_opt_arr;
-  Json::Value insn_nopt_arr;
-
-  for (const auto& cls_pair : m_cls_opt_map) {
-    auto cls_opt_data = cls_pair.second;
-    serialize_class(cls_opt_data, cls_id, &cls_arr, &cls_opt_arr,
-                    &cls_nopt_arr);
-
-    for (const auto& meth_pair : cls_opt_data->m_meth_opt_map) {
-      auto meth_opt_data = meth_pair.second;
-      serialize_method(meth_opt_data, cls_id, meth_id, &meth_arr, &meth_opt_arr,
-                       &meth_nopt_arr);
-
-      for (const auto& insn_pair : meth_opt_data->m_insn_opt_map) {
-        auto insn_opt_data = insn_pair.second;
-        serialize_insn(insn_opt_data, meth_id, insn_id, &insn_arr,
-                       &insn_opt_arr, &insn_nopt_arr);
-        insn_id++;
+namespace {
+
+// The records of a class, method or instruction, in the order they were
+// logged.
+struct Entry {
+  const OptRecord* first;
+  size_t parent_id;
+  std::vector<const OptRecord*> records;
+};
+
+template <class Key, class Hash = std::hash<Key>>
+struct EntryTable {
+  std::vector<Entry> entries;
+  std::unordered_map<Key, size_t, Hash> ids;
+
+  size_t get(const Key& key, const OptRecord* record, size_t parent_id) {
+    auto it = ids.emplace(key, entries.size()).first;
+    if (it->second == entries.size()) {
+      entries.push_back(Entry{record, parent_id, {}});
+    }
+    return it->second;
+  }
+};
+
+void write_json_string(std::ostream& os, const std::string& str) {
+  os << '"';
+  for (char c : str) {
+    switch (c) {
+    case '"':
+      os << "\\\"";
+      break;
+    case '\\':
+      os << "\\\\";
+      break;
+    case '\n':
+      os << "\\n";
+      break;
+    case '\t':
+      os << "\\t";
+      break;
+    default:
+      if (static_cast<unsigned char>(c) < 0x20) {
+        char buf[8];
+        snprintf(buf, sizeof(buf), "\\u%04x", c);
+        os << buf;
+      } else {
+        os << c;
       }
-      meth_id++;
     }
-    cls_id++;
   }
-
-  top[CLASSES] = cls_arr;
-  top[METHODS] = meth_arr;
-  top[INSTRUCTIONS] = insn_arr;
-  top[INSTRUCTION_OPTS] = insn_opt_arr;
-  top[METHOD_OPTS] = meth_opt_arr;
-  top[CLASS_OPTS] = cls_opt_arr;
-  top[INSTRUCTION_NOPTS] = insn_nopt_arr;
-  top[METHOD_NOPTS] = meth_nopt_arr;
-  top[CLASS_NOPTS] = cls_nopt_arr;
-  return top;
+  os << '"';
 }
 
-void OptDataMapper::serialize_messages_helper(
-    const std::unordered_map<int, std::string>& msg_map, Json::Value* arr) {
-  for (const auto& reason_msg_pair : msg_map) {
-    auto reason = reason_msg_pair.first;
-    const auto& message = reason_msg_pair.second;
-    Json::Value msg_pair;
-    msg_pair["reason_code"] = reason;
-    msg_pair["message"] = message;
-    arr->append(msg_pair);
+// Writes `"name":[row,row,...]`, with write_row writing the fields of every
+// row given its index.
+template <class WriteRow>
+void write_table(std::ostream& os,
+                 const char* name,
+                 size_t num_rows,
+                 const WriteRow& write_row,
+                 bool last = false) {
+  os << '"' << name << "\":[";
+  for (size_t i = 0; i < num_rows; ++i) {
+    os << (i == 0 ? "{" : ",{");
+    write_row(i);
+    os << '}';
   }
+  os << (last ? "]" : "],") << '\n';
 }
 
-void OptDataMapper::serialize_opt_nopt_helper(
-    const std::vector<OptReason>& opts,
-    const std::vector<NoptReason>& nopts,
-    size_t id,
-    Json::Value* opt_arr,
-    Json::Value* nopt_arr) {
-  for (size_t i = 0; i < opts.size(); ++i) {
-    verify_opt(opts.at(i));
-    Json::Value opt_data;
-    opt_data["reason_idx"] = (uint)i;
-    opt_data["id"] = (uint)id;
-    opt_data["reason_code"] = opts.at(i);
-    opt_arr->append(opt_data);
-  }
-  for (size_t i = 0; i < nopts.size(); ++i) {
-    verify_nopt(nopts.at(i));
-    Json::Value nopt_data;
-    nopt_data["reason_idx"] = (uint)i;
-    nopt_data["id"] = (uint)id;
-    nopt_data["reason_code"] = nopts.at(i);
-    nopt_arr->append(nopt_data);
+// Writes the {level}_{type} table of the entries.
+void write_reasons(std::ostream& os,
+                   const char* name,
+                   const std::vector<Entry>& entries,
+                   bool is_opt,
+                   bool last = false) {
+  os << '"' << name << "\":[";
+  bool first_row = true;
+  for (size_t id = 0; id < entries.size(); ++id) {
+    size_t idx = 0;
+    for (auto record : entries[id].records) {
+      if (record->is_opt != is_opt) {
+        continue;
+      }
+      os << (first_row ? "{" : ",{") << "\"reason_idx\":" << idx++
+         << ",\"id\":" << id << ",\"reason_code\":" << record->reason
+         << '}';
+      first_row = false;
+    }
   }
+  os << (last ? "]" : "],") << '\n';
 }
 
-void OptDataMapper::serialize_class(
-    const std::shared_ptr<ClassOptData>& cls_opt_data,
-    size_t cls_id,
-    Json::Value* arr,
-    Json::Value* opt_arr,
-    Json::Value* nopt_arr) {
-  const auto& name = get_deobfuscated_name_substr(cls_opt_data->m_cls);
-  Json::Value cls_data;
-  cls_data["id"] = (uint)cls_id;
-  cls_data["package"] = cls_opt_data->m_package;
-  cls_data["source_file"] =
-      cls_opt_data->m_has_srcfile ? cls_opt_data->m_filename : "";
-  cls_data["name"] = name.c_str();
-  arr->append(cls_data);
-  serialize_opt_nopt_helper(cls_opt_data->m_opts, cls_opt_data->m_nopts, cls_id,
-                            opt_arr, nopt_arr);
-}
+} // namespace
 
-void OptDataMapper::serialize_method(
-    const std::shared_ptr<MethodOptData>& meth_opt_data,
-    size_t cls_id,
-    size_t meth_id,
-    Json::Value* arr,
-    Json::Value* opt_arr,
-    Json::Value* nopt_arr) {
-  const auto& method = meth_opt_data->m_method;
-  Json::Value meth_data;
-  meth_data["id"] = (uint)meth_id;
-  meth_data["cls_id"] = (uint)cls_id;
-  meth_data["has_line_num"] = meth_opt_data->m_has_line_num ? 1 : 0;
-  meth_data["line_num"] = (uint)meth_opt_data->m_line_num;
-  meth_data["signature"] = get_deobfuscated_name(method);
-  meth_data["code_size"] =
-      (uint)(method->get_code() ? method->get_code()->sum_opcode_sizes() : 0);
-  arr->append(meth_data);
-  serialize_opt_nopt_helper(meth_opt_data->m_opts, meth_opt_data->m_nopts,
-                            meth_id, opt_arr, nopt_arr);
-}
+void OptDataMapper::write_sql_json(std::ostream& os) {
+  std::vector<const OptRecord*> records;
+  for (const auto& log : m_logs) {
+    for (const auto& record : *log) {
+      records.push_back(&record);
+    }
+  }
+  std::sort(records.begin(), records.end(),
+            [](const OptRecord* a, const OptRecord* b) {
+              return a->seq < b->seq;
+            });
+
+  EntryTable<const DexClass*> classes;
+  EntryTable<const DexMethod*> methods;
+  EntryTable<std::pair<const DexMethod*, const IRInstruction*>,
+             boost::hash<std::pair<const DexMethod*, const IRInstruction*>>>
+      insns;
+  for (auto record : records) {
+    if (record->is_opt) {
+      verify_opt(record->reason);
+    } else {
+      verify_nopt(record->reason);
+    }
+    auto cls_id = classes.get(record->cls, record, 0);
+    if (record->method == nullptr) {
+      classes.entries[cls_id].records.push_back(record);
+      continue;
+    }
+    auto meth_id = methods.get(record->method, record, cls_id);
+    if (record->insn == nullptr) {
+      methods.entries[meth_id].records.push_back(record);
+      continue;
+    }
+    auto insn_key = std::make_pair(record->method, record->insn);
+    auto insn_id = insns.get(insn_key, record, meth_id);
+    insns.entries[insn_id].records.push_back(record);
+  }
 
-void OptDataMapper::serialize_insn(
-    const std::shared_ptr<InsnOptData>& insn_opt_data,
-    size_t meth_id,
-    size_t insn_id,
-    Json::Value* arr,
-    Json::Value* opt_arr,
-    Json::Value* nopt_arr) {
-  Json::Value insn_data;
-  insn_data["id"] = (uint)insn_id;
-  insn_data["meth_id"] = (uint)meth_id;
-  insn_data["has_line_num"] = insn_opt_data->m_has_line_num ? 1 : 0;
-  insn_data["line_num"] = (uint)insn_opt_data->m_line_num;
-  insn_data["instruction"] = insn_opt_data->m_insn_orig;
-
-  // TODO In case of invokes, we want to show the deobfuscated name for clarity,
-  // if possible.
-  arr->append(insn_data);
-  serialize_opt_nopt_helper(insn_opt_data->m_opts, insn_opt_data->m_nopts,
-                            insn_id, opt_arr, nopt_arr);
+  auto write_messages = [&](const char* name,
+                            const std::unordered_map<int, std::string>& msgs) {
+    std::vector<std::pair<int, const std::string*>> sorted;
+    for (const auto& pair : msgs) {
+      sorted.emplace_back(pair.first, &pair.second);
+    }
+    std::sort(sorted.begin(), sorted.end());
+    write_table(os, name, sorted.size(), [&](size_t i) {
+      os << "\"reason_code\":" << sorted[i].first << ",\"message\":";
+      write_json_string(os, *sorted[i].second);
+    });
+  };
+
+  os << "{\n";
+  write_messages("opt_messages", m_opt_msg_map);
+  write_messages("nopt_messages", m_nopt_msg_map);
+  write_table(os, "classes", classes.entries.size(), [&](size_t i) {
+    auto cls = classes.entries[i].first->cls;
+    auto source_file = cls->get_source_file();
+    os << "\"id\":" << i << ",\"package\":";
+    write_json_string(os, type::get_package_name(cls->get_type()));
+    os << ",\"source_file\":";
+    write_json_string(os, source_file ? source_file->str() : "");
+    os << ",\"name\":";
+    write_json_string(os, get_deobfuscated_name_substr(cls));
+  });
+  write_table(os, "methods", methods.entries.size(), [&](size_t i) {
+    const auto& entry = methods.entries[i];
+    auto method = entry.first->method;
+    os << "\"id\":" << i << ",\"cls_id\":" << entry.parent_id
+       << ",\"has_line_num\":" << (entry.first->has_method_line_num ? 1 : 0)
+       << ",\"line_num\":" << entry.first->method_line_num
+       << ",\"signature\":";
+    write_json_string(os, get_deobfuscated_name(method));
+    os << ",\"code_size\":"
+       << (method->get_code() ? method->get_code()->sum_opcode_sizes() : 0);
+  });
+  write_table(os, "instructions", insns.entries.size(), [&](size_t i) {
+    const auto& entry = insns.entries[i];
+    os << "\"id\":" << i << ",\"meth_id\":" << entry.parent_id
+       << ",\"has_line_num\":" << (entry.first->has_insn_line_num ? 1 : 0)
+       << ",\"line_num\":" << entry.first->insn_line_num
+       << ",\"instruction\":";
+    write_json_string(os, entry.first->insn_orig);
+  });
+  write_reasons(os, "instruction_opts", insns.entries, true);
+  write_reasons(os, "method_opts", methods.entries, true);
+  write_reasons(os, "class_opts", classes.entries, true);
+  write_reasons(os, "instruction_nopts", insns.entries, false);
+  write_reasons(os, "method_nopts", methods.entries, false);
+  write_reasons(os, "class_nopts", classes.entries, false, /* last */ true);
+  os << "}\n";
 }
 
 /**
@@ -460,17 +454,16 @@ void OptDataMapper::init_nopt_messages() {
   m_nopt_msg_map = std::move(nopt_msg_map);
 }
 
-void OptDataMapper::verify_opt(OptReason reason) {
+void OptDataMapper::verify_opt(int reason) {
   always_assert_log(m_opt_msg_map.find(reason) != m_opt_msg_map.end(),
-                    "Message not found for reason %s\n",
+                    "Message not found for reason %d\n",
                     reason);
 }
 
-void OptDataMapper::verify_nopt(NoptReason reason) {
+void OptDataMapper::verify_nopt(int reason) {
   always_assert_log(m_nopt_msg_map.find(reason) != m_nopt_msg_map.end(),
-                    "Message not found for reason %s\n",
+                    "Message not found for reason %d\n",
                     reason);
 }
 
-std::mutex OptDataMapper::s_opt_log_mutex;
 } // namespace opt_metadata
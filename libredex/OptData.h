@@ -7,11 +7,13 @@
 
 #pragma once
 
-#include <json/json.h>
+#include <atomic>
 #include <memory>
 #include <mutex>
+#include <ostream>
 #include <string>
 #include <unordered_map>
+#include <vector>
 
 #include "DexClass.h"
 #include "IRInstruction.h"
@@ -32,9 +34,6 @@
  *     - For class-level: log_opt/nopt(reason, cls)
  */
 namespace opt_metadata {
-class InsnOptData;
-class MethodOptData;
-class ClassOptData;
 
 /**
  * Per-instruction logging functions. We require each insn log to be
@@ -63,75 +62,36 @@ void log_opt(OptReason opt, const DexClass* cls);
 void log_nopt(NoptReason opt, const DexClass* cls);
 
 /**
- * Stores per-insn optimization data.
+ * A single logged opt or nopt. What may not survive until the data is
+ * written, i.e. the instruction and the line numbers, is captured when it is
+ * logged.
  */
-class InsnOptData {
-  friend class MethodOptData;
-  friend class OptDataMapper;
-
- public:
-  InsnOptData(const DexMethod* method, const IRInstruction* insn);
-
- private:
-  const DexMethod* m_method;
-  std::string m_insn_orig;
-  bool m_has_line_num{false};
-  size_t m_line_num{0};
-  std::vector<OptReason> m_opts;
-  std::vector<NoptReason> m_nopts;
-};
-
-/**
- * Stores per-method optimization data.
- */
-class MethodOptData {
-  friend class InsnOptData;
-  friend class ClassOptData;
-  friend class OptDataMapper;
-
- public:
-  explicit MethodOptData(const DexMethod* method);
-  std::shared_ptr<InsnOptData> get_insn_opt_data(const IRInstruction* insn);
-
- private:
-  const DexMethod* m_method;
-  std::string m_method_orig;
-  bool m_has_line_num{false};
-  size_t m_line_num{0};
-  std::vector<OptReason> m_opts;
-  std::vector<NoptReason> m_nopts;
-  std::unordered_map<const IRInstruction*, std::shared_ptr<InsnOptData>>
-      m_insn_opt_map;
-};
-
-/**
- * Stores per-class optimization data.
- */
-class ClassOptData {
-  friend class OptDataMapper;
-
- public:
-  explicit ClassOptData(const DexClass* cls);
-  std::shared_ptr<MethodOptData> get_meth_opt_data(const DexMethod* method);
-
- private:
-  const DexClass* m_cls;
-  bool m_has_srcfile{false};
-  std::string m_package;
-  std::string m_filename;
-  std::vector<OptReason> m_opts;
-  std::vector<NoptReason> m_nopts;
-  std::unordered_map<const DexMethod*, std::shared_ptr<MethodOptData>>
-      m_meth_opt_map;
+struct OptRecord {
+  // The order of the records across all the threads.
+  uint64_t seq;
+  const DexClass* cls;
+  // Null for class-level records.
+  const DexMethod* method;
+  // Null for class and method-level records.
+  const IRInstruction* insn;
+  std::string insn_orig;
+  uint32_t method_line_num;
+  uint32_t insn_line_num;
+  uint16_t reason;
+  bool is_opt;
+  bool has_method_line_num;
+  bool has_insn_line_num;
 };
 
 /**
  * Records and expresses optimization data.
+ *
+ * Each thread appends its records to its own log, so that logging takes no
+ * lock and allocates nothing but the record. They are only grouped by class,
+ * method and instruction when written.
  */
 class OptDataMapper {
  public:
-  static std::mutex s_opt_log_mutex;
-
   static OptDataMapper& get_instance() {
     static OptDataMapper instance;
     return instance;
@@ -159,9 +119,10 @@ class OptDataMapper {
   void log_nopt(NoptReason opt, const DexClass* cls);
 
   /**
-   * Writes the gathered optimization data in terms of sql queries, separated
-   * by newlines for easy parsing later on.
-   * 11 tables are created:
+   * Writes the gathered optimization data as a json object of the rows of
+   * sql tables, one array per table, streaming the rows rather than building
+   * the object in memory first. Must not run concurrently with logging.
+   * 11 tables are written:
    *  - opt_messages maps an optimization reason_code to a message.
    *  - nopt_messages maps a non-optimization reason_code to a message.
    *  - 6 tables that are effectively edges between level and type,
@@ -172,12 +133,14 @@ class OptDataMapper {
    *  - classes/methods/instructions contain basic information: a unique id,
    *    names, and in the case of instructions, the instruction itself.
    */
-  Json::Value serialize_sql();
+  void write_sql_json(std::ostream& os);
 
  private:
   bool m_logs_enabled{false};
-  std::unordered_map<const DexClass*, std::shared_ptr<ClassOptData>>
-      m_cls_opt_map;
+  std::atomic<uint64_t> m_next_seq{0};
+  // The logs of the threads, which stay here when the threads exit.
+  std::mutex m_logs_mutex;
+  std::vector<std::unique_ptr<std::vector<OptRecord>>> m_logs;
   std::unordered_map<int /*OptReason*/, std::string> m_opt_msg_map;
   std::unordered_map<int /*NoptReason*/, std::string> m_nopt_msg_map;
 
@@ -186,59 +149,13 @@ class OptDataMapper {
     init_nopt_messages();
   }
 
-  /**
-   * Finds and returns a ClassOptData for the given class type. If the
-   * ClassOptData doesn't yet exist, construct it and return.
-   */
-  std::shared_ptr<ClassOptData> get_cls_opt_data(DexType* cls_type);
-
-  /**
-   * For the table {msg_type}_messages, append each row as an entry to arr.
-   */
-  void serialize_messages_helper(
-      const std::unordered_map<int, std::string>& msg_map, Json::Value* arr);
+  std::vector<OptRecord>& thread_log();
 
-  /**
-   * For the tables {level}_opts and {level}_nopts, append each row as an
-   * entry in the corresponding json arr.
-   */
-  void serialize_opt_nopt_helper(const std::vector<OptReason>& opts,
-                                 const std::vector<NoptReason>& nopts,
-                                 size_t id,
-                                 Json::Value* opt_arr,
-                                 Json::Value* nopt_arr);
-
-  /**
-   * For the table 'classes', append class info to arr. Append cls opt info to
-   * opt/nopt arrs.
-   */
-  void serialize_class(const std::shared_ptr<ClassOptData>& cls_opt_data,
-                       size_t cls_id,
-                       Json::Value* arr,
-                       Json::Value* opt_arr,
-                       Json::Value* nopt_arr);
-
-  /**
-   * For the table 'methods', append method info to arr. Append meth opt info to
-   * opt/nopt arrs.
-   */
-  void serialize_method(const std::shared_ptr<MethodOptData>& meth_opt_data,
-                        size_t cls_id,
-                        size_t meth_id,
-                        Json::Value* arr,
-                        Json::Value* opt_arr,
-                        Json::Value* nopt_arr);
-
-  /**
-   * For the table 'instructions', append instruction info to arr. Append insn
-   * opt info to opt/nopt arrs.
-   */
-  void serialize_insn(const std::shared_ptr<InsnOptData>& insn_opt_data,
-                      size_t meth_id,
-                      size_t insn_id,
-                      Json::Value* arr,
-                      Json::Value* opt_arr,
-                      Json::Value* nopt_arr);
+  void log(bool is_opt,
+           int reason,
+           const DexClass* cls,
+           const DexMethod* method,
+           const IRInstruction* insn);
 
   /**
    * NOTE: Register an opt/non-opt message to the corresponding init_ function.
@@ -250,7 +167,7 @@ class OptDataMapper {
   /**
    * Verifies that a message has been registered for the given reason.
    */
-  void verify_opt(OptReason reason);
-  void verify_nopt(NoptReason reason);
+  void verify_opt(int reason);
+  void verify_nopt(int reason);
 };
 } // namespace opt_metadata
@@ -44,6 +44,25 @@ class Pass : public Configurable {
 
   virtual void destroy_analysis_result() {}
 
+  /**
+   * Whether the pass accepts methods whose code is in editable CFG form, and
+   * may leave them in that form instead of linearizing them when it is done.
+   * The PassManager keeps the CFGs built across consecutive CFG-legal passes,
+   * and only linearizes them before a pass that expects IRLists, and before
+   * the output phase.
+   */
+  virtual bool is_cfg_legal() const { return false; }
+
+  /**
+   * Whether the pass only reads the dex stores: it changes no class, member or
+   * code, nor any global state that another pass reads, and only uses the
+   * PassManager to record its metrics. The PassManager may then run it
+   * concurrently with the read-only passes next to it, when the config sets
+   * "run_read_only_passes_concurrently". Read-only passes preserve all the
+   * analyses.
+   */
+  virtual bool is_read_only() const { return false; }
+
   /**
    * All passes' eval_pass are run, and then all passes' run_pass are run. This
    * allows each pass to evaluate its rules in terms of the original input,
@@ -60,6 +79,10 @@ class Pass : public Configurable {
                         PassManager& mgr) = 0;
 
   virtual void set_analysis_usage(AnalysisUsage& analysis_usage) const {
+    if (is_read_only()) {
+      analysis_usage.set_preserve_all();
+      return;
+    }
     switch (m_kind) {
     case TRANSFORMATION:
       analysis_usage.set_preserve_none();
@@ -7,15 +7,21 @@
 
 #include "PassManager.h"
 
+#include <algorithm>
+#include <atomic>
 #include <boost/filesystem.hpp>
+#include <boost/functional/hash.hpp>
+#include <chrono>
 #include <cinttypes>
 #include <cstdio>
+#include <sys/resource.h>
 #include <typeinfo>
 #include <unordered_set>
 
 #include "ApiLevelChecker.h"
 #include "ApkManager.h"
 #include "CommandProfiling.h"
+#include "ConcurrentContainers.h"
 #include "ConfigFiles.h"
 #include "Debug.h"
 #include "DexClass.h"
@@ -40,6 +46,10 @@ namespace {
 
 const std::string PASS_ORDER_KEY = "pass_order";
 
+// The pass that the thread runs, while the PassManager runs read-only passes
+// concurrently. It takes precedence over m_current_pass_info.
+thread_local PassManager::PassInfo* t_concurrent_pass_info = nullptr;
+
 constexpr const char* CFG_DUMP_BASE_NAME = "redex-cfg-dumps.cfg";
 
 std::string get_apk_dir(const Json::Value& config) {
@@ -48,14 +58,52 @@ std::string get_apk_dir(const Json::Value& config) {
   return apkdir;
 }
 
+// The hashes of the methods that passed the type checker, so that the checks
+// after the passes can skip the methods that haven't changed since.
+using VerifiedMethods = ConcurrentMap<const DexMethod*, size_t>;
+
+// Whether a method is checked at the given sampling rate. This only depends
+// on the contents of the method and on the seed, so that it is deterministic,
+// while a different seed for each check samples different methods.
+bool is_sampled(size_t hash, size_t seed, double sampling_rate) {
+  constexpr size_t kBuckets = 1 << 16;
+  boost::hash_combine(seed, hash);
+  return (seed % kBuckets) < sampling_rate * kBuckets;
+}
+
 // TODO(fengliu): Kill the `validate_access` flag.
+/*
+ * Only checks a sample of the methods unless the sampling rate is 1, and
+ * with verified methods, only those that changed since they last passed.
+ * That misses the failures that changes elsewhere, e.g. to the class
+ * hierarchy, cause in unchanged code, so the check before the output is
+ * always done in full.
+ */
 void run_verifier(const Scope& scope,
                   bool verify_moves,
                   bool check_no_overwrite_this,
-                  bool validate_access) {
+                  bool validate_access,
+                  VerifiedMethods* verified = nullptr,
+                  double sampling_rate = 1.0,
+                  size_t sample_seed = 0) {
   TRACE(PM, 1, "Running IRTypeChecker...");
   Timer t("IRTypeChecker");
-  walk::parallel::methods(scope, [=](DexMethod* dex_method) {
+  std::atomic<size_t> num_checked{0};
+  walk::parallel::methods(scope, [=, &num_checked](DexMethod* dex_method) {
+    size_t hash = 0;
+    if (verified != nullptr || sampling_rate < 1) {
+      hash = hashing::hash_method(dex_method);
+      if (!is_sampled(hash, sample_seed, sampling_rate)) {
+        return;
+      }
+      if (verified != nullptr) {
+        auto it = verified->find(dex_method);
+        if (it != verified->end() && it->second == hash) {
+          return;
+        }
+      }
+    }
+    ++num_checked;
     IRTypeChecker checker(dex_method, validate_access);
     if (verify_moves) {
       checker.verify_moves();
@@ -71,6 +119,20 @@ void run_verifier(const Scope& scope,
       fprintf(stderr, "Code:\n%s\n", SHOW(dex_method->get_code()->cfg()));
       exit(EXIT_FAILURE);
     }
+    if (verified != nullptr) {
+      verified->insert_or_assign(std::make_pair(dex_method, hash));
+    }
+  });
+  TRACE(PM, 1, "IRTypeChecker checked %zu methods", num_checked.load());
+}
+
+// Linearizes the editable CFGs that CFG-legal passes have left behind.
+void clear_cfgs(const Scope& scope) {
+  Timer t("Linearizing CFGs");
+  walk::parallel::code(scope, [](DexMethod*, IRCode& code) {
+    if (code.editable_cfg_built()) {
+      code.clear_cfg();
+    }
   });
 }
 
@@ -80,16 +142,30 @@ struct ScopedVmHWM {
       if (reset) {
         try_reset_hwm_mem_stat();
       }
-      before = get_mem_stats().vm_hwm;
+      auto stats = get_mem_stats();
+      before = stats.vm_hwm;
+      rss_before = stats.vm_rss;
     }
   }
 
   void trace_log(PassManager* mgr, const Pass* pass) {
     if (enabled) {
-      uint64_t after = get_mem_stats().vm_hwm;
+      auto stats = get_mem_stats();
+      uint64_t after = stats.vm_hwm;
       if (mgr != nullptr) {
         mgr->set_metric("vm_hwm_after", after);
         mgr->set_metric("vm_hwm_delta", after - before);
+        // The memory profile of the pass, next to its timers in the stats.
+        mgr->set_metric("~pass~memory~rss~delta~",
+                        (int64_t)stats.vm_rss - (int64_t)rss_before);
+        mgr->set_metric("~pass~memory~rss~peak~", after);
+        jemalloc_util::Stats jemalloc_stats;
+        if (jemalloc_util::get_stats(&jemalloc_stats)) {
+          mgr->set_metric("~pass~memory~jemalloc~allocated~",
+                          jemalloc_stats.allocated);
+          mgr->set_metric("~pass~memory~jemalloc~active~",
+                          jemalloc_stats.active);
+        }
       }
       TRACE(STATS, 1, "VmHWM for %s was %s (%s over start).",
             pass->name().c_str(), pretty_bytes(after).c_str(),
@@ -98,9 +174,60 @@ struct ScopedVmHWM {
   }
 
   uint64_t before;
+  uint64_t rss_before;
   bool enabled;
 };
 
+uint64_t process_cpu_us() {
+  struct rusage usage;
+  getrusage(RUSAGE_SELF, &usage);
+  auto us = [](const struct timeval& tv) {
+    return (uint64_t)tv.tv_sec * 1000000 + tv.tv_usec;
+  };
+  return us(usage.ru_utime) + us(usage.ru_stime);
+}
+
+/*
+ * How well a pass uses the machine: the CPU time of all the threads against
+ * the wall time, and what the work queues did meanwhile. The efficiency is
+ * the percentage of the default number of threads that was kept busy on
+ * average, so that the passes that leave the most threads idle stand out.
+ */
+struct ScopedParallelismStats {
+  ScopedParallelismStats()
+      : wall_start(std::chrono::steady_clock::now()),
+        cpu_start_us(process_cpu_us()),
+        tasks_before(sparta::workqueue_impl::global_stats().tasks),
+        steals_before(sparta::workqueue_impl::global_stats().steals),
+        idle_ns_before(sparta::workqueue_impl::global_stats().idle_ns) {}
+
+  void trace_log(PassManager* mgr, const Pass* pass) {
+    auto wall_us = std::chrono::duration_cast<std::chrono::microseconds>(
+                       std::chrono::steady_clock::now() - wall_start)
+                       .count();
+    auto cpu_us = process_cpu_us() - cpu_start_us;
+    const auto& stats = sparta::workqueue_impl::global_stats();
+    auto threads = redex_parallel::default_num_threads();
+    int64_t efficiency =
+        wall_us == 0 ? 0 : cpu_us * 100 / (wall_us * threads);
+    mgr->set_metric("~pass~wall~ms~", wall_us / 1000);
+    mgr->set_metric("~pass~cpu~ms~", cpu_us / 1000);
+    mgr->set_metric("~pass~parallel~efficiency~", efficiency);
+    mgr->set_metric("~pass~workqueue~tasks~", stats.tasks - tasks_before);
+    mgr->set_metric("~pass~workqueue~steals~", stats.steals - steals_before);
+    mgr->set_metric("~pass~workqueue~idle~ms~",
+                    (stats.idle_ns - idle_ns_before) / 1000000);
+    TRACE(STATS, 1, "%s kept %" PRId64 "%% of %zu threads busy.",
+          pass->name().c_str(), efficiency, threads);
+  }
+
+  std::chrono::steady_clock::time_point wall_start;
+  uint64_t cpu_start_us;
+  uint64_t tasks_before;
+  uint64_t steals_before;
+  uint64_t idle_ns_before;
+};
+
 } // namespace
 
 std::unique_ptr<keep_rules::ProguardConfiguration> empty_pg_config() {
@@ -151,9 +278,26 @@ PassManager::PassManager(
 
 void PassManager::init(const Json::Value& config) {
   if (config["redex"].isMember("passes")) {
+    // Passes to leave out of the pipeline, e.g. when bisecting: "Name" skips
+    // all runs of a pass, "Name#k" only its k-th run, and "i" the i-th entry
+    // of the passes list, as this run of redex-all sees it.
+    std::unordered_set<std::string> skip_passes;
+    for (auto& skip : config["redex"]["skip_passes"]) {
+      skip_passes.emplace(skip.asString());
+    }
     auto passes_from_config = config["redex"]["passes"];
-    for (auto& pass : passes_from_config) {
-      activate_pass(pass.asString().c_str(), config);
+    std::unordered_map<std::string, size_t> pass_counters;
+    for (Json::ArrayIndex i = 0; i < passes_from_config.size(); ++i) {
+      auto name = passes_from_config[i].asString();
+      auto pass_name = name.substr(0, name.find('#'));
+      auto count = ++pass_counters[pass_name];
+      if (skip_passes.count(pass_name) ||
+          skip_passes.count(pass_name + "#" + std::to_string(count)) ||
+          skip_passes.count(std::to_string(i))) {
+        TRACE(PM, 1, "Skipping %s#%zu", pass_name.c_str(), count);
+        continue;
+      }
+      activate_pass(name.c_str(), config);
     }
   } else {
     // If config isn't set up, run all registered passes.
@@ -212,6 +356,7 @@ void PassManager::run_passes(DexStoresVector& stores, ConfigFiles& conf) {
 
   // Clear stale data. Make sure we start fresh.
   m_preserved_analysis_passes.clear();
+  m_analysis_cache.invalidate();
 
   {
     Timer t("API Level Checker");
@@ -281,6 +426,17 @@ void PassManager::run_passes(DexStoresVector& stores, ConfigFiles& conf) {
   bool verify_moves = type_checker_args.get("verify_moves", true).asBool();
   bool check_no_overwrite_this =
       type_checker_args.get("check_no_overwrite_this", false).asBool();
+  // Only check the methods that changed since they last passed, and a
+  // sample of them, so that checking after the passes is cheap.
+  bool type_check_changed_methods_only =
+      type_checker_args.get("changed_methods_only", false).asBool();
+  double type_checker_sampling_rate =
+      type_checker_args.get("sampling_rate", 1.0).asDouble();
+  always_assert_log(
+      type_checker_sampling_rate > 0 && type_checker_sampling_rate <= 1,
+      "sampling_rate must be in (0, 1], actual: %f\n",
+      type_checker_sampling_rate);
+  VerifiedMethods verified_methods;
   std::unordered_set<std::string> type_checker_trigger_passes;
 
   for (auto& trigger_pass : type_checker_args["run_after_passes"]) {
@@ -308,6 +464,23 @@ void PassManager::run_passes(DexStoresVector& stores, ConfigFiles& conf) {
   const bool hwm_per_pass =
       conf.get_json_config().get("mem_stats_per_pass", true);
 
+  // Whether the last passes were CFG-legal, and may have left editable CFGs.
+  bool cfgs_built = false;
+
+  // Consecutive read-only passes run concurrently, and then go through the
+  // checks below one by one, in order. Passes that are profiled, or that
+  // require analyses, always run on their own.
+  bool run_read_only_passes_concurrently =
+      conf.get_json_config().get("run_read_only_passes_concurrently", false);
+  std::vector<bool> ran_concurrently(m_activated_passes.size(), false);
+  auto can_run_concurrently = [&](Pass* pass) {
+    AnalysisUsage usage;
+    pass->set_analysis_usage(usage);
+    return pass->is_read_only() && usage.get_required_passes().empty() &&
+           !(m_profiler_info && m_profiler_info->pass == pass) &&
+           m_malloc_profile_pass != pass;
+  };
+
   for (size_t i = 0; i < m_activated_passes.size(); ++i) {
     Pass* pass = m_activated_passes[i];
     AnalysisUsage analysis_usage;
@@ -320,32 +493,65 @@ void PassManager::run_passes(DexStoresVector& stores, ConfigFiles& conf) {
           pass->name().c_str(), analysis_id.c_str());
     }
 
-    TRACE(PM, 1, "Running %s...", pass->name().c_str());
-    ScopedVmHWM vm_hwm{hwm_pass_stats, hwm_per_pass};
-    Timer t(pass->name() + " (run)");
-    m_current_pass_info = &m_pass_info[i];
+    if (cfgs_built && !pass->is_cfg_legal()) {
+      clear_cfgs(build_class_scope(stores));
+      cfgs_built = false;
+    }
 
-    {
-      bool run_profiler = m_profiler_info && m_profiler_info->pass == pass;
-      ScopedCommandProfiling cmd_prof(
-          run_profiler ? boost::make_optional(m_profiler_info->command)
-                       : boost::none,
-          run_profiler ? m_profiler_info->shutdown_cmd : boost::none,
-          run_profiler ? m_profiler_info->post_cmd : boost::none);
-      jemalloc_util::ScopedProfiling malloc_prof(m_malloc_profile_pass == pass);
-      pass->run_pass(stores, conf, *this);
+    if (run_read_only_passes_concurrently && !ran_concurrently[i]) {
+      size_t end = i;
+      while (end < m_activated_passes.size() &&
+             can_run_concurrently(m_activated_passes[end])) {
+        ++end;
+      }
+      if (end - i > 1) {
+        if (cfgs_built &&
+            std::any_of(m_activated_passes.begin() + i,
+                        m_activated_passes.begin() + end,
+                        [](Pass* p) { return !p->is_cfg_legal(); })) {
+          clear_cfgs(build_class_scope(stores));
+          cfgs_built = false;
+        }
+        run_passes_concurrently(i, end, stores, conf);
+        std::fill(ran_concurrently.begin() + i, ran_concurrently.begin() + end,
+                  true);
+      }
     }
 
-    vm_hwm.trace_log(this, pass);
+    m_current_pass_info = &m_pass_info[i];
+    if (!ran_concurrently[i]) {
+      TRACE(PM, 1, "Running %s...", pass->name().c_str());
+      ScopedVmHWM vm_hwm{hwm_pass_stats, hwm_per_pass};
+      ScopedParallelismStats parallelism_stats;
+      Timer t(pass->name() + " (run)");
+      {
+        bool run_profiler = m_profiler_info && m_profiler_info->pass == pass;
+        ScopedCommandProfiling cmd_prof(
+            run_profiler ? boost::make_optional(m_profiler_info->command)
+                         : boost::none,
+            run_profiler ? m_profiler_info->shutdown_cmd : boost::none,
+            run_profiler ? m_profiler_info->post_cmd : boost::none);
+        jemalloc_util::ScopedProfiling malloc_prof(m_malloc_profile_pass ==
+                                                   pass);
+        pass->run_pass(stores, conf, *this);
+      }
+      vm_hwm.trace_log(this, pass);
+      parallelism_stats.trace_log(this, pass);
+    }
 
     sanitizers::lsan_do_recoverable_leak_check();
-    walk::parallel::code(build_class_scope(stores), [](DexMethod* m,
-                                                       IRCode& code) {
-      // Ensure that pass authors deconstructed the editable CFG at the end of
-      // their pass. Currently, passes assume the incoming code will be in
-      // IRCode form
-      always_assert_log(!code.editable_cfg_built(), "%s has a cfg!", SHOW(m));
-    });
+    if (pass->is_cfg_legal()) {
+      cfgs_built = true;
+    } else {
+      walk::parallel::code(build_class_scope(stores), [](DexMethod* m,
+                                                         IRCode& code) {
+        // Ensure that pass authors deconstructed the editable CFG at the end
+        // of their pass, unless the pass is CFG-legal. Other passes assume
+        // the incoming code will be in IRCode form
+        always_assert_log(!code.editable_cfg_built(), "%s has a cfg!",
+                          SHOW(m));
+      });
+    }
 
     class_cfgs.add_pass(pass->name(), VISUALIZER_PASS_OPTIONS);
 
@@ -355,6 +561,10 @@ void PassManager::run_passes(DexStoresVector& stores, ConfigFiles& conf) {
 
     if (run_hasher || run_type_checker) {
       scope = build_class_scope(it);
+      if (cfgs_built) {
+        clear_cfgs(scope);
+        cfgs_built = false;
+      }
       if (run_hasher) {
         m_current_pass_info->hash = boost::optional<hashing::DexHash>(
             this->run_hasher(pass->name().c_str(), scope));
@@ -364,7 +574,11 @@ void PassManager::run_passes(DexStoresVector& stores, ConfigFiles& conf) {
         // output phase -- the register allocator can fix it up later.
         run_verifier(scope, verify_moves,
                      /* check_no_overwrite_this */ false,
-                     /* validate_access */ false);
+                     /* validate_access */ false,
+                     type_check_changed_methods_only ? &verified_methods
+                                                     : nullptr,
+                     type_checker_sampling_rate,
+                     /* sample_seed */ i);
       }
     }
 
@@ -375,6 +589,9 @@ void PassManager::run_passes(DexStoresVector& stores, ConfigFiles& conf) {
       }
       m_preserved_analysis_passes.clear();
     }
+    if (!analysis_usage.get_preserve_cached_graphs()) {
+      m_analysis_cache.invalidate();
+    }
 
     if (pass->is_analysis_pass()) {
       // If the pass is an analysis pass, preserve it.
@@ -386,6 +603,9 @@ void PassManager::run_passes(DexStoresVector& stores, ConfigFiles& conf) {
 
   // Always run the type checker before generating the optimized dex code.
   scope = build_class_scope(it);
+  if (cfgs_built) {
+    clear_cfgs(scope);
+  }
   run_verifier(scope, verify_moves, get_redex_options().no_overwrite_this(),
                /* validate_access */ true);
 
@@ -431,18 +651,48 @@ Pass* PassManager::find_pass(const std::string& pass_name) const {
   return pass_it != m_activated_passes.end() ? *pass_it : nullptr;
 }
 
+void PassManager::run_passes_concurrently(size_t begin,
+                                          size_t end,
+                                          DexStoresVector& stores,
+                                          ConfigFiles& conf) {
+  std::string names;
+  for (size_t i = begin; i < end; ++i) {
+    names += (i == begin ? "" : ", ") + m_activated_passes[i]->name();
+  }
+  TRACE(PM, 1, "Running %s concurrently...", names.c_str());
+  Timer t(names + " (run)");
+  auto wq = workqueue_foreach<size_t>(
+      [&](size_t i) {
+        t_concurrent_pass_info = &m_pass_info[i];
+        m_activated_passes[i]->run_pass(stores, conf, *this);
+        t_concurrent_pass_info = nullptr;
+      },
+      end - begin);
+  for (size_t i = begin; i < end; ++i) {
+    wq.add_item(i);
+  }
+  wq.run_all();
+}
+
+PassManager::PassInfo* PassManager::current_pass_info() const {
+  return t_concurrent_pass_info != nullptr ? t_concurrent_pass_info
+                                           : m_current_pass_info;
+}
+
 void PassManager::incr_metric(const std::string& key, int64_t value) {
-  always_assert_log(m_current_pass_info != nullptr, "No current pass!");
-  (m_current_pass_info->metrics)[key] += value;
+  auto pass_info = current_pass_info();
+  always_assert_log(pass_info != nullptr, "No current pass!");
+  (pass_info->metrics)[key] += value;
 }
 
 void PassManager::set_metric(const std::string& key, int64_t value) {
-  always_assert_log(m_current_pass_info != nullptr, "No current pass!");
-  (m_current_pass_info->metrics)[key] = value;
+  auto pass_info = current_pass_info();
+  always_assert_log(pass_info != nullptr, "No current pass!");
+  (pass_info->metrics)[key] = value;
 }
 
 int64_t PassManager::get_metric(const std::string& key) {
-  return (m_current_pass_info->metrics)[key];
+  return (current_pass_info()->metrics)[key];
 }
 
 const std::vector<PassManager::PassInfo>& PassManager::get_pass_info() const {
@@ -7,6 +7,7 @@
 
 #pragma once
 
+#include "AnalysisCache.h"
 #include "ApkManager.h"
 #include "DexHasher.h"
 #include "Pass.h"
@@ -69,7 +70,7 @@ class PassManager {
   // do not use ProGuard configuration keep rules.
   void set_testing_mode() { m_testing_mode = true; }
 
-  const PassInfo* get_current_pass_info() const { return m_current_pass_info; }
+  const PassInfo* get_current_pass_info() const { return current_pass_info(); }
 
   ApkManager& apk_manager() { return m_apk_mgr; }
 
@@ -77,6 +78,9 @@ class PassManager {
 
   bool regalloc_has_run() { return m_regalloc_has_run; }
 
+  // Graphs shared by the passes, see AnalysisCache.
+  AnalysisCache& analysis_cache() { return m_analysis_cache; }
+
   template <typename PassType>
   PassType* get_preserved_analysis() const {
     auto pass = m_preserved_analysis_passes.find(typeid(PassType).name());
@@ -95,10 +99,21 @@ class PassManager {
 
   hashing::DexHash run_hasher(const char* name, const Scope& scope);
 
+  // Runs the activated passes [begin, end), which are read-only, each on its
+  // own thread.
+  void run_passes_concurrently(size_t begin,
+                               size_t end,
+                               DexStoresVector& stores,
+                               ConfigFiles& conf);
+
+  // The pass that the calling thread runs.
+  PassInfo* current_pass_info() const;
+
   ApkManager m_apk_mgr;
   std::vector<Pass*> m_registered_passes;
   std::vector<Pass*> m_activated_passes;
   std::unordered_map<AnalysisID, Pass*> m_preserved_analysis_passes;
+  AnalysisCache m_analysis_cache;
 
   // Per-pass information and metrics
   std::vector<PassManager::PassInfo> m_pass_info;
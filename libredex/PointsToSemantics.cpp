@@ -1517,7 +1517,7 @@ boost::optional<PointsToMethodSemantics> PointsToMethodSemantics::from_s_expr(
     if (!action_opt) {
       return {};
     }
-    semantics.add(*action_opt);
+    semantics.add(std::move(*action_opt));
   }
   return boost::optional<PointsToMethodSemantics>(semantics);
 }
@@ -1594,7 +1594,7 @@ void PointsToSemantics::load_stubs(const std::string& file_name) {
     DexMethodRef* dex_method = semantics_opt->get_method();
     auto it = m_method_semantics.find(dex_method);
     if (it == m_method_semantics.end()) {
-      m_method_semantics.emplace(dex_method, *semantics_opt);
+      m_method_semantics.emplace(dex_method, std::move(*semantics_opt));
     } else {
       TRACE(PTA, 2, "Collision with stub for method %s", SHOW(dex_method));
     }
@@ -1654,6 +1654,7 @@ void PointsToSemantics::generate_points_to_actions(DexMethod* dex_method) {
     pts_impl::PointsToActionGenerator generator(
         dex_method, semantics, m_type_system, m_utils);
     generator.run();
+    semantics->compact();
   }
 }
 
@@ -466,7 +466,12 @@ class PointsToMethodSemantics {
     return m_points_to_actions;
   }
 
-  void add(const PointsToAction& a) { m_points_to_actions.emplace_back(a); }
+  // The actions are built as temporaries, so they're moved in rather than
+  // copying their arguments.
+  void add(PointsToAction a) { m_points_to_actions.emplace_back(std::move(a)); }
+
+  // Releases the spare capacity of the actions once they're all generated.
+  void compact() { m_points_to_actions.shrink_to_fit(); }
 
   /*
    * This function attempts to remove points-to equations that have no effect on
@@ -7,8 +7,15 @@
 
 #pragma once
 
+#include <algorithm>
+#include <atomic>
 #include <chrono>
+#include <exception>
+#include <functional>
+#include <map>
+#include <memory>
 #include <queue>
+#include <vector>
 
 #ifdef __GNUC__
 #pragma GCC diagnostic push
@@ -33,16 +40,69 @@
  *
  * The thread-pool must be initialized with a positive number of threads to be
  * functional.
+ *
+ * Work items may themselves fan out into nested parallel work via
+ * run_nested(), which shares the threads of the pool instead of spawning
+ * additional ones.
  */
 class PriorityThreadPool {
+ public:
+  // How long the work items of one priority stayed queued before they ran.
+  struct QueueWaitStats {
+    size_t work_items{0};
+    std::chrono::duration<double> total{0};
+    std::chrono::duration<double> max{0};
+  };
+
  private:
+  struct PendingWorkItem {
+    std::function<void()> f;
+    std::chrono::steady_clock::time_point posted;
+  };
+
   std::unique_ptr<boost::asio::thread_pool> m_pool;
   // The following data structures are guarded by this mutex.
   boost::mutex m_mutex;
-  std::map<int, std::queue<std::function<void()>>> m_pending_work_items;
+  std::map<int, std::queue<PendingWorkItem>> m_pending_work_items;
+  std::map<int, QueueWaitStats> m_queue_wait_stats;
   size_t m_running_work_items{0};
   boost::condition_variable m_condition;
   std::chrono::duration<double> m_waited_time;
+  int m_num_threads{0};
+
+  // Shared between a run_nested() caller and the helper work items it posts;
+  // helpers may only get to run after the caller returned.
+  struct NestedTasks {
+    std::vector<std::function<void()>> tasks;
+    std::atomic<size_t> next{0};
+    // The following are guarded by this mutex.
+    boost::mutex mutex;
+    size_t done{0};
+    std::exception_ptr exception;
+    boost::condition_variable condition;
+
+    explicit NestedTasks(std::vector<std::function<void()>> tasks)
+        : tasks(std::move(tasks)) {}
+
+    // Claims and runs tasks until none are left to claim.
+    void help() {
+      for (size_t i; (i = next.fetch_add(1)) < tasks.size();) {
+        std::exception_ptr e;
+        try {
+          tasks[i]();
+        } catch (...) {
+          e = std::current_exception();
+        }
+        boost::mutex::scoped_lock lock(mutex);
+        if (e && !exception) {
+          exception = e;
+        }
+        if (++done == tasks.size()) {
+          condition.notify_all();
+        }
+      }
+    }
+  };
 
  public:
   // Creates an instance with a default number of threads
@@ -63,20 +123,32 @@ class PriorityThreadPool {
         .count();
   }
 
+  // The queue wait times of all work items that ran so far, by priority. Only
+  // meaningful after wait() or join().
+  const std::map<int, QueueWaitStats>& get_queue_wait_stats() const {
+    return m_queue_wait_stats;
+  }
+
   // The number of threads may be set at most once to a positive number
   void set_num_threads(int num_threads) {
     always_assert(!m_pool);
     if (num_threads > 0) {
       m_pool = std::make_unique<boost::asio::thread_pool>(num_threads);
+      m_num_threads = num_threads;
     }
   }
 
+  // The number of threads available to process work items; zero if the
+  // pool was never started or has been joined.
+  int get_num_threads() const { return m_num_threads; }
+
   // Post a work item with a priority. This method is thread safe.
   void post(int priority, const std::function<void()>& f) {
     always_assert(m_pool);
     {
       boost::mutex::scoped_lock lock(m_mutex);
-      m_pending_work_items[priority].push(f);
+      m_pending_work_items[priority].push(
+          PendingWorkItem{f, std::chrono::steady_clock::now()});
     }
     boost::asio::defer(*m_pool, [this]() {
       // Find work item with highest priority
@@ -84,11 +156,18 @@ class PriorityThreadPool {
       {
         boost::mutex::scoped_lock lock(m_mutex);
         auto& p = *m_pending_work_items.rbegin();
+        auto highest_priority = p.first;
         auto& queue = p.second;
-        highest_priority_f = queue.front();
+        auto& item = queue.front();
+        std::chrono::duration<double> queued =
+            std::chrono::steady_clock::now() - item.posted;
+        auto& stats = m_queue_wait_stats[highest_priority];
+        stats.work_items++;
+        stats.total += queued;
+        stats.max = std::max(stats.max, queued);
+        highest_priority_f = std::move(item.f);
         queue.pop();
         if (queue.empty()) {
-          auto highest_priority = p.first;
           m_pending_work_items.erase(highest_priority);
         }
         m_running_work_items++;
@@ -105,6 +184,38 @@ class PriorityThreadPool {
     });
   }
 
+  // Run all `tasks` and return once all of them have finished, rethrowing the
+  // first exception any of them threw. This method is thread safe, and is
+  // meant to be called from within work items of this pool.
+  //
+  // Up to (number of threads - 1) helper work items get posted with the given
+  // priority. The calling thread executes tasks as well; it only waits for
+  // tasks that other threads have already started, never for queued work.
+  // Thus no thread gets blocked, and the total parallelism stays bounded by
+  // the number of threads of the pool. Without any threads, all tasks simply
+  // run on the calling thread.
+  void run_nested(int priority, std::vector<std::function<void()>> tasks) {
+    if (tasks.empty()) {
+      return;
+    }
+    auto nested = std::make_shared<NestedTasks>(std::move(tasks));
+    if (m_num_threads > 0) {
+      auto num_helpers = std::min<size_t>(m_num_threads - 1,
+                                          nested->tasks.size() - 1);
+      for (size_t i = 0; i < num_helpers; i++) {
+        post(priority, [nested]() { nested->help(); });
+      }
+    }
+    nested->help();
+    boost::mutex::scoped_lock lock(nested->mutex);
+    while (nested->done != nested->tasks.size()) {
+      nested->condition.wait(lock);
+    }
+    if (nested->exception) {
+      std::rethrow_exception(nested->exception);
+    }
+  }
+
   // Wait for all work items to be processed.
   void wait() {
     always_assert(m_pool);
@@ -127,5 +238,7 @@ class PriorityThreadPool {
   void join() {
     wait();
     m_pool->join();
+    // No more work can be processed.
+    m_num_threads = 0;
   }
 };
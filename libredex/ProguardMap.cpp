@@ -7,21 +7,18 @@
 
 #include "ProguardMap.h"
 
+#include <boost/filesystem.hpp>
+#include <boost/iostreams/device/mapped_file.hpp>
+#include <cstring>
+#include <iterator>
+
 #include "DexUtil.h"
 #include "IRCode.h"
 #include "Timer.h"
-#include "WorkQueue.h"
+#include "Walkers.h"
 
 namespace {
 
-std::string find_or_same(
-    const std::string& key,
-    const std::unordered_map<std::string, std::string>& map) {
-  auto it = map.find(key);
-  if (it == map.end()) return key;
-  return it->second;
-}
-
 std::string convert_scalar_type(const std::string& type) {
   static const std::unordered_map<std::string, std::string> prim_map = {
       {"void", "V"},  {"boolean", "Z"}, {"byte", "B"},
@@ -149,10 +146,64 @@ ProguardMap::ProguardMap(const std::string& filename) {
     Timer t("Parsing proguard map");
     std::ifstream fp(filename);
     always_assert_log(fp, "Can't open proguard map: %s\n", filename.c_str());
-    parse_proguard_map(fp);
+    fp.close();
+    if (boost::filesystem::file_size(filename) == 0) {
+      // Empty files can't be mapped.
+      return;
+    }
+    boost::iostreams::mapped_file_source file(filename);
+    parse_proguard_map(file.data(), file.data() + file.size());
   }
 }
 
+ProguardMap::ProguardMap(std::istream& is) {
+  std::string contents{std::istreambuf_iterator<char>(is),
+                       std::istreambuf_iterator<char>()};
+  parse_proguard_map(contents.data(), contents.data() + contents.size());
+}
+
+const char* ProguardMap::StringPool::intern(boost::string_view str) {
+  auto it = m_index.find(str);
+  if (it != m_index.end()) {
+    return it->data();
+  }
+  constexpr size_t kBlockSize = 1 << 20;
+  size_t size = str.size() + 1;
+  if (size > m_free_size) {
+    size_t block_size = std::max(kBlockSize, size);
+    m_blocks.emplace_back(new char[block_size]);
+    m_free = m_blocks.back().get();
+    m_free_size = block_size;
+  }
+  char* copy = m_free;
+  memcpy(copy, str.data(), str.size());
+  copy[str.size()] = '\0';
+  m_free += size;
+  m_free_size -= size;
+  m_index.emplace(copy, str.size());
+  return copy;
+}
+
+const char* ProguardMap::StringPool::find(boost::string_view str) const {
+  auto it = m_index.find(str);
+  return it == m_index.end() ? nullptr : it->data();
+}
+
+void ProguardMap::add(NameMap& map,
+                      const std::string& key,
+                      const std::string& value) {
+  map[m_pool.intern(key)] = m_pool.intern(value);
+}
+
+std::string ProguardMap::find_or_same(const std::string& key,
+                                      const NameMap& map) const {
+  auto interned = m_pool.find(key);
+  if (interned == nullptr) return key;
+  auto it = map.find(interned);
+  if (it == map.end()) return key;
+  return it->second;
+}
+
 std::string ProguardMap::translate_class(const std::string& cls) const {
   return find_or_same(cls, m_classMap);
 }
@@ -181,8 +232,9 @@ std::string ProguardMap::deobfuscate_method(const std::string& method) const {
 std::vector<ProguardMap::Frame> ProguardMap::deobfuscate_frame(
     DexString* method_name, uint32_t line) const {
   std::vector<Frame> frames;
-  auto ranges_it =
-      m_obfMethodLinesMap.find(pg_impl::lines_key(method_name->str()));
+  auto key = m_pool.find(pg_impl::lines_key(method_name->str()));
+  auto ranges_it = key == nullptr ? m_obfMethodLinesMap.end()
+                                  : m_obfMethodLinesMap.find(key);
   if (ranges_it != m_obfMethodLinesMap.end()) {
     for (const auto& range : ranges_it->second) {
       if (!range->matches(line)) {
@@ -207,33 +259,45 @@ std::vector<ProguardMap::Frame> ProguardMap::deobfuscate_frame(
 
 ProguardLineRangeVector& ProguardMap::method_lines(
     const std::string& obfuscated_method) {
-  return m_obfMethodLinesMap.at(pg_impl::lines_key(obfuscated_method));
+  auto key = m_pool.find(pg_impl::lines_key(obfuscated_method));
+  if (key == nullptr) {
+    throw std::out_of_range("No line ranges for " + obfuscated_method);
+  }
+  return m_obfMethodLinesMap.at(key);
 }
 
-void ProguardMap::parse_proguard_map(std::istream& fp) {
+void ProguardMap::parse_proguard_map(const char* begin, const char* end) {
+  // The parsing helpers rely on lines being NUL-terminated, so each line gets
+  // copied into a reused buffer.
   std::string line;
-  while (std::getline(fp, line)) {
-    parse_class(line);
-  }
-  fp.clear();
-  fp.seekg(0);
-  assert_log(!fp.fail(), "Can't use ProguardMap with non-seekable stream");
-  while (std::getline(fp, line)) {
+  auto for_each_line = [&](const std::function<void()>& fn) {
+    for (const char* p = begin; p < end;) {
+      auto eol = static_cast<const char*>(memchr(p, '\n', end - p));
+      if (eol == nullptr) {
+        eol = end;
+      }
+      line.assign(p, eol - p);
+      fn();
+      p = eol + 1;
+    }
+  };
+  for_each_line([&]() { parse_class(line); });
+  for_each_line([&]() {
     if (parse_class(line)) {
-      continue;
+      return;
     }
     if (parse_field(line)) {
-      continue;
+      return;
     }
     if (parse_method(line)) {
-      continue;
+      return;
     }
     if (comment(line)) {
-      continue;
+      return;
     }
     always_assert_log(
         false, "Bogus line encountered in proguard map: %s\n", line.c_str());
-  }
+  });
 }
 
 bool ProguardMap::parse_class(const std::string& line) {
@@ -245,8 +309,8 @@ bool ProguardMap::parse_class(const std::string& line) {
   if (!id(p, newname)) return false;
   m_currClass = convert_type(classname);
   m_currNewClass = convert_type(newname);
-  m_classMap[m_currClass] = m_currNewClass;
-  m_obfClassMap[m_currNewClass] = m_currClass;
+  add(m_classMap, m_currClass, m_currNewClass);
+  add(m_obfClassMap, m_currNewClass, m_currClass);
   return true;
 }
 
@@ -276,9 +340,9 @@ bool ProguardMap::parse_field(const std::string& line) {
             pgold.c_str());
     m_pg_coalesced_interfaces.insert(ctype);
   }
-  m_fieldMap[pgold] = pgnew;
-  m_obfFieldMap[pgnew] = pgold;
-  m_obfUntypedFieldMap[pgnew_notype] = pgold;
+  add(m_fieldMap, pgold, pgnew);
+  add(m_obfFieldMap, pgnew, pgold);
+  add(m_obfUntypedFieldMap, pgnew_notype, pgold);
   return true;
 }
 
@@ -328,11 +392,12 @@ bool ProguardMap::parse_method(const std::string& line) {
   auto pgold = convert_method(classname, old_rtype, methodname, old_args);
   auto pgnew = convert_method(m_currNewClass, new_rtype, newname, new_args);
   auto pgnew_no_rtype = convert_method(m_currNewClass, "", newname, new_args);
-  m_methodMap[pgold] = pgnew;
-  m_obfMethodMap[pgnew] = pgold;
-  m_obfUntypedMethodMap[pgnew_no_rtype] = pgold;
+  add(m_methodMap, pgold, pgnew);
+  add(m_obfMethodMap, pgnew, pgold);
+  add(m_obfUntypedMethodMap, pgnew_no_rtype, pgold);
   lines->original_name = pgold;
-  m_obfMethodLinesMap[pg_impl::lines_key(pgnew)].push_back(std::move(lines));
+  m_obfMethodLinesMap[m_pool.intern(pg_impl::lines_key(pgnew))].push_back(
+      std::move(lines));
   return true;
 }
 
@@ -360,15 +425,6 @@ DexString* file_name_from_method_string(const DexString* method) {
   return DexString::make_string(s.substr(start, end - start) + ".java");
 }
 
-static void apply_deobfuscated_positions(DexMethod* method,
-                                         const ProguardMap& pm) {
-  auto* code = method->get_code();
-  if (code == nullptr) {
-    return;
-  }
-  apply_deobfuscated_positions(code, pm);
-}
-
 void apply_deobfuscated_positions(IRCode* code, const ProguardMap& pm) {
   for (auto& mie : *code) {
     if (mie.type != MFLOW_POSITION) {
@@ -412,6 +468,14 @@ std::string lines_key(const std::string& method_name) {
 
 void apply_deobfuscated_names(const std::vector<DexClasses>& dexen,
                               const ProguardMap& pm) {
+  Scope scope;
+  for (const auto& dex : dexen) {
+    scope.insert(scope.end(), dex.begin(), dex.end());
+  }
+  apply_deobfuscated_names(scope, pm);
+}
+
+void apply_deobfuscated_names(const Scope& scope, const ProguardMap& pm) {
   std::function<void(DexClass*)> worker_empty_pg_map = [&](DexClass* cls) {
     cls->set_deobfuscated_name(show(cls));
     for (const auto& m : cls->get_dmethods()) {
@@ -436,13 +500,11 @@ void apply_deobfuscated_names(const std::vector<DexClasses>& dexen,
       TRACE(PGR, 4, "deob dmeth %s %s", SHOW(m),
             pm.deobfuscate_method(show(m)).c_str());
       m->set_deobfuscated_name(pm.deobfuscate_method(show(m)));
-      pg_impl::apply_deobfuscated_positions(m, pm);
     }
     for (const auto& m : cls->get_vmethods()) {
       TRACE(PM, 4, "deob vmeth %s %s", SHOW(m),
             pm.deobfuscate_method(show(m)).c_str());
       m->set_deobfuscated_name(pm.deobfuscate_method(show(m)));
-      pg_impl::apply_deobfuscated_positions(m, pm);
     }
     for (const auto& f : cls->get_ifields()) {
       TRACE(PM, 4, "deob ifield %s %s", SHOW(f),
@@ -456,16 +518,19 @@ void apply_deobfuscated_names(const std::vector<DexClasses>& dexen,
     }
   };
 
-  auto wq = workqueue_foreach<DexClass*>(pm.empty() ? worker_empty_pg_map
-                                                    : worker_pg_map);
-
-  for (const auto& dex : dexen) {
-    for (const auto& cls : dex) {
-      wq.add_item(cls);
-    }
+  walk::parallel::classes(scope,
+                          pm.empty() ? worker_empty_pg_map : worker_pg_map);
+  if (pm.empty()) {
+    return;
   }
 
-  wq.run_all();
+  // Remapping positions costs about as much as walking the code, and would
+  // leave the classes with the largest methods for last if done per class.
+  walk::parallel::code_by_cost(
+      scope, [](DexMethod*) { return true; },
+      walk::parallel::code_size_cost, [&](DexMethod*, IRCode& code) {
+        pg_impl::apply_deobfuscated_positions(&code, pm);
+      });
 }
 
 std::string convert_type(std::string type) {
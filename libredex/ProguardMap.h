@@ -7,11 +7,15 @@
 
 #pragma once
 
+#include <boost/functional/hash.hpp>
+#include <boost/utility/string_view.hpp>
 #include <cstddef>
 #include <fstream>
+#include <memory>
 #include <string>
 #include <unordered_map>
 #include <unordered_set>
+#include <vector>
 
 #include "DexClass.h"
 #include "ProguardLineRange.h"
@@ -45,14 +49,15 @@ struct ProguardMap {
   explicit ProguardMap() = default;
 
   /**
-   * Construct map from the given file.
+   * Construct map from the given file. The file is memory-mapped rather than
+   * read through a stream.
    */
   explicit ProguardMap(const std::string& filename);
 
   /**
    * Construct map from a given stream.
    */
-  explicit ProguardMap(std::istream& is) { parse_proguard_map(is); }
+  explicit ProguardMap(std::istream& is);
 
   /**
    * Translate un-obfuscated class name to obfuscated name.
@@ -111,32 +116,66 @@ struct ProguardMap {
   }
 
  private:
-  void parse_proguard_map(std::istream& fp);
+  /**
+   * Owns a single copy of each distinct name in the map. Names are stored
+   * NUL-terminated, back to back in large blocks, so that the tables below
+   * can refer to them by pointer. A mapping file mentions most names several
+   * times, and one heap allocation per name adds up for big maps.
+   */
+  class StringPool {
+   public:
+    const char* intern(boost::string_view str);
+
+    // Returns nullptr if str hasn't been interned.
+    const char* find(boost::string_view str) const;
+
+   private:
+    struct Hash {
+      size_t operator()(boost::string_view str) const {
+        return boost::hash_range(str.begin(), str.end());
+      }
+    };
+    std::unordered_set<boost::string_view, Hash> m_index;
+    std::vector<std::unique_ptr<char[]>> m_blocks;
+    char* m_free{nullptr};
+    size_t m_free_size{0};
+  };
+
+  // Maps interned names to interned names.
+  using NameMap = std::unordered_map<const char*, const char*>;
+
+  void parse_proguard_map(const char* begin, const char* end);
 
   bool parse_class(const std::string& line);
   bool parse_field(const std::string& line);
   bool parse_method(const std::string& line);
 
+  void add(NameMap& map, const std::string& key, const std::string& value);
+  std::string find_or_same(const std::string& key, const NameMap& map) const;
+
  private:
+  StringPool m_pool;
+
   // Unobfuscated to obfuscated maps
-  std::unordered_map<std::string, std::string> m_classMap;
-  std::unordered_map<std::string, std::string> m_fieldMap;
-  std::unordered_map<std::string, std::string> m_methodMap;
+  NameMap m_classMap;
+  NameMap m_fieldMap;
+  NameMap m_methodMap;
 
   // Obfuscated to unobfuscated maps from proguard
-  std::unordered_map<std::string, std::string> m_obfClassMap;
-  std::unordered_map<std::string, std::string> m_obfFieldMap;
-  std::unordered_map<std::string, std::string> m_obfMethodMap;
+  NameMap m_obfClassMap;
+  NameMap m_obfFieldMap;
+  NameMap m_obfMethodMap;
 
   // Field map for reflection analysis when type is unknown
   // Stores Lcom/facebook/Class;.field -> original name without class name
-  std::unordered_map<std::string, std::string> m_obfUntypedFieldMap;
+  NameMap m_obfUntypedFieldMap;
 
   // Method map for reflection analysis when return type is unknown
   // Stores Lcom/facebook/Class;.method(II) -> original name without class name
-  std::unordered_map<std::string, std::string> m_obfUntypedMethodMap;
+  NameMap m_obfUntypedMethodMap;
 
-  std::unordered_map<std::string, ProguardLineRangeVector> m_obfMethodLinesMap;
+  // Keyed by interned pg_impl::lines_key() of the obfuscated method
+  std::unordered_map<const char*, ProguardLineRangeVector> m_obfMethodLinesMap;
 
   // Interfaces that are (most likely) coalesced by Proguard.
   std::unordered_set<std::string> m_pg_coalesced_interfaces;
@@ -153,6 +192,8 @@ struct ProguardMap {
 void apply_deobfuscated_names(const std::vector<DexClasses>&,
                               const ProguardMap&);
 
+void apply_deobfuscated_names(const Scope&, const ProguardMap&);
+
 // Exposed for testing purposes.
 namespace pg_impl {
 
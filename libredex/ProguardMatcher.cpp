@@ -6,7 +6,6 @@
  */
 
 #include <algorithm>
-#include <boost/regex.hpp>
 #include <iostream>
 #include <mutex>
 #include <thread>
@@ -19,6 +18,7 @@
 #include "ProguardPrintConfiguration.h"
 #include "ProguardRegex.h"
 #include "ProguardReporting.h"
+#include "ProguardWildcardMatcher.h"
 #include "ReachableClasses.h"
 #include "StringBuilder.h"
 #include "Timer.h"
@@ -28,14 +28,16 @@ using namespace keep_rules;
 
 namespace {
 
-using RegexMap = std::unordered_map<std::string, boost::regex>;
+using proguard_parser::WildcardMatcher;
 
-std::unique_ptr<boost::regex> make_rx(const std::string& s,
-                                      bool convert = true) {
+using RegexMap = std::unordered_map<std::string, WildcardMatcher>;
+
+std::unique_ptr<WildcardMatcher> make_rx(const std::string& s,
+                                         bool convert = true) {
   if (s.empty()) return nullptr;
   auto wc = convert ? proguard_parser::convert_wildcard_type(s) : s;
   auto rx = proguard_parser::form_type_regex(wc);
-  return std::make_unique<boost::regex>(rx);
+  return std::make_unique<WildcardMatcher>(rx);
 }
 
 std::string get_deobfuscated_name(const DexType* type) {
@@ -46,11 +48,11 @@ std::string get_deobfuscated_name(const DexType* type) {
   return cls->get_deobfuscated_name();
 }
 
-bool match_annotation_rx(const DexClass* cls, const boost::regex& annorx) {
+bool match_annotation_rx(const DexClass* cls, const WildcardMatcher& annorx) {
   const auto* annos = cls->get_anno_set();
   if (!annos) return false;
   for (const auto& anno : annos->get_annotations()) {
-    if (boost::regex_match(get_deobfuscated_name(anno->type()), annorx)) {
+    if (annorx.match(get_deobfuscated_name(anno->type()))) {
       return true;
     }
   }
@@ -90,10 +92,23 @@ struct ClassMatcher {
     return match_extends(cls);
   }
 
+  // Every class that matches has a deobfuscated name with this prefix.
+  const std::string& name_prefix() const {
+    return m_cls ? m_cls->literal_prefix() : s_empty;
+  }
+
+  // Every class that matches has a super class or interface, transitively,
+  // whose deobfuscated name starts with this.
+  const std::string& extends_prefix() const {
+    return m_extends ? m_extends->literal_prefix() : s_empty;
+  }
+
  private:
+  static const std::string s_empty;
+
   bool match_name(const DexClass* cls) const {
     const auto& deob_name = cls->get_deobfuscated_name();
-    return boost::regex_match(deob_name, *m_cls);
+    return m_cls->match(deob_name);
   }
 
   bool match_access(const DexClass* cls) const {
@@ -120,7 +135,7 @@ struct ClassMatcher {
       }
     }
     const auto& deob_name = cls->get_deobfuscated_name();
-    return boost::regex_match(deob_name, *m_extends);
+    return m_extends->match(deob_name);
   }
 
   bool search_interfaces(const DexClass* cls) {
@@ -168,14 +183,55 @@ struct ClassMatcher {
   DexAccessFlags setFlags_;
   DexAccessFlags unsetFlags_;
   std::string m_class_name;
-  std::unique_ptr<boost::regex> m_cls;
-  std::unique_ptr<boost::regex> m_anno;
-  std::unique_ptr<boost::regex> m_extends;
-  std::unique_ptr<boost::regex> m_extends_anno;
+  std::unique_ptr<WildcardMatcher> m_cls;
+  std::unique_ptr<WildcardMatcher> m_anno;
+  std::unique_ptr<WildcardMatcher> m_extends;
+  std::unique_ptr<WildcardMatcher> m_extends_anno;
 
   std::unordered_map<const DexClass*, bool> m_extends_result_cache;
 };
 
+const std::string ClassMatcher::s_empty;
+
+/*
+ * Classes sorted by deobfuscated name, so that the ones whose names start with
+ * a given prefix, e.g. those in a package, form a contiguous range.
+ */
+class ClassNameIndex {
+ public:
+  ClassNameIndex() = default;
+
+  template <class Collection>
+  void insert(const Collection& classes) {
+    m_classes.insert(m_classes.end(), classes.begin(), classes.end());
+  }
+
+  void sort() {
+    std::sort(m_classes.begin(), m_classes.end(),
+              [](const DexClass* a, const DexClass* b) {
+                return a->get_deobfuscated_name() < b->get_deobfuscated_name();
+              });
+  }
+
+  template <class Fn>
+  void for_each_with_prefix(const std::string& prefix, Fn fn) const {
+    auto it = std::lower_bound(m_classes.begin(), m_classes.end(), prefix,
+                               [](const DexClass* cls, const std::string& p) {
+                                 return cls->get_deobfuscated_name() < p;
+                               });
+    for (; it != m_classes.end(); ++it) {
+      const auto& name = (*it)->get_deobfuscated_name();
+      if (name.compare(0, prefix.size(), prefix) != 0) {
+        break;
+      }
+      fn(*it);
+    }
+  }
+
+ private:
+  std::vector<DexClass*> m_classes;
+};
+
 enum class RuleType {
   WHY_ARE_YOU_KEEPING,
   KEEP,
@@ -193,28 +249,6 @@ std::string to_string(RuleType rule_type) {
   }
 }
 
-/*
- * Build a DAG of class -> subclass and implementors. This is fairly similar to
- * build_type_hierarchy and friends, but Proguard doesn't distinguish between
- * subclasses and interface implementors, so this function combines them
- * together.
- */
-void build_extends_or_implements_hierarchy(const Scope& scope,
-                                           ClassHierarchy* hierarchy) {
-  for (const auto& cls : scope) {
-    const auto* type = cls->get_type();
-    // ensure an entry for the DexClass is created
-    (*hierarchy)[type];
-    const auto* super = cls->get_super_class();
-    if (super != nullptr) {
-      (*hierarchy)[super].insert(type);
-    }
-    for (const auto& impl : cls->get_interfaces()->get_type_list()) {
-      (*hierarchy)[impl].insert(type);
-    }
-  }
-}
-
 /*
  * This class contains the logic for matching against a single keep rule.
  */
@@ -238,7 +272,7 @@ class KeepRuleMatcher {
 
   bool any_method_matches(const DexClass* cls,
                           const MemberSpecification& method_keep,
-                          const boost::regex& method_regex);
+                          const WildcardMatcher& method_regex);
 
   // Check that each method keep matches at least one method in :cls.
   bool all_method_keeps_match(
@@ -268,30 +302,31 @@ class KeepRuleMatcher {
   template <class Container>
   void keep_fields(const Container& fields,
                    const MemberSpecification& fieldSpecification,
-                   const boost::regex& fieldname_regex);
+                   const WildcardMatcher& fieldname_regex);
 
   template <class Container>
   void keep_methods(const MemberSpecification& methodSpecification,
                     const Container& methods,
-                    const boost::regex& method_regex);
+                    const WildcardMatcher& method_regex);
 
   bool field_level_match(const MemberSpecification& fieldSpecification,
                          const DexField* field,
-                         const boost::regex& fieldname_regex);
+                         const WildcardMatcher& fieldname_regex);
 
   bool method_level_match(const MemberSpecification& methodSpecification,
                           const DexMethod* method,
-                          const boost::regex& method_regex);
+                          const WildcardMatcher& method_regex);
 
   template <class DexMember>
   bool has_annotation(const DexMember* member,
                       const std::string& annotation) const;
 
-  boost::regex register_matcher(const std::string& regex) const {
-    if (!m_regex_map.count(regex)) {
-      m_regex_map.emplace(regex, boost::regex{regex});
+  const WildcardMatcher& register_matcher(const std::string& regex) const {
+    auto it = m_regex_map.find(regex);
+    if (it == m_regex_map.end()) {
+      it = m_regex_map.emplace(regex, WildcardMatcher(regex)).first;
     }
-    return m_regex_map.at(regex);
+    return it->second;
   }
 
  private:
@@ -315,6 +350,7 @@ class ProguardMatcher {
     // may, for instance, forbid renaming of all classes that inherit from a
     // given external class.
     build_extends_or_implements_hierarchy(m_external_classes, &m_hierarchy);
+    build_indices();
   }
 
   void process_proguard_rules(const ProguardConfiguration& pg_config);
@@ -327,10 +363,34 @@ class ProguardMatcher {
   DexClass* find_single_class(const std::string& descriptor) const;
 
  private:
+  void build_indices();
+
+  // The transitive children of type in m_hierarchy. Rules with the same
+  // extends clause are common, so these are kept for all calls of
+  // process_keep.
+  const TypeSet& all_children(const DexType* type) const {
+    auto it = m_all_children.find(type);
+    if (it == m_all_children.end()) {
+      it = m_all_children.emplace(type, get_all_children(m_hierarchy, type))
+               .first;
+    }
+    return it->second;
+  }
+
+  template <class Fn>
+  void for_each_candidate(const ClassMatcher& class_match,
+                          bool process_external,
+                          Fn fn) const;
+
   const ProguardMap& m_pg_map;
   const Scope& m_classes;
   const Scope& m_external_classes;
   ClassHierarchy m_hierarchy;
+  ClassNameIndex m_class_index;
+  ClassNameIndex m_external_class_index;
+  // Classes that some class in m_hierarchy extends or implements.
+  ClassNameIndex m_super_index;
+  mutable std::unordered_map<const DexType*, TypeSet> m_all_children;
 };
 
 // Updates a class, field or method to add keep modifiers.
@@ -382,10 +442,10 @@ bool KeepRuleMatcher::has_annotation(const DexMember* member,
     }
   } else {
     auto annotation_regex = proguard_parser::form_type_regex(annotation);
-    const boost::regex& annotation_matcher = register_matcher(annotation_regex);
+    const WildcardMatcher& annotation_matcher =
+        register_matcher(annotation_regex);
     for (const auto& anno : annos->get_annotations()) {
-      if (boost::regex_match(get_deobfuscated_name(anno->type()),
-                             annotation_matcher)) {
+      if (annotation_matcher.match(get_deobfuscated_name(anno->type()))) {
         return true;
       }
     }
@@ -412,7 +472,7 @@ std::string extract_method_name_and_type(
 bool KeepRuleMatcher::field_level_match(
     const MemberSpecification& fieldSpecification,
     const DexField* field,
-    const boost::regex& fieldname_regex) {
+    const WildcardMatcher& fieldname_regex) {
   // Check for annotation guards.
   if (!(fieldSpecification.annotationType.empty())) {
     if (!has_annotation(field, fieldSpecification.annotationType)) {
@@ -427,13 +487,13 @@ bool KeepRuleMatcher::field_level_match(
   }
   // Match field name against regex.
   auto dequalified_name = extract_field_name(field->get_deobfuscated_name());
-  return boost::regex_match(dequalified_name, fieldname_regex);
+  return fieldname_regex.match(dequalified_name);
 }
 
 template <class Container>
 void KeepRuleMatcher::keep_fields(const Container& fields,
                                   const MemberSpecification& fieldSpecification,
-                                  const boost::regex& fieldname_regex) {
+                                  const WildcardMatcher& fieldname_regex) {
   for (DexField* field : fields) {
     if (!field_level_match(fieldSpecification, field, fieldname_regex)) {
       continue;
@@ -456,7 +516,7 @@ std::string field_regex(const MemberSpecification& field_spec) {
 void KeepRuleMatcher::apply_field_keeps(const DexClass* cls) {
   for (const auto& field_spec : m_keep_rule.class_spec.fieldSpecifications) {
     auto fieldname_regex = field_regex(field_spec);
-    const boost::regex& matcher = register_matcher(fieldname_regex);
+    const WildcardMatcher& matcher = register_matcher(fieldname_regex);
     keep_fields(cls->get_ifields(), field_spec, matcher);
     keep_fields(cls->get_sfields(), field_spec, matcher);
   }
@@ -465,7 +525,7 @@ void KeepRuleMatcher::apply_field_keeps(const DexClass* cls) {
 bool KeepRuleMatcher::method_level_match(
     const MemberSpecification& methodSpecification,
     const DexMethod* method,
-    const boost::regex& method_regex) {
+    const WildcardMatcher& method_regex) {
   // Check to see if the method match is guarded by an annotation match.
   if (!(methodSpecification.annotationType.empty())) {
     if (!has_annotation(method, methodSpecification.annotationType)) {
@@ -479,14 +539,14 @@ bool KeepRuleMatcher::method_level_match(
   }
   auto dequalified_name =
       extract_method_name_and_type(method->get_deobfuscated_name());
-  return boost::regex_match(dequalified_name.c_str(), method_regex);
+  return method_regex.match(dequalified_name);
 }
 
 template <class Container>
 void KeepRuleMatcher::keep_methods(
     const MemberSpecification& methodSpecification,
     const Container& methods,
-    const boost::regex& method_regex) {
+    const WildcardMatcher& method_regex) {
   for (DexMethod* method : methods) {
     if (method_level_match(methodSpecification, method, method_regex)) {
       if (m_rule_type == RuleType::KEEP) {
@@ -510,7 +570,8 @@ void KeepRuleMatcher::apply_method_keeps(const DexClass* cls) {
   auto methodSpecifications = m_keep_rule.class_spec.methodSpecifications;
   for (auto& method_spec : methodSpecifications) {
     auto qualified_method_regex = method_regex(method_spec);
-    const boost::regex& method_regex = register_matcher(qualified_method_regex);
+    const WildcardMatcher& method_regex =
+        register_matcher(qualified_method_regex);
     keep_methods(method_spec, cls->get_vmethods(), method_regex);
     keep_methods(method_spec, cls->get_dmethods(), method_regex);
   }
@@ -527,7 +588,7 @@ bool classname_contains_wildcard(const std::string& classname) {
 
 bool KeepRuleMatcher::any_method_matches(const DexClass* cls,
                                          const MemberSpecification& method_keep,
-                                         const boost::regex& method_regex) {
+                                         const WildcardMatcher& method_regex) {
   auto match = [&](const DexMethod* method) {
     return method_level_match(method_keep, method, method_regex);
   };
@@ -544,7 +605,7 @@ bool KeepRuleMatcher::all_method_keeps_match(
                      method_keeps.end(),
                      [&](const MemberSpecification& method_keep) {
                        auto qualified_method_regex = method_regex(method_keep);
-                       const boost::regex& matcher =
+                       const WildcardMatcher& matcher =
                            register_matcher(qualified_method_regex);
                        return any_method_matches(cls, method_keep, matcher);
                      });
@@ -553,7 +614,7 @@ bool KeepRuleMatcher::all_method_keeps_match(
 bool KeepRuleMatcher::any_field_matches(const DexClass* cls,
                                         const MemberSpecification& field_keep) {
   auto fieldtype_regex = field_regex(field_keep);
-  const boost::regex& matcher = register_matcher(fieldtype_regex);
+  const WildcardMatcher& matcher = register_matcher(fieldtype_regex);
   auto match = [&](const DexField* field) {
     return field_level_match(field_keep, field, matcher);
   };
@@ -708,6 +769,63 @@ DexClass* ProguardMatcher::find_single_class(
   return type_class(typ);
 }
 
+void ProguardMatcher::build_indices() {
+  m_class_index.insert(m_classes);
+  m_class_index.sort();
+  m_external_class_index.insert(m_external_classes);
+  m_external_class_index.sort();
+  std::vector<DexClass*> supers;
+  for (const auto& pair : m_hierarchy) {
+    if (pair.second.empty()) {
+      continue;
+    }
+    auto cls = type_class(pair.first);
+    if (cls != nullptr) {
+      supers.push_back(cls);
+    }
+  }
+  m_super_index.insert(supers);
+  m_super_index.sort();
+}
+
+// Calls fn on a superset of the classes that class_match may accept. The
+// classes whose names share the pattern's literal prefix are a contiguous
+// range of the name index. When the name pattern has no useful prefix but the
+// extends pattern does, we collect the subclasses and implementors of the
+// matching super types instead.
+template <class Fn>
+void ProguardMatcher::for_each_candidate(const ClassMatcher& class_match,
+                                         bool process_external,
+                                         Fn fn) const {
+  // Every class descriptor starts with "L".
+  const auto& name_prefix = class_match.name_prefix();
+  const auto& extends_prefix = class_match.extends_prefix();
+  if (name_prefix.size() <= 1 && extends_prefix.size() > 1) {
+    // The subtrees of the matching super types overlap, so walk them with a
+    // shared worklist rather than collecting all children of each.
+    std::unordered_set<const DexType*> visited;
+    std::vector<const DexType*> worklist;
+    m_super_index.for_each_with_prefix(extends_prefix, [&](DexClass* super) {
+      worklist.push_back(super->get_type());
+      while (!worklist.empty()) {
+        const auto* type = worklist.back();
+        worklist.pop_back();
+        for (const auto* child : get_children(m_hierarchy, type)) {
+          if (visited.insert(child).second) {
+            fn(type_class(child));
+            worklist.push_back(child);
+          }
+        }
+      }
+    });
+    return;
+  }
+  m_class_index.for_each_with_prefix(name_prefix, fn);
+  if (process_external) {
+    m_external_class_index.for_each_with_prefix(name_prefix, fn);
+  }
+}
+
 void ProguardMatcher::process_keep(const KeepSpecSet& keep_rules,
                                    RuleType rule_type,
                                    bool process_external) {
@@ -741,14 +859,9 @@ void ProguardMatcher::process_keep(const KeepSpecSet& keep_rules,
     ClassMatcher class_match(*keep_rule);
     KeepRuleMatcher rule_matcher(rule_type, *keep_rule, regex_map);
 
-    for (const auto& cls : m_classes) {
+    for_each_candidate(class_match, process_external, [&](DexClass* cls) {
       process_single_keep(class_match, rule_matcher, cls);
-    }
-    if (process_external) {
-      for (const auto& cls : m_external_classes) {
-        process_single_keep(class_match, rule_matcher, cls);
-      }
-    }
+    });
   });
 
   RegexMap regex_map;
@@ -772,7 +885,7 @@ void ProguardMatcher::process_keep(const KeepSpecSet& keep_rules,
       DexClass* super = find_single_class(extendsClassName);
       if (super != nullptr) {
         KeepRuleMatcher rule_matcher(rule_type, keep_rule, regex_map);
-        auto children = get_all_children(m_hierarchy, super->get_type());
+        const auto& children = all_children(super->get_type());
         process_single_keep(class_match, rule_matcher, super);
         for (auto const* type : children) {
           process_single_keep(class_match, rule_matcher, type_class(type));
@@ -0,0 +1,414 @@
+/*
+ * Copyright (c) Facebook, Inc. and its affiliates.
+ *
+ * This source code is licensed under the MIT license found in the
+ * LICENSE file in the root directory of this source tree.
+ */
+
+#include "ProguardWildcardMatcher.h"
+
+#include <cctype>
+#include <cstring>
+
+namespace keep_rules {
+namespace proguard_parser {
+
+namespace {
+
+using CharSet = std::bitset<256>;
+
+// Thrown while parsing a regex that uses syntax we do not compile.
+struct Unsupported {};
+
+struct Node {
+  enum Kind { Set, Concat, Alt, Star, Plus, Opt };
+
+  Kind kind;
+  CharSet set;
+  std::vector<Node> kids;
+
+  explicit Node(Kind k) : kind(k) {}
+
+  static Node single(unsigned char c) {
+    Node n(Set);
+    n.set.set(c);
+    return n;
+  }
+};
+
+/*
+ * Recursive descent parser for the subset of the Perl regex syntax that
+ * form_type_regex and form_member_regex emit.
+ */
+class Parser {
+ public:
+  explicit Parser(const std::string& regex) : m_regex(regex) {}
+
+  Node parse() {
+    auto node = parse_alt();
+    if (m_pos != m_regex.size()) {
+      throw Unsupported();
+    }
+    return node;
+  }
+
+ private:
+  bool at_end() const { return m_pos == m_regex.size(); }
+
+  char peek() const { return m_regex[m_pos]; }
+
+  char next() {
+    if (at_end()) {
+      throw Unsupported();
+    }
+    return m_regex[m_pos++];
+  }
+
+  // Escapes of alphanumerics are character classes, anchors or backrefs.
+  char escaped() {
+    char c = next();
+    if (std::isalnum(static_cast<unsigned char>(c))) {
+      throw Unsupported();
+    }
+    return c;
+  }
+
+  Node parse_alt() {
+    Node alt(Node::Alt);
+    alt.kids.push_back(parse_concat());
+    while (!at_end() && peek() == '|') {
+      ++m_pos;
+      alt.kids.push_back(parse_concat());
+    }
+    if (alt.kids.size() == 1) {
+      return std::move(alt.kids[0]);
+    }
+    return alt;
+  }
+
+  Node parse_concat() {
+    Node concat(Node::Concat);
+    while (!at_end() && peek() != '|' && peek() != ')') {
+      concat.kids.push_back(parse_repeat());
+    }
+    return concat;
+  }
+
+  Node parse_repeat() {
+    auto atom = parse_atom();
+    if (at_end()) {
+      return atom;
+    }
+    Node::Kind kind;
+    switch (peek()) {
+    case '*':
+      kind = Node::Star;
+      break;
+    case '+':
+      kind = Node::Plus;
+      break;
+    case '?':
+      kind = Node::Opt;
+      break;
+    case '{':
+      throw Unsupported();
+    default:
+      return atom;
+    }
+    ++m_pos;
+    if (!at_end()) {
+      // A lazy quantifier accepts the same language; possessive ones and
+      // stacked quantifiers do not, or are errors.
+      if (peek() == '?') {
+        ++m_pos;
+      }
+      if (!at_end() && std::strchr("*+?{", peek()) != nullptr) {
+        throw Unsupported();
+      }
+    }
+    Node repeat(kind);
+    repeat.kids.push_back(std::move(atom));
+    return repeat;
+  }
+
+  Node parse_atom() {
+    char c = next();
+    switch (c) {
+    case '(': {
+      if (!at_end() && peek() == '?') {
+        ++m_pos;
+        if (next() != ':') {
+          throw Unsupported();
+        }
+      }
+      auto group = parse_alt();
+      if (next() != ')') {
+        throw Unsupported();
+      }
+      return group;
+    }
+    case '[':
+      return parse_class();
+    case '.': {
+      Node any(Node::Set);
+      any.set.set();
+      return any;
+    }
+    case '\\':
+      return Node::single(escaped());
+    case '^':
+    case '$':
+    case '{':
+    case '}':
+    case ')':
+    case '*':
+    case '+':
+    case '?':
+    case '|':
+      throw Unsupported();
+    default:
+      return Node::single(c);
+    }
+  }
+
+  Node parse_class() {
+    Node cls(Node::Set);
+    bool negate = false;
+    if (!at_end() && peek() == '^') {
+      negate = true;
+      ++m_pos;
+    }
+    bool first = true;
+    while (true) {
+      char c = next();
+      if (c == ']' && !first) {
+        break;
+      }
+      first = false;
+      if (c == '[') {
+        // Possibly a [:class:]
+        throw Unsupported();
+      }
+      if (c == '\\') {
+        c = escaped();
+      }
+      auto lo = static_cast<unsigned char>(c);
+      auto hi = lo;
+      if (m_pos + 1 < m_regex.size() && peek() == '-' &&
+          m_regex[m_pos + 1] != ']') {
+        ++m_pos;
+        char h = next();
+        if (h == '\\') {
+          h = escaped();
+        }
+        hi = static_cast<unsigned char>(h);
+        if (hi < lo) {
+          throw Unsupported();
+        }
+      }
+      for (unsigned int i = lo; i <= hi; ++i) {
+        cls.set.set(i);
+      }
+    }
+    if (negate) {
+      cls.set.flip();
+    }
+    return cls;
+  }
+
+  const std::string& m_regex;
+  size_t m_pos{0};
+};
+
+/*
+ * Thompson construction. States are built back to front: compile(node, next)
+ * returns a state that matches node and then continues at next.
+ */
+class NFABuilder {
+ public:
+  struct State {
+    enum Kind { Set, Split, Accept } kind;
+    CharSet set;
+    int out1;
+    int out2;
+  };
+
+  int accept() { return add({State::Accept, CharSet(), -1, -1}); }
+
+  int compile(const Node& node, int next) {
+    switch (node.kind) {
+    case Node::Set:
+      return add({State::Set, node.set, next, -1});
+    case Node::Concat:
+      for (auto it = node.kids.rbegin(); it != node.kids.rend(); ++it) {
+        next = compile(*it, next);
+      }
+      return next;
+    case Node::Alt: {
+      int entry = compile(node.kids.back(), next);
+      for (auto it = node.kids.rbegin() + 1; it != node.kids.rend(); ++it) {
+        entry = add({State::Split, CharSet(), compile(*it, next), entry});
+      }
+      return entry;
+    }
+    case Node::Star: {
+      int loop = add({State::Split, CharSet(), -1, next});
+      int body = compile(node.kids[0], loop);
+      m_states[loop].out1 = body;
+      return loop;
+    }
+    case Node::Plus: {
+      int loop = add({State::Split, CharSet(), -1, next});
+      int body = compile(node.kids[0], loop);
+      m_states[loop].out1 = body;
+      return body;
+    }
+    case Node::Opt:
+      return add(
+          {State::Split, CharSet(), compile(node.kids[0], next), next});
+    }
+    throw Unsupported();
+  }
+
+  const std::vector<State>& states() const { return m_states; }
+
+ private:
+  int add(State state) {
+    m_states.push_back(std::move(state));
+    return static_cast<int>(m_states.size() - 1);
+  }
+
+  std::vector<State> m_states;
+};
+
+} // namespace
+
+WildcardMatcher::WildcardMatcher(const std::string& regex) {
+  if (!compile(regex)) {
+    m_fallback = std::make_unique<boost::regex>(regex);
+  }
+}
+
+bool WildcardMatcher::compile(const std::string& regex) {
+  Node root(Node::Concat);
+  try {
+    root = Parser(regex).parse();
+  } catch (const Unsupported&) {
+    return false;
+  }
+
+  // Peel the literal characters off the front; they are compared directly.
+  if (root.kind == Node::Set && root.set.count() == 1) {
+    Node concat(Node::Concat);
+    concat.kids.push_back(std::move(root));
+    root = std::move(concat);
+  }
+  if (root.kind == Node::Concat) {
+    size_t literals = 0;
+    for (const auto& kid : root.kids) {
+      if (kid.kind != Node::Set || kid.set.count() != 1) {
+        break;
+      }
+      for (unsigned int c = 0; c < 256; ++c) {
+        if (kid.set.test(c)) {
+          m_prefix += static_cast<char>(c);
+          break;
+        }
+      }
+      ++literals;
+    }
+    root.kids.erase(root.kids.begin(), root.kids.begin() + literals);
+  }
+
+  NFABuilder builder;
+  int entry = builder.compile(root, builder.accept());
+  const auto& states = builder.states();
+
+  // Only the consuming states and the accepting state take part in the
+  // simulation; the splits are folded into the closures.
+  std::vector<int> bit(states.size(), -1);
+  for (size_t i = 0; i < states.size(); ++i) {
+    if (states[i].kind == NFABuilder::State::Split) {
+      continue;
+    }
+    if (m_sets.size() == kMaxStates) {
+      m_sets.clear();
+      m_prefix.clear();
+      return false;
+    }
+    bit[i] = static_cast<int>(m_sets.size());
+    if (states[i].kind == NFABuilder::State::Accept) {
+      m_accept = m_sets.size();
+    }
+    m_sets.push_back(states[i].set);
+  }
+  m_words = (m_sets.size() + 63) / 64;
+
+  std::vector<char> visited(states.size());
+  std::vector<int> stack;
+  auto closure = [&](int from, uint64_t* out) {
+    std::fill(visited.begin(), visited.end(), 0);
+    stack.assign(1, from);
+    while (!stack.empty()) {
+      int s = stack.back();
+      stack.pop_back();
+      if (s < 0 || visited[s]) {
+        continue;
+      }
+      visited[s] = 1;
+      if (states[s].kind == NFABuilder::State::Split) {
+        stack.push_back(states[s].out2);
+        stack.push_back(states[s].out1);
+      } else {
+        out[bit[s] / 64] |= uint64_t(1) << (bit[s] % 64);
+      }
+    }
+  };
+
+  closure(entry, m_start);
+  m_follow.assign(m_sets.size() * m_words, 0);
+  for (size_t i = 0; i < states.size(); ++i) {
+    if (states[i].kind == NFABuilder::State::Set) {
+      closure(states[i].out1, &m_follow[bit[i] * m_words]);
+    }
+  }
+  return true;
+}
+
+bool WildcardMatcher::match(const std::string& str) const {
+  if (m_fallback) {
+    return boost::regex_match(str, *m_fallback);
+  }
+  if (str.compare(0, m_prefix.size(), m_prefix) != 0) {
+    return false;
+  }
+  uint64_t cur[kWords];
+  uint64_t next[kWords];
+  std::copy(m_start, m_start + m_words, cur);
+  for (size_t i = m_prefix.size(); i < str.size(); ++i) {
+    auto c = static_cast<unsigned char>(str[i]);
+    std::fill(next, next + m_words, 0);
+    bool alive = false;
+    for (size_t w = 0; w < m_words; ++w) {
+      for (uint64_t bits = cur[w]; bits != 0; bits &= bits - 1) {
+        size_t s = w * 64 + __builtin_ctzll(bits);
+        if (!m_sets[s].test(c)) {
+          continue;
+        }
+        const uint64_t* follow = &m_follow[s * m_words];
+        for (size_t v = 0; v < m_words; ++v) {
+          next[v] |= follow[v];
+        }
+        alive = true;
+      }
+    }
+    if (!alive) {
+      return false;
+    }
+    std::copy(next, next + m_words, cur);
+  }
+  return (cur[m_accept / 64] >> (m_accept % 64)) & 1;
+}
+
+} // namespace proguard_parser
+} // namespace keep_rules
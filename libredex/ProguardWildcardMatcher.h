@@ -0,0 +1,65 @@
+/*
+ * Copyright (c) Facebook, Inc. and its affiliates.
+ *
+ * This source code is licensed under the MIT license found in the
+ * LICENSE file in the root directory of this source tree.
+ */
+
+#pragma once
+
+#include <bitset>
+#include <boost/regex.hpp>
+#include <cstdint>
+#include <memory>
+#include <string>
+#include <vector>
+
+namespace keep_rules {
+namespace proguard_parser {
+
+/*
+ * Matches names against the regexes built by form_type_regex and
+ * form_member_regex, i.e. against ProGuard's `*`, `**`, `?`, `%`, `***` and
+ * `...` wildcards. match() is equivalent to boost::regex_match on the same
+ * regex, but those regexes only ever use literals, `.`, character classes,
+ * non-capturing groups, alternation and `*`, so we compile them to a
+ * bit-parallel NFA instead. The literal prefix of the pattern (typically the
+ * package) is compared before the NFA runs.
+ *
+ * Regexes outside of that subset, such as member names with a `$` that
+ * form_member_regex leaves unescaped, or patterns too large for the NFA, are
+ * handed to boost::regex.
+ */
+class WildcardMatcher {
+ public:
+  explicit WildcardMatcher(const std::string& regex);
+
+  bool match(const std::string& str) const;
+
+  bool uses_fallback() const { return m_fallback != nullptr; }
+
+  // Every matching string starts with this. Empty for the fallback.
+  const std::string& literal_prefix() const { return m_prefix; }
+
+  static constexpr size_t kMaxStates = 256;
+
+ private:
+  static constexpr size_t kWords = kMaxStates / 64;
+
+  bool compile(const std::string& regex);
+
+  std::string m_prefix;
+  // Consuming states, plus the accepting state at index m_accept.
+  std::vector<std::bitset<256>> m_sets;
+  // For each state, the states reachable after it consumed a character, as
+  // m_words words starting at m_follow[state * m_words].
+  std::vector<uint64_t> m_follow;
+  uint64_t m_start[kWords]{};
+  size_t m_words{0};
+  size_t m_accept{0};
+
+  std::unique_ptr<boost::regex> m_fallback;
+};
+
+} // namespace proguard_parser
+} // namespace keep_rules
@@ -6,12 +6,16 @@
  */
 
 #include "Purity.h"
+
+#include <atomic>
+
 #include "ControlFlow.h"
 #include "EditableCfgAdapter.h"
+#include "GraphUtil.h"
 #include "IRInstruction.h"
 #include "Resolver.h"
 #include "Walkers.h"
-#include "WeakTopologicalOrdering.h"
+#include "WorkQueue.h"
 
 std::ostream& operator<<(std::ostream& o, const CseLocation& l) {
   switch (l.special_location) {
@@ -419,128 +423,136 @@ size_t compute_locations_closure(
     }
   });
 
-  std::unordered_map<const DexMethod*, LocationsAndDependencies> method_lads(
-      concurrent_method_lads.begin(), concurrent_method_lads.end());
-
-  // 2. Compute inverse dependencies so that we know what needs to be recomputed
-  // during the fixpoint computation, and determine set of methods that are
-  // initially "impacted" in the sense that they have dependencies.
-  std::unordered_map<const DexMethod*, std::unordered_set<const DexMethod*>>
-      inverse_dependencies;
-  std::unordered_set<const DexMethod*> impacted_methods;
-  for (const auto& p : method_lads) {
-    auto method = p.first;
-    auto& lads = p.second;
-    if (!lads.dependencies.empty()) {
-      for (auto d : lads.dependencies) {
-        inverse_dependencies[d].insert(method);
+  // 2. Number the methods in a deterministic order, and compute the
+  //    strongly connected components of their dependencies. All the methods
+  //    of a component depend on each other, so they end up with the same
+  //    locations.
+  std::vector<const DexMethod*> methods;
+  methods.reserve(concurrent_method_lads.size());
+  for (const auto& p : concurrent_method_lads) {
+    methods.push_back(p.first);
+  }
+  std::sort(methods.begin(), methods.end(), compare_dexmethods);
+  std::unordered_map<const DexMethod*, uint32_t> method_indices;
+  for (uint32_t i = 0; i < methods.size(); ++i) {
+    method_indices.emplace(methods[i], i);
+  }
+
+  const auto n = static_cast<uint32_t>(methods.size());
+  std::vector<std::vector<uint32_t>> succs(n);
+  // Methods that depend on a method for which there is no information are
+  // equivalent to a general memory barrier, and are systematically pruned.
+  std::vector<bool> unknown_methods(n, false);
+  for (uint32_t i = 0; i < n; ++i) {
+    const auto& lads = concurrent_method_lads.at(methods[i]);
+    for (auto d : lads.dependencies) {
+      if (d == methods[i]) {
+        continue;
+      }
+      auto it = method_indices.find(d);
+      if (it == method_indices.end()) {
+        unknown_methods[i] = true;
+      } else {
+        succs[i].push_back(it->second);
       }
-      impacted_methods.insert(method);
     }
+    std::sort(succs[i].begin(), succs[i].end());
   }
 
-  // 3. Let's try to (semantically) inline locations, computing a fixed
-  //    point. Methods for which information is directly or indirectly absent
-  //    are equivalent to a general memory barrier, and are systematically
-  //    pruned.
+  auto scc_members = graph::strongly_connected_components(succs);
+  std::vector<uint32_t> method_sccs(n);
+  for (uint32_t scc = 0; scc < scc_members.size(); ++scc) {
+    for (auto m : scc_members[scc]) {
+      method_sccs[m] = scc;
+    }
+  }
 
-  // TODO: Instead of custom fixpoint computation using WTO, consider using the
-  // MonotonicFixpointIterator, operating on a callgraph, capture the
-  // dependencies, and have the Locations as the abstract domain.
+  const auto num_sccs = static_cast<uint32_t>(scc_members.size());
+  std::vector<std::vector<uint32_t>> scc_dependencies(num_sccs);
+  std::vector<std::vector<uint32_t>> scc_dependents(num_sccs);
+  for (uint32_t scc = 0; scc < num_sccs; ++scc) {
+    auto& deps = scc_dependencies[scc];
+    for (auto m : scc_members[scc]) {
+      for (auto w : succs[m]) {
+        if (method_sccs[w] != scc) {
+          deps.push_back(method_sccs[w]);
+        }
+      }
+    }
+    std::sort(deps.begin(), deps.end());
+    deps.erase(std::unique(deps.begin(), deps.end()), deps.end());
+    for (auto d : deps) {
+      scc_dependents[d].push_back(scc);
+    }
+  }
 
-  size_t iterations = 0;
-  while (!impacted_methods.empty()) {
-    iterations++;
-    // We order the impacted methods in a deterministic way that's likely
-    // helping to reduce the number of needed iterations.
-    sparta::WeakTopologicalOrdering<const DexMethod*> wto(
-        nullptr,
-        [&impacted_methods, &inverse_dependencies](const DexMethod* const& m) {
-          std::vector<const DexMethod*> successors;
-          if (m == nullptr) {
-            std::copy(impacted_methods.begin(), impacted_methods.end(),
-                      std::back_inserter(successors));
-          } else {
-            auto it = inverse_dependencies.find(m);
-            if (it != inverse_dependencies.end()) {
-              for (auto n : it->second) {
-                if (impacted_methods.count(n)) {
-                  successors.push_back(n);
-                }
-              }
-            }
+  // 3. Compute the locations of the components bottom-up: a component is
+  //    scheduled once all the components it depends on are done, so the
+  //    independent parts of the dependency graph are processed in parallel.
+  struct SccResult {
+    bool unknown{false};
+    CseUnorderedLocationSet locations;
+    // The length of the longest chain of components below this one.
+    size_t depth{0};
+  };
+  std::vector<SccResult> scc_results(num_sccs);
+  std::vector<std::atomic<uint32_t>> pending(num_sccs);
+  for (uint32_t scc = 0; scc < num_sccs; ++scc) {
+    pending[scc] = scc_dependencies[scc].size();
+  }
+  auto wq = workqueue_foreach<uint32_t>(
+      [&](sparta::SpartaWorkerState<uint32_t>* worker_state, uint32_t scc) {
+        auto& scc_result = scc_results[scc];
+        for (auto d : scc_dependencies[scc]) {
+          const auto& dep_result = scc_results[d];
+          scc_result.depth = std::max(scc_result.depth, dep_result.depth + 1);
+          if (dep_result.unknown) {
+            scc_result.unknown = true;
+          } else if (!scc_result.unknown) {
+            scc_result.locations.insert(dep_result.locations.begin(),
+                                        dep_result.locations.end());
           }
-          // Make number of iterations deterministic
-          std::sort(successors.begin(), successors.end(), compare_dexmethods);
-          return successors;
-        });
-
-    std::vector<const DexMethod*> ordered_impacted_methods;
-    wto.visit_depth_first([&ordered_impacted_methods](const DexMethod* m) {
-      if (m) {
-        ordered_impacted_methods.push_back(m);
-      }
-    });
-    impacted_methods.clear();
-
-    std::vector<const DexMethod*> changed_methods;
-    for (const DexMethod* method : ordered_impacted_methods) {
-      auto& lads = method_lads.at(method);
-      bool unknown = false;
-      size_t lads_locations_size = lads.locations.size();
-      for (const DexMethod* d : lads.dependencies) {
-        if (d == method) {
-          continue;
         }
-        auto it = method_lads.find(d);
-        if (it == method_lads.end()) {
-          unknown = true;
-          break;
+        for (auto m : scc_members[scc]) {
+          if (unknown_methods[m]) {
+            scc_result.unknown = true;
+          } else if (!scc_result.unknown) {
+            const auto& locations =
+                concurrent_method_lads.at(methods[m]).locations;
+            scc_result.locations.insert(locations.begin(), locations.end());
+          }
         }
-        const auto& other_locations = it->second.locations;
-        lads.locations.insert(other_locations.begin(), other_locations.end());
-      }
-      if (unknown || lads_locations_size < lads.locations.size()) {
-        // something changed
-        changed_methods.push_back(method);
-        if (unknown) {
-          method_lads.erase(method);
+        if (scc_result.unknown) {
+          scc_result.locations.clear();
         }
-      }
-    }
-
-    // Given set of changed methods, determine set of dependents for which
-    // we need to re-run the analysis in another iteration.
-    for (auto changed_method : changed_methods) {
-      auto idit = inverse_dependencies.find(changed_method);
-      if (idit == inverse_dependencies.end()) {
-        continue;
-      }
-
-      // remove inverse dependency entries as appropriate
-      auto& entries = idit->second;
-      for (auto it = entries.begin(); it != entries.end();) {
-        if (!method_lads.count(*it)) {
-          it = entries.erase(it);
-        } else {
-          it++;
+        for (auto dependent : scc_dependents[scc]) {
+          if (--pending[dependent] == 0) {
+            worker_state->push_task(dependent);
+          }
         }
-      }
-
-      if (entries.empty()) {
-        // remove inverse dependency
-        inverse_dependencies.erase(changed_method);
-      } else {
-        // add inverse dependencies entries to impacted methods
-        impacted_methods.insert(entries.begin(), entries.end());
-      }
+        return nullptr;
+      },
+      redex_parallel::default_num_threads(),
+      /* push_tasks_while_running */ true);
+  for (uint32_t scc = 0; scc < num_sccs; ++scc) {
+    if (scc_dependencies[scc].empty()) {
+      wq.add_item(scc);
     }
   }
+  wq.run_all();
 
   // For all methods which have a known set of locations at this point,
   // persist that information
-  for (auto& p : method_lads) {
-    result->emplace(p.first, p.second.locations);
+  size_t iterations = 0;
+  for (uint32_t scc = 0; scc < num_sccs; ++scc) {
+    const auto& scc_result = scc_results[scc];
+    iterations = std::max(iterations, scc_result.depth);
+    if (scc_result.unknown) {
+      continue;
+    }
+    for (auto m : scc_members[scc]) {
+      result->emplace(methods[m], scc_result.locations);
+    }
   }
 
   return iterations;
@@ -141,8 +141,10 @@ bool process_base_and_overriding_methods(
 // account all overriding methods.
 // When encountering unknown method implementations, the resulting map will have
 // no entry for the relevant (base) methods.
-// The return value indicates how many iterations the fixed-point computation
-// required.
+// The methods are processed bottom-up over the strongly connected components
+// of their dependencies, in parallel where the components are independent.
+// The return value indicates the length of the longest chain of components,
+// i.e. the number of rounds a fixed-point computation would have required.
 size_t compute_locations_closure(
     const Scope& scope,
     const method_override_graph::Graph* method_override_graph,
@@ -166,8 +168,6 @@ size_t compute_conditionally_pure_methods(
 // state and only call other methods which do not have side effects.
 // The return value indicates how many iterations the fixed-point computation
 // required.
-// The return value indicates how many iterations the fixed-point computation
-// required.
 size_t compute_no_side_effects_methods(
     const Scope& scope,
     const method_override_graph::Graph* method_override_graph,
@@ -246,10 +246,9 @@ void TransitiveClosureMarker::push(const Parent* parent, const DexClass* cls) {
     return;
   }
   record_reachability(parent, cls);
-  if (m_reachable_objects->marked(cls)) {
+  if (!m_reachable_objects->mark(cls)) {
     return;
   }
-  m_reachable_objects->mark(cls);
   m_worker_state->push_task(ReachableObject(cls));
 }
 
@@ -260,14 +259,13 @@ void TransitiveClosureMarker::push(const Parent* parent,
     return;
   }
   record_reachability(parent, field);
-  if (m_reachable_objects->marked(field)) {
+  if (!m_reachable_objects->mark(field)) {
     return;
   }
   auto f = field->as_def();
   if (f) {
     gather_and_push(f);
   }
-  m_reachable_objects->mark(field);
   m_worker_state->push_task(ReachableObject(field));
 }
 
@@ -278,10 +276,9 @@ void TransitiveClosureMarker::push(const Parent* parent,
     return;
   }
   record_reachability(parent, method);
-  if (m_reachable_objects->marked(method)) {
+  if (!m_reachable_objects->mark(method)) {
     return;
   }
-  m_reachable_objects->mark(method);
   m_worker_state->push_task(ReachableObject(method));
 }
 
@@ -486,7 +483,8 @@ void TransitiveClosureMarker::record_reachability(Parent* parent,
                                                   Object* object) {
   if (m_record_reachability) {
     redex_assert(parent != nullptr && object != nullptr);
-    m_reachable_objects->record_reachability(parent, object);
+    m_reachable_objects->record_reachability(m_worker_state->worker_id(),
+                                             parent, object);
   }
 }
 
@@ -517,6 +515,9 @@ std::unique_ptr<ReachableObjects> compute_reachable_objects(
 
   size_t num_threads = redex_parallel::default_num_threads();
   auto stats_arr = std::make_unique<Stats[]>(num_threads);
+  if (record_reachability) {
+    reachable_objects->init_retainer_logs(num_threads);
+  }
   auto work_queue = workqueue_foreach<ReachableObject>(
       [&](MarkWorkerState* worker_state, const ReachableObject& obj) {
         TransitiveClosureMarker transitive_closure_marker(
@@ -532,6 +533,9 @@ std::unique_ptr<ReachableObjects> compute_reachable_objects(
     work_queue.add_item(obj);
   }
   work_queue.run_all();
+  if (record_reachability) {
+    reachable_objects->resolve_retainers();
+  }
 
   if (num_ignore_check_strings != nullptr) {
     for (size_t i = 0; i < num_threads; ++i) {
@@ -546,43 +550,65 @@ std::unique_ptr<ReachableObjects> compute_reachable_objects(
   return reachable_objects;
 }
 
-void ReachableObjects::record_reachability(const DexMethodRef* member,
+void ReachableObjects::resolve_retainers() {
+  Timer t("Resolving retainers");
+  auto wq = workqueue_foreach<size_t>(
+      [&](size_t i) {
+        auto& edges = m_retainer_logs[i].edges;
+        for (const auto& edge : edges) {
+          m_retainers_of.update(
+              RetainerEdge::unpack(edge.object),
+              [&](const ReachableObject&, ReachableObjectSet& set,
+                  bool /* exists */) {
+                set.emplace(RetainerEdge::unpack(edge.parent));
+              });
+        }
+        std::vector<RetainerEdge>().swap(edges);
+      },
+      m_num_retainer_logs);
+  for (size_t i = 0; i < m_num_retainer_logs; ++i) {
+    wq.add_item(i);
+  }
+  wq.run_all();
+  m_retainer_logs.reset();
+  m_num_retainer_logs = 0;
+}
+
+void ReachableObjects::record_reachability(size_t worker,
+                                           const DexMethodRef* member,
                                            const DexClass* cls) {
   // Each class member trivially retains its containing class; let's filter out
   // this uninteresting information from our diagnostics.
   if (member->get_class() == cls->get_type()) {
     return;
   }
-  m_retainers_of.update(ReachableObject(cls),
-                        [&](const ReachableObject&, ReachableObjectSet& set,
-                            bool /* exists */) { set.emplace(member); });
+  record_edge(worker, ReachableObject(member), ReachableObject(cls));
 }
 
-void ReachableObjects::record_reachability(const DexFieldRef* member,
+void ReachableObjects::record_reachability(size_t worker,
+                                           const DexFieldRef* member,
                                            const DexClass* cls) {
   if (member->get_class() == cls->get_type()) {
     return;
   }
-  m_retainers_of.update(ReachableObject(cls),
-                        [&](const ReachableObject&, ReachableObjectSet& set,
-                            bool /* exists */) { set.emplace(member); });
+  record_edge(worker, ReachableObject(member), ReachableObject(cls));
 }
 
 template <class Object>
-void ReachableObjects::record_reachability(Object* parent, Object* object) {
+void ReachableObjects::record_reachability(size_t worker,
+                                           Object* parent,
+                                           Object* object) {
   if (parent == object) {
     return;
   }
-  m_retainers_of.update(ReachableObject(object),
-                        [&](const ReachableObject&, ReachableObjectSet& set,
-                            bool /* exists */) { set.emplace(parent); });
+  record_edge(worker, ReachableObject(parent), ReachableObject(object));
 }
 
 template <class Parent, class Object>
-void ReachableObjects::record_reachability(Parent* parent, Object* object) {
-  m_retainers_of.update(ReachableObject(object),
-                        [&](const ReachableObject&, ReachableObjectSet& set,
-                            bool /* exists */) { set.emplace(parent); });
+void ReachableObjects::record_reachability(size_t worker,
+                                           Parent* parent,
+                                           Object* object) {
+  record_edge(worker, ReachableObject(parent), ReachableObject(object));
 }
 
 template <class Seed>
@@ -668,13 +694,11 @@ ObjectCounts count_objects(const DexStoresVector& stores) {
 // Graph serialization helpers
 namespace {
 
-void write_reachable_object(std::ostream& os, const ReachableObject& obj) {
-  bs::write<uint8_t>(os, static_cast<uint8_t>(obj.type));
+std::pair<uint8_t, std::string> label_reachable_object(
+    const ReachableObject& obj) {
   std::ostringstream ss;
   ss << obj;
-  const auto& s = ss.str();
-  bs::write<uint32_t>(os, s.size());
-  os << s;
+  return {static_cast<uint8_t>(obj.type), ss.str()};
 }
 
 } // namespace
@@ -705,9 +729,8 @@ void dump_graph(std::ostream& os, const ReachableObjectGraph& retainers_of) {
     __builtin_unreachable();
   };
 
-  bs::write_header(os, /* version */ 1);
-  bs::GraphWriter<ReachableObject, ReachableObjectHash> gw(
-      write_reachable_object,
+  bs::CompactGraphWriter<ReachableObject, ReachableObjectHash> gw(
+      label_reachable_object,
       [&](const ReachableObject& obj) -> std::vector<ReachableObject> {
         if (!retainers_of.count(obj)) {
           return {};
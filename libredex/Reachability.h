@@ -7,9 +7,11 @@
 
 #pragma once
 
+#include <atomic>
 #include <unordered_map>
 #include <unordered_set>
 
+#include "AtomicBitVector.h"
 #include "ConcurrentContainers.h"
 #include "DexClass.h"
 #include "KeepReason.h"
@@ -89,63 +91,147 @@ using ReachableObjectSet =
 using ReachableObjectGraph =
     ConcurrentMap<ReachableObject, ReachableObjectSet, ReachableObjectHash>;
 
+/*
+ * An edge of the retainers graph, recorded while marking. Each end is a
+ * ReachableObject packed into a word: the objects are all word-aligned, so
+ * the low bits of the pointer are free to hold the type.
+ */
+struct RetainerEdge {
+  uintptr_t object;
+  uintptr_t parent;
+
+  static uintptr_t pack(const ReachableObject& obj) {
+    auto ptr = reinterpret_cast<uintptr_t>(obj.anno);
+    redex_assert((ptr & kTypeMask) == 0);
+    return ptr | static_cast<uintptr_t>(obj.type);
+  }
+
+  static ReachableObject unpack(uintptr_t packed) {
+    ReachableObject obj;
+    obj.type = static_cast<ReachableObjectType>(packed & kTypeMask);
+    obj.anno = reinterpret_cast<const DexAnnotation*>(packed & ~kTypeMask);
+    return obj;
+  }
+
+  static constexpr uintptr_t kTypeMask = 7;
+};
+
+/*
+ * The marked classes, fields and methods are bit vectors indexed by the dense
+ * ids of those objects, so marking is a single atomic test-and-set. They are
+ * sized for the objects that exist when this is constructed; no objects may be
+ * created while marking.
+ */
 class ReachableObjects {
  public:
+  ReachableObjects()
+      : m_marked_classes(g_redex->num_class_ids()),
+        m_marked_fields(g_redex->num_field_ids()),
+        m_marked_methods(g_redex->num_method_ids()) {}
+
   const ReachableObjectGraph& retainers_of() const { return m_retainers_of; }
 
-  void mark(const DexClass* cls) { m_marked_classes.insert(cls); }
+  // These return whether the object was not marked before.
+  bool mark(const DexClass* cls) {
+    return test_and_set(m_marked_classes, m_num_marked_classes, cls->id());
+  }
 
-  void mark(const DexMethodRef* method) { m_marked_methods.insert(method); }
+  bool mark(const DexMethodRef* method) {
+    return test_and_set(m_marked_methods, m_num_marked_methods, method->id());
+  }
 
-  void mark(const DexFieldRef* field) { m_marked_fields.insert(field); }
+  bool mark(const DexFieldRef* field) {
+    return test_and_set(m_marked_fields, m_num_marked_fields, field->id());
+  }
 
-  bool marked(const DexClass* cls) const { return m_marked_classes.count(cls); }
+  bool marked(const DexClass* cls) const {
+    return m_marked_classes.test(cls->id());
+  }
 
   bool marked(const DexMethodRef* method) const {
-    return m_marked_methods.count(method);
+    return m_marked_methods.test(method->id());
   }
 
   bool marked(const DexFieldRef* field) const {
-    return m_marked_fields.count(field);
+    return m_marked_fields.test(field->id());
   }
 
-  bool marked_unsafe(const DexClass* cls) const {
-    return m_marked_classes.count_unsafe(cls);
-  }
+  // Lookups never lock anymore; these remain for callers that used to avoid
+  // the locks.
+  bool marked_unsafe(const DexClass* cls) const { return marked(cls); }
 
   bool marked_unsafe(const DexMethodRef* method) const {
-    return m_marked_methods.count_unsafe(method);
+    return marked(method);
   }
 
-  bool marked_unsafe(const DexFieldRef* field) const {
-    return m_marked_fields.count_unsafe(field);
-  }
+  bool marked_unsafe(const DexFieldRef* field) const { return marked(field); }
 
-  size_t num_marked_classes() const { return m_marked_classes.size(); }
+  size_t num_marked_classes() const { return m_num_marked_classes.load(); }
 
-  size_t num_marked_fields() const { return m_marked_fields.size(); }
+  size_t num_marked_fields() const { return m_num_marked_fields.load(); }
 
-  size_t num_marked_methods() const { return m_marked_methods.size(); }
+  size_t num_marked_methods() const { return m_num_marked_methods.load(); }
+
+  // The workers of the transitive closure each append to their own log, so
+  // recording an edge takes no lock, and costs two words rather than a node
+  // of a set. resolve_retainers() then builds retainers_of from the logs.
+  void init_retainer_logs(size_t num_workers) {
+    m_retainer_logs = std::make_unique<RetainerLog[]>(num_workers);
+    m_num_retainer_logs = num_workers;
+  }
+
+  void resolve_retainers();
 
  private:
   template <class Seed>
   void record_is_seed(Seed* seed);
 
+  void record_edge(size_t worker,
+                   const ReachableObject& parent,
+                   const ReachableObject& object) {
+    m_retainer_logs[worker].edges.push_back(
+        {RetainerEdge::pack(object), RetainerEdge::pack(parent)});
+  }
+
   template <class Parent, class Object>
-  void record_reachability(Parent*, Object*);
+  void record_reachability(size_t worker, Parent*, Object*);
 
   template <class Object>
-  void record_reachability(Object* parent, Object* object);
+  void record_reachability(size_t worker, Object* parent, Object* object);
 
-  void record_reachability(const DexFieldRef* member, const DexClass* cls);
+  void record_reachability(size_t worker,
+                           const DexFieldRef* member,
+                           const DexClass* cls);
 
-  void record_reachability(const DexMethodRef* member, const DexClass* cls);
+  void record_reachability(size_t worker,
+                           const DexMethodRef* member,
+                           const DexClass* cls);
 
-  ConcurrentSet<const DexClass*> m_marked_classes;
-  ConcurrentSet<const DexFieldRef*> m_marked_fields;
-  ConcurrentSet<const DexMethodRef*> m_marked_methods;
+  static bool test_and_set(AtomicBitVector& bits,
+                           std::atomic<size_t>& count,
+                           uint32_t id) {
+    if (!bits.test_and_set(id)) {
+      return false;
+    }
+    count.fetch_add(1, std::memory_order_relaxed);
+    return true;
+  }
+
+  AtomicBitVector m_marked_classes;
+  AtomicBitVector m_marked_fields;
+  AtomicBitVector m_marked_methods;
+  std::atomic<size_t> m_num_marked_classes{0};
+  std::atomic<size_t> m_num_marked_fields{0};
+  std::atomic<size_t> m_num_marked_methods{0};
   ReachableObjectGraph m_retainers_of;
 
+  // Aligned to avoid false sharing between the workers.
+  struct alignas(CACHE_LINE_SIZE) RetainerLog {
+    std::vector<RetainerEdge> edges;
+  };
+  std::unique_ptr<RetainerLog[]> m_retainer_logs;
+  size_t m_num_retainer_logs{0};
+
   friend class RootSetMarker;
   friend class TransitiveClosureMarker;
 };
@@ -347,6 +433,11 @@ struct ObjectCounts {
  */
 ObjectCounts count_objects(const DexStoresVector& stores);
 
+/*
+ * Write the graph in the format of binary_serialization::CompactGraphWriter.
+ * Each object's successors are its retainers. tools/reachability-analysis can
+ * memory-map the result.
+ */
 void dump_graph(std::ostream& os, const ReachableObjectGraph& retainers_of);
 
 } // namespace reachability
@@ -21,6 +21,7 @@
 #include "StringUtil.h"
 #include "TypeSystem.h"
 #include "Walkers.h"
+#include "WorkQueue.h"
 
 namespace {
 
@@ -181,26 +182,61 @@ void analyze_reflection(const Scope& scope) {
     }
   };
 
+  // The types and names of the methods above, if they exist at all, so that
+  // the invokes are matched without looking at their strings.
+  std::unordered_map<const DexType*,
+                     std::unordered_map<const DexString*, ReflectionType>>
+      refl_index;
+  for (const auto& cls_entry : refls) {
+    auto* type = DexType::get_type(cls_entry.first);
+    if (type == nullptr) {
+      continue;
+    }
+    for (const auto& method_entry : cls_entry.second) {
+      auto* name = DexString::get_string(method_entry.first);
+      if (name != nullptr) {
+        refl_index[type].emplace(name, method_entry.second);
+      }
+    }
+  }
+  if (refl_index.empty()) {
+    return;
+  }
+
+  struct ReflectionSite {
+    ReflectionType refl_type;
+    DexType* cls;
+    DexString* name;
+    boost::optional<std::vector<DexType*>> param_types;
+  };
+
   reflection::MetadataCache refl_metadata_cache;
 
-  walk::code(scope, [&](DexMethod* method, IRCode& code) {
+  // The analysis of the methods runs in parallel. The members found are only
+  // marked afterwards, in the order of the scope, as marking isn't
+  // thread-safe.
+  std::vector<DexMethod*> methods;
+  walk::code(scope, [&](DexMethod* method, IRCode&) {
+    methods.push_back(method);
+  });
+  std::vector<std::vector<ReflectionSite>> sites(methods.size());
+  auto wq = workqueue_foreach<size_t>([&](size_t i) {
+    auto* method = methods[i];
     std::unique_ptr<ReflectionAnalysis> analysis = nullptr;
-    for (auto& mie : InstructionIterable(code)) {
+    for (auto& mie : InstructionIterable(method->get_code())) {
       IRInstruction* insn = mie.insn;
       if (!is_invoke(insn->opcode())) {
         continue;
       }
 
       // See if it matches something in refls
-      auto& method_name = insn->get_method()->get_name()->str();
-      auto& method_class_name =
-          insn->get_method()->get_class()->get_name()->str();
-      auto method_map = refls.find(method_class_name);
-      if (method_map == refls.end()) {
+      auto method_map = refl_index.find(insn->get_method()->get_class());
+      if (method_map == refl_index.end()) {
         continue;
       }
 
-      auto refl_entry = method_map->second.find(method_name);
+      auto refl_entry =
+          method_map->second.find(insn->get_method()->get_name());
       if (refl_entry == method_map->second.end()) {
         continue;
       }
@@ -234,36 +270,47 @@ void analyze_reflection(const Scope& scope) {
         param_types = analysis->get_method_params(insn);
       }
       TRACE(PGR, 4, "SRA ANALYZE: %s: type:%d %s.%s cls: %d %s %s str: %s",
-            insn->get_method()->get_name()->str().c_str(), refl_type,
-            method_class_name.c_str(), method_name.c_str(), arg_cls->obj_kind,
+            insn->get_method()->get_name()->c_str(), refl_type,
+            insn->get_method()->get_class()->get_name()->c_str(),
+            insn->get_method()->get_name()->c_str(), arg_cls->obj_kind,
             SHOW(arg_cls->dex_type), SHOW(arg_cls->dex_string),
             SHOW(arg_str_value));
+      sites[i].push_back(ReflectionSite{refl_type, arg_cls->dex_type,
+                                        arg_str_value, param_types});
+    }
+  });
+  for (size_t i = 0; i < methods.size(); ++i) {
+    wq.add_item(i);
+  }
+  wq.run_all();
 
-      switch (refl_type) {
+  for (size_t i = 0; i < methods.size(); ++i) {
+    auto* method = methods[i];
+    for (const auto& site : sites[i]) {
+      switch (site.refl_type) {
       case GET_FIELD:
-        blacklist_field(method, arg_cls->dex_type, arg_str_value, false);
+        blacklist_field(method, site.cls, site.name, false);
         break;
       case GET_DECLARED_FIELD:
-        blacklist_field(method, arg_cls->dex_type, arg_str_value, true);
+        blacklist_field(method, site.cls, site.name, true);
         break;
       case GET_METHOD:
       case GET_CONSTRUCTOR:
-        blacklist_method(method, arg_cls->dex_type, arg_str_value, param_types,
+        blacklist_method(method, site.cls, site.name, site.param_types,
                          false);
         break;
       case GET_DECLARED_METHOD:
       case GET_DECLARED_CONSTRUCTOR:
-        blacklist_method(method, arg_cls->dex_type, arg_str_value, param_types,
-                         true);
+        blacklist_method(method, site.cls, site.name, site.param_types, true);
         break;
       case INT_UPDATER:
       case LONG_UPDATER:
       case REF_UPDATER:
-        blacklist_field(method, arg_cls->dex_type, arg_str_value, true);
+        blacklist_field(method, site.cls, site.name, true);
         break;
       }
     }
-  });
+  }
 }
 
 /**
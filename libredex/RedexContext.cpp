@@ -17,6 +17,7 @@
 #include "DexCallSite.h"
 #include "DexClass.h"
 #include "DuplicateClasses.h"
+#include "Show.h"
 
 RedexContext* g_redex;
 
@@ -24,16 +25,18 @@ RedexContext::RedexContext(bool allow_class_duplicates)
     : m_allow_class_duplicates(allow_class_duplicates) {}
 
 RedexContext::~RedexContext() {
-  // Delete DexStrings.
+  // Destroy DexStrings. Their memory is owned by m_string_arena.
   for (auto const& p : s_string_map) {
-    delete p.second;
+    p.second->~DexString();
   }
   // Delete DexTypes.  NB: This table intentionally contains aliases (multiple
   // DexStrings map to the same DexType), so we have to dedup the set of types
   // before deleting to avoid double-frees.
   std::unordered_set<DexType*> delete_types;
   for (auto const& p : s_type_map) {
-    delete_types.emplace(p.second);
+    if (auto type = p.second.load()) {
+      delete_types.emplace(type);
+    }
   }
   for (auto const& t : delete_types) {
     delete t;
@@ -48,11 +51,11 @@ RedexContext::~RedexContext() {
   }
   // Delete DexProtos.
   for (auto const& p : s_proto_map) {
-    delete p.second;
+    delete p.second.load();
   }
   // Delete DexMethods.
   for (auto const& it : s_method_map) {
-    delete static_cast<DexMethod*>(it.second);
+    delete static_cast<DexMethod*>(it.second.load());
   }
   // Delete DexClasses.
   for (auto const& it : m_type_to_class) {
@@ -68,6 +71,13 @@ RedexContext::~RedexContext() {
   }
 }
 
+// For objects allocated in a ConcurrentArena, whose memory cannot be freed
+// individually.
+template <class T>
+struct ArenaDestructor {
+  void operator()(T* t) { t->~T(); }
+};
+
 /*
  * Try and insert (:key, :value) into :container. This insertion may fail if
  * another thread has already inserted that key. In that case, return the
@@ -92,6 +102,50 @@ static StoredValue* try_insert(Key key,
   return container->at(key);
 }
 
+/*
+ * Versions of the above for the lock-free InterningMaps, where an entry holding
+ * nullptr is considered absent.
+ */
+template <class Value, class Key, class Map>
+static Value* get_interned(const Map& map, const Key& key) {
+  auto slot = map.get(key);
+  return slot == nullptr ? nullptr : slot->load();
+}
+
+template <class InsertValue,
+          class StoredValue = InsertValue,
+          class Deleter = std::default_delete<InsertValue>,
+          class Key,
+          class Map>
+static StoredValue* try_intern(const Key& key, InsertValue* value, Map* map) {
+  std::unique_ptr<InsertValue, Deleter> to_insert(value);
+  auto res = map->emplace(key, to_insert.get());
+  if (res.second) {
+    return to_insert.release();
+  }
+  StoredValue* expected = nullptr;
+  if (res.first->compare_exchange_strong(expected, to_insert.get())) {
+    return to_insert.release();
+  }
+  return expected;
+}
+
+template <class StoredValue, class Key, class Map>
+static void set_interned(Map* map, const Key& key, StoredValue* value) {
+  auto res = map->emplace(key, value);
+  if (!res.second) {
+    res.first->store(value);
+  }
+}
+
+template <class Key, class Map>
+static void erase_interned(Map* map, const Key& key) {
+  auto slot = map->get(key);
+  if (slot != nullptr) {
+    slot->store(nullptr);
+  }
+}
+
 DexString* RedexContext::make_string(const char* nstr, uint32_t utfsize) {
   always_assert(nstr != nullptr);
   auto rv = s_string_map.get(nstr, nullptr);
@@ -102,8 +156,10 @@ DexString* RedexContext::make_string(const char* nstr, uint32_t utfsize) {
   // std::string. The c_str is valid until a the string is destroyed, or until a
   // non-const function is called on the string (but note the std::string itself
   // is const)
-  auto dexstring = new DexString(nstr, utfsize);
-  return try_insert(dexstring->c_str(), dexstring, &s_string_map);
+  auto dexstring = new (m_string_arena.allocate(sizeof(DexString)))
+      DexString(nstr, utfsize);
+  return try_insert<DexString, DexString, ArenaDestructor<DexString>>(
+      dexstring->c_str(), dexstring, &s_string_map);
 }
 
 DexString* RedexContext::get_string(const char* nstr, uint32_t utfsize) {
@@ -115,11 +171,11 @@ DexString* RedexContext::get_string(const char* nstr, uint32_t utfsize) {
 
 DexType* RedexContext::make_type(const DexString* dstring) {
   always_assert(dstring != nullptr);
-  auto rv = s_type_map.get(dstring, nullptr);
+  auto rv = get_interned<DexType>(s_type_map, dstring);
   if (rv != nullptr) {
     return rv;
   }
-  return try_insert(dstring, new DexType(const_cast<DexString*>(dstring)),
+  return try_intern(dstring, new DexType(const_cast<DexString*>(dstring)),
                     &s_type_map);
 }
 
@@ -127,23 +183,27 @@ DexType* RedexContext::get_type(const DexString* dstring) {
   if (dstring == nullptr) {
     return nullptr;
   }
-  return s_type_map.get(dstring, nullptr);
+  return get_interned<DexType>(s_type_map, dstring);
 }
 
 void RedexContext::set_type_name(DexType* type, DexString* new_name) {
+  drop_descriptor_index();
   alias_type_name(type, new_name);
   type->m_name = new_name;
 }
 
 void RedexContext::alias_type_name(DexType* type, DexString* new_name) {
   always_assert_log(
-      !s_type_map.count(new_name),
+      !get_interned<DexType>(s_type_map, new_name),
       "Bailing, attempting to alias a symbol that already exists! '%s'\n",
       new_name->c_str());
-  s_type_map.emplace(new_name, type);
+  set_interned(&s_type_map, new_name, type);
 }
 
-void RedexContext::remove_type_name(DexString* name) { s_type_map.erase(name); }
+void RedexContext::remove_type_name(DexString* name) {
+  drop_descriptor_index();
+  erase_interned(&s_type_map, name);
+}
 
 DexFieldRef* RedexContext::make_field(const DexType* container,
                                       const DexString* name,
@@ -175,6 +235,7 @@ DexFieldRef* RedexContext::get_field(const DexType* container,
 }
 
 void RedexContext::erase_field(DexFieldRef* field) {
+  drop_descriptor_index();
   s_field_map.erase(field->m_spec);
 }
 
@@ -182,7 +243,28 @@ void RedexContext::mutate_field(DexFieldRef* field,
                                 const DexFieldSpec& ref,
                                 bool rename_on_collision,
                                 bool update_deobfuscated_name) {
+  drop_descriptor_index();
+  std::lock_guard<std::mutex> lock(s_field_lock);
+  mutate_field_locked(field, ref, rename_on_collision,
+                      update_deobfuscated_name);
+}
+
+void RedexContext::mutate_fields(
+    const std::vector<std::pair<DexFieldRef*, DexFieldSpec>>& mutations,
+    bool rename_on_collision,
+    bool update_deobfuscated_name) {
+  drop_descriptor_index();
   std::lock_guard<std::mutex> lock(s_field_lock);
+  for (const auto& pair : mutations) {
+    mutate_field_locked(pair.first, pair.second, rename_on_collision,
+                        update_deobfuscated_name);
+  }
+}
+
+void RedexContext::mutate_field_locked(DexFieldRef* field,
+                                       const DexFieldSpec& ref,
+                                       bool rename_on_collision,
+                                       bool update_deobfuscated_name) {
   DexFieldSpec& r = field->m_spec;
   s_field_map.erase(r);
   r.cls = ref.cls != nullptr ? ref.cls : field->m_spec.cls;
@@ -227,11 +309,11 @@ DexProto* RedexContext::make_proto(const DexType* rtype,
                                    const DexString* shorty) {
   always_assert(rtype != nullptr && args != nullptr && shorty != nullptr);
   ProtoKey key(rtype, args);
-  auto rv = s_proto_map.get(key, nullptr);
+  auto rv = get_interned<DexProto>(s_proto_map, key);
   if (rv != nullptr) {
     return rv;
   }
-  return try_insert(key,
+  return try_intern(key,
                     new DexProto(const_cast<DexType*>(rtype),
                                  const_cast<DexTypeList*>(args),
                                  const_cast<DexString*>(shorty)),
@@ -243,7 +325,7 @@ DexProto* RedexContext::get_proto(const DexType* rtype,
   if (rtype == nullptr || args == nullptr) {
     return nullptr;
   }
-  return s_proto_map.get(ProtoKey(rtype, args), nullptr);
+  return get_interned<DexProto>(s_proto_map, ProtoKey(rtype, args));
 }
 
 DexMethodRef* RedexContext::make_method(const DexType* type_,
@@ -257,11 +339,11 @@ DexMethodRef* RedexContext::make_method(const DexType* type_,
   auto proto = const_cast<DexProto*>(proto_);
   always_assert(type != nullptr && name != nullptr && proto != nullptr);
   DexMethodSpec r(type, name, proto);
-  auto rv = s_method_map.get(r, nullptr);
+  auto rv = get_interned<DexMethodRef>(s_method_map, r);
   if (rv != nullptr) {
     return rv;
   }
-  return try_insert<DexMethod, DexMethodRef, DexMethod::Deleter>(
+  return try_intern<DexMethod, DexMethodRef, DexMethod::Deleter>(
       r, new DexMethod(type, name, proto), &s_method_map);
 }
 
@@ -273,11 +355,12 @@ DexMethodRef* RedexContext::get_method(const DexType* type,
   }
   DexMethodSpec r(const_cast<DexType*>(type), const_cast<DexString*>(name),
                   const_cast<DexProto*>(proto));
-  return s_method_map.get(r, nullptr);
+  return get_interned<DexMethodRef>(s_method_map, r);
 }
 
 void RedexContext::erase_method(DexMethodRef* method) {
-  s_method_map.erase(method->m_spec);
+  drop_descriptor_index();
+  erase_interned(&s_method_map, method->m_spec);
 }
 
 // TODO: Need a better interface.
@@ -285,16 +368,37 @@ void RedexContext::mutate_method(DexMethodRef* method,
                                  const DexMethodSpec& new_spec,
                                  bool rename_on_collision,
                                  bool update_deobfuscated_name) {
+  drop_descriptor_index();
   std::lock_guard<std::mutex> lock(s_method_lock);
+  mutate_method_locked(method, new_spec, rename_on_collision,
+                       update_deobfuscated_name);
+}
+
+void RedexContext::mutate_methods(
+    const std::vector<std::pair<DexMethodRef*, DexMethodSpec>>& mutations,
+    bool rename_on_collision,
+    bool update_deobfuscated_name) {
+  drop_descriptor_index();
+  std::lock_guard<std::mutex> lock(s_method_lock);
+  for (const auto& pair : mutations) {
+    mutate_method_locked(pair.first, pair.second, rename_on_collision,
+                         update_deobfuscated_name);
+  }
+}
+
+void RedexContext::mutate_method_locked(DexMethodRef* method,
+                                        const DexMethodSpec& new_spec,
+                                        bool rename_on_collision,
+                                        bool update_deobfuscated_name) {
   DexMethodSpec old_spec = method->m_spec;
-  s_method_map.erase(method->m_spec);
+  erase_interned(&s_method_map, method->m_spec);
 
   DexMethodSpec& r = method->m_spec;
   r.cls = new_spec.cls != nullptr ? new_spec.cls : method->m_spec.cls;
   r.name = new_spec.name != nullptr ? new_spec.name : method->m_spec.name;
   r.proto = new_spec.proto != nullptr ? new_spec.proto : method->m_spec.proto;
 
-  if (s_method_map.count(r) && rename_on_collision) {
+  if (get_interned<DexMethodRef>(s_method_map, r) && rename_on_collision) {
     // Never rename constructors, which causes runtime verification error:
     // "Method 42(Foo;.$init$$0) is marked constructor, but doesn't match name"
     always_assert_log(
@@ -321,7 +425,7 @@ void RedexContext::mutate_method(DexMethodRef* method,
       }
       do {
         r.name = DexString::make_string((prefix + std::to_string(i++)).c_str());
-      } while (s_method_map.count(r));
+      } while (get_interned<DexMethodRef>(s_method_map, r));
     } else {
       // We are about to change its class. Use a better name to remember its
       // original source class on a collision. Tokenize the class name into
@@ -348,7 +452,7 @@ void RedexContext::mutate_method(DexMethodRef* method,
       for (auto part = parts.rbegin(); part != parts.rend(); ++part) {
         ss << "$" << *part;
         r.name = DexString::make_string(ss.str());
-        if (!s_method_map.count(r)) {
+        if (!get_interned<DexMethodRef>(s_method_map, r)) {
           break;
         }
       }
@@ -356,14 +460,13 @@ void RedexContext::mutate_method(DexMethodRef* method,
   }
 
   // We might still miss name collision cases. As of now, let's just assert.
-  if (s_method_map.count(r)) {
-    auto& m = *s_method_map.find(r)->second;
-    always_assert_log(!s_method_map.count(r),
+  if (get_interned<DexMethodRef>(s_method_map, r)) {
+    always_assert_log(!get_interned<DexMethodRef>(s_method_map, r),
                       "Another method of the same signature already exists %s"
                       " %s %s",
                       SHOW(r.cls), SHOW(r.name), SHOW(r.proto));
   }
-  s_method_map.emplace(r, method);
+  set_interned(&s_method_map, r, method);
 
   // We just updated DexMethodSpec, which will update this method's name.
   // But we also need to update deobfuscated names properly, except for the
@@ -379,14 +482,52 @@ void RedexContext::mutate_method(DexMethodRef* method,
 // Return false on unique classes
 // Return true on benign duplicate classes
 // Throw RedexException on problematic duplicate classes
+void RedexContext::build_descriptor_index() {
+  auto index = std::make_shared<DescriptorIndex>();
+  for (auto const& it : s_method_map) {
+    if (auto method = it.second.load()) {
+      index->methods.emplace(show(method), method);
+    }
+  }
+  for (auto const& it : s_field_map) {
+    index->fields.emplace(show(it.second), it.second);
+  }
+  std::atomic_store(&m_descriptor_index,
+                    std::shared_ptr<const DescriptorIndex>(std::move(index)));
+  m_has_descriptor_index = true;
+}
+
+DexMethodRef* RedexContext::find_indexed_method(const std::string& descriptor) {
+  if (!m_has_descriptor_index.load(std::memory_order_relaxed)) {
+    return nullptr;
+  }
+  auto index = std::atomic_load(&m_descriptor_index);
+  if (index == nullptr) {
+    return nullptr;
+  }
+  auto it = index->methods.find(descriptor);
+  return it == index->methods.end() ? nullptr : it->second;
+}
+
+DexFieldRef* RedexContext::find_indexed_field(const std::string& descriptor) {
+  if (!m_has_descriptor_index.load(std::memory_order_relaxed)) {
+    return nullptr;
+  }
+  auto index = std::atomic_load(&m_descriptor_index);
+  if (index == nullptr) {
+    return nullptr;
+  }
+  auto it = index->fields.find(descriptor);
+  return it == index->fields.end() ? nullptr : it->second;
+}
+
 bool RedexContext::class_already_loaded(DexClass* cls) {
-  std::lock_guard<std::mutex> l(m_type_system_mutex);
   const DexType* type = cls->get_type();
-  const auto& it = m_type_to_class.find(type);
-  if (it == m_type_to_class.end()) {
+  auto prev = m_type_to_class.get(type);
+  if (prev == nullptr) {
     return false;
   } else {
-    const auto& prev_loc = it->second->get_location();
+    const auto& prev_loc = (*prev)->get_location();
     const auto& cur_loc = cls->get_location();
     if (prev_loc == cur_loc || dup_classes::is_known_dup(cls)) {
       // benign duplicates
@@ -413,19 +554,19 @@ bool RedexContext::class_already_loaded(DexClass* cls) {
 }
 
 void RedexContext::publish_class(DexClass* cls) {
-  std::lock_guard<std::mutex> l(m_type_system_mutex);
   const DexType* type = cls->get_type();
   const auto& pair = m_type_to_class.emplace(type, cls);
   bool insertion_took_place = pair.second;
   always_assert(insertion_took_place);
   if (cls->is_external()) {
+    std::lock_guard<std::mutex> l(m_external_classes_mutex);
     m_external_classes.emplace_back(cls);
   }
 }
 
 DexClass* RedexContext::type_class(const DexType* t) {
-  auto it = m_type_to_class.find(t);
-  return it != m_type_to_class.end() ? it->second : nullptr;
+  auto cls = m_type_to_class.get(t);
+  return cls != nullptr ? *cls : nullptr;
 }
 
 void run_rethrow_first_aggregate(const std::function<void()>& f) {
@@ -8,21 +8,26 @@
 #pragma once
 
 #include <array>
+#include <atomic>
 #include <boost/functional/hash.hpp>
 #include <cstring>
 #include <deque>
 #include <functional>
 #include <list>
 #include <map>
+#include <memory>
 #include <mutex>
 #include <sstream>
+#include <string>
 #include <unordered_map>
 #include <vector>
 
+#include "ConcurrentArena.h"
 #include "ConcurrentContainers.h"
 #include "DexMemberRefs.h"
 #include "FrequentlyUsedPointersCache.h"
 #include "KeepReason.h"
+#include "StrcmpLess.h"
 
 class DexCallSite;
 class DexDebugInstruction;
@@ -41,10 +46,6 @@ struct RedexContext;
 
 extern RedexContext* g_redex;
 
-#if defined(__SSE4_2__) && defined(__linux__) && defined(__STRCMP_LESS__)
-extern "C" bool strcmp_less(const char* str1, const char* str2);
-#endif
-
 struct RedexContext {
   explicit RedexContext(bool allow_class_duplicates = false);
   ~RedexContext();
@@ -80,6 +81,11 @@ struct RedexContext {
                     const DexFieldSpec& ref,
                     bool rename_on_collision,
                     bool update_deobfuscated_name);
+  // Applies the mutations in order, taking the field lock only once.
+  void mutate_fields(
+      const std::vector<std::pair<DexFieldRef*, DexFieldSpec>>& mutations,
+      bool rename_on_collision,
+      bool update_deobfuscated_name);
 
   DexTypeList* make_type_list(std::deque<DexType*>&& p);
   DexTypeList* get_type_list(std::deque<DexType*>&& p);
@@ -104,6 +110,26 @@ struct RedexContext {
                      const DexMethodSpec& new_spec,
                      bool rename_on_collision,
                      bool update_deobfuscated_name);
+  // Applies the mutations in order, taking the method lock only once.
+  void mutate_methods(
+      const std::vector<std::pair<DexMethodRef*, DexMethodSpec>>& mutations,
+      bool rename_on_collision,
+      bool update_deobfuscated_name);
+
+  /*
+   * Indexes all the methods and fields by their full descriptors, e.g.
+   * "LFoo;.bar:(I)V", so that DexMethod::get_method and DexField::get_field
+   * find them with a single lookup instead of parsing the descriptor and
+   * interning each of its parts. This is meant to be built once after
+   * loading, for the config and profile lookups that follow. Renaming or
+   * erasing any member or type drops the index for good, as it would go
+   * stale; the lookups then take the slow path again.
+   */
+  void build_descriptor_index();
+  // Return the indexed member, or nullptr if it isn't indexed, e.g. because
+  // it was created after the index, or there is no index.
+  DexMethodRef* find_indexed_method(const std::string& descriptor);
+  DexFieldRef* find_indexed_field(const std::string& descriptor);
 
   DexDebugEntry* make_dbg_entry(DexDebugInstruction* opcode);
   DexDebugEntry* make_dbg_entry(DexPosition* pos);
@@ -153,6 +179,16 @@ struct RedexContext {
 
   FrequentlyUsedPointers pointers_cache() { return m_pointers_cache; }
 
+  // Every DexClass, DexFieldRef and DexMethodRef gets the next id of its kind
+  // when it is constructed. Ids are never reused, so the counts bound all ids
+  // handed out so far.
+  uint32_t next_class_id() { return m_num_class_ids.fetch_add(1); }
+  uint32_t next_field_id() { return m_num_field_ids.fetch_add(1); }
+  uint32_t next_method_id() { return m_num_method_ids.fetch_add(1); }
+  size_t num_class_ids() const { return m_num_class_ids.load(); }
+  size_t num_field_ids() const { return m_num_field_ids.load(); }
+  size_t num_method_ids() const { return m_num_method_ids.load(); }
+
  private:
   struct Strcmp;
   struct TruncatedStringHash;
@@ -177,11 +213,7 @@ struct RedexContext {
 
   struct Strcmp {
     bool operator()(const char* a, const char* b) const {
-#if defined(__SSE4_2__) && defined(__linux__) && defined(__STRCMP_LESS__)
       return strcmp_less(a, b);
-#else
-      return strcmp(a, b) < 0;
-#endif
     }
   };
 
@@ -202,15 +234,29 @@ struct RedexContext {
     }
   };
 
-  // DexString
+  // DexString. The DexString objects themselves are allocated in the arena,
+  // saving an individual heap allocation for each of the millions of strings.
   ConcurrentLargeStringMap<DexString*> s_string_map;
+  ConcurrentArena m_string_arena;
+
+  // The interning tables below are lock-free, as they are hammered from all
+  // threads during loading and in many passes. Entries can never be removed
+  // from those maps; instead, erasing an entry resets its value to nullptr.
+  template <typename Key, typename Value, typename Hash = std::hash<Key>>
+  using InterningMap =
+      InsertOnlyConcurrentMap<Key, std::atomic<Value*>, Hash>;
 
   // DexType
-  ConcurrentMap<const DexString*, DexType*> s_type_map;
+  InterningMap<const DexString*, DexType> s_type_map;
 
   // DexFieldRef
   ConcurrentMap<DexFieldSpec, DexFieldRef*> s_field_map;
   std::mutex s_field_lock;
+  // Requires s_field_lock to be held.
+  void mutate_field_locked(DexFieldRef* field,
+                           const DexFieldSpec& ref,
+                           bool rename_on_collision,
+                           bool update_deobfuscated_name);
 
   // DexTypeList
   ConcurrentMap<std::deque<DexType*>,
@@ -220,15 +266,38 @@ struct RedexContext {
 
   // DexProto
   using ProtoKey = std::pair<const DexType*, const DexTypeList*>;
-  ConcurrentMap<ProtoKey, DexProto*, boost::hash<ProtoKey>> s_proto_map;
+  InterningMap<ProtoKey, DexProto, boost::hash<ProtoKey>> s_proto_map;
 
   // DexMethod
-  ConcurrentMap<DexMethodSpec, DexMethodRef*> s_method_map;
+  InterningMap<DexMethodSpec, DexMethodRef> s_method_map;
   std::mutex s_method_lock;
+  // Requires s_method_lock to be held.
+  void mutate_method_locked(DexMethodRef* method,
+                            const DexMethodSpec& new_spec,
+                            bool rename_on_collision,
+                            bool update_deobfuscated_name);
+
+  struct DescriptorIndex {
+    std::unordered_map<std::string, DexMethodRef*> methods;
+    std::unordered_map<std::string, DexFieldRef*> fields;
+  };
+  // Read with std::atomic_load, as a mutation may drop it concurrently.
+  std::shared_ptr<const DescriptorIndex> m_descriptor_index;
+  // Whether there is an index to drop, so that mutations don't have to touch
+  // the shared pointer.
+  std::atomic<bool> m_has_descriptor_index{false};
+  void drop_descriptor_index() {
+    if (m_has_descriptor_index.load(std::memory_order_relaxed)) {
+      m_has_descriptor_index = false;
+      std::atomic_store(&m_descriptor_index,
+                        std::shared_ptr<const DescriptorIndex>());
+    }
+  }
 
-  // Type-to-class map
-  std::mutex m_type_system_mutex;
-  std::unordered_map<const DexType*, DexClass*> m_type_to_class;
+  // Type-to-class map. Classes of a dex are published from all loading
+  // threads, and are never unpublished, so this doesn't need a lock.
+  InsertOnlyConcurrentMap<const DexType*, DexClass*> m_type_to_class;
+  std::mutex m_external_classes_mutex;
   std::vector<DexClass*> m_external_classes;
 
   const std::vector<const DexType*> m_empty_types;
@@ -246,6 +315,10 @@ struct RedexContext {
   bool m_allow_class_duplicates;
 
   FrequentlyUsedPointers m_pointers_cache;
+
+  std::atomic<uint32_t> m_num_class_ids{0};
+  std::atomic<uint32_t> m_num_field_ids{0};
+  std::atomic<uint32_t> m_num_method_ids{0};
 };
 
 // One or more exceptions
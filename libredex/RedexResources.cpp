@@ -10,8 +10,11 @@
 #include <boost/algorithm/string.hpp>
 #include <boost/algorithm/string/predicate.hpp>
 #include <boost/filesystem.hpp>
+#include <boost/iostreams/device/mapped_file.hpp>
 #include <boost/optional.hpp>
 #include <boost/regex.hpp>
+#include <atomic>
+#include <cstddef>
 #include <cstdio>
 #include <cstdlib>
 #include <fcntl.h>
@@ -45,8 +48,12 @@
 #include "utils/TypeHelpers.h"
 #include <json/json.h>
 
+// Sparta uses assert, which Debug.h undefines.
+#include "WorkQueue.h"
+
 #include "Debug.h"
 #include "StringUtil.h"
+#include "ZipReader.h"
 
 constexpr size_t MIN_CLASSNAME_LENGTH = 10;
 constexpr size_t MAX_CLASSNAME_LENGTH = 500;
@@ -215,9 +222,9 @@ std::unordered_set<std::string> extract_js_resources(
 }
 
 std::unordered_set<uint32_t> extract_xml_reference_attributes(
-    const std::string& file_contents, const std::string& filename) {
+    const char* data, size_t size, const std::string& filename) {
   android::ResXMLTree parser;
-  parser.setTo(file_contents.data(), file_contents.size());
+  parser.setTo(data, size);
   std::unordered_set<uint32_t> result;
   if (parser.getError() != android::NO_ERROR) {
     throw std::runtime_error("Unable to read file: " + filename);
@@ -472,13 +479,14 @@ std::string read_attribute_name_at_idx(const android::ResXMLTree& parser,
 }
 
 void extract_classes_from_layout(
-    const std::string& layout_contents,
+    const char* data,
+    size_t size,
     const std::unordered_set<std::string>& attributes_to_read,
     std::unordered_set<std::string>& out_classes,
     std::unordered_multimap<std::string, std::string>& out_attributes) {
 
   android::ResXMLTree parser;
-  parser.setTo(layout_contents.data(), layout_contents.size());
+  parser.setTo(data, size);
 
   android::String16 name("name");
   android::String16 klazz("class");
@@ -605,6 +613,67 @@ std::string read_entire_file(const std::string& filename) {
   return sstr.str();
 }
 
+namespace {
+
+/*
+ * Maps a file for reading, to parse it in place. The file is left unmapped
+ * if it is empty or can't be opened, as read_entire_file would return an
+ * empty string.
+ */
+class ReadOnlyMappedFile {
+ public:
+  explicit ReadOnlyMappedFile(const std::string& filename) {
+    boost::system::error_code ec;
+    if (boost::filesystem::file_size(filename, ec) == 0 || ec) {
+      return;
+    }
+    try {
+      m_file.open(filename);
+    } catch (const std::exception&) {
+    }
+  }
+
+  const char* data() const { return m_file.is_open() ? m_file.data() : ""; }
+
+  size_t size() const { return m_file.is_open() ? m_file.size() : 0; }
+
+ private:
+  boost::iostreams::mapped_file_source m_file;
+};
+
+/*
+ * Maps a file for reading and writing, to patch it in place. The changes are
+ * written back to the file when it is unmapped.
+ */
+class WritableMappedFile {
+ public:
+  explicit WritableMappedFile(const std::string& filename) {
+    boost::system::error_code ec;
+    if (boost::filesystem::file_size(filename, ec) == 0 || ec) {
+      fprintf(stderr, "Unable to read file: %s\n", filename.data());
+      throw std::runtime_error("Unable to read file: " + filename);
+    }
+    m_data = map_file(filename.c_str(), &m_file_descriptor, &m_size,
+                      /* mode_write */ true);
+  }
+
+  WritableMappedFile(const WritableMappedFile&) = delete;
+  WritableMappedFile& operator=(const WritableMappedFile&) = delete;
+
+  ~WritableMappedFile() { unmap_and_close(m_file_descriptor, m_data, m_size); }
+
+  void* data() const { return m_data; }
+
+  size_t size() const { return m_size; }
+
+ private:
+  int m_file_descriptor;
+  void* m_data;
+  size_t m_size;
+};
+
+} // namespace
+
 void write_entire_file(const std::string& filename,
                        const std::string& contents) {
   std::ofstream out(filename, std::ofstream::binary);
@@ -663,6 +732,17 @@ ManifestClassInfo get_manifest_class_info(const std::string& filename) {
   return classes;
 }
 
+ManifestClassInfo get_manifest_class_info(const ZipReader& apk) {
+  auto entry = apk.find_entry("AndroidManifest.xml");
+  ManifestClassInfo classes;
+  if (entry != nullptr && entry->ucomp_size != 0) {
+    classes = extract_classes_from_manifest(apk.read_entry(*entry));
+  } else {
+    fprintf(stderr, "Unable to read manifest file in the APK\n");
+  }
+  return classes;
+}
+
 std::unordered_set<std::string> get_files_by_suffix(
     const std::string& directory, const std::string& suffix) {
   std::unordered_set<std::string> files;
@@ -827,9 +907,11 @@ std::unordered_set<uint32_t> get_xml_reference_attributes(
     std::unordered_set<uint32_t> empty;
     return empty;
   }
-  std::string file_contents = read_entire_file(filename);
-  ensure_file_contents(file_contents, filename);
-  return extract_xml_reference_attributes(file_contents, filename);
+  ReadOnlyMappedFile file(filename);
+  if (file.size() == 0) {
+    throw std::runtime_error("Unable to read file: " + filename);
+  }
+  return extract_xml_reference_attributes(file.data(), file.size(), filename);
 }
 
 bool is_drawable_attribute(android::ResXMLTree& parser, size_t attr_index) {
@@ -859,12 +941,10 @@ int inline_xml_reference_attributes(
     const std::string& filename,
     const std::map<uint32_t, android::Res_value>& id_to_inline_value) {
   int num_values_inlined = 0;
-  std::string file_contents = read_entire_file(filename);
-  ensure_file_contents(file_contents, filename);
-  bool made_change = false;
-
+  // The values have a fixed size, so the file is patched in place.
+  WritableMappedFile file(filename);
   android::ResXMLTree parser;
-  parser.setTo(file_contents.data(), file_contents.size());
+  parser.setTo(file.data(), file.size());
   if (parser.getError() != android::NO_ERROR) {
     throw std::runtime_error("Unable to read file: " + filename);
   }
@@ -894,7 +974,6 @@ int inline_xml_reference_attributes(
             android::Res_value new_value = p->second;
             parser.setAttribute(i, new_value);
             ++num_values_inlined;
-            made_change = true;
           }
         }
       }
@@ -902,10 +981,21 @@ int inline_xml_reference_attributes(
   } while (type != android::ResXMLParser::BAD_DOCUMENT &&
            type != android::ResXMLParser::END_DOCUMENT);
 
-  if (made_change) {
-    write_entire_file(filename, file_contents);
-  }
+  return num_values_inlined;
+}
 
+int inline_xml_reference_attributes(
+    const std::vector<std::string>& filenames,
+    const std::map<uint32_t, android::Res_value>& id_to_inline_value) {
+  std::atomic<int> num_values_inlined{0};
+  auto wq = workqueue_foreach<std::string>([&](const std::string& filename) {
+    num_values_inlined +=
+        inline_xml_reference_attributes(filename, id_to_inline_value);
+  });
+  for (const auto& filename : filenames) {
+    wq.add_item(filename);
+  }
+  wq.run_all();
   return num_values_inlined;
 }
 
@@ -915,12 +1005,10 @@ void remap_xml_reference_attributes(
   if (is_raw_resource(filename)) {
     return;
   }
-  std::string file_contents = read_entire_file(filename);
-  ensure_file_contents(file_contents, filename);
-  bool made_change = false;
-
+  // The ids have a fixed size, so the file is patched in place.
+  WritableMappedFile file(filename);
   android::ResXMLTree parser;
-  parser.setTo(file_contents.data(), file_contents.size());
+  parser.setTo(file.data(), file.size());
   if (parser.getError() != android::NO_ERROR) {
     throw std::runtime_error("Unable to read file: " + filename);
   }
@@ -932,7 +1020,6 @@ void remap_xml_reference_attributes(
     auto id_search = kept_to_remapped_ids.find(resourceIds[i]);
     if (id_search != kept_to_remapped_ids.end()) {
       resourceIds[i] = id_search->second;
-      made_change = true;
     }
   }
 
@@ -953,7 +1040,6 @@ void remap_xml_reference_attributes(
             uint32_t new_value = kept_to_remapped_ids.at(outValue.data);
             if (new_value != outValue.data) {
               parser.setAttributeData(i, new_value);
-              made_change = true;
             }
           }
         }
@@ -961,10 +1047,18 @@ void remap_xml_reference_attributes(
     }
   } while (type != android::ResXMLParser::BAD_DOCUMENT &&
            type != android::ResXMLParser::END_DOCUMENT);
+}
 
-  if (made_change) {
-    write_entire_file(filename, file_contents);
+void remap_xml_reference_attributes(
+    const std::vector<std::string>& filenames,
+    const std::map<uint32_t, uint32_t>& kept_to_remapped_ids) {
+  auto wq = workqueue_foreach<std::string>([&](const std::string& filename) {
+    remap_xml_reference_attributes(filename, kept_to_remapped_ids);
+  });
+  for (const auto& filename : filenames) {
+    wq.add_item(filename);
   }
+  wq.run_all();
 }
 
 std::vector<std::string> find_layout_files(const std::string& apk_directory) {
@@ -1000,9 +1094,9 @@ void collect_layout_classes_and_attributes_for_file(
     const std::unordered_set<std::string>& attributes_to_read,
     std::unordered_set<std::string>& out_classes,
     std::unordered_multimap<std::string, std::string>& out_attributes) {
-  std::string contents = read_entire_file(file_path);
-  extract_classes_from_layout(contents, attributes_to_read, out_classes,
-                              out_attributes);
+  ReadOnlyMappedFile file(file_path);
+  extract_classes_from_layout(file.data(), file.size(), attributes_to_read,
+                              out_classes, out_attributes);
 }
 
 void collect_layout_classes_and_attributes(
@@ -1011,9 +1105,72 @@ void collect_layout_classes_and_attributes(
     std::unordered_set<std::string>& out_classes,
     std::unordered_multimap<std::string, std::string>& out_attributes) {
   std::vector<std::string> files = find_layout_files(apk_directory);
-  for (const auto& layout_file : files) {
+  // The layouts are parsed in parallel, and their classes and attributes
+  // merged in the order of their paths.
+  std::sort(files.begin(), files.end());
+  struct LayoutInfo {
+    std::unordered_set<std::string> classes;
+    std::unordered_multimap<std::string, std::string> attributes;
+  };
+  std::vector<LayoutInfo> infos(files.size());
+  auto wq = workqueue_foreach<size_t>([&](size_t i) {
     collect_layout_classes_and_attributes_for_file(
-        layout_file, attributes_to_read, out_classes, out_attributes);
+        files[i], attributes_to_read, infos[i].classes, infos[i].attributes);
+  });
+  for (size_t i = 0; i < files.size(); i++) {
+    wq.add_item(i);
+  }
+  wq.run_all();
+  for (auto& info : infos) {
+    out_classes.insert(info.classes.begin(), info.classes.end());
+    out_attributes.insert(info.attributes.begin(), info.attributes.end());
+  }
+}
+
+void collect_layout_classes_and_attributes(
+    const ZipReader& apk,
+    const std::unordered_set<std::string>& attributes_to_read,
+    std::unordered_set<std::string>& out_classes,
+    std::unordered_multimap<std::string, std::string>& out_attributes) {
+  // The files directly in the res/layout* directories, like
+  // find_layout_files().
+  std::vector<const ZipReader::Entry*> entries;
+  for (const auto& entry : apk.entries()) {
+    const auto& name = entry.name;
+    if (starts_with(name.c_str(), "res/layout") &&
+        name.find('/') == 3 && name.find('/', 4) == name.rfind('/') &&
+        name.back() != '/') {
+      entries.push_back(&entry);
+    }
+  }
+  std::sort(entries.begin(), entries.end(),
+            [](const ZipReader::Entry* a, const ZipReader::Entry* b) {
+              return a->name < b->name;
+            });
+  struct LayoutInfo {
+    std::unordered_set<std::string> classes;
+    std::unordered_multimap<std::string, std::string> attributes;
+  };
+  std::vector<LayoutInfo> infos(entries.size());
+  auto wq = workqueue_foreach<size_t>([&](size_t i) {
+    const auto& entry = *entries[i];
+    auto data = apk.get_stored_contents(entry);
+    std::string inflated;
+    if (data == nullptr) {
+      inflated = apk.read_entry(entry);
+      data = reinterpret_cast<const uint8_t*>(inflated.data());
+    }
+    extract_classes_from_layout(reinterpret_cast<const char*>(data),
+                                entry.ucomp_size, attributes_to_read,
+                                infos[i].classes, infos[i].attributes);
+  });
+  for (size_t i = 0; i < entries.size(); i++) {
+    wq.add_item(i);
+  }
+  wq.run_all();
+  for (auto& info : infos) {
+    out_classes.insert(info.classes.begin(), info.classes.end());
+    out_attributes.insert(info.attributes.begin(), info.attributes.end());
   }
 }
 
@@ -1337,3 +1494,224 @@ ResourcesArscFile::~ResourcesArscFile() {
     unmap_and_close(m_arsc_fd, m_arsc_ptr, m_arsc_len);
   }
 }
+
+namespace {
+
+// Returns the chunk which starts at `begin`, after checking that it fits
+// before `end`.
+const android::ResChunk_header* get_chunk(const char* begin, const char* end) {
+  always_assert_log(begin + sizeof(android::ResChunk_header) <= end,
+                    "Truncated arsc chunk");
+  auto chunk = reinterpret_cast<const android::ResChunk_header*>(begin);
+  size_t header_size = dtohs(chunk->headerSize);
+  size_t size = dtohl(chunk->size);
+  always_assert_log(header_size >= sizeof(android::ResChunk_header) &&
+                        header_size <= size &&
+                        size <= static_cast<size_t>(end - begin),
+                    "Malformed arsc chunk of type 0x%x",
+                    dtohs(chunk->type));
+  return chunk;
+}
+
+// The key string index of the given entry of the type chunk, if the chunk has
+// a value for it.
+boost::optional<uint32_t> get_key_index(const android::ResTable_type* type,
+                                        uint32_t entry_id) {
+  if (entry_id >= dtohl(type->entryCount)) {
+    return boost::none;
+  }
+  auto base = reinterpret_cast<const char*>(type);
+  auto offsets = reinterpret_cast<const uint32_t*>(
+      base + dtohs(type->header.headerSize));
+  uint32_t offset = dtohl(offsets[entry_id]);
+  if (offset == android::ResTable_type::NO_ENTRY) {
+    return boost::none;
+  }
+  size_t entry_start = static_cast<size_t>(dtohl(type->entriesStart)) + offset;
+  always_assert_log(entry_start + sizeof(android::ResTable_entry) <=
+                        dtohl(type->header.size),
+                    "Malformed arsc entry 0x%x of type %u", entry_id,
+                    type->id);
+  auto entry = reinterpret_cast<const android::ResTable_entry*>(
+      base + entry_start);
+  return dtohl(entry->key.index);
+}
+
+boost::optional<std::string> get_pool_string(
+    const android::ResStringPool& pool, uint32_t index) {
+  size_t len;
+  if (pool.isUTF8()) {
+    auto str = pool.string8At(index, &len);
+    if (str != nullptr) {
+      return std::string(str, len);
+    }
+  } else {
+    auto str = pool.stringAt(index, &len);
+    if (str != nullptr) {
+      return std::string(android::String8(str, len).string());
+    }
+  }
+  return boost::none;
+}
+
+} // namespace
+
+ResourcesArscView::ResourcesArscView(const std::string& path) {
+  m_arsc_ptr = map_file(path.c_str(), &m_arsc_fd, &m_arsc_len, false);
+  index_table(static_cast<const char*>(m_arsc_ptr), m_arsc_len, path);
+}
+
+ResourcesArscView::ResourcesArscView(const ZipReader& apk) {
+  auto entry = apk.find_entry("resources.arsc");
+  always_assert_log(entry != nullptr, "No resources.arsc in the APK");
+  auto data = apk.get_stored_contents(*entry);
+  // The chunks are read in place, so they must be aligned, which zipalign
+  // ensures for stored entries.
+  if (data == nullptr || reinterpret_cast<uintptr_t>(data) % 4 != 0) {
+    m_inflated = std::make_unique<uint32_t[]>(entry->ucomp_size / 4 + 1);
+    auto buffer = reinterpret_cast<uint8_t*>(m_inflated.get());
+    always_assert_log(apk.read_entry(*entry, buffer),
+                      "Cannot read resources.arsc in the APK");
+    data = buffer;
+  }
+  index_table(reinterpret_cast<const char*>(data), entry->ucomp_size,
+              entry->name);
+}
+
+void ResourcesArscView::index_table(const char* begin,
+                                    size_t size,
+                                    const std::string& name) {
+  auto table = get_chunk(begin, begin + size);
+  always_assert_log(dtohs(table->type) == android::RES_TABLE_TYPE &&
+                        dtohs(table->headerSize) >=
+                            sizeof(android::ResTable_header),
+                    "Not a resources.arsc file: %s", name.c_str());
+  auto table_end = begin + dtohl(table->size);
+  for (auto it = begin + dtohs(table->headerSize); it < table_end;) {
+    auto chunk = get_chunk(it, table_end);
+    if (dtohs(chunk->type) == android::RES_TABLE_PACKAGE_TYPE) {
+      index_package(reinterpret_cast<const android::ResTable_package*>(chunk));
+    }
+    it += dtohl(chunk->size);
+  }
+}
+
+void ResourcesArscView::index_package(
+    const android::ResTable_package* package) {
+  // Older files don't have the typeIdOffset field.
+  always_assert_log(dtohs(package->header.headerSize) >=
+                        offsetof(android::ResTable_package, typeIdOffset),
+                    "Malformed arsc package header");
+  auto begin = reinterpret_cast<const char*>(package);
+  size_t size = dtohl(package->header.size);
+  size_t key_strings = dtohl(package->keyStrings);
+  always_assert_log(key_strings < size, "Malformed arsc package 0x%x",
+                    dtohl(package->id));
+
+  Package indexed;
+  indexed.id = dtohl(package->id);
+  auto key_pool = get_chunk(begin + key_strings, begin + size);
+  // The strings are decoded from the mapped file when they are looked up.
+  indexed.key_strings = std::make_unique<android::ResStringPool>(
+      key_pool, dtohl(key_pool->size), /* copyData */ false);
+  always_assert_log(indexed.key_strings->getError() == android::NO_ERROR,
+                    "Malformed key strings of arsc package 0x%x",
+                    indexed.id);
+
+  for (auto it = begin + dtohs(package->header.headerSize);
+       it < begin + size;) {
+    auto chunk = get_chunk(it, begin + size);
+    it += dtohl(chunk->size);
+    if (dtohs(chunk->type) != android::RES_TABLE_TYPE_TYPE) {
+      continue;
+    }
+    auto type = reinterpret_cast<const android::ResTable_type*>(chunk);
+    size_t header_size = dtohs(chunk->headerSize);
+    always_assert_log(
+        header_size >= offsetof(android::ResTable_type, config) &&
+            header_size + dtohl(type->entryCount) * sizeof(uint32_t) <=
+                dtohl(chunk->size) &&
+            dtohl(type->entriesStart) <= dtohl(chunk->size),
+        "Malformed arsc type chunk %u", type->id);
+    indexed.types[type->id].push_back(type);
+  }
+  m_packages.push_back(std::move(indexed));
+}
+
+const ResourcesArscView::Package* ResourcesArscView::get_package(
+    uint32_t package_id) const {
+  for (const auto& package : m_packages) {
+    if (package.id == package_id) {
+      return &package;
+    }
+  }
+  return nullptr;
+}
+
+boost::optional<std::string> ResourcesArscView::get_resource_name(
+    uint32_t id) const {
+  auto package = get_package(id >> 24);
+  if (package == nullptr) {
+    return boost::none;
+  }
+  auto it = package->types.find((id >> TYPE_INDEX_BIT_SHIFT) & 0xFF);
+  if (it == package->types.end()) {
+    return boost::none;
+  }
+  // All the configurations of an entry have the same key.
+  for (auto type : it->second) {
+    auto key_index = get_key_index(type, id & 0xFFFF);
+    if (key_index) {
+      return get_pool_string(*package->key_strings, *key_index);
+    }
+  }
+  return boost::none;
+}
+
+std::unordered_set<uint32_t> ResourcesArscView::get_resources_by_name_prefix(
+    const std::vector<std::string>& prefixes) const {
+  std::unordered_set<uint32_t> found_resources;
+  for (const auto& package : m_packages) {
+    // Match each key once, instead of once per entry and configuration.
+    const auto& key_strings = *package.key_strings;
+    std::vector<bool> matching_keys(key_strings.size());
+    bool any_match = false;
+    for (size_t i = 0; i < key_strings.size(); ++i) {
+      auto name = get_pool_string(key_strings, i);
+      if (!name) {
+        continue;
+      }
+      for (const auto& prefix : prefixes) {
+        if (boost::algorithm::starts_with(*name, prefix)) {
+          matching_keys[i] = true;
+          any_match = true;
+          break;
+        }
+      }
+    }
+    if (!any_match) {
+      continue;
+    }
+    for (const auto& pair : package.types) {
+      for (auto type : pair.second) {
+        for (uint32_t entry_id = 0; entry_id < dtohl(type->entryCount);
+             ++entry_id) {
+          auto key_index = get_key_index(type, entry_id);
+          if (key_index && *key_index < matching_keys.size() &&
+              matching_keys[*key_index]) {
+            found_resources.insert(package.id << 24 |
+                                   pair.first << TYPE_INDEX_BIT_SHIFT |
+                                   entry_id);
+          }
+        }
+      }
+    }
+  }
+  return found_resources;
+}
+
+ResourcesArscView::~ResourcesArscView() {
+  if (m_arsc_ptr != nullptr) {
+    unmap_and_close(m_arsc_fd, m_arsc_ptr, m_arsc_len);
+  }
+}
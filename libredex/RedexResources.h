@@ -10,6 +10,7 @@
 #include <boost/noncopyable.hpp>
 #include <boost/optional.hpp>
 #include <map>
+#include <memory>
 #include <set>
 #include <string>
 #include <unordered_map>
@@ -18,6 +19,8 @@
 
 #include "androidfw/ResourceTypes.h"
 
+class ZipReader;
+
 const char* const ONCLICK_ATTRIBUTE = "android:onClick";
 
 std::string read_entire_file(const std::string& filename);
@@ -103,6 +106,8 @@ struct ManifestClassInfo {
 };
 
 ManifestClassInfo get_manifest_class_info(const std::string& filename);
+// Same as above, for the AndroidManifest.xml of an APK read in place.
+ManifestClassInfo get_manifest_class_info(const ZipReader& apk);
 
 std::unordered_set<std::string> get_native_classes(
     const std::string& apk_directory);
@@ -117,12 +122,21 @@ std::unordered_set<uint32_t> get_xml_reference_attributes(
 // for resource remapping, class name extraction, etc. These files don't follow
 // binary XML format, and thus are out of scope for many optimizations.
 bool is_raw_resource(const std::string& filename);
+// The attribute values are patched in place in the mapped file, as their
+// size doesn't change.
 int inline_xml_reference_attributes(
     const std::string& filename,
     const std::map<uint32_t, android::Res_value>& id_to_inline_value);
 void remap_xml_reference_attributes(
     const std::string& filename,
     const std::map<uint32_t, uint32_t>& kept_to_remapped_ids);
+// Same as above for many files, which are patched in parallel.
+int inline_xml_reference_attributes(
+    const std::vector<std::string>& filenames,
+    const std::map<uint32_t, android::Res_value>& id_to_inline_value);
+void remap_xml_reference_attributes(
+    const std::vector<std::string>& filenames,
+    const std::map<uint32_t, uint32_t>& kept_to_remapped_ids);
 
 // Iterates through all layouts in the given directory. Adds all class names to
 // the output set, and allows for any specified attribute values to be returned
@@ -134,6 +148,14 @@ void collect_layout_classes_and_attributes(
     std::unordered_set<std::string>& out_classes,
     std::unordered_multimap<std::string, std::string>& out_attributes);
 
+// Same as above, for the layouts of an APK, which are read in place or
+// inflated on demand instead of being unpacked first.
+void collect_layout_classes_and_attributes(
+    const ZipReader& apk,
+    const std::unordered_set<std::string>& attributes_to_read,
+    std::unordered_set<std::string>& out_classes,
+    std::unordered_multimap<std::string, std::string>& out_attributes);
+
 // Same as above, for single file.
 void collect_layout_classes_and_attributes_for_file(
     const std::string& file_path,
@@ -215,3 +237,59 @@ class ResourcesArscFile {
   size_t m_arsc_len;
   void* m_arsc_ptr;
 };
+
+/*
+ * A read-only view of a resources.arsc file, for the queries that only need
+ * the names of the resources. Unlike ResourcesArscFile, it neither copies the
+ * file nor builds a ResTable: the file is mapped, the offsets of the type
+ * chunks of every package are indexed upfront, and the entries and their key
+ * strings are only decoded when they are looked up.
+ */
+class ResourcesArscView {
+ public:
+  ResourcesArscView(const ResourcesArscView&) = delete;
+  ResourcesArscView& operator=(const ResourcesArscView&) = delete;
+
+  explicit ResourcesArscView(const std::string& path);
+  /*
+   * The resources.arsc of an APK, read in place if it is stored, as it should
+   * be, or inflated otherwise. The archive must outlive the view.
+   */
+  explicit ResourcesArscView(const ZipReader& apk);
+  ~ResourcesArscView();
+
+  /*
+   * The key name of the resource, which is none if no configuration of its
+   * type has an entry for it.
+   */
+  boost::optional<std::string> get_resource_name(uint32_t id) const;
+
+  /*
+   * The ids of the resources whose key name starts with one of the prefixes,
+   * like get_resources_by_name_prefix() over name_to_ids.
+   */
+  std::unordered_set<uint32_t> get_resources_by_name_prefix(
+      const std::vector<std::string>& prefixes) const;
+
+ private:
+  struct Package {
+    uint32_t id;
+    std::unique_ptr<android::ResStringPool> key_strings;
+    // The ResTable_type chunks, i.e. the configurations, of each type id.
+    std::map<uint8_t, std::vector<const android::ResTable_type*>> types;
+  };
+
+  void index_table(const char* begin, size_t size, const std::string& name);
+
+  void index_package(const android::ResTable_package* package);
+
+  const Package* get_package(uint32_t package_id) const;
+
+  int m_arsc_fd;
+  size_t m_arsc_len;
+  // Only set when the view maps the file itself.
+  void* m_arsc_ptr{nullptr};
+  // The contents of a compressed resources.arsc.
+  std::unique_ptr<uint32_t[]> m_inflated;
+  std::vector<Package> m_packages;
+};
@@ -7,6 +7,7 @@
 
 #pragma once
 
+#include <algorithm>
 #include <atomic>
 #include <boost/optional.hpp>
 #include <mutex>
@@ -404,7 +405,10 @@ class ReferencedState {
     always_assert(RedexContext::record_keep_reasons());
     auto& keep_reasons = ensure_keep_reasons();
     std::lock_guard<std::mutex> lock(keep_reasons.m_keep_reasons_mtx);
-    keep_reasons.m_keep_reasons.emplace(reason);
+    auto& reasons = keep_reasons.m_keep_reasons;
+    if (std::find(reasons.begin(), reasons.end(), reason) == reasons.end()) {
+      reasons.push_back(reason);
+    }
   }
 
   friend class keep_rules::impl::KeepState;
@@ -7,6 +7,7 @@
 
 #pragma once
 
+#include "ConcurrentContainers.h"
 #include "DexClass.h"
 #include "DexUtil.h"
 #include "IRInstruction.h"
@@ -61,6 +62,11 @@ struct MethodRefCacheKeyHash {
 using MethodRefCache =
     std::unordered_map<MethodRefCacheKey, DexMethod*, MethodRefCacheKeyHash>;
 
+using ConcurrentMethodRefCache =
+    InsertOnlyConcurrentMap<MethodRefCacheKey,
+                            DexMethod*,
+                            MethodRefCacheKeyHash>;
+
 /**
  * Helper to map an opcode to a MethodSearch rule.
  */
@@ -240,6 +246,32 @@ inline DexMethod* resolve_method(DexMethodRef* method,
   return mdef;
 }
 
+/**
+ * Same as above, with a cache that can be shared by concurrent callers.
+ */
+inline DexMethod* resolve_method(DexMethodRef* method,
+                                 MethodSearch search,
+                                 ConcurrentMethodRefCache& ref_cache,
+                                 const DexMethod* caller = nullptr) {
+  if (search == MethodSearch::Super) {
+    return resolve_method(method, search, caller);
+  }
+  auto m = method->as_def();
+  if (m) {
+    return m;
+  }
+  MethodRefCacheKey key{method, search};
+  auto def = ref_cache.get(key);
+  if (def != nullptr) {
+    return *def;
+  }
+  auto mdef = resolve_method(method, search);
+  if (mdef != nullptr) {
+    ref_cache.emplace(key, mdef);
+  }
+  return mdef;
+}
+
 /**
  * Given a scope defined by DexClass, a name and a proto look for the vmethod
  * on the top ancestor. Essentially finds where the method was introduced.
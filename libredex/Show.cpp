@@ -23,7 +23,6 @@
 #include "DexUtil.h"
 #include "IRCode.h"
 #include "IROpcode.h"
-#include "StringBuilder.h"
 
 namespace {
 
@@ -649,24 +648,93 @@ std::ostream& operator<<(std::ostream& o, const DexType& type) {
   return o;
 }
 
-inline std::string show(DexString* p) {
+std::string show(const DexString* p) {
   if (!p) return "";
   return p->str();
 }
 
-inline std::string show(DexType* p) {
+std::string show(DexString* p) { return show(const_cast<const DexString*>(p)); }
+
+std::string show(const DexType* p) {
   if (!p) return "";
   return p->get_name()->str();
 }
 
+std::string show(DexType* p) { return show(const_cast<const DexType*>(p)); }
+
+namespace {
+
+// The exact sizes of what append_show appends, so that show() allocates once.
+size_t show_size(const DexType* p) { return p ? p->get_name()->size() : 0; }
+
+size_t show_size(const DexTypeList* p) {
+  size_t size = 0;
+  if (p) {
+    for (auto const type : p->get_type_list()) {
+      size += show_size(type);
+    }
+  }
+  return size;
+}
+
+size_t show_size(const DexProto* p) {
+  return p ? 2 + show_size(p->get_args()) + show_size(p->get_rtype()) : 0;
+}
+
+} // namespace
+
+void append_show(std::string* out, const DexType* p) {
+  if (p) {
+    out->append(p->get_name()->c_str(), p->get_name()->size());
+  }
+}
+
+void append_show(std::string* out, const DexTypeList* p) {
+  if (p) {
+    for (auto const type : p->get_type_list()) {
+      append_show(out, type);
+    }
+  }
+}
+
+void append_show(std::string* out, const DexProto* p) {
+  if (p) {
+    *out += '(';
+    append_show(out, p->get_args());
+    *out += ')';
+    append_show(out, p->get_rtype());
+  }
+}
+
+void append_show(std::string* out, const DexFieldRef* p) {
+  if (p) {
+    append_show(out, p->get_class());
+    *out += '.';
+    out->append(p->get_name()->c_str(), p->get_name()->size());
+    *out += ':';
+    append_show(out, p->get_type());
+  }
+}
+
+void append_show(std::string* out, const DexMethodRef* p) {
+  if (p) {
+    append_show(out, p->get_class());
+    *out += '.';
+    out->append(p->get_name()->c_str(), p->get_name()->size());
+    *out += ':';
+    append_show(out, p->get_proto());
+  }
+}
+
 // This format must match the proguard map format because it's used to look up
 // in the proguard map
 std::string show(const DexFieldRef* p) {
   if (!p) return "";
-  string_builders::StaticStringBuilder<5> b;
-  b << show(p->get_class()) << "." << show(p->get_name()) << ":"
-    << show(p->get_type());
-  return b.str();
+  std::string result;
+  result.reserve(show_size(p->get_class()) + p->get_name()->size() + 2 +
+                 show_size(p->get_type()));
+  append_show(&result, p);
+  return result;
 }
 
 std::ostream& operator<<(std::ostream& o, const DexFieldRef& p) {
@@ -714,21 +782,20 @@ std::string vshow(const DexProto* p, bool include_ret_type = true) {
 // in the proguard map
 std::string show(const DexTypeList* p) {
   if (!p) return "";
-  const auto& type_list = p->get_type_list();
-  string_builders::DynamicStringBuilder b(type_list.size());
-  for (auto const type : type_list) {
-    b << show(type);
-  }
-  return b.str();
+  std::string result;
+  result.reserve(show_size(p));
+  append_show(&result, p);
+  return result;
 }
 
 // This format must match the proguard map format because it's used to look up
 // in the proguard map
 std::string show(const DexProto* p) {
   if (!p) return "";
-  string_builders::StaticStringBuilder<4> b;
-  b << "(" << show(p->get_args()) << ")" << show(p->get_rtype());
-  return b.str();
+  std::string result;
+  result.reserve(show_size(p));
+  append_show(&result, p);
+  return result;
 }
 
 std::string show(const DexCode* code) {
@@ -749,10 +816,11 @@ std::string show(const DexCode* code) {
 // in the proguard map
 std::string show(const DexMethodRef* p) {
   if (!p) return "";
-  string_builders::StaticStringBuilder<5> b;
-  b << show(p->get_class()) << "." << show(p->get_name()) << ":"
-    << show(p->get_proto());
-  return b.str();
+  std::string result;
+  result.reserve(show_size(p->get_class()) + p->get_name()->size() + 2 +
+                 show_size(p->get_proto()));
+  append_show(&result, p);
+  return result;
 }
 
 std::string vshow(uint32_t acc, bool is_method) {
@@ -1328,10 +1396,15 @@ std::string show_deobfuscated(const DexFieldRef* ref) {
 }
 
 std::string show_deobfuscated_no_cache(const DexMethodRef* ref) {
-  string_builders::StaticStringBuilder<5> b;
-  b << show_deobfuscated(ref->get_class()) << "." << show(ref->get_name())
-    << ":" << show_deobfuscated(ref->get_proto());
-  return b.str();
+  std::string result;
+  result.reserve(show_size(ref->get_class()) + ref->get_name()->size() + 2 +
+                 show_size(ref->get_proto()));
+  append_show_deobfuscated(&result, ref->get_class());
+  result += '.';
+  result.append(ref->get_name()->c_str(), ref->get_name()->size());
+  result += ':';
+  append_show_deobfuscated(&result, ref->get_proto());
+  return result;
 }
 
 std::string show_deobfuscated(const DexMethodRef* ref) {
@@ -1357,48 +1430,66 @@ std::string show_deobfuscated(const DexEncodedValue* ev) {
   return ev->show_deobfuscated();
 }
 
-std::string show_deobfuscated(const DexType* t) {
-  std::function<std::string(const DexType*)> f = [&f](const DexType* t) {
-    if (t == nullptr) {
-      return std::string("");
-    }
-    const auto& name = show(t);
-    if (name[0] == 'L') {
-      const DexClass* cls = type_class(t);
-      if (cls == nullptr || cls->get_deobfuscated_name().empty()) {
-        return name;
-      }
-      return cls->get_deobfuscated_name();
-    } else if (name[0] == '[') {
-      std::ostringstream ss;
-      ss << '[' << f(DexType::get_type(name.substr(1)));
-      return ss.str();
+// Class types, and arrays of them, take the deobfuscated name of the class,
+// which the class keeps, so only the array prefix is ever built.
+void append_show_deobfuscated(std::string* out, const DexType* t) {
+  if (t == nullptr) {
+    return;
+  }
+  auto name = t->get_name();
+  const char* element = name->c_str();
+  while (*element == '[') {
+    ++element;
+  }
+  if (*element == 'L') {
+    auto element_type =
+        element == name->c_str() ? t : DexType::get_type(element);
+    const DexClass* cls =
+        element_type == nullptr ? nullptr : type_class(element_type);
+    if (cls != nullptr && !cls->get_deobfuscated_name().empty()) {
+      out->append(name->c_str(), element - name->c_str());
+      *out += cls->get_deobfuscated_name();
+      return;
     }
-    return name;
-  };
-  return f(t);
+  }
+  out->append(name->c_str(), name->size());
 }
 
-std::string show_deobfuscated(const DexTypeList* l) {
-  if (l == nullptr) {
-    return "";
+void append_show_deobfuscated(std::string* out, const DexTypeList* l) {
+  if (l != nullptr) {
+    for (const auto& type : l->get_type_list()) {
+      append_show_deobfuscated(out, type);
+    }
   }
-  const auto& type_list = l->get_type_list();
-  string_builders::DynamicStringBuilder b(type_list.size());
-  for (const auto& type : type_list) {
-    b << show_deobfuscated(type);
+}
+
+void append_show_deobfuscated(std::string* out, const DexProto* p) {
+  if (p != nullptr) {
+    *out += '(';
+    append_show_deobfuscated(out, p->get_args());
+    *out += ')';
+    append_show_deobfuscated(out, p->get_rtype());
   }
-  return b.str();
+}
+
+std::string show_deobfuscated(const DexType* t) {
+  std::string result;
+  append_show_deobfuscated(&result, t);
+  return result;
+}
+
+std::string show_deobfuscated(const DexTypeList* l) {
+  std::string result;
+  result.reserve(show_size(l));
+  append_show_deobfuscated(&result, l);
+  return result;
 }
 
 std::string show_deobfuscated(const DexProto* p) {
-  if (p == nullptr) {
-    return "";
-  }
-  string_builders::StaticStringBuilder<4> b;
-  b << "(" << show_deobfuscated(p->get_args()) << ")"
-    << show_deobfuscated(p->get_rtype());
-  return b.str();
+  std::string result;
+  result.reserve(show_size(p));
+  append_show_deobfuscated(&result, p);
+  return result;
 }
 
 std::string show_deobfuscated(const DexCallSite* callsite) {
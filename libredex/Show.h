@@ -104,6 +104,11 @@ std::ostream& operator<<(std::ostream&, const MethodItemEntry&);
 std::ostream& operator<<(std::ostream&, const DexCallSite&);
 std::ostream& operator<<(std::ostream&, const DexMethodHandle&);
 
+// Strings and types hold their descriptor already, so these only copy it.
+std::string show(const DexString*);
+std::string show(DexString*);
+std::string show(const DexType*);
+std::string show(DexType*);
 std::string show(const DexFieldRef*);
 std::string show(const DexDebugEntry*);
 std::string show(const DexTypeList*);
@@ -137,6 +142,19 @@ std::string show_deobfuscated(const DexProto*);
 std::string show_deobfuscated(const DexCallSite*);
 std::string show_deobfuscated(const DexMethodHandle*);
 
+/*
+ * Append what show() returns to `out`, without building a string for each
+ * part, so that a caller formatting many descriptors can reuse one buffer.
+ */
+void append_show(std::string* out, const DexType*);
+void append_show(std::string* out, const DexTypeList*);
+void append_show(std::string* out, const DexProto*);
+void append_show(std::string* out, const DexFieldRef*);
+void append_show(std::string* out, const DexMethodRef*);
+void append_show_deobfuscated(std::string* out, const DexType*);
+void append_show_deobfuscated(std::string* out, const DexTypeList*);
+void append_show_deobfuscated(std::string* out, const DexProto*);
+
 // SHOW(x) is syntax sugar for show(x).c_str()
 #define SHOW(...) show(__VA_ARGS__).c_str()
 
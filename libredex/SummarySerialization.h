@@ -7,17 +7,27 @@
 
 #pragma once
 
+#include <algorithm>
+#include <functional>
 #include <istream>
 #include <ostream>
+#include <string>
+#include <unordered_set>
+#include <vector>
 
+#include <boost/functional/hash.hpp>
+
+#include "CallGraph.h"
 #include "DexClass.h"
+#include "DexHasher.h"
 #include "S_Expression.h"
 #include "Show.h"
 
 /*
  * This module serves to (de)serialize maps of DexMethods to summary objects
  * of any type, which is useful for the analysis of methods external to the
- * APK.
+ * APK, and for reusing the summaries of unchanged methods from one build to
+ * the next.
  */
 
 namespace summary_serialization {
@@ -80,4 +90,173 @@ size_t read(std::istream& input,
   return load_count;
 }
 
+/*
+ * Hashes a method together with the methods that it calls. A summary that
+ * depends on the summaries of the callees must be recomputed when the call
+ * sites of the method are resolved differently, even if the method itself is
+ * unchanged.
+ */
+inline size_t hash_method_and_callees(const call_graph::Graph& graph,
+                                      const DexMethod* method) {
+  auto hash = hashing::hash_method(method);
+  if (!graph.has_node(method)) {
+    return hash;
+  }
+  std::vector<std::string> callees;
+  for (const auto& edge : graph.node(method)->callees()) {
+    auto* callee = edge->callee()->method();
+    if (callee != nullptr) {
+      callees.emplace_back(show(callee));
+    }
+  }
+  std::sort(callees.begin(), callees.end());
+  boost::hash_combine(hash, callees);
+  return hash;
+}
+
+/*
+ * A store of the summaries of the methods defined in the APK, each of which is
+ * keyed by the hash of the method it was computed from. Writing the store at
+ * the end of a build and reading it back in the next one lets an analysis
+ * reuse the summaries of the methods that did not change.
+ *
+ * A store is tagged with the kind of its summaries and a version, which must
+ * be bumped whenever the format or the meaning of the summaries changes. A
+ * store with a different tag is ignored.
+ */
+template <typename V>
+class MethodSummaryStore final {
+ public:
+  using HashFunction = std::function<size_t(const DexMethod*)>;
+
+  MethodSummaryStore(std::string kind,
+                     int32_t version,
+                     HashFunction hash_fn = hashing::hash_method)
+      : m_kind(std::move(kind)),
+        m_version(version),
+        m_hash_fn(std::move(hash_fn)) {}
+
+  // Records the summary of the method as of its current contents.
+  void set(const DexMethod* method, V summary) {
+    m_summaries[method] = Entry{m_hash_fn(method), std::move(summary)};
+  }
+
+  const V* get(const DexMethodRef* method) const {
+    auto it = m_summaries.find(method);
+    return it == m_summaries.end() ? nullptr : &it->second.summary;
+  }
+
+  size_t size() const { return m_summaries.size(); }
+
+  void write(std::ostream& output) const {
+    output << sparta::s_expr(
+                  {sparta::s_expr(m_kind), sparta::s_expr(m_version)})
+           << std::endl;
+    // Order the entries so that the output is deterministic.
+    std::map<const DexMethodRef*, const Entry*, dexmethods_comparator> entries;
+    for (const auto& pair : m_summaries) {
+      entries.emplace(pair.first, &pair.second);
+    }
+    for (const auto& pair : entries) {
+      output << sparta::s_expr({sparta::s_expr(show(pair.first)),
+                                sparta::s_expr(hashing::hash_to_string(
+                                    pair.second->hash)),
+                                to_s_expr(pair.second->summary)})
+             << std::endl;
+    }
+  }
+
+  /*
+   * Loads the summaries of the methods that are unchanged since the store was
+   * written. Returns the number of summaries loaded.
+   */
+  size_t read(std::istream& input) {
+    sparta::s_expr_istream s_expr_input(input);
+    sparta::s_expr header;
+    s_expr_input >> header;
+    if (s_expr_input.eoi() || s_expr_input.fail() || header.size() != 2 ||
+        !header[0].is_string() || header[0].get_string() != m_kind ||
+        !header[1].is_int32() || header[1].get_int32() != m_version) {
+      TRACE(LIB, 1, "Ignoring a summary store that is not of kind %s v%d",
+            m_kind.c_str(), m_version);
+      return 0;
+    }
+    size_t load_count{0};
+    while (s_expr_input.good()) {
+      sparta::s_expr expr;
+      s_expr_input >> expr;
+      if (s_expr_input.eoi()) {
+        break;
+      }
+      always_assert_log(!s_expr_input.fail(), "%s\n",
+                        s_expr_input.what().c_str());
+      auto* method_ref = DexMethod::get_method(expr[0].get_string());
+      if (method_ref == nullptr || !method_ref->is_def()) {
+        continue;
+      }
+      const auto* method = method_ref->as_def();
+      auto hash = std::stoull(expr[1].get_string(), nullptr, 16);
+      if (method->get_code() == nullptr || m_hash_fn(method) != hash) {
+        continue;
+      }
+      m_summaries[method] = Entry{hash, V::from_s_expr(expr[2])};
+      ++load_count;
+    }
+    return load_count;
+  }
+
+  /*
+   * Removes the summaries of the methods that transitively call a method with
+   * code whose summary is not in the store. Such summaries depend on the
+   * summaries of callees that are about to be recomputed. Returns the number
+   * of summaries removed.
+   */
+  size_t remove_stale_callers(const call_graph::Graph& graph) {
+    auto is_missing = [this](const DexMethod* method) {
+      return method != nullptr && method->get_code() != nullptr &&
+             m_summaries.count(method) == 0;
+    };
+    std::unordered_set<const DexMethod*> stale;
+    for (const auto& pair : m_summaries) {
+      auto* method = static_cast<const DexMethod*>(pair.first);
+      if (!graph.has_node(method)) {
+        continue;
+      }
+      for (const auto& edge : graph.node(method)->callees()) {
+        if (is_missing(edge->callee()->method())) {
+          stale.emplace(method);
+          break;
+        }
+      }
+    }
+    std::vector<const DexMethod*> worklist(stale.begin(), stale.end());
+    while (!worklist.empty()) {
+      auto* method = worklist.back();
+      worklist.pop_back();
+      for (const auto& edge : graph.node(method)->callers()) {
+        auto* caller = edge->caller()->method();
+        if (caller != nullptr && m_summaries.count(caller) != 0 &&
+            stale.emplace(caller).second) {
+          worklist.push_back(caller);
+        }
+      }
+    }
+    for (auto* method : stale) {
+      m_summaries.erase(method);
+    }
+    return stale.size();
+  }
+
+ private:
+  struct Entry {
+    size_t hash;
+    V summary;
+  };
+
+  std::string m_kind;
+  int32_t m_version;
+  HashFunction m_hash_fn;
+  std::unordered_map<const DexMethodRef*, Entry> m_summaries;
+};
+
 } // namespace summary_serialization
@@ -8,22 +8,27 @@
 #include "Timer.h"
 
 #include "Trace.h"
+#include "TraceTimeline.h"
 
-unsigned Timer::s_indent = 0;
+std::atomic<unsigned> Timer::s_indent{0};
 std::mutex Timer::s_lock;
 Timer::times_t Timer::s_times;
 
 Timer::Timer(const std::string& msg)
-    : m_msg(msg), m_start(std::chrono::high_resolution_clock::now()) {
+    : m_msg(msg),
+      m_start(std::chrono::high_resolution_clock::now()),
+      m_timeline_start(trace_timeline::clock::now()) {
   ++s_indent;
 }
 
 Timer::~Timer() {
-  --s_indent;
+  unsigned indent = --s_indent;
   auto end = std::chrono::high_resolution_clock::now();
   auto duration_s = std::chrono::duration<double>(end - m_start).count();
-  TRACE(TIME, 1, "%*s%s completed in %.1lf seconds", 4 * s_indent, "",
+  TRACE(TIME, 1, "%*s%s completed in %.1lf seconds", 4 * indent, "",
         m_msg.c_str(), duration_s);
+  trace_timeline::record_scope(m_msg, m_timeline_start,
+                               trace_timeline::clock::now());
 
   {
     std::lock_guard<std::mutex> guard(s_lock);
@@ -7,6 +7,7 @@
 
 #pragma once
 
+#include <atomic>
 #include <chrono>
 #include <mutex>
 #include <string>
@@ -24,7 +25,9 @@ struct Timer {
  private:
   static std::mutex s_lock;
   static times_t s_times;
-  static unsigned s_indent;
+  // Timers may run on several threads at once during startup.
+  static std::atomic<unsigned> s_indent;
   std::string m_msg;
   std::chrono::high_resolution_clock::time_point m_start;
+  std::chrono::steady_clock::time_point m_timeline_start;
 };
@@ -7,6 +7,7 @@
 
 #include "Trace.h"
 
+#include <algorithm>
 #include <array>
 #include <cstdarg>
 #include <cstdio>
@@ -53,6 +54,13 @@ struct Tracer {
 
     init_trace_modules(traceenv);
     init_trace_file(envfile);
+#ifndef NDEBUG
+    long max_level = m_level;
+    for (auto level : m_traces) {
+      max_level = std::max(max_level, level);
+    }
+    trace_impl::s_max_level.store(max_level, std::memory_order_relaxed);
+#endif
 
     if (show_timestamps) {
       m_show_timestamps = true;
@@ -171,11 +179,19 @@ struct Tracer {
   std::array<long, N_TRACE_MODULES> m_traces;
 };
 
+} // namespace
+
+#ifndef NDEBUG
+// Constant-initialized, so that it is valid before the tracer is constructed.
+std::atomic<long> trace_impl::s_max_level{0};
+#endif
+
+namespace {
 static Tracer tracer;
 } // namespace
 
 #ifndef NDEBUG
-bool traceEnabled(TraceModule module, int level) {
+bool trace_impl::module_trace_enabled(TraceModule module, int level) {
   return tracer.traceEnabled(module, level);
 }
 #endif
@@ -7,6 +7,7 @@
 
 #pragma once
 
+#include <atomic>
 #include <memory>
 #include <mutex>
 #include <string>
@@ -156,7 +157,18 @@ enum TraceModule : int {
 #ifdef NDEBUG
 constexpr bool traceEnabled(TraceModule, int) { return false; }
 #else
-bool traceEnabled(TraceModule module, int level);
+namespace trace_impl {
+// The highest level that any module traces at, 0 when tracing is off. It is
+// checked inline, so that a disabled TRACE costs a load and a branch rather
+// than a call, even in hot loops.
+extern std::atomic<long> s_max_level;
+bool module_trace_enabled(TraceModule module, int level);
+} // namespace trace_impl
+
+inline bool traceEnabled(TraceModule module, int level) {
+  return level <= trace_impl::s_max_level.load(std::memory_order_relaxed) &&
+         trace_impl::module_trace_enabled(module, level);
+}
 #endif // NDEBUG
 
 void trace(
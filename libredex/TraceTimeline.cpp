@@ -0,0 +1,152 @@
+/*
+ * Copyright (c) Facebook, Inc. and its affiliates.
+ *
+ * This source code is licensed under the MIT license found in the
+ * LICENSE file in the root directory of this source tree.
+ */
+
+#include "TraceTimeline.h"
+
+#include <atomic>
+#include <cstdio>
+#include <fstream>
+#include <memory>
+#include <mutex>
+#include <vector>
+
+namespace trace_timeline {
+
+namespace {
+
+// Work queue tasks starting less than this after the previous task on the same
+// thread ended are merged into the previous span.
+constexpr int64_t MERGE_GAP_US = 50;
+
+struct Event {
+  // Empty for (merged) work queue tasks.
+  std::string name;
+  int64_t start_us;
+  int64_t end_us;
+  size_t num_tasks;
+};
+
+struct ThreadBuffer {
+  size_t tid;
+  std::vector<Event> events;
+};
+
+std::atomic<bool> s_enabled{false};
+clock::time_point s_epoch;
+std::mutex s_buffers_mutex;
+std::vector<std::unique_ptr<ThreadBuffer>> s_buffers;
+
+int64_t to_us(clock::time_point t) {
+  return std::chrono::duration_cast<std::chrono::microseconds>(t - s_epoch)
+      .count();
+}
+
+ThreadBuffer& get_thread_buffer() {
+  // The buffers outlive their threads, so they can be written out at the end.
+  thread_local ThreadBuffer* buffer = nullptr;
+  if (buffer == nullptr) {
+    std::lock_guard<std::mutex> lock(s_buffers_mutex);
+    s_buffers.emplace_back(new ThreadBuffer{s_buffers.size(), {}});
+    buffer = s_buffers.back().get();
+  }
+  return *buffer;
+}
+
+void write_escaped(std::ostream& os, const std::string& s) {
+  for (char c : s) {
+    switch (c) {
+    case '"':
+      os << "\\\"";
+      break;
+    case '\\':
+      os << "\\\\";
+      break;
+    case '\n':
+      os << "\\n";
+      break;
+    default:
+      if (static_cast<unsigned char>(c) < 0x20) {
+        char buf[8];
+        snprintf(buf, sizeof(buf), "\\u%04x", c);
+        os << buf;
+      } else {
+        os << c;
+      }
+    }
+  }
+}
+
+} // namespace
+
+void enable() {
+  s_epoch = clock::now();
+  s_enabled.store(true);
+}
+
+bool is_enabled() { return s_enabled.load(std::memory_order_relaxed); }
+
+void record_scope(const std::string& name,
+                  clock::time_point start,
+                  clock::time_point end) {
+  if (!is_enabled()) {
+    return;
+  }
+  get_thread_buffer().events.push_back(
+      Event{name, to_us(start), to_us(end), 0});
+}
+
+void record_task(clock::time_point start, clock::time_point end) {
+  if (!is_enabled()) {
+    return;
+  }
+  auto& events = get_thread_buffer().events;
+  auto start_us = to_us(start);
+  auto end_us = to_us(end);
+  if (!events.empty()) {
+    auto& last = events.back();
+    if (last.name.empty() && start_us - last.end_us < MERGE_GAP_US) {
+      last.end_us = end_us;
+      last.num_tasks++;
+      return;
+    }
+  }
+  events.push_back(Event{"", start_us, end_us, 1});
+}
+
+bool write(const std::string& path) {
+  std::ofstream os(path);
+  if (!os) {
+    return false;
+  }
+  std::lock_guard<std::mutex> lock(s_buffers_mutex);
+  os << "{\"traceEvents\":[";
+  bool first = true;
+  for (auto& buffer : s_buffers) {
+    for (auto& event : buffer->events) {
+      os << (first ? "\n" : ",\n");
+      first = false;
+      os << "{\"name\":\"";
+      if (event.name.empty()) {
+        os << "tasks";
+      } else {
+        write_escaped(os, event.name);
+      }
+      os << "\",\"cat\":\"" << (event.name.empty() ? "workqueue" : "timer")
+         << "\",\"ph\":\"X\",\"pid\":1,\"tid\":" << buffer->tid
+         << ",\"ts\":" << event.start_us
+         << ",\"dur\":" << (event.end_us - event.start_us);
+      if (event.name.empty()) {
+        os << ",\"args\":{\"num_tasks\":" << event.num_tasks << "}";
+      }
+      os << "}";
+    }
+  }
+  os << "\n],\"displayTimeUnit\":\"ms\"}\n";
+  return !os.fail();
+}
+
+} // namespace trace_timeline
@@ -0,0 +1,63 @@
+/*
+ * Copyright (c) Facebook, Inc. and its affiliates.
+ *
+ * This source code is licensed under the MIT license found in the
+ * LICENSE file in the root directory of this source tree.
+ */
+
+#pragma once
+
+#include <chrono>
+#include <string>
+
+/*
+ * Opt-in recording of a timeline of (nested) Timer scopes and WorkQueue task
+ * spans, per thread, which can be written out in the Chrome trace_event JSON
+ * format and opened in chrome://tracing or Perfetto.
+ *
+ * Recording is cheap when disabled: a single relaxed atomic load. When
+ * enabled, events are appended to thread-local buffers. Back-to-back work queue
+ * tasks with only tiny gaps in between are merged into a single span, which
+ * bounds the amount of recorded data while keeping thread idle time visible.
+ */
+namespace trace_timeline {
+
+using clock = std::chrono::steady_clock;
+
+void enable();
+
+bool is_enabled();
+
+// Record a completed named scope, e.g. a Timer, on the current thread.
+void record_scope(const std::string& name,
+                  clock::time_point start,
+                  clock::time_point end);
+
+// Record a completed work queue task on the current thread.
+void record_task(clock::time_point start, clock::time_point end);
+
+class ScopedTask final {
+ public:
+  ScopedTask() : m_enabled(is_enabled()) {
+    if (m_enabled) {
+      m_start = clock::now();
+    }
+  }
+
+  ~ScopedTask() {
+    if (m_enabled) {
+      record_task(m_start, clock::now());
+    }
+  }
+
+ private:
+  bool m_enabled;
+  clock::time_point m_start;
+};
+
+// Writes all recorded events. There should be no concurrently running threads
+// recording events when this function is called. Returns false if the file
+// could not be written.
+bool write(const std::string& path);
+
+} // namespace trace_timeline
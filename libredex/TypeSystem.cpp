@@ -74,20 +74,36 @@ TypeSystem::TypeSystem(const Scope& scope) : m_class_scopes(scope) {
   make_instanceof_interfaces_table();
 }
 
-void TypeSystem::get_all_super_interfaces(const DexType* intf,
-                                          TypeSet& supers) const {
+const TypeSet& TypeSystem::all_super_interfaces(const DexType* intf) const {
+  const auto* memo = m_all_super_interfaces.get(intf);
+  if (memo != nullptr) {
+    return *memo;
+  }
+  TypeSet supers;
   const auto cls = type_class(intf);
-  if (cls == nullptr) return;
-  for (const auto& super : cls->get_interfaces()->get_type_list()) {
-    supers.insert(super);
-    get_all_super_interfaces(super, supers);
+  if (cls != nullptr) {
+    for (const auto& super : cls->get_interfaces()->get_type_list()) {
+      supers.insert(super);
+      const auto& super_supers = all_super_interfaces(super);
+      supers.insert(super_supers.begin(), super_supers.end());
+    }
   }
+  // Another thread may have gotten there first, with the same result.
+  return *m_all_super_interfaces.emplace(intf, std::move(supers)).first;
 }
 
-TypeSet TypeSystem::get_all_super_interfaces(const DexType* intf) const {
-  TypeSet supers;
-  get_all_super_interfaces(intf, supers);
-  return supers;
+const TypeSet& TypeSystem::all_interface_children(const DexType* intf) const {
+  const auto* memo = m_all_interface_children.get(intf);
+  if (memo != nullptr) {
+    return *memo;
+  }
+  TypeSet children;
+  for (const auto& child : get_interface_children(intf)) {
+    children.insert(child);
+    const auto& grandchildren = all_interface_children(child);
+    children.insert(grandchildren.begin(), grandchildren.end());
+  }
+  return *m_all_interface_children.emplace(intf, std::move(children)).first;
 }
 
 TypeSet TypeSystem::get_local_interfaces(const TypeSet& classes) {
@@ -184,6 +200,39 @@ void TypeSystem::make_instanceof_interfaces_table() {
   for (const auto& root : no_parents) {
     make_interfaces_table(root);
   }
+  for (const auto& root : no_parents) {
+    number_hierarchy(root);
+  }
+}
+
+void TypeSystem::number_hierarchy(const DexType* root) {
+  if (m_intervals.count(root) != 0) {
+    return;
+  }
+  const auto& hierarchy = m_class_scopes.get_class_hierarchy();
+  // Iterative, as the hierarchy can be deep. The second member of a stack
+  // entry tells whether the type's subclasses have been numbered.
+  std::vector<std::pair<const DexType*, bool>> stack{{root, false}};
+  while (!stack.empty()) {
+    auto& top = stack.back();
+    const auto* type = top.first;
+    if (top.second) {
+      m_intervals.at(type).last = static_cast<uint32_t>(m_preorder.size() - 1);
+      stack.pop_back();
+      continue;
+    }
+    top.second = true;
+    auto index = static_cast<uint32_t>(m_preorder.size());
+    m_intervals.emplace(type, Interval{index, index});
+    m_preorder.emplace_back(type);
+    const auto& children = hierarchy.find(type);
+    if (children == hierarchy.end()) {
+      continue;
+    }
+    for (const auto& child : children->second) {
+      stack.emplace_back(child, false);
+    }
+  }
 }
 
 void TypeSystem::make_interfaces_table(const DexType* type) {
@@ -8,6 +8,7 @@
 #pragma once
 
 #include "ClassHierarchy.h"
+#include "ConcurrentContainers.h"
 #include "DexClass.h"
 #include "VirtualScope.h"
 
@@ -34,10 +35,25 @@ class TypeSystem {
   static const TypeSet empty_set;
   static const TypeVector empty_vec;
 
+  // The classes of the hierarchy in pre-order. The subclasses of a type are
+  // exactly those numbered in (first, last].
+  struct Interval {
+    uint32_t first;
+    uint32_t last;
+  };
+
   ClassScopes m_class_scopes;
   ClassHierarchy m_intf_children;
   InstanceOfTable m_instanceof_table;
   TypeToTypeSet m_interfaces;
+  TypeVector m_preorder;
+  std::unordered_map<const DexType*, Interval> m_intervals;
+  // Closures of the interface DAG, computed on demand. Entries never move, so
+  // references to them stay valid while other threads insert.
+  mutable InsertOnlyConcurrentMap<const DexType*, TypeSet>
+      m_all_super_interfaces;
+  mutable InsertOnlyConcurrentMap<const DexType*, TypeSet>
+      m_all_interface_children;
 
  public:
   explicit TypeSystem(const Scope& scope);
@@ -58,8 +74,13 @@ class TypeSystem {
    * The type must be a class (not an interface).
    */
   void get_all_children(const DexType* type, TypeSet& children) const {
-    return ::get_all_children(
-        m_class_scopes.get_class_hierarchy(), type, children);
+    const auto& interval = m_intervals.find(type);
+    if (interval == m_intervals.end()) {
+      return ::get_all_children(
+          m_class_scopes.get_class_hierarchy(), type, children);
+    }
+    children.insert(m_preorder.begin() + interval->second.first + 1,
+                    m_preorder.begin() + interval->second.last + 1);
   }
 
   /**
@@ -106,16 +127,13 @@ class TypeSystem {
    * The type must be a class (not an interface).
    */
   bool is_subtype(const DexType* parent, const DexType* child) const {
-    const auto& parent_it = m_instanceof_table.find(parent);
-    const auto& child_it = m_instanceof_table.find(child);
-    if (parent_it == m_instanceof_table.end() ||
-        child_it == m_instanceof_table.end()) {
+    const auto& parent_it = m_intervals.find(parent);
+    const auto& child_it = m_intervals.find(child);
+    if (parent_it == m_intervals.end() || child_it == m_intervals.end()) {
       return false;
     }
-    const auto& p_chain = parent_it->second;
-    const auto& c_chain = child_it->second;
-    if (p_chain.size() > c_chain.size()) return false;
-    return c_chain.at(p_chain.size() - 1) == parent;
+    return parent_it->second.first <= child_it->second.first &&
+           child_it->second.first <= parent_it->second.last;
   }
 
   /**
@@ -150,8 +168,13 @@ class TypeSystem {
    * The direct list of interfaces implemented can be retrived in the
    * DexClass.
    */
-  void get_all_super_interfaces(const DexType* intf, TypeSet& supers) const;
-  TypeSet get_all_super_interfaces(const DexType* intf) const;
+  void get_all_super_interfaces(const DexType* intf, TypeSet& supers) const {
+    const auto& all_supers = all_super_interfaces(intf);
+    supers.insert(all_supers.begin(), all_supers.end());
+  }
+  TypeSet get_all_super_interfaces(const DexType* intf) const {
+    return all_super_interfaces(intf);
+  }
 
   /**
    * Return the direct children of a given interface.
@@ -169,11 +192,8 @@ class TypeSystem {
    */
   void get_all_interface_children(const DexType* intf,
                                   TypeSet& children) const {
-    const auto& direct_children = get_interface_children(intf);
-    children.insert(direct_children.begin(), direct_children.end());
-    for (const auto& child : direct_children) {
-      get_all_interface_children(child, children);
-    }
+    const auto& all_children = all_interface_children(intf);
+    children.insert(all_children.begin(), all_children.end());
   }
 
   /**
@@ -223,4 +243,7 @@ class TypeSystem {
  private:
   void make_instanceof_interfaces_table();
   void make_interfaces_table(const DexType* type);
+  void number_hierarchy(const DexType* root);
+  const TypeSet& all_super_interfaces(const DexType* intf) const;
+  const TypeSet& all_interface_children(const DexType* intf) const;
 };
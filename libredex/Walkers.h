@@ -511,6 +511,43 @@ class walk {
           init);
     }
 
+    // Same as the `methods()` variant taking a walker that returns an
+    // Accumulator, but the unit of parallelization is a single method, and
+    // methods are scheduled in order of decreasing `cost` (LPT scheduling).
+    // This keeps a few giant methods from being picked up last and
+    // determining the wall time of the whole walk.
+    //
+    // CostFn should accept a `DexMethod*` and return a `size_t`; see
+    // `code_size_cost`.
+    // WalkerFn should accept a `DexMethod*` and return `Accumulator`.
+    template <class Accumulator,
+              class Reduce = plus_assign<Accumulator>,
+              class Classes,
+              typename CostFn,
+              typename WalkerFn>
+    static Accumulator methods_by_cost(
+        const Classes& classes,
+        const CostFn& cost,
+        const WalkerFn& walker,
+        size_t num_threads = redex_parallel::default_num_threads(),
+        Accumulator init = Accumulator()) {
+      std::vector<CacheAligned<Accumulator>> acc_vec(num_threads, init);
+      auto reduce = Reduce();
+      auto wq = workqueue_foreach<DexMethod*>(
+          [&](sparta::SpartaWorkerState<DexMethod*>* state, DexMethod* m) {
+            Accumulator& acc = acc_vec[state->worker_id()];
+            TraceContext context(m->get_deobfuscated_name());
+            reduce(walker(m), &acc);
+          },
+          num_threads);
+      run_all(wq, sorted_by_decreasing_cost(classes, all_methods, cost));
+
+      for (Accumulator& acc : acc_vec) {
+        reduce(acc, &init);
+      }
+      return init;
+    }
+
     //
     // Call `walker` on all fields in `classes` in parallel.
     //   WalkerFn should accept a `DexField*`.
@@ -552,6 +589,43 @@ class walk {
       walk::parallel::code(classes, all_methods, walker, num_threads);
     }
 
+    // Same as `code()`, but the unit of parallelization is a single method,
+    // and methods are scheduled in order of decreasing `cost` (LPT
+    // scheduling).
+    //   CostFn should accept a `DexMethod*` and return a `size_t`; see
+    //   `code_size_cost`.
+    template <class Classes,
+              typename FilterFn,
+              typename CostFn,
+              typename WalkerFn>
+    static void code_by_cost(
+        const Classes& classes,
+        const FilterFn& filter,
+        const CostFn& cost,
+        const WalkerFn& walker,
+        size_t num_threads = redex_parallel::default_num_threads()) {
+      auto wq = workqueue_foreach<DexMethod*>(
+          [&walker](DexMethod* m) {
+            TraceContext context(m->get_deobfuscated_name());
+            walker(m, *m->get_code());
+          },
+          num_threads);
+      run_all(wq,
+              sorted_by_decreasing_cost(
+                  classes,
+                  [&filter](DexMethod* m) {
+                    return m->get_code() != nullptr && filter(m);
+                  },
+                  cost));
+    }
+
+    // A cheap cost estimate for the `*_by_cost` walkers: the size of the
+    // method's code in code units, or zero for methods without code.
+    static size_t code_size_cost(DexMethod* m) {
+      auto code = m->get_code();
+      return code ? code->sum_opcode_sizes() : 0;
+    }
+
     // Call `walker` on all opcodes (of methods approved by `filter`) in
     // `classes` in parallel.
     //   FilterFn should accept a `DexMethod*` and return a bool.
@@ -648,6 +722,35 @@ class walk {
     }
 
    private:
+    // The work queue hands out items round-robin to the workers, which
+    // process their own items in insertion order; so adding items sorted by
+    // decreasing cost makes every worker start with the most expensive ones.
+    // Ties are broken by the original order to keep this deterministic.
+    template <class Classes, typename FilterFn, typename CostFn>
+    static std::vector<DexMethod*> sorted_by_decreasing_cost(
+        const Classes& classes, const FilterFn& filter, const CostFn& cost) {
+      std::vector<std::pair<size_t, DexMethod*>> costed;
+      for (const auto& cls : classes) {
+        for (auto* methods : {&cls->get_dmethods(), &cls->get_vmethods()}) {
+          for (auto* m : *methods) {
+            if (filter(m)) {
+              costed.emplace_back(cost(m), m);
+            }
+          }
+        }
+      }
+      std::stable_sort(
+          costed.begin(), costed.end(), [](const auto& a, const auto& b) {
+            return a.first > b.first;
+          });
+      std::vector<DexMethod*> res;
+      res.reserve(costed.size());
+      for (auto& p : costed) {
+        res.push_back(p.second);
+      }
+      return res;
+    }
+
     template <class WQ, class Classes>
     static void run_all(WQ& wq, const Classes& classes) {
       for (const auto& cls : classes) {
@@ -8,8 +8,10 @@
 #pragma once
 
 #include <exception>
+#include <vector>
 
 #include "SpartaWorkQueue.h"
+#include "TraceTimeline.h"
 
 namespace redex_workqueue_impl {
 
@@ -20,6 +22,7 @@ template <typename Input, typename Fn>
 struct NoStateWorkQueueHelper {
   Fn fn;
   void operator()(sparta::SpartaWorkerState<Input>*, Input a) {
+    trace_timeline::ScopedTask task;
     try {
       fn(a);
     } catch (std::exception& e) {
@@ -33,6 +36,7 @@ template <typename Input, typename Fn>
 struct WithStateWorkQueueHelper {
   Fn fn;
   void operator()(sparta::SpartaWorkerState<Input>* state, Input a) {
+    trace_timeline::ScopedTask task;
     try {
       fn(state, a);
     } catch (std::exception& e) {
@@ -60,13 +64,15 @@ sparta::SpartaWorkQueue<Input,
 workqueue_foreach(
     const Fn& fn,
     unsigned int num_threads = sparta::parallel::default_num_threads(),
-    bool push_tasks_while_running = false) {
+    bool push_tasks_while_running = false,
+    bool work_stealing = false) {
   return sparta::SpartaWorkQueue<
       Input,
       redex_workqueue_impl::NoStateWorkQueueHelper<Input, Fn>>(
       redex_workqueue_impl::NoStateWorkQueueHelper<Input, Fn>{fn},
       num_threads,
-      push_tasks_while_running);
+      push_tasks_while_running,
+      work_stealing);
 }
 template <class Input,
           typename Fn,
@@ -77,11 +83,34 @@ sparta::SpartaWorkQueue<
 workqueue_foreach(
     const Fn& fn,
     unsigned int num_threads = sparta::parallel::default_num_threads(),
-    bool push_tasks_while_running = false) {
+    bool push_tasks_while_running = false,
+    bool work_stealing = false) {
   return sparta::SpartaWorkQueue<
       Input,
       redex_workqueue_impl::WithStateWorkQueueHelper<Input, Fn>>(
       redex_workqueue_impl::WithStateWorkQueueHelper<Input, Fn>{fn},
       num_threads,
-      push_tasks_while_running);
+      push_tasks_while_running,
+      work_stealing);
+}
+
+/*
+ * Joins the partial results in `partials`, e.g. the ones computed by each
+ * thread of a work queue, pairwise and in parallel, until the first one holds
+ * the join of all of them. `join(T* into, T* from)` must be associative.
+ */
+template <typename T, typename Fn>
+void workqueue_tree_reduce(
+    std::vector<T>* partials,
+    const Fn& join,
+    unsigned int num_threads = sparta::parallel::default_num_threads()) {
+  for (size_t stride = 1; stride < partials->size(); stride *= 2) {
+    auto wq = workqueue_foreach<size_t>(
+        [&](size_t i) { join(&(*partials)[i], &(*partials)[i + stride]); },
+        num_threads);
+    for (size_t i = 0; i + stride < partials->size(); i += 2 * stride) {
+      wq.add_item(i);
+    }
+    wq.run_all();
+  }
 }
@@ -0,0 +1,293 @@
+/*
+ * Copyright (c) Facebook, Inc. and its affiliates.
+ *
+ * This source code is licensed under the MIT license found in the
+ * LICENSE file in the root directory of this source tree.
+ */
+
+#include "ZipReader.h"
+
+#include <cstdio>
+#include <cstring>
+#include <stdexcept>
+#include <zlib.h>
+
+#include "Util.h"
+
+namespace {
+static const int kSignatureSize = 4;
+
+static const uint16_t kCompMethodStore(0);
+static const uint16_t kCompMethodDeflate(8);
+
+/* CDFile
+ * Central directory file header entry structures.
+ */
+static const uint8_t kCDFile[] = {'P', 'K', 0x01, 0x02};
+
+PACKED(struct pk_cd_file {
+  uint32_t signature;
+  uint16_t vmade;
+  uint16_t vextract;
+  uint16_t flags;
+  uint16_t comp_method;
+  uint16_t mod_time;
+  uint16_t mod_date;
+  uint32_t crc32;
+  uint32_t comp_size;
+  uint32_t ucomp_size;
+  uint16_t fname_len;
+  uint16_t extra_len;
+  uint16_t comment_len;
+  uint16_t diskno;
+  uint16_t interal_attr;
+  uint32_t external_attr;
+  uint32_t disk_offset;
+});
+
+/* CDirEnd:
+ * End of central directory record structures.
+ */
+static const int kMaxCDirEndSearch = 100;
+static const uint8_t kCDirEnd[] = {'P', 'K', 0x05, 0x06};
+
+PACKED(struct pk_cdir_end {
+  uint32_t signature;
+  uint16_t diskno;
+  uint16_t cd_diskno;
+  uint16_t cd_disk_entries;
+  uint16_t cd_entries;
+  uint32_t cd_size;
+  uint32_t cd_disk_offset;
+  uint16_t comment_len;
+});
+
+/* LFile:
+ * Local file header structures.
+ * (Yes, this made more sense in the world of floppies and tapes.)
+ */
+static const uint8_t kLFile[] = {'P', 'K', 0x03, 0x04};
+
+PACKED(struct pk_lfile {
+  uint32_t signature;
+  uint16_t vextract;
+  uint16_t flags;
+  uint16_t comp_method;
+  uint16_t mod_time;
+  uint16_t mod_date;
+  uint32_t crc32;
+  uint32_t comp_size;
+  uint32_t ucomp_size;
+  uint16_t fname_len;
+  uint16_t extra_len;
+});
+
+bool find_central_directory(const uint8_t* mapping,
+                            ssize_t size,
+                            pk_cdir_end& pce) {
+  ssize_t soffset = (size - sizeof(pk_cdir_end));
+  ssize_t eoffset = soffset - kMaxCDirEndSearch;
+  if (soffset < 0) return false;
+  if (eoffset < 0) eoffset = 0;
+  do {
+    const uint8_t* cdsearch = mapping + soffset;
+    if (memcmp(cdsearch, kCDirEnd, kSignatureSize) == 0) {
+      memcpy(&pce, cdsearch, sizeof(pk_cdir_end));
+      return true;
+    }
+  } while (soffset-- > eoffset);
+  fprintf(stderr, "End of central directory record not found, bailing\n");
+  return false;
+}
+
+bool validate_pce(pk_cdir_end& pce, ssize_t size) {
+  /* We only support a limited feature set.  We
+   * don't support disk-spanning, so bail if that's the case.
+   */
+  if (pce.cd_diskno != pce.diskno || pce.cd_diskno != 0 ||
+      pce.cd_entries != pce.cd_disk_entries) {
+    fprintf(stderr, "Disk spanning is not supported, bailing\n");
+    return false;
+  }
+  ssize_t data_size = size - sizeof(pk_cdir_end);
+  if (pce.cd_disk_offset + pce.cd_size > data_size) {
+    fprintf(stderr, "Central directory overflow, invalid pce structure\n");
+    return false;
+  }
+  return true;
+}
+
+bool extract_entry(const uint8_t*& mapping,
+                   const uint8_t* cdir_end,
+                   ZipReader::Entry& entry) {
+  if (mapping + sizeof(pk_cd_file) > cdir_end ||
+      memcmp(mapping, kCDFile, kSignatureSize) != 0) {
+    fprintf(stderr, "Invalid central directory entry, bailing\n");
+    return false;
+  }
+  pk_cd_file cd_entry;
+  memcpy(&cd_entry, mapping, sizeof(pk_cd_file));
+  mapping += sizeof(pk_cd_file);
+  if (mapping + cd_entry.fname_len > cdir_end) {
+    fprintf(stderr, "Invalid central directory entry, bailing\n");
+    return false;
+  }
+  entry.name.assign(reinterpret_cast<const char*>(mapping),
+                    cd_entry.fname_len);
+  entry.comp_method = cd_entry.comp_method;
+  entry.comp_size = cd_entry.comp_size;
+  entry.ucomp_size = cd_entry.ucomp_size;
+  entry.local_header_offset = cd_entry.disk_offset;
+  mapping += cd_entry.fname_len;
+  mapping += cd_entry.extra_len;
+  mapping += cd_entry.comment_len;
+  return true;
+}
+
+int zip_uncompress(Bytef* dest,
+                   uLongf* destLen,
+                   const Bytef* source,
+                   uLong sourceLen) {
+  z_stream stream;
+  int err;
+
+  stream.next_in = (Bytef*)source;
+  stream.avail_in = (uInt)sourceLen;
+  stream.next_out = dest;
+  stream.avail_out = (uInt)*destLen;
+  stream.zalloc = (alloc_func)0;
+  stream.zfree = (free_func)0;
+
+  err = inflateInit2(&stream, -MAX_WBITS);
+  if (err != Z_OK) return err;
+
+  err = inflate(&stream, Z_FINISH);
+  if (err != Z_STREAM_END) {
+    inflateEnd(&stream);
+    return err;
+  }
+  *destLen = stream.total_out;
+
+  err = inflateEnd(&stream);
+  return err;
+}
+
+} // namespace
+
+bool ZipReader::Entry::is_stored() const {
+  return comp_method == kCompMethodStore;
+}
+
+ZipReader::ZipReader(const std::string& path) {
+  try {
+    m_file.open(path);
+  } catch (const std::exception&) {
+    throw std::runtime_error("Cannot map zip file: " + path);
+  }
+  pk_cdir_end pce;
+  ssize_t size = m_file.size();
+  if (!find_central_directory(data(), size, pce) || !validate_pce(pce, size)) {
+    throw std::runtime_error("Cannot read zip file: " + path);
+  }
+  const uint8_t* cdir = data() + pce.cd_disk_offset;
+  const uint8_t* cdir_end = cdir + pce.cd_size;
+  m_entries.resize(pce.cd_entries);
+  for (size_t i = 0; i < m_entries.size(); i++) {
+    if (!extract_entry(cdir, cdir_end, m_entries[i])) {
+      throw std::runtime_error("Cannot read zip file: " + path);
+    }
+    // The first entry wins if a name is repeated.
+    m_entry_indices.emplace(m_entries[i].name, i);
+  }
+}
+
+const ZipReader::Entry* ZipReader::find_entry(const std::string& name) const {
+  auto it = m_entry_indices.find(name);
+  return it == m_entry_indices.end() ? nullptr : &m_entries[it->second];
+}
+
+const uint8_t* ZipReader::get_local_contents(const Entry& entry) const {
+  if (entry.local_header_offset + sizeof(pk_lfile) > size()) {
+    fprintf(stderr, "Invalid local file entry, bailing\n");
+    return nullptr;
+  }
+  const uint8_t* lfile = data() + entry.local_header_offset;
+  if (memcmp(lfile, kLFile, kSignatureSize) != 0) {
+    fprintf(stderr, "Invalid local file entry, bailing\n");
+    return nullptr;
+  }
+  pk_lfile pkf;
+  memcpy(&pkf, lfile, sizeof(pk_lfile));
+  // The sizes are in a data descriptor after the contents if they weren't
+  // known when the local header was written.
+  if (pkf.comp_size == 0 && pkf.ucomp_size == 0 &&
+      pkf.comp_size != entry.comp_size &&
+      pkf.ucomp_size != entry.ucomp_size) {
+    pkf.comp_size = entry.comp_size;
+    pkf.ucomp_size = entry.ucomp_size;
+  }
+  lfile += sizeof(pk_lfile);
+  if (pkf.fname_len != entry.name.size() ||
+      pkf.comp_size != entry.comp_size ||
+      pkf.ucomp_size != entry.ucomp_size ||
+      pkf.comp_method != entry.comp_method ||
+      lfile + pkf.fname_len > data() + size() ||
+      memcmp(lfile, entry.name.data(), pkf.fname_len) != 0) {
+    fprintf(stderr,
+            "Directory entry doesn't match local file header, "
+            "Bailing %d %d %d %d, %d %d %d %d extra %d\n",
+            pkf.fname_len, pkf.comp_size, pkf.ucomp_size, pkf.comp_method,
+            (int)entry.name.size(), entry.comp_size, entry.ucomp_size,
+            entry.comp_method, pkf.extra_len);
+    return nullptr;
+  }
+  lfile += pkf.fname_len;
+  lfile += pkf.extra_len;
+  if (lfile + pkf.comp_size > data() + size()) {
+    fprintf(stderr, "Local file entry overflow, bailing\n");
+    return nullptr;
+  }
+  return lfile;
+}
+
+const uint8_t* ZipReader::get_stored_contents(const Entry& entry) const {
+  if (!entry.is_stored()) {
+    return nullptr;
+  }
+  return get_local_contents(entry);
+}
+
+bool ZipReader::read_entry(const Entry& entry, uint8_t* out) const {
+  if (!entry.is_stored() && entry.comp_method != kCompMethodDeflate) {
+    fprintf(stderr, "Unknown compression method %d, Bailing\n",
+            entry.comp_method);
+    return false;
+  }
+  const uint8_t* contents = get_local_contents(entry);
+  if (contents == nullptr) {
+    return false;
+  }
+  if (entry.is_stored()) {
+    memcpy(out, contents, entry.ucomp_size);
+    return true;
+  }
+  uLongf dlen = entry.ucomp_size;
+  int zlibrv = zip_uncompress(out, &dlen, contents, entry.comp_size);
+  if (zlibrv != Z_OK) {
+    fprintf(stderr, "uncompress failed with code %d, Bailing\n", zlibrv);
+    return false;
+  }
+  if (dlen != entry.ucomp_size) {
+    fprintf(stderr, "mis-match on uncompressed size, Bailing\n");
+    return false;
+  }
+  return true;
+}
+
+std::string ZipReader::read_entry(const Entry& entry) const {
+  std::string contents(entry.ucomp_size, '\0');
+  if (!read_entry(entry, reinterpret_cast<uint8_t*>(&contents[0]))) {
+    throw std::runtime_error("Cannot read zip entry: " + entry.name);
+  }
+  return contents;
+}
@@ -0,0 +1,83 @@
+/*
+ * Copyright (c) Facebook, Inc. and its affiliates.
+ *
+ * This source code is licensed under the MIT license found in the
+ * LICENSE file in the root directory of this source tree.
+ */
+
+#pragma once
+
+#include <boost/iostreams/device/mapped_file.hpp>
+#include <cstdint>
+#include <string>
+#include <unordered_map>
+#include <vector>
+
+/*
+ * A zip archive, e.g. a jar or an APK, read from its memory-mapped file, so
+ * that its entries can be used without unpacking it first. The central
+ * directory is parsed upfront; the stored entries are read straight from the
+ * mapping and the deflated ones are inflated when they are read.
+ *
+ * Multi-disk and zip64 archives aren't supported. The const methods may be
+ * called concurrently.
+ */
+class ZipReader {
+ public:
+  struct Entry {
+    std::string name;
+    uint16_t comp_method;
+    uint32_t comp_size;
+    uint32_t ucomp_size;
+    uint32_t local_header_offset;
+
+    bool is_stored() const;
+  };
+
+  /*
+   * Maps the archive and parses its central directory. Throws
+   * std::runtime_error if the file can't be mapped or isn't a supported zip
+   * archive.
+   */
+  explicit ZipReader(const std::string& path);
+
+  ZipReader(const ZipReader&) = delete;
+  ZipReader& operator=(const ZipReader&) = delete;
+
+  const uint8_t* data() const {
+    return reinterpret_cast<const uint8_t*>(m_file.data());
+  }
+  size_t size() const { return m_file.size(); }
+
+  // The entries in the order of the central directory.
+  const std::vector<Entry>& entries() const { return m_entries; }
+
+  // The entry with the given name, or nullptr if there is none.
+  const Entry* find_entry(const std::string& name) const;
+
+  /*
+   * The contents of a stored entry in the mapping, which stay valid as long
+   * as the reader. Returns nullptr for the compressed entries, or if the
+   * entry is malformed.
+   */
+  const uint8_t* get_stored_contents(const Entry& entry) const;
+
+  /*
+   * Copies or inflates the contents of the entry into `out`, which must have
+   * room for its uncompressed size. Returns false if the entry is malformed
+   * or uses an unsupported compression method.
+   */
+  bool read_entry(const Entry& entry, uint8_t* out) const;
+
+  // Same as above, but throws std::runtime_error on failure.
+  std::string read_entry(const Entry& entry) const;
+
+ private:
+  // The start of the (possibly compressed) data of the entry, after checking
+  // that its local header agrees with the central directory.
+  const uint8_t* get_local_contents(const Entry& entry) const;
+
+  boost::iostreams::mapped_file_source m_file;
+  std::vector<Entry> m_entries;
+  std::unordered_map<std::string, size_t> m_entry_indices;
+};
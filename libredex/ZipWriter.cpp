@@ -0,0 +1,247 @@
+/*
+ * Copyright (c) Facebook, Inc. and its affiliates.
+ *
+ * This source code is licensed under the MIT license found in the
+ * LICENSE file in the root directory of this source tree.
+ */
+
+#include "ZipWriter.h"
+
+#include <algorithm>
+#include <fstream>
+#include <iterator>
+#include <limits>
+#include <stdexcept>
+#include <zlib.h>
+
+// Sparta uses assert, which Debug.h undefines.
+#include "WorkQueue.h"
+
+#include "Debug.h"
+
+namespace {
+
+constexpr uint16_t kCompMethodStore = 0;
+constexpr uint16_t kCompMethodDeflate = 8;
+
+constexpr uint32_t kLFileSignature = 0x04034b50;
+constexpr uint32_t kCDFileSignature = 0x02014b50;
+constexpr uint32_t kCDirEndSignature = 0x06054b50;
+constexpr size_t kLFileHeaderSize = 30;
+
+// 1980-01-01 00:00, the earliest DOS date, so that the archive only depends
+// on its entries.
+constexpr uint16_t kModTime = 0;
+constexpr uint16_t kModDate = (1 << 5) | 1;
+
+// The entries above this size are deflated in chunks of this size in
+// parallel.
+constexpr size_t kChunkSize = 1 << 20;
+// Each chunk is primed with this much of the end of the previous one, the
+// size of the deflate window.
+constexpr size_t kDictionarySize = 32 * 1024;
+
+void put16(std::string& out, uint16_t value) {
+  out.push_back(static_cast<char>(value & 0xff));
+  out.push_back(static_cast<char>(value >> 8));
+}
+
+void put32(std::string& out, uint32_t value) {
+  put16(out, value & 0xffff);
+  put16(out, value >> 16);
+}
+
+/*
+ * Deflates a chunk into a raw deflate stream. The streams of consecutive
+ * chunks can be concatenated, as all but the last one end with a sync flush
+ * instead of a final block.
+ */
+std::string deflate_chunk(const uint8_t* dictionary,
+                          size_t dictionary_size,
+                          const uint8_t* data,
+                          size_t size,
+                          bool is_last) {
+  z_stream stream{};
+  always_assert(deflateInit2(&stream, Z_DEFAULT_COMPRESSION, Z_DEFLATED,
+                             -MAX_WBITS, 8, Z_DEFAULT_STRATEGY) == Z_OK);
+  if (dictionary_size != 0) {
+    always_assert(deflateSetDictionary(&stream, dictionary, dictionary_size) ==
+                  Z_OK);
+  }
+  // The bound doesn't account for the marker of a sync flush.
+  std::string out(deflateBound(&stream, size) + 16, '\0');
+  stream.next_in = const_cast<Bytef*>(data);
+  stream.avail_in = size;
+  stream.next_out = reinterpret_cast<Bytef*>(&out[0]);
+  stream.avail_out = out.size();
+  int err = deflate(&stream, is_last ? Z_FINISH : Z_SYNC_FLUSH);
+  always_assert_log(err == (is_last ? Z_STREAM_END : Z_OK) &&
+                        stream.avail_in == 0 && stream.avail_out != 0,
+                    "deflate failed with code %d", err);
+  out.resize(stream.total_out);
+  deflateEnd(&stream);
+  return out;
+}
+
+} // namespace
+
+ZipWriter::ZipWriter(const std::string& path) : m_path(path) {
+  m_file = fopen(path.c_str(), "wb");
+  if (m_file == nullptr) {
+    throw std::runtime_error("Cannot create zip file: " + path);
+  }
+}
+
+ZipWriter::~ZipWriter() {
+  if (m_file != nullptr) {
+    fclose(m_file);
+  }
+}
+
+void ZipWriter::add_entry(const std::string& name,
+                          const uint8_t* data,
+                          size_t size,
+                          bool compress) {
+  always_assert_log(size <= std::numeric_limits<uint32_t>::max(),
+                    "%s is too big for a zip archive", name.c_str());
+  Entry entry;
+  entry.name = name;
+  entry.ucomp_size = size;
+  if (!compress) {
+    entry.comp_method = kCompMethodStore;
+    entry.crc32 = crc32(0, data, size);
+    entry.data.assign(reinterpret_cast<const char*>(data), size);
+  } else {
+    entry.comp_method = kCompMethodDeflate;
+    size_t num_chunks = std::max<size_t>((size + kChunkSize - 1) / kChunkSize,
+                                         1);
+    std::vector<std::string> chunks(num_chunks);
+    std::vector<uint32_t> crcs(num_chunks);
+    auto deflate_one = [&](size_t i) {
+      size_t begin = i * kChunkSize;
+      size_t end = std::min(begin + kChunkSize, size);
+      size_t dictionary_size = std::min(begin, kDictionarySize);
+      chunks[i] = deflate_chunk(data + begin - dictionary_size,
+                                dictionary_size, data + begin, end - begin,
+                                i + 1 == num_chunks);
+      crcs[i] = crc32(0, data + begin, end - begin);
+    };
+    if (num_chunks == 1) {
+      deflate_one(0);
+    } else {
+      auto wq = workqueue_foreach<size_t>(
+          deflate_one,
+          std::min<size_t>(num_chunks, redex_parallel::default_num_threads()));
+      for (size_t i = 0; i < num_chunks; i++) {
+        wq.add_item(i);
+      }
+      wq.run_all();
+    }
+    entry.crc32 = crcs[0];
+    for (size_t i = 1; i < num_chunks; i++) {
+      size_t chunk_size = std::min(kChunkSize, size - i * kChunkSize);
+      entry.crc32 = crc32_combine(entry.crc32, crcs[i], chunk_size);
+    }
+    size_t comp_size = 0;
+    for (const auto& chunk : chunks) {
+      comp_size += chunk.size();
+    }
+    entry.data.reserve(comp_size);
+    for (const auto& chunk : chunks) {
+      entry.data += chunk;
+    }
+  }
+  always_assert_log(entry.data.size() <= std::numeric_limits<uint32_t>::max(),
+                    "%s is too big for a zip archive", name.c_str());
+  std::lock_guard<std::mutex> lock(m_entries_mutex);
+  m_entries.push_back(std::move(entry));
+}
+
+void ZipWriter::add_file(const std::string& name,
+                         const std::string& path,
+                         bool compress) {
+  std::ifstream in(path, std::ios::binary);
+  always_assert_log(in, "Cannot read %s", path.c_str());
+  std::string contents((std::istreambuf_iterator<char>(in)),
+                       std::istreambuf_iterator<char>());
+  add_entry(name, reinterpret_cast<const uint8_t*>(contents.data()),
+            contents.size(), compress);
+}
+
+void ZipWriter::finish() {
+  always_assert_log(m_entries.size() <= std::numeric_limits<uint16_t>::max(),
+                    "Too many entries for a zip archive: %zu",
+                    m_entries.size());
+  std::stable_sort(
+      m_entries.begin(), m_entries.end(),
+      [](const Entry& a, const Entry& b) { return a.name < b.name; });
+
+  auto write = [&](const std::string& bytes) {
+    always_assert_log(
+        fwrite(bytes.data(), 1, bytes.size(), m_file) == bytes.size(),
+        "Error writing %s", m_path.c_str());
+  };
+  auto put_common_fields = [](std::string& out, const Entry& entry) {
+    put16(out, entry.comp_method == kCompMethodStore ? 10 : 20);
+    put16(out, 0);
+    put16(out, entry.comp_method);
+    put16(out, kModTime);
+    put16(out, kModDate);
+    put32(out, entry.crc32);
+    put32(out, entry.data.size());
+    put32(out, entry.ucomp_size);
+    put16(out, entry.name.size());
+  };
+
+  uint64_t offset = 0;
+  std::string central_directory;
+  for (const auto& entry : m_entries) {
+    always_assert_log(offset <= std::numeric_limits<uint32_t>::max(),
+                      "%s is too big for a zip archive", m_path.c_str());
+    // Pad the extra field of the stored entries to align their contents.
+    size_t padding = 0;
+    if (entry.comp_method == kCompMethodStore) {
+      padding = (4 - (offset + kLFileHeaderSize + entry.name.size()) % 4) % 4;
+    }
+    std::string header;
+    put32(header, kLFileSignature);
+    put_common_fields(header, entry);
+    put16(header, padding);
+    header += entry.name;
+    header.append(padding, '\0');
+    write(header);
+    write(entry.data);
+
+    put32(central_directory, kCDFileSignature);
+    put16(central_directory, 20);
+    put_common_fields(central_directory, entry);
+    put16(central_directory, 0); // extra field
+    put16(central_directory, 0); // comment
+    put16(central_directory, 0); // disk number
+    put16(central_directory, 0); // internal attributes
+    put32(central_directory, 0); // external attributes
+    put32(central_directory, offset);
+    central_directory += entry.name;
+
+    offset += header.size() + entry.data.size();
+  }
+  always_assert_log(
+      offset + central_directory.size() <= std::numeric_limits<uint32_t>::max(),
+      "%s is too big for a zip archive", m_path.c_str());
+  write(central_directory);
+
+  std::string end;
+  put32(end, kCDirEndSignature);
+  put16(end, 0);
+  put16(end, 0);
+  put16(end, m_entries.size());
+  put16(end, m_entries.size());
+  put32(end, central_directory.size());
+  put32(end, offset);
+  put16(end, 0);
+  write(end);
+
+  always_assert_log(fclose(m_file) == 0, "Error writing %s", m_path.c_str());
+  m_file = nullptr;
+  m_entries.clear();
+}
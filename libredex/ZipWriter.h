@@ -0,0 +1,70 @@
+/*
+ * Copyright (c) Facebook, Inc. and its affiliates.
+ *
+ * This source code is licensed under the MIT license found in the
+ * LICENSE file in the root directory of this source tree.
+ */
+
+#pragma once
+
+#include <cstdint>
+#include <cstdio>
+#include <mutex>
+#include <string>
+#include <vector>
+
+/*
+ * Writes a zip archive, e.g. an APK or a jar of secondary dexes, without
+ * going through loose files and a separate compression step.
+ *
+ * The entries are deflated as they are added, so that threads which produce
+ * entries concurrently, e.g. the dex writers, also compress them
+ * concurrently. A big entry is additionally split into chunks which are
+ * deflated in parallel, like pigz does, each one primed with the end of the
+ * previous chunk so that the compression barely suffers.
+ *
+ * The archive is written by finish(), with the entries sorted by name so
+ * that it doesn't depend on the order in which they were added. As with
+ * zipalign, the contents of the stored entries are 4-byte aligned.
+ */
+class ZipWriter {
+ public:
+  // Throws std::runtime_error if the file can't be created.
+  explicit ZipWriter(const std::string& path);
+  ~ZipWriter();
+
+  ZipWriter(const ZipWriter&) = delete;
+  ZipWriter& operator=(const ZipWriter&) = delete;
+
+  /*
+   * Adds an entry with a copy of the given contents, deflated unless
+   * `compress` is false. May be called concurrently.
+   */
+  void add_entry(const std::string& name,
+                 const uint8_t* data,
+                 size_t size,
+                 bool compress = true);
+
+  // Same as above, with the contents of a file.
+  void add_file(const std::string& name,
+                const std::string& path,
+                bool compress = true);
+
+  // Writes the entries and the central directory, and closes the archive.
+  void finish();
+
+ private:
+  struct Entry {
+    std::string name;
+    uint16_t comp_method;
+    uint32_t crc32;
+    uint32_t ucomp_size;
+    // The contents, as they are stored in the archive.
+    std::string data;
+  };
+
+  std::string m_path;
+  FILE* m_file;
+  std::mutex m_entries_mutex;
+  std::vector<Entry> m_entries;
+};
@@ -0,0 +1,195 @@
+/*
+ * Copyright (c) Facebook, Inc. and its affiliates.
+ *
+ * This source code is licensed under the MIT license found in the
+ * LICENSE file in the root directory of this source tree.
+ */
+
+#include "BlockProfileLayout.h"
+
+#include <algorithm>
+#include <unordered_set>
+
+#include "ControlFlow.h"
+#include "DexClass.h"
+#include "IRCode.h"
+#include "PassManager.h"
+#include "Walkers.h"
+
+namespace {
+
+// Smaller switches are as cheap to dispatch as the compares that would
+// replace them.
+constexpr size_t kMinCasesToHoist = 4;
+
+/*
+ * Tests the cases of a big switch that ran before the switch, when there are
+ * at most max_hot_cases of them, e.g. for a dispatch loop that mostly sees a
+ * couple of messages:
+ *
+ *   CONST v_key, [key]
+ *   IF_EQ v_value, v_key, :case
+ *   ...
+ *   SWITCH v_value
+ *
+ * The switch keeps all its cases, and its lowering still picks the most
+ * compact encoding for it. Returns the number of hoisted cases.
+ */
+size_t hoist_hot_switch_cases(cfg::ControlFlowGraph& cfg,
+                              const std::unordered_set<cfg::BlockId>& cold,
+                              size_t max_hot_cases) {
+  size_t hoisted = 0;
+  for (cfg::Block* block : cfg.blocks()) {
+    auto switch_it = block->get_last_insn();
+    if (switch_it == block->end() ||
+        !is_switch(switch_it->insn->opcode())) {
+      continue;
+    }
+    std::vector<std::pair<int32_t, cfg::Block*>> hot_cases;
+    size_t num_cases = 0;
+    for (cfg::Edge* e : block->succs()) {
+      if (e->type() != cfg::EDGE_BRANCH) {
+        continue;
+      }
+      num_cases++;
+      if (!cold.count(e->target()->id())) {
+        hot_cases.emplace_back(*e->case_key(), e->target());
+      }
+    }
+    if (num_cases < kMinCasesToHoist || hot_cases.empty() ||
+        hot_cases.size() > max_hot_cases) {
+      continue;
+    }
+    std::sort(hot_cases.begin(), hot_cases.end());
+    reg_t value = switch_it->insn->src(0);
+
+    // Separate the switch from the instructions before it, if any.
+    cfg::Block* switch_block = block;
+    auto prev_it = block->end();
+    for (auto it = block->begin(); it != switch_it; ++it) {
+      if (it->type == MFLOW_OPCODE) {
+        prev_it = it;
+      }
+    }
+    if (prev_it == block->end() && block == cfg.entry_block()) {
+      continue;
+    }
+    if (prev_it != block->end()) {
+      switch_block = cfg.split_block(block, prev_it);
+    }
+
+    // Chain the tests, from the last one to the first one.
+    cfg::Block* next = switch_block;
+    for (auto it = hot_cases.rbegin(); it != hot_cases.rend(); ++it) {
+      cfg::Block* test = cfg.create_block();
+      IRInstruction* if_insn;
+      if (it->first == 0) {
+        if_insn = (new IRInstruction(OPCODE_IF_EQZ))->set_src(0, value);
+      } else {
+        reg_t key = cfg.allocate_temp();
+        test->push_back((new IRInstruction(OPCODE_CONST))
+                            ->set_literal(it->first)
+                            ->set_dest(key));
+        if_insn = (new IRInstruction(OPCODE_IF_EQ))
+                      ->set_src(0, value)
+                      ->set_src(1, key);
+      }
+      cfg.create_branch(test, if_insn, next, it->second);
+      next = test;
+    }
+    if (switch_block != block) {
+      cfg.set_edge_target(cfg.get_succ_edge_of_type(block, cfg::EDGE_GOTO),
+                          next);
+    } else {
+      for (cfg::Edge* e : std::vector<cfg::Edge*>(block->preds())) {
+        cfg.set_edge_target(e, next);
+      }
+    }
+    hoisted += hot_cases.size();
+  }
+  return hoisted;
+}
+
+} // namespace
+
+BlockProfileLayoutPass::Stats& BlockProfileLayoutPass::Stats::operator+=(
+    const Stats& that) {
+  methods_laid_out += that.methods_laid_out;
+  methods_mismatched += that.methods_mismatched;
+  cold_blocks += that.cold_blocks;
+  hoisted_switch_cases += that.hoisted_switch_cases;
+  return *this;
+}
+
+BlockProfileLayoutPass::Stats BlockProfileLayoutPass::process_code(
+    IRCode* code,
+    const basic_block_profiles::MethodCoverage& coverage,
+    size_t max_hoisted_switch_cases) {
+  Stats stats;
+  if (!coverage.any_ran()) {
+    return stats;
+  }
+
+  // Find the instructions of the blocks that didn't run, in the CFG that the
+  // profile describes.
+  std::unordered_set<const IRInstruction*> cold_insns;
+  if (!basic_block_profiles::gather_cold_instructions(code, coverage,
+                                                      &cold_insns)) {
+    stats.methods_mismatched = 1;
+    return stats;
+  }
+
+  // The editable CFG has different blocks, but the same instructions.
+  code->build_cfg(/* editable */ true);
+  auto& cfg = code->cfg();
+  std::unordered_set<cfg::BlockId> cold_blocks;
+  for (cfg::Block* block : cfg.blocks()) {
+    auto ii = InstructionIterable(block);
+    if (ii.empty()) {
+      continue;
+    }
+    if (std::all_of(ii.begin(), ii.end(), [&](const MethodItemEntry& mie) {
+          return cold_insns.count(mie.insn);
+        })) {
+      cold_blocks.insert(block->id());
+    }
+  }
+  if (max_hoisted_switch_cases > 0) {
+    stats.hoisted_switch_cases =
+        hoist_hot_switch_cases(cfg, cold_blocks, max_hoisted_switch_cases);
+  }
+  stats.methods_laid_out = 1;
+  stats.cold_blocks = cold_blocks.size();
+  cfg.set_cold_blocks(std::move(cold_blocks));
+  code->clear_cfg();
+  return stats;
+}
+
+void BlockProfileLayoutPass::run_pass(DexStoresVector& stores,
+                                      ConfigFiles&,
+                                      PassManager& mgr) {
+  if (m_index_filename.empty() || m_stats_filename.empty()) {
+    TRACE(METH_PROF, 1, "BlockProfileLayoutPass: no profile given");
+    return;
+  }
+  basic_block_profiles::BasicBlockProfiles profiles;
+  always_assert_log(profiles.initialize(m_index_filename, m_stats_filename),
+                    "Cannot load the basic block profile %s, %s",
+                    m_index_filename.c_str(), m_stats_filename.c_str());
+
+  const auto& scope = build_class_scope(stores);
+  auto stats = walk::parallel::methods<Stats>(scope, [&](DexMethod* method) {
+    auto code = method->get_code();
+    auto coverage = profiles.get(method);
+    if (code == nullptr || coverage == nullptr) {
+      return Stats{};
+    }
+    return process_code(code, *coverage, m_max_hoisted_switch_cases);
+  });
+  mgr.set_metric("methods_laid_out", stats.methods_laid_out);
+  mgr.set_metric("methods_mismatched", stats.methods_mismatched);
+  mgr.set_metric("cold_blocks", stats.cold_blocks);
+  mgr.set_metric("hoisted_switch_cases", stats.hoisted_switch_cases);
+}
+
+static BlockProfileLayoutPass s_pass;
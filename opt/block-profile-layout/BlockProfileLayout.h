@@ -0,0 +1,57 @@
+/*
+ * Copyright (c) Facebook, Inc. and its affiliates.
+ *
+ * This source code is licensed under the MIT license found in the
+ * LICENSE file in the root directory of this source tree.
+ */
+
+#pragma once
+
+#include "BasicBlockProfiles.h"
+#include "Pass.h"
+
+/*
+ * Lays out the blocks of the profiled methods from the output of
+ * InstrumentPass's basic_block_tracing: the blocks that never ran, such as
+ * exception paths, are moved after all the others, and the successor that ran
+ * becomes the fallthrough of a conditional branch. The few cases of a big
+ * switch that ran are tested before it.
+ *
+ * The profile numbers the blocks of the non-editable CFG of each method as
+ * InstrumentPass saw it, so this pass must run at the position InstrumentPass
+ * had in the instrumented build. Methods whose number of blocks changed since
+ * are left alone.
+ */
+class BlockProfileLayoutPass : public Pass {
+ public:
+  struct Stats {
+    size_t methods_laid_out{0};
+    size_t methods_mismatched{0};
+    size_t cold_blocks{0};
+    size_t hoisted_switch_cases{0};
+
+    Stats& operator+=(const Stats&);
+  };
+
+  BlockProfileLayoutPass() : Pass("BlockProfileLayoutPass") {}
+
+  void bind_config() override {
+    bind("basic_block_index_file", "", m_index_filename,
+         "The metadata file written by basic_block_tracing.");
+    bind("basic_block_stats_file", "", m_stats_filename,
+         "The collected sBasicBlockStats, as \"<index>,<value>\" lines.");
+    bind("max_hoisted_switch_cases", 2u, m_max_hoisted_switch_cases,
+         "Switches with at most this many cases that ran test them first.");
+  }
+
+  void run_pass(DexStoresVector&, ConfigFiles&, PassManager&) override;
+
+  static Stats process_code(IRCode*,
+                            const basic_block_profiles::MethodCoverage&,
+                            size_t max_hoisted_switch_cases = 0);
+
+ private:
+  std::string m_index_filename;
+  std::string m_stats_filename;
+  unsigned int m_max_hoisted_switch_cases;
+};
@@ -19,6 +19,8 @@ class CheckBreadcrumbsPass : public Pass {
  public:
   CheckBreadcrumbsPass() : Pass("CheckBreadcrumbsPass") {}
 
+  bool is_read_only() const override { return true; }
+
   void bind_config() override {
     bind("fail", false, fail);
     bind("fail_if_illegal_refs", false, fail_if_illegal_refs);
@@ -22,6 +22,7 @@
 #include "ClassSplitting.h"
 
 #include <algorithm>
+#include <map>
 #include <vector>
 
 #include "ApiLevelChecker.h"
@@ -37,6 +38,7 @@
 #include "PluginRegistry.h"
 #include "Resolver.h"
 #include "Walkers.h"
+#include "WorkQueue.h"
 
 namespace {
 
@@ -72,6 +74,21 @@ struct ClassSplittingStats {
   size_t popular_methods{0};
 };
 
+// The number of methods per limitation metric.
+using Limitations = std::map<std::string, size_t>;
+
+struct RelocationCandidate {
+  DexMethod* method;
+  bool requires_trampoline;
+  int32_t api_level;
+};
+
+struct ClassAnalysis {
+  bool relocatable{false};
+  std::vector<RelocationCandidate> candidates;
+  Limitations limitations;
+};
+
 class ClassSplittingInterDexPlugin : public interdex::InterDexPassPlugin {
  public:
   ClassSplittingInterDexPlugin(
@@ -82,19 +99,21 @@ class ClassSplittingInterDexPlugin : public interdex::InterDexPassPlugin {
 
   void configure(const Scope& scope, ConfigFiles& conf) override {
     if (m_method_profiles.has_stats()) {
-      for (auto& p : m_method_profiles.all_interactions()) {
-        auto& method_stats = p.second;
-        walk::methods(scope, [&](DexMethod* method) {
-          auto it = method_stats.find(method);
-          if (it == method_stats.end()) {
-            return;
-          }
-          if (it->second.appear_percent >=
-              m_config.method_profiles_appear_percent_threshold) {
-            m_sufficiently_popular_methods.insert(method);
-          }
-        });
-      }
+      using Methods = std::unordered_set<DexMethod*>;
+      m_sufficiently_popular_methods =
+          walk::parallel::methods<Methods, MergeContainers<Methods>>(
+              scope, [&](DexMethod* method, Methods* acc) {
+                for (auto& p : m_method_profiles.all_interactions()) {
+                  auto& method_stats = p.second;
+                  auto it = method_stats.find(method);
+                  if (it != method_stats.end() &&
+                      it->second.appear_percent >=
+                          m_config.method_profiles_appear_percent_threshold) {
+                    acc->insert(method);
+                    return;
+                  }
+                }
+              });
     }
     if (m_config.relocate_non_true_virtual_methods) {
       m_non_true_virtual_methods =
@@ -169,32 +188,63 @@ class ClassSplittingInterDexPlugin : public interdex::InterDexPassPlugin {
     return trampoline_target_method;
   }
 
-  void prepare(const DexClass* cls,
-               std::vector<DexMethodRef*>* mrefs,
-               std::vector<DexType*>* trefs,
-               bool should_not_relocate_methods_of_class) {
+  /*
+   * Finds the methods of the class that can be relocated. This only reads the
+   * class and its code, so that it can run for many classes in parallel.
+   */
+  ClassAnalysis analyze(const DexClass* cls,
+                        bool should_not_relocate_methods_of_class) const {
+    ClassAnalysis analysis;
     // Bail out if we just cannot or should not relocate methods of this class.
     if (!can_relocate(cls) || should_not_relocate_methods_of_class) {
-      return;
+      return analysis;
     }
+    analysis.relocatable = true;
     auto cls_has_clinit = !!cls->get_clinit();
-
-    SplitClass& sc = m_split_classes[cls];
-    always_assert(sc.relocatable_methods.empty());
     auto process_method = [&](DexMethod* method) {
       if (m_sufficiently_popular_methods.count(method)) {
         return;
       }
       bool requires_trampoline{false};
-      if (!can_relocate(cls_has_clinit, method, /* log */ true,
+      if (!can_relocate(cls_has_clinit, method, &analysis.limitations,
                         &requires_trampoline)) {
         return;
       }
       if (requires_trampoline && !m_config.trampolines) {
         return;
       }
-      DexClass* target_cls;
       int api_level = api::LevelChecker::get_method_level(method);
+      analysis.candidates.push_back({method, requires_trampoline, api_level});
+    };
+    auto& dmethods = cls->get_dmethods();
+    std::for_each(dmethods.begin(), dmethods.end(), process_method);
+    auto& vmethods = cls->get_vmethods();
+    std::for_each(vmethods.begin(), vmethods.end(), process_method);
+    return analysis;
+  }
+
+  /*
+   * Assigns the relocatable methods of the class to target classes, creating
+   * them and the trampolines as needed. The target classes depend on the
+   * classes committed before, so this must run in the order of the classes.
+   */
+  void commit(const DexClass* cls,
+              const ClassAnalysis& analysis,
+              std::vector<DexMethodRef*>* mrefs,
+              std::vector<DexType*>* trefs) {
+    for (auto& p : analysis.limitations) {
+      m_mgr.incr_metric(p.first, p.second);
+    }
+    if (!analysis.relocatable) {
+      return;
+    }
+
+    SplitClass& sc = m_split_classes[cls];
+    always_assert(sc.relocatable_methods.empty());
+    for (auto& candidate : analysis.candidates) {
+      auto method = candidate.method;
+      auto api_level = candidate.api_level;
+      DexClass* target_cls;
       if (m_config.combine_target_classes_by_api_level) {
         TargetClassInfo& target_class_info =
             m_target_classes_by_api_level[api_level];
@@ -227,7 +277,7 @@ class ClassSplittingInterDexPlugin : public interdex::InterDexPassPlugin {
         }
       }
       DexMethod* trampoline_target_method = nullptr;
-      if (requires_trampoline) {
+      if (candidate.requires_trampoline) {
         trampoline_target_method =
             create_trampoline_method(method, target_cls, api_level);
       }
@@ -241,11 +291,36 @@ class ClassSplittingInterDexPlugin : public interdex::InterDexPassPlugin {
       }
       TRACE(CS, 4, "[class splitting] Method {%s} will be relocated to {%s}",
             SHOW(method), SHOW(target_cls));
-    };
-    auto& dmethods = cls->get_dmethods();
-    std::for_each(dmethods.begin(), dmethods.end(), process_method);
-    auto& vmethods = cls->get_vmethods();
-    std::for_each(vmethods.begin(), vmethods.end(), process_method);
+    }
+  }
+
+  void prepare(const DexClass* cls,
+               std::vector<DexMethodRef*>* mrefs,
+               std::vector<DexType*>* trefs,
+               bool should_not_relocate_methods_of_class) {
+    commit(cls, analyze(cls, should_not_relocate_methods_of_class), mrefs,
+           trefs);
+  }
+
+  /*
+   * Same as calling prepare() on each class in order, without refs, but the
+   * classes are analyzed in parallel.
+   */
+  void prepare(const std::vector<DexClass*>& classes,
+               const std::vector<bool>& should_not_relocate_methods_of_class) {
+    std::vector<ClassAnalysis> analyses(classes.size());
+    auto wq = workqueue_foreach<size_t>([&](size_t i) {
+      analyses[i] =
+          analyze(classes[i], should_not_relocate_methods_of_class[i]);
+    });
+    for (size_t i = 0; i < classes.size(); i++) {
+      wq.add_item(i);
+    }
+    wq.run_all();
+    for (size_t i = 0; i < classes.size(); i++) {
+      commit(classes[i], analyses[i], nullptr /* mrefs */,
+             nullptr /* trefs */);
+    }
   }
 
   DexClasses additional_classes(const DexClassesVector& outdex,
@@ -294,8 +369,8 @@ class ClassSplittingInterDexPlugin : public interdex::InterDexPassPlugin {
         }
         const RelocatableMethodInfo& method_info = it->second;
         bool requires_trampoline{false};
-        if (!can_relocate(cls_has_clinit, method, /* log */ false,
-                          &requires_trampoline)) {
+        if (!can_relocate(cls_has_clinit, method,
+                          /* limitations */ nullptr, &requires_trampoline)) {
           TRACE(CS,
                 4,
                 "[class splitting] Method earlier identified as relocatable is "
@@ -564,61 +639,51 @@ class ClassSplittingInterDexPlugin : public interdex::InterDexPassPlugin {
   ClassSplittingStats m_stats;
   std::unordered_set<DexMethod*> m_non_true_virtual_methods;
 
-  bool can_relocate(const DexClass* cls) {
+  bool can_relocate(const DexClass* cls) const {
     return !cls->is_external() && !cls->rstate.is_generated();
   }
 
+  // The reasons why methods can't be relocated or require a trampoline are
+  // counted in `limitations`, if given.
   bool can_relocate(bool cls_has_clinit,
                     const DexMethod* m,
-                    bool log,
-                    bool* requires_trampoline) {
+                    Limitations* limitations,
+                    bool* requires_trampoline) const {
+    auto log = [limitations](const char* metric) {
+      if (limitations) {
+        ++(*limitations)[metric];
+      }
+    };
     *requires_trampoline = false;
     if (!m->is_concrete() || m->is_external() || !m->get_code()) {
       return false;
     }
     if (!can_rename(m)) {
-      if (log) {
-        m_mgr.incr_metric("num_class_splitting_limitation_cannot_rename", 1);
-      }
+      log("num_class_splitting_limitation_cannot_rename");
       *requires_trampoline = true;
     }
     if (root(m)) {
-      if (log) {
-        m_mgr.incr_metric("num_class_splitting_limitation_root", 1);
-      }
+      log("num_class_splitting_limitation_root");
       *requires_trampoline = true;
     }
     if (m->rstate.no_optimizations()) {
-      if (log) {
-        m_mgr.incr_metric("num_class_splitting_limitation_no_optimizations", 1);
-      }
+      log("num_class_splitting_limitation_no_optimizations");
       return false;
     }
     if (!gather_invoked_methods_that_prevent_relocation(m)) {
-      if (log) {
-        m_mgr.incr_metric(
-            "num_class_splitting_limitation_invoked_methods_prevent_relocation",
-            1);
-      }
+      log("num_class_splitting_limitation_invoked_methods_prevent_relocation");
       return false;
     }
     if (!can_change_visibility_for_relocation(m)) {
-      if (log) {
-        m_mgr.incr_metric(
-            "num_class_splitting_limitation_cannot_change_visibility", 1);
-      }
+      log("num_class_splitting_limitation_cannot_change_visibility");
       return false;
     }
     if (!method::no_invoke_super(m)) {
-      if (log) {
-        m_mgr.incr_metric("num_class_splitting_limitation_invoke_super", 1);
-      }
+      log("num_class_splitting_limitation_invoke_super");
       return false;
     }
     if (m->rstate.is_generated()) {
-      if (log) {
-        m_mgr.incr_metric("num_class_splitting_limitation_generated", 1);
-      }
+      log("num_class_splitting_limitation_generated");
       return false;
     }
 
@@ -627,19 +692,12 @@ class ClassSplittingInterDexPlugin : public interdex::InterDexPassPlugin {
         return false;
       }
       if (cls_has_clinit) {
-        if (log) {
-          m_mgr.incr_metric(
-              "num_class_splitting_limitation_static_method_declaring_class_"
-              "has_clinit",
-              1);
-        }
+        log("num_class_splitting_limitation_static_method_declaring_class_"
+            "has_clinit");
         *requires_trampoline = true;
       }
       if (method::is_clinit(m)) {
-        if (log) {
-          m_mgr.incr_metric(
-              "num_class_splitting_limitation_static_method_is_clinit", 1);
-        }
+        log("num_class_splitting_limitation_static_method_is_clinit");
         // TODO: Could be done with trampolines if we remove "final" flag from
         // fields
         return false;
@@ -649,10 +707,7 @@ class ClassSplittingInterDexPlugin : public interdex::InterDexPassPlugin {
         return false;
       }
       if (method::is_init(m)) {
-        if (log) {
-          m_mgr.incr_metric(
-              "num_class_splitting_limitation_static_method_is_clinit", 1);
-        }
+        log("num_class_splitting_limitation_static_method_is_clinit");
         // TODO: Could be done with trampolines if we remove "final" flag from
         // fields, and carefully deal with super-init calls.
         return false;
@@ -669,10 +724,7 @@ class ClassSplittingInterDexPlugin : public interdex::InterDexPassPlugin {
     }
     if (*requires_trampoline && m->get_code()->sum_opcode_sizes() <
                                     m_config.trampoline_size_threshold) {
-      if (log) {
-        m_mgr.incr_metric(
-            "num_class_splitting_trampoline_size_threshold_not_met", 1);
-      }
+      log("num_class_splitting_trampoline_size_threshold_not_met");
       return false;
     }
     return true;
@@ -737,6 +789,7 @@ void ClassSplittingPass::run_before_interdex(DexStoresVector& stores,
   auto& store = stores.at(0);
   auto& dexen = store.get_dexen();
   DexClasses classes;
+  std::vector<bool> classes_should_not_relocate_methods;
   // We skip the first dex, as that's the primary dex, and we won't split
   // classes in there anyway
   for (size_t dex_nr = 1; dex_nr < dexen.size(); dex_nr++) {
@@ -750,11 +803,11 @@ void ClassSplittingPass::run_before_interdex(DexStoresVector& stores,
         continue;
       }
       classes.push_back(cls);
-      class_splitting_plugin.prepare(cls, nullptr /* mrefs */,
-                                     nullptr /* trefs */,
-                                     should_not_relocate_methods_of_class(cls));
+      classes_should_not_relocate_methods.push_back(
+          should_not_relocate_methods_of_class(cls));
     }
   }
+  class_splitting_plugin.prepare(classes, classes_should_not_relocate_methods);
   auto classes_to_add =
       class_splitting_plugin.additional_classes(dexen, classes);
   dexen.push_back(classes_to_add);
@@ -23,8 +23,16 @@ void ConstantPropagationPass::run_pass(DexStoresVector& stores,
 
   mgr.incr_metric("num_branches_forwarded", stats.branches_forwarded);
   mgr.incr_metric("num_branch_propagated", stats.branches_removed);
+  mgr.incr_metric("num_range_checks_removed", stats.range_checks_removed);
   mgr.incr_metric("num_materialized_consts", stats.materialized_consts);
   mgr.incr_metric("num_throws", stats.throws);
+  mgr.incr_metric("num_unchanged_cache_hits", stats.unchanged_cache_hits);
+  mgr.incr_metric("num_unchanged_cache_misses", stats.unchanged_cache_misses);
+  auto lookups = stats.unchanged_cache_hits + stats.unchanged_cache_misses;
+  if (lookups > 0) {
+    mgr.incr_metric("unchanged_cache_hit_rate_percent",
+                    stats.unchanged_cache_hits * 100 / lookups);
+  }
 
   TRACE(CONSTP, 1, "num_branch_propagated: %d", stats.branches_removed);
   TRACE(CONSTP,
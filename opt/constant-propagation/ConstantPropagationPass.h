@@ -21,6 +21,14 @@ class ConstantPropagationPass : public Pass {
          true,
          m_config.transform.replace_moves_with_consts);
     bind("remove_dead_switch", true, m_config.transform.remove_dead_switch);
+    bind("remove_redundant_range_checks",
+         false,
+         m_config.remove_redundant_range_checks);
+    bind("sparse_analysis_min_size",
+         m_config.sparse_analysis_min_size,
+         m_config.sparse_analysis_min_size,
+         "Use the sparse engine for the methods whose number of blocks times "
+         "number of registers is at least this; 0 disables it.");
   }
 
   void run_pass(DexStoresVector& stores,
@@ -97,14 +97,20 @@ class AnalyzerGenerator {
  */
 std::unique_ptr<FixpointIterator> PassImpl::analyze(
     const Scope& scope,
-    const ImmutableAttributeAnalyzerState* immut_analyzer_state) {
-  call_graph::Graph cg = call_graph::single_callee_graph(scope);
+    const ImmutableAttributeAnalyzerState* immut_analyzer_state,
+    AnalysisCache* cache) {
+  AnalysisCache local_cache;
+  if (cache == nullptr) {
+    cache = &local_cache;
+  }
+  auto cg = cache->single_callee_graph(scope);
   auto fp_iter = std::make_unique<FixpointIterator>(
-      cg, AnalyzerGenerator(immut_analyzer_state));
+      *cg, AnalyzerGenerator(immut_analyzer_state));
   // Run the bootstrap. All field value and method return values are
   // represented by Top.
   fp_iter->run({{CURRENT_PARTITION_LABEL, ArgumentDomain()}});
-  auto non_true_virtuals = mog::get_non_true_virtuals(scope);
+  auto non_true_virtuals =
+      mog::get_non_true_virtuals(*cache->method_override_graph(scope), scope);
   for (size_t i = 0; i < m_config.max_heap_analysis_iterations; ++i) {
     // Build an approximation of all the field values and method return values.
     auto wps = std::make_unique<WholeProgramState>(
@@ -114,9 +120,12 @@ std::unique_ptr<FixpointIterator> PassImpl::analyze(
       break;
     }
     // Use the refined WholeProgramState to propagate more constants via
-    // the stack and registers.
+    // the stack and registers. Only the methods that read a refined value,
+    // and the ones whose arguments change as a result, are analyzed again.
+    auto affected_nodes = fp_iter->get_affected_nodes(*wps);
     fp_iter->set_whole_program_state(std::move(wps));
-    fp_iter->run({{CURRENT_PARTITION_LABEL, ArgumentDomain()}});
+    fp_iter->run_incrementally({{CURRENT_PARTITION_LABEL, ArgumentDomain()}},
+                               affected_nodes);
   }
   compute_analysis_stats(fp_iter->get_whole_program_state());
 
@@ -193,7 +202,7 @@ void PassImpl::optimize(
       });
 }
 
-void PassImpl::run(const DexStoresVector& stores) {
+void PassImpl::run(const DexStoresVector& stores, AnalysisCache* cache) {
   auto scope = build_class_scope(stores);
   XStoreRefs xstores(stores);
   // Rebuild all CFGs here -- this should be more efficient than doing them
@@ -207,7 +216,7 @@ void PassImpl::run(const DexStoresVector& stores) {
   std::unique_ptr<ImmutableAttributeAnalyzerState> immut_analyzer_state =
       std::make_unique<ImmutableAttributeAnalyzerState>();
   immutable_state::analyze_constructors(scope, immut_analyzer_state.get());
-  auto fp_iter = analyze(scope, immut_analyzer_state.get());
+  auto fp_iter = analyze(scope, immut_analyzer_state.get(), cache);
   optimize(scope, xstores, *fp_iter, immut_analyzer_state.get());
 }
 
@@ -219,7 +228,7 @@ void PassImpl::run_pass(DexStoresVector& stores,
         RuntimeAssertTransform::Config(config.get_proguard_map());
   }
 
-  run(stores);
+  run(stores, &mgr.analysis_cache());
   mgr.incr_metric("branches_forwarded", m_transform_stats.branches_forwarded);
   mgr.incr_metric("branches_removed", m_transform_stats.branches_removed);
   mgr.incr_metric("materialized_consts", m_transform_stats.materialized_consts);
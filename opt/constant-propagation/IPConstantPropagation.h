@@ -9,6 +9,7 @@
 
 #include <utility>
 
+#include "AnalysisCache.h"
 #include "ConstantPropagationRuntimeAssert.h"
 #include "ConstantPropagationTransform.h"
 #include "ConstantPropagationWholeProgramState.h"
@@ -62,15 +63,18 @@ class PassImpl : public Pass {
   /*
    * run_pass() takes a PassManager object, making it awkward to call in unit
    * tests. run() is a more direct way to call this pass. The caller is
-   * responsible for picking the right Config settings.
+   * responsible for picking the right Config settings. The call graph is
+   * taken from `cache` when one is given.
    */
-  void run(const DexStoresVector& stores);
+  void run(const DexStoresVector& stores, AnalysisCache* cache = nullptr);
 
   /*
    * Exposed for testing purposes.
    */
   std::unique_ptr<FixpointIterator> analyze(
-      const Scope&, const ImmutableAttributeAnalyzerState*);
+      const Scope&,
+      const ImmutableAttributeAnalyzerState*,
+      AnalysisCache* cache = nullptr);
 
  private:
   void compute_analysis_stats(const WholeProgramState&);
@@ -69,8 +69,9 @@ void CommonSubexpressionEliminationPass::run_pass(DexStoresVector& stores,
   copy_prop_config.eliminate_const_classes = false;
   copy_prop_config.eliminate_const_strings = false;
   copy_prop_config.static_finals = false;
-  const auto stats = walk::parallel::methods<Stats>(
+  const auto stats = walk::parallel::methods_by_cost<Stats>(
       scope,
+      walk::parallel::code_size_cost,
       [&](DexMethod* method) {
         const auto code = method->get_code();
         if (code == nullptr) {
@@ -17,6 +17,7 @@
 #include "IRInstruction.h"
 #include "InstructionSequenceOutliner.h"
 #include "Walkers.h"
+#include "WorkQueue.h"
 #include "locator.h"
 
 namespace {
@@ -59,17 +60,11 @@ void DedupStrings::run(DexStoresVector& stores) {
   std::unordered_set<const DexMethod*> perf_sensitive_methods =
       get_perf_sensitive_methods(dexen);
 
-  // Compute set of non-load strings in each dex
+  // Compute set of non-load strings in each dex, and for each string, figure
+  // out how many times it's loaded per dex
   std::unordered_set<const DexString*> non_load_strings[dexen.size()];
-  for (size_t i = 0; i < dexen.size(); i++) {
-    auto& strings = non_load_strings[i];
-    gather_non_load_strings(dexen[i], &strings);
-  }
-
-  // For each string, figure out how many times it's loaded per dex
-  ConcurrentMap<DexString*, std::unordered_map<size_t, size_t>> occurrences =
-      get_occurrences(scope, methods_to_dex, perf_sensitive_methods,
-                      non_load_strings);
+  StringOccurrences occurrences =
+      get_occurrences(dexen, perf_sensitive_methods, non_load_strings);
 
   // Use heuristics to determine which strings to dedup,
   // and figure out factory method details
@@ -259,7 +254,7 @@ DexMethod* DedupStrings::make_const_string_loader_method(
 }
 
 void DedupStrings::gather_non_load_strings(
-    DexClasses& classes, std::unordered_set<const DexString*>* strings) {
+    const DexClasses& classes, std::unordered_set<const DexString*>* strings) {
   // Let's figure out the set of "non-load" strings, i.e. the strings which
   // are referenced by some metadata (and not just const-string instructions)
   std::vector<DexString*> lstring;
@@ -275,50 +270,56 @@ void DedupStrings::gather_non_load_strings(
   strings->insert(lstring.begin(), lstring.end());
 }
 
-ConcurrentMap<DexString*, std::unordered_map<size_t, size_t>>
-DedupStrings::get_occurrences(
-    const Scope& scope,
-    const std::unordered_map<const DexMethod*, size_t>& methods_to_dex,
+DedupStrings::StringOccurrences DedupStrings::get_occurrences(
+    const DexClassesVector& dexen,
     const std::unordered_set<const DexMethod*>& perf_sensitive_methods,
     std::unordered_set<const DexString*> non_load_strings[]) {
-  // For each string, figure out how many times it's loaded per dex
-  ConcurrentMap<DexString*, std::unordered_map<size_t, size_t>> occurrences;
-  ConcurrentMap<DexString*, std::unordered_set<size_t>> perf_sensitive_strings;
-  walk::parallel::code(
-      scope, [&occurrences, &perf_sensitive_strings, &methods_to_dex,
-              &perf_sensitive_methods](DexMethod* method, IRCode& code) {
-        const auto dexnr = methods_to_dex.at(method);
-        const auto perf_sensitive = perf_sensitive_methods.count(method) != 0;
-        for (auto& mie : InstructionIterable(code)) {
-          const auto insn = mie.insn;
-          if (insn->opcode() == OPCODE_CONST_STRING) {
-            const auto str = insn->get_string();
-            if (perf_sensitive) {
-              perf_sensitive_strings.update(
-                  str,
-                  [dexnr](const DexString*,
-                          std::unordered_set<size_t>& s,
-                          bool /* exists */) { s.emplace(dexnr); });
-            } else {
-              occurrences.update(str,
-                                 [dexnr](const DexString*,
-                                         std::unordered_map<size_t, size_t>& m,
-                                         bool /* exists */) { ++m[dexnr]; });
-            }
+  // Each dex is tallied on its own, without any shared state. The tallies are
+  // then merged in dex order, so the result doesn't depend on scheduling.
+  struct DexTally {
+    std::unordered_map<DexString*, size_t> loads;
+    std::unordered_set<DexString*> perf_sensitive_strings;
+  };
+  std::vector<DexTally> tallies(dexen.size());
+  auto wq = workqueue_foreach<size_t>([&](size_t dexnr) {
+    auto& tally = tallies[dexnr];
+    gather_non_load_strings(dexen[dexnr], &non_load_strings[dexnr]);
+    walk::code(dexen[dexnr], [&](DexMethod* method, IRCode& code) {
+      const auto perf_sensitive = perf_sensitive_methods.count(method) != 0;
+      for (auto& mie : InstructionIterable(code)) {
+        const auto insn = mie.insn;
+        if (insn->opcode() == OPCODE_CONST_STRING) {
+          const auto str = insn->get_string();
+          if (perf_sensitive) {
+            tally.perf_sensitive_strings.emplace(str);
+          } else {
+            ++tally.loads[str];
           }
         }
-      });
-
-  // Also, add all the strings that occurred in perf-sensitive methods
-  // to the non_load_strings datastructure, as we won't attempt to dedup them.
-  for (const auto& it : perf_sensitive_strings) {
-    const auto str = it.first;
-    TRACE(DS, 3, "[dedup strings] perf sensitive string: {%s}", SHOW(str));
+      }
+    });
+    // Also, add all the strings that occurred in perf-sensitive methods
+    // to the non_load_strings datastructure, as we won't attempt to dedup
+    // them.
+    non_load_strings[dexnr].insert(tally.perf_sensitive_strings.begin(),
+                                   tally.perf_sensitive_strings.end());
+  });
+  for (size_t dexnr = 0; dexnr < dexen.size(); dexnr++) {
+    wq.add_item(dexnr);
+  }
+  wq.run_all();
 
-    const auto& dexes = it.second;
-    for (const auto dexnr : dexes) {
-      auto& strings = non_load_strings[dexnr];
-      strings.emplace(str);
+  StringOccurrences occurrences;
+  std::unordered_set<DexString*> perf_sensitive_strings;
+  for (size_t dexnr = 0; dexnr < dexen.size(); dexnr++) {
+    const auto& tally = tallies[dexnr];
+    for (const auto& p : tally.loads) {
+      occurrences[p.first].emplace(dexnr, p.second);
+    }
+    for (const auto str : tally.perf_sensitive_strings) {
+      if (perf_sensitive_strings.insert(str).second) {
+        TRACE(DS, 3, "[dedup strings] perf sensitive string: {%s}", SHOW(str));
+      }
     }
   }
 
@@ -330,8 +331,7 @@ DedupStrings::get_occurrences(
 std::unordered_map<DexString*, DedupStrings::DedupStringInfo>
 DedupStrings::get_strings_to_dedup(
     DexClassesVector& dexen,
-    const ConcurrentMap<DexString*, std::unordered_map<size_t, size_t>>&
-        occurrences,
+    const StringOccurrences& occurrences,
     std::unordered_map<const DexMethod*, size_t>& methods_to_dex,
     std::unordered_set<const DexMethod*>& perf_sensitive_methods,
     const std::unordered_set<const DexString*> non_load_strings[]) {
@@ -359,7 +359,7 @@ DedupStrings::get_strings_to_dedup(
   std::sort(ordered_strings.begin(), ordered_strings.end(), compare_dexstrings);
   for (DexString* s : ordered_strings) {
     // We are going to look at the situation of a particular string here
-    const auto& m = occurrences.at_unsafe(s);
+    const auto& m = occurrences.at(s);
     always_assert(m.size() > 1);
     const auto entry_size = s->get_entry_size();
     const auto get_size_reduction = [entry_size, non_load_strings](
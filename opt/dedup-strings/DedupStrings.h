@@ -56,17 +56,18 @@ class DedupStrings {
       const DexClassesVector& dexen);
   DexMethod* make_const_string_loader_method(
       DexClass* host_cls, const std::vector<DexString*>& strings);
-  void gather_non_load_strings(DexClasses& classes,
+  void gather_non_load_strings(const DexClasses& classes,
                                std::unordered_set<const DexString*>* strings);
-  ConcurrentMap<DexString*, std::unordered_map<size_t, size_t>> get_occurrences(
-      const Scope& scope,
-      const std::unordered_map<const DexMethod*, size_t>& methods_to_dex,
+  // For each string, the number of times it's loaded in each dex.
+  using StringOccurrences =
+      std::unordered_map<DexString*, std::unordered_map<size_t, size_t>>;
+  StringOccurrences get_occurrences(
+      const DexClassesVector& dexen,
       const std::unordered_set<const DexMethod*>& perf_sensitive_methods,
       std::unordered_set<const DexString*> non_load_strings[]);
   std::unordered_map<DexString*, DedupStringInfo> get_strings_to_dedup(
       DexClassesVector& dexen,
-      const ConcurrentMap<DexString*, std::unordered_map<size_t, size_t>>&
-          occurrences,
+      const StringOccurrences& occurrences,
       std::unordered_map<const DexMethod*, size_t>& methods_to_dex,
       std::unordered_set<const DexMethod*>& perf_sensitive_methods,
       const std::unordered_set<const DexString*> non_load_strings[]);
@@ -39,7 +39,6 @@ void DedupBlocksPass::run_pass(DexStoresVector& stores,
         dedup_blocks_impl::DedupBlocks impl(&m_config, method);
         impl.run();
 
-        code->clear_cfg();
         return impl.get_stats();
       },
       m_config.debug ? 1 : redex_parallel::default_num_threads());
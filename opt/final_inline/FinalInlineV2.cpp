@@ -8,6 +8,7 @@
 #include "FinalInlineV2.h"
 
 #include <boost/variant.hpp>
+#include <unordered_map>
 #include <unordered_set>
 #include <vector>
 
@@ -17,6 +18,8 @@
 #include "DexAccess.h"
 #include "DexClass.h"
 #include "DexUtil.h"
+#include "Dominators.h"
+#include "GraphUtil.h"
 #include "IPConstantPropagationAnalysis.h"
 #include "IRCode.h"
 #include "LocalDce.h"
@@ -225,10 +228,11 @@ class encoding_visitor : public boost::static_visitor<DexEncodedValue*> {
 /*
  * If a field is both read and written to in its initializer, then we can
  * update its encoded value with the value at exit only if the reads (sgets) are
- * are dominated by the writes (sputs) -- otherwise we may change program
- * semantics. Checking for dominance takes some work, and static fields are
- * rarely read in their class' <clinit>, so we simply avoid inlining all fields
- * that are read in their class' <clinit>.
+ * dominated by the writes (sputs) -- otherwise we may change program
+ * semantics. This returns the fields that have a read in their class' <clinit>
+ * that isn't dominated by a write, so that they can be left alone. A write in
+ * a dominating block only counts if that block can't throw, as the reads that
+ * are reached through its catch handlers may run before the write did.
  *
  * TODO: We should really transitively analyze all callees for field reads.
  * Right now this just analyzes the sgets directly in the <clinit>.
@@ -236,14 +240,48 @@ class encoding_visitor : public boost::static_visitor<DexEncodedValue*> {
 std::unordered_set<const DexFieldRef*> gather_read_static_fields(
     DexClass* cls) {
   std::unordered_set<const DexFieldRef*> read_fields;
-  auto clinit = cls->get_clinit();
-  for (auto* block : clinit->get_code()->cfg().blocks()) {
+  auto& cfg = cls->get_clinit()->get_code()->cfg();
+  std::unordered_map<cfg::Block*, std::unordered_set<const DexFieldRef*>>
+      written_fields;
+  for (auto* block : cfg.blocks()) {
+    for (auto& mie : InstructionIterable(block)) {
+      if (is_sput(mie.insn->opcode())) {
+        written_fields[block].emplace(mie.insn->get_field());
+      }
+    }
+  }
+  auto doms = cfg.dominators();
+  auto is_written_by_dominator = [&](cfg::Block* block,
+                                     const DexFieldRef* field) {
+    while (true) {
+      auto idom = doms->get_idom(block);
+      if (idom == block) {
+        return false;
+      }
+      block = idom;
+      auto it = written_fields.find(block);
+      if (it != written_fields.end() && it->second.count(field) &&
+          cfg.get_succ_edge_of_type(block, cfg::EDGE_THROW) == nullptr) {
+        return true;
+      }
+    }
+  };
+  // The unreachable blocks have no dominators, and their reads never run.
+  for (auto* block : graph::postorder_sort<cfg::GraphInterface>(cfg)) {
+    std::unordered_set<const DexFieldRef*> written_in_block;
     for (auto& mie : InstructionIterable(block)) {
       auto insn = mie.insn;
-      if (is_sget(insn->opcode())) {
-        read_fields.emplace(insn->get_field());
+      if (is_sput(insn->opcode())) {
+        written_in_block.emplace(insn->get_field());
+      } else if (is_sget(insn->opcode())) {
+        auto field = insn->get_field();
+        if (written_in_block.count(field) ||
+            is_written_by_dominator(block, field)) {
+          continue;
+        }
+        read_fields.emplace(field);
         TRACE(FINALINLINE, 3, "Found static field read in clinit: %s",
-              SHOW(insn->get_field()));
+              SHOW(field));
       }
     }
   }
@@ -31,17 +31,44 @@
  * Its class and method names are specified in the config. This pass then
  * inserts the method to points of interest. For a starting example, we
  * implement the "onMethodBegin" instrumentation.
+ *
+ * The "sampled_method_tracing" strategy is a cheaper variant of it: each
+ * instrumented method bumps its own entry of a short array of hit counts
+ * inline, and only calls the analysis method on its first hit and then once
+ * every sample_rate hits.
  */
 namespace {
 
 static bool debug = false;
 
+constexpr const char* kHitCountsFieldName = "sMethodHitCounts";
+
+DexClass* find_analysis_class(const std::string& analysis_class_name) {
+  DexType* analysis_class_type =
+      g_redex->get_type(DexString::get_string(analysis_class_name.c_str()));
+  return analysis_class_type == nullptr ? nullptr
+                                        : type_class(analysis_class_type);
+}
+
 class InstrumentInterDexPlugin : public interdex::InterDexPassPlugin {
  public:
-  explicit InstrumentInterDexPlugin(size_t max_analysis_methods)
-      : m_max_analysis_methods(max_analysis_methods) {}
-
-  void configure(const Scope& scope, ConfigFiles& cfg) override{};
+  InstrumentInterDexPlugin(size_t max_analysis_methods,
+                           const std::string& hit_counts_class_name)
+      : m_max_analysis_methods(max_analysis_methods),
+        m_hit_counts_class_name(hit_counts_class_name) {}
+
+  void configure(const Scope& scope, ConfigFiles& cfg) override {
+    // With sampled tracing, every instrumented method refers to the array of
+    // hit counts.
+    if (m_hit_counts_class_name.empty()) {
+      return;
+    }
+    auto cls = find_analysis_class(m_hit_counts_class_name);
+    if (cls != nullptr) {
+      m_hit_counts_field =
+          cls->find_field_from_simple_deobfuscated_name(kHitCountsFieldName);
+    }
+  };
 
   bool should_skip_class(const DexClass* clazz) override { return false; }
 
@@ -51,7 +78,11 @@ class InstrumentInterDexPlugin : public interdex::InterDexPassPlugin {
                    std::vector<DexFieldRef*>& frefs,
                    std::vector<DexType*>& trefs,
                    std::vector<DexClass*>* erased_classes,
-                   bool should_not_relocate_methods_of_class) override {}
+                   bool should_not_relocate_methods_of_class) override {
+    if (m_hit_counts_field != nullptr) {
+      frefs.push_back(m_hit_counts_field);
+    }
+  }
 
   size_t reserve_mrefs() override {
     // In each dex, we will introduce more method refs from analysis methods.
@@ -68,6 +99,8 @@ class InstrumentInterDexPlugin : public interdex::InterDexPassPlugin {
 
  private:
   const size_t m_max_analysis_methods;
+  const std::string m_hit_counts_class_name;
+  DexFieldRef* m_hit_counts_field{nullptr};
 };
 
 // For example, say that "Lcom/facebook/debug/" is in the set. We match either
@@ -80,9 +113,13 @@ bool match_class_name(std::string cls_name,
     return true;
   }
   cls_name.back() = '/';
+  // Reuse one buffer for all the package prefixes.
+  std::string prefix;
+  prefix.reserve(cls_name.size());
   size_t pos = cls_name.find('/', 0);
   while (pos != std::string::npos) {
-    if (set.count(cls_name.substr(0, pos + 1))) {
+    prefix.assign(cls_name, 0, pos + 1);
+    if (set.count(prefix)) {
       return true;
     }
     pos = cls_name.find('/', pos + 1);
@@ -354,8 +391,59 @@ IRList::iterator find_or_insn_insert_point(cfg::Block* block) {
       });
 }
 
+// A block which only falls through to a block that has no other predecessor
+// runs exactly when that successor does, as long as it can't throw to a
+// handler: an exception which leaves the method skips the report anyway. So
+// such straight-line chains of blocks need a single probe, in their last
+// block, which sets the bits of the whole chain.
+//
+// Returns the block holding the probe of every block, which may be itself.
+template <typename CanInstrument>
+std::unordered_map<cfg::Block*, cfg::Block*> find_probe_blocks(
+    const cfg::ControlFlowGraph& cfg, const CanInstrument& can_instrument) {
+  auto next_in_chain = [&](cfg::Block* block) -> cfg::Block* {
+    const auto& succs = block->succs();
+    if (succs.size() != 1 || succs[0]->type() != cfg::EDGE_GOTO) {
+      return nullptr;
+    }
+    cfg::Block* succ = succs[0]->target();
+    if (succ == cfg.entry_block() || succ->preds().size() != 1 ||
+        !can_instrument(succ)) {
+      return nullptr;
+    }
+    return succ;
+  };
+
+  std::unordered_map<cfg::Block*, cfg::Block*> probe_block;
+  for (cfg::Block* block : cfg.blocks()) {
+    // Walk down the chain until a block whose probe is known; the blocks on
+    // the way share it.
+    std::vector<cfg::Block*> chain;
+    std::unordered_set<cfg::Block*> on_chain;
+    cfg::Block* cur = block;
+    while (!probe_block.count(cur)) {
+      chain.push_back(cur);
+      on_chain.insert(cur);
+      cfg::Block* next = next_in_chain(cur);
+      // A chain may only loop back onto itself in unreachable code.
+      if (next == nullptr || on_chain.count(next)) {
+        probe_block[cur] = cur;
+        break;
+      }
+      cur = next;
+    }
+    cfg::Block* probe = probe_block.at(cur);
+    for (cfg::Block* b : chain) {
+      probe_block[b] = probe;
+    }
+  }
+  return probe_block;
+}
+
 // For every basic block, add an instruction to calculate:
 //   bit_vector[n] OR (1 << block_id).
+// The blocks of a straight-line chain are covered by a single instruction at
+// the end of the chain; see find_probe_blocks.
 //
 // We use 16-bit short vectors to capture all the basic blocks in a method. We
 // reserve the MSB of each 16-bit vector as the end marker. This end marker is
@@ -412,31 +500,47 @@ int instrument_onBasicBlockBegin(
                                method_onMethodExit_map.at(index_to_method),
                                reg_bb_vector);
 
-  for (cfg::Block* block : blocks) {
-    const size_t block_vector_index = block->id() / 15;
-    // Add instruction to calculate 'basic_block_bit_vector |= 1 << block->id()'
-    // We use OPCODE_OR_INT_LIT16 to prevent inserting an extra CONST
-    // instruction into the bytecode.
-    IRInstruction* or_inst = new IRInstruction(OPCODE_OR_INT_LIT16);
-    or_inst->set_literal(static_cast<int16_t>(1ULL << (block->id() % 15)));
-    or_inst->set_src(0, reg_bb_vector.at(block_vector_index));
-    or_inst->set_dest(reg_bb_vector.at(block_vector_index));
-
-    // Find where to insert the newly created instruction block.
-    auto insert_point = find_or_insn_insert_point(block);
+  // We do not instrument a Basic block if:
+  // 1. It only has internal or MOVE instructions.
+  // 2. BB has no opcodes.
+  auto can_instrument = [](cfg::Block* block) {
+    return find_or_insn_insert_point(block) != block->end() &&
+           block->num_opcodes() >= 1;
+  };
+  auto probe_block = find_probe_blocks(code->cfg(), can_instrument);
 
-    // We do not instrument a Basic block if:
-    // 1. It only has internal or MOVE instructions.
-    // 2. BB has no opcodes.
-    if (insert_point == block->end() || block->num_opcodes() < 1) {
+  // The bits of all the blocks which share a probe, per vector.
+  std::unordered_map<cfg::Block*, std::map<size_t, uint16_t>> probe_masks;
+  for (cfg::Block* block : blocks) {
+    if (!can_instrument(block)) {
       TRACE(INSTRUMENT, 7, "No instrumentation to block: %s",
             SHOW(show(method) + std::to_string(block->id())));
       continue;
     }
     num_blocks_instrumented++;
-    code->insert_before(insert_point, or_inst);
+    probe_masks[probe_block.at(block)][block->id() / 15] |=
+        1ULL << (block->id() % 15);
   }
 
+  size_t num_probes = 0;
+  for (const auto& p : probe_masks) {
+    // Find where to insert the newly created instruction block.
+    auto insert_point = find_or_insn_insert_point(p.first);
+    for (const auto& vector_mask : p.second) {
+      // Add instruction to calculate 'basic_block_bit_vector |= mask'
+      // We use OPCODE_OR_INT_LIT16 to prevent inserting an extra CONST
+      // instruction into the bytecode.
+      IRInstruction* or_inst = new IRInstruction(OPCODE_OR_INT_LIT16);
+      or_inst->set_literal(static_cast<int16_t>(vector_mask.second));
+      or_inst->set_src(0, reg_bb_vector.at(vector_mask.first));
+      or_inst->set_dest(reg_bb_vector.at(vector_mask.first));
+      code->insert_before(insert_point, or_inst);
+      num_probes++;
+    }
+  }
+  TRACE(INSTRUMENT, 7, "[%s] Probes: %zu", SHOW(method->get_name()),
+        num_probes);
+
   // We use intentionally obfuscated name to guarantee the uniqueness.
   const auto& method_name = show(method);
   assert(!method_id_name_map.count(method_id));
@@ -464,22 +568,7 @@ int instrument_onBasicBlockBegin(
   return method_id;
 }
 
-void instrument_onMethodBegin(DexMethod* method,
-                              int index,
-                              DexMethod* method_onMethodBegin) {
-  IRCode* code = method->get_code();
-  assert(code != nullptr);
-
-  IRInstruction* const_inst = new IRInstruction(OPCODE_CONST);
-  const_inst->set_literal(index);
-  const auto reg_dest = code->allocate_temp();
-  const_inst->set_dest(reg_dest);
-
-  IRInstruction* invoke_inst = new IRInstruction(OPCODE_INVOKE_STATIC);
-  invoke_inst->set_method(method_onMethodBegin);
-  invoke_inst->set_srcs_size(1);
-  invoke_inst->set_src(0, reg_dest);
-
+IRList::iterator find_method_begin_insert_point(IRCode* code) {
   // TODO(minjang): Consider using get_param_instructions.
   // Try to find a right insertion point: the entry point of the method.
   // We skip any fall throughs and IOPCODE_LOAD_PARRM*.
@@ -507,7 +596,26 @@ void instrument_onMethodBegin(DexMethod* method,
   } else {
     // Otherwise, insert_point can be used directly.
   }
+  return insert_point;
+}
 
+void instrument_onMethodBegin(DexMethod* method,
+                              int index,
+                              DexMethod* method_onMethodBegin) {
+  IRCode* code = method->get_code();
+  assert(code != nullptr);
+
+  IRInstruction* const_inst = new IRInstruction(OPCODE_CONST);
+  const_inst->set_literal(index);
+  const auto reg_dest = code->allocate_temp();
+  const_inst->set_dest(reg_dest);
+
+  IRInstruction* invoke_inst = new IRInstruction(OPCODE_INVOKE_STATIC);
+  invoke_inst->set_method(method_onMethodBegin);
+  invoke_inst->set_srcs_size(1);
+  invoke_inst->set_src(0, reg_dest);
+
+  auto insert_point = find_method_begin_insert_point(code);
   code->insert_before(code->insert_before(insert_point, invoke_inst),
                       const_inst);
 
@@ -532,6 +640,89 @@ void instrument_onMethodBegin(DexMethod* method,
   }
 }
 
+// Like instrument_onMethodBegin, but behind an inline hit counter, so that
+// onMethodBegin is only called on the first hit and then every sample_rate
+// hits:
+//
+//   SGET_OBJECT <hit_counts>
+//   IOPCODE_MOVE_RESULT_PSEUDO_OBJECT v_counts
+//   CONST v_id, [method_id]
+//   AGET_SHORT v_counts, v_id
+//   IOPCODE_MOVE_RESULT_PSEUDO v_hits
+//   ADD_INT_LIT8 v_next, v_hits, 1
+//   INT_TO_SHORT v_next, v_next
+//   APUT_SHORT v_next, v_counts, v_id
+//   AND_INT_LIT16 v_hits, v_hits, [sample_rate - 1]
+//   IF_NEZ v_hits, :skip
+//   CONST v_index, [index]
+//   INVOKE_STATIC v_index, onMethodBegin
+//  :skip
+//
+// The counts wrap around, which keeps the sampling regular as sample_rate is
+// a power of two.
+void instrument_onMethodBegin_sampled(DexMethod* method,
+                                      int index,
+                                      DexMethod* method_onMethodBegin,
+                                      DexFieldRef* hit_counts,
+                                      size_t method_id,
+                                      int64_t sample_rate) {
+  IRCode* code = method->get_code();
+  assert(code != nullptr);
+
+  const auto reg_counts = code->allocate_temp();
+  const auto reg_id = code->allocate_temp();
+  const auto reg_hits = code->allocate_temp();
+  const auto reg_next = code->allocate_temp();
+  const auto reg_index = code->allocate_temp();
+
+  auto insert_point = find_method_begin_insert_point(code);
+  for (auto insn : std::vector<IRInstruction*>{
+           (new IRInstruction(OPCODE_SGET_OBJECT))->set_field(hit_counts),
+           (new IRInstruction(IOPCODE_MOVE_RESULT_PSEUDO_OBJECT))
+               ->set_dest(reg_counts),
+           (new IRInstruction(OPCODE_CONST))
+               ->set_literal(method_id)
+               ->set_dest(reg_id),
+           (new IRInstruction(OPCODE_AGET_SHORT))
+               ->set_srcs_size(2)
+               ->set_src(0, reg_counts)
+               ->set_src(1, reg_id),
+           (new IRInstruction(IOPCODE_MOVE_RESULT_PSEUDO))->set_dest(reg_hits),
+           (new IRInstruction(OPCODE_ADD_INT_LIT8))
+               ->set_literal(1)
+               ->set_src(0, reg_hits)
+               ->set_dest(reg_next),
+           (new IRInstruction(OPCODE_INT_TO_SHORT))
+               ->set_src(0, reg_next)
+               ->set_dest(reg_next),
+           (new IRInstruction(OPCODE_APUT_SHORT))
+               ->set_srcs_size(3)
+               ->set_src(0, reg_next)
+               ->set_src(1, reg_counts)
+               ->set_src(2, reg_id),
+           (new IRInstruction(OPCODE_AND_INT_LIT16))
+               ->set_literal(sample_rate - 1)
+               ->set_src(0, reg_hits)
+               ->set_dest(reg_hits),
+       }) {
+    code->insert_before(insert_point, insn);
+  }
+  auto if_it = code->insert_before(
+      insert_point, (new IRInstruction(OPCODE_IF_NEZ))->set_src(0, reg_hits));
+  code->insert_before(insert_point,
+                      (new IRInstruction(OPCODE_CONST))
+                          ->set_literal(index)
+                          ->set_dest(reg_index));
+  code->insert_before(insert_point,
+                      (new IRInstruction(OPCODE_INVOKE_STATIC))
+                          ->set_method(method_onMethodBegin)
+                          ->set_srcs_size(1)
+                          ->set_src(0, reg_index));
+  code->insert_before(insert_point, new BranchTarget(&*if_it));
+
+  TRACE(INSTRUMENT, 9, "After sampled instrumentation:\n%s", SHOW(code));
+}
+
 // Find a sequence of opcode that creates a static array. Patch the array size.
 void patch_array_size(DexClass* analysis_cls,
                       const std::string& array_name,
@@ -869,6 +1060,18 @@ void do_simple_method_tracing(DexClass* analysis_cls,
   // Write meta info of the meta file: the type of the meta file and version.
   ofs << "#,simple-method-tracing,1.0" << std::endl;
 
+  const bool sampled =
+      options.instrumentation_strategy == "sampled_method_tracing";
+  DexField* hit_counts = nullptr;
+  if (sampled) {
+    hit_counts = analysis_cls->find_field_from_simple_deobfuscated_name(
+        kHitCountsFieldName);
+    always_assert_log(hit_counts != nullptr, "Cannot find %s in %s",
+                      kHitCountsFieldName, SHOW(analysis_cls));
+    // The counts in the profile are sampled; consumers scale them back.
+    ofs << "#,sample-rate," << options.sample_rate << std::endl;
+  }
+
   size_t method_id = 0;
   int excluded = 0;
   std::unordered_set<std::string> method_names;
@@ -1017,9 +1220,15 @@ void do_simple_method_tracing(DexClass* analysis_cls,
   for (size_t i = 0; i < kTotalSize; ++i) {
     TRACE(INSTRUMENT, 6, "Sharded %zu => [%zu][%zu] %s", i, (i % NUM_SHARDS),
           (i / NUM_SHARDS), SHOW(to_instrument[i]));
-    instrument_onMethodBegin(to_instrument[i],
-                             (i / NUM_SHARDS) * options.num_stats_per_method,
-                             analysis_method_map.at((i % NUM_SHARDS) + 1));
+    const int index = (i / NUM_SHARDS) * options.num_stats_per_method;
+    DexMethod* analysis_method = analysis_method_map.at((i % NUM_SHARDS) + 1);
+    if (sampled) {
+      instrument_onMethodBegin_sampled(to_instrument[i], index,
+                                       analysis_method, hit_counts, i,
+                                       options.sample_rate);
+    } else {
+      instrument_onMethodBegin(to_instrument[i], index, analysis_method);
+    }
   }
 
   TRACE(INSTRUMENT,
@@ -1037,6 +1246,10 @@ void do_simple_method_tracing(DexClass* analysis_cls,
                      options.num_stats_per_method * n);
   }
 
+  if (sampled) {
+    patch_array_size(analysis_cls, hit_counts->get_name()->str(), kTotalSize);
+  }
+
   // Patch method count constant.
   always_assert(method_id == kTotalSize);
   auto field = analysis_cls->find_field_from_simple_deobfuscated_name(
@@ -1063,12 +1276,14 @@ void do_simple_method_tracing(DexClass* analysis_cls,
 //   - Initialize bit vector(s) at the beginning
 //   - Set <bb_id>-th bit in the vector using or-lit/16. So, the bit vector is a
 //     short type. We don't use a 32-bit int; no such or-lit/32 instruction.
+//     A straight-line chain of blocks, like this one, sets all its bits at
+//     once in its last block.
 //   - Before RETURN, insert INVOKE onMethodExit(method_id, bit_vectors).
 //
 //   +------------------+     +------------------+     +-----------------------+
-//   | * CONST v0, 0    | --> | * OR_LIT16 v0, 2 | --> | * OR_LIT16 v0, 4      |
-//   | * OR_LIT16 v0, 1 |     |   block1         |     |   block2              |
-//   |   block0         |     |                  |     | * CONST v2, method_id |
+//   | * CONST v0, 0    | --> |   block1         | --> | * OR_LIT16 v0, 7      |
+//   |   block0         |     |                  |     |   block2              |
+//   |                  |     |                  |     | * CONST v2, method_id |
 //   +------------------+     +------------------+     | * INVOKE v2,v0, ...   |
 //                                                     |   Return              |
 //                                                     +-----------------------+
@@ -1183,6 +1398,10 @@ void InstrumentPass::bind_config() {
   bind("num_stats_per_method", {1}, m_options.num_stats_per_method);
   bind("num_shards", {1}, m_options.num_shards);
   bind("only_cold_start_class", true, m_options.only_cold_start_class);
+  bind("sample_rate", {64}, m_options.sample_rate,
+       "With sampled_method_tracing, the analysis method is called on the "
+       "first hit of a method and then every this many hits. Must be a power "
+       "of two.");
   bind("methods_replacement", {}, m_options.methods_replacement,
        "Replacing instance method call with static method call.",
        Configurable::bindflags::methods::error_if_unresolvable);
@@ -1193,10 +1412,23 @@ void InstrumentPass::bind_config() {
     interdex::InterDexRegistry* registry =
         static_cast<interdex::InterDexRegistry*>(
             PluginRegistry::get().pass_registry(interdex::INTERDEX_PASS_NAME));
-    registry->register_plugin("INSTRUMENT_PASS_PLUGIN",
-                              [num_shards = m_options.num_shards]() {
-                                return new InstrumentInterDexPlugin(num_shards);
-                              });
+    const bool sampled =
+        m_options.instrumentation_strategy == "sampled_method_tracing";
+    registry->register_plugin(
+        "INSTRUMENT_PASS_PLUGIN",
+        [num_shards = m_options.num_shards,
+         hit_counts_class_name =
+             sampled ? m_options.analysis_class_name : std::string()]() {
+          return new InstrumentInterDexPlugin(num_shards,
+                                              hit_counts_class_name);
+        });
+    if (sampled) {
+      always_assert_log(m_options.sample_rate > 0 &&
+                            m_options.sample_rate <= 32768 &&
+                            (m_options.sample_rate &
+                             (m_options.sample_rate - 1)) == 0,
+                        "sample_rate must be a power of two up to 32768\n");
+    }
     // Currently we only support instance call to static call.
     for (auto& pair : m_options.methods_replacement) {
       always_assert(!is_static(pair.first));
@@ -1245,17 +1477,13 @@ void InstrumentPass::run_pass(DexStoresVector& stores,
   }
 
   // Get the analysis class.
-  DexType* analysis_class_type = g_redex->get_type(
-      DexString::get_string(m_options.analysis_class_name.c_str()));
-  if (analysis_class_type == nullptr) {
+  DexClass* analysis_cls = find_analysis_class(m_options.analysis_class_name);
+  if (analysis_cls == nullptr) {
     std::cerr << "[InstrumentPass] error: cannot find analysis class: "
               << m_options.analysis_class_name << std::endl;
     exit(1);
   }
 
-  DexClass* analysis_cls = g_redex->type_class(analysis_class_type);
-  always_assert(analysis_cls != nullptr);
-
   // Check whether the analysis class is in the primary dex. We use a heuristic
   // that looks the last 12 characters of the location of the given dex.
   auto dex_loc = analysis_cls->get_location();
@@ -1275,7 +1503,8 @@ void InstrumentPass::run_pass(DexStoresVector& stores,
         SHOW(m_options.analysis_class_name),
         SHOW(analysis_cls->get_location()));
 
-  if (m_options.instrumentation_strategy == "simple_method_tracing") {
+  if (m_options.instrumentation_strategy == "simple_method_tracing" ||
+      m_options.instrumentation_strategy == "sampled_method_tracing") {
     do_simple_method_tracing(analysis_cls, stores, cfg, pm, m_options);
   } else if (m_options.instrumentation_strategy == "basic_block_tracing") {
     do_basic_block_tracing(analysis_cls, stores, cfg, pm, m_options);
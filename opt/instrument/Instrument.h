@@ -29,6 +29,7 @@ class InstrumentPass : public Pass {
     int64_t num_stats_per_method;
     int64_t num_shards;
     bool only_cold_start_class;
+    int64_t sample_rate;
     std::unordered_map<DexMethod*, DexMethod*> methods_replacement;
   };
 
@@ -67,17 +67,49 @@ uint64_t CrossDexRefMinimizer::ClassInfo::get_priority() const {
   return (primary_priority << 24) | secondary_priority;
 }
 
-void CrossDexRefMinimizer::reprioritize(
-    const std::unordered_map<DexClass*, CrossDexRefMinimizer::ClassInfoDelta>&
-        affected_classes) {
+CrossDexRefMinimizer::ClassInfoDelta& CrossDexRefMinimizer::get_delta(
+    uint32_t index) {
+  auto& class_info = m_class_infos[index];
+  if (!class_info.affected) {
+    class_info.affected = true;
+    m_affected_classes.push_back(index);
+  }
+  return class_info.delta;
+}
+
+template <typename Fn>
+void CrossDexRefMinimizer::walk_ref_classes(RefId ref, const Fn& fn) {
+  // Drop the erased classes along the way.
+  auto& classes = m_ref_classes[ref];
+  size_t live = 0;
+  for (auto index : classes) {
+    if (m_class_infos[index].cls != nullptr) {
+      classes[live++] = index;
+      fn(index);
+    }
+  }
+  classes.resize(live);
+}
+
+CrossDexRefMinimizer::RefId CrossDexRefMinimizer::get_ref_id(const void* ref) {
+  auto p = m_ref_ids.emplace(ref, m_ref_counts.size());
+  if (p.second) {
+    m_ref_counts.push_back(0);
+    m_ref_classes.emplace_back();
+    m_ref_frequencies.push_back(0);
+    m_applied_refs.push_back(false);
+  }
+  return p.first->second;
+}
+
+void CrossDexRefMinimizer::reprioritize() {
   TRACE(IDEX, 4, "[dex ordering] Reprioritizing %u classes",
-        affected_classes.size());
-  for (auto p : affected_classes) {
+        m_affected_classes.size());
+  for (auto index : m_affected_classes) {
     ++m_stats.reprioritizations;
-    DexClass* affected_class = p.first;
-    CrossDexRefMinimizer::ClassInfoDelta& delta = p.second;
     CrossDexRefMinimizer::ClassInfo& affected_class_info =
-        m_class_infos.at(affected_class);
+        m_class_infos[index];
+    CrossDexRefMinimizer::ClassInfoDelta& delta = affected_class_info.delta;
     affected_class_info.applied_refs_weight += delta.applied_refs_weight;
     for (size_t i = 0; i < INFREQUENT_REFS_COUNT; ++i) {
       affected_class_info.infrequent_refs_weight[i] +=
@@ -85,26 +117,29 @@ void CrossDexRefMinimizer::reprioritize(
     }
 
     const auto priority = affected_class_info.get_priority();
-    m_prioritized_classes.update_priority(affected_class, priority);
+    m_prioritized_classes.update_priority(index, priority);
     TRACE(
         IDEX, 5,
         "[dex ordering] Reprioritized class {%s} with priority %016lx; "
         "index %u; %u (delta %d) applied refs weight, %s (delta %s) infrequent "
         "refs weights, %u total refs",
-        SHOW(affected_class), priority, affected_class_info.index,
+        SHOW(affected_class_info.cls), priority, affected_class_info.index,
         affected_class_info.applied_refs_weight, delta.applied_refs_weight,
         format_infrequent_refs_array(affected_class_info.infrequent_refs_weight)
             .c_str(),
         format_infrequent_refs_array(delta.infrequent_refs_weight).c_str(),
         affected_class_info.refs.size());
+    affected_class_info.delta = ClassInfoDelta();
+    affected_class_info.affected = false;
   }
+  m_affected_classes.clear();
 }
 
-void CrossDexRefMinimizer::gather_refs(DexClass* cls,
-                                       std::vector<DexMethodRef*>& method_refs,
-                                       std::vector<DexFieldRef*>& field_refs,
-                                       std::vector<DexType*>& types,
-                                       std::vector<DexString*>& strings) {
+void CrossDexRefMinimizer::gather_refs(DexClass* cls, ClassRefs* refs) {
+  auto& method_refs = refs->method_refs;
+  auto& field_refs = refs->field_refs;
+  auto& types = refs->types;
+  auto& strings = refs->strings;
   cls->gather_methods(method_refs);
   cls->gather_fields(field_refs);
   cls->gather_types(types);
@@ -127,53 +162,59 @@ void CrossDexRefMinimizer::ignore(DexClass* cls) {
   // By setting the count to the maximum value here, the class will later appear
   // to have an extremely high frequency and thus get skipped from
   // consideration by insert/add_weight.
-  m_ref_counts[cls->get_type()] = std::numeric_limits<size_t>::max();
+  m_ref_counts[get_ref_id(cls->get_type())] =
+      std::numeric_limits<size_t>::max();
 }
 
 void CrossDexRefMinimizer::sample(DexClass* cls) {
-  std::vector<DexMethodRef*> method_refs;
-  std::vector<DexFieldRef*> field_refs;
-  std::vector<DexType*> types;
-  std::vector<DexString*> strings;
-  gather_refs(cls, method_refs, field_refs, types, strings);
-  auto increment = [& ref_counts = m_ref_counts,
-                    &max_ref_count = m_max_ref_count](void* ref) {
-    size_t& count = ref_counts[ref];
-    if (count < std::numeric_limits<size_t>::max() && ++count > max_ref_count) {
-      max_ref_count = count;
+  ClassRefs refs;
+  gather_refs(cls, &refs);
+  sample(refs);
+}
+
+void CrossDexRefMinimizer::sample(const ClassRefs& refs) {
+  auto increment = [this](const void* ref) {
+    size_t& count = m_ref_counts[get_ref_id(ref)];
+    if (count < std::numeric_limits<size_t>::max() &&
+        ++count > m_max_ref_count) {
+      m_max_ref_count = count;
     }
   };
-  for (auto ref : method_refs) {
+  for (auto ref : refs.method_refs) {
     increment(ref);
   }
-  for (auto ref : field_refs) {
+  for (auto ref : refs.field_refs) {
     increment(ref);
   }
-  for (auto ref : types) {
+  for (auto ref : refs.types) {
     increment(ref);
   }
-  for (auto ref : strings) {
+  for (auto ref : refs.strings) {
     increment(ref);
   }
 }
 
 void CrossDexRefMinimizer::insert(DexClass* cls) {
-  always_assert(m_class_infos.count(cls) == 0);
-  ++m_stats.classes;
-  CrossDexRefMinimizer::ClassInfo& class_info =
-      m_class_infos
-          .insert({cls, CrossDexRefMinimizer::ClassInfo(m_next_index++)})
-          .first->second;
-
   // Collect all relevant references that contribute to cross-dex metadata
   // entries.
   // We don't bother with protos and type_lists, as they are directly related
   // to method refs (I tried, didn't help).
-  std::vector<DexMethodRef*> method_refs;
-  std::vector<DexFieldRef*> field_refs;
-  std::vector<DexType*> types;
-  std::vector<DexString*> strings;
-  gather_refs(cls, method_refs, field_refs, types, strings);
+  ClassRefs class_refs;
+  gather_refs(cls, &class_refs);
+  insert(cls, class_refs);
+}
+
+void CrossDexRefMinimizer::insert(DexClass* cls, const ClassRefs& class_refs) {
+  uint32_t index = m_class_infos.size();
+  always_assert(m_class_indices.emplace(cls, index).second);
+  ++m_stats.classes;
+  m_class_infos.emplace_back(cls, index);
+  CrossDexRefMinimizer::ClassInfo& class_info = m_class_infos.back();
+
+  const auto& method_refs = class_refs.method_refs;
+  const auto& field_refs = class_refs.field_refs;
+  const auto& types = class_refs.types;
+  const auto& strings = class_refs.strings;
 
   auto& refs = class_info.refs;
   refs.reserve(method_refs.size() + field_refs.size() + types.size() +
@@ -181,12 +222,12 @@ void CrossDexRefMinimizer::insert(DexClass* cls) {
   uint64_t& refs_weight = class_info.refs_weight;
   uint64_t& seed_weight = class_info.seed_weight;
 
-  auto add_weight = [& ref_counts = m_ref_counts,
-                     max_ref_count = m_max_ref_count, &refs, &refs_weight,
-                     &seed_weight](void* ref, size_t item_weight,
-                                   size_t item_seed_weight) {
-    auto it = ref_counts.find(ref);
-    auto ref_count = it == ref_counts.end() ? 1 : it->second;
+  auto add_weight = [this, max_ref_count = m_max_ref_count, &refs,
+                     &refs_weight, &seed_weight](const void* ref,
+                                                 size_t item_weight,
+                                                 size_t item_seed_weight) {
+    auto it = m_ref_ids.find(ref);
+    auto ref_count = it == m_ref_ids.end() ? 1 : m_ref_counts[it->second];
     double frequency = ref_count * 1.0 / max_ref_count;
     // We skip reference that...
     // - only ever appear once (those won't help with prioritization), and
@@ -196,7 +237,7 @@ void CrossDexRefMinimizer::insert(DexClass* cls) {
     TRACE(IDEX, 6, "[dex ordering] %zu/%zu = %lf %s", ref_count, max_ref_count,
           frequency, skipping ? "(skipping)" : "");
     if (!skipping) {
-      refs.emplace_back(ref, item_weight);
+      refs.emplace_back(it->second, item_weight);
       refs_weight += item_weight;
       seed_weight += item_seed_weight;
     }
@@ -220,51 +261,50 @@ void CrossDexRefMinimizer::insert(DexClass* cls) {
     add_weight(fref, m_config.field_ref_weight, m_config.field_seed_weight);
   }
 
-  std::unordered_map<DexClass*, CrossDexRefMinimizer::ClassInfoDelta>
-      affected_classes;
-  for (const std::pair<void*, uint32_t>& p : refs) {
-    void* ref = p.first;
+  for (const std::pair<RefId, uint32_t>& p : refs) {
+    RefId ref = p.first;
     uint32_t weight = p.second;
-    auto& classes = m_ref_classes[ref];
-    size_t frequency = classes.size();
+    size_t frequency = m_ref_frequencies[ref];
     // We record the need to undo (subtract weight of) a previously claimed
     // infrequent ref. The actual undoing happens later in
     // reprioritize.
-    if (frequency > 0 && frequency <= INFREQUENT_REFS_COUNT) {
-      for (DexClass* affected_class : classes) {
-        always_assert(affected_class != cls);
-        affected_classes[affected_class]
-            .infrequent_refs_weight[frequency - 1] -= weight;
-      }
-    }
-    ++frequency;
-    // We are recording a new infrequent unapplied ref, if any.
+    // We are also recording a new infrequent unapplied ref, if any.
     // This happens immediately for the to be inserted class cls,
     // so that it can be used right away by the upcoming
     // class_info.get_priority() call, while all other change requests happen
     // later in reprioritize.
-    if (frequency <= INFREQUENT_REFS_COUNT) {
-      for (DexClass* affected_class : classes) {
-        affected_classes[affected_class]
-            .infrequent_refs_weight[frequency - 1] += weight;
-      }
-      class_info.infrequent_refs_weight[frequency - 1] += weight;
+    if (frequency + 1 <= INFREQUENT_REFS_COUNT) {
+      walk_ref_classes(ref, [&](uint32_t affected_index) {
+        always_assert(affected_index != index);
+        auto& delta = get_delta(affected_index);
+        if (frequency > 0) {
+          delta.infrequent_refs_weight[frequency - 1] -= weight;
+        }
+        delta.infrequent_refs_weight[frequency] += weight;
+      });
+      class_info.infrequent_refs_weight[frequency] += weight;
+    } else if (frequency == INFREQUENT_REFS_COUNT) {
+      walk_ref_classes(ref, [&](uint32_t affected_index) {
+        get_delta(affected_index).infrequent_refs_weight[frequency - 1] -=
+            weight;
+      });
     }
 
-    // There's an implicit invariant that class_info and the keys of
-    // affected_classes are disjoint, so we are not going to reprioritize
-    // the class that we are adding here.
-    classes.emplace(cls);
+    // There's an implicit invariant that class_info and the affected classes
+    // are disjoint, so we are not going to reprioritize the class that we are
+    // adding here.
+    m_ref_classes[ref].push_back(index);
+    ++m_ref_frequencies[ref];
   }
   const auto priority = class_info.get_priority();
-  m_prioritized_classes.insert(cls, priority);
+  m_prioritized_classes.insert(index, priority);
   TRACE(IDEX, 4,
         "[dex ordering] Inserting class {%s} with priority %016lx; index %u; "
         "%s infrequent refs weights, %u total refs",
         SHOW(cls), priority, class_info.index,
         format_infrequent_refs_array(class_info.infrequent_refs_weight).c_str(),
         refs.size());
-  reprioritize(affected_classes);
+  reprioritize();
 }
 
 bool CrossDexRefMinimizer::empty() const {
@@ -272,53 +312,50 @@ bool CrossDexRefMinimizer::empty() const {
 }
 
 DexClass* CrossDexRefMinimizer::front() const {
-  return m_prioritized_classes.front();
+  return m_class_infos[m_prioritized_classes.front()].cls;
 }
 
 DexClass* CrossDexRefMinimizer::worst(bool generated) {
-  auto max_it = m_class_infos.end();
+  const CrossDexRefMinimizer::ClassInfo* max_class_info = nullptr;
   uint64_t max_value = 0;
 
-  for (auto it = m_class_infos.begin(); it != m_class_infos.end(); ++it) {
+  // Classes are visited by increasing index, so when values are equal, the
+  // class that was inserted earlier is preferred, which makes things
+  // deterministic.
+  for (const auto& class_info : m_class_infos) {
     // If requested, let's skip generated classes, as they tend to be not stable
     // and may cause drastic build-over-build changes.
-    if (it->first->rstate.is_generated() != generated) {
+    if (class_info.cls == nullptr ||
+        class_info.cls->rstate.is_generated() != generated) {
       continue;
     }
 
-    const CrossDexRefMinimizer::ClassInfo& class_info = it->second;
     uint64_t value = class_info.seed_weight;
 
     // Prefer the largest denominator
-    if (value < max_value) {
-      continue;
-    }
-
-    // If equal, prefer the class that was inserted earlier (smaller index) to
-    // make things deterministic.
-    if (value == max_value && max_it != m_class_infos.end() &&
-        class_info.index > max_it->second.index) {
+    if (value < max_value ||
+        (value == max_value && max_class_info != nullptr)) {
       continue;
     }
 
-    max_it = it;
+    max_class_info = &class_info;
     max_value = value;
   }
 
-  if (max_it == m_class_infos.end()) {
+  if (max_class_info == nullptr) {
     return nullptr;
   }
 
   TRACE(IDEX, 3,
         "[dex ordering] Picked worst class {%s} with seed %u; "
         "index %u",
-        SHOW(max_it->first), max_value, max_it->second.index);
-  m_stats.worst_classes.emplace_back(max_it->first, max_value);
-  return max_it->first;
+        SHOW(max_class_info->cls), max_value, max_class_info->index);
+  m_stats.worst_classes.emplace_back(max_class_info->cls, max_value);
+  return max_class_info->cls;
 }
 
 DexClass* CrossDexRefMinimizer::worst() {
-  always_assert(!m_class_infos.empty());
+  always_assert(!m_class_indices.empty());
   // We prefer to find a class that is not generated. Only when such a class
   // doesn't exist (because all classes are generated), then we pick the worst
   // generated class.
@@ -331,10 +368,12 @@ DexClass* CrossDexRefMinimizer::worst() {
 }
 
 void CrossDexRefMinimizer::erase(DexClass* cls, bool emitted, bool reset) {
-  m_prioritized_classes.erase(cls);
-  auto class_info_it = m_class_infos.find(cls);
-  always_assert(class_info_it != m_class_infos.end());
-  const CrossDexRefMinimizer::ClassInfo& class_info = class_info_it->second;
+  auto index_it = m_class_indices.find(cls);
+  always_assert(index_it != m_class_indices.end());
+  uint32_t index = index_it->second;
+  m_class_indices.erase(index_it);
+  m_prioritized_classes.erase(index);
+  CrossDexRefMinimizer::ClassInfo& class_info = m_class_infos[index];
   TRACE(IDEX, 3,
         "[dex ordering] Processing class {%s} with priority %016lx; "
         "index %u; %u applied refs weight, %s infrequent refs weights, %u "
@@ -350,68 +389,64 @@ void CrossDexRefMinimizer::erase(DexClass* cls, bool emitted, bool reset) {
   if (reset) {
     TRACE(IDEX, 3, "[dex ordering] Reset");
     ++m_stats.resets;
-    m_applied_refs.clear();
+    for (auto ref : m_applied_refs_list) {
+      m_applied_refs[ref] = false;
+    }
+    m_applied_refs_list.clear();
   }
 
-  std::unordered_map<DexClass*, CrossDexRefMinimizer::ClassInfoDelta>
-      affected_classes;
-  const auto& refs = class_info.refs;
-  size_t old_applied_refs = m_applied_refs.size();
-  for (const std::pair<void*, uint32_t>& p : refs) {
-    void* ref = p.first;
+  // From now on, the class is skipped when walking the classes of a ref.
+  class_info.cls = nullptr;
+  auto refs = std::move(class_info.refs);
+  size_t old_applied_refs = m_applied_refs_list.size();
+  for (const std::pair<RefId, uint32_t>& p : refs) {
+    RefId ref = p.first;
     uint32_t weight = p.second;
-    auto& classes = m_ref_classes.at(ref);
-    size_t frequency = classes.size();
+    size_t frequency = m_ref_frequencies[ref];
     always_assert(frequency > 0);
-    const auto erased = classes.erase(cls);
-    always_assert(erased);
-    if (frequency <= INFREQUENT_REFS_COUNT) {
-      for (DexClass* affected_class : classes) {
-        affected_classes[affected_class]
-            .infrequent_refs_weight[frequency - 1] -= weight;
-      }
-    }
-    --frequency;
-    if (frequency > 0 && frequency <= INFREQUENT_REFS_COUNT) {
-      for (DexClass* affected_class : classes) {
-        affected_classes[affected_class]
-            .infrequent_refs_weight[frequency - 1] += weight;
-      }
-    }
-
-    if (!emitted) {
+    --m_ref_frequencies[ref];
+    bool apply = emitted && !m_applied_refs[ref];
+    if (!apply && frequency > INFREQUENT_REFS_COUNT + 1) {
       continue;
     }
-    if (m_applied_refs.count(ref) != 0) {
-      continue;
-    }
-    m_applied_refs.emplace(ref);
-    for (DexClass* affected_class : classes) {
-      affected_classes[affected_class].applied_refs_weight += weight;
+    walk_ref_classes(ref, [&](uint32_t affected_index) {
+      auto& delta = get_delta(affected_index);
+      if (frequency <= INFREQUENT_REFS_COUNT) {
+        delta.infrequent_refs_weight[frequency - 1] -= weight;
+      }
+      if (frequency > 1 && frequency - 1 <= INFREQUENT_REFS_COUNT) {
+        delta.infrequent_refs_weight[frequency - 2] += weight;
+      }
+      if (apply) {
+        delta.applied_refs_weight += weight;
+      }
+    });
+    if (apply) {
+      m_applied_refs[ref] = true;
+      m_applied_refs_list.push_back(ref);
     }
   }
 
   // Updating m_class_infos and m_prioritized_classes
 
-  m_class_infos.erase(class_info_it);
-  always_assert(m_class_infos.count(cls) == 0);
-
   if (reset) {
     m_prioritized_classes.clear();
-    for (auto it = m_class_infos.begin(); it != m_class_infos.end(); ++it) {
-      DexClass* reset_class = it->first;
-      CrossDexRefMinimizer::ClassInfo& reset_class_info = it->second;
+    for (auto& reset_class_info : m_class_infos) {
+      if (reset_class_info.cls == nullptr) {
+        continue;
+      }
       reset_class_info.applied_refs_weight = 0;
       const auto priority = reset_class_info.get_priority();
-      m_prioritized_classes.insert(reset_class, priority);
+      m_prioritized_classes.insert(reset_class_info.index, priority);
       always_assert(reset_class_info.applied_refs_weight == 0);
     }
   }
   if (emitted) {
     TRACE(IDEX, 4, "[dex ordering] %u + %u = %u applied refs", old_applied_refs,
-          m_applied_refs.size() - old_applied_refs, m_applied_refs.size());
+          m_applied_refs_list.size() - old_applied_refs,
+          m_applied_refs_list.size());
   }
-  reprioritize(affected_classes);
+  reprioritize();
 }
 
 } // namespace interdex
@@ -7,8 +7,8 @@
 
 #pragma once
 
+#include <array>
 #include <unordered_map>
-#include <unordered_set>
 #include <vector>
 
 #include "DexClass.h"
@@ -26,7 +26,8 @@ namespace interdex {
 // minimization, but also causes it to use more memory and run slower.
 constexpr uint64_t INFREQUENT_REFS_COUNT = 6;
 
-using PrioritizedDexClasses = MutablePriorityQueue<DexClass*, uint64_t>;
+// Classes are identified by the dense index under which they were inserted.
+using PrioritizedDexClasses = MutablePriorityQueue<uint32_t, uint64_t>;
 struct CrossDexRefMinimizerStats {
   uint64_t classes{0};
   uint64_t resets{0};
@@ -77,58 +78,92 @@ struct CrossDexRefMinimizerConfig {
 // overflows. In any case, all of this flows into a heuristic, so it wouldn't
 // be the end of the world if an overflow ever happens.
 class CrossDexRefMinimizer {
+  // Refs are identified by dense indices, in the order in which they were
+  // first sampled, so that the per-ref data lives in plain arrays.
+  using RefId = uint32_t;
+
   PrioritizedDexClasses m_prioritized_classes;
-  std::unordered_set<void*> m_applied_refs;
+  // Indexed by RefId; the list of the applied refs makes resetting cheap.
+  std::vector<bool> m_applied_refs;
+  std::vector<RefId> m_applied_refs_list;
+
+  struct ClassInfoDelta {
+    std::array<int32_t, INFREQUENT_REFS_COUNT> infrequent_refs_weight{};
+    int64_t applied_refs_weight{0};
+  };
+
   struct ClassInfo {
+    // Null once the class has been erased.
+    DexClass* cls;
     uint32_t index;
     // This array stores (the weights of) how many of the *refs of this class
     // have only one, two, ... classes left that reference them.
     std::array<uint32_t, INFREQUENT_REFS_COUNT> infrequent_refs_weight;
-    std::vector<std::pair<void*, uint32_t>> refs;
+    std::vector<std::pair<RefId, uint32_t>> refs;
     uint64_t refs_weight;
     uint64_t applied_refs_weight;
     uint64_t seed_weight{0};
-    explicit ClassInfo(uint32_t i)
-        : index(i),
+    // The change of the priority inputs that is pending until reprioritize.
+    ClassInfoDelta delta;
+    bool affected{false};
+    ClassInfo(DexClass* c, uint32_t i)
+        : cls(c),
+          index(i),
           infrequent_refs_weight(),
           refs_weight(0),
           applied_refs_weight(0) {}
     uint64_t get_primary_priority_denominator() const;
     uint64_t get_priority() const;
   };
-  std::unordered_map<DexClass*, ClassInfo> m_class_infos;
-  uint32_t m_next_index{0};
-  std::unordered_map<void*, std::unordered_set<DexClass*>> m_ref_classes;
+  // Indexed by the class index.
+  std::vector<ClassInfo> m_class_infos;
+  std::unordered_map<DexClass*, uint32_t> m_class_indices;
+  std::unordered_map<const void*, RefId> m_ref_ids;
+  // Indexed by RefId: the indices of the classes that have the ref, including
+  // erased classes which are only dropped when the list is next walked, and
+  // the number of classes that are not erased.
+  std::vector<std::vector<uint32_t>> m_ref_classes;
+  std::vector<uint32_t> m_ref_frequencies;
+  // The indices of the classes with a pending delta.
+  std::vector<uint32_t> m_affected_classes;
   CrossDexRefMinimizerStats m_stats;
   const CrossDexRefMinimizerConfig m_config;
 
-  struct ClassInfoDelta {
-    std::array<int32_t, INFREQUENT_REFS_COUNT> infrequent_refs_weight{};
-    int64_t applied_refs_weight{0};
-  };
-
-  void reprioritize(
-      const std::unordered_map<DexClass*, ClassInfoDelta>& affected_classes);
+  ClassInfoDelta& get_delta(uint32_t index);
+  template <typename Fn>
+  void walk_ref_classes(RefId ref, const Fn& fn);
+  void reprioritize();
   DexClass* worst(bool generated);
+  RefId get_ref_id(const void* ref);
 
-  std::unordered_map<void*, size_t> m_ref_counts;
+  std::vector<size_t> m_ref_counts;
   size_t m_max_ref_count{0};
 
-  void gather_refs(DexClass* cls,
-                   std::vector<DexMethodRef*>& method_refs,
-                   std::vector<DexFieldRef*>& field_refs,
-                   std::vector<DexType*>& types,
-                   std::vector<DexString*>& strings);
 
  public:
+  // All relevant references of a class that contribute to cross-dex metadata
+  // entries, deduplicated and sorted deterministically.
+  struct ClassRefs {
+    std::vector<DexMethodRef*> method_refs;
+    std::vector<DexFieldRef*> field_refs;
+    std::vector<DexType*> types;
+    std::vector<DexString*> strings;
+  };
+
   explicit CrossDexRefMinimizer(const CrossDexRefMinimizerConfig& config)
       : m_config(config) {}
+  // Doesn't touch any state, so it may be called for many classes in
+  // parallel ahead of sample and insert.
+  static void gather_refs(DexClass* cls, ClassRefs* refs);
   // Gather frequency counts; must be called for relevant classes before
   // inserting them
   void sample(DexClass* cls);
+  void sample(const ClassRefs& refs);
   // Ignore a class reference when computing weights
   void ignore(DexClass* cls);
   void insert(DexClass* cls);
+  // The refs must be those gathered for cls.
+  void insert(DexClass* cls, const ClassRefs& refs);
   bool empty() const;
   DexClass* front() const;
   // "Worst" in the sense of having highest seed weight.
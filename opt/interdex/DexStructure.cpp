@@ -77,19 +77,24 @@ unsigned estimate_linear_alloc(const DexClass* clazz) {
 }
 
 /**
- * Removes the elements of b from a. Runs in O(size(a)), so it works best if
- * size(a) << size(b).
+ * Stores the ids of the refs in ids, and returns how many of them are not in
+ * the set.
  */
-template <typename T>
-std::unordered_set<T> set_difference(const std::unordered_set<T>& a,
-                                     const std::unordered_set<T>& b) {
-  std::unordered_set<T> result;
-  for (auto& v : a) {
-    if (!b.count(v)) {
-      result.emplace(v);
+template <typename Ref>
+size_t gather_new_ids(const std::unordered_set<Ref*>& refs,
+                      interdex::RefIds<Ref>* ref_ids,
+                      const interdex::RefBitset& set,
+                      std::vector<uint32_t>* ids) {
+  ids->clear();
+  size_t new_ids = 0;
+  for (auto* ref : refs) {
+    auto id = ref_ids->get_or_add(ref);
+    ids->push_back(id);
+    if (!set.contains(id)) {
+      ++new_ids;
     }
   }
-  return result;
+  return new_ids;
 }
 
 } // namespace
@@ -151,7 +156,7 @@ DexClasses DexesStructure::end_dex(DexInfo dex_info) {
 
   DexClasses all_classes = m_current_dex.take_all_classes();
 
-  m_current_dex = DexStructure();
+  m_current_dex = DexStructure(m_ref_ids);
   return all_classes;
 }
 
@@ -186,35 +191,36 @@ bool DexStructure::add_class_if_fits(const MethodRefs& clazz_mrefs,
     return false;
   }
 
-  auto extra_mrefs = set_difference(clazz_mrefs, m_mrefs);
-  auto extra_frefs = set_difference(clazz_frefs, m_frefs);
-  auto extra_trefs = set_difference(clazz_trefs, m_trefs);
+  auto extra = gather_ref_ids(clazz_mrefs, clazz_frefs, clazz_trefs);
+  auto extra_mrefs = extra[0];
+  auto extra_frefs = extra[1];
+  auto extra_trefs = extra[2];
 
-  if (m_mrefs.size() + extra_mrefs.size() >= method_refs_limit) {
+  if (m_mrefs.size() + extra_mrefs >= method_refs_limit) {
     TRACE(IDEX, 6,
           "[warning]: Class won't fit current dex since it will go "
           "over the method refs limit: %d >= %d: %s",
-          m_mrefs.size() + extra_mrefs.size(), method_refs_limit, SHOW(clazz));
+          m_mrefs.size() + extra_mrefs, method_refs_limit, SHOW(clazz));
     return false;
   }
 
-  if (m_frefs.size() + extra_frefs.size() >= MAX_FIELD_REFS) {
+  if (m_frefs.size() + extra_frefs >= MAX_FIELD_REFS) {
     TRACE(IDEX, 6,
           "[warning]: Class won't fit current dex since it will go "
           "over the field refs limit: %d >= %d: %s",
-          m_frefs.size() + extra_frefs.size(), MAX_FIELD_REFS, SHOW(clazz));
+          m_frefs.size() + extra_frefs, MAX_FIELD_REFS, SHOW(clazz));
     return false;
   }
 
-  if (m_trefs.size() + extra_trefs.size() >= type_refs_limit) {
+  if (m_trefs.size() + extra_trefs >= type_refs_limit) {
     TRACE(IDEX, 6,
           "[warning]: Class won't fit current dex since it will go "
           "over the type refs limit: %d >= %d: %s",
-          m_trefs.size() + extra_trefs.size(), type_refs_limit, SHOW(clazz));
+          m_trefs.size() + extra_trefs, type_refs_limit, SHOW(clazz));
     return false;
   }
 
-  add_class_no_checks(clazz_mrefs, clazz_frefs, clazz_trefs, laclazz, clazz);
+  add_class_from_ref_ids(laclazz, clazz);
   return true;
 }
 
@@ -223,10 +229,35 @@ void DexStructure::add_class_no_checks(const MethodRefs& clazz_mrefs,
                                        const TypeRefs& clazz_trefs,
                                        unsigned laclazz,
                                        DexClass* clazz) {
+  gather_ref_ids(clazz_mrefs, clazz_frefs, clazz_trefs);
+  add_class_from_ref_ids(laclazz, clazz);
+}
+
+std::array<size_t, 3> DexStructure::gather_ref_ids(
+    const MethodRefs& clazz_mrefs,
+    const FieldRefs& clazz_frefs,
+    const TypeRefs& clazz_trefs) {
+  return {
+      gather_new_ids(clazz_mrefs, &m_ref_ids->mrefs, m_mrefs,
+                     &m_clazz_mref_ids),
+      gather_new_ids(clazz_frefs, &m_ref_ids->frefs, m_frefs,
+                     &m_clazz_fref_ids),
+      gather_new_ids(clazz_trefs, &m_ref_ids->trefs, m_trefs,
+                     &m_clazz_tref_ids),
+  };
+}
+
+void DexStructure::add_class_from_ref_ids(unsigned laclazz, DexClass* clazz) {
   TRACE(IDEX, 7, "Adding class: %s", SHOW(clazz));
-  m_mrefs.insert(clazz_mrefs.begin(), clazz_mrefs.end());
-  m_frefs.insert(clazz_frefs.begin(), clazz_frefs.end());
-  m_trefs.insert(clazz_trefs.begin(), clazz_trefs.end());
+  for (auto id : m_clazz_mref_ids) {
+    m_mrefs.insert(id);
+  }
+  for (auto id : m_clazz_fref_ids) {
+    m_frefs.insert(id);
+  }
+  for (auto id : m_clazz_tref_ids) {
+    m_trefs.insert(id);
+  }
   m_linear_alloc_size += laclazz;
   m_classes.push_back(clazz);
 }
@@ -249,7 +280,7 @@ void DexStructure::check_refs_count() {
     std::vector<DexMethodRef*> mrefs_vec(mrefs_set.begin(), mrefs_set.end());
     std::sort(mrefs_vec.begin(), mrefs_vec.end(), compare_dexmethods);
     for (DexMethodRef* mr : mrefs_vec) {
-      if (!m_mrefs.count(mr)) {
+      if (!m_mrefs.contains(m_ref_ids->mrefs.get(mr))) {
         TRACE(IDEX, 4, "WARNING: Could not find %s in predicted mrefs set",
               SHOW(mr));
       }
@@ -265,7 +296,7 @@ void DexStructure::check_refs_count() {
     std::vector<DexFieldRef*> frefs_vec(frefs_set.begin(), frefs_set.end());
     std::sort(frefs_vec.begin(), frefs_vec.end(), compare_dexfields);
     for (auto* fr : frefs_vec) {
-      if (!m_frefs.count(fr)) {
+      if (!m_frefs.contains(m_ref_ids->frefs.get(fr))) {
         TRACE(IDEX, 4, "WARNING: Could not find %s in predicted frefs set",
               SHOW(fr));
       }
@@ -283,7 +314,7 @@ void DexStructure::squash_empty_last_class(DexClass* clazz) {
   always_assert(clazz->get_ifields().empty());
   always_assert(!is_interface(clazz));
   m_classes.pop_back();
-  m_trefs.erase(clazz->get_type());
+  m_trefs.erase(m_ref_ids->trefs.get(clazz->get_type()));
   m_squashed_classes.push_back(clazz);
 }
 
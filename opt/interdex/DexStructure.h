@@ -7,6 +7,10 @@
 
 #pragma once
 
+#include <algorithm>
+#include <array>
+#include <memory>
+#include <unordered_map>
 #include <unordered_set>
 #include <vector>
 
@@ -28,9 +32,76 @@ struct DexInfo {
   bool scroll{false};
 };
 
+/**
+ * Dense ids for the refs of one kind. They are shared by all the dexes that
+ * are filled one after another, so that the refs of each dex can be kept in a
+ * bitset.
+ */
+template <typename Ref>
+class RefIds {
+ public:
+  uint32_t get_or_add(Ref* ref) {
+    return m_ids.emplace(ref, m_ids.size()).first->second;
+  }
+
+  /**
+   * Returns size() if the ref doesn't have an id yet.
+   */
+  uint32_t get(Ref* ref) const {
+    auto it = m_ids.find(ref);
+    return it == m_ids.end() ? size() : it->second;
+  }
+
+  uint32_t size() const { return m_ids.size(); }
+
+ private:
+  std::unordered_map<Ref*, uint32_t> m_ids;
+};
+
+struct DexRefIds {
+  RefIds<DexMethodRef> mrefs;
+  RefIds<DexFieldRef> frefs;
+  RefIds<DexType> trefs;
+};
+
+/**
+ * A set of refs of one kind, as a bitset over their dense ids, along with
+ * its number of elements.
+ */
+class RefBitset {
+ public:
+  size_t size() const { return m_size; }
+
+  bool contains(uint32_t id) const { return id < m_bits.size() && m_bits[id]; }
+
+  void insert(uint32_t id) {
+    if (id >= m_bits.size()) {
+      m_bits.resize(std::max<size_t>(id + 1, 2 * m_bits.size()));
+    }
+    if (!m_bits[id]) {
+      m_bits[id] = true;
+      ++m_size;
+    }
+  }
+
+  void erase(uint32_t id) {
+    if (contains(id)) {
+      m_bits[id] = false;
+      --m_size;
+    }
+  }
+
+ private:
+  std::vector<bool> m_bits;
+  size_t m_size{0};
+};
+
 class DexStructure {
  public:
-  DexStructure() : m_linear_alloc_size(0) {}
+  DexStructure() : DexStructure(std::make_shared<DexRefIds>()) {}
+
+  explicit DexStructure(std::shared_ptr<DexRefIds> ref_ids)
+      : m_linear_alloc_size(0), m_ref_ids(std::move(ref_ids)) {}
 
   size_t get_linear_alloc_size() const { return m_linear_alloc_size; }
 
@@ -66,10 +137,28 @@ class DexStructure {
   void squash_empty_last_class(DexClass* clazz);
 
  private:
+  /**
+   * Fills the id buffers with the refs of the class, and returns the number
+   * of method, field and type refs that aren't in this dex yet.
+   */
+  std::array<size_t, 3> gather_ref_ids(const MethodRefs& clazz_mrefs,
+                                       const FieldRefs& clazz_frefs,
+                                       const TypeRefs& clazz_trefs);
+
+  /**
+   * Adds the class whose refs are in the id buffers.
+   */
+  void add_class_from_ref_ids(unsigned laclazz, DexClass* clazz);
+
   size_t m_linear_alloc_size;
-  TypeRefs m_trefs;
-  MethodRefs m_mrefs;
-  FieldRefs m_frefs;
+  std::shared_ptr<DexRefIds> m_ref_ids;
+  RefBitset m_trefs;
+  RefBitset m_mrefs;
+  RefBitset m_frefs;
+  // Reused for the ids of the refs of the class that is being added.
+  std::vector<uint32_t> m_clazz_mref_ids;
+  std::vector<uint32_t> m_clazz_fref_ids;
+  std::vector<uint32_t> m_clazz_tref_ids;
   std::vector<DexClass*> m_classes;
   std::vector<DexClass*> m_squashed_classes;
 };
@@ -157,8 +246,10 @@ class DexesStructure {
                     const FieldRefs& clazz_frefs,
                     DexClass* clazz);
 
+  std::shared_ptr<DexRefIds> m_ref_ids{std::make_shared<DexRefIds>()};
+
   // NOTE: Keeps track only of the last dex.
-  DexStructure m_current_dex;
+  DexStructure m_current_dex{m_ref_ids};
 
   // All the classes that end up added in the dexes.
   std::unordered_set<DexClass*> m_classes;
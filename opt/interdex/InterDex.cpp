@@ -26,6 +26,7 @@
 #include "ReachableClasses.h"
 #include "StringUtil.h"
 #include "Walkers.h"
+#include "WorkQueue.h"
 #include "file-utils.h"
 
 namespace {
@@ -210,6 +211,22 @@ void do_order_classes(const std::vector<std::string>& coldstart_class_names,
 
 namespace interdex {
 
+PrecomputedClassRefs precompute_class_refs(const Scope& scope) {
+  PrecomputedClassRefs precomputed_refs;
+  precomputed_refs.reserve(scope.size());
+  for (const DexClass* cls : scope) {
+    precomputed_refs[cls];
+  }
+  // The map doesn't change anymore, so each class can fill its own entry.
+  walk::parallel::classes(scope, [&precomputed_refs](DexClass* cls) {
+    auto& refs = precomputed_refs.at(cls);
+    gather_refs({}, EMPTY_DEX_INFO, cls, &refs.mrefs, &refs.frefs, &refs.trefs,
+                /* erased_classes */ nullptr,
+                /* should_not_relocate_methods_of_class */ false);
+  });
+  return precomputed_refs;
+}
+
 bool is_canary(DexClass* clazz) {
   const char* cname = clazz->get_type()->get_name()->c_str();
   return strncmp(cname, CANARY_PREFIX, strlen(CANARY_PREFIX)) == 0;
@@ -268,6 +285,20 @@ bool InterDex::emit_class(DexInfo& dex_info,
     clazz->set_perf_sensitive(true);
   }
 
+  if (m_precomputed_refs != nullptr) {
+    auto it = m_precomputed_refs->find(clazz);
+    if (it != m_precomputed_refs->end()) {
+      const auto& refs = it->second;
+      if (!m_dexes_structure.add_class_to_current_dex(refs.mrefs, refs.frefs,
+                                                      refs.trefs, clazz)) {
+        flush_out_dex(dex_info);
+        m_dexes_structure.add_class_no_checks(refs.mrefs, refs.frefs,
+                                              refs.trefs, clazz);
+      }
+      return true;
+    }
+  }
+
   // Calculate the extra method and field refs that we would need to add to
   // the current dex if we defined clazz in it.
   MethodRefs clazz_mrefs;
@@ -628,6 +659,8 @@ void InterDex::init_cross_dex_ref_minimizer_and_relocate_methods() {
   }
 
   std::vector<DexClass*> classes_to_insert;
+  // Classes that are skipped, but whose refs may still be emitted later.
+  std::vector<DexClass*> classes_to_sample;
   // Emit classes using some algorithm to group together classes which
   // tend to share the same refs.
   for (DexClass* cls : m_scope) {
@@ -662,22 +695,42 @@ void InterDex::init_cross_dex_ref_minimizer_and_relocate_methods() {
       // class will get emitted later via the additional-class mechanism,
       // which is accounted for via the erased_classes reported through the
       // plugin's gather_refs callback. So we'll also sample those classes here.
-      m_cross_dex_ref_minimizer.sample(cls);
+      classes_to_sample.emplace_back(cls);
       continue;
     }
 
     classes_to_insert.emplace_back(cls);
   }
 
+  // Gathering the refs walks all instructions, so it's done in parallel; only
+  // the counts and the priority queue are updated serially.
+  auto gather_class_refs = [](const std::vector<DexClass*>& classes) {
+    std::vector<CrossDexRefMinimizer::ClassRefs> class_refs(classes.size());
+    auto wq = workqueue_foreach<size_t>([&](size_t i) {
+      CrossDexRefMinimizer::gather_refs(classes[i], &class_refs[i]);
+    });
+    for (size_t i = 0; i < classes.size(); ++i) {
+      wq.add_item(i);
+    }
+    wq.run_all();
+    return class_refs;
+  };
+
   // Initialize ref frequency counts
-  for (DexClass* cls : classes_to_insert) {
-    m_cross_dex_ref_minimizer.sample(cls);
+  for (const auto& class_refs : gather_class_refs(classes_to_sample)) {
+    m_cross_dex_ref_minimizer.sample(class_refs);
+  }
+  auto classes_to_insert_refs = gather_class_refs(classes_to_insert);
+  for (const auto& class_refs : classes_to_insert_refs) {
+    m_cross_dex_ref_minimizer.sample(class_refs);
   }
 
   // Emit classes using some algorithm to group together classes which
   // tend to share the same refs.
-  for (DexClass* cls : classes_to_insert) {
-    m_cross_dex_ref_minimizer.insert(cls);
+  for (size_t i = 0; i < classes_to_insert.size(); ++i) {
+    m_cross_dex_ref_minimizer.insert(classes_to_insert[i],
+                                     classes_to_insert_refs[i]);
+    classes_to_insert_refs[i] = CrossDexRefMinimizer::ClassRefs();
   }
 }
 
@@ -854,8 +907,12 @@ void InterDex::run() {
   print_stats(&m_dexes_structure);
 }
 
-void InterDex::run_on_nonroot_store() {
+void InterDex::run_on_nonroot_store(
+    const PrecomputedClassRefs* precomputed_refs) {
   TRACE(IDEX, 2, "IDEX: Running on non-root store");
+  if (m_plugins.empty()) {
+    m_precomputed_refs = precomputed_refs;
+  }
   for (DexClass* cls : m_original_scope) {
     emit_class(EMPTY_DEX_INFO, cls, /* check_if_skip */ false,
                /* perf_sensitive */ false);
@@ -867,6 +924,7 @@ void InterDex::run_on_nonroot_store() {
   }
 
   print_stats(&m_dexes_structure);
+  m_precomputed_refs = nullptr;
 }
 
 void InterDex::add_dexes_from_store(const DexStore& store) {
@@ -7,6 +7,7 @@
 
 #pragma once
 
+#include <unordered_map>
 #include <unordered_set>
 
 #include "ApkManager.h"
@@ -23,6 +24,23 @@ namespace interdex {
 
 bool is_canary(DexClass* clazz);
 
+/**
+ * The refs of a class that count towards the dex limits, as gathered without
+ * any plugins.
+ */
+struct ClassRefs {
+  MethodRefs mrefs;
+  FieldRefs frefs;
+  TypeRefs trefs;
+};
+using PrecomputedClassRefs = std::unordered_map<const DexClass*, ClassRefs>;
+
+/**
+ * Gathers the refs of all the classes in parallel, so that they can be shared
+ * by the runs that don't have plugins.
+ */
+PrecomputedClassRefs precompute_class_refs(const Scope& scope);
+
 class InterDex {
  public:
   InterDex(const Scope& original_scope,
@@ -95,7 +113,12 @@ class InterDex {
   DexClassesVector take_outdex() { return std::move(m_outdex); }
 
   void run();
-  void run_on_nonroot_store();
+  /**
+   * The refs of the classes are taken from precomputed_refs when given; they
+   * must have been gathered after any change to the classes.
+   */
+  void run_on_nonroot_store(
+      const PrecomputedClassRefs* precomputed_refs = nullptr);
   void add_dexes_from_store(const DexStore& store);
   void cleanup(const Scope& final_scope);
   const std::vector<DexType*>& get_interdex_types() const {
@@ -168,6 +191,8 @@ class InterDex {
   Scope m_scope;
   std::vector<DexType*> m_interdex_types;
   const XStoreRefs* m_xstore_refs;
+  // Only set while there are no plugins.
+  const PrecomputedClassRefs* m_precomputed_refs{nullptr};
 };
 
 } // namespace interdex
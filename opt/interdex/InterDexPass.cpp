@@ -166,12 +166,13 @@ void InterDexPass::run_pass(DexStoresVector& stores,
                  cross_dex_relocator_stats.relocated_virtual_methods);
 }
 
-void InterDexPass::run_pass_on_nonroot_store(DexStoresVector& stores,
-                                             DexClassesVector& dexen,
-                                             ConfigFiles& conf,
-                                             PassManager& mgr) {
-  auto original_scope = build_class_scope(stores);
-
+void InterDexPass::run_pass_on_nonroot_store(
+    const Scope& original_scope,
+    const XStoreRefs& xstore_refs,
+    const PrecomputedClassRefs& precomputed_refs,
+    DexClassesVector& dexen,
+    ConfigFiles& conf,
+    PassManager& mgr) {
   // Setup default configs for non-root store
   // For now, no plugins configured for non-root stores
   std::vector<std::unique_ptr<InterDexPassPlugin>> plugins;
@@ -184,7 +185,6 @@ void InterDexPass::run_pass_on_nonroot_store(DexStoresVector& stores,
   CrossDexRelocatorConfig cross_dex_relocator_config;
 
   // Initialize interdex and run for nonroot store
-  XStoreRefs xstore_refs(stores);
   InterDex interdex(original_scope, dexen, mgr.apk_manager(), conf, plugins,
                     m_linear_alloc_limit, m_type_refs_limit, m_static_prune,
                     m_normal_primary_dex, false /* force single dex */,
@@ -192,10 +192,11 @@ void InterDexPass::run_pass_on_nonroot_store(DexStoresVector& stores,
                     false /* minimize_cross_dex_refs */, cross_dex_refs_config,
                     cross_dex_relocator_config, reserve_mrefs, &xstore_refs);
 
-  interdex.run_on_nonroot_store();
+  interdex.run_on_nonroot_store(&precomputed_refs);
 
-  auto final_scope = build_class_scope(stores);
-  interdex.cleanup(final_scope);
+  // The non-root stores don't change any class, so the final scope is the
+  // original one.
+  interdex.cleanup(original_scope);
 }
 
 void InterDexPass::run_pass(DexStoresVector& stores,
@@ -208,16 +209,37 @@ void InterDexPass::run_pass(DexStoresVector& stores,
     return;
   }
 
-  auto wq = workqueue_foreach<DexStore*>([&](DexStore* store) {
-    run_pass_on_nonroot_store(stores, store->get_dexen(), conf, mgr);
-  });
+  // The root store changes the classes and the stores, so it has to run
+  // before the others.
   for (auto& store : stores) {
     if (store.is_root_store()) {
       run_pass(stores, store.get_dexen(), conf, mgr);
-    } else {
-      wq.add_item(&store);
     }
   }
+
+  std::vector<DexStore*> nonroot_stores;
+  for (auto& store : stores) {
+    if (!store.is_root_store()) {
+      nonroot_stores.push_back(&store);
+    }
+  }
+  if (nonroot_stores.empty()) {
+    return;
+  }
+
+  // All the non-root stores see the same classes and don't change them, so
+  // their scope, cross-store refs, and the refs of each class are computed
+  // once and shared.
+  auto original_scope = build_class_scope(stores);
+  XStoreRefs xstore_refs(stores);
+  auto precomputed_refs = precompute_class_refs(original_scope);
+  auto wq = workqueue_foreach<DexStore*>([&](DexStore* store) {
+    run_pass_on_nonroot_store(original_scope, xstore_refs, precomputed_refs,
+                              store->get_dexen(), conf, mgr);
+  });
+  for (DexStore* store : nonroot_stores) {
+    wq.add_item(store);
+  }
   wq.run_all();
 }
 
@@ -78,7 +78,9 @@ class InterDexPass : public Pass {
                         ConfigFiles&,
                         PassManager&);
 
-  void run_pass_on_nonroot_store(DexStoresVector&,
+  void run_pass_on_nonroot_store(const Scope&,
+                                 const XStoreRefs&,
+                                 const PrecomputedClassRefs&,
                                  DexClassesVector&,
                                  ConfigFiles&,
                                  PassManager&);
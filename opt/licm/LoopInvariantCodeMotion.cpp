@@ -0,0 +1,375 @@
+/*
+ * Copyright (c) Facebook, Inc. and its affiliates.
+ *
+ * This source code is licensed under the MIT license found in the
+ * LICENSE file in the root directory of this source tree.
+ */
+
+/*
+ * This pass hoists loop-invariant computations into the preheader of their
+ * loop, so that they are evaluated once instead of once per iteration.
+ *
+ * For example:
+ *
+ *   L0: CONST v1, 42
+ *       ADD_INT v2, v0, v1
+ *       ... (uses of v2, no other writes of v0, v1, v2)
+ *       IF_NEZ v3, L0
+ *
+ * becomes
+ *
+ *       CONST v1, 42
+ *       ADD_INT v2, v0, v1
+ *   L0: ...
+ *       IF_NEZ v3, L0
+ *
+ * Since the hoisted code also runs when the instruction would not have been
+ * reached in the loop, only computations that can neither throw nor have side
+ * effects are hoisted: constants, moves, arithmetic that cannot trap, reads of
+ * the static final fields of the method's own class, and calls to pure static
+ * methods on primitives.
+ *
+ * An instruction is invariant if none of its sources are written in the loop.
+ * It can be hoisted if, in addition, it is the only write of its destination
+ * in the loop, and the destination is not live-in at the loop header, i.e.
+ * the value it held before the loop is never read.
+ */
+
+#include "LoopInvariantCodeMotion.h"
+
+#include <vector>
+
+#include "ControlFlow.h"
+#include "DexUtil.h"
+#include "IRCode.h"
+#include "IRInstruction.h"
+#include "Liveness.h"
+#include "LoopInfo.h"
+#include "MethodUtil.h"
+#include "Purity.h"
+#include "Resolver.h"
+#include "Trace.h"
+#include "Walkers.h"
+
+namespace {
+
+constexpr const char* METRIC_LOOPS = "num_loops";
+constexpr const char* METRIC_INSTRUCTIONS_HOISTED = "num_instructions_hoisted";
+
+bool is_hoistable_opcode(IROpcode op) {
+  switch (op) {
+  case OPCODE_CONST:
+  case OPCODE_CONST_WIDE:
+  case OPCODE_MOVE:
+  case OPCODE_MOVE_WIDE:
+  case OPCODE_MOVE_OBJECT:
+
+  case OPCODE_NEG_INT:
+  case OPCODE_NOT_INT:
+  case OPCODE_NEG_LONG:
+  case OPCODE_NOT_LONG:
+  case OPCODE_NEG_FLOAT:
+  case OPCODE_NEG_DOUBLE:
+  case OPCODE_INT_TO_LONG:
+  case OPCODE_INT_TO_FLOAT:
+  case OPCODE_INT_TO_DOUBLE:
+  case OPCODE_LONG_TO_INT:
+  case OPCODE_LONG_TO_FLOAT:
+  case OPCODE_LONG_TO_DOUBLE:
+  case OPCODE_FLOAT_TO_INT:
+  case OPCODE_FLOAT_TO_LONG:
+  case OPCODE_FLOAT_TO_DOUBLE:
+  case OPCODE_DOUBLE_TO_INT:
+  case OPCODE_DOUBLE_TO_LONG:
+  case OPCODE_DOUBLE_TO_FLOAT:
+  case OPCODE_INT_TO_BYTE:
+  case OPCODE_INT_TO_CHAR:
+  case OPCODE_INT_TO_SHORT:
+  case OPCODE_CMPL_FLOAT:
+  case OPCODE_CMPG_FLOAT:
+  case OPCODE_CMPL_DOUBLE:
+  case OPCODE_CMPG_DOUBLE:
+  case OPCODE_CMP_LONG:
+
+  // Integer division and remainder are left out, as they throw on zero.
+  case OPCODE_ADD_INT:
+  case OPCODE_SUB_INT:
+  case OPCODE_MUL_INT:
+  case OPCODE_AND_INT:
+  case OPCODE_OR_INT:
+  case OPCODE_XOR_INT:
+  case OPCODE_SHL_INT:
+  case OPCODE_SHR_INT:
+  case OPCODE_USHR_INT:
+  case OPCODE_ADD_LONG:
+  case OPCODE_SUB_LONG:
+  case OPCODE_MUL_LONG:
+  case OPCODE_AND_LONG:
+  case OPCODE_OR_LONG:
+  case OPCODE_XOR_LONG:
+  case OPCODE_SHL_LONG:
+  case OPCODE_SHR_LONG:
+  case OPCODE_USHR_LONG:
+  case OPCODE_ADD_FLOAT:
+  case OPCODE_SUB_FLOAT:
+  case OPCODE_MUL_FLOAT:
+  case OPCODE_DIV_FLOAT:
+  case OPCODE_REM_FLOAT:
+  case OPCODE_ADD_DOUBLE:
+  case OPCODE_SUB_DOUBLE:
+  case OPCODE_MUL_DOUBLE:
+  case OPCODE_DIV_DOUBLE:
+  case OPCODE_REM_DOUBLE:
+  case OPCODE_ADD_INT_LIT16:
+  case OPCODE_RSUB_INT:
+  case OPCODE_MUL_INT_LIT16:
+  case OPCODE_AND_INT_LIT16:
+  case OPCODE_OR_INT_LIT16:
+  case OPCODE_XOR_INT_LIT16:
+  case OPCODE_ADD_INT_LIT8:
+  case OPCODE_RSUB_INT_LIT8:
+  case OPCODE_MUL_INT_LIT8:
+  case OPCODE_AND_INT_LIT8:
+  case OPCODE_OR_INT_LIT8:
+  case OPCODE_XOR_INT_LIT8:
+  case OPCODE_SHL_INT_LIT8:
+  case OPCODE_SHR_INT_LIT8:
+  case OPCODE_USHR_INT_LIT8:
+    return true;
+
+  default:
+    return false;
+  }
+}
+
+// Pure methods that may still throw, and thus can't run speculatively.
+bool may_throw(const DexMethodRef* method) {
+  const auto& name = method->get_name()->str();
+  return name == "floorDiv" || name == "floorMod";
+}
+
+// Whether the instruction can be executed ahead of the loop, even if it
+// would not have been reached in it. Instructions with a move-result are only
+// considered if they are followed by it.
+bool can_run_speculatively(
+    const IRInstruction* insn,
+    const std::unordered_set<DexMethodRef*>& pure_methods,
+    const DexType* declaring_type) {
+  auto op = insn->opcode();
+  if (is_hoistable_opcode(op)) {
+    return true;
+  }
+  if (is_sget(op)) {
+    // The class of the method is initialized by the time the method runs, and
+    // its final fields are only written in <clinit>.
+    if (declaring_type == nullptr) {
+      return false;
+    }
+    auto field = resolve_field(insn->get_field(), FieldSearch::Static);
+    return field != nullptr && is_final(field) &&
+           field->get_class() == declaring_type;
+  }
+  if (op == OPCODE_INVOKE_STATIC) {
+    auto method = insn->get_method();
+    if (!pure_methods.count(method) || may_throw(method)) {
+      return false;
+    }
+    // Calls without arguments, e.g. Math.random, are not deterministic.
+    auto proto = method->get_proto();
+    auto args = proto->get_args()->get_type_list();
+    if (args.empty() || proto->get_rtype() == type::_void() ||
+        !type::is_primitive(proto->get_rtype())) {
+      return false;
+    }
+    for (auto arg : args) {
+      if (!type::is_primitive(arg)) {
+        return false;
+      }
+    }
+    return true;
+  }
+  return false;
+}
+
+void count_def(reg_t reg,
+               bool wide,
+               int delta,
+               std::unordered_map<reg_t, int>* defs) {
+  (*defs)[reg] += delta;
+  if (wide) {
+    (*defs)[reg + 1] += delta;
+  }
+}
+
+int num_defs(reg_t reg, const std::unordered_map<reg_t, int>& defs) {
+  auto it = defs.find(reg);
+  return it == defs.end() ? 0 : it->second;
+}
+
+bool is_written(reg_t reg,
+                bool wide,
+                const std::unordered_map<reg_t, int>& defs) {
+  return num_defs(reg, defs) != 0 || (wide && num_defs(reg + 1, defs) != 0);
+}
+
+// Hoists the invariant instructions of the given blocks into the preheader,
+// and returns how many were hoisted.
+size_t hoist(cfg::ControlFlowGraph& cfg,
+             const std::vector<cfg::Block*>& blocks,
+             cfg::Block* header,
+             cfg::Block* preheader,
+             const std::unordered_set<DexMethodRef*>& pure_methods,
+             const DexType* declaring_type) {
+  std::unordered_set<cfg::Block*> block_set(blocks.begin(), blocks.end());
+  std::unordered_map<reg_t, int> defs;
+  for (auto block : blocks) {
+    for (auto& mie : InstructionIterable(block)) {
+      auto insn = mie.insn;
+      if (insn->has_dest()) {
+        count_def(insn->dest(), insn->dest_is_wide(), 1, &defs);
+      }
+    }
+  }
+
+  LivenessFixpointIterator liveness(cfg);
+  liveness.run(LivenessDomain());
+  auto live_in = liveness.get_live_in_vars_at(header);
+
+  // The instructions to hoist, in dependency order, along with their
+  // move-results.
+  std::vector<cfg::InstructionIterator> hoisted;
+  std::unordered_set<const IRInstruction*> hoisted_insns;
+  bool changed = true;
+  while (changed) {
+    changed = false;
+    for (auto block : blocks) {
+      auto ii = InstructionIterable(block);
+      for (auto mie_it = ii.begin(); mie_it != ii.end(); ++mie_it) {
+        auto insn = mie_it->insn;
+        if (hoisted_insns.count(insn) ||
+            !can_run_speculatively(insn, pure_methods, declaring_type)) {
+          continue;
+        }
+        auto it = block->to_cfg_instruction_iterator(mie_it);
+        auto dest_insn = insn;
+        if (insn->has_move_result_any()) {
+          auto move_result = cfg.move_result_of(it);
+          if (move_result.is_end() || !block_set.count(move_result.block())) {
+            continue;
+          }
+          dest_insn = move_result->insn;
+        }
+        auto dest = dest_insn->dest();
+        auto dest_is_wide = dest_insn->dest_is_wide();
+        bool invariant = true;
+        for (size_t i = 0; i < insn->srcs_size(); ++i) {
+          if (is_written(insn->src(i), insn->src_is_wide(i), defs)) {
+            invariant = false;
+            break;
+          }
+        }
+        if (!invariant || num_defs(dest, defs) != 1 ||
+            (dest_is_wide && num_defs(dest + 1, defs) != 1) ||
+            live_in.contains(dest) ||
+            (dest_is_wide && live_in.contains(dest + 1))) {
+          continue;
+        }
+        // Nothing in the loop writes the destination anymore, so that the
+        // instructions using it may now be invariant too.
+        count_def(dest, dest_is_wide, -1, &defs);
+        hoisted.push_back(it);
+        hoisted_insns.insert(insn);
+        changed = true;
+      }
+    }
+  }
+
+  if (hoisted.empty()) {
+    return 0;
+  }
+  std::vector<IRInstruction*> copies;
+  for (const auto& it : hoisted) {
+    copies.push_back(new IRInstruction(*it->insn));
+    if (it->insn->has_move_result_any()) {
+      copies.push_back(new IRInstruction(*cfg.move_result_of(it)->insn));
+    }
+  }
+  // Removing an instruction also removes its move-result, which may be in
+  // another block, but leaves the iterators to the other instructions valid.
+  for (const auto& it : hoisted) {
+    cfg.remove_insn(it);
+  }
+  preheader->push_back(copies);
+  return hoisted.size();
+}
+
+} // namespace
+
+LoopInvariantCodeMotionPass::Stats LoopInvariantCodeMotionPass::process_code(
+    const std::unordered_set<DexMethodRef*>& pure_methods,
+    const DexType* declaring_type,
+    IRCode* code) {
+  Stats stats;
+  code->build_cfg(/* editable */ true);
+  auto& cfg = code->cfg();
+  // For the liveness analysis.
+  cfg.calculate_exit_block();
+  {
+    loop_impl::LoopInfo loop_info(cfg);
+    // Inner loops come last, and are processed first, so that what is hoisted
+    // into their preheaders can be hoisted again out of the outer loops.
+    for (auto it = loop_info.rbegin(); it != loop_info.rend(); ++it) {
+      auto loop = *it;
+      auto header = loop->get_header();
+      auto preheader = loop->get_preheader();
+      // The preheader of a loop at the entry of the method is unreachable, and
+      // a catch block can only be entered by throwing.
+      if (preheader->preds().empty() || header->is_catch()) {
+        continue;
+      }
+      stats.loops++;
+      auto blocks = loop->get_blocks();
+      for (auto other : loop_info) {
+        if (other != loop && loop->contains(other)) {
+          blocks.push_back(other->get_preheader());
+        }
+      }
+      stats.instructions_hoisted += hoist(cfg, blocks, header, preheader,
+                                          pure_methods, declaring_type);
+    }
+  }
+  code->clear_cfg();
+  return stats;
+}
+
+void LoopInvariantCodeMotionPass::run_pass(DexStoresVector& stores,
+                                           ConfigFiles& /* unused */,
+                                           PassManager& mgr) {
+  auto scope = build_class_scope(stores);
+  const auto pure_methods = get_pure_methods();
+
+  Stats stats =
+      walk::parallel::methods<Stats>(scope, [&](DexMethod* method) {
+        const auto code = method->get_code();
+        if (!code) {
+          return Stats{};
+        }
+
+        Stats stats = LoopInvariantCodeMotionPass::process_code(
+            pure_methods,
+            method::is_clinit(method) ? nullptr : method->get_class(), code);
+        if (stats.instructions_hoisted) {
+          TRACE(LOOP, 3,
+                "[licm] Hoisted %u instructions out of %u loops in {%s}",
+                stats.instructions_hoisted, stats.loops, SHOW(method));
+        }
+        return stats;
+      });
+
+  mgr.incr_metric(METRIC_LOOPS, stats.loops);
+  mgr.incr_metric(METRIC_INSTRUCTIONS_HOISTED, stats.instructions_hoisted);
+  TRACE(LOOP, 1, "[licm] Hoisted %u instructions out of %u loops in total",
+        stats.instructions_hoisted, stats.loops);
+}
+
+static LoopInvariantCodeMotionPass s_pass;
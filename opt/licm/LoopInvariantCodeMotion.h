@@ -0,0 +1,44 @@
+/*
+ * Copyright (c) Facebook, Inc. and its affiliates.
+ *
+ * This source code is licensed under the MIT license found in the
+ * LICENSE file in the root directory of this source tree.
+ */
+
+#pragma once
+
+#include <unordered_set>
+
+#include "DexClass.h"
+#include "Pass.h"
+
+class LoopInvariantCodeMotionPass : public Pass {
+ public:
+  struct Stats {
+    size_t loops{0};
+    size_t instructions_hoisted{0};
+
+    Stats& operator+=(const Stats& that) {
+      loops += that.loops;
+      instructions_hoisted += that.instructions_hoisted;
+      return *this;
+    }
+  };
+
+  LoopInvariantCodeMotionPass() : Pass("LoopInvariantCodeMotionPass") {}
+
+  bool is_cfg_legal() const override { return true; }
+
+  void run_pass(DexStoresVector&, ConfigFiles&, PassManager&) override;
+
+  /*
+   * Hoists the invariant computations of all loops of the code into their
+   * preheaders, innermost loops first. Reads of the static final fields of
+   * declaring_type are considered invariant, unless declaring_type is null,
+   * which it must be for a <clinit>.
+   */
+  static Stats process_code(
+      const std::unordered_set<DexMethodRef*>& pure_methods,
+      const DexType* declaring_type,
+      IRCode* code);
+};
@@ -21,6 +21,7 @@
 #include "IRCode.h"
 #include "IRInstruction.h"
 #include "MethodOverrideGraph.h"
+#include "PassManager.h"
 #include "Purity.h"
 #include "Resolver.h"
 #include "Transform.h"
@@ -50,11 +51,12 @@ void LocalDcePass::run_pass(DexStoresVector& stores,
                       configured_pure_methods.end());
   auto rstate_pure_method = get_rstate_pure_methods(scope);
   pure_methods.insert(rstate_pure_method.begin(), rstate_pure_method.end());
-  auto override_graph = method_override_graph::build_graph(scope);
-  std::unordered_set<const DexMethod*> computed_no_side_effects_methods;
+  auto override_graph = mgr.analysis_cache().method_override_graph(scope);
+  auto no_side_effects =
+      mgr.analysis_cache().no_side_effects_methods(scope, pure_methods);
+  const auto& computed_no_side_effects_methods = no_side_effects->methods;
   auto computed_no_side_effects_methods_iterations =
-      compute_no_side_effects_methods(scope, override_graph.get(), pure_methods,
-                                      &computed_no_side_effects_methods);
+      no_side_effects->iterations;
   for (auto m : computed_no_side_effects_methods) {
     pure_methods.insert(const_cast<DexMethod*>(m));
   }
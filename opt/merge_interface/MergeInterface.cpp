@@ -560,9 +560,9 @@ void update_after_merge(
     const std::unordered_map<const DexType*, DexType*>& intf_merge_map,
     const std::unordered_map<DexMethodRef*, DexMethodRef*>& old_to_new_method,
     const ClassHierarchy& ch) {
-  type_reference::update_method_signature_type_references(scope, intf_merge_map,
-                                                          ch);
-  type_reference::update_field_type_references(scope, intf_merge_map);
+  type_reference::BatchRefUpdater ref_updater;
+  ref_updater.add_types(intf_merge_map);
+  ref_updater.apply(scope, ch);
   update_reference_for_code(scope, intf_merge_map, old_to_new_method);
   remove_implements(scope, intf_merge_map);
 }
@@ -22,8 +22,17 @@ void PerfMethodInlinePass::run_pass(DexStoresVector& stores,
     TRACE(METH_PROF, 1, "PerfMethodInlinePass requires --enable-pgi to run");
     return;
   }
-  inliner::run_inliner(
-      stores, mgr, conf, /* intra_dex */ true, /* use_method_profiles */ true);
+  basic_block_profiles::BasicBlockProfiles block_profiles;
+  bool has_block_profiles = !m_index_filename.empty() &&
+                            !m_stats_filename.empty() &&
+                            block_profiles.initialize(m_index_filename,
+                                                      m_stats_filename);
+  if (!m_index_filename.empty() && !has_block_profiles) {
+    TRACE(METH_PROF, 1, "PerfMethodInlinePass: cannot load the block profile");
+  }
+  inliner::run_inliner(stores, mgr, conf, /* intra_dex */ true,
+                       /* use_method_profiles */ true,
+                       has_block_profiles ? &block_profiles : nullptr);
 }
 
 static PerfMethodInlinePass s_pass;
@@ -14,5 +14,17 @@ class PerfMethodInlinePass : public Pass {
  public:
   PerfMethodInlinePass() : Pass("PerfMethodInlinePass") {}
 
+  void bind_config() override {
+    bind("basic_block_index_file", "", m_index_filename,
+         "The metadata file written by basic_block_tracing.");
+    bind("basic_block_stats_file", "", m_stats_filename,
+         "The collected sBasicBlockStats, as \"<index>,<value>\" lines. The "
+         "call sites that never ran are not inlined.");
+  }
+
   void run_pass(DexStoresVector&, ConfigFiles&, PassManager&) override;
+
+ private:
+  std::string m_index_filename;
+  std::string m_stats_filename;
 };
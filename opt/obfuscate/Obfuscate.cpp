@@ -8,6 +8,7 @@
 #include <list>
 
 #include "ClassHierarchy.h"
+#include "ConcurrentContainers.h"
 #include "DexClass.h"
 #include "DexUtil.h"
 #include "IRCode.h"
@@ -78,26 +79,24 @@ template <typename DexMember,
           typename K>
 DexMember* find_renamable_ref(
     DexMemberRef* ref,
-    std::unordered_map<DexMemberRef*, DexMember*>& ref_def_cache,
-    DexElemManager<DexMember*, DexMemberRef*, DexMemberSpec, K>& name_mapping) {
+    InsertOnlyConcurrentMap<DexMemberRef*, DexMember*>& ref_def_cache,
+    const DexElemManager<DexMember*, DexMemberRef*, DexMemberSpec, K>&
+        name_mapping) {
   TRACE(OBFUSCATE, 4, "Found a ref opcode");
-  DexMember* def = nullptr;
-  auto member_itr = ref_def_cache.find(ref);
-  if (member_itr != ref_def_cache.end()) {
-    def = member_itr->second;
-  } else {
-    def = name_mapping.def_of_ref(ref);
+  auto cached = ref_def_cache.get(ref);
+  if (cached != nullptr) {
+    return *cached;
   }
-  ref_def_cache[ref] = def;
-  return def;
+  return *ref_def_cache.emplace(ref, name_mapping.def_of_ref(ref)).first;
 }
 
+// The name managers are only read here, so the code is walked in parallel.
 void update_refs(Scope& scope,
-                 DexFieldManager& field_name_mapping,
-                 DexMethodManager& method_name_mapping) {
-  std::unordered_map<DexFieldRef*, DexField*> f_ref_def_cache;
-  std::unordered_map<DexMethodRef*, DexMethod*> m_ref_def_cache;
-  walk::opcodes(scope, [&](DexMethod*, IRInstruction* instr) {
+                 const DexFieldManager& field_name_mapping,
+                 const DexMethodManager& method_name_mapping) {
+  InsertOnlyConcurrentMap<DexFieldRef*, DexField*> f_ref_def_cache;
+  InsertOnlyConcurrentMap<DexMethodRef*, DexMethod*> m_ref_def_cache;
+  walk::parallel::opcodes(scope, [&](DexMethod*, IRInstruction* instr) {
     auto op = instr->opcode();
     if (instr->has_field()) {
       DexFieldRef* field_ref = instr->get_field();
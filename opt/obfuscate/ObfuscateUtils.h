@@ -485,6 +485,22 @@ class FieldNameGenerator : public NameGenerator<DexField*> {
   }
 };
 
+// Commit the renamings under a single acquisition of the RedexContext lock.
+// We should not update deobfuscated names here!
+inline void commit_renamings(
+    const std::vector<std::pair<DexFieldRef*, DexFieldSpec>>& renamings) {
+  g_redex->mutate_fields(renamings,
+                         false /* rename on collision */,
+                         false /* update deobfuscated name */);
+}
+
+inline void commit_renamings(
+    const std::vector<std::pair<DexMethodRef*, DexMethodSpec>>& renamings) {
+  g_redex->mutate_methods(renamings,
+                          false /* rename on collision */,
+                          false /* update deobfuscated name */);
+}
+
 // T - DexField/DexElem - what we're managing
 // R - DexFieldRef/DexElemRef - the ref to what we're managing
 // S - DexFieldSpec/DexElemSpec - the spec to what we're managing
@@ -523,12 +539,11 @@ class DexElemManager {
   // void lock_elements() { mark_all_unrenamable = true; }
   // void unlock_elements() { mark_all_unrenamable = false; }
 
-  inline bool contains_elem(DexType* cls, K sig, DexString* name) {
-    return elements.count(cls) > 0 && elements[cls].count(sig) > 0 &&
-           elements[cls][sig].count(name) > 0;
+  inline bool contains_elem(DexType* cls, K sig, DexString* name) const {
+    return find_elem(cls, sig, name) != nullptr;
   }
 
-  inline bool contains_elem(R elem) {
+  inline bool contains_elem(R elem) const {
     return contains_elem(elem->get_class(), sig_getter_fn(elem),
                          elem->get_name());
   }
@@ -557,7 +572,7 @@ class DexElemManager {
   // of elements renamed
   int commit_renamings_to_dex() {
     std::unordered_set<T> renamed_elems;
-    int renamings = 0;
+    std::vector<std::pair<R, S>> renamings;
     for (auto& class_itr : this->elements) {
       for (auto& type_itr : class_itr.second) {
         for (auto& name_wrap : type_itr.second) {
@@ -582,33 +597,40 @@ class DexElemManager {
                   SHOW(elem));
           }
           renamed_elems.insert(elem);
-          // We should not update deobfuscated name here!
-          elem->change(ref_getter_fn(wrap->get_name()),
-                       false /* rename on collision */,
-                       false /* update deobfuscated name */);
-          renamings++;
+          renamings.emplace_back(elem, ref_getter_fn(wrap->get_name()));
         }
       }
     }
-    return renamings;
+    commit_renamings(renamings);
+    return renamings.size();
   }
 
  private:
+  // Returns the wrapper of the element if it exists, without creating any
+  // entry, so that it can be called concurrently.
+  DexNameWrapper<T>* find_elem(DexType* cls, K sig, DexString* name) const {
+    auto cls_it = elements.find(cls);
+    if (cls_it == elements.end()) return nullptr;
+    auto sig_it = cls_it->second.find(sig);
+    if (sig_it == cls_it->second.end()) return nullptr;
+    auto name_it = sig_it->second.find(name);
+    if (name_it == sig_it->second.end()) return nullptr;
+    return name_it->second.get();
+  }
+
   // Returns the def for that class and ref if it exists, nullptr otherwise
-  T find_def(R ref, DexType* cls) {
+  T find_def(R ref, DexType* cls) const {
     if (cls == nullptr) return nullptr;
-    if (contains_elem(cls, sig_getter_fn(ref), ref->get_name())) {
-      DexNameWrapper<T>* wrap =
-          elements[cls][sig_getter_fn(ref)][ref->get_name()].get();
-      if (wrap->is_modified()) return wrap->get();
-    }
+    DexNameWrapper<T>* wrap =
+        find_elem(cls, sig_getter_fn(ref), ref->get_name());
+    if (wrap != nullptr && wrap->is_modified()) return wrap->get();
     return nullptr;
   }
 
   /**
    * Look up in the class and all its interfaces.
    */
-  T find_def_in_class_and_intf(R ref, DexClass* cls) {
+  T find_def_in_class_and_intf(R ref, DexClass* cls) const {
     if (cls == nullptr) return nullptr;
     auto found_def = find_def(ref, cls->get_type());
     if (found_def != nullptr) return found_def;
@@ -623,7 +645,7 @@ class DexElemManager {
   // Does a lookup over the fields we renamed in the dex to see what the
   // reference should be reset with. Returns nullptr if there is no mapping.
   // Note: we also have to look in superclasses in the case that this is a ref
-  T def_of_ref(R ref) {
+  T def_of_ref(R ref) const {
     DexClass* cls = type_class(ref->get_class());
     while (cls && !cls->is_external()) {
       auto found = find_def_in_class_and_intf(ref, cls);
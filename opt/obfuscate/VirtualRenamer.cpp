@@ -6,6 +6,7 @@
  */
 
 #include "VirtualRenamer.h"
+#include "ConcurrentContainers.h"
 #include "DexAccess.h"
 #include "DexClass.h"
 #include "DexUtil.h"
@@ -150,6 +151,10 @@ struct VirtualRenamer {
   std::unordered_map<const DexType*, std::string>* external_name_cache;
   const std::unordered_map<const DexClass*, int>& next_dmethod_seeds;
   mutable std::unordered_map<const VirtualScope*, int> next_virtualscope_seeds;
+  // The root of each virtual scope and all its children. The hierarchy does
+  // not change while renaming, and it is scanned for every candidate name.
+  mutable std::unordered_map<const DexType*, std::vector<const DexType*>>
+      hierarchies;
 
  private:
   const std::string& get_prefix(const DexType* type) const {
@@ -177,6 +182,18 @@ struct VirtualRenamer {
     return seed;
   }
 
+  const std::vector<const DexType*>& get_hierarchy(const DexType* root) const {
+    auto it = hierarchies.find(root);
+    if (it != hierarchies.end()) {
+      return it->second;
+    }
+    auto hier = get_all_children(class_scopes.get_class_hierarchy(), root);
+    hier.insert(root);
+    return hierarchies
+        .emplace(root, std::vector<const DexType*>(hier.begin(), hier.end()))
+        .first->second;
+  }
+
   void rename(DexMethodRef* meth, DexString* name);
   int rename_scope_ref(DexMethod* meth, DexString* name);
   int rename_scope(const VirtualScope* scope, DexString* name);
@@ -269,10 +286,8 @@ int VirtualRenamer::rename_scope(const VirtualScope* scope, DexString* name) {
  */
 bool VirtualRenamer::usable_name(DexString* name,
                                  const VirtualScope* scope) const {
-  const auto root = scope->type;
   const auto proto = scope->methods[0].first->get_proto();
-  auto hier = get_all_children(class_scopes.get_class_hierarchy(), root);
-  hier.insert(root);
+  const auto& hier = get_hierarchy(scope->type);
   bool has_ste = stack_trace_elements != nullptr;
   for (const auto& type : hier) {
     if (DexMethod::get_method(const_cast<DexType*>(type), name, proto) !=
@@ -472,7 +487,8 @@ int VirtualRenamer::rename_virtual_scopes(const DexType* type, int& seed) {
  * Collect all method refs to concrete methods (definitions).
  */
 void collect_refs(Scope& scope, RefsMap& def_refs) {
-  walk::opcodes(
+  ConcurrentMap<DexMethod*, RefsMap::mapped_type> concurrent_def_refs;
+  walk::parallel::opcodes(
       scope, [](DexMethod*) { return true; },
       [&](DexMethod*, IRInstruction* insn) {
         if (!insn->has_method()) return;
@@ -499,8 +515,14 @@ void collect_refs(Scope& scope, RefsMap& def_refs) {
         redex_assert(type_class(top->get_class()) != nullptr);
         if (type_class(top->get_class())->is_external()) return;
         // it's a top definition on an internal class, save it
-        def_refs[top].insert(callee);
+        concurrent_def_refs.update(
+            top, [callee](DexMethod*, RefsMap::mapped_type& refs, bool) {
+              refs.insert(callee);
+            });
       });
+  for (auto& pair : concurrent_def_refs) {
+    def_refs.emplace(pair.first, std::move(pair.second));
+  }
 }
 
 } // namespace
@@ -7,6 +7,7 @@
 
 #include "ObjectSensitiveDcePass.h"
 
+#include <fstream>
 #include <functional>
 
 #include "ConcurrentContainers.h"
@@ -88,9 +89,13 @@ class CallGraphStrategy final : public call_graph::BuildStrategy {
 
   const Scope& m_scope;
   std::unordered_set<const DexMethod*> m_non_overridden_virtuals;
-  mutable MethodRefCache m_resolved_refs;
+  mutable ConcurrentMethodRefCache m_resolved_refs;
 };
 
+// Bump this whenever the side-effect analysis changes, so that the summaries
+// cached by previous builds are not reused.
+constexpr int32_t SIDE_EFFECT_SUMMARIES_VERSION = 1;
+
 static side_effects::InvokeToSummaryMap build_summary_map(
     const side_effects::SummaryMap& effect_summaries,
     const call_graph::Graph& call_graph,
@@ -137,8 +142,42 @@ void ObjectSensitiveDcePass::run_pass(DexStoresVector& stores,
     std::ifstream file_input(*m_external_side_effect_summaries_file);
     summary_serialization::read(file_input, &effect_summaries);
   }
+  // The summary of a method depends on its callees, and on whether it may be
+  // optimized.
+  summary_serialization::MethodSummaryStore<side_effects::Summary>
+      summary_store(
+          "side_effects", SIDE_EFFECT_SUMMARIES_VERSION,
+          [&call_graph](const DexMethod* method) {
+            auto hash = summary_serialization::hash_method_and_callees(
+                call_graph, method);
+            boost::hash_combine(hash, method->rstate.no_optimizations());
+            return hash;
+          });
+  if (m_side_effect_summaries_cache_file) {
+    std::ifstream file_input(*m_side_effect_summaries_cache_file);
+    if (file_input) {
+      summary_store.read(file_input);
+      summary_store.remove_stale_callers(call_graph);
+      walk::methods(scope, [&](DexMethod* method) {
+        if (const auto* summary = summary_store.get(method)) {
+          effect_summaries.emplace(method, *summary);
+        }
+      });
+      mgr.set_metric("reused_side_effect_summaries", summary_store.size());
+    }
+  }
   side_effects::analyze_scope(scope, call_graph, *ptrs_fp_iter_map,
                               &effect_summaries);
+  if (m_side_effect_summaries_cache_file) {
+    walk::methods(scope, [&](DexMethod* method) {
+      auto it = effect_summaries.find(method);
+      if (method->get_code() != nullptr && it != effect_summaries.end()) {
+        summary_store.set(method, it->second);
+      }
+    });
+    std::ofstream file_output(*m_side_effect_summaries_cache_file);
+    summary_store.write(file_output);
+  }
 
   auto removed =
       walk::parallel::methods<size_t>(scope, [&](DexMethod* method) -> size_t {
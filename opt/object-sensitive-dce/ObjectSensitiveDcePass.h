@@ -26,6 +26,13 @@ class ObjectSensitiveDcePass final : public Pass {
     bind("escape_summaries", {boost::none}, m_external_escape_summaries_file,
          "TODO: Document me!",
          Configurable::bindflags::optionals::skip_empty_string);
+    bind("side_effect_summaries_cache", {boost::none},
+         m_side_effect_summaries_cache_file,
+         "File to which the side-effect summaries of the APK's methods are "
+         "written, and from which the next build reuses the summaries of the "
+         "unchanged methods. It must be deleted when the external summaries "
+         "change.",
+         Configurable::bindflags::optionals::skip_empty_string);
 
     if (!m_external_escape_summaries_file ||
         !m_external_side_effect_summaries_file) {
@@ -40,4 +47,5 @@ class ObjectSensitiveDcePass final : public Pass {
  private:
   boost::optional<std::string> m_external_side_effect_summaries_file;
   boost::optional<std::string> m_external_escape_summaries_file;
+  boost::optional<std::string> m_side_effect_summaries_cache_file;
 };
@@ -7,7 +7,11 @@
 
 #include "OptimizeEnums.h"
 
+#include <algorithm>
+#include <atomic>
+
 #include "ClassAssemblingUtils.h"
+#include "ConcurrentContainers.h"
 #include "EnumAnalyzeGeneratedMethods.h"
 #include "EnumClinitAnalysis.h"
 #include "EnumInSwitch.h"
@@ -29,6 +33,7 @@
  *   every use of an enum in a switch statement, an anonymous class is generated
  *   in the class the switchis defined. This class will contain ONLY lookup
  *   tables (array) as static fields and a static initializer.
+ *   kotlinc does the same with the `$WhenMappings` classes.
  *
  * 2. Try to replace enum objects with boxed Integer objects based on static
  * analysis results.
@@ -208,6 +213,26 @@ bool analyze_enum_ctors(
   return true;
 }
 
+const std::string& get_field_name(const DexField* field) {
+  const auto& deobfuscated_name = field->get_deobfuscated_name();
+  return deobfuscated_name.empty() ? field->get_name()->str()
+                                   : deobfuscated_name;
+}
+
+/**
+ * The lookup tables of kotlinc are named `$EnumSwitchMapping$<index>`, so
+ * their enum is found from the ordinals that index them.
+ */
+bool is_kotlin_lookup_table(const DexField* field) {
+  return get_field_name(field).find("$EnumSwitchMapping$") !=
+         std::string::npos;
+}
+
+bool is_lookup_table(const DexField* field) {
+  return is_kotlin_lookup_table(field) ||
+         get_field_name(field).find("$SwitchMap$") != std::string::npos;
+}
+
 /**
  * Collect enum fields to switch case.
  *
@@ -250,8 +275,8 @@ class OptimizeEnums {
     m_java_enum_ctor = get_java_enum_ctor();
   }
 
-  void remove_redundant_generated_classes() {
-    auto generated_classes = collect_generated_classes();
+  void remove_redundant_generated_classes(bool all_stores) {
+    auto generated_classes = collect_generated_classes(all_stores);
     auto enum_field_to_ordinal = collect_enum_field_ordinals();
 
     std::unordered_set<DexType*> collected_enums;
@@ -264,12 +289,24 @@ class OptimizeEnums {
 
     for (const auto& generated_cls : generated_classes) {
       auto generated_clinit = generated_cls->get_clinit();
+      std::unordered_map<DexField*, DexType*> kotlin_lookup_table_enums;
+      const auto& sfields = generated_cls->get_sfields();
+      if (std::any_of(sfields.begin(), sfields.end(), is_kotlin_lookup_table)) {
+        optimize_enums::OptimizeEnumsGeneratedAnalysis analysis(
+            generated_cls, /* current_enum */ nullptr);
+        kotlin_lookup_table_enums = analysis.collect_lookup_table_enums();
+      }
 
-      for (const auto& sfield : generated_cls->get_sfields()) {
+      for (const auto& sfield : sfields) {
         // update stats.
         m_stats.num_lookup_tables++;
 
-        auto enum_type = get_enum_used(sfield);
+        DexType* enum_type = nullptr;
+        if (!is_kotlin_lookup_table(sfield)) {
+          enum_type = get_enum_used(sfield);
+        } else if (kotlin_lookup_table_enums.count(sfield)) {
+          enum_type = kotlin_lookup_table_enums.at(sfield);
+        }
         if (!enum_type || collected_enums.count(enum_type) == 0) {
           // Nothing to do if we couldn't determine enum ordinals.
           continue;
@@ -512,9 +549,14 @@ class OptimizeEnums {
    * We determine which classes are generated based on:
    * - classes that only have 1 dmethods: <clinit>
    * - no instance fields, nor virtual methods
-   * - all static fields match `$SwitchMap$<enum_path>`
+   * - all static fields match `$SwitchMap$<enum_path>`, or
+   *   `$EnumSwitchMapping$<index>` for kotlinc
+   *
+   * Only the ordinals that are known at build time replace the lookup tables,
+   * so that replacing them adds no reference. Unless `all_stores` is set,
+   * only the classes of the root store are accepted, to be conservative.
    */
-  std::vector<DexClass*> collect_generated_classes() {
+  std::vector<DexClass*> collect_generated_classes(bool all_stores) {
     std::vector<DexClass*> generated_classes;
     std::unordered_set<DexClass*> scope_classes(m_scope.begin(), m_scope.end());
 
@@ -524,7 +566,7 @@ class OptimizeEnums {
 
     for (const auto& cls : m_scope) {
       size_t cls_store_idx = xstores.get_store_idx(cls->get_type());
-      if (cls_store_idx > 1) {
+      if (cls_store_idx > 1 && !all_stores) {
         continue;
       }
 
@@ -535,21 +577,7 @@ class OptimizeEnums {
       if (!sfields.empty() && cls->get_dmethods().size() == 1 &&
           cls->get_vmethods().empty() && cls->get_ifields().empty()) {
 
-        bool accept_cls = true;
-        for (auto sfield : sfields) {
-          const std::string& deobfuscated_name =
-              sfield->get_deobfuscated_name();
-          const std::string& sfield_name = deobfuscated_name.empty()
-                                               ? sfield->get_name()->str()
-                                               : deobfuscated_name;
-
-          if (sfield_name.find("$SwitchMap$") == std::string::npos) {
-            accept_cls = false;
-            break;
-          }
-        }
-
-        if (accept_cls) {
+        if (std::all_of(sfields.begin(), sfields.end(), is_lookup_table)) {
           generated_classes.emplace_back(cls);
         }
       }
@@ -633,8 +661,29 @@ class OptimizeEnums {
       const std::unordered_map<DexField*, size_t>& enum_field_to_ordinal,
       const GeneratedSwitchCases& generated_switch_cases) {
 
-    namespace cp = constant_propagation;
-    walk::code(m_scope, [&](DexMethod*, IRCode& code) {
+    if (lookup_table_to_enum.empty()) {
+      return;
+    }
+    // Only the methods that read a lookup table can use it in a switch, so
+    // the others are skipped before building their CFGs.
+    const auto reads_lookup_table = [&](IRCode& code) {
+      for (const auto& mie : InstructionIterable(code)) {
+        auto insn = mie.insn;
+        if (insn->opcode() != OPCODE_SGET_OBJECT) {
+          continue;
+        }
+        auto field = resolve_field(insn->get_field(), FieldSearch::Static);
+        if (field != nullptr && lookup_table_to_enum.count(field)) {
+          return true;
+        }
+      }
+      return false;
+    };
+
+    walk::parallel::code(m_scope, [&](DexMethod*, IRCode& code) {
+      if (!reads_lookup_table(code)) {
+        return;
+      }
       code.build_cfg(/* editable */ true);
       auto& cfg = code.cfg();
       cfg.calculate_exit_block();
@@ -844,7 +893,7 @@ class OptimizeEnums {
       }
     }
 
-    m_lookup_tables_replaced.emplace(info.array_field);
+    m_lookup_tables_replaced.insert(info.array_field);
   }
 
   /**
@@ -853,9 +902,7 @@ class OptimizeEnums {
    * where Lcom/<part_of_path_1>/.../enum_name; is the actual enum.
    */
   DexType* get_enum_used(DexField* field) {
-    const auto& deobfuscated_name = field->get_deobfuscated_name();
-    const auto& name = deobfuscated_name.empty() ? field->get_name()->str()
-                                                 : deobfuscated_name;
+    const auto& name = get_field_name(field);
 
     // Get the class path, by removing the first part of the field
     // name ($SwitchMap$), adding 'L' and ';' and replacing '$' with '/'.
@@ -912,13 +959,13 @@ class OptimizeEnums {
     size_t num_enum_classes{0};
     size_t num_enum_objs{0};
     size_t num_int_objs{0};
-    size_t num_switch_equiv_finder_failures{0};
+    std::atomic<size_t> num_switch_equiv_finder_failures{0};
     size_t num_candidate_generated_methods{0};
     size_t num_removed_generated_methods{0};
   };
   Stats m_stats;
 
-  std::unordered_set<DexField*> m_lookup_tables_replaced;
+  ConcurrentSet<DexField*> m_lookup_tables_replaced;
   const DexMethod* m_java_enum_ctor;
   const ProguardMap& m_pg_map;
 };
@@ -935,13 +982,17 @@ void OptimizeEnumsPass::bind_config() {
        "A whitelist of enum classes that may have more than `max_enum_size` "
        "enum fields, try to erase them without considering reference equality "
        "of the enum objects. Do not add enums to the whitelist!");
+  bind("lookup_tables_in_all_stores", false, m_lookup_tables_in_all_stores,
+       "Also replace the lookup tables of the generated switch map classes "
+       "that are outside of the root store. The switches then use the "
+       "ordinals, which are known at build time, so no reference is added.");
 }
 
 void OptimizeEnumsPass::run_pass(DexStoresVector& stores,
                                  ConfigFiles& conf,
                                  PassManager& mgr) {
   OptimizeEnums opt_enums(stores, conf);
-  opt_enums.remove_redundant_generated_classes();
+  opt_enums.remove_redundant_generated_classes(m_lookup_tables_in_all_stores);
   opt_enums.replace_enum_with_int(m_max_enum_size, m_enum_to_integer_whitelist);
   opt_enums.remove_enum_generated_methods();
   opt_enums.stats(mgr);
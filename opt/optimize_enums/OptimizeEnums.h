@@ -21,6 +21,7 @@ class OptimizeEnumsPass : public Pass {
  private:
   int m_max_enum_size;
   std::vector<DexType*> m_enum_to_integer_whitelist;
+  bool m_lookup_tables_in_all_stores;
 };
 
 } // namespace optimize_enums
@@ -294,6 +294,41 @@ OptimizeEnumsGeneratedAnalysis::OptimizeEnumsGeneratedAnalysis(
 
 void OptimizeEnumsGeneratedAnalysis::collect_generated_switch_cases(
     GeneratedSwitchCases& generated_switch_cases) {
+  walk_lookup_table_aputs([&](DexField* lookup_table, uint32_t switch_case,
+                              DexField* field_ordinal) {
+    if (field_ordinal == nullptr || field_ordinal->get_class() != m_enum) {
+      return;
+    }
+    // Set switch case, based on the value that is associated with the enum
+    // field.
+    generated_switch_cases[lookup_table][switch_case] = field_ordinal;
+  });
+}
+
+std::unordered_map<DexField*, DexType*>
+OptimizeEnumsGeneratedAnalysis::collect_lookup_table_enums() {
+  std::unordered_map<DexField*, DexType*> lookup_table_enums;
+  walk_lookup_table_aputs(
+      [&](DexField* lookup_table, uint32_t, DexField* field_ordinal) {
+        auto enum_type =
+            field_ordinal == nullptr ? nullptr : field_ordinal->get_class();
+        auto it = lookup_table_enums.emplace(lookup_table, enum_type).first;
+        if (it->second != enum_type) {
+          it->second = nullptr;
+        }
+      });
+  for (auto it = lookup_table_enums.begin(); it != lookup_table_enums.end();) {
+    if (it->second == nullptr) {
+      it = lookup_table_enums.erase(it);
+    } else {
+      ++it;
+    }
+  }
+  return lookup_table_enums;
+}
+
+void OptimizeEnumsGeneratedAnalysis::walk_lookup_table_aputs(
+    const std::function<void(DexField*, uint32_t, DexField*)>& f) {
 
   auto clinit = m_generated_cls->get_clinit();
   auto* code = clinit->get_code();
@@ -319,13 +354,8 @@ void OptimizeEnumsGeneratedAnalysis::collect_generated_switch_cases(
         always_assert(lookup_table && switch_case);
         always_assert((*lookup_table)->get_class() ==
                       m_generated_cls->get_type());
-        if (!field_ordinal || (*field_ordinal)->get_class() != m_enum) {
-          continue;
-        }
-
-        // Set switch case, based on the value that is associated with the enum
-        // field.
-        generated_switch_cases[*lookup_table][*switch_case] = *field_ordinal;
+        f(*lookup_table, *switch_case,
+          field_ordinal ? *field_ordinal : nullptr);
       }
 
       m_field_analyzer->analyze_instruction(insn, &field_env);
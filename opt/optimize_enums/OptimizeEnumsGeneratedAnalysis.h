@@ -7,6 +7,7 @@
 
 #pragma once
 
+#include <functional>
 #include <unordered_map>
 
 #include "DexClass.h"
@@ -34,7 +35,21 @@ class OptimizeEnumsGeneratedAnalysis final {
   void collect_generated_switch_cases(
       GeneratedSwitchCases& generated_switch_cases);
 
+  /**
+   * The enum whose ordinals index each lookup table of the generated class,
+   * for the tables that are only indexed by the ordinals of one enum. Kotlin
+   * doesn't name its lookup tables after the enums.
+   */
+  std::unordered_map<DexField*, DexType*> collect_lookup_table_enums();
+
  private:
+  /**
+   * Calls `f` with the lookup table, the switch case and the enum field (or
+   * nullptr if it is unknown) of each APUT that fills a lookup table.
+   */
+  void walk_lookup_table_aputs(
+      const std::function<void(DexField*, uint32_t, DexField*)>& f);
+
   const DexType* m_enum;
   const DexClass* m_generated_cls;
   std::unique_ptr<impl::FieldAnalyzer> m_field_analyzer;
@@ -0,0 +1,85 @@
+/*
+ * Copyright (c) Facebook, Inc. and its affiliates.
+ *
+ * This source code is licensed under the MIT license found in the
+ * LICENSE file in the root directory of this source tree.
+ */
+
+#pragma once
+
+#include <algorithm>
+#include <atomic>
+#include <cstdint>
+#include <limits>
+#include <memory>
+
+#include "Debug.h"
+
+namespace outliner_impl {
+
+/*
+ * A count-min sketch (Cormode and Muthukrishnan, 2005) estimates how often
+ * each key was added in constant space. The estimate is never below the true
+ * count, and exceeds it by at most a small fraction of the total count with
+ * high probability. Keys are given by their hashes.
+ *
+ * Adding counts is thread safe and lock-free.
+ */
+class CountMinSketch {
+ public:
+  // The width must be a power of two.
+  CountMinSketch(size_t depth, size_t width)
+      : m_depth(depth),
+        m_width(width),
+        m_counters(new std::atomic<uint32_t>[depth * width]) {
+    always_assert(depth > 0 && depth <= MAX_DEPTH);
+    always_assert(width > 0 && (width & (width - 1)) == 0);
+    for (size_t i = 0; i < depth * width; i++) {
+      m_counters[i].store(0, std::memory_order_relaxed);
+    }
+  }
+
+  void add(size_t hash, uint32_t count) {
+    for (size_t row = 0; row < m_depth; row++) {
+      auto& counter = m_counters[row * m_width + column(row, hash)];
+      // Saturate instead of wrapping around, so that estimates stay upper
+      // bounds.
+      uint32_t old_value = counter.load(std::memory_order_relaxed);
+      uint32_t new_value;
+      do {
+        new_value = old_value > std::numeric_limits<uint32_t>::max() - count
+                        ? std::numeric_limits<uint32_t>::max()
+                        : old_value + count;
+      } while (!counter.compare_exchange_weak(old_value, new_value,
+                                              std::memory_order_relaxed));
+    }
+  }
+
+  uint32_t estimate(size_t hash) const {
+    uint32_t res = std::numeric_limits<uint32_t>::max();
+    for (size_t row = 0; row < m_depth; row++) {
+      res = std::min(res, m_counters[row * m_width + column(row, hash)].load(
+                              std::memory_order_relaxed));
+    }
+    return res;
+  }
+
+ private:
+  static constexpr size_t MAX_DEPTH = 8;
+
+  // Derives an independent-enough column for each row from the key's hash.
+  size_t column(size_t row, size_t hash) const {
+    static constexpr uint64_t SEEDS[MAX_DEPTH] = {
+        0x9E3779B97F4A7C15ULL, 0xC2B2AE3D27D4EB4FULL, 0x165667B19E3779F9ULL,
+        0xD6E8FEB86659FD93ULL, 0xFF51AFD7ED558CCDULL, 0xC4CEB9FE1A85EC53ULL,
+        0x27D4EB2F165667C5ULL, 0x94D049BB133111EBULL};
+    uint64_t h = (static_cast<uint64_t>(hash) ^ (row << 1)) * SEEDS[row];
+    return (h >> 32) & (m_width - 1);
+  }
+
+  const size_t m_depth;
+  const size_t m_width;
+  std::unique_ptr<std::atomic<uint32_t>[]> m_counters;
+};
+
+} // namespace outliner_impl
@@ -14,7 +14,7 @@
  * instructions in a block occurs sufficiently often. The average complexity is
  * held down by filtering out instruction sequences where adjacent sequences of
  * abstracted instructions ("cores") of fixed lengths never occur twice anywhere
- * in the scope (seems good enough, even without a suffix tree).
+ * in the scope, as determined with a suffix array.
  *
  * When reaching a conditional branch or switch instruction, different control-
  * paths are explored as well, as long as they eventually all arrive at a common
@@ -24,7 +24,7 @@
  * instructions in a block occurs sufficiently often. The average complexity is
  * held down by filtering out instruction sequences where adjacent sequences of
  * abstracted instructions ("cores") of fixed lengths never occur twice anywhere
- * in the scope (seems good enough, even without a suffix tree).
+ * in the scope, as determined with a suffix array.
  *
  * We gather existing method/type references in a dex and make sure that we
  * don't go beyond the limits when adding methods/types, effectively filling up
@@ -74,6 +74,7 @@
 #include "ApiLevelChecker.h"
 #include "BigBlocks.h"
 #include "CFGMutation.h"
+#include "CountMinSketch.h"
 #include "Creators.h"
 #include "DexClass.h"
 #include "DexLimits.h"
@@ -88,8 +89,10 @@
 #include "PartialCandidates.h"
 #include "ReachingInitializeds.h"
 #include "Resolver.h"
+#include "SuffixArray.h"
 #include "Trace.h"
 #include "Walkers.h"
+#include "WorkQueue.h"
 
 namespace {
 
@@ -118,6 +121,11 @@ const size_t MAX_ARGS = 5;
 // definition of cores
 const size_t MIN_INSNS_SIZE = 3;
 
+// Dimensions of the count-min sketch that estimates candidate frequencies
+// when use_frequency_sketch is enabled; about 16MB.
+const size_t FREQUENCY_SKETCH_DEPTH = 4;
+const size_t FREQUENCY_SKETCH_WIDTH = 1 << 20;
+
 ////////////////////////////////////////////////////////////////////////////////
 // "Candidate instructions" with hashes, equality, and stable hashes
 ////////////////////////////////////////////////////////////////////////////////
@@ -1163,50 +1171,102 @@ static bool can_outline_from_method(
 // Gather set of recurring small (MIN_INSNS_SIZE) adjacent instruction
 // sequences that are outlinable. Note that all longer recurring outlinable
 // instruction sequences must be comprised of shorter recurring ones.
+//
+// Instead of counting all the adjacent cores in a hash map, which mostly end
+// up holding singletons, we build a suffix array over a token stream of the
+// maximal outlinable instruction runs of all big blocks, where each token
+// stands for a distinct instruction core, and each run is followed by a
+// separator token. A sequence of cores recurs exactly if the suffix that
+// starts with it shares a prefix of at least that length with one of its
+// neighbours in the suffix array.
 static void get_recurring_cores(
     PassManager& mgr,
     const Scope& scope,
     const std::unordered_set<DexMethod*>& sufficiently_hot_methods,
     const std::function<bool(const DexType*)>& illegal_ref,
     CandidateInstructionCoresSet* recurring_cores) {
-  ConcurrentMap<CandidateInstructionCores, size_t,
-                CandidateInstructionCoresHasher>
-      concurrent_cores;
+  using Runs = std::vector<std::vector<CandidateInstructionCore>>;
+  ConcurrentMap<const DexMethod*, Runs> concurrent_runs;
   walk::parallel::code(
       scope, [illegal_ref, &sufficiently_hot_methods,
-              &concurrent_cores](DexMethod* method, IRCode& code) {
+              &concurrent_runs](DexMethod* method, IRCode& code) {
         if (!can_outline_from_method(method, sufficiently_hot_methods)) {
           return;
         }
         code.build_cfg(/* editable */ true);
         code.cfg().calculate_exit_block();
         auto& cfg = code.cfg();
+        Runs runs;
+        std::vector<CandidateInstructionCore> run;
+        auto flush = [&]() {
+          if (run.size() >= MIN_INSNS_SIZE) {
+            runs.push_back(std::move(run));
+          }
+          run.clear();
+        };
         for (auto& big_block : big_blocks::get_big_blocks(cfg)) {
-          CandidateInstructionCoresBuilder cores_builder;
           for (auto& mie : big_blocks::InstructionIterable(big_block)) {
             auto insn = mie.insn;
             if (!can_outline_insn(illegal_ref, insn)) {
-              cores_builder.clear();
+              flush();
               continue;
             }
-            cores_builder.push_back(insn);
-            if (cores_builder.has_value()) {
-              concurrent_cores.update(cores_builder.get_value(),
-                                      [](const CandidateInstructionCores&,
-                                         size_t& occurrences,
-                                         bool /* exists */) { occurrences++; });
-            }
+            run.push_back(to_core(insn));
           }
+          flush();
+        }
+        if (!runs.empty()) {
+          concurrent_runs.emplace(method, std::move(runs));
         }
       });
+
+  // Token 0 is the separator.
+  static constexpr uint32_t SEPARATOR = 0;
+  std::unordered_map<CandidateInstructionCore, uint32_t,
+                     CandidateInstructionCoreHasher>
+      tokens;
+  std::vector<CandidateInstructionCore> token_cores(1);
+  std::vector<uint32_t> stream;
+  for (auto& p : concurrent_runs) {
+    for (auto& run : p.second) {
+      for (auto& core : run) {
+        auto it = tokens.emplace(core, token_cores.size()).first;
+        if (it->second == token_cores.size()) {
+          token_cores.push_back(core);
+        }
+        stream.push_back(it->second);
+      }
+      stream.push_back(SEPARATOR);
+    }
+  }
+  concurrent_runs.clear();
+
+  auto sa = build_suffix_array(stream, token_cores.size());
+  auto lcp = build_lcp_array(stream, sa);
   size_t singleton_cores{0};
-  for (auto& p : concurrent_cores) {
-    always_assert(p.second > 0);
-    if (p.second > 1) {
-      recurring_cores->insert(p.first);
-    } else {
+  for (size_t rank = 0; rank < sa.size(); rank++) {
+    size_t pos = sa[rank];
+    if (pos + MIN_INSNS_SIZE > stream.size() ||
+        std::find(stream.begin() + pos, stream.begin() + pos + MIN_INSNS_SIZE,
+                  SEPARATOR) != stream.begin() + pos + MIN_INSNS_SIZE) {
+      continue;
+    }
+    size_t repeated = 0;
+    if (rank > 0) {
+      repeated = lcp[rank - 1];
+    }
+    if (rank + 1 < sa.size()) {
+      repeated = std::max<size_t>(repeated, lcp[rank]);
+    }
+    if (repeated < MIN_INSNS_SIZE) {
       singleton_cores++;
+      continue;
+    }
+    CandidateInstructionCores cores;
+    for (size_t i = 0; i < MIN_INSNS_SIZE; i++) {
+      cores[i] = token_cores.at(stream[pos + i]);
     }
+    recurring_cores->insert(cores);
   }
   mgr.incr_metric("num_singleton_cores", singleton_cores);
   mgr.incr_metric("num_recurring_cores", recurring_cores->size());
@@ -1223,8 +1283,14 @@ static void get_recurring_cores(
 struct CandidateInfo {
   std::unordered_map<DexMethod*, std::vector<CandidateMethodLocation>> methods;
   size_t count{0};
+  // How many of the occurrences are in warm methods, where each execution
+  // pays for the invocation of the outlined method.
+  size_t warm_count{0};
 };
 
+using CandidateInfos =
+    std::unordered_map<Candidate, CandidateInfo, CandidateHasher>;
+
 // We keep track of outlined methods that reside in earlier dexes of the current
 // store
 using ReusableOutlinedMethods =
@@ -1348,7 +1414,8 @@ static size_t get_savings(
   size_t outlined_cost =
       COST_METHOD_METADATA +
       (c.res_type ? COST_INVOKE_WITH_RESULT : COST_INVOKE_WITHOUT_RESULT) *
-          ci.count;
+          ci.count +
+      config.warm_invoke_cost * ci.warm_count;
   if (find_reusable_method(c, ci, reusable_outlined_methods) == nullptr) {
     outlined_cost += COST_METHOD_BODY + c.size;
   }
@@ -1358,6 +1425,20 @@ static size_t get_savings(
              : 0;
 }
 
+// Whether a candidate occurring that many times might be beneficial, even in
+// the best case of reusing an existing outlined method, where no new method
+// body is needed, and of no occurrence being in a warm method.
+static bool could_be_beneficial(const InstructionSequenceOutlinerConfig& config,
+                                const Candidate& c,
+                                size_t count) {
+  size_t cost = c.size * count;
+  size_t outlined_cost =
+      COST_METHOD_METADATA +
+      (c.res_type ? COST_INVOKE_WITH_RESULT : COST_INVOKE_WITHOUT_RESULT) *
+          count;
+  return (outlined_cost + config.savings_threshold) < cost;
+}
+
 using CandidateId = uint32_t;
 struct CandidateWithInfo {
   Candidate candidate;
@@ -1391,30 +1472,103 @@ static void get_beneficial_candidates(
     std::vector<CandidateWithInfo>* candidates_with_infos,
     std::unordered_map<DexMethod*, std::unordered_set<CandidateId>>*
         candidate_ids_by_methods) {
-  ConcurrentMap<Candidate, CandidateInfo, CandidateHasher>
-      concurrent_candidates;
+  // Candidates are gathered as a map-reduce: Each thread collects the
+  // candidates of its methods in its own tables without any locking, and
+  // then the tables of all threads are merged shard by shard in parallel.
+  // As every method is visited by exactly one thread, the merged infos don't
+  // depend on the scheduling.
+  const size_t num_threads = redex_parallel::default_num_threads();
+  const size_t num_shards = num_threads * 4;
+  auto get_shard = [num_shards](const Candidate& c) {
+    // Mix the hash, as the tables use its low bits for their buckets.
+    uint64_t hash = CandidateHasher()(c);
+    return (hash * 0x9E3779B97F4A7C15ULL >> 32) % num_shards;
+  };
+  std::vector<std::vector<CandidateInfos>> thread_candidates(
+      num_threads, std::vector<CandidateInfos>(num_shards));
   FindCandidatesStats stats;
-  walk::parallel::code(scope, [&config, &sufficiently_warm_methods,
-                               &sufficiently_hot_methods, &illegal_ref,
-                               &recurring_cores, &concurrent_candidates,
-                               &stats](DexMethod* method, IRCode& code) {
-    if (!can_outline_from_method(method, sufficiently_hot_methods)) {
-      return;
-    }
-    bool skip_loops = !!sufficiently_warm_methods.count(method);
-    for (auto& p :
-         find_method_candidates(config, illegal_ref, skip_loops, method,
-                                code.cfg(), recurring_cores, &stats)) {
-      std::vector<CandidateMethodLocation>& cmls = p.second;
-      concurrent_candidates.update(p.first,
-                                   [method, &cmls](const Candidate&,
-                                                   CandidateInfo& info,
-                                                   bool /* exists */) {
-                                     info.methods.emplace(method, cmls);
-                                     info.count += cmls.size();
-                                   });
+
+  // Optionally, a first round only estimates how often each candidate occurs,
+  // so that the second round doesn't need to hold on to the occurrences of the
+  // many candidates that are too rare to ever be beneficial.
+  std::unique_ptr<CountMinSketch> sketch;
+  std::atomic<size_t> sketch_dropped{0};
+  if (config.use_frequency_sketch) {
+    sketch = std::make_unique<CountMinSketch>(FREQUENCY_SKETCH_DEPTH,
+                                              FREQUENCY_SKETCH_WIDTH);
+    FindCandidatesStats ignored_stats;
+    walk::parallel::code(
+        scope, [&](DexMethod* method, IRCode& code) {
+          if (!can_outline_from_method(method, sufficiently_hot_methods)) {
+            return;
+          }
+          bool skip_loops = !!sufficiently_warm_methods.count(method);
+          for (auto& p :
+               find_method_candidates(config, illegal_ref, skip_loops,
+                                      method, code.cfg(), recurring_cores,
+                                      &ignored_stats)) {
+            sketch->add(CandidateHasher()(p.first), p.second.size());
+          }
+        });
+  }
+  auto find_wq = workqueue_foreach<DexMethod*>(
+      [&](sparta::SpartaWorkerState<DexMethod*>* state, DexMethod* method) {
+        bool skip_loops = !!sufficiently_warm_methods.count(method);
+        auto& local_candidates = thread_candidates[state->worker_id()];
+        for (auto& p : find_method_candidates(
+                 config, illegal_ref, skip_loops, method,
+                 method->get_code()->cfg(), recurring_cores, &stats)) {
+          std::vector<CandidateMethodLocation>& cmls = p.second;
+          if (sketch && !could_be_beneficial(
+                            config, p.first,
+                            sketch->estimate(CandidateHasher()(p.first)))) {
+            sketch_dropped += cmls.size();
+            continue;
+          }
+          auto& info = local_candidates[get_shard(p.first)][p.first];
+          info.count += cmls.size();
+          if (skip_loops) {
+            info.warm_count += cmls.size();
+          }
+          info.methods.emplace(method, std::move(cmls));
+        }
+      },
+      num_threads);
+  walk::code(scope, [&](DexMethod* method, IRCode&) {
+    if (can_outline_from_method(method, sufficiently_hot_methods)) {
+      find_wq.add_item(method);
     }
   });
+  find_wq.run_all();
+
+  std::vector<CandidateInfos> candidates(num_shards);
+  auto merge_wq = workqueue_foreach<size_t>(
+      [&](size_t shard) {
+        auto& merged = candidates[shard];
+        for (auto& local_candidates : thread_candidates) {
+          for (auto& p : local_candidates[shard]) {
+            auto& info = merged[p.first];
+            info.count += p.second.count;
+            info.warm_count += p.second.warm_count;
+            for (auto& q : p.second.methods) {
+              info.methods.emplace(q.first, std::move(q.second));
+            }
+          }
+          local_candidates[shard].clear();
+        }
+      },
+      num_threads);
+  for (size_t shard = 0; shard < num_shards; shard++) {
+    merge_wq.add_item(shard);
+  }
+  merge_wq.run_all();
+  thread_candidates.clear();
+  auto get_info = [&](const Candidate& c) -> const CandidateInfo& {
+    return candidates[get_shard(c)].at(c);
+  };
+  if (sketch) {
+    mgr.incr_metric("num_candidates_dropped_by_sketch", sketch_dropped);
+  }
 #define FOR_EACH(name) mgr.incr_metric("num_candidate_" #name, stats.name);
   STATS
 #undef FOR_EACH
@@ -1422,14 +1576,17 @@ static void get_beneficial_candidates(
   std::map<DexMethod*, CandidateSet, dexmethods_comparator>
       candidates_by_methods;
   size_t beneficial_count{0}, maleficial_count{0};
-  for (auto& p : concurrent_candidates) {
-    if (get_savings(config, p.first, p.second, reusable_outlined_methods) > 0) {
-      beneficial_count += p.second.count;
-      for (auto& q : p.second.methods) {
-        candidates_by_methods[q.first].insert(p.first);
+  for (auto& shard_candidates : candidates) {
+    for (auto& p : shard_candidates) {
+      if (get_savings(config, p.first, p.second, reusable_outlined_methods) >
+          0) {
+        beneficial_count += p.second.count;
+        for (auto& q : p.second.methods) {
+          candidates_by_methods[q.first].insert(p.first);
+        }
+      } else {
+        maleficial_count += p.second.count;
       }
-    } else {
-      maleficial_count += p.second.count;
     }
   }
   TRACE(ISO, 2,
@@ -1451,7 +1608,7 @@ static void get_beneficial_candidates(
         method_candidate_ids.insert(id_it->second);
         continue;
       }
-      const auto& ci = concurrent_candidates.at_unsafe(c);
+      const auto& ci = get_info(c);
       for (auto& cml : ci.methods.at(p.first)) {
         ordered.emplace_back(cml, it);
       }
@@ -1487,8 +1644,7 @@ static void get_beneficial_candidates(
         CandidateId candidate_id = candidate_ids.size();
         method_candidate_ids.insert(candidate_id);
         candidate_ids.emplace(c, candidate_id);
-        candidates_with_infos->push_back(
-            {c, concurrent_candidates.at_unsafe(c)});
+        candidates_with_infos->push_back({c, get_info(c)});
       }
     }
   }
@@ -2220,6 +2376,7 @@ static NewlyOutlinedMethods outline(
     std::vector<CandidateWithInfo>* candidates_with_infos,
     std::unordered_map<DexMethod*, std::unordered_set<CandidateId>>*
         candidate_ids_by_methods,
+    const std::unordered_set<DexMethod*>& sufficiently_warm_methods,
     ReusableOutlinedMethods* reusable_outlined_methods,
     size_t iteration) {
   MethodNameGenerator method_name_generator(mgr, iteration);
@@ -2253,6 +2410,7 @@ static NewlyOutlinedMethods outline(
     }
     cwi.info.methods.clear();
     cwi.info.count = 0;
+    cwi.info.warm_count = 0;
   };
   for (CandidateId id = 0; id < candidates_with_infos->size(); id++) {
     pq.insert(id, get_priority(id));
@@ -2295,6 +2453,7 @@ static NewlyOutlinedMethods outline(
     for (auto& p : cwi.info.methods) {
       auto method = p.first;
       auto& cmls = p.second;
+      bool is_warm = !!sufficiently_warm_methods.count(method);
       for (auto other_id : candidate_ids_by_methods->at(method)) {
         if (other_id == id) {
           continue;
@@ -2307,6 +2466,9 @@ static NewlyOutlinedMethods outline(
             if (ranges_overlap(cml.ranges, other_cml.ranges)) {
               it = other_cmls.erase(it);
               other_c.info.count--;
+              if (is_warm) {
+                other_c.info.warm_count--;
+              }
               if (other_id != id) {
                 other_candidate_ids_with_changes.insert(other_id);
               }
@@ -2665,6 +2827,16 @@ void InstructionSequenceOutliner::bind_config() {
        m_config.savings_threshold,
        "Minimum number of code units saved before a particular code sequence "
        "is outlined anywhere");
+  bind("warm_invoke_cost", m_config.warm_invoke_cost,
+       m_config.warm_invoke_cost,
+       "Penalty in code units for each occurrence outlined from a warm "
+       "method, where the invocation overhead is paid at runtime; 0 only "
+       "weighs the size savings");
+  bind("use_frequency_sketch", m_config.use_frequency_sketch,
+       m_config.use_frequency_sketch,
+       "Whether to first estimate how often each candidate occurs in a dex, "
+       "and then only keep the occurrences of candidates that might be "
+       "beneficial; this takes more time, but much less memory");
   always_assert(m_config.min_insns_size >= MIN_INSNS_SIZE);
   always_assert(m_config.max_insns_size >= m_config.min_insns_size);
   always_assert(m_config.max_outlined_methods_per_class > 0);
@@ -2741,8 +2913,8 @@ void InstructionSequenceOutliner::run_pass(DexStoresVector& stores,
       DexState dex_state(mgr, dex, dex_id++, reserved_mrefs);
       auto newly_outlined_methods =
           outline(m_config, mgr, dex_state, &candidates_with_infos,
-                  &candidate_ids_by_methods, reusable_outlined_methods.get(),
-                  iteration);
+                  &candidate_ids_by_methods, sufficiently_warm_methods,
+                  reusable_outlined_methods.get(), iteration);
 
       reorder_with_method_profiles(m_config, mgr, dex, methods_global_order,
                                    newly_outlined_methods);
@@ -22,6 +22,8 @@ struct InstructionSequenceOutlinerConfig {
   bool reuse_outlined_methods_across_dexes{true};
   size_t max_outlined_methods_per_class{100};
   size_t savings_threshold{10};
+  size_t warm_invoke_cost{0};
+  bool use_frequency_sketch{false};
 };
 
 class InstructionSequenceOutliner : public Pass {
@@ -0,0 +1,187 @@
+/*
+ * Copyright (c) Facebook, Inc. and its affiliates.
+ *
+ * This source code is licensed under the MIT license found in the
+ * LICENSE file in the root directory of this source tree.
+ */
+
+#include "SuffixArray.h"
+
+#include <algorithm>
+#include <limits>
+
+#include "Debug.h"
+
+namespace outliner_impl {
+
+namespace {
+
+// Induced sorting of all suffixes of s, whose values are in [0, upper]. The
+// recursion works on the reduced string of the LMS substrings, which is at most
+// half as long.
+template <typename T>
+std::vector<int32_t> sa_is(const std::vector<T>& s, int32_t upper) {
+  const int32_t n = s.size();
+  if (n == 0) {
+    return {};
+  }
+  if (n == 1) {
+    return {0};
+  }
+  if (n == 2) {
+    if (s[0] < s[1]) {
+      return {0, 1};
+    }
+    return {1, 0};
+  }
+
+  std::vector<int32_t> sa(n);
+  // Whether each suffix is an S-type suffix, i.e. smaller than the next one.
+  std::vector<bool> ls(n);
+  for (int32_t i = n - 2; i >= 0; i--) {
+    ls[i] = s[i] == s[i + 1] ? ls[i + 1] : s[i] < s[i + 1];
+  }
+  // The start positions of the L-type and S-type buckets of each value.
+  std::vector<int32_t> sum_l(upper + 1), sum_s(upper + 1);
+  for (int32_t i = 0; i < n; i++) {
+    if (!ls[i]) {
+      sum_s[s[i]]++;
+    } else {
+      sum_l[s[i] + 1]++;
+    }
+  }
+  for (int32_t i = 0; i <= upper; i++) {
+    sum_s[i] += sum_l[i];
+    if (i < upper) {
+      sum_l[i + 1] += sum_s[i];
+    }
+  }
+
+  std::vector<int32_t> buf(upper + 1);
+  auto induce = [&](const std::vector<int32_t>& lms) {
+    std::fill(sa.begin(), sa.end(), -1);
+    std::copy(sum_s.begin(), sum_s.end(), buf.begin());
+    for (auto d : lms) {
+      if (d != n) {
+        sa[buf[s[d]]++] = d;
+      }
+    }
+    std::copy(sum_l.begin(), sum_l.end(), buf.begin());
+    sa[buf[s[n - 1]]++] = n - 1;
+    for (int32_t i = 0; i < n; i++) {
+      int32_t v = sa[i];
+      if (v >= 1 && !ls[v - 1]) {
+        sa[buf[s[v - 1]]++] = v - 1;
+      }
+    }
+    std::copy(sum_l.begin(), sum_l.end(), buf.begin());
+    for (int32_t i = n - 1; i >= 0; i--) {
+      int32_t v = sa[i];
+      if (v >= 1 && ls[v - 1]) {
+        sa[--buf[s[v - 1] + 1]] = v - 1;
+      }
+    }
+  };
+
+  // The leftmost S-type positions, and their indices among each other.
+  std::vector<int32_t> lms_map(n + 1, -1);
+  std::vector<int32_t> lms;
+  for (int32_t i = 1; i < n; i++) {
+    if (!ls[i - 1] && ls[i]) {
+      lms_map[i] = lms.size();
+      lms.push_back(i);
+    }
+  }
+  const int32_t m = lms.size();
+
+  induce(lms);
+
+  if (m == 0) {
+    return sa;
+  }
+
+  // Name the LMS substrings in sorted order, giving equal substrings equal
+  // names, and sort the suffixes of the string of names recursively.
+  std::vector<int32_t> sorted_lms;
+  sorted_lms.reserve(m);
+  for (auto v : sa) {
+    if (lms_map[v] != -1) {
+      sorted_lms.push_back(v);
+    }
+  }
+  std::vector<int32_t> rec_s(m);
+  int32_t rec_upper = 0;
+  rec_s[lms_map[sorted_lms[0]]] = 0;
+  for (int32_t i = 1; i < m; i++) {
+    int32_t l = sorted_lms[i - 1];
+    int32_t r = sorted_lms[i];
+    int32_t end_l = lms_map[l] + 1 < m ? lms[lms_map[l] + 1] : n;
+    int32_t end_r = lms_map[r] + 1 < m ? lms[lms_map[r] + 1] : n;
+    bool same = true;
+    if (end_l - l != end_r - r) {
+      same = false;
+    } else {
+      while (l < end_l && s[l] == s[r]) {
+        l++;
+        r++;
+      }
+      if (l == n || s[l] != s[r]) {
+        same = false;
+      }
+    }
+    if (!same) {
+      rec_upper++;
+    }
+    rec_s[lms_map[sorted_lms[i]]] = rec_upper;
+  }
+
+  auto rec_sa = sa_is(rec_s, rec_upper);
+  for (int32_t i = 0; i < m; i++) {
+    sorted_lms[i] = lms[rec_sa[i]];
+  }
+  induce(sorted_lms);
+  return sa;
+}
+
+} // namespace
+
+std::vector<int32_t> build_suffix_array(const std::vector<uint32_t>& s,
+                                        uint32_t alphabet_size) {
+  always_assert(s.size() <
+                static_cast<size_t>(std::numeric_limits<int32_t>::max()));
+  always_assert(alphabet_size > 0);
+  always_assert(alphabet_size <=
+                static_cast<uint32_t>(std::numeric_limits<int32_t>::max()));
+  return sa_is(s, static_cast<int32_t>(alphabet_size - 1));
+}
+
+std::vector<int32_t> build_lcp_array(const std::vector<uint32_t>& s,
+                                     const std::vector<int32_t>& sa) {
+  const int32_t n = s.size();
+  always_assert(sa.size() == s.size());
+  if (n == 0) {
+    return {};
+  }
+  std::vector<int32_t> rank(n);
+  for (int32_t i = 0; i < n; i++) {
+    rank[sa[i]] = i;
+  }
+  std::vector<int32_t> lcp(n - 1);
+  int32_t h = 0;
+  for (int32_t i = 0; i < n; i++) {
+    if (h > 0) {
+      h--;
+    }
+    if (rank[i] == 0) {
+      continue;
+    }
+    int32_t j = sa[rank[i] - 1];
+    while (j + h < n && i + h < n && s[j + h] == s[i + h]) {
+      h++;
+    }
+    lcp[rank[i] - 1] = h;
+  }
+  return lcp;
+}
+
+} // namespace outliner_impl
@@ -0,0 +1,33 @@
+/*
+ * Copyright (c) Facebook, Inc. and its affiliates.
+ *
+ * This source code is licensed under the MIT license found in the
+ * LICENSE file in the root directory of this source tree.
+ */
+
+#pragma once
+
+#include <cstdint>
+#include <vector>
+
+namespace outliner_impl {
+
+/*
+ * Builds the suffix array of a string of tokens in [0, alphabet_size), i.e.
+ * the start positions of all suffixes in lexicographic order, with the SA-IS
+ * algorithm (Nong, Zhang and Chan, "Two Efficient Algorithms for Linear Time
+ * Suffix Array Construction", 2011). This takes linear time and space in the
+ * length of the string.
+ */
+std::vector<int32_t> build_suffix_array(const std::vector<uint32_t>& s,
+                                        uint32_t alphabet_size);
+
+/*
+ * Builds the LCP array of a string and its suffix array with Kasai's
+ * algorithm: element i is the length of the longest common prefix of the
+ * suffixes that start at sa[i] and sa[i + 1].
+ */
+std::vector<int32_t> build_lcp_array(const std::vector<uint32_t>& s,
+                                     const std::vector<int32_t>& sa);
+
+} // namespace outliner_impl
@@ -21,6 +21,7 @@
 #include "DexInstruction.h"
 #include "DexUtil.h"
 #include "IRInstruction.h"
+#include "OpcodeStream.h"
 #include "PassManager.h"
 #include "RedundantCheckCastRemover.h"
 #include "SpartaWorkQueue.h"
@@ -264,9 +265,23 @@ struct Pattern {
         predicate(std::move(predicate)) {}
 };
 
+std::vector<OpcodeSet> compile_opcodes(const std::vector<DexPattern>& match) {
+  std::vector<OpcodeSet> opcodes;
+  opcodes.reserve(match.size());
+  for (const auto& dex_pattern : match) {
+    opcodes.emplace_back(dex_pattern.opcodes);
+  }
+  return opcodes;
+}
+
 // Matcher holds the matching state for the given pattern.
 struct Matcher {
   const Pattern& pattern;
+  // The opcodes that each instruction of a match can have, as bitsets that
+  // are built once, instead of the hash sets of the pattern.
+  const std::vector<OpcodeSet> match_opcodes;
+  // The opcodes of the instructions at which a match can start.
+  const OpcodeSet first_opcodes;
   size_t match_index;
   std::vector<IRInstruction*> matched_instructions;
 
@@ -276,7 +291,22 @@ struct Matcher {
   std::unordered_map<Type, DexType*, EnumClassHash> matched_types;
   std::unordered_map<Field, DexFieldRef*, EnumClassHash> matched_fields;
 
-  explicit Matcher(const Pattern& pattern) : pattern(pattern), match_index(0) {}
+  explicit Matcher(const Pattern& pattern)
+      : pattern(pattern),
+        match_opcodes(compile_opcodes(pattern.match)),
+        first_opcodes(match_opcodes.at(0)),
+        match_index(0) {}
+
+  // Whether a sequence of instructions with these opcodes can contain a match,
+  // i.e. whether each instruction of the pattern has one of its opcodes.
+  bool may_match(const OpcodeSet& opcodes) const {
+    for (const auto& set : match_opcodes) {
+      if (!set.intersects(opcodes)) {
+        return false;
+      }
+    }
+    return true;
+  }
 
   void reset() {
     match_index = 0;
@@ -335,10 +365,10 @@ struct Matcher {
       return newly_inserted ? true : result.first->second == insn_field;
     };
 
-    // Does 'insn' match to the given DexPattern?
-    auto match_instruction = [&](const DexPattern& dex_pattern) {
-      if (dex_pattern.opcodes.find(insn->opcode()) ==
-              end(dex_pattern.opcodes) ||
+    // Does 'insn' match to the DexPattern at the given index?
+    auto match_instruction = [&](size_t index) {
+      const auto& dex_pattern = pattern.match[index];
+      if (!match_opcodes[index].contains(insn->opcode()) ||
           dex_pattern.srcs.size() != insn->srcs_size() ||
           dex_pattern.dests.size() != insn->has_dest()) {
         return false;
@@ -377,7 +407,7 @@ struct Matcher {
     };
 
     redex_assert(match_index < pattern.match.size());
-    if (!match_instruction(pattern.match[match_index])) {
+    if (!match_instruction(match_index)) {
       // Okay, this is the PG's heuristic. Retry only if the failure occurs on
       // the second opcode of the pattern.
       bool retry = (match_index == 1);
@@ -390,7 +420,7 @@ struct Matcher {
       reset();
       if (retry) {
         redex_assert(match_index == 0);
-        if (!match_instruction(pattern.match[match_index])) {
+        if (!match_instruction(match_index)) {
           return false;
         }
       } else {
@@ -1728,15 +1758,43 @@ class alignas(CACHE_LINE_SIZE) PeepholeOptimizer {
     code->build_cfg(/* editable */ true);
     auto& cfg = code->cfg();
 
+    // The opcodes of each block, so that a pattern only looks at the blocks
+    // and instructions where it can start. They are built again after a
+    // pattern has changed the code.
+    std::vector<cfg::Block*> blocks;
+    std::vector<OpcodeStream> streams;
+    OpcodeSet method_opcodes;
+    bool streams_valid = false;
+
     // do optimizations one at a time
     // so they can match on the same pattern without interfering
     for (size_t i = 0; i < m_matchers.size(); ++i) {
       auto& matcher = m_matchers[i];
 
-      const auto& blocks = cfg.blocks();
+      if (!streams_valid) {
+        blocks = cfg.blocks();
+        streams.clear();
+        streams.reserve(blocks.size());
+        method_opcodes = OpcodeSet();
+        for (auto* block : blocks) {
+          streams.emplace_back(InstructionIterable(block));
+          method_opcodes |= streams.back().opcodes();
+        }
+        streams_valid = true;
+      }
+      // Most patterns need opcodes that the method doesn't have at all.
+      if (!matcher.may_match(method_opcodes)) {
+        continue;
+      }
       cfg::CFGMutation mutator(cfg);
 
-      for (const auto& block : blocks) {
+      for (size_t b = 0; b < blocks.size(); ++b) {
+        auto* block = blocks[b];
+        const auto& stream = streams[b];
+        if (!matcher.may_match(stream.opcodes())) {
+          continue;
+        }
+
         // Currently, all patterns do not span over multiple basic blocks. So
         // reset all matching states on visiting every basic block.
         matcher.reset();
@@ -1745,11 +1803,20 @@ class alignas(CACHE_LINE_SIZE) PeepholeOptimizer {
         // CFGMutation capabilities.
         std::unordered_set<IRInstruction*> removed_insns;
 
-        for (auto& mie : InstructionIterable(block)) {
-          if (!matcher.try_match(mie.insn)) {
+        for (size_t pos = 0; pos < stream.size();) {
+          // An instruction that cannot start a match leaves a reset matcher
+          // unchanged, so skip to the next one that can.
+          if (matcher.match_index == 0) {
+            pos = stream.find_first_of(matcher.first_opcodes, pos);
+            if (pos == stream.size()) {
+              break;
+            }
+          }
+          if (!matcher.try_match(stream.insn(pos++))) {
             continue;
           }
           m_stats.at(i)++;
+          streams_valid = false;
           TRACE(PEEPHOLE, 7, "PATTERN %s MATCHED!",
                 matcher.pattern.name.c_str());
 
@@ -15,6 +15,8 @@ class PrintMembersPass : public Pass {
  public:
   PrintMembersPass() : Pass("PrintMembersPass") {}
 
+  bool is_read_only() const override { return true; }
+
   void bind_config() override {
     bind("show_code", false, m_config.show_code);
     bind("show_sfields", true, m_config.show_sfields);
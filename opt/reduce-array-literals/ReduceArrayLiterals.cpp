@@ -31,6 +31,8 @@ constexpr const char* METRIC_FILLED_ARRAYS = "num_filled_arrays";
 constexpr const char* METRIC_FILLED_ARRAY_ELEMENTS =
     "num_filled_array_elements";
 constexpr const char* METRIC_FILLED_ARRAY_CHUNKS = "num_filled_array_chunks";
+constexpr const char* METRIC_ARRAY_DATA_PAYLOADS = "num_array_data_payloads";
+constexpr const char* METRIC_ARRAY_DATA_ELEMENTS = "num_array_data_elements";
 constexpr const char* METRIC_REMAINING_WIDE_ARRAYS =
     "num_remaining_wide_arrays";
 constexpr const char* METRIC_REMAINING_WIDE_ARRAY_ELEMENTS =
@@ -173,6 +175,7 @@ using TrackedDomain =
     sparta::HashedSetAbstractDomain<TrackedValue, TrackedValueHasher>;
 using EscapedArrayDomain =
     sparta::ConstantAbstractDomain<std::vector<const IRInstruction*>>;
+using AputLiteralDomain = sparta::ConstantAbstractDomain<int32_t>;
 
 /**
  * For each register that holds a relevant value, keep track of it.
@@ -297,6 +300,16 @@ class Analyzer final : public BaseIRAnalyzer<TrackedDomainEnvironment> {
           TrackedValue new_array = *array;
           if (add_element(new_array, index_literal, insn)) {
             current_state->set(insn->src(1), TrackedDomain(new_array));
+            const auto value = get_singleton(current_state->get(insn->src(0)));
+            auto literal = value && is_literal(*value)
+                               ? AputLiteralDomain(get_literal(*value))
+                               : AputLiteralDomain::top();
+            auto it = m_aput_literals.find(insn);
+            if (it == m_aput_literals.end()) {
+              m_aput_literals.emplace(insn, literal);
+            } else {
+              it->second.join_with(literal);
+            }
             break;
           }
         }
@@ -338,9 +351,22 @@ class Analyzer final : public BaseIRAnalyzer<TrackedDomainEnvironment> {
     return result;
   }
 
+  std::unordered_map<const IRInstruction*, int32_t> get_aput_literals() {
+    std::unordered_map<const IRInstruction*, int32_t> result;
+    for (auto& p : m_aput_literals) {
+      auto constant = p.second.get_constant();
+      if (constant) {
+        result.emplace(p.first, *constant);
+      }
+    }
+    return result;
+  }
+
  private:
   mutable std::unordered_map<const IRInstruction*, EscapedArrayDomain>
       m_escaped_arrays;
+  mutable std::unordered_map<const IRInstruction*, AputLiteralDomain>
+      m_aput_literals;
 };
 
 } // namespace
@@ -350,10 +376,12 @@ class Analyzer final : public BaseIRAnalyzer<TrackedDomainEnvironment> {
 ReduceArrayLiterals::ReduceArrayLiterals(cfg::ControlFlowGraph& cfg,
                                          size_t max_filled_elements,
                                          int32_t min_sdk,
-                                         Architecture arch)
+                                         Architecture arch,
+                                         size_t min_array_data_elements)
     : m_cfg(cfg),
       m_max_filled_elements(max_filled_elements),
       m_min_sdk(min_sdk),
+      m_min_array_data_elements(min_array_data_elements),
       m_arch(arch) {
 
   std::vector<IRInstruction*> new_array_insns;
@@ -378,6 +406,7 @@ ReduceArrayLiterals::ReduceArrayLiterals(cfg::ControlFlowGraph& cfg,
     }
   }
   always_assert(array_literals.size() == m_array_literals.size());
+  m_aput_literals = analyzer.get_aput_literals();
 }
 
 void ReduceArrayLiterals::patch() {
@@ -389,6 +418,12 @@ void ReduceArrayLiterals::patch() {
       continue;
     }
 
+    if (m_min_array_data_elements > 0 &&
+        aput_insns.size() >= m_min_array_data_elements &&
+        patch_array_data(new_array_insn, aput_insns)) {
+      continue;
+    }
+
     auto type = new_array_insn->get_type();
     auto element_type = type::get_array_component_type(type);
 
@@ -463,6 +498,65 @@ void ReduceArrayLiterals::patch() {
   }
 }
 
+namespace {
+
+template <typename IntType>
+DexOpcodeData* encode_literals(const std::vector<int32_t>& literals) {
+  // Truncated just like the aput instructions would.
+  std::vector<IntType> elements(literals.begin(), literals.end());
+  return encode_fill_array_data_payload(elements);
+}
+
+} // namespace
+
+bool ReduceArrayLiterals::patch_array_data(
+    const IRInstruction* new_array_insn,
+    const std::vector<const IRInstruction*>& aput_insns) {
+  auto element_type =
+      type::get_array_component_type(new_array_insn->get_type());
+  if (!type::is_primitive(element_type) || type::is_wide_type(element_type)) {
+    return false;
+  }
+  std::vector<int32_t> literals;
+  literals.reserve(aput_insns.size());
+  for (auto aput_insn : aput_insns) {
+    auto it = m_aput_literals.find(aput_insn);
+    if (it == m_aput_literals.end()) {
+      return false;
+    }
+    literals.push_back(it->second);
+  }
+
+  DexOpcodeData* data;
+  if (element_type == type::_boolean() || element_type == type::_byte()) {
+    data = encode_literals<int8_t>(literals);
+  } else if (element_type == type::_char()) {
+    data = encode_literals<uint16_t>(literals);
+  } else if (element_type == type::_short()) {
+    data = encode_literals<int16_t>(literals);
+  } else {
+    data = encode_literals<int32_t>(literals);
+  }
+
+  // The fill-array-data instruction takes the place of the last aput, where
+  // the array is in the same register as at the other aputs, and nothing has
+  // read its elements yet.
+  auto last_aput_insn = aput_insns.back();
+  auto fill_array_data_insn = new IRInstruction(OPCODE_FILL_ARRAY_DATA);
+  fill_array_data_insn->set_src(0, last_aput_insn->src(1))->set_data(data);
+  for (auto aput_insn : aput_insns) {
+    auto it = m_cfg.find_insn(const_cast<IRInstruction*>(aput_insn));
+    if (aput_insn == last_aput_insn) {
+      m_cfg.replace_insn(it, fill_array_data_insn);
+    } else {
+      m_cfg.remove_insn(it);
+    }
+  }
+  m_stats.array_data_payloads++;
+  m_stats.array_data_elements += aput_insns.size();
+  return true;
+}
+
 void ReduceArrayLiterals::patch_new_array(
     const IRInstruction* new_array_insn,
     const std::vector<const IRInstruction*>& aput_insns) {
@@ -639,6 +733,11 @@ void ReduceArrayLiteralsPass::bind_config() {
   // runtime, while also being reasonably large so that this optimization still
   // results in a significant win in terms of instructions count.
   bind("max_filled_elements", {27}, m_max_filled_elements);
+  // Large lookup tables are much cheaper to initialize, and smaller, as
+  // fill-array-data payloads than as a constant and an aput per element.
+  bind("min_array_data_elements", {0}, m_min_array_data_elements,
+       "Initialize primitive array literals with at least this many constant "
+       "elements by fill-array-data. Zero disables this.");
   after_configuration([this] {
     always_assert(m_max_filled_elements < 0xff);
     interdex::InterDexRegistry* registry =
@@ -672,7 +771,7 @@ void ReduceArrayLiteralsPass::run_pass(DexStoresVector& stores,
 
         code->build_cfg(/* editable */ true);
         ReduceArrayLiterals ral(code->cfg(), m_max_filled_elements, min_sdk,
-                                arch);
+                                arch, m_min_array_data_elements);
         ral.patch();
         code->clear_cfg();
         return ral.get_stats();
@@ -681,6 +780,8 @@ void ReduceArrayLiteralsPass::run_pass(DexStoresVector& stores,
   mgr.incr_metric(METRIC_FILLED_ARRAYS, stats.filled_arrays);
   mgr.incr_metric(METRIC_FILLED_ARRAY_ELEMENTS, stats.filled_array_elements);
   mgr.incr_metric(METRIC_FILLED_ARRAY_CHUNKS, stats.filled_array_chunks);
+  mgr.incr_metric(METRIC_ARRAY_DATA_PAYLOADS, stats.array_data_payloads);
+  mgr.incr_metric(METRIC_ARRAY_DATA_ELEMENTS, stats.array_data_elements);
   mgr.incr_metric(METRIC_REMAINING_WIDE_ARRAYS, stats.remaining_wide_arrays);
   mgr.incr_metric(METRIC_REMAINING_WIDE_ARRAY_ELEMENTS,
                   stats.remaining_wide_array_elements);
@@ -698,6 +799,8 @@ ReduceArrayLiterals::Stats& ReduceArrayLiterals::Stats::operator+=(
   filled_arrays += that.filled_arrays;
   filled_array_elements += that.filled_array_elements;
   filled_array_chunks += that.filled_array_chunks;
+  array_data_payloads += that.array_data_payloads;
+  array_data_elements += that.array_data_elements;
   remaining_wide_arrays += that.remaining_wide_arrays;
   remaining_wide_array_elements += that.remaining_wide_array_elements;
   remaining_unimplemented_arrays += that.remaining_unimplemented_arrays;
@@ -7,6 +7,8 @@
 
 #pragma once
 
+#include <unordered_map>
+
 #include "Pass.h"
 #include "PassManager.h"
 
@@ -16,6 +18,8 @@ class ReduceArrayLiterals {
     size_t filled_arrays{0};
     size_t filled_array_chunks{0};
     size_t filled_array_elements{0};
+    size_t array_data_payloads{0};
+    size_t array_data_elements{0};
     size_t remaining_wide_arrays{0};
     size_t remaining_wide_array_elements{0};
     size_t remaining_unimplemented_arrays{0};
@@ -26,10 +30,16 @@ class ReduceArrayLiterals {
     Stats& operator+=(const Stats&);
   };
 
+  /*
+   * Primitive array literals of at least min_array_data_elements constant
+   * elements are initialized with a single fill-array-data instruction, whose
+   * payload holds the elements, instead. Zero disables this.
+   */
   ReduceArrayLiterals(cfg::ControlFlowGraph&,
                       size_t max_filled_elements,
                       int32_t min_sdk,
-                      Architecture arch);
+                      Architecture arch,
+                      size_t min_array_data_elements = 0);
 
   const Stats& get_stats() const { return m_stats; }
 
@@ -39,6 +49,8 @@ class ReduceArrayLiterals {
   void patch();
 
  private:
+  bool patch_array_data(const IRInstruction* new_array_insn,
+                        const std::vector<const IRInstruction*>& aput_insns);
   void patch_new_array(const IRInstruction* new_array_insn,
                        const std::vector<const IRInstruction*>& aput_insns);
   size_t patch_new_array_chunk(
@@ -51,11 +63,15 @@ class ReduceArrayLiterals {
   cfg::ControlFlowGraph& m_cfg;
   size_t m_max_filled_elements;
   int32_t m_min_sdk;
+  size_t m_min_array_data_elements;
   std::vector<reg_t> m_local_temp_regs;
   Stats m_stats;
   std::vector<
       std::pair<const IRInstruction*, std::vector<const IRInstruction*>>>
       m_array_literals;
+  // The values stored by the aput instructions of the array literals, if they
+  // are constants.
+  std::unordered_map<const IRInstruction*, int32_t> m_aput_literals;
   Architecture m_arch;
 };
 
@@ -68,5 +84,6 @@ class ReduceArrayLiteralsPass : public Pass {
 
  private:
   size_t m_max_filled_elements;
+  size_t m_min_array_data_elements;
   bool m_debug;
 };
@@ -304,6 +304,30 @@ std::string show(const RegisterTransform& reg_transform) {
   return ss.str();
 }
 
+/*
+ * Orders the nodes from the best spill candidate to the worst one: the nodes
+ * that have not been spilled yet, by increasing ratio of spill cost to
+ * weight, and then by register. See simplify() for the rationale.
+ */
+struct SpillCandidateOrder {
+  const interference::Graph* ig;
+
+  bool operator()(reg_t a, reg_t b) const {
+    auto& node_a = ig->get_node(a);
+    auto& node_b = ig->get_node(b);
+    if (node_a.is_spilt() != node_b.is_spilt()) {
+      return !node_a.is_spilt();
+    }
+    // Note that a / b < c / d <=> a * d < c * b.
+    uint64_t cost_a = uint64_t(node_a.spill_cost()) * node_b.weight();
+    uint64_t cost_b = uint64_t(node_b.spill_cost()) * node_a.weight();
+    if (cost_a != cost_b) {
+      return cost_a < cost_b;
+    }
+    return a < b;
+  }
+};
+
 } // namespace
 
 Allocator::Stats& Allocator::Stats::operator+=(const Allocator::Stats& that) {
@@ -314,6 +338,9 @@ Allocator::Stats& Allocator::Stats::operator+=(const Allocator::Stats& that) {
   split_moves += that.split_moves;
   moves_coalesced += that.moves_coalesced;
   params_spill_early += that.params_spill_early;
+  linear_scan_allocations += that.linear_scan_allocations;
+  linear_scan_fallbacks += that.linear_scan_fallbacks;
+  liveness_reuse_count += that.liveness_reuse_count;
   return *this;
 }
 
@@ -433,8 +460,10 @@ void Allocator::simplify(interference::Graph* ig,
   // the nodes in `low` have a max_vreg of 15, we can still have more than 16
   // of them here since some of them can have zero weight.
   std::set<reg_t> low;
-  // Nodes that may not be colorable
-  std::set<reg_t> high;
+  // Nodes that may not be colorable, ordered by how good a spill candidate
+  // they are, so that picking one does not take a scan. A node's position
+  // depends on its weight; nodes are taken out while their weight changes.
+  std::set<reg_t, SpillCandidateOrder> high(SpillCandidateOrder{ig});
 
   for (const auto& pair : ig->active_nodes()) {
     auto reg = pair.first;
@@ -448,6 +477,7 @@ void Allocator::simplify(interference::Graph* ig,
       high.emplace(reg);
     }
   }
+  std::vector<reg_t> reweighted;
   while (true) {
     while (!low.empty()) {
       auto reg = *low.begin();
@@ -458,17 +488,21 @@ void Allocator::simplify(interference::Graph* ig,
       } else {
         spilled_select_stack->push(reg);
       }
-      ig->remove_node(reg);
-      low.erase(reg);
+      reweighted.clear();
       for (auto adj : node.adjacent()) {
-        auto& adj_node = ig->get_node(adj);
-        if (!adj_node.is_active() || adj_node.is_param() ||
-            adj_node.is_range()) {
-          continue;
+        auto adj_it = high.find(adj);
+        if (adj_it != high.end() && ig->get_node(adj).is_active()) {
+          high.erase(adj_it);
+          reweighted.push_back(adj);
         }
-        if (adj_node.definitely_colorable()) {
+      }
+      ig->remove_node(reg);
+      low.erase(reg);
+      for (auto adj : reweighted) {
+        if (ig->get_node(adj).definitely_colorable()) {
           low.emplace(adj);
-          high.erase(adj);
+        } else {
+          high.emplace(adj);
         }
       }
     }
@@ -495,18 +529,8 @@ void Allocator::simplify(interference::Graph* ig,
     // uses (high spill cost), and interfere with fewer live ranges (have lower
     // weight) compared to v2 and v3 (tying with v4, but v4 still has a lower
     // spill cost).
-    auto spill_candidate_it =
-        std::min_element(high.begin(), high.end(), [ig](reg_t a, reg_t b) {
-          auto& node_a = ig->get_node(a);
-          auto& node_b = ig->get_node(b);
-          if (node_a.is_spilt() == node_b.is_spilt()) {
-            // Note that a / b < c / d <=> a * d < c * b.
-            return node_a.spill_cost() * node_b.weight() <
-                   node_b.spill_cost() * node_a.weight();
-          }
-          return !node_a.is_spilt() && node_b.is_spilt();
-        });
-    TRACE(REG, 6, "Potentially spilling %u", *spill_candidate_it);
+    auto spill_candidate = *high.begin();
+    TRACE(REG, 6, "Potentially spilling %u", spill_candidate);
     // Our spill candidate has too many neighbors for us to be certain that we
     // can color it. Instead of spilling it immediately, we put it into `low`,
     // which will ensure that it ends up on the stack before any of the
@@ -515,8 +539,8 @@ void Allocator::simplify(interference::Graph* ig,
     // neighbors. If some of those neighbors share the same colors, we may be
     // able to color this node despite its weight. Briggs calls this
     // "optimistic coloring".
-    low.emplace(*spill_candidate_it);
-    high.erase(*spill_candidate_it);
+    low.emplace(spill_candidate);
+    high.erase(high.begin());
   }
 }
 
@@ -848,7 +872,7 @@ std::unordered_map<reg_t, IRList::iterator> Allocator::find_param_splits(
 
   auto& cfg = code->cfg();
   cfg::Block* start_block = cfg.entry_block();
-  auto doms = dominators::SimpleFastDominators<cfg::GraphInterface>(cfg);
+  auto doms = cfg.dominators();
   for (auto param : params) {
     auto block_uses = find_first_uses(param, start_block);
     // Since this function only gets called for param regs that need to be
@@ -860,7 +884,7 @@ std::unordered_map<reg_t, IRList::iterator> Allocator::find_param_splits(
       // insert a load at its end.
       cfg::Block* idom = block_uses[0];
       for (size_t index = 1; index < block_uses.size(); ++index) {
-        idom = doms.intersect(idom, block_uses[index]);
+        idom = doms->intersect(idom, block_uses[index]);
       }
       TRACE(REG, 5, "Inserting param load of v%u in B%u", param, idom->id());
       // We need to check insn before end of block to make sure we didn't
@@ -939,12 +963,40 @@ void Allocator::split_params(const interference::Graph& ig,
  * Param-related symregs are spilled by inserting loads just after the
  * block of parameter instructions.
  */
-void Allocator::spill(const interference::Graph& ig,
+bool Allocator::spill(const interference::Graph& ig,
                       const SpillPlan& spill_plan,
                       const RangeSet& range_set,
-                      IRCode* code) {
+                      IRCode* code,
+                      std::unordered_set<cfg::Block*>* changed_blocks) {
   // TODO: account for "close" defs and uses. See [Briggs92], section 8.7
 
+  // A move inserted before the first entry of a block would end up in the
+  // previous block, so the CFG has to be built again.
+  std::unordered_map<const IRInstruction*, cfg::Block*> blocks;
+  std::unordered_set<const IRInstruction*> block_heads;
+  if (changed_blocks != nullptr) {
+    for (cfg::Block* block : code->cfg().blocks()) {
+      for (auto& mie : InstructionIterable(block)) {
+        blocks.emplace(mie.insn, block);
+      }
+      if (block->begin() != block->end() &&
+          block->begin()->type == MFLOW_OPCODE) {
+        block_heads.emplace(block->begin()->insn);
+      }
+    }
+  }
+  bool cfg_valid{true};
+  auto note_insertion = [&](const IRInstruction* insn, bool before) {
+    if (changed_blocks == nullptr) {
+      cfg_valid = false;
+      return;
+    }
+    if (before && block_heads.count(insn)) {
+      cfg_valid = false;
+    }
+    changed_blocks->emplace(blocks.at(insn));
+  };
+
   auto ii = InstructionIterable(code);
   auto end = ii.end();
   for (auto it = ii.begin(); it != end; ++it) {
@@ -962,6 +1014,7 @@ void Allocator::spill(const interference::Graph& ig,
           auto mov = gen_move(node.type(), temp, src);
           ++m_stats.range_spill_moves;
           code->insert_before(it.unwrap(), mov);
+          note_insertion(insn, /* before */ true);
         }
       }
     } else {
@@ -984,6 +1037,7 @@ void Allocator::spill(const interference::Graph& ig,
           auto mov = gen_move(node.type(), temp, src);
           ++m_stats.global_spill_moves;
           code->insert_before(it.unwrap(), mov);
+          note_insertion(insn, /* before */ true);
         }
       }
       if (insn->has_dest()) {
@@ -996,10 +1050,12 @@ void Allocator::spill(const interference::Graph& ig,
           it.reset(code->insert_after(
               it.unwrap(), gen_move(ig.get_node(dest).type(), dest, temp)));
           ++m_stats.global_spill_moves;
+          note_insertion(insn, /* before */ false);
         }
       }
     }
   }
+  return cfg_valid;
 }
 
 /*
@@ -1081,16 +1137,27 @@ void Allocator::allocate(DexMethod* method) {
     dedicate_this_register(method);
   }
   bool first{true};
+  // The liveness is kept across iterations as long as the CFG is, and then
+  // only the blocks in which spill moves were inserted are analyzed again.
+  std::unique_ptr<LivenessFixpointIterator> fixpoint_iter_ptr;
+  std::unordered_set<cfg::Block*> changed_blocks;
   while (true) {
     SplitCosts split_costs;
     SpillPlan spill_plan;
     SplitPlan split_plan;
     RegisterTransform reg_transform;
 
-    auto& cfg = code->cfg();
-    cfg.calculate_exit_block();
-    LivenessFixpointIterator fixpoint_iter(cfg);
-    fixpoint_iter.run(LivenessDomain());
+    if (fixpoint_iter_ptr == nullptr) {
+      auto& cfg = code->cfg();
+      cfg.calculate_exit_block();
+      fixpoint_iter_ptr = std::make_unique<LivenessFixpointIterator>(cfg);
+      fixpoint_iter_ptr->run(LivenessDomain());
+    } else {
+      fixpoint_iter_ptr->rerun(LivenessDomain(), changed_blocks);
+      ++m_stats.liveness_reuse_count;
+    }
+    changed_blocks.clear();
+    auto& fixpoint_iter = *fixpoint_iter_ptr;
 
     TRACE(REG, 5, "Allocating:\n%s", ::SHOW(code->cfg()));
     auto ig =
@@ -1151,7 +1218,7 @@ void Allocator::allocate(DexMethod* method) {
         find_split(ig, split_costs, &reg_transform, &spill_plan, &split_plan);
       }
       split_params(ig, spill_plan.param_spills, code);
-      spill(ig, spill_plan, range_set, code);
+      bool cfg_valid = spill(ig, spill_plan, range_set, code, &changed_blocks);
 
       if (!split_plan.split_around.empty()) {
         TRACE(REG, 5, "Split plan:\n%s", SHOW(split_plan));
@@ -1160,8 +1227,13 @@ void Allocator::allocate(DexMethod* method) {
       }
 
       // Since we have inserted instructions, we need to rebuild the CFG to
-      // ensure that block boundaries remain correct
-      code->build_cfg(/* editable */ false);
+      // ensure that block boundaries remain correct, unless all the
+      // instructions are spill moves inside blocks.
+      if (!cfg_valid || !spill_plan.param_spills.empty() ||
+          !split_plan.split_around.empty()) {
+        code->build_cfg(/* editable */ false);
+        fixpoint_iter_ptr.reset();
+      }
     } else {
       transform::remap_registers(code, reg_transform.map);
       code->set_registers_size(reg_transform.size);
@@ -1178,6 +1250,7 @@ void Allocator::allocate(DexMethod* method) {
   TRACE(REG, 3, "Coalesce count: %lu", m_stats.moves_coalesced);
   TRACE(REG, 3, "Params spilled too early: %lu", m_stats.params_spill_early);
   TRACE(REG, 3, "Net moves: %ld", m_stats.net_moves());
+  TRACE(REG, 3, "Liveness reuse count: %lu", m_stats.liveness_reuse_count);
 }
 
 } // namespace graph_coloring
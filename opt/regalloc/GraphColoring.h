@@ -83,6 +83,8 @@ class Allocator {
   struct Config {
     bool no_overwrite_this{false};
     bool use_splitting{false};
+    // Try the linear scan allocator first on small methods.
+    bool use_linear_scan{false};
   };
 
   struct Stats {
@@ -93,6 +95,10 @@ class Allocator {
     size_t split_moves{0};
     size_t moves_coalesced{0};
     size_t params_spill_early{0};
+    size_t linear_scan_allocations{0};
+    size_t linear_scan_fallbacks{0};
+    // The spill iterations that kept the CFG and liveness of the previous one.
+    size_t liveness_reuse_count{0};
     size_t moves_inserted() const {
       return param_spill_moves + range_spill_moves + global_spill_moves +
              split_moves;
@@ -146,10 +152,16 @@ class Allocator {
                     const std::unordered_set<reg_t>& param_regs,
                     IRCode*);
 
-  void spill(const interference::Graph&,
+  /*
+   * Returns whether the CFG of the code is still valid, i.e. whether all the
+   * spill moves were inserted inside blocks. If so, the blocks that got spill
+   * moves are added to `changed_blocks`, when it is given.
+   */
+  bool spill(const interference::Graph&,
              const SpillPlan&,
              const RangeSet&,
-             IRCode*);
+             IRCode*,
+             std::unordered_set<cfg::Block*>* changed_blocks = nullptr);
 
   void allocate(DexMethod*);
 
@@ -66,18 +66,51 @@ uint32_t Graph::edge_weight(const Node& u_node, const Node& v_node) const {
                         : 0;
 }
 
+bool AdjacencyMatrix::add(reg_t u, reg_t v, bool can_coalesce) {
+  if (m_large.empty()) {
+    if (std::max(u, v) <= MAX_MATRIX_REG) {
+      auto bit = bit_index(u, v);
+      if (bit >= m_bits.size()) {
+        // Grow geometrically, up to the limit.
+        size_t dim = std::max<size_t>(std::max(u, v) + 1,
+                                      std::max<size_t>(2 * m_dim, 64));
+        m_dim = std::min<size_t>(dim, MAX_MATRIX_REG + 1);
+        m_bits.resize(m_dim * (m_dim - 1));
+      }
+      bool is_new = !m_bits[bit];
+      m_bits[bit] = true;
+      if (!can_coalesce) {
+        m_bits[bit + 1] = true;
+      }
+      return is_new;
+    }
+    // Too large for the matrix; move all edges into the map.
+    size_t bits = m_bits.size();
+    for (size_t hi = 1; bit_index(hi, 0) < bits; hi++) {
+      for (size_t lo = 0; lo < hi; lo++) {
+        auto bit = bit_index(hi, lo);
+        if (m_bits[bit]) {
+          m_large.emplace(build_edge(hi, lo), !m_bits[bit + 1]);
+        }
+      }
+    }
+    m_bits.clear();
+    m_bits.shrink_to_fit();
+    m_dim = 0;
+  }
+  auto it = m_large.find(build_edge(u, v));
+  if (it != m_large.end()) {
+    it->second = it->second && can_coalesce;
+    return false;
+  }
+  m_large.emplace(build_edge(u, v), can_coalesce);
+  return true;
+}
+
 void Graph::add_edge(reg_t u, reg_t v, bool can_coalesce) {
   if (u == v) {
     return;
   }
-  if (!is_adjacent(u, v)) {
-    auto& u_node = m_nodes.at(u);
-    auto& v_node = m_nodes.at(v);
-    u_node.m_adjacent.push_back(v);
-    v_node.m_adjacent.push_back(u);
-    u_node.m_weight += edge_weight(u_node, v_node);
-    v_node.m_weight += edge_weight(v_node, u_node);
-  }
   // If we have one instruction that creates a coalesceable edge between two
   // nodes s0 and s1, and another that creates a non-coalesceable edge, those
   // edges combined must be non-coalesceable. For example, if we have
@@ -87,8 +120,14 @@ void Graph::add_edge(reg_t u, reg_t v, bool can_coalesce) {
   //
   // then the final state of the edge between s0 and s1 must be
   // non-coalesceable.
-  m_adj_matrix[build_edge(u, v)] =
-      m_adj_matrix[build_edge(u, v)] || !can_coalesce;
+  if (m_adj_matrix.add(u, v, can_coalesce)) {
+    auto& u_node = m_nodes.at(u);
+    auto& v_node = m_nodes.at(v);
+    u_node.m_adjacent.push_back(v);
+    v_node.m_adjacent.push_back(u);
+    u_node.m_weight += edge_weight(u_node, v_node);
+    v_node.m_weight += edge_weight(v_node, u_node);
+  }
 }
 
 uint32_t Node::colorable_limit() const {
@@ -88,6 +88,60 @@ inline reg_pair_t build_edge(reg_t u, reg_t v) {
   return (hi << (sizeof(reg_t) * 8)) | lo;
 }
 
+/*
+ * The set of interference edges, each with whether it may be coalesced. As
+ * in Chaitin-Briggs allocators, adjacency is tested with a triangular bit
+ * matrix, while each Node keeps a vector of its neighbors for iteration.
+ * The matrix grows as larger registers come in; as indexing it only depends
+ * on the larger of the two registers, growing it just appends. Graphs with
+ * too many registers for a matrix fall back to a hash map.
+ */
+class AdjacencyMatrix {
+ public:
+  bool contains(reg_t u, reg_t v) const {
+    if (!m_large.empty()) {
+      return m_large.count(build_edge(u, v));
+    }
+    auto bit = bit_index(u, v);
+    return bit < m_bits.size() && m_bits[bit];
+  }
+
+  // Whether a contained edge may be coalesced.
+  bool is_coalesceable(reg_t u, reg_t v) const {
+    if (!m_large.empty()) {
+      return m_large.at(build_edge(u, v));
+    }
+    return !m_bits[bit_index(u, v) + 1];
+  }
+
+  /*
+   * Adds the edge, unless it already exists. Once an edge was added as not
+   * coalesceable, it stays so. Returns whether the edge is new.
+   */
+  bool add(reg_t u, reg_t v, bool can_coalesce);
+
+ private:
+  // The largest register that is tracked in the matrix; beyond it, the
+  // matrix would take more than 8 MB.
+  static constexpr reg_t MAX_MATRIX_REG = 1 << 13;
+
+  // Each pair of registers takes two bits: whether there's an edge, and
+  // whether it is *not* coalesceable.
+  static size_t bit_index(reg_t u, reg_t v) {
+    if (u < v) {
+      std::swap(u, v);
+    }
+    return (static_cast<size_t>(u) * (u - 1) / 2 + v) * 2;
+  }
+
+  // The number of registers covered by the matrix.
+  size_t m_dim{0};
+  std::vector<bool> m_bits;
+  // Maps edges to whether they are coalesceable, once the graph got too
+  // large for the matrix.
+  std::unordered_map<reg_pair_t, bool> m_large;
+};
+
 } // namespace impl
 
 class Node {
@@ -191,11 +245,11 @@ class Graph {
   }
 
   bool is_adjacent(reg_t u, reg_t v) const {
-    return m_adj_matrix.find(impl::build_edge(u, v)) != m_adj_matrix.end();
+    return u != v && m_adj_matrix.contains(u, v);
   }
 
   bool is_coalesceable(reg_t u, reg_t v) const {
-    return !is_adjacent(u, v) || !m_adj_matrix.at(impl::build_edge(u, v));
+    return !is_adjacent(u, v) || m_adj_matrix.is_coalesceable(u, v);
   }
 
   bool has_containment_edge(reg_t u, reg_t v) const {
@@ -238,7 +292,7 @@ class Graph {
 
  private:
   std::unordered_map<reg_t, Node> m_nodes;
-  std::unordered_map<reg_pair_t, bool> m_adj_matrix;
+  impl::AdjacencyMatrix m_adj_matrix;
   std::unordered_set<reg_pair_t> m_containment_graph;
   // This map contains the LivenessDomains for all instructions which could
   // potentialy take on the /range format.
@@ -0,0 +1,332 @@
+/*
+ * Copyright (c) Facebook, Inc. and its affiliates.
+ *
+ * This source code is licensed under the MIT license found in the
+ * LICENSE file in the root directory of this source tree.
+ */
+
+#include "LinearScan.h"
+
+#include <algorithm>
+#include <limits>
+
+#include "ControlFlow.h"
+#include "DexUtil.h"
+#include "IRCode.h"
+#include "IRInstruction.h"
+#include "Liveness.h"
+#include "Show.h"
+#include "Trace.h"
+#include "Transform.h"
+
+namespace regalloc {
+
+namespace linear_scan {
+
+namespace {
+
+// Methods with at most this many registers can be allocated without range
+// instructions or spills, since most instructions address 4-bit registers.
+constexpr reg_t MAX_REGISTERS = 16;
+
+constexpr size_t MAX_INSTRUCTIONS = 256;
+
+constexpr reg_t NO_REG = std::numeric_limits<reg_t>::max();
+
+/*
+ * The live interval of a symreg. Each instruction takes two positions: its
+ * srcs are read at the first one and its dest is written at the second one,
+ * so that the dest of an instruction may reuse the vreg of a src that dies
+ * there.
+ */
+struct Interval {
+  uint32_t start{std::numeric_limits<uint32_t>::max()};
+  uint32_t end{0};
+  vreg_t max_vreg{max_unsigned_value(16)};
+  vreg_t width{1};
+  bool is_param{false};
+  // The symreg whose vreg this one would like to reuse, i.e. the src of the
+  // move or check-cast that defines it.
+  reg_t hint{NO_REG};
+
+  bool is_empty() const { return start > end; }
+
+  void extend(uint32_t pos) {
+    start = std::min(start, pos);
+    end = std::max(end, pos);
+  }
+};
+
+// A move or check-cast that is worth coalescing.
+struct Copy {
+  reg_t dest;
+  reg_t src;
+  // The position at which the dest is written.
+  uint32_t def;
+};
+
+reg_t this_register(const graph_coloring::Allocator::Config& config,
+                    const DexMethod* method) {
+  if (!config.no_overwrite_this || is_static(method)) {
+    return NO_REG;
+  }
+  auto param_insns = method->get_code()->get_param_instructions();
+  return param_insns.begin()->insn->dest();
+}
+
+} // namespace
+
+bool is_eligible(const graph_coloring::Allocator::Config& config,
+                 DexMethod* method) {
+  auto code = method->get_code();
+  if (code->get_registers_size() > MAX_REGISTERS ||
+      code->count_opcodes() > MAX_INSTRUCTIONS ||
+      init_range_set(code).size() != 0) {
+    return false;
+  }
+  // The graph coloring allocator splits the `this` register when it is
+  // overwritten; leave those methods to it.
+  auto this_reg = this_register(config, method);
+  if (this_reg != NO_REG) {
+    auto param_insns = code->get_param_instructions();
+    auto this_insn = param_insns.begin()->insn;
+    for (const auto& mie : InstructionIterable(code)) {
+      auto insn = mie.insn;
+      if (insn->has_dest() && insn->dest() == this_reg && insn != this_insn) {
+        return false;
+      }
+    }
+  }
+  return true;
+}
+
+bool allocate(const graph_coloring::Allocator::Config& config,
+              DexMethod* method,
+              graph_coloring::Allocator::Stats* stats) {
+  IRCode* code = method->get_code();
+  auto& cfg = code->cfg();
+  cfg.calculate_exit_block();
+  LivenessFixpointIterator fixpoint_iter(cfg);
+  fixpoint_iter.run(LivenessDomain());
+
+  // Build the intervals, with the same constraints as the edges and nodes of
+  // the interference graph.
+  std::vector<Interval> intervals(code->get_registers_size());
+  std::vector<Copy> moves;
+  std::vector<Copy> check_casts;
+  std::unordered_map<const IRInstruction*, uint32_t> check_cast_defs;
+  uint32_t index = 0;
+  for (cfg::Block* block : cfg.blocks()) {
+    uint32_t first_index = index;
+    for (auto it = block->begin(); it != block->end(); ++it) {
+      if (it->type != MFLOW_OPCODE) {
+        continue;
+      }
+      auto insn = it->insn;
+      auto op = insn->opcode();
+      uint32_t use = 2 * index;
+      uint32_t def = use + 1;
+      for (size_t i = 0; i < insn->srcs_size(); ++i) {
+        auto& interval = intervals.at(insn->src(i));
+        bool is_wide = insn->src_is_wide(i);
+        // A wide src must not overlap the dest of its instruction, see
+        // GraphBuilder::build.
+        interval.extend(is_wide && insn->has_dest() ? def : use);
+        interval.max_vreg = std::min(
+            interval.max_vreg, max_value_for_src(insn, i, is_wide));
+        if (is_wide) {
+          interval.width = 2;
+        }
+      }
+      if (insn->has_dest()) {
+        auto dest = insn->dest();
+        auto& interval = intervals.at(dest);
+        interval.extend(def);
+        interval.max_vreg = std::min(interval.max_vreg,
+                                     max_unsigned_value(dest_bit_width(it)));
+        if (insn->dest_is_wide()) {
+          interval.width = 2;
+        }
+        if (opcode::is_load_param(op)) {
+          interval.is_param = true;
+        } else if (is_move(op)) {
+          interval.hint = insn->src(0);
+          moves.push_back({dest, insn->src(0), def});
+        } else if (opcode::is_move_result_pseudo(op)) {
+          auto primary =
+              ir_list::primary_instruction_of_move_result_pseudo(it);
+          if (primary->opcode() == OPCODE_CHECK_CAST) {
+            // The dest of a check-cast is written before the check, so it
+            // must not clobber the registers that are live after it.
+            auto cc_def = check_cast_defs.find(primary);
+            if (cc_def == check_cast_defs.end()) {
+              return false;
+            }
+            interval.extend(cc_def->second);
+            interval.hint = primary->src(0);
+            check_casts.push_back({dest, primary->src(0), cc_def->second});
+          }
+        }
+      }
+      if (op == OPCODE_CHECK_CAST) {
+        check_cast_defs.emplace(insn, def);
+      }
+      ++index;
+    }
+    if (index == first_index) {
+      continue;
+    }
+    for (auto reg : fixpoint_iter.get_live_in_vars_at(block).elements()) {
+      intervals.at(reg).extend(2 * first_index);
+    }
+    for (auto reg : fixpoint_iter.get_live_out_vars_at(block).elements()) {
+      intervals.at(reg).extend(2 * index - 1);
+    }
+  }
+
+  auto this_reg = this_register(config, method);
+  if (this_reg != NO_REG) {
+    intervals.at(this_reg).extend(2 * index - 1);
+  }
+
+  // No allocation can use fewer vregs than the largest number of registers
+  // that are simultaneously live, or than the params.
+  vreg_t params_size{0};
+  for (const auto& interval : intervals) {
+    if (interval.is_param) {
+      params_size += interval.width;
+    }
+  }
+  auto live_size = [&](const LivenessDomain& live, reg_t dest) -> vreg_t {
+    vreg_t size = 0;
+    for (auto reg : live.elements()) {
+      if (reg != dest && reg != this_reg) {
+        size += intervals[reg].width;
+      }
+    }
+    if (dest != NO_REG && dest != this_reg) {
+      size += intervals[dest].width;
+    }
+    return this_reg == NO_REG ? size : size + intervals[this_reg].width;
+  };
+  vreg_t frame_size = params_size;
+  for (cfg::Block* block : cfg.blocks()) {
+    auto live = fixpoint_iter.get_live_out_vars_at(block);
+    for (auto it = block->rbegin(); it != block->rend(); ++it) {
+      if (it->type != MFLOW_OPCODE) {
+        continue;
+      }
+      auto insn = it->insn;
+      auto dest = insn->has_dest() ? insn->dest() : NO_REG;
+      frame_size = std::max(frame_size, live_size(live, dest));
+      fixpoint_iter.analyze_instruction(insn, &live);
+    }
+  }
+
+  // Scan the intervals by increasing start. The params come first since the
+  // load-param instructions lead the method.
+  std::vector<reg_t> order;
+  for (reg_t reg = 0; reg < intervals.size(); ++reg) {
+    if (!intervals[reg].is_empty()) {
+      order.push_back(reg);
+    }
+  }
+  std::sort(order.begin(), order.end(), [&](reg_t a, reg_t b) {
+    return intervals[a].start != intervals[b].start
+               ? intervals[a].start < intervals[b].start
+               : a < b;
+  });
+
+  transform::RegMap reg_map;
+  // For each vreg, the position from which it is free, and the symreg that
+  // took it last.
+  std::vector<uint32_t> free_at(frame_size, 0);
+  std::vector<reg_t> owner(frame_size, NO_REG);
+  // The vregs of a src that dies at the instruction which defines the
+  // interval may be reused as a whole, even if the src is wide, but must not
+  // partially overlap with it.
+  auto fits = [&](const Interval& interval, vreg_t vreg, reg_t reusable) {
+    if (vreg > interval.max_vreg || vreg + interval.width > frame_size) {
+      return false;
+    }
+    for (vreg_t i = 0; i < interval.width; ++i) {
+      auto v = vreg + i;
+      if (free_at[v] > interval.start &&
+          (reusable == NO_REG || owner[v] != reusable ||
+           intervals[reusable].end > interval.start)) {
+        return false;
+      }
+    }
+    return true;
+  };
+  vreg_t next_param_vreg = frame_size - params_size;
+  for (auto reg : order) {
+    const auto& interval = intervals[reg];
+    vreg_t vreg;
+    if (interval.is_param) {
+      vreg = next_param_vreg;
+      next_param_vreg += interval.width;
+      if (!fits(interval, vreg, NO_REG)) {
+        return false;
+      }
+    } else {
+      auto hint_it = reg_map.end();
+      if (interval.hint != NO_REG &&
+          intervals[interval.hint].width == interval.width) {
+        hint_it = reg_map.find(interval.hint);
+      }
+      if (hint_it != reg_map.end() &&
+          fits(interval, hint_it->second, interval.hint)) {
+        vreg = hint_it->second;
+      } else {
+        vreg = 0;
+        while (vreg < frame_size && !fits(interval, vreg, NO_REG)) {
+          ++vreg;
+        }
+        if (vreg == frame_size) {
+          TRACE(REG, 5, "Linear scan cannot allocate v%u of %s", reg,
+                SHOW(method));
+          return false;
+        }
+      }
+    }
+    reg_map.emplace(reg, vreg);
+    for (vreg_t i = 0; i < interval.width; ++i) {
+      free_at[vreg + i] = interval.end + 1;
+      owner[vreg + i] = reg;
+    }
+  }
+
+  // Graph coloring would coalesce the moves, and the check-casts whose src
+  // dies at the check.
+  for (const auto& move : moves) {
+    if (reg_map.at(move.dest) != reg_map.at(move.src)) {
+      TRACE(REG, 5, "Linear scan cannot coalesce v%u and v%u of %s", move.dest,
+            move.src, SHOW(method));
+      return false;
+    }
+  }
+  for (const auto& check_cast : check_casts) {
+    if (intervals[check_cast.src].end < check_cast.def &&
+        reg_map.at(check_cast.dest) != reg_map.at(check_cast.src)) {
+      return false;
+    }
+  }
+
+  transform::remap_registers(code, reg_map);
+  code->set_registers_size(frame_size);
+  auto ii = InstructionIterable(code);
+  for (auto it = ii.begin(); it != ii.end(); ++it) {
+    auto insn = it->insn;
+    if (is_move(insn->opcode()) && insn->dest() == insn->src(0)) {
+      ++stats->moves_coalesced;
+      code->remove_opcode(it.unwrap());
+    }
+  }
+  ++stats->linear_scan_allocations;
+  return true;
+}
+
+} // namespace linear_scan
+
+} // namespace regalloc
@@ -0,0 +1,49 @@
+/*
+ * Copyright (c) Facebook, Inc. and its affiliates.
+ *
+ * This source code is licensed under the MIT license found in the
+ * LICENSE file in the root directory of this source tree.
+ */
+
+#pragma once
+
+#include "GraphColoring.h"
+
+namespace regalloc {
+
+namespace linear_scan {
+
+/*
+ * Whether the method is small and simple enough for the linear scan
+ * allocator to be tried: it uses few registers and instructions, and none of
+ * its instructions needs a range encoding.
+ */
+bool is_eligible(const graph_coloring::Allocator::Config&, DexMethod*);
+
+/*
+ * A linear scan allocator [Poletto99] for the methods that need neither
+ * spilling nor range instructions, which is most of them. It avoids the
+ * build-coalesce-simplify-select loop of the graph coloring allocator.
+ *
+ * Live intervals are the hulls of the liveness of the symregs, in the order
+ * of the basic blocks, and they respect the same constraints as the edges of
+ * the interference graph. The params take the last vregs of the frame, and
+ * the dest of a move or check-cast preferably takes the vreg of its src.
+ *
+ * The result is only applied when it cannot be worse than that of graph
+ * coloring: every constraint on the vregs is met, every move is coalesced,
+ * and the frame is no larger than the number of registers that are live at
+ * the same time. Otherwise, the code is left untouched and false is
+ * returned, so that the caller can fall back to graph coloring. Requires the
+ * CFG to be built.
+ *
+ *  [Poletto99] M. Poletto and V. Sarkar. Linear Scan Register Allocation.
+ *    ACM TOPLAS 21(5), 1999.
+ */
+bool allocate(const graph_coloring::Allocator::Config&,
+              DexMethod*,
+              graph_coloring::Allocator::Stats*);
+
+} // namespace linear_scan
+
+} // namespace regalloc
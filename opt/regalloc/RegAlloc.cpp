@@ -15,6 +15,7 @@
 #include "IRAssembler.h"
 #include "IRCode.h"
 #include "IRInstruction.h"
+#include "LinearScan.h"
 #include "LiveRange.h"
 #include "Show.h"
 #include "Transform.h"
@@ -38,11 +39,22 @@ Stats RegAllocPass::allocate(
     // The transformations below all require a CFG. Build it once
     // here instead of requiring each transform to build it.
     code.build_cfg(/* editable */ false);
+    Stats linear_scan_stats;
+    if (allocator_config.use_linear_scan &&
+        linear_scan::is_eligible(allocator_config, m)) {
+      if (linear_scan::allocate(allocator_config, m, &linear_scan_stats)) {
+        TRACE(REG, 5, "After linear scan: regs:%d code:\n%s",
+              code.get_registers_size(), SHOW(&code));
+        return linear_scan_stats;
+      }
+      ++linear_scan_stats.linear_scan_fallbacks;
+    }
     graph_coloring::Allocator allocator(allocator_config);
     allocator.allocate(m);
     TRACE(REG, 5, "After alloc: regs:%d code:\n%s", code.get_registers_size(),
           SHOW(&code));
-    return allocator.get_stats();
+    linear_scan_stats += allocator.get_stats();
+    return linear_scan_stats;
   } catch (const std::exception& e) {
     std::cerr << "Failed to allocate " << SHOW(m) << ": " << e.what()
               << std::endl;
@@ -67,12 +79,14 @@ void RegAllocPass::run_pass(DexStoresVector& stores,
   graph_coloring::Allocator::Config allocator_config;
   const auto& jw = mgr.get_current_pass_info()->config;
   jw.get("live_range_splitting", false, allocator_config.use_splitting);
+  jw.get("use_linear_scan", false, allocator_config.use_linear_scan);
   allocator_config.no_overwrite_this =
       mgr.get_redex_options().no_overwrite_this();
 
   auto scope = build_class_scope(stores);
-  auto stats = walk::parallel::methods<Stats>(
-      scope, [&](DexMethod* m) { return allocate(allocator_config, m); });
+  auto stats = walk::parallel::methods_by_cost<Stats>(
+      scope, walk::parallel::code_size_cost,
+      [&](DexMethod* m) { return allocate(allocator_config, m); });
 
   TRACE(REG, 1, "Total reiteration count: %lu", stats.reiteration_count);
   TRACE(REG, 1, "Total Params spilled early: %lu", stats.params_spill_early);
@@ -83,12 +97,19 @@ void RegAllocPass::run_pass(DexStoresVector& stores,
   TRACE(REG, 1, "  Total splits: %lu", stats.split_moves);
   TRACE(REG, 1, "Total coalesce count: %lu", stats.moves_coalesced);
   TRACE(REG, 1, "Total net moves: %ld", stats.net_moves());
+  TRACE(REG, 1, "Total linear scan allocations: %lu",
+        stats.linear_scan_allocations);
+  TRACE(REG, 1, "Total linear scan fallbacks: %lu",
+        stats.linear_scan_fallbacks);
 
   mgr.incr_metric("param spilled too early", stats.params_spill_early);
   mgr.incr_metric("reiteration_count", stats.reiteration_count);
   mgr.incr_metric("spill_count", stats.moves_inserted());
   mgr.incr_metric("coalesce_count", stats.moves_coalesced);
   mgr.incr_metric("net_moves", stats.net_moves());
+  mgr.incr_metric("linear_scan_allocations", stats.linear_scan_allocations);
+  mgr.incr_metric("linear_scan_fallbacks", stats.linear_scan_fallbacks);
+  mgr.incr_metric("liveness_reuse_count", stats.liveness_reuse_count);
 
   mgr.record_running_regalloc();
 }
@@ -264,9 +264,9 @@ void remove_interface_references(
   }
   auto& parent_to_children =
       type_system.get_class_scopes().get_parent_to_children();
-  update_method_signature_type_references(scope, old_to_new,
-                                          parent_to_children);
-  update_field_type_references(scope, old_to_new);
+  BatchRefUpdater ref_updater;
+  ref_updater.add_types(old_to_new);
+  ref_updater.apply(scope, parent_to_children);
 }
 
 size_t exclude_unremovables(const Scope& scope,
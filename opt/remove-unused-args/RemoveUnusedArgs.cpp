@@ -7,7 +7,9 @@
 
 #include "RemoveUnusedArgs.h"
 
+#include <atomic>
 #include <deque>
+#include <memory>
 #include <mutex>
 #include <unordered_map>
 #include <vector>
@@ -22,6 +24,7 @@
 #include "OptData.h"
 #include "OptDataDefs.h"
 #include "Walkers.h"
+#include "WorkQueue.h"
 
 namespace mog = method_override_graph;
 
@@ -56,6 +59,11 @@ static LocalDce::Stats add_dce_stats(LocalDce::Stats a, LocalDce::Stats b) {
  * updates all affected callsites accordingly.
  */
 RemoveArgs::PassStats RemoveArgs::run() {
+  std::unique_ptr<call_site_index::CallSiteIndex> own_call_sites;
+  if (m_call_sites == nullptr) {
+    own_call_sites.reset(new call_site_index::CallSiteIndex(m_scope));
+    m_call_sites = own_call_sites.get();
+  }
   RemoveArgs::PassStats pass_stats;
   gather_results_used();
   auto method_stats = update_meths_with_unused_args_or_results();
@@ -66,6 +74,9 @@ RemoveArgs::PassStats RemoveArgs::run() {
   pass_stats.method_results_removed_count =
       method_stats.method_results_removed_count;
   pass_stats.local_dce_stats = method_stats.local_dce_stats;
+  if (own_call_sites) {
+    m_call_sites = nullptr;
+  }
   return pass_stats;
 }
 
@@ -74,28 +85,29 @@ RemoveArgs::PassStats RemoveArgs::run() {
  * move-result instructions, and record this information for each method.
  */
 void RemoveArgs::gather_results_used() {
-  walk::parallel::code(
-      m_scope, [& result_used = m_result_used](DexMethod*, IRCode& code) {
-        const auto ii = InstructionIterable(code);
-        for (auto it = ii.begin(); it != ii.end(); it++) {
-          auto insn = it->insn;
-          if (!is_invoke(insn->opcode())) {
-            continue;
-          }
-          const auto next = std::next(it);
-          always_assert(next != ii.end());
-          const auto peek = next->insn;
-          if (!opcode::is_move_result(peek->opcode())) {
-            continue;
-          }
-          auto method = insn->get_method()->as_def();
-          if (!method) {
-            // TODO: T31388603 -- Remove unused results for true virtuals.
-            continue;
-          }
-          result_used.insert(method);
-        }
-      });
+  auto wq = workqueue_foreach<DexMethodRef*>([&](DexMethodRef* callee) {
+    auto method = callee->as_def();
+    if (!method) {
+      // TODO: T31388603 -- Remove unused results for true virtuals.
+      return;
+    }
+    for (const auto& call_site : m_call_sites->get_call_sites(callee)) {
+      auto code = call_site.caller->get_code();
+      auto next = std::next(call_site.invoke);
+      while (next != code->end() && next->type != MFLOW_OPCODE) {
+        ++next;
+      }
+      always_assert(next != code->end());
+      if (opcode::is_move_result(next->insn->opcode())) {
+        m_result_used.insert(method);
+        return;
+      }
+    }
+  });
+  for (auto callee : m_call_sites->get_callees()) {
+    wq.add_item(callee);
+  }
+  wq.run_all();
 }
 
 /**
@@ -305,6 +317,7 @@ RemoveArgs::MethodStats RemoveArgs::update_meths_with_unused_args_or_results() {
             });
 
   RemoveArgs::MethodStats method_stats;
+  std::vector<DexMethod*> updated_methods;
   std::vector<DexClass*> classes;
   std::unordered_map<DexClass*, std::vector<std::pair<DexMethod*, Entry>>>
       class_entries;
@@ -317,6 +330,7 @@ RemoveArgs::MethodStats RemoveArgs::update_meths_with_unused_args_or_results() {
     }
 
     // Remember entry for further processing, and log statistics
+    updated_methods.push_back(method);
     DexClass* cls = type_class(method->get_class());
     classes.push_back(cls);
     class_entries[cls].push_back(p);
@@ -365,6 +379,8 @@ RemoveArgs::MethodStats RemoveArgs::update_meths_with_unused_args_or_results() {
       }
     }
   });
+  // The call sites in the updated methods may have been removed.
+  m_call_sites->update_callers(updated_methods);
   return method_stats;
 }
 
@@ -400,26 +416,27 @@ size_t RemoveArgs::update_callsite(IRInstruction* instr) {
  * removed.
  */
 size_t RemoveArgs::update_callsites() {
-  // Walk through all methods to look for and edit callsites.
-  return walk::parallel::methods<size_t>(
-      m_scope, [&](DexMethod* method) -> size_t {
-        auto code = method->get_code();
-        if (code == nullptr) {
-          return 0;
-        }
-        size_t callsite_args_removed = 0;
-        for (const auto& mie : InstructionIterable(code)) {
-          auto insn = mie.insn;
-          if (is_invoke(insn->opcode())) {
-            size_t insn_args_removed = update_callsite(insn);
-            if (insn_args_removed > 0) {
-              log_opt(CALLSITE_ARGS_REMOVED, method, insn);
-              callsite_args_removed += insn_args_removed;
-            }
-          }
-        }
-        return callsite_args_removed;
-      });
+  // Only the call sites of the updated methods need to be visited.
+  std::vector<DexMethod*> callees;
+  for (auto& p : m_live_arg_idxs_map) {
+    callees.push_back(p.first);
+  }
+  std::atomic<size_t> callsite_args_removed{0};
+  auto wq = workqueue_foreach<DexMethod*>([&](DexMethod* callee) {
+    for (const auto& call_site : m_call_sites->get_call_sites(callee)) {
+      auto insn = call_site.invoke->insn;
+      size_t insn_args_removed = update_callsite(insn);
+      if (insn_args_removed > 0) {
+        log_opt(CALLSITE_ARGS_REMOVED, call_site.caller, insn);
+        callsite_args_removed += insn_args_removed;
+      }
+    }
+  });
+  for (auto callee : callees) {
+    wq.add_item(callee);
+  }
+  wq.run_all();
+  return callsite_args_removed;
 }
 
 void RemoveUnusedArgsPass::run_pass(DexStoresVector& stores,
@@ -433,9 +450,10 @@ void RemoveUnusedArgsPass::run_pass(DexStoresVector& stores,
   size_t num_method_results_removed_count = 0;
   size_t num_iterations = 0;
   LocalDce::Stats local_dce_stats{0, 0};
+  call_site_index::CallSiteIndex call_sites(scope);
   while (true) {
     num_iterations++;
-    RemoveArgs rm_args(scope, m_black_list, m_total_iterations++);
+    RemoveArgs rm_args(scope, m_black_list, m_total_iterations++, &call_sites);
     auto pass_stats = rm_args.run();
     if (pass_stats.methods_updated_count == 0) {
       break;
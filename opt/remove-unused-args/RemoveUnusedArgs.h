@@ -9,6 +9,7 @@
 
 #include <mutex>
 
+#include "CallSiteIndex.h"
 #include "ConcurrentContainers.h"
 #include "LocalDce.h"
 #include "PassManager.h"
@@ -31,10 +32,19 @@ class RemoveArgs {
     LocalDce::Stats local_dce_stats{0, 0};
   };
 
+  /*
+   * The call sites of the scope are taken from the given index, which is kept
+   * up to date, so that it can be shared by the iterations of the pass.
+   * Without one, run() indexes the scope itself.
+   */
   RemoveArgs(const Scope& scope,
              const std::vector<std::string>& black_list,
-             size_t iteration = 0)
-      : m_scope(scope), m_black_list(black_list), m_iteration(iteration){};
+             size_t iteration = 0,
+             call_site_index::CallSiteIndex* call_sites = nullptr)
+      : m_scope(scope),
+        m_black_list(black_list),
+        m_iteration(iteration),
+        m_call_sites(call_sites){};
   RemoveArgs::PassStats run();
   std::deque<uint16_t> compute_live_args(
       DexMethod* method,
@@ -49,6 +59,7 @@ class RemoveArgs {
   ConcurrentSet<DexMethod*> m_result_used;
   const std::vector<std::string>& m_black_list;
   size_t m_iteration;
+  call_site_index::CallSiteIndex* m_call_sites;
 
   std::deque<DexType*> get_live_arg_type_list(
       DexMethod* method, const std::deque<uint16_t>& live_arg_idxs);
@@ -8,6 +8,7 @@
 #include "RenameClassesV2.h"
 
 #include <algorithm>
+#include <atomic>
 #include <boost/algorithm/string/predicate.hpp>
 #include <boost/regex.hpp>
 #include <map>
@@ -16,6 +17,7 @@
 #include <unordered_set>
 #include <vector>
 
+#include "ConcurrentContainers.h"
 #include "DexClass.h"
 #include "DexUtil.h"
 #include "IRInstruction.h"
@@ -24,6 +26,7 @@
 #include "TypeStringRewriter.h"
 #include "Walkers.h"
 #include "Warning.h"
+#include "WorkQueue.h"
 
 #include <locator.h>
 using facebook::Locator;
@@ -121,28 +124,38 @@ bool is_allowed_layout_class(
 std::unordered_set<std::string>
 RenameClassesPassV2::build_dont_rename_class_name_literals(Scope& scope) {
   using namespace boost::algorithm;
-  std::vector<DexString*> all_strings;
-  for (auto clazz : scope) {
-    clazz->gather_strings(all_strings);
-  }
-  sort_unique(all_strings);
-  std::unordered_set<std::string> result;
-  boost::regex external_name_regex{
+  const boost::regex external_name_regex{
       "((org)|(com)|(android(x|\\.support)))\\."
       "([a-zA-Z][a-zA-Z\\d_$]*\\.)*"
       "[a-zA-Z][a-zA-Z\\d_$]*"};
-  for (auto dex_str : all_strings) {
-    const std::string& s = dex_str->str();
-    if (!ends_with(s, ".java") && boost::regex_match(s, external_name_regex)) {
-      const std::string& internal_name = java_names::external_to_internal(s);
-      auto cls = type_class(DexType::get_type(internal_name));
-      if (cls != nullptr && !cls->is_external()) {
-        result.insert(internal_name);
-        TRACE(RENAME, 4, "Found %s in string pool before renaming", s.c_str());
+  // The strings of each class are matched in parallel. Most strings don't even
+  // start like a package name, which is checked before running the regex.
+  ConcurrentSet<std::string> concurrent_result;
+  walk::parallel::classes(scope, [&](DexClass* clazz) {
+    std::vector<DexString*> strings;
+    clazz->gather_strings(strings);
+    sort_unique(strings);
+    for (auto dex_str : strings) {
+      const std::string& s = dex_str->str();
+      if (!starts_with(s, "org.") && !starts_with(s, "com.") &&
+          !starts_with(s, "androidx.") &&
+          !starts_with(s, "android.support.")) {
+        continue;
+      }
+      if (!ends_with(s, ".java") &&
+          boost::regex_match(s, external_name_regex)) {
+        const std::string& internal_name = java_names::external_to_internal(s);
+        auto cls = type_class(DexType::get_type(internal_name));
+        if (cls != nullptr && !cls->is_external()) {
+          concurrent_result.insert(internal_name);
+          TRACE(RENAME, 4, "Found %s in string pool before renaming",
+                s.c_str());
+        }
       }
     }
-  }
-  return result;
+  });
+  return std::unordered_set<std::string>(concurrent_result.begin(),
+                                         concurrent_result.end());
 }
 
 std::unordered_set<std::string>
@@ -167,7 +180,12 @@ RenameClassesPassV2::build_dont_rename_for_types_with_reflection(
     }
   }
 
-  walk::opcodes(
+  if (refl_map.empty()) {
+    return dont_rename_class_for_types_with_reflection;
+  }
+
+  ConcurrentSet<std::string> concurrent_classnames;
+  walk::parallel::opcodes(
       scope,
       [](DexMethod*) { return true; },
       [&](DexMethod* m, IRInstruction* insn) {
@@ -180,9 +198,11 @@ RenameClassesPassV2::build_dont_rename_for_types_with_reflection(
           TRACE(RENAME, 4,
                 "Found %s with known reflection usage. marking reachable",
                 classname.c_str());
-          dont_rename_class_for_types_with_reflection.insert(classname);
+          concurrent_classnames.insert(classname);
         }
       });
+  dont_rename_class_for_types_with_reflection.insert(
+      concurrent_classnames.begin(), concurrent_classnames.end());
   return dont_rename_class_for_types_with_reflection;
 }
 
@@ -589,7 +609,7 @@ void RenameClassesPassV2::eval_classes_post(
 void RenameClassesPassV2::eval_pass(DexStoresVector& stores,
                                     ConfigFiles& conf,
                                     PassManager& mgr) {
-  auto json = conf.get_json_config();
+  const auto& json = conf.get_json_config();
   json.get("apk_dir", "", m_apk_dir);
   TRACE(RENAME, 3, "APK Dir: %s", m_apk_dir.c_str());
   auto scope = build_class_scope(stores);
@@ -716,13 +736,12 @@ void RenameClassesPassV2::rename_classes_in_layouts(
         java_names::internal_to_external(apair.first->str()),
         java_names::internal_to_external(apair.second->str()));
   }
-  ssize_t layout_bytes_delta = 0;
-  size_t num_layout_renamed = 0;
+  std::atomic<ssize_t> layout_bytes_delta{0};
+  std::atomic<size_t> num_layout_renamed{0};
   auto xml_files = get_xml_files(m_apk_dir + "/res");
-  for (const auto& path : xml_files) {
-    if (is_raw_resource(path)) {
-      continue;
-    }
+  // Each layout is rewritten in place on its own, so they can be processed
+  // in parallel.
+  auto wq = workqueue_foreach<std::string>([&](const std::string& path) {
     size_t num_renamed = 0;
     ssize_t out_delta = 0;
     TRACE(RENAME, 6, "Begin rename Views in layout %s", path.c_str());
@@ -732,10 +751,16 @@ void RenameClassesPassV2::rename_classes_in_layouts(
           num_renamed, path.c_str());
     layout_bytes_delta += out_delta;
     num_layout_renamed += num_renamed;
+  });
+  for (const auto& path : xml_files) {
+    if (!is_raw_resource(path)) {
+      wq.add_item(path);
+    }
   }
-  mgr.incr_metric("layout_bytes_delta", layout_bytes_delta);
+  wq.run_all();
+  mgr.incr_metric("layout_bytes_delta", layout_bytes_delta.load());
   TRACE(RENAME, 2, "Renamed %zu ResStringPool entries, delta %zi bytes",
-        num_layout_renamed, layout_bytes_delta);
+        num_layout_renamed.load(), layout_bytes_delta.load());
 }
 
 std::string RenameClassesPassV2::prepend_package_prefix(
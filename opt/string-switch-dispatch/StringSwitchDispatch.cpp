@@ -0,0 +1,167 @@
+/*
+ * Copyright (c) Facebook, Inc. and its affiliates.
+ *
+ * This source code is licensed under the MIT license found in the
+ * LICENSE file in the root directory of this source tree.
+ */
+
+#include "StringSwitchDispatch.h"
+
+#include <map>
+#include <vector>
+
+#include "ControlFlow.h"
+#include "DexClass.h"
+#include "IRCode.h"
+#include "IRInstruction.h"
+#include "PassManager.h"
+#include "ScopedCFG.h"
+#include "Show.h"
+#include "Trace.h"
+#include "Walkers.h"
+
+namespace {
+
+constexpr const char* METRIC_SWITCHES = "num_string_switches_split";
+constexpr const char* METRIC_BUCKETS = "num_string_switch_buckets";
+
+// The mask has to fit the literal of and-int/lit16.
+constexpr size_t MAX_BUCKET_BITS = 15;
+
+// Whether the register that the switch at the end of the block reads holds
+// the hash code of a string, computed in the same block.
+bool switches_on_hash_code(cfg::Block* block,
+                           IRInstruction* switch_insn,
+                           const DexMethodRef* hash_code) {
+  auto reg = switch_insn->src(0);
+  bool is_hash_code = false;
+  IRInstruction* prev = nullptr;
+  for (auto& mie : InstructionIterable(block)) {
+    auto insn = mie.insn;
+    if (insn == switch_insn) {
+      break;
+    }
+    if (insn->has_dest() &&
+        (insn->dest() == reg ||
+         (insn->dest_is_wide() && insn->dest() + 1 == reg))) {
+      is_hash_code = insn->opcode() == OPCODE_MOVE_RESULT && prev != nullptr &&
+                     prev->opcode() == OPCODE_INVOKE_VIRTUAL &&
+                     prev->get_method() == hash_code;
+    }
+    prev = insn;
+  }
+  return is_hash_code;
+}
+
+size_t bucket_bits(size_t cases) {
+  // About two cases in each bucket.
+  size_t bits = 1;
+  while ((size_t(1) << (bits + 1)) < cases) {
+    ++bits;
+  }
+  return bits;
+}
+
+} // namespace
+
+void StringSwitchDispatchPass::bind_config() {
+  bind("min_cases", m_config.min_cases, m_config.min_cases,
+       "Only split the switches over String.hashCode() that have at least "
+       "this many cases.");
+}
+
+StringSwitchDispatchPass::Stats StringSwitchDispatchPass::run(
+    IRCode* code, size_t min_cases) {
+  Stats stats;
+  auto hash_code = DexMethod::get_method("Ljava/lang/String;.hashCode:()I");
+  if (hash_code == nullptr) {
+    return stats;
+  }
+  cfg::ScopedCFG cfg(code);
+  std::vector<cfg::Block*> switch_blocks;
+  for (auto block : cfg->blocks()) {
+    auto last = block->get_last_insn();
+    if (last == block->end() || !is_switch(last->insn->opcode())) {
+      continue;
+    }
+    auto cases = cfg->get_succ_edges_of_type(block, cfg::EDGE_BRANCH).size();
+    if (cases >= min_cases && bucket_bits(cases) <= MAX_BUCKET_BITS &&
+        switches_on_hash_code(block, last->insn, hash_code)) {
+      switch_blocks.push_back(block);
+    }
+  }
+
+  for (auto block : switch_blocks) {
+    auto switch_insn = block->get_last_insn()->insn;
+    auto hash_reg = switch_insn->src(0);
+    auto default_block = block->goes_to();
+    auto case_edges = cfg->get_succ_edges_of_type(block, cfg::EDGE_BRANCH);
+    auto mask = (int32_t(1) << bucket_bits(case_edges.size())) - 1;
+    // Ordered, so that the new blocks don't depend on the order of the edges.
+    std::map<int32_t, std::map<int32_t, cfg::Block*>> buckets;
+    for (auto edge : case_edges) {
+      auto key = *edge->case_key();
+      buckets[key & mask].emplace(key, edge->target());
+    }
+    TRACE(SW, 3, "Splitting %s into %zu buckets", SHOW(switch_insn),
+          buckets.size());
+
+    std::vector<std::pair<int32_t, cfg::Block*>> bucket_blocks;
+    for (const auto& p : buckets) {
+      auto bucket_block = cfg->create_block();
+      const auto& cases = p.second;
+      if (cases.size() == 1) {
+        auto key_reg = cfg->allocate_temp();
+        bucket_block->push_back((new IRInstruction(OPCODE_CONST))
+                                    ->set_literal(cases.begin()->first)
+                                    ->set_dest(key_reg));
+        cfg->create_branch(bucket_block,
+                           (new IRInstruction(OPCODE_IF_EQ))
+                               ->set_src(0, hash_reg)
+                               ->set_src(1, key_reg),
+                           default_block, cases.begin()->second);
+      } else {
+        cfg->create_branch(
+            bucket_block,
+            (new IRInstruction(OPCODE_SWITCH))->set_src(0, hash_reg),
+            default_block,
+            std::vector<std::pair<int32_t, cfg::Block*>>(cases.begin(),
+                                                         cases.end()));
+      }
+      bucket_blocks.emplace_back(p.first, bucket_block);
+    }
+
+    // Also removes the edges of the cases, leaving the one to the default.
+    cfg->remove_insn(cfg->find_insn(switch_insn, block));
+    auto bucket_reg = cfg->allocate_temp();
+    block->push_back((new IRInstruction(OPCODE_AND_INT_LIT16))
+                         ->set_literal(mask)
+                         ->set_src(0, hash_reg)
+                         ->set_dest(bucket_reg));
+    cfg->create_branch(
+        block, (new IRInstruction(OPCODE_SWITCH))->set_src(0, bucket_reg),
+        nullptr, bucket_blocks);
+    stats.switches++;
+    stats.buckets += bucket_blocks.size();
+  }
+  return stats;
+}
+
+void StringSwitchDispatchPass::run_pass(DexStoresVector& stores,
+                                        ConfigFiles&,
+                                        PassManager& mgr) {
+  auto scope = build_class_scope(stores);
+  auto min_cases = m_config.min_cases;
+  auto stats =
+      walk::parallel::methods<Stats>(scope, [&](DexMethod* method) -> Stats {
+        auto code = method->get_code();
+        if (code == nullptr || method->rstate.no_optimizations()) {
+          return Stats();
+        }
+        return run(code, min_cases);
+      });
+  mgr.incr_metric(METRIC_SWITCHES, stats.switches);
+  mgr.incr_metric(METRIC_BUCKETS, stats.buckets);
+}
+
+static StringSwitchDispatchPass s_pass;
@@ -0,0 +1,68 @@
+/*
+ * Copyright (c) Facebook, Inc. and its affiliates.
+ *
+ * This source code is licensed under the MIT license found in the
+ * LICENSE file in the root directory of this source tree.
+ */
+
+#pragma once
+
+#include "Pass.h"
+
+class IRCode;
+
+/*
+ * javac and kotlinc compile a switch over strings into a sparse switch over
+ * the hash codes of the cases, whose targets then compare the strings:
+ *
+ *   invoke-virtual {v0}, Ljava/lang/String;.hashCode:()I
+ *   move-result v1
+ *   sparse-switch v1, {0x18cc9: :foo, 0x17c52: :bar, ...}
+ *
+ * A sparse switch is a binary search over its keys, which gets slow for the
+ * switches with hundreds of cases that dispatch deep links or commands. This
+ * pass buckets the keys of the large ones by their low bits, and dispatches
+ * through a dense table of buckets first:
+ *
+ *   and-int/lit16 v2, v1, 0xff
+ *   packed-switch v2, {0: :bucket0, 1: :bucket1, ...}
+ *   :bucket0
+ *   sparse-switch v1, {0x17c00: :baz, 0x18c00: :qux}
+ *
+ * Each bucket still compares the full hash code, so the targets see the same
+ * values as before, and the comparisons of the strings are left untouched.
+ */
+class StringSwitchDispatchPass : public Pass {
+ public:
+  struct Config {
+    size_t min_cases{64};
+  };
+
+  struct Stats {
+    size_t switches{0};
+    size_t buckets{0};
+
+    Stats& operator+=(const Stats& that) {
+      switches += that.switches;
+      buckets += that.buckets;
+      return *this;
+    }
+  };
+
+  StringSwitchDispatchPass() : Pass("StringSwitchDispatchPass") {}
+
+  void bind_config() override;
+
+  bool is_cfg_legal() const override { return true; }
+
+  /*
+   * Splits the switches over String.hashCode() that have at least `min_cases`
+   * cases.
+   */
+  static Stats run(IRCode* code, size_t min_cases);
+
+  void run_pass(DexStoresVector&, ConfigFiles&, PassManager&) override;
+
+ private:
+  Config m_config;
+};
@@ -0,0 +1,298 @@
+/*
+ * Copyright (c) Facebook, Inc. and its affiliates.
+ *
+ * This source code is licensed under the MIT license found in the
+ * LICENSE file in the root directory of this source tree.
+ */
+
+#include "StringBuilderPresizer.h"
+
+#include <algorithm>
+#include <unordered_map>
+#include <unordered_set>
+
+#include "DexClass.h"
+#include "IRInstruction.h"
+#include "PassManager.h"
+#include "StringBuilderOutliner.h"
+#include "TypeUtil.h"
+#include "Walkers.h"
+
+using namespace stringbuilder_outliner;
+
+namespace stringbuilder_presizer {
+
+namespace {
+
+// The capacity that StringBuilder() starts with.
+constexpr size_t DEFAULT_CAPACITY = 16;
+// Don't reserve more than this for values whose length we can only guess.
+constexpr size_t MAX_CAPACITY = 1024;
+
+// The usual length of the appended value, or its exact length if it's a
+// constant string.
+size_t estimate_length(const IRInstruction* append,
+                       const std::unordered_map<const IRInstruction*,
+                                                const DexString*>& constants) {
+  auto it = constants.find(append);
+  if (it != constants.end()) {
+    return it->second->length();
+  }
+  auto type = append->get_method()->get_proto()->get_args()->at(0);
+  switch (type::to_datatype(type)) {
+  case DataType::Boolean:
+    return 5;
+  case DataType::Char:
+    return 1;
+  case DataType::Int:
+    return 11;
+  case DataType::Long:
+    return 20;
+  default:
+    return DEFAULT_CAPACITY;
+  }
+}
+
+struct Builder {
+  const IRInstruction* init{nullptr};
+  std::vector<const BuilderState*> states;
+};
+
+} // namespace
+
+Stats presize(IRCode* code) {
+  Stats stats;
+  auto default_ctor =
+      DexMethod::get_method("Ljava/lang/StringBuilder;.<init>:()V");
+  auto tostring = DexMethod::get_method(
+      "Ljava/lang/StringBuilder;.toString:()Ljava/lang/String;");
+  auto append_string = DexMethod::get_method(
+      "Ljava/lang/StringBuilder;.append:(Ljava/lang/String;)Ljava/lang/"
+      "StringBuilder;");
+  if (default_ctor == nullptr || tostring == nullptr) {
+    return stats;
+  }
+  bool has_default_ctor = false;
+  bool has_tostring = false;
+  for (const auto& mie : InstructionIterable(code)) {
+    if (mie.insn->has_method()) {
+      has_default_ctor |= mie.insn->get_method() == default_ctor;
+      has_tostring |= mie.insn->get_method() == tostring;
+    }
+  }
+  if (!has_default_ctor || !has_tostring) {
+    return stats;
+  }
+
+  code->build_cfg(/* editable */ false); // Not editable because of T42743620
+  auto& cfg = code->cfg();
+  cfg.calculate_exit_block();
+  FixpointIterator fp_iter(cfg);
+  fp_iter.run(Environment());
+
+  // The StringBuilders, identified by their new-instance, that were created
+  // with the default constructor, and the states they reach toString() in.
+  std::unordered_map<const IRInstruction*, Builder> builders;
+  std::vector<BuilderState> states;
+  // The constant strings appended, and the block of each operation.
+  std::unordered_map<const IRInstruction*, const DexString*> constants;
+  std::unordered_map<const IRInstruction*, cfg::Block*> blocks;
+  auto get_pointer = [](const Environment& env,
+                        reg_t reg) -> const IRInstruction* {
+    const auto& pointers = env.get_pointers(reg);
+    if (!pointers.is_value() || pointers.elements().size() != 1) {
+      return nullptr;
+    }
+    return *pointers.elements().begin();
+  };
+  std::vector<std::pair<const IRInstruction*, size_t>> tostring_states;
+  for (auto* block : cfg.blocks()) {
+    auto env = fp_iter.get_entry_state_at(block);
+    std::unordered_map<reg_t, const DexString*> strings;
+    const DexString* pending_string = nullptr;
+    for (auto& mie : InstructionIterable(block)) {
+      auto* insn = mie.insn;
+      blocks.emplace(insn, block);
+      if (insn->has_method() && insn->get_method() == append_string) {
+        auto it = strings.find(insn->src(1));
+        if (it != strings.end()) {
+          constants.emplace(insn, it->second);
+        }
+      } else if (insn->has_method() && insn->get_method() == default_ctor) {
+        auto pointer = get_pointer(env, insn->src(0));
+        if (pointer != nullptr) {
+          builders[pointer].init = insn;
+        }
+      } else if (insn->opcode() == OPCODE_INVOKE_VIRTUAL &&
+                 insn->get_method() == tostring) {
+        auto pointer = get_pointer(env, insn->src(0));
+        if (pointer != nullptr) {
+          const auto& state = env.get_store().get(pointer).state();
+          if (state) {
+            states.push_back(*state);
+            tostring_states.emplace_back(pointer, states.size() - 1);
+          }
+        }
+      }
+
+      if (insn->opcode() == OPCODE_CONST_STRING) {
+        pending_string = insn->get_string();
+      } else if (insn->has_dest()) {
+        strings.erase(insn->dest());
+        if (insn->dest_is_wide()) {
+          strings.erase(insn->dest() + 1);
+        }
+        if (insn->opcode() == IOPCODE_MOVE_RESULT_PSEUDO_OBJECT &&
+            pending_string != nullptr) {
+          strings.emplace(insn->dest(), pending_string);
+        }
+        pending_string = nullptr;
+      }
+      fp_iter.analyze_instruction(insn, &env);
+    }
+  }
+  code->clear_cfg();
+  for (const auto& p : tostring_states) {
+    builders[p.first].states.push_back(&states[p.second]);
+  }
+
+  // An operation that is part of more than one state is seen by more than one
+  // toString(), some of which would see the fused string too early.
+  std::unordered_map<const IRInstruction*, size_t> state_counts;
+  for (const auto& state : states) {
+    for (auto* op : state) {
+      state_counts[op]++;
+    }
+  }
+  auto is_fusable = [&](const IRInstruction* op) {
+    return constants.count(op) && state_counts.at(op) == 1;
+  };
+
+  // The fused appends, mapped to the appends that take their place, and the
+  // strings that those append.
+  std::unordered_map<const IRInstruction*, const IRInstruction*> fused;
+  std::unordered_map<const IRInstruction*, std::string> fused_strings;
+  for (const auto& state : states) {
+    for (size_t i = 0; i < state.size();) {
+      auto first = state[i];
+      size_t j = i + 1;
+      if (is_fusable(first)) {
+        std::string str = constants.at(first)->str();
+        for (; j < state.size() && is_fusable(state[j]) &&
+               blocks.at(state[j]) == blocks.at(first);
+             ++j) {
+          str += constants.at(state[j])->str();
+          fused.emplace(state[j], first);
+        }
+        if (j > i + 1) {
+          fused_strings.emplace(first, str);
+        }
+      }
+      i = j;
+    }
+  }
+
+  // The capacities of the default constructor calls to replace.
+  std::unordered_map<const IRInstruction*, size_t> capacities;
+  for (const auto& p : builders) {
+    const auto& builder = p.second;
+    if (builder.init == nullptr || builder.states.empty()) {
+      continue;
+    }
+    size_t capacity = 0;
+    for (auto* state : builder.states) {
+      size_t length = 0;
+      for (auto* op : *state) {
+        if (op->get_method()->get_name()->str() != "append") {
+          // The builder was also initialized with a string.
+          length = 0;
+          break;
+        }
+        length += estimate_length(op, constants);
+      }
+      capacity = std::max(capacity, length);
+    }
+    if (capacity > DEFAULT_CAPACITY) {
+      capacities[builder.init] = std::min(capacity, MAX_CAPACITY);
+    }
+  }
+
+  if (fused.empty() && capacities.empty()) {
+    return stats;
+  }
+  auto capacity_ctor =
+      DexMethod::make_method("Ljava/lang/StringBuilder;.<init>:(I)V");
+  std::vector<IRList::iterator> to_remove;
+  for (auto it = code->begin(); it != code->end(); ++it) {
+    if (it->type != MFLOW_OPCODE) {
+      continue;
+    }
+    auto insn = it->insn;
+    auto capacity_it = capacities.find(insn);
+    if (capacity_it != capacities.end()) {
+      auto capacity_reg = code->allocate_temp();
+      code->insert_before(it, (new IRInstruction(OPCODE_CONST))
+                                  ->set_literal(capacity_it->second)
+                                  ->set_dest(capacity_reg));
+      code->insert_before(it, (new IRInstruction(OPCODE_INVOKE_DIRECT))
+                                  ->set_method(capacity_ctor)
+                                  ->set_srcs_size(2)
+                                  ->set_src(0, insn->src(0))
+                                  ->set_src(1, capacity_reg));
+      to_remove.push_back(it);
+      stats.presized_builders++;
+      continue;
+    }
+    auto string_it = fused_strings.find(insn);
+    if (string_it != fused_strings.end()) {
+      auto string_reg = code->allocate_temp();
+      code->insert_before(
+          it, (new IRInstruction(OPCODE_CONST_STRING))
+                  ->set_string(DexString::make_string(string_it->second)));
+      code->insert_before(it,
+                          (new IRInstruction(IOPCODE_MOVE_RESULT_PSEUDO_OBJECT))
+                              ->set_dest(string_reg));
+      insn->set_src(1, string_reg);
+      continue;
+    }
+    if (fused.count(insn)) {
+      // The builder that append() returns is the one it was called on.
+      auto next = std::next(it);
+      while (next->type != MFLOW_OPCODE) {
+        ++next;
+      }
+      if (next->insn->opcode() == OPCODE_MOVE_RESULT_OBJECT) {
+        auto move_result = next->insn;
+        next->insn = (new IRInstruction(OPCODE_MOVE_OBJECT))
+                         ->set_dest(move_result->dest())
+                         ->set_src(0, insn->src(0));
+        delete move_result;
+      }
+      to_remove.push_back(it);
+      stats.fused_appends++;
+    }
+  }
+  for (const auto& it : to_remove) {
+    code->remove_opcode(it);
+  }
+  return stats;
+}
+
+void StringBuilderPresizerPass::run_pass(DexStoresVector& stores,
+                                         ConfigFiles&,
+                                         PassManager& mgr) {
+  auto scope = build_class_scope(stores);
+  auto stats = walk::parallel::methods<Stats>(scope, [](DexMethod* method) {
+    auto code = method->get_code();
+    if (code == nullptr || method->rstate.no_optimizations()) {
+      return Stats();
+    }
+    return presize(code);
+  });
+  mgr.incr_metric("presized_builders", stats.presized_builders);
+  mgr.incr_metric("fused_appends", stats.fused_appends);
+}
+
+static StringBuilderPresizerPass s_pass;
+
+} // namespace stringbuilder_presizer
@@ -0,0 +1,65 @@
+/*
+ * Copyright (c) Facebook, Inc. and its affiliates.
+ *
+ * This source code is licensed under the MIT license found in the
+ * LICENSE file in the root directory of this source tree.
+ */
+
+#pragma once
+
+#include "IRCode.h"
+#include "Pass.h"
+
+/*
+ * This pass gives the StringBuilders whose append() calls we can see up to
+ * their toString() an initial capacity that fits what they append, so that
+ * they don't grow their buffer from the default capacity of 16 characters:
+ *
+ *   new-instance v0 StringBuilder;
+ *   invoke-direct v0 StringBuilder;.<init>:()V
+ *   const-string v1 "Loaded "
+ *   invoke-virtual {v0, v1} StringBuilder;.append:(Ljava/lang/String;)...
+ *   const-string v1 "items from "
+ *   invoke-virtual {v0, v1} StringBuilder;.append:(Ljava/lang/String;)...
+ *   invoke-virtual {v0, v2} StringBuilder;.append:(I)Ljava/lang/StringBuilder;
+ *   invoke-virtual v0 StringBuilder;.toString:()Ljava/lang/String;
+ *
+ * becomes
+ *
+ *   new-instance v0 StringBuilder;
+ *   const v3 29
+ *   invoke-direct {v0, v3} StringBuilder;.<init>:(I)V
+ *   const-string v1 "Loaded items from "
+ *   invoke-virtual {v0, v1} StringBuilder;.append:(Ljava/lang/String;)...
+ *   invoke-virtual {v0, v2} StringBuilder;.append:(I)Ljava/lang/StringBuilder;
+ *   invoke-virtual v0 StringBuilder;.toString:()Ljava/lang/String;
+ *
+ * Consecutive appends of constant strings in the same block are fused into
+ * one. The capacity counts the constant strings exactly, and estimates the
+ * length of the other values from their type.
+ *
+ * The StringBuilders are modeled by the analysis of the StringBuilderOutliner.
+ */
+namespace stringbuilder_presizer {
+
+struct Stats {
+  size_t presized_builders{0};
+  size_t fused_appends{0};
+
+  Stats& operator+=(const Stats& that) {
+    presized_builders += that.presized_builders;
+    fused_appends += that.fused_appends;
+    return *this;
+  }
+};
+
+Stats presize(IRCode* code);
+
+class StringBuilderPresizerPass : public Pass {
+ public:
+  StringBuilderPresizerPass() : Pass("StringBuilderPresizerPass") {}
+
+  void run_pass(DexStoresVector&, ConfigFiles&, PassManager&) override;
+};
+
+} // namespace stringbuilder_presizer
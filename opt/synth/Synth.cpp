@@ -30,6 +30,7 @@
 #include "Resolver.h"
 #include "SynthConfig.h"
 #include "Walkers.h"
+#include "WorkQueue.h"
 
 constexpr const char* METRIC_GETTERS_REMOVED = "getter_methods_removed_count";
 constexpr const char* METRIC_WRAPPERS_REMOVED = "wrapper_methods_removed_count";
@@ -287,75 +288,109 @@ void purge_wrapped_wrappers(WrapperMethods& ssms) {
   ssms.next_pass = ssms.next_pass || !remove.empty();
 }
 
-WrapperMethods analyze(const ClassHierarchy& ch,
-                       const std::vector<DexClass*>& classes,
-                       const SynthConfig& synthConfig) {
-  WrapperMethods ssms;
-  for (auto cls : classes) {
-    if (synthConfig.black_list_types.count(cls->get_type())) {
+// The wrappers that a class defines, in the order of its methods.
+struct ClassWrappers {
+  std::vector<std::pair<DexMethod*, DexField*>> getters;
+  std::vector<std::pair<DexMethod*, DexMethod*>> wrappers;
+  std::vector<std::pair<DexMethod*, DexMethod*>> ctors;
+};
+
+ClassWrappers analyze_class(const ClassHierarchy& ch,
+                            const DexClass* cls,
+                            const SynthConfig& synthConfig) {
+  ClassWrappers found;
+  if (synthConfig.black_list_types.count(cls->get_type())) {
+    return found;
+  }
+  for (auto dmethod : cls->get_dmethods()) {
+    if (dmethod->rstate.dont_inline()) continue;
+    // constructors are special and all we can remove are synthetic ones
+    if (synthConfig.remove_constructors && is_synthetic(dmethod) &&
+        method::is_constructor(dmethod)) {
+      auto ctor = trivial_ctor_wrapper(dmethod);
+      if (ctor) {
+        TRACE(SYNT, 2, "Trivial constructor wrapper: %s", SHOW(dmethod));
+        TRACE(SYNT, 2, "  Calls constructor: %s", SHOW(ctor));
+        found.ctors.emplace_back(dmethod, ctor);
+      }
       continue;
     }
-    for (auto dmethod : cls->get_dmethods()) {
-      if (dmethod->rstate.dont_inline()) continue;
-      // constructors are special and all we can remove are synthetic ones
-      if (synthConfig.remove_constructors && is_synthetic(dmethod) &&
-          method::is_constructor(dmethod)) {
-        auto ctor = trivial_ctor_wrapper(dmethod);
-        if (ctor) {
-          TRACE(SYNT, 2, "Trivial constructor wrapper: %s", SHOW(dmethod));
-          TRACE(SYNT, 2, "  Calls constructor: %s", SHOW(ctor));
-          ssms.ctors.emplace(dmethod, ctor);
-        }
+    if (method::is_constructor(dmethod)) continue;
+
+    if (is_static_synthetic(dmethod)) {
+      auto field = trivial_get_field_wrapper(dmethod);
+      if (field) {
+        TRACE(SYNT, 2, "Static trivial getter: %s", SHOW(dmethod));
+        TRACE(SYNT, 2, "  Gets field: %s", SHOW(field));
+        found.getters.emplace_back(dmethod, field);
         continue;
       }
-      if (method::is_constructor(dmethod)) continue;
-
-      if (is_static_synthetic(dmethod)) {
-        auto field = trivial_get_field_wrapper(dmethod);
-        if (field) {
-          TRACE(SYNT, 2, "Static trivial getter: %s", SHOW(dmethod));
-          TRACE(SYNT, 2, "  Gets field: %s", SHOW(field));
-          ssms.getters.emplace(dmethod, field);
-          continue;
-        }
-        auto sfield = trivial_get_static_field_wrapper(dmethod);
-        if (sfield) {
-          TRACE(SYNT, 2, "Static trivial static field getter: %s",
-                SHOW(dmethod));
-          TRACE(SYNT, 2, "  Gets static field: %s", SHOW(sfield));
-          ssms.getters.emplace(dmethod, sfield);
-          continue;
-        }
+      auto sfield = trivial_get_static_field_wrapper(dmethod);
+      if (sfield) {
+        TRACE(SYNT, 2, "Static trivial static field getter: %s",
+              SHOW(dmethod));
+        TRACE(SYNT, 2, "  Gets static field: %s", SHOW(sfield));
+        found.getters.emplace_back(dmethod, sfield);
+        continue;
       }
+    }
 
-      if (can_optimize(dmethod, synthConfig)) {
-        auto method = trivial_method_wrapper(dmethod, ch);
-        if (method) {
-          // this is not strictly needed but to avoid changing visibility of
-          // virtuals we are skipping a wrapper to a virtual.
-          // Incidentally we have no single method falling in that bucket
-          // at this time
-          if (method->is_virtual()) continue;
-
-          TRACE(SYNT, 2, "Static trivial method wrapper: %s", SHOW(dmethod));
-          TRACE(SYNT, 2, "  Calls method: %s", SHOW(method));
-          ssms.wrappers.emplace(dmethod, method);
-          if (!is_static(method)) {
-            auto wrapped = ssms.wrapped.find(method);
-            if (wrapped == ssms.wrapped.end()) {
-              ssms.wrapped.emplace(method, std::make_pair(dmethod, 1));
-            } else {
-              wrapped->second.second++;
-            }
-          }
-        }
+    if (can_optimize(dmethod, synthConfig)) {
+      auto method = trivial_method_wrapper(dmethod, ch);
+      if (method) {
+        // this is not strictly needed but to avoid changing visibility of
+        // virtuals we are skipping a wrapper to a virtual.
+        // Incidentally we have no single method falling in that bucket
+        // at this time
+        if (method->is_virtual()) continue;
+
+        TRACE(SYNT, 2, "Static trivial method wrapper: %s", SHOW(dmethod));
+        TRACE(SYNT, 2, "  Calls method: %s", SHOW(method));
+        found.wrappers.emplace_back(dmethod, method);
       }
     }
-    if (debug) {
-      // Static synthetics should never be virtual.
-      for (auto vmethod : cls->get_vmethods()) {
-        (void)vmethod;
-        redex_assert(!is_static_synthetic(vmethod));
+  }
+  if (debug) {
+    // Static synthetics should never be virtual.
+    for (auto vmethod : cls->get_vmethods()) {
+      (void)vmethod;
+      redex_assert(!is_static_synthetic(vmethod));
+    }
+  }
+  return found;
+}
+
+WrapperMethods analyze(const ClassHierarchy& ch,
+                       const std::vector<DexClass*>& classes,
+                       const SynthConfig& synthConfig) {
+  // Find the wrappers of each class in parallel, and then index them in the
+  // order of the classes, so that the first wrapper of a wrappee stays the
+  // same.
+  std::vector<ClassWrappers> found(classes.size());
+  auto wq = workqueue_foreach<size_t>([&](size_t i) {
+    found[i] = analyze_class(ch, classes[i], synthConfig);
+  });
+  for (size_t i = 0; i < classes.size(); ++i) {
+    wq.add_item(i);
+  }
+  wq.run_all();
+
+  WrapperMethods ssms;
+  for (const auto& cls_wrappers : found) {
+    ssms.getters.insert(cls_wrappers.getters.begin(),
+                        cls_wrappers.getters.end());
+    ssms.ctors.insert(cls_wrappers.ctors.begin(), cls_wrappers.ctors.end());
+    for (const auto& p : cls_wrappers.wrappers) {
+      auto dmethod = p.first;
+      auto method = p.second;
+      ssms.wrappers.emplace(dmethod, method);
+      if (!is_static(method)) {
+        auto wrapped = ssms.wrapped.find(method);
+        if (wrapped == ssms.wrapped.end()) {
+          ssms.wrapped.emplace(method, std::make_pair(dmethod, 1));
+        } else {
+          wrapped->second.second++;
+        }
       }
     }
   }
@@ -513,16 +548,29 @@ void replace_ctor_wrapper(IRCode* transform,
   transform->replace_opcode(ctor_insn, new_ctor_call);
 }
 
-void replace_wrappers(const ClassHierarchy& ch,
-                      DexMethod* caller_method,
-                      WrapperMethods& ssms) {
+// The calls of a method that go through wrappers.
+struct WrapperCalls {
   std::vector<std::tuple<IRInstruction*, IRInstruction*, DexField*>>
       getter_calls;
   std::vector<std::pair<IRInstruction*, DexMethod*>> wrapper_calls;
   std::vector<std::pair<IRInstruction*, DexMethod*>> wrapped_calls;
   std::vector<std::pair<IRInstruction*, DexMethod*>> ctor_calls;
+  // The callees that must be kept, as some of their calls stay.
+  std::vector<DexMethod*> keepers;
+};
 
-  TRACE(SYNT, 4, "Replacing wrappers in %s", SHOW(caller_method));
+// Finds the calls to replace in the method. It doesn't change anything, so
+// that the methods can be scanned in parallel.
+WrapperCalls find_wrapper_calls(DexMethod* caller_method,
+                                const WrapperMethods& ssms) {
+  WrapperCalls calls;
+  auto& getter_calls = calls.getter_calls;
+  auto& wrapper_calls = calls.wrapper_calls;
+  auto& wrapped_calls = calls.wrapped_calls;
+  auto& ctor_calls = calls.ctor_calls;
+  auto& keepers = calls.keepers;
+
+  TRACE(SYNT, 4, "Finding wrapper calls in %s", SHOW(caller_method));
   auto ii = InstructionIterable(caller_method->get_code());
   for (auto it = ii.begin(); it != ii.end(); ++it) {
     auto insn = it->insn;
@@ -537,7 +585,7 @@ void replace_wrappers(const ClassHierarchy& ch,
         auto next_it = std::next(it);
         auto const move_result = next_it->insn;
         if (!opcode::is_move_result(move_result->opcode())) {
-          ssms.keepers.emplace(callee);
+          keepers.push_back(callee);
           continue;
         }
         auto field = found_get->second;
@@ -555,7 +603,7 @@ void replace_wrappers(const ClassHierarchy& ch,
                         "caller: %s\ncallee: %s\ninsn: %s\n",
                         SHOW(caller_method), SHOW(callee), SHOW(insn));
 
-      ssms.keepers.emplace(callee);
+      keepers.push_back(callee);
     } else if (insn->opcode() == OPCODE_INVOKE_DIRECT) {
       auto const callee =
           resolve_method(insn->get_method(), MethodSearch::Direct);
@@ -566,7 +614,7 @@ void replace_wrappers(const ClassHierarchy& ch,
         auto next_it = std::next(it);
         auto const move_result = next_it->insn;
         if (!opcode::is_move_result(move_result->opcode())) {
-          ssms.keepers.emplace(callee);
+          keepers.push_back(callee);
           continue;
         }
         auto field = found_get->second;
@@ -596,6 +644,20 @@ void replace_wrappers(const ClassHierarchy& ch,
       }
     }
   }
+  return calls;
+}
+
+void replace_wrappers(const ClassHierarchy& ch,
+                      DexMethod* caller_method,
+                      WrapperCalls& calls,
+                      WrapperMethods& ssms) {
+  auto& getter_calls = calls.getter_calls;
+  auto& wrapper_calls = calls.wrapper_calls;
+  auto& wrapped_calls = calls.wrapped_calls;
+  auto& ctor_calls = calls.ctor_calls;
+  ssms.keepers.insert(calls.keepers.begin(), calls.keepers.end());
+
+  TRACE(SYNT, 4, "Replacing wrappers in %s", SHOW(caller_method));
   // Prune out wrappers that are invalid due to naming conflicts.
   std::unordered_set<DexMethod*> bad_wrappees;
   std::unordered_multimap<DexMethod*, DexMethod*> wrappees_to_wrappers;
@@ -774,9 +836,22 @@ void do_transform(const ClassHierarchy& ch,
       methods.emplace_back(vm);
     }
   }
-  for (auto const& m : methods) {
-    if (m->get_code()) {
-      replace_wrappers(ch, m, ssms);
+  // Scanning all the code is the expensive part, so it runs in parallel.
+  // The replacements change the wrappees, e.g. make them static, which the
+  // other replacements check, so they are done serially, in order.
+  std::vector<WrapperCalls> calls(methods.size());
+  auto wq = workqueue_foreach<size_t>([&](size_t i) {
+    if (methods[i]->get_code()) {
+      calls[i] = find_wrapper_calls(methods[i], ssms);
+    }
+  });
+  for (size_t i = 0; i < methods.size(); ++i) {
+    wq.add_item(i);
+  }
+  wq.run_all();
+  for (size_t i = 0; i < methods.size(); ++i) {
+    if (methods[i]->get_code()) {
+      replace_wrappers(ch, methods[i], calls[i], ssms);
     }
   }
   // check that invokes to promoted static method is correct
@@ -0,0 +1,262 @@
+/*
+ * Copyright (c) Facebook, Inc. and its affiliates.
+ *
+ * This source code is licensed under the MIT license found in the
+ * LICENSE file in the root directory of this source tree.
+ */
+
+#include "ThrowOutliner.h"
+
+#include <algorithm>
+#include <boost/optional.hpp>
+
+#include "ConcurrentContainers.h"
+#include "ControlFlow.h"
+#include "Creators.h"
+#include "DexAsm.h"
+#include "DexUtil.h"
+#include "IRCode.h"
+#include "PassManager.h"
+#include "Resolver.h"
+#include "ScopedCFG.h"
+#include "Show.h"
+#include "Trace.h"
+#include "Walkers.h"
+
+namespace {
+
+constexpr const char* METRIC_THROWS_OUTLINED = "num_throws_outlined";
+constexpr const char* METRIC_HELPER_METHODS_CREATED =
+    "num_helper_methods_created";
+
+struct ThrowSite {
+  IRInstruction* new_instance;
+  IRInstruction* init;
+};
+
+bool can_call_from_helper(DexMethodRef* constructor) {
+  auto cls = type_class(constructor->get_class());
+  if (cls == nullptr || !cls->is_external() || !is_public(cls) ||
+      is_abstract(cls) || is_interface(cls)) {
+    return false;
+  }
+  auto method = resolve_method(constructor, MethodSearch::Direct);
+  return method != nullptr && is_public(method);
+}
+
+bool touches(const IRInstruction* insn, reg_t reg) {
+  if (insn->has_dest() &&
+      (insn->dest() == reg ||
+       (insn->dest_is_wide() && insn->dest() + 1 == reg))) {
+    return true;
+  }
+  for (size_t i = 0; i < insn->srcs_size(); ++i) {
+    if (insn->src(i) == reg ||
+        (insn->src_is_wide(i) && insn->src(i) + 1 == reg)) {
+      return true;
+    }
+  }
+  return false;
+}
+
+/*
+ * Matches a block that ends with
+ *
+ *   new-instance <type>
+ *   move-result-pseudo-object v0
+ *   ... (nothing that touches v0)
+ *   invoke-direct {v0, ...} <type>.<init>
+ *   throw v0
+ *
+ * Outside of try regions, so that no handler sees the exception or the
+ * registers before it is thrown.
+ */
+boost::optional<ThrowSite> match_throw_site(const cfg::ControlFlowGraph& cfg,
+                                            cfg::Block* block) {
+  if (cfg.get_succ_edge_of_type(block, cfg::EDGE_THROW) != nullptr) {
+    return boost::none;
+  }
+  std::vector<IRInstruction*> insns;
+  for (auto& mie : InstructionIterable(block)) {
+    insns.push_back(mie.insn);
+  }
+  if (insns.size() < 4 || insns.back()->opcode() != OPCODE_THROW) {
+    return boost::none;
+  }
+  auto thrown = insns.back()->src(0);
+  auto init = insns[insns.size() - 2];
+  if (init->opcode() != OPCODE_INVOKE_DIRECT ||
+      !method::is_init(init->get_method()) || init->src(0) != thrown) {
+    return boost::none;
+  }
+  for (size_t i = 1; i < init->srcs_size(); ++i) {
+    if (init->src(i) == thrown) {
+      return boost::none;
+    }
+  }
+  for (size_t i = insns.size() - 2; i-- > 1;) {
+    auto insn = insns[i];
+    if (insn->opcode() == IOPCODE_MOVE_RESULT_PSEUDO_OBJECT &&
+        insn->dest() == thrown) {
+      auto new_instance = insns[i - 1];
+      if (new_instance->opcode() != OPCODE_NEW_INSTANCE ||
+          new_instance->get_type() != init->get_method()->get_class()) {
+        return boost::none;
+      }
+      return ThrowSite{new_instance, init};
+    }
+    if (touches(insn, thrown)) {
+      return boost::none;
+    }
+  }
+  return boost::none;
+}
+
+} // namespace
+
+void ThrowOutlinerPass::bind_config() {
+  bind("min_outline_count", m_config.min_outline_count,
+       m_config.min_outline_count,
+       "Only outline the constructions of the exceptions that are thrown from "
+       "at least this many places.");
+}
+
+std::vector<DexMethodRef*> ThrowOutlinerPass::find_outlinable_throws(
+    IRCode* code) {
+  std::vector<DexMethodRef*> constructors;
+  cfg::ScopedCFG cfg(code);
+  for (auto block : cfg->blocks()) {
+    auto site = match_throw_site(*cfg, block);
+    if (site && can_call_from_helper(site->init->get_method())) {
+      constructors.push_back(site->init->get_method());
+    }
+  }
+  return constructors;
+}
+
+/*
+ * Given the constructor Foo.<init>(String, int), generates the equivalent of
+ *
+ *   static Foo create(String a, int b) {
+ *     return new Foo(a, b);
+ *   }
+ */
+DexMethod* ThrowOutlinerPass::create_helper(DexType* helper_type,
+                                            DexMethodRef* constructor) {
+  using namespace dex_asm;
+
+  auto type = constructor->get_class();
+  auto args = constructor->get_proto()->get_args();
+  auto helper =
+      DexMethod::make_method(helper_type, DexString::make_string("create"),
+                             DexProto::make_proto(type, args))
+          ->make_concrete(ACC_PUBLIC | ACC_STATIC, false);
+  auto code = std::make_unique<IRCode>(helper, 1);
+  code->push_back(dasm(OPCODE_NEW_INSTANCE, type));
+  code->push_back(dasm(IOPCODE_MOVE_RESULT_PSEUDO_OBJECT, {0_v}));
+  auto init = (new IRInstruction(OPCODE_INVOKE_DIRECT))
+                  ->set_method(constructor)
+                  ->set_srcs_size(args->size() + 1)
+                  ->set_src(0, 0);
+  size_t i = 1;
+  for (auto& mie : InstructionIterable(code->get_param_instructions())) {
+    init->set_src(i++, mie.insn->dest());
+  }
+  code->push_back(init);
+  code->push_back(dasm(OPCODE_RETURN_OBJECT, {0_v}));
+  helper->set_code(std::move(code));
+  helper->set_deobfuscated_name(show(helper));
+  // Inlining it would undo the outlining.
+  helper->rstate.set_dont_inline();
+  return helper;
+}
+
+size_t ThrowOutlinerPass::outline_throws(
+    const std::unordered_map<const DexMethodRef*, DexMethod*>& helpers,
+    IRCode* code) {
+  cfg::ScopedCFG cfg(code);
+  std::vector<std::pair<cfg::Block*, ThrowSite>> sites;
+  for (auto block : cfg->blocks()) {
+    auto site = match_throw_site(*cfg, block);
+    if (site && helpers.count(site->init->get_method())) {
+      sites.emplace_back(block, *site);
+    }
+  }
+  for (const auto& p : sites) {
+    auto block = p.first;
+    auto init = p.second.init;
+    auto helper = helpers.at(init->get_method());
+    TRACE(OUTLINE, 4, "outlining %s", SHOW(init));
+    auto invoke = (new IRInstruction(OPCODE_INVOKE_STATIC))
+                      ->set_method(helper)
+                      ->set_srcs_size(init->srcs_size() - 1);
+    for (size_t i = 1; i < init->srcs_size(); ++i) {
+      invoke->set_src(i - 1, init->src(i));
+    }
+    auto move_result =
+        (new IRInstruction(OPCODE_MOVE_RESULT_OBJECT))->set_dest(init->src(0));
+    // Also removes the move-result-pseudo.
+    cfg->remove_insn(cfg->find_insn(p.second.new_instance, block));
+    cfg->replace_insns(cfg->find_insn(init, block), {invoke, move_result});
+  }
+  return sites.size();
+}
+
+void ThrowOutlinerPass::run_pass(DexStoresVector& stores,
+                                 ConfigFiles&,
+                                 PassManager& mgr) {
+  auto helper_type = DexType::make_type("Lcom/redex/OutlinedThrows;");
+  if (type_class(helper_type) != nullptr) {
+    TRACE(OUTLINE, 1, "%s already exists", SHOW(helper_type));
+    return;
+  }
+  auto scope = build_class_scope(stores);
+  ConcurrentMap<DexMethodRef*, size_t> counts;
+  walk::parallel::code(scope, [&](DexMethod* method, IRCode& code) {
+    if (method->rstate.no_optimizations() || method->rstate.outlined()) {
+      return;
+    }
+    for (auto constructor : find_outlinable_throws(&code)) {
+      counts.update(constructor,
+                    [](DexMethodRef*, size_t& n, bool /* exists */) { ++n; });
+    }
+  });
+
+  std::vector<DexMethodRef*> constructors;
+  for (const auto& p : counts) {
+    if (p.second >= m_config.min_outline_count) {
+      constructors.push_back(p.first);
+    }
+  }
+  std::sort(constructors.begin(), constructors.end(), compare_dexmethods);
+  Stats stats;
+  if (!constructors.empty()) {
+    ClassCreator cc(helper_type);
+    cc.set_super(type::java_lang_Object());
+    cc.set_access(ACC_PUBLIC | ACC_FINAL);
+    std::unordered_map<const DexMethodRef*, DexMethod*> helpers;
+    for (auto constructor : constructors) {
+      auto helper = create_helper(helper_type, constructor);
+      cc.add_method(helper);
+      helpers.emplace(constructor, helper);
+    }
+    auto helper_cls = cc.create();
+    helper_cls->rstate.set_generated();
+    stats.helper_methods_created = helpers.size();
+    stats.throws_outlined = walk::parallel::methods<size_t>(
+        scope, [&](DexMethod* method) -> size_t {
+          auto code = method->get_code();
+          if (code == nullptr || method->rstate.no_optimizations() ||
+              method->rstate.outlined()) {
+            return 0;
+          }
+          return outline_throws(helpers, code);
+        });
+    stores[0].get_dexen()[0].push_back(helper_cls);
+  }
+  mgr.incr_metric(METRIC_THROWS_OUTLINED, stats.throws_outlined);
+  mgr.incr_metric(METRIC_HELPER_METHODS_CREATED,
+                  stats.helper_methods_created);
+}
+
+static ThrowOutlinerPass s_pass;
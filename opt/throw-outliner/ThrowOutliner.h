@@ -0,0 +1,83 @@
+/*
+ * Copyright (c) Facebook, Inc. and its affiliates.
+ *
+ * This source code is licensed under the MIT license found in the
+ * LICENSE file in the root directory of this source tree.
+ */
+
+#pragma once
+
+#include <unordered_map>
+#include <vector>
+
+#include "DexClass.h"
+#include "Pass.h"
+
+/*
+ * This pass moves the construction of the exceptions that are thrown right
+ * after they are constructed into shared helpers, so that the cold paths that
+ * check preconditions take less room in the methods that contain them:
+ *
+ *   new-instance v0, Ljava/lang/IllegalStateException;
+ *   const-string v1, "not started"
+ *   invoke-direct {v0, v1}, Ljava/lang/IllegalStateException;.<init>:
+ *       (Ljava/lang/String;)V
+ *   throw v0
+ *
+ * becomes
+ *
+ *   const-string v1, "not started"
+ *   invoke-static {v1}, Lcom/redex/OutlinedThrows;.create:
+ *       (Ljava/lang/String;)Ljava/lang/IllegalStateException;
+ *   move-result-object v0
+ *   throw v0
+ *
+ * The throw itself stays, so that the verifiers still see the end of the
+ * block. The message is still built in the method that throws, as it differs
+ * between the throw sites. Only the exceptions of the framework are handled,
+ * so that the helpers can go into the primary dex without referencing types
+ * of other stores.
+ */
+class ThrowOutlinerPass : public Pass {
+ public:
+  struct Config {
+    size_t min_outline_count{10};
+  };
+
+  struct Stats {
+    size_t throws_outlined{0};
+    size_t helper_methods_created{0};
+  };
+
+  ThrowOutlinerPass() : Pass("ThrowOutlinerPass") {}
+
+  void bind_config() override;
+
+  bool is_cfg_legal() const override { return true; }
+
+  /*
+   * The constructors of the exceptions that the code constructs and then
+   * throws right away, one for each throw site that can be outlined.
+   */
+  static std::vector<DexMethodRef*> find_outlinable_throws(IRCode* code);
+
+  /*
+   * Creates the helper that constructs the exceptions that the constructor
+   * initializes.
+   */
+  static DexMethod* create_helper(DexType* helper_type,
+                                  DexMethodRef* constructor);
+
+  /*
+   * Replaces the constructions of the exceptions whose constructor has a
+   * helper by calls to it. Returns the number of throws outlined.
+   */
+  static size_t outline_throws(
+      const std::unordered_map<const DexMethodRef*, DexMethod*>& helpers,
+      IRCode* code);
+
+  void run_pass(DexStoresVector&, ConfigFiles&, PassManager&) override;
+
+ private:
+  Config m_config;
+};
@@ -342,12 +342,6 @@ void ThrowPropagationPass::run_pass(DexStoresVector& stores,
     stats += last_stats;
   }
 
-  walk::parallel::code(scope, [&](const DexMethod* method, IRCode& code) {
-    if (!method->rstate.no_optimizations()) {
-      code.clear_cfg();
-    }
-  });
-
   mgr.incr_metric(METRIC_THROWS_INSERTED, stats.throws_inserted);
   mgr.incr_metric(METRIC_UNREACHABLE_INSTRUCTIONS,
                   stats.unreachable_instruction_count);
@@ -33,6 +33,8 @@ class ThrowPropagationPass : public Pass {
 
   void bind_config() override;
 
+  bool is_cfg_legal() const override { return true; }
+
   static std::unordered_set<DexMethod*> get_no_return_methods(
       const Config& config, const Scope& scope);
 
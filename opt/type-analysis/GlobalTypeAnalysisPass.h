@@ -20,6 +20,7 @@ class GlobalTypeAnalysisPass : public Pass {
  public:
   struct Config {
     size_t max_global_analysis_iteration{10};
+    bool compact_analysis_states{true};
     bool insert_runtime_asserts{false};
     type_analyzer::Transform::Config transform;
     type_analyzer::RuntimeAssertTransform::Config runtime_assert;
@@ -50,7 +51,14 @@ class GlobalTypeAnalysisPass : public Pass {
     bind("max_global_analysis_iteration", size_t(100),
          m_config.max_global_analysis_iteration,
          "Maximum number of global iterations the analysis runs");
+    bind("compact_analysis_states", true, m_config.compact_analysis_states,
+         "Only keep the entry states of the methods once the global analysis "
+         "is done, and recompute the local analyses from them on demand");
     bind("insert_runtime_asserts", false, m_config.insert_runtime_asserts);
+    bind("remove_redundant_null_branches", true,
+         m_config.transform.remove_redundant_null_branches,
+         "Remove the if-eqz and if-nez branches on values whose nullness is "
+         "known");
     trait(Traits::Pass::unique, true);
   }
 
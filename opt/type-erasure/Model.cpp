@@ -21,6 +21,7 @@
 #include "IRCode.h"
 #include "Resolver.h"
 #include "Walkers.h"
+#include "WorkQueue.h"
 
 size_t Model::s_shape_count = 0;
 size_t Model::s_num_interdex_groups = 0;
@@ -694,10 +695,24 @@ void Model::shape_model() {
     mergers.emplace_back(&m_mergers[type]);
   }
 
-  for (auto merger : mergers) {
+  // The shapes of the mergers are independent of each other, so they are
+  // collected in parallel. The rest is done in order, as it names and creates
+  // the new mergers.
+  std::vector<MergerType::ShapeCollector> merger_shapes(mergers.size());
+  std::vector<TypeSet> merger_excluded(mergers.size());
+  auto wq = workqueue_foreach<size_t>([&](size_t i) {
+    shape_merger(*mergers[i], merger_shapes[i], merger_excluded[i]);
+  });
+  for (size_t i = 0; i < mergers.size(); i++) {
+    wq.add_item(i);
+  }
+  wq.run_all();
+
+  for (size_t i = 0; i < mergers.size(); i++) {
+    auto merger = mergers[i];
     TRACE(TERA, 6, "Build shapes from %s", SHOW(merger->type));
-    MergerType::ShapeCollector shapes;
-    shape_merger(*merger, shapes);
+    auto& shapes = merger_shapes[i];
+    m_excluded.insert(merger_excluded[i].begin(), merger_excluded[i].end());
     approximate_shapes(shapes);
     m_metric.dropped += trim_shapes(shapes, m_spec.min_count);
     for (auto& shape_it : shapes) {
@@ -713,7 +728,8 @@ void Model::shape_model() {
 }
 
 void Model::shape_merger(const MergerType& merger,
-                         MergerType::ShapeCollector& shapes) {
+                         MergerType::ShapeCollector& shapes,
+                         TypeSet& excluded) const {
   // if the root has got no children there is nothing to "shape"
   const auto& children = m_hierarchy.find(merger.type);
   if (children == m_hierarchy.end()) {
@@ -726,7 +742,7 @@ void Model::shape_merger(const MergerType& merger,
       continue;
     }
     if (is_excluded(child)) {
-      m_excluded.insert(child);
+      excluded.insert(child);
       continue;
     }
     if (m_non_mergeables.count(child)) {
@@ -884,14 +900,14 @@ DexType* check_current_instance(const TypeSet& types, IRInstruction* insn) {
   return type;
 }
 
-ConcurrentMap<DexType*, std::unordered_set<DexType*>> get_type_usages(
+ConcurrentMap<const DexType*, std::unordered_set<DexType*>> get_type_usages(
     const TypeSet& types, const Scope& scope) {
-  ConcurrentMap<DexType*, std::unordered_set<DexType*>> res;
+  ConcurrentMap<const DexType*, std::unordered_set<DexType*>> res;
 
   walk::parallel::opcodes(scope, [&](DexMethod* method, IRInstruction* insn) {
     auto cls = method->get_class();
     const auto& updater =
-        [&cls](DexType* /* key */, std::unordered_set<DexType*>& set,
+        [&cls](const DexType* /* key */, std::unordered_set<DexType*>& set,
                bool /* already_exists */) { set.emplace(cls); };
 
     auto current_instance = check_current_instance(types, insn);
@@ -940,12 +956,21 @@ size_t get_interdex_group(
 } // namespace
 
 std::vector<TypeSet> Model::group_per_interdex_set(const TypeSet& types) {
-  const auto& type_to_usages = get_type_usages(types, m_scope);
+  // The usages of all the types of the model are collected in a single walk
+  // over the scope, instead of one walk per group.
+  if (!m_type_usages) {
+    m_type_usages = std::make_shared<TypeUsages>(
+        get_type_usages(m_types, m_scope));
+  }
   std::vector<TypeSet> new_groups(s_num_interdex_groups);
-  for (const auto& pair : type_to_usages) {
-    auto index = get_interdex_group(pair.second, s_cls_to_interdex_group,
+  for (const auto& type : types) {
+    auto it = m_type_usages->find(type);
+    if (it == m_type_usages->end()) {
+      continue;
+    }
+    auto index = get_interdex_group(it->second, s_cls_to_interdex_group,
                                     s_num_interdex_groups);
-    new_groups[index].emplace(pair.first);
+    new_groups[index].emplace(type);
   }
 
   if (m_spec.merge_per_interdex_set == InterDexGroupingType::NON_HOT_SET) {
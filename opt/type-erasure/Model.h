@@ -8,8 +8,10 @@
 #pragma once
 
 #include <boost/optional.hpp>
+#include <memory>
 
 #include "ApproximateShapeMerging.h"
+#include "ConcurrentContainers.h"
 #include "DexClass.h"
 #include "MergerType.h"
 #include "TypeSystem.h"
@@ -331,6 +333,12 @@ class Model {
 
   const Scope& m_scope;
 
+  // The classes that use each type of the model, computed on demand when
+  // grouping the mergeables per interdex set.
+  using TypeUsages =
+      ConcurrentMap<const DexType*, std::unordered_set<DexType*>>;
+  std::shared_ptr<const TypeUsages> m_type_usages;
+
   static std::unordered_map<DexType*, size_t> s_cls_to_interdex_group;
   static size_t s_num_interdex_groups;
 
@@ -388,7 +396,9 @@ class Model {
 
   // make shapes out of the model classes
   void shape_model();
-  void shape_merger(const MergerType& root, MergerType::ShapeCollector& shapes);
+  void shape_merger(const MergerType& root,
+                    MergerType::ShapeCollector& shapes,
+                    TypeSet& excluded) const;
   void approximate_shapes(MergerType::ShapeCollector& shapes);
   void break_by_interface(const MergerType& merger,
                           const MergerType::Shape& shape,
@@ -348,13 +348,13 @@ void update_refs_to_mergeable_types(
     bool has_type_tags) {
   // Update simple type referencing instructions to instantiate merger type.
   update_code_type_refs(scope, mergeable_to_merger);
-  type_reference::update_method_signature_type_references(
+  type_reference::BatchRefUpdater ref_updater;
+  ref_updater.add_types(mergeable_to_merger);
+  ref_updater.apply(
       scope,
-      mergeable_to_merger,
       parent_to_children,
       boost::optional<std::unordered_map<DexMethod*, std::string>&>(
           method_debug_map));
-  type_reference::update_field_type_references(scope, mergeable_to_merger);
   // Fix INSTANCE_OF
   if (!has_type_tags) {
     always_assert(type_tag_fields.empty());
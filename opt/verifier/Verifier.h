@@ -13,5 +13,7 @@ class VerifierPass : public Pass {
  public:
   VerifierPass() : Pass("VerifierPass") {}
 
+  bool is_read_only() const override { return true; }
+
   void run_pass(DexStoresVector&, ConfigFiles&, PassManager&) override;
 };
@@ -50,6 +50,7 @@
 #include "Resolver.h"
 #include "TypeSystem.h"
 #include "Walkers.h"
+#include "WorkQueue.h"
 
 namespace {
 
@@ -137,11 +138,28 @@ void VirtualMerging::find_unsupported_virtual_scopes() {
   }
 }
 
+namespace {
+
+using ScopeMethods =
+    std::vector<std::pair<const VirtualScope*, const DexMethod*>>;
+
+struct AppendScopeMethods {
+  void operator()(const ScopeMethods& addend, ScopeMethods* accumulator) const {
+    accumulator->insert(accumulator->end(), addend.begin(), addend.end());
+  }
+};
+
+} // namespace
+
 // Part 2: Identify all overriding virtual methods which might potentially be
 //         mergeable into other overridden virtual methods.
 //         Group these methods by virtual scopes.
 void VirtualMerging::compute_mergeable_scope_methods() {
-  walk::parallel::methods(m_scope, [&](const DexMethod* overriding_method) {
+  // Each thread collects its candidates in its own list; they are grouped by
+  // virtual scope once all methods have been visited.
+  auto scope_methods = walk::parallel::methods<ScopeMethods,
+                                               AppendScopeMethods>(
+      m_scope, [&](DexMethod* overriding_method, ScopeMethods* acc) {
     if (!overriding_method->is_virtual() || !overriding_method->is_concrete() ||
         is_native(overriding_method) || is_abstract(overriding_method)) {
       return;
@@ -177,12 +195,11 @@ void VirtualMerging::compute_mergeable_scope_methods() {
       return;
     }
 
-    m_mergeable_scope_methods.update(
-        virtual_scope,
-        [&](const VirtualScope*,
-            std::unordered_set<const DexMethod*>& s,
-            bool /* exists */) { s.emplace(overriding_method); });
+    acc->emplace_back(virtual_scope, overriding_method);
   });
+  for (const auto& p : scope_methods) {
+    m_mergeable_scope_methods[p.first].emplace(p.second);
+  }
 
   m_stats.mergeable_scope_methods = m_mergeable_scope_methods.size();
   for (auto& p : m_mergeable_scope_methods) {
@@ -425,51 +442,50 @@ class MergePairsBuilder {
 //         way that it can be later processed sequentially.
 void VirtualMerging::compute_mergeable_pairs_by_virtual_scopes(
     const method_profiles::MethodProfiles& profiles) {
-  ConcurrentMap<const VirtualScope*, LocalStats> local_stats;
   std::vector<const VirtualScope*> virtual_scopes;
   for (auto& p : m_mergeable_scope_methods) {
     virtual_scopes.push_back(p.first);
   }
-  ConcurrentMap<const VirtualScope*,
-                std::vector<std::pair<const DexMethod*, const DexMethod*>>>
-      mergeable_pairs_by_virtual_scopes;
-  walk::parallel::virtual_scopes(
-      virtual_scopes, [&](const VirtualScope* virtual_scope) {
-        MergePairsBuilder mpb(virtual_scope);
-        auto res = mpb.build(m_mergeable_scope_methods.at(virtual_scope),
-                             m_xstores, m_xdexes, profiles);
-        if (!res) {
-          return;
-        }
-        local_stats.emplace(virtual_scope, res->first);
-        if (!res->second.empty()) {
-          mergeable_pairs_by_virtual_scopes.emplace(virtual_scope,
-                                                    std::move(res->second));
-        }
-      });
-
-  m_stats.virtual_scopes_with_mergeable_pairs +=
-      mergeable_pairs_by_virtual_scopes.size();
+  // Every virtual scope writes its result into its own slot, so no lock is
+  // needed.
+  using Result = std::pair<LocalStats, MergePairsBuilder::PairSeq>;
+  std::vector<boost::optional<Result>> results(virtual_scopes.size());
+  auto wq = workqueue_foreach<size_t>([&](size_t i) {
+    auto virtual_scope = virtual_scopes[i];
+    MergePairsBuilder mpb(virtual_scope);
+    results[i] = mpb.build(m_mergeable_scope_methods.at(virtual_scope),
+                           m_xstores, m_xdexes, profiles);
+  });
+  for (size_t i = 0; i < virtual_scopes.size(); i++) {
+    wq.add_item(i);
+  }
+  wq.run_all();
 
   size_t overriding_methods = 0;
-  for (auto& p : local_stats) {
-    overriding_methods += p.second.overriding_methods;
-    m_stats.cross_store_refs += p.second.cross_store_refs;
-    m_stats.cross_dex_refs += p.second.cross_dex_refs;
+  for (size_t i = 0; i < virtual_scopes.size(); i++) {
+    auto& res = results[i];
+    if (!res) {
+      continue;
+    }
+    const auto& local_stats = res->first;
+    overriding_methods += local_stats.overriding_methods;
+    m_stats.cross_store_refs += local_stats.cross_store_refs;
+    m_stats.cross_dex_refs += local_stats.cross_dex_refs;
     m_stats.inconcrete_overridden_methods +=
-        p.second.inconcrete_overridden_methods;
+        local_stats.inconcrete_overridden_methods;
+    auto& mergeable_pairs = res->second;
+    if (mergeable_pairs.empty()) {
+      continue;
+    }
+    m_stats.virtual_scopes_with_mergeable_pairs++;
+    m_stats.mergeable_pairs += mergeable_pairs.size();
+    m_mergeable_pairs_by_virtual_scopes.emplace(virtual_scopes[i],
+                                                std::move(mergeable_pairs));
   }
 
   always_assert(overriding_methods <= m_stats.mergeable_virtual_methods);
   m_stats.annotated_methods =
       m_stats.mergeable_virtual_methods - overriding_methods;
-  for (auto& p : mergeable_pairs_by_virtual_scopes) {
-    const auto& mergeable_pairs = p.second;
-    m_stats.mergeable_pairs += mergeable_pairs.size();
-    m_mergeable_pairs_by_virtual_scopes.insert(p);
-  }
-  always_assert(mergeable_pairs_by_virtual_scopes.size() ==
-                m_mergeable_pairs_by_virtual_scopes.size());
   always_assert(m_stats.mergeable_pairs ==
                 m_stats.mergeable_virtual_methods - m_stats.annotated_methods -
                     m_stats.cross_store_refs - m_stats.cross_dex_refs -
@@ -55,7 +55,7 @@ class VirtualMerging {
       m_unsupported_named_protos;
 
   void compute_mergeable_scope_methods();
-  ConcurrentMap<const VirtualScope*, std::unordered_set<const DexMethod*>>
+  std::unordered_map<const VirtualScope*, std::unordered_set<const DexMethod*>>
       m_mergeable_scope_methods;
 
   void compute_mergeable_pairs_by_virtual_scopes(
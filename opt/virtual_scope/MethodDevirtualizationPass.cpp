@@ -8,6 +8,8 @@
 #include "MethodDevirtualizationPass.h"
 #include "DexUtil.h"
 #include "MethodDevirtualizer.h"
+#include "SpeculativeDevirtualization.h"
+#include "Walkers.h"
 
 void MethodDevirtualizationPass::run_pass(DexStoresVector& stores,
                                           ConfigFiles&,
@@ -26,6 +28,28 @@ void MethodDevirtualizationPass::run_pass(DexStoresVector& stores,
   manager.incr_metric("num_virtual_calls_converted", metrics.num_virtual_calls);
   manager.incr_metric("num_direct_calls_converted", metrics.num_direct_calls);
   manager.incr_metric("num_super_calls_converted", metrics.num_super_calls);
+
+  if (m_speculative_receivers_file.empty()) {
+    return;
+  }
+  namespace sd = speculative_devirtualization;
+  sd::LikelyReceivers likely_receivers;
+  always_assert_log(
+      sd::read_likely_receivers(m_speculative_receivers_file,
+                                m_speculative_min_percent, &likely_receivers),
+      "Cannot load the receiver profile %s",
+      m_speculative_receivers_file.c_str());
+  const auto stats =
+      walk::parallel::methods<sd::Stats>(scope, [&](DexMethod* method) {
+        auto code = method->get_code();
+        auto it = likely_receivers.find(method);
+        if (code == nullptr || it == likely_receivers.end()) {
+          return sd::Stats{};
+        }
+        return sd::guard_calls(it->second, code);
+      });
+  manager.incr_metric("num_speculatively_guarded_calls", stats.guarded_calls);
+  manager.incr_metric("num_speculative_calls_skipped", stats.skipped_calls);
 }
 
 static MethodDevirtualizationPass s_pass;
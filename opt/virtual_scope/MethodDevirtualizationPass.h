@@ -27,6 +27,12 @@ class MethodDevirtualizationPass : public Pass {
          false,
          m_staticize_dmethods_using_this);
     bind("ignore_keep", false, m_ignore_keep);
+    bind("speculative_receivers_file", "", m_speculative_receivers_file,
+         "Lines of \"<caller>,<callee>,<receiver class>,<percent of the "
+         "calls>\". The calls get a type check for their likely receiver, "
+         "which calls its implementation directly.");
+    bind("speculative_min_percent", 90.0f, m_speculative_min_percent,
+         "The share of the calls that the likely receiver must get.");
   }
 
   void run_pass(DexStoresVector&, ConfigFiles&, PassManager&) override;
@@ -37,4 +43,6 @@ class MethodDevirtualizationPass : public Pass {
   bool m_staticize_dmethods_not_using_this;
   bool m_staticize_dmethods_using_this;
   bool m_ignore_keep;
+  std::string m_speculative_receivers_file;
+  float m_speculative_min_percent;
 };
@@ -0,0 +1,208 @@
+/*
+ * Copyright (c) Facebook, Inc. and its affiliates.
+ *
+ * This source code is licensed under the MIT license found in the
+ * LICENSE file in the root directory of this source tree.
+ */
+
+#include "SpeculativeDevirtualization.h"
+
+#include <algorithm>
+#include <cstdlib>
+#include <fstream>
+#include <iostream>
+#include <sstream>
+
+#include "ControlFlow.h"
+#include "DexUtil.h"
+#include "IRCode.h"
+#include "IRInstruction.h"
+#include "Resolver.h"
+#include "Show.h"
+#include "Trace.h"
+#include "TypeUtil.h"
+
+namespace speculative_devirtualization {
+
+namespace {
+
+std::vector<std::string> split_line(const std::string& line) {
+  std::vector<std::string> fields;
+  std::stringstream ss(line);
+  std::string field;
+  while (std::getline(ss, field, ',')) {
+    fields.push_back(field);
+  }
+  return fields;
+}
+
+// The implementation that a call to the callee runs for the receiver, if it
+// can be called from anywhere and the call isn't already monomorphic.
+const DexMethod* get_implementation(const IRInstruction* insn,
+                                    const DexType* receiver) {
+  auto callee = insn->get_method();
+  auto receiver_cls = type_class(receiver);
+  if (receiver_cls == nullptr || is_interface(receiver_cls) ||
+      is_abstract(receiver_cls) || !is_public(receiver_cls) ||
+      !type::check_cast(receiver, callee->get_class())) {
+    return nullptr;
+  }
+  auto impl = resolve_method(receiver_cls, callee->get_name(),
+                             callee->get_proto(), MethodSearch::Virtual);
+  if (impl == nullptr || !impl->is_concrete() || !is_public(impl) ||
+      !is_public(type_class(impl->get_class()))) {
+    return nullptr;
+  }
+  auto target = resolve_method(callee, opcode_to_search(insn));
+  if (target == impl && (is_final(impl) || is_final(receiver_cls))) {
+    return nullptr;
+  }
+  return impl;
+}
+
+// Turns the call into a type check and two calls, which rejoin after the
+// move-result, if any.
+void guard_call(cfg::ControlFlowGraph& cfg,
+                IRInstruction* invoke,
+                const DexType* receiver,
+                const DexMethod* impl) {
+  // Outside of try regions, the move-result is in the same block.
+  auto block = cfg.find_insn(invoke).block();
+  auto ii = InstructionIterable(block);
+  auto invoke_it = std::find_if(ii.begin(), ii.end(), [&](const auto& mie) {
+    return mie.insn == invoke;
+  });
+  auto last_it = invoke_it;
+  IRInstruction* move_result = nullptr;
+  auto next_it = std::next(invoke_it);
+  if (next_it != ii.end() &&
+      opcode::is_move_result_any(next_it->insn->opcode())) {
+    last_it = next_it;
+    move_result = next_it->insn;
+  }
+  auto join = cfg.split_block(block->to_cfg_instruction_iterator(last_it));
+
+  auto fallback = cfg.create_block();
+  std::vector<IRInstruction*> fallback_insns{new IRInstruction(*invoke)};
+  if (move_result != nullptr) {
+    fallback_insns.push_back(new IRInstruction(*move_result));
+  }
+  fallback->push_back(fallback_insns);
+  cfg.add_edge(fallback, join, cfg::EDGE_GOTO);
+
+  auto cast_reg = cfg.allocate_temp();
+  auto guarded_invoke = new IRInstruction(OPCODE_INVOKE_VIRTUAL);
+  guarded_invoke->set_method(const_cast<DexMethod*>(impl))
+      ->set_srcs_size(invoke->srcs_size());
+  guarded_invoke->set_src(0, cast_reg);
+  for (size_t i = 1; i < invoke->srcs_size(); ++i) {
+    guarded_invoke->set_src(i, invoke->src(i));
+  }
+  std::vector<IRInstruction*> guarded_insns{
+      (new IRInstruction(OPCODE_CHECK_CAST))
+          ->set_type(const_cast<DexType*>(receiver))
+          ->set_src(0, invoke->src(0)),
+      (new IRInstruction(IOPCODE_MOVE_RESULT_PSEUDO_OBJECT))
+          ->set_dest(cast_reg),
+      guarded_invoke};
+  if (move_result != nullptr) {
+    guarded_insns.push_back(new IRInstruction(*move_result));
+  }
+  auto guarded = cfg.create_block();
+  guarded->push_back(guarded_insns);
+  cfg.add_edge(guarded, join, cfg::EDGE_GOTO);
+
+  auto flag_reg = cfg.allocate_temp();
+  auto receiver_reg = invoke->src(0);
+  // Also removes the move-result.
+  cfg.remove_insn(block->to_cfg_instruction_iterator(invoke_it));
+  block->push_back(std::vector<IRInstruction*>{
+      (new IRInstruction(OPCODE_INSTANCE_OF))
+          ->set_type(const_cast<DexType*>(receiver))
+          ->set_src(0, receiver_reg),
+      (new IRInstruction(IOPCODE_MOVE_RESULT_PSEUDO))->set_dest(flag_reg)});
+  cfg.set_edge_target(cfg.get_succ_edge_of_type(block, cfg::EDGE_GOTO),
+                      fallback);
+  cfg.create_branch(block,
+                    (new IRInstruction(OPCODE_IF_NEZ))->set_src(0, flag_reg),
+                    nullptr, guarded);
+}
+
+} // namespace
+
+bool read_likely_receivers(const std::string& filename,
+                           double min_percent,
+                           LikelyReceivers* likely_receivers) {
+  std::ifstream file(filename);
+  if (!file) {
+    std::cerr << "FAILED to open " << filename << "\n";
+    return false;
+  }
+  std::string line;
+  while (std::getline(file, line)) {
+    if (line.empty()) {
+      continue;
+    }
+    auto fields = split_line(line);
+    if (fields.size() != 4) {
+      std::cerr << "Bad line in " << filename << ": " << line << "\n";
+      return false;
+    }
+    if (std::strtod(fields[3].c_str(), nullptr) < min_percent) {
+      continue;
+    }
+    auto caller = DexMethod::get_method</*kCheckFormat=*/true>(fields[0]);
+    auto callee = DexMethod::get_method</*kCheckFormat=*/true>(fields[1]);
+    auto receiver = DexType::get_type(fields[2]);
+    if (caller == nullptr || callee == nullptr || receiver == nullptr) {
+      TRACE(VIRT, 6, "failed to resolve %s", line.c_str());
+      continue;
+    }
+    (*likely_receivers)[caller].push_back(LikelyReceiver{callee, receiver});
+  }
+  return true;
+}
+
+Stats guard_calls(const std::vector<LikelyReceiver>& likely_receivers,
+                  IRCode* code) {
+  Stats stats;
+  code->build_cfg(/* editable */ true);
+  auto& cfg = code->cfg();
+  std::vector<std::pair<IRInstruction*, const LikelyReceiver*>> calls;
+  for (auto block : cfg.blocks()) {
+    for (auto& mie : InstructionIterable(block)) {
+      auto insn = mie.insn;
+      auto op = insn->opcode();
+      if (op != OPCODE_INVOKE_VIRTUAL && op != OPCODE_INVOKE_INTERFACE) {
+        continue;
+      }
+      for (const auto& likely : likely_receivers) {
+        if (insn->get_method() != likely.callee) {
+          continue;
+        }
+        // The guarded call would need the throw edges of the original one.
+        if (cfg.get_succ_edge_of_type(block, cfg::EDGE_THROW) != nullptr) {
+          stats.skipped_calls++;
+        } else {
+          calls.emplace_back(insn, &likely);
+        }
+        break;
+      }
+    }
+  }
+  for (const auto& call : calls) {
+    auto impl = get_implementation(call.first, call.second->receiver);
+    if (impl == nullptr) {
+      stats.skipped_calls++;
+      continue;
+    }
+    TRACE(VIRT, 5, "guarding %s for %s", SHOW(call.first),
+          SHOW(call.second->receiver));
+    guard_call(cfg, call.first, call.second->receiver, impl);
+    stats.guarded_calls++;
+  }
+  code->clear_cfg();
+  return stats;
+}
+
+} // namespace speculative_devirtualization
@@ -0,0 +1,79 @@
+/*
+ * Copyright (c) Facebook, Inc. and its affiliates.
+ *
+ * This source code is licensed under the MIT license found in the
+ * LICENSE file in the root directory of this source tree.
+ */
+
+#pragma once
+
+#include <string>
+#include <unordered_map>
+#include <vector>
+
+#include "DexClass.h"
+
+/*
+ * Guards the virtual and interface calls that mostly see one receiver class
+ * with a type check, so that the common case calls the implementation of that
+ * class, which the inliner can then see through:
+ *
+ *   INVOKE_INTERFACE v0, LRunnable;.run:()V
+ *
+ * becomes
+ *
+ *   INSTANCE_OF v0, LTask;
+ *   MOVE_RESULT_PSEUDO v1
+ *   IF_NEZ v1, L0
+ *   INVOKE_INTERFACE v0, LRunnable;.run:()V
+ *   L1: ...
+ *
+ *   L0: CHECK_CAST v0, LTask;
+ *   MOVE_RESULT_PSEUDO_OBJECT v2
+ *   INVOKE_VIRTUAL v2, LTask;.run:()V
+ *   GOTO L1
+ *
+ * The guarded call stays virtual, so that it remains correct for the
+ * subclasses of the receiver class.
+ */
+namespace speculative_devirtualization {
+
+struct LikelyReceiver {
+  const DexMethodRef* callee;
+  const DexType* receiver;
+};
+
+// The likely receivers of the call sites of each caller.
+using LikelyReceivers =
+    std::unordered_map<const DexMethodRef*, std::vector<LikelyReceiver>>;
+
+/*
+ * Reads the receiver profile, whose lines are
+ * "<caller>,<callee>,<receiver class>,<percent of the calls>", keeping the
+ * receivers that got at least min_percent of the calls. Returns false if the
+ * file can't be read or parsed.
+ */
+bool read_likely_receivers(const std::string& filename,
+                           double min_percent,
+                           LikelyReceivers* likely_receivers);
+
+struct Stats {
+  size_t guarded_calls{0};
+  size_t skipped_calls{0};
+
+  Stats& operator+=(const Stats& that) {
+    guarded_calls += that.guarded_calls;
+    skipped_calls += that.skipped_calls;
+    return *this;
+  }
+};
+
+/*
+ * Guards the calls of the code to the given callees. Calls in try regions,
+ * and calls whose receiver class or its implementation are not public, are
+ * skipped.
+ */
+Stats guard_calls(const std::vector<LikelyReceiver>& likely_receivers,
+                  IRCode* code);
+
+} // namespace speculative_devirtualization
@@ -118,10 +118,13 @@ bool find_field(const std::string& simple_deobfuscated_name,
                 const std::vector<FRefInfo>& frefs_info,
                 DexType* field_type,
                 DexAccessFlags access_flags) {
+  auto* name = DexString::get_string(simple_deobfuscated_name);
+  if (name == nullptr) {
+    return false;
+  }
   for (const FRefInfo& fref_info : frefs_info) {
     auto* fref = fref_info.fref;
-    if (fref->get_name()->str() == simple_deobfuscated_name &&
-        fref->get_type() == field_type) {
+    if (fref->get_name() == name && fref->get_type() == field_type) {
 
       // We also need to check the access flags.
       // NOTE: We accept cases where the methods are not declared final.
@@ -384,6 +387,7 @@ void ApiLevelsUtils::gather_non_private_members(const Scope& scope) {
 }
 
 void ApiLevelsUtils::load_framework_api(const Scope& scope) {
+  // A copy, as the classes that can't be replaced are erased from it.
   std::unordered_map<DexType*, FrameworkAPI> framework_cls_to_api =
       get_framework_classes();
   for (auto it = framework_cls_to_api.begin();
@@ -14,6 +14,7 @@
 #include "ConstantArrayDomain.h"
 #include "ControlFlow.h"
 #include "DisjointUnionAbstractDomain.h"
+#include "FlatPatriciaTreeMapAbstractEnvironment.h"
 #include "HashedAbstractPartition.h"
 #include "ObjectDomain.h"
 #include "ObjectWithImmutAttr.h"
@@ -79,8 +80,9 @@ using ConstantValue =
 using FieldEnvironment =
     sparta::PatriciaTreeMapAbstractEnvironment<const DexField*, ConstantValue>;
 
+// Most methods use only a handful of registers.
 using ConstantRegisterEnvironment =
-    sparta::PatriciaTreeMapAbstractEnvironment<reg_t, ConstantValue>;
+    sparta::FlatPatriciaTreeMapAbstractEnvironment<reg_t, ConstantValue>;
 
 /*****************************************************************************
  * Heap values.
@@ -7,33 +7,98 @@
 
 #include "ConstantPropagation.h"
 
+#include <boost/functional/hash.hpp>
+
 #include "ConstantPropagationAnalysis.h"
 #include "ConstantPropagationTransform.h"
+#include "DexHasher.h"
+#include "RangeAnalysis.h"
 
 #include "Walkers.h"
 
 namespace constant_propagation {
 
+size_t UnchangedMethodCache::KeyHash::operator()(const Key& key) const {
+  size_t seed = 0;
+  boost::hash_combine(seed, key.method);
+  boost::hash_combine(seed, key.hash);
+  boost::hash_combine(seed, key.options);
+  return seed;
+}
+
+UnchangedMethodCache& UnchangedMethodCache::get() {
+  static UnchangedMethodCache cache;
+  return cache;
+}
+
+boost::optional<UnchangedMethodCache::Key> UnchangedMethodCache::make_key(
+    const DexMethod* method,
+    const Transform::Config& config,
+    const XStoreRefs* xstores,
+    bool run_on_editable_cfg,
+    bool remove_redundant_range_checks) {
+  if (method->get_code() == nullptr || config.class_under_init != nullptr ||
+      config.getter_methods_for_immutable_fields != nullptr) {
+    return boost::none;
+  }
+  uint32_t options = 0;
+  options |= uint32_t(config.replace_moves_with_consts) << 0;
+  options |= uint32_t(config.replace_move_result_with_consts) << 1;
+  options |= uint32_t(config.remove_dead_switch) << 2;
+  options |= uint32_t(xstores != nullptr) << 3;
+  options |= uint32_t(run_on_editable_cfg) << 4;
+  options |= uint32_t(remove_redundant_range_checks) << 5;
+  return Key{method, hashing::hash_method(method), options};
+}
+
+bool UnchangedMethodCache::is_unchanged(const DexMethod* method,
+                                        const Key& key) {
+  return hashing::hash_method(method) == key.hash;
+}
+
 Transform::Stats ConstantPropagation::run(DexMethod* method,
                                           XStoreRefs* xstores) {
   if (method->get_code() == nullptr) {
     return Transform::Stats();
   }
   TRACE(CONSTP, 2, "Method: %s", SHOW(method));
+  auto& cache = UnchangedMethodCache::get();
+  auto key = UnchangedMethodCache::make_key(
+      method, m_config.transform, xstores,
+      /* run_on_editable_cfg */ xstores != nullptr,
+      m_config.remove_redundant_range_checks);
+  if (key && cache.contains(*key)) {
+    Transform::Stats stats;
+    stats.unchanged_cache_hits = 1;
+    return stats;
+  }
   auto code = method->get_code();
   code->build_cfg(/* editable */ false);
   auto& cfg = code->cfg();
+  bool sparse = m_config.sparse_analysis_min_size > 0 &&
+                cfg.num_blocks() * code->get_registers_size() >=
+                    m_config.sparse_analysis_min_size;
+  auto run_fixpoint = [sparse](intraprocedural::FixpointIterator* fp_iter) {
+    if (sparse) {
+      fp_iter->run_sparse(ConstantEnvironment());
+    } else {
+      fp_iter->run(ConstantEnvironment());
+    }
+  };
 
   TRACE(CONSTP, 5, "CFG: %s", SHOW(code->cfg()));
   Transform::Stats local_stats;
   {
     intraprocedural::FixpointIterator fp_iter(code->cfg(),
                                               ConstantPrimitiveAnalyzer());
-    fp_iter.run(ConstantEnvironment());
+    run_fixpoint(&fp_iter);
     constant_propagation::Transform tf(m_config.transform);
     local_stats = tf.apply_on_uneditable_cfg(
         fp_iter, WholeProgramState(), code, xstores, method->get_class());
   }
+  // The changes made on the editable cfg are all counted in the stats, but
+  // the ones made on the uneditable cfg aren't, e.g. redundant puts.
+  bool unchanged = key && UnchangedMethodCache::is_unchanged(method, *key);
   if (xstores) {
     always_assert(!code->editable_cfg_built());
     code->build_cfg(/* editable */ true);
@@ -41,12 +106,30 @@ Transform::Stats ConstantPropagation::run(DexMethod* method,
     {
       intraprocedural::FixpointIterator fp_iter(code->cfg(),
                                                 ConstantPrimitiveAnalyzer());
-      fp_iter.run(ConstantEnvironment());
+      run_fixpoint(&fp_iter);
       constant_propagation::Transform tf(m_config.transform);
       local_stats += tf.apply(fp_iter, code->cfg(), method, xstores);
     }
+    if (m_config.remove_redundant_range_checks) {
+      range::FixpointIterator range_iter(code->cfg());
+      range_iter.run(range::RangeEnvironment());
+      auto removed = range::remove_redundant_branches(range_iter, &code->cfg());
+      if (removed > 0) {
+        code->cfg().remove_unreachable_blocks();
+        local_stats.range_checks_removed += removed;
+      }
+    }
     code->clear_cfg();
   }
+  if (key) {
+    // The sparse engine may be less precise, so finding nothing to change
+    // with it doesn't mean that the dense one wouldn't.
+    if (unchanged && !sparse && local_stats.branches_forwarded == 0 &&
+        local_stats.range_checks_removed == 0) {
+      cache.insert(*key);
+    }
+    local_stats.unchanged_cache_misses = 1;
+  }
   return local_stats;
 }
 
@@ -7,6 +7,9 @@
 
 #pragma once
 
+#include <boost/optional.hpp>
+
+#include "ConcurrentContainers.h"
 #include "ConstantPropagationTransform.h"
 #include "IRCode.h"
 
@@ -14,6 +17,67 @@ namespace constant_propagation {
 
 struct Config {
   Transform::Config transform;
+  // Also remove the branches that are decided by the ranges of integers, see
+  // RangeAnalysis.h.
+  bool remove_redundant_range_checks{false};
+  // Analyze the methods whose number of blocks times number of registers is
+  // at least this with the sparse engine, see SparseConstantPropagation.h.
+  // Zero disables it.
+  size_t sparse_analysis_min_size{0};
+};
+
+/*
+ * Remembers the methods on which a run of the intraprocedural constant
+ * propagation changed nothing, so that a later run over the same unmodified
+ * method -- e.g. the shrinker of the inliner after ConstantPropagationPass --
+ * can skip both the fixpoint iteration and the transform.
+ *
+ * Entries are keyed by the method, the hash of its contents and the options
+ * of the run. Only runs whose outcome is a function of the method alone are
+ * cached, i.e. runs with the ConstantPrimitiveAnalyzer, an empty
+ * WholeProgramState and none of the transform options that refer to other
+ * classes or methods. Whether cross-store references are checked is part of
+ * the options; the stores themselves don't change over a run of Redex.
+ */
+class UnchangedMethodCache final {
+ public:
+  struct Key {
+    const DexMethod* method;
+    size_t hash;
+    uint32_t options;
+
+    bool operator==(const Key& that) const {
+      return method == that.method && hash == that.hash &&
+             options == that.options;
+    }
+  };
+
+  struct KeyHash {
+    size_t operator()(const Key& key) const;
+  };
+
+  // The cache is shared by all passes.
+  static UnchangedMethodCache& get();
+
+  // Returns none if a run with the given options cannot be cached.
+  static boost::optional<Key> make_key(const DexMethod* method,
+                                       const Transform::Config& config,
+                                       const XStoreRefs* xstores,
+                                       bool run_on_editable_cfg,
+                                       bool remove_redundant_range_checks);
+
+  // Whether the contents of the method are still the ones the key was made
+  // for.
+  static bool is_unchanged(const DexMethod* method, const Key& key);
+
+  bool contains(const Key& key) const { return m_keys.count(key); }
+
+  void insert(const Key& key) { m_keys.insert(key); }
+
+  void clear() { m_keys.clear(); }
+
+ private:
+  ConcurrentSet<Key, KeyHash> m_keys;
 };
 
 class ConstantPropagation final {
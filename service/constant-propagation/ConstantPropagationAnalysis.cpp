@@ -20,6 +20,7 @@ std::enable_if_t<std::is_integral<T>::value, int> fpclassify(T x) {
 
 #include "DexUtil.h"
 #include "Resolver.h"
+#include "SparseConstantPropagation.h"
 #include "Transform.h"
 #include "Walkers.h"
 
@@ -1005,6 +1006,18 @@ void FixpointIterator::analyze_instruction_no_throw(
       src, meet(value, SignedConstantDomain(sign_domain::Interval::NEZ)));
 }
 
+void FixpointIterator::run_sparse(const ConstantEnvironment& init) {
+  this->clear();
+  sparse::SparseConstantPropagation sccp(m_cfg, *this);
+  sccp.run(init);
+  for (auto* block : m_cfg.blocks()) {
+    auto entry_state = sccp.get_entry_state_at(block);
+    auto exit_state = entry_state;
+    analyze_node(block, &exit_state);
+    set_states_at(block, std::move(entry_state), std::move(exit_state));
+  }
+}
+
 void FixpointIterator::analyze_node(const NodeId& block,
                                     ConstantEnvironment* state_at_entry) const {
   TRACE(CONSTP, 5, "Analyzing block: %d", block->id());
@@ -30,8 +30,20 @@ class FixpointIterator final
       const cfg::ControlFlowGraph& cfg,
       InstructionAnalyzer<ConstantEnvironment> insn_analyzer)
       : MonotonicFixpointIterator(cfg),
+        m_cfg(cfg),
         m_insn_analyzer(std::move(insn_analyzer)) {}
 
+  /*
+   * Computes the invariants with the sparse engine of
+   * SparseConstantPropagation.h instead of iterating over whole environments,
+   * which is much faster on huge methods. The engine only supports instruction
+   * analyzers that read nothing but registers, e.g. ConstantPrimitiveAnalyzer.
+   * It doesn't refine the values of registers along the paths where a branch
+   * or a dereference tells more about them, so it may be less precise than
+   * run().
+   */
+  void run_sparse(const ConstantEnvironment& init);
+
   ConstantEnvironment analyze_edge(
       const EdgeId&,
       const ConstantEnvironment& exit_state_at_source) const override;
@@ -47,6 +59,7 @@ class FixpointIterator final
                     ConstantEnvironment* state_at_entry) const override;
 
  private:
+  const cfg::ControlFlowGraph& m_cfg;
   InstructionAnalyzer<ConstantEnvironment> m_insn_analyzer;
 };
 
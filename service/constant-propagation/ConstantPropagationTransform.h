@@ -38,16 +38,25 @@ class Transform final {
   struct Stats {
     size_t branches_removed{0};
     size_t branches_forwarded{0};
+    size_t range_checks_removed{0};
     size_t materialized_consts{0};
     size_t added_param_const{0};
     size_t throws{0};
+    // Methods whose analysis was skipped, resp. not, because an earlier run
+    // over the same unchanged method found nothing to change, see
+    // UnchangedMethodCache.
+    size_t unchanged_cache_hits{0};
+    size_t unchanged_cache_misses{0};
 
     Stats& operator+=(const Stats& that) {
       branches_removed += that.branches_removed;
       branches_forwarded += that.branches_forwarded;
+      range_checks_removed += that.range_checks_removed;
       materialized_consts += that.materialized_consts;
       added_param_const += that.added_param_const;
       throws += that.throws;
+      unchanged_cache_hits += that.unchanged_cache_hits;
+      unchanged_cache_misses += that.unchanged_cache_misses;
       return *this;
     }
   };
@@ -9,6 +9,7 @@
 
 #include "IPConstantPropagationAnalysis.h"
 #include "Walkers.h"
+#include "WorkQueue.h"
 
 using namespace constant_propagation;
 
@@ -152,43 +153,85 @@ WholeProgramState::WholeProgramState(
 /*
  * Walk over the entire program, doing a join over the values written to each
  * field, as well as a join over the values returned by each method.
+ *
+ * The fields get dense ids, so that each thread joins the values it sees into
+ * a vector of its own, and these partial results are then reduced in
+ * parallel. The return values of a method only come from its own code, so
+ * they are joined by the thread that walks it.
  */
 void WholeProgramState::collect(
     const Scope& scope, const interprocedural::FixpointIterator& fp_iter) {
   initialize_ifields(scope, &m_field_partition);
-  ConcurrentMap<const DexField*, std::vector<ConstantValue>> fields_value_tmp;
-  ConcurrentMap<const DexMethod*, std::vector<ConstantValue>> methods_value_tmp;
-  walk::parallel::methods(scope, [&](DexMethod* method) {
-    IRCode* code = method->get_code();
-    if (code == nullptr) {
-      return;
-    }
-    auto& cfg = code->cfg();
-    auto intra_cp = fp_iter.get_intraprocedural_analysis(method);
-    for (cfg::Block* b : cfg.blocks()) {
-      auto env = intra_cp->get_entry_state_at(b);
-      auto last_insn = b->get_last_insn();
-      for (auto& mie : InstructionIterable(b)) {
-        auto* insn = mie.insn;
-        intra_cp->analyze_instruction(insn, &env, insn == last_insn->insn);
-        collect_field_values(insn, env,
-                             method::is_clinit(method) ? method->get_class()
-                                                       : nullptr,
-                             &fields_value_tmp);
-        collect_return_values(insn, env, method, &methods_value_tmp);
-      }
+  std::vector<const DexField*> fields;
+  std::unordered_map<const DexField*, uint32_t> field_ids;
+  walk::fields(scope, [&](DexField* field) {
+    if (m_known_fields.count(field)) {
+      field_ids.emplace(field, fields.size());
+      fields.push_back(field);
     }
   });
-  for (const auto& pair : fields_value_tmp) {
-    for (auto& value : pair.second) {
-      m_field_partition.update(pair.first, [&value](auto* current_value) {
+  std::vector<DexMethod*> methods;
+  walk::code(scope,
+             [&](DexMethod* method, IRCode&) { methods.push_back(method); });
+
+  auto num_threads = redex_parallel::default_num_threads();
+  std::vector<std::vector<ConstantValue>> thread_field_values(num_threads);
+  std::vector<ConstantValue> return_values(methods.size(),
+                                           ConstantValue::bottom());
+  auto wq = workqueue_foreach<uint32_t>(
+      [&](sparta::SpartaWorkerState<uint32_t>* state, uint32_t idx) {
+        auto* method = methods[idx];
+        auto& field_values = thread_field_values[state->worker_id()];
+        if (field_values.empty()) {
+          field_values.resize(fields.size(), ConstantValue::bottom());
+        }
+        auto& cfg = method->get_code()->cfg();
+        auto intra_cp = fp_iter.get_intraprocedural_analysis(method);
+        auto clinit_cls =
+            method::is_clinit(method) ? method->get_class() : nullptr;
+        for (cfg::Block* b : cfg.blocks()) {
+          auto env = intra_cp->get_entry_state_at(b);
+          auto last_insn = b->get_last_insn();
+          for (auto& mie : InstructionIterable(b)) {
+            auto* insn = mie.insn;
+            intra_cp->analyze_instruction(insn, &env, insn == last_insn->insn);
+            collect_field_values(insn, env, clinit_cls, field_ids,
+                                 &field_values);
+            collect_return_values(insn, env, &return_values[idx]);
+          }
+        }
+      },
+      num_threads);
+  for (uint32_t idx = 0; idx < methods.size(); ++idx) {
+    wq.add_item(idx);
+  }
+  wq.run_all();
+
+  workqueue_tree_reduce(
+      &thread_field_values,
+      [](std::vector<ConstantValue>* into, std::vector<ConstantValue>* from) {
+        if (into->empty()) {
+          into->swap(*from);
+          return;
+        }
+        for (size_t i = 0; i < from->size(); ++i) {
+          (*into)[i].join_with((*from)[i]);
+        }
+      },
+      num_threads);
+  const auto& field_values = thread_field_values.front();
+  for (size_t i = 0; i < field_values.size(); ++i) {
+    const auto& value = field_values[i];
+    if (!value.is_bottom()) {
+      m_field_partition.update(fields[i], [&value](auto* current_value) {
         current_value->join_with(value);
       });
     }
   }
-  for (const auto& pair : methods_value_tmp) {
-    for (auto& value : pair.second) {
-      m_method_partition.update(pair.first, [&value](auto* current_value) {
+  for (size_t i = 0; i < methods.size(); ++i) {
+    const auto& value = return_values[i];
+    if (!value.is_bottom()) {
+      m_method_partition.update(methods[i], [&value](auto* current_value) {
         current_value->join_with(value);
       });
     }
@@ -208,22 +251,21 @@ void WholeProgramState::collect_field_values(
     const IRInstruction* insn,
     const ConstantEnvironment& env,
     const DexType* clinit_cls,
-    ConcurrentMap<const DexField*, std::vector<ConstantValue>>*
-        fields_value_tmp) {
+    const std::unordered_map<const DexField*, uint32_t>& field_ids,
+    std::vector<ConstantValue>* field_values) {
   if (!is_sput(insn->opcode()) && !is_iput(insn->opcode())) {
     return;
   }
   auto field = resolve_field(insn->get_field());
-  if (field != nullptr && m_known_fields.count(field)) {
+  if (field == nullptr) {
+    return;
+  }
+  auto it = field_ids.find(field);
+  if (it != field_ids.end()) {
     if (is_sput(insn->opcode()) && field->get_class() == clinit_cls) {
       return;
     }
-    auto value = env.get(insn->src(0));
-    fields_value_tmp->update(
-        field,
-        [value](const DexField*,
-                std::vector<ConstantValue>& s,
-                bool /* exists */) { s.emplace_back(value); });
+    (*field_values)[it->second].join_with(env.get(insn->src(0)));
   }
 }
 
@@ -233,12 +275,9 @@ void WholeProgramState::collect_field_values(
  * If there are no reachable return opcodes in the method, then it never
  * returns. Its return value will be represented by Bottom in our analysis.
  */
-void WholeProgramState::collect_return_values(
-    const IRInstruction* insn,
-    const ConstantEnvironment& env,
-    const DexMethod* method,
-    ConcurrentMap<const DexMethod*, std::vector<ConstantValue>>*
-        methods_value_tmp) {
+void WholeProgramState::collect_return_values(const IRInstruction* insn,
+                                              const ConstantEnvironment& env,
+                                              ConstantValue* return_value) {
   auto op = insn->opcode();
   if (!is_return(op)) {
     return;
@@ -248,19 +287,10 @@ void WholeProgramState::collect_return_values(
     // does indeed return -- even though `void` is not actually a return value,
     // this tells us that the code following any invoke of this method is
     // reachable.
-    methods_value_tmp->update(
-        method,
-        [](const DexMethod*, std::vector<ConstantValue>& s, bool /* exists */) {
-          s.emplace_back(ConstantValue::top());
-        });
+    return_value->set_to_top();
     return;
   }
-  auto value = env.get(insn->src(0));
-  methods_value_tmp->update(
-      method,
-      [value](const DexMethod*,
-              std::vector<ConstantValue>& s,
-              bool /* exists */) { s.emplace_back(value); });
+  return_value->join_with(env.get(insn->src(0)));
 }
 
 void WholeProgramState::collect_static_finals(const DexClass* cls,
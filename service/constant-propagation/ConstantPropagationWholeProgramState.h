@@ -113,13 +113,12 @@ class WholeProgramState {
       const IRInstruction* insn,
       const ConstantEnvironment& env,
       const DexType* clinit_cls,
-      ConcurrentMap<const DexField*, std::vector<ConstantValue>>* field_tmp);
+      const std::unordered_map<const DexField*, uint32_t>& field_ids,
+      std::vector<ConstantValue>* field_values);
 
-  void collect_return_values(
-      const IRInstruction* insn,
-      const ConstantEnvironment& env,
-      const DexMethod* method,
-      ConcurrentMap<const DexMethod*, std::vector<ConstantValue>>* method_tmp);
+  void collect_return_values(const IRInstruction* insn,
+                             const ConstantEnvironment& env,
+                             ConstantValue* return_value);
 
   // Unknown fields and methods will be treated as containing / returning Top.
   std::unordered_set<const DexField*> m_known_fields;
@@ -7,6 +7,9 @@
 
 #include "IPConstantPropagationAnalysis.h"
 
+#include "Resolver.h"
+#include "WorkQueue.h"
+
 namespace constant_propagation {
 
 namespace interprocedural {
@@ -78,7 +81,7 @@ void FixpointIterator::analyze_node(call_graph::NodeId const& node,
 }
 
 Domain FixpointIterator::analyze_edge(
-    const std::shared_ptr<call_graph::Edge>& edge,
+    const call_graph::EdgeId& edge,
     const Domain& exit_state_at_source) const {
   Domain entry_state_at_dest;
   auto it = edge->invoke_iterator();
@@ -105,6 +108,50 @@ FixpointIterator::get_intraprocedural_analysis(const DexMethod* method) const {
                                  args.get(CURRENT_PARTITION_LABEL));
 }
 
+std::unordered_set<call_graph::NodeId> FixpointIterator::get_affected_nodes(
+    const WholeProgramState& wps) const {
+  const auto& old_wps = get_whole_program_state();
+  std::vector<char> affected(m_call_graph.num_nodes(), false);
+  auto wq = workqueue_foreach<uint32_t>([&](uint32_t id) {
+    const DexMethod* method = m_call_graph.node_by_id(id)->method();
+    if (method == nullptr || method->get_code() == nullptr) {
+      return;
+    }
+    for (auto& mie : InstructionIterable(method->get_code()->cfg())) {
+      auto* insn = mie.insn;
+      if (insn->has_field()) {
+        auto field = resolve_field(insn->get_field());
+        if (field != nullptr &&
+            !old_wps.get_field_value(field).equals(
+                wps.get_field_value(field))) {
+          affected[id] = true;
+          return;
+        }
+      } else if (insn->has_method()) {
+        auto callee =
+            resolve_method(insn->get_method(), opcode_to_search(insn));
+        if (callee != nullptr &&
+            !old_wps.get_return_value(callee).equals(
+                wps.get_return_value(callee))) {
+          affected[id] = true;
+          return;
+        }
+      }
+    }
+  });
+  for (uint32_t id = 0; id < m_call_graph.num_nodes(); ++id) {
+    wq.add_item(id);
+  }
+  wq.run_all();
+  std::unordered_set<call_graph::NodeId> affected_nodes;
+  for (uint32_t id = 0; id < m_call_graph.num_nodes(); ++id) {
+    if (affected[id]) {
+      affected_nodes.insert(m_call_graph.node_by_id(id));
+    }
+  }
+  return affected_nodes;
+}
+
 } // namespace interprocedural
 
 void set_encoded_values(const DexClass* cls, ConstantEnvironment* env) {
@@ -82,7 +82,7 @@ class FixpointIterator : public sparta::ParallelMonotonicFixpointIterator<
   void analyze_node(const call_graph::NodeId& node,
                     Domain* current_state) const override;
 
-  Domain analyze_edge(const std::shared_ptr<call_graph::Edge>& edge,
+  Domain analyze_edge(const call_graph::EdgeId& edge,
                       const Domain& exit_state_at_source) const override;
 
   std::unique_ptr<intraprocedural::FixpointIterator>
@@ -94,6 +94,15 @@ class FixpointIterator : public sparta::ParallelMonotonicFixpointIterator<
     m_wps = std::move(wps);
   }
 
+  /*
+   * Returns the nodes of the call graph whose methods read a field value or a
+   * return value that differs between the current WholeProgramState and
+   * `wps`. These are the only nodes that need to be analyzed again with the
+   * same arguments once `wps` is installed, see run_incrementally().
+   */
+  std::unordered_set<call_graph::NodeId> get_affected_nodes(
+      const WholeProgramState& wps) const;
+
   const call_graph::Graph& get_call_graph() { return m_call_graph; }
 
  private:
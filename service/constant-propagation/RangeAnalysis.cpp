@@ -0,0 +1,371 @@
+/*
+ * Copyright (c) Facebook, Inc. and its affiliates.
+ *
+ * This source code is licensed under the MIT license found in the
+ * LICENSE file in the root directory of this source tree.
+ */
+
+#include "RangeAnalysis.h"
+
+#include <algorithm>
+#include <functional>
+#include <limits>
+
+#include "IROpcode.h"
+#include "Trace.h"
+
+namespace constant_propagation {
+
+namespace range {
+
+namespace {
+
+constexpr int64_t INT_MIN_VALUE = std::numeric_limits<int32_t>::min();
+constexpr int64_t INT_MAX_VALUE = std::numeric_limits<int32_t>::max();
+
+IntegerRange make_range(int64_t lb, int64_t ub) {
+  if (lb > ub) {
+    return IntegerRange::bottom();
+  }
+  return IntegerRange::finite(lb, ub);
+}
+
+/*
+ * The result of an arithmetic operation, which is any 32-bit value if the
+ * operation may overflow, since integer arithmetic wraps around.
+ */
+IntegerRange make_wrapping_range(int64_t lb, int64_t ub) {
+  if (lb < INT_MIN_VALUE || ub > INT_MAX_VALUE) {
+    return IntegerRange::top();
+  }
+  return make_range(lb, ub);
+}
+
+void set_range(RangeEnvironment* env, reg_t reg, const IntegerRange& range) {
+  if (range.is_bottom()) {
+    env->set_to_bottom();
+  } else {
+    env->set(reg, range);
+  }
+}
+
+// The range of `x rem divisor` for a positive divisor.
+IntegerRange rem_range(const IntegerRange& x, int64_t divisor) {
+  auto modulus = divisor - 1;
+  auto lb = x.lower_bound() >= 0 ? 0 : std::max(x.lower_bound(), -modulus);
+  auto ub = x.upper_bound() <= 0 ? 0 : std::min(x.upper_bound(), modulus);
+  return make_range(lb, ub);
+}
+
+/*
+ * Refines the ranges of the operands of a comparison, assuming that it
+ * evaluates to true.
+ */
+void analyze_if(const IRInstruction* insn,
+                RangeEnvironment* env,
+                bool is_true_branch) {
+  if (env->is_bottom()) {
+    return;
+  }
+  // Inverting the conditional here means that we only need to consider the
+  // "true" case of the if-* opcode
+  auto op = !is_true_branch ? opcode::invert_conditional_branch(insn->opcode())
+                            : insn->opcode();
+  bool is_unary = insn->srcs_size() == 1;
+  auto left = FixpointIterator::get_range(*env, insn->src(0));
+  auto right = is_unary ? IntegerRange::finite(0, 0)
+                        : FixpointIterator::get_range(*env, insn->src(1));
+  auto refined_left = left;
+  auto refined_right = right;
+  switch (op) {
+  case OPCODE_IF_EQ:
+  case OPCODE_IF_EQZ: {
+    refined_left = left.meet(right);
+    refined_right = refined_left;
+    break;
+  }
+  case OPCODE_IF_NE:
+  case OPCODE_IF_NEZ: {
+    // Only the bounds of an interval can be excluded.
+    auto exclude = [](const IntegerRange& x, const IntegerRange& y) {
+      if (y.lower_bound() != y.upper_bound()) {
+        return x;
+      }
+      auto lb = x.lower_bound();
+      auto ub = x.upper_bound();
+      if (lb == y.lower_bound()) {
+        ++lb;
+      }
+      if (ub == y.lower_bound()) {
+        --ub;
+      }
+      return make_range(lb, ub);
+    };
+    refined_left = exclude(left, right);
+    refined_right = exclude(right, left);
+    break;
+  }
+  case OPCODE_IF_LT:
+  case OPCODE_IF_LTZ: {
+    refined_left =
+        left.meet(make_range(INT_MIN_VALUE, right.upper_bound() - 1));
+    refined_right =
+        right.meet(make_range(left.lower_bound() + 1, INT_MAX_VALUE));
+    break;
+  }
+  case OPCODE_IF_LE:
+  case OPCODE_IF_LEZ: {
+    refined_left = left.meet(make_range(INT_MIN_VALUE, right.upper_bound()));
+    refined_right = right.meet(make_range(left.lower_bound(), INT_MAX_VALUE));
+    break;
+  }
+  case OPCODE_IF_GT:
+  case OPCODE_IF_GTZ: {
+    refined_left =
+        left.meet(make_range(right.lower_bound() + 1, INT_MAX_VALUE));
+    refined_right =
+        right.meet(make_range(INT_MIN_VALUE, left.upper_bound() - 1));
+    break;
+  }
+  case OPCODE_IF_GE:
+  case OPCODE_IF_GEZ: {
+    refined_left = left.meet(make_range(right.lower_bound(), INT_MAX_VALUE));
+    refined_right = right.meet(make_range(INT_MIN_VALUE, left.upper_bound()));
+    break;
+  }
+  default: {
+    always_assert_log(false, "Unexpected opcode: %s\n", SHOW(op));
+  }
+  }
+  if (refined_left.is_bottom() || refined_right.is_bottom()) {
+    env->set_to_bottom();
+    return;
+  }
+  env->set(insn->src(0), refined_left);
+  if (!is_unary) {
+    env->set(insn->src(1), refined_right);
+  }
+}
+
+} // namespace
+
+IntegerRange FixpointIterator::get_range(const RangeEnvironment& env,
+                                         reg_t reg) {
+  auto range = env.get(reg);
+  if (range.is_bottom()) {
+    return range;
+  }
+  return make_range(std::max(range.lower_bound(), INT_MIN_VALUE),
+                    std::min(range.upper_bound(), INT_MAX_VALUE));
+}
+
+void FixpointIterator::analyze_instruction(const IRInstruction* insn,
+                                           RangeEnvironment* env) const {
+  auto op = insn->opcode();
+  auto literal_op = [&](const std::function<IntegerRange(
+                            const IntegerRange&, int64_t)>& f) {
+    auto x = get_range(*env, insn->src(0));
+    set_range(env, insn->dest(), f(x, insn->get_literal()));
+  };
+  switch (op) {
+  case OPCODE_CONST: {
+    set_range(env, insn->dest(),
+              make_range(insn->get_literal(), insn->get_literal()));
+    return;
+  }
+  case OPCODE_MOVE: {
+    set_range(env, insn->dest(), env->get(insn->src(0)));
+    return;
+  }
+  case OPCODE_MOVE_RESULT:
+  case IOPCODE_MOVE_RESULT_PSEUDO: {
+    set_range(env, insn->dest(), env->get(RESULT_REGISTER));
+    env->set(RESULT_REGISTER, IntegerRange::top());
+    return;
+  }
+  case OPCODE_ADD_INT_LIT16:
+  case OPCODE_ADD_INT_LIT8: {
+    literal_op([](const IntegerRange& x, int64_t c) {
+      return make_wrapping_range(x.lower_bound() + c, x.upper_bound() + c);
+    });
+    return;
+  }
+  case OPCODE_RSUB_INT:
+  case OPCODE_RSUB_INT_LIT8: {
+    literal_op([](const IntegerRange& x, int64_t c) {
+      return make_wrapping_range(c - x.upper_bound(), c - x.lower_bound());
+    });
+    return;
+  }
+  case OPCODE_AND_INT_LIT16:
+  case OPCODE_AND_INT_LIT8: {
+    literal_op([](const IntegerRange& x, int64_t c) {
+      if (c >= 0) {
+        // Masking with a non-negative literal clears the sign bit.
+        auto ub = x.lower_bound() >= 0 ? std::min(x.upper_bound(), c) : c;
+        return make_range(0, ub);
+      }
+      return x.lower_bound() >= 0 ? make_range(0, x.upper_bound())
+                                  : IntegerRange::top();
+    });
+    return;
+  }
+  case OPCODE_REM_INT_LIT16:
+  case OPCODE_REM_INT_LIT8: {
+    auto x = get_range(*env, insn->src(0));
+    auto c = insn->get_literal();
+    // The sign of the result is the sign of the dividend, and its magnitude
+    // is below the magnitude of the divisor. The remainder by zero throws.
+    env->set(RESULT_REGISTER,
+             c == 0 ? IntegerRange::top() : rem_range(x, c > 0 ? c : -c));
+    return;
+  }
+  case OPCODE_ADD_INT:
+  case OPCODE_SUB_INT: {
+    auto x = get_range(*env, insn->src(0));
+    auto y = get_range(*env, insn->src(1));
+    if (x.is_bottom() || y.is_bottom()) {
+      env->set_to_bottom();
+    } else if (op == OPCODE_ADD_INT) {
+      set_range(env, insn->dest(),
+                make_wrapping_range(x.lower_bound() + y.lower_bound(),
+                                    x.upper_bound() + y.upper_bound()));
+    } else {
+      set_range(env, insn->dest(),
+                make_wrapping_range(x.lower_bound() - y.upper_bound(),
+                                    x.upper_bound() - y.lower_bound()));
+    }
+    return;
+  }
+  case OPCODE_ARRAY_LENGTH: {
+    env->set(RESULT_REGISTER, make_range(0, INT_MAX_VALUE));
+    return;
+  }
+  case OPCODE_AGET_BOOLEAN: {
+    env->set(RESULT_REGISTER, make_range(0, 1));
+    return;
+  }
+  case OPCODE_AGET_BYTE: {
+    env->set(RESULT_REGISTER, make_range(std::numeric_limits<int8_t>::min(),
+                                         std::numeric_limits<int8_t>::max()));
+    return;
+  }
+  case OPCODE_AGET_CHAR: {
+    env->set(RESULT_REGISTER,
+             make_range(0, std::numeric_limits<uint16_t>::max()));
+    return;
+  }
+  case OPCODE_AGET_SHORT: {
+    env->set(RESULT_REGISTER,
+             make_range(std::numeric_limits<int16_t>::min(),
+                        std::numeric_limits<int16_t>::max()));
+    return;
+  }
+  case OPCODE_INT_TO_BYTE: {
+    set_range(env, insn->dest(),
+              make_range(std::numeric_limits<int8_t>::min(),
+                         std::numeric_limits<int8_t>::max()));
+    return;
+  }
+  case OPCODE_INT_TO_CHAR: {
+    set_range(env, insn->dest(),
+              make_range(0, std::numeric_limits<uint16_t>::max()));
+    return;
+  }
+  case OPCODE_INT_TO_SHORT: {
+    set_range(env, insn->dest(),
+              make_range(std::numeric_limits<int16_t>::min(),
+                         std::numeric_limits<int16_t>::max()));
+    return;
+  }
+  case OPCODE_CMPL_FLOAT:
+  case OPCODE_CMPG_FLOAT:
+  case OPCODE_CMPL_DOUBLE:
+  case OPCODE_CMPG_DOUBLE:
+  case OPCODE_CMP_LONG: {
+    set_range(env, insn->dest(), make_range(-1, 1));
+    return;
+  }
+  default: {
+    break;
+  }
+  }
+  // Everything else, including wide values, is not tracked.
+  if (insn->has_dest()) {
+    env->set(insn->dest(), IntegerRange::top());
+    if (insn->dest_is_wide()) {
+      env->set(insn->dest() + 1, IntegerRange::top());
+    }
+  } else if (insn->has_move_result_any()) {
+    env->set(RESULT_REGISTER, IntegerRange::top());
+  }
+}
+
+RangeEnvironment FixpointIterator::analyze_edge(
+    const cfg::GraphInterface::EdgeId& edge,
+    const RangeEnvironment& exit_state_at_source) const {
+  auto env = exit_state_at_source;
+  auto last_insn_it = edge->src()->get_last_insn();
+  if (last_insn_it == edge->src()->end()) {
+    return env;
+  }
+  auto insn = last_insn_it->insn;
+  auto op = insn->opcode();
+  if (is_conditional_branch(op)) {
+    analyze_if(insn, &env, edge->type() == cfg::EDGE_BRANCH);
+  } else if (is_switch(op) && edge->case_key()) {
+    auto key = *edge->case_key();
+    set_range(&env,
+              insn->src(0),
+              get_range(env, insn->src(0)).meet(make_range(key, key)));
+  }
+  return env;
+}
+
+size_t remove_redundant_branches(const FixpointIterator& fp_iter,
+                                 cfg::ControlFlowGraph* cfg) {
+  size_t edges_removed = 0;
+  for (auto* block : cfg->blocks()) {
+    auto env = fp_iter.get_exit_state_at(block);
+    if (env.is_bottom()) {
+      // Unreachable code.
+      continue;
+    }
+    auto insn_it = block->get_last_insn();
+    if (insn_it == block->end()) {
+      continue;
+    }
+    auto op = insn_it->insn->opcode();
+    if (is_conditional_branch(op)) {
+      auto branch = cfg->get_succ_edge_of_type(block, cfg::EDGE_BRANCH);
+      auto fallthrough = cfg->get_succ_edge_of_type(block, cfg::EDGE_GOTO);
+      for (auto* edge : {branch, fallthrough}) {
+        if (edge != nullptr && fp_iter.analyze_edge(edge, env).is_bottom()) {
+          TRACE(CONSTP, 2, "Range analysis: %s is never %s",
+                SHOW(insn_it->insn), edge == branch ? "true" : "false");
+          // Deleting the edge removes the branch instruction as well.
+          cfg->delete_edge(edge);
+          ++edges_removed;
+          // At least one of the two successors of a reachable block is
+          // reachable.
+          break;
+        }
+      }
+    } else if (is_switch(op)) {
+      // The fallthrough edge is kept even if it is unreachable, the case
+      // edges are removed, and so is the switch if no case remains.
+      auto cases = cfg->get_succ_edges_of_type(block, cfg::EDGE_BRANCH);
+      for (auto* edge : cases) {
+        if (fp_iter.analyze_edge(edge, env).is_bottom()) {
+          cfg->delete_edge(edge);
+          ++edges_removed;
+        }
+      }
+    }
+  }
+  return edges_removed;
+}
+
+} // namespace range
+
+} // namespace constant_propagation
@@ -0,0 +1,72 @@
+/*
+ * Copyright (c) Facebook, Inc. and its affiliates.
+ *
+ * This source code is licensed under the MIT license found in the
+ * LICENSE file in the root directory of this source tree.
+ */
+
+#pragma once
+
+#include <cstdint>
+
+#include "BaseIRAnalyzer.h"
+#include "ControlFlow.h"
+#include "IntervalDomain.h"
+#include "PatriciaTreeMapAbstractEnvironment.h"
+
+namespace constant_propagation {
+
+namespace range {
+
+/*
+ * The range of values of a 32-bit integer register. The bounds are stored on
+ * 64 bits, so that the results of arithmetic operations can be checked for
+ * overflow before they are bound to a register.
+ *
+ * Top denotes any 32-bit value: wide registers are not tracked, and the
+ * ranges of object references only tell whether they are null.
+ */
+using IntegerRange = sparta::IntervalDomain<int64_t>;
+
+using RangeEnvironment =
+    sparta::PatriciaTreeMapAbstractEnvironment<reg_t, IntegerRange>;
+
+/*
+ * An intraprocedural range analysis of integer registers. Conditional branches
+ * refine the ranges of the compared registers along their outgoing edges, and
+ * loops are handled by the widening of intervals, which sends unstable bounds
+ * to infinity. Since the 32-bit bounds are always known, a widened bound can
+ * still be refined by the loop guard.
+ */
+class FixpointIterator final
+    : public ir_analyzer::BaseIRAnalyzer<RangeEnvironment> {
+ public:
+  explicit FixpointIterator(const cfg::ControlFlowGraph& cfg)
+      : ir_analyzer::BaseIRAnalyzer<RangeEnvironment>(cfg) {}
+
+  void analyze_instruction(const IRInstruction* insn,
+                           RangeEnvironment* env) const override;
+
+  RangeEnvironment analyze_edge(
+      const cfg::GraphInterface::EdgeId& edge,
+      const RangeEnvironment& exit_state_at_source) const override;
+
+  /*
+   * Returns the range of the register in the given environment, with the
+   * bounds of a 32-bit integer in place of infinite bounds.
+   */
+  static IntegerRange get_range(const RangeEnvironment& env, reg_t reg);
+};
+
+/*
+ * Removes the conditional branches and switch cases that the range analysis
+ * proves to be never taken, e.g., the bounds checks of indices that are
+ * masked or that are incremented from zero in a loop. Returns the number of
+ * edges removed.
+ */
+size_t remove_redundant_branches(const FixpointIterator& fp_iter,
+                                 cfg::ControlFlowGraph* cfg);
+
+} // namespace range
+
+} // namespace constant_propagation
@@ -0,0 +1,255 @@
+/*
+ * Copyright (c) Facebook, Inc. and its affiliates.
+ *
+ * This source code is licensed under the MIT license found in the
+ * LICENSE file in the root directory of this source tree.
+ */
+
+#include "SparseConstantPropagation.h"
+
+#include <algorithm>
+
+namespace constant_propagation {
+
+namespace sparse {
+
+namespace {
+
+// The value of a definition in a loop can only go up a couple of times in the
+// lattice, unless the instruction analyzer keeps refining it. This bounds the
+// number of times an instruction is re-evaluated.
+constexpr uint32_t MAX_UPDATES = 8;
+
+} // namespace
+
+constexpr uint32_t SparseConstantPropagation::UNDEFINED;
+
+SparseConstantPropagation::SparseConstantPropagation(
+    const cfg::ControlFlowGraph& cfg,
+    const intraprocedural::FixpointIterator& intra_cp)
+    : m_cfg(cfg), m_intra_cp(intra_cp), m_reaching_defs(cfg) {}
+
+uint32_t SparseConstantPropagation::get_index(const IRInstruction* insn) {
+  auto it = m_indices.find(insn);
+  if (it != m_indices.end()) {
+    return it->second;
+  }
+  uint32_t idx = m_insns.size();
+  m_indices.emplace(insn, idx);
+  m_insns.emplace_back();
+  m_insns.back().insn = const_cast<IRInstruction*>(insn);
+  return idx;
+}
+
+void SparseConstantPropagation::build_def_use_chains() {
+  m_reaching_defs.run(reaching_defs::Environment());
+  cfg::BlockId max_id = 0;
+  for (auto* block : m_cfg.blocks()) {
+    max_id = std::max(max_id, block->id());
+  }
+  m_executable_blocks.assign(max_id + 1, false);
+
+  for (auto* block : m_cfg.blocks()) {
+    auto env = m_reaching_defs.get_entry_state_at(block);
+    // A move-result may start a block, after the throw edges of its primary
+    // instruction.
+    const IRInstruction* primary = nullptr;
+    for (auto* edge : block->preds()) {
+      if (edge->type() == cfg::EDGE_GOTO) {
+        auto last_it = edge->src()->get_last_insn();
+        if (last_it != edge->src()->end() &&
+            last_it->insn->has_move_result_any()) {
+          primary = last_it->insn;
+        }
+      }
+    }
+    auto& block_insns = m_block_insns[block->id()];
+    auto last_insn = block->get_last_insn();
+    for (auto& mie : InstructionIterable(block)) {
+      auto* insn = mie.insn;
+      auto idx = get_index(insn);
+      block_insns.push_back(idx);
+      std::vector<std::vector<uint32_t>> src_defs(insn->srcs_size());
+      for (size_t i = 0; i < insn->srcs_size(); ++i) {
+        auto defs = env.get(insn->src(i));
+        if (defs.is_top()) {
+          src_defs[i].push_back(UNDEFINED);
+        } else if (!defs.is_bottom()) {
+          for (auto* def : defs.elements()) {
+            src_defs[i].push_back(get_index(def));
+          }
+        }
+      }
+      uint32_t primary_idx = UNDEFINED;
+      if (opcode::is_move_result_any(insn->opcode()) && primary != nullptr) {
+        primary_idx = get_index(primary);
+      }
+      auto& info = m_insns[idx];
+      info.block = block;
+      info.is_last = insn == last_insn->insn;
+      info.src_defs = std::move(src_defs);
+      info.primary = primary_idx;
+      m_reaching_defs.analyze_instruction(insn, &env);
+      primary = insn->has_move_result_any() ? insn : nullptr;
+    }
+  }
+
+  for (uint32_t idx = 0; idx < m_insns.size(); ++idx) {
+    const auto& info = m_insns[idx];
+    for (const auto& defs : info.src_defs) {
+      for (auto def : defs) {
+        if (def != UNDEFINED) {
+          auto& users = m_insns[def].users;
+          if (users.empty() || users.back() != idx) {
+            users.push_back(idx);
+          }
+        }
+      }
+    }
+    if (info.primary != UNDEFINED) {
+      m_insns[info.primary].users.push_back(idx);
+    }
+  }
+}
+
+ConstantValue SparseConstantPropagation::get_src_value(
+    const std::vector<uint32_t>& defs) const {
+  auto value = ConstantValue::bottom();
+  for (auto def : defs) {
+    if (def == UNDEFINED) {
+      return ConstantValue::top();
+    }
+    value.join_with(m_insns[def].value);
+  }
+  return value;
+}
+
+void SparseConstantPropagation::mark_executable(cfg::Block* block) {
+  if (!m_executable_blocks[block->id()]) {
+    m_executable_blocks[block->id()] = true;
+    m_block_worklist.push_back(block);
+  }
+}
+
+void SparseConstantPropagation::evaluate_edges(cfg::Block* block,
+                                               const ConstantEnvironment& env) {
+  for (auto* edge : block->succs()) {
+    if (!is_executable(edge->target()) &&
+        !m_intra_cp.analyze_edge(edge, env).is_bottom()) {
+      mark_executable(edge->target());
+    }
+  }
+}
+
+void SparseConstantPropagation::evaluate(uint32_t idx) {
+  auto& info = m_insns[idx];
+  auto* insn = info.insn;
+  // The registers that aren't sources of the instruction don't matter, so
+  // they are left to their initial values.
+  auto env = m_init;
+  for (size_t i = 0; i < insn->srcs_size(); ++i) {
+    const auto& defs = info.src_defs[i];
+    if (defs.size() == 1 && defs[0] == UNDEFINED) {
+      continue;
+    }
+    env.set(insn->src(i), get_src_value(defs));
+  }
+  if (opcode::is_move_result_any(insn->opcode())) {
+    env.set(RESULT_REGISTER, info.primary == UNDEFINED
+                                 ? ConstantValue::top()
+                                 : m_insns[info.primary].value);
+  }
+  m_intra_cp.analyze_instruction(insn, &env, /* is_last */ true);
+
+  if (insn->has_dest() || insn->has_move_result_any()) {
+    auto value = ConstantValue::bottom();
+    if (!env.is_bottom()) {
+      value = insn->has_move_result_any() ? env.get(RESULT_REGISTER)
+                                          : env.get(insn->dest());
+    }
+    if (!value.leq(info.value)) {
+      if (++info.updates > MAX_UPDATES) {
+        info.value.set_to_top();
+      } else {
+        info.value.join_with(value);
+      }
+      for (auto user : info.users) {
+        auto& user_info = m_insns[user];
+        if (!user_info.in_worklist) {
+          user_info.in_worklist = true;
+          m_worklist.push_back(user);
+        }
+      }
+    }
+  }
+  if (info.is_last) {
+    evaluate_edges(info.block, env);
+  }
+}
+
+void SparseConstantPropagation::run(const ConstantEnvironment& init) {
+  m_init = init;
+  build_def_use_chains();
+  mark_executable(m_cfg.entry_block());
+  while (!m_block_worklist.empty() || !m_worklist.empty()) {
+    if (!m_block_worklist.empty()) {
+      auto* block = m_block_worklist.back();
+      m_block_worklist.pop_back();
+      const auto& block_insns = m_block_insns[block->id()];
+      if (block_insns.empty()) {
+        evaluate_edges(block, m_init);
+      }
+      for (auto idx : block_insns) {
+        evaluate(idx);
+      }
+      continue;
+    }
+    auto idx = m_worklist.back();
+    m_worklist.pop_back();
+    m_insns[idx].in_worklist = false;
+    // The instructions of a block are evaluated when it becomes executable.
+    if (is_executable(m_insns[idx].block)) {
+      evaluate(idx);
+    }
+  }
+}
+
+ConstantValue SparseConstantPropagation::get_value(
+    const IRInstruction* insn) const {
+  auto it = m_indices.find(insn);
+  return it == m_indices.end() ? ConstantValue::top()
+                               : m_insns[it->second].value;
+}
+
+ConstantEnvironment SparseConstantPropagation::get_entry_state_at(
+    cfg::Block* block) const {
+  if (!is_executable(block)) {
+    return ConstantEnvironment::bottom();
+  }
+  auto env = block == m_cfg.entry_block() ? m_init : ConstantEnvironment();
+  auto defs_env = m_reaching_defs.get_entry_state_at(block);
+  if (defs_env.is_value()) {
+    for (const auto& pair : defs_env.bindings()) {
+      auto value = ConstantValue::bottom();
+      for (auto* def : pair.second.elements()) {
+        value.join_with(get_value(def));
+      }
+      // The register isn't defined along the executable paths.
+      if (value.is_bottom()) {
+        continue;
+      }
+      env.set(pair.first, value);
+    }
+  }
+  // The single edge into a block can refine the values of the registers that
+  // its source branches on.
+  const auto& preds = block->preds();
+  if (block != m_cfg.entry_block() && preds.size() == 1) {
+    env = m_intra_cp.analyze_edge(preds[0], env);
+  }
+  return env;
+}
+
+} // namespace sparse
+
+} // namespace constant_propagation
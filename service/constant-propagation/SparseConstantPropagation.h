@@ -0,0 +1,116 @@
+/*
+ * Copyright (c) Facebook, Inc. and its affiliates.
+ *
+ * This source code is licensed under the MIT license found in the
+ * LICENSE file in the root directory of this source tree.
+ */
+
+#pragma once
+
+#include <limits>
+#include <unordered_map>
+#include <vector>
+
+#include "ConstantEnvironment.h"
+#include "ConstantPropagationAnalysis.h"
+#include "ControlFlow.h"
+#include "ReachingDefinitions.h"
+
+namespace constant_propagation {
+
+namespace sparse {
+
+/*
+ * Sparse conditional constant propagation [SCCP] over the def-use chains
+ * given by the reaching definitions, instead of SSA form.
+ *
+ * The value of every definition starts at bottom, and an instruction is
+ * (re-)evaluated when its block becomes executable or when the value of one
+ * of the definitions reaching its sources changes. A source's value is the
+ * join of the values of the definitions that reach it, so the definitions of
+ * the blocks that are not executable are ignored. The successors of a block
+ * become executable when the edge to them is feasible for the values of the
+ * sources of its last instruction.
+ *
+ * The instructions are evaluated by the instruction analyzer of the dense
+ * FixpointIterator, on an environment that only binds their sources. Hence
+ * the engine does a constant amount of work per use and definition, instead
+ * of joining whole environments at every block, which matters for methods
+ * with thousands of registers and blocks, e.g. generated parsers.
+ *
+ * The environment at the entry of a block can be computed afterwards from the
+ * reaching definitions at that point.
+ *
+ *   [SCCP] M. N. Wegman and F. K. Zadeck. Constant Propagation with
+ *     Conditional Branches. TOPLAS 1991.
+ */
+class SparseConstantPropagation final {
+ public:
+  SparseConstantPropagation(const cfg::ControlFlowGraph& cfg,
+                            const intraprocedural::FixpointIterator& intra_cp);
+
+  void run(const ConstantEnvironment& init);
+
+  bool is_executable(cfg::Block* block) const {
+    return m_executable_blocks.at(block->id());
+  }
+
+  /*
+   * Returns the value of the register defined by the given instruction, or of
+   * its result if it has a move-result.
+   */
+  ConstantValue get_value(const IRInstruction* insn) const;
+
+  /*
+   * Returns the environment at the entry of the block, which is bottom for
+   * the blocks that aren't executable.
+   */
+  ConstantEnvironment get_entry_state_at(cfg::Block* block) const;
+
+ private:
+  // Marks the source of a use that may not be defined.
+  static constexpr uint32_t UNDEFINED = std::numeric_limits<uint32_t>::max();
+
+  struct Insn {
+    IRInstruction* insn;
+    cfg::Block* block;
+    bool is_last;
+    // For each source, the indices of the definitions that reach it.
+    std::vector<std::vector<uint32_t>> src_defs;
+    // The primary instruction of a move-result.
+    uint32_t primary{UNDEFINED};
+    // The instructions that use the definition.
+    std::vector<uint32_t> users;
+    ConstantValue value{ConstantValue::bottom()};
+    uint32_t updates{0};
+    bool in_worklist{false};
+  };
+
+  uint32_t get_index(const IRInstruction* insn);
+
+  ConstantValue get_src_value(const std::vector<uint32_t>& defs) const;
+
+  void build_def_use_chains();
+
+  void mark_executable(cfg::Block* block);
+
+  void evaluate(uint32_t idx);
+
+  void evaluate_edges(cfg::Block* block, const ConstantEnvironment& env);
+
+  const cfg::ControlFlowGraph& m_cfg;
+  const intraprocedural::FixpointIterator& m_intra_cp;
+  reaching_defs::FixpointIterator m_reaching_defs;
+  ConstantEnvironment m_init;
+  std::vector<Insn> m_insns;
+  std::unordered_map<const IRInstruction*, uint32_t> m_indices;
+  // The indices of the instructions of each block.
+  std::unordered_map<cfg::BlockId, std::vector<uint32_t>> m_block_insns;
+  std::vector<bool> m_executable_blocks;
+  std::vector<uint32_t> m_worklist;
+  std::vector<cfg::Block*> m_block_worklist;
+};
+
+} // namespace sparse
+
+} // namespace constant_propagation
@@ -16,6 +16,7 @@
 #ifdef __GNUC__
 #pragma GCC diagnostic pop
 #endif
+#include <boost/functional/hash.hpp>
 #include <boost/optional.hpp>
 #include <boost/range/algorithm.hpp>
 #include <boost/range/iterator_range.hpp>
@@ -299,18 +300,12 @@ reg_t AliasedRegisters::get_representative(
 
 // if `r` is in the graph, return the vertex holding it.
 // if not, return boost::none.
-// WARNING: this operation is expensive on large graphs. It's an O(n) search of
-// all the nodes.
 boost::optional<vertex_t> AliasedRegisters::find(const Value& r) const {
-  const auto& iters = boost::vertices(m_graph);
-  const auto& begin = iters.first;
-  const auto& end = iters.second;
-  for (auto it = begin; it != end; ++it) {
-    if (m_graph[*it] == r) {
-      return *it;
-    }
+  auto it = m_vertices.find(r);
+  if (it == m_vertices.end()) {
+    return boost::none;
   }
-  return boost::none;
+  return it->second;
 }
 
 // If any nodes in the same tree as `in_this_tree` have the Value `r`, then
@@ -341,6 +336,7 @@ vertex_t AliasedRegisters::find_or_create(const Value& r) {
     return *it;
   } else {
     vertex_t v = boost::add_vertex(r, m_graph);
+    m_vertices.emplace(r, v);
     return v;
   }
 }
@@ -389,6 +385,7 @@ bool AliasedRegisters::has_outgoing(vertex_t v) {
 void AliasedRegisters::clear() {
   m_graph.clear();
   m_insert_order.clear();
+  m_vertices.clear();
 }
 
 AbstractValueKind AliasedRegisters::kind() const {
@@ -679,6 +676,33 @@ bool Value::operator<(const Value& other) const {
   }
 }
 
+size_t Value::hash() const {
+  size_t seed = static_cast<size_t>(m_kind);
+  switch (m_kind) {
+  case Kind::REGISTER:
+    boost::hash_combine(seed, m_reg);
+    break;
+  case Kind::CONST_LITERAL:
+  case Kind::CONST_LITERAL_UPPER:
+    boost::hash_combine(seed, m_literal);
+    boost::hash_combine(seed, static_cast<size_t>(m_type_demand));
+    break;
+  case Kind::CONST_STRING:
+    boost::hash_combine(seed, m_str);
+    break;
+  case Kind::CONST_TYPE:
+    boost::hash_combine(seed, m_type);
+    break;
+  case Kind::STATIC_FINAL:
+  case Kind::STATIC_FINAL_UPPER:
+    boost::hash_combine(seed, m_field);
+    break;
+  case Kind::NONE:
+    break;
+  }
+  return seed;
+}
+
 // returns a string representation of this Value. Intended for debugging.
 std::string Value::str() const {
   std::ostringstream oss;
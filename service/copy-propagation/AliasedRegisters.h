@@ -18,6 +18,7 @@
 #include <boost/optional.hpp>
 #include <boost/range/iterator_range.hpp>
 #include <limits>
+#include <unordered_map>
 
 #include "AbstractDomain.h"
 #include "ConstantUses.h"
@@ -100,6 +101,7 @@ class Value {
 
   bool operator==(const Value& other) const;
   bool operator<(const Value& other) const;
+  size_t hash() const;
   std::string str() const;
 
   bool operator!=(const Value& other) const { return !(*this == other); }
@@ -119,6 +121,10 @@ class Value {
   }
 };
 
+struct ValueHash {
+  size_t operator()(const Value& value) const { return value.hash(); }
+};
+
 class AliasedRegisters final : public sparta::AbstractValue<AliasedRegisters> {
  public:
   AliasedRegisters() {}
@@ -184,6 +190,10 @@ class AliasedRegisters final : public sparta::AbstractValue<AliasedRegisters> {
   using InsertionOrder = std::unordered_map<vertex_t, size_t>;
   InsertionOrder m_insert_order;
 
+  // The vertex of each Value, so that finding one doesn't scan the graph.
+  // Vertices are never removed from the graph, only their edges are.
+  std::unordered_map<Value, vertex_t, ValueHash> m_vertices;
+
   boost::optional<vertex_t> find(const Value& r) const;
   boost::optional<vertex_t> find_in_tree(const Value& r,
                                          vertex_t in_this_tree) const;
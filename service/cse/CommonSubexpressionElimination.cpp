@@ -51,6 +51,8 @@
 
 #include "CommonSubexpressionElimination.h"
 
+#include <boost/functional/hash.hpp>
+#include <limits>
 #include <utility>
 
 #include "BaseIRAnalyzer.h"
@@ -65,6 +67,7 @@
 #include "Resolver.h"
 #include "TypeInference.h"
 #include "Walkers.h"
+#include "WorkQueue.h"
 
 using namespace sparta;
 using namespace cse_impl;
@@ -133,22 +136,109 @@ struct IRValue {
     // position, and cannot be replaced.
     const IRInstruction* positional_insn;
   };
-};
+  // Must be updated by compute_hash() once all of the above are set.
+  size_t hash{0};
 
-struct IRValueHasher {
-  size_t operator()(const IRValue& tv) const {
-    size_t hash = tv.opcode;
-    for (auto src : tv.srcs) {
-      hash = hash * 27 + src;
+  void compute_hash() {
+    hash = opcode;
+    for (auto src : srcs) {
+      boost::hash_combine(hash, src);
     }
-    hash = hash * 27 + (size_t)tv.literal;
-    return hash;
+    boost::hash_combine(hash, literal);
   }
 };
 
-bool operator==(const IRValue& a, const IRValue& b) {
-  return a.opcode == b.opcode && a.srcs == b.srcs && a.literal == b.literal;
-}
+constexpr uint32_t EMPTY_SLOT = std::numeric_limits<uint32_t>::max();
+
+/*
+ * The ids of the values that the analysis of a method has seen so far. Values
+ * are never removed, and there may be a lot of them in giant methods, so they
+ * are stored flat: their srcs are copied back to back into a single arena, and
+ * the entries are found by open addressing with linear probing on the hashes
+ * that the values carry.
+ */
+class IRValueTable {
+ public:
+  boost::optional<value_id_t> find(const IRValue& value) const {
+    if (m_slots.empty()) {
+      return boost::none;
+    }
+    for (size_t slot = first_slot(value.hash);; slot = next_slot(slot)) {
+      auto index = m_slots[slot];
+      if (index == EMPTY_SLOT) {
+        return boost::none;
+      }
+      if (matches(m_entries[index], value)) {
+        return m_entries[index].id;
+      }
+    }
+  }
+
+  // The value must not be in the table yet.
+  void insert(const IRValue& value, value_id_t id) {
+    if ((m_entries.size() + 1) * 2 > m_slots.size()) {
+      grow();
+    }
+    Entry entry;
+    entry.hash = value.hash;
+    entry.literal = value.literal;
+    entry.id = id;
+    entry.srcs_begin = m_srcs.size();
+    entry.srcs_size = value.srcs.size();
+    entry.opcode = value.opcode;
+    m_srcs.insert(m_srcs.end(), value.srcs.begin(), value.srcs.end());
+    place(entry.hash, m_entries.size());
+    m_entries.push_back(entry);
+  }
+
+  size_t size() const { return m_entries.size(); }
+
+ private:
+  struct Entry {
+    size_t hash;
+    uint64_t literal;
+    value_id_t id;
+    uint32_t srcs_begin;
+    uint32_t srcs_size;
+    IROpcode opcode;
+  };
+
+  size_t first_slot(size_t hash) const {
+    // Fibonacci hashing spreads the bits of weak hashes over the slots.
+    return (hash * 0x9E3779B97F4A7C15ull) & (m_slots.size() - 1);
+  }
+
+  size_t next_slot(size_t slot) const {
+    return (slot + 1) & (m_slots.size() - 1);
+  }
+
+  bool matches(const Entry& entry, const IRValue& value) const {
+    return entry.hash == value.hash && entry.opcode == value.opcode &&
+           entry.literal == value.literal &&
+           entry.srcs_size == value.srcs.size() &&
+           std::equal(value.srcs.begin(), value.srcs.end(),
+                      m_srcs.begin() + entry.srcs_begin);
+  }
+
+  void place(size_t hash, uint32_t index) {
+    auto slot = first_slot(hash);
+    while (m_slots[slot] != EMPTY_SLOT) {
+      slot = next_slot(slot);
+    }
+    m_slots[slot] = index;
+  }
+
+  void grow() {
+    m_slots.assign(std::max<size_t>(64, m_slots.size() * 2), EMPTY_SLOT);
+    for (uint32_t index = 0; index < m_entries.size(); ++index) {
+      place(m_entries[index].hash, index);
+    }
+  }
+
+  std::vector<Entry> m_entries;
+  std::vector<value_id_t> m_srcs;
+  std::vector<uint32_t> m_slots;
+};
 
 using IRInstructionsDomain =
     sparta::PatriciaTreeSetAbstractDomain<const IRInstruction*>;
@@ -551,9 +641,9 @@ class Analyzer final : public BaseIRAnalyzer<CseEnvironment> {
   }
 
   boost::optional<value_id_t> get_value_id(const IRValue& value) const {
-    auto it = m_value_ids.find(value);
-    if (it != m_value_ids.end()) {
-      return boost::optional<value_id_t>(it->second);
+    auto existing_id = m_value_ids.find(value);
+    if (existing_id) {
+      return existing_id;
     }
     value_id_t id = m_value_ids.size() * ValueIdFlags::BASE;
     always_assert(id / ValueIdFlags::BASE == m_value_ids.size());
@@ -574,7 +664,7 @@ class Analyzer final : public BaseIRAnalyzer<CseEnvironment> {
         id |= (src & ValueIdFlags::IS_TRACKED_LOCATION_MASK);
       }
     }
-    m_value_ids.emplace(value, id);
+    m_value_ids.insert(value, id);
     if (value.opcode == IOPCODE_POSITIONAL) {
       m_positional_insns.emplace(id, value.positional_insn);
     } else if (value.opcode == IOPCODE_PRE_STATE_SRC) {
@@ -587,6 +677,7 @@ class Analyzer final : public BaseIRAnalyzer<CseEnvironment> {
     IRValue value;
     value.opcode = OPCODE_ARRAY_LENGTH;
     value.srcs.push_back(array_value_id);
+    value.compute_hash();
     return value;
   }
 
@@ -598,6 +689,7 @@ class Analyzer final : public BaseIRAnalyzer<CseEnvironment> {
       IRValue value;
       value.opcode = (IROpcode)(insn->opcode() - OPCODE_SPUT + OPCODE_SGET);
       value.field = insn->get_field();
+      value.compute_hash();
       return value;
     } else if (is_iput(insn->opcode())) {
       always_assert(insn->srcs_size() == 2);
@@ -607,6 +699,7 @@ class Analyzer final : public BaseIRAnalyzer<CseEnvironment> {
         value.opcode = (IROpcode)(insn->opcode() - OPCODE_IPUT + OPCODE_IGET);
         value.srcs.push_back(*src1);
         value.field = insn->get_field();
+        value.compute_hash();
         return value;
       }
     } else if (is_aput(insn->opcode())) {
@@ -618,6 +711,7 @@ class Analyzer final : public BaseIRAnalyzer<CseEnvironment> {
         value.opcode = (IROpcode)(insn->opcode() - OPCODE_APUT + OPCODE_AGET);
         value.srcs.push_back(*src1);
         value.srcs.push_back(*src2);
+        value.compute_hash();
         return value;
       }
     }
@@ -629,6 +723,7 @@ class Analyzer final : public BaseIRAnalyzer<CseEnvironment> {
     value.opcode = IOPCODE_PRE_STATE_SRC;
     value.srcs.push_back(reg);
     value.positional_insn = insn;
+    value.compute_hash();
     return value;
   }
 
@@ -662,6 +757,7 @@ class Analyzer final : public BaseIRAnalyzer<CseEnvironment> {
     auto opcode = insn->opcode();
     always_assert(opcode != IOPCODE_PRE_STATE_SRC);
     value.opcode = opcode;
+    value.srcs.reserve(insn->srcs_size());
     const auto& ref_env = current_state->get_ref_env();
     for (auto reg : insn->srcs()) {
       auto c = ref_env.get(reg).get_constant();
@@ -715,6 +811,7 @@ class Analyzer final : public BaseIRAnalyzer<CseEnvironment> {
     } else if (insn->has_data()) {
       value.data = insn->get_data();
     }
+    value.compute_hash();
     return value;
   }
 
@@ -758,7 +855,7 @@ class Analyzer final : public BaseIRAnalyzer<CseEnvironment> {
   std::unordered_map<CseLocation, value_id_t, CseLocationHasher>
       m_tracked_locations;
   SharedState* m_shared_state;
-  mutable std::unordered_map<IRValue, value_id_t, IRValueHasher> m_value_ids;
+  mutable IRValueTable m_value_ids;
   mutable std::unordered_set<value_id_t> m_pre_state_value_ids;
   mutable std::unordered_map<value_id_t, const IRInstruction*>
       m_positional_insns;
@@ -988,21 +1085,128 @@ void SharedState::init_scope(const Scope& scope) {
   }
 
   init_method_barriers(scope);
+  init_invoke_summaries(scope);
+}
+
+void SharedState::init_invoke_summaries(const Scope& scope) {
+  Timer t("init_invoke_summaries");
+  ConcurrentSet<InvokeKey, InvokeKeyHasher> concurrent_keys;
+  walk::parallel::code(scope, [&](const DexMethod*, IRCode& code) {
+    std::unordered_set<InvokeKey, InvokeKeyHasher> keys;
+    for (const auto& mie : cfg::InstructionIterable(code.cfg())) {
+      auto insn = mie.insn;
+      if (is_invoke(insn->opcode())) {
+        keys.emplace(insn->get_method(), insn->opcode());
+      }
+    }
+    for (const auto& key : keys) {
+      concurrent_keys.insert(key);
+    }
+  });
+  std::vector<InvokeKey> keys(concurrent_keys.begin(), concurrent_keys.end());
+  std::vector<InvokeSummary> summaries(keys.size());
+  auto wq = workqueue_foreach<size_t>(
+      [&](size_t i) { summaries[i] = compute_invoke_summary(keys[i]); });
+  for (size_t i = 0; i < keys.size(); ++i) {
+    wq.add_item(i);
+  }
+  wq.run_all();
+  m_invoke_summaries.reserve(keys.size());
+  for (size_t i = 0; i < keys.size(); ++i) {
+    m_invoke_summaries.emplace(keys[i], std::move(summaries[i]));
+  }
+}
+
+SharedState::InvokeSummary SharedState::compute_invoke_summary(
+    const InvokeKey& key) const {
+  auto method_ref = const_cast<DexMethodRef*>(key.first);
+  auto opcode = key.second;
+  InvokeSummary summary;
+  if ((opcode == OPCODE_INVOKE_STATIC || opcode == OPCODE_INVOKE_DIRECT) &&
+      m_safe_methods.count(method_ref)) {
+    summary.safe = true;
+    return summary;
+  }
+
+  auto method = resolve_method(method_ref, opcode_to_search(opcode));
+  if (method) {
+    if ((opcode == OPCODE_INVOKE_STATIC || opcode == OPCODE_INVOKE_DIRECT ||
+         opcode == OPCODE_INVOKE_INTERFACE) &&
+        m_safe_methods.count(method)) {
+      summary.safe = true;
+      return summary;
+    }
+    if (opcode == OPCODE_INVOKE_VIRTUAL && m_safe_methods.count(method)) {
+      auto type = method->get_class();
+      auto cls = type_class(type);
+      always_assert(cls);
+      if (is_final(cls) || is_final(method)) {
+        summary.safe = true;
+        return summary;
+      }
+      summary.safe_exact_type = type;
+    }
+  }
+
+  if (opcode == OPCODE_INVOKE_SUPER) {
+    // TODO
+    summary.general_memory_barrier = true;
+    return summary;
+  }
+
+  if (!process_base_and_overriding_methods(
+          m_method_override_graph.get(), method, &m_safe_method_defs,
+          /* ignore_methods_with_assumenosideeffects */ true,
+          [&](DexMethod* other_method) {
+            auto it = m_method_written_locations.find(other_method);
+            if (it == m_method_written_locations.end()) {
+              return false;
+            }
+            summary.written_locations.insert(it->second.begin(),
+                                             it->second.end());
+            return true;
+          })) {
+    summary.general_memory_barrier = true;
+    summary.written_locations.clear();
+  }
+  return summary;
 }
 
 CseUnorderedLocationSet SharedState::get_relevant_written_locations(
     const IRInstruction* insn,
     DexType* exact_virtual_scope,
     const CseUnorderedLocationSet& read_locations) {
-  if (may_be_barrier(insn, exact_virtual_scope)) {
-    if (is_invoke(insn->opcode())) {
-      return get_relevant_written_locations(insn, read_locations);
-    } else {
-      auto barrier = make_barrier(insn);
-      if (is_barrier_relevant(barrier, read_locations)) {
-        return CseUnorderedLocationSet{get_written_location(barrier)};
+  if (is_invoke(insn->opcode())) {
+    InvokeKey key(insn->get_method(), insn->opcode());
+    auto it = m_invoke_summaries.find(key);
+    // The code that is analyzed should be in the scope, but just in case...
+    InvokeSummary computed;
+    if (it == m_invoke_summaries.end()) {
+      computed = compute_invoke_summary(key);
+    }
+    const auto& summary =
+        it == m_invoke_summaries.end() ? computed : it->second;
+    if (summary.safe || (exact_virtual_scope != nullptr &&
+                         exact_virtual_scope == summary.safe_exact_type)) {
+      return no_locations;
+    }
+    if (summary.general_memory_barrier) {
+      return general_memory_barrier_locations;
+    }
+    // Remove written locations that are not read
+    CseUnorderedLocationSet written_locations;
+    for (const auto& l : summary.written_locations) {
+      if (read_locations.count(l)) {
+        written_locations.insert(l);
       }
     }
+    return written_locations;
+  }
+  if (may_be_barrier(insn, exact_virtual_scope)) {
+    auto barrier = make_barrier(insn);
+    if (is_barrier_relevant(barrier, read_locations)) {
+      return CseUnorderedLocationSet{get_written_location(barrier)};
+    }
   }
   return no_locations;
 }
@@ -1073,45 +1277,6 @@ bool SharedState::is_invoke_safe(const IRInstruction* insn,
   return false;
 }
 
-CseUnorderedLocationSet SharedState::get_relevant_written_locations(
-    const IRInstruction* insn, const CseUnorderedLocationSet& read_locations) {
-  always_assert(is_invoke(insn->opcode()));
-
-  auto opcode = insn->opcode();
-  if (opcode == OPCODE_INVOKE_SUPER) {
-    // TODO
-    return general_memory_barrier_locations;
-  }
-
-  auto method_ref = insn->get_method();
-  DexMethod* method = resolve_method(method_ref, opcode_to_search(insn));
-  CseUnorderedLocationSet written_locations;
-  if (!process_base_and_overriding_methods(
-          m_method_override_graph.get(), method, &m_safe_method_defs,
-          /* ignore_methods_with_assumenosideeffects */ true,
-          [&](DexMethod* other_method) {
-            auto it = m_method_written_locations.find(other_method);
-            if (it == m_method_written_locations.end()) {
-              return false;
-            }
-            written_locations.insert(it->second.begin(), it->second.end());
-            return true;
-          })) {
-    return general_memory_barrier_locations;
-  }
-
-  // Remove written locations that are not read
-  for (auto it = written_locations.begin(); it != written_locations.end();) {
-    if (!read_locations.count(*it)) {
-      it = written_locations.erase(it);
-    } else {
-      it++;
-    }
-  }
-
-  return written_locations;
-}
-
 void SharedState::log_barrier(const Barrier& barrier) {
   if (m_barriers) {
     m_barriers->update(
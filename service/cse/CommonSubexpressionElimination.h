@@ -76,11 +76,30 @@ class SharedState {
   const method_override_graph::Graph* get_method_override_graph() const;
 
  private:
+  // What invoking a method ref with an opcode may write.
+  struct InvokeSummary {
+    // Safe invokes never represent barriers.
+    bool safe{false};
+    // An unsafe invoke-virtual is still safe when the receiver has exactly
+    // this type.
+    const DexType* safe_exact_type{nullptr};
+    // For unsafe invokes, either a general memory barrier, or the locations
+    // that the invoked methods may write.
+    bool general_memory_barrier{false};
+    CseUnorderedLocationSet written_locations;
+  };
+  using InvokeKey = std::pair<const DexMethodRef*, IROpcode>;
+  struct InvokeKeyHasher {
+    size_t operator()(const InvokeKey& key) const {
+      return (size_t)key.first ^ key.second;
+    }
+  };
+
   void init_method_barriers(const Scope& scope);
+  void init_invoke_summaries(const Scope& scope);
   bool may_be_barrier(const IRInstruction* insn, DexType* exact_virtual_scope);
   bool is_invoke_safe(const IRInstruction* insn, DexType* exact_virtual_scope);
-  CseUnorderedLocationSet get_relevant_written_locations(
-      const IRInstruction* insn, const CseUnorderedLocationSet& read_locations);
+  InvokeSummary compute_invoke_summary(const InvokeKey& key) const;
   // after init_scope, m_pure_methods will include m_conditionally_pure_methods
   std::unordered_set<DexMethodRef*> m_pure_methods;
   // methods which never represent barriers
@@ -90,6 +109,10 @@ class SharedState {
   std::unique_ptr<ConcurrentMap<Barrier, size_t, BarrierHasher>> m_barriers;
   std::unordered_map<const DexMethod*, CseUnorderedLocationSet>
       m_method_written_locations;
+  // The summaries of all the invokes in the scope. They are computed up front
+  // in init_scope, so the CSE workers can read them without synchronization.
+  std::unordered_map<InvokeKey, InvokeSummary, InvokeKeyHasher>
+      m_invoke_summaries;
   std::unordered_map<const DexMethod*, CseUnorderedLocationSet>
       m_conditionally_pure_methods;
   std::unique_ptr<const method_override_graph::Graph> m_method_override_graph;
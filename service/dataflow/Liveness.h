@@ -7,11 +7,16 @@
 
 #pragma once
 
+#include <unordered_map>
+#include <unordered_set>
+
 #include "BaseIRAnalyzer.h"
+#include "BitVectorSetAbstractDomain.h"
 #include "ControlFlow.h"
-#include "PatriciaTreeSetAbstractDomain.h"
 
-using LivenessDomain = sparta::PatriciaTreeSetAbstractDomain<reg_t>;
+// Registers are dense and bounded by the register frame of the method, hence
+// live sets are represented as bit vectors.
+using LivenessDomain = sparta::BitVectorSetAbstractDomain<reg_t>;
 
 class LivenessFixpointIterator final
     : public ir_analyzer::BaseBackwardsIRAnalyzer<LivenessDomain> {
@@ -19,6 +24,41 @@ class LivenessFixpointIterator final
   explicit LivenessFixpointIterator(const cfg::ControlFlowGraph& cfg)
       : ir_analyzer::BaseBackwardsIRAnalyzer<LivenessDomain>(cfg) {}
 
+  /*
+   * The code may have changed since the previous run, e.g., when the register
+   * allocator coalesces registers, so the block summaries are recomputed.
+   */
+  void run(const LivenessDomain& init) {
+    m_block_summaries.clear();
+    ir_analyzer::BaseBackwardsIRAnalyzer<LivenessDomain>::run(init);
+  }
+
+  /*
+   * Runs again after only the instructions of the given blocks changed, e.g.,
+   * when the register allocator inserts spill moves inside them. The CFG must
+   * be the same; the summaries of the other blocks are reused.
+   */
+  void rerun(const LivenessDomain& init,
+             const std::unordered_set<cfg::Block*>& changed_blocks) {
+    for (auto* block : changed_blocks) {
+      m_block_summaries.erase(block);
+    }
+    ir_analyzer::BaseBackwardsIRAnalyzer<LivenessDomain>::run(init);
+  }
+
+  /*
+   * The effect of a block on liveness is summarized as a pair of register
+   * sets, so that blocks in loops are only scanned once per run.
+   */
+  void analyze_node(const NodeId& block,
+                    LivenessDomain* current_state) const override {
+    auto it = m_block_summaries.find(block);
+    if (it == m_block_summaries.end()) {
+      it = m_block_summaries.emplace(block, summarize(block)).first;
+    }
+    current_state->difference_union_with(it->second.kill, it->second.gen);
+  }
+
   void analyze_instruction(IRInstruction* insn,
                            LivenessDomain* current_state) const override {
     if (insn->has_dest()) {
@@ -36,4 +76,34 @@ class LivenessFixpointIterator final
   LivenessDomain get_live_out_vars_at(const NodeId& block) const {
     return get_entry_state_at(block);
   }
+
+ private:
+  struct BlockSummary {
+    // The registers defined by the block before being used.
+    sparta::BitVectorSet<reg_t> kill;
+    // The registers used by the block before being defined.
+    sparta::BitVectorSet<reg_t> gen;
+  };
+
+  static BlockSummary summarize(cfg::Block* block) {
+    // Composes the effects of analyze_instruction() from the last instruction
+    // of the block to the first one.
+    BlockSummary summary;
+    for (auto it = block->rbegin(); it != block->rend(); ++it) {
+      if (it->type != MFLOW_OPCODE) {
+        continue;
+      }
+      auto insn = it->insn;
+      if (insn->has_dest()) {
+        summary.gen.remove(insn->dest());
+        summary.kill.insert(insn->dest());
+      }
+      for (size_t i = 0; i < insn->srcs_size(); ++i) {
+        summary.gen.insert(insn->src(i));
+      }
+    }
+    return summary;
+  }
+
+  mutable std::unordered_map<cfg::Block*, BlockSummary> m_block_summaries;
 };
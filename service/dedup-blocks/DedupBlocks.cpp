@@ -124,12 +124,25 @@ struct BlocksInSameGroup {
   }
 };
 
+// Consistent with BlocksInSameGroup. The successors are only hashed by the
+// kinds of their edges, as a self-loop can match an edge to the other block.
 struct BlockHasher {
   hash_t operator()(cfg::Block* b) const {
     hash_t result = 0;
     for (auto& mie : InstructionIterable(b)) {
       result = (result * 7) ^ mie.insn->hash();
     }
+    // The successors are unordered.
+    hash_t succs = 0;
+    for (const auto* succ : b->succs()) {
+      if (is_branch_or_goto(succ)) {
+        hash_t h = succ->type();
+        boost::hash_combine(h, succ->case_key().value_or(0));
+        succs += h;
+      }
+    }
+    boost::hash_combine(result, succs);
+    boost::hash_combine(result, b->is_catch());
     return result;
   }
 };
@@ -155,14 +168,6 @@ struct BlockSuccHasher {
   }
 };
 
-struct InstructionHasher {
-  hash_t operator()(IRInstruction* insn) const { return insn->hash(); }
-};
-
-struct InstructionEquals {
-  bool operator()(IRInstruction* a, IRInstruction* b) const { return *a == *b; }
-};
-
 // Choose an iteration order based on block ids for determinism. This returns a
 // vector of pointers to the entries of the Map.
 //
@@ -237,16 +242,9 @@ class DedupBlocksImpl {
   }
 
  private:
-  // Be careful using `.at()` (or similar) on this map. We use a very broad
-  // equality function that can lead to unexpected results. The key equality
-  // function of this map is actually a check that they are duplicates, not that
-  // they're the same block.
-  //
-  // Because `BlocksInSameGroup` depends on the CFG, modifications to the CFG
-  // invalidate this map.
+  // The groups of duplicate blocks, ordered by the ids of their canons.
   using BlockSet = std::set<cfg::Block*, BlockCompare>;
-  using Duplicates =
-      std::unordered_map<cfg::Block*, BlockSet, BlockHasher, BlocksInSameGroup>;
+  using Duplicates = std::vector<BlockSet>;
   struct PostfixSplitGroup {
     BlockSet postfix_blocks;
     std::map<cfg::Block*, IRList::reverse_iterator, BlockCompare>
@@ -254,7 +252,13 @@ class DedupBlocksImpl {
     size_t insn_count;
   };
 
-  // Be careful using `.at()` on this map for the same reason as on `Duplicates`
+  // Be careful using `.at()` (or similar) on this map. We use a very broad
+  // equality function that can lead to unexpected results. The key equality
+  // function of this map is actually a check that the blocks have the same
+  // successors, not that they're the same block.
+  //
+  // Because `SuccBlocksInSameGroup` depends on the CFG, modifications to the
+  // CFG invalidate this map.
   using PostfixSplitGroupMap = std::unordered_map<cfg::Block*,
                                                   PostfixSplitGroup,
                                                   BlockSuccHasher,
@@ -264,35 +268,65 @@ class DedupBlocksImpl {
 
   // Find blocks with the same exact code
   Duplicates collect_duplicates(DexMethod* method, cfg::ControlFlowGraph& cfg) {
-    const auto& blocks = cfg.blocks();
-    Duplicates duplicates;
-
-    for (cfg::Block* block : blocks) {
+    // Hash every eligible block once, and bucket the blocks by their hashes.
+    // Only the blocks of a bucket are compared with each other.
+    std::vector<std::pair<hash_t, cfg::Block*>> hashed_blocks;
+    for (cfg::Block* block : cfg.blocks()) {
       if (is_eligible(block)) {
-        // Find a group that matches this one. The key equality function of this
-        // map is actually a check that they are duplicates, not that they're
-        // the same block.
-        //
-        // For example, if Block A and Block A' are duplicates, we will
-        // populate this map as such:
-        //   * after the first iteration (inserted A)
-        //       A -> [A]
-        //   * after the second iteration (inserted A')
-        //       A -> [A, A']
-        duplicates[block].insert(block);
+        hashed_blocks.emplace_back(BlockHasher{}(block), block);
         ++m_stats.eligible_blocks;
       }
     }
+    // The blocks are in id order, so the canon of every group is its first
+    // block.
+    std::stable_sort(hashed_blocks.begin(), hashed_blocks.end(),
+                     [](const auto& a, const auto& b) {
+                       return a.first < b.first;
+                     });
+
+    Duplicates duplicates;
+    for (auto begin = hashed_blocks.begin(); begin != hashed_blocks.end();) {
+      auto end = std::find_if(begin, hashed_blocks.end(), [&](const auto& p) {
+        return p.first != begin->first;
+      });
+      if (std::next(begin) == end) {
+        begin = end;
+        continue;
+      }
+      auto bucket_begin = duplicates.size();
+      for (auto it = begin; it != end; ++it) {
+        auto* block = it->second;
+        auto group = std::find_if(
+            duplicates.begin() + bucket_begin, duplicates.end(),
+            [&](const BlockSet& g) {
+              return BlocksInSameGroup{}(*g.begin(), block);
+            });
+        if (group == duplicates.end()) {
+          duplicates.emplace_back();
+          duplicates.back().insert(block);
+        } else {
+          group->insert(block);
+        }
+      }
+      begin = end;
+    }
 
     std::unique_ptr<reaching_defs::MoveAwareFixpointIterator>
         reaching_defs_fixpoint_iter;
     std::unique_ptr<LivenessFixpointIterator> liveness_fixpoint_iter;
     std::unique_ptr<type_inference::TypeInference> type_inference;
-    remove_if(duplicates, [&](auto& blocks) {
-      return is_singleton_or_inconsistent(
-          method, blocks, cfg, reaching_defs_fixpoint_iter,
-          liveness_fixpoint_iter, type_inference);
-    });
+    duplicates.erase(
+        std::remove_if(duplicates.begin(), duplicates.end(),
+                       [&](const BlockSet& blocks) {
+                         return is_singleton_or_inconsistent(
+                             method, blocks, cfg, reaching_defs_fixpoint_iter,
+                             liveness_fixpoint_iter, type_inference);
+                       }),
+        duplicates.end());
+    std::sort(duplicates.begin(), duplicates.end(),
+              [](const BlockSet& a, const BlockSet& b) {
+                return **a.begin() < **b.begin();
+              });
     return duplicates;
   }
 
@@ -315,16 +349,9 @@ class DedupBlocksImpl {
   // canonical block
   void deduplicate(const Duplicates& dups, cfg::ControlFlowGraph& cfg) {
     fix_dex_pos_pointers(dups.begin(), dups.end(),
-                         [](auto it) { return it->second; }, cfg);
+                         [](auto it) -> const BlockSet& { return *it; }, cfg);
 
-    // Copy the BlockSets into a vector so that we're not reading the map while
-    // editing the CFG.
-    std::vector<BlockSet> order;
-    for (const Duplicates::value_type* entry : get_id_order(dups)) {
-      order.push_back(entry->second);
-    }
-
-    for (const BlockSet& group : order) {
+    for (const BlockSet& group : dups) {
       dedup_blocks(cfg, group);
     }
   }
@@ -413,9 +440,11 @@ class DedupBlocksImpl {
           "split_postfix: partitioned %d blocks into %d groups", blocks.size(),
           splitGroupMap.size());
 
+    // The blocks whose suffixes have the same rolling hash at the current
+    // depth, in id order.
     struct CountGroup {
-      size_t count = 0;
-      BlockSet blocks;
+      IRInstruction* insn;
+      std::vector<size_t> blocks;
     };
 
     // For each ([succs], [blocks]) pair
@@ -439,11 +468,16 @@ class DedupBlocksImpl {
       size_t best_insn_count = 0;
       size_t best_saved_insn = 0;
 
-      // Get (reverse) iterators for all blocks.
-      std::map<cfg::Block*, IRList::reverse_iterator, BlockCompare>
-          block_iterator_map;
+      // Get (reverse) iterators for all blocks, in id order, along with the
+      // rolling hashes of the suffixes scanned so far.
+      struct BlockIterator {
+        cfg::Block* block;
+        IRList::reverse_iterator it;
+        hash_t suffix_hash;
+      };
+      std::vector<BlockIterator> block_iterators;
       for (auto block : succ_blocks) {
-        block_iterator_map[block] = block->rbegin();
+        block_iterators.push_back({block, block->rbegin(), 0});
       }
 
       // Find the best common blocks
@@ -452,34 +486,29 @@ class DedupBlocksImpl {
         TRACE(DEDUP_BLOCKS, 4, "split_postfix: scanning instruction at %d",
               cur_insn_index);
 
-        // For each "iteration" - we count the distinct instructions and select
-        // the instruction with highest count - the majority.
-        // We do remember the instructions saved and select the best
-        // combination at the end.
-        size_t majority = 0;
-        IRInstruction* majority_insn = nullptr;
-
         // For each (Block, iterator) - advance the iterator and partition
-        // the current set of blocks into two groups:
+        // the current set of blocks by the hashes of their suffixes, and keep
         // 1) the group with the most shared instructions (majority).
         // 2) the rest.
-        // The following insn_count map maintains the (insn -> count) mapping
-        // so that we can group the blocks based on the current instruction.
+        // The blocks of the current set share their suffixes up to the
+        // current instruction, so the blocks are grouped by that instruction.
         // For example, if you have A, B, C, D, E blocks, and (A, B, C) share
         // the same instruction I1, while (D, E) share the same instruction I2,
         // you would end up with (I1 : (A, B, C), 3, and I2 : (D, E), 2).
         // With the above map, you can select I1 group (A, B, C) as the current
-        // group to track (current implementation).
+        // group to track (current implementation). The instructions are only
+        // compared when their hashes collide; a block whose instruction
+        // doesn't match is dropped.
         // @TODO - Instead of only keeping one group and calculate best savings
         // based on just one group, maintain multiple groups at the same time
         // and split/dedup those groups.
-        std::unordered_map<IRInstruction*, CountGroup, InstructionHasher,
-                           InstructionEquals>
-            insn_count;
+        std::unordered_map<hash_t, CountGroup> insn_count;
+        CountGroup* majority_group = nullptr;
 
-        for (auto& block_iterator_pair : block_iterator_map) {
-          const auto block = block_iterator_pair.first;
-          auto& it = block_iterator_pair.second;
+        for (size_t i = 0; i < block_iterators.size(); ++i) {
+          auto& block_it = block_iterators[i];
+          const auto block = block_it.block;
+          auto& it = block_it.it;
 
           // Skip all non-instructions.
           while (it != block->rend() && it->type != MFLOW_OPCODE) {
@@ -488,12 +517,17 @@ class DedupBlocksImpl {
 
           if (it != block->rend()) {
             // Count the instructions and locate the majority
-            auto& count_group = insn_count[it->insn];
-            count_group.count++;
-            count_group.blocks.insert(block);
-            if (count_group.count > majority) {
-              majority = count_group.count;
-              majority_insn = it->insn;
+            block_it.suffix_hash = block_it.suffix_hash * 31 + it->insn->hash();
+            auto& count_group = insn_count[block_it.suffix_hash];
+            if (count_group.blocks.empty()) {
+              count_group.insn = it->insn;
+            }
+            if (*count_group.insn == *it->insn) {
+              count_group.blocks.push_back(i);
+              if (majority_group == nullptr ||
+                  count_group.blocks.size() > majority_group->blocks.size()) {
+                majority_group = &count_group;
+              }
             }
 
             // Move to next instruction.
@@ -508,37 +542,36 @@ class DedupBlocksImpl {
 
         // No group to count or no one group has more than 1 item in common.
         // In either case we are done.
-        if (majority_insn == nullptr || majority <= 1) {
+        if (majority_group == nullptr || majority_group->blocks.size() <= 1) {
           break;
         }
 
         cur_insn_index++;
-        auto& majority_count_group = insn_count[majority_insn];
-
-        // Remove the iterators
-        for (auto it = block_iterator_map.begin();
-             it != block_iterator_map.end();) {
-          if (majority_count_group.blocks.find(it->first) ==
-              majority_count_group.blocks.end()) {
-            // Remove iterator that is not in the majority group
-            it = block_iterator_map.erase(it);
-          } else {
-            it++;
-          }
+
+        // Remove the iterators that are not in the majority group
+        std::vector<BlockIterator> majority_iterators;
+        majority_iterators.reserve(majority_group->blocks.size());
+        for (auto i : majority_group->blocks) {
+          majority_iterators.push_back(block_iterators[i]);
         }
+        block_iterators = std::move(majority_iterators);
 
         // Is this the best saving we've seen so far?
         // Note we only want at least 3 level deep otherwise it is probably not
         // quite worth it (configurable).
-        size_t cur_saved_insn =
-            cur_insn_index * (majority_count_group.blocks.size() - 1);
+        size_t cur_saved_insn = cur_insn_index * (block_iterators.size() - 1);
         if (cur_saved_insn > best_saved_insn &&
             cur_insn_index >= m_config->block_split_min_opcode_count) {
           // Save it
           best_saved_insn = cur_saved_insn;
           best_insn_count = cur_insn_index;
-          best_block_its = block_iterator_map;
-          best_blocks = std::move(majority_count_group.blocks);
+          best_block_its.clear();
+          best_blocks.clear();
+          for (const auto& block_it : block_iterators) {
+            best_block_its.emplace_hint(best_block_its.end(), block_it.block,
+                                        block_it.it);
+            best_blocks.insert(best_blocks.end(), block_it.block);
+          }
         }
       }
 
@@ -830,8 +863,7 @@ class DedupBlocksImpl {
   void record_stats(const Duplicates& duplicates) {
     // avoid the expensive lock if we won't actually print the information
     if (traceEnabled(DEDUP_BLOCKS, 2)) {
-      for (const auto& entry : duplicates) {
-        const auto& blocks = entry.second;
+      for (const auto& blocks : duplicates) {
         // all blocks have the same number of opcodes
         cfg::Block* block = *blocks.begin();
         m_stats.dup_sizes[num_opcodes(block)] += blocks.size();
@@ -975,9 +1007,9 @@ class DedupBlocksImpl {
 
   static void print_dups(const Duplicates& dups) {
     TRACE(DEDUP_BLOCKS, 4, "duplicate blocks set: {");
-    for (const auto& entry : dups) {
-      TRACE(DEDUP_BLOCKS, 4, "  hash = %lu", BlockHasher{}(entry.first));
-      for (cfg::Block* b : entry.second) {
+    for (const auto& blocks : dups) {
+      TRACE(DEDUP_BLOCKS, 4, "  hash = %lu", BlockHasher{}(*blocks.begin()));
+      for (cfg::Block* b : blocks) {
         TRACE(DEDUP_BLOCKS, 4, "    block %d", b->id());
         for (const MethodItemEntry& mie : *b) {
           TRACE(DEDUP_BLOCKS, 4, "      %s", SHOW(mie));
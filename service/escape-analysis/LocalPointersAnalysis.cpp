@@ -7,8 +7,11 @@
 
 #include "LocalPointersAnalysis.h"
 
+#include <algorithm>
+#include <atomic>
+
 #include "DexUtil.h"
-#include "PatriciaTreeSet.h"
+#include "GraphUtil.h"
 #include "Resolver.h"
 #include "Walkers.h"
 #include "WorkQueue.h"
@@ -389,25 +392,15 @@ void FixpointIteratorMapDeleter::operator()(FixpointIteratorMap* map) {
   wq.run_all();
 }
 
-static void analyze_method_recursive(
-    const DexMethod* method,
-    const call_graph::Graph& call_graph,
-    sparta::PatriciaTreeSet<const DexMethodRef*> visiting,
-    FixpointIteratorMap* fp_iter_map,
-    SummaryCMap* summary_map) {
-  if (!method || summary_map->count(method) != 0 || visiting.contains(method) ||
-      method->get_code() == nullptr) {
-    return;
-  }
-  visiting.insert(method);
-
+static void analyze_method(const DexMethod* method,
+                           const call_graph::Graph& call_graph,
+                           FixpointIteratorMap* fp_iter_map,
+                           SummaryCMap* summary_map) {
   std::unordered_map<const IRInstruction*, EscapeSummary> invoke_to_summary_map;
   if (call_graph.has_node(method)) {
     const auto& callee_edges = call_graph.node(method)->callees();
     for (const auto& edge : callee_edges) {
       auto* callee = edge->callee()->method();
-      analyze_method_recursive(callee, call_graph, visiting, fp_iter_map,
-                               summary_map);
       if (summary_map->count(callee) != 0) {
         invoke_to_summary_map.emplace(edge->invoke_iterator()->insn,
                                       summary_map->at(callee));
@@ -419,20 +412,10 @@ static void analyze_method_recursive(
   auto& cfg = code->cfg();
   auto fp_iter = new FixpointIterator(cfg, std::move(invoke_to_summary_map));
   fp_iter->run(Environment());
-
-  // The following updates form a critical section.
-  {
-    boost::lock_guard<boost::mutex> lock(fp_iter_map->get_lock(method));
-    fp_iter_map->update_unsafe(method,
-                               [&](auto, FixpointIterator*& v, bool exists) {
-                                 redex_assert(!(exists ^ (v != nullptr)));
-                                 delete v;
-                                 v = fp_iter;
-                               });
-    summary_map->update(method, [&](auto, EscapeSummary& v, bool) {
-      v = get_escape_summary(*fp_iter, *code);
-    });
-  }
+  summary_map->emplace(method, get_escape_summary(*fp_iter, *code));
+  // The clients of the map only query the entry states.
+  fp_iter->clear_exit_states();
+  fp_iter_map->emplace(method, fp_iter);
 }
 
 FixpointIteratorMapPtr analyze_scope(const Scope& scope,
@@ -446,10 +429,86 @@ FixpointIteratorMapPtr analyze_scope(const Scope& scope,
   summary_map_ptr->emplace(
       DexMethod::get_method("Ljava/lang/Object;.<init>:()V"), EscapeSummary{});
 
-  walk::parallel::code(scope, [&](const DexMethod* method, IRCode& code) {
-    sparta::PatriciaTreeSet<const DexMethodRef*> visiting;
-    analyze_method_recursive(method, call_graph, visiting, fp_iter_map.get(),
-                             summary_map_ptr);
+  // The methods of the call graph that still need a summary, and the calls
+  // between them.
+  auto needs_summary = [&](const DexMethod* method) {
+    return method != nullptr && method->get_code() != nullptr &&
+           summary_map_ptr->count(method) == 0;
+  };
+  std::vector<std::vector<uint32_t>> callees(call_graph.num_nodes());
+  for (uint32_t id = 0; id < call_graph.num_nodes(); ++id) {
+    auto node = call_graph.node_by_id(id);
+    if (!needs_summary(node->method())) {
+      continue;
+    }
+    for (const auto& edge : node->callees()) {
+      if (needs_summary(edge->callee()->method())) {
+        callees[id].push_back(edge->callee()->id());
+      }
+    }
+  }
+
+  // Analyze the strongly connected components of the call graph bottom-up: a
+  // component is scheduled once all the components it calls are done. Within
+  // a component, the calls to the methods that aren't analyzed yet get no
+  // summary, and are thus treated as escaping their arguments.
+  auto sccs = graph::strongly_connected_components(callees);
+  std::vector<uint32_t> node_sccs(callees.size());
+  for (uint32_t scc = 0; scc < sccs.size(); ++scc) {
+    for (auto id : sccs[scc]) {
+      node_sccs[id] = scc;
+    }
+  }
+  std::vector<std::vector<uint32_t>> callers(sccs.size());
+  std::vector<std::atomic<uint32_t>> pending(sccs.size());
+  for (uint32_t scc = 0; scc < sccs.size(); ++scc) {
+    std::vector<uint32_t> callee_sccs;
+    for (auto id : sccs[scc]) {
+      for (auto callee : callees[id]) {
+        if (node_sccs[callee] != scc) {
+          callee_sccs.push_back(node_sccs[callee]);
+        }
+      }
+    }
+    std::sort(callee_sccs.begin(), callee_sccs.end());
+    callee_sccs.erase(std::unique(callee_sccs.begin(), callee_sccs.end()),
+                      callee_sccs.end());
+    for (auto callee_scc : callee_sccs) {
+      callers[callee_scc].push_back(scc);
+    }
+    pending[scc] = callee_sccs.size();
+  }
+  auto wq = workqueue_foreach<uint32_t>(
+      [&](sparta::SpartaWorkerState<uint32_t>* worker_state, uint32_t scc) {
+        for (auto id : sccs[scc]) {
+          auto* method = call_graph.node_by_id(id)->method();
+          if (needs_summary(method)) {
+            analyze_method(method, call_graph, fp_iter_map.get(),
+                           summary_map_ptr);
+          }
+        }
+        for (auto caller : callers[scc]) {
+          if (--pending[caller] == 0) {
+            worker_state->push_task(caller);
+          }
+        }
+        return nullptr;
+      },
+      redex_parallel::default_num_threads(),
+      /* push_tasks_while_running */ true);
+  for (uint32_t scc = 0; scc < sccs.size(); ++scc) {
+    if (pending[scc] == 0) {
+      wq.add_item(scc);
+    }
+  }
+  wq.run_all();
+
+  // The methods that aren't part of the call graph don't get the summaries of
+  // their callees.
+  walk::parallel::code(scope, [&](const DexMethod* method, IRCode&) {
+    if (!call_graph.has_node(method) && needs_summary(method)) {
+      analyze_method(method, call_graph, fp_iter_map.get(), summary_map_ptr);
+    }
   });
   return fp_iter_map;
 }
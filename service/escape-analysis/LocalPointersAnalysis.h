@@ -307,10 +307,13 @@ using SummaryCMap = ConcurrentMap<const DexMethodRef*, EscapeSummary>;
 
 /*
  * Analyze all methods in scope, making sure to analyze the callees before
- * their callers.
+ * their callers. The strongly connected components of the call graph are
+ * analyzed in parallel, as soon as all the components they call are done.
  *
  * If a non-null SummaryCMap pointer is passed in, it will get populated
  * with the escape summaries of the methods in scope.
+ *
+ * The returned iterators only keep the states at the block entries.
  */
 FixpointIteratorMapPtr analyze_scope(const Scope&,
                                      const call_graph::Graph&,
@@ -8,6 +8,8 @@
 #include "LocalDce.h"
 
 #include <array>
+#include <deque>
+#include <functional>
 #include <iostream>
 #include <unordered_set>
 #include <vector>
@@ -74,59 +76,70 @@ void LocalDce::dce(IRCode* code) {
   for (cfg::Block* b : blocks) {
     liveness.emplace(b->id(), boost::dynamic_bitset<>(regs + 1));
   }
-  bool changed;
-  std::vector<std::pair<cfg::Block*, IRList::iterator>> dead_instructions;
+  auto pure_invokes = find_pure_invokes(blocks);
 
   TRACE(DCE, 5, "%s", SHOW(*cfg));
 
-  // Iterate liveness analysis to a fixed point.
-  do {
-    changed = false;
-    dead_instructions.clear();
-    for (auto& b : blocks) {
-      auto prev_liveness = liveness.at(b->id());
-      auto& bliveness = liveness.at(b->id());
-      bliveness.reset();
-      TRACE(DCE, 5, "B%lu: %s", b->id(), show(bliveness).c_str());
-
-      // Compute live-out for this block from its successors.
-      for (auto& s : b->succs()) {
-        if (s->target()->id() == b->id()) {
-          bliveness |= prev_liveness;
-        }
-        TRACE(DCE,
-              5,
-              "  S%lu: %s",
-              s->target()->id(),
-              SHOW(liveness.at(s->target()->id())));
-        bliveness |= liveness.at(s->target()->id());
+  // Computes the live-in of the block from the live-ins of its successors, and
+  // passes each instruction to `on_dead` if it isn't required.
+  using DeadCallback = std::function<void(const IRList::reverse_iterator&)>;
+  auto analyze_block = [&](cfg::Block* b,
+                           boost::dynamic_bitset<>& bliveness,
+                           const DeadCallback& on_dead) {
+    bliveness.reset();
+    for (auto& s : b->succs()) {
+      bliveness |= liveness.at(s->target()->id());
+    }
+    for (auto it = b->rbegin(); it != b->rend(); ++it) {
+      if (it->type != MFLOW_OPCODE) {
+        continue;
       }
-
-      // Compute live-in for this block by walking its instruction list in
-      // reverse and applying the liveness rules.
-      for (auto it = b->rbegin(); it != b->rend(); ++it) {
-        if (it->type != MFLOW_OPCODE) {
-          continue;
-        }
-        bool required = is_required(*cfg, b, it->insn, bliveness);
-        if (required) {
-          update_liveness(it->insn, bliveness);
-        } else {
-          // move-result-pseudo instructions will be automatically removed
-          // when their primary instruction is deleted.
-          if (!opcode::is_move_result_pseudo(it->insn->opcode())) {
-            auto forward_it = std::prev(it.base());
-            dead_instructions.emplace_back(b, forward_it);
-          }
-        }
-        TRACE(CFG, 5, "%s\n%s", show(it->insn).c_str(),
-              show(bliveness).c_str());
+      if (is_required(*cfg, b, it->insn, bliveness, pure_invokes)) {
+        update_liveness(it->insn, bliveness);
+      } else if (on_dead) {
+        on_dead(it);
       }
-      if (bliveness != prev_liveness) {
-        changed = true;
+      TRACE(CFG, 5, "%s\n%s", show(it->insn).c_str(),
+            show(bliveness).c_str());
+    }
+  };
+
+  // Iterate liveness analysis to a fixed point. Only the predecessors of the
+  // blocks whose live-in changed need to be visited again.
+  std::deque<cfg::Block*> worklist(blocks.begin(), blocks.end());
+  std::unordered_set<cfg::Block*> in_worklist(blocks.begin(), blocks.end());
+  boost::dynamic_bitset<> bliveness(regs + 1);
+  while (!worklist.empty()) {
+    auto b = worklist.front();
+    worklist.pop_front();
+    in_worklist.erase(b);
+    analyze_block(b, bliveness, nullptr);
+    auto& live_in = liveness.at(b->id());
+    TRACE(DCE, 5, "B%lu: %s", b->id(), show(bliveness).c_str());
+    if (bliveness == live_in) {
+      continue;
+    }
+    live_in.swap(bliveness);
+    for (auto& p : b->preds()) {
+      auto pred = p->src();
+      if (liveness.count(pred->id()) && in_worklist.insert(pred).second) {
+        worklist.push_back(pred);
       }
     }
-  } while (changed);
+  }
+
+  // Collect the dead instructions once, with the final liveness.
+  std::vector<std::pair<cfg::Block*, IRList::iterator>> dead_instructions;
+  for (auto& b : blocks) {
+    analyze_block(b, bliveness, [&](const IRList::reverse_iterator& it) {
+      // move-result-pseudo instructions will be automatically removed
+      // when their primary instruction is deleted.
+      if (!opcode::is_move_result_pseudo(it->insn->opcode())) {
+        auto forward_it = std::prev(it.base());
+        dead_instructions.emplace_back(b, forward_it);
+      }
+    });
+  }
 
   // Remove dead instructions.
   std::unordered_set<IRInstruction*> seen;
@@ -187,18 +200,15 @@ void LocalDce::dce(IRCode* code) {
  * An instruction is required (i.e., live) if it has side effects or if its
  * destination register is live.
  */
-bool LocalDce::is_required(cfg::ControlFlowGraph& cfg,
-                           cfg::Block* b,
-                           IRInstruction* inst,
-                           const boost::dynamic_bitset<>& bliveness) {
+bool LocalDce::is_required(
+    cfg::ControlFlowGraph& cfg,
+    cfg::Block* b,
+    IRInstruction* inst,
+    const boost::dynamic_bitset<>& bliveness,
+    const std::unordered_set<const IRInstruction*>& pure_invokes) {
   if (opcode::has_side_effects(inst->opcode())) {
     if (is_invoke(inst->opcode())) {
-      const auto meth =
-          resolve_method(inst->get_method(), opcode_to_search(inst));
-      if (meth == nullptr) {
-        return true;
-      }
-      if (!assumenosideeffects(inst->get_method(), meth)) {
+      if (!pure_invokes.count(inst)) {
         return true;
       }
       return bliveness.test(bliveness.size() - 1);
@@ -231,6 +241,28 @@ bool LocalDce::is_required(cfg::ControlFlowGraph& cfg,
   return false;
 }
 
+/*
+ * The invokes that can be removed when their result is dead. They are found
+ * once, instead of resolving every invoke in every iteration of the analysis.
+ */
+std::unordered_set<const IRInstruction*> LocalDce::find_pure_invokes(
+    const std::vector<cfg::Block*>& blocks) {
+  std::unordered_set<const IRInstruction*> pure_invokes;
+  for (auto b : blocks) {
+    for (auto& mie : InstructionIterable(b)) {
+      auto insn = mie.insn;
+      if (!is_invoke(insn->opcode())) {
+        continue;
+      }
+      auto meth = resolve_method(insn->get_method(), opcode_to_search(insn));
+      if (meth != nullptr && assumenosideeffects(insn->get_method(), meth)) {
+        pure_invokes.insert(insn);
+      }
+    }
+  }
+  return pure_invokes;
+}
+
 bool LocalDce::assumenosideeffects(DexMethodRef* ref, DexMethod* meth) {
   if (::assumenosideeffects(meth)) {
     return true;
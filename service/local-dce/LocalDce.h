@@ -34,17 +34,20 @@ class LocalDce {
    * - Maintain a bitvector for each block representing the liveness for each
    *   register.  Function call results are represented by bit #num_regs.
    *
-   * - Walk the blocks in postorder. Compute each block's output state by
+   * - Visit the blocks in postorder. Compute each block's output state by
    *   OR-ing the liveness of its successors
    *
    * - Walk each block's instructions in reverse to determine its input state.
    *   An instruction's input registers are live if (a) it has side effects, or
    *   (b) its output registers are live.
    *
-   * - If the liveness of any block changes during a pass, repeat it.  Since
-   *   anything live in one pass is guaranteed to be live in the next, this is
-   *   guaranteed to reach a fixed point and terminate.  Visiting blocks in
-   *   postorder guarantees a minimum number of passes.
+   * - If the liveness of a block changes, visit its predecessors again.
+   *   Since anything live in one visit is guaranteed to be live in the next,
+   *   this is guaranteed to reach a fixed point and terminate.  Visiting
+   *   blocks in postorder first minimizes the number of visits.
+   *
+   * - Once at the fixed point, walk each block once more to collect the
+   *   instructions that are not required, and remove them.
    *
    * - Catch blocks are handled slightly differently; since any instruction
    *   inside a `try` region can jump to a catch block, we assume that any
@@ -71,9 +74,13 @@ class LocalDce {
   const bool m_may_allocate_registers;
   Stats m_stats;
 
-  bool is_required(cfg::ControlFlowGraph& cfg,
-                   cfg::Block* b,
-                   IRInstruction* inst,
-                   const boost::dynamic_bitset<>& bliveness);
+  bool is_required(
+      cfg::ControlFlowGraph& cfg,
+      cfg::Block* b,
+      IRInstruction* inst,
+      const boost::dynamic_bitset<>& bliveness,
+      const std::unordered_set<const IRInstruction*>& pure_invokes);
+  std::unordered_set<const IRInstruction*> find_pure_invokes(
+      const std::vector<cfg::Block*>& blocks);
   bool assumenosideeffects(DexMethodRef* ref, DexMethod* meth);
 };
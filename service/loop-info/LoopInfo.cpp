@@ -204,6 +204,12 @@ LoopInfo::LoopInfo(cfg::ControlFlowGraph& cfg) {
   }
 }
 
+LoopInfo::~LoopInfo() {
+  for (auto loop : m_loops) {
+    delete loop;
+  }
+}
+
 /**
  * Returns the innermost loop that contains block, or nullptr if block is not
  * contained in a loop
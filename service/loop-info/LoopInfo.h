@@ -130,6 +130,7 @@ class LoopInfo {
   using iterator = std::vector<Loop*>::iterator;
   using reverse_iterator = std::vector<Loop*>::reverse_iterator;
   explicit LoopInfo(cfg::ControlFlowGraph& cfg);
+  ~LoopInfo();
   Loop* get_loop_for(cfg::Block* block);
   size_t num_loops();
   iterator begin();
@@ -138,6 +139,8 @@ class LoopInfo {
   reverse_iterator rend();
 
  private:
+  LoopInfo(const LoopInfo&) = delete;
+  const LoopInfo& operator=(const LoopInfo&) = delete;
   std::vector<Loop*> m_loops;
   std::unordered_map<cfg::Block*, int> m_loop_depth;
   std::unordered_map<cfg::Block*, Loop*> m_block_location;
@@ -7,47 +7,51 @@
 
 #include "MethodDedup.h"
 
+#include <algorithm>
+
+#include "DexHasher.h"
 #include "IRCode.h"
 #include "MethodReference.h"
+#include "WorkQueue.h"
 
 namespace {
 
-struct CodeAsKey {
-  IRCode* code;
-
-  explicit CodeAsKey(IRCode* c) : code(c) {}
-
-  bool operator==(const CodeAsKey& other) const {
-    return code->structural_equals(*other.code);
-  }
-};
-
-struct CodeHasher {
-  size_t operator()(const CodeAsKey& key) const {
-    size_t result = 0;
-    for (auto& mie : InstructionIterable(key.code)) {
-      result ^= mie.insn->hash();
-    }
-    return result;
-  }
-};
-
-using DuplicateMethods =
-    std::unordered_map<CodeAsKey, MethodOrderedSet, CodeHasher>;
+// Below this number of methods, the hashes are computed serially.
+constexpr size_t MIN_METHODS_TO_HASH_IN_PARALLEL = 256;
 
+// Only the methods whose code has the same hash are compared.
 std::vector<MethodOrderedSet> get_duplicate_methods_simple(
-    const MethodOrderedSet& methods) {
-  DuplicateMethods duplicates;
+    const MethodOrderedSet& methods,
+    const std::unordered_map<const DexMethod*, size_t>& code_hashes) {
+  std::unordered_map<size_t, std::vector<MethodOrderedSet>> buckets;
   for (DexMethod* method : methods) {
     always_assert(method->get_code());
-    duplicates[CodeAsKey(method->get_code())].emplace(method);
+    auto& groups = buckets[code_hashes.at(method)];
+    auto it = std::find_if(
+        groups.begin(), groups.end(), [&](const MethodOrderedSet& group) {
+          return (*group.begin())
+              ->get_code()
+              ->structural_equals(*method->get_code());
+        });
+    if (it == groups.end()) {
+      groups.emplace_back();
+      it = std::prev(groups.end());
+    }
+    it->emplace(method);
   }
 
   std::vector<MethodOrderedSet> result;
-  for (auto& duplicate : duplicates) {
-    result.push_back(std::move(duplicate.second));
+  for (auto& bucket : buckets) {
+    for (auto& group : bucket.second) {
+      result.push_back(std::move(group));
+    }
   }
-
+  // The methods are visited in order, so the groups are ordered by their
+  // first methods.
+  std::sort(result.begin(), result.end(),
+            [](const MethodOrderedSet& a, const MethodOrderedSet& b) {
+              return compare_dexmethods(*a.begin(), *b.begin());
+            });
   return result;
 }
 
@@ -89,10 +93,31 @@ std::vector<MethodOrderedSet> group_identical_methods(
   std::vector<MethodOrderedSet> result;
   std::vector<MethodOrderedSet> same_protos = group_similar_methods(methods);
 
+  // Hash the code of all methods upfront.
+  std::vector<size_t> hashes(methods.size());
+  auto hash_code = [&](size_t i) {
+    hashes[i] = hashing::hash_code_structure(methods[i]->get_code());
+  };
+  if (methods.size() < MIN_METHODS_TO_HASH_IN_PARALLEL) {
+    for (size_t i = 0; i < methods.size(); ++i) {
+      hash_code(i);
+    }
+  } else {
+    auto wq = workqueue_foreach<size_t>(hash_code);
+    for (size_t i = 0; i < methods.size(); ++i) {
+      wq.add_item(i);
+    }
+    wq.run_all();
+  }
+  std::unordered_map<const DexMethod*, size_t> code_hashes;
+  for (size_t i = 0; i < methods.size(); ++i) {
+    code_hashes.emplace(methods[i], hashes[i]);
+  }
+
   // Find actual duplicates.
   for (const auto& same_proto : same_protos) {
     std::vector<MethodOrderedSet> duplicates =
-        get_duplicate_methods_simple(same_proto);
+        get_duplicate_methods_simple(same_proto, code_hashes);
 
     result.insert(result.end(), duplicates.begin(), duplicates.end());
   }
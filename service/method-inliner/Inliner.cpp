@@ -57,6 +57,11 @@ const size_t MAX_COST_FOR_CONSTANT_PROPAGATION = 272;
 // variations before parallelizing constant-propagation.
 const size_t MIN_COST_FOR_PARALLELIZATION = 1977;
 
+// The priority of a callee in the asynchronous inliner is the length of its
+// critical path, i.e. how many methods transitively wait for it, shifted by
+// this many bits to make room for a tie-breaker.
+constexpr int CRITICAL_PATH_PRIORITY_SHIFT = 16;
+
 /*
  * This is the maximum size of method that Dex bytecode can encode.
  * The table of instructions is indexed by a 32 bit unsigned integer.
@@ -88,16 +93,25 @@ MultiMethodInliner::MultiMethodInliner(
     const std::unordered_map<const DexMethod*, size_t>*
         same_method_implementations,
     bool analyze_and_prune_inits,
-    const std::unordered_set<DexMethodRef*>& configured_pure_methods)
+    const std::unordered_set<DexMethodRef*>& configured_pure_methods,
+    AnalysisCache* analysis_cache,
+    const std::unordered_set<const IRInstruction*>* cold_insns)
     : resolver(std::move(resolve_fn)),
       xstores(stores),
       m_scope(scope),
       m_config(config),
       m_mode(mode),
-      m_inline_for_speed(method_profiles),
+      m_inline_for_speed(method_profiles, cold_insns),
       m_same_method_implementations(same_method_implementations),
-      m_pure_methods(get_pure_methods()),
-      m_analyze_and_prune_inits(analyze_and_prune_inits) {
+      m_analyze_and_prune_inits(analyze_and_prune_inits),
+      m_shrinker(scope,
+                 &xstores,
+                 shrinker::ShrinkerConfig{
+                     config.run_const_prop, config.run_cse,
+                     config.run_copy_prop, config.run_local_dce,
+                     config.run_dedup_blocks},
+                 configured_pure_methods,
+                 analysis_cache) {
   for (const auto& callee_callers : true_virtual_callers) {
     for (const auto& caller_insns : callee_callers.second) {
       for (auto insn : caller_insns.second) {
@@ -173,38 +187,6 @@ MultiMethodInliner::MultiMethodInliner(
       }
     }
   }
-
-  m_shrinking_enabled = m_config.run_const_prop || m_config.run_cse ||
-                        m_config.run_copy_prop || m_config.run_local_dce ||
-                        m_config.run_dedup_blocks;
-
-  if (m_config.run_cse || m_config.run_local_dce) {
-    m_pure_methods.insert(configured_pure_methods.begin(),
-                          configured_pure_methods.end());
-    auto rstate_pure_method = get_rstate_pure_methods(scope);
-    m_pure_methods.insert(rstate_pure_method.begin(), rstate_pure_method.end());
-    if (m_config.run_cse) {
-      m_cse_shared_state =
-          std::make_unique<cse_impl::SharedState>(m_pure_methods);
-    }
-    if (m_config.run_local_dce) {
-      std::unique_ptr<const method_override_graph::Graph> owned_override_graph;
-      const method_override_graph::Graph* override_graph;
-      if (m_config.run_cse) {
-        override_graph = m_cse_shared_state->get_method_override_graph();
-      } else {
-        owned_override_graph = method_override_graph::build_graph(scope);
-        override_graph = owned_override_graph.get();
-      }
-      std::unordered_set<const DexMethod*> computed_no_side_effects_methods;
-      auto computed_no_side_effects_methods_iterations =
-          compute_no_side_effects_methods(scope, override_graph, m_pure_methods,
-                                          &computed_no_side_effects_methods);
-      for (auto m : computed_no_side_effects_methods) {
-        m_pure_methods.insert(const_cast<DexMethod*>(m));
-      }
-    }
-  }
 }
 
 /*
@@ -381,7 +363,11 @@ void MultiMethodInliner::inline_methods() {
     auto& callee_priority = m_async_callee_priorities[callee];
     info.critical_path_length =
         std::max(info.critical_path_length, callee_priority);
-    callee_priority = (callee_priority << 16) + callers.size();
+    // The length of the critical path comes first; among callees with equally
+    // long paths, the ones that unblock more callers go first.
+    callee_priority = (callee_priority << CRITICAL_PATH_PRIORITY_SHIFT) +
+                      std::min<size_t>(callers.size(),
+                                       (1 << CRITICAL_PATH_PRIORITY_SHIFT) - 1);
   }
 
   // Kick off (shrinking and) pre-computing the should-inline cache.
@@ -396,7 +382,7 @@ void MultiMethodInliner::inline_methods() {
     }
   }
 
-  if (m_shrinking_enabled && m_config.shrink_other_methods) {
+  if (m_shrinker.enabled() && m_config.shrink_other_methods) {
     walk::code(m_scope, [&](DexMethod* method, IRCode& code) {
       // If a method is not tracked as a caller, and not already in the
       // processing pool because it's a callee, then process it.
@@ -410,6 +396,18 @@ void MultiMethodInliner::inline_methods() {
   m_async_method_executor.join();
   delayed_change_visibilities();
   info.waited_seconds = m_async_method_executor.get_waited_seconds();
+  for (auto& p : m_async_method_executor.get_queue_wait_stats()) {
+    // Work items of callers that aren't callees, delayed shrinking, and nested
+    // work all go to depth 0.
+    auto priority = p.first;
+    int depth = priority > 0 && priority < std::numeric_limits<int>::max()
+                    ? priority >> CRITICAL_PATH_PRIORITY_SHIFT
+                    : 0;
+    auto& stats = info.queue_wait_by_critical_path_depth[depth];
+    stats.work_items += p.second.work_items;
+    stats.total += p.second.total;
+    stats.max = std::max(stats.max, p.second.max);
+  }
 }
 
 size_t MultiMethodInliner::compute_caller_nonrecursive_callees_by_stack_depth(
@@ -432,6 +430,10 @@ size_t MultiMethodInliner::compute_caller_nonrecursive_callees_by_stack_depth(
 
   std::vector<DexMethod*> nonrecursive_callees;
   nonrecursive_callees.reserve(callees.size());
+  std::unordered_map<const DexMethodRef*, double> call_site_weights;
+  if (for_speed()) {
+    call_site_weights = m_inline_for_speed.get_call_site_weights(caller);
+  }
   size_t stack_depth = 0;
   // recurse into the callees in case they have something to inline on
   // their own. We want to inline bottom up so that a callee is
@@ -453,8 +455,13 @@ size_t MultiMethodInliner::compute_caller_nonrecursive_callees_by_stack_depth(
 
     if (!for_speed()) {
       nonrecursive_callees.push_back(callee);
-    } else if (m_inline_for_speed.should_inline(caller, callee)) {
-      nonrecursive_callees.push_back(callee);
+    } else {
+      // The true virtual call sites don't resolve to the callee.
+      auto it = call_site_weights.find(callee);
+      auto site_weight = it == call_site_weights.end() ? 1.0 : it->second;
+      if (m_inline_for_speed.should_inline(caller, callee, site_weight)) {
+        nonrecursive_callees.push_back(callee);
+      }
     }
 
     stack_depth = std::max(stack_depth, callee_stack_depth + 1);
@@ -748,6 +755,7 @@ void MultiMethodInliner::inline_inlinables(
       }
       m_inlined.insert(callee_method);
     }
+    invalidate_callee_caches(caller_method);
   }
 
   for (IRCode* code : need_deconstruct) {
@@ -775,7 +783,7 @@ void MultiMethodInliner::async_prioritized_method_execute(
 
 void MultiMethodInliner::async_postprocess_method(DexMethod* method) {
   if (m_async_callee_priorities.count(method) == 0 &&
-      (!m_shrinking_enabled || method->rstate.no_optimizations())) {
+      (!m_shrinker.enabled() || method->rstate.no_optimizations())) {
     return;
   }
 
@@ -784,101 +792,14 @@ void MultiMethodInliner::async_postprocess_method(DexMethod* method) {
 }
 
 void MultiMethodInliner::shrink_method(DexMethod* method) {
-  auto code = method->get_code();
-  bool editable_cfg_built = code->editable_cfg_built();
-
-  constant_propagation::Transform::Stats const_prop_stats;
-  cse_impl::Stats cse_stats;
-  copy_propagation_impl::Stats copy_prop_stats;
-  LocalDce::Stats local_dce_stats;
-  dedup_blocks_impl::Stats dedup_blocks_stats;
-
-  if (m_config.run_const_prop) {
-    if (editable_cfg_built) {
-      code->clear_cfg();
-    }
-    if (!code->cfg_built()) {
-      code->build_cfg(/* editable */ false);
-    }
-    {
-      constant_propagation::intraprocedural::FixpointIterator fp_iter(
-          code->cfg(), constant_propagation::ConstantPrimitiveAnalyzer());
-      fp_iter.run(ConstantEnvironment());
-      constant_propagation::Transform::Config config;
-      constant_propagation::Transform tf(config);
-      const_prop_stats = tf.apply_on_uneditable_cfg(
-          fp_iter, constant_propagation::WholeProgramState(), code, &xstores,
-          method->get_class());
-    }
-    always_assert(!code->editable_cfg_built());
-    code->build_cfg(/* editable */ true);
-    code->cfg().calculate_exit_block();
-    {
-      constant_propagation::intraprocedural::FixpointIterator fp_iter(
-          code->cfg(), constant_propagation::ConstantPrimitiveAnalyzer());
-      fp_iter.run(ConstantEnvironment());
-      constant_propagation::Transform::Config config;
-      constant_propagation::Transform tf(config);
-      const_prop_stats += tf.apply(fp_iter, code->cfg(), method, &xstores);
-    }
-  }
-
-  if (m_config.run_cse) {
-    if (!code->editable_cfg_built()) {
-      code->build_cfg(/* editable */ true);
-    }
-
-    cse_impl::CommonSubexpressionElimination cse(
-        m_cse_shared_state.get(), code->cfg(), is_static(method),
-        method::is_init(method) || method::is_clinit(method),
-        method->get_class(), method->get_proto()->get_args());
-    cse.patch();
-    cse_stats = cse.get_stats();
-  }
-
-  if (m_config.run_copy_prop) {
-    copy_propagation_impl::Config config;
-    copy_propagation_impl::CopyPropagation copy_propagation(config);
-    copy_prop_stats = copy_propagation.run(code, method);
-  }
-
-  if (m_config.run_local_dce) {
-    // LocalDce doesn't care if editable_cfg_built
-    auto local_dce = LocalDce(m_pure_methods);
-    local_dce.dce(code);
-    local_dce_stats = local_dce.get_stats();
-  }
-
-  if (m_config.run_dedup_blocks) {
-    if (!code->editable_cfg_built()) {
-      code->build_cfg(/* editable */ true);
-    }
-
-    dedup_blocks_impl::Config config;
-    dedup_blocks_impl::DedupBlocks dedup_blocks(&config, method);
-    dedup_blocks.run();
-    dedup_blocks_stats = dedup_blocks.get_stats();
-  }
-
-  if (editable_cfg_built && !code->editable_cfg_built()) {
-    code->build_cfg(/* editable */ true);
-  } else if (!editable_cfg_built && code->editable_cfg_built()) {
-    code->clear_cfg();
-  }
-
-  std::lock_guard<std::mutex> guard(m_stats_mutex);
-  m_const_prop_stats += const_prop_stats;
-  m_cse_stats += cse_stats;
-  m_copy_prop_stats += copy_prop_stats;
-  m_local_dce_stats += local_dce_stats;
-  m_dedup_blocks_stats += dedup_blocks_stats;
-  m_methods_shrunk++;
+  m_shrinker.shrink_method(method);
+  invalidate_callee_caches(method);
 }
 
 void MultiMethodInliner::postprocess_method(DexMethod* method) {
   bool delayed_shrinking = false;
   bool is_callee = !!m_async_callee_priorities.count(method);
-  if (m_shrinking_enabled && !method->rstate.no_optimizations()) {
+  if (m_shrinker.enabled() && !method->rstate.no_optimizations()) {
     if (is_callee && should_inline_fast(method)) {
       // We know now that this method will get inlined regardless of the size
       // of its code. Therefore, we can delay shrinking, to unblock further
@@ -940,7 +861,7 @@ void MultiMethodInliner::decrement_caller_wait_counts(
           auto& callees = m_async_caller_callees.at(caller);
           caller_inline(caller, callees);
           decrement_delayed_shrinking_callee_wait_counts(callees);
-          if (m_shrinking_enabled ||
+          if (m_shrinker.enabled() ||
               m_async_callee_priorities.count(caller) != 0) {
             postprocess_method(caller);
           }
@@ -1158,6 +1079,30 @@ bool MultiMethodInliner::should_inline(const DexMethod* callee) {
   return *res;
 }
 
+size_t MultiMethodInliner::get_callee_version(const DexMethod* callee) const {
+  return m_callee_versions.get(callee, 0);
+}
+
+void MultiMethodInliner::invalidate_callee_caches(const DexMethod* method) {
+  // Bump the version first, so that a concurrent computation that started
+  // with the old body doesn't put its result back after we erased it.
+  m_callee_versions.update(
+      method, [](const DexMethod*, size_t& version, bool /* exists */) {
+        version++;
+      });
+  m_inlined_costs.erase(method);
+  m_inlined_costs_keyed.erase(method);
+  if (m_callee_insn_sizes) {
+    m_callee_insn_sizes->erase(method);
+  }
+  if (m_callee_type_refs) {
+    m_callee_type_refs->erase(method);
+  }
+  if (m_callee_method_refs) {
+    m_callee_method_refs->erase(method);
+  }
+}
+
 size_t MultiMethodInliner::get_callee_insn_size(const DexMethod* callee) {
   if (m_callee_insn_sizes) {
     const auto absent = std::numeric_limits<size_t>::max();
@@ -1167,10 +1112,11 @@ size_t MultiMethodInliner::get_callee_insn_size(const DexMethod* callee) {
     }
   }
 
+  auto version = get_callee_version(callee);
   const IRCode* code = callee->get_code();
   auto size = code->editable_cfg_built() ? code->cfg().sum_opcode_sizes()
                                          : code->sum_opcode_sizes();
-  if (m_callee_insn_sizes) {
+  if (m_callee_insn_sizes && get_callee_version(callee) == version) {
     m_callee_insn_sizes->emplace(callee, size);
   }
   return size;
@@ -1359,6 +1305,7 @@ size_t MultiMethodInliner::get_inlined_cost(const DexMethod* callee) {
     return *opt_inlined_cost;
   }
 
+  auto version = get_callee_version(callee);
   std::atomic<size_t> callees_analyzed{0};
   std::atomic<size_t> callees_unreachable_blocks{0};
   std::atomic<size_t> inlined_cost{
@@ -1390,18 +1337,28 @@ size_t MultiMethodInliner::get_inlined_cost(const DexMethod* callee) {
     if (callee_constant_arguments.size() > 1 &&
         callee_constant_arguments.size() * inlined_cost >=
             MIN_COST_FOR_PARALLELIZATION) {
-      // TODO: This parallelization happens independently (in addition to) the
-      // parallelization via m_async_method_executor. This should be combined,
-      // using a single thread pool.
       inlined_cost = 0;
-      auto num_threads = std::min(redex_parallel::default_num_threads(),
-                                  callee_constant_arguments.size());
-      auto wq = workqueue_foreach<ConstantArgumentsOccurrences>(process_key,
-                                                                num_threads);
-      for (auto& p : callee_constant_arguments) {
-        wq.add_item(p);
+      if (m_async_method_executor.get_num_threads() > 0) {
+        // We are (likely) running as part of the asynchronous inlining, so
+        // share its threads instead of oversubscribing the machine.
+        std::vector<std::function<void()>> tasks;
+        tasks.reserve(callee_constant_arguments.size());
+        for (auto& p : callee_constant_arguments) {
+          tasks.emplace_back([&process_key, &p]() { process_key(p); });
+        }
+        // Some thread is waiting for the results, so don't delay them.
+        m_async_method_executor.run_nested(std::numeric_limits<int>::max(),
+                                           std::move(tasks));
+      } else {
+        auto num_threads = std::min(redex_parallel::default_num_threads(),
+                                    callee_constant_arguments.size());
+        auto wq = workqueue_foreach<ConstantArgumentsOccurrences>(process_key,
+                                                                  num_threads);
+        for (auto& p : callee_constant_arguments) {
+          wq.add_item(p);
+        }
+        wq.run_all();
       }
-      wq.run_all();
     } else {
       inlined_cost = 0;
       for (auto& p : callee_constant_arguments) {
@@ -1411,12 +1368,19 @@ size_t MultiMethodInliner::get_inlined_cost(const DexMethod* callee) {
 
     always_assert(callees_analyzed > 0);
     inlined_cost = inlined_cost / callees_analyzed;
+  }
+  TRACE(INLINE, 4, "[too_many_callers] get_inlined_cost %s: %u", SHOW(callee),
+        (size_t)inlined_cost);
+  if (get_callee_version(callee) != version) {
+    // The callee was mutated while we were looking at it; don't cache what
+    // may already be stale.
+    return inlined_cost;
+  }
+  if (callees_analyzed > 0) {
     m_inlined_costs_keyed.emplace(
         callee, std::make_shared<std::unordered_map<std::string, size_t>>(
                     inlined_costs_keyed.begin(), inlined_costs_keyed.end()));
   }
-  TRACE(INLINE, 4, "[too_many_callers] get_inlined_cost %s: %u", SHOW(callee),
-        (size_t)inlined_cost);
   m_inlined_costs.update(
       callee,
       [&](const DexMethod*, boost::optional<size_t>& value, bool exists) {
@@ -1583,6 +1547,12 @@ bool MultiMethodInliner::should_inline_optional(
   auto& constant_arguments = m_call_constant_arguments.at_unsafe(invoke_insn);
   auto opt_inlined_costs_keyed = m_inlined_costs_keyed.get(
       callee, std::shared_ptr<std::unordered_map<std::string, size_t>>());
+  if (!opt_inlined_costs_keyed && !m_inlined_costs.count(callee)) {
+    // The costs were invalidated when the callee was last mutated.
+    get_inlined_cost(callee);
+    opt_inlined_costs_keyed = m_inlined_costs_keyed.get(
+        callee, std::shared_ptr<std::unordered_map<std::string, size_t>>());
+  }
   if (!opt_inlined_costs_keyed) {
     return false;
   }
@@ -1864,6 +1834,7 @@ std::vector<DexType*> MultiMethodInliner::get_callee_type_refs(
     }
   }
 
+  auto version = get_callee_version(callee);
   std::unordered_set<DexType*> type_refs_set;
   editable_cfg_adapter::iterate(
       callee->get_code(), [&](const MethodItemEntry& mie) {
@@ -1898,7 +1869,7 @@ std::vector<DexType*> MultiMethodInliner::get_callee_type_refs(
     type_refs.push_back(type);
   }
 
-  if (m_callee_type_refs) {
+  if (m_callee_type_refs && get_callee_version(callee) == version) {
     m_callee_type_refs->emplace(callee, type_refs);
   }
   return type_refs;
@@ -1913,6 +1884,7 @@ size_t MultiMethodInliner::get_callee_method_refs(const DexMethod* callee) {
     }
   }
 
+  auto version = get_callee_version(callee);
   std::unordered_set<DexMethodRef*> method_refs_set;
   editable_cfg_adapter::iterate(
       callee->get_code(), [&](const MethodItemEntry& mie) {
@@ -1927,7 +1899,7 @@ size_t MultiMethodInliner::get_callee_method_refs(const DexMethod* callee) {
         return editable_cfg_adapter::LOOP_CONTINUE;
       });
 
-  if (m_callee_method_refs) {
+  if (m_callee_method_refs && get_callee_version(callee) == version) {
     m_callee_method_refs->emplace(callee, method_refs_set.size());
   }
   return method_refs_set.size();
@@ -28,6 +28,7 @@
 #include "PatriciaTreeSet.h"
 #include "PriorityThreadPool.h"
 #include "Resolver.h"
+#include "Shrinker.h"
 
 namespace inliner {
 
@@ -146,7 +147,9 @@ class MultiMethodInliner {
       const std::unordered_map<const DexMethod*, size_t>*
           same_method_implementations = nullptr,
       bool analyze_and_prune_inits = false,
-      const std::unordered_set<DexMethodRef*>& configured_pure_methods = {});
+      const std::unordered_set<DexMethodRef*>& configured_pure_methods = {},
+      AnalysisCache* analysis_cache = nullptr,
+      const std::unordered_set<const IRInstruction*>* cold_insns = nullptr);
 
   ~MultiMethodInliner() { delayed_invoke_direct_to_static(); }
 
@@ -339,6 +342,18 @@ class MultiMethodInliner {
    */
   bool should_inline_fast(const DexMethod* callee);
 
+  /**
+   * The version of the body of a method, which changes whenever the method is
+   * mutated by inlining or shrinking.
+   */
+  size_t get_callee_version(const DexMethod* callee) const;
+
+  /**
+   * Drop all cached costs of a method whose body just changed. They will be
+   * recomputed on demand.
+   */
+  void invalidate_callee_caches(const DexMethod* method);
+
   /**
    * Gets the number of instructions in a callee.
    */
@@ -533,7 +548,6 @@ class MultiMethodInliner {
       m_async_delayed_shrinking_callee_wait_counts;
 
   // Whether any of const-prop/cs/copy-prop/local-dce are enabled.
-  bool m_shrinking_enabled{0};
 
   // Set of methods that need to be made static eventually. The destructor
   // of this class will do the necessary delayed work.
@@ -547,6 +561,10 @@ class MultiMethodInliner {
   // When calling change_visibility eagerly
   std::mutex m_change_visibility_mutex;
 
+  // Versions of the bodies of the methods that have been mutated; methods
+  // that were never mutated are at version 0.
+  mutable ConcurrentMap<const DexMethod*, size_t> m_callee_versions;
+
   // Cache for should_inline function
   ConcurrentMap<const DexMethod*, boost::optional<bool>> m_should_inline;
 
@@ -568,16 +586,6 @@ class MultiMethodInliner {
   mutable ConcurrentMap<const DexMethod*, boost::optional<bool>>
       m_can_inline_init;
 
-  constant_propagation::Transform::Stats m_const_prop_stats;
-  cse_impl::Stats m_cse_stats;
-  copy_propagation_impl::Stats m_copy_prop_stats;
-  LocalDce::Stats m_local_dce_stats;
-  dedup_blocks_impl::Stats m_dedup_blocks_stats;
-  size_t m_methods_shrunk{0};
-
-  // When mutating service stats while inlining in parallel
-  std::mutex m_stats_mutex;
-
  private:
   /**
    * Info about inlining.
@@ -588,6 +596,10 @@ class MultiMethodInliner {
     size_t max_call_stack_depth{0};
     size_t waited_seconds{0};
     int critical_path_length{0};
+    // How long work items waited in the queue of the asynchronous inliner, by
+    // the length of their critical path.
+    std::map<int, PriorityThreadPool::QueueWaitStats>
+        queue_wait_by_critical_path_depth;
 
     // statistics that may be incremented concurrently
     std::atomic<size_t> calls_inlined{0};
@@ -628,29 +640,29 @@ class MultiMethodInliner {
   const std::unordered_map<const DexMethod*, size_t>*
       m_same_method_implementations;
 
-  std::unordered_set<DexMethodRef*> m_pure_methods;
-
   // Whether to do some deep analysis to determine if constructor candidates
   // can be safely inlined, and don't inline them otherwise.
   bool m_analyze_and_prune_inits;
 
-  std::unique_ptr<cse_impl::SharedState> m_cse_shared_state;
+  shrinker::Shrinker m_shrinker;
 
  public:
   const InliningInfo& get_info() { return info; }
 
   const constant_propagation::Transform::Stats& get_const_prop_stats() {
-    return m_const_prop_stats;
+    return m_shrinker.get_const_prop_stats();
   }
-  const cse_impl::Stats& get_cse_stats() { return m_cse_stats; }
+  const cse_impl::Stats& get_cse_stats() { return m_shrinker.get_cse_stats(); }
   const copy_propagation_impl::Stats& get_copy_prop_stats() {
-    return m_copy_prop_stats;
+    return m_shrinker.get_copy_prop_stats();
+  }
+  const LocalDce::Stats& get_local_dce_stats() {
+    return m_shrinker.get_local_dce_stats();
   }
-  const LocalDce::Stats& get_local_dce_stats() { return m_local_dce_stats; }
   const dedup_blocks_impl::Stats& get_dedup_blocks_stats() {
-    return m_dedup_blocks_stats;
+    return m_shrinker.get_dedup_blocks_stats();
   }
-  size_t get_methods_shrunk() { return m_methods_shrunk; }
+  size_t get_methods_shrunk() { return m_shrinker.get_methods_shrunk(); }
   size_t get_callers() { return m_async_caller_wait_counts.size(); }
   size_t get_delayed_shrinking_callees() {
     return m_async_delayed_shrinking_callee_wait_counts.size();
@@ -9,6 +9,7 @@
 
 #include <algorithm>
 #include <map>
+#include <mutex>
 #include <set>
 #include <string>
 #include <vector>
@@ -191,14 +192,14 @@ using CallerInsns =
  * return an object type.
  */
 void gather_true_virtual_methods(
+    const mog::Graph& method_override_graph,
     const Scope& scope,
     CalleeCallerInsns* true_virtual_callers,
     std::unordered_set<DexMethod*>* methods,
     std::unordered_map<const DexMethod*, size_t>* same_method_implementations) {
-  auto method_override_graph = mog::build_graph(scope);
-  auto non_virtual = mog::get_non_true_virtuals(*method_override_graph, scope);
+  auto non_virtual = mog::get_non_true_virtuals(method_override_graph, scope);
   auto same_implementation_map = get_same_implementation_map(
-      scope, *method_override_graph, same_method_implementations);
+      scope, method_override_graph, same_method_implementations);
   std::unordered_set<DexMethod*> non_virtual_set{non_virtual.begin(),
                                                  non_virtual.end()};
   // Add mapping from callee to monomorphic callsites.
@@ -250,7 +251,7 @@ void gather_true_virtual_methods(
         continue;
       }
       const auto& overriding_methods =
-          mog::get_overriding_methods(*method_override_graph, callee);
+          mog::get_overriding_methods(method_override_graph, callee);
       if (!callee->is_external()) {
         if (overriding_methods.empty()) {
           // There is no override for this method
@@ -299,7 +300,9 @@ void run_inliner(DexStoresVector& stores,
                  PassManager& mgr,
                  ConfigFiles& conf,
                  bool intra_dex /* false */,
-                 bool use_method_profiles /* false */) {
+                 bool use_method_profiles /* false */,
+                 const basic_block_profiles::BasicBlockProfiles*
+                     block_profiles /* nullptr */) {
   if (mgr.no_proguard_rules()) {
     TRACE(INLINE, 1,
           "MethodInlinePass not run because no ProGuard configuration was "
@@ -338,14 +341,33 @@ void run_inliner(DexStoresVector& stores,
 
   std::unordered_map<const DexMethod*, size_t> same_method_implementations;
   if (inliner_config.virtual_inline && inliner_config.true_virtual_inline) {
-    gather_true_virtual_methods(scope, &true_virtual_callers, &methods,
-                                &same_method_implementations);
+    gather_true_virtual_methods(
+        *mgr.analysis_cache().method_override_graph(scope), scope,
+        &true_virtual_callers, &methods, &same_method_implementations);
   }
   // keep a map from refs to defs or nullptr if no method was found
   MethodRefCache resolved_refs;
   auto resolver = [&resolved_refs](DexMethodRef* method, MethodSearch search) {
     return resolve_method(method, search, resolved_refs);
   };
+  // The blocks of the profiles are those of the non-editable CFGs, so the cold
+  // instructions are found before the editable ones are built.
+  std::unordered_set<const IRInstruction*> cold_insns;
+  if (use_method_profiles && block_profiles != nullptr) {
+    std::mutex cold_insns_mutex;
+    walk::parallel::code(scope, [&](DexMethod* method, IRCode& code) {
+      auto coverage = block_profiles->get(method);
+      if (coverage == nullptr || !coverage->any_ran()) {
+        return;
+      }
+      std::unordered_set<const IRInstruction*> method_cold_insns;
+      basic_block_profiles::gather_cold_instructions(&code, *coverage,
+                                                     &method_cold_insns);
+      std::lock_guard<std::mutex> lock(cold_insns_mutex);
+      cold_insns.insert(method_cold_insns.begin(), method_cold_insns.end());
+    });
+    mgr.set_metric("cold_instructions", cold_insns.size());
+  }
   if (inliner_config.use_cfg_inliner) {
     walk::parallel::code(scope, [](DexMethod*, IRCode& code) {
       code.build_cfg(/* editable */ true);
@@ -357,7 +379,8 @@ void run_inliner(DexStoresVector& stores,
                              intra_dex ? IntraDex : InterDex,
                              true_virtual_callers, &method_profiles,
                              &same_method_implementations,
-                             analyze_and_prune_inits, conf.get_pure_methods());
+                             analyze_and_prune_inits, conf.get_pure_methods(),
+                             &mgr.analysis_cache(), &cold_insns);
   inliner.inline_methods();
 
   if (inliner_config.use_cfg_inliner) {
@@ -392,6 +415,18 @@ void run_inliner(DexStoresVector& stores,
   TRACE(INLINE, 3, "max_call_stack_depth %ld",
         inliner.get_info().max_call_stack_depth);
   TRACE(INLINE, 3, "waited seconds %ld", inliner.get_info().waited_seconds);
+  double queue_waited_seconds{0};
+  double max_queue_waited_seconds{0};
+  for (auto& p : inliner.get_info().queue_wait_by_critical_path_depth) {
+    TRACE(INLINE, 3,
+          "critical path depth %d: %zu work items queued for %.3lf seconds "
+          "(max %.3lf)",
+          p.first, p.second.work_items, p.second.total.count(),
+          p.second.max.count());
+    queue_waited_seconds += p.second.total.count();
+    max_queue_waited_seconds =
+        std::max(max_queue_waited_seconds, p.second.max.count());
+  }
   TRACE(INLINE, 3, "blacklisted meths %ld",
         (size_t)inliner.get_info().blacklisted);
   TRACE(INLINE, 3, "virtualizing methods %ld",
@@ -445,6 +480,10 @@ void run_inliner(DexStoresVector& stores,
       inliner.get_info().constant_invoke_callees_unreachable_blocks);
   mgr.incr_metric("critical_path_length",
                   inliner.get_info().critical_path_length);
+  mgr.incr_metric("queue_waited_ms",
+                  static_cast<int64_t>(queue_waited_seconds * 1000));
+  mgr.incr_metric("max_queue_waited_ms",
+                  static_cast<int64_t>(max_queue_waited_seconds * 1000));
   mgr.incr_metric("methods_shrunk", inliner.get_methods_shrunk());
   mgr.incr_metric("callers", inliner.get_callers());
   mgr.incr_metric("delayed_shrinking_callees",
@@ -455,6 +494,18 @@ void run_inliner(DexStoresVector& stores,
                       inliner.get_const_prop_stats().materialized_consts +
                       inliner.get_const_prop_stats().added_param_const +
                       inliner.get_const_prop_stats().throws);
+  const auto& const_prop_stats = inliner.get_const_prop_stats();
+  mgr.incr_metric("const_prop_unchanged_cache_hits",
+                  const_prop_stats.unchanged_cache_hits);
+  mgr.incr_metric("const_prop_unchanged_cache_misses",
+                  const_prop_stats.unchanged_cache_misses);
+  auto const_prop_lookups = const_prop_stats.unchanged_cache_hits +
+                            const_prop_stats.unchanged_cache_misses;
+  if (const_prop_lookups > 0) {
+    mgr.incr_metric(
+        "const_prop_unchanged_cache_hit_rate_percent",
+        const_prop_stats.unchanged_cache_hits * 100 / const_prop_lookups);
+  }
   mgr.incr_metric("instructions_eliminated_cse",
                   inliner.get_cse_stats().instructions_eliminated);
   mgr.incr_metric("instructions_eliminated_copy_prop",
@@ -5,6 +5,7 @@
  * LICENSE file in the root directory of this source tree.
  */
 
+#include "BasicBlockProfiles.h"
 #include "InlinerConfig.h"
 #include "PassManager.h"
 
@@ -13,10 +14,15 @@ namespace inliner {
  * Before InterDexPass, we can run inliner with "intra_dex=false" to do global
  * inlining. But after InterDexPass, we can only run inliner within each dex by
  * setting "intra_dex" to true.
+ *
+ * When inlining for speed, the call sites in the blocks that never ran
+ * according to block_profiles are left alone.
  */
-void run_inliner(DexStoresVector& stores,
-                 PassManager& mgr,
-                 ConfigFiles& inliner_config,
-                 bool intra_dex = false,
-                 bool use_method_profiles = false);
+void run_inliner(
+    DexStoresVector& stores,
+    PassManager& mgr,
+    ConfigFiles& inliner_config,
+    bool intra_dex = false,
+    bool use_method_profiles = false,
+    const basic_block_profiles::BasicBlockProfiles* block_profiles = nullptr);
 } // namespace inliner
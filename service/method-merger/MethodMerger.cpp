@@ -13,6 +13,7 @@
 #include "Resolver.h"
 #include "SwitchDispatch.h"
 #include "Walkers.h"
+#include "WorkQueue.h"
 
 namespace mog = method_override_graph;
 
@@ -71,20 +72,27 @@ class RefCounter {
   std::unordered_map<DexMethod*, uint32_t> m_counter;
 };
 
-void create_one_dispatch(
-    const std::map<SwitchIndices, DexMethod*>& indices_to_callee,
-    uint32_t min_size,
-    std::unordered_map<DexMethod*, method_reference::NewCallee>* old_to_new,
-    method_merger::Stats* stats) {
-  if (indices_to_callee.size() < min_size) {
-    return;
-  }
+using DispatchGroup = std::map<SwitchIndices, DexMethod*>;
+
+DexMethod* create_one_dispatch(const DispatchGroup& indices_to_callee) {
   auto first_method = indices_to_callee.begin()->second;
   auto method = dispatch::create_simple_dispatch(indices_to_callee);
   always_assert_log(method != nullptr, "Dispatch null for %s\n",
                     SHOW(first_method));
   auto cls = type_class(first_method->get_class());
   cls->add_method(method);
+  return method;
+}
+
+/**
+ * Update old_to_new mapping and stats for a created dispatch.
+ */
+void record_one_dispatch(
+    const DispatchGroup& indices_to_callee,
+    DexMethod* method,
+    std::unordered_map<DexMethod*, method_reference::NewCallee>* old_to_new,
+    method_merger::Stats* stats) {
+  auto first_method = indices_to_callee.begin()->second;
   for (auto& id_meth : indices_to_callee) {
     uint32_t tag = *id_meth.first.begin();
     method_reference::NewCallee new_callee(method, tag);
@@ -102,14 +110,11 @@ void create_one_dispatch(
 }
 
 /**
- * Generate dispatches for the methods, then update old_to_new mapping and
- * update stats.
+ * Split the methods into the groups that each get a dispatch.
  */
-void generate_dispatches(
-    const std::vector<DexMethod*>& methods,
-    const RefCounter& ref_counter,
-    std::unordered_map<DexMethod*, method_reference::NewCallee>* old_to_new,
-    method_merger::Stats* stats) {
+void collect_dispatch_groups(const std::vector<DexMethod*>& methods,
+                             const RefCounter& ref_counter,
+                             std::vector<DispatchGroup>* dispatch_groups) {
   constexpr uint64_t HARD_MAX_INSTRUCTION_SIZE = 1L << 16;
   constexpr uint32_t min_method_group_size = 3;
   std::unordered_map<DexProto*, std::set<DexMethod*, dexmethods_comparator>>
@@ -123,20 +128,24 @@ void generate_dispatches(
       proto_to_methods[method->get_proto()].insert(method);
     }
   }
+  auto add_group = [&](DispatchGroup& indices_to_callee) {
+    if (indices_to_callee.size() >= min_method_group_size) {
+      dispatch_groups->push_back(std::move(indices_to_callee));
+    }
+    indices_to_callee.clear();
+  };
   for (auto& p : proto_to_methods) {
     if (p.second.size() < min_method_group_size) {
       continue;
     }
-    std::map<SwitchIndices, DexMethod*> indices_to_callee;
+    DispatchGroup indices_to_callee;
     uint64_t code_size = 0;
     uint32_t id = 0;
     for (auto it = p.second.begin(); it != p.second.end(); ++it) {
       auto cur_meth = *it;
       code_size += cur_meth->get_code()->sum_opcode_sizes();
       if (code_size > HARD_MAX_INSTRUCTION_SIZE) {
-        create_one_dispatch(indices_to_callee, min_method_group_size,
-                            old_to_new, stats);
-        indices_to_callee.clear();
+        add_group(indices_to_callee);
         code_size = 0;
         id = 0;
       }
@@ -144,9 +153,39 @@ void generate_dispatches(
       indices_to_callee[indices] = cur_meth;
       ++id;
     }
-    create_one_dispatch(indices_to_callee, min_method_group_size, old_to_new,
-                        stats);
+    add_group(indices_to_callee);
+  }
+}
+
+/**
+ * Create the dispatches of all groups. The name of a dispatch depends on the
+ * methods its class already has, so the dispatches of one class are created
+ * in order by a single worker, and the classes are processed in parallel.
+ */
+std::vector<DexMethod*> create_dispatches(
+    const std::vector<DispatchGroup>& dispatch_groups) {
+  std::unordered_map<DexType*, std::vector<size_t>> owner_to_groups;
+  std::vector<const std::vector<size_t>*> owners;
+  for (size_t i = 0; i < dispatch_groups.size(); ++i) {
+    auto owner = dispatch_groups[i].begin()->second->get_class();
+    auto& groups = owner_to_groups[owner];
+    if (groups.empty()) {
+      owners.push_back(&groups);
+    }
+    groups.push_back(i);
+  }
+  std::vector<DexMethod*> dispatches(dispatch_groups.size());
+  auto wq = workqueue_foreach<const std::vector<size_t>*>(
+      [&](const std::vector<size_t>* groups) {
+        for (auto i : *groups) {
+          dispatches[i] = create_one_dispatch(dispatch_groups[i]);
+        }
+      });
+  for (auto groups : owners) {
+    wq.add_item(groups);
   }
+  wq.run_all();
+  return dispatches;
 }
 } // namespace
 
@@ -162,9 +201,15 @@ Stats merge_methods(const MethodGroups& method_groups,
   method_reference::CallSites callsites =
       method_reference::collect_call_refs(scope, all_methods);
   RefCounter ref_counter(callsites);
-  std::unordered_map<DexMethod*, method_reference::NewCallee> old_to_new;
+  std::vector<DispatchGroup> dispatch_groups;
   for (auto& methods : method_groups) {
-    generate_dispatches(methods, ref_counter, &old_to_new, &stats);
+    collect_dispatch_groups(methods, ref_counter, &dispatch_groups);
+  }
+  auto dispatches = create_dispatches(dispatch_groups);
+  std::unordered_map<DexMethod*, method_reference::NewCallee> old_to_new;
+  for (size_t i = 0; i < dispatch_groups.size(); ++i) {
+    record_one_dispatch(dispatch_groups[i], dispatches[i], &old_to_new,
+                        &stats);
   }
   if (old_to_new.empty()) {
     return stats;
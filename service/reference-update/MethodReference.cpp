@@ -82,6 +82,41 @@ void patch_callsite(const CallSite& callsite, const NewCallee& new_callee) {
   // Assuming the following move-result is there and good.
 }
 
+bool update_call_ref(
+    DexMethod* caller,
+    IRInstruction* insn,
+    const std::unordered_map<DexMethod*, DexMethod*>& old_to_new_callee) {
+  if (!insn->has_method()) {
+    return false;
+  }
+  const auto method =
+      resolve_method(insn->get_method(), opcode_to_search(insn), caller);
+  if (method == nullptr) {
+    return false;
+  }
+  auto it = old_to_new_callee.find(method);
+  if (it == old_to_new_callee.end()) {
+    return false;
+  }
+  auto new_callee = it->second;
+  // At this point, a non static private should not exist.
+  always_assert_log(!is_private(new_callee) || is_static(new_callee),
+                    "%s\n",
+                    vshow(new_callee).c_str());
+  TRACE(REFU, 9, " Updated call %s to %s", SHOW(insn), SHOW(new_callee));
+  insn->set_method(new_callee);
+  if (new_callee->is_virtual()) {
+    always_assert_log(is_invoke_virtual(insn->opcode()),
+                      "invalid callsite %s\n",
+                      SHOW(insn));
+  } else if (is_static(new_callee)) {
+    always_assert_log(is_invoke_static(insn->opcode()),
+                      "invalid callsite %s\n",
+                      SHOW(insn));
+  }
+  return true;
+}
+
 void update_call_refs_simple(
     const Scope& scope,
     const std::unordered_map<DexMethod*, DexMethod*>& old_to_new_callee) {
@@ -91,31 +126,7 @@ void update_call_refs_simple(
 
   auto patcher = [&](DexMethod* meth, IRCode& code) {
     for (auto& mie : InstructionIterable(code)) {
-      auto insn = mie.insn;
-      if (!insn->has_method()) {
-        continue;
-      }
-      const auto method =
-          resolve_method(insn->get_method(), opcode_to_search(insn), meth);
-      if (method == nullptr || old_to_new_callee.count(method) == 0) {
-        continue;
-      }
-      auto new_callee = old_to_new_callee.at(method);
-      // At this point, a non static private should not exist.
-      always_assert_log(!is_private(new_callee) || is_static(new_callee),
-                        "%s\n",
-                        vshow(new_callee).c_str());
-      TRACE(REFU, 9, " Updated call %s to %s", SHOW(insn), SHOW(new_callee));
-      insn->set_method(new_callee);
-      if (new_callee->is_virtual()) {
-        always_assert_log(is_invoke_virtual(insn->opcode()),
-                          "invalid callsite %s\n",
-                          SHOW(insn));
-      } else if (is_static(new_callee)) {
-        always_assert_log(is_invoke_static(insn->opcode()),
-                          "invalid callsite %s\n",
-                          SHOW(insn));
-      }
+      update_call_ref(meth, mie.insn, old_to_new_callee);
     }
   };
   walk::parallel::code(scope, patcher);
@@ -59,6 +59,15 @@ IRInstruction* make_invoke(DexMethod* callee,
  */
 void patch_callsite(const CallSite& callsite, const NewCallee& new_callee);
 
+/**
+ * Rewrites the call of insn in caller if it resolves to one of the old
+ * callees. Returns true if the call was rewritten.
+ */
+bool update_call_ref(
+    DexMethod* caller,
+    IRInstruction* insn,
+    const std::unordered_map<DexMethod*, DexMethod*>& old_to_new_callee);
+
 void update_call_refs_simple(
     const Scope& scope,
     const std::unordered_map<DexMethod*, DexMethod*>& old_to_new_callee);
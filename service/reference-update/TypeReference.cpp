@@ -561,9 +561,12 @@ DexTypeList* drop_and_make(const DexTypeList* list, size_t num_types_to_drop) {
   return DexTypeList::make_type_list(std::move(dropped));
 }
 
-void update_method_signature_type_references(
+namespace {
+
+void update_method_signatures(
     const Scope& scope,
     const std::unordered_map<const DexType*, DexType*>& old_to_new,
+    const UnorderedTypeSet& old_types,
     const ClassHierarchy& ch,
     boost::optional<std::unordered_map<DexMethod*, std::string>&>
         method_debug_map) {
@@ -582,11 +585,6 @@ void update_method_signature_type_references(
     };
   }
 
-  UnorderedTypeSet old_types;
-  for (auto& pair : old_to_new) {
-    old_types.insert(pair.first);
-  }
-
   walk::methods(scope, [&](DexMethod* method) {
     auto proto = method->get_proto();
     if (!proto_has_reference_to(proto, old_types)) {
@@ -628,24 +626,9 @@ void update_method_signature_type_references(
     auto& group = key_and_group.second;
     update_vmethods_group_one_type_ref(group, ch);
   }
-
-  // Ensure that no method references left that still refer old types.
-  walk::parallel::code(scope, [&old_types](DexMethod*, IRCode& code) {
-    for (auto& mie : InstructionIterable(code)) {
-      auto insn = mie.insn;
-      if (insn->has_method()) {
-        auto proto = insn->get_method()->get_proto();
-        always_assert_log(
-            !proto_has_reference_to(proto, old_types),
-            "Find old type in method reference %s, please make sure that "
-            "ReBindRefsPass is enabled before the crashed pass.\n",
-            SHOW(insn));
-      }
-    }
-  });
 }
 
-void update_field_type_references(
+void update_field_types(
     const Scope& scope,
     const std::unordered_map<const DexType*, DexType*>& old_to_new) {
   TRACE(REFU, 4, " updating field refs");
@@ -664,21 +647,127 @@ void update_field_type_references(
     TRACE(REFU, 9, " updating field ref to %s", SHOW(type));
   };
   walk::parallel::fields(scope, update_field);
+}
+
+void check_no_method_ref_to(const IRInstruction* insn,
+                            const UnorderedTypeSet& old_types) {
+  if (insn->has_method()) {
+    auto proto = insn->get_method()->get_proto();
+    always_assert_log(
+        !proto_has_reference_to(proto, old_types),
+        "Find old type in method reference %s, please make sure that "
+        "ReBindRefsPass is enabled before the crashed pass.\n",
+        SHOW(insn));
+  }
+}
+
+void check_no_field_ref_to(
+    const IRInstruction* insn,
+    const std::unordered_map<const DexType*, DexType*>& old_to_new) {
+  if (insn->has_field()) {
+    const auto ref_type = insn->get_field()->get_type();
+    const auto type = type::get_element_type_if_array(ref_type);
+    always_assert_log(
+        old_to_new.count(type) == 0,
+        "Find old type in field reference %s, please make sure that "
+        "ReBindRefsPass is enabled before TypeErasurePass\n",
+        SHOW(insn));
+  }
+}
+
+UnorderedTypeSet get_old_types(
+    const std::unordered_map<const DexType*, DexType*>& old_to_new) {
+  UnorderedTypeSet old_types;
+  for (auto& pair : old_to_new) {
+    old_types.insert(pair.first);
+  }
+  return old_types;
+}
+
+} // namespace
+
+void update_method_signature_type_references(
+    const Scope& scope,
+    const std::unordered_map<const DexType*, DexType*>& old_to_new,
+    const ClassHierarchy& ch,
+    boost::optional<std::unordered_map<DexMethod*, std::string>&>
+        method_debug_map) {
+  auto old_types = get_old_types(old_to_new);
+  update_method_signatures(scope, old_to_new, old_types, ch, method_debug_map);
+
+  // Ensure that no method references left that still refer old types.
+  walk::parallel::code(scope, [&old_types](DexMethod*, IRCode& code) {
+    for (auto& mie : InstructionIterable(code)) {
+      check_no_method_ref_to(mie.insn, old_types);
+    }
+  });
+}
+
+void update_field_type_references(
+    const Scope& scope,
+    const std::unordered_map<const DexType*, DexType*>& old_to_new) {
+  update_field_types(scope, old_to_new);
 
   walk::parallel::code(scope, [&old_to_new](DexMethod*, IRCode& code) {
+    for (auto& mie : InstructionIterable(code)) {
+      check_no_field_ref_to(mie.insn, old_to_new);
+    }
+  });
+}
+
+void BatchRefUpdater::add_types(
+    const std::unordered_map<const DexType*, DexType*>& old_to_new) {
+  for (const auto& pair : old_to_new) {
+    auto it = m_old_to_new_types.emplace(pair).first;
+    always_assert_log(it->second == pair.second,
+                      "Conflicting replacements for %s: %s and %s",
+                      SHOW(pair.first), SHOW(it->second), SHOW(pair.second));
+  }
+}
+
+void BatchRefUpdater::add_callees(
+    const std::unordered_map<DexMethod*, DexMethod*>& old_to_new_callee) {
+  for (const auto& pair : old_to_new_callee) {
+    auto it = m_old_to_new_callees.emplace(pair).first;
+    always_assert_log(it->second == pair.second,
+                      "Conflicting replacements for %s: %s and %s",
+                      SHOW(pair.first), SHOW(it->second), SHOW(pair.second));
+  }
+}
+
+void BatchRefUpdater::apply(
+    const Scope& scope,
+    const ClassHierarchy& ch,
+    boost::optional<std::unordered_map<DexMethod*, std::string>&>
+        method_debug_map) {
+  if (m_old_to_new_types.empty() && m_old_to_new_callees.empty()) {
+    return;
+  }
+  auto old_types = get_old_types(m_old_to_new_types);
+  if (!m_old_to_new_types.empty()) {
+    update_method_signatures(scope, m_old_to_new_types, old_types, ch,
+                             method_debug_map);
+    update_field_types(scope, m_old_to_new_types);
+  }
+
+  // A single walk over the code rewrites the calls and checks that no
+  // reference to an old type is left. Changing the signatures updates the
+  // method refs in place, so the callees still resolve to the same methods.
+  walk::parallel::code(scope, [&](DexMethod* method, IRCode& code) {
     for (auto& mie : InstructionIterable(code)) {
       auto insn = mie.insn;
-      if (insn->has_field()) {
-        const auto ref_type = insn->get_field()->get_type();
-        const auto type = type::get_element_type_if_array(ref_type);
-        always_assert_log(
-            old_to_new.count(type) == 0,
-            "Find old type in field reference %s, please make sure that "
-            "ReBindRefsPass is enabled before TypeErasurePass\n",
-            SHOW(insn));
+      if (!m_old_to_new_callees.empty()) {
+        method_reference::update_call_ref(method, insn, m_old_to_new_callees);
+      }
+      if (!old_types.empty()) {
+        check_no_method_ref_to(insn, old_types);
+        check_no_field_ref_to(insn, m_old_to_new_types);
       }
     }
   });
+
+  m_old_to_new_types.clear();
+  m_old_to_new_callees.clear();
 }
 
 } // namespace type_reference
@@ -123,4 +123,36 @@ void update_field_type_references(
     const Scope& scope,
     const std::unordered_map<const DexType*, DexType*>& old_to_new);
 
+/**
+ * Accumulates the type and callee substitutions of a pass, and applies them
+ * with a single parallel walk over the code of the scope. Updating the
+ * method signatures, the field types and the calls separately walks the whole
+ * scope's code once for each of them.
+ *
+ * The type substitutions are applied like in
+ * update_method_signature_type_references and update_field_type_references,
+ * and the callee substitutions like in
+ * method_reference::update_call_refs_simple.
+ */
+class BatchRefUpdater final {
+ public:
+  void add_types(
+      const std::unordered_map<const DexType*, DexType*>& old_to_new);
+
+  void add_callees(
+      const std::unordered_map<DexMethod*, DexMethod*>& old_to_new_callee);
+
+  /**
+   * Applies the accumulated substitutions and clears them.
+   */
+  void apply(const Scope& scope,
+             const ClassHierarchy& ch,
+             boost::optional<std::unordered_map<DexMethod*, std::string>&>
+                 method_debug_map = boost::none);
+
+ private:
+  std::unordered_map<const DexType*, DexType*> m_old_to_new_types;
+  std::unordered_map<DexMethod*, DexMethod*> m_old_to_new_callees;
+};
+
 } // namespace type_reference
@@ -0,0 +1,178 @@
+/*
+ * Copyright (c) Facebook, Inc. and its affiliates.
+ *
+ * This source code is licensed under the MIT license found in the
+ * LICENSE file in the root directory of this source tree.
+ */
+
+#include "Shrinker.h"
+
+#include "ConstantPropagation.h"
+#include "ConstantPropagationAnalysis.h"
+#include "ConstantPropagationWholeProgramState.h"
+#include "ControlFlow.h"
+#include "IRCode.h"
+#include "MethodOverrideGraph.h"
+#include "MethodUtil.h"
+#include "Purity.h"
+
+namespace shrinker {
+
+Shrinker::Shrinker(
+    const Scope& scope,
+    const XStoreRefs* xstores,
+    const ShrinkerConfig& config,
+    const std::unordered_set<DexMethodRef*>& configured_pure_methods,
+    AnalysisCache* analysis_cache)
+    : m_xstores(xstores),
+      m_config(config),
+      m_enabled(config.run_const_prop || config.run_cse ||
+                config.run_copy_prop || config.run_local_dce ||
+                config.run_dedup_blocks),
+      m_pure_methods(get_pure_methods()) {
+  if (m_config.run_cse || m_config.run_local_dce) {
+    m_pure_methods.insert(configured_pure_methods.begin(),
+                          configured_pure_methods.end());
+    auto rstate_pure_method = get_rstate_pure_methods(scope);
+    m_pure_methods.insert(rstate_pure_method.begin(), rstate_pure_method.end());
+    if (m_config.run_cse) {
+      m_cse_shared_state =
+          std::make_unique<cse_impl::SharedState>(m_pure_methods);
+    }
+    if (m_config.run_local_dce && analysis_cache != nullptr) {
+      auto no_side_effects =
+          analysis_cache->no_side_effects_methods(scope, m_pure_methods);
+      for (auto m : no_side_effects->methods) {
+        m_pure_methods.insert(const_cast<DexMethod*>(m));
+      }
+    } else if (m_config.run_local_dce) {
+      std::unique_ptr<const method_override_graph::Graph> owned_override_graph;
+      const method_override_graph::Graph* override_graph;
+      if (m_config.run_cse) {
+        override_graph = m_cse_shared_state->get_method_override_graph();
+      } else {
+        owned_override_graph = method_override_graph::build_graph(scope);
+        override_graph = owned_override_graph.get();
+      }
+      std::unordered_set<const DexMethod*> computed_no_side_effects_methods;
+      compute_no_side_effects_methods(scope, override_graph, m_pure_methods,
+                                      &computed_no_side_effects_methods);
+      for (auto m : computed_no_side_effects_methods) {
+        m_pure_methods.insert(const_cast<DexMethod*>(m));
+      }
+    }
+  }
+}
+
+void Shrinker::shrink_method(DexMethod* method) {
+  auto code = method->get_code();
+  bool editable_cfg_built = code->editable_cfg_built();
+
+  constant_propagation::Transform::Stats const_prop_stats;
+  cse_impl::Stats cse_stats;
+  copy_propagation_impl::Stats copy_prop_stats;
+  LocalDce::Stats local_dce_stats;
+  dedup_blocks_impl::Stats dedup_blocks_stats;
+
+  auto& const_prop_cache = constant_propagation::UnchangedMethodCache::get();
+  boost::optional<constant_propagation::UnchangedMethodCache::Key>
+      const_prop_key;
+  bool const_prop_unchanged = false;
+  bool run_const_prop = m_config.run_const_prop;
+  if (run_const_prop) {
+    // Some of the constant-propagation transformations are only implemented
+    // on the linear IR, so they run before everything else.
+    if (editable_cfg_built) {
+      code->clear_cfg();
+    }
+    const_prop_key = constant_propagation::UnchangedMethodCache::make_key(
+        method, constant_propagation::Transform::Config(), m_xstores,
+        /* run_on_editable_cfg */ true,
+        /* remove_redundant_range_checks */ false);
+    if (const_prop_key && const_prop_cache.contains(*const_prop_key)) {
+      const_prop_stats.unchanged_cache_hits = 1;
+      run_const_prop = false;
+    }
+  }
+  if (run_const_prop) {
+    if (!code->cfg_built()) {
+      code->build_cfg(/* editable */ false);
+    }
+    constant_propagation::intraprocedural::FixpointIterator fp_iter(
+        code->cfg(), constant_propagation::ConstantPrimitiveAnalyzer());
+    fp_iter.run(ConstantEnvironment());
+    constant_propagation::Transform::Config config;
+    constant_propagation::Transform tf(config);
+    const_prop_stats = tf.apply_on_uneditable_cfg(
+        fp_iter, constant_propagation::WholeProgramState(), code, m_xstores,
+        method->get_class());
+    always_assert(!code->editable_cfg_built());
+    const_prop_unchanged =
+        const_prop_key && constant_propagation::UnchangedMethodCache::
+                              is_unchanged(method, *const_prop_key);
+  }
+
+  // All remaining stages share this editable CFG.
+  if (!code->editable_cfg_built()) {
+    code->build_cfg(/* editable */ true);
+  }
+  auto& cfg = code->cfg();
+
+  if (run_const_prop) {
+    cfg.calculate_exit_block();
+    constant_propagation::intraprocedural::FixpointIterator fp_iter(
+        cfg, constant_propagation::ConstantPrimitiveAnalyzer());
+    fp_iter.run(ConstantEnvironment());
+    constant_propagation::Transform::Config config;
+    constant_propagation::Transform tf(config);
+    const_prop_stats += tf.apply(fp_iter, cfg, method, m_xstores);
+    if (const_prop_key) {
+      if (const_prop_unchanged && const_prop_stats.branches_forwarded == 0) {
+        const_prop_cache.insert(*const_prop_key);
+      }
+      const_prop_stats.unchanged_cache_misses = 1;
+    }
+  }
+
+  if (m_config.run_cse) {
+    cse_impl::CommonSubexpressionElimination cse(
+        m_cse_shared_state.get(), cfg, is_static(method),
+        method::is_init(method) || method::is_clinit(method),
+        method->get_class(), method->get_proto()->get_args());
+    cse.patch();
+    cse_stats = cse.get_stats();
+  }
+
+  if (m_config.run_copy_prop) {
+    copy_propagation_impl::Config config;
+    copy_propagation_impl::CopyPropagation copy_propagation(config);
+    copy_prop_stats = copy_propagation.run(code, method);
+  }
+
+  if (m_config.run_local_dce) {
+    auto local_dce = LocalDce(m_pure_methods);
+    local_dce.dce(code);
+    local_dce_stats = local_dce.get_stats();
+  }
+
+  if (m_config.run_dedup_blocks) {
+    dedup_blocks_impl::Config config;
+    dedup_blocks_impl::DedupBlocks dedup_blocks(&config, method);
+    dedup_blocks.run();
+    dedup_blocks_stats = dedup_blocks.get_stats();
+  }
+
+  if (!editable_cfg_built) {
+    code->clear_cfg();
+  }
+
+  std::lock_guard<std::mutex> guard(m_stats_mutex);
+  m_const_prop_stats += const_prop_stats;
+  m_cse_stats += cse_stats;
+  m_copy_prop_stats += copy_prop_stats;
+  m_local_dce_stats += local_dce_stats;
+  m_dedup_blocks_stats += dedup_blocks_stats;
+  m_methods_shrunk++;
+}
+
+} // namespace shrinker
@@ -0,0 +1,93 @@
+/*
+ * Copyright (c) Facebook, Inc. and its affiliates.
+ *
+ * This source code is licensed under the MIT license found in the
+ * LICENSE file in the root directory of this source tree.
+ */
+
+#pragma once
+
+#include <memory>
+#include <mutex>
+#include <unordered_set>
+
+#include "AnalysisCache.h"
+#include "CommonSubexpressionElimination.h"
+#include "ConstantPropagationTransform.h"
+#include "CopyPropagation.h"
+#include "DedupBlocks.h"
+#include "DexClass.h"
+#include "DexStore.h"
+#include "LocalDce.h"
+
+namespace shrinker {
+
+struct ShrinkerConfig {
+  bool run_const_prop{false};
+  bool run_cse{false};
+  bool run_copy_prop{false};
+  bool run_local_dce{false};
+  bool run_dedup_blocks{false};
+};
+
+/*
+ * Runs a fixed pipeline of cheap intraprocedural optimizations (constant
+ * propagation, CSE, copy propagation, local DCE and block deduplication) over
+ * individual methods. The state shared by all methods, e.g. the set of pure
+ * methods, is computed once upfront; and within a method, all stages after the
+ * first constant propagation transform share a single editable CFG, instead of
+ * each building and linearizing their own.
+ *
+ * shrink_method is thread safe, so a Shrinker can be used from any thread
+ * pool.
+ *
+ * When given the PassManager's AnalysisCache, the methods without side effects
+ * are taken from it, so that they aren't recomputed by every pass.
+ */
+class Shrinker {
+ public:
+  Shrinker(const Scope& scope,
+           const XStoreRefs* xstores,
+           const ShrinkerConfig& config,
+           const std::unordered_set<DexMethodRef*>& configured_pure_methods,
+           AnalysisCache* analysis_cache = nullptr);
+
+  // Whether any of the optimizations is enabled.
+  bool enabled() const { return m_enabled; }
+
+  void shrink_method(DexMethod* method);
+
+  const constant_propagation::Transform::Stats& get_const_prop_stats() const {
+    return m_const_prop_stats;
+  }
+  const cse_impl::Stats& get_cse_stats() const { return m_cse_stats; }
+  const copy_propagation_impl::Stats& get_copy_prop_stats() const {
+    return m_copy_prop_stats;
+  }
+  const LocalDce::Stats& get_local_dce_stats() const {
+    return m_local_dce_stats;
+  }
+  const dedup_blocks_impl::Stats& get_dedup_blocks_stats() const {
+    return m_dedup_blocks_stats;
+  }
+  size_t get_methods_shrunk() const { return m_methods_shrunk; }
+
+ private:
+  const XStoreRefs* m_xstores;
+  const ShrinkerConfig m_config;
+  bool m_enabled;
+
+  std::unordered_set<DexMethodRef*> m_pure_methods;
+  std::unique_ptr<cse_impl::SharedState> m_cse_shared_state;
+
+  // The following are guarded by this mutex.
+  std::mutex m_stats_mutex;
+  constant_propagation::Transform::Stats m_const_prop_stats;
+  cse_impl::Stats m_cse_stats;
+  copy_propagation_impl::Stats m_copy_prop_stats;
+  LocalDce::Stats m_local_dce_stats;
+  dedup_blocks_impl::Stats m_dedup_blocks_stats;
+  size_t m_methods_shrunk{0};
+};
+
+} // namespace shrinker
@@ -11,6 +11,7 @@
 #include <vector>
 
 #include "ConstantPropagationAnalysis.h"
+#include "RangeAnalysis.h"
 #include "ReachingDefinitions.h"
 
 namespace {
@@ -410,9 +411,23 @@ void SwitchEquivFinder::find_case_keys(const std::vector<cfg::Edge*>& leaves) {
     return true;
   };
 
+  // The ranges are only computed if a leaf is reached with a non-constant
+  // value, e.g., through a chain of if-lt instructions.
+  std::unique_ptr<cp::range::FixpointIterator> range_fixpoint;
+  const auto& get_range = [this, &range_fixpoint](cfg::Edge* edge_to_leaf) {
+    if (range_fixpoint == nullptr) {
+      range_fixpoint = std::make_unique<cp::range::FixpointIterator>(*m_cfg);
+      range_fixpoint->run(cp::range::RangeEnvironment());
+    }
+    auto env = range_fixpoint->get_exit_state_at(edge_to_leaf->src());
+    env = range_fixpoint->analyze_edge(edge_to_leaf, env);
+    return cp::range::FixpointIterator::get_range(env, m_switching_reg);
+  };
+
   // returns the value of `m_switching_reg` if the leaf is reached via this edge
-  const auto& get_case_key =
-      [this, &fixpoint](cfg::Edge* edge_to_leaf) -> boost::optional<int32_t> {
+  const auto& get_case_key = [this, &fixpoint, &get_range](
+                                 cfg::Edge* edge_to_leaf)
+      -> boost::optional<int32_t> {
     // Get the inferred value of m_switching_reg at the end of `edge_to_leaf`
     // but before the beginning of the leaf block because we would lose the
     // information by merging all the incoming edges.
@@ -420,6 +435,11 @@ void SwitchEquivFinder::find_case_keys(const std::vector<cfg::Edge*>& leaves) {
     env = fixpoint.analyze_edge(edge_to_leaf, env);
     const auto& case_key = env.get<SignedConstantDomain>(m_switching_reg);
     if (case_key.is_top() || case_key.get_constant() == boost::none) {
+      // The range of the value may still be a single value.
+      auto range = get_range(edge_to_leaf);
+      if (!range.is_bottom() && range.lower_bound() == range.upper_bound()) {
+        return static_cast<int32_t>(range.lower_bound());
+      }
       // boost::none represents the fallthrough block
       return boost::none;
     } else {
@@ -431,6 +451,11 @@ void SwitchEquivFinder::find_case_keys(const std::vector<cfg::Edge*>& leaves) {
 
   for (cfg::Edge* edge_to_leaf : leaves) {
     const auto& case_key = get_case_key(edge_to_leaf);
+    if (case_key == boost::none && get_range(edge_to_leaf).is_bottom()) {
+      // This leaf is never reached via this edge, e.g., because the ranges
+      // tested along the path to it are disjoint. It does not need a case.
+      continue;
+    }
     bool success = insert(case_key, edge_to_leaf->target());
     if (!success) {
       // If we didn't insert into result for this leaf node, abort the entire
@@ -10,6 +10,7 @@
 #include "MethodOverrideGraph.h"
 #include "Resolver.h"
 #include "Walkers.h"
+#include "WorkQueue.h"
 
 namespace mog = method_override_graph;
 
@@ -97,7 +98,7 @@ void GlobalTypeAnalyzer::analyze_node(
 }
 
 ArgumentTypePartition GlobalTypeAnalyzer::analyze_edge(
-    const std::shared_ptr<call_graph::Edge>& edge,
+    const call_graph::EdgeId& edge,
     const ArgumentTypePartition& exit_state_at_source) const {
   ArgumentTypePartition entry_state_at_dest;
   auto it = edge->invoke_iterator();
@@ -114,6 +115,13 @@ ArgumentTypePartition GlobalTypeAnalyzer::analyze_edge(
 
 std::unique_ptr<local::LocalTypeAnalyzer>
 GlobalTypeAnalyzer::get_local_analysis(const DexMethod* method) const {
+  if (m_compacted) {
+    auto it = m_entry_args.find(method);
+    return analyze_method(method, this->get_whole_program_state(),
+                          it == m_entry_args.end()
+                              ? ArgumentTypeEnvironment::bottom()
+                              : it->second);
+  }
   auto args = ArgumentTypePartition::bottom();
 
   if (m_call_graph.has_node(method)) {
@@ -124,6 +132,67 @@ GlobalTypeAnalyzer::get_local_analysis(const DexMethod* method) const {
                         args.get(CURRENT_PARTITION_LABEL));
 }
 
+void GlobalTypeAnalyzer::compact() {
+  always_assert(!m_compacted);
+  for (uint32_t id = 0; id < m_call_graph.num_nodes(); ++id) {
+    auto node = m_call_graph.node_by_id(id);
+    if (node->method() == nullptr) {
+      continue;
+    }
+    auto args = this->get_entry_state_at(node).get(CURRENT_PARTITION_LABEL);
+    if (!args.is_bottom()) {
+      m_entry_args.emplace(node->method(), std::move(args));
+    }
+  }
+  this->clear();
+  this->discard_recorded_analyses();
+  m_compacted = true;
+}
+
+std::unordered_set<call_graph::NodeId> GlobalTypeAnalyzer::get_affected_nodes(
+    const WholeProgramState& wps) const {
+  always_assert(!m_compacted);
+  const auto& old_wps = get_whole_program_state();
+  std::vector<char> affected(m_call_graph.num_nodes(), false);
+  auto wq = workqueue_foreach<uint32_t>([&](uint32_t id) {
+    const DexMethod* method = m_call_graph.node_by_id(id)->method();
+    if (method == nullptr || method->get_code() == nullptr) {
+      return;
+    }
+    for (auto& mie : InstructionIterable(method->get_code()->cfg())) {
+      auto* insn = mie.insn;
+      if (insn->has_field()) {
+        auto field = resolve_field(insn->get_field());
+        if (field != nullptr &&
+            !old_wps.get_field_type(field).equals(wps.get_field_type(field))) {
+          affected[id] = true;
+          return;
+        }
+      } else if (insn->has_method()) {
+        auto callee =
+            resolve_method(insn->get_method(), opcode_to_search(insn));
+        if (callee != nullptr &&
+            !old_wps.get_return_type(callee).equals(
+                wps.get_return_type(callee))) {
+          affected[id] = true;
+          return;
+        }
+      }
+    }
+  });
+  for (uint32_t id = 0; id < m_call_graph.num_nodes(); ++id) {
+    wq.add_item(id);
+  }
+  wq.run_all();
+  std::unordered_set<call_graph::NodeId> affected_nodes;
+  for (uint32_t id = 0; id < m_call_graph.num_nodes(); ++id) {
+    if (affected[id]) {
+      affected_nodes.insert(m_call_graph.node_by_id(id));
+    }
+  }
+  return affected_nodes;
+}
+
 using CombinedAnalyzer =
     InstructionAnalyzerCombiner<local::ClinitFieldAnalyzer,
                                 WholeProgramAwareAnalyzer,
@@ -162,8 +231,12 @@ std::unique_ptr<local::LocalTypeAnalyzer> GlobalTypeAnalyzer::analyze_method(
 }
 
 std::unique_ptr<GlobalTypeAnalyzer> GlobalTypeAnalysis::analyze(
-    const Scope& scope) {
-  call_graph::Graph cg = call_graph::single_callee_graph(scope);
+    const Scope& scope, AnalysisCache* cache) {
+  AnalysisCache local_cache;
+  if (cache == nullptr) {
+    cache = &local_cache;
+  }
+  auto cg = cache->single_callee_graph(scope);
   // Rebuild all CFGs here -- this should be more efficient than doing them
   // within FixpointIterator::analyze_node(), since that can get called
   // multiple times for a given method
@@ -174,9 +247,10 @@ std::unique_ptr<GlobalTypeAnalyzer> GlobalTypeAnalysis::analyze(
   // Run the bootstrap. All field value and method return values are
   // represented by Top.
   TRACE(TYPE, 2, "[global] Bootstrap run");
-  auto gta = std::make_unique<GlobalTypeAnalyzer>(cg);
+  auto gta = std::make_unique<GlobalTypeAnalyzer>(*cg);
   gta->run({{CURRENT_PARTITION_LABEL, ArgumentTypeEnvironment()}});
-  auto non_true_virtuals = mog::get_non_true_virtuals(scope);
+  auto non_true_virtuals =
+      mog::get_non_true_virtuals(*cache->method_override_graph(scope), scope);
   size_t iteration_cnt = 0;
 
   for (size_t i = 0; i < m_max_global_analysis_iteration; ++i) {
@@ -194,8 +268,11 @@ std::unique_ptr<GlobalTypeAnalyzer> GlobalTypeAnalysis::analyze(
     // Use the refined WholeProgramState to propagate more constants via
     // the stack and registers.
     TRACE(TYPE, 2, "[global] Start a new global analysis run");
+    auto affected_nodes = gta->get_affected_nodes(*wps);
+    TRACE(TYPE, 2, "[global] %zu methods affected", affected_nodes.size());
     gta->set_whole_program_state(std::move(wps));
-    gta->run({{CURRENT_PARTITION_LABEL, ArgumentTypeEnvironment()}});
+    gta->run_incrementally(
+        {{CURRENT_PARTITION_LABEL, ArgumentTypeEnvironment()}}, affected_nodes);
     ++iteration_cnt;
   }
 
@@ -204,6 +281,9 @@ std::unique_ptr<GlobalTypeAnalyzer> GlobalTypeAnalysis::analyze(
         "[global] Finished in %d global iterations (max %d)",
         iteration_cnt,
         m_max_global_analysis_iteration);
+  if (m_compact_states) {
+    gta->compact();
+  }
   return gta;
 }
 
@@ -7,6 +7,7 @@
 
 #pragma once
 
+#include "AnalysisCache.h"
 #include "CallGraph.h"
 #include "DexTypeEnvironment.h"
 #include "HashedAbstractPartition.h"
@@ -77,7 +78,7 @@ class GlobalTypeAnalyzer : public sparta::ParallelMonotonicFixpointIterator<
                     ArgumentTypePartition* current_state) const override;
 
   ArgumentTypePartition analyze_edge(
-      const std::shared_ptr<call_graph::Edge>& edge,
+      const call_graph::EdgeId& edge,
       const ArgumentTypePartition& exit_state_at_source) const override;
 
   /*
@@ -93,11 +94,28 @@ class GlobalTypeAnalyzer : public sparta::ParallelMonotonicFixpointIterator<
     m_wps = std::move(wps);
   }
 
+  /*
+   * Returns the nodes of the call graph whose methods read a field type or a
+   * return type that differs between the current WholeProgramState and `wps`.
+   */
+  std::unordered_set<call_graph::NodeId> get_affected_nodes(
+      const WholeProgramState& wps) const;
+
   const call_graph::Graph& get_call_graph() { return m_call_graph; }
 
+  /*
+   * Keeps only the argument types at the entry of each method, which is all
+   * that get_local_analysis needs, and releases the rest of the states of the
+   * fixpoint, i.e. the argument types at every call site. The analyzer can't
+   * be run again afterwards.
+   */
+  void compact();
+
  private:
   std::unique_ptr<const WholeProgramState> m_wps;
   call_graph::Graph m_call_graph;
+  bool m_compacted{false};
+  std::unordered_map<const DexMethod*, ArgumentTypeEnvironment> m_entry_args;
 
   std::unique_ptr<local::LocalTypeAnalyzer> analyze_method(
       const DexMethod* method,
@@ -108,18 +126,27 @@ class GlobalTypeAnalyzer : public sparta::ParallelMonotonicFixpointIterator<
 class GlobalTypeAnalysis {
 
  public:
-  explicit GlobalTypeAnalysis(size_t max_global_analysis_iteration = 10)
-      : m_max_global_analysis_iteration(max_global_analysis_iteration) {}
+  /*
+   * With `compact_states`, the analyzer returned by analyze() only keeps the
+   * per-method entry states, see GlobalTypeAnalyzer::compact.
+   */
+  explicit GlobalTypeAnalysis(size_t max_global_analysis_iteration = 10,
+                              bool compact_states = false)
+      : m_max_global_analysis_iteration(max_global_analysis_iteration),
+        m_compact_states(compact_states) {}
 
   void run(Scope& scope) { analyze(scope); }
 
   /*
-   * Exposed for testing purposes.
+   * Exposed for testing purposes. The call graph is taken from `cache` when
+   * one is given.
    */
-  std::unique_ptr<GlobalTypeAnalyzer> analyze(const Scope&);
+  std::unique_ptr<GlobalTypeAnalyzer> analyze(const Scope&,
+                                              AnalysisCache* cache = nullptr);
 
  private:
   size_t m_max_global_analysis_iteration;
+  bool m_compact_states;
 
   struct Stats {
     size_t resolved_fields{0};
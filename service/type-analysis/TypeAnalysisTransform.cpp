@@ -14,6 +14,30 @@ constexpr const char* CHECK_PARAM_NULL_SIGNATURE =
 constexpr const char* CHECK_EXPR_NULL_SIGNATURE =
     "Lkotlin/jvm/internal/Intrinsics;.checkExpressionValueIsNotNull:(Ljava/"
     "lang/Object;Ljava/lang/String;)V";
+constexpr const char* REQUIRE_NON_NULL_SIGNATURE =
+    "Ljava/util/Objects;.requireNonNull:(Ljava/lang/Object;)Ljava/lang/Object;";
+constexpr const char* REQUIRE_NON_NULL_MESSAGE_SIGNATURE =
+    "Ljava/util/Objects;.requireNonNull:(Ljava/lang/Object;Ljava/lang/"
+    "String;)Ljava/lang/Object;";
+
+namespace {
+
+// Whether the branch on the value is always taken, if that's known.
+boost::optional<bool> is_null_branch_taken(IROpcode op,
+                                           const DexTypeDomain& value) {
+  if (value.is_top() || value.is_bottom()) {
+    return boost::none;
+  }
+  if (value.is_null()) {
+    return op == OPCODE_IF_EQZ;
+  }
+  if (value.is_not_null()) {
+    return op == OPCODE_IF_NEZ;
+  }
+  return boost::none;
+}
+
+} // namespace
 
 Transform::Stats Transform::apply(
     const type_analyzer::local::LocalTypeAnalyzer& lta,
@@ -25,12 +49,24 @@ Transform::Stats Transform::apply(
     if (env.is_bottom()) {
       continue;
     }
+    // The null assertion before this instruction, if it was removed.
+    const IRInstruction* removed_assertion = nullptr;
     for (auto& mie : InstructionIterable(block)) {
       auto it = code->iterator_to(mie);
       auto* insn = mie.insn;
       lta.analyze_instruction(insn, &env);
 
-      if (insn->opcode() == OPCODE_INVOKE_STATIC &&
+      auto op = insn->opcode();
+      if (removed_assertion != nullptr && opcode::is_move_result_any(op)) {
+        // Objects.requireNonNull returns its argument.
+        m_replacements.emplace_back(
+            insn, (new IRInstruction(OPCODE_MOVE_OBJECT))
+                      ->set_dest(insn->dest())
+                      ->set_src(0, removed_assertion->src(0)));
+      }
+      removed_assertion = nullptr;
+
+      if (op == OPCODE_INVOKE_STATIC &&
           null_assertion_set.count(insn->get_method())) {
 
         auto parm = env.get(insn->src(0));
@@ -41,7 +77,22 @@ Transform::Stats Transform::apply(
         if (parm.is_not_null()) {
           m_deletes.emplace_back(it);
           stats.null_check_insn_removed++;
+          removed_assertion = insn;
         }
+      } else if ((op == OPCODE_IF_EQZ || op == OPCODE_IF_NEZ) &&
+                 m_config.remove_redundant_null_branches) {
+        auto taken = is_null_branch_taken(op, env.get(insn->src(0)));
+        if (!taken) {
+          continue;
+        }
+        TRACE(TYPE_TRANSFORM, 4, "Branch %s is always %s", SHOW(insn),
+              *taken ? "taken" : "not taken");
+        if (*taken) {
+          m_replacements.emplace_back(insn, new IRInstruction(OPCODE_GOTO));
+        } else {
+          m_deletes.emplace_back(it);
+        }
+        stats.null_branches_removed++;
       }
     }
   }
@@ -50,6 +101,14 @@ Transform::Stats Transform::apply(
 }
 
 void Transform::apply_changes(IRCode* code) {
+  for (const auto& p : m_replacements) {
+    TRACE(TYPE_TRANSFORM, 4, "Replacing instruction %s", SHOW(p.first));
+    if (is_branch(p.first->opcode())) {
+      code->replace_branch(p.first, p.second);
+    } else {
+      code->replace_opcode(p.first, p.second);
+    }
+  }
   for (const auto& it : m_deletes) {
     TRACE(TYPE_TRANSFORM, 4, "Removing instruction %s", SHOW(it->insn));
     code->remove_opcode(it);
@@ -65,6 +124,13 @@ void Transform::setup(NullAssertionSet& null_assertion_set) {
   if (check_expr_method) {
     null_assertion_set.insert(check_expr_method);
   }
+  for (auto signature :
+       {REQUIRE_NON_NULL_SIGNATURE, REQUIRE_NON_NULL_MESSAGE_SIGNATURE}) {
+    auto require_non_null_method = DexMethod::get_method(signature);
+    if (require_non_null_method) {
+      null_assertion_set.insert(require_non_null_method);
+    }
+  }
 }
 
 } // namespace type_analyzer
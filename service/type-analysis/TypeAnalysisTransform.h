@@ -17,31 +17,42 @@ namespace type_analyzer {
 /**
  * Optimize the given code by:
  *   - removing dead nonnull assertions generated by Kotlin
- * (checkParameterIsNotNull/checkExpressionValueIsNotNull)
+ * (checkParameterIsNotNull/checkExpressionValueIsNotNull) and by
+ * Objects.requireNonNull
+ *   - removing if-eqz/if-nez branches on values that are known to be null or
+ * non-null
  */
 class Transform final {
  public:
   using NullAssertionSet = std::unordered_set<DexMethodRef*>;
   struct Config {
     bool remove_dead_null_check_insn{true};
+    bool remove_redundant_null_branches{true};
     Config() {}
   };
 
   struct Stats {
     size_t null_check_insn_removed{0};
+    size_t null_branches_removed{0};
 
     Stats& operator+=(const Stats& that) {
       null_check_insn_removed += that.null_check_insn_removed;
+      null_branches_removed += that.null_branches_removed;
       return *this;
     }
 
     void report(PassManager& mgr) const {
       mgr.incr_metric("null_check_insn_removed", null_check_insn_removed);
+      mgr.incr_metric("null_branches_removed", null_branches_removed);
       TRACE(TYPE_TRANSFORM, 2, "TypeAnalysisTransform Stats:");
       TRACE(TYPE_TRANSFORM,
             2,
             "TypeAnalysisTransform insns removed = %u",
             null_check_insn_removed);
+      TRACE(TYPE_TRANSFORM,
+            2,
+            "TypeAnalysisTransform branches removed = %u",
+            null_branches_removed);
     }
   };
 
@@ -56,6 +67,7 @@ class Transform final {
 
   const Config m_config;
   std::vector<IRList::iterator> m_deletes;
+  std::vector<std::pair<IRInstruction*, IRInstruction*>> m_replacements;
 };
 
 } // namespace type_analyzer
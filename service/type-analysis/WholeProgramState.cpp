@@ -11,6 +11,7 @@
 #include "GlobalTypeAnalyzer.h"
 #include "Resolver.h"
 #include "Walkers.h"
+#include "WorkQueue.h"
 
 using namespace type_analyzer;
 
@@ -187,37 +188,80 @@ WholeProgramState::WholeProgramState(
   collect(scope, gta);
 }
 
+/*
+ * The fields get dense ids, so that each thread joins the types it sees into a
+ * vector of its own, and these partial results are then reduced in parallel.
+ * The return types of a method only come from its own code, so they are
+ * joined by the thread that walks it.
+ */
 void WholeProgramState::collect(const Scope& scope,
                                 const global::GlobalTypeAnalyzer& gta) {
-  ConcurrentMap<const DexField*, std::vector<DexTypeDomain>> fields_tmp;
-  ConcurrentMap<const DexMethod*, std::vector<DexTypeDomain>> methods_tmp;
-  walk::parallel::methods(scope, [&](DexMethod* method) {
-    IRCode* code = method->get_code();
-    if (code == nullptr) {
-      return;
-    }
-    auto& cfg = code->cfg();
-    auto lta = gta.get_local_analysis(method);
-    for (cfg::Block* b : cfg.blocks()) {
-      auto env = lta->get_entry_state_at(b);
-      for (auto& mie : InstructionIterable(b)) {
-        auto* insn = mie.insn;
-        lta->analyze_instruction(insn, &env);
-        collect_field_types(insn, env, &fields_tmp);
-        collect_return_types(insn, env, method, &methods_tmp);
-      }
+  std::vector<const DexField*> fields;
+  std::unordered_map<const DexField*, uint32_t> field_ids;
+  walk::fields(scope, [&](DexField* field) {
+    if (is_reference(field)) {
+      field_ids.emplace(field, fields.size());
+      fields.push_back(field);
     }
   });
-  for (const auto& pair : fields_tmp) {
-    for (auto& type : pair.second) {
-      m_field_partition.update(pair.first, [&type](auto* current_type) {
+  std::vector<DexMethod*> methods;
+  walk::code(scope,
+             [&](DexMethod* method, IRCode&) { methods.push_back(method); });
+
+  auto num_threads = redex_parallel::default_num_threads();
+  std::vector<std::vector<DexTypeDomain>> thread_field_types(num_threads);
+  std::vector<DexTypeDomain> return_types(methods.size(),
+                                          DexTypeDomain::bottom());
+  auto wq = workqueue_foreach<uint32_t>(
+      [&](sparta::SpartaWorkerState<uint32_t>* state, uint32_t idx) {
+        auto* method = methods[idx];
+        auto& field_types = thread_field_types[state->worker_id()];
+        if (field_types.empty()) {
+          field_types.resize(fields.size(), DexTypeDomain::bottom());
+        }
+        auto& cfg = method->get_code()->cfg();
+        auto lta = gta.get_local_analysis(method);
+        for (cfg::Block* b : cfg.blocks()) {
+          auto env = lta->get_entry_state_at(b);
+          for (auto& mie : InstructionIterable(b)) {
+            auto* insn = mie.insn;
+            lta->analyze_instruction(insn, &env);
+            collect_field_types(insn, env, field_ids, &field_types);
+            collect_return_types(insn, env, method, &return_types[idx]);
+          }
+        }
+      },
+      num_threads);
+  for (uint32_t idx = 0; idx < methods.size(); ++idx) {
+    wq.add_item(idx);
+  }
+  wq.run_all();
+
+  workqueue_tree_reduce(
+      &thread_field_types,
+      [](std::vector<DexTypeDomain>* into, std::vector<DexTypeDomain>* from) {
+        if (into->empty()) {
+          into->swap(*from);
+          return;
+        }
+        for (size_t i = 0; i < from->size(); ++i) {
+          (*into)[i].join_with((*from)[i]);
+        }
+      },
+      num_threads);
+  const auto& field_types = thread_field_types.front();
+  for (size_t i = 0; i < field_types.size(); ++i) {
+    const auto& type = field_types[i];
+    if (!type.is_bottom()) {
+      m_field_partition.update(fields[i], [&type](auto* current_type) {
         current_type->join_with(type);
       });
     }
   }
-  for (const auto& pair : methods_tmp) {
-    for (auto& type : pair.second) {
-      m_method_partition.update(pair.first, [&type](auto* current_type) {
+  for (size_t i = 0; i < methods.size(); ++i) {
+    const auto& type = return_types[i];
+    if (!type.is_bottom()) {
+      m_method_partition.update(methods[i], [&type](auto* current_type) {
         current_type->join_with(type);
       });
     }
@@ -227,7 +271,8 @@ void WholeProgramState::collect(const Scope& scope,
 void WholeProgramState::collect_field_types(
     const IRInstruction* insn,
     const DexTypeEnvironment& env,
-    ConcurrentMap<const DexField*, std::vector<DexTypeDomain>>* field_tmp) {
+    const std::unordered_map<const DexField*, uint32_t>& field_ids,
+    std::vector<DexTypeDomain>* field_types) {
   if (!is_sput(insn->opcode()) && !is_iput(insn->opcode())) {
     return;
   }
@@ -235,23 +280,24 @@ void WholeProgramState::collect_field_types(
   if (!field || !type::is_object(field->get_type())) {
     return;
   }
+  // The fields outside of the scope are unknown anyway.
+  auto it = field_ids.find(field);
+  if (it == field_ids.end()) {
+    return;
+  }
   auto type = env.get(insn->src(0));
   if (traceEnabled(TYPE, 5)) {
     std::ostringstream ss;
     ss << type;
     TRACE(TYPE, 5, "collecting field %s -> %s", SHOW(field), ss.str().c_str());
   }
-  field_tmp->update(field,
-                    [type](const DexField*,
-                           std::vector<DexTypeDomain>& s,
-                           bool /* exists */) { s.emplace_back(type); });
+  (*field_types)[it->second].join_with(type);
 }
 
-void WholeProgramState::collect_return_types(
-    const IRInstruction* insn,
-    const DexTypeEnvironment& env,
-    const DexMethod* method,
-    ConcurrentMap<const DexMethod*, std::vector<DexTypeDomain>>* method_tmp) {
+void WholeProgramState::collect_return_types(const IRInstruction* insn,
+                                             const DexTypeEnvironment& env,
+                                             const DexMethod* method,
+                                             DexTypeDomain* return_type) {
   auto op = insn->opcode();
   if (!is_return(op)) {
     return;
@@ -261,18 +307,10 @@ void WholeProgramState::collect_return_types(
     // does indeed return -- even though `void` is not actually a return type,
     // this tells us that the code following any invoke of this method is
     // reachable.
-    method_tmp->update(
-        method,
-        [](const DexMethod*, std::vector<DexTypeDomain>& s, bool /* exists */) {
-          s.emplace_back(DexTypeDomain::top());
-        });
+    return_type->set_to_top();
     return;
   }
-  auto type = env.get(insn->src(0));
-  method_tmp->update(method,
-                     [type](const DexMethod*,
-                            std::vector<DexTypeDomain>& s,
-                            bool /* exists */) { s.emplace_back(type); });
+  return_type->join_with(env.get(insn->src(0)));
 }
 
 std::string WholeProgramState::print_field_partition_diff(
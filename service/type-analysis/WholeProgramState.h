@@ -124,13 +124,13 @@ class WholeProgramState {
   void collect_field_types(
       const IRInstruction* insn,
       const DexTypeEnvironment& env,
-      ConcurrentMap<const DexField*, std::vector<DexTypeDomain>>* field_tmp);
+      const std::unordered_map<const DexField*, uint32_t>& field_ids,
+      std::vector<DexTypeDomain>* field_types);
 
-  void collect_return_types(
-      const IRInstruction* insn,
-      const DexTypeEnvironment& env,
-      const DexMethod* method,
-      ConcurrentMap<const DexMethod*, std::vector<DexTypeDomain>>* method_tmp);
+  void collect_return_types(const IRInstruction* insn,
+                            const DexTypeEnvironment& env,
+                            const DexMethod* method,
+                            DexTypeDomain* return_type);
 
   // Track the set of fields that we can correctly analyze.
   // The unknown fields can be written to by non-dex code or through reflection.
@@ -7,9 +7,13 @@
 
 #include "mmap.h"
 
+#include <errno.h>
+#include <fcntl.h>
 #include <inttypes.h>
 #include <stdlib.h>
+#include <string.h>
 #include <sys/mman.h>
+#include <unistd.h>
 
 #include <memory>
 #include <sstream>
@@ -44,19 +48,74 @@ MappedFile* MappedFile::mmap_file(size_t byte_count,
   return new MappedFile(filename, actual, byte_count);
 }
 
-MappedFile::~MappedFile() {
-  if (begin_ == nullptr && size_ == 0) {
-    return;
+MappedFile* MappedFile::create_writable_file(size_t byte_count,
+                                             const char* filename,
+                                             std::string* error_msg) {
+  int fd = open(filename, O_CREAT | O_TRUNC | O_RDWR, 0660);
+  if (fd == -1) {
+    if (error_msg != nullptr) {
+      *error_msg = std::string("open of '") + filename +
+                   "' failed: " + strerror(errno);
+    }
+    return nullptr;
+  }
+  if (ftruncate(fd, byte_count) != 0) {
+    if (error_msg != nullptr) {
+      *error_msg = std::string("ftruncate of '") + filename +
+                   "' failed: " + strerror(errno);
+    }
+    close(fd);
+    return nullptr;
+  }
+  if (byte_count == 0) {
+    return new MappedFile(filename, nullptr, 0, fd);
+  }
+
+  uint8_t* actual = reinterpret_cast<uint8_t*>(mmap(nullptr,
+                                                    byte_count,
+                                                    PROT_READ | PROT_WRITE,
+                                                    MAP_SHARED,
+                                                    fd,
+                                                    0));
+  if (actual == MAP_FAILED) {
+    if (error_msg != nullptr) {
+      *error_msg = std::string("mmap of '") + filename +
+                   "' failed: " + strerror(errno);
+    }
+    close(fd);
+    return nullptr;
+  }
+
+  return new MappedFile(filename, actual, byte_count, fd);
+}
+
+bool MappedFile::truncate(size_t byte_count) {
+  CHECK(owned_fd_ != -1);
+  if (begin_ != nullptr && munmap(begin_, size_) == -1) {
+    return false;
   }
+  begin_ = nullptr;
+  size_ = 0;
+  return ftruncate(owned_fd_, byte_count) == 0;
+}
 
-  int result = munmap(begin_, size_);
-  if (result == -1) {
-    fprintf(stderr, "munmap failed\n");
+MappedFile::~MappedFile() {
+  if (begin_ != nullptr || size_ != 0) {
+    int result = munmap(begin_, size_);
+    if (result == -1) {
+      fprintf(stderr, "munmap failed\n");
+    }
+  }
+  if (owned_fd_ != -1) {
+    close(owned_fd_);
   }
 }
 
-MappedFile::MappedFile(const std::string& _name, uint8_t* _begin, size_t _size)
-    : name_(_name), begin_(_begin), size_(_size) {
+MappedFile::MappedFile(const std::string& _name,
+                       uint8_t* _begin,
+                       size_t _size,
+                       int owned_fd)
+    : name_(_name), begin_(_begin), size_(_size), owned_fd_(owned_fd) {
   if (size_ == 0) {
     CHECK(begin_ == nullptr);
   } else {
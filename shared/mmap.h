@@ -23,12 +23,23 @@ class MappedFile {
                                int fd,
                                const char* filename,
                                std::string* error_msg);
+
+  // Creates (or truncates) filename with byte_count zero bytes, and maps it
+  // shared and writable. The file stays open so that it can be shrunk with
+  // truncate() once the final size is known.
+  static MappedFile* create_writable_file(size_t byte_count,
+                                          const char* filename,
+                                          std::string* error_msg);
   ~MappedFile();
 
   const std::string& name() const { return name_; }
 
   bool sync();
 
+  // Unmaps the file and sets its size to byte_count. Only valid for files
+  // created with create_writable_file().
+  bool truncate(size_t byte_count);
+
   uint8_t* begin() const { return begin_; }
 
   size_t size() const { return size_; }
@@ -40,9 +51,13 @@ class MappedFile {
   }
 
  private:
-  MappedFile(const std::string& name, uint8_t* begin, size_t size);
+  MappedFile(const std::string& name,
+             uint8_t* begin,
+             size_t size,
+             int owned_fd = -1);
 
   const std::string name_;
   uint8_t* begin_; // Start of data.
   size_t size_; // Length of data.
+  int owned_fd_; // File descriptor to close, or -1.
 };
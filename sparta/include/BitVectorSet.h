@@ -0,0 +1,441 @@
+/*
+ * Copyright (c) Facebook, Inc. and its affiliates.
+ *
+ * This source code is licensed under the MIT license found in the
+ * LICENSE file in the root directory of this source tree.
+ */
+
+#pragma once
+
+#include <algorithm>
+#include <cstddef>
+#include <cstdint>
+#include <initializer_list>
+#include <iterator>
+#include <limits>
+#include <ostream>
+#include <type_traits>
+
+#include <boost/container/small_vector.hpp>
+
+#if defined(__AVX2__)
+#include <immintrin.h>
+#elif defined(__ARM_NEON)
+#include <arm_neon.h>
+#endif
+
+namespace sparta {
+
+namespace bvs_impl {
+
+using Word = uint64_t;
+
+constexpr size_t kBitsPerWord = 64;
+
+/*
+ * Kernels operating on arrays of n words. They are vectorized when the target
+ * supports AVX2 or NEON, which lets the transfer functions of dense dataflow
+ * problems process 256 (resp. 128) elements per instruction.
+ */
+
+// dst |= src
+inline void or_words(Word* dst, const Word* src, size_t n) {
+  size_t i = 0;
+#if defined(__AVX2__)
+  for (; i + 4 <= n; i += 4) {
+    auto d = _mm256_loadu_si256(reinterpret_cast<const __m256i*>(dst + i));
+    auto s = _mm256_loadu_si256(reinterpret_cast<const __m256i*>(src + i));
+    _mm256_storeu_si256(reinterpret_cast<__m256i*>(dst + i),
+                        _mm256_or_si256(d, s));
+  }
+#elif defined(__ARM_NEON)
+  for (; i + 2 <= n; i += 2) {
+    vst1q_u64(dst + i, vorrq_u64(vld1q_u64(dst + i), vld1q_u64(src + i)));
+  }
+#endif
+  for (; i < n; ++i) {
+    dst[i] |= src[i];
+  }
+}
+
+// dst &= src
+inline void and_words(Word* dst, const Word* src, size_t n) {
+  size_t i = 0;
+#if defined(__AVX2__)
+  for (; i + 4 <= n; i += 4) {
+    auto d = _mm256_loadu_si256(reinterpret_cast<const __m256i*>(dst + i));
+    auto s = _mm256_loadu_si256(reinterpret_cast<const __m256i*>(src + i));
+    _mm256_storeu_si256(reinterpret_cast<__m256i*>(dst + i),
+                        _mm256_and_si256(d, s));
+  }
+#elif defined(__ARM_NEON)
+  for (; i + 2 <= n; i += 2) {
+    vst1q_u64(dst + i, vandq_u64(vld1q_u64(dst + i), vld1q_u64(src + i)));
+  }
+#endif
+  for (; i < n; ++i) {
+    dst[i] &= src[i];
+  }
+}
+
+// dst &= ~src
+inline void andnot_words(Word* dst, const Word* src, size_t n) {
+  size_t i = 0;
+#if defined(__AVX2__)
+  for (; i + 4 <= n; i += 4) {
+    auto d = _mm256_loadu_si256(reinterpret_cast<const __m256i*>(dst + i));
+    auto s = _mm256_loadu_si256(reinterpret_cast<const __m256i*>(src + i));
+    _mm256_storeu_si256(reinterpret_cast<__m256i*>(dst + i),
+                        _mm256_andnot_si256(s, d));
+  }
+#elif defined(__ARM_NEON)
+  for (; i + 2 <= n; i += 2) {
+    vst1q_u64(dst + i, vbicq_u64(vld1q_u64(dst + i), vld1q_u64(src + i)));
+  }
+#endif
+  for (; i < n; ++i) {
+    dst[i] &= ~src[i];
+  }
+}
+
+// dst = (dst & ~kill) | gen
+inline void transfer_words(Word* dst,
+                           const Word* kill,
+                           const Word* gen,
+                           size_t n) {
+  size_t i = 0;
+#if defined(__AVX2__)
+  for (; i + 4 <= n; i += 4) {
+    auto d = _mm256_loadu_si256(reinterpret_cast<const __m256i*>(dst + i));
+    auto k = _mm256_loadu_si256(reinterpret_cast<const __m256i*>(kill + i));
+    auto g = _mm256_loadu_si256(reinterpret_cast<const __m256i*>(gen + i));
+    _mm256_storeu_si256(reinterpret_cast<__m256i*>(dst + i),
+                        _mm256_or_si256(_mm256_andnot_si256(k, d), g));
+  }
+#elif defined(__ARM_NEON)
+  for (; i + 2 <= n; i += 2) {
+    auto d = vbicq_u64(vld1q_u64(dst + i), vld1q_u64(kill + i));
+    vst1q_u64(dst + i, vorrq_u64(d, vld1q_u64(gen + i)));
+  }
+#endif
+  for (; i < n; ++i) {
+    dst[i] = (dst[i] & ~kill[i]) | gen[i];
+  }
+}
+
+// (s & ~t) == 0
+inline bool is_subset_words(const Word* s, const Word* t, size_t n) {
+  size_t i = 0;
+#if defined(__AVX2__)
+  for (; i + 4 <= n; i += 4) {
+    auto a = _mm256_loadu_si256(reinterpret_cast<const __m256i*>(s + i));
+    auto b = _mm256_loadu_si256(reinterpret_cast<const __m256i*>(t + i));
+    if (!_mm256_testc_si256(b, a)) {
+      return false;
+    }
+  }
+#elif defined(__ARM_NEON)
+  for (; i + 2 <= n; i += 2) {
+    auto d = vbicq_u64(vld1q_u64(s + i), vld1q_u64(t + i));
+    if ((vgetq_lane_u64(d, 0) | vgetq_lane_u64(d, 1)) != 0) {
+      return false;
+    }
+  }
+#endif
+  for (; i < n; ++i) {
+    if ((s[i] & ~t[i]) != 0) {
+      return false;
+    }
+  }
+  return true;
+}
+
+template <typename IntegerType>
+class BitVectorSetIterator;
+
+} // namespace bvs_impl
+
+/*
+ * A set of small unsigned integers represented as a bit vector, e.g., the sets
+ * of registers manipulated by a liveness analysis. Unlike a Patricia tree,
+ * whose operations are logarithmic in the number of elements but pay for a
+ * pointer chase at every level, all operations on a bit vector are linear in
+ * the value of the largest element, and run on whole words at a time. This is
+ * the better tradeoff when the universe is dense and bounded, like the
+ * registers of a method.
+ *
+ * The vector never ends with a zero word, so that two sets are equal if and
+ * only if their words are. Iterating over a set enumerates its elements in
+ * increasing order.
+ */
+template <typename IntegerType>
+class BitVectorSet final {
+  static_assert(std::is_integral<IntegerType>::value &&
+                    std::is_unsigned<IntegerType>::value,
+                "BitVectorSet can only contain unsigned integers");
+
+ public:
+  // C++ container concept member types
+  using iterator = bvs_impl::BitVectorSetIterator<IntegerType>;
+  using const_iterator = iterator;
+  using value_type = IntegerType;
+  using difference_type = std::ptrdiff_t;
+  using size_type = size_t;
+  using const_reference = IntegerType;
+
+  // Sets of up to 256 elements are stored inline.
+  using Words = boost::container::small_vector<bvs_impl::Word, 4>;
+
+  BitVectorSet() = default;
+
+  explicit BitVectorSet(std::initializer_list<IntegerType> l) {
+    for (IntegerType x : l) {
+      insert(x);
+    }
+  }
+
+  template <typename InputIterator>
+  BitVectorSet(InputIterator first, InputIterator last) {
+    for (auto it = first; it != last; ++it) {
+      insert(*it);
+    }
+  }
+
+  bool empty() const { return m_words.empty(); }
+
+  size_t size() const {
+    size_t s = 0;
+    for (auto word : m_words) {
+      s += __builtin_popcountll(word);
+    }
+    return s;
+  }
+
+  size_t max_size() const { return std::numeric_limits<IntegerType>::max(); }
+
+  iterator begin() const { return iterator(m_words.data(), m_words.size()); }
+
+  iterator end() const { return iterator(); }
+
+  bool contains(IntegerType x) const {
+    size_t index = word_index(x);
+    return index < m_words.size() && (m_words[index] & bit_mask(x)) != 0;
+  }
+
+  bool is_subset_of(const BitVectorSet& other) const {
+    // Neither vector has trailing zero words, hence a longer vector holds an
+    // element that the shorter one doesn't.
+    if (m_words.size() > other.m_words.size()) {
+      return false;
+    }
+    return bvs_impl::is_subset_words(
+        m_words.data(), other.m_words.data(), m_words.size());
+  }
+
+  bool equals(const BitVectorSet& other) const {
+    return m_words.size() == other.m_words.size() &&
+           std::equal(m_words.begin(), m_words.end(), other.m_words.begin());
+  }
+
+  friend bool operator==(const BitVectorSet& s1, const BitVectorSet& s2) {
+    return s1.equals(s2);
+  }
+
+  friend bool operator!=(const BitVectorSet& s1, const BitVectorSet& s2) {
+    return !s1.equals(s2);
+  }
+
+  BitVectorSet& insert(IntegerType x) {
+    size_t index = word_index(x);
+    if (index >= m_words.size()) {
+      m_words.resize(index + 1, 0);
+    }
+    m_words[index] |= bit_mask(x);
+    return *this;
+  }
+
+  BitVectorSet& remove(IntegerType x) {
+    size_t index = word_index(x);
+    if (index < m_words.size()) {
+      m_words[index] &= ~bit_mask(x);
+      trim();
+    }
+    return *this;
+  }
+
+  BitVectorSet& union_with(const BitVectorSet& other) {
+    if (other.m_words.size() > m_words.size()) {
+      m_words.resize(other.m_words.size(), 0);
+    }
+    bvs_impl::or_words(
+        m_words.data(), other.m_words.data(), other.m_words.size());
+    return *this;
+  }
+
+  BitVectorSet& intersection_with(const BitVectorSet& other) {
+    if (m_words.size() > other.m_words.size()) {
+      m_words.resize(other.m_words.size());
+    }
+    bvs_impl::and_words(m_words.data(), other.m_words.data(), m_words.size());
+    trim();
+    return *this;
+  }
+
+  BitVectorSet& difference_with(const BitVectorSet& other) {
+    bvs_impl::andnot_words(m_words.data(),
+                           other.m_words.data(),
+                           std::min(m_words.size(), other.m_words.size()));
+    trim();
+    return *this;
+  }
+
+  /*
+   * Replaces this set S by (S \ kill) ∪ gen in a single pass over the words,
+   * which is the transfer function of a block in gen/kill dataflow problems
+   * like liveness.
+   */
+  BitVectorSet& difference_union_with(const BitVectorSet& kill,
+                                      const BitVectorSet& gen) {
+    if (gen.m_words.size() > m_words.size()) {
+      m_words.resize(gen.m_words.size(), 0);
+    }
+    size_t common = std::min(kill.m_words.size(), gen.m_words.size());
+    bvs_impl::transfer_words(
+        m_words.data(), kill.m_words.data(), gen.m_words.data(), common);
+    if (kill.m_words.size() > common) {
+      bvs_impl::andnot_words(
+          m_words.data() + common,
+          kill.m_words.data() + common,
+          std::min(m_words.size(), kill.m_words.size()) - common);
+    } else {
+      bvs_impl::or_words(m_words.data() + common,
+                         gen.m_words.data() + common,
+                         gen.m_words.size() - common);
+    }
+    trim();
+    return *this;
+  }
+
+  BitVectorSet get_union_with(const BitVectorSet& other) const {
+    auto result = *this;
+    result.union_with(other);
+    return result;
+  }
+
+  BitVectorSet get_intersection_with(const BitVectorSet& other) const {
+    auto result = *this;
+    result.intersection_with(other);
+    return result;
+  }
+
+  BitVectorSet get_difference_with(const BitVectorSet& other) const {
+    auto result = *this;
+    result.difference_with(other);
+    return result;
+  }
+
+  void clear() { m_words.clear(); }
+
+  friend std::ostream& operator<<(std::ostream& o, const BitVectorSet& s) {
+    o << "{";
+    for (auto it = s.begin(); it != s.end(); ++it) {
+      if (it != s.begin()) {
+        o << ", ";
+      }
+      o << *it;
+    }
+    o << "}";
+    return o;
+  }
+
+ private:
+  static size_t word_index(IntegerType x) {
+    return static_cast<size_t>(x) / bvs_impl::kBitsPerWord;
+  }
+
+  static bvs_impl::Word bit_mask(IntegerType x) {
+    return bvs_impl::Word(1)
+           << (static_cast<size_t>(x) % bvs_impl::kBitsPerWord);
+  }
+
+  void trim() {
+    while (!m_words.empty() && m_words.back() == 0) {
+      m_words.pop_back();
+    }
+  }
+
+  Words m_words;
+};
+
+namespace bvs_impl {
+
+/*
+ * Enumerates the elements of a bit vector in increasing order, skipping over
+ * zero words.
+ */
+template <typename IntegerType>
+class BitVectorSetIterator final {
+ public:
+  using iterator_category = std::forward_iterator_tag;
+  using value_type = IntegerType;
+  using difference_type = std::ptrdiff_t;
+  using pointer = const IntegerType*;
+  using reference = IntegerType;
+
+  BitVectorSetIterator() = default;
+
+  BitVectorSetIterator(const Word* words, size_t size)
+      : m_words(words), m_size(size) {
+    if (m_size > 0) {
+      m_current = m_words[0];
+      skip_zero_words();
+    }
+  }
+
+  BitVectorSetIterator& operator++() {
+    m_current &= m_current - 1;
+    skip_zero_words();
+    return *this;
+  }
+
+  BitVectorSetIterator operator++(int) {
+    BitVectorSetIterator retval = *this;
+    ++(*this);
+    return retval;
+  }
+
+  bool operator==(const BitVectorSetIterator& other) const {
+    return m_index == other.m_index && m_current == other.m_current;
+  }
+
+  bool operator!=(const BitVectorSetIterator& other) const {
+    return !(*this == other);
+  }
+
+  reference operator*() const {
+    return static_cast<IntegerType>(m_index * kBitsPerWord +
+                                    __builtin_ctzll(m_current));
+  }
+
+ private:
+  // Moves to the next nonzero word. The end iterator is represented by
+  // m_index == 0 and m_current == 0, like a default-constructed one.
+  void skip_zero_words() {
+    while (m_current == 0) {
+      if (++m_index >= m_size) {
+        m_index = 0;
+        return;
+      }
+      m_current = m_words[m_index];
+    }
+  }
+
+  const Word* m_words{nullptr};
+  size_t m_size{0};
+  size_t m_index{0};
+  Word m_current{0};
+};
+
+} // namespace bvs_impl
+
+} // namespace sparta
@@ -0,0 +1,154 @@
+/*
+ * Copyright (c) Facebook, Inc. and its affiliates.
+ *
+ * This source code is licensed under the MIT license found in the
+ * LICENSE file in the root directory of this source tree.
+ */
+
+#pragma once
+
+#include <cstddef>
+#include <initializer_list>
+#include <ostream>
+
+#include "BitVectorSet.h"
+#include "PowersetAbstractDomain.h"
+
+namespace sparta {
+
+template <typename Element>
+class BitVectorSetAbstractDomain;
+
+namespace bvsad_impl {
+
+/*
+ * An abstract value from a powerset is implemented as a bit vector.
+ */
+template <typename Element>
+class SetValue final
+    : public PowersetImplementation<Element,
+                                    const BitVectorSet<Element>&,
+                                    SetValue<Element>> {
+ public:
+  SetValue() = default;
+
+  SetValue(const Element& e) { m_set.insert(e); }
+
+  SetValue(std::initializer_list<Element> l) : m_set(l.begin(), l.end()) {}
+
+  const BitVectorSet<Element>& elements() const override { return m_set; }
+
+  size_t size() const override { return m_set.size(); }
+
+  bool contains(const Element& e) const override { return m_set.contains(e); }
+
+  void add(const Element& e) override { m_set.insert(e); }
+
+  void remove(const Element& e) override { m_set.remove(e); }
+
+  void clear() override { m_set.clear(); }
+
+  AbstractValueKind kind() const override { return AbstractValueKind::Value; }
+
+  bool leq(const SetValue& other) const override {
+    return m_set.is_subset_of(other.m_set);
+  }
+
+  bool equals(const SetValue& other) const override {
+    return m_set.equals(other.m_set);
+  }
+
+  AbstractValueKind join_with(const SetValue& other) override {
+    m_set.union_with(other.m_set);
+    return AbstractValueKind::Value;
+  }
+
+  AbstractValueKind meet_with(const SetValue& other) override {
+    m_set.intersection_with(other.m_set);
+    return AbstractValueKind::Value;
+  }
+
+  friend std::ostream& operator<<(std::ostream& o, const SetValue& value) {
+    o << "[#" << value.size() << "]";
+    o << value.m_set;
+    return o;
+  }
+
+ private:
+  BitVectorSet<Element> m_set;
+
+  template <typename T>
+  friend class sparta::BitVectorSetAbstractDomain;
+};
+
+} // namespace bvsad_impl
+
+/*
+ * An implementation of powerset abstract domains using bit vectors. This
+ * implementation should be used for dense sets of small unsigned integers
+ * drawn from a bounded universe, like the registers of a method in a liveness
+ * analysis. Sets of arbitrary objects, or sparse sets of large integers, are
+ * better served by PatriciaTreeSetAbstractDomain.
+ *
+ * Sample usage:
+ *
+ *  using Registers = BitVectorSetAbstractDomain<uint32_t>;
+ *
+ *  Registers live;
+ *  live.add(3);
+ *  live.difference_union_with(kill, gen);
+ *  for (uint32_t reg : live.elements()) {
+ *    ...
+ *  }
+ *
+ */
+template <typename Element>
+class BitVectorSetAbstractDomain final
+    : public PowersetAbstractDomain<Element,
+                                    bvsad_impl::SetValue<Element>,
+                                    const BitVectorSet<Element>&,
+                                    BitVectorSetAbstractDomain<Element>> {
+ public:
+  using Value = bvsad_impl::SetValue<Element>;
+
+  BitVectorSetAbstractDomain()
+      : PowersetAbstractDomain<Element,
+                               Value,
+                               const BitVectorSet<Element>&,
+                               BitVectorSetAbstractDomain>() {}
+
+  BitVectorSetAbstractDomain(AbstractValueKind kind)
+      : PowersetAbstractDomain<Element,
+                               Value,
+                               const BitVectorSet<Element>&,
+                               BitVectorSetAbstractDomain>(kind) {}
+
+  explicit BitVectorSetAbstractDomain(const Element& e) {
+    this->set_to_value(Value(e));
+  }
+
+  explicit BitVectorSetAbstractDomain(std::initializer_list<Element> l) {
+    this->set_to_value(Value(l));
+  }
+
+  /*
+   * Replaces the set S by (S \ kill) ∪ gen. Like add() and remove(), this has
+   * no effect on Top and Bottom.
+   */
+  void difference_union_with(const BitVectorSet<Element>& kill,
+                             const BitVectorSet<Element>& gen) {
+    if (this->kind() == AbstractValueKind::Value) {
+      this->get_value()->m_set.difference_union_with(kill, gen);
+    }
+  }
+
+  static BitVectorSetAbstractDomain bottom() {
+    return BitVectorSetAbstractDomain(AbstractValueKind::Bottom);
+  }
+
+  static BitVectorSetAbstractDomain top() {
+    return BitVectorSetAbstractDomain(AbstractValueKind::Top);
+  }
+};
+
+} // namespace sparta
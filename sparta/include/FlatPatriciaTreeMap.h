@@ -0,0 +1,679 @@
+/*
+ * Copyright (c) Facebook, Inc. and its affiliates.
+ *
+ * This source code is licensed under the MIT license found in the
+ * LICENSE file in the root directory of this source tree.
+ */
+
+#pragma once
+
+#include <algorithm>
+#include <array>
+#include <cstddef>
+#include <cstdint>
+#include <functional>
+#include <iterator>
+#include <limits>
+#include <memory>
+#include <ostream>
+#include <type_traits>
+#include <utility>
+
+#include <boost/container/static_vector.hpp>
+
+#ifdef __SSE2__
+#include <emmintrin.h>
+#endif
+
+#include "PatriciaTreeMap.h"
+
+// Forward declarations
+namespace sparta {
+
+template <typename Key, typename ValueType, typename Value, size_t Capacity>
+class FlatPatriciaTreeMap;
+
+} // namespace sparta
+
+template <typename Key, typename ValueType, typename Value, size_t Capacity>
+std::ostream& operator<<(
+    std::ostream&,
+    const typename sparta::
+        FlatPatriciaTreeMap<Key, ValueType, Value, Capacity>&);
+
+namespace sparta {
+
+namespace fptmap_impl {
+
+/*
+ * Iterates over the inline bindings of a small map, or over the Patricia tree
+ * of a large one.
+ */
+template <typename Key, typename Value>
+class FlatPatriciaTreeIterator final {
+ public:
+  // C++ iterator concept member types
+  using iterator_category = std::forward_iterator_tag;
+  using mapped_type = typename Value::type;
+  using value_type = std::pair<Key, mapped_type>;
+  using difference_type = std::ptrdiff_t;
+  using pointer = value_type*;
+  using reference = const value_type&;
+
+  using TreeIterator =
+      typename PatriciaTreeMap<Key, mapped_type, Value>::iterator;
+
+  FlatPatriciaTreeIterator() {}
+
+  explicit FlatPatriciaTreeIterator(const value_type* binding)
+      : m_binding(binding) {}
+
+  explicit FlatPatriciaTreeIterator(TreeIterator it)
+      : m_tree_iterator(std::move(it)) {}
+
+  FlatPatriciaTreeIterator& operator++() {
+    if (m_binding != nullptr) {
+      ++m_binding;
+    } else {
+      ++m_tree_iterator;
+    }
+    return *this;
+  }
+
+  FlatPatriciaTreeIterator operator++(int) {
+    FlatPatriciaTreeIterator retval = *this;
+    ++(*this);
+    return retval;
+  }
+
+  bool operator==(const FlatPatriciaTreeIterator& other) const {
+    return m_binding == other.m_binding &&
+           m_tree_iterator == other.m_tree_iterator;
+  }
+
+  bool operator!=(const FlatPatriciaTreeIterator& other) const {
+    return !(*this == other);
+  }
+
+  const value_type& operator*() {
+    return m_binding != nullptr ? *m_binding : *m_tree_iterator;
+  }
+
+  const value_type* operator->() { return &**this; }
+
+ private:
+  // Null when iterating over a Patricia tree.
+  const value_type* m_binding{nullptr};
+  TreeIterator m_tree_iterator;
+};
+
+} // namespace fptmap_impl
+
+/*
+ * A map with the same semantics as PatriciaTreeMap, for maps that are almost
+ * always small, such as the register environments of an abstract interpreter.
+ *
+ * Up to Capacity bindings are stored in a single array sorted by key. Keys are
+ * looked up by comparing them all at once, with SSE2 when the keys are 32-bit
+ * integers, instead of chasing pointers through the nodes of a tree. The array
+ * is shared by the copies of a map and copied on their first write, so that
+ * copying a map is as cheap as copying a Patricia tree.
+ *
+ * When an operation creates more than Capacity bindings, they are moved to a
+ * PatriciaTreeMap. They only move back to the array once an operation leaves at
+ * most Capacity / 2 bindings, so that a map whose size hovers around the
+ * threshold does not keep switching representation.
+ *
+ * The Value parameter is the same as for PatriciaTreeMap.
+ */
+template <typename Key,
+          typename ValueType,
+          typename Value = ptmap_impl::SimpleValue<ValueType>,
+          size_t Capacity = 16>
+class FlatPatriciaTreeMap final {
+ public:
+  // C++ container concept member types
+  using key_type = Key;
+  using mapped_type = typename Value::type;
+  using value_type = std::pair<Key, mapped_type>;
+  using iterator = fptmap_impl::FlatPatriciaTreeIterator<Key, Value>;
+  using const_iterator = iterator;
+  using difference_type = std::ptrdiff_t;
+  using size_type = size_t;
+  using const_reference = const mapped_type&;
+  using const_pointer = const mapped_type*;
+
+  using IntegerType =
+      typename std::conditional_t<std::is_pointer<Key>::value, uintptr_t, Key>;
+  using TreeMap = PatriciaTreeMap<Key, ValueType, Value>;
+  using combining_function = ptmap_impl::CombiningFunction<mapped_type>;
+  using mapping_function = ptmap_impl::MappingFunction<mapped_type>;
+
+  static_assert(Capacity > 0 && Capacity % 4 == 0,
+                "Capacity must be a positive multiple of 4");
+
+  bool empty() const { return m_large ? m_tree.empty() : flat_size() == 0; }
+
+  size_t size() const { return m_large ? m_tree.size() : flat_size(); }
+
+  size_t max_size() const { return std::numeric_limits<IntegerType>::max(); }
+
+  // Whether the bindings are stored in the array.
+  bool is_flat() const { return !m_large; }
+
+  iterator begin() const {
+    if (m_flat == nullptr) {
+      return iterator(m_tree.begin());
+    }
+    return iterator(m_flat->bindings.data());
+  }
+
+  iterator end() const {
+    if (m_flat == nullptr) {
+      return iterator(m_tree.end());
+    }
+    return iterator(m_flat->bindings.data() + m_flat->bindings.size());
+  }
+
+  const mapped_type at(Key key) const {
+    if (m_large) {
+      return m_tree.at(key);
+    }
+    size_t i = find(encode(key));
+    if (i == flat_size()) {
+      return Value::default_value();
+    }
+    return m_flat->bindings[i].second;
+  }
+
+  bool leq(const FlatPatriciaTreeMap& other) const {
+    if (m_large || other.m_large) {
+      return as_tree().leq(other.as_tree());
+    }
+    if (m_flat == other.m_flat) {
+      return true;
+    }
+    bool result = true;
+    merge_bindings(
+        other,
+        [&result](const value_type& x) {
+          result = Value::leq(x.second, Value::default_value());
+        },
+        [&result](const value_type& y) {
+          result = Value::leq(Value::default_value(), y.second);
+        },
+        [&result](const value_type& x, const value_type& y) {
+          result = Value::leq(x.second, y.second);
+        },
+        [&result] { return !result; });
+    return result;
+  }
+
+  bool equals(const FlatPatriciaTreeMap& other) const {
+    if (m_large || other.m_large) {
+      return as_tree().equals(other.as_tree());
+    }
+    if (m_flat == other.m_flat) {
+      return true;
+    }
+    if (flat_size() != other.flat_size()) {
+      return false;
+    }
+    for (size_t i = 0; i < flat_size(); ++i) {
+      if (m_flat->keys[i] != other.m_flat->keys[i] ||
+          !Value::equals(m_flat->bindings[i].second,
+                         other.m_flat->bindings[i].second)) {
+        return false;
+      }
+    }
+    return true;
+  }
+
+  friend bool operator==(const FlatPatriciaTreeMap& m1,
+                         const FlatPatriciaTreeMap& m2) {
+    return m1.equals(m2);
+  }
+
+  friend bool operator!=(const FlatPatriciaTreeMap& m1,
+                         const FlatPatriciaTreeMap& m2) {
+    return !m1.equals(m2);
+  }
+
+  FlatPatriciaTreeMap& update(
+      const std::function<mapped_type(const mapped_type&)>& operation,
+      Key key) {
+    if (m_large) {
+      m_tree.update(operation, key);
+      return *this;
+    }
+    IntegerType encoded = encode(key);
+    size_t i = lower_bound(encoded);
+    if (i < flat_size() && m_flat->keys[i] == encoded) {
+      auto value = operation(m_flat->bindings[i].second);
+      if (Value::is_default_value(value)) {
+        erase_at(i);
+      } else {
+        mutable_flat().bindings[i].second = std::move(value);
+      }
+      return *this;
+    }
+    auto value = operation(Value::default_value());
+    if (!Value::is_default_value(value)) {
+      insert_at(i, key, std::move(value));
+    }
+    return *this;
+  }
+
+  bool map(const mapping_function& f) {
+    if (m_large) {
+      bool res = m_tree.map(f);
+      shrink_if_small();
+      return res;
+    }
+    if (m_flat == nullptr) {
+      return false;
+    }
+    bool res = false;
+    Bindings result;
+    for (const auto& binding : m_flat->bindings) {
+      auto value = f(binding.second);
+      if (Value::is_default_value(value)) {
+        res = true;
+        continue;
+      }
+      if (!Value::equals(value, binding.second)) {
+        res = true;
+      }
+      result.emplace_back(binding.first, std::move(value));
+    }
+    if (res) {
+      set_flat(std::move(result));
+    }
+    return res;
+  }
+
+  bool erase_all_matching(Key key_mask) {
+    if (m_large) {
+      bool res = m_tree.erase_all_matching(key_mask);
+      shrink_if_small();
+      return res;
+    }
+    if (m_flat == nullptr) {
+      return false;
+    }
+    IntegerType mask = encode(key_mask);
+    Bindings result;
+    for (const auto& binding : m_flat->bindings) {
+      if ((encode(binding.first) & mask) == 0) {
+        result.push_back(binding);
+      }
+    }
+    if (result.size() == flat_size()) {
+      return false;
+    }
+    set_flat(std::move(result));
+    return true;
+  }
+
+  FlatPatriciaTreeMap& insert_or_assign(Key key, const mapped_type& value) {
+    if (m_large) {
+      m_tree.insert_or_assign(key, value);
+      return *this;
+    }
+    IntegerType encoded = encode(key);
+    size_t i = lower_bound(encoded);
+    bool found = i < flat_size() && m_flat->keys[i] == encoded;
+    if (Value::is_default_value(value)) {
+      if (found) {
+        erase_at(i);
+      }
+    } else if (found) {
+      mutable_flat().bindings[i].second = value;
+    } else {
+      insert_at(i, key, value);
+    }
+    return *this;
+  }
+
+  FlatPatriciaTreeMap& union_with(const combining_function& combine,
+                                  const FlatPatriciaTreeMap& other) {
+    if (m_large || other.m_large) {
+      union_of_trees(combine, other);
+      return *this;
+    }
+    if (other.m_flat == nullptr) {
+      return *this;
+    }
+    if (m_flat == nullptr) {
+      m_flat = other.m_flat;
+      return *this;
+    }
+    size_t union_size = flat_size() + other.flat_size();
+    merge_bindings(other,
+                   [](const value_type&) {},
+                   [](const value_type&) {},
+                   [&union_size](const value_type&, const value_type&) {
+                     --union_size;
+                   },
+                   [] { return false; });
+    if (union_size > Capacity) {
+      union_of_trees(combine, other);
+      return *this;
+    }
+    Bindings result;
+    merge_bindings(
+        other,
+        [&result](const value_type& x) { result.push_back(x); },
+        [&result](const value_type& y) { result.push_back(y); },
+        [&result, &combine](const value_type& x, const value_type& y) {
+          auto value = combine(x.second, y.second);
+          if (!Value::is_default_value(value)) {
+            result.emplace_back(x.first, std::move(value));
+          }
+        },
+        [] { return false; });
+    set_flat(std::move(result));
+    return *this;
+  }
+
+  FlatPatriciaTreeMap& intersection_with(const combining_function& combine,
+                                         const FlatPatriciaTreeMap& other) {
+    if (m_large && other.m_large) {
+      m_tree.intersection_with(combine, other.m_tree);
+      shrink_if_small();
+      return *this;
+    }
+    // The result has at most as many bindings as the small operand.
+    Bindings result;
+    auto keep = [&result](Key key, mapped_type value) {
+      if (!Value::is_default_value(value)) {
+        result.emplace_back(key, std::move(value));
+      }
+    };
+    if (m_large) {
+      for (const auto& binding : other) {
+        auto x = m_tree.at(binding.first);
+        if (!Value::is_default_value(x)) {
+          keep(binding.first, combine(x, binding.second));
+        }
+      }
+    } else if (other.m_large) {
+      for (const auto& binding : *this) {
+        auto y = other.m_tree.at(binding.first);
+        if (!Value::is_default_value(y)) {
+          keep(binding.first, combine(binding.second, y));
+        }
+      }
+    } else {
+      merge_bindings(other,
+                     [](const value_type&) {},
+                     [](const value_type&) {},
+                     [&](const value_type& x, const value_type& y) {
+                       keep(x.first, combine(x.second, y.second));
+                     },
+                     [] { return false; });
+    }
+    set_flat(std::move(result));
+    return *this;
+  }
+
+  FlatPatriciaTreeMap get_union_with(const combining_function& combine,
+                                     const FlatPatriciaTreeMap& other) const {
+    auto result = *this;
+    result.union_with(combine, other);
+    return result;
+  }
+
+  FlatPatriciaTreeMap get_intersection_with(
+      const combining_function& combine,
+      const FlatPatriciaTreeMap& other) const {
+    auto result = *this;
+    result.intersection_with(combine, other);
+    return result;
+  }
+
+  void clear() {
+    m_flat.reset();
+    m_tree.clear();
+    m_large = false;
+  }
+
+ private:
+  using Bindings = boost::container::static_vector<value_type, Capacity>;
+
+  struct FlatBindings {
+    FlatBindings() { keys.fill(no_key()); }
+
+    // The encoded keys of the bindings, in the same order. The slots past the
+    // last binding hold no_key(), which never compares less than a key.
+    std::array<IntegerType, Capacity> keys;
+    Bindings bindings;
+  };
+
+  static IntegerType no_key() {
+    return std::numeric_limits<IntegerType>::max();
+  }
+
+  size_t flat_size() const {
+    return m_flat == nullptr ? 0 : m_flat->bindings.size();
+  }
+
+  // The index of the first binding whose key is not less than the given key.
+  size_t lower_bound(IntegerType key) const {
+    if (m_flat == nullptr) {
+      return 0;
+    }
+    const auto& keys = m_flat->keys;
+    size_t size = m_flat->bindings.size();
+#ifdef __SSE2__
+    if (sizeof(IntegerType) == sizeof(int32_t)) {
+      // SSE2 only has signed comparisons, hence we flip the sign bits.
+      const __m128i bias = _mm_set1_epi32(std::numeric_limits<int32_t>::min());
+      const __m128i needle =
+          _mm_xor_si128(_mm_set1_epi32(static_cast<int32_t>(key)), bias);
+      size_t count = 0;
+      for (size_t i = 0; i < size; i += 4) {
+        __m128i block = _mm_xor_si128(
+            _mm_loadu_si128(reinterpret_cast<const __m128i*>(&keys[i])), bias);
+        int less =
+            _mm_movemask_ps(_mm_castsi128_ps(_mm_cmplt_epi32(block, needle)));
+        count += __builtin_popcount(less);
+      }
+      return count;
+    }
+#endif
+    return std::lower_bound(keys.begin(), keys.begin() + size, key) -
+           keys.begin();
+  }
+
+  // The index of the binding of the given key, or flat_size() if there is none.
+  size_t find(IntegerType key) const {
+    size_t i = lower_bound(key);
+    if (i < flat_size() && m_flat->keys[i] == key) {
+      return i;
+    }
+    return flat_size();
+  }
+
+  // Copies the array if it is shared with another map.
+  FlatBindings& mutable_flat() {
+    if (m_flat == nullptr) {
+      m_flat = std::make_shared<FlatBindings>();
+    } else if (m_flat.use_count() > 1) {
+      m_flat = std::make_shared<FlatBindings>(*m_flat);
+    }
+    return *m_flat;
+  }
+
+  void insert_at(size_t i, Key key, mapped_type value) {
+    size_t size = flat_size();
+    if (size == Capacity) {
+      auto tree = as_tree();
+      tree.insert_or_assign(key, value);
+      set_tree(std::move(tree));
+      return;
+    }
+    auto& flat = mutable_flat();
+    std::copy_backward(flat.keys.begin() + i,
+                       flat.keys.begin() + size,
+                       flat.keys.begin() + size + 1);
+    flat.keys[i] = encode(key);
+    flat.bindings.emplace(flat.bindings.begin() + i, key, std::move(value));
+  }
+
+  void erase_at(size_t i) {
+    size_t size = flat_size();
+    if (size == 1) {
+      m_flat.reset();
+      return;
+    }
+    auto& flat = mutable_flat();
+    std::copy(flat.keys.begin() + i + 1,
+              flat.keys.begin() + size,
+              flat.keys.begin() + i);
+    flat.keys[size - 1] = no_key();
+    flat.bindings.erase(flat.bindings.begin() + i);
+  }
+
+  // Replaces the bindings with the given ones, which are sorted by key.
+  void set_flat(Bindings bindings) {
+    m_tree.clear();
+    m_large = false;
+    if (bindings.empty()) {
+      m_flat.reset();
+      return;
+    }
+    if (m_flat == nullptr || m_flat.use_count() > 1) {
+      m_flat = std::make_shared<FlatBindings>();
+    }
+    auto& flat = *m_flat;
+    flat.bindings = std::move(bindings);
+    for (size_t i = 0; i < flat.bindings.size(); ++i) {
+      flat.keys[i] = encode(flat.bindings[i].first);
+    }
+    std::fill(
+        flat.keys.begin() + flat.bindings.size(), flat.keys.end(), no_key());
+  }
+
+  /*
+   * Walks the sorted bindings of both small maps in lockstep, calling
+   * only_this, only_other or both for each key depending on where it is
+   * bound, until stop() returns true.
+   */
+  template <typename OnlyThis, typename OnlyOther, typename Both, typename Stop>
+  void merge_bindings(const FlatPatriciaTreeMap& other,
+                      const OnlyThis& only_this,
+                      const OnlyOther& only_other,
+                      const Both& both,
+                      const Stop& stop) const {
+    size_t i = 0;
+    size_t j = 0;
+    size_t n = flat_size();
+    size_t m = other.flat_size();
+    while ((i < n || j < m) && !stop()) {
+      if (j == m || (i < n && m_flat->keys[i] < other.m_flat->keys[j])) {
+        only_this(m_flat->bindings[i++]);
+      } else if (i == n || other.m_flat->keys[j] < m_flat->keys[i]) {
+        only_other(other.m_flat->bindings[j++]);
+      } else {
+        both(m_flat->bindings[i++], other.m_flat->bindings[j++]);
+      }
+    }
+  }
+
+  TreeMap as_tree() const {
+    if (m_large) {
+      return m_tree;
+    }
+    TreeMap tree;
+    for (const auto& binding : *this) {
+      tree.insert_or_assign(binding.first, binding.second);
+    }
+    return tree;
+  }
+
+  void set_tree(TreeMap tree) {
+    m_flat.reset();
+    m_tree = std::move(tree);
+    m_large = true;
+  }
+
+  void union_of_trees(const combining_function& combine,
+                      const FlatPatriciaTreeMap& other) {
+    auto tree = as_tree();
+    tree.union_with(combine, other.as_tree());
+    set_tree(std::move(tree));
+  }
+
+  // Moves the bindings of a large map back to the array once there are few
+  // enough of them.
+  void shrink_if_small() {
+    Bindings bindings;
+    for (const auto& binding : m_tree) {
+      if (bindings.size() == Capacity / 2) {
+        return;
+      }
+      bindings.push_back(binding);
+    }
+    std::sort(bindings.begin(),
+              bindings.end(),
+              [](const value_type& x, const value_type& y) {
+                return encode(x.first) < encode(y.first);
+              });
+    set_flat(std::move(bindings));
+  }
+
+  template <typename T = Key,
+            typename std::enable_if_t<std::is_pointer<T>::value, int> = 0>
+  static uintptr_t encode(Key x) {
+    return reinterpret_cast<uintptr_t>(x);
+  }
+
+  template <typename T = Key,
+            typename std::enable_if_t<!std::is_pointer<T>::value, int> = 0>
+  static Key encode(Key x) {
+    return x;
+  }
+
+  template <typename T = Key,
+            typename std::enable_if_t<std::is_pointer<T>::value, int> = 0>
+  static const typename std::remove_pointer<T>::type& deref(Key x) {
+    return *x;
+  }
+
+  template <typename T = Key,
+            typename std::enable_if_t<!std::is_pointer<T>::value, int> = 0>
+  static Key deref(Key x) {
+    return x;
+  }
+
+  // Null when the map is large or empty.
+  std::shared_ptr<FlatBindings> m_flat;
+  // Holds the bindings instead of the array when m_large is set.
+  TreeMap m_tree;
+  bool m_large{false};
+
+  template <typename T, typename VT, typename V, size_t C>
+  friend std::ostream& ::operator<<(std::ostream&,
+                                    const FlatPatriciaTreeMap<T, VT, V, C>&);
+};
+
+} // namespace sparta
+
+template <typename Key, typename ValueType, typename Value, size_t Capacity>
+inline std::ostream& operator<<(
+    std::ostream& o,
+    const typename sparta::
+        FlatPatriciaTreeMap<Key, ValueType, Value, Capacity>& s) {
+  using namespace sparta;
+  o << "{";
+  for (auto it = s.begin(); it != s.end(); ++it) {
+    o << FlatPatriciaTreeMap<Key, ValueType, Value, Capacity>::deref(it->first)
+      << " -> " << it->second;
+    if (std::next(it) != s.end()) {
+      o << ", ";
+    }
+  }
+  o << "}";
+  return o;
+}
@@ -0,0 +1,310 @@
+/*
+ * Copyright (c) Facebook, Inc. and its affiliates.
+ *
+ * This source code is licensed under the MIT license found in the
+ * LICENSE file in the root directory of this source tree.
+ */
+
+#pragma once
+
+#include <cstddef>
+#include <functional>
+#include <initializer_list>
+#include <ostream>
+#include <utility>
+
+#include "AbstractDomain.h"
+#include "FlatPatriciaTreeMap.h"
+#include "PatriciaTreeMapAbstractEnvironment.h"
+
+namespace sparta {
+
+namespace fptmae_impl {
+
+template <typename Variable, typename Domain, size_t Capacity>
+class MapValue;
+
+} // namespace fptmae_impl
+
+/*
+ * An abstract environment for environments that are almost always small, e.g.,
+ * the register environments of methods, most of which have fewer than 16
+ * registers. It behaves exactly like a PatriciaTreeMapAbstractEnvironment, but
+ * stores up to Capacity bindings in a sorted inline array, and only falls back
+ * to a Patricia tree above that (see FlatPatriciaTreeMap.h).
+ *
+ * Small environments are faster to query and to update in place, but copying
+ * one copies its bindings instead of sharing a tree.
+ */
+template <typename Variable, typename Domain, size_t Capacity = 16>
+class FlatPatriciaTreeMapAbstractEnvironment final
+    : public AbstractDomainScaffolding<
+          fptmae_impl::MapValue<Variable, Domain, Capacity>,
+          FlatPatriciaTreeMapAbstractEnvironment<Variable, Domain, Capacity>> {
+ public:
+  using Value = fptmae_impl::MapValue<Variable, Domain, Capacity>;
+
+  using MapType = FlatPatriciaTreeMap<Variable,
+                                      Domain,
+                                      typename Value::ValueInterface,
+                                      Capacity>;
+
+  /*
+   * The default constructor produces the Top value.
+   */
+  FlatPatriciaTreeMapAbstractEnvironment()
+      : AbstractDomainScaffolding<Value,
+                                  FlatPatriciaTreeMapAbstractEnvironment>() {}
+
+  FlatPatriciaTreeMapAbstractEnvironment(AbstractValueKind kind)
+      : AbstractDomainScaffolding<Value,
+                                  FlatPatriciaTreeMapAbstractEnvironment>(
+            kind) {}
+
+  FlatPatriciaTreeMapAbstractEnvironment(
+      std::initializer_list<std::pair<Variable, Domain>> l) {
+    for (const auto& p : l) {
+      if (p.second.is_bottom()) {
+        this->set_to_bottom();
+        return;
+      }
+      this->get_value()->insert_binding(p.first, p.second);
+    }
+    this->normalize();
+  }
+
+  size_t size() const {
+    RUNTIME_CHECK(this->kind() == AbstractValueKind::Value,
+                  invalid_abstract_value()
+                      << expected_kind(AbstractValueKind::Value)
+                      << actual_kind(this->kind()));
+    return this->get_value()->m_map.size();
+  }
+
+  const MapType& bindings() const {
+    RUNTIME_CHECK(this->kind() == AbstractValueKind::Value,
+                  invalid_abstract_value()
+                      << expected_kind(AbstractValueKind::Value)
+                      << actual_kind(this->kind()));
+    return this->get_value()->m_map;
+  }
+
+  Domain get(const Variable& variable) const {
+    if (this->is_bottom()) {
+      return Domain::bottom();
+    }
+    return this->get_value()->m_map.at(variable);
+  }
+
+  FlatPatriciaTreeMapAbstractEnvironment& set(const Variable& variable,
+                                              const Domain& value) {
+    if (this->is_bottom()) {
+      return *this;
+    }
+    if (value.is_bottom()) {
+      this->set_to_bottom();
+      return *this;
+    }
+    this->get_value()->insert_binding(variable, value);
+    this->normalize();
+    return *this;
+  }
+
+  bool map(std::function<Domain(const Domain&)> f) {
+    if (this->is_bottom()) {
+      return false;
+    }
+    bool res = this->get_value()->m_map.map(f);
+    this->normalize();
+    return res;
+  }
+
+  bool erase_all_matching(const Variable& variable_mask) {
+    if (this->is_bottom()) {
+      return false;
+    }
+    bool res = this->get_value()->m_map.erase_all_matching(variable_mask);
+    this->normalize();
+    return res;
+  }
+
+  FlatPatriciaTreeMapAbstractEnvironment& clear() {
+    if (this->is_bottom()) {
+      return *this;
+    }
+    this->get_value()->clear();
+    this->normalize();
+    return *this;
+  }
+
+  FlatPatriciaTreeMapAbstractEnvironment& update(
+      const Variable& variable,
+      std::function<Domain(const Domain&)> operation) {
+    if (this->is_bottom()) {
+      return *this;
+    }
+    try {
+      this->get_value()->m_map.update(
+          [&operation](const Domain& x) {
+            Domain result = operation(x);
+            if (result.is_bottom()) {
+              throw ptmae_impl::value_is_bottom();
+            }
+            return result;
+          },
+          variable);
+    } catch (const ptmae_impl::value_is_bottom&) {
+      this->set_to_bottom();
+    }
+    this->normalize();
+    return *this;
+  }
+
+  static FlatPatriciaTreeMapAbstractEnvironment bottom() {
+    return FlatPatriciaTreeMapAbstractEnvironment(AbstractValueKind::Bottom);
+  }
+
+  static FlatPatriciaTreeMapAbstractEnvironment top() {
+    return FlatPatriciaTreeMapAbstractEnvironment(AbstractValueKind::Top);
+  }
+};
+
+} // namespace sparta
+
+template <typename Variable, typename Domain, size_t Capacity>
+inline std::ostream& operator<<(
+    std::ostream& o,
+    const typename sparta::
+        FlatPatriciaTreeMapAbstractEnvironment<Variable, Domain, Capacity>& e) {
+  using namespace sparta;
+  switch (e.kind()) {
+  case AbstractValueKind::Bottom: {
+    o << "_|_";
+    break;
+  }
+  case AbstractValueKind::Top: {
+    o << "T";
+    break;
+  }
+  case AbstractValueKind::Value: {
+    o << "[#" << e.size() << "]";
+    o << e.bindings();
+    break;
+  }
+  }
+  return o;
+}
+
+namespace sparta {
+
+namespace fptmae_impl {
+
+/*
+ * The element of a FlatPatriciaTreeMapAbstractEnvironment. As in
+ * PatriciaTreeMapAbstractEnvironment, bindings to Top are not stored, and
+ * bindings to Bottom never occur: they turn the whole environment into Bottom.
+ */
+template <typename Variable, typename Domain, size_t Capacity>
+class MapValue final
+    : public AbstractValue<MapValue<Variable, Domain, Capacity>> {
+ public:
+  struct ValueInterface {
+    using type = Domain;
+
+    static type default_value() { return type::top(); }
+
+    static bool is_default_value(const type& x) { return x.is_top(); }
+
+    static bool equals(const type& x, const type& y) { return x.equals(y); }
+
+    static bool leq(const type& x, const type& y) { return x.leq(y); }
+  };
+
+  using MapType =
+      FlatPatriciaTreeMap<Variable, Domain, ValueInterface, Capacity>;
+
+  MapValue() = default;
+
+  MapValue(const Variable& variable, const Domain& value) {
+    insert_binding(variable, value);
+  }
+
+  void clear() override { m_map.clear(); }
+
+  AbstractValueKind kind() const override {
+    // If the map is empty, then all variables are implicitly bound to Top,
+    // i.e., the abstract environment itself is Top.
+    return m_map.empty() ? AbstractValueKind::Top : AbstractValueKind::Value;
+  }
+
+  bool leq(const MapValue& other) const override {
+    return m_map.leq(other.m_map);
+  }
+
+  bool equals(const MapValue& other) const override {
+    return m_map.equals(other.m_map);
+  }
+
+  AbstractValueKind join_with(const MapValue& other) override {
+    return join_like_operation(
+        other, [](const Domain& x, const Domain& y) { return x.join(y); });
+  }
+
+  AbstractValueKind widen_with(const MapValue& other) override {
+    return join_like_operation(
+        other, [](const Domain& x, const Domain& y) { return x.widening(y); });
+  }
+
+  AbstractValueKind meet_with(const MapValue& other) override {
+    return meet_like_operation(
+        other, [](const Domain& x, const Domain& y) { return x.meet(y); });
+  }
+
+  AbstractValueKind narrow_with(const MapValue& other) override {
+    return meet_like_operation(
+        other, [](const Domain& x, const Domain& y) { return x.narrowing(y); });
+  }
+
+ private:
+  void insert_binding(const Variable& variable, const Domain& value) {
+    // The Bottom value is handled by the caller and should never occur here.
+    RUNTIME_CHECK(!value.is_bottom(), internal_error());
+    m_map.insert_or_assign(variable, value);
+  }
+
+  AbstractValueKind join_like_operation(
+      const MapValue& other,
+      std::function<Domain(const Domain&, const Domain&)> operation) {
+    m_map.intersection_with(operation, other.m_map);
+    return kind();
+  }
+
+  AbstractValueKind meet_like_operation(
+      const MapValue& other,
+      std::function<Domain(const Domain&, const Domain&)> operation) {
+    try {
+      m_map.union_with(
+          [&operation](const Domain& x, const Domain& y) {
+            Domain result = operation(x, y);
+            if (result.is_bottom()) {
+              throw ptmae_impl::value_is_bottom();
+            }
+            return result;
+          },
+          other.m_map);
+      return kind();
+    } catch (const ptmae_impl::value_is_bottom&) {
+      clear();
+      return AbstractValueKind::Bottom;
+    }
+  }
+
+  MapType m_map;
+
+  template <typename T1, typename T2, size_t T3>
+  friend class sparta::FlatPatriciaTreeMapAbstractEnvironment;
+};
+
+} // namespace fptmae_impl
+
+} // namespace sparta
@@ -10,8 +10,12 @@
 #include <algorithm>
 #include <cstddef>
 #include <functional>
+#include <memory>
+#include <queue>
 #include <type_traits>
 #include <unordered_map>
+#include <unordered_set>
+#include <utility>
 #include <vector>
 
 #include "AbstractDomain.h"
@@ -22,8 +26,56 @@
 
 namespace sparta {
 
+template <typename GraphInterface,
+          typename NodeHash = std::hash<typename GraphInterface::NodeId>>
+std::shared_ptr<
+    const WeakPartialOrdering<typename GraphInterface::NodeId, NodeHash>>
+make_weak_partial_ordering(const typename GraphInterface::Graph& graph);
+
 namespace fp_impl {
 
+/*
+ * A graph interface may provide a weak partial ordering of its graph that is
+ * shared across fixpoint iterators, e.g., because it is cached on the graph:
+ *
+ *   static std::shared_ptr<const WeakPartialOrdering<NodeId>>
+ *   weak_partial_ordering(const Graph& graph);
+ *
+ * Otherwise, every fixpoint iterator computes its own.
+ */
+template <typename GraphInterface, typename NodeHash, typename = void>
+struct WeakPartialOrderingProvider {
+  static std::shared_ptr<
+      const WeakPartialOrdering<typename GraphInterface::NodeId, NodeHash>>
+  get(const typename GraphInterface::Graph& graph) {
+    return make_weak_partial_ordering<GraphInterface, NodeHash>(graph);
+  }
+};
+
+template <typename GraphInterface, typename NodeHash>
+struct WeakPartialOrderingProvider<
+    GraphInterface,
+    NodeHash,
+    typename std::enable_if<std::is_same<
+        decltype(GraphInterface::weak_partial_ordering(
+            std::declval<const typename GraphInterface::Graph&>())),
+        std::shared_ptr<const WeakPartialOrdering<
+            typename GraphInterface::NodeId,
+            NodeHash>>>::value>::type> {
+  static std::shared_ptr<
+      const WeakPartialOrdering<typename GraphInterface::NodeId, NodeHash>>
+  get(const typename GraphInterface::Graph& graph) {
+    return GraphInterface::weak_partial_ordering(graph);
+  }
+};
+
+template <typename GraphInterface, typename NodeHash>
+std::shared_ptr<
+    const WeakPartialOrdering<typename GraphInterface::NodeId, NodeHash>>
+get_weak_partial_ordering(const typename GraphInterface::Graph& graph) {
+  return WeakPartialOrderingProvider<GraphInterface, NodeHash>::get(graph);
+}
+
 /*
  * This data structure contains the current state of the fixpoint iteration,
  * which is provided to the user when an extrapolation step is executed, so as
@@ -177,6 +229,25 @@ class MonotonicFixpointIteratorBase
     m_exit_states.clear();
   }
 
+  /*
+   * Drops the invariants at the node exits, for clients that only query the
+   * entry states once the iteration is done. Afterwards, get_exit_state_at
+   * returns _|_ everywhere.
+   */
+  void clear_exit_states() { m_exit_states.clear(); }
+
+  /*
+   * Sets the invariants at the entry and exit of a node, for the iterators
+   * that compute them by other means than the iteration, e.g. from the
+   * results of a sparse analysis.
+   */
+  void set_states_at(const NodeId& node,
+                     Domain entry_state,
+                     Domain exit_state) {
+    m_entry_states[node] = std::move(entry_state);
+    m_exit_states[node] = std::move(exit_state);
+  }
+
   void set_all_to_bottom(std::unordered_set<NodeId>& all_nodes) {
     // Pre-populate entry and exit states for all nodes.
     for (auto& node : all_nodes) {
@@ -365,28 +436,8 @@ class ParallelMonotonicFixpointIterator
       : fp_impl::
             MonotonicFixpointIteratorBase<GraphInterface, Domain, NodeHash>(
                 graph, /*cfg_size_hint*/ 4),
-        m_wpo(GraphInterface::entry(graph),
-              [=, &graph](const NodeId& x) {
-                const auto& succ_edges = GraphInterface::successors(graph, x);
-                std::vector<NodeId> succ_nodes_tmp;
-                std::transform(succ_edges.begin(),
-                               succ_edges.end(),
-                               std::back_inserter(succ_nodes_tmp),
-                               std::bind(&GraphInterface::target,
-                                         std::ref(graph),
-                                         std::placeholders::_1));
-                // Filter out duplicate succ nodes.
-                std::vector<NodeId> succ_nodes;
-                std::unordered_set<NodeId> succ_nodes_set;
-                for (auto node : succ_nodes_tmp) {
-                  if (!succ_nodes_set.count(node)) {
-                    succ_nodes_set.emplace(node);
-                    succ_nodes.emplace_back(node);
-                  }
-                }
-                return succ_nodes;
-              },
-              false),
+        m_wpo(fp_impl::get_weak_partial_ordering<GraphInterface, NodeHash>(
+            graph)),
         m_num_thread(num_thread) {
     // Gathering all reachable nodes in graph.
     std::stack<NodeId> node_queue;
@@ -411,28 +462,72 @@ class ParallelMonotonicFixpointIterator
    * with different values in order to analyze the program under different
    * initial conditions.
    */
-  void run(const Domain& init) {
+  void run(const Domain& init) { run(init, /* previous_run */ nullptr); }
+
+  /*
+   * Executes the fixpoint iterator again after the semantics of some nodes
+   * has changed since the previous run, e.g., because the summaries of the
+   * functions that they call have been refined between two global iterations
+   * of an interprocedural analysis. A node that is not in `changed_nodes` is
+   * only analyzed again if its entry state differs from all the ones it was
+   * analyzed with during the previous run, so that only the part of the graph
+   * that is actually affected by the change is recomputed.
+   *
+   * In order to support this, every run records the entry and exit states of
+   * each analysis of a node.
+   */
+  void run_incrementally(const Domain& init,
+                         const std::unordered_set<NodeId>& changed_nodes) {
+    PreviousRun previous_run{changed_nodes, {}};
+    previous_run.analyses.swap(m_analyses);
+    run(init, &previous_run);
+  }
+
+  /*
+   * Releases the states recorded for run_incrementally, when there won't be
+   * another incremental run. The invariants are not affected.
+   */
+  void discard_recorded_analyses() { Analyses().swap(m_analyses); }
+
+ private:
+  // The pairs of entry and exit states computed for each node.
+  using Analyses = std::unordered_map<NodeId,
+                                      std::vector<std::pair<Domain, Domain>>,
+                                      NodeHash>;
+
+  struct PreviousRun {
+    const std::unordered_set<NodeId>& changed_nodes;
+    Analyses analyses;
+  };
+
+  void run(const Domain& init, const PreviousRun* previous_run) {
     this->set_all_to_bottom(m_all_nodes);
+    // The table is populated before the iteration starts, since it is accessed
+    // concurrently.
+    m_analyses.clear();
+    for (const auto& node : m_all_nodes) {
+      m_analyses[node];
+    }
     Context context(init, m_all_nodes);
-    m_wpo_counter.init(m_wpo.size());
-    auto entry_idx = m_wpo.get_entry();
-    assert(m_wpo.get_num_preds(entry_idx) == 0);
+    m_wpo_counter.init(m_wpo->size());
+    auto entry_idx = m_wpo->get_entry();
+    assert(m_wpo->get_num_preds(entry_idx) == 0);
     // Prepare work queue.
     auto wq = sparta::work_queue<uint32_t>(
-        [&context, &entry_idx, this](WPOWorkerState* worker_state,
-                                     uint32_t wpo_idx) {
+        [&context, &entry_idx, previous_run, this](
+            WPOWorkerState* worker_state, uint32_t wpo_idx) {
           std::atomic<uint32_t>& current_counter =
               m_wpo_counter.value_at(wpo_idx);
           current_counter = 0;
           // NonExit node
-          if (!m_wpo.is_exit(wpo_idx)) {
-            this->analyze_vertex(&context, m_wpo.get_node(wpo_idx));
-            for (auto succ_idx : m_wpo.get_successors(wpo_idx)) {
+          if (!m_wpo->is_exit(wpo_idx)) {
+            analyze_vertex(&context, m_wpo->get_node(wpo_idx), previous_run);
+            for (auto succ_idx : m_wpo->get_successors(wpo_idx)) {
               std::atomic<uint32_t>& succ_counter =
                   m_wpo_counter.value_at(succ_idx);
               // Increase succ node's counter, push succ nodes in work queue if
               // their counter number matches their NumSchedPreds.
-              if (++succ_counter == m_wpo.get_num_preds(succ_idx)) {
+              if (++succ_counter == m_wpo->get_num_preds(succ_idx)) {
                 worker_state->push_task(succ_idx);
               }
             }
@@ -440,8 +535,8 @@ class ParallelMonotonicFixpointIterator
           }
           // Exit node
           // Check if component of the exit node has stablized.
-          auto head_idx = m_wpo.get_head_of_exit(wpo_idx);
-          NodeId head = m_wpo.get_node(head_idx);
+          auto head_idx = m_wpo->get_head_of_exit(wpo_idx);
+          NodeId head = m_wpo->get_node(head_idx);
           Domain* current_state = &this->m_entry_states[head];
           Domain new_state;
           this->compute_entry_state(&context, head, &new_state);
@@ -449,12 +544,12 @@ class ParallelMonotonicFixpointIterator
             // Component stablized.
             context.reset_local_iteration_count_for(head);
             *current_state = std::move(new_state);
-            for (auto succ_idx : m_wpo.get_successors(wpo_idx)) {
+            for (auto succ_idx : m_wpo->get_successors(wpo_idx)) {
               std::atomic<uint32_t>& succ_counter =
                   m_wpo_counter.value_at(succ_idx);
               // Increase succ node's counter, push succ nodes in work queue if
               // their counter number matches their NumSchedPreds.
-              if (++succ_counter == m_wpo.get_num_preds(succ_idx)) {
+              if (++succ_counter == m_wpo->get_num_preds(succ_idx)) {
                 worker_state->push_task(succ_idx);
               }
             }
@@ -464,7 +559,7 @@ class ParallelMonotonicFixpointIterator
             context.increase_iteration_count_for(head);
             // Set component nodes v's counter to their
             // NumOuterSchedPreds(v, wpo_idx)
-            for (auto pred_pair : m_wpo.get_num_outer_preds(wpo_idx)) {
+            for (auto pred_pair : m_wpo->get_num_outer_preds(wpo_idx)) {
               auto component_idx = pred_pair.first;
               assert(component_idx != entry_idx);
               std::atomic<uint32_t>& component_counter =
@@ -473,7 +568,7 @@ class ParallelMonotonicFixpointIterator
               // Push component nodes in work queue if their counter number
               // matches their NumSchedPreds.
               if (m_wpo_counter.value_at(component_idx) ==
-                  m_wpo.get_num_preds(component_idx)) {
+                  m_wpo->get_num_preds(component_idx)) {
                 worker_state->push_task(component_idx);
               }
             }
@@ -490,15 +585,39 @@ class ParallelMonotonicFixpointIterator
         },
         m_num_thread,
         /*push_tasks_while_running=*/true);
-    wq.add_item(m_wpo.get_entry());
+    wq.add_item(m_wpo->get_entry());
     wq.run_all();
   }
 
- private:
-  WeakPartialOrdering<NodeId, NodeHash> m_wpo;
+  void analyze_vertex(Context* context,
+                      const NodeId& node,
+                      const PreviousRun* previous_run) {
+    Domain& entry_state = this->m_entry_states[node];
+    this->compute_entry_state(context, node, &entry_state);
+    Domain& exit_state = this->m_exit_states[node];
+    auto& analyses = m_analyses.at(node);
+    if (previous_run != nullptr && !previous_run->changed_nodes.count(node)) {
+      auto it = previous_run->analyses.find(node);
+      if (it != previous_run->analyses.end()) {
+        for (const auto& analysis : it->second) {
+          if (analysis.first.equals(entry_state)) {
+            exit_state = analysis.second;
+            analyses.push_back(analysis);
+            return;
+          }
+        }
+      }
+    }
+    exit_state = entry_state;
+    this->analyze_node(node, &exit_state);
+    analyses.emplace_back(entry_state, exit_state);
+  }
+
+  std::shared_ptr<const WeakPartialOrdering<NodeId, NodeHash>> m_wpo;
   WPOCounter m_wpo_counter;
   size_t m_num_thread;
   std::unordered_set<NodeId> m_all_nodes;
+  Analyses m_analyses;
 };
 
 /*
@@ -523,28 +642,8 @@ class MonotonicFixpointIterator
       : fp_impl::MonotonicFixpointIteratorBase<GraphInterface,
                                                Domain,
                                                NodeHash>(graph, cfg_size_hint),
-        m_wpo(GraphInterface::entry(graph),
-              [=, &graph](const NodeId& x) {
-                const auto& succ_edges = GraphInterface::successors(graph, x);
-                std::vector<NodeId> succ_nodes_tmp;
-                std::transform(succ_edges.begin(),
-                               succ_edges.end(),
-                               std::back_inserter(succ_nodes_tmp),
-                               std::bind(&GraphInterface::target,
-                                         std::ref(graph),
-                                         std::placeholders::_1));
-                // Filter out duplicate succ nodes.
-                std::vector<NodeId> succ_nodes;
-                std::unordered_set<NodeId> succ_nodes_set;
-                for (auto node : succ_nodes_tmp) {
-                  if (!succ_nodes_set.count(node)) {
-                    succ_nodes_set.emplace(node);
-                    succ_nodes.emplace_back(node);
-                  }
-                }
-                return succ_nodes;
-              },
-              false) {}
+        m_wpo(fp_impl::get_weak_partial_ordering<GraphInterface, NodeHash>(
+            graph)) {}
 
   /*
    * Executes the fixpoint iterator given an abstract value describing the
@@ -557,18 +656,18 @@ class MonotonicFixpointIterator
     Context context(init);
     std::unordered_map<uint32_t, uint32_t> wpo_counter;
     std::queue<uint32_t> work_queue;
-    auto entry_idx = m_wpo.get_entry();
-    assert(m_wpo.get_num_preds(entry_idx) == 0);
+    auto entry_idx = m_wpo->get_entry();
+    assert(m_wpo->get_num_preds(entry_idx) == 0);
     // Prepare work queue.
     auto process_node = [&](uint32_t wpo_idx) {
       wpo_counter[wpo_idx] = 0;
       // NonExit node
-      if (!m_wpo.is_exit(wpo_idx)) {
-        this->analyze_vertex(&context, m_wpo.get_node(wpo_idx));
-        for (auto succ_idx : m_wpo.get_successors(wpo_idx)) {
+      if (!m_wpo->is_exit(wpo_idx)) {
+        this->analyze_vertex(&context, m_wpo->get_node(wpo_idx));
+        for (auto succ_idx : m_wpo->get_successors(wpo_idx)) {
           // Increase succ node's counter, push succ nodes in work queue if
           // their counter number matches their NumSchedPreds.
-          if (++wpo_counter[succ_idx] == m_wpo.get_num_preds(succ_idx)) {
+          if (++wpo_counter[succ_idx] == m_wpo->get_num_preds(succ_idx)) {
             work_queue.emplace(succ_idx);
           }
         }
@@ -576,8 +675,8 @@ class MonotonicFixpointIterator
       }
       // Exit node
       // Check if component of the exit node has stablized.
-      uint32_t head_idx = m_wpo.get_head_of_exit(wpo_idx);
-      NodeId head = m_wpo.get_node(head_idx);
+      uint32_t head_idx = m_wpo->get_head_of_exit(wpo_idx);
+      NodeId head = m_wpo->get_node(head_idx);
       Domain* current_state = &this->m_entry_states[head];
       Domain new_state;
       this->compute_entry_state(&context, head, &new_state);
@@ -585,10 +684,10 @@ class MonotonicFixpointIterator
         // Component stablized.
         context.reset_local_iteration_count_for(head);
         *current_state = std::move(new_state);
-        for (auto succ_idx : m_wpo.get_successors(wpo_idx)) {
+        for (auto succ_idx : m_wpo->get_successors(wpo_idx)) {
           // Increase succ node's counter, push succ nodes in work queue if
           // their counter number matches their NumSchedPreds.
-          if (++wpo_counter[succ_idx] == m_wpo.get_num_preds(succ_idx)) {
+          if (++wpo_counter[succ_idx] == m_wpo->get_num_preds(succ_idx)) {
             work_queue.emplace(succ_idx);
           }
         }
@@ -598,13 +697,13 @@ class MonotonicFixpointIterator
         context.increase_iteration_count_for(head);
         // Set component nodes v's counter to their
         // NumOuterSchedPreds(v, wpo_idx)
-        for (auto pred_pair : m_wpo.get_num_outer_preds(wpo_idx)) {
+        for (auto pred_pair : m_wpo->get_num_outer_preds(wpo_idx)) {
           auto component_idx = pred_pair.first;
           assert(component_idx != entry_idx);
           wpo_counter[component_idx] = pred_pair.second;
           // Push component nodes in work queue if their counter number
           // matches their NumSchedPreds.
-          if (pred_pair.second == m_wpo.get_num_preds(component_idx)) {
+          if (pred_pair.second == m_wpo->get_num_preds(component_idx)) {
             work_queue.emplace(component_idx);
           }
         }
@@ -629,7 +728,174 @@ class MonotonicFixpointIterator
   }
 
  private:
-  WeakPartialOrdering<NodeId, NodeHash> m_wpo;
+  std::shared_ptr<const WeakPartialOrdering<NodeId, NodeHash>> m_wpo;
+};
+
+/*
+ * A worklist fixpoint iterator that always analyzes next the pending node that
+ * comes first in a reverse postorder of the graph. Nodes are put on the
+ * worklist when the exit state of one of their predecessors changes, and are
+ * never queued twice. Unlike the recursive strategy of the
+ * WTOMonotonicFixpointIterator, which stabilizes every nested component anew
+ * at each iteration of the enclosing one, only the nodes whose input has
+ * actually changed are reanalyzed. This usually converges with fewer node
+ * analyses on graphs with large or deeply nested strongly connected components.
+ *
+ * Widening is performed at the targets of the retreating edges of the reverse
+ * postorder, which cut every cycle of the graph. The extrapolate() method is
+ * invoked at these nodes whenever their entry state grows, as for the heads of
+ * components in the other fixpoint iterators. Note that the local iteration
+ * count of a node is never reset, since nodes do not belong to a single
+ * component here.
+ *
+ * This iterator has the same interface as MonotonicFixpointIterator, so that
+ * an analysis can be switched from one to the other by changing its base
+ * class.
+ */
+template <typename GraphInterface,
+          typename Domain,
+          typename NodeHash = std::hash<typename GraphInterface::NodeId>>
+class WorklistMonotonicFixpointIterator
+    : public fp_impl::
+          MonotonicFixpointIteratorBase<GraphInterface, Domain, NodeHash> {
+ public:
+  using Graph = typename GraphInterface::Graph;
+  using NodeId = typename GraphInterface::NodeId;
+  using EdgeId = typename GraphInterface::EdgeId;
+  using Context =
+      fp_impl::MonotonicFixpointIteratorContext<NodeId, Domain, NodeHash>;
+
+  WorklistMonotonicFixpointIterator(const Graph& graph,
+                                    size_t cfg_size_hint = 4)
+      : fp_impl::MonotonicFixpointIteratorBase<GraphInterface,
+                                               Domain,
+                                               NodeHash>(graph,
+                                                         cfg_size_hint) {
+    compute_reverse_postorder(graph);
+  }
+
+  /*
+   * Executes the fixpoint iterator given an abstract value describing the
+   * initial program configuration. This method can be invoked multiple times
+   * with different values in order to analyze the program under different
+   * initial conditions.
+   */
+  void run(const Domain& init) {
+    this->clear();
+    Context context(init);
+    size_t size = m_nodes.size();
+    std::vector<bool> queued(size, false);
+    std::vector<bool> visited(size, false);
+    std::priority_queue<uint32_t, std::vector<uint32_t>, std::greater<uint32_t>>
+        worklist;
+    worklist.push(0);
+    queued[0] = true;
+    while (!worklist.empty()) {
+      uint32_t index = worklist.top();
+      worklist.pop();
+      queued[index] = false;
+      if (!analyze_vertex(&context, index, visited[index])) {
+        continue;
+      }
+      visited[index] = true;
+      for (uint32_t succ : m_successors[index]) {
+        if (!queued[succ]) {
+          queued[succ] = true;
+          worklist.push(succ);
+        }
+      }
+    }
+  }
+
+ private:
+  // Recomputes the entry and exit states of a node, and returns whether the
+  // exit state has changed.
+  bool analyze_vertex(Context* context, uint32_t index, bool visited) {
+    const NodeId& node = m_nodes[index];
+    Domain new_entry_state;
+    this->compute_entry_state(context, node, &new_entry_state);
+    Domain& entry_state = this->m_entry_states[node];
+    if (!visited) {
+      entry_state = std::move(new_entry_state);
+    } else if (new_entry_state.leq(entry_state)) {
+      return false;
+    } else if (m_is_widening_point[index]) {
+      this->extrapolate(*context, node, &entry_state, new_entry_state);
+      context->increase_iteration_count_for(node);
+    } else {
+      entry_state = std::move(new_entry_state);
+    }
+    Domain exit_state = entry_state;
+    this->analyze_node(node, &exit_state);
+    auto it = this->m_exit_states.find(node);
+    if (it == this->m_exit_states.end()) {
+      this->m_exit_states.emplace(node, std::move(exit_state));
+      return true;
+    }
+    if (exit_state.equals(it->second)) {
+      return false;
+    }
+    it->second = std::move(exit_state);
+    return true;
+  }
+
+  void compute_reverse_postorder(const Graph& graph) {
+    // An iterative depth-first traversal, since a recursive one could overflow
+    // the stack on large graphs.
+    std::unordered_map<NodeId, std::vector<NodeId>, NodeHash> successors;
+    std::unordered_set<NodeId, NodeHash> discovered;
+    std::vector<NodeId> postorder;
+    std::vector<std::pair<NodeId, size_t>> stack;
+    auto discover = [&](const NodeId& node) {
+      discovered.emplace(node);
+      auto& succs = successors[node];
+      for (const auto& edge : GraphInterface::successors(graph, node)) {
+        succs.push_back(GraphInterface::target(graph, edge));
+      }
+      stack.emplace_back(node, 0);
+    };
+    discover(GraphInterface::entry(graph));
+    while (!stack.empty()) {
+      auto& frame = stack.back();
+      const auto& succs = successors.at(frame.first);
+      if (frame.second == succs.size()) {
+        postorder.push_back(frame.first);
+        stack.pop_back();
+        continue;
+      }
+      NodeId succ = succs[frame.second++];
+      if (!discovered.count(succ)) {
+        discover(succ);
+      }
+    }
+
+    m_nodes.assign(postorder.rbegin(), postorder.rend());
+    std::unordered_map<NodeId, uint32_t, NodeHash> priorities;
+    for (uint32_t i = 0; i < m_nodes.size(); ++i) {
+      priorities.emplace(m_nodes[i], i);
+    }
+    m_successors.resize(m_nodes.size());
+    m_is_widening_point.assign(m_nodes.size(), false);
+    for (uint32_t i = 0; i < m_nodes.size(); ++i) {
+      for (const auto& succ : successors.at(m_nodes[i])) {
+        uint32_t j = priorities.at(succ);
+        if (j <= i) {
+          m_is_widening_point[j] = true;
+        }
+        if (std::find(m_successors[i].begin(), m_successors[i].end(), j) ==
+            m_successors[i].end()) {
+          m_successors[i].push_back(j);
+        }
+      }
+    }
+  }
+
+  // The nodes reachable from the entry, in reverse postorder, which is the
+  // order of priority of the worklist. Nodes are designated by their index in
+  // this vector.
+  std::vector<NodeId> m_nodes;
+  std::vector<std::vector<uint32_t>> m_successors;
+  std::vector<bool> m_is_widening_point;
 };
 
 /*
@@ -641,6 +907,40 @@ class MonotonicFixpointIterator
  * performing a backwards analysis simply amounts to performing a forwards
  * analysis on the reverse CFG.
  */
+/*
+ * Builds the weak partial ordering of the nodes that are reachable from the
+ * entry of the graph.
+ */
+template <typename GraphInterface, typename NodeHash>
+std::shared_ptr<
+    const WeakPartialOrdering<typename GraphInterface::NodeId, NodeHash>>
+make_weak_partial_ordering(const typename GraphInterface::Graph& graph) {
+  using NodeId = typename GraphInterface::NodeId;
+  return std::make_shared<const WeakPartialOrdering<NodeId, NodeHash>>(
+      GraphInterface::entry(graph),
+      [&graph](const NodeId& x) {
+        const auto& succ_edges = GraphInterface::successors(graph, x);
+        std::vector<NodeId> succ_nodes_tmp;
+        std::transform(succ_edges.begin(),
+                       succ_edges.end(),
+                       std::back_inserter(succ_nodes_tmp),
+                       std::bind(&GraphInterface::target,
+                                 std::ref(graph),
+                                 std::placeholders::_1));
+        // Filter out duplicate succ nodes.
+        std::vector<NodeId> succ_nodes;
+        std::unordered_set<NodeId> succ_nodes_set;
+        for (auto node : succ_nodes_tmp) {
+          if (!succ_nodes_set.count(node)) {
+            succ_nodes_set.emplace(node);
+            succ_nodes.emplace_back(node);
+          }
+        }
+        return succ_nodes;
+      },
+      false);
+}
+
 template <typename GraphInterface>
 class BackwardsFixpointIterationAdaptor {
  public:
@@ -658,12 +958,10 @@ class BackwardsFixpointIterationAdaptor {
   static NodeId exit(const Graph& graph) {
     return GraphInterface::entry(graph);
   }
-  static std::vector<EdgeId> predecessors(const Graph& graph,
-                                          const NodeId& node) {
+  static auto predecessors(const Graph& graph, const NodeId& node) {
     return GraphInterface::successors(graph, node);
   }
-  static std::vector<EdgeId> successors(const Graph& graph,
-                                        const NodeId& node) {
+  static auto successors(const Graph& graph, const NodeId& node) {
     return GraphInterface::predecessors(graph, node);
   }
   static NodeId source(const Graph& graph, const EdgeId& edge) {
@@ -672,6 +970,13 @@ class BackwardsFixpointIterationAdaptor {
   static NodeId target(const Graph& graph, const EdgeId& edge) {
     return GraphInterface::source(graph, edge);
   }
+  // Only available if the graph interface provides an ordering of the reversed
+  // graph, see fp_impl::WeakPartialOrderingProvider.
+  template <typename G = GraphInterface>
+  static auto weak_partial_ordering(const Graph& graph)
+      -> decltype(G::backwards_weak_partial_ordering(graph)) {
+    return G::backwards_weak_partial_ordering(graph);
+  }
 };
 
 } // namespace sparta
@@ -18,34 +18,50 @@
 #include <type_traits>
 #include <utility>
 
+#include <boost/functional/hash.hpp>
+#include <boost/intrusive_ptr.hpp>
+
 #include "AbstractDomain.h"
 #include "PatriciaTreeUtil.h"
 
 // Forward declarations
 namespace sparta {
 
-template <typename Key, typename ValueType, typename Value>
+template <typename Key,
+          typename ValueType,
+          typename Value,
+          typename Allocation>
 class PatriciaTreeMap;
 
 } // namespace sparta
 
-template <typename Key, typename ValueType, typename Value>
+template <typename Key,
+          typename ValueType,
+          typename Value,
+          typename Allocation>
 std::ostream& operator<<(
     std::ostream&,
-    const typename sparta::PatriciaTreeMap<Key, ValueType, Value>&);
+    const typename sparta::PatriciaTreeMap<Key, ValueType, Value, Allocation>&);
 
 namespace sparta {
 
 // Forward declarations.
 namespace ptmap_impl {
 
-template <typename IntegerType, typename Value>
+template <typename IntegerType, typename Value, typename Allocation>
 class PatriciaTree;
 
-template <typename IntegerType, typename Value>
+template <typename IntegerType, typename Value, typename Allocation>
 class PatriciaTreeLeaf;
 
-template <typename IntegerType, typename Value>
+template <typename IntegerType, typename Value, typename Allocation>
+class PatriciaTreeBranch;
+
+template <typename IntegerType, typename Value, typename Allocation>
+using PatriciaTreePtr =
+    boost::intrusive_ptr<PatriciaTree<IntegerType, Value, Allocation>>;
+
+template <typename IntegerType, typename Value, typename Allocation>
 class PatriciaTreeIterator;
 
 template <typename T>
@@ -54,54 +70,54 @@ using CombiningFunction = std::function<T(const T&, const T&)>;
 template <typename Value>
 using MappingFunction = std::function<Value(const Value&)>;
 
-template <typename IntegerType, typename Value>
+template <typename IntegerType, typename Value, typename Allocation>
 inline const typename Value::type* find_value(
     IntegerType key,
-    const std::shared_ptr<PatriciaTree<IntegerType, Value>>& tree);
+    const PatriciaTreePtr<IntegerType, Value, Allocation>& tree);
 
-template <typename IntegerType, typename Value>
-inline bool leq(const std::shared_ptr<PatriciaTree<IntegerType, Value>>& tree1,
-                const std::shared_ptr<PatriciaTree<IntegerType, Value>>& tree2);
+template <typename IntegerType, typename Value, typename Allocation>
+inline bool leq(const PatriciaTreePtr<IntegerType, Value, Allocation>& tree1,
+                const PatriciaTreePtr<IntegerType, Value, Allocation>& tree2);
 
-template <typename IntegerType, typename Value>
+template <typename IntegerType, typename Value, typename Allocation>
 inline bool equals(
-    const std::shared_ptr<PatriciaTree<IntegerType, Value>>& tree1,
-    const std::shared_ptr<PatriciaTree<IntegerType, Value>>& tree2);
+    const PatriciaTreePtr<IntegerType, Value, Allocation>& tree1,
+    const PatriciaTreePtr<IntegerType, Value, Allocation>& tree2);
 
-template <typename IntegerType, typename Value>
-inline std::shared_ptr<PatriciaTree<IntegerType, Value>> combine_new_leaf(
+template <typename IntegerType, typename Value, typename Allocation>
+inline PatriciaTreePtr<IntegerType, Value, Allocation> combine_new_leaf(
     const CombiningFunction<typename Value::type>& combine,
     IntegerType key,
     const typename Value::type& value);
 
-template <typename IntegerType, typename Value>
-inline std::shared_ptr<PatriciaTree<IntegerType, Value>> update(
+template <typename IntegerType, typename Value, typename Allocation>
+inline PatriciaTreePtr<IntegerType, Value, Allocation> update(
     const CombiningFunction<typename Value::type>& combine,
     IntegerType key,
     const typename Value::type& value,
-    const std::shared_ptr<PatriciaTree<IntegerType, Value>>& tree);
+    const PatriciaTreePtr<IntegerType, Value, Allocation>& tree);
 
-template <typename IntegerType, typename Value>
-inline std::shared_ptr<PatriciaTree<IntegerType, Value>> map(
+template <typename IntegerType, typename Value, typename Allocation>
+inline PatriciaTreePtr<IntegerType, Value, Allocation> map(
     const MappingFunction<typename Value::type>& f,
-    const std::shared_ptr<PatriciaTree<IntegerType, Value>>& tree);
+    const PatriciaTreePtr<IntegerType, Value, Allocation>& tree);
 
-template <typename IntegerType, typename Value>
-inline std::shared_ptr<PatriciaTree<IntegerType, Value>> erase_all_matching(
+template <typename IntegerType, typename Value, typename Allocation>
+inline PatriciaTreePtr<IntegerType, Value, Allocation> erase_all_matching(
     IntegerType key_mask,
-    const std::shared_ptr<PatriciaTree<IntegerType, Value>>& tree);
+    const PatriciaTreePtr<IntegerType, Value, Allocation>& tree);
 
-template <typename IntegerType, typename Value>
-inline std::shared_ptr<PatriciaTree<IntegerType, Value>> merge(
+template <typename IntegerType, typename Value, typename Allocation>
+inline PatriciaTreePtr<IntegerType, Value, Allocation> merge(
     const CombiningFunction<typename Value::type>& combine,
-    const std::shared_ptr<PatriciaTree<IntegerType, Value>>& s,
-    const std::shared_ptr<PatriciaTree<IntegerType, Value>>& t);
+    const PatriciaTreePtr<IntegerType, Value, Allocation>& s,
+    const PatriciaTreePtr<IntegerType, Value, Allocation>& t);
 
-template <typename IntegerType, typename Value>
-inline std::shared_ptr<PatriciaTree<IntegerType, Value>> intersect(
+template <typename IntegerType, typename Value, typename Allocation>
+inline PatriciaTreePtr<IntegerType, Value, Allocation> intersect(
     const ptmap_impl::CombiningFunction<typename Value::type>& combine,
-    const std::shared_ptr<PatriciaTree<IntegerType, Value>>& s,
-    const std::shared_ptr<PatriciaTree<IntegerType, Value>>& t);
+    const PatriciaTreePtr<IntegerType, Value, Allocation>& s,
+    const PatriciaTreePtr<IntegerType, Value, Allocation>& t);
 
 template <typename T>
 T snd(const T&, const T& second) {
@@ -166,17 +182,21 @@ struct SimpleValue {
  * accommodated as long as they are represented as pointers. Our implementation
  * of Patricia-tree maps can transparently operate on keys that are either
  * unsigned integers or pointers to objects.
+ *
+ * The Allocation parameter selects how the nodes of the trees are allocated,
+ * see HeapNodes and PooledNodes in PatriciaTreeUtil.h.
  */
 template <typename Key,
           typename ValueType,
-          typename Value = ptmap_impl::SimpleValue<ValueType>>
+          typename Value = ptmap_impl::SimpleValue<ValueType>,
+          typename Allocation = pt_util::HeapNodes>
 class PatriciaTreeMap final {
  public:
   // C++ container concept member types
   using key_type = Key;
   using mapped_type = typename Value::type;
   using value_type = std::pair<const Key, mapped_type>;
-  using iterator = ptmap_impl::PatriciaTreeIterator<Key, Value>;
+  using iterator = ptmap_impl::PatriciaTreeIterator<Key, Value, Allocation>;
   using const_iterator = iterator;
   using difference_type = std::ptrdiff_t;
   using size_type = size_t;
@@ -380,26 +400,32 @@ class PatriciaTreeMap final {
     return x;
   }
 
-  std::shared_ptr<ptmap_impl::PatriciaTree<IntegerType, Value>> m_tree;
+  ptmap_impl::PatriciaTreePtr<IntegerType, Value, Allocation>
+      m_tree;
 
-  template <typename T, typename VT, typename V>
+  template <typename T, typename VT, typename V, typename A>
   friend std::ostream& ::operator<<(std::ostream&,
-                                    const PatriciaTreeMap<T, VT, V>&);
+                                    const PatriciaTreeMap<T, VT, V, A>&);
 
-  template <typename T, typename V>
+  template <typename T, typename V, typename A>
   friend class ptmap_impl::PatriciaTreeIterator;
 };
 
 } // namespace sparta
 
-template <typename Key, typename ValueType, typename Value>
+template <typename Key,
+          typename ValueType,
+          typename Value,
+          typename Allocation>
 inline std::ostream& operator<<(
     std::ostream& o,
-    const typename sparta::PatriciaTreeMap<Key, ValueType, Value>& s) {
+    const typename sparta::PatriciaTreeMap<Key, ValueType, Value, Allocation>&
+        s) {
   using namespace sparta;
   o << "{";
   for (auto it = s.begin(); it != s.end(); ++it) {
-    o << PatriciaTreeMap<Key, ValueType, Value>::deref(it->first) << " -> "
+    o << PatriciaTreeMap<Key, ValueType, Value, Allocation>::deref(it->first)
+      << " -> "
       << it->second;
     if (std::next(it) != s.end()) {
       o << ", ";
@@ -415,8 +441,8 @@ namespace ptmap_impl {
 
 using namespace pt_util;
 
-template <typename IntegerType, typename Value>
-class PatriciaTree {
+template <typename IntegerType, typename Value, typename Allocation>
+class PatriciaTree : public PatriciaTreeNode<Allocation> {
  public:
   // A Patricia tree is an immutable structure.
   PatriciaTree& operator=(const PatriciaTree& other) = delete;
@@ -434,14 +460,15 @@ class PatriciaTree {
   bool is_branch() const { return !is_leaf(); }
 };
 
-template <typename IntegerType, typename Value>
-class PatriciaTreeBranch final : public PatriciaTree<IntegerType, Value> {
+template <typename IntegerType, typename Value, typename Allocation>
+class PatriciaTreeBranch final
+    : public PatriciaTree<IntegerType, Value, Allocation> {
  public:
   PatriciaTreeBranch(
       IntegerType prefix,
       IntegerType branching_bit,
-      const std::shared_ptr<PatriciaTree<IntegerType, Value>>& left_tree,
-      const std::shared_ptr<PatriciaTree<IntegerType, Value>>& right_tree)
+      const PatriciaTreePtr<IntegerType, Value, Allocation>& left_tree,
+      const PatriciaTreePtr<IntegerType, Value, Allocation>& right_tree)
       : m_prefix(prefix),
         m_stacking_bit(branching_bit),
         m_left_tree(left_tree),
@@ -453,23 +480,44 @@ class PatriciaTreeBranch final : public PatriciaTree<IntegerType, Value> {
 
   IntegerType branching_bit() const { return m_stacking_bit; }
 
-  const std::shared_ptr<PatriciaTree<IntegerType, Value>>& left_tree() const {
+  const PatriciaTreePtr<IntegerType, Value, Allocation>& left_tree() const {
     return m_left_tree;
   }
 
-  const std::shared_ptr<PatriciaTree<IntegerType, Value>>& right_tree() const {
+  const PatriciaTreePtr<IntegerType, Value, Allocation>& right_tree() const {
     return m_right_tree;
   }
 
+  size_t hash_cons_hash() const {
+    size_t seed = 0;
+    boost::hash_combine(seed, m_prefix);
+    boost::hash_combine(seed, m_stacking_bit);
+    boost::hash_combine(seed, m_left_tree.get());
+    boost::hash_combine(seed, m_right_tree.get());
+    return seed;
+  }
+
+  bool hash_cons_equals(const PatriciaTreeBranch& other) const {
+    return m_prefix == other.m_prefix &&
+           m_stacking_bit == other.m_stacking_bit &&
+           m_left_tree == other.m_left_tree &&
+           m_right_tree == other.m_right_tree;
+  }
+
  private:
+  void unintern() const override {
+    hash_cons_impl::unintern(this, Allocation());
+  }
+
   IntegerType m_prefix;
   IntegerType m_stacking_bit;
-  std::shared_ptr<PatriciaTree<IntegerType, Value>> m_left_tree;
-  std::shared_ptr<PatriciaTree<IntegerType, Value>> m_right_tree;
+  PatriciaTreePtr<IntegerType, Value, Allocation> m_left_tree;
+  PatriciaTreePtr<IntegerType, Value, Allocation> m_right_tree;
 };
 
-template <typename IntegerType, typename Value>
-class PatriciaTreeLeaf final : public PatriciaTree<IntegerType, Value> {
+template <typename IntegerType, typename Value, typename Allocation>
+class PatriciaTreeLeaf final
+    : public PatriciaTree<IntegerType, Value, Allocation> {
  public:
   using mapped_type = typename Value::type;
 
@@ -482,66 +530,93 @@ class PatriciaTreeLeaf final : public PatriciaTree<IntegerType, Value> {
 
   const mapped_type& value() const { return m_pair.second; }
 
+  size_t hash_cons_hash() const {
+    size_t seed = 0;
+    boost::hash_combine(seed, key());
+    boost::hash_combine(seed, Value::hash(value()));
+    return seed;
+  }
+
+  bool hash_cons_equals(const PatriciaTreeLeaf& other) const {
+    return key() == other.key() && Value::equals(value(), other.value());
+  }
+
  private:
+  void unintern() const override {
+    hash_cons_impl::unintern(this, Allocation());
+  }
+
   std::pair<IntegerType, mapped_type> m_pair;
 
-  template <typename T, typename V>
+  template <typename T, typename V, typename A>
   friend class ptmap_impl::PatriciaTreeIterator;
 };
 
-template <typename IntegerType, typename Value>
-std::shared_ptr<PatriciaTreeBranch<IntegerType, Value>> join(
+template <typename IntegerType, typename Value, typename Allocation>
+inline boost::intrusive_ptr<PatriciaTreeLeaf<IntegerType, Value, Allocation>>
+as_leaf(const PatriciaTreePtr<IntegerType, Value, Allocation>& tree) {
+  return boost::static_pointer_cast<
+      PatriciaTreeLeaf<IntegerType, Value, Allocation>>(tree);
+}
+
+template <typename IntegerType, typename Value, typename Allocation>
+inline boost::intrusive_ptr<PatriciaTreeBranch<IntegerType, Value, Allocation>>
+as_branch(const PatriciaTreePtr<IntegerType, Value, Allocation>& tree) {
+  return boost::static_pointer_cast<
+      PatriciaTreeBranch<IntegerType, Value, Allocation>>(tree);
+}
+
+template <typename IntegerType, typename Value, typename Allocation>
+boost::intrusive_ptr<PatriciaTreeBranch<IntegerType, Value, Allocation>> join(
     IntegerType prefix0,
-    const std::shared_ptr<PatriciaTree<IntegerType, Value>>& tree0,
+    const PatriciaTreePtr<IntegerType, Value, Allocation>& tree0,
     IntegerType prefix1,
-    const std::shared_ptr<PatriciaTree<IntegerType, Value>>& tree1) {
+    const PatriciaTreePtr<IntegerType, Value, Allocation>& tree1) {
   IntegerType m = get_branching_bit(prefix0, prefix1);
   if (is_zero_bit(prefix0, m)) {
-    return std::make_shared<PatriciaTreeBranch<IntegerType, Value>>(
+    return make_node<PatriciaTreeBranch<IntegerType, Value, Allocation>>(
         mask(prefix0, m), m, tree0, tree1);
   } else {
-    return std::make_shared<PatriciaTreeBranch<IntegerType, Value>>(
+    return make_node<PatriciaTreeBranch<IntegerType, Value, Allocation>>(
         mask(prefix0, m), m, tree1, tree0);
   }
 }
 
 // This function is used to prevent the creation of branch nodes with only one
 // child.
-template <typename IntegerType, typename Value>
-std::shared_ptr<PatriciaTree<IntegerType, Value>> make_branch(
+template <typename IntegerType, typename Value, typename Allocation>
+PatriciaTreePtr<IntegerType, Value, Allocation> make_branch(
     IntegerType prefix,
     IntegerType branching_bit,
-    const std::shared_ptr<PatriciaTree<IntegerType, Value>>& left_tree,
-    const std::shared_ptr<PatriciaTree<IntegerType, Value>>& right_tree) {
+    const PatriciaTreePtr<IntegerType, Value, Allocation>& left_tree,
+    const PatriciaTreePtr<IntegerType, Value, Allocation>& right_tree) {
   if (left_tree == nullptr) {
     return right_tree;
   }
   if (right_tree == nullptr) {
     return left_tree;
   }
-  return std::make_shared<PatriciaTreeBranch<IntegerType, Value>>(
+  return make_node<PatriciaTreeBranch<IntegerType, Value, Allocation>>(
       prefix, branching_bit, left_tree, right_tree);
 }
 
 // Tries to find the value corresponding to :key. Returns null if the key is
 // not present in :tree.
-template <typename IntegerType, typename Value>
+template <typename IntegerType, typename Value, typename Allocation>
 inline const typename Value::type* find_value(
     IntegerType key,
-    const std::shared_ptr<PatriciaTree<IntegerType, Value>>& tree) {
+    const PatriciaTreePtr<IntegerType, Value, Allocation>& tree) {
   if (tree == nullptr) {
     return nullptr;
   }
   if (tree->is_leaf()) {
-    const auto& leaf =
-        std::static_pointer_cast<PatriciaTreeLeaf<IntegerType, Value>>(tree);
+    const auto& leaf = as_leaf(tree);
     if (key == leaf->key()) {
       return &leaf->value();
     }
     return nullptr;
   }
-  const auto& branch =
-      std::static_pointer_cast<PatriciaTreeBranch<IntegerType, Value>>(tree);
+  const auto& branch = as_branch(tree);
   if (is_zero_bit(key, branch->branching_bit())) {
     return find_value(key, branch->left_tree());
   } else {
@@ -550,9 +625,9 @@ inline const typename Value::type* find_value(
 }
 
 /* Assumes Value::default_value() is either Top or Bottom */
-template <typename IntegerType, typename Value>
-inline bool leq(const std::shared_ptr<PatriciaTree<IntegerType, Value>>& s,
-                const std::shared_ptr<PatriciaTree<IntegerType, Value>>& t) {
+template <typename IntegerType, typename Value, typename Allocation>
+inline bool leq(const PatriciaTreePtr<IntegerType, Value, Allocation>& s,
+                const PatriciaTreePtr<IntegerType, Value, Allocation>& t) {
 
   RUNTIME_CHECK(Value::default_value().is_top() ||
                     Value::default_value().is_bottom(),
@@ -570,8 +645,7 @@ inline bool leq(const std::shared_ptr<PatriciaTree<IntegerType, Value>>& s,
     return Value::default_value().is_top();
   }
   if (s->is_leaf()) {
-    const auto& s_leaf =
-        std::static_pointer_cast<PatriciaTreeLeaf<IntegerType, Value>>(s);
+    const auto& s_leaf = as_leaf(s);
 
     if (t->is_branch()) {
       // t has at least one non-default binding that s doesn't have.
@@ -595,8 +669,7 @@ inline bool leq(const std::shared_ptr<PatriciaTree<IntegerType, Value>>& s,
 
     // Both nodes are leaves. s leq to t iff
     // key(s) == key(t) && value(s) <= value(t).
-    const auto& t_leaf =
-        std::static_pointer_cast<PatriciaTreeLeaf<IntegerType, Value>>(t);
+    const auto& t_leaf = as_leaf(t);
     return s_leaf->key() == t_leaf->key() &&
            Value::leq(s_leaf->value(), t_leaf->value());
   } else if (t->is_leaf()) {
@@ -606,8 +679,7 @@ inline bool leq(const std::shared_ptr<PatriciaTree<IntegerType, Value>>& s,
       return false;
     }
 
-    const auto& t_leaf =
-        std::static_pointer_cast<PatriciaTreeLeaf<IntegerType, Value>>(t);
+    const auto& t_leaf = as_leaf(t);
     auto* s_value = find_value(t_leaf->key(), s);
     if (s_value == nullptr) {
       // Always false if default_value is Top, which we already assume.
@@ -617,10 +689,8 @@ inline bool leq(const std::shared_ptr<PatriciaTree<IntegerType, Value>>& s,
   }
 
   // Neither s nor t is a leaf.
-  const auto& s_branch =
-      std::static_pointer_cast<PatriciaTreeBranch<IntegerType, Value>>(s);
-  const auto& t_branch =
-      std::static_pointer_cast<PatriciaTreeBranch<IntegerType, Value>>(t);
+  const auto& s_branch = as_branch(s);
+  const auto& t_branch = as_branch(t);
   IntegerType m = s_branch->branching_bit();
   IntegerType n = t_branch->branching_bit();
   IntegerType p = s_branch->prefix();
@@ -642,10 +712,10 @@ inline bool leq(const std::shared_ptr<PatriciaTree<IntegerType, Value>>& s,
 
 // A Patricia tree is a canonical representation of the set of keys it contains.
 // Hence, set equality is equivalent to structural equality of Patricia trees.
-template <typename IntegerType, typename Value>
+template <typename IntegerType, typename Value, typename Allocation>
 inline bool equals(
-    const std::shared_ptr<PatriciaTree<IntegerType, Value>>& tree1,
-    const std::shared_ptr<PatriciaTree<IntegerType, Value>>& tree2) {
+    const PatriciaTreePtr<IntegerType, Value, Allocation>& tree1,
+    const PatriciaTreePtr<IntegerType, Value, Allocation>& tree2) {
   if (tree1 == tree2) {
     // This conditions allows the equality test to run in sublinear time when
     // comparing Patricia trees that share some structure.
@@ -657,24 +727,24 @@ inline bool equals(
   if (tree2 == nullptr) {
     return false;
   }
+  if (Allocation::hash_consed) {
+    // Structurally equal hash-consed trees are the same node.
+    return false;
+  }
   if (tree1->is_leaf()) {
     if (tree2->is_branch()) {
       return false;
     }
-    const auto& leaf1 =
-        std::static_pointer_cast<PatriciaTreeLeaf<IntegerType, Value>>(tree1);
-    const auto& leaf2 =
-        std::static_pointer_cast<PatriciaTreeLeaf<IntegerType, Value>>(tree2);
+    const auto& leaf1 = as_leaf(tree1);
+    const auto& leaf2 = as_leaf(tree2);
     return leaf1->key() == leaf2->key() &&
            Value::equals(leaf1->value(), leaf2->value());
   }
   if (tree2->is_leaf()) {
     return false;
   }
-  const auto& branch1 =
-      std::static_pointer_cast<PatriciaTreeBranch<IntegerType, Value>>(tree1);
-  const auto& branch2 =
-      std::static_pointer_cast<PatriciaTreeBranch<IntegerType, Value>>(tree2);
+  const auto& branch1 = as_branch(tree1);
+  const auto& branch2 = as_branch(tree2);
   return branch1->prefix() == branch2->prefix() &&
          branch1->branching_bit() == branch2->branching_bit() &&
          equals(branch1->left_tree(), branch2->left_tree()) &&
@@ -684,29 +754,30 @@ inline bool equals(
 // Finds the value corresponding to :key in the tree and replaces its bound
 // value with combine(bound_value, :value). Note that the existing value is
 // always the first parameter to :combine and the new value is the second.
-template <typename IntegerType, typename Value>
-inline std::shared_ptr<PatriciaTree<IntegerType, Value>> update(
+template <typename IntegerType, typename Value, typename Allocation>
+inline PatriciaTreePtr<IntegerType, Value, Allocation> update(
     const ptmap_impl::CombiningFunction<typename Value::type>& combine,
     IntegerType key,
     const typename Value::type& value,
-    const std::shared_ptr<PatriciaTree<IntegerType, Value>>& tree) {
+    const PatriciaTreePtr<IntegerType, Value, Allocation>& tree) {
   if (tree == nullptr) {
-    return combine_new_leaf<IntegerType, Value>(combine, key, value);
+    return combine_new_leaf<IntegerType, Value, Allocation>(
+        combine, key, value);
   }
   if (tree->is_leaf()) {
-    const auto& leaf =
-        std::static_pointer_cast<PatriciaTreeLeaf<IntegerType, Value>>(tree);
+    const auto& leaf = as_leaf(tree);
     if (key == leaf->key()) {
       return combine_leaf(combine, value, leaf);
     }
-    auto new_leaf = combine_new_leaf<IntegerType, Value>(combine, key, value);
+    auto new_leaf = combine_new_leaf<IntegerType, Value, Allocation>(
+        combine, key, value);
     if (new_leaf == nullptr) {
       return leaf;
     }
-    return join<IntegerType, Value>(key, new_leaf, leaf->key(), leaf);
+    return join<IntegerType, Value, Allocation>(
+        key, new_leaf, leaf->key(), leaf);
   }
-  const auto& branch =
-      std::static_pointer_cast<PatriciaTreeBranch<IntegerType, Value>>(tree);
+  const auto& branch = as_branch(tree);
   if (match_prefix(key, branch->prefix(), branch->branching_bit())) {
     if (is_zero_bit(key, branch->branching_bit())) {
       auto new_left_tree = update(combine, key, value, branch->left_tree());
@@ -728,29 +799,29 @@ inline std::shared_ptr<PatriciaTree<IntegerType, Value>> update(
                          new_right_tree);
     }
   }
-  auto new_leaf = combine_new_leaf<IntegerType, Value>(combine, key, value);
+  auto new_leaf = combine_new_leaf<IntegerType, Value, Allocation>(
+      combine, key, value);
   if (new_leaf == nullptr) {
     return branch;
   }
-  return join<IntegerType, Value>(key, new_leaf, branch->prefix(), branch);
+  return join<IntegerType, Value, Allocation>(
+      key, new_leaf, branch->prefix(), branch);
 }
 
 // Maps all entries with non-default values, applying a given function.
-template <typename IntegerType, typename Value>
-inline std::shared_ptr<PatriciaTree<IntegerType, Value>> map(
+template <typename IntegerType, typename Value, typename Allocation>
+inline PatriciaTreePtr<IntegerType, Value, Allocation> map(
     const MappingFunction<typename Value::type>& f,
-    const std::shared_ptr<PatriciaTree<IntegerType, Value>>& tree) {
+    const PatriciaTreePtr<IntegerType, Value, Allocation>& tree) {
   if (tree == nullptr) {
     return nullptr;
   }
   if (tree->is_leaf()) {
-    const auto& leaf =
-        std::static_pointer_cast<PatriciaTreeLeaf<IntegerType, Value>>(tree);
+    const auto& leaf = as_leaf(tree);
     auto new_value = f(leaf->value());
     return combine_leaf(ptmap_impl::snd<typename Value::type>, new_value, leaf);
   }
-  const auto& branch =
-      std::static_pointer_cast<PatriciaTreeBranch<IntegerType, Value>>(tree);
+  const auto& branch = as_branch(tree);
   auto new_left_tree = map(f, branch->left_tree());
   auto new_right_tree = map(f, branch->right_tree());
   if (new_left_tree == branch->left_tree() &&
@@ -762,23 +833,21 @@ inline std::shared_ptr<PatriciaTree<IntegerType, Value>> map(
 }
 
 // Erases all entries where keys and :key_mask share common bits.
-template <typename IntegerType, typename Value>
-inline std::shared_ptr<PatriciaTree<IntegerType, Value>> erase_all_matching(
+template <typename IntegerType, typename Value, typename Allocation>
+inline PatriciaTreePtr<IntegerType, Value, Allocation> erase_all_matching(
     IntegerType key_mask,
-    const std::shared_ptr<PatriciaTree<IntegerType, Value>>& tree) {
+    const PatriciaTreePtr<IntegerType, Value, Allocation>& tree) {
   if (tree == nullptr) {
     return nullptr;
   }
   if (tree->is_leaf()) {
-    const auto& leaf =
-        std::static_pointer_cast<PatriciaTreeLeaf<IntegerType, Value>>(tree);
+    const auto& leaf = as_leaf(tree);
     if (key_mask & leaf->key()) {
       return nullptr;
     }
     return tree;
   }
-  const auto& branch =
-      std::static_pointer_cast<PatriciaTreeBranch<IntegerType, Value>>(tree);
+  const auto& branch = as_branch(tree);
   if (key_mask & branch->prefix()) {
     return nullptr;
   }
@@ -797,11 +866,11 @@ inline std::shared_ptr<PatriciaTree<IntegerType, Value>> erase_all_matching(
 
 // We keep the notations of the paper so as to make the implementation easier
 // to follow.
-template <typename IntegerType, typename Value>
-inline std::shared_ptr<PatriciaTree<IntegerType, Value>> merge(
+template <typename IntegerType, typename Value, typename Allocation>
+inline PatriciaTreePtr<IntegerType, Value, Allocation> merge(
     const ptmap_impl::CombiningFunction<typename Value::type>& combine,
-    const std::shared_ptr<PatriciaTree<IntegerType, Value>>& s,
-    const std::shared_ptr<PatriciaTree<IntegerType, Value>>& t) {
+    const PatriciaTreePtr<IntegerType, Value, Allocation>& s,
+    const PatriciaTreePtr<IntegerType, Value, Allocation>& t) {
   if (s == t) {
     // This conditional is what allows the union operation to complete in
     // sublinear time when the operands share some structure.
@@ -814,19 +883,15 @@ inline std::shared_ptr<PatriciaTree<IntegerType, Value>> merge(
     return s;
   }
   if (s->is_leaf()) {
-    const auto& leaf =
-        std::static_pointer_cast<PatriciaTreeLeaf<IntegerType, Value>>(s);
+    const auto& leaf = as_leaf(s);
     return update(combine, leaf->key(), leaf->value(), t);
   }
   if (t->is_leaf()) {
-    const auto& leaf =
-        std::static_pointer_cast<PatriciaTreeLeaf<IntegerType, Value>>(t);
+    const auto& leaf = as_leaf(t);
     return update(combine, leaf->key(), leaf->value(), s);
   }
-  const auto& s_branch =
-      std::static_pointer_cast<PatriciaTreeBranch<IntegerType, Value>>(s);
-  const auto& t_branch =
-      std::static_pointer_cast<PatriciaTreeBranch<IntegerType, Value>>(t);
+  const auto& s_branch = as_branch(s);
+  const auto& t_branch = as_branch(t);
   IntegerType m = s_branch->branching_bit();
   IntegerType n = t_branch->branching_bit();
   IntegerType p = s_branch->prefix();
@@ -845,7 +910,7 @@ inline std::shared_ptr<PatriciaTree<IntegerType, Value>> merge(
     if (new_left == t0 && new_right == t1) {
       return t;
     }
-    return std::make_shared<PatriciaTreeBranch<IntegerType, Value>>(
+    return make_node<PatriciaTreeBranch<IntegerType, Value, Allocation>>(
         p, m, new_left, new_right);
   }
   if (m < n && match_prefix(q, p, m)) {
@@ -855,14 +920,14 @@ inline std::shared_ptr<PatriciaTree<IntegerType, Value>> merge(
       if (s0 == new_left) {
         return s;
       }
-      return std::make_shared<PatriciaTreeBranch<IntegerType, Value>>(
+      return make_node<PatriciaTreeBranch<IntegerType, Value, Allocation>>(
           p, m, new_left, s1);
     } else {
       auto new_right = merge(combine, s1, t);
       if (s1 == new_right) {
         return s;
       }
-      return std::make_shared<PatriciaTreeBranch<IntegerType, Value>>(
+      return make_node<PatriciaTreeBranch<IntegerType, Value, Allocation>>(
           p, m, s0, new_right);
     }
   }
@@ -873,14 +938,14 @@ inline std::shared_ptr<PatriciaTree<IntegerType, Value>> merge(
       if (t0 == new_left) {
         return t;
       }
-      return std::make_shared<PatriciaTreeBranch<IntegerType, Value>>(
+      return make_node<PatriciaTreeBranch<IntegerType, Value, Allocation>>(
           q, n, new_left, t1);
     } else {
       auto new_right = merge(combine, s, t1);
       if (t1 == new_right) {
         return t;
       }
-      return std::make_shared<PatriciaTreeBranch<IntegerType, Value>>(
+      return make_node<PatriciaTreeBranch<IntegerType, Value, Allocation>>(
           q, n, t0, new_right);
     }
   }
@@ -889,38 +954,39 @@ inline std::shared_ptr<PatriciaTree<IntegerType, Value>> merge(
 }
 
 // Combine :value with the value in :leaf.
-template <typename IntegerType, typename Value>
-inline std::shared_ptr<PatriciaTree<IntegerType, Value>> combine_leaf(
+template <typename IntegerType, typename Value, typename Allocation>
+inline PatriciaTreePtr<IntegerType, Value, Allocation> combine_leaf(
     const ptmap_impl::CombiningFunction<typename Value::type>& combine,
     const typename Value::type& value,
-    const std::shared_ptr<PatriciaTreeLeaf<IntegerType, Value>>& leaf) {
+    const boost::intrusive_ptr<
+        PatriciaTreeLeaf<IntegerType, Value, Allocation>>& leaf) {
   auto combined_value = combine(leaf->value(), value);
   if (Value::is_default_value(combined_value)) {
     return nullptr;
   }
   if (!Value::equals(combined_value, leaf->value())) {
-    return std::make_shared<PatriciaTreeLeaf<IntegerType, Value>>(
+    return make_node<PatriciaTreeLeaf<IntegerType, Value, Allocation>>(
         leaf->key(), combined_value);
   }
   return leaf;
 }
 
 // Create a new leaf with the default value and combine :value into it.
-template <typename IntegerType, typename Value>
-inline std::shared_ptr<PatriciaTree<IntegerType, Value>> combine_new_leaf(
+template <typename IntegerType, typename Value, typename Allocation>
+inline PatriciaTreePtr<IntegerType, Value, Allocation> combine_new_leaf(
     const ptmap_impl::CombiningFunction<typename Value::type>& combine,
     IntegerType key,
     const typename Value::type& value) {
-  auto new_leaf = std::make_shared<PatriciaTreeLeaf<IntegerType, Value>>(
+  auto new_leaf = make_node<PatriciaTreeLeaf<IntegerType, Value, Allocation>>(
       key, Value::default_value());
   return combine_leaf(combine, value, new_leaf);
 }
 
-template <typename IntegerType, typename Value>
-inline std::shared_ptr<PatriciaTree<IntegerType, Value>> intersect(
+template <typename IntegerType, typename Value, typename Allocation>
+inline PatriciaTreePtr<IntegerType, Value, Allocation> intersect(
     const ptmap_impl::CombiningFunction<typename Value::type>& combine,
-    const std::shared_ptr<PatriciaTree<IntegerType, Value>>& s,
-    const std::shared_ptr<PatriciaTree<IntegerType, Value>>& t) {
+    const PatriciaTreePtr<IntegerType, Value, Allocation>& s,
+    const PatriciaTreePtr<IntegerType, Value, Allocation>& t) {
   if (s == t) {
     // This conditional is what allows the intersection operation to complete in
     // sublinear time when the operands share some structure.
@@ -930,8 +996,7 @@ inline std::shared_ptr<PatriciaTree<IntegerType, Value>> intersect(
     return nullptr;
   }
   if (s->is_leaf()) {
-    const auto& leaf =
-        std::static_pointer_cast<PatriciaTreeLeaf<IntegerType, Value>>(s);
+    const auto& leaf = as_leaf(s);
     auto* value = find_value(leaf->key(), t);
     if (value == nullptr) {
       return nullptr;
@@ -939,18 +1004,15 @@ inline std::shared_ptr<PatriciaTree<IntegerType, Value>> intersect(
     return combine_leaf(combine, *value, leaf);
   }
   if (t->is_leaf()) {
-    const auto& leaf =
-        std::static_pointer_cast<PatriciaTreeLeaf<IntegerType, Value>>(t);
+    const auto& leaf = as_leaf(t);
     auto* value = find_value(leaf->key(), s);
     if (value == nullptr) {
       return nullptr;
     }
     return combine_leaf(combine, *value, leaf);
   }
-  const auto& s_branch =
-      std::static_pointer_cast<PatriciaTreeBranch<IntegerType, Value>>(s);
-  const auto& t_branch =
-      std::static_pointer_cast<PatriciaTreeBranch<IntegerType, Value>>(t);
+  const auto& s_branch = as_branch(s);
+  const auto& t_branch = as_branch(t);
   IntegerType m = s_branch->branching_bit();
   IntegerType n = t_branch->branching_bit();
   IntegerType p = s_branch->prefix();
@@ -966,7 +1028,7 @@ inline std::shared_ptr<PatriciaTree<IntegerType, Value>> intersect(
     // The subtrees don't have overlapping explicit values, but the combining
     // function will still be called to merge the elements in one tree with the
     // implicit default values in the other.
-    return merge<IntegerType, Value>(
+    return merge<IntegerType, Value, Allocation>(
         [](const typename Value::type& x, const typename Value::type& y) ->
         typename Value::type {
           if (Value::is_default_value(x)) {
@@ -995,7 +1057,7 @@ inline std::shared_ptr<PatriciaTree<IntegerType, Value>> intersect(
 
 // The iterator basically performs a post-order traversal of the tree, pausing
 // at each leaf.
-template <typename Key, typename Value>
+template <typename Key, typename Value, typename Allocation>
 class PatriciaTreeIterator final {
  public:
   // C++ iterator concept member types
@@ -1012,7 +1074,7 @@ class PatriciaTreeIterator final {
   PatriciaTreeIterator() {}
 
   explicit PatriciaTreeIterator(
-      const std::shared_ptr<PatriciaTree<IntegerType, Value>>& tree) {
+      const PatriciaTreePtr<IntegerType, Value, Allocation>& tree) {
     if (tree == nullptr) {
       return;
     }
@@ -1063,24 +1125,25 @@ class PatriciaTreeIterator final {
  private:
   // The argument is never null.
   void go_to_next_leaf(
-      const std::shared_ptr<PatriciaTree<IntegerType, Value>>& tree) {
+      const PatriciaTreePtr<IntegerType, Value, Allocation>& tree) {
     auto t = tree;
     // We go to the leftmost leaf, storing the branches that we're traversing
     // on the stack. By definition of a Patricia tree, a branch node always
     // has two children, hence the leftmost leaf always exists.
     while (t->is_branch()) {
-      auto branch =
-          std::static_pointer_cast<PatriciaTreeBranch<IntegerType, Value>>(t);
+      auto branch = as_branch(t);
       m_stack.push(branch);
       t = branch->left_tree();
       // A branch node always has two children.
       RUNTIME_CHECK(t != nullptr, internal_error());
     }
-    m_leaf = std::static_pointer_cast<PatriciaTreeLeaf<IntegerType, Value>>(t);
+    m_leaf = as_leaf(t);
   }
 
-  std::stack<std::shared_ptr<PatriciaTreeBranch<IntegerType, Value>>> m_stack;
-  std::shared_ptr<PatriciaTreeLeaf<IntegerType, Value>> m_leaf;
+  std::stack<
+      boost::intrusive_ptr<PatriciaTreeBranch<IntegerType, Value, Allocation>>>
+      m_stack;
+  boost::intrusive_ptr<PatriciaTreeLeaf<IntegerType, Value, Allocation>> m_leaf;
 };
 
 } // namespace ptmap_impl
@@ -7,6 +7,7 @@
 
 #pragma once
 
+#include <array>
 #include <cstddef>
 #include <functional>
 #include <initializer_list>
@@ -22,7 +23,7 @@ namespace sparta {
 
 namespace ptmae_impl {
 
-template <typename Variable, typename Domain>
+template <typename Variable, typename Domain, typename Allocation>
 class MapValue;
 
 class value_is_bottom {};
@@ -37,17 +38,25 @@ class value_is_bottom {};
  *
  * See HashedAbstractEnvironment.h for more details about abstract
  * environments.
+ *
+ * Allocation is the node policy of the underlying Patricia tree map (see
+ * PatriciaTreeUtil.h). Hash-consed environments require the Domain to provide
+ * a `size_t hash() const` method consistent with `equals()`.
  */
-template <typename Variable, typename Domain>
+template <typename Variable,
+          typename Domain,
+          typename Allocation = pt_util::HeapNodes>
 class PatriciaTreeMapAbstractEnvironment final
     : public AbstractDomainScaffolding<
-          ptmae_impl::MapValue<Variable, Domain>,
-          PatriciaTreeMapAbstractEnvironment<Variable, Domain>> {
+          ptmae_impl::MapValue<Variable, Domain, Allocation>,
+          PatriciaTreeMapAbstractEnvironment<Variable, Domain, Allocation>> {
  public:
-  using Value = ptmae_impl::MapValue<Variable, Domain>;
+  using Value = ptmae_impl::MapValue<Variable, Domain, Allocation>;
 
-  using MapType =
-      PatriciaTreeMap<Variable, Domain, typename Value::ValueInterface>;
+  using MapType = PatriciaTreeMap<Variable,
+                                  Domain,
+                                  typename Value::ValueInterface,
+                                  Allocation>;
 
   /*
    * The default constructor produces the Top value.
@@ -170,11 +179,11 @@ class PatriciaTreeMapAbstractEnvironment final
 
 } // namespace sparta
 
-template <typename Variable, typename Domain>
+template <typename Variable, typename Domain, typename Allocation>
 inline std::ostream& operator<<(
     std::ostream& o,
-    const typename sparta::PatriciaTreeMapAbstractEnvironment<Variable, Domain>&
-        e) {
+    const typename sparta::
+        PatriciaTreeMapAbstractEnvironment<Variable, Domain, Allocation>& e) {
   using namespace sparta;
   switch (e.kind()) {
   case AbstractValueKind::Bottom: {
@@ -198,6 +207,64 @@ namespace sparta {
 
 namespace ptmae_impl {
 
+struct JoinOperation {};
+
+struct MeetOperation {};
+
+/*
+ * A small per-thread cache of the most recent results of an operation on the
+ * maps of abstract environments. Fixpoint iterations keep combining the same
+ * pairs of environments, e.g., at the head of a loop whose body has already
+ * stabilized. Operands are matched by the identity of their trees, which the
+ * cache keeps alive, hence a hit is always exact. This works best with
+ * hash-consed maps, where equal environments always share their tree.
+ */
+template <typename Map, typename Operation>
+class OperationCache final {
+ public:
+  static OperationCache& get() {
+    static thread_local OperationCache cache;
+    return cache;
+  }
+
+  // Returns the cached result of the operation on x and y, or null.
+  const std::pair<Map, AbstractValueKind>* find(const Map& x,
+                                                const Map& y) const {
+    for (const auto& entry : m_entries) {
+      if (entry.valid && entry.x.reference_equals(x) &&
+          entry.y.reference_equals(y)) {
+        return &entry.result;
+      }
+    }
+    return nullptr;
+  }
+
+  void insert(const Map& x,
+              const Map& y,
+              const Map& result,
+              AbstractValueKind kind) {
+    auto& entry = m_entries[m_next];
+    m_next = (m_next + 1) % kSize;
+    entry.valid = true;
+    entry.x = x;
+    entry.y = y;
+    entry.result = std::make_pair(result, kind);
+  }
+
+ private:
+  static constexpr size_t kSize = 8;
+
+  struct Entry {
+    bool valid{false};
+    Map x;
+    Map y;
+    std::pair<Map, AbstractValueKind> result;
+  };
+
+  std::array<Entry, kSize> m_entries;
+  size_t m_next{0};
+};
+
 /*
  * The definition of an element of an abstract environment, i.e., a map from a
  * (possibly infinite) set of variables to an abstract domain implemented as a
@@ -208,8 +275,9 @@ namespace ptmae_impl {
  * return AbstractValueKind::Bottom whenever a binding with Bottom is about to
  * be created.
  */
-template <typename Variable, typename Domain>
-class MapValue final : public AbstractValue<MapValue<Variable, Domain>> {
+template <typename Variable, typename Domain, typename Allocation>
+class MapValue final
+    : public AbstractValue<MapValue<Variable, Domain, Allocation>> {
  public:
   struct ValueInterface {
     using type = Domain;
@@ -221,8 +289,14 @@ class MapValue final : public AbstractValue<MapValue<Variable, Domain>> {
     static bool equals(const type& x, const type& y) { return x.equals(y); }
 
     static bool leq(const type& x, const type& y) { return x.leq(y); }
+
+    // Only required by hash-consed environments.
+    static size_t hash(const type& x) { return x.hash(); }
   };
 
+  using MapType =
+      PatriciaTreeMap<Variable, Domain, ValueInterface, Allocation>;
+
   MapValue() = default;
 
   MapValue(const Variable& variable, const Domain& value) {
@@ -246,8 +320,10 @@ class MapValue final : public AbstractValue<MapValue<Variable, Domain>> {
   }
 
   AbstractValueKind join_with(const MapValue& other) override {
-    return join_like_operation(
-        other, [](const Domain& x, const Domain& y) { return x.join(y); });
+    return cached_operation<JoinOperation>(other, [this, &other] {
+      return join_like_operation(
+          other, [](const Domain& x, const Domain& y) { return x.join(y); });
+    });
   }
 
   AbstractValueKind widen_with(const MapValue& other) override {
@@ -256,8 +332,10 @@ class MapValue final : public AbstractValue<MapValue<Variable, Domain>> {
   }
 
   AbstractValueKind meet_with(const MapValue& other) override {
-    return meet_like_operation(
-        other, [](const Domain& x, const Domain& y) { return x.meet(y); });
+    return cached_operation<MeetOperation>(other, [this, &other] {
+      return meet_like_operation(
+          other, [](const Domain& x, const Domain& y) { return x.meet(y); });
+    });
   }
 
   AbstractValueKind narrow_with(const MapValue& other) override {
@@ -266,6 +344,22 @@ class MapValue final : public AbstractValue<MapValue<Variable, Domain>> {
   }
 
  private:
+  template <typename Operation, typename Compute>
+  AbstractValueKind cached_operation(const MapValue& other,
+                                     const Compute& compute) {
+    auto& cache = OperationCache<MapType, Operation>::get();
+    if (const auto* result = cache.find(m_map, other.m_map)) {
+      m_map = result->first;
+      return result->second;
+    }
+    // The operands may be the same object.
+    auto x = m_map;
+    auto y = other.m_map;
+    auto kind = compute();
+    cache.insert(x, y, m_map, kind);
+    return kind;
+  }
+
   void insert_binding(const Variable& variable, const Domain& value) {
     // The Bottom value is handled by the caller and should never occur here.
     RUNTIME_CHECK(!value.is_bottom(), internal_error());
@@ -305,9 +399,9 @@ class MapValue final : public AbstractValue<MapValue<Variable, Domain>> {
     }
   }
 
-  PatriciaTreeMap<Variable, Domain, ValueInterface> m_map;
+  MapType m_map;
 
-  template <typename T1, typename T2>
+  template <typename T1, typename T2, typename T3>
   friend class sparta::PatriciaTreeMapAbstractEnvironment;
 };
 
@@ -20,6 +20,7 @@
 #include <utility>
 
 #include <boost/functional/hash.hpp>
+#include <boost/intrusive_ptr.hpp>
 
 #include "Exceptions.h"
 #include "PatriciaTreeUtil.h"
@@ -29,55 +30,62 @@ namespace sparta {
 // Forward declarations.
 namespace pt_impl {
 
-template <typename IntegerType>
+template <typename IntegerType, typename Allocation>
 class PatriciaTree;
 
-template <typename IntegerType>
+template <typename IntegerType, typename Allocation>
 class PatriciaTreeLeaf;
 
-template <typename IntegerType>
+template <typename IntegerType, typename Allocation>
+class PatriciaTreeBranch;
+
+template <typename IntegerType, typename Allocation>
+using PatriciaTreePtr =
+    boost::intrusive_ptr<PatriciaTree<IntegerType, Allocation>>;
+
+template <typename IntegerType, typename Allocation>
 class PatriciaTreeIterator;
 
-template <typename IntegerType>
+template <typename IntegerType, typename Allocation>
 inline bool contains(IntegerType key,
-                     const std::shared_ptr<PatriciaTree<IntegerType>>& tree);
+                     const PatriciaTreePtr<IntegerType, Allocation>& tree);
 
-template <typename IntegerType>
+template <typename IntegerType, typename Allocation>
 inline bool is_subset_of(
-    const std::shared_ptr<PatriciaTree<IntegerType>>& tree1,
-    const std::shared_ptr<PatriciaTree<IntegerType>>& tree2);
+    const PatriciaTreePtr<IntegerType, Allocation>& tree1,
+    const PatriciaTreePtr<IntegerType, Allocation>& tree2);
 
-template <typename IntegerType>
-inline bool equals(const std::shared_ptr<PatriciaTree<IntegerType>>& tree1,
-                   const std::shared_ptr<PatriciaTree<IntegerType>>& tree2);
+template <typename IntegerType, typename Allocation>
+inline bool equals(const PatriciaTreePtr<IntegerType, Allocation>& tree1,
+                   const PatriciaTreePtr<IntegerType, Allocation>& tree2);
 
-template <typename IntegerType>
-inline std::shared_ptr<PatriciaTree<IntegerType>> insert(
-    IntegerType key, const std::shared_ptr<PatriciaTree<IntegerType>>& tree);
+template <typename IntegerType, typename Allocation>
+inline PatriciaTreePtr<IntegerType, Allocation> insert(
+    IntegerType key, const PatriciaTreePtr<IntegerType, Allocation>& tree);
 
-template <typename IntegerType>
-inline std::shared_ptr<PatriciaTree<IntegerType>> remove(
-    IntegerType key, const std::shared_ptr<PatriciaTree<IntegerType>>& tree);
+template <typename IntegerType, typename Allocation>
+inline PatriciaTreePtr<IntegerType, Allocation> remove(
+    IntegerType key, const PatriciaTreePtr<IntegerType, Allocation>& tree);
 
-template <typename IntegerType>
-inline std::shared_ptr<PatriciaTree<IntegerType>> filter(
+template <typename IntegerType, typename Allocation>
+inline PatriciaTreePtr<IntegerType, Allocation> filter(
     const std::function<bool(IntegerType)>& predicate,
-    const std::shared_ptr<PatriciaTree<IntegerType>>& tree);
+    const PatriciaTreePtr<IntegerType, Allocation>& tree);
 
-template <typename IntegerType>
-inline std::shared_ptr<PatriciaTree<IntegerType>> merge(
-    const std::shared_ptr<PatriciaTree<IntegerType>>& s,
-    const std::shared_ptr<PatriciaTree<IntegerType>>& t);
+template <typename IntegerType, typename Allocation>
+inline PatriciaTreePtr<IntegerType, Allocation> merge(
+    const PatriciaTreePtr<IntegerType, Allocation>& s,
+    const PatriciaTreePtr<IntegerType, Allocation>& t);
 
-template <typename IntegerType>
-inline std::shared_ptr<PatriciaTree<IntegerType>> intersect(
-    const std::shared_ptr<PatriciaTree<IntegerType>>& s,
-    const std::shared_ptr<PatriciaTree<IntegerType>>& t);
+template <typename IntegerType, typename Allocation>
+inline PatriciaTreePtr<IntegerType, Allocation> intersect(
+    const PatriciaTreePtr<IntegerType, Allocation>& s,
+    const PatriciaTreePtr<IntegerType, Allocation>& t);
 
-template <typename IntegerType>
-inline std::shared_ptr<PatriciaTree<IntegerType>> diff(
-    const std::shared_ptr<PatriciaTree<IntegerType>>& s,
-    const std::shared_ptr<PatriciaTree<IntegerType>>& t);
+template <typename IntegerType, typename Allocation>
+inline PatriciaTreePtr<IntegerType, Allocation> diff(
+    const PatriciaTreePtr<IntegerType, Allocation>& s,
+    const PatriciaTreePtr<IntegerType, Allocation>& t);
 
 } // namespace pt_impl
 
@@ -106,12 +114,15 @@ inline std::shared_ptr<PatriciaTree<IntegerType>> diff(
  * accommodated as long as they are represented as pointers. Our implementation
  * of Patricia-tree sets can transparently operate on either unsigned integers
  * or pointers to objects.
+ *
+ * The Allocation parameter selects how the nodes of the trees are allocated,
+ * see HeapNodes and PooledNodes in PatriciaTreeUtil.h.
  */
-template <typename Element>
+template <typename Element, typename Allocation = pt_util::HeapNodes>
 class PatriciaTreeSet final {
  public:
   // C++ container concept member types
-  using iterator = pt_impl::PatriciaTreeIterator<Element>;
+  using iterator = pt_impl::PatriciaTreeIterator<Element, Allocation>;
   using const_iterator = iterator;
   using value_type = Element;
   using difference_type = std::ptrdiff_t;
@@ -257,10 +268,10 @@ class PatriciaTreeSet final {
   void clear() { m_tree.reset(); }
 
   friend std::ostream& operator<<(std::ostream& o,
-                                  const PatriciaTreeSet<Element>& s) {
+                                  const PatriciaTreeSet& s) {
     o << "{";
     for (auto it = s.begin(); it != s.end(); ++it) {
-      o << PatriciaTreeSet<Element>::deref(*it);
+      o << PatriciaTreeSet::deref(*it);
       if (std::next(it) != s.end()) {
         o << ", ";
       }
@@ -309,9 +320,9 @@ class PatriciaTreeSet final {
     return x;
   }
 
-  std::shared_ptr<pt_impl::PatriciaTree<IntegerType>> m_tree;
+  pt_impl::PatriciaTreePtr<IntegerType, Allocation> m_tree;
 
-  template <typename T>
+  template <typename T, typename A>
   friend class pt_impl::PatriciaTreeIterator;
 };
 
@@ -319,8 +330,8 @@ namespace pt_impl {
 
 using namespace pt_util;
 
-template <typename IntegerType>
-class PatriciaTree {
+template <typename IntegerType, typename Allocation>
+class PatriciaTree : public PatriciaTreeNode<Allocation> {
  public:
   // A Patricia tree is an immutable structure.
   PatriciaTree& operator=(const PatriciaTree& other) = delete;
@@ -353,13 +364,13 @@ class PatriciaTree {
 // (i.e., all bits are 0 except for the branching bit). All keys in the subtree
 // originating from a given node share the same bit prefix (in the little endian
 // ordering), which is stored in m_prefix.
-template <typename IntegerType>
-class PatriciaTreeBranch final : public PatriciaTree<IntegerType> {
+template <typename IntegerType, typename Allocation>
+class PatriciaTreeBranch final : public PatriciaTree<IntegerType, Allocation> {
  public:
   PatriciaTreeBranch(IntegerType prefix,
                      IntegerType branching_bit,
-                     std::shared_ptr<PatriciaTree<IntegerType>> left_tree,
-                     std::shared_ptr<PatriciaTree<IntegerType>> right_tree)
+                     PatriciaTreePtr<IntegerType, Allocation> left_tree,
+                     PatriciaTreePtr<IntegerType, Allocation> right_tree)
       : m_prefix(prefix),
         m_branching_bit(branching_bit),
         m_left_tree(left_tree),
@@ -378,23 +389,36 @@ class PatriciaTreeBranch final : public PatriciaTree<IntegerType> {
 
   IntegerType branching_bit() const { return m_branching_bit; }
 
-  const std::shared_ptr<PatriciaTree<IntegerType>>& left_tree() const {
+  const PatriciaTreePtr<IntegerType, Allocation>& left_tree() const {
     return m_left_tree;
   }
 
-  const std::shared_ptr<PatriciaTree<IntegerType>>& right_tree() const {
+  const PatriciaTreePtr<IntegerType, Allocation>& right_tree() const {
     return m_right_tree;
   }
 
+  size_t hash_cons_hash() const { return this->hash(); }
+
+  bool hash_cons_equals(const PatriciaTreeBranch& other) const {
+    return m_prefix == other.m_prefix &&
+           m_branching_bit == other.m_branching_bit &&
+           m_left_tree == other.m_left_tree &&
+           m_right_tree == other.m_right_tree;
+  }
+
  private:
+  void unintern() const override {
+    hash_cons_impl::unintern(this, Allocation());
+  }
+
   IntegerType m_prefix;
   IntegerType m_branching_bit;
-  std::shared_ptr<PatriciaTree<IntegerType>> m_left_tree;
-  std::shared_ptr<PatriciaTree<IntegerType>> m_right_tree;
+  PatriciaTreePtr<IntegerType, Allocation> m_left_tree;
+  PatriciaTreePtr<IntegerType, Allocation> m_right_tree;
 };
 
-template <typename IntegerType>
-class PatriciaTreeLeaf final : public PatriciaTree<IntegerType> {
+template <typename IntegerType, typename Allocation>
+class PatriciaTreeLeaf final : public PatriciaTree<IntegerType, Allocation> {
  public:
   explicit PatriciaTreeLeaf(IntegerType key) : m_key(key) {
     boost::hash<IntegerType> hasher;
@@ -405,57 +429,79 @@ class PatriciaTreeLeaf final : public PatriciaTree<IntegerType> {
 
   const IntegerType& key() const { return m_key; }
 
+  size_t hash_cons_hash() const { return this->hash(); }
+
+  bool hash_cons_equals(const PatriciaTreeLeaf& other) const {
+    return m_key == other.m_key;
+  }
+
  private:
+  void unintern() const override {
+    hash_cons_impl::unintern(this, Allocation());
+  }
+
   IntegerType m_key;
 };
 
-template <typename IntegerType>
-std::shared_ptr<PatriciaTreeBranch<IntegerType>> join(
+template <typename IntegerType, typename Allocation>
+inline boost::intrusive_ptr<PatriciaTreeLeaf<IntegerType, Allocation>> as_leaf(
+    const PatriciaTreePtr<IntegerType, Allocation>& tree) {
+  return boost::static_pointer_cast<PatriciaTreeLeaf<IntegerType, Allocation>>(
+      tree);
+}
+
+template <typename IntegerType, typename Allocation>
+inline boost::intrusive_ptr<PatriciaTreeBranch<IntegerType, Allocation>>
+as_branch(const PatriciaTreePtr<IntegerType, Allocation>& tree) {
+  return boost::static_pointer_cast<
+      PatriciaTreeBranch<IntegerType, Allocation>>(tree);
+}
+
+template <typename IntegerType, typename Allocation>
+boost::intrusive_ptr<PatriciaTreeBranch<IntegerType, Allocation>> join(
     IntegerType prefix0,
-    const std::shared_ptr<PatriciaTree<IntegerType>>& tree0,
+    const PatriciaTreePtr<IntegerType, Allocation>& tree0,
     IntegerType prefix1,
-    const std::shared_ptr<PatriciaTree<IntegerType>>& tree1) {
+    const PatriciaTreePtr<IntegerType, Allocation>& tree1) {
   IntegerType m = get_branching_bit(prefix0, prefix1);
   if (is_zero_bit(prefix0, m)) {
-    return std::make_shared<PatriciaTreeBranch<IntegerType>>(
+    return make_node<PatriciaTreeBranch<IntegerType, Allocation>>(
         mask(prefix0, m), m, tree0, tree1);
   } else {
-    return std::make_shared<PatriciaTreeBranch<IntegerType>>(
+    return make_node<PatriciaTreeBranch<IntegerType, Allocation>>(
         mask(prefix0, m), m, tree1, tree0);
   }
 }
 
 // This function is used by remove() to prevent the creation of branch nodes
 // with only one child.
-template <typename IntegerType>
-std::shared_ptr<PatriciaTree<IntegerType>> make_branch(
+template <typename IntegerType, typename Allocation>
+PatriciaTreePtr<IntegerType, Allocation> make_branch(
     IntegerType prefix,
     IntegerType branching_bit,
-    const std::shared_ptr<PatriciaTree<IntegerType>>& left_tree,
-    const std::shared_ptr<PatriciaTree<IntegerType>>& right_tree) {
+    const PatriciaTreePtr<IntegerType, Allocation>& left_tree,
+    const PatriciaTreePtr<IntegerType, Allocation>& right_tree) {
   if (left_tree == nullptr) {
     return right_tree;
   }
   if (right_tree == nullptr) {
     return left_tree;
   }
-  return std::make_shared<PatriciaTreeBranch<IntegerType>>(
+  return make_node<PatriciaTreeBranch<IntegerType, Allocation>>(
       prefix, branching_bit, left_tree, right_tree);
 }
 
-template <typename IntegerType>
+template <typename IntegerType, typename Allocation>
 inline bool contains(IntegerType key,
-                     const std::shared_ptr<PatriciaTree<IntegerType>>& tree) {
+                     const PatriciaTreePtr<IntegerType, Allocation>& tree) {
   if (tree == nullptr) {
     return false;
   }
   if (tree->is_leaf()) {
-    const auto& leaf =
-        std::static_pointer_cast<PatriciaTreeLeaf<IntegerType>>(tree);
+    const auto& leaf = as_leaf(tree);
     return key == leaf->key();
   }
-  const auto& branch =
-      std::static_pointer_cast<PatriciaTreeBranch<IntegerType>>(tree);
+  const auto& branch = as_branch(tree);
   if (is_zero_bit(key, branch->branching_bit())) {
     return contains(key, branch->left_tree());
   } else {
@@ -463,10 +509,10 @@ inline bool contains(IntegerType key,
   }
 }
 
-template <typename IntegerType>
+template <typename IntegerType, typename Allocation>
 inline bool is_subset_of(
-    const std::shared_ptr<PatriciaTree<IntegerType>>& tree1,
-    const std::shared_ptr<PatriciaTree<IntegerType>>& tree2) {
+    const PatriciaTreePtr<IntegerType, Allocation>& tree1,
+    const PatriciaTreePtr<IntegerType, Allocation>& tree2) {
   if (tree1 == tree2) {
     // This conditions allows the inclusion test to run in sublinear time
     // when comparing Patricia trees that share some structure.
@@ -479,17 +525,14 @@ inline bool is_subset_of(
     return false;
   }
   if (tree1->is_leaf()) {
-    const auto& leaf =
-        std::static_pointer_cast<PatriciaTreeLeaf<IntegerType>>(tree1);
+    const auto& leaf = as_leaf(tree1);
     return contains(leaf->key(), tree2);
   }
   if (tree2->is_leaf()) {
     return false;
   }
-  const auto& branch1 =
-      std::static_pointer_cast<PatriciaTreeBranch<IntegerType>>(tree1);
-  const auto& branch2 =
-      std::static_pointer_cast<PatriciaTreeBranch<IntegerType>>(tree2);
+  const auto& branch1 = as_branch(tree1);
+  const auto& branch2 = as_branch(tree2);
   if (branch1->prefix() == branch2->prefix() &&
       branch1->branching_bit() == branch2->branching_bit()) {
     return is_subset_of(branch1->left_tree(), branch2->left_tree()) &&
@@ -511,9 +554,9 @@ inline bool is_subset_of(
 
 // A Patricia tree is a canonical representation of the set of keys it contains.
 // Hence, set equality is equivalent to structural equality of Patricia trees.
-template <typename IntegerType>
-inline bool equals(const std::shared_ptr<PatriciaTree<IntegerType>>& tree1,
-                   const std::shared_ptr<PatriciaTree<IntegerType>>& tree2) {
+template <typename IntegerType, typename Allocation>
+inline bool equals(const PatriciaTreePtr<IntegerType, Allocation>& tree1,
+                   const PatriciaTreePtr<IntegerType, Allocation>& tree2) {
   if (tree1 == tree2) {
     // This conditions allows the equality test to run in sublinear time
     // when comparing Patricia trees that share some structure.
@@ -525,6 +568,10 @@ inline bool equals(const std::shared_ptr<PatriciaTree<IntegerType>>& tree1,
   if (tree2 == nullptr) {
     return false;
   }
+  if (Allocation::hash_consed) {
+    // Structurally equal hash-consed trees are the same node.
+    return false;
+  }
   // Since the hash codes are readily available (they're computed when the trees
   // are constructed), we can use them to cut short the equality test.
   if (tree1->hash() != tree2->hash()) {
@@ -534,52 +581,46 @@ inline bool equals(const std::shared_ptr<PatriciaTree<IntegerType>>& tree1,
     if (tree2->is_branch()) {
       return false;
     }
-    const auto& leaf1 =
-        std::static_pointer_cast<PatriciaTreeLeaf<IntegerType>>(tree1);
-    const auto& leaf2 =
-        std::static_pointer_cast<PatriciaTreeLeaf<IntegerType>>(tree2);
+    const auto& leaf1 = as_leaf(tree1);
+    const auto& leaf2 = as_leaf(tree2);
     return leaf1->key() == leaf2->key();
   }
   if (tree2->is_leaf()) {
     return false;
   }
-  const auto& branch1 =
-      std::static_pointer_cast<PatriciaTreeBranch<IntegerType>>(tree1);
-  const auto& branch2 =
-      std::static_pointer_cast<PatriciaTreeBranch<IntegerType>>(tree2);
+  const auto& branch1 = as_branch(tree1);
+  const auto& branch2 = as_branch(tree2);
   return branch1->prefix() == branch2->prefix() &&
          branch1->branching_bit() == branch2->branching_bit() &&
          equals(branch1->left_tree(), branch2->left_tree()) &&
          equals(branch1->right_tree(), branch2->right_tree());
 }
 
-template <typename IntegerType>
-inline std::shared_ptr<PatriciaTree<IntegerType>> insert(
-    IntegerType key, const std::shared_ptr<PatriciaTree<IntegerType>>& tree) {
+template <typename IntegerType, typename Allocation>
+inline PatriciaTreePtr<IntegerType, Allocation> insert(
+    IntegerType key, const PatriciaTreePtr<IntegerType, Allocation>& tree) {
   if (tree == nullptr) {
-    return std::make_shared<PatriciaTreeLeaf<IntegerType>>(key);
+    return make_node<PatriciaTreeLeaf<IntegerType, Allocation>>(key);
   }
   if (tree->is_leaf()) {
-    const auto& leaf =
-        std::static_pointer_cast<PatriciaTreeLeaf<IntegerType>>(tree);
+    const auto& leaf = as_leaf(tree);
     if (key == leaf->key()) {
       return leaf;
     }
-    return join<IntegerType>(
+    return join<IntegerType, Allocation>(
         key,
-        std::make_shared<PatriciaTreeLeaf<IntegerType>>(key),
+        make_node<PatriciaTreeLeaf<IntegerType, Allocation>>(key),
         leaf->key(),
         leaf);
   }
-  const auto& branch =
-      std::static_pointer_cast<PatriciaTreeBranch<IntegerType>>(tree);
+  const auto& branch = as_branch(tree);
   if (match_prefix(key, branch->prefix(), branch->branching_bit())) {
     if (is_zero_bit(key, branch->branching_bit())) {
       auto new_left_tree = insert(key, branch->left_tree());
       if (new_left_tree == branch->left_tree()) {
         return branch;
       }
-      return std::make_shared<PatriciaTreeBranch<IntegerType>>(
+      return make_node<PatriciaTreeBranch<IntegerType, Allocation>>(
           branch->prefix(),
           branch->branching_bit(),
           new_left_tree,
@@ -589,92 +630,89 @@ inline std::shared_ptr<PatriciaTree<IntegerType>> insert(
       if (new_right_tree == branch->right_tree()) {
         return branch;
       }
-      return std::make_shared<PatriciaTreeBranch<IntegerType>>(
+      return make_node<PatriciaTreeBranch<IntegerType, Allocation>>(
           branch->prefix(),
           branch->branching_bit(),
           branch->left_tree(),
           new_right_tree);
     }
   }
-  return join<IntegerType>(key,
-                           std::make_shared<PatriciaTreeLeaf<IntegerType>>(key),
-                           branch->prefix(),
-                           branch);
+  return join<IntegerType, Allocation>(
+      key,
+      make_node<PatriciaTreeLeaf<IntegerType, Allocation>>(key),
+      branch->prefix(),
+      branch);
 }
 
-template <typename IntegerType>
-inline std::shared_ptr<PatriciaTree<IntegerType>> remove(
-    IntegerType key, const std::shared_ptr<PatriciaTree<IntegerType>>& tree) {
+template <typename IntegerType, typename Allocation>
+inline PatriciaTreePtr<IntegerType, Allocation> remove(
+    IntegerType key, const PatriciaTreePtr<IntegerType, Allocation>& tree) {
   if (tree == nullptr) {
     return nullptr;
   }
   if (tree->is_leaf()) {
-    const auto& leaf =
-        std::static_pointer_cast<PatriciaTreeLeaf<IntegerType>>(tree);
+    const auto& leaf = as_leaf(tree);
     if (key == leaf->key()) {
       return nullptr;
     }
     return leaf;
   }
-  const auto& branch =
-      std::static_pointer_cast<PatriciaTreeBranch<IntegerType>>(tree);
+  const auto& branch = as_branch(tree);
   if (match_prefix(key, branch->prefix(), branch->branching_bit())) {
     if (is_zero_bit(key, branch->branching_bit())) {
       auto new_left_tree = remove(key, branch->left_tree());
       if (new_left_tree == branch->left_tree()) {
         return branch;
       }
-      return make_branch<IntegerType>(branch->prefix(),
-                                      branch->branching_bit(),
-                                      new_left_tree,
-                                      branch->right_tree());
+      return make_branch<IntegerType, Allocation>(branch->prefix(),
+                                                  branch->branching_bit(),
+                                                  new_left_tree,
+                                                  branch->right_tree());
     } else {
       auto new_right_tree = remove(key, branch->right_tree());
       if (new_right_tree == branch->right_tree()) {
         return branch;
       }
-      return make_branch<IntegerType>(branch->prefix(),
-                                      branch->branching_bit(),
-                                      branch->left_tree(),
-                                      new_right_tree);
+      return make_branch<IntegerType, Allocation>(branch->prefix(),
+                                                  branch->branching_bit(),
+                                                  branch->left_tree(),
+                                                  new_right_tree);
     }
   }
   return branch;
 }
 
-template <typename IntegerType>
-inline std::shared_ptr<PatriciaTree<IntegerType>> filter(
+template <typename IntegerType, typename Allocation>
+inline PatriciaTreePtr<IntegerType, Allocation> filter(
     const std::function<bool(IntegerType key)>& predicate,
-    const std::shared_ptr<PatriciaTree<IntegerType>>& tree) {
+    const PatriciaTreePtr<IntegerType, Allocation>& tree) {
   if (tree == nullptr) {
     return nullptr;
   }
   if (tree->is_leaf()) {
-    const auto& leaf =
-        std::static_pointer_cast<PatriciaTreeLeaf<IntegerType>>(tree);
+    const auto& leaf = as_leaf(tree);
     return predicate(leaf->key()) ? leaf : nullptr;
   }
-  const auto& branch =
-      std::static_pointer_cast<PatriciaTreeBranch<IntegerType>>(tree);
+  const auto& branch = as_branch(tree);
   auto new_left_tree = filter(predicate, branch->left_tree());
   auto new_right_tree = filter(predicate, branch->right_tree());
   if (new_left_tree == branch->left_tree() &&
       new_right_tree == branch->right_tree()) {
     return branch;
   } else {
-    return make_branch<IntegerType>(branch->prefix(),
-                                    branch->branching_bit(),
-                                    new_left_tree,
-                                    new_right_tree);
+    return make_branch<IntegerType, Allocation>(branch->prefix(),
+                                                branch->branching_bit(),
+                                                new_left_tree,
+                                                new_right_tree);
   }
 }
 
 // We keep the notations of the paper so as to make the implementation easier
 // to follow.
-template <typename IntegerType>
-inline std::shared_ptr<PatriciaTree<IntegerType>> merge(
-    const std::shared_ptr<PatriciaTree<IntegerType>>& s,
-    const std::shared_ptr<PatriciaTree<IntegerType>>& t) {
+template <typename IntegerType, typename Allocation>
+inline PatriciaTreePtr<IntegerType, Allocation> merge(
+    const PatriciaTreePtr<IntegerType, Allocation>& s,
+    const PatriciaTreePtr<IntegerType, Allocation>& t) {
   if (s == t) {
     // This conditional is what allows the union operation to complete in
     // sublinear time when the operands share some structure.
@@ -690,19 +728,15 @@ inline std::shared_ptr<PatriciaTree<IntegerType>> merge(
   // Otherwise, if s and t are both leaves, we would end up inserting s into t.
   // This would violate the assumptions required by `reference_equals()`.
   if (t->is_leaf()) {
-    const auto& leaf =
-        std::static_pointer_cast<PatriciaTreeLeaf<IntegerType>>(t);
+    const auto& leaf = as_leaf(t);
     return insert(leaf->key(), s);
   }
   if (s->is_leaf()) {
-    const auto& leaf =
-        std::static_pointer_cast<PatriciaTreeLeaf<IntegerType>>(s);
+    const auto& leaf = as_leaf(s);
     return insert(leaf->key(), t);
   }
-  const auto& s_branch =
-      std::static_pointer_cast<PatriciaTreeBranch<IntegerType>>(s);
-  const auto& t_branch =
-      std::static_pointer_cast<PatriciaTreeBranch<IntegerType>>(t);
+  const auto& s_branch = as_branch(s);
+  const auto& t_branch = as_branch(t);
   IntegerType m = s_branch->branching_bit();
   IntegerType n = t_branch->branching_bit();
   IntegerType p = s_branch->prefix();
@@ -721,7 +755,7 @@ inline std::shared_ptr<PatriciaTree<IntegerType>> merge(
     if (new_left == t0 && new_right == t1) {
       return t;
     }
-    return std::make_shared<PatriciaTreeBranch<IntegerType>>(
+    return make_node<PatriciaTreeBranch<IntegerType, Allocation>>(
         p, m, new_left, new_right);
   }
   if (m < n && match_prefix(q, p, m)) {
@@ -731,14 +765,14 @@ inline std::shared_ptr<PatriciaTree<IntegerType>> merge(
       if (s0 == new_left) {
         return s;
       }
-      return std::make_shared<PatriciaTreeBranch<IntegerType>>(
+      return make_node<PatriciaTreeBranch<IntegerType, Allocation>>(
           p, m, new_left, s1);
     } else {
       auto new_right = merge(s1, t);
       if (s1 == new_right) {
         return s;
       }
-      return std::make_shared<PatriciaTreeBranch<IntegerType>>(
+      return make_node<PatriciaTreeBranch<IntegerType, Allocation>>(
           p, m, s0, new_right);
     }
   }
@@ -749,14 +783,14 @@ inline std::shared_ptr<PatriciaTree<IntegerType>> merge(
       if (t0 == new_left) {
         return t;
       }
-      return std::make_shared<PatriciaTreeBranch<IntegerType>>(
+      return make_node<PatriciaTreeBranch<IntegerType, Allocation>>(
           q, n, new_left, t1);
     } else {
       auto new_right = merge(s, t1);
       if (t1 == new_right) {
         return t;
       }
-      return std::make_shared<PatriciaTreeBranch<IntegerType>>(
+      return make_node<PatriciaTreeBranch<IntegerType, Allocation>>(
           q, n, t0, new_right);
     }
   }
@@ -764,10 +798,10 @@ inline std::shared_ptr<PatriciaTree<IntegerType>> merge(
   return join(p, s, q, t);
 }
 
-template <typename IntegerType>
-inline std::shared_ptr<PatriciaTree<IntegerType>> intersect(
-    const std::shared_ptr<PatriciaTree<IntegerType>>& s,
-    const std::shared_ptr<PatriciaTree<IntegerType>>& t) {
+template <typename IntegerType, typename Allocation>
+inline PatriciaTreePtr<IntegerType, Allocation> intersect(
+    const PatriciaTreePtr<IntegerType, Allocation>& s,
+    const PatriciaTreePtr<IntegerType, Allocation>& t) {
   if (s == t) {
     // This conditional is what allows the intersection operation to complete in
     // sublinear time when the operands share some structure.
@@ -777,19 +811,15 @@ inline std::shared_ptr<PatriciaTree<IntegerType>> intersect(
     return nullptr;
   }
   if (s->is_leaf()) {
-    const auto& leaf =
-        std::static_pointer_cast<PatriciaTreeLeaf<IntegerType>>(s);
+    const auto& leaf = as_leaf(s);
     return contains(leaf->key(), t) ? leaf : nullptr;
   }
   if (t->is_leaf()) {
-    const auto& leaf =
-        std::static_pointer_cast<PatriciaTreeLeaf<IntegerType>>(t);
+    const auto& leaf = as_leaf(t);
     return contains(leaf->key(), s) ? leaf : nullptr;
   }
-  const auto& s_branch =
-      std::static_pointer_cast<PatriciaTreeBranch<IntegerType>>(s);
-  const auto& t_branch =
-      std::static_pointer_cast<PatriciaTreeBranch<IntegerType>>(t);
+  const auto& s_branch = as_branch(s);
+  const auto& t_branch = as_branch(t);
   IntegerType m = s_branch->branching_bit();
   IntegerType n = t_branch->branching_bit();
   IntegerType p = s_branch->prefix();
@@ -815,10 +845,10 @@ inline std::shared_ptr<PatriciaTree<IntegerType>> intersect(
   return nullptr;
 }
 
-template <typename IntegerType>
-inline std::shared_ptr<PatriciaTree<IntegerType>> diff(
-    const std::shared_ptr<PatriciaTree<IntegerType>>& s,
-    const std::shared_ptr<PatriciaTree<IntegerType>>& t) {
+template <typename IntegerType, typename Allocation>
+inline PatriciaTreePtr<IntegerType, Allocation> diff(
+    const PatriciaTreePtr<IntegerType, Allocation>& s,
+    const PatriciaTreePtr<IntegerType, Allocation>& t) {
   if (s == t) {
     // This conditional is what allows the intersection operation to complete in
     // sublinear time when the operands share some structure.
@@ -831,19 +861,15 @@ inline std::shared_ptr<PatriciaTree<IntegerType>> diff(
     return s;
   }
   if (s->is_leaf()) {
-    const auto& leaf =
-        std::static_pointer_cast<PatriciaTreeLeaf<IntegerType>>(s);
+    const auto& leaf = as_leaf(s);
     return contains(leaf->key(), t) ? nullptr : leaf;
   }
   if (t->is_leaf()) {
-    const auto& leaf =
-        std::static_pointer_cast<PatriciaTreeLeaf<IntegerType>>(t);
+    const auto& leaf = as_leaf(t);
     return remove(leaf->key(), s);
   }
-  const auto& s_branch =
-      std::static_pointer_cast<PatriciaTreeBranch<IntegerType>>(s);
-  const auto& t_branch =
-      std::static_pointer_cast<PatriciaTreeBranch<IntegerType>>(t);
+  const auto& s_branch = as_branch(s);
+  const auto& t_branch = as_branch(t);
   IntegerType m = s_branch->branching_bit();
   IntegerType n = t_branch->branching_bit();
   IntegerType p = s_branch->prefix();
@@ -879,7 +905,7 @@ inline std::shared_ptr<PatriciaTree<IntegerType>> diff(
 
 // The iterator basically performs a post-order traversal of the tree, pausing
 // at each leaf.
-template <typename Element>
+template <typename Element, typename Allocation>
 class PatriciaTreeIterator final {
  public:
   // C++ iterator concept member types
@@ -889,12 +915,13 @@ class PatriciaTreeIterator final {
   using pointer = Element*;
   using reference = const Element&;
 
-  using IntegerType = typename PatriciaTreeSet<Element>::IntegerType;
+  using IntegerType =
+      typename PatriciaTreeSet<Element, Allocation>::IntegerType;
 
   PatriciaTreeIterator() {}
 
   explicit PatriciaTreeIterator(
-      const std::shared_ptr<PatriciaTree<IntegerType>>& tree) {
+      const PatriciaTreePtr<IntegerType, Allocation>& tree) {
     if (tree == nullptr) {
       return;
     }
@@ -935,29 +962,29 @@ class PatriciaTreeIterator final {
   }
 
   Element operator*() {
-    return PatriciaTreeSet<Element>::decode(m_leaf->key());
+    return PatriciaTreeSet<Element, Allocation>::decode(m_leaf->key());
   }
 
  private:
   // The argument is never null.
-  void go_to_next_leaf(const std::shared_ptr<PatriciaTree<IntegerType>>& tree) {
+  void go_to_next_leaf(const PatriciaTreePtr<IntegerType, Allocation>& tree) {
     auto t = tree;
     // We go to the leftmost leaf, storing the branches that we're traversing
     // on the stack. By definition of a Patricia tree, a branch node always
     // has two children, hence the leftmost leaf always exists.
     while (t->is_branch()) {
-      auto branch =
-          std::static_pointer_cast<PatriciaTreeBranch<IntegerType>>(t);
+      auto branch = as_branch(t);
       m_stack.push(branch);
       t = branch->left_tree();
       // A branch node always has two children.
       RUNTIME_CHECK(t != nullptr, internal_error());
     }
-    m_leaf = std::static_pointer_cast<PatriciaTreeLeaf<IntegerType>>(t);
+    m_leaf = as_leaf(t);
   }
 
-  std::stack<std::shared_ptr<PatriciaTreeBranch<IntegerType>>> m_stack;
-  std::shared_ptr<PatriciaTreeLeaf<IntegerType>> m_leaf;
+  std::stack<boost::intrusive_ptr<PatriciaTreeBranch<IntegerType, Allocation>>>
+      m_stack;
+  boost::intrusive_ptr<PatriciaTreeLeaf<IntegerType, Allocation>> m_leaf;
 };
 
 } // namespace pt_impl
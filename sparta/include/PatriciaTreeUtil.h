@@ -7,6 +7,18 @@
 
 #pragma once
 
+#include <array>
+#include <atomic>
+#include <cstddef>
+#include <cstdint>
+#include <mutex>
+#include <new>
+#include <unordered_map>
+#include <utility>
+#include <vector>
+
+#include <boost/intrusive_ptr.hpp>
+
 namespace sparta {
 
 namespace pt_util {
@@ -36,6 +48,388 @@ IntegerType match_prefix(IntegerType k, IntegerType p, IntegerType m) {
   return mask(k, m) == p;
 }
 
+/*
+ * Node allocation policies for Patricia trees, selected by the last template
+ * parameter of PatriciaTreeSet and PatriciaTreeMap.
+ *
+ * HeapNodes allocates every node with the global operator new.
+ *
+ * PooledNodes carves nodes out of large chunks and recycles the nodes that are
+ * freed through a per-thread free list for each node size, so that building
+ * and discarding trees in a tight loop doesn't go through malloc. A node may be
+ * freed by another thread than the one that allocated it, in which case it
+ * joins the free list of the thread that frees it. Threads hand their surplus
+ * of free nodes, and all of them when they exit, back to a shared pool. Chunks
+ * are never returned to the system: the pool holds on to the memory of the
+ * largest number of nodes that were alive at the same time.
+ *
+ * HashConsedNodes<Base> gets its memory from Base, and additionally
+ * hash-conses the nodes: structurally equal subtrees are always represented by
+ * the same node, across all the trees of a given type and all threads. Hence,
+ * equality of trees becomes a pointer comparison. In exchange, every node that
+ * gets created is looked up in a global table, which is guarded by a set of
+ * locks. Hash-consed maps require their value interface to provide
+ *
+ *     static size_t hash(const type& x);
+ *
+ * which must be consistent with `equals()`.
+ */
+struct HeapNodes final {
+  static constexpr bool hash_consed = false;
+
+  static void* allocate(size_t size) { return ::operator new(size); }
+
+  static void deallocate(void* p, size_t /* size */) { ::operator delete(p); }
+};
+
+namespace pool_impl {
+
+constexpr size_t kGranularity = alignof(std::max_align_t);
+// Larger nodes, i.e., map leaves holding large values, go to the heap.
+constexpr size_t kMaxNodeSize = 256;
+constexpr size_t kSizeClasses = kMaxNodeSize / kGranularity;
+// The number of nodes exchanged between a thread and the shared pool at once.
+constexpr size_t kBatchSize = 256;
+
+inline size_t size_class(size_t size) { return (size - 1) / kGranularity; }
+
+struct FreeNode {
+  FreeNode* next;
+};
+
+struct FreeList {
+  FreeNode* head{nullptr};
+  size_t length{0};
+
+  void* pop() {
+    auto* node = head;
+    head = node->next;
+    --length;
+    return node;
+  }
+
+  void push(void* p) {
+    auto* node = static_cast<FreeNode*>(p);
+    node->next = head;
+    head = node;
+    ++length;
+  }
+
+  // Detaches the first n nodes into a list of their own.
+  FreeList split(size_t n) {
+    FreeList front{head, n};
+    auto* last = head;
+    for (size_t i = 1; i < n; ++i) {
+      last = last->next;
+    }
+    head = last->next;
+    length -= n;
+    last->next = nullptr;
+    return front;
+  }
+};
+
+class SharedPool final {
+ public:
+  // The pool is never destroyed, since trees with static storage duration may
+  // release their nodes after all the static objects have been torn down.
+  static SharedPool& get() {
+    static auto* pool = new SharedPool();
+    return *pool;
+  }
+
+  // Returns a nonempty list of free nodes, carving a new chunk if needed.
+  FreeList acquire(size_t cls) {
+    std::lock_guard<std::mutex> lock(m_mutex);
+    auto& lists = m_free_lists[cls];
+    if (!lists.empty()) {
+      auto list = lists.back();
+      lists.pop_back();
+      return list;
+    }
+    size_t node_size = (cls + 1) * kGranularity;
+    auto* chunk = static_cast<char*>(::operator new(node_size * kBatchSize));
+    m_chunks.push_back(chunk);
+    FreeList list;
+    for (size_t i = kBatchSize; i > 0; --i) {
+      list.push(chunk + (i - 1) * node_size);
+    }
+    return list;
+  }
+
+  void release(size_t cls, const FreeList& list) {
+    if (list.head == nullptr) {
+      return;
+    }
+    std::lock_guard<std::mutex> lock(m_mutex);
+    m_free_lists[cls].push_back(list);
+  }
+
+ private:
+  SharedPool() = default;
+
+  std::mutex m_mutex;
+  std::array<std::vector<FreeList>, kSizeClasses> m_free_lists;
+  std::vector<void*> m_chunks;
+};
+
+class LocalPool final {
+ public:
+  // Returns null while the thread is exiting, once its pool is gone.
+  static LocalPool* get() {
+    if (destroyed()) {
+      return nullptr;
+    }
+    static thread_local LocalPool pool;
+    return &pool;
+  }
+
+  ~LocalPool() {
+    destroyed() = true;
+    for (size_t cls = 0; cls < kSizeClasses; ++cls) {
+      SharedPool::get().release(cls, m_free_lists[cls]);
+    }
+  }
+
+  void* allocate(size_t cls) {
+    auto& list = m_free_lists[cls];
+    if (list.head == nullptr) {
+      list = SharedPool::get().acquire(cls);
+    }
+    return list.pop();
+  }
+
+  void deallocate(void* p, size_t cls) {
+    auto& list = m_free_lists[cls];
+    list.push(p);
+    if (list.length == 2 * kBatchSize) {
+      SharedPool::get().release(cls, list.split(kBatchSize));
+    }
+  }
+
+ private:
+  LocalPool() = default;
+
+  // This flag is trivially destructible, hence it outlives the pool.
+  static bool& destroyed() {
+    static thread_local bool flag = false;
+    return flag;
+  }
+
+  std::array<FreeList, kSizeClasses> m_free_lists;
+};
+
+} // namespace pool_impl
+
+struct PooledNodes final {
+  static constexpr bool hash_consed = false;
+
+  static void* allocate(size_t size) {
+    using namespace pool_impl;
+    if (size > kMaxNodeSize) {
+      return ::operator new(size);
+    }
+    auto* local = LocalPool::get();
+    if (local != nullptr) {
+      return local->allocate(size_class(size));
+    }
+    auto list = SharedPool::get().acquire(size_class(size));
+    void* p = list.pop();
+    SharedPool::get().release(size_class(size), list);
+    return p;
+  }
+
+  static void deallocate(void* p, size_t size) {
+    using namespace pool_impl;
+    if (size > kMaxNodeSize) {
+      ::operator delete(p);
+      return;
+    }
+    auto* local = LocalPool::get();
+    if (local != nullptr) {
+      local->deallocate(p, size_class(size));
+      return;
+    }
+    FreeList list;
+    list.push(p);
+    SharedPool::get().release(size_class(size), list);
+  }
+};
+
+template <typename Base = HeapNodes>
+struct HashConsedNodes final {
+  static constexpr bool hash_consed = true;
+
+  static void* allocate(size_t size) { return Base::allocate(size); }
+
+  static void deallocate(void* p, size_t size) { Base::deallocate(p, size); }
+};
+
+/*
+ * The base of all Patricia tree nodes. Nodes are reference-counted
+ * intrusively, which saves the separate control block of a shared pointer and
+ * halves the size of the pointers to the subtrees, and they get their memory
+ * from the allocation policy.
+ */
+template <typename Allocation>
+class PatriciaTreeNode {
+ public:
+  PatriciaTreeNode() = default;
+
+  PatriciaTreeNode(const PatriciaTreeNode&) = delete;
+
+  PatriciaTreeNode& operator=(const PatriciaTreeNode&) = delete;
+
+  virtual ~PatriciaTreeNode() = default;
+
+  using allocation = Allocation;
+
+  static void* operator new(size_t size) { return Allocation::allocate(size); }
+
+  // Since the destructor is virtual, this receives the size of the most
+  // derived node type.
+  static void operator delete(void* p, size_t size) {
+    Allocation::deallocate(p, size);
+  }
+
+  friend void intrusive_ptr_add_ref(const PatriciaTreeNode* node) {
+    node->m_reference_count.fetch_add(1, std::memory_order_relaxed);
+  }
+
+  friend void intrusive_ptr_release(const PatriciaTreeNode* node) {
+    if (node->m_reference_count.fetch_sub(1, std::memory_order_acq_rel) == 1) {
+      if (Allocation::hash_consed) {
+        node->unintern();
+      }
+      delete node;
+    }
+  }
+
+  // Takes a reference to the node, unless it is already being destroyed.
+  bool retain_if_alive() const {
+    auto count = m_reference_count.load(std::memory_order_relaxed);
+    while (count != 0) {
+      if (m_reference_count.compare_exchange_weak(
+              count, count + 1, std::memory_order_relaxed)) {
+        return true;
+      }
+    }
+    return false;
+  }
+
+ protected:
+  // Removes a dead hash-consed node from the table of its type.
+  virtual void unintern() const {}
+
+ private:
+  mutable std::atomic<uint32_t> m_reference_count{0};
+};
+
+namespace hash_cons_impl {
+
+constexpr size_t kShards = 64;
+
+/*
+ * The live hash-consed nodes of type Node. Node must provide
+ *
+ *   size_t hash_cons_hash() const;
+ *   bool hash_cons_equals(const Node& other) const;
+ *
+ * Since the children of a hash-consed branch are hash-consed themselves, these
+ * can compare the children by address.
+ */
+template <typename Node>
+class Table final {
+ public:
+  // Never destroyed, for the same reason as the shared pool of PooledNodes.
+  static Table& get() {
+    static auto* table = new Table();
+    return *table;
+  }
+
+  // Returns the live node that is structurally equal to the given one, which
+  // is then discarded, or the given node after adding it to the table.
+  boost::intrusive_ptr<Node> intern(Node* node) {
+    size_t hash = node->hash_cons_hash();
+    auto& shard = m_shards[hash % kShards];
+    const Node* existing = nullptr;
+    {
+      std::lock_guard<std::mutex> lock(shard.mutex);
+      auto range = shard.nodes.equal_range(hash);
+      for (auto it = range.first; it != range.second; ++it) {
+        // A node whose reference count dropped to zero is about to leave the
+        // table; we must not resurrect it.
+        if (it->second->hash_cons_equals(*node) &&
+            it->second->retain_if_alive()) {
+          existing = it->second;
+          break;
+        }
+      }
+      if (existing == nullptr) {
+        // The node must not look dead to the other threads once it's in the
+        // table.
+        intrusive_ptr_add_ref(node);
+        shard.nodes.emplace(hash, node);
+      }
+    }
+    if (existing != nullptr) {
+      delete node;
+      return boost::intrusive_ptr<Node>(const_cast<Node*>(existing),
+                                        /* add_ref */ false);
+    }
+    return boost::intrusive_ptr<Node>(node, /* add_ref */ false);
+  }
+
+  void erase(const Node* node) {
+    size_t hash = node->hash_cons_hash();
+    auto& shard = m_shards[hash % kShards];
+    std::lock_guard<std::mutex> lock(shard.mutex);
+    auto range = shard.nodes.equal_range(hash);
+    for (auto it = range.first; it != range.second; ++it) {
+      if (it->second == node) {
+        shard.nodes.erase(it);
+        return;
+      }
+    }
+  }
+
+ private:
+  Table() = default;
+
+  struct Shard {
+    std::mutex mutex;
+    std::unordered_multimap<size_t, const Node*> nodes;
+  };
+
+  std::array<Shard, kShards> m_shards;
+};
+
+template <typename Node, typename Allocation>
+inline boost::intrusive_ptr<Node> intern(Node* node, Allocation) {
+  return boost::intrusive_ptr<Node>(node);
+}
+
+template <typename Node, typename Base>
+inline boost::intrusive_ptr<Node> intern(Node* node, HashConsedNodes<Base>) {
+  return Table<Node>::get().intern(node);
+}
+
+template <typename Node, typename Allocation>
+inline void unintern(const Node*, Allocation) {}
+
+template <typename Node, typename Base>
+inline void unintern(const Node* node, HashConsedNodes<Base>) {
+  Table<Node>::get().erase(node);
+}
+
+} // namespace hash_cons_impl
+
+template <typename Node, typename... Args>
+inline boost::intrusive_ptr<Node> make_node(Args&&... args) {
+  return hash_cons_impl::intern(new Node(std::forward<Args>(args)...),
+                                typename Node::allocation());
+}
+
 } // namespace pt_util
 
 } // namespace sparta
@@ -12,12 +12,16 @@
 #include <boost/optional/optional.hpp>
 #include <chrono>
 #include <condition_variable>
+#include <cstdint>
+#include <deque>
+#include <memory>
 #include <mutex>
 #include <numeric>
 #include <queue>
 #include <random>
 #include <thread>
 #include <utility>
+#include <vector>
 
 #include "Arity.h"
 
@@ -89,9 +93,133 @@ class Semaphore {
   size_t m_count;
 };
 
+/**
+ * A Chase-Lev work-stealing deque of trivially copyable values (in practice,
+ * pointers), following "Correct and Efficient Work-Stealing for Weak Memory
+ * Models" (Le et al., PPoPP'13).
+ *
+ * Only the owning thread may call push() and pop(), which operate on the
+ * bottom end in LIFO order. Any thread may call steal(), which takes from the
+ * top end in FIFO order. Arrays that become too small are replaced by a new
+ * array twice the size; the old ones are retired and only freed when the
+ * deque is destroyed, as concurrent thieves may still be reading them.
+ */
+template <typename T>
+class ChaseLevDeque {
+ public:
+  explicit ChaseLevDeque(size_t log_initial_size = 6)
+      : m_array(new Array(log_initial_size)) {
+    m_arrays.emplace_back(m_array.load(std::memory_order_relaxed));
+  }
+
+  ChaseLevDeque(const ChaseLevDeque&) = delete;
+  ChaseLevDeque& operator=(const ChaseLevDeque&) = delete;
+
+  void push(T value) {
+    int64_t b = m_bottom.load(std::memory_order_relaxed);
+    int64_t t = m_top.load(std::memory_order_acquire);
+    Array* a = m_array.load(std::memory_order_relaxed);
+    if (b - t > static_cast<int64_t>(a->size()) - 1) {
+      a = grow(a, t, b);
+    }
+    a->put(b, value);
+    std::atomic_thread_fence(std::memory_order_release);
+    m_bottom.store(b + 1, std::memory_order_relaxed);
+  }
+
+  bool pop(T* out) {
+    int64_t b = m_bottom.load(std::memory_order_relaxed) - 1;
+    Array* a = m_array.load(std::memory_order_relaxed);
+    m_bottom.store(b, std::memory_order_relaxed);
+    std::atomic_thread_fence(std::memory_order_seq_cst);
+    int64_t t = m_top.load(std::memory_order_relaxed);
+    if (t > b) {
+      // Empty.
+      m_bottom.store(b + 1, std::memory_order_relaxed);
+      return false;
+    }
+    *out = a->get(b);
+    if (t != b) {
+      return true;
+    }
+    // Last element: race against thieves.
+    bool won = m_top.compare_exchange_strong(
+        t, t + 1, std::memory_order_seq_cst, std::memory_order_relaxed);
+    m_bottom.store(b + 1, std::memory_order_relaxed);
+    return won;
+  }
+
+  bool steal(T* out) {
+    int64_t t = m_top.load(std::memory_order_acquire);
+    std::atomic_thread_fence(std::memory_order_seq_cst);
+    int64_t b = m_bottom.load(std::memory_order_acquire);
+    if (t >= b) {
+      return false;
+    }
+    Array* a = m_array.load(std::memory_order_acquire);
+    T value = a->get(t);
+    if (!m_top.compare_exchange_strong(
+            t, t + 1, std::memory_order_seq_cst, std::memory_order_relaxed)) {
+      // Lost the race against the owner or another thief.
+      return false;
+    }
+    *out = value;
+    return true;
+  }
+
+  bool empty() const {
+    return m_bottom.load(std::memory_order_relaxed) <=
+           m_top.load(std::memory_order_relaxed);
+  }
+
+ private:
+  class Array {
+   public:
+    explicit Array(size_t log_size)
+        : m_mask((size_t(1) << log_size) - 1),
+          m_buffer(new std::atomic<T>[size_t(1) << log_size]) {}
+
+    size_t size() const { return m_mask + 1; }
+
+    T get(int64_t i) const {
+      return m_buffer[i & m_mask].load(std::memory_order_relaxed);
+    }
+
+    void put(int64_t i, T value) {
+      m_buffer[i & m_mask].store(value, std::memory_order_relaxed);
+    }
+
+   private:
+    const size_t m_mask;
+    std::unique_ptr<std::atomic<T>[]> m_buffer;
+  };
+
+  Array* grow(Array* a, int64_t t, int64_t b) {
+    size_t log_size = 0;
+    while ((size_t(1) << log_size) < a->size() * 2) {
+      ++log_size;
+    }
+    auto* bigger = new Array(log_size);
+    for (int64_t i = t; i < b; ++i) {
+      bigger->put(i, a->get(i));
+    }
+    m_arrays.emplace_back(bigger);
+    m_array.store(bigger, std::memory_order_release);
+    return bigger;
+  }
+
+  std::atomic<int64_t> m_top{0};
+  std::atomic<int64_t> m_bottom{0};
+  std::atomic<Array*> m_array;
+  // Owned by the pushing thread; keeps retired arrays alive for thieves.
+  std::vector<std::unique_ptr<Array>> m_arrays;
+};
+
 struct StateCounters {
   std::atomic_uint num_non_empty;
   std::atomic_uint num_running;
+  // Only used in work-stealing mode: number of tasks sitting in any deque.
+  std::atomic_size_t num_pending;
   const unsigned int num_all;
   // Mutexes aren't move-able.
   std::unique_ptr<Semaphore> waiter;
@@ -99,15 +227,62 @@ struct StateCounters {
   explicit StateCounters(unsigned int num)
       : num_non_empty(0),
         num_running(0),
+        num_pending(0),
         num_all(num),
         waiter(new Semaphore(0)) {}
   StateCounters(StateCounters&& other)
       : num_non_empty(other.num_non_empty.load()),
         num_running(other.num_running.load()),
+        num_pending(other.num_pending.load()),
         num_all(other.num_all),
         waiter(std::move(other.waiter)) {}
 };
 
+/**
+ * Totals over all the work queues of the process, so that a caller can tell
+ * how a phase used its threads by diffing two snapshots. The workers only
+ * update them once when they are done, and only read the clock when they
+ * stop or wait, so this is cheap enough to always be on.
+ */
+struct Stats {
+  std::atomic<uint64_t> tasks{0};
+  // Tasks that a worker took from the queue of another one.
+  std::atomic<uint64_t> steals{0};
+  // Time the workers spent blocked waiting for tasks, or done while others
+  // still ran, summed across the workers.
+  std::atomic<uint64_t> idle_ns{0};
+};
+
+inline Stats& global_stats() {
+  static Stats stats;
+  return stats;
+}
+
+// What a worker tracks over a run, before adding it to the global stats.
+struct WorkerStats {
+  uint64_t tasks{0};
+  uint64_t steals{0};
+  std::chrono::steady_clock::duration waiting{0};
+  std::chrono::steady_clock::time_point done;
+};
+
+inline void add_to_global_stats(const std::vector<WorkerStats>& workers) {
+  auto end = std::chrono::steady_clock::now();
+  uint64_t tasks = 0;
+  uint64_t steals = 0;
+  std::chrono::steady_clock::duration idle{0};
+  for (const auto& worker : workers) {
+    tasks += worker.tasks;
+    steals += worker.steals;
+    idle += worker.waiting + (end - worker.done);
+  }
+  auto& stats = global_stats();
+  stats.tasks += tasks;
+  stats.steals += steals;
+  stats.idle_ns +=
+      std::chrono::duration_cast<std::chrono::nanoseconds>(idle).count();
+}
+
 } // namespace workqueue_impl
 
 template <class Input, typename Executor>
@@ -116,8 +291,14 @@ class SpartaWorkQueue;
 template <class Input>
 class SpartaWorkerState final {
  public:
-  SpartaWorkerState(size_t id, workqueue_impl::StateCounters* sc, bool can_push)
-      : m_id(id), m_state_counters(sc), m_can_push_task(can_push) {}
+  SpartaWorkerState(size_t id,
+                    workqueue_impl::StateCounters* sc,
+                    bool can_push,
+                    bool work_stealing = false)
+      : m_id(id),
+        m_state_counters(sc),
+        m_can_push_task(can_push),
+        m_work_stealing(work_stealing) {}
 
   /*
    * Add more items to the queue of the currently-running worker. When a
@@ -126,6 +307,13 @@ class SpartaWorkerState final {
    */
   void push_task(Input task) {
     assert(m_can_push_task);
+    if (m_work_stealing) {
+      push_stealable(std::move(task));
+      if (m_state_counters->num_running < m_state_counters->num_all) {
+        m_state_counters->waiter->give(1u); // May consider waking all.
+      }
+      return;
+    }
     std::lock_guard<std::mutex> guard(m_queue_mtx);
     if (m_queue.empty()) {
       ++m_state_counters->num_non_empty;
@@ -164,12 +352,35 @@ class SpartaWorkerState final {
     return boost::none;
   }
 
+  // Work-stealing mode. The storage is only ever appended to by the owning
+  // thread (or before the queue runs); std::deque never relocates existing
+  // elements on push_back, so the pointers handed out via m_deque stay valid
+  // while other threads consume them.
+  void push_stealable(Input task) {
+    m_storage.push_back(std::move(task));
+    ++m_state_counters->num_pending;
+    m_deque.push(&m_storage.back());
+  }
+
+  Input* pop_own() {
+    Input* task;
+    return m_deque.pop(&task) ? task : nullptr;
+  }
+
+  Input* steal() {
+    Input* task;
+    return m_deque.steal(&task) ? task : nullptr;
+  }
+
   size_t m_id;
   bool m_running{false};
   std::queue<Input> m_queue;
   std::mutex m_queue_mtx;
   workqueue_impl::StateCounters* m_state_counters;
   const bool m_can_push_task{false};
+  const bool m_work_stealing{false};
+  std::deque<Input> m_storage;
+  workqueue_impl::ChaseLevDeque<Input*> m_deque;
 
   template <class, typename>
   friend class SpartaWorkQueue;
@@ -186,11 +397,14 @@ class SpartaWorkQueue {
   size_t m_insert_idx{0};
   workqueue_impl::StateCounters m_state_counters;
   const bool m_can_push_task{false};
+  const bool m_work_stealing{false};
 
   void consume(SpartaWorkerState<Input>* state, Input task) {
     m_executor(state, task);
   }
 
+  void run_all_work_stealing();
+
  public:
   SpartaWorkQueue(Executor,
                   unsigned int num_threads = parallel::default_num_threads(),
@@ -201,7 +415,14 @@ class SpartaWorkQueue {
                   // * When this flag is false, threads can
                   //   exit as soon as there is no more work (to avoid
                   //   preempting a thread that has useful work)
-                  bool push_tasks_while_running = false);
+                  bool push_tasks_while_running = false,
+                  // work_stealing:
+                  // * When this flag is true, every worker owns a Chase-Lev
+                  //   deque. It pops its own tasks in LIFO order, and once
+                  //   empty steals the oldest task of randomly chosen
+                  //   victims until no task is left anywhere. This keeps
+                  //   all threads busy when a few tasks dominate the cost.
+                  bool work_stealing = false);
 
   // copies are not allowed
   SpartaWorkQueue(const SpartaWorkQueue&) = delete;
@@ -222,15 +443,17 @@ class SpartaWorkQueue {
 template <class Input, typename Executor>
 SpartaWorkQueue<Input, Executor>::SpartaWorkQueue(Executor executor,
                                                   unsigned int num_threads,
-                                                  bool push_tasks_while_running)
+                                                  bool push_tasks_while_running,
+                                                  bool work_stealing)
     : m_executor(executor),
       m_num_threads(num_threads),
       m_state_counters(num_threads),
-      m_can_push_task(push_tasks_while_running) {
+      m_can_push_task(push_tasks_while_running),
+      m_work_stealing(work_stealing) {
   assert(num_threads >= 1);
   for (unsigned int i = 0; i < m_num_threads; ++i) {
     m_states.emplace_back(std::make_unique<SpartaWorkerState<Input>>(
-        i, &m_state_counters, m_can_push_task));
+        i, &m_state_counters, m_can_push_task, m_work_stealing));
   }
 }
 
@@ -238,6 +461,10 @@ template <class Input, typename Executor>
 void SpartaWorkQueue<Input, Executor>::add_item(Input task) {
   m_insert_idx = (m_insert_idx + 1) % m_num_threads;
   assert(m_insert_idx < m_states.size());
+  if (m_work_stealing) {
+    m_states[m_insert_idx]->push_stealable(std::move(task));
+    return;
+  }
   m_states[m_insert_idx]->m_queue.push(task);
 }
 
@@ -247,11 +474,17 @@ void SpartaWorkQueue<Input, Executor>::add_item(Input task) {
  */
 template <class Input, typename Executor>
 void SpartaWorkQueue<Input, Executor>::run_all() {
+  if (m_work_stealing) {
+    run_all_work_stealing();
+    return;
+  }
   std::vector<std::thread> all_threads;
   m_state_counters.num_non_empty = 0;
   m_state_counters.num_running = 0;
   m_state_counters.waiter->take_all();
+  std::vector<workqueue_impl::WorkerStats> worker_stats(m_num_threads);
   auto worker = [&](SpartaWorkerState<Input>* state, size_t state_idx) {
+    auto& stats = worker_stats[state_idx];
     auto attempts =
         workqueue_impl::create_permutation(m_num_threads, state_idx);
     while (true) {
@@ -261,6 +494,8 @@ void SpartaWorkQueue<Input, Executor>::run_all() {
         auto task = other_state->pop_task(state);
         if (task) {
           have_task = true;
+          ++stats.tasks;
+          stats.steals += idx != state_idx;
           consume(state, *task);
           break;
         }
@@ -273,6 +508,7 @@ void SpartaWorkQueue<Input, Executor>::run_all() {
       if (!m_can_push_task) {
         // New tasks can't be added. We don't need to wait for the currently
         // running jobs to finish.
+        stats.done = std::chrono::steady_clock::now();
         return;
       }
 
@@ -282,10 +518,13 @@ void SpartaWorkQueue<Input, Executor>::run_all() {
           m_state_counters.num_non_empty == 0) {
         // Wake up everyone who might be waiting, so they can quit.
         m_state_counters.waiter->give(m_state_counters.num_all);
+        stats.done = std::chrono::steady_clock::now();
         return;
       }
 
+      auto wait_start = std::chrono::steady_clock::now();
       m_state_counters.waiter->take(); // Wait for work.
+      stats.waiting += std::chrono::steady_clock::now() - wait_start;
     }
   };
 
@@ -301,12 +540,101 @@ void SpartaWorkQueue<Input, Executor>::run_all() {
   for (auto& thread : all_threads) {
     thread.join();
   }
+  workqueue_impl::add_to_global_stats(worker_stats);
 
   for (size_t i = 0; i < m_num_threads; ++i) {
     assert(m_states[i]->m_queue.empty());
   }
 }
 
+/*
+ * Each worker thread pops from the bottom of its own deque first. Once that
+ * is empty, it keeps picking a random victim and steals from the top of its
+ * deque for as long as any task is pending. A worker counts as running while
+ * it is looking for work, so that the last running worker can tell that no
+ * more tasks can ever show up.
+ */
+template <class Input, typename Executor>
+void SpartaWorkQueue<Input, Executor>::run_all_work_stealing() {
+  std::vector<std::thread> all_threads;
+  m_state_counters.num_running = 0;
+  m_state_counters.waiter->take_all();
+  auto seed = std::chrono::system_clock::now().time_since_epoch().count();
+  std::vector<workqueue_impl::WorkerStats> worker_stats(m_num_threads);
+  auto find_task = [&](SpartaWorkerState<Input>* state,
+                       std::minstd_rand& rng,
+                       workqueue_impl::WorkerStats& stats) -> Input* {
+    if (auto task = state->pop_own()) {
+      return task;
+    }
+    std::uniform_int_distribution<size_t> pick(0, m_num_threads - 1);
+    while (m_state_counters.num_pending > 0) {
+      // A few random attempts before checking our own deque again, which
+      // may have been filled up by a task we are running.
+      for (size_t i = 0; i < m_num_threads; ++i) {
+        auto victim = m_states[pick(rng)].get();
+        if (victim == state) {
+          if (auto task = state->pop_own()) {
+            return task;
+          }
+        } else if (auto task = victim->steal()) {
+          ++stats.steals;
+          return task;
+        }
+      }
+      std::this_thread::yield();
+    }
+    return nullptr;
+  };
+  auto worker = [&](SpartaWorkerState<Input>* state, size_t state_idx) {
+    auto& stats = worker_stats[state_idx];
+    std::minstd_rand rng(static_cast<std::minstd_rand::result_type>(
+        seed + state_idx * 7919));
+    while (true) {
+      state->set_running(true);
+      if (auto task = find_task(state, rng, stats)) {
+        --m_state_counters.num_pending;
+        ++stats.tasks;
+        consume(state, std::move(*task));
+        continue;
+      }
+
+      state->set_running(false);
+      if (!m_can_push_task) {
+        stats.done = std::chrono::steady_clock::now();
+        return;
+      }
+
+      if (m_state_counters.num_running == 0 &&
+          m_state_counters.num_pending == 0) {
+        // Wake up everyone who might be waiting, so they can quit.
+        m_state_counters.waiter->give(m_state_counters.num_all);
+        stats.done = std::chrono::steady_clock::now();
+        return;
+      }
+
+      auto wait_start = std::chrono::steady_clock::now();
+      m_state_counters.waiter->take(); // Wait for work.
+      stats.waiting += std::chrono::steady_clock::now() - wait_start;
+    }
+  };
+
+  for (size_t i = 0; i < m_num_threads; ++i) {
+    all_threads.emplace_back(std::bind<void>(worker, m_states[i].get(), i));
+  }
+
+  for (auto& thread : all_threads) {
+    thread.join();
+  }
+  workqueue_impl::add_to_global_stats(worker_stats);
+
+  assert(m_state_counters.num_pending == 0);
+  for (size_t i = 0; i < m_num_threads; ++i) {
+    assert(m_states[i]->m_deque.empty());
+    m_states[i]->m_storage.clear();
+  }
+}
+
 namespace workqueue_impl {
 // Helper classes so the type of Executor can be inferred
 template <typename Input, typename Fn>
@@ -328,12 +656,14 @@ template <class Input,
 SpartaWorkQueue<Input, workqueue_impl::NoStateWorkQueueHelper<Input, Fn>>
 work_queue(const Fn& fn,
            unsigned int num_threads = parallel::default_num_threads(),
-           bool push_tasks_while_running = false) {
+           bool push_tasks_while_running = false,
+           bool work_stealing = false) {
   return SpartaWorkQueue<Input,
                          workqueue_impl::NoStateWorkQueueHelper<Input, Fn>>(
       workqueue_impl::NoStateWorkQueueHelper<Input, Fn>{fn},
       num_threads,
-      push_tasks_while_running);
+      push_tasks_while_running,
+      work_stealing);
 }
 template <class Input,
           typename Fn,
@@ -341,12 +671,14 @@ template <class Input,
 SpartaWorkQueue<Input, workqueue_impl::WithStateWorkQueueHelper<Input, Fn>>
 work_queue(const Fn& fn,
            unsigned int num_threads = parallel::default_num_threads(),
-           bool push_tasks_while_running = false) {
+           bool push_tasks_while_running = false,
+           bool work_stealing = false) {
   return SpartaWorkQueue<Input,
                          workqueue_impl::WithStateWorkQueueHelper<Input, Fn>>(
       workqueue_impl::WithStateWorkQueueHelper<Input, Fn>{fn},
       num_threads,
-      push_tasks_while_running);
+      push_tasks_while_running,
+      work_stealing);
 }
 
 } // namespace sparta
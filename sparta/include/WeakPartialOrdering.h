@@ -198,7 +198,7 @@ class WeakPartialOrdering final {
   uint32_t size() const { return m_nodes.size(); }
 
   // Entry node of this wpo.
-  WpoIdx get_entry() { return m_nodes.size() - 1; }
+  WpoIdx get_entry() const { return m_nodes.size() - 1; }
 
   // Successors of the node.
   const std::set<WpoIdx>& get_successors(WpoIdx idx) const {
@@ -240,7 +240,7 @@ class WeakPartialOrdering final {
   //   is_backedge(head, pred)
   //     := !is_from_outside(head, pred) /\ is_predecessor(head, pred)
   // This is used in interleaved widening and narrowing.
-  bool is_from_outside(NodeId head, NodeId pred) {
+  bool is_from_outside(NodeId head, NodeId pred) const {
     return get_post_dfn(head) < get_post_dfn(pred);
   }
 
@@ -0,0 +1,214 @@
+/*
+ * Copyright (c) Facebook, Inc. and its affiliates.
+ *
+ * This source code is licensed under the MIT license found in the
+ * LICENSE file in the root directory of this source tree.
+ */
+
+#include "BitVectorSetAbstractDomain.h"
+
+#include <algorithm>
+#include <chrono>
+#include <cstdint>
+#include <cstdio>
+#include <gmock/gmock.h>
+#include <gtest/gtest.h>
+#include <random>
+#include <sstream>
+#include <vector>
+
+#include "AbstractDomainPropertyTest.h"
+#include "PatriciaTreeSetAbstractDomain.h"
+
+using namespace sparta;
+
+using Domain = BitVectorSetAbstractDomain<uint32_t>;
+using TreeDomain = PatriciaTreeSetAbstractDomain<uint32_t>;
+
+INSTANTIATE_TYPED_TEST_CASE_P(BitVectorSetAbstractDomain,
+                              AbstractDomainPropertyTest,
+                              Domain);
+
+template <>
+std::vector<Domain> AbstractDomainPropertyTest<Domain>::non_extremal_values() {
+  Domain e1(1);
+  Domain e2({1, 2, 300});
+  Domain e3({2, 300, 1000});
+  return {e1, e2, e3};
+}
+
+namespace {
+
+std::vector<uint32_t> to_vector(const BitVectorSet<uint32_t>& s) {
+  return std::vector<uint32_t>(s.begin(), s.end());
+}
+
+std::vector<uint32_t> to_sorted_vector(const PatriciaTreeSet<uint32_t>& s) {
+  std::vector<uint32_t> result(s.begin(), s.end());
+  std::sort(result.begin(), result.end());
+  return result;
+}
+
+// Builds the same random set in both representations.
+void random_sets(std::mt19937* rng,
+                 uint32_t universe,
+                 BitVectorSet<uint32_t>* bits,
+                 PatriciaTreeSet<uint32_t>* tree) {
+  size_t size = (*rng)() % (universe / 2 + 1);
+  for (size_t i = 0; i < size; ++i) {
+    uint32_t x = (*rng)() % universe;
+    bits->insert(x);
+    tree->insert(x);
+  }
+}
+
+template <typename F>
+double time_in_ms(const F& f) {
+  auto start = std::chrono::steady_clock::now();
+  f();
+  auto end = std::chrono::steady_clock::now();
+  return std::chrono::duration<double, std::milli>(end - start).count();
+}
+
+// Mimics the liveness analysis of a loop body: each block kills a few
+// registers and uses a few others, and the live sets are joined at branches.
+template <typename D>
+size_t run_liveness_workload(uint32_t registers, size_t rounds) {
+  std::mt19937 rng(registers);
+  D live;
+  size_t checksum = 0;
+  for (size_t i = 0; i < rounds; ++i) {
+    D other = live;
+    for (size_t j = 0; j < 4; ++j) {
+      live.remove(rng() % registers);
+      live.add(rng() % registers);
+      other.add(rng() % registers);
+    }
+    live.join_with(other);
+    checksum += other.leq(live) + live.size();
+  }
+  return checksum;
+}
+
+} // namespace
+
+TEST(BitVectorSetAbstractDomainTest, latticeOperations) {
+  Domain e1(1);
+  Domain e2({1, 2, 300});
+  Domain e3({2, 300, 1000});
+
+  EXPECT_THAT(to_vector(e1.elements()), ::testing::ElementsAre(1));
+  EXPECT_THAT(to_vector(e2.elements()), ::testing::ElementsAre(1, 2, 300));
+  EXPECT_THAT(to_vector(e3.elements()), ::testing::ElementsAre(2, 300, 1000));
+
+  std::ostringstream out;
+  out << e2;
+  EXPECT_EQ("[#3]{1, 2, 300}", out.str());
+
+  EXPECT_TRUE(e1.leq(e2));
+  EXPECT_FALSE(e1.leq(e3));
+  EXPECT_FALSE(e3.leq(e2));
+  EXPECT_TRUE(e2.equals(Domain({300, 2, 1})));
+  EXPECT_FALSE(e2.equals(e3));
+
+  EXPECT_THAT(to_vector(e2.join(e3).elements()),
+              ::testing::ElementsAre(1, 2, 300, 1000));
+  EXPECT_TRUE(e1.join(e2).equals(e2));
+  EXPECT_TRUE(e2.join(Domain::top()).is_top());
+
+  EXPECT_THAT(to_vector(e2.meet(e3).elements()),
+              ::testing::ElementsAre(2, 300));
+  EXPECT_TRUE(e1.meet(e2).equals(e1));
+  EXPECT_TRUE(e1.meet(e3).elements().empty());
+
+  // Removing the largest element trims the vector, so that equality still
+  // holds.
+  Domain e4({1, 2, 300, 1000});
+  e4.remove(1000);
+  EXPECT_TRUE(e4.equals(e2));
+  EXPECT_TRUE(e4.leq(e2));
+  EXPECT_TRUE(e2.leq(e4));
+}
+
+TEST(BitVectorSetAbstractDomainTest, differenceUnion) {
+  Domain live({1, 5, 70, 400});
+  BitVectorSet<uint32_t> kill({5, 70, 1000});
+  BitVectorSet<uint32_t> gen({2, 70});
+  live.difference_union_with(kill, gen);
+  EXPECT_THAT(to_vector(live.elements()),
+              ::testing::ElementsAre(1, 2, 70, 400));
+
+  live.difference_union_with(BitVectorSet<uint32_t>({400}),
+                             BitVectorSet<uint32_t>());
+  EXPECT_TRUE(live.equals(Domain({1, 2, 70})));
+
+  auto top = Domain::top();
+  top.difference_union_with(kill, gen);
+  EXPECT_TRUE(top.is_top());
+  auto bottom = Domain::bottom();
+  bottom.difference_union_with(kill, gen);
+  EXPECT_TRUE(bottom.is_bottom());
+}
+
+TEST(BitVectorSetAbstractDomainTest, behavesLikePatriciaTreeSets) {
+  std::mt19937 rng(42);
+  for (size_t round = 0; round < 2000; ++round) {
+    // Pick universes that are smaller than, equal to, and larger than the
+    // inline capacity and the vector width.
+    uint32_t universe = 1 + rng() % 1200;
+    BitVectorSet<uint32_t> b1, b2, b3;
+    PatriciaTreeSet<uint32_t> t1, t2, t3;
+    random_sets(&rng, universe, &b1, &t1);
+    random_sets(&rng, universe, &b2, &t2);
+    random_sets(&rng, 1 + rng() % 1200, &b3, &t3);
+    ASSERT_EQ(to_sorted_vector(t1), to_vector(b1));
+    EXPECT_EQ(t1.size(), b1.size());
+
+    EXPECT_EQ(t1.is_subset_of(t2), b1.is_subset_of(b2));
+    EXPECT_EQ(t2.is_subset_of(t1), b2.is_subset_of(b1));
+    EXPECT_TRUE(b1.get_intersection_with(b2).is_subset_of(b1));
+    EXPECT_EQ(t1.equals(t2), b1.equals(b2));
+
+    EXPECT_EQ(to_sorted_vector(t1.get_union_with(t2)),
+              to_vector(b1.get_union_with(b2)));
+    EXPECT_EQ(to_sorted_vector(t1.get_intersection_with(t2)),
+              to_vector(b1.get_intersection_with(b2)));
+    EXPECT_EQ(to_sorted_vector(t1.get_difference_with(t2)),
+              to_vector(b1.get_difference_with(b2)));
+    EXPECT_TRUE(b1.get_union_with(b2).get_difference_with(b2).equals(
+        b1.get_difference_with(b2)));
+
+    auto b = b1;
+    b.difference_union_with(b2, b3);
+    auto t = t1.get_difference_with(t2).get_union_with(t3);
+    EXPECT_EQ(to_sorted_vector(t), to_vector(b));
+    EXPECT_TRUE(b.equals(BitVectorSet<uint32_t>(t.begin(), t.end())));
+
+    auto x = rng() % universe;
+    EXPECT_EQ(t1.contains(x), b1.contains(x));
+    b1.remove(x);
+    t1.remove(x);
+    EXPECT_EQ(to_sorted_vector(t1), to_vector(b1));
+  }
+}
+
+// Compares both domains on the live sets of methods of various sizes. The
+// figures are informational.
+TEST(BitVectorSetAbstractDomainTest, benchmark) {
+  constexpr size_t kRounds = 5000;
+  for (uint32_t registers : {16, 64, 256, 1024}) {
+    size_t bits_result = 0;
+    size_t tree_result = 0;
+    double bits_ms = time_in_ms([&] {
+      bits_result = run_liveness_workload<Domain>(registers, kRounds);
+    });
+    double tree_ms = time_in_ms([&] {
+      tree_result = run_liveness_workload<TreeDomain>(registers, kRounds);
+    });
+    EXPECT_EQ(tree_result, bits_result);
+    printf("%u registers: Patricia tree %.1f ms, bit vector %.1f ms\n",
+           registers,
+           tree_ms,
+           bits_ms);
+  }
+}
@@ -0,0 +1,265 @@
+/*
+ * Copyright (c) Facebook, Inc. and its affiliates.
+ *
+ * This source code is licensed under the MIT license found in the
+ * LICENSE file in the root directory of this source tree.
+ */
+
+#include "FlatPatriciaTreeMapAbstractEnvironment.h"
+
+#include <chrono>
+#include <cstdint>
+#include <cstdio>
+#include <map>
+#include <random>
+#include <string>
+#include <vector>
+
+#include <gtest/gtest.h>
+
+#include "ConstantAbstractDomain.h"
+#include "PatriciaTreeMapAbstractEnvironment.h"
+
+using namespace sparta;
+
+namespace {
+
+using Domain = ConstantAbstractDomain<int>;
+using FlatEnvironment =
+    FlatPatriciaTreeMapAbstractEnvironment<uint32_t, Domain>;
+using TreeEnvironment = PatriciaTreeMapAbstractEnvironment<uint32_t, Domain>;
+
+template <typename Environment>
+std::map<uint32_t, Domain> bindings(const Environment& env) {
+  std::map<uint32_t, Domain> result;
+  if (env.is_value()) {
+    for (const auto& binding : env.bindings()) {
+      result.emplace(binding.first, binding.second);
+    }
+  }
+  return result;
+}
+
+// Applies the same random operations to pairs of flat and tree environments.
+class Generator {
+ public:
+  explicit Generator(uint32_t seed) : m_generator(seed) {}
+
+  void random_bindings(size_t max_size,
+                       FlatEnvironment* flat,
+                       TreeEnvironment* tree) {
+    size_t size =
+        std::uniform_int_distribution<size_t>(0, max_size)(m_generator);
+    for (size_t i = 0; i < size; ++i) {
+      auto key = random_key();
+      auto value = random_value();
+      flat->set(key, value);
+      tree->set(key, value);
+    }
+  }
+
+  uint32_t random_key() {
+    // Mostly register-like keys, with a few large ones.
+    if (m_generator() % 8 == 0) {
+      return m_generator();
+    }
+    return m_generator() % 48;
+  }
+
+  Domain random_value() {
+    auto n = m_generator() % 5;
+    return n == 4 ? Domain::top() : Domain(n);
+  }
+
+  std::mt19937 m_generator;
+};
+
+template <typename Environment>
+size_t run_method_workload(size_t registers, size_t rounds) {
+  // Mimics the analysis of a method: each block copies the state at its
+  // entry, updates a few registers, and is joined with a sibling at a merge
+  // point.
+  std::mt19937 rng(registers);
+  Environment entry;
+  for (uint32_t reg = 0; reg < registers; ++reg) {
+    entry.set(reg, Domain(reg % 3));
+  }
+  size_t checksum = 0;
+  for (size_t i = 0; i < rounds; ++i) {
+    auto left = entry;
+    auto right = entry;
+    for (size_t j = 0; j < 4; ++j) {
+      left.set(rng() % registers, Domain(rng() % 3));
+      right.set(rng() % registers, Domain(rng() % 3));
+    }
+    for (size_t j = 0; j < 8; ++j) {
+      checksum += left.get(rng() % registers).is_top();
+    }
+    left.join_with(right);
+    checksum += left.leq(entry);
+    if (i % 16 == 0) {
+      entry = left;
+      for (uint32_t reg = 0; reg < registers; ++reg) {
+        entry.set(reg, Domain(reg % 3));
+      }
+    }
+  }
+  return checksum;
+}
+
+template <typename F>
+double time_in_ms(const F& f) {
+  auto start = std::chrono::steady_clock::now();
+  f();
+  auto end = std::chrono::steady_clock::now();
+  return std::chrono::duration<double, std::milli>(end - start).count();
+}
+
+} // namespace
+
+TEST(FlatPatriciaTreeMapTest, switchesRepresentation) {
+  FlatPatriciaTreeMap<uint32_t, uint32_t> m;
+  for (uint32_t i = 1; i <= 16; ++i) {
+    m.insert_or_assign(i * 3, i);
+  }
+  EXPECT_TRUE(m.is_flat());
+  EXPECT_EQ(16, m.size());
+  EXPECT_EQ(5, m.at(15));
+  EXPECT_EQ(0, m.at(16));
+
+  m.insert_or_assign(1000, 1);
+  EXPECT_FALSE(m.is_flat());
+  EXPECT_EQ(17, m.size());
+  EXPECT_EQ(1, m.at(1000));
+
+  // Removing a single binding does not move them back to the array.
+  m.insert_or_assign(1000, 0);
+  EXPECT_FALSE(m.is_flat());
+
+  FlatPatriciaTreeMap<uint32_t, uint32_t> small;
+  small.insert_or_assign(3, 1);
+  small.insert_or_assign(6, 7);
+  small.insert_or_assign(7, 7);
+  m.intersection_with([](uint32_t x, uint32_t y) { return x + y; }, small);
+  EXPECT_TRUE(m.is_flat());
+  EXPECT_EQ(2, m.size());
+  EXPECT_EQ(2, m.at(3));
+  EXPECT_EQ(9, m.at(6));
+
+  std::vector<uint32_t> keys;
+  for (const auto& binding : m) {
+    keys.push_back(binding.first);
+  }
+  EXPECT_EQ(std::vector<uint32_t>({3, 6}), keys);
+
+  // Copies share their bindings until one of them is written to.
+  auto copy = m;
+  copy.insert_or_assign(3, 100);
+  EXPECT_EQ(2, m.at(3));
+  EXPECT_EQ(100, copy.at(3));
+  EXPECT_FALSE(m.equals(copy));
+}
+
+TEST(FlatPatriciaTreeMapTest, pointerKeys) {
+  std::vector<std::string> strings(40, "s");
+  FlatPatriciaTreeMap<const std::string*, uint32_t> m;
+  std::map<const std::string*, uint32_t> expected;
+  for (size_t i = 0; i < strings.size(); ++i) {
+    m.insert_or_assign(&strings[i], i + 1);
+    expected[&strings[i]] = i + 1;
+    for (size_t j = 0; j <= i; ++j) {
+      EXPECT_EQ(j + 1, m.at(&strings[j]));
+    }
+  }
+  EXPECT_EQ(expected.size(), m.size());
+  m.erase_all_matching(nullptr);
+  EXPECT_EQ(expected.size(), m.size());
+}
+
+TEST(FlatPatriciaTreeMapAbstractEnvironmentTest, behavesLikeTreeEnvironments) {
+  Generator generator(42);
+  for (size_t round = 0; round < 2000; ++round) {
+    FlatEnvironment f1, f2;
+    TreeEnvironment t1, t2;
+    generator.random_bindings(24, &f1, &t1);
+    generator.random_bindings(24, &f2, &t2);
+    ASSERT_EQ(bindings(t1), bindings(f1));
+
+    EXPECT_EQ(t1.leq(t2), f1.leq(f2));
+    EXPECT_EQ(t2.leq(t1), f2.leq(f1));
+    EXPECT_EQ(t1.equals(t2), f1.equals(f2));
+
+    auto fj = f1;
+    auto tj = t1;
+    fj.join_with(f2);
+    tj.join_with(t2);
+    EXPECT_EQ(bindings(tj), bindings(fj));
+    EXPECT_EQ(tj.kind(), fj.kind());
+    EXPECT_TRUE(f1.leq(fj));
+    EXPECT_TRUE(f2.leq(fj));
+
+    auto fm = f1;
+    auto tm = t1;
+    fm.meet_with(f2);
+    tm.meet_with(t2);
+    EXPECT_EQ(bindings(tm), bindings(fm));
+    EXPECT_EQ(tm.kind(), fm.kind());
+
+    auto key = generator.random_key();
+    auto value = generator.random_value();
+    f1.update(key, [&value](const Domain& x) { return x.join(value); });
+    t1.update(key, [&value](const Domain& x) { return x.join(value); });
+    EXPECT_EQ(bindings(t1), bindings(f1));
+
+    f2.erase_all_matching(32);
+    t2.erase_all_matching(32);
+    EXPECT_EQ(bindings(t2), bindings(f2));
+
+    auto to_top = [](const Domain& x) {
+      return x.get_constant() && *x.get_constant() == 0 ? Domain::top() : x;
+    };
+    EXPECT_EQ(t2.map(to_top), f2.map(to_top));
+    EXPECT_EQ(bindings(t2), bindings(f2));
+
+    auto self = f1;
+    self.join_with(self);
+    EXPECT_EQ(f1, self);
+  }
+}
+
+TEST(FlatPatriciaTreeMapAbstractEnvironmentTest, bottomBindings) {
+  FlatEnvironment env({{1, Domain(1)}, {2, Domain(2)}});
+  EXPECT_TRUE(env.is_value());
+  env.set(3, Domain::bottom());
+  EXPECT_TRUE(env.is_bottom());
+
+  FlatEnvironment e1({{1, Domain(1)}});
+  FlatEnvironment e2({{1, Domain(2)}});
+  e1.meet_with(e2);
+  EXPECT_TRUE(e1.is_bottom());
+
+  FlatEnvironment e3({{1, Domain(1)}});
+  e3.update(1, [](const Domain&) { return Domain::bottom(); });
+  EXPECT_TRUE(e3.is_bottom());
+}
+
+// Compares both environments on the register environments of methods of
+// various sizes. The figures are informational.
+TEST(FlatPatriciaTreeMapAbstractEnvironmentTest, benchmark) {
+  constexpr size_t kRounds = 20000;
+  for (size_t registers : {4, 8, 16, 32}) {
+    size_t flat_result = 0;
+    size_t tree_result = 0;
+    double flat_ms = time_in_ms([&] {
+      flat_result = run_method_workload<FlatEnvironment>(registers, kRounds);
+    });
+    double tree_ms = time_in_ms([&] {
+      tree_result = run_method_workload<TreeEnvironment>(registers, kRounds);
+    });
+    EXPECT_EQ(tree_result, flat_result);
+    printf("%zu registers: Patricia tree %.1f ms, flat %.1f ms\n",
+           registers,
+           tree_ms,
+           flat_ms);
+  }
+}
@@ -18,6 +18,7 @@
 #include <boost/functional/hash.hpp>
 
 #include "HashedSetAbstractDomain.h"
+#include "IntervalDomain.h"
 
 using namespace sparta;
 
@@ -147,14 +148,19 @@ class ProgramInterface {
  */
 using LivenessDomain = HashedSetAbstractDomain<std::string>;
 
-class FixpointEngine final
-    : public WTOMonotonicFixpointIterator<
-          BackwardsFixpointIterationAdaptor<ProgramInterface>,
-          LivenessDomain,
-          boost::hash<ControlPoint>> {
+template <template <typename...> class Iterator>
+class LivenessFixpointEngine final
+    : public Iterator<BackwardsFixpointIterationAdaptor<ProgramInterface>,
+                      LivenessDomain,
+                      boost::hash<ControlPoint>> {
  public:
-  explicit FixpointEngine(const Program& program)
-      : WTOMonotonicFixpointIterator(program), m_program(program) {}
+  using Base = Iterator<BackwardsFixpointIterationAdaptor<ProgramInterface>,
+                        LivenessDomain,
+                        boost::hash<ControlPoint>>;
+  using EdgeId = typename Base::EdgeId;
+
+  explicit LivenessFixpointEngine(const Program& program)
+      : Base(program), m_program(program) {}
 
   void analyze_node(const ControlPoint& node,
                     LivenessDomain* current_state) const override {
@@ -175,19 +181,23 @@ class FixpointEngine final
     // Since we performed a backward analysis by reversing the control-flow
     // graph, the set of live variables before executing a node is given by
     // the exit state at the node.
-    return get_exit_state_at(ControlPoint(node));
+    return this->get_exit_state_at(ControlPoint(node));
   }
 
   LivenessDomain get_live_out_vars_at(const std::string& node) {
     // Similarly, the set of live variables after executing a node is given by
     // the entry state at the node.
-    return get_entry_state_at(ControlPoint(node));
+    return this->get_entry_state_at(ControlPoint(node));
   }
 
  private:
   const Program& m_program;
 };
 
+using FixpointEngine = LivenessFixpointEngine<WTOMonotonicFixpointIterator>;
+using WorklistFixpointEngine =
+    LivenessFixpointEngine<WorklistMonotonicFixpointIterator>;
+
 class MonotonicFixpointIteratorTest : public ::testing::Test {
  protected:
   MonotonicFixpointIteratorTest() : m_program1("1"), m_program2("1") {}
@@ -360,3 +370,107 @@ TEST_F(MonotonicFixpointIteratorTest, program2) {
   ASSERT_TRUE(fp.get_live_in_vars_at("7").is_bottom());
   ASSERT_TRUE(fp.get_live_out_vars_at("7").is_bottom());
 }
+
+TEST_F(MonotonicFixpointIteratorTest, worklistIterator) {
+  for (const Program* program : {&this->m_program1, &this->m_program2}) {
+    FixpointEngine fp(*program);
+    fp.run(LivenessDomain());
+    WorklistFixpointEngine worklist_fp(*program);
+    worklist_fp.run(LivenessDomain());
+    for (const char* node : {"1", "2", "3", "4", "5", "6", "7"}) {
+      EXPECT_EQ(fp.get_live_in_vars_at(node),
+                worklist_fp.get_live_in_vars_at(node))
+          << "at node " << node;
+      EXPECT_EQ(fp.get_live_out_vars_at(node),
+                worklist_fp.get_live_out_vars_at(node))
+          << "at node " << node;
+    }
+  }
+}
+
+namespace {
+
+/*
+ * A graph over integers, where the edge i -> j is represented as the pair
+ * (i, j), used to check that the worklist iterator widens around cycles.
+ */
+struct IntegerGraph {
+  std::unordered_map<uint32_t, std::vector<std::pair<uint32_t, uint32_t>>>
+      successors;
+  std::unordered_map<uint32_t, std::vector<std::pair<uint32_t, uint32_t>>>
+      predecessors;
+
+  void add_edge(uint32_t i, uint32_t j) {
+    successors[i].emplace_back(i, j);
+    predecessors[j].emplace_back(i, j);
+  }
+};
+
+struct IntegerGraphInterface {
+  using Graph = IntegerGraph;
+  using NodeId = uint32_t;
+  using EdgeId = std::pair<uint32_t, uint32_t>;
+
+  static NodeId entry(const Graph&) { return 0; }
+  static std::vector<EdgeId> predecessors(const Graph& graph,
+                                          const NodeId& node) {
+    auto it = graph.predecessors.find(node);
+    return it == graph.predecessors.end() ? std::vector<EdgeId>()
+                                          : it->second;
+  }
+  static std::vector<EdgeId> successors(const Graph& graph,
+                                        const NodeId& node) {
+    auto it = graph.successors.find(node);
+    return it == graph.successors.end() ? std::vector<EdgeId>() : it->second;
+  }
+  static NodeId source(const Graph&, const EdgeId& e) { return e.first; }
+  static NodeId target(const Graph&, const EdgeId& e) { return e.second; }
+};
+
+using Interval = IntervalDomain<int32_t>;
+
+/*
+ * Node 0 sets a counter to 0, node 2 increments it and nodes 1 and 3 leave it
+ * unchanged.
+ */
+class CounterAnalysis final
+    : public WorklistMonotonicFixpointIterator<IntegerGraphInterface,
+                                               Interval> {
+ public:
+  explicit CounterAnalysis(const IntegerGraph& graph)
+      : WorklistMonotonicFixpointIterator(graph) {}
+
+  void analyze_node(const uint32_t& node,
+                    Interval* current_state) const override {
+    if (node == 0) {
+      *current_state = Interval::finite(0, 0);
+    } else if (node == 2) {
+      *current_state += 1;
+    }
+  }
+
+  Interval analyze_edge(const EdgeId&,
+                        const Interval& exit_state_at_source) const override {
+    return exit_state_at_source;
+  }
+};
+
+} // namespace
+
+TEST(WorklistMonotonicFixpointIteratorTest, widensAroundCycles) {
+  //  0 -> 1 -> 3
+  //       ^    |
+  //       |    v
+  //       +--- 2
+  IntegerGraph graph;
+  graph.add_edge(0, 1);
+  graph.add_edge(1, 3);
+  graph.add_edge(3, 2);
+  graph.add_edge(2, 1);
+  CounterAnalysis fp(graph);
+  fp.run(Interval::top());
+  EXPECT_EQ(Interval::finite(0, 0), fp.get_exit_state_at(0));
+  EXPECT_EQ(Interval::bounded_below(0), fp.get_entry_state_at(1));
+  EXPECT_EQ(Interval::bounded_below(0), fp.get_exit_state_at(3));
+  EXPECT_EQ(Interval::bounded_below(1), fp.get_exit_state_at(2));
+}
@@ -7,6 +7,7 @@
 
 #include "MonotonicFixpointIterator.h"
 
+#include <atomic>
 #include <functional>
 #include <gmock/gmock.h>
 #include <gtest/gtest.h>
@@ -128,6 +129,7 @@ class FixpointEngine final
 
   void analyze_node(const uint32_t& node,
                     LivenessDomain* current_state) const override {
+    ++m_analyzed_nodes;
     const Statement& stmt = m_program.statement_at(node);
     // This is the standard semantic definition of liveness.
     current_state->remove(stmt.def.begin(), stmt.def.end());
@@ -154,8 +156,11 @@ class FixpointEngine final
     return get_entry_state_at(node);
   }
 
+  size_t analyzed_nodes() const { return m_analyzed_nodes; }
+
  private:
   const Program& m_program;
+  mutable std::atomic<size_t> m_analyzed_nodes{0};
 };
 
 class ParallelFixpointIteratorTest : public ::testing::Test {
@@ -431,3 +436,29 @@ TEST_F(ParallelFixpointIteratorTest, program3) {
   EXPECT_THAT(fp.get_live_out_vars_at(8).elements(),
               ::testing::UnorderedElementsAre("z", "c", "b", "y"));
 }
+
+TEST_F(ParallelFixpointIteratorTest, incrementalRun) {
+  FixpointEngine fp(this->m_program1);
+  fp.run(LivenessDomain());
+  size_t analyzed_nodes = fp.analyzed_nodes();
+
+  // Nothing has changed, hence nothing is analyzed again.
+  fp.run_incrementally(LivenessDomain(), {});
+  EXPECT_EQ(analyzed_nodes, fp.analyzed_nodes());
+  EXPECT_THAT(fp.get_live_in_vars_at(1).elements(),
+              ::testing::UnorderedElementsAre("c"));
+
+  // 3: c = b;
+  this->m_program1.add(3, Statement(/* use: */ {"b"}, /* def: */ {"c"}));
+  fp.run_incrementally(LivenessDomain(), {3});
+  EXPECT_GT(fp.analyzed_nodes(), analyzed_nodes);
+  FixpointEngine expected(this->m_program1);
+  expected.run(LivenessDomain());
+  for (uint32_t node = 1; node <= 6; ++node) {
+    EXPECT_EQ(expected.get_live_in_vars_at(node),
+              fp.get_live_in_vars_at(node));
+    EXPECT_EQ(expected.get_live_out_vars_at(node),
+              fp.get_live_out_vars_at(node));
+  }
+  EXPECT_TRUE(fp.get_live_in_vars_at(1).elements().empty());
+}
@@ -0,0 +1,132 @@
+/*
+ * Copyright (c) Facebook, Inc. and its affiliates.
+ *
+ * This source code is licensed under the MIT license found in the
+ * LICENSE file in the root directory of this source tree.
+ */
+
+#include <cstdint>
+#include <thread>
+#include <vector>
+
+#include <gtest/gtest.h>
+
+#include "ConstantAbstractDomain.h"
+#include "PatriciaTreeMap.h"
+#include "PatriciaTreeMapAbstractEnvironment.h"
+#include "PatriciaTreeSet.h"
+
+using namespace sparta;
+
+namespace {
+
+using HashConsedSet =
+    PatriciaTreeSet<uint32_t, pt_util::HashConsedNodes<pt_util::PooledNodes>>;
+
+struct HashedValue : ptmap_impl::SimpleValue<uint32_t> {
+  static size_t hash(uint32_t x) { return x; }
+};
+
+using HashConsedMap = PatriciaTreeMap<uint32_t,
+                                      uint32_t,
+                                      HashedValue,
+                                      pt_util::HashConsedNodes<>>;
+
+using Domain = ConstantAbstractDomain<int>;
+using Environment = PatriciaTreeMapAbstractEnvironment<uint32_t, Domain>;
+
+} // namespace
+
+TEST(PatriciaTreeHashConsingTest, equalSetsShareTheirTree) {
+  HashConsedSet s1;
+  HashConsedSet s2;
+  for (uint32_t i = 0; i < 1000; ++i) {
+    s1.insert(i);
+  }
+  for (uint32_t i = 1000; i > 0; --i) {
+    s2.insert(i - 1);
+  }
+  EXPECT_TRUE(s1.reference_equals(s2));
+  EXPECT_TRUE(s1.equals(s2));
+
+  s2.remove(500);
+  EXPECT_FALSE(s1.equals(s2));
+  s2.insert(500);
+  EXPECT_TRUE(s1.reference_equals(s2));
+
+  HashConsedSet evens;
+  HashConsedSet odds;
+  for (uint32_t i = 0; i < 1000; ++i) {
+    (i % 2 == 0 ? evens : odds).insert(i);
+  }
+  EXPECT_TRUE(evens.get_union_with(odds).reference_equals(s1));
+  EXPECT_TRUE(s1.get_difference_with(odds).reference_equals(evens));
+  EXPECT_TRUE(s1.get_intersection_with(evens).reference_equals(evens));
+  EXPECT_EQ(500, evens.size());
+}
+
+TEST(PatriciaTreeHashConsingTest, equalMapsShareTheirTree) {
+  HashConsedMap m1;
+  HashConsedMap m2;
+  for (uint32_t i = 0; i < 100; ++i) {
+    m1.insert_or_assign(i, i % 7);
+    m2.insert_or_assign(99 - i, (99 - i) % 7);
+  }
+  EXPECT_TRUE(m1.reference_equals(m2));
+  EXPECT_TRUE(m1.equals(m2));
+
+  m2.insert_or_assign(3, 42);
+  EXPECT_FALSE(m1.equals(m2));
+  m2.insert_or_assign(3, 3);
+  EXPECT_TRUE(m1.reference_equals(m2));
+
+  // Binding a key to the default value removes it.
+  m2.insert_or_assign(100, 0);
+  EXPECT_TRUE(m1.reference_equals(m2));
+}
+
+TEST(PatriciaTreeHashConsingTest, threadsShareNodes) {
+  constexpr size_t kThreads = 4;
+  std::vector<HashConsedSet> sets(kThreads);
+  std::vector<std::thread> threads;
+  for (size_t t = 0; t < kThreads; ++t) {
+    threads.emplace_back([&sets, t] {
+      for (size_t round = 0; round < 20; ++round) {
+        HashConsedSet s;
+        for (uint32_t i = 0; i < 512; ++i) {
+          s.insert((i * 7 + t) % 512);
+        }
+        sets[t] = s;
+      }
+    });
+  }
+  for (auto& thread : threads) {
+    thread.join();
+  }
+  for (size_t t = 1; t < kThreads; ++t) {
+    EXPECT_TRUE(sets[0].reference_equals(sets[t]));
+  }
+}
+
+TEST(PatriciaTreeHashConsingTest, joinsOfRecentEnvironmentsAreCached) {
+  Environment e1({{1, Domain(1)}, {2, Domain(2)}, {3, Domain(3)}});
+  Environment e2({{1, Domain(1)}, {2, Domain(4)}});
+
+  auto j1 = e1;
+  j1.join_with(e2);
+  auto j2 = e1;
+  j2.join_with(e2);
+  EXPECT_EQ(Environment({{1, Domain(1)}}), j1);
+  EXPECT_TRUE(j1.bindings().reference_equals(j2.bindings()));
+
+  auto m1 = e1;
+  m1.meet_with(e2);
+  EXPECT_TRUE(m1.is_bottom());
+  auto m2 = e1;
+  m2.meet_with(e2);
+  EXPECT_TRUE(m2.is_bottom());
+
+  auto self = e1;
+  self.join_with(self);
+  EXPECT_EQ(e1, self);
+}
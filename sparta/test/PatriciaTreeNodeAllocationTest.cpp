@@ -0,0 +1,222 @@
+/*
+ * Copyright (c) Facebook, Inc. and its affiliates.
+ *
+ * This source code is licensed under the MIT license found in the
+ * LICENSE file in the root directory of this source tree.
+ */
+
+#include <chrono>
+#include <cstdint>
+#include <cstdio>
+#include <random>
+#include <thread>
+#include <vector>
+
+#include <gmock/gmock.h>
+#include <gtest/gtest.h>
+
+#include "PatriciaTreeMap.h"
+#include "PatriciaTreeSet.h"
+
+using namespace sparta;
+
+namespace {
+
+using HeapSet = PatriciaTreeSet<uint32_t>;
+using PooledSet = PatriciaTreeSet<uint32_t, pt_util::PooledNodes>;
+using HeapMap = PatriciaTreeMap<uint32_t, uint32_t>;
+using PooledMap = PatriciaTreeMap<uint32_t,
+                                  uint32_t,
+                                  ptmap_impl::SimpleValue<uint32_t>,
+                                  pt_util::PooledNodes>;
+
+template <typename Set>
+std::vector<uint32_t> elements(const Set& s) {
+  return std::vector<uint32_t>(s.begin(), s.end());
+}
+
+template <typename Map>
+std::vector<std::pair<uint32_t, uint32_t>> bindings(const Map& m) {
+  std::vector<std::pair<uint32_t, uint32_t>> result;
+  for (const auto& p : m) {
+    result.emplace_back(p.first, p.second);
+  }
+  return result;
+}
+
+// Mimics the joins and updates of an abstract interpreter: a handful of
+// environments that are repeatedly updated and joined with each other.
+template <typename Set>
+size_t run_set_workload(size_t rounds) {
+  std::mt19937 rng(0);
+  std::uniform_int_distribution<uint32_t> keys(0, 4096);
+  std::vector<Set> sets(8);
+  size_t checksum = 0;
+  for (size_t i = 0; i < rounds; ++i) {
+    auto& s = sets[i % sets.size()];
+    s.insert(keys(rng));
+    s.remove(keys(rng));
+    auto joined = s.get_union_with(sets[(i + 3) % sets.size()]);
+    joined.intersection_with(sets[(i + 5) % sets.size()]);
+    checksum += joined.hash();
+    if (i % 97 == 0) {
+      s.clear();
+    }
+  }
+  return checksum;
+}
+
+template <typename Map>
+size_t run_map_workload(size_t rounds) {
+  std::mt19937 rng(0);
+  std::uniform_int_distribution<uint32_t> keys(0, 4096);
+  std::vector<Map> maps(8);
+  size_t checksum = 0;
+  for (size_t i = 0; i < rounds; ++i) {
+    auto& m = maps[i % maps.size()];
+    m.insert_or_assign(keys(rng), keys(rng));
+    m.update([](const uint32_t& x) { return x + 1; }, keys(rng));
+    auto joined = m;
+    joined.union_with(
+        [](const uint32_t& x, const uint32_t& y) { return x | y; },
+        maps[(i + 3) % maps.size()]);
+    checksum += joined.size();
+    if (i % 97 == 0) {
+      m.clear();
+    }
+  }
+  return checksum;
+}
+
+template <typename F>
+double time_in_ms(const F& f) {
+  auto start = std::chrono::steady_clock::now();
+  f();
+  auto end = std::chrono::steady_clock::now();
+  return std::chrono::duration<double, std::milli>(end - start).count();
+}
+
+} // namespace
+
+TEST(PatriciaTreeNodeAllocationTest, pooledSetsBehaveLikeHeapSets) {
+  std::mt19937 rng(1);
+  std::uniform_int_distribution<uint32_t> keys(0, 1000);
+  HeapSet heap1, heap2;
+  PooledSet pooled1, pooled2;
+  for (size_t i = 0; i < 5000; ++i) {
+    uint32_t k = keys(rng);
+    switch (i % 4) {
+    case 0:
+      heap1.insert(k);
+      pooled1.insert(k);
+      break;
+    case 1:
+      heap2.insert(k);
+      pooled2.insert(k);
+      break;
+    case 2:
+      heap1.remove(k);
+      pooled1.remove(k);
+      break;
+    case 3:
+      heap2.union_with(heap1.get_difference_with(heap2));
+      pooled2.union_with(pooled1.get_difference_with(pooled2));
+      break;
+    }
+    EXPECT_EQ(heap1.hash(), pooled1.hash());
+  }
+  EXPECT_EQ(elements(heap1), elements(pooled1));
+  EXPECT_EQ(elements(heap2), elements(pooled2));
+  EXPECT_EQ(elements(heap1.get_intersection_with(heap2)),
+            elements(pooled1.get_intersection_with(pooled2)));
+  EXPECT_TRUE(pooled1.is_subset_of(pooled1.get_union_with(pooled2)));
+}
+
+TEST(PatriciaTreeNodeAllocationTest, pooledMapsBehaveLikeHeapMaps) {
+  std::mt19937 rng(2);
+  std::uniform_int_distribution<uint32_t> keys(0, 1000);
+  HeapMap heap;
+  PooledMap pooled;
+  for (size_t i = 0; i < 5000; ++i) {
+    uint32_t k = keys(rng);
+    uint32_t v = keys(rng) % 4;
+    heap.insert_or_assign(k, v);
+    pooled.insert_or_assign(k, v);
+  }
+  EXPECT_EQ(bindings(heap), bindings(pooled));
+  auto heap_copy = heap;
+  auto pooled_copy = pooled;
+  heap_copy.map([](const uint32_t& x) { return x * 2; });
+  pooled_copy.map([](const uint32_t& x) { return x * 2; });
+  EXPECT_EQ(bindings(heap_copy), bindings(pooled_copy));
+  EXPECT_TRUE(pooled.equals(pooled));
+  EXPECT_FALSE(pooled.equals(pooled_copy));
+}
+
+TEST(PatriciaTreeNodeAllocationTest, nodesFreedOnOtherThreads) {
+  // Trees built by one thread and released by others, as happens when the
+  // abstract environments of a parallel fixpoint iteration are discarded.
+  constexpr size_t kThreads = 4;
+  std::vector<std::vector<PooledSet>> built(kThreads);
+  std::vector<std::thread> threads;
+  for (size_t t = 0; t < kThreads; ++t) {
+    threads.emplace_back([&built, t] {
+      for (uint32_t i = 0; i < 64; ++i) {
+        PooledSet s;
+        for (uint32_t k = 0; k < 512; ++k) {
+          s.insert(k * (i + 1) + t);
+        }
+        built[t].push_back(s);
+      }
+    });
+  }
+  for (auto& thread : threads) {
+    thread.join();
+  }
+  threads.clear();
+  for (size_t t = 0; t < kThreads; ++t) {
+    threads.emplace_back([&built, t] {
+      auto& sets = built[(t + 1) % kThreads];
+      PooledSet all;
+      for (const auto& s : sets) {
+        all.union_with(s);
+      }
+      EXPECT_FALSE(all.empty());
+      sets.clear();
+    });
+  }
+  for (auto& thread : threads) {
+    thread.join();
+  }
+  PooledSet s;
+  for (uint32_t k = 0; k < 4096; ++k) {
+    s.insert(k);
+  }
+  EXPECT_EQ(4096, s.size());
+}
+
+// Compares the two allocation policies on a synthetic abstract interpretation
+// workload. The figures are informational; the test only checks that both
+// policies compute the same trees.
+TEST(PatriciaTreeNodeAllocationTest, benchmark) {
+  constexpr size_t kRounds = 10000;
+  size_t heap_result = 0;
+  size_t pooled_result = 0;
+  double heap_ms =
+      time_in_ms([&] { heap_result = run_set_workload<HeapSet>(kRounds); });
+  double pooled_ms = time_in_ms(
+      [&] { pooled_result = run_set_workload<PooledSet>(kRounds); });
+  EXPECT_EQ(heap_result, pooled_result);
+  printf("PatriciaTreeSet: heap nodes %.1f ms, pooled nodes %.1f ms\n",
+         heap_ms,
+         pooled_ms);
+
+  heap_ms =
+      time_in_ms([&] { heap_result = run_map_workload<HeapMap>(kRounds); });
+  pooled_ms = time_in_ms(
+      [&] { pooled_result = run_map_workload<PooledMap>(kRounds); });
+  EXPECT_EQ(heap_result, pooled_result);
+  printf("PatriciaTreeMap: heap nodes %.1f ms, pooled nodes %.1f ms\n",
+         heap_ms,
+         pooled_ms);
+}
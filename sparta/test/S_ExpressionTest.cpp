@@ -254,3 +254,90 @@ TEST(S_ExpressionTest, patternMatching) {
   EXPECT_TRUE(y.is_nil());
   EXPECT_EQ(parse("((c d) e)"), z);
 }
+
+namespace {
+
+struct AtomCounter {
+  size_t lists{0};
+  size_t atoms{0};
+  void begin_list() { ++lists; }
+  void end_list() {}
+  void int32_atom(int32_t) { ++atoms; }
+  void string_atom(const char*, size_t) { ++atoms; }
+};
+
+// Parses the input with an s_expr_parser, and checks that it behaves like an
+// s_expr_istream.
+std::vector<s_expr> parse_buffer(const std::string& str, std::string* what) {
+  std::istringstream str_input(str);
+  s_expr_istream stream_input(str_input);
+  s_expr_parser buffer_input(str);
+  std::vector<s_expr> exprs;
+  for (;;) {
+    s_expr e1, e2;
+    stream_input >> e1;
+    buffer_input >> e2;
+    EXPECT_EQ(stream_input.good(), buffer_input.good());
+    EXPECT_EQ(stream_input.eoi(), buffer_input.eoi());
+    EXPECT_EQ(stream_input.what(), buffer_input.what());
+    if (!buffer_input.good()) {
+      break;
+    }
+    EXPECT_EQ(e1, e2);
+    exprs.push_back(e2);
+  }
+  *what = buffer_input.what();
+  return exprs;
+}
+
+} // namespace
+
+TEST(S_ExpressionTest, bufferParser) {
+  std::string what;
+  auto exprs = parse_buffer(
+      "(123#123()abc\"def\"\"gh()i\") ; comment\n"
+      "(a \"b\\\"c\\\\d\" #-2147483648 #2147483647) x #-5 \"\"",
+      &what);
+  EXPECT_EQ("On line 2: End of input", what);
+  ASSERT_EQ(5, exprs.size());
+  EXPECT_EQ("(123 #123 () abc def \"gh()i\")", exprs[0].str());
+  EXPECT_EQ(s_expr({s_expr("a"), s_expr("b\"c\\d"),
+                    s_expr(std::numeric_limits<int32_t>::min()),
+                    s_expr(std::numeric_limits<int32_t>::max())}),
+            exprs[1]);
+  EXPECT_EQ(s_expr("x"), exprs[2]);
+  EXPECT_EQ(s_expr(-5), exprs[3]);
+  EXPECT_EQ(s_expr(""), exprs[4]);
+
+  auto e = s_expr({s_expr("A"), s_expr(""), s_expr("a b\n\t\"c\""), s_expr(7)});
+  exprs = parse_buffer(e.str(), &what);
+  EXPECT_THAT(exprs, ::testing::ElementsAre(e));
+
+  parse_buffer("((a) b ()", &what);
+  EXPECT_EQ("On line 1: Incomplete S-expression", what);
+  parse_buffer("(\n(a)\nb\n()\n", &what);
+  EXPECT_EQ("On line 5: Incomplete S-expression", what);
+  parse_buffer("((a) b c))", &what);
+  EXPECT_EQ("On line 1: Extra ')' encountered", what);
+  parse_buffer("(a b #9999999999999)", &what);
+  EXPECT_EQ("On line 1: Error parsing int32_t literal", what);
+  parse_buffer("(a b #2147483648)", &what);
+  EXPECT_EQ("On line 1: Error parsing int32_t literal", what);
+  parse_buffer("(a b #-9999999999999)", &what);
+  EXPECT_EQ("On line 1: Error parsing int32_t literal", what);
+  parse_buffer("(a b \"abcdef)", &what);
+  EXPECT_EQ("On line 1: Error parsing string literal", what);
+  parse_buffer("123, (a b c)", &what);
+  EXPECT_EQ("On line 1: Unexpected character encountered: ','", what);
+  parse_buffer(";The error should be on line 2\n(123, (a b c)", &what);
+  EXPECT_EQ("On line 2: Unexpected character encountered: ','", what);
+
+  std::string input = "(a (b #1) \"c\") d";
+  s_expr_parser parser(input);
+  AtomCounter counter;
+  while (parser.next(counter)) {
+  }
+  EXPECT_TRUE(parser.eoi());
+  EXPECT_EQ(2, counter.lists);
+  EXPECT_EQ(5, counter.atoms);
+}
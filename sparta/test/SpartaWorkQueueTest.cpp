@@ -7,6 +7,7 @@
 
 #include "SpartaWorkQueue.h"
 
+#include <array>
 #include <atomic>
 #include <chrono>
 #include <gtest/gtest.h>
@@ -85,3 +86,79 @@ TEST(SpartaWorkQueueTest, checkDynamicallyAddingTasks) {
   // 10 + 9 + ... + 1 + 0 = 55
   EXPECT_EQ(55, result);
 }
+
+TEST(SpartaWorkQueueTest, workStealingTest) {
+  std::array<int, NUM_INTS> array = {0};
+
+  auto wq = sparta::work_queue<int*>([](int* a) { (*a)++; },
+                                     4,
+                                     /*push_tasks_while_running=*/false,
+                                     /*work_stealing=*/true);
+
+  for (int idx = 0; idx < NUM_INTS; ++idx) {
+    wq.add_item(&array[idx]);
+  }
+  wq.run_all();
+  for (int idx = 0; idx < NUM_INTS; ++idx) {
+    ASSERT_EQ(1, array[idx]);
+  }
+}
+
+// Tasks pushed by a running worker must be stealable by the others, including
+// when the owner's deque has to grow.
+TEST(SpartaWorkQueueTest, workStealingDynamicallyAddingTasks) {
+  constexpr size_t num_threads{4};
+  std::atomic<int> result{0};
+  auto wq = sparta::work_queue<int>(
+      [&](sparta::SpartaWorkerState<int>* worker_state, int a) {
+        if (a == 0) {
+          return;
+        }
+        if (a == NUM_INTS) {
+          for (int i = 1; i < NUM_INTS; ++i) {
+            worker_state->push_task(i);
+          }
+        }
+        result += a;
+      },
+      num_threads,
+      /*push_tasks_while_running=*/true,
+      /*work_stealing=*/true);
+  wq.add_item(NUM_INTS);
+  wq.run_all();
+
+  EXPECT_EQ(NUM_INTS * (NUM_INTS + 1) / 2, result);
+}
+
+TEST(SpartaWorkQueueTest, globalStats) {
+  const auto& stats = sparta::workqueue_impl::global_stats();
+  uint64_t tasks_before = stats.tasks;
+  uint64_t steals_before = stats.steals;
+  // A single thread has nobody to steal from.
+  auto single = sparta::work_queue<int>([](int) {}, 1);
+  for (int idx = 0; idx < NUM_INTS; ++idx) {
+    single.add_item(idx);
+  }
+  single.run_all();
+  EXPECT_EQ(NUM_INTS, stats.tasks - tasks_before);
+  EXPECT_EQ(0, stats.steals - steals_before);
+
+  // All the tasks start out in the first deque, so the others must steal.
+  tasks_before = stats.tasks;
+  auto stealing = sparta::work_queue<int>(
+      [](sparta::SpartaWorkerState<int>* worker_state, int a) {
+        if (a == 0) {
+          for (int i = 1; i < NUM_INTS; ++i) {
+            worker_state->push_task(i);
+          }
+        }
+        std::this_thread::sleep_for(std::chrono::microseconds(10));
+      },
+      4,
+      /*push_tasks_while_running=*/true,
+      /*work_stealing=*/true);
+  stealing.add_item(0);
+  stealing.run_all();
+  EXPECT_EQ(NUM_INTS, stats.tasks - tasks_before);
+  EXPECT_GT(stats.steals, steals_before);
+}
@@ -32,8 +32,12 @@ public class LineMapperV2 {
                           Long.toHexString(magic));
     }
     int version = readInt(ds);
+    if (version == 3) {
+      readV3(ds);
+      return;
+    }
     if (version != 2) {
-      throw new Exception("Version mismatch: Expected 2, got " +
+      throw new Exception("Version mismatch: Expected 2 or 3, got " +
                           Integer.toString(version));
     }
     int spool_count = readInt(ds);
@@ -56,6 +60,41 @@ public class LineMapperV2 {
     }
   }
 
+  // The sections of a version 3 map follow each other in the file, so they
+  // can be read in order.
+  private void readV3(DataInputStream ds) throws IOException {
+    int spool_count = readInt(ds);
+    int pos_count = readInt(ds);
+    int offsets_offset = readInt(ds);
+    int data_offset = readInt(ds);
+    int data_size = readInt(ds);
+    int positions_offset = readInt(ds);
+    int read = 32;
+    ds.skipBytes(offsets_offset - read);
+    int[] offsets = new int[spool_count + 1];
+    for (int i = 0; i <= spool_count; ++i) {
+      offsets[i] = readInt(ds);
+    }
+    read = offsets_offset + 4 * (spool_count + 1);
+    ds.skipBytes(data_offset - read);
+    byte[] data = new byte[data_size];
+    ds.readFully(data, 0, data_size);
+    read = data_offset + data_size;
+    stringPool = new String[spool_count];
+    for (int i = 0; i < spool_count; ++i) {
+      stringPool[i] = new String(data, offsets[i], offsets[i + 1] - offsets[i]);
+    }
+    ds.skipBytes(positions_offset - read);
+    for (int i = 0; i < pos_count; ++i) {
+      int class_id = readInt(ds);
+      int method_id = readInt(ds);
+      int file_id = readInt(ds);
+      int line = readInt(ds);
+      long parent = readInt(ds);
+      mapping.add(new PositionV2(class_id, method_id, file_id, line, parent));
+    }
+  }
+
   public ArrayList<PositionV2> getPositionsAt(long idx) {
     ArrayList<PositionV2> positions = new ArrayList();
     while (idx >= 0) {
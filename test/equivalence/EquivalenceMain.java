@@ -46,6 +46,38 @@ public class EquivalenceMain extends InstrumentationTestCase {
       Method after = afterMethods.get(entry.getKey());
       Assert.assertEquals(before.invoke(this), after.invoke(this));
     }
+    for (Map.Entry<String, Method> entry : beforeMethods.entrySet()) {
+      benchmark(c, entry.getKey(), entry.getValue(),
+                afterMethods.get(entry.getKey()));
+    }
+  }
+
+  // Reports how much faster (or slower) the transformed method runs.
+  private void benchmark(Class c, String name, Method before, Method after)
+      throws Exception {
+    int iterations = (Integer) c.getDeclaredMethod("iterations_" + name)
+        .invoke(this);
+    if (iterations <= 0) {
+      return;
+    }
+    // Warm up both methods first, so that neither is timed while the other
+    // gets compiled.
+    time(before, iterations / 10);
+    time(after, iterations / 10);
+    long beforeNanos = time(before, iterations);
+    long afterNanos = time(after, iterations);
+    writeToAdb(String.format(
+        "Timing %s: before %d ns, after %d ns, speedup %.2fx\n", name,
+        beforeNanos / iterations, afterNanos / iterations,
+        (double) beforeNanos / Math.max(afterNanos, 1)));
+  }
+
+  private long time(Method m, int iterations) throws Exception {
+    long start = System.nanoTime();
+    for (int i = 0; i < iterations; i++) {
+      m.invoke(this);
+    }
+    return System.nanoTime() - start;
   }
 
   private void writeToAdb(String s) {
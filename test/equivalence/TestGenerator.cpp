@@ -17,6 +17,7 @@
 
 #include <json/json.h>
 
+#include "DexAsm.h"
 #include "DexLoader.h"
 #include "DexOutput.h"
 #include "IRCode.h"
@@ -42,6 +43,19 @@ void EquivalenceTest::generate(DexClass* cls) {
       before, cls->get_type(), DexString::make_string("after_" + test_name()));
   cls->add_method(after);
   transform_method(after);
+
+  using namespace dex_asm;
+  DexMethod* iterations = static_cast<DexMethod*>(DexMethod::make_method(
+      cls->get_type(), DexString::make_string("iterations_" + test_name()),
+      proto));
+  iterations->make_concrete(ACC_PUBLIC | ACC_STATIC, false);
+  iterations->set_code(std::make_unique<IRCode>(iterations, 0));
+  auto code = iterations->get_code();
+  code->push_back(
+      dasm(OPCODE_CONST, {0_v, Operand{LITERAL, benchmark_iterations()}}));
+  code->push_back(dasm(OPCODE_RETURN, {0_v}));
+  code->set_registers_size(1);
+  cls->add_method(iterations);
 }
 
 void EquivalenceTest::generate_all(DexClass* cls) {
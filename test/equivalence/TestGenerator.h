@@ -36,6 +36,13 @@
  *
  *   before_foo() == after_foo()
  *
+ * It also times benchmark_iterations() calls of each method, which are made
+ * available to it as
+ *
+ *   static int iterations_foo() { ... }
+ *
+ * and reports the speedup or slowdown of after_foo() over before_foo().
+ *
  * TODO: Enable more return types for the test methods!
  */
 class EquivalenceTest {
@@ -54,6 +61,8 @@ class EquivalenceTest {
   virtual void setup(DexClass*) {}
   virtual void build_method(DexMethod*) = 0;
   virtual void transform_method(DexMethod*) = 0;
+  // How often to call each method when timing them; 0 skips the timing.
+  virtual int32_t benchmark_iterations() { return 10000; }
 
   void generate(DexClass* cls);
   static void generate_all(DexClass* cls);
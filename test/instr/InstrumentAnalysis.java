@@ -15,6 +15,7 @@ public class InstrumentAnalysis {
 
   private static int sNumStaticallyInstrumented = 0; // Redex will patch
   private static final int[] sMethodStats = new int[0]; // Redex will patch
+  private static short[] sMethodHitCounts = new short[0]; // Redex will patch
   private static short[][] sMethodStatsArray = new short[][] {};  // Redex will patch
 
   public static void onMethodBegin(int index) {
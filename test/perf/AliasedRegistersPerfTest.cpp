@@ -0,0 +1,94 @@
+/*
+ * Copyright (c) Facebook, Inc. and its affiliates.
+ *
+ * This source code is licensed under the MIT license found in the
+ * LICENSE file in the root directory of this source tree.
+ */
+
+#include <gtest/gtest.h>
+
+#include <chrono>
+#include <cstdio>
+#include <sstream>
+#include <string>
+
+#include "AliasedRegisters.h"
+#include "CopyPropagation.h"
+#include "IRAssembler.h"
+#include "IRCode.h"
+#include "RedexTest.h"
+
+using namespace aliased_registers;
+
+namespace {
+
+/*
+ * Builds a method where long chains of moves keep most registers aliased,
+ * and where conditionals that break some of the aliases on one side only
+ * make the analysis join large alias groups at every merge point.
+ */
+std::string make_method(size_t registers, size_t diamonds) {
+  std::ostringstream ss;
+  ss << "((load-param v0)";
+  for (size_t d = 0; d < diamonds; ++d) {
+    for (size_t reg = 2; reg < registers; ++reg) {
+      ss << "(move v" << reg << " v" << reg - 1 << ")";
+    }
+    ss << "(if-eqz v0 :join" << d << ")";
+    ss << "(const v" << 2 + d % (registers - 2) << " " << d << ")";
+    ss << "(:join" << d << ")";
+  }
+  ss << "(return-void))";
+  return ss.str();
+}
+
+} // namespace
+
+struct AliasedRegistersPerfTest : public RedexTest {};
+
+TEST_F(AliasedRegistersPerfTest, moveAndJoin) {
+  constexpr size_t kRuns = 20;
+  for (size_t registers : {16, 64, 256, 1024}) {
+    auto start = std::chrono::steady_clock::now();
+    for (size_t i = 0; i < kRuns; ++i) {
+      AliasedRegisters a;
+      AliasedRegisters b;
+      for (size_t reg = 1; reg < registers; ++reg) {
+        a.move(Value::create_register(reg), Value::create_register(reg - 1));
+      }
+      // Split the registers into the even and the odd ones in `b`, so that
+      // the join has to split the group of `a`.
+      for (size_t reg = 2; reg < registers; ++reg) {
+        b.move(Value::create_register(reg), Value::create_register(reg % 2));
+      }
+      a.join_with(b);
+      EXPECT_TRUE(a.are_aliases(Value::create_register(0),
+                                Value::create_register(2)));
+    }
+    auto end = std::chrono::steady_clock::now();
+    printf("%zu registers: %.3f ms per join\n",
+           registers,
+           std::chrono::duration<double, std::milli>(end - start).count() /
+               kRuns);
+  }
+}
+
+TEST_F(AliasedRegistersPerfTest, copyPropagation) {
+  constexpr size_t kRuns = 5;
+  constexpr size_t kDiamonds = 32;
+  for (size_t registers : {16, 64, 256}) {
+    auto start = std::chrono::steady_clock::now();
+    for (size_t i = 0; i < kRuns; ++i) {
+      auto code =
+          assembler::ircode_from_string(make_method(registers, kDiamonds));
+      code->set_registers_size(registers);
+      copy_propagation_impl::Config config;
+      copy_propagation_impl::CopyPropagation(config).run(code.get());
+    }
+    auto end = std::chrono::steady_clock::now();
+    printf("%zu registers: %.3f ms per method\n",
+           registers,
+           std::chrono::duration<double, std::milli>(end - start).count() /
+               kRuns);
+  }
+}
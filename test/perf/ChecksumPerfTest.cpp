@@ -0,0 +1,90 @@
+/*
+ * Copyright (c) Facebook, Inc. and its affiliates.
+ *
+ * This source code is licensed under the MIT license found in the
+ * LICENSE file in the root directory of this source tree.
+ */
+
+#include <gtest/gtest.h>
+
+#include <chrono>
+#include <cstring>
+#include <random>
+#include <vector>
+#include <zlib.h>
+
+#include "Adler32.h"
+#include "Sha1.h"
+
+namespace {
+
+// About the size of a full dex.
+constexpr size_t kDataSize = 16 * 1024 * 1024;
+constexpr int kIterations = 10;
+
+std::vector<unsigned char> make_random_data(size_t size) {
+  std::mt19937 rng(0);
+  std::vector<unsigned char> data(size);
+  for (auto& c : data) {
+    c = static_cast<unsigned char>(rng());
+  }
+  return data;
+}
+
+template <typename Fn>
+double megabytes_per_second(const Fn& fn) {
+  auto start = std::chrono::steady_clock::now();
+  for (int i = 0; i < kIterations; i++) {
+    fn();
+  }
+  auto end = std::chrono::steady_clock::now();
+  double seconds = std::chrono::duration<double>(end - start).count();
+  return kDataSize * kIterations / seconds / (1024 * 1024);
+}
+
+} // namespace
+
+TEST(ChecksumPerfTest, sha1) {
+  auto data = make_random_data(kDataSize);
+  unsigned char digest[20];
+  auto mbps = megabytes_per_second([&]() {
+    Sha1Context context;
+    sha1_init(&context);
+    sha1_update(&context, data.data(), data.size());
+    sha1_final(digest, &context);
+  });
+  printf("sha1: %.0f MB/s\n", mbps);
+
+  // The well-known digest of "abc".
+  const unsigned char expected[20] = {
+      0xa9, 0x99, 0x3e, 0x36, 0x47, 0x06, 0x81, 0x6a, 0xba, 0x3e,
+      0x25, 0x71, 0x78, 0x50, 0xc2, 0x6c, 0x9c, 0xd0, 0xd8, 0x9d};
+  Sha1Context context;
+  sha1_init(&context);
+  sha1_update(&context, (const unsigned char*)"abc", 3);
+  sha1_final(digest, &context);
+  EXPECT_EQ(0, memcmp(digest, expected, sizeof(digest)));
+}
+
+TEST(ChecksumPerfTest, adler32) {
+  auto data = make_random_data(kDataSize);
+  uint32_t ours = 0;
+  uint32_t zlib = 0;
+  auto ours_mbps = megabytes_per_second([&]() {
+    ours = adler32_update(ADLER32_INIT, data.data(), data.size());
+  });
+  auto zlib_mbps = megabytes_per_second([&]() {
+    zlib = (uint32_t)adler32(adler32(0L, Z_NULL, 0), data.data(), data.size());
+  });
+  printf("adler32: %.0f MB/s, zlib adler32: %.0f MB/s\n", ours_mbps,
+         zlib_mbps);
+  EXPECT_EQ(ours, zlib);
+
+  // Odd lengths and split updates exercise the scalar tail.
+  for (size_t len : {0, 1, 31, 32, 33, 5551, 5552, 5553, 100003}) {
+    uint32_t split = adler32_update(
+        adler32_update(ADLER32_INIT, data.data(), len / 3),
+        data.data() + len / 3, len - len / 3);
+    EXPECT_EQ(split, (uint32_t)adler32(1, data.data(), len)) << len;
+  }
+}
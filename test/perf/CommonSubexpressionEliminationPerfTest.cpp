@@ -0,0 +1,81 @@
+/*
+ * Copyright (c) Facebook, Inc. and its affiliates.
+ *
+ * This source code is licensed under the MIT license found in the
+ * LICENSE file in the root directory of this source tree.
+ */
+
+#include <gtest/gtest.h>
+
+#include <chrono>
+#include <cstdio>
+#include <sstream>
+#include <string>
+
+#include "CommonSubexpressionElimination.h"
+#include "ControlFlow.h"
+#include "IRAssembler.h"
+#include "IRCode.h"
+#include "Purity.h"
+#include "RedexTest.h"
+
+namespace {
+
+/*
+ * Builds the body of a giant method, the way generated code often looks: a
+ * long sequence of blocks, each of which recomputes a few arithmetic
+ * expressions and field reads over the params, interleaved with field writes
+ * that act as barriers.
+ */
+std::string make_method(size_t blocks) {
+  std::ostringstream ss;
+  ss << "((load-param v0)(load-param v1)(load-param-object v2)";
+  for (size_t i = 0; i < blocks; ++i) {
+    ss << "(add-int v3 v0 v1)";
+    ss << "(mul-int v4 v3 v0)";
+    ss << "(add-int/lit8 v5 v4 " << i % 100 << ")";
+    ss << "(iget v2 \"LFoo;.a:I\")";
+    ss << "(move-result-pseudo v6)";
+    ss << "(add-int v7 v6 v5)";
+    ss << "(if-eqz v7 :skip" << i << ")";
+    ss << "(iput v7 v2 \"LFoo;.b:I\")";
+    ss << "(:skip" << i << ")";
+    if (i % 8 == 0) {
+      ss << "(iput v5 v2 \"LFoo;.a:I\")";
+    }
+  }
+  ss << "(return v7))";
+  return ss.str();
+}
+
+} // namespace
+
+struct CommonSubexpressionEliminationPerfTest : public RedexTest {};
+
+TEST_F(CommonSubexpressionEliminationPerfTest, giantMethods) {
+  DexField::make_field("LFoo;.a:I")->make_concrete(ACC_PUBLIC);
+  DexField::make_field("LFoo;.b:I")->make_concrete(ACC_PUBLIC);
+  auto pure_methods = get_pure_methods();
+  cse_impl::SharedState shared_state(pure_methods);
+  shared_state.init_scope({});
+  auto args = DexTypeList::make_type_list(
+      {type::_int(), type::_int(), DexType::make_type("LFoo;")});
+  for (size_t blocks : {250, 1000, 4000}) {
+    auto code = assembler::ircode_from_string(make_method(blocks));
+    code->build_cfg(/* editable */ true);
+    auto start = std::chrono::steady_clock::now();
+    cse_impl::CommonSubexpressionElimination cse(&shared_state, code->cfg(),
+                                                 /* is_static */ true,
+                                                 /* is_init_or_clinit */ false,
+                                                 /* declaring_type */ nullptr,
+                                                 args);
+    cse.patch();
+    auto end = std::chrono::steady_clock::now();
+    EXPECT_GT(cse.get_stats().instructions_eliminated, 0);
+    printf("%zu blocks: %zu values, %.3f ms\n",
+           blocks,
+           cse.get_stats().max_value_ids,
+           std::chrono::duration<double, std::milli>(end - start).count());
+    code->clear_cfg();
+  }
+}
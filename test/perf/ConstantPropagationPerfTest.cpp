@@ -0,0 +1,80 @@
+/*
+ * Copyright (c) Facebook, Inc. and its affiliates.
+ *
+ * This source code is licensed under the MIT license found in the
+ * LICENSE file in the root directory of this source tree.
+ */
+
+#include <gtest/gtest.h>
+
+#include <chrono>
+#include <cstdio>
+#include <sstream>
+#include <string>
+
+#include "ConstantPropagationAnalysis.h"
+#include "IRAssembler.h"
+#include "IRCode.h"
+#include "RedexTest.h"
+
+namespace cp = constant_propagation;
+
+namespace {
+
+/*
+ * Builds the body of a method that uses the given number of registers: a loop
+ * around a sequence of diamonds, each of which updates a few registers, the
+ * way typical methods shuffle locals around their branches.
+ */
+std::string make_method(size_t registers, size_t diamonds) {
+  std::ostringstream ss;
+  ss << "((load-param v0)";
+  for (size_t reg = 1; reg < registers; ++reg) {
+    ss << "(const v" << reg << " " << reg % 5 << ")";
+  }
+  ss << "(:loop)";
+  ss << "(if-ge v1 v0 :end)";
+  for (size_t i = 0; i < diamonds; ++i) {
+    size_t a = 2 + (i * 3) % (registers - 2);
+    size_t b = 2 + (i * 7 + 1) % (registers - 2);
+    ss << "(if-eqz v" << a << " :else" << i << ")";
+    ss << "(add-int/lit8 v" << b << " v" << b << " 1)";
+    ss << "(goto :join" << i << ")";
+    ss << "(:else" << i << ")";
+    ss << "(const v" << b << " " << i % 3 << ")";
+    ss << "(:join" << i << ")";
+  }
+  ss << "(add-int/lit8 v1 v1 1)";
+  ss << "(goto :loop)";
+  ss << "(:end)";
+  ss << "(return v1))";
+  return ss.str();
+}
+
+} // namespace
+
+struct ConstantPropagationPerfTest : public RedexTest {};
+
+TEST_F(ConstantPropagationPerfTest, typicalMethods) {
+  constexpr size_t kDiamonds = 32;
+  constexpr size_t kRuns = 200;
+  for (size_t registers : {4, 8, 12, 16, 24, 32}) {
+    auto code =
+        assembler::ircode_from_string(make_method(registers, kDiamonds));
+    code->build_cfg(/* editable */ false);
+    code->cfg().calculate_exit_block();
+    auto start = std::chrono::steady_clock::now();
+    for (size_t i = 0; i < kRuns; ++i) {
+      cp::intraprocedural::FixpointIterator intra_cp(
+          code->cfg(), cp::ConstantPrimitiveAnalyzer());
+      intra_cp.run(ConstantEnvironment());
+      EXPECT_FALSE(intra_cp.get_exit_state_at(code->cfg().exit_block())
+                       .is_bottom());
+    }
+    auto end = std::chrono::steady_clock::now();
+    printf("%zu registers: %.3f ms per method\n",
+           registers,
+           std::chrono::duration<double, std::milli>(end - start).count() /
+               kRuns);
+  }
+}
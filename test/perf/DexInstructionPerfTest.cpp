@@ -0,0 +1,102 @@
+/*
+ * Copyright (c) Facebook, Inc. and its affiliates.
+ *
+ * This source code is licensed under the MIT license found in the
+ * LICENSE file in the root directory of this source tree.
+ */
+
+#include <gtest/gtest.h>
+
+#include <chrono>
+#include <cstdio>
+#include <vector>
+
+#include "DexInstruction.h"
+
+namespace {
+
+constexpr size_t kRepeats = 200000;
+constexpr int kIterations = 5;
+
+// A mix of the ref-less formats, with 1 to 5 code units each.
+const std::vector<uint16_t> kPattern = {
+    0x1012,                         // const/4 v0, #1
+    0x0113, 100,                    // const/16 v1, #100
+    0x0214, 0x5678, 0x1234,         // const v2, #0x12345678
+    0x0090, 0x0201,                 // add-int v0, v1, v2
+    0x0418, 1, 2, 3, 4,             // const-wide v4, #0x0004000300020001
+    0x0301,                         // move v3, v0
+    0x10b0,                         // add-int/2addr v0, v1
+};
+constexpr size_t kPatternInsns = 7;
+
+template <typename Fn>
+double insns_per_second(size_t insns, const Fn& fn) {
+  auto start = std::chrono::steady_clock::now();
+  for (int i = 0; i < kIterations; i++) {
+    fn();
+  }
+  auto end = std::chrono::steady_clock::now();
+  double seconds = std::chrono::duration<double>(end - start).count();
+  return insns * kIterations / seconds;
+}
+
+} // namespace
+
+TEST(DexInstructionPerfTest, decodeAndEncode) {
+  std::vector<uint16_t> code;
+  for (size_t i = 0; i < kRepeats; i++) {
+    code.insert(code.end(), kPattern.begin(), kPattern.end());
+  }
+  code.push_back(0x000e); // return-void
+  const size_t insns = kRepeats * kPatternInsns + 1;
+  const uint16_t* end = code.data() + code.size();
+
+  size_t counted = 0;
+  auto count_ips = insns_per_second(insns, [&]() {
+    counted = DexInstruction::count_instructions(code.data(), end);
+  });
+  EXPECT_EQ(counted, insns);
+
+  std::vector<DexInstruction*> decoded;
+  auto decode_ips = insns_per_second(insns, [&]() {
+    for (auto insn : decoded) {
+      delete insn;
+    }
+    decoded.clear();
+    decoded.reserve(DexInstruction::count_instructions(code.data(), end));
+    const uint16_t* cdata = code.data();
+    while (cdata < end) {
+      decoded.push_back(DexInstruction::make_instruction(nullptr, &cdata));
+    }
+  });
+  ASSERT_EQ(decoded.size(), insns);
+
+  std::vector<uint16_t> encoded(code.size());
+  auto encode_ips = insns_per_second(insns, [&]() {
+    uint16_t* out = encoded.data();
+    for (auto insn : decoded) {
+      insn->encode(nullptr, out);
+    }
+  });
+  EXPECT_EQ(encoded, code);
+
+  size_t units = 0;
+  for (auto insn : decoded) {
+    units += insn->size();
+    delete insn;
+  }
+  EXPECT_EQ(units, code.size());
+
+  printf("count: %.1f M insns/s, decode: %.1f M insns/s, "
+         "encode: %.1f M insns/s\n",
+         count_ips / 1e6, decode_ips / 1e6, encode_ips / 1e6);
+}
+
+TEST(DexInstructionPerfTest, payloadCodeUnits) {
+  // A packed-switch payload with two targets.
+  std::vector<uint16_t> code = {0x0100, 2, 0, 0, 0, 0, 0, 0};
+  EXPECT_EQ(DexInstruction::code_units(code.data()), code.size());
+  const uint16_t* end = code.data() + code.size();
+  EXPECT_EQ(DexInstruction::count_instructions(code.data(), end), 1);
+}
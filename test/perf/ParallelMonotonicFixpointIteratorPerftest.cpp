@@ -226,6 +226,24 @@ double calculate_speedup(const MonotonicFixpointIteratorTest& test,
   return duration2;
 }
 
+/*
+ * Measures the time taken to propagate a change of the statement at node 2
+ * after a full run, which re-analyzes nodes 2 and 1 only.
+ */
+double calculate_incremental_duration(MonotonicFixpointIteratorTest& test,
+                                      uint32_t num_core) {
+  ParallelFixpointEngine para_fp(test.m_program1, num_core);
+  para_fp.run(LivenessDomain());
+  test.m_program1.add(2, Statement(/* use: */ {1}, /* def: */ {2}));
+  auto incremental_start = std::chrono::high_resolution_clock::now();
+  para_fp.run_incrementally(LivenessDomain(), {2});
+  auto incremental_end = std::chrono::high_resolution_clock::now();
+  test.m_program1.add(2, Statement(/* use: */ {0}, /* def: */ {2}));
+  return std::chrono::duration_cast<std::chrono::microseconds>(
+             incremental_end - incremental_start)
+      .count();
+}
+
 int main() {
   printf("Begin!\n");
   MonotonicFixpointIteratorTest test;
@@ -240,4 +258,8 @@ int main() {
   for (uint32_t i = 1; i <= redex_parallel::default_num_threads(); ++i) {
     printf("%u %lf\n", i, duration1 / calculate_speedup(test, i));
   }
+  printf("Incremental run after a change to one node\n");
+  for (uint32_t i = 1; i <= redex_parallel::default_num_threads(); ++i) {
+    printf("%u %lf\n", i, duration1 / calculate_incremental_duration(test, i));
+  }
 }
@@ -0,0 +1,279 @@
+/*
+ * Copyright (c) Facebook, Inc. and its affiliates.
+ *
+ * This source code is licensed under the MIT license found in the
+ * LICENSE file in the root directory of this source tree.
+ */
+
+#include <gtest/gtest.h>
+
+#include <chrono>
+#include <cstdio>
+#include <cstdlib>
+#include <fstream>
+#include <functional>
+#include <json/json.h>
+#include <memory>
+#include <sstream>
+#include <string>
+#include <vector>
+
+#include "CommonSubexpressionEliminationPass.h"
+#include "DexOutput.h"
+#include "DexPosition.h"
+#include "IRAssembler.h"
+#include "InstructionLowering.h"
+#include "InterDexPass.h"
+#include "MethodInlinePass.h"
+#include "RedexTest.h"
+#include "RedexTestUtils.h"
+#include "RegAlloc.h"
+#include "RemoveUnreachable.h"
+
+/*
+ * Times the main passes on a synthetic scope. The shape of the scope is read
+ * from the environment, so that the same binary can be pointed at different
+ * workloads:
+ *
+ *   REDEX_PERF_CLASSES       number of classes (200)
+ *   REDEX_PERF_METHODS       static methods per class (20)
+ *   REDEX_PERF_BLOCKS        average number of blocks per method (16)
+ *   REDEX_PERF_SIZES         uniform | skewed; skewed makes most methods
+ *                            small and every 64th one ten times the average
+ *   REDEX_PERF_CALL_GRAPH    chain | hub | random (random)
+ *   REDEX_PERF_CALLS         calls per method for hub and random (2)
+ *   REDEX_PERF_JSON          where to write the results (stdout)
+ *
+ * Every pass runs on a freshly generated scope. The results are emitted as a
+ * JSON object, with the shape of the scope and the wall time of each pass in
+ * milliseconds, so that they can be tracked over time.
+ */
+
+namespace {
+
+struct ScopeShape {
+  size_t classes;
+  size_t methods;
+  size_t blocks;
+  std::string sizes;
+  std::string call_graph;
+  size_t calls;
+};
+
+size_t env_size(const char* name, size_t default_value) {
+  auto value = getenv(name);
+  return value ? std::stoul(value) : default_value;
+}
+
+std::string env_string(const char* name, const char* default_value) {
+  auto value = getenv(name);
+  return value ? value : default_value;
+}
+
+ScopeShape shape_from_env() {
+  return ScopeShape{env_size("REDEX_PERF_CLASSES", 200),
+                    env_size("REDEX_PERF_METHODS", 20),
+                    env_size("REDEX_PERF_BLOCKS", 16),
+                    env_string("REDEX_PERF_SIZES", "uniform"),
+                    env_string("REDEX_PERF_CALL_GRAPH", "random"),
+                    env_size("REDEX_PERF_CALLS", 2)};
+}
+
+std::string method_name(size_t index, const ScopeShape& shape) {
+  return "LPerf" + std::to_string(index / shape.methods) + ";.m" +
+         std::to_string(index % shape.methods) + ":(I)I";
+}
+
+// The callees of a method, as indices into all the methods of the scope.
+std::vector<size_t> callees(size_t index,
+                            const ScopeShape& shape,
+                            uint32_t* rand_state) {
+  size_t num_methods = shape.classes * shape.methods;
+  std::vector<size_t> result;
+  if (shape.call_graph == "chain") {
+    if (index + 1 < num_methods) {
+      result.push_back(index + 1);
+    }
+  } else if (shape.call_graph == "hub") {
+    // Everything calls the first few methods, which are thus worth
+    // inlining.
+    for (size_t i = 0; i < shape.calls; ++i) {
+      if (i != index && i < num_methods) {
+        result.push_back(i);
+      }
+    }
+  } else {
+    always_assert_log(shape.call_graph == "random", "Unknown call graph %s",
+                      shape.call_graph.c_str());
+    for (size_t i = 0; i < shape.calls; ++i) {
+      *rand_state = *rand_state * 1103515245 + 12345;
+      result.push_back((*rand_state >> 8) % num_methods);
+    }
+  }
+  return result;
+}
+
+size_t num_blocks(size_t index, const ScopeShape& shape, uint32_t* rand_state) {
+  if (shape.sizes == "skewed") {
+    return index % 64 == 0 ? shape.blocks * 10 : shape.blocks / 4 + 1;
+  }
+  always_assert_log(shape.sizes == "uniform", "Unknown size distribution %s",
+                    shape.sizes.c_str());
+  *rand_state = *rand_state * 1103515245 + 12345;
+  return 1 + (*rand_state >> 8) % (2 * shape.blocks);
+}
+
+/*
+ * Each method repeats a few redundant arithmetic expressions per block, so
+ * that CSE finds something to do, and keeps several values live across the
+ * calls for the register allocator.
+ */
+std::string make_method(size_t index,
+                        const ScopeShape& shape,
+                        uint32_t* rand_state) {
+  std::ostringstream ss;
+  ss << "(method (public static) \"" << method_name(index, shape) << "\" ("
+     << "(load-param v0)"
+     << "(const v1 " << index % 100 << ")";
+  size_t blocks = num_blocks(index, shape, rand_state);
+  for (size_t i = 0; i < blocks; ++i) {
+    ss << "(add-int v2 v0 v1)"
+       << "(mul-int v3 v2 v0)"
+       << "(add-int v4 v0 v1)"
+       << "(xor-int v1 v3 v4)"
+       << "(if-eqz v1 :b" << i << ")"
+       << "(add-int/lit8 v1 v1 " << i % 100 << ")"
+       << "(:b" << i << ")";
+  }
+  for (auto callee : callees(index, shape, rand_state)) {
+    ss << "(invoke-static (v1) \"" << method_name(callee, shape) << "\")"
+       << "(move-result v2)"
+       << "(add-int v1 v1 v2)";
+  }
+  ss << "(return v1)))";
+  return ss.str();
+}
+
+// Generates the scope into a new root store. The methods of the first class
+// are the roots.
+DexStoresVector make_stores(const ScopeShape& shape) {
+  uint32_t rand_state = 1;
+  DexClasses classes;
+  for (size_t cls = 0; cls < shape.classes; ++cls) {
+    std::vector<DexMethod*> methods;
+    for (size_t m = 0; m < shape.methods; ++m) {
+      auto method = assembler::method_from_string(
+          make_method(cls * shape.methods + m, shape, &rand_state));
+      if (cls == 0) {
+        method->rstate.set_root();
+      }
+      methods.push_back(method);
+    }
+    classes.push_back(assembler::class_with_methods(
+        "LPerf" + std::to_string(cls) + ";", methods));
+  }
+  DexMetadata dm;
+  dm.set_id("classes");
+  DexStore store(dm);
+  store.add_classes(std::move(classes));
+  DexStoresVector stores;
+  stores.emplace_back(std::move(store));
+  return stores;
+}
+
+double time_ms(const std::function<void()>& fn) {
+  auto start = std::chrono::steady_clock::now();
+  fn();
+  auto end = std::chrono::steady_clock::now();
+  return std::chrono::duration<double, std::milli>(end - start).count();
+}
+
+Json::Value shape_to_json(const ScopeShape& shape) {
+  Json::Value json(Json::objectValue);
+  json["classes"] = Json::UInt64(shape.classes);
+  json["methods_per_class"] = Json::UInt64(shape.methods);
+  json["blocks_per_method"] = Json::UInt64(shape.blocks);
+  json["sizes"] = shape.sizes;
+  json["call_graph"] = shape.call_graph;
+  json["calls_per_method"] = Json::UInt64(shape.calls);
+  return json;
+}
+
+} // namespace
+
+struct PassThroughputPerfTest : public RedexTest {
+  // Runs a single pass on a fresh scope, in its own context.
+  double time_pass(Pass* pass, const Json::Value& json_conf) {
+    delete g_redex;
+    g_redex = new RedexContext();
+    auto stores = make_stores(m_shape);
+    PassManager manager({pass}, json_conf);
+    manager.set_testing_mode();
+    ConfigFiles conf(json_conf);
+    return time_ms([&] { manager.run_passes(stores, conf); });
+  }
+
+  ScopeShape m_shape{shape_from_env()};
+};
+
+TEST_F(PassThroughputPerfTest, corePasses) {
+  auto tmp_dir = redex::make_tmp_dir("redex_pass_perf_test_%%%%%%%%");
+  auto coldstart_classes = tmp_dir.path + "/coldstart_classes.txt";
+  std::ofstream(coldstart_classes).close();
+  Json::Value json_conf(Json::objectValue);
+  json_conf["apk_dir"] = tmp_dir.path;
+  json_conf["coldstart_classes"] = coldstart_classes;
+  boost::filesystem::create_directories(tmp_dir.path +
+                                        "/assets/secondary-program-dex-jars");
+
+  Json::Value results(Json::objectValue);
+  results["shape"] = shape_to_json(m_shape);
+  Json::Value& passes = results["passes_ms"];
+  {
+    CommonSubexpressionEliminationPass pass;
+    passes["CommonSubexpressionEliminationPass"] = time_pass(&pass, json_conf);
+  }
+  {
+    MethodInlinePass pass;
+    passes["MethodInlinePass"] = time_pass(&pass, json_conf);
+  }
+  {
+    regalloc::RegAllocPass pass;
+    passes["RegAllocPass"] = time_pass(&pass, json_conf);
+  }
+  {
+    interdex::InterDexPass pass(/* register_plugins = */ false);
+    passes["InterDexPass"] = time_pass(&pass, json_conf);
+  }
+  {
+    RemoveUnreachablePass pass;
+    passes["RemoveUnreachablePass"] = time_pass(&pass, json_conf);
+  }
+  {
+    delete g_redex;
+    g_redex = new RedexContext();
+    auto stores = make_stores(m_shape);
+    instruction_lowering::run(stores);
+    ConfigFiles conf(json_conf, tmp_dir.path);
+    std::unique_ptr<PositionMapper> pos_mapper(PositionMapper::make(""));
+    auto& classes = stores[0].get_dexen()[0];
+    passes["DexOutput"] = time_ms([&] {
+      write_classes_to_dex(RedexOptions(), tmp_dir.path + "/classes.dex",
+                           &classes, nullptr /* LocatorIndex* */, 0, 0, conf,
+                           pos_mapper.get(), nullptr, nullptr,
+                           nullptr /* IODIMetadata* */,
+                           DEX_HEADER_DEXMAGIC_V35);
+    });
+  }
+  for (const auto& name : passes.getMemberNames()) {
+    EXPECT_GT(passes[name].asDouble(), 0) << name;
+  }
+
+  Json::StyledWriter writer;
+  auto json_path = env_string("REDEX_PERF_JSON", "");
+  if (json_path.empty()) {
+    printf("%s", writer.write(results).c_str());
+  } else {
+    std::ofstream(json_path) << writer.write(results);
+  }
+}
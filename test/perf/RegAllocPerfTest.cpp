@@ -0,0 +1,95 @@
+/*
+ * Copyright (c) Facebook, Inc. and its affiliates.
+ *
+ * This source code is licensed under the MIT license found in the
+ * LICENSE file in the root directory of this source tree.
+ */
+
+#include <gtest/gtest.h>
+
+#include <chrono>
+#include <cstdio>
+#include <sstream>
+#include <string>
+
+#include "GraphColoring.h"
+#include "IRAssembler.h"
+#include "IRCode.h"
+#include "Interference.h"
+#include "LiveRange.h"
+#include "Liveness.h"
+#include "RedexTest.h"
+
+using namespace regalloc;
+
+namespace {
+
+/*
+ * Builds the body of a large generated method, e.g., a static initializer:
+ * many registers are defined up front and stay live until they are all
+ * summed at the end, so that the interference graph is dense.
+ */
+std::string make_method(size_t registers) {
+  std::ostringstream ss;
+  ss << "(";
+  for (size_t reg = 0; reg < registers; ++reg) {
+    ss << "(const v" << reg << " " << reg % 7 << ")";
+  }
+  for (size_t reg = 1; reg < registers; ++reg) {
+    ss << "(add-int v0 v0 v" << reg << ")";
+  }
+  ss << "(return v0))";
+  return ss.str();
+}
+
+} // namespace
+
+struct RegAllocPerfTest : public RedexTest {};
+
+TEST_F(RegAllocPerfTest, buildInterferenceGraph) {
+  constexpr size_t kRuns = 5;
+  for (size_t registers : {64, 256, 1024, 4096}) {
+    auto code = assembler::ircode_from_string(make_method(registers));
+    code->set_registers_size(registers);
+    code->build_cfg(/* editable */ false);
+    auto& cfg = code->cfg();
+    cfg.calculate_exit_block();
+    LivenessFixpointIterator fixpoint_iter(cfg);
+    fixpoint_iter.run(LivenessDomain());
+    auto start = std::chrono::steady_clock::now();
+    for (size_t i = 0; i < kRuns; ++i) {
+      RangeSet range_set;
+      auto ig = interference::build_graph(
+          fixpoint_iter, code.get(), code->get_registers_size(), range_set);
+      EXPECT_TRUE(ig.is_adjacent(0, registers - 1));
+    }
+    auto end = std::chrono::steady_clock::now();
+    printf("%zu registers: %.3f ms per graph\n",
+           registers,
+           std::chrono::duration<double, std::milli>(end - start).count() /
+               kRuns);
+  }
+}
+
+TEST_F(RegAllocPerfTest, allocate) {
+  constexpr size_t kRuns = 5;
+  for (size_t registers : {64, 256, 1024}) {
+    auto start = std::chrono::steady_clock::now();
+    for (size_t i = 0; i < kRuns; ++i) {
+      auto name = "LFoo;.bar" + std::to_string(registers) + "_" +
+                  std::to_string(i) + ":()I";
+      auto method = DexMethod::make_method(name)->make_concrete(
+          ACC_PUBLIC | ACC_STATIC, false);
+      method->set_code(
+          assembler::ircode_from_string(make_method(registers)));
+      method->get_code()->set_registers_size(registers);
+      graph_coloring::Allocator allocator;
+      allocator.allocate(method);
+    }
+    auto end = std::chrono::steady_clock::now();
+    printf("%zu registers: %.3f ms per method\n",
+           registers,
+           std::chrono::duration<double, std::milli>(end - start).count() /
+               kRuns);
+  }
+}
@@ -5,16 +5,14 @@
  * LICENSE file in the root directory of this source tree.
  */
 
-#if defined(__SSE4_2__) && defined(__linux__) && defined(__STRCMP_LESS__)
 #include <gtest/gtest.h>
 
 #include <cstring>
-#include <ctime>
 #include <stdlib.h>
 #include <string>
 #include <sys/time.h>
 
-extern "C" bool strcmp_less(const char* str1, const char* str2);
+#include "StrcmpLess.h"
 
 unsigned long long get_time_in_ms() {
   struct timeval tv;
@@ -25,7 +23,7 @@ unsigned long long get_time_in_ms() {
 }
 
 TEST(StrcmpLessPerfTest, Test1) {
-  const int iter = 1000000000;
+  const int iter = 10000000;
   const int len = 8;
   const char* strs_equal[] = {
       "Lcom/some/class/name:methodname",
@@ -54,27 +52,42 @@ TEST(StrcmpLessPerfTest, Test1) {
       "123456789",
       "this string is very long very long very long very long",
       "this string is very long very long very long very lon"};
-  long long result1 = 0;
-  long long result2 = 0;
+  long long expected = 0;
   unsigned long long ts1 = get_time_in_ms();
   for (int i = 0; i < iter; i++) {
     for (int j = 0; j < len - 1; j = j + 2) {
-      result1 += (int)(strcmp(strs_equal[j], strs_equal[j + 1]) < 0);
-      result1 += (int)(strcmp(strs_less[j], strs_less[j + 1]) < 0);
-      result1 += (int)(strcmp(strs_greater[j], strs_greater[j + 1]) < 0);
+      expected += (int)(strcmp(strs_equal[j], strs_equal[j + 1]) < 0);
+      expected += (int)(strcmp(strs_less[j], strs_less[j + 1]) < 0);
+      expected += (int)(strcmp(strs_greater[j], strs_greater[j + 1]) < 0);
     }
   }
   unsigned long long ts2 = get_time_in_ms();
-  for (int i = 0; i < iter; i++) {
-    for (int j = 0; j < len - 1; j = j + 2) {
-      result2 += (int)(strcmp_less(strs_equal[j], strs_equal[j + 1]));
-      result2 += (int)(strcmp_less(strs_less[j], strs_less[j + 1]));
-      result2 += (int)(strcmp_less(strs_greater[j], strs_greater[j + 1]));
+  printf("Execution time (ms) strcmp: %llu\n", ts2 - ts1);
+
+  const std::pair<StrcmpLessVariant, const char*> variants[] = {
+      {StrcmpLessVariant::Portable, "portable"},
+      {StrcmpLessVariant::SSE42, "sse4.2"},
+      {StrcmpLessVariant::AVX2, "avx2"},
+      {StrcmpLessVariant::NEON, "neon"},
+  };
+  for (const auto& variant : variants) {
+    if (!strcmp_less_supported(variant.first)) {
+      printf("strcmp_less %s: not supported\n", variant.second);
+      continue;
+    }
+    auto less = get_strcmp_less(variant.first);
+    long long result = 0;
+    ts1 = get_time_in_ms();
+    for (int i = 0; i < iter; i++) {
+      for (int j = 0; j < len - 1; j = j + 2) {
+        result += (int)(less(strs_equal[j], strs_equal[j + 1]));
+        result += (int)(less(strs_less[j], strs_less[j + 1]));
+        result += (int)(less(strs_greater[j], strs_greater[j + 1]));
+      }
     }
+    ts2 = get_time_in_ms();
+    printf("Execution time (ms) strcmp_less %s: %llu\n", variant.second,
+           ts2 - ts1);
+    EXPECT_EQ(expected, result) << variant.second;
   }
-  unsigned long long ts3 = get_time_in_ms();
-  printf("Execution time (ms) strcmp: %llu strcmp_less: %llu\n", ts2 - ts1,
-         ts3 - ts2);
-  EXPECT_EQ(result1, result2);
 }
-#endif // defined(__SSE4_2__) && defined(__linux__) && defined(__STRCMP_LESS__)
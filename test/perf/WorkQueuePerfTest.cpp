@@ -7,7 +7,9 @@
 
 #include "WorkQueue.h"
 
+#include <algorithm>
 #include <chrono>
+#include <numeric>
 #include <random>
 #include <thread>
 
@@ -16,9 +18,14 @@
 //==========
 
 template <typename T>
-double calculate_speedup(std::vector<int>& wait_times, int num_threads) {
+double calculate_speedup(std::vector<int>& wait_times,
+                         int num_threads,
+                         bool work_stealing = false) {
   auto wq = workqueue_foreach<int>(
-      [](int a) { std::this_thread::sleep_for(T(a)); }, num_threads);
+      [](int a) { std::this_thread::sleep_for(T(a)); },
+      num_threads,
+      /*push_tasks_while_running=*/false,
+      work_stealing);
 
   for (auto& item : wait_times) {
     wq.add_item(item);
@@ -73,9 +80,76 @@ void smallLengthTasks() {
   printf("speedup small length tasks: %f\n", speedup);
 }
 
+/*
+ * Models a parallel pass over methods where a handful of huge methods
+ * dominate: a few long tasks buried behind many short ones. Ideally the wall
+ * time is bounded by the longest task, so we also report how far we are from
+ * that bound.
+ */
+template <typename T>
+double timed_run(const std::vector<int>& wait_times,
+                 int num_threads,
+                 bool work_stealing) {
+  auto wq = workqueue_foreach<int>(
+      [](int a) {
+        // Busy-wait rather than sleep: the tail latency we care about comes
+        // from cores being occupied, not from blocked threads.
+        auto end = std::chrono::high_resolution_clock::now() + T(a);
+        while (std::chrono::high_resolution_clock::now() < end) {
+        }
+      },
+      num_threads,
+      /*push_tasks_while_running=*/false,
+      work_stealing);
+  for (auto& item : wait_times) {
+    wq.add_item(item);
+  }
+  auto start = std::chrono::high_resolution_clock::now();
+  wq.run_all();
+  auto end = std::chrono::high_resolution_clock::now();
+  return std::chrono::duration_cast<T>(end - start).count();
+}
+
+void skewedLengthTasks() {
+  std::vector<int> times;
+  std::mt19937 gen(42);
+  std::uniform_int_distribution<int> small(100, 2000);
+  for (int i = 0; i < 20000; ++i) {
+    times.push_back(small(gen));
+  }
+  // A handful of giant tasks, all landing late in the queues.
+  for (int i = 0; i < 6; ++i) {
+    times.push_back(1000000);
+  }
+  double total = std::accumulate(times.begin(), times.end(), 0.0);
+  int num_threads = std::thread::hardware_concurrency();
+  double lower_bound = std::max(total / num_threads, 1000000.0);
+  for (bool work_stealing : {false, true}) {
+    double duration = timed_run<std::chrono::microseconds>(
+        times, num_threads, work_stealing);
+    printf("skewed length tasks (%s): %.0fus, %.2fx of lower bound\n",
+           work_stealing ? "work stealing" : "default",
+           duration,
+           duration / lower_bound);
+  }
+}
+
+void variableLengthTasksWorkStealing() {
+  std::vector<int> times;
+  for (int i = 0; i < 50; ++i) {
+    auto secs = rand() % 1000;
+    times.push_back(secs);
+  }
+  double speedup = calculate_speedup<std::chrono::milliseconds>(
+      times, 8, /*work_stealing=*/true);
+  printf("speedup variable length tasks (work stealing): %f\n", speedup);
+}
+
 int main() {
   printf("Begin!\n");
   profileBusyLoop();
   variableLengthTasks();
   smallLengthTasks();
+  variableLengthTasksWorkStealing();
+  skewedLengthTasks();
 }
@@ -0,0 +1,135 @@
+/*
+ * Copyright (c) Facebook, Inc. and its affiliates.
+ *
+ * This source code is licensed under the MIT license found in the
+ * LICENSE file in the root directory of this source tree.
+ */
+
+#include <gtest/gtest.h>
+
+#include <chrono>
+#include <cstdio>
+#include <sstream>
+#include <string>
+
+#include "ConstantPropagationAnalysis.h"
+#include "IRAssembler.h"
+#include "IRCode.h"
+#include "MonotonicFixpointIterator.h"
+#include "RedexTest.h"
+
+namespace cp = constant_propagation;
+
+namespace {
+
+/*
+ * Builds the body of a method with the given number of nested loops, each of
+ * which contains a diamond and increments its own counter.
+ */
+std::string make_method(size_t depth) {
+  std::ostringstream ss;
+  ss << "((load-param v0)";
+  for (size_t i = 1; i <= depth; ++i) {
+    ss << "(const v" << i << " 0)";
+    ss << "(:loop" << i << ")";
+    ss << "(if-ge v" << i << " v0 :end" << i << ")";
+    ss << "(if-eqz v" << i << " :else" << i << ")";
+    ss << "(const v" << depth + i << " 1)";
+    ss << "(goto :join" << i << ")";
+    ss << "(:else" << i << ")";
+    ss << "(const v" << depth + i << " 2)";
+    ss << "(:join" << i << ")";
+  }
+  for (size_t i = depth; i >= 1; --i) {
+    ss << "(add-int/lit8 v" << i << " v" << i << " 1)";
+    ss << "(goto :loop" << i << ")";
+    ss << "(:end" << i << ")";
+    if (i > 1) {
+      ss << "(const v" << i << " 0)";
+    }
+  }
+  ss << "(return v0))";
+  return ss.str();
+}
+
+/*
+ * Runs the intraprocedural constant propagation with the given iteration
+ * strategy, and counts the number of blocks analyzed.
+ */
+template <template <typename...> class Iterator>
+class CountingFixpointIterator final
+    : public Iterator<cfg::GraphInterface, ConstantEnvironment> {
+ public:
+  using NodeId = cfg::Block*;
+  using EdgeId = cfg::GraphInterface::EdgeId;
+
+  explicit CountingFixpointIterator(const cfg::ControlFlowGraph& cfg)
+      : Iterator<cfg::GraphInterface, ConstantEnvironment>(
+            cfg, cfg.blocks().size()),
+        m_analyzer(cfg, cp::ConstantPrimitiveAnalyzer()) {}
+
+  void analyze_node(const NodeId& block,
+                    ConstantEnvironment* current_state) const override {
+    ++m_analyzed_blocks;
+    m_analyzer.analyze_node(block, current_state);
+  }
+
+  ConstantEnvironment analyze_edge(
+      const EdgeId& edge,
+      const ConstantEnvironment& exit_state_at_source) const override {
+    return m_analyzer.analyze_edge(edge, exit_state_at_source);
+  }
+
+  size_t analyzed_blocks() const { return m_analyzed_blocks; }
+
+ private:
+  cp::intraprocedural::FixpointIterator m_analyzer;
+  mutable size_t m_analyzed_blocks{0};
+};
+
+template <template <typename...> class Iterator>
+void run_iterator(const char* name, const cfg::ControlFlowGraph& cfg) {
+  constexpr size_t kRuns = 100;
+  size_t analyzed_blocks = 0;
+  auto start = std::chrono::steady_clock::now();
+  for (size_t i = 0; i < kRuns; ++i) {
+    CountingFixpointIterator<Iterator> fp(cfg);
+    fp.run(ConstantEnvironment());
+    EXPECT_FALSE(fp.get_exit_state_at(cfg.exit_block()).is_bottom());
+    analyzed_blocks = fp.analyzed_blocks();
+  }
+  auto end = std::chrono::steady_clock::now();
+  printf("  %s: %zu blocks analyzed, %.3f ms per method\n",
+         name,
+         analyzed_blocks,
+         std::chrono::duration<double, std::milli>(end - start).count() /
+             kRuns);
+}
+
+} // namespace
+
+struct WorklistFixpointIteratorPerfTest : public RedexTest {};
+
+TEST_F(WorklistFixpointIteratorPerfTest, nestedLoops) {
+  for (size_t depth : {1, 2, 4, 6, 8}) {
+    auto code = assembler::ircode_from_string(make_method(depth));
+    code->build_cfg(/* editable */ false);
+    auto& cfg = code->cfg();
+    cfg.calculate_exit_block();
+    printf("%zu nested loops, %zu blocks:\n", depth, cfg.blocks().size());
+    run_iterator<sparta::WTOMonotonicFixpointIterator>("WTO", cfg);
+    run_iterator<sparta::MonotonicFixpointIterator>("WPO", cfg);
+    run_iterator<sparta::WorklistMonotonicFixpointIterator>("worklist", cfg);
+
+    // Both strategies reach the same invariants on these methods.
+    CountingFixpointIterator<sparta::MonotonicFixpointIterator> fp(cfg);
+    fp.run(ConstantEnvironment());
+    CountingFixpointIterator<sparta::WorklistMonotonicFixpointIterator>
+        worklist_fp(cfg);
+    worklist_fp.run(ConstantEnvironment());
+    for (auto* block : cfg.blocks()) {
+      EXPECT_EQ(fp.get_entry_state_at(block),
+                worklist_fp.get_entry_state_at(block));
+    }
+  }
+}
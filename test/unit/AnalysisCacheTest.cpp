@@ -0,0 +1,79 @@
+/*
+ * Copyright (c) Facebook, Inc. and its affiliates.
+ *
+ * This source code is licensed under the MIT license found in the
+ * LICENSE file in the root directory of this source tree.
+ */
+
+#include <gtest/gtest.h>
+
+#include "AnalysisCache.h"
+
+#include "CallGraph.h"
+#include "Creators.h"
+#include "DexClass.h"
+#include "MethodOverrideGraph.h"
+#include "RedexTest.h"
+
+struct AnalysisCacheTest : public RedexTest {
+  Scope m_scope;
+
+  AnalysisCacheTest() {
+    for (const char* name : {"LFoo;", "LBar;"}) {
+      ClassCreator creator(DexType::make_type(name));
+      creator.set_super(type::java_lang_Object());
+      m_scope.push_back(creator.create());
+    }
+  }
+};
+
+TEST_F(AnalysisCacheTest, reuse) {
+  AnalysisCache cache;
+  auto mog = cache.method_override_graph(m_scope);
+  EXPECT_EQ(mog, cache.method_override_graph(m_scope));
+
+  auto cg = cache.single_callee_graph(m_scope);
+  EXPECT_EQ(cg, cache.single_callee_graph(m_scope));
+  EXPECT_NE(cg, cache.complete_call_graph(m_scope));
+  // Building the call graphs reused the override graph.
+  EXPECT_EQ(mog, cache.method_override_graph(m_scope));
+}
+
+TEST_F(AnalysisCacheTest, invalidate) {
+  AnalysisCache cache;
+  auto mog = cache.method_override_graph(m_scope);
+  auto cg = cache.single_callee_graph(m_scope);
+  cache.invalidate();
+  EXPECT_NE(mog, cache.method_override_graph(m_scope));
+  EXPECT_NE(cg, cache.single_callee_graph(m_scope));
+
+  // The graphs handed out remain usable.
+  EXPECT_FALSE(cg->has_node(nullptr));
+}
+
+TEST_F(AnalysisCacheTest, different_scope) {
+  AnalysisCache cache;
+  auto mog = cache.method_override_graph(m_scope);
+  Scope smaller(m_scope.begin(), m_scope.begin() + 1);
+  auto smaller_mog = cache.method_override_graph(smaller);
+  EXPECT_NE(mog, smaller_mog);
+  EXPECT_EQ(smaller_mog, cache.method_override_graph(smaller));
+}
+
+TEST_F(AnalysisCacheTest, no_side_effects_methods) {
+  AnalysisCache cache;
+  std::unordered_set<DexMethodRef*> pure_methods;
+  auto methods = cache.no_side_effects_methods(m_scope, pure_methods);
+  EXPECT_EQ(methods, cache.no_side_effects_methods(m_scope, pure_methods));
+
+  // Different pure methods give a different result.
+  pure_methods.insert(DexMethod::make_method("LFoo;.bar:()V"));
+  auto other_methods = cache.no_side_effects_methods(m_scope, pure_methods);
+  EXPECT_NE(methods, other_methods);
+  EXPECT_EQ(other_methods,
+            cache.no_side_effects_methods(m_scope, pure_methods));
+
+  cache.invalidate();
+  EXPECT_NE(other_methods,
+            cache.no_side_effects_methods(m_scope, pure_methods));
+}
@@ -0,0 +1,51 @@
+/*
+ * Copyright (c) Facebook, Inc. and its affiliates.
+ *
+ * This source code is licensed under the MIT license found in the
+ * LICENSE file in the root directory of this source tree.
+ */
+
+#include <gtest/gtest.h>
+
+#include <atomic>
+#include <thread>
+#include <vector>
+
+#include "AtomicBitVector.h"
+
+TEST(AtomicBitVectorTest, testAndSet) {
+  AtomicBitVector bits(130);
+  EXPECT_EQ(130, bits.size());
+  for (size_t i : {0, 63, 64, 129}) {
+    EXPECT_FALSE(bits.test(i));
+    EXPECT_TRUE(bits.test_and_set(i));
+    EXPECT_TRUE(bits.test(i));
+    EXPECT_FALSE(bits.test_and_set(i));
+  }
+  EXPECT_FALSE(bits.test(1));
+  EXPECT_FALSE(bits.test(65));
+  // Bits past the end are never set.
+  EXPECT_FALSE(bits.test(130));
+}
+
+TEST(AtomicBitVectorTest, concurrentTestAndSet) {
+  constexpr size_t kBits = 10000;
+  constexpr size_t kThreads = 8;
+  AtomicBitVector bits(kBits);
+  std::atomic<size_t> wins{0};
+  std::vector<std::thread> threads;
+  for (size_t t = 0; t < kThreads; ++t) {
+    threads.emplace_back([&]() {
+      for (size_t i = 0; i < kBits; ++i) {
+        if (bits.test_and_set(i)) {
+          ++wins;
+        }
+      }
+    });
+  }
+  for (auto& thread : threads) {
+    thread.join();
+  }
+  // Exactly one thread wins each bit.
+  EXPECT_EQ(kBits, wins.load());
+}
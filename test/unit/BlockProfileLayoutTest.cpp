@@ -0,0 +1,145 @@
+/*
+ * Copyright (c) Facebook, Inc. and its affiliates.
+ *
+ * This source code is licensed under the MIT license found in the
+ * LICENSE file in the root directory of this source tree.
+ */
+
+#include <gtest/gtest.h>
+#include <unordered_set>
+
+#include "BlockProfileLayout.h"
+#include "ControlFlow.h"
+#include "IRAssembler.h"
+#include "IRCode.h"
+#include "RedexTest.h"
+
+class BlockProfileLayoutTest : public RedexTest {};
+
+namespace {
+
+const char* const kCode = R"(
+  (
+    (load-param v0)
+    (if-eqz v0 :hot)
+    (const v1 1)
+    (return v1)
+    (:hot)
+    (const v1 2)
+    (return v1)
+  )
+)";
+
+// All the blocks ran, except the ones that hold `const v1 <literal>`.
+basic_block_profiles::MethodCoverage coverage_without(
+    IRCode* code, const std::unordered_set<int64_t>& literals) {
+  basic_block_profiles::MethodCoverage coverage;
+  code->build_cfg(/* editable */ false);
+  const auto& blocks = code->cfg().blocks();
+  coverage.num_blocks = blocks.size();
+  coverage.vectors.resize((blocks.size() + 14) / 15);
+  for (auto* block : blocks) {
+    bool cold = false;
+    for (const auto& mie : InstructionIterable(block)) {
+      cold |= mie.insn->opcode() == OPCODE_CONST &&
+              literals.count(mie.insn->get_literal());
+    }
+    if (!cold) {
+      coverage.vectors[block->id() / 15] |= 1 << (block->id() % 15);
+    }
+  }
+  code->clear_cfg();
+  return coverage;
+}
+
+std::vector<IRInstruction*> instructions(IRCode* code) {
+  std::vector<IRInstruction*> insns;
+  for (const auto& mie : InstructionIterable(code)) {
+    insns.push_back(mie.insn);
+  }
+  return insns;
+}
+
+} // namespace
+
+TEST_F(BlockProfileLayoutTest, coldFallthroughMovesToEnd) {
+  auto code = assembler::ircode_from_string(kCode);
+  auto coverage = coverage_without(code.get(), {1});
+
+  auto stats = BlockProfileLayoutPass::process_code(code.get(), coverage);
+  EXPECT_EQ(stats.methods_laid_out, 1);
+  EXPECT_EQ(stats.cold_blocks, 1);
+
+  // The branch is inverted, so that the block that ran is the fallthrough.
+  auto insns = instructions(code.get());
+  ASSERT_EQ(insns.size(), 6);
+  EXPECT_EQ(insns[1]->opcode(), OPCODE_IF_NEZ);
+  EXPECT_EQ(insns[2]->opcode(), OPCODE_CONST);
+  EXPECT_EQ(insns[2]->get_literal(), 2);
+  EXPECT_EQ(insns[4]->opcode(), OPCODE_CONST);
+  EXPECT_EQ(insns[4]->get_literal(), 1);
+}
+
+TEST_F(BlockProfileLayoutTest, hotFallthroughStays) {
+  auto code = assembler::ircode_from_string(kCode);
+  auto expected = assembler::ircode_from_string(kCode);
+  auto coverage = coverage_without(code.get(), {2});
+
+  auto stats = BlockProfileLayoutPass::process_code(code.get(), coverage);
+  EXPECT_EQ(stats.cold_blocks, 1);
+  EXPECT_CODE_EQ(code.get(), expected.get());
+}
+
+TEST_F(BlockProfileLayoutTest, mismatchedProfile) {
+  auto code = assembler::ircode_from_string(kCode);
+  auto expected = assembler::ircode_from_string(kCode);
+  auto coverage = coverage_without(code.get(), {1});
+  coverage.num_blocks++;
+  coverage.vectors.resize((coverage.num_blocks + 14) / 15);
+
+  auto stats = BlockProfileLayoutPass::process_code(code.get(), coverage);
+  EXPECT_EQ(stats.methods_mismatched, 1);
+  EXPECT_EQ(stats.methods_laid_out, 0);
+  EXPECT_CODE_EQ(code.get(), expected.get());
+}
+
+TEST_F(BlockProfileLayoutTest, hotSwitchCaseIsHoisted) {
+  auto code = assembler::ircode_from_string(R"(
+    (
+      (load-param v0)
+      (switch v0 (:a :b :c :d))
+      (const v1 -1)
+      (return v1)
+      (:a 1)
+      (const v1 10)
+      (return v1)
+      (:b 2)
+      (const v1 20)
+      (return v1)
+      (:c 3)
+      (const v1 30)
+      (return v1)
+      (:d 4)
+      (const v1 40)
+      (return v1)
+    )
+  )");
+  auto coverage = coverage_without(code.get(), {10, 30, 40});
+
+  auto stats = BlockProfileLayoutPass::process_code(code.get(), coverage,
+                                                    /* max hoisted */ 1);
+  EXPECT_EQ(stats.hoisted_switch_cases, 1);
+  auto insns = instructions(code.get());
+  ASSERT_GE(insns.size(), 4);
+  EXPECT_EQ(insns[1]->opcode(), OPCODE_CONST);
+  EXPECT_EQ(insns[1]->get_literal(), 2);
+  EXPECT_EQ(insns[2]->opcode(), OPCODE_IF_EQ);
+  EXPECT_EQ(insns[2]->src(0), insns[0]->dest());
+  EXPECT_EQ(insns[2]->src(1), insns[1]->dest());
+  EXPECT_EQ(insns[3]->opcode(), OPCODE_SWITCH);
+
+  // Not when more cases ran.
+  stats = BlockProfileLayoutPass::process_code(
+      code.get(), coverage_without(code.get(), {10}), 1);
+  EXPECT_EQ(stats.hoisted_switch_cases, 0);
+}
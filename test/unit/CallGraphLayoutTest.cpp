@@ -0,0 +1,41 @@
+/*
+ * Copyright (c) Facebook, Inc. and its affiliates.
+ *
+ * This source code is licensed under the MIT license found in the
+ * LICENSE file in the root directory of this source tree.
+ */
+
+#include <gtest/gtest.h>
+
+#include "CallGraphLayout.h"
+
+using namespace call_graph_layout;
+
+TEST(CallGraphLayoutTest, calleesFollowTheirHottestCaller) {
+  // 0 calls 1 and 2, but 2 is called more often by 3.
+  std::vector<Node> nodes{{100, 10}, {100, 5}, {100, 8}, {100, 9}};
+  std::vector<Edge> edges{{0, 1, 50}, {0, 2, 1}, {3, 2, 20}};
+  auto order = cluster(nodes, edges);
+  EXPECT_EQ(order, (std::vector<uint32_t>{3, 2, 0, 1}));
+}
+
+TEST(CallGraphLayoutTest, clustersDontExceedThePageSize) {
+  std::vector<Node> nodes{{3000, 1}, {2000, 10}, {1000, 5}};
+  std::vector<Edge> edges{{0, 1, 10}, {0, 2, 10}};
+  auto order = cluster(nodes, edges);
+  // 1 is hottest but doesn't fit with 0; 2 does.
+  EXPECT_EQ(order, (std::vector<uint32_t>{1, 0, 2}));
+}
+
+TEST(CallGraphLayoutTest, duplicateEdgesAreSummed) {
+  std::vector<Node> nodes{{30, 1}, {10, 1}, {10, 1}};
+  std::vector<Edge> edges{{0, 2, 3}, {1, 2, 2}, {1, 2, 2}};
+  auto order = cluster(nodes, edges);
+  EXPECT_EQ(order, (std::vector<uint32_t>{1, 2, 0}));
+}
+
+TEST(CallGraphLayoutTest, unconnectedNodesAreOrderedByDensity) {
+  std::vector<Node> nodes{{100, 1}, {10, 1}, {100, 50}};
+  auto order = cluster(nodes, {});
+  EXPECT_EQ(order, (std::vector<uint32_t>{2, 1, 0}));
+}
@@ -0,0 +1,71 @@
+/*
+ * Copyright (c) Facebook, Inc. and its affiliates.
+ *
+ * This source code is licensed under the MIT license found in the
+ * LICENSE file in the root directory of this source tree.
+ */
+
+#include <gtest/gtest.h>
+
+#include "CallSiteIndex.h"
+
+#include "Creators.h"
+#include "DexClass.h"
+#include "IRAssembler.h"
+#include "RedexTest.h"
+
+using namespace call_site_index;
+
+struct CallSiteIndexTest : public RedexTest {
+  DexClass* m_class;
+  Scope m_scope;
+
+  CallSiteIndexTest() {
+    auto type = DexType::make_type("LFoo;");
+    ClassCreator creator(type);
+    creator.set_super(type::java_lang_Object());
+    m_class = creator.create();
+    m_scope.push_back(m_class);
+  }
+
+  DexMethod* make_method(const std::string& name, const std::string& body) {
+    auto method = assembler::method_from_string(
+        "(method (public static) \"LFoo;." + name + ":()V\" " + body + ")");
+    m_class->add_method(method);
+    return method;
+  }
+};
+
+TEST_F(CallSiteIndexTest, callSites) {
+  auto callee = make_method("callee", "((return-void))");
+  auto other = make_method("other", "((return-void))");
+  auto caller = make_method("caller",
+                            "((invoke-static () \"LFoo;.callee:()V\") "
+                            "(invoke-static () \"LFoo;.callee:()V\") "
+                            "(invoke-static () \"LFoo;.other:()V\") "
+                            "(return-void))");
+
+  CallSiteIndex index(m_scope);
+  EXPECT_EQ(index.get_callees().size(), 2);
+  const auto& call_sites = index.get_call_sites(callee);
+  ASSERT_EQ(call_sites.size(), 2);
+  EXPECT_EQ(call_sites[0].caller, caller);
+  EXPECT_EQ(call_sites[0].invoke->insn->get_method(), callee);
+  EXPECT_EQ(index.get_call_sites(other).size(), 1);
+  EXPECT_TRUE(index.get_call_sites(caller).empty());
+
+  // Redirect the invokes of callee to other.
+  for (const auto& call_site : call_sites) {
+    call_site.invoke->insn->set_method(other);
+  }
+  index.move_call_sites(callee, other);
+  EXPECT_TRUE(index.get_call_sites(callee).empty());
+  EXPECT_EQ(index.get_call_sites(other).size(), 3);
+
+  // Drop an invoke and re-index the caller.
+  caller->get_code()->remove_opcode(
+      index.get_call_sites(other).front().invoke->insn);
+  index.update_callers({caller});
+  EXPECT_EQ(index.get_call_sites(other).size(), 2);
+  EXPECT_EQ(index.get_callees().size(), 1);
+}
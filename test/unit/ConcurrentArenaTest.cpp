@@ -0,0 +1,56 @@
+/*
+ * Copyright (c) Facebook, Inc. and its affiliates.
+ *
+ * This source code is licensed under the MIT license found in the
+ * LICENSE file in the root directory of this source tree.
+ */
+
+#include "ConcurrentArena.h"
+
+#include <cstdint>
+#include <cstring>
+#include <gtest/gtest.h>
+#include <vector>
+
+#include <boost/thread/thread.hpp>
+
+TEST(ConcurrentArenaTest, concurrentAllocations) {
+  constexpr size_t kThreads = 8;
+  constexpr size_t kAllocations = 10000;
+  // Small chunks, so that threads keep racing to start new ones.
+  ConcurrentArena arena(1024);
+  std::vector<std::vector<char*>> results(kThreads);
+  std::vector<boost::thread> threads;
+  for (size_t t = 0; t < kThreads; ++t) {
+    threads.emplace_back([&arena, &results, t]() {
+      for (size_t i = 0; i < kAllocations; ++i) {
+        size_t size = 1 + (i % 100);
+        auto p = static_cast<char*>(arena.allocate(size));
+        EXPECT_EQ(0, reinterpret_cast<uintptr_t>(p) %
+                         ConcurrentArena::ALIGNMENT);
+        memset(p, static_cast<int>(t), size);
+        results[t].push_back(p);
+      }
+    });
+  }
+  for (auto& thread : threads) {
+    thread.join();
+  }
+  // Nobody overwrote anybody else's memory.
+  for (size_t t = 0; t < kThreads; ++t) {
+    for (size_t i = 0; i < kAllocations; ++i) {
+      size_t size = 1 + (i % 100);
+      for (size_t j = 0; j < size; ++j) {
+        ASSERT_EQ(static_cast<char>(t), results[t][i][j]);
+      }
+    }
+  }
+  EXPECT_GE(arena.reserved_bytes(), kThreads * kAllocations);
+}
+
+TEST(ConcurrentArenaTest, largeAllocation) {
+  ConcurrentArena arena(64);
+  auto p = static_cast<char*>(arena.allocate(4096));
+  memset(p, 1, 4096);
+  EXPECT_GE(arena.reserved_bytes(), 4096);
+}
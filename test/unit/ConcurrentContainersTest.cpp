@@ -216,6 +216,53 @@ TEST_F(ConcurrentContainersTest, insertOnlyConcurrentSetTest) {
   }
 }
 
+TEST_F(ConcurrentContainersTest, insertOnlyConcurrentMapTest) {
+  // Start small, so that the table has to grow while being filled.
+  InsertOnlyConcurrentMap<uint32_t, std::string> map(16);
+
+  run_on_subset_samples([&map](const std::vector<uint32_t>& sample) {
+    for (size_t i = 0; i < sample.size(); ++i) {
+      map.emplace(sample[i], std::to_string(sample[i]));
+      EXPECT_EQ(1, map.count(sample[i]));
+    }
+  });
+  EXPECT_EQ(m_subset_data_set.size(), map.size());
+  for (uint32_t x : m_subset_data) {
+    auto value = map.get(x);
+    ASSERT_NE(nullptr, value);
+    EXPECT_EQ(std::to_string(x), *value);
+  }
+
+  // Check that pointers/references are stable.
+  std::vector<std::pair<const std::string*, uint32_t>> pointers;
+  for (uint32_t x : m_subset_data) {
+    auto res = map.emplace(x, "ignored");
+    EXPECT_FALSE(res.second);
+    pointers.emplace_back(res.first, x);
+  }
+
+  run_on_samples([&map](const std::vector<uint32_t>& sample) {
+    for (size_t i = 0; i < sample.size(); ++i) {
+      map.emplace(sample[i], std::to_string(sample[i]));
+      EXPECT_NE(nullptr, map.get(sample[i]));
+    }
+  });
+  EXPECT_EQ(m_data_set.size(), map.size());
+
+  for (const auto& pair : pointers) {
+    EXPECT_EQ(std::to_string(pair.second), *pair.first);
+    EXPECT_EQ(pair.first, map.get(pair.second));
+  }
+
+  std::unordered_set<uint32_t> keys;
+  for (const auto& p : map) {
+    EXPECT_EQ(std::to_string(p.first), p.second);
+    keys.insert(p.first);
+  }
+  EXPECT_EQ(m_data_set, keys);
+  EXPECT_EQ(nullptr, map.get(1000000001));
+}
+
 TEST_F(ConcurrentContainersTest, concurrentMapTest) {
   ConcurrentMap<std::string, uint32_t> map;
 
@@ -530,3 +530,26 @@ TEST_F(ConfigurableTest, RequiredBinds) {
     EXPECT_EQ(DexType::get_type(type1), c.m_type_param);
   }
 }
+
+TEST_F(ConfigurableTest, JsonWrapperLookups) {
+  Json::Value json;
+  json["int_param"] = 3;
+  json["str_param"] = "foo";
+  json["null_param"] = Json::nullValue;
+  JsonWrapper original(json);
+  // The copy has to look into its own config, not into the original one.
+  JsonWrapper copy(JsonWrapper{json});
+  copy = original;
+  for (const auto* wrapper : {&original, &copy}) {
+    int64_t int_param;
+    wrapper->get("int_param", 0, int_param);
+    EXPECT_EQ(3, int_param);
+    EXPECT_EQ("foo", wrapper->get("str_param", std::string("bar")));
+    EXPECT_EQ("bar", wrapper->get("missing", std::string("bar")));
+    EXPECT_TRUE(wrapper->contains("null_param"));
+    EXPECT_FALSE(wrapper->contains("missing"));
+    ASSERT_NE(nullptr, wrapper->find("int_param"));
+    EXPECT_EQ(nullptr, wrapper->find("missing"));
+    EXPECT_TRUE((*wrapper)["missing"].isNull());
+  }
+}
@@ -10,9 +10,11 @@
 
 #include "ControlFlow.h"
 #include "DexAsm.h"
+#include "Dominators.h"
 #include "IRAssembler.h"
 #include "IRCode.h"
 #include "RedexTest.h"
+#include "WeakPartialOrdering.h"
 
 namespace cfg {
 
@@ -2215,3 +2217,108 @@ TEST_F(ControlFlowTest, get_param_instructions_empty) {
 
   EXPECT_TRUE(cfg.get_param_instructions().empty());
 }
+
+TEST_F(ControlFlowTest, weak_partial_ordering_cache) {
+  auto code = assembler::ircode_from_string(R"(
+    (
+      (load-param v0)
+      (if-eqz v0 :true)
+      (const v1 1)
+      (:true)
+      (return v0)
+    )
+  )");
+
+  code->build_cfg(/* editable */ true);
+  auto& cfg = code->cfg();
+  cfg.calculate_exit_block();
+
+  auto wpo = cfg.weak_partial_ordering();
+  EXPECT_EQ(cfg.blocks().size(), wpo->size());
+  EXPECT_EQ(cfg.entry_block(), wpo->get_node(wpo->get_entry()));
+  EXPECT_EQ(wpo, cfg.weak_partial_ordering());
+  auto backwards_wpo = cfg.backwards_weak_partial_ordering();
+  EXPECT_EQ(cfg.exit_block(),
+            backwards_wpo->get_node(backwards_wpo->get_entry()));
+  EXPECT_EQ(backwards_wpo, cfg.backwards_weak_partial_ordering());
+
+  // Changing the edges of the graph invalidates both orderings.
+  cfg.delete_edge(
+      cfg.get_succ_edge_of_type(cfg.entry_block(), cfg::EDGE_BRANCH));
+  EXPECT_NE(wpo, cfg.weak_partial_ordering());
+  EXPECT_EQ(cfg.blocks().size(), cfg.weak_partial_ordering()->size());
+  EXPECT_NE(backwards_wpo, cfg.backwards_weak_partial_ordering());
+}
+
+TEST_F(ControlFlowTest, blockIdsAfterRemoval) {
+  ControlFlowGraph cfg;
+  auto b0 = cfg.create_block();
+  auto b1 = cfg.create_block();
+  auto b2 = cfg.create_block();
+  cfg.set_entry_block(b0);
+  cfg.add_edge(b0, b2, EDGE_GOTO);
+  cfg.remove_block(b1);
+
+  // The ids of the remaining blocks are kept, and the hole is skipped.
+  EXPECT_EQ(cfg.blocks(), (std::vector<Block*>{b0, b2}));
+
+  // Removing the block with the largest id allows its id to be reused.
+  cfg.remove_block(b2);
+  auto b3 = cfg.create_block();
+  EXPECT_EQ(b3->id(), 1);
+  EXPECT_EQ(cfg.blocks(), (std::vector<Block*>{b0, b3}));
+}
+
+TEST_F(ControlFlowTest, orderAfterStructuralChange) {
+  auto code = assembler::ircode_from_string(R"(
+    (
+      (load-param v0)
+      (if-eqz v0 :true)
+      (const v0 1)
+      (:true)
+      (return-void)
+    )
+  )");
+  code->build_cfg(/* editable */ true);
+  auto& cfg = code->cfg();
+  auto order = cfg.order();
+  EXPECT_EQ(order.size(), cfg.blocks().size());
+  EXPECT_EQ(cfg.order(), order);
+
+  // A split block is part of the next order.
+  auto entry = cfg.entry_block();
+  auto b = cfg.split_block(entry->to_cfg_instruction_iterator(
+      entry->get_first_insn()));
+  order = cfg.order();
+  EXPECT_EQ(order.size(), cfg.blocks().size());
+  EXPECT_THAT(order, ::testing::Contains(b));
+  code->clear_cfg();
+}
+
+TEST_F(ControlFlowTest, cachedDominators) {
+  auto code = assembler::ircode_from_string(R"(
+    (
+      (load-param v0)
+      (if-eqz v0 :true)
+      (const v0 1)
+      (:true)
+      (return-void)
+    )
+  )");
+  code->build_cfg(/* editable */ true);
+  auto& cfg = code->cfg();
+  auto entry = cfg.entry_block();
+  auto doms = cfg.dominators();
+  EXPECT_EQ(cfg.dominators(), doms);
+  for (auto* b : cfg.blocks()) {
+    EXPECT_EQ(doms->get_idom(b), entry);
+  }
+
+  // Editing instructions keeps the dominators, changing edges drops them.
+  cfg.blocks().back()->push_front(dasm(OPCODE_CONST, {1_v, 0_L}));
+  EXPECT_EQ(cfg.dominators(), doms);
+  cfg.split_block(entry->to_cfg_instruction_iterator(entry->get_first_insn()));
+  EXPECT_NE(cfg.dominators(), doms);
+  EXPECT_EQ(cfg.dominators()->get_idom(cfg.entry_block()), cfg.entry_block());
+  code->clear_cfg();
+}
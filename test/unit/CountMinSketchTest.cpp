@@ -0,0 +1,39 @@
+/*
+ * Copyright (c) Facebook, Inc. and its affiliates.
+ *
+ * This source code is licensed under the MIT license found in the
+ * LICENSE file in the root directory of this source tree.
+ */
+
+#include <gtest/gtest.h>
+#include <limits>
+
+#include "CountMinSketch.h"
+
+using namespace outliner_impl;
+
+TEST(CountMinSketchTest, estimatesAreUpperBounds) {
+  CountMinSketch sketch(4, 1 << 10);
+  for (size_t key = 0; key < 5000; key++) {
+    sketch.add(key * 7919, key % 5 + 1);
+  }
+  for (size_t key = 0; key < 5000; key++) {
+    EXPECT_GE(sketch.estimate(key * 7919), key % 5 + 1);
+  }
+}
+
+TEST(CountMinSketchTest, exactWithoutCollisions) {
+  CountMinSketch sketch(4, 1 << 16);
+  sketch.add(1, 3);
+  sketch.add(2, 5);
+  sketch.add(1, 4);
+  EXPECT_EQ(7, sketch.estimate(1));
+  EXPECT_EQ(5, sketch.estimate(2));
+}
+
+TEST(CountMinSketchTest, saturates) {
+  CountMinSketch sketch(2, 64);
+  sketch.add(3, std::numeric_limits<uint32_t>::max() - 10);
+  sketch.add(3, 100);
+  EXPECT_EQ(std::numeric_limits<uint32_t>::max(), sketch.estimate(3));
+}
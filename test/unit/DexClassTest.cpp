@@ -66,3 +66,62 @@ TEST_F(DexClassTest, testUniqueTypeName) {
   EXPECT_EQ(foor1_type->str(), "LFoor$1;");
   EXPECT_EQ(foor0r0_type->str(), "LFoor$0r$0;");
 }
+
+TEST_F(DexClassTest, testMutateMethods) {
+  auto a = DexMethod::make_method("LFoo;.a:()V");
+  auto b = DexMethod::make_method("LFoo;.b:()V");
+  std::vector<std::pair<DexMethodRef*, DexMethodSpec>> mutations;
+  DexMethodSpec spec;
+  // The mutations are applied in order, so a can take the name of b.
+  spec.name = DexString::make_string("c");
+  mutations.emplace_back(b, spec);
+  spec.name = DexString::make_string("b");
+  mutations.emplace_back(a, spec);
+  g_redex->mutate_methods(mutations,
+                          false /* rename on collision */,
+                          false /* update deobfuscated name */);
+  EXPECT_EQ(DexMethod::get_method("LFoo;.b:()V"), a);
+  EXPECT_EQ(DexMethod::get_method("LFoo;.c:()V"), b);
+  EXPECT_EQ(DexMethod::get_method("LFoo;.a:()V"), nullptr);
+}
+
+TEST_F(DexClassTest, testDescriptorIndex) {
+  auto a = DexMethod::make_method("LFoo;.a:(I)V");
+  auto f = DexField::make_field("LFoo;.f:I");
+  g_redex->build_descriptor_index();
+  EXPECT_EQ(g_redex->find_indexed_method("LFoo;.a:(I)V"), a);
+  EXPECT_EQ(g_redex->find_indexed_field("LFoo;.f:I"), f);
+  EXPECT_EQ(DexMethod::get_method("LFoo;.a:(I)V"), a);
+  EXPECT_EQ(DexField::get_field("LFoo;.f:I"), f);
+
+  // Members made after the index are still found, through the slow path.
+  auto b = DexMethod::make_method("LFoo;.b:()V");
+  EXPECT_EQ(g_redex->find_indexed_method("LFoo;.b:()V"), nullptr);
+  EXPECT_EQ(DexMethod::get_method("LFoo;.b:()V"), b);
+
+  // A rename drops the index, which would otherwise find a by its old name.
+  DexMethodSpec spec;
+  spec.name = DexString::make_string("c");
+  a->change(spec,
+            false /* rename on collision */,
+            false /* update deobfuscated name */);
+  EXPECT_EQ(g_redex->find_indexed_method("LFoo;.c:(I)V"), nullptr);
+  EXPECT_EQ(DexMethod::get_method("LFoo;.a:(I)V"), nullptr);
+  EXPECT_EQ(DexMethod::get_method("LFoo;.c:(I)V"), a);
+}
+
+TEST_F(DexClassTest, testShowDescriptors) {
+  auto method = DexMethod::make_method("LFoo;.bar:(I[LFoo;)LBar;");
+  EXPECT_EQ(show(method), "LFoo;.bar:(I[LFoo;)LBar;");
+  std::string out = "method ";
+  append_show(&out, method);
+  EXPECT_EQ(out, "method LFoo;.bar:(I[LFoo;)LBar;");
+
+  ClassCreator creator(DexType::make_type("LFoo;"));
+  creator.set_super(type::java_lang_Object());
+  auto cls = creator.create();
+  cls->set_deobfuscated_name("Lcom/Foo;");
+  EXPECT_EQ(show_deobfuscated(DexType::make_type("[[LFoo;")), "[[Lcom/Foo;");
+  EXPECT_EQ(show_deobfuscated(DexType::make_type("[I")), "[I");
+  EXPECT_EQ(show_deobfuscated(method), "Lcom/Foo;.bar:(I[Lcom/Foo;)LBar;");
+}
@@ -9,6 +9,10 @@
 #include <gtest/gtest.h>
 #include <json/json.h>
 
+#include "RedexTest.h"
+
+struct DexOutputLocatorTest : public RedexTest {};
+
 TEST(DexOutput, checkMethodInstructionSizeLimit) {
 
   Json::Value json_cfg;
@@ -24,3 +28,66 @@ TEST(DexOutput, checkMethodInstructionSizeLimit) {
       DexOutput::check_method_instruction_size_limit(conf, 65537, "method"),
       RedexException);
 }
+
+TEST(DexOutput, packHotCodeItems) {
+  // The first page has 100 bytes left, which only the cold item of 96 bytes
+  // (rounded up from 94) fits into.
+  std::vector<uint32_t> sizes{200, 94, 3000, 3000, 102};
+  std::vector<bool> is_hot{false, false, true, true, false};
+  EXPECT_EQ(pack_hot_code_items(3996, sizes, is_hot),
+            (std::vector<size_t>{1, 2, 3, 0, 4}));
+
+  // Hot items that fit before the page boundary are not moved after it.
+  std::vector<uint32_t> small_sizes{50, 20};
+  std::vector<bool> small_hot{false, true};
+  EXPECT_EQ(pack_hot_code_items(3996, small_sizes, small_hot),
+            (std::vector<size_t>{1, 0}));
+}
+
+TEST_F(DexOutputLocatorTest, locatorIndex) {
+  auto a = DexString::make_string("LA;");
+  auto b = DexString::make_string("LB;");
+  auto c = DexString::make_string("LC;");
+  LocatorIndex index({{c, 1, 2, 3}, {a, 0, 1, 0}});
+  EXPECT_EQ(index.size(), 2);
+  EXPECT_EQ(index.find(b), nullptr);
+  auto entry = index.find(c);
+  ASSERT_NE(entry, nullptr);
+  auto locator = entry->locator();
+  EXPECT_EQ(locator.strnr, 1);
+  EXPECT_EQ(locator.dexnr, 2);
+  EXPECT_EQ(locator.clsnr, 3);
+  ASSERT_NE(index.find(a), nullptr);
+  EXPECT_EQ(index.find(a)->dexnr, 1);
+}
+
+TEST(DexOutput, decodeLocatorsInBatch) {
+  std::vector<Locator> locators;
+  for (uint32_t i = 0; i < 40; i++) {
+    locators.push_back(Locator::make(i % 3, i % 64, i * 25000));
+  }
+  std::vector<std::string> encoded;
+  for (auto& locator : locators) {
+    char buf[Locator::encoded_max];
+    locator.encode(buf);
+    // Locators are preceded by their uleb length in the string table, which
+    // stops the backward decoding.
+    encoded.push_back(std::string(1, '\0') + buf);
+  }
+  std::vector<const char*> ends;
+  for (const auto& s : encoded) {
+    ends.push_back(s.c_str() + s.size());
+  }
+  std::vector<uint32_t> strnrs(ends.size());
+  std::vector<uint32_t> dexnrs(ends.size());
+  std::vector<uint32_t> clsnrs(ends.size());
+  Locator::decodeBackwardBatch(ends.data(), ends.size(), strnrs.data(),
+                               dexnrs.data(), clsnrs.data());
+  for (size_t i = 0; i < locators.size(); i++) {
+    auto single = Locator::decodeBackward(ends[i]);
+    EXPECT_EQ(strnrs[i], locators[i].strnr);
+    EXPECT_EQ(dexnrs[i], locators[i].dexnr);
+    EXPECT_EQ(clsnrs[i], locators[i].clsnr);
+    EXPECT_EQ(clsnrs[i], single.clsnr);
+  }
+}
@@ -0,0 +1,44 @@
+/*
+ * Copyright (c) Facebook, Inc. and its affiliates.
+ *
+ * This source code is licensed under the MIT license found in the
+ * LICENSE file in the root directory of this source tree.
+ */
+
+#include <gtest/gtest.h>
+
+#include "DexClass.h"
+#include "DexPosition.h"
+#include "RedexTest.h"
+
+struct DexPositionTest : public RedexTest {};
+
+TEST_F(DexPositionTest, internSharesParentChains) {
+  auto method = DexString::make_string("LFoo;.bar:()V");
+  auto file = DexString::make_string("Foo.java");
+
+  // The same callee position, inlined at two call sites of the same line.
+  DexPosition call_site1(method, file, 10);
+  DexPosition call_site2(method, file, 10);
+  DexPosition inlined1(method, file, 20);
+  inlined1.parent = &call_site1;
+  DexPosition inlined2(method, file, 20);
+  inlined2.parent = &call_site2;
+  DexPosition other(method, file, 30);
+  other.parent = &call_site2;
+
+  PositionTable table;
+  auto index1 = table.intern(&inlined1);
+  EXPECT_EQ(table.size(), 2);
+  EXPECT_EQ(table.intern(&inlined2), index1);
+  EXPECT_EQ(table.intern(&call_site2), table.intern(&call_site1));
+  EXPECT_EQ(table.size(), 2);
+
+  auto other_index = table.intern(&other);
+  EXPECT_NE(other_index, index1);
+  EXPECT_EQ(table.size(), 3);
+  EXPECT_EQ(table.at(other_index).line, 30);
+  EXPECT_EQ(table.at(other_index).parent, table.at(index1).parent);
+  EXPECT_EQ(table.at(table.at(index1).parent).parent,
+            PositionTable::NO_PARENT);
+}
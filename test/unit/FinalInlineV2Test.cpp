@@ -186,20 +186,38 @@ TEST_F(FinalInlineTest, dominatedSget) {
   )"));
   auto cls = m_cc->create();
 
-  // This could be further optimized to remove the sput to the field bar. This
-  // test illustrates that we are being overly conservative if a field is
-  // ever read in its <clinit>. In practice though this rarely occurs.
-  auto expected = assembler::ircode_from_string(R"(
-    (
+  FinalInlinePassV2::run({cls}, /* xstores */ nullptr);
+  // Both writes are made redundant by the encoded values.
+  EXPECT_EQ(cls->get_clinit(), nullptr);
+  EXPECT_EQ(field_bar->get_static_value()->value(), 1);
+  EXPECT_EQ(field_baz->get_static_value()->value(), 1);
+}
+
+TEST_F(FinalInlineTest, undominatedSget) {
+  auto field_bar = create_field_with_zero_value("LFoo;.bar:I");
+  auto field_baz = create_field_with_zero_value("LFoo;.baz:I");
+  m_cc->add_method(assembler::method_from_string(R"(
+    (method (public static) "LFoo;.<clinit>:()V"
+     (
+      (invoke-static () "LBar;.flag:()Z")
+      (move-result v1)
+      (if-eqz v1 :skip)
+      (const v0 1)
+      (sput v0 "LFoo;.bar:I")
+      (:skip)
+      (sget "LFoo;.bar:I")
+      (move-result-pseudo v0)
+      (sput v0 "LFoo;.baz:I")
       (const v0 1)
       (sput v0 "LFoo;.bar:I")
       (return-void)
+     )
     )
-  )");
+  )"));
+  auto cls = m_cc->create();
 
-  auto original = assembler::to_s_expr(cls->get_clinit()->get_code());
+  // The read may see the initial value of bar, so it must stay zero.
   FinalInlinePassV2::run({cls}, /* xstores */ nullptr);
-  EXPECT_CODE_EQ(cls->get_clinit()->get_code(), expected.get());
+  EXPECT_NE(cls->get_clinit(), nullptr);
   EXPECT_EQ(field_bar->get_static_value()->value(), 0);
-  EXPECT_EQ(field_baz->get_static_value()->value(), 1);
 }
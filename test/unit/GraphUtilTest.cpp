@@ -85,3 +85,15 @@ TEST(GraphUtilTest, postorder_tree_crossedge) {
   const auto& sorted = postorder_sort<GraphInterface>(graph);
   EXPECT_EQ(sorted, std::vector<uint32_t>({2, 4, 3, 1, 0}));
 }
+
+/*
+ *  0 -> 1 <-> 2 -> 3
+ *       ^
+ *  4 ---+     5 -> 5
+ */
+TEST(GraphUtilTest, strongly_connected_components) {
+  std::vector<std::vector<uint32_t>> successors{{1}, {2}, {1, 3}, {}, {1}, {5}};
+  auto components = strongly_connected_components(successors);
+  std::vector<std::vector<uint32_t>> expected{{3}, {2, 1}, {0}, {4}, {5}};
+  EXPECT_EQ(components, expected);
+}
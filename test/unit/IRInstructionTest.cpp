@@ -395,3 +395,29 @@ TEST_F(IRInstructionTest, InvokeSourceIsWideComplex2) {
   EXPECT_FALSE(insn->invoke_src_is_wide(3));
   EXPECT_TRUE(insn->invoke_src_is_wide(4));
 }
+
+TEST_F(IRInstructionTest, ResizeSources) {
+  IRInstruction insn(OPCODE_INVOKE_STATIC);
+  EXPECT_EQ(24, sizeof(IRInstruction));
+  insn.set_srcs_size(2);
+  insn.set_src(0, 1);
+  insn.set_src(1, 2);
+
+  // Growing past the inline sources keeps the existing ones, and the new
+  // ones are zero.
+  insn.set_srcs_size(5);
+  EXPECT_EQ(std::vector<reg_t>({1, 2, 0, 0, 0}), insn.srcs_vec());
+  insn.set_src(4, 5);
+
+  IRInstruction copy(insn);
+  EXPECT_EQ(insn, copy);
+  copy.set_srcs_size(3);
+  EXPECT_EQ(std::vector<reg_t>({1, 2, 0}), copy.srcs_vec());
+  copy.set_srcs_size(1);
+  EXPECT_EQ(std::vector<reg_t>({1}), copy.srcs_vec());
+  EXPECT_EQ(std::vector<reg_t>({1, 2, 0, 0, 5}), insn.srcs_vec());
+
+  insn.set_srcs_size(0);
+  EXPECT_EQ(0, insn.srcs_size());
+  EXPECT_TRUE(insn.srcs().empty());
+}
@@ -134,3 +134,44 @@ TEST_F(IRListTest, keep_valid_regs) {
   EXPECT_EQ(assembler::to_string(expected_code.get()),
             assembler::to_string(code.get()));
 }
+
+TEST_F(IRListTest, clone_keeps_branch_and_catch_links) {
+  auto code = assembler::ircode_from_string(R"(
+    (
+      (load-param v0)
+      (.try_start foo)
+      (const v1 0)
+      (switch v0 (:a :b))
+      (if-gtz v0 :a)
+      (throw v0)
+      (.try_end foo)
+
+      (.catch (foo bar) "LFoo;")
+      (.catch (bar) "LBar;")
+      (return v1)
+
+      (:a 0)
+      (const v1 1)
+      (goto :b)
+
+      (:b 1)
+      (return v1)
+    )
+  )");
+  IRCode copy(*code);
+  EXPECT_EQ(assembler::to_string(code.get()), assembler::to_string(&copy));
+
+  std::unordered_set<const MethodItemEntry*> copied_entries;
+  for (const auto& mie : copy) {
+    copied_entries.insert(&mie);
+  }
+  for (const auto& mie : copy) {
+    if (mie.type == MFLOW_TARGET) {
+      EXPECT_EQ(copied_entries.count(mie.target->src), 1);
+    } else if (mie.type == MFLOW_TRY && mie.tentry->type == TRY_START) {
+      EXPECT_EQ(copied_entries.count(mie.tentry->catch_start), 1);
+    } else if (mie.type == MFLOW_CATCH && mie.centry->next != nullptr) {
+      EXPECT_EQ(copied_entries.count(mie.centry->next), 1);
+    }
+  }
+}
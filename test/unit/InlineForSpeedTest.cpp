@@ -0,0 +1,64 @@
+/*
+ * Copyright (c) Facebook, Inc. and its affiliates.
+ *
+ * This source code is licensed under the MIT license found in the
+ * LICENSE file in the root directory of this source tree.
+ */
+
+#include <gtest/gtest.h>
+
+#include "ControlFlow.h"
+#include "IRAssembler.h"
+#include "IRCode.h"
+#include "InlineForSpeed.h"
+#include "RedexTest.h"
+
+class InlineForSpeedTest : public RedexTest {};
+
+TEST_F(InlineForSpeedTest, callSiteWeights) {
+  auto callee = [](const std::string& name) {
+    return assembler::method_from_string("(method (public static) \"LFoo;." +
+                                         name + ":()V\" ((return-void)))");
+  };
+  auto once = callee("once");
+  auto looped = callee("looped");
+  auto nested = callee("nested");
+  auto cold = callee("cold");
+  auto caller = assembler::method_from_string(R"(
+    (method (public static) "LFoo;.caller:(I)V"
+      (
+        (load-param v0)
+        (invoke-static () "LFoo;.once:()V")
+        (invoke-static () "LFoo;.looped:()V")
+        (:outer)
+        (invoke-static () "LFoo;.looped:()V")
+        (:inner)
+        (invoke-static () "LFoo;.nested:()V")
+        (invoke-static () "LFoo;.cold:()V")
+        (add-int/lit8 v0 v0 -1)
+        (if-nez v0 :inner)
+        (if-gez v0 :outer)
+        (return-void)
+      )
+    )
+  )");
+  assembler::class_with_methods("LFoo;", {once, looped, nested, cold, caller});
+
+  auto code = caller->get_code();
+  std::unordered_set<const IRInstruction*> cold_insns;
+  for (const auto& mie : InstructionIterable(code)) {
+    if (mie.insn->has_method() && mie.insn->get_method() == cold) {
+      cold_insns.insert(mie.insn);
+    }
+  }
+  code->build_cfg(/* editable */ true);
+  InlineForSpeed inline_for_speed(nullptr, &cold_insns);
+  auto weights = inline_for_speed.get_call_site_weights(caller);
+  code->clear_cfg();
+
+  EXPECT_EQ(weights.at(once), 1);
+  // The hottest of the call sites.
+  EXPECT_EQ(weights.at(looped), 8);
+  EXPECT_EQ(weights.at(nested), 64);
+  EXPECT_EQ(weights.at(cold), 0);
+}
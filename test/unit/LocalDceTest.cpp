@@ -228,6 +228,35 @@ TEST_F(LocalDceTryTest, deadCast) {
   EXPECT_FALSE(has_check_cast);
 }
 
+TEST_F(LocalDceTryTest, deadLoopCounter) {
+  auto code = assembler::ircode_from_string(R"(
+    (
+      (load-param v0)
+      (const v1 0)
+      (const v2 5)
+      (:loop)
+      (add-int/lit8 v1 v1 1)
+      (if-nez v0 :loop)
+      (return v2)
+    )
+  )");
+  std::unordered_set<DexMethodRef*> pure_methods;
+  LocalDce(pure_methods).dce(code.get());
+
+  // The counter is only used by itself around the loop, while v2 is live
+  // through it.
+  auto expected = assembler::ircode_from_string(R"(
+    (
+      (load-param v0)
+      (const v2 5)
+      (:loop)
+      (if-nez v0 :loop)
+      (return v2)
+    )
+  )");
+  EXPECT_CODE_EQ(code.get(), expected.get());
+}
+
 struct LocalDceEnhanceTest : public RedexTest {};
 
 static std::unordered_set<DexMethodRef*> get_no_side_effect_methods(
@@ -0,0 +1,220 @@
+/*
+ * Copyright (c) Facebook, Inc. and its affiliates.
+ *
+ * This source code is licensed under the MIT license found in the
+ * LICENSE file in the root directory of this source tree.
+ */
+
+#include <gtest/gtest.h>
+
+#include "Creators.h"
+#include "IRAssembler.h"
+#include "IRCode.h"
+#include "LoopInvariantCodeMotion.h"
+#include "RedexTest.h"
+
+class LoopInvariantCodeMotionTest : public RedexTest {};
+
+void test(const std::string& code_str,
+          const std::string& expected_str,
+          size_t expected_instructions_hoisted,
+          const DexType* declaring_type = nullptr) {
+  auto code = assembler::ircode_from_string(code_str);
+  auto expected = assembler::ircode_from_string(expected_str);
+
+  std::unordered_set<DexMethodRef*> pure_methods{
+      DexMethod::make_method("Ljava/lang/Math;.abs:(I)I"),
+      DexMethod::make_method("Ljava/lang/Math;.floorDiv:(II)I"),
+      DexMethod::make_method("Ljava/lang/Math;.random:()D")};
+  auto stats = LoopInvariantCodeMotionPass::process_code(
+      pure_methods, declaring_type, code.get());
+  EXPECT_EQ(expected_instructions_hoisted, stats.instructions_hoisted);
+
+  printf("%s\n", assembler::to_string(code.get()).c_str());
+  EXPECT_CODE_EQ(code.get(), expected.get());
+}
+
+TEST_F(LoopInvariantCodeMotionTest, basic) {
+  auto code_str = R"(
+    (
+      (load-param v0)
+      (const v3 0)
+      (:loop)
+      (const v1 42)
+      (add-int v2 v0 v1)
+      (add-int v3 v3 v2)
+      (if-nez v3 :loop)
+      (return v3)
+    )
+  )";
+  auto expected_str = R"(
+    (
+      (load-param v0)
+      (const v3 0)
+      (const v1 42)
+      (add-int v2 v0 v1)
+      (:loop)
+      (add-int v3 v3 v2)
+      (if-nez v3 :loop)
+      (return v3)
+    )
+  )";
+  test(code_str, expected_str, 2);
+}
+
+TEST_F(LoopInvariantCodeMotionTest, live_in_at_header) {
+  // The first iteration reads the value v1 had before the loop.
+  auto code_str = R"(
+    (
+      (load-param v0)
+      (const v1 0)
+      (:loop)
+      (add-int v0 v0 v1)
+      (const v1 42)
+      (if-nez v0 :loop)
+      (return v0)
+    )
+  )";
+  test(code_str, code_str, 0);
+}
+
+TEST_F(LoopInvariantCodeMotionTest, written_twice) {
+  auto code_str = R"(
+    (
+      (load-param v0)
+      (:loop)
+      (const v1 42)
+      (if-eqz v0 :skip)
+      (const v1 43)
+      (:skip)
+      (add-int v0 v0 v1)
+      (if-nez v0 :loop)
+      (return v0)
+    )
+  )";
+  test(code_str, code_str, 0);
+}
+
+TEST_F(LoopInvariantCodeMotionTest, may_throw) {
+  auto code_str = R"(
+    (
+      (load-param v0)
+      (load-param v1)
+      (:loop)
+      (div-int v0 v1)
+      (move-result-pseudo v2)
+      (invoke-static (v0 v1) "Ljava/lang/Math;.floorDiv:(II)I")
+      (move-result v3)
+      (add-int v0 v2 v3)
+      (if-nez v0 :loop)
+      (return v0)
+    )
+  )";
+  test(code_str, code_str, 0);
+}
+
+TEST_F(LoopInvariantCodeMotionTest, pure_call) {
+  auto code_str = R"(
+    (
+      (load-param v0)
+      (load-param v1)
+      (:loop)
+      (invoke-static (v1) "Ljava/lang/Math;.abs:(I)I")
+      (move-result v2)
+      (invoke-static () "Ljava/lang/Math;.random:()D")
+      (move-result-wide v4)
+      (add-int v0 v0 v2)
+      (if-nez v0 :loop)
+      (return v0)
+    )
+  )";
+  auto expected_str = R"(
+    (
+      (load-param v0)
+      (load-param v1)
+      (invoke-static (v1) "Ljava/lang/Math;.abs:(I)I")
+      (move-result v2)
+      (:loop)
+      (invoke-static () "Ljava/lang/Math;.random:()D")
+      (move-result-wide v4)
+      (add-int v0 v0 v2)
+      (if-nez v0 :loop)
+      (return v0)
+    )
+  )";
+  test(code_str, expected_str, 1);
+}
+
+TEST_F(LoopInvariantCodeMotionTest, final_field) {
+  ClassCreator foo_creator(DexType::make_type("LFoo;"));
+  foo_creator.set_super(type::java_lang_Object());
+  DexField::make_field("LFoo;.x:I")
+      ->make_concrete(ACC_PUBLIC | ACC_STATIC | ACC_FINAL);
+  DexField::make_field("LFoo;.y:I")->make_concrete(ACC_PUBLIC | ACC_STATIC);
+  auto declaring_type = foo_creator.create()->get_type();
+
+  auto code_str = R"(
+    (
+      (load-param v0)
+      (:loop)
+      (sget "LFoo;.x:I")
+      (move-result-pseudo v1)
+      (sget "LFoo;.y:I")
+      (move-result-pseudo v2)
+      (add-int v0 v0 v1)
+      (add-int v0 v0 v2)
+      (if-nez v0 :loop)
+      (return v0)
+    )
+  )";
+  auto expected_str = R"(
+    (
+      (load-param v0)
+      (sget "LFoo;.x:I")
+      (move-result-pseudo v1)
+      (:loop)
+      (sget "LFoo;.y:I")
+      (move-result-pseudo v2)
+      (add-int v0 v0 v1)
+      (add-int v0 v0 v2)
+      (if-nez v0 :loop)
+      (return v0)
+    )
+  )";
+  test(code_str, expected_str, 1, declaring_type);
+  // Within <clinit>, the final field may still be written.
+  test(code_str, code_str, 0);
+}
+
+TEST_F(LoopInvariantCodeMotionTest, nested) {
+  auto code_str = R"(
+    (
+      (load-param v0)
+      (:outer)
+      (move v1 v0)
+      (:inner)
+      (const v2 7)
+      (add-int v1 v1 v2)
+      (if-nez v1 :inner)
+      (add-int/lit8 v0 v0 -1)
+      (if-nez v0 :outer)
+      (return v0)
+    )
+  )";
+  auto expected_str = R"(
+    (
+      (load-param v0)
+      (const v2 7)
+      (:outer)
+      (move v1 v0)
+      (:inner)
+      (add-int v1 v1 v2)
+      (if-nez v1 :inner)
+      (add-int/lit8 v0 v0 -1)
+      (if-nez v0 :outer)
+      (return v0)
+    )
+  )";
+  // Hoisted into the inner preheader first, and then out of the outer loop.
+  test(code_str, expected_str, 2);
+}
@@ -0,0 +1,44 @@
+/*
+ * Copyright (c) Facebook, Inc. and its affiliates.
+ *
+ * This source code is licensed under the MIT license found in the
+ * LICENSE file in the root directory of this source tree.
+ */
+
+#include <algorithm>
+#include <gtest/gtest.h>
+
+#include "MethodDedup.h"
+
+#include "IRAssembler.h"
+#include "RedexTest.h"
+
+struct MethodDedupTest : public RedexTest {};
+
+TEST_F(MethodDedupTest, groupIdenticalMethods) {
+  auto make_method = [](const std::string& name, const std::string& body) {
+    return assembler::method_from_string(
+        "(method (public static) \"LFoo;." + name + ":(I)I\" " + body + ")");
+  };
+  std::vector<DexMethod*> methods{
+      make_method("a", "((load-param v0) (add-int/lit8 v0 v0 1) (return v0))"),
+      make_method("b", "((load-param v0) (add-int/lit8 v0 v0 2) (return v0))"),
+      // Positions are ignored.
+      make_method("c",
+                  "((load-param v0) (.pos \"LFoo;.c:(I)I\" \"Foo.java\" 12)"
+                  " (add-int/lit8 v0 v0 1) (return v0))"),
+      make_method("d", "((load-param v0) (return v0))"),
+      make_method("e", "((load-param v0) (add-int/lit8 v0 v0 2) (return v0))"),
+  };
+  auto groups = method_dedup::group_identical_methods(methods);
+  std::vector<std::vector<std::string>> group_names;
+  for (const auto& group : groups) {
+    group_names.emplace_back();
+    for (auto* method : group) {
+      group_names.back().push_back(method->get_name()->str());
+    }
+  }
+  std::vector<std::vector<std::string>> expected{{"a", "c"}, {"b", "e"}, {"d"}};
+  std::sort(group_names.begin(), group_names.end());
+  EXPECT_EQ(group_names, expected);
+}
@@ -0,0 +1,142 @@
+/*
+ * Copyright (c) Facebook, Inc. and its affiliates.
+ *
+ * This source code is licensed under the MIT license found in the
+ * LICENSE file in the root directory of this source tree.
+ */
+
+#include <fstream>
+#include <gtest/gtest.h>
+
+#include "MethodProfiles.h"
+#include "RedexTest.h"
+#include "RedexTestUtils.h"
+
+using namespace method_profiles;
+
+class MethodProfilesTest : public RedexTest {
+ protected:
+  MethodProfilesTest() : m_tmp_dir(redex::make_tmp_dir("method_profiles%%%%")) {
+    m_foo = DexMethod::make_method("LFoo;.foo:()V");
+    m_bar = DexMethod::make_method("LFoo;.bar:(I)I");
+  }
+
+  std::string write_csv(const std::string& contents) {
+    auto path = m_tmp_dir.path + "/profile.csv";
+    std::ofstream(path) << contents;
+    return path;
+  }
+
+  redex::TempDir m_tmp_dir;
+  DexMethodRef* m_foo;
+  DexMethodRef* m_bar;
+};
+
+const std::string HEADER =
+    "index,name,appear100,appear#,avg_call,avg_order,avg_rank100,"
+    "min_api_level,interaction\n";
+
+TEST_F(MethodProfilesTest, parseCsv) {
+  auto csv = write_csv(HEADER +
+                       "0,LFoo;.foo:()V,100.0,10,2.5,1,10.0,21,ColdStart\n"
+                       "1,LFoo;.bar:(I)I,50.0,5,1.0,2,20.0,23,ColdStart\n"
+                       "2,LFoo;.bar:(I)I,25.0,2,3.0,4,40.0,24,Scroll\n"
+                       "3,LFoo;.baz:()V,25.0,2,3.0,4,40.0,24,Scroll");
+  MethodProfiles profiles;
+  ASSERT_TRUE(profiles.initialize(csv));
+
+  const auto& cold_start = profiles.method_stats(COLD_START);
+  ASSERT_EQ(cold_start.size(), 2);
+  EXPECT_EQ(cold_start.at(m_foo).appear_percent, 100.0);
+  EXPECT_EQ(cold_start.at(m_foo).call_count, 2.5);
+  EXPECT_EQ(cold_start.at(m_foo).order_percent, 10.0);
+  EXPECT_EQ(cold_start.at(m_foo).min_api_level, 21);
+  EXPECT_EQ(cold_start.at(m_bar).order_percent, 20.0);
+
+  // The unknown method is dropped.
+  const auto& scroll = profiles.method_stats("Scroll");
+  ASSERT_EQ(scroll.size(), 1);
+  EXPECT_EQ(scroll.at(m_bar).min_api_level, 24);
+}
+
+TEST_F(MethodProfilesTest, unknownColumn) {
+  auto csv = write_csv(
+      "index,name,appear100,appear#,avg_call,avg_order,avg_rank100,"
+      "min_api_level,extra\n"
+      "0,LFoo;.foo:()V,100.0,10,2.5,1,10.0,21,whatever\n");
+  MethodProfiles profiles;
+  EXPECT_FALSE(profiles.initialize(csv));
+  EXPECT_FALSE(profiles.has_stats());
+}
+
+TEST_F(MethodProfilesTest, binaryRoundTrip) {
+  auto csv = write_csv(HEADER +
+                       "0,LFoo;.foo:()V,100.0,10,2.5,1,10.0,21,ColdStart\n"
+                       "1,LFoo;.bar:(I)I,50.0,5,1.0,2,20.0,23,ColdStart\n"
+                       "2,LFoo;.bar:(I)I,25.0,2,3.0,4,40.0,24,Scroll\n");
+  auto binary = m_tmp_dir.path + "/profile.bin";
+  ASSERT_TRUE(MethodProfiles::write_binary_profile(csv, binary));
+
+  MethodProfiles from_csv;
+  ASSERT_TRUE(from_csv.initialize(csv));
+  MethodProfiles from_binary;
+  ASSERT_TRUE(from_binary.initialize(binary));
+  const auto& expected = from_csv.all_interactions();
+  const auto& actual = from_binary.all_interactions();
+  ASSERT_EQ(actual.size(), expected.size());
+  for (const auto& pair : expected) {
+    const auto& stats = actual.at(pair.first);
+    ASSERT_EQ(stats.size(), pair.second.size());
+    for (const auto& method_stats : pair.second) {
+      const auto& s = stats.at(method_stats.first);
+      EXPECT_EQ(s.appear_percent, method_stats.second.appear_percent);
+      EXPECT_EQ(s.call_count, method_stats.second.call_count);
+      EXPECT_EQ(s.order_percent, method_stats.second.order_percent);
+      EXPECT_EQ(s.min_api_level, method_stats.second.min_api_level);
+    }
+  }
+}
+
+TEST_F(MethodProfilesTest, weightedStats) {
+  auto csv = write_csv(HEADER +
+                       "0,LFoo;.foo:()V,100.0,10,2.0,1,10.0,21,ColdStart\n"
+                       "1,LFoo;.bar:(I)I,60.0,5,4.0,2,20.0,23,ColdStart\n"
+                       "2,LFoo;.bar:(I)I,90.0,9,10.0,4,50.0,21,Scroll\n");
+  MethodProfiles profiles;
+  ASSERT_TRUE(profiles.initialize(csv));
+  // Without weights, the cold start stats are used.
+  EXPECT_EQ(&profiles.weighted_stats(), &profiles.method_stats(COLD_START));
+
+  WeightedStatsConfig config;
+  config.interaction_weights = {{COLD_START, 3.0}, {"Scroll", 1.0}};
+  profiles.set_weighted_stats_config(config);
+  const auto& stats = profiles.weighted_stats();
+  ASSERT_EQ(stats.size(), 2);
+
+  // foo doesn't appear during Scroll.
+  EXPECT_DOUBLE_EQ(stats.at(m_foo).appear_percent, 75.0);
+  EXPECT_DOUBLE_EQ(stats.at(m_foo).call_count, 1.5);
+  EXPECT_DOUBLE_EQ(stats.at(m_foo).order_percent, 10.0);
+  EXPECT_EQ(stats.at(m_foo).min_api_level, 21);
+
+  EXPECT_DOUBLE_EQ(stats.at(m_bar).appear_percent, 67.5);
+  EXPECT_DOUBLE_EQ(stats.at(m_bar).call_count, 5.5);
+  EXPECT_DOUBLE_EQ(stats.at(m_bar).order_percent, 27.5);
+  EXPECT_EQ(stats.at(m_bar).min_api_level, 21);
+}
+
+TEST_F(MethodProfilesTest, parseBeforeResolving) {
+  auto csv = write_csv(HEADER +
+                       "0,LFoo;.foo:()V,100.0,10,2.5,1,10.0,21,ColdStart\n"
+                       "1,LFoo;.qux:()V,50.0,5,1.0,2,20.0,23,ColdStart\n");
+  MethodProfiles profiles;
+  ASSERT_TRUE(profiles.parse(csv));
+  EXPECT_FALSE(profiles.is_initialized());
+
+  // The names are only resolved now, so qux is found.
+  auto qux = DexMethod::make_method("LFoo;.qux:()V");
+  ASSERT_TRUE(profiles.initialize_parsed(true));
+  const auto& cold_start = profiles.method_stats(COLD_START);
+  ASSERT_EQ(cold_start.size(), 2);
+  EXPECT_EQ(cold_start.at(qux).min_api_level, 23);
+}
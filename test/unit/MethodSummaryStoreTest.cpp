@@ -0,0 +1,82 @@
+/*
+ * Copyright (c) Facebook, Inc. and its affiliates.
+ *
+ * This source code is licensed under the MIT license found in the
+ * LICENSE file in the root directory of this source tree.
+ */
+
+#include "SummarySerialization.h"
+
+#include <gtest/gtest.h>
+#include <sstream>
+
+#include "IRAssembler.h"
+#include "RedexTest.h"
+
+namespace {
+
+struct Count {
+  int32_t n{0};
+
+  static Count from_s_expr(const sparta::s_expr& expr) {
+    return Count{expr.get_int32()};
+  }
+};
+
+sparta::s_expr to_s_expr(const Count& count) { return sparta::s_expr(count.n); }
+
+using Store = summary_serialization::MethodSummaryStore<Count>;
+
+} // namespace
+
+struct MethodSummaryStoreTest : public RedexTest {};
+
+TEST_F(MethodSummaryStoreTest, reuseUnchangedMethods) {
+  auto foo = assembler::method_from_string(R"(
+    (method (public static) "LFoo;.foo:()I"
+      (
+        (const v0 0)
+        (return v0)
+      )
+    )
+  )");
+  auto bar = assembler::method_from_string(R"(
+    (method (public static) "LFoo;.bar:()V"
+      (
+        (return-void)
+      )
+    )
+  )");
+
+  Store store("counts", 1);
+  store.set(foo, Count{1});
+  store.set(bar, Count{2});
+  std::stringstream ss;
+  store.write(ss);
+
+  Store reloaded("counts", 1);
+  std::istringstream input(ss.str());
+  EXPECT_EQ(reloaded.read(input), 2);
+  ASSERT_NE(reloaded.get(foo), nullptr);
+  EXPECT_EQ(reloaded.get(foo)->n, 1);
+  EXPECT_EQ(reloaded.get(bar)->n, 2);
+
+  // The summary of a modified method is not reused.
+  foo->set_code(assembler::ircode_from_string(R"(
+    (
+      (const v0 1)
+      (return v0)
+    )
+  )"));
+  Store modified("counts", 1);
+  std::istringstream modified_input(ss.str());
+  EXPECT_EQ(modified.read(modified_input), 1);
+  EXPECT_EQ(modified.get(foo), nullptr);
+  EXPECT_EQ(modified.get(bar)->n, 2);
+
+  // Neither is a store of another version.
+  Store next_version("counts", 2);
+  std::istringstream next_version_input(ss.str());
+  EXPECT_EQ(next_version.read(next_version_input), 0);
+  EXPECT_EQ(next_version.size(), 0);
+}
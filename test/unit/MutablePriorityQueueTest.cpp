@@ -0,0 +1,70 @@
+/*
+ * Copyright (c) Facebook, Inc. and its affiliates.
+ *
+ * This source code is licensed under the MIT license found in the
+ * LICENSE file in the root directory of this source tree.
+ */
+
+#include <gtest/gtest.h>
+
+#include <map>
+#include <random>
+
+#include "Debug.h"
+#include "MutablePriorityQueue.h"
+
+TEST(MutablePriorityQueueTest, frontHasHighestPriority) {
+  MutablePriorityQueue<int, int> pq;
+  EXPECT_TRUE(pq.empty());
+  pq.insert(1, 10);
+  pq.insert(2, 30);
+  pq.insert(3, 20);
+  EXPECT_EQ(pq.front(), 2);
+  pq.update_priority(2, 5);
+  EXPECT_EQ(pq.front(), 3);
+  pq.update_priority(1, 40);
+  EXPECT_EQ(pq.front(), 1);
+  pq.erase(1);
+  EXPECT_EQ(pq.front(), 3);
+  pq.erase(3);
+  EXPECT_EQ(pq.front(), 2);
+  pq.erase(2);
+  EXPECT_TRUE(pq.empty());
+}
+
+TEST(MutablePriorityQueueTest, matchesSortedMap) {
+  // Priorities are unique: a random part, and the value in the low bits.
+  std::mt19937 rng(0);
+  MutablePriorityQueue<uint32_t, uint64_t> pq;
+  std::map<uint64_t, uint32_t> expected;
+  std::unordered_map<uint32_t, uint64_t> priorities;
+  auto make_priority = [&](uint32_t value) {
+    return (uint64_t(rng() % 1000) << 32) | value;
+  };
+  for (int step = 0; step < 20000; step++) {
+    uint32_t value = rng() % 500;
+    auto it = priorities.find(value);
+    if (it == priorities.end()) {
+      auto priority = make_priority(value);
+      pq.insert(value, priority);
+      expected.emplace(priority, value);
+      priorities.emplace(value, priority);
+    } else if (rng() % 3 == 0) {
+      pq.erase(value);
+      expected.erase(it->second);
+      priorities.erase(it);
+    } else {
+      auto priority = make_priority(value);
+      pq.update_priority(value, priority);
+      expected.erase(it->second);
+      expected.emplace(priority, value);
+      it->second = priority;
+    }
+    ASSERT_EQ(pq.empty(), expected.empty());
+    if (!expected.empty()) {
+      ASSERT_EQ(pq.front(), expected.rbegin()->second);
+    }
+  }
+  pq.clear();
+  EXPECT_TRUE(pq.empty());
+}
@@ -0,0 +1,93 @@
+/*
+ * Copyright (c) Facebook, Inc. and its affiliates.
+ *
+ * This source code is licensed under the MIT license found in the
+ * LICENSE file in the root directory of this source tree.
+ */
+
+#include "ObjectPool.h"
+
+#include <cstdint>
+#include <gtest/gtest.h>
+#include <unordered_set>
+#include <vector>
+
+#include <boost/thread/thread.hpp>
+
+namespace {
+
+struct Pooled final {
+  explicit Pooled(uint64_t value) : value(value) {}
+  uint64_t value;
+  char padding[40];
+
+  REDEX_POOLED_ALLOCATION(Pooled)
+};
+
+} // namespace
+
+TEST(ObjectPoolTest, recycleSlots) {
+  std::vector<Pooled*> objects;
+  for (uint64_t i = 0; i < 100000; ++i) {
+    objects.push_back(new Pooled(i));
+    EXPECT_EQ(0, reinterpret_cast<uintptr_t>(objects.back()) %
+                     alignof(Pooled));
+  }
+  std::unordered_set<Pooled*> addresses(objects.begin(), objects.end());
+  EXPECT_EQ(objects.size(), addresses.size());
+  for (uint64_t i = 0; i < objects.size(); ++i) {
+    ASSERT_EQ(i, objects[i]->value);
+    delete objects[i];
+  }
+  // The memory of the deleted objects is reused.
+  for (size_t i = 0; i < objects.size(); ++i) {
+    objects[i] = new Pooled(i);
+  }
+#ifndef REDEX_OBJECT_POOL_DISABLED
+  for (auto* object : objects) {
+    EXPECT_EQ(1, addresses.count(object));
+  }
+#endif
+  for (auto* object : objects) {
+    delete object;
+  }
+}
+
+TEST(ObjectPoolTest, freeOnOtherThreads) {
+  constexpr size_t kThreads = 8;
+  constexpr size_t kObjects = 20000;
+  std::vector<std::vector<Pooled*>> objects(kThreads);
+  std::vector<boost::thread> threads;
+  for (size_t t = 0; t < kThreads; ++t) {
+    threads.emplace_back([&objects, t]() {
+      for (size_t i = 0; i < kObjects; ++i) {
+        objects[t].push_back(new Pooled(t * kObjects + i));
+      }
+    });
+  }
+  for (auto& thread : threads) {
+    thread.join();
+  }
+  threads.clear();
+  // Each thread deletes the objects of another one, and allocates new ones
+  // from the slots that it freed and those that exited threads gave back.
+  for (size_t t = 0; t < kThreads; ++t) {
+    threads.emplace_back([&objects, t]() {
+      auto& others = objects[(t + 1) % kThreads];
+      for (size_t i = 0; i < kObjects; ++i) {
+        EXPECT_EQ(((t + 1) % kThreads) * kObjects + i, others[i]->value);
+        delete others[i];
+      }
+      for (size_t i = 0; i < kObjects; ++i) {
+        others[i] = new Pooled(i);
+      }
+      for (size_t i = 0; i < kObjects; ++i) {
+        EXPECT_EQ(i, others[i]->value);
+        delete others[i];
+      }
+    });
+  }
+  for (auto& thread : threads) {
+    thread.join();
+  }
+}
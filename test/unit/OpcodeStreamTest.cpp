@@ -0,0 +1,69 @@
+/*
+ * Copyright (c) Facebook, Inc. and its affiliates.
+ *
+ * This source code is licensed under the MIT license found in the
+ * LICENSE file in the root directory of this source tree.
+ */
+
+#include <gtest/gtest.h>
+
+#include "IRAssembler.h"
+#include "IRCode.h"
+#include "OpcodeStream.h"
+#include "RedexTest.h"
+
+struct OpcodeStreamTest : public RedexTest {};
+
+TEST_F(OpcodeStreamTest, findFirstOf) {
+  auto code = assembler::ircode_from_string(R"(
+    (
+      (const v0 0)
+      (const v1 1)
+      (add-int v2 v0 v1)
+      (move v3 v2)
+      (add-int v2 v2 v1)
+      (return v2)
+    )
+  )");
+  OpcodeStream stream(InstructionIterable(code.get()));
+  ASSERT_EQ(stream.size(), 6);
+  EXPECT_EQ(stream.opcode(3), OPCODE_MOVE);
+  EXPECT_EQ(stream.insn(3)->opcode(), OPCODE_MOVE);
+
+  OpcodeSet add{std::vector<IROpcode>{OPCODE_ADD_INT}};
+  EXPECT_EQ(stream.find_first_of(add, 0), 2);
+  EXPECT_EQ(stream.find_first_of(add, 3), 4);
+  EXPECT_EQ(stream.find_first_of(add, 5), 6);
+
+  OpcodeSet move_or_return{
+      std::vector<IROpcode>{OPCODE_MOVE, OPCODE_RETURN, OPCODE_MOVE}};
+  EXPECT_EQ(move_or_return.size(), 2);
+  EXPECT_EQ(stream.find_first_of(move_or_return, 0), 3);
+  EXPECT_EQ(stream.find_first_of(move_or_return, 4), 5);
+
+  OpcodeSet goto_set{std::vector<IROpcode>{OPCODE_GOTO}};
+  EXPECT_FALSE(goto_set.intersects(stream.opcodes()));
+  EXPECT_EQ(stream.find_first_of(goto_set, 0), 6);
+}
+
+TEST_F(OpcodeStreamTest, unionOfSets) {
+  auto code = assembler::ircode_from_string(R"(
+    (
+      (const v0 0)
+      (move v1 v0)
+      (return v1)
+    )
+  )");
+  OpcodeStream stream(InstructionIterable(code.get()));
+
+  OpcodeSet set;
+  set |= OpcodeSet{std::vector<IROpcode>{OPCODE_RETURN}};
+  EXPECT_EQ(set.size(), 1);
+  // A singleton union is still searched for correctly.
+  EXPECT_EQ(stream.find_first_of(set, 0), 2);
+
+  set |= OpcodeSet{std::vector<IROpcode>{OPCODE_MOVE, OPCODE_RETURN}};
+  EXPECT_EQ(set.size(), 2);
+  EXPECT_TRUE(set.contains(OPCODE_MOVE));
+  EXPECT_EQ(stream.find_first_of(set, 0), 1);
+}
@@ -12,6 +12,7 @@
 #include "EnumConfig.h"
 #include "EnumInSwitch.h"
 #include "IRAssembler.h"
+#include "OptimizeEnumsGeneratedAnalysis.h"
 #include "RedexTest.h"
 #include "SwitchEquivFinder.h"
 
@@ -659,3 +660,77 @@ TEST_F(OptimizeEnumsTest, test_param_summary_generating) {
   EXPECT_EQ(summary4.returned_param, boost::none);
   EXPECT_TRUE(summary4.safe_params.empty());
 }
+
+TEST_F(OptimizeEnumsTest, kotlin_lookup_table_enums) {
+  ClassCreator enum_creator(type::java_lang_Enum());
+  enum_creator.set_super(type::java_lang_Object());
+  enum_creator.set_external();
+  auto ordinal = DexMethod::make_method("Ljava/lang/Enum;.ordinal:()I")
+                     ->make_concrete(ACC_PUBLIC | ACC_FINAL,
+                                     /* is_virtual */ true);
+  ordinal->set_external();
+  enum_creator.add_method(ordinal);
+  enum_creator.create();
+
+  ClassCreator color_creator(DexType::make_type("LColor;"));
+  color_creator.set_super(type::java_lang_Enum());
+  color_creator.set_access(ACC_PUBLIC | ACC_FINAL | ACC_ENUM);
+  for (const auto& name : {"LColor;.RED:LColor;", "LColor;.GREEN:LColor;"}) {
+    color_creator.add_field(DexField::make_field(name)->make_concrete(
+        ACC_PUBLIC | ACC_STATIC | ACC_FINAL | ACC_ENUM));
+  }
+  color_creator.create();
+
+  ClassCreator mappings_creator(DexType::make_type("LFoo$WhenMappings;"));
+  mappings_creator.set_super(type::java_lang_Object());
+  auto lookup_table =
+      DexField::make_field("LFoo$WhenMappings;.$EnumSwitchMapping$0:[I")
+          ->make_concrete(ACC_PUBLIC | ACC_STATIC | ACC_FINAL);
+  mappings_creator.add_field(lookup_table);
+  auto clinit = DexMethod::make_method("LFoo$WhenMappings;.<clinit>:()V")
+                    ->make_concrete(ACC_STATIC | ACC_CONSTRUCTOR,
+                                    assembler::ircode_from_string(R"(
+    (
+      (invoke-static () "LColor;.values:()[LColor;")
+      (move-result-object v0)
+      (array-length v0)
+      (move-result-pseudo v0)
+      (new-array v0 "[I")
+      (move-result-pseudo-object v0)
+      (sput-object v0 "LFoo$WhenMappings;.$EnumSwitchMapping$0:[I")
+      (sget-object "LColor;.RED:LColor;")
+      (move-result-pseudo-object v1)
+      (invoke-virtual (v1) "LColor;.ordinal:()I")
+      (move-result v1)
+      (const v2 1)
+      (aput v2 v0 v1)
+      (sget-object "LColor;.GREEN:LColor;")
+      (move-result-pseudo-object v1)
+      (invoke-virtual (v1) "LColor;.ordinal:()I")
+      (move-result v1)
+      (const v2 2)
+      (aput v2 v0 v1)
+      (return-void)
+    )
+  )"),
+                                    /* is_virtual */ false);
+  mappings_creator.add_method(clinit);
+  auto mappings_cls = mappings_creator.create();
+
+  optimize_enums::OptimizeEnumsGeneratedAnalysis analysis(
+      mappings_cls, /* current_enum */ nullptr);
+  auto enums = analysis.collect_lookup_table_enums();
+  ASSERT_EQ(enums.size(), 1);
+  EXPECT_EQ(enums.at(lookup_table), DexType::get_type("LColor;"));
+
+  optimize_enums::OptimizeEnumsGeneratedAnalysis color_analysis(
+      mappings_cls, DexType::get_type("LColor;"));
+  optimize_enums::GeneratedSwitchCases cases;
+  color_analysis.collect_generated_switch_cases(cases);
+  ASSERT_EQ(cases.at(lookup_table).size(), 2);
+  EXPECT_EQ(cases.at(lookup_table).at(1),
+            DexField::get_field("LColor;.RED:LColor;"));
+  EXPECT_EQ(cases.at(lookup_table).at(2),
+            DexField::get_field("LColor;.GREEN:LColor;"));
+  clinit->get_code()->clear_cfg();
+}
@@ -0,0 +1,82 @@
+/*
+ * Copyright (c) Facebook, Inc. and its affiliates.
+ *
+ * This source code is licensed under the MIT license found in the
+ * LICENSE file in the root directory of this source tree.
+ */
+
+#include "PriorityThreadPool.h"
+
+#include <atomic>
+#include <gtest/gtest.h>
+#include <stdexcept>
+#include <thread>
+
+TEST(PriorityThreadPoolTest, nestedTasks) {
+  PriorityThreadPool pool(4);
+  std::atomic<size_t> sum{0};
+  for (size_t i = 0; i < 16; i++) {
+    pool.post(0, [&pool, &sum]() {
+      std::vector<std::function<void()>> tasks;
+      for (size_t j = 1; j <= 10; j++) {
+        tasks.emplace_back([&sum, j]() { sum += j; });
+      }
+      pool.run_nested(1, std::move(tasks));
+    });
+  }
+  pool.join();
+  EXPECT_EQ(16 * 55, sum);
+}
+
+TEST(PriorityThreadPoolTest, nestedTasksWithoutThreads) {
+  PriorityThreadPool pool(0);
+  size_t sum{0};
+  std::vector<std::function<void()>> tasks;
+  for (size_t j = 1; j <= 10; j++) {
+    tasks.emplace_back([&sum, j]() { sum += j; });
+  }
+  pool.run_nested(0, std::move(tasks));
+  EXPECT_EQ(55, sum);
+}
+
+TEST(PriorityThreadPoolTest, nestedTasksException) {
+  PriorityThreadPool pool(2);
+  std::atomic<size_t> ran{0};
+  std::vector<std::function<void()>> tasks;
+  for (size_t j = 0; j < 10; j++) {
+    tasks.emplace_back([&ran, j]() {
+      ran++;
+      if (j == 5) {
+        throw std::runtime_error("nested");
+      }
+    });
+  }
+  EXPECT_THROW(pool.run_nested(0, std::move(tasks)), std::runtime_error);
+  // All tasks still ran to completion.
+  EXPECT_EQ(10, ran);
+  pool.join();
+}
+
+TEST(PriorityThreadPoolTest, queueWaitStats) {
+  PriorityThreadPool pool(1);
+  std::vector<int> order;
+  // Block the only thread until all other work items have been posted.
+  std::atomic<bool> posted{false};
+  pool.post(0, [&posted]() {
+    while (!posted) {
+      std::this_thread::yield();
+    }
+  });
+  pool.post(1, [&order]() { order.push_back(1); });
+  pool.post(2, [&order]() { order.push_back(2); });
+  pool.post(1, [&order]() { order.push_back(1); });
+  posted = true;
+  pool.join();
+  EXPECT_EQ(std::vector<int>({2, 1, 1}), order);
+  const auto& stats = pool.get_queue_wait_stats();
+  ASSERT_EQ(3, stats.size());
+  EXPECT_EQ(1, stats.at(0).work_items);
+  EXPECT_EQ(2, stats.at(1).work_items);
+  EXPECT_EQ(1, stats.at(2).work_items);
+  EXPECT_LE(stats.at(1).max, stats.at(1).total);
+}
@@ -0,0 +1,115 @@
+/*
+ * Copyright (c) Facebook, Inc. and its affiliates.
+ *
+ * This source code is licensed under the MIT license found in the
+ * LICENSE file in the root directory of this source tree.
+ */
+
+#include <gtest/gtest.h>
+
+#include <boost/regex.hpp>
+
+#include "ProguardRegex.h"
+#include "ProguardWildcardMatcher.h"
+
+using namespace keep_rules;
+using proguard_parser::WildcardMatcher;
+
+namespace {
+
+const std::vector<std::string> kNames = {
+    "",
+    "L",
+    "Lalpha;",
+    "Lalpha/beta;",
+    "Lalpha/beta/gamma;",
+    "Lalpha$beta;",
+    "Lalpha/Beta$Gamma;",
+    "[Lalpha/beta;",
+    "[[I",
+    "I",
+    "V",
+    "Z",
+    "alpha",
+    "alpha54beta",
+    "alpha:I",
+    "alpha:Lalpha/beta;",
+    "<init>:()V",
+    "alpha:(ILjava/lang/String;[J)V",
+    "alpha:(Ljava/lang/String;Lalpha;)Lalpha/beta;",
+    "access$000:(Lalpha;)I",
+};
+
+// The matcher must agree with boost::regex on every name.
+void expect_same_as_boost(const std::string& regex) {
+  boost::regex rx(regex);
+  WildcardMatcher matcher(regex);
+  for (const auto& name : kNames) {
+    EXPECT_EQ(boost::regex_match(name, rx), matcher.match(name))
+        << "regex: " << regex << " name: " << name;
+  }
+}
+
+} // namespace
+
+TEST(ProguardWildcardMatcherTest, types) {
+  for (const auto& pattern :
+       {"", "%", "***", "L*;", "L**;", "Lalpha;", "Lalpha/*;", "Lalpha/**;",
+        "Lalpha/*/gamma;", "Lalpha/**/gamma;", "Lalph?;", "L*$*;",
+        "Lalpha/Beta$*;", "[Lalpha/*;", "[[%", "[***", "(...)V",
+        "(I...)V", "(***)I", "(%***[J)V"}) {
+    auto regex = proguard_parser::form_type_regex(pattern);
+    expect_same_as_boost(regex);
+    EXPECT_FALSE(WildcardMatcher(regex).uses_fallback()) << regex;
+  }
+}
+
+TEST(ProguardWildcardMatcherTest, members) {
+  for (const auto& pair : std::vector<std::pair<std::string, std::string>>{
+           {"", ""},
+           {"*", "%"},
+           {"alpha", "I"},
+           {"al*", "***"},
+           {"?lpha", "L**;"},
+           {"<init>", "()V"},
+           {"*", "(...)V"},
+           {"alpha", "(I...)V"},
+           {"*", "(Ljava/lang/String;***)Lalpha/*;"},
+       }) {
+    auto regex = proguard_parser::form_member_regex(pair.first) + "\\:" +
+                 proguard_parser::form_type_regex(pair.second);
+    expect_same_as_boost(regex);
+    EXPECT_FALSE(WildcardMatcher(regex).uses_fallback()) << regex;
+  }
+}
+
+TEST(ProguardWildcardMatcherTest, fallback) {
+  // form_member_regex does not escape $, which makes it an anchor.
+  auto regex = proguard_parser::form_member_regex("access$000") + "\\:" +
+               proguard_parser::form_type_regex("(***)I");
+  EXPECT_TRUE(WildcardMatcher(regex).uses_fallback());
+  expect_same_as_boost(regex);
+
+  for (const auto& regex : {"^alpha", "a{2}", "\\w+", "(?=a)a", "[[:alpha:]]*",
+                            "a*+"}) {
+    EXPECT_TRUE(WildcardMatcher(regex).uses_fallback()) << regex;
+  }
+
+  // Long literal prefixes are not part of the NFA, but long patterns are.
+  std::string long_name(WildcardMatcher::kMaxStates, 'a');
+  EXPECT_FALSE(WildcardMatcher(long_name + ".*").uses_fallback());
+  std::string long_class;
+  for (size_t i = 0; i < WildcardMatcher::kMaxStates; ++i) {
+    long_class += "[^a]";
+  }
+  EXPECT_TRUE(WildcardMatcher(long_class).uses_fallback());
+}
+
+TEST(ProguardWildcardMatcherTest, syntax) {
+  for (const auto& regex :
+       {"a|b", "(?:ab|c)*d", "(ab)+", "a?b", "a*?b", "[a-c]*", "[^\\/]*",
+        "[]a]", "\\.\\:", ".", ".*alpha.*"}) {
+    expect_same_as_boost(regex);
+    EXPECT_FALSE(WildcardMatcher(regex).uses_fallback()) << regex;
+  }
+}
@@ -0,0 +1,84 @@
+/*
+ * Copyright (c) Facebook, Inc. and its affiliates.
+ *
+ * This source code is licensed under the MIT license found in the
+ * LICENSE file in the root directory of this source tree.
+ */
+
+#include <gtest/gtest.h>
+
+#include "Purity.h"
+
+#include "Creators.h"
+#include "DexClass.h"
+#include "IRAssembler.h"
+#include "RedexTest.h"
+
+struct PurityTest : public RedexTest {
+  Scope m_scope;
+  std::vector<DexMethod*> m_methods;
+  std::vector<DexField*> m_fields;
+
+  PurityTest() {
+    ClassCreator creator(DexType::make_type("LFoo;"));
+    creator.set_super(type::java_lang_Object());
+    for (size_t i = 0; i < 6; ++i) {
+      auto name = std::to_string(i);
+      auto method = assembler::method_from_string(
+          "(method (public static) \"LFoo;.m" + name +
+          ":()V\" ((return-void)))");
+      creator.add_method(method);
+      m_methods.push_back(method);
+      auto field = DexField::make_field("LFoo;.f" + name + ":I")
+                       ->make_concrete(ACC_PUBLIC | ACC_STATIC);
+      creator.add_field(field);
+      m_fields.push_back(field);
+    }
+    m_scope.push_back(creator.create());
+  }
+};
+
+TEST_F(PurityTest, locationsClosure) {
+  // m0 -> m1 <-> m2 -> m3, m4 -> m5 -> <unknown>
+  std::unordered_map<const DexMethod*, std::vector<size_t>> dependencies{
+      {m_methods[0], {1}}, {m_methods[1], {2}}, {m_methods[2], {1, 2, 3}},
+      {m_methods[3], {}},  {m_methods[4], {5}}, {m_methods[5], {}}};
+  std::unordered_map<const DexMethod*, CseUnorderedLocationSet> result;
+  auto iterations = compute_locations_closure(
+      m_scope, /* method_override_graph */ nullptr,
+      [&](DexMethod* method) -> boost::optional<LocationsAndDependencies> {
+        LocationsAndDependencies lads;
+        for (size_t i = 0; i < m_methods.size(); ++i) {
+          if (m_methods[i] == method) {
+            lads.locations.insert(get_field_location(OPCODE_SGET, m_fields[i]));
+          }
+        }
+        if (method == m_methods[5]) {
+          auto unknown = DexMethod::make_method("LBar;.unknown:()V");
+          lads.dependencies.insert(static_cast<DexMethod*>(unknown));
+        }
+        for (auto d : dependencies.at(method)) {
+          lads.dependencies.insert(m_methods[d]);
+        }
+        return lads;
+      },
+      &result);
+  EXPECT_EQ(iterations, 2);
+
+  auto locations = [&](std::initializer_list<size_t> indices) {
+    CseUnorderedLocationSet set;
+    for (auto i : indices) {
+      set.insert(get_field_location(OPCODE_SGET, m_fields[i]));
+    }
+    return set;
+  };
+  ASSERT_EQ(result.size(), 4);
+  EXPECT_EQ(result.at(m_methods[0]), locations({0, 1, 2, 3}));
+  // The methods of a cycle share their locations.
+  EXPECT_EQ(result.at(m_methods[1]), locations({1, 2, 3}));
+  EXPECT_EQ(result.at(m_methods[2]), locations({1, 2, 3}));
+  EXPECT_EQ(result.at(m_methods[3]), locations({3}));
+  // Depending on a method without information is a general barrier.
+  EXPECT_FALSE(result.count(m_methods[4]));
+  EXPECT_FALSE(result.count(m_methods[5]));
+}
@@ -0,0 +1,56 @@
+/*
+ * Copyright (c) Facebook, Inc. and its affiliates.
+ *
+ * This source code is licensed under the MIT license found in the
+ * LICENSE file in the root directory of this source tree.
+ */
+
+#include <gtest/gtest.h>
+
+#include <string>
+#include <vector>
+
+#include "Creators.h"
+#include "DexClass.h"
+#include "RedexTest.h"
+#include "WorkQueue.h"
+
+struct RedexContextTest : public RedexTest {};
+
+TEST_F(RedexContextTest, publishClassesConcurrently) {
+  constexpr size_t kClasses = 10000;
+  std::vector<DexClass*> classes(kClasses);
+  auto wq = workqueue_foreach<size_t>([&](size_t i) {
+    auto name = "LFoo" + std::to_string(i) + ";";
+    auto type = DexType::make_type(name.c_str());
+    ClassCreator creator(type);
+    creator.set_super(type::java_lang_Object());
+    classes[i] = creator.create();
+  });
+  for (size_t i = 0; i < kClasses; i++) {
+    wq.add_item(i);
+  }
+  wq.run_all();
+
+  size_t walked = 0;
+  g_redex->walk_type_class([&](const DexType* type, const DexClass* cls) {
+    EXPECT_EQ(cls->get_type(), type);
+    walked++;
+  });
+  EXPECT_GE(walked, kClasses);
+  for (size_t i = 0; i < kClasses; i++) {
+    auto type = DexType::get_type("LFoo" + std::to_string(i) + ";");
+    ASSERT_NE(type, nullptr);
+    EXPECT_EQ(type_class(type), classes[i]);
+  }
+}
+
+TEST_F(RedexContextTest, publishedClassIsAlreadyLoaded) {
+  auto type = DexType::make_type("LBar;");
+  ClassCreator creator(type);
+  creator.set_super(type::java_lang_Object());
+  auto cls = creator.create();
+  // A benign duplicate, as it comes from the same location.
+  EXPECT_TRUE(g_redex->class_already_loaded(cls));
+  EXPECT_EQ(type_class(type), cls);
+}
@@ -337,3 +337,81 @@ TEST_F(ReduceArrayLiteralsTest, conditional_escape) {
   const auto& expected_str = code_str;
   test(code_str, expected_str, 0, 0);
 }
+
+const IRInstruction* find_fill_array_data(IRCode* code) {
+  for (const auto& mie : InstructionIterable(code)) {
+    if (mie.insn->opcode() == OPCODE_FILL_ARRAY_DATA) {
+      return mie.insn;
+    }
+  }
+  return nullptr;
+}
+
+TEST_F(ReduceArrayLiteralsTest, array_data) {
+  auto code = assembler::ircode_from_string(R"(
+    (
+      (const v0 3)
+      (new-array v0 "[S")
+      (move-result-pseudo-object v1)
+      (const v0 0)
+      (const v2 7)
+      (aput-short v2 v1 v0)
+      (const v0 1)
+      (const v2 -1)
+      (aput-short v2 v1 v0)
+      (const v0 2)
+      (const v2 300)
+      (aput-short v2 v1 v0)
+      (return-object v1)
+    )
+  )");
+  code->build_cfg(/* editable */ true);
+  ReduceArrayLiterals ral(code->cfg(), 222, 24, Architecture::UNKNOWN,
+                          /* min_array_data_elements */ 3);
+  ral.patch();
+  code->clear_cfg();
+  EXPECT_EQ(ral.get_stats().array_data_payloads, 1);
+  EXPECT_EQ(ral.get_stats().array_data_elements, 3);
+  EXPECT_EQ(ral.get_stats().filled_arrays, 0);
+
+  auto fill_array_data = find_fill_array_data(code.get());
+  ASSERT_NE(fill_array_data, nullptr);
+  EXPECT_EQ(fill_array_data->src(0), 1);
+  // The payload starts with the element width and count.
+  const uint16_t* data = fill_array_data->get_data()->data();
+  EXPECT_EQ(data[0], 2);
+  EXPECT_EQ(*(uint32_t*)(data + 1), 3);
+  const int16_t* elements = (const int16_t*)(data + 3);
+  EXPECT_EQ(elements[0], 7);
+  EXPECT_EQ(elements[1], -1);
+  EXPECT_EQ(elements[2], 300);
+  for (const auto& mie : InstructionIterable(code.get())) {
+    EXPECT_FALSE(is_aput(mie.insn->opcode()));
+  }
+}
+
+TEST_F(ReduceArrayLiteralsTest, array_data_non_constant_element) {
+  auto code = assembler::ircode_from_string(R"(
+    (
+      (load-param v2)
+      (const v0 2)
+      (new-array v0 "[I")
+      (move-result-pseudo-object v1)
+      (const v0 0)
+      (aput v2 v1 v0)
+      (const v0 1)
+      (const v2 5)
+      (aput v2 v1 v0)
+      (return-object v1)
+    )
+  )");
+  code->build_cfg(/* editable */ true);
+  ReduceArrayLiterals ral(code->cfg(), 222, 24, Architecture::UNKNOWN,
+                          /* min_array_data_elements */ 2);
+  ral.patch();
+  code->clear_cfg();
+  // Falls back to filled-new-array.
+  EXPECT_EQ(ral.get_stats().array_data_payloads, 0);
+  EXPECT_EQ(ral.get_stats().filled_arrays, 1);
+  EXPECT_EQ(find_fill_array_data(code.get()), nullptr);
+}
@@ -16,6 +16,7 @@
 #include "IRCode.h"
 #include "IRInstruction.h"
 #include "Interference.h"
+#include "LinearScan.h"
 #include "LiveRange.h"
 #include "Liveness.h"
 #include "OpcodeList.h"
@@ -315,6 +316,32 @@ TEST_F(RegAllocTest, BuildInterferenceGraph) {
   }
 }
 
+TEST_F(RegAllocTest, AdjacencyMatrix) {
+  using namespace interference::impl;
+  AdjacencyMatrix matrix;
+  EXPECT_FALSE(matrix.contains(0, 1));
+  EXPECT_TRUE(matrix.add(0, 1, /* can_coalesce */ true));
+  EXPECT_FALSE(matrix.add(1, 0, /* can_coalesce */ true));
+  EXPECT_TRUE(matrix.contains(1, 0));
+  EXPECT_TRUE(matrix.is_coalesceable(0, 1));
+  // Once non-coalesceable, an edge stays so.
+  EXPECT_FALSE(matrix.add(0, 1, /* can_coalesce */ false));
+  EXPECT_FALSE(matrix.add(0, 1, /* can_coalesce */ true));
+  EXPECT_FALSE(matrix.is_coalesceable(1, 0));
+
+  // The matrix grows, and then falls back to a map for huge registers.
+  EXPECT_TRUE(matrix.add(100, 3, /* can_coalesce */ true));
+  EXPECT_TRUE(matrix.add(70000, 2, /* can_coalesce */ true));
+  EXPECT_TRUE(matrix.contains(0, 1));
+  EXPECT_FALSE(matrix.is_coalesceable(0, 1));
+  EXPECT_TRUE(matrix.contains(3, 100));
+  EXPECT_TRUE(matrix.is_coalesceable(3, 100));
+  EXPECT_TRUE(matrix.contains(2, 70000));
+  EXPECT_FALSE(matrix.contains(2, 100));
+  EXPECT_FALSE(matrix.add(100, 3, /* can_coalesce */ false));
+  EXPECT_FALSE(matrix.is_coalesceable(3, 100));
+}
+
 TEST_F(RegAllocTest, CombineNonAdjacentNodes) {
   using namespace interference::impl;
   auto ig = GraphBuilder::create_empty();
@@ -1017,3 +1044,63 @@ TEST_F(RegAllocTest, NoOverwriteThis) {
 )");
   EXPECT_CODE_EQ(expected_code.get(), method->get_code());
 }
+
+TEST_F(RegAllocTest, LinearScan) {
+  auto method = assembler::method_from_string(R"(
+    (method (public static) "LFoo;.bar:(I)I"
+     (
+      (load-param v0)
+      (const v1 1)
+      (add-int v2 v0 v1)
+      (move v3 v2)
+      (return v3)
+     )
+    )
+)");
+  method->get_code()->set_registers_size(4);
+
+  graph_coloring::Allocator::Config config;
+  config.use_linear_scan = true;
+  auto stats = RegAllocPass::allocate(config, method);
+  EXPECT_EQ(stats.linear_scan_allocations, 1);
+  EXPECT_EQ(stats.linear_scan_fallbacks, 0);
+  EXPECT_EQ(stats.moves_coalesced, 1);
+
+  auto expected_code = assembler::ircode_from_string(R"(
+    (
+     (load-param v1)
+     (const v0 1)
+     (add-int v0 v1 v0)
+     (return v0)
+    )
+)");
+  EXPECT_CODE_EQ(expected_code.get(), method->get_code());
+  EXPECT_EQ(method->get_code()->get_registers_size(), 2);
+}
+
+TEST_F(RegAllocTest, LinearScanFallsBack) {
+  // The move cannot be coalesced by linear scan, since both its src and its
+  // dest are live after it.
+  auto method = assembler::method_from_string(R"(
+    (method (public static) "LFoo;.bar:(I)I"
+     (
+      (load-param v0)
+      (move v1 v0)
+      (add-int v2 v0 v1)
+      (return v2)
+     )
+    )
+)");
+  auto code = method->get_code();
+  code->set_registers_size(3);
+  code->build_cfg(/* editable */ false);
+  auto original_code_s_expr = assembler::to_s_expr(code);
+
+  graph_coloring::Allocator::Config config;
+  config.use_linear_scan = true;
+  graph_coloring::Allocator::Stats stats;
+  EXPECT_TRUE(linear_scan::is_eligible(config, method));
+  EXPECT_FALSE(linear_scan::allocate(config, method, &stats));
+  EXPECT_EQ(assembler::to_s_expr(code), original_code_s_expr);
+  EXPECT_EQ(stats.linear_scan_allocations, 0);
+}
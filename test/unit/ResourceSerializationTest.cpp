@@ -283,3 +283,34 @@ TEST(ResTable, AppendNewType) {
 
   unmap_and_close(file_descriptor, fp, length);
 }
+
+TEST(ResourcesArscView, MatchesResTable) {
+  size_t length;
+  int file_descriptor;
+  auto fp = map_file(std::getenv("test_arsc_path"), &file_descriptor, &length);
+  android::ResTable table;
+  ASSERT_EQ(table.add(fp, length), 0);
+  android::SortedVector<uint32_t> ids;
+  table.getResourceIds(&ids);
+  ASSERT_GT(ids.size(), 0);
+
+  ResourcesArscView view(std::getenv("test_arsc_path"));
+  std::map<std::string, std::vector<uint32_t>> name_to_ids;
+  for (size_t i = 0; i < ids.size(); ++i) {
+    android::ResTable::resource_name name;
+    table.getResourceName(ids[i], true, &name);
+    std::string expected(android::String8(name.name8, name.nameLen).string());
+    auto actual = view.get_resource_name(ids[i]);
+    ASSERT_TRUE(actual);
+    ASSERT_EQ(*actual, expected);
+    name_to_ids[expected].push_back(ids[i]);
+  }
+  ASSERT_FALSE(view.get_resource_name(0x7f7f7f7f));
+
+  for (const auto& pair : name_to_ids) {
+    std::vector<std::string> prefixes{pair.first.substr(0, 1)};
+    ASSERT_EQ(view.get_resources_by_name_prefix(prefixes),
+              get_resources_by_name_prefix(prefixes, name_to_ids));
+  }
+  unmap_and_close(file_descriptor, fp, length);
+}
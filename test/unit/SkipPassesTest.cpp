@@ -0,0 +1,68 @@
+/*
+ * Copyright (c) Facebook, Inc. and its affiliates.
+ *
+ * This source code is licensed under the MIT license found in the
+ * LICENSE file in the root directory of this source tree.
+ */
+
+#include <gtest/gtest.h>
+#include <json/json.h>
+
+#include "Pass.h"
+#include "PassManager.h"
+#include "RedexTest.h"
+
+namespace {
+
+class NoopPass : public Pass {
+ public:
+  explicit NoopPass(const std::string& name) : Pass(name) {}
+
+  void run_pass(DexStoresVector&, ConfigFiles&, PassManager&) override {}
+};
+
+} // namespace
+
+class SkipPassesTest : public RedexTest {
+ protected:
+  NoopPass m_foo{"FooPass"};
+  NoopPass m_bar{"BarPass"};
+
+  std::vector<std::string> activated(const Json::Value& skip_passes) {
+    Json::Value config(Json::objectValue);
+    config["redex"] = Json::objectValue;
+    config["redex"]["passes"] = Json::arrayValue;
+    for (auto name : {"FooPass", "BarPass", "FooPass", "BarPass"}) {
+      config["redex"]["passes"].append(name);
+    }
+    config["redex"]["skip_passes"] = skip_passes;
+    std::vector<Pass*> passes{&m_foo, &m_bar};
+    PassManager manager(passes, config);
+    std::vector<std::string> names;
+    for (const auto& info : manager.get_pass_info()) {
+      names.push_back(info.name);
+    }
+    return names;
+  }
+};
+
+TEST_F(SkipPassesTest, noSkippedPasses) {
+  EXPECT_EQ(activated(Json::arrayValue),
+            std::vector<std::string>(
+                {"FooPass#1", "BarPass#1", "FooPass#2", "BarPass#2"}));
+}
+
+TEST_F(SkipPassesTest, skipAllRunsOfAPass) {
+  Json::Value skip(Json::arrayValue);
+  skip.append("BarPass");
+  EXPECT_EQ(activated(skip),
+            std::vector<std::string>({"FooPass#1", "FooPass#2"}));
+}
+
+TEST_F(SkipPassesTest, skipOneRunOrIndex) {
+  Json::Value skip(Json::arrayValue);
+  skip.append("FooPass#2");
+  skip.append("1");
+  EXPECT_EQ(activated(skip),
+            std::vector<std::string>({"FooPass#1", "BarPass#1"}));
+}
@@ -0,0 +1,96 @@
+/*
+ * Copyright (c) Facebook, Inc. and its affiliates.
+ *
+ * This source code is licensed under the MIT license found in the
+ * LICENSE file in the root directory of this source tree.
+ */
+
+#include <gtest/gtest.h>
+
+#include "Creators.h"
+#include "IRAssembler.h"
+#include "IRCode.h"
+#include "RedexTest.h"
+#include "SpeculativeDevirtualization.h"
+
+namespace sd = speculative_devirtualization;
+
+class SpeculativeDevirtualizationTest : public RedexTest {
+ public:
+  SpeculativeDevirtualizationTest() {
+    m_base = make_class("LBase;", type::java_lang_Object(), "LBase;.run:()I");
+    m_task = make_class("LTask;", m_base, "LTask;.run:()I");
+    m_other =
+        make_class("LOther;", type::java_lang_Object(), "LOther;.run:()I");
+  }
+
+  static DexType* make_class(const char* name,
+                             DexType* super,
+                             const std::string& method_name) {
+    ClassCreator creator(DexType::make_type(name));
+    creator.set_super(super);
+    creator.set_access(ACC_PUBLIC);
+    creator.add_method(assembler::method_from_string(
+        "(method (public) \"" + method_name +
+        "\" ((load-param-object v0) (const v1 0) (return v1)))"));
+    return creator.create()->get_type();
+  }
+
+  DexType* m_base;
+  DexType* m_task;
+  DexType* m_other;
+};
+
+size_t count(IRCode* code, IROpcode op, const DexMethodRef* method = nullptr) {
+  size_t n = 0;
+  for (const auto& mie : InstructionIterable(code)) {
+    if (mie.insn->opcode() == op &&
+        (method == nullptr || mie.insn->get_method() == method)) {
+      n++;
+    }
+  }
+  return n;
+}
+
+TEST_F(SpeculativeDevirtualizationTest, guardsLikelyReceiver) {
+  auto code = assembler::ircode_from_string(R"(
+    (
+      (load-param-object v0)
+      (invoke-virtual (v0) "LBase;.run:()I")
+      (move-result v1)
+      (return v1)
+    )
+  )");
+  auto base_run = DexMethod::get_method("LBase;.run:()I");
+  auto task_run = DexMethod::get_method("LTask;.run:()I");
+  auto stats = sd::guard_calls({sd::LikelyReceiver{base_run, m_task}},
+                               code.get());
+  EXPECT_EQ(stats.guarded_calls, 1);
+  EXPECT_EQ(stats.skipped_calls, 0);
+
+  EXPECT_EQ(count(code.get(), OPCODE_INSTANCE_OF), 1);
+  EXPECT_EQ(count(code.get(), OPCODE_CHECK_CAST), 1);
+  EXPECT_EQ(count(code.get(), OPCODE_INVOKE_VIRTUAL, task_run), 1);
+  // The fallback.
+  EXPECT_EQ(count(code.get(), OPCODE_INVOKE_VIRTUAL, base_run), 1);
+  EXPECT_EQ(count(code.get(), OPCODE_MOVE_RESULT), 2);
+}
+
+TEST_F(SpeculativeDevirtualizationTest, skipsUnrelatedReceiver) {
+  auto code_str = R"(
+    (
+      (load-param-object v0)
+      (invoke-virtual (v0) "LBase;.run:()I")
+      (move-result v1)
+      (return v1)
+    )
+  )";
+  auto code = assembler::ircode_from_string(code_str);
+  auto expected = assembler::ircode_from_string(code_str);
+  auto base_run = DexMethod::get_method("LBase;.run:()I");
+  auto stats = sd::guard_calls({sd::LikelyReceiver{base_run, m_other}},
+                               code.get());
+  EXPECT_EQ(stats.guarded_calls, 0);
+  EXPECT_EQ(stats.skipped_calls, 1);
+  EXPECT_CODE_EQ(code.get(), expected.get());
+}
@@ -5,64 +5,89 @@
  * LICENSE file in the root directory of this source tree.
  */
 
-#if defined(__SSE4_2__) && defined(__linux__) && defined(__STRCMP_LESS__)
 #include <gtest/gtest.h>
 
 #include <cstring>
 #include <stdlib.h>
 #include <string>
+#include <sys/mman.h>
+#include <unistd.h>
+#include <vector>
 
-extern "C" bool strcmp_less(const char* str1, const char* str2);
+#include "StrcmpLess.h"
 
-TEST(StrcmpLessTest, Test1) {
+class StrcmpLessTest : public ::testing::TestWithParam<StrcmpLessVariant> {
+ protected:
+  bool strcmp_less(const char* str1, const char* str2) {
+    return get_strcmp_less(GetParam())(str1, str2);
+  }
+};
+
+std::vector<StrcmpLessVariant> supported_variants() {
+  std::vector<StrcmpLessVariant> variants;
+  for (auto variant :
+       {StrcmpLessVariant::Portable, StrcmpLessVariant::SSE42,
+        StrcmpLessVariant::AVX2, StrcmpLessVariant::NEON}) {
+    if (strcmp_less_supported(variant)) {
+      variants.push_back(variant);
+    }
+  }
+  return variants;
+}
+
+INSTANTIATE_TEST_CASE_P(AllVariants,
+                        StrcmpLessTest,
+                        ::testing::ValuesIn(supported_variants()));
+
+TEST_P(StrcmpLessTest, Test1) {
   const char* str1 = "a";
   const char* str2 = "a";
   EXPECT_FALSE(strcmp_less(str1, str2));
 }
 
-TEST(StrcmpLessTest, Test2) {
+TEST_P(StrcmpLessTest, Test2) {
   const char* str1 = "a";
   const char* str2 = "b";
   EXPECT_TRUE(strcmp_less(str1, str2));
 }
 
-TEST(StrcmpLessTest, Test3) {
+TEST_P(StrcmpLessTest, Test3) {
   const char* str1 = "b";
   const char* str2 = "a";
   EXPECT_FALSE(strcmp_less(str1, str2));
 }
 
-TEST(StrcmpLessTest, Test4) {
+TEST_P(StrcmpLessTest, Test4) {
   const char* str1 = "abcd";
   const char* str2 = "abcd";
   EXPECT_FALSE(strcmp_less(str1, str2));
 }
 
-TEST(StrcmpLessTest, Test5) {
+TEST_P(StrcmpLessTest, Test5) {
   const char* str1 = "abcd";
   const char* str2 = "abce";
   EXPECT_TRUE(strcmp_less(str1, str2));
 }
 
-TEST(StrcmpLessTest, Test6) {
+TEST_P(StrcmpLessTest, Test6) {
   const char* str1 = "abce";
   const char* str2 = "abcd";
   EXPECT_FALSE(strcmp_less(str1, str2));
 }
 
-TEST(StrcmpLessTest, Test7) {
+TEST_P(StrcmpLessTest, Test7) {
   const char* str1 = "abcd";
   const char* str2 = "abcde";
   EXPECT_TRUE(strcmp_less(str1, str2));
 }
 
-TEST(StrcmpLessTest, Test8) {
+TEST_P(StrcmpLessTest, Test8) {
   const char* str1 = "abcde";
   const char* str2 = "abcd";
   EXPECT_FALSE(strcmp_less(str1, str2));
 }
 
-TEST(StrcmpLessTest, Test9) {
+TEST_P(StrcmpLessTest, Test9) {
   std::string str1;
   std::string str2;
   const int min_str_len = 1;
@@ -86,7 +111,7 @@ TEST(StrcmpLessTest, Test9) {
 }
 
 // str1 == str2
-TEST(StrcmpLessTest, Test10) {
+TEST_P(StrcmpLessTest, Test10) {
   std::string str1;
   std::string str2;
   const int min_str_len = 1;
@@ -106,7 +131,7 @@ TEST(StrcmpLessTest, Test10) {
 }
 
 // str1 < str2
-TEST(StrcmpLessTest, Test11) {
+TEST_P(StrcmpLessTest, Test11) {
   std::string str1;
   std::string str2;
   const int min_str_len = 1;
@@ -130,7 +155,7 @@ TEST(StrcmpLessTest, Test11) {
 }
 
 // str1 > str2
-TEST(StrcmpLessTest, Test12) {
+TEST_P(StrcmpLessTest, Test12) {
   std::string str1;
   std::string str2;
   const int min_str_len = 1;
@@ -152,4 +177,27 @@ TEST(StrcmpLessTest, Test12) {
     EXPECT_FALSE(strcmp_less(str1.c_str(), str2.c_str()));
   }
 }
-#endif // defined(__SSE4_2__) && defined(__linux__) && defined(__STRCMP_LESS__)
+
+// Strings ending right before an unmapped page must not be read past.
+TEST_P(StrcmpLessTest, PageBoundary) {
+  size_t page_size = sysconf(_SC_PAGESIZE);
+  auto* pages = static_cast<char*>(mmap(nullptr, 2 * page_size,
+                                        PROT_READ | PROT_WRITE,
+                                        MAP_PRIVATE | MAP_ANONYMOUS, -1, 0));
+  ASSERT_NE(pages, MAP_FAILED);
+  ASSERT_EQ(mprotect(pages + page_size, page_size, PROT_NONE), 0);
+  char* end = pages + page_size;
+  for (size_t len = 1; len < 80; len++) {
+    char* str1 = end - len;
+    memset(str1, 'a', len - 1);
+    str1[len - 1] = '\0';
+    std::string str2(len - 1, 'a');
+    EXPECT_FALSE(strcmp_less(str1, str2.c_str()));
+    EXPECT_FALSE(strcmp_less(str2.c_str(), str1));
+    str2.push_back('a');
+    EXPECT_TRUE(strcmp_less(str1, str2.c_str()));
+    EXPECT_FALSE(strcmp_less(str2.c_str(), str1));
+    EXPECT_FALSE(strcmp_less(str1, str1));
+  }
+  munmap(pages, 2 * page_size);
+}
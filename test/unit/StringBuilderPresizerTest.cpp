@@ -0,0 +1,116 @@
+/*
+ * Copyright (c) Facebook, Inc. and its affiliates.
+ *
+ * This source code is licensed under the MIT license found in the
+ * LICENSE file in the root directory of this source tree.
+ */
+
+#include "StringBuilderPresizer.h"
+
+#include <gtest/gtest.h>
+
+#include "IRAssembler.h"
+#include "RedexTest.h"
+
+class StringBuilderPresizerTest : public RedexTest {
+ public:
+  void SetUp() override {
+    DexMethod::make_method(
+        "Ljava/lang/StringBuilder;.<init>:(Ljava/lang/String;)V");
+  }
+};
+
+TEST_F(StringBuilderPresizerTest, presizeAndFuse) {
+  auto code = assembler::ircode_from_string(R"(
+    (
+      (load-param v2)
+      (new-instance "Ljava/lang/StringBuilder;")
+      (move-result-pseudo-object v0)
+      (invoke-direct (v0) "Ljava/lang/StringBuilder;.<init>:()V")
+      (const-string "Loaded ")
+      (move-result-pseudo-object v1)
+      (invoke-virtual (v0 v1) "Ljava/lang/StringBuilder;.append:(Ljava/lang/String;)Ljava/lang/StringBuilder;")
+      (const-string "items from ")
+      (move-result-pseudo-object v1)
+      (invoke-virtual (v0 v1) "Ljava/lang/StringBuilder;.append:(Ljava/lang/String;)Ljava/lang/StringBuilder;")
+      (move-result-object v3)
+      (invoke-virtual (v3 v2) "Ljava/lang/StringBuilder;.append:(I)Ljava/lang/StringBuilder;")
+      (invoke-virtual (v0) "Ljava/lang/StringBuilder;.toString:()Ljava/lang/String;")
+      (move-result-object v0)
+      (return-object v0)
+    )
+  )");
+  auto stats = stringbuilder_presizer::presize(code.get());
+  EXPECT_EQ(stats.presized_builders, 1);
+  EXPECT_EQ(stats.fused_appends, 1);
+
+  auto expected = assembler::ircode_from_string(R"(
+    (
+      (load-param v2)
+      (new-instance "Ljava/lang/StringBuilder;")
+      (move-result-pseudo-object v0)
+      (const v4 29)
+      (invoke-direct (v0 v4) "Ljava/lang/StringBuilder;.<init>:(I)V")
+      (const-string "Loaded ")
+      (move-result-pseudo-object v1)
+      (const-string "Loaded items from ")
+      (move-result-pseudo-object v5)
+      (invoke-virtual (v0 v5) "Ljava/lang/StringBuilder;.append:(Ljava/lang/String;)Ljava/lang/StringBuilder;")
+      (const-string "items from ")
+      (move-result-pseudo-object v1)
+      (move-object v3 v0)
+      (invoke-virtual (v3 v2) "Ljava/lang/StringBuilder;.append:(I)Ljava/lang/StringBuilder;")
+      (invoke-virtual (v0) "Ljava/lang/StringBuilder;.toString:()Ljava/lang/String;")
+      (move-result-object v0)
+      (return-object v0)
+    )
+  )");
+  EXPECT_CODE_EQ(code.get(), expected.get());
+}
+
+TEST_F(StringBuilderPresizerTest, shortBuilderUnchanged) {
+  auto code_str = R"(
+    (
+      (load-param v2)
+      (new-instance "Ljava/lang/StringBuilder;")
+      (move-result-pseudo-object v0)
+      (invoke-direct (v0) "Ljava/lang/StringBuilder;.<init>:()V")
+      (invoke-virtual (v0 v2) "Ljava/lang/StringBuilder;.append:(I)Ljava/lang/StringBuilder;")
+      (invoke-virtual (v0) "Ljava/lang/StringBuilder;.toString:()Ljava/lang/String;")
+      (move-result-object v0)
+      (return-object v0)
+    )
+  )";
+  auto code = assembler::ircode_from_string(code_str);
+  auto expected = assembler::ircode_from_string(code_str);
+  auto stats = stringbuilder_presizer::presize(code.get());
+  EXPECT_EQ(stats.presized_builders, 0);
+  EXPECT_EQ(stats.fused_appends, 0);
+  EXPECT_CODE_EQ(code.get(), expected.get());
+}
+
+TEST_F(StringBuilderPresizerTest, escapingBuilderUnchanged) {
+  auto code_str = R"(
+    (
+      (new-instance "Ljava/lang/StringBuilder;")
+      (move-result-pseudo-object v0)
+      (invoke-direct (v0) "Ljava/lang/StringBuilder;.<init>:()V")
+      (const-string "a long constant string")
+      (move-result-pseudo-object v1)
+      (invoke-virtual (v0 v1) "Ljava/lang/StringBuilder;.append:(Ljava/lang/String;)Ljava/lang/StringBuilder;")
+      (invoke-static (v0) "LFoo;.bar:(Ljava/lang/StringBuilder;)V")
+      (const-string "more")
+      (move-result-pseudo-object v1)
+      (invoke-virtual (v0 v1) "Ljava/lang/StringBuilder;.append:(Ljava/lang/String;)Ljava/lang/StringBuilder;")
+      (invoke-virtual (v0) "Ljava/lang/StringBuilder;.toString:()Ljava/lang/String;")
+      (move-result-object v0)
+      (return-object v0)
+    )
+  )";
+  auto code = assembler::ircode_from_string(code_str);
+  auto expected = assembler::ircode_from_string(code_str);
+  auto stats = stringbuilder_presizer::presize(code.get());
+  EXPECT_EQ(stats.presized_builders, 0);
+  EXPECT_EQ(stats.fused_appends, 0);
+  EXPECT_CODE_EQ(code.get(), expected.get());
+}
@@ -0,0 +1,107 @@
+/*
+ * Copyright (c) Facebook, Inc. and its affiliates.
+ *
+ * This source code is licensed under the MIT license found in the
+ * LICENSE file in the root directory of this source tree.
+ */
+
+#include <gtest/gtest.h>
+
+#include "ControlFlow.h"
+#include "IRAssembler.h"
+#include "IRCode.h"
+#include "RedexTest.h"
+#include "StringSwitchDispatch.h"
+
+class StringSwitchDispatchTest : public RedexTest {};
+
+namespace {
+
+size_t count_opcode(IRCode* code, IROpcode op) {
+  size_t count = 0;
+  for (const auto& mie : InstructionIterable(code)) {
+    count += mie.insn->opcode() == op;
+  }
+  return count;
+}
+
+} // namespace
+
+TEST_F(StringSwitchDispatchTest, splitHashCodeSwitch) {
+  auto code = assembler::ircode_from_string(R"(
+    (
+      (load-param-object v0)
+      (invoke-virtual (v0) "Ljava/lang/String;.hashCode:()I")
+      (move-result v1)
+      (switch v1 (:a :b :c))
+      (const v2 -1)
+      (return v2)
+      (:a 10)
+      (const v2 0)
+      (return v2)
+      (:b 12)
+      (const v2 1)
+      (return v2)
+      (:c 13)
+      (const v2 2)
+      (return v2)
+    )
+  )");
+  auto stats = StringSwitchDispatchPass::run(code.get(), 3);
+  EXPECT_EQ(stats.switches, 1);
+  // 10 and 12 share the bucket 0, 13 has the bucket 1 to itself.
+  EXPECT_EQ(stats.buckets, 2);
+  EXPECT_EQ(count_opcode(code.get(), OPCODE_AND_INT_LIT16), 1);
+  EXPECT_EQ(count_opcode(code.get(), OPCODE_SWITCH), 2);
+  EXPECT_EQ(count_opcode(code.get(), OPCODE_IF_EQ), 1);
+
+  code->build_cfg();
+  auto& cfg = code->cfg();
+  auto entry = cfg.entry_block();
+  auto last = entry->get_last_insn()->insn;
+  ASSERT_EQ(last->opcode(), OPCODE_SWITCH);
+  auto bucket_edges = cfg.get_succ_edges_of_type(entry, cfg::EDGE_BRANCH);
+  ASSERT_EQ(bucket_edges.size(), 2);
+  for (auto edge : bucket_edges) {
+    auto bucket = edge->target();
+    auto bucket_branch = bucket->get_last_insn()->insn;
+    EXPECT_EQ(bucket_branch->src(0), 1);
+    // Each bucket falls back to the default case of the original switch.
+    EXPECT_EQ(bucket->goes_to(), entry->goes_to());
+    if (*edge->case_key() == 0) {
+      EXPECT_EQ(bucket_branch->opcode(), OPCODE_SWITCH);
+      EXPECT_EQ(cfg.get_succ_edges_of_type(bucket, cfg::EDGE_BRANCH).size(),
+                2);
+    } else {
+      EXPECT_EQ(*edge->case_key(), 1);
+      EXPECT_EQ(bucket_branch->opcode(), OPCODE_IF_EQ);
+    }
+  }
+  code->clear_cfg();
+}
+
+TEST_F(StringSwitchDispatchTest, otherSwitchUnchanged) {
+  auto code = assembler::ircode_from_string(R"(
+    (
+      (load-param v0)
+      (switch v0 (:a :b :c))
+      (const v2 -1)
+      (return v2)
+      (:a 10)
+      (const v2 0)
+      (return v2)
+      (:b 12)
+      (const v2 1)
+      (return v2)
+      (:c 13)
+      (const v2 2)
+      (return v2)
+    )
+  )");
+  // Make sure that String.hashCode() exists.
+  DexMethod::make_method("Ljava/lang/String;.hashCode:()I");
+  auto stats = StringSwitchDispatchPass::run(code.get(), 3);
+  EXPECT_EQ(stats.switches, 0);
+  EXPECT_EQ(count_opcode(code.get(), OPCODE_AND_INT_LIT16), 0);
+  EXPECT_EQ(count_opcode(code.get(), OPCODE_SWITCH), 1);
+}
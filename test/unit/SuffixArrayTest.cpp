@@ -0,0 +1,71 @@
+/*
+ * Copyright (c) Facebook, Inc. and its affiliates.
+ *
+ * This source code is licensed under the MIT license found in the
+ * LICENSE file in the root directory of this source tree.
+ */
+
+#include <algorithm>
+#include <gtest/gtest.h>
+#include <random>
+
+#include "SuffixArray.h"
+
+using namespace outliner_impl;
+
+namespace {
+
+std::vector<int32_t> naive_suffix_array(const std::vector<uint32_t>& s) {
+  std::vector<int32_t> sa(s.size());
+  for (size_t i = 0; i < s.size(); i++) {
+    sa[i] = i;
+  }
+  std::sort(sa.begin(), sa.end(), [&](int32_t a, int32_t b) {
+    return std::lexicographical_compare(s.begin() + a, s.end(), s.begin() + b,
+                                        s.end());
+  });
+  return sa;
+}
+
+size_t naive_lcp(const std::vector<uint32_t>& s, size_t a, size_t b) {
+  size_t h = 0;
+  while (a + h < s.size() && b + h < s.size() && s[a + h] == s[b + h]) {
+    h++;
+  }
+  return h;
+}
+
+} // namespace
+
+TEST(SuffixArrayTest, empty) {
+  EXPECT_TRUE(build_suffix_array({}, 1).empty());
+  EXPECT_TRUE(build_lcp_array({}, {}).empty());
+}
+
+TEST(SuffixArrayTest, banana) {
+  // b a n a n a
+  std::vector<uint32_t> s{1, 0, 2, 0, 2, 0};
+  auto sa = build_suffix_array(s, 3);
+  EXPECT_EQ(std::vector<int32_t>({5, 3, 1, 0, 4, 2}), sa);
+  EXPECT_EQ(std::vector<int32_t>({1, 3, 0, 0, 2}), build_lcp_array(s, sa));
+}
+
+TEST(SuffixArrayTest, matchesNaive) {
+  std::mt19937 gen(42);
+  for (uint32_t alphabet_size : {1, 2, 3, 8, 100}) {
+    std::uniform_int_distribution<uint32_t> dist(0, alphabet_size - 1);
+    for (size_t n = 1; n < 200; n += 7) {
+      std::vector<uint32_t> s(n);
+      for (auto& c : s) {
+        c = dist(gen);
+      }
+      auto sa = build_suffix_array(s, alphabet_size);
+      ASSERT_EQ(naive_suffix_array(s), sa);
+      auto lcp = build_lcp_array(s, sa);
+      ASSERT_EQ(n - 1, lcp.size());
+      for (size_t i = 0; i + 1 < n; i++) {
+        EXPECT_EQ(naive_lcp(s, sa[i], sa[i + 1]), lcp[i]);
+      }
+    }
+  }
+}
@@ -0,0 +1,117 @@
+/*
+ * Copyright (c) Facebook, Inc. and its affiliates.
+ *
+ * This source code is licensed under the MIT license found in the
+ * LICENSE file in the root directory of this source tree.
+ */
+
+#include <gtest/gtest.h>
+
+#include "Creators.h"
+#include "IRAssembler.h"
+#include "IRCode.h"
+#include "RedexTest.h"
+#include "ThrowOutliner.h"
+
+class ThrowOutlinerTest : public RedexTest {
+ public:
+  ThrowOutlinerTest() {
+    ClassCreator creator(DexType::make_type("Ljava/lang/FooException;"));
+    creator.set_super(type::java_lang_Object());
+    creator.set_access(ACC_PUBLIC);
+    creator.set_external();
+    auto init = static_cast<DexMethod*>(DexMethod::make_method(
+        "Ljava/lang/FooException;.<init>:(Ljava/lang/String;)V"));
+    init->make_concrete(ACC_PUBLIC | ACC_CONSTRUCTOR, /* is_virtual */ false);
+    init->set_external();
+    creator.add_method(init);
+    creator.create();
+  }
+};
+
+TEST_F(ThrowOutlinerTest, outlineThrow) {
+  auto code = assembler::ircode_from_string(R"(
+    (
+      (load-param v2)
+      (if-nez v2 :ok)
+      (new-instance "Ljava/lang/FooException;")
+      (move-result-pseudo-object v0)
+      (const-string "not started")
+      (move-result-pseudo-object v1)
+      (invoke-direct (v0 v1) "Ljava/lang/FooException;.<init>:(Ljava/lang/String;)V")
+      (throw v0)
+      (:ok)
+      (return-void)
+    )
+  )");
+  auto constructors = ThrowOutlinerPass::find_outlinable_throws(code.get());
+  ASSERT_EQ(constructors.size(), 1);
+  auto helper = ThrowOutlinerPass::create_helper(
+      DexType::make_type("LHelper;"), constructors[0]);
+  EXPECT_EQ(
+      ThrowOutlinerPass::outline_throws({{constructors[0], helper}}, code.get()),
+      1);
+
+  auto expected = assembler::ircode_from_string(R"(
+    (
+      (load-param v2)
+      (if-nez v2 :ok)
+      (const-string "not started")
+      (move-result-pseudo-object v1)
+      (invoke-static (v1) "LHelper;.create:(Ljava/lang/String;)Ljava/lang/FooException;")
+      (move-result-object v0)
+      (throw v0)
+      (:ok)
+      (return-void)
+    )
+  )");
+  EXPECT_CODE_EQ(code.get(), expected.get());
+
+  auto expected_helper = assembler::ircode_from_string(R"(
+    (
+      (load-param-object v1)
+      (new-instance "Ljava/lang/FooException;")
+      (move-result-pseudo-object v0)
+      (invoke-direct (v0 v1) "Ljava/lang/FooException;.<init>:(Ljava/lang/String;)V")
+      (return-object v0)
+    )
+  )");
+  EXPECT_CODE_EQ(helper->get_code(), expected_helper.get());
+}
+
+TEST_F(ThrowOutlinerTest, exceptionUsedBeforeThrow) {
+  auto code = assembler::ircode_from_string(R"(
+    (
+      (new-instance "Ljava/lang/FooException;")
+      (move-result-pseudo-object v0)
+      (invoke-static (v0) "LFoo;.log:(Ljava/lang/Object;)V")
+      (const-string "not started")
+      (move-result-pseudo-object v1)
+      (invoke-direct (v0 v1) "Ljava/lang/FooException;.<init>:(Ljava/lang/String;)V")
+      (throw v0)
+    )
+  )");
+  EXPECT_TRUE(ThrowOutlinerPass::find_outlinable_throws(code.get()).empty());
+}
+
+TEST_F(ThrowOutlinerTest, internalException) {
+  ClassCreator creator(DexType::make_type("LBarException;"));
+  creator.set_super(type::java_lang_Object());
+  creator.set_access(ACC_PUBLIC);
+  auto init = static_cast<DexMethod*>(
+      DexMethod::make_method("LBarException;.<init>:()V"));
+  init->make_concrete(ACC_PUBLIC | ACC_CONSTRUCTOR, /* is_virtual */ false);
+  creator.add_method(init);
+  creator.create();
+
+  auto code = assembler::ircode_from_string(R"(
+    (
+      (new-instance "LBarException;")
+      (move-result-pseudo-object v0)
+      (invoke-direct (v0) "LBarException;.<init>:()V")
+      (throw v0)
+    )
+  )");
+  // Its helper could reference a class of another store.
+  EXPECT_TRUE(ThrowOutlinerPass::find_outlinable_throws(code.get()).empty());
+}
@@ -11,6 +11,7 @@
 
 #include "Creators.h"
 #include "DexClass.h"
+#include "IRAssembler.h"
 #include "RedexTest.h"
 
 using namespace type_reference;
@@ -109,3 +110,32 @@ TEST_F(TypeReferenceTest, update_field_type_references) {
             type::make_array_type(
                 type::make_array_type(type::make_array_type(type::_int()))));
 }
+
+TEST_F(TypeReferenceTest, batch_ref_updater) {
+  auto f_e0 = make_a_field("f_e0", type::java_lang_Enum());
+  auto make_method = [&](const std::string& name, const std::string& body) {
+    auto method = assembler::method_from_string(
+        "(method (public static) \"Lcom/TestClass;." + name + ":()V\" " +
+        body + ")");
+    m_class->add_method(method);
+    return method;
+  };
+  auto old_callee = make_method("old_callee", "((return-void))");
+  auto new_callee = make_method("new_callee", "((return-void))");
+  auto caller = make_method(
+      "caller",
+      "((invoke-static () \"Lcom/TestClass;.old_callee:()V\") "
+      "(return-void))");
+
+  BatchRefUpdater ref_updater;
+  ref_updater.add_types(m_old_to_new);
+  ref_updater.add_callees({{old_callee, new_callee}});
+  ClassHierarchy ch;
+  ref_updater.apply(m_scope, ch);
+
+  EXPECT_EQ(f_e0->get_type(), type::_int());
+  auto expected = assembler::ircode_from_string(
+      "((invoke-static () \"Lcom/TestClass;.new_callee:()V\") "
+      "(return-void))");
+  EXPECT_CODE_EQ(caller->get_code(), expected.get());
+}
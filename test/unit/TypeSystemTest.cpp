@@ -373,4 +373,16 @@ TEST_F(TypeSystemTest, empty) {
   EXPECT_THAT(type_system.get_implemented_interfaces(odd12_t),
               ::testing::UnorderedElementsAre(iout1_t));
   EXPECT_THAT(type_system.get_implemented_interfaces(odd_t).size(), 0);
+
+  // The closures are memoized; asking again adds to what is already there.
+  types = {a_t};
+  type_system.get_all_super_interfaces(i1_1_43_t, types);
+  EXPECT_THAT(types,
+              ::testing::UnorderedElementsAre(a_t, i3_t, i4_t, i1_43_t));
+  types = {a_t};
+  type_system.get_all_interface_children(i4_t, types);
+  EXPECT_THAT(types, ::testing::UnorderedElementsAre(a_t, i1_1_43_t, i1_43_t));
+  types = {i_t};
+  type_system.get_all_children(odd1_t, types);
+  EXPECT_THAT(types, ::testing::UnorderedElementsAre(i_t, odd11_t, odd12_t));
 }
@@ -10,6 +10,7 @@
 #include <gmock/gmock.h>
 
 #include "DexUtil.h"
+#include "IRAssembler.h"
 #include "RedexTest.h"
 
 struct WalkersTest : public RedexTest {};
@@ -36,3 +37,46 @@ TEST_F(WalkersTest, accumlate) {
       ::testing::UnorderedElementsAre(
           "LFoo;.bar:()V", "LFoo;.baz:()V", "LFoo;.qux:()V", "LFoo;.quux:()V"));
 }
+
+TEST_F(WalkersTest, by_cost_schedules_largest_first) {
+  ClassCreator cc(DexType::make_type("LFoo;"));
+  cc.set_super(type::java_lang_Object());
+  auto add_method = [&](const char* name, size_t num_consts) {
+    auto m = DexMethod::make_method(std::string("LFoo;.") + name + ":()V")
+                 ->make_concrete(ACC_PUBLIC | ACC_STATIC, false);
+    std::string body = "(";
+    for (size_t i = 0; i < num_consts; ++i) {
+      body += "(const v0 0)";
+    }
+    body += "(return-void))";
+    m->set_code(assembler::ircode_from_string(body));
+    cc.add_method(m);
+  };
+  add_method("small", 1);
+  add_method("large", 20);
+  add_method("medium", 5);
+  cc.add_method(DexMethod::make_method("LFoo;.abstr:()V")
+                    ->make_concrete(ACC_PUBLIC | ACC_ABSTRACT, true));
+
+  Scope scope{cc.create()};
+  // With a single thread, the walk order is the scheduling order.
+  std::vector<std::string> order;
+  walk::parallel::code_by_cost(
+      scope,
+      [](DexMethod*) { return true; },
+      walk::parallel::code_size_cost,
+      [&](DexMethod* m, IRCode&) { order.push_back(m->get_name()->str()); },
+      /* num_threads */ 1);
+  EXPECT_THAT(order, ::testing::ElementsAre("large", "medium", "small"));
+
+  using StringSet = std::unordered_set<std::string>;
+  auto strings =
+      walk::parallel::methods_by_cost<StringSet, MergeContainers<StringSet>>(
+          scope,
+          walk::parallel::code_size_cost,
+          [&](DexMethod* m) { return StringSet{m->get_name()->str()}; },
+          /* num_threads */ 2);
+  EXPECT_THAT(strings,
+              ::testing::UnorderedElementsAre("small", "medium", "large",
+                                              "abstr"));
+}
@@ -0,0 +1,138 @@
+/*
+ * Copyright (c) Facebook, Inc. and its affiliates.
+ *
+ * This source code is licensed under the MIT license found in the
+ * LICENSE file in the root directory of this source tree.
+ */
+
+#include <fstream>
+#include <gtest/gtest.h>
+#include <zlib.h>
+
+#include "RedexTestUtils.h"
+#include "ZipReader.h"
+
+namespace {
+
+struct TestEntry {
+  std::string name;
+  std::string contents;
+  bool deflate;
+};
+
+void put16(std::string& out, uint16_t value) {
+  out.push_back(value & 0xff);
+  out.push_back(value >> 8);
+}
+
+void put32(std::string& out, uint32_t value) {
+  put16(out, value & 0xffff);
+  put16(out, value >> 16);
+}
+
+std::string raw_deflate(const std::string& contents) {
+  z_stream stream{};
+  EXPECT_EQ(deflateInit2(&stream, Z_BEST_COMPRESSION, Z_DEFLATED, -MAX_WBITS,
+                         8, Z_DEFAULT_STRATEGY),
+            Z_OK);
+  std::string out(deflateBound(&stream, contents.size()), '\0');
+  stream.next_in = (Bytef*)contents.data();
+  stream.avail_in = contents.size();
+  stream.next_out = (Bytef*)&out[0];
+  stream.avail_out = out.size();
+  EXPECT_EQ(deflate(&stream, Z_FINISH), Z_STREAM_END);
+  out.resize(stream.total_out);
+  deflateEnd(&stream);
+  return out;
+}
+
+// Writes a minimal zip archive with the given entries.
+void write_zip(const std::string& path, const std::vector<TestEntry>& entries) {
+  std::string local;
+  std::string central;
+  for (const auto& entry : entries) {
+    auto data = entry.deflate ? raw_deflate(entry.contents) : entry.contents;
+    uint32_t crc = crc32(0, (const Bytef*)entry.contents.data(),
+                         entry.contents.size());
+    uint32_t offset = local.size();
+
+    put32(local, 0x04034b50);
+    put16(local, 20);
+    put16(local, 0);
+    put16(local, entry.deflate ? 8 : 0);
+    put32(local, 0);
+    put32(local, crc);
+    put32(local, data.size());
+    put32(local, entry.contents.size());
+    put16(local, entry.name.size());
+    put16(local, 0);
+    local += entry.name;
+    local += data;
+
+    put32(central, 0x02014b50);
+    put16(central, 20);
+    put16(central, 20);
+    put16(central, 0);
+    put16(central, entry.deflate ? 8 : 0);
+    put32(central, 0);
+    put32(central, crc);
+    put32(central, data.size());
+    put32(central, entry.contents.size());
+    put16(central, entry.name.size());
+    put16(central, 0);
+    put16(central, 0);
+    put16(central, 0);
+    put16(central, 0);
+    put32(central, 0);
+    put32(central, offset);
+    central += entry.name;
+  }
+  std::string end;
+  put32(end, 0x06054b50);
+  put16(end, 0);
+  put16(end, 0);
+  put16(end, entries.size());
+  put16(end, entries.size());
+  put32(end, central.size());
+  put32(end, local.size());
+  put16(end, 0);
+  std::ofstream(path, std::ios::binary) << local << central << end;
+}
+
+} // namespace
+
+TEST(ZipReaderTest, readEntries) {
+  auto tmp_dir = redex::make_tmp_dir("zip_reader_test%%%%");
+  auto path = tmp_dir.path + "/test.zip";
+  std::string long_contents(10000, 'x');
+  write_zip(path,
+            {{"stored.txt", "hello", false},
+             {"res/layout/deflated.xml", long_contents, true}});
+
+  ZipReader zip(path);
+  ASSERT_EQ(zip.entries().size(), 2);
+  EXPECT_EQ(zip.find_entry("missing"), nullptr);
+
+  auto stored = zip.find_entry("stored.txt");
+  ASSERT_NE(stored, nullptr);
+  EXPECT_TRUE(stored->is_stored());
+  auto stored_contents = zip.get_stored_contents(*stored);
+  ASSERT_NE(stored_contents, nullptr);
+  EXPECT_EQ(std::string((const char*)stored_contents, stored->ucomp_size),
+            "hello");
+  EXPECT_EQ(zip.read_entry(*stored), "hello");
+
+  auto deflated = zip.find_entry("res/layout/deflated.xml");
+  ASSERT_NE(deflated, nullptr);
+  EXPECT_FALSE(deflated->is_stored());
+  EXPECT_LT(deflated->comp_size, deflated->ucomp_size);
+  EXPECT_EQ(zip.get_stored_contents(*deflated), nullptr);
+  EXPECT_EQ(zip.read_entry(*deflated), long_contents);
+}
+
+TEST(ZipReaderTest, notAZip) {
+  auto tmp_dir = redex::make_tmp_dir("zip_reader_test%%%%");
+  auto path = tmp_dir.path + "/test.zip";
+  std::ofstream(path) << "not a zip archive, but long enough to look for one";
+  EXPECT_THROW(ZipReader{path}, std::runtime_error);
+}
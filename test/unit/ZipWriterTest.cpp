@@ -0,0 +1,75 @@
+/*
+ * Copyright (c) Facebook, Inc. and its affiliates.
+ *
+ * This source code is licensed under the MIT license found in the
+ * LICENSE file in the root directory of this source tree.
+ */
+
+#include <gtest/gtest.h>
+
+#include "RedexTestUtils.h"
+#include "ZipReader.h"
+#include "ZipWriter.h"
+
+namespace {
+
+// Compressible, but not trivially so.
+std::string make_contents(size_t size) {
+  std::string contents;
+  contents.reserve(size);
+  uint32_t state = 1;
+  while (contents.size() < size) {
+    state = state * 1103515245 + 12345;
+    contents += "entry" + std::to_string((state >> 16) % 1000) + ";";
+  }
+  contents.resize(size);
+  return contents;
+}
+
+void add(ZipWriter& zip,
+         const std::string& name,
+         const std::string& contents,
+         bool compress) {
+  zip.add_entry(name, reinterpret_cast<const uint8_t*>(contents.data()),
+                contents.size(), compress);
+}
+
+} // namespace
+
+TEST(ZipWriterTest, roundTrip) {
+  auto tmp_dir = redex::make_tmp_dir("zip_writer_test%%%%");
+  auto path = tmp_dir.path + "/test.zip";
+  // Spans several chunks, which are deflated in parallel.
+  auto big = make_contents(5 * 1024 * 1024 + 123);
+  {
+    ZipWriter zip(path);
+    add(zip, "classes2.dex", big, true);
+    add(zip, "a.txt", "hello", true);
+    add(zip, "resources.arsc", "stored!", false);
+    add(zip, "empty", "", true);
+    zip.finish();
+  }
+
+  ZipReader zip(path);
+  ASSERT_EQ(zip.entries().size(), 4);
+  // The entries are sorted by name.
+  EXPECT_EQ(zip.entries()[0].name, "a.txt");
+  EXPECT_EQ(zip.entries()[1].name, "classes2.dex");
+  EXPECT_EQ(zip.entries()[2].name, "empty");
+  EXPECT_EQ(zip.entries()[3].name, "resources.arsc");
+
+  auto dex = zip.find_entry("classes2.dex");
+  ASSERT_NE(dex, nullptr);
+  EXPECT_LT(dex->comp_size, big.size() / 2);
+  EXPECT_EQ(zip.read_entry(*dex), big);
+  EXPECT_EQ(zip.read_entry(*zip.find_entry("a.txt")), "hello");
+  EXPECT_EQ(zip.read_entry(*zip.find_entry("empty")), "");
+
+  auto arsc = zip.find_entry("resources.arsc");
+  ASSERT_NE(arsc, nullptr);
+  EXPECT_TRUE(arsc->is_stored());
+  auto contents = zip.get_stored_contents(*arsc);
+  ASSERT_NE(contents, nullptr);
+  EXPECT_EQ(reinterpret_cast<uintptr_t>(contents) % 4, 0);
+  EXPECT_EQ(std::string((const char*)contents, arsc->ucomp_size), "stored!");
+}
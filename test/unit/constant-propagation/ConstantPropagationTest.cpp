@@ -804,3 +804,46 @@ TEST_F(ConstantPropagationTest, ForwardBranchesSwitch) {
   EXPECT_CODE_EQ(code.get(), expected_code.get());
 }
 
+
+TEST_F(ConstantPropagationTest, UnchangedMethodCache) {
+  cp::UnchangedMethodCache::get().clear();
+  auto method = assembler::method_from_string(R"(
+    (method (public static) "LFoo;.bar:(I)V"
+     (
+      (load-param v0)
+      (const v1 0)
+      (if-eqz v1 :L0)
+      (return-void)
+      (:L0)
+      (add-int v2 v0 v0)
+      (return-void)
+     )
+    )
+  )");
+  cp::Config config;
+  cp::ConstantPropagation impl(config);
+
+  // The branch gets removed, so the first run can't be skipped next time.
+  auto stats = impl.run(method, nullptr);
+  EXPECT_EQ(stats.branches_removed, 1);
+  EXPECT_EQ(stats.unchanged_cache_misses, 1);
+  method->get_code()->clear_cfg();
+
+  stats = impl.run(method, nullptr);
+  EXPECT_EQ(stats.branches_removed, 0);
+  EXPECT_EQ(stats.unchanged_cache_hits, 0);
+  EXPECT_EQ(stats.unchanged_cache_misses, 1);
+  method->get_code()->clear_cfg();
+
+  stats = impl.run(method, nullptr);
+  EXPECT_EQ(stats.unchanged_cache_hits, 1);
+  EXPECT_EQ(stats.unchanged_cache_misses, 0);
+
+  // Changing the method invalidates the entry.
+  auto code = method->get_code();
+  code->insert_before(code->get_param_instructions().end(),
+                      (new IRInstruction(OPCODE_CONST))->set_dest(3));
+  stats = impl.run(method, nullptr);
+  EXPECT_EQ(stats.unchanged_cache_hits, 0);
+  EXPECT_EQ(stats.unchanged_cache_misses, 1);
+}
@@ -0,0 +1,110 @@
+/*
+ * Copyright (c) Facebook, Inc. and its affiliates.
+ *
+ * This source code is licensed under the MIT license found in the
+ * LICENSE file in the root directory of this source tree.
+ */
+
+#include "RangeAnalysis.h"
+
+#include <gtest/gtest.h>
+
+#include "IRAssembler.h"
+#include "IRCode.h"
+#include "RedexTest.h"
+
+namespace range = constant_propagation::range;
+
+struct RangeAnalysisTest : public RedexTest {};
+
+namespace {
+
+size_t remove_redundant_branches(IRCode* code) {
+  code->build_cfg(/* editable */ true);
+  auto& cfg = code->cfg();
+  cfg.calculate_exit_block();
+  range::FixpointIterator fp_iter(cfg);
+  fp_iter.run(range::RangeEnvironment());
+  auto removed = range::remove_redundant_branches(fp_iter, &cfg);
+  cfg.remove_unreachable_blocks();
+  code->clear_cfg();
+  return removed;
+}
+
+} // namespace
+
+TEST_F(RangeAnalysisTest, maskedIndex) {
+  auto code = assembler::ircode_from_string(R"(
+    (
+      (load-param v0)
+      (and-int/lit8 v0 v0 15)
+      (if-ltz v0 :negative)
+      (const v1 16)
+      (if-ge v0 v1 :negative)
+      (return v0)
+      (:negative)
+      (const v0 -1)
+      (return v0)
+    )
+)");
+  EXPECT_EQ(remove_redundant_branches(code.get()), 2);
+
+  auto expected_code = assembler::ircode_from_string(R"(
+    (
+      (load-param v0)
+      (and-int/lit8 v0 v0 15)
+      (const v1 16)
+      (return v0)
+    )
+)");
+  EXPECT_CODE_EQ(code.get(), expected_code.get());
+}
+
+TEST_F(RangeAnalysisTest, loopCounter) {
+  auto code = assembler::ircode_from_string(R"(
+    (
+      (load-param v0)
+      (const v1 0)
+      (:loop)
+      (if-ge v1 v0 :end)
+      (if-ltz v1 :end)
+      (add-int/lit8 v1 v1 1)
+      (goto :loop)
+      (:end)
+      (return v1)
+    )
+)");
+  EXPECT_EQ(remove_redundant_branches(code.get()), 1);
+
+  auto expected_code = assembler::ircode_from_string(R"(
+    (
+      (load-param v0)
+      (const v1 0)
+      (:loop)
+      (if-ge v1 v0 :end)
+      (add-int/lit8 v1 v1 1)
+      (goto :loop)
+      (:end)
+      (return v1)
+    )
+)");
+  EXPECT_CODE_EQ(code.get(), expected_code.get());
+}
+
+TEST_F(RangeAnalysisTest, overlappingRanges) {
+  auto code = assembler::ircode_from_string(R"(
+    (
+      (load-param v0)
+      (const v1 10)
+      (if-gt v0 v1 :large)
+      (const v1 5)
+      (if-gt v0 v1 :large)
+      (return v0)
+      (:large)
+      (const v0 0)
+      (return v0)
+    )
+)");
+  // Neither check decides the other: v0 may be in (5, 10].
+  EXPECT_EQ(remove_redundant_branches(code.get()), 0);
+}
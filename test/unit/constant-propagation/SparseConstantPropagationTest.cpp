@@ -0,0 +1,128 @@
+/*
+ * Copyright (c) Facebook, Inc. and its affiliates.
+ *
+ * This source code is licensed under the MIT license found in the
+ * LICENSE file in the root directory of this source tree.
+ */
+
+#include "SparseConstantPropagation.h"
+
+#include <gtest/gtest.h>
+
+#include "ConstantPropagationTestUtil.h"
+#include "IRAssembler.h"
+
+namespace {
+
+void do_sparse_const_prop(IRCode* code) {
+  code->build_cfg(/* editable */ false);
+  code->cfg().calculate_exit_block();
+  cp::intraprocedural::FixpointIterator intra_cp(
+      code->cfg(), cp::ConstantPrimitiveAnalyzer());
+  intra_cp.run_sparse(ConstantEnvironment());
+  cp::Transform tf;
+  tf.apply_on_uneditable_cfg(
+      intra_cp, cp::WholeProgramState(), code, nullptr, nullptr);
+}
+
+// The sparse engine must agree with the dense one.
+void check_same_as_dense(const std::string& code_str) {
+  auto code = assembler::ircode_from_string(code_str);
+  do_sparse_const_prop(code.get());
+  auto expected_code = assembler::ircode_from_string(code_str);
+  do_const_prop(expected_code.get());
+  EXPECT_CODE_EQ(code.get(), expected_code.get());
+}
+
+} // namespace
+
+TEST_F(ConstantPropagationTest, SparseJoin) {
+  auto code_str = R"(
+    (
+      (load-param v0)
+      (if-eqz v0 :L0)
+      (const v1 1)
+      (goto :L1)
+      (:L0)
+      (const v1 1)
+      (:L1)
+      (if-eqz v1 :L2)
+      (const v2 2)
+      (:L2)
+      (return-void)
+    )
+)";
+  auto code = assembler::ircode_from_string(code_str);
+  do_sparse_const_prop(code.get());
+
+  auto expected_code = assembler::ircode_from_string(R"(
+    (
+      (load-param v0)
+      (if-eqz v0 :L0)
+      (const v1 1)
+      (goto :L1)
+      (:L0)
+      (const v1 1)
+      (:L1)
+      (const v2 2)
+      (return-void)
+    )
+)");
+  EXPECT_CODE_EQ(code.get(), expected_code.get());
+  check_same_as_dense(code_str);
+}
+
+TEST_F(ConstantPropagationTest, SparseUnexecutableDefinitions) {
+  // The only definition of v1 that is not constant is in a block that is
+  // never executed.
+  check_same_as_dense(R"(
+    (
+      (load-param v0)
+      (const v1 0)
+      (const v2 0)
+      (if-eqz v2 :L0)
+      (move v1 v0)
+      (:L0)
+      (if-nez v1 :L1)
+      (return-void)
+      (:L1)
+      (const v3 3)
+      (return-void)
+    )
+)");
+}
+
+TEST_F(ConstantPropagationTest, SparseLoop) {
+  check_same_as_dense(R"(
+    (
+      (load-param v0)
+      (const v1 0)
+      (const v2 5)
+      (:loop)
+      (add-int/lit8 v1 v1 1)
+      (mul-int v3 v2 v2)
+      (if-lt v1 v0 :loop)
+      (const v4 25)
+      (if-eq v3 v4 :end)
+      (const v5 1)
+      (:end)
+      (return-void)
+    )
+)");
+}
+
+TEST_F(ConstantPropagationTest, SparseMoveResult) {
+  check_same_as_dense(R"(
+    (
+      (const-wide v0 1)
+      (const-wide v2 2)
+      (cmp-long v4 v0 v2)
+      (if-ltz v4 :L0)
+      (const v5 3)
+      (:L0)
+      (filled-new-array (v4) "[I")
+      (move-result-object v6)
+      (return-void)
+    )
+)");
+}
@@ -363,3 +363,49 @@ TEST_F(GlobalTypeAnalysisTest, ClinitSimpleTest) {
   auto foo_exit_env = lta->get_exit_state_at(code->cfg().exit_block());
   EXPECT_EQ(foo_exit_env.get_reg_environment().get(1), get_type_domain("LO;"));
 }
+
+TEST_F(GlobalTypeAnalysisTest, CompactStatesTest) {
+  Scope scope;
+  prepare_scope(scope);
+
+  auto cls_a = DexType::make_type("LA;");
+  ClassCreator creator(cls_a);
+  creator.set_super(type::java_lang_Object());
+
+  auto meth_bar = assembler::method_from_string(R"(
+    (method (public static) "LA;.bar:(Ljava/lang/Object;)V"
+     (
+      (load-param-object v0)
+      (return-void)
+     )
+    )
+  )");
+  creator.add_method(meth_bar);
+
+  auto meth_foo = assembler::method_from_string(R"(
+    (method (public static) "LA;.foo:()V"
+     (
+      (new-instance "LO;")
+      (move-result-pseudo-object v0)
+      (invoke-direct (v0) "LO;.<init>:()V")
+      (invoke-static (v0) "LA;.bar:(Ljava/lang/Object;)V")
+      (return-void)
+     )
+    )
+  )");
+  meth_foo->rstate.set_root();
+  creator.add_method(meth_foo);
+  scope.push_back(creator.create());
+
+  walk::code(scope, [](DexMethod*, IRCode& code) {
+    code.build_cfg(/* editable */ false);
+  });
+
+  // The local analyses are the same once only the entry states are kept.
+  GlobalTypeAnalysis analysis(10, /* compact_states */ true);
+  auto gta = analysis.analyze(scope);
+  auto lta = gta->get_local_analysis(meth_bar);
+  auto code = meth_bar->get_code();
+  auto bar_exit_env = lta->get_exit_state_at(code->cfg().exit_block());
+  EXPECT_EQ(bar_exit_env.get_reg_environment().get(0), get_type_domain("LO;"));
+}
@@ -226,3 +226,57 @@ TEST_F(TypeAnalysisTransformTest, MultiArgumentPassingTest) {
 
   EXPECT_CODE_EQ(m_method_call->get_code(), expected_code.get());
 }
+
+TEST_F(TypeAnalysisTransformTest, RedundantNullChecksTest) {
+  Scope scope;
+  prepare_scope(scope);
+
+  auto cls_a = DexType::make_type("LA;");
+  ClassCreator creator(cls_a);
+  creator.set_super(type::java_lang_Object());
+
+  auto meth_baz = assembler::method_from_string(R"(
+    (method (public static) "LA;.baz:(LARG;)I"
+     (
+      (load-param-object v0)
+      (invoke-static (v0) "Ljava/util/Objects;.requireNonNull:(Ljava/lang/Object;)Ljava/lang/Object;")
+      (move-result-object v1)
+      (if-eqz v0 :null)
+      (const v2 1)
+      (return v2)
+      (:null)
+      (const v2 0)
+      (return v2)
+     )
+    )
+  )");
+  creator.add_method(meth_baz);
+
+  auto meth_foo = assembler::method_from_string(R"(
+    (method (public static) "LA;.foo:()V"
+     (
+      (new-instance "LARG;")
+      (move-result-pseudo-object v0)
+      (invoke-static (v0) "LA;.baz:(LARG;)I")
+      (return-void)
+     )
+    )
+  )");
+  meth_foo->rstate.set_root();
+  creator.add_method(meth_foo);
+  scope.push_back(creator.create());
+  run_opt(scope);
+
+  auto expected_code = assembler::ircode_from_string(R"(
+       (
+        (load-param-object v0)
+        (move-object v1 v0)
+        (const v2 1)
+        (return v2)
+        (const v2 0)
+        (return v2)
+       )
+    )");
+
+  EXPECT_CODE_EQ(meth_baz->get_code(), expected_code.get());
+}
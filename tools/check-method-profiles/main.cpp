@@ -14,11 +14,27 @@ int main(int argc, char* argv[]) {
   if (argc == 1 || std::string("--help") == argv[1] ||
       std::string("-h") == argv[1]) {
     // No args (or help), print usage.
-    std::cerr << "Usage: check-method-profiles PROF-FILE [PROF-FILE...]"
+    std::cerr << "Usage: check-method-profiles PROF-FILE [PROF-FILE...]\n"
+              << "       check-method-profiles --write-binary OUT-FILE "
+                 "PROF-FILE"
               << std::endl;
     return argc == 1 ? 1 : 0;
   }
 
+  if (std::string("--write-binary") == argv[1]) {
+    if (argc != 4) {
+      std::cerr << "--write-binary takes an output and an input file"
+                << std::endl;
+      return 1;
+    }
+    if (!method_profiles::MethodProfiles::write_binary_profile(argv[3],
+                                                               argv[2])) {
+      std::cerr << "Failed converting " << argv[3] << std::endl;
+      return 1;
+    }
+    return 0;
+  }
+
   bool fail = false;
   for (int i = 1; i < argc; ++i) {
     std::cout << "Processing " << argv[i] << std::endl;
@@ -220,10 +220,11 @@ void load_all_intermediate(const std::string& input_ir_dir,
   // load external classes
   Scope external_classes;
   if (!(*entry_data).get("jars", Json::nullValue).empty()) {
+    std::vector<std::string> jar_paths;
     for (const Json::Value& item : (*entry_data)["jars"]) {
-      const std::string jar_path = item.asString();
-      always_assert(load_jar_file(jar_path.c_str(), &external_classes));
+      jar_paths.push_back(item.asString());
     }
+    always_assert(load_jar_files(jar_paths, &external_classes));
   }
 
   init_ir_meta(stores);
@@ -5,16 +5,36 @@
  * LICENSE file in the root directory of this source tree.
  */
 
-#include <boost/scope_exit.hpp>
+#include <cstring>
 #include <fcntl.h>
 #include <iostream>
 #include <memory>
+#include <stdexcept>
 #include <string>
 #include <sys/mman.h>
 #include <sys/stat.h>
+#include <unistd.h>
 
 #include "PositionMap.h"
 
+PositionMap::~PositionMap() { munmap(m_mapping, m_mapping_size); }
+
+boost::string_view PositionMap::string(uint32_t id) const {
+  if (m_string_offsets == nullptr) {
+    return m_string_pool.at(id);
+  }
+  if (id >= m_string_pool_size) {
+    throw std::out_of_range("string id " + std::to_string(id));
+  }
+  uint32_t begin = m_string_offsets[id];
+  uint32_t end = m_string_offsets[id + 1];
+  if (begin > end || end > m_string_data_size) {
+    throw std::out_of_range("string offsets of " + std::to_string(id));
+  }
+  return boost::string_view(m_string_data + begin, end - begin);
+}
+
+
 std::unique_ptr<PositionMap> read_map(const char* filename) {
   int fd = open(filename, O_RDONLY);
   if (fd == -1) {
@@ -26,54 +46,111 @@ std::unique_ptr<PositionMap> read_map(const char* filename) {
   if (fstat(fd, &buf)) {
     std::cerr << "Cannot fstat file (" << filename
               << ") with error: " << strerror(errno) << std::endl;
+    close(fd);
     return nullptr;
   }
-  uint8_t* mapping = (uint8_t*)mmap(
-      nullptr, buf.st_size, PROT_READ, MAP_FILE | MAP_SHARED, fd, 0);
-  uint32_t magic = *(uint32_t*)mapping;
-  mapping += sizeof(uint32_t);
-  if (mapping == MAP_FAILED) {
+  size_t size = buf.st_size;
+  void* addr = mmap(nullptr, size, PROT_READ, MAP_FILE | MAP_SHARED, fd, 0);
+  close(fd);
+  if (addr == MAP_FAILED) {
     std::cerr << "mmap failed for file (" << filename
               << ") with error: " << strerror(errno) << std::endl;
     return nullptr;
   }
-  BOOST_SCOPE_EXIT_ALL(=, &buf) { munmap(mapping, buf.st_size); };
+  // From now on, the map owns the mapping.
+  std::unique_ptr<PositionMap> map(new PositionMap(addr, size));
+
+  const uint8_t* mapping = (const uint8_t*)addr;
+  const uint8_t* end = mapping + size;
+  auto read_u32 = [&](uint32_t* value) {
+    if (end - mapping < (ptrdiff_t)sizeof(uint32_t)) {
+      return false;
+    }
+    memcpy(value, mapping, sizeof(uint32_t));
+    mapping += sizeof(uint32_t);
+    return true;
+  };
+  auto truncated = [&]() {
+    std::cerr << "Truncated file (" << filename << ")\n";
+    return nullptr;
+  };
+
+  uint32_t magic;
+  if (!read_u32(&magic)) {
+    return truncated();
+  }
   if (magic != 0xfaceb000) {
     std::cerr << "Magic number mismatch\n";
     return nullptr;
   }
-  uint32_t version = *(uint32_t*)mapping;
-  mapping += sizeof(uint32_t);
+  uint32_t version;
+  if (!read_u32(&version)) {
+    return truncated();
+  }
+  if (version == 3) {
+    // Everything is used in place.
+    PositionMapHeaderV3 header;
+    if (size < sizeof(header)) {
+      return truncated();
+    }
+    memcpy(&header, addr, sizeof(header));
+    auto fits = [size](uint64_t offset, uint64_t count, uint64_t item_size) {
+      return offset % 4 == 0 && offset <= size &&
+             count <= (size - offset) / item_size;
+    };
+    if (!fits(header.string_offsets_offset, header.string_pool_size + 1ULL,
+              sizeof(uint32_t)) ||
+        !fits(header.string_data_offset, header.string_data_size, 1) ||
+        !fits(header.positions_offset, header.positions_size,
+              sizeof(PositionItem))) {
+      return truncated();
+    }
+    auto base = (const uint8_t*)addr;
+    map->m_string_offsets =
+        (const uint32_t*)(base + header.string_offsets_offset);
+    map->m_string_data = (const char*)(base + header.string_data_offset);
+    map->m_string_pool_size = header.string_pool_size;
+    map->m_string_data_size = header.string_data_size;
+    map->positions = (const PositionItem*)(base + header.positions_offset);
+    map->positions_size = header.positions_size;
+    return map;
+  }
   if (version != 2) {
     std::cerr << "Version mismatch\n";
     return nullptr;
   }
 
-  std::unique_ptr<PositionMap> map(new PositionMap());
-  std::vector<std::string> string_pool;
-  uint32_t spool_count = *(uint32_t*)mapping;
-  mapping += sizeof(uint32_t);
+  uint32_t spool_count;
+  if (!read_u32(&spool_count)) {
+    return truncated();
+  }
+  map->m_string_pool.reserve(spool_count);
   for (uint32_t i = 0; i < spool_count; ++i) {
-    uint32_t ssize = *(uint32_t*)mapping;
-    mapping += sizeof(uint32_t);
-    map->string_pool.emplace_back((const char*)mapping, ssize);
+    uint32_t ssize;
+    if (!read_u32(&ssize) || (size_t)(end - mapping) < ssize) {
+      return truncated();
+    }
+    map->m_string_pool.emplace_back((const char*)mapping, ssize);
     mapping += ssize;
   }
-  uint32_t pos_count = *(uint32_t*)mapping;
-  mapping += sizeof(uint32_t);
-  map->positions.reset(new PositionItem[pos_count]);
+  uint32_t pos_count;
+  if (!read_u32(&pos_count) ||
+      (size_t)(end - mapping) / sizeof(PositionItem) < pos_count) {
+    return truncated();
+  }
+  // The items are packed, so they can be used in place at any alignment.
+  map->positions = (const PositionItem*)mapping;
   map->positions_size = pos_count;
-  memcpy(map->positions.get(), mapping, pos_count * sizeof(PositionItem));
   return map;
 }
 
 std::vector<Position> get_stack(const PositionMap& map, int64_t idx) {
   std::vector<Position> stack;
   while (idx >= 0 && (size_t)idx < map.positions_size) {
-    auto pi = map.positions[idx];
-    stack.push_back(Position(map.string_pool[pi.class_id],
-                             map.string_pool[pi.method_id],
-                             map.string_pool[pi.file_id],
+    const auto& pi = map.positions[idx];
+    stack.push_back(Position(map.string(pi.class_id),
+                             map.string(pi.method_id),
+                             map.string(pi.file_id),
                              pi.line));
     idx = (int64_t)pi.parent - 1;
   }
@@ -5,6 +5,7 @@
  * LICENSE file in the root directory of this source tree.
  */
 
+#include <boost/utility/string_view.hpp>
 #include <memory>
 #include <string>
 #include <vector>
@@ -17,22 +18,62 @@ struct __attribute__((packed)) PositionItem {
   uint32_t parent;
 };
 
+// The strings point into the map they come from.
 struct Position {
-  std::string cls;
-  std::string method;
-  std::string filename;
+  boost::string_view cls;
+  boost::string_view method;
+  boost::string_view filename;
   uint32_t line;
-  Position(const std::string& cls,
-           const std::string& method,
-           const std::string& filename,
+  Position(boost::string_view cls,
+           boost::string_view method,
+           boost::string_view filename,
            uint32_t line)
       : cls(cls), method(method), filename(filename), line(line) {}
 };
 
+// The fixed-size header of a version 3 map, which RealPositionMapper writes.
+// All the offsets are 4-byte aligned, so that the map is used in place.
+struct PositionMapHeaderV3 {
+  uint32_t magic;
+  uint32_t version;
+  uint32_t string_pool_size;
+  uint32_t positions_size;
+  uint32_t string_offsets_offset;
+  uint32_t string_data_offset;
+  uint32_t string_data_size;
+  uint32_t positions_offset;
+};
+
+// The strings and positions point into the mapped file, which stays mapped
+// for the lifetime of the map. It can be shared by several threads.
 struct PositionMap {
-  std::vector<std::string> string_pool;
-  std::unique_ptr<PositionItem[]> positions;
+  const PositionItem* positions;
   size_t positions_size;
+
+  PositionMap(void* mapping, size_t mapping_size)
+      : positions(nullptr),
+        positions_size(0),
+        m_mapping(mapping),
+        m_mapping_size(mapping_size) {}
+  ~PositionMap();
+
+  PositionMap(const PositionMap&) = delete;
+  PositionMap& operator=(const PositionMap&) = delete;
+
+  boost::string_view string(uint32_t id) const;
+
+ private:
+  friend std::unique_ptr<PositionMap> read_map(const char* filename);
+
+  void* m_mapping;
+  size_t m_mapping_size;
+  // Version 2 maps must be scanned for their strings.
+  std::vector<boost::string_view> m_string_pool;
+  // Version 3 maps have their string offsets in place.
+  const uint32_t* m_string_offsets{nullptr};
+  const char* m_string_data{nullptr};
+  uint32_t m_string_pool_size{0};
+  uint32_t m_string_data_size{0};
 };
 
 std::unique_ptr<PositionMap> read_map(const char* filename);
@@ -5,31 +5,191 @@
  * LICENSE file in the root directory of this source tree.
  */
 
-#include <boost/regex.hpp>
+#include <algorithm>
+#include <atomic>
+#include <cctype>
+#include <cstring>
+#include <fstream>
 #include <iostream>
+#include <sstream>
 #include <string>
+#include <thread>
+#include <vector>
 
 #include "PositionMap.h"
 
-boost::regex trace_regex(R"/(((\s+at\s+)[^(]*)\(:(\d+)\)\s?)/");
+namespace {
+
+constexpr const char* kOutputSuffix = ".symbolicated";
+
+/*
+ * Recognizes the frames of the traces of the obfuscated line numbers, i.e.
+ * the lines that match
+ *
+ *   ((\s+at\s+)[^(]*)\(:(\d+)\)\s?
+ *
+ * Returns the length of the `\s+at\s+` prefix and the line number.
+ */
+bool parse_frame(boost::string_view line, size_t* prefix_size, int64_t* idx) {
+  auto space = [&](size_t i) {
+    return i < line.size() && std::isspace((unsigned char)line[i]);
+  };
+  size_t i = 0;
+  while (space(i)) {
+    ++i;
+  }
+  if (i == 0 || line.substr(i, 2) != "at") {
+    return false;
+  }
+  i += 2;
+  if (!space(i)) {
+    return false;
+  }
+  while (space(i)) {
+    ++i;
+  }
+  *prefix_size = i;
+
+  i = line.find('(', i);
+  if (i == boost::string_view::npos || line.substr(i, 2) != "(:") {
+    return false;
+  }
+  i += 2;
+  size_t digits = i;
+  int64_t number = 0;
+  while (i < line.size() && std::isdigit((unsigned char)line[i])) {
+    // Anything bigger is not in the map anyway.
+    number = std::min<int64_t>(number * 10 + (line[i] - '0'), 1LL << 40);
+    ++i;
+  }
+  if (i == digits || i == line.size() || line[i] != ')') {
+    return false;
+  }
+  ++i;
+  if (space(i)) {
+    ++i;
+  }
+  if (i != line.size()) {
+    return false;
+  }
+  *idx = number - 1;
+  return true;
+}
+
+// Symbolicates the lines of a trace, which must end with a newline unless it
+// is empty.
+void symbolicate(const PositionMap& map,
+                 boost::string_view text,
+                 std::string* out) {
+  while (!text.empty()) {
+    auto eol = text.find('\n');
+    auto line = text.substr(0, eol);
+    text.remove_prefix(eol == boost::string_view::npos ? text.size()
+                                                       : eol + 1);
+    size_t prefix_size;
+    int64_t idx;
+    if (!parse_frame(line, &prefix_size, &idx)) {
+      out->append(line.data(), line.size());
+      out->push_back('\n');
+      continue;
+    }
+    auto prefix = line.substr(0, prefix_size);
+    for (const auto& pos : get_stack(map, idx)) {
+      out->append(prefix.data(), prefix.size());
+      out->append(pos.cls.data(), pos.cls.size());
+      out->push_back('.');
+      out->append(pos.method.data(), pos.method.size());
+      out->push_back('(');
+      out->append(pos.filename.data(), pos.filename.size());
+      out->push_back(':');
+      out->append(std::to_string(pos.line));
+      out->append(")\n");
+    }
+  }
+}
+
+bool symbolicate_file(const PositionMap& map, const std::string& path) {
+  std::ifstream in(path, std::ios::binary);
+  if (!in) {
+    std::cerr << "Cannot read " << path << "\n";
+    return false;
+  }
+  std::stringstream contents;
+  contents << in.rdbuf();
+  std::string text = contents.str();
+  if (!text.empty() && text.back() != '\n') {
+    text.push_back('\n');
+  }
+  std::string out;
+  out.reserve(text.size() + text.size() / 2);
+  symbolicate(map, text, &out);
+
+  auto out_path = path + kOutputSuffix;
+  std::ofstream os(out_path, std::ios::binary | std::ios::trunc);
+  os.write(out.data(), out.size());
+  os.close();
+  if (!os) {
+    std::cerr << "Cannot write " << out_path << "\n";
+    return false;
+  }
+  return true;
+}
+
+void print_usage() {
+  std::cerr << "Usage: cat trace | symbolicate-trace mapping_file\n"
+            << "       symbolicate-trace [-j <threads>] mapping_file "
+               "trace_file...\n"
+            << "The second form writes each trace_file" << kOutputSuffix
+            << " on several threads.\n";
+}
+
+} // namespace
 
 int main(int argc, char** argv) {
-  if (argc < 2) {
-    std::cerr << "Usage: cat trace | remap mapping_file\n";
+  size_t threads = std::max(1u, std::thread::hardware_concurrency());
+  int arg = 1;
+  if (arg + 1 < argc && strcmp(argv[arg], "-j") == 0) {
+    threads = std::max(1, atoi(argv[arg + 1]));
+    arg += 2;
+  }
+  if (arg >= argc) {
+    print_usage();
     abort();
   }
-  auto map = read_map(argv[1]);
-  for (std::string line; std::getline(std::cin, line);) {
-    boost::smatch matches;
-    if (boost::regex_match(line, matches, trace_regex)) {
-      auto idx = std::stoi(matches[3]) - 1;
-      auto stack = get_stack(*map, idx);
-      for (const auto& pos : stack) {
-        std::cout << matches[2] << pos.cls << "." << pos.method << "("
-                  << pos.filename << ":" << pos.line << ")" << std::endl;
+  auto map = read_map(argv[arg++]);
+  if (map == nullptr) {
+    return 1;
+  }
+
+  if (arg == argc) {
+    std::string out;
+    for (std::string line; std::getline(std::cin, line);) {
+      line.push_back('\n');
+      out.clear();
+      symbolicate(*map, line, &out);
+      std::cout << out;
+    }
+    return 0;
+  }
+
+  // The files are independent, and the map is read-only.
+  std::vector<std::string> paths(argv + arg, argv + argc);
+  std::atomic<size_t> next{0};
+  std::atomic<bool> ok{true};
+  auto worker = [&]() {
+    for (size_t i; (i = next++) < paths.size();) {
+      if (!symbolicate_file(*map, paths[i])) {
+        ok = false;
       }
-    } else {
-      std::cout << line << std::endl;
     }
+  };
+  std::vector<std::thread> pool;
+  for (size_t i = 1; i < std::min(threads, paths.size()); ++i) {
+    pool.emplace_back(worker);
+  }
+  worker();
+  for (auto& t : pool) {
+    t.join();
   }
+  return ok ? 0 : 1;
 }
@@ -7,26 +7,198 @@
 
 #include <cstdio>
 #include <cstdlib>
+#include <cstring>
+#include <fcntl.h>
 #include <getopt.h>
 #include <regex>
+#include <string>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <unistd.h>
+#include <vector>
 
 #include "DexCommon.h"
 
+namespace {
+
+/*
+ * The index of a dex holds the names of its classes in class def order, so
+ * that queries don't have to load the dex. It is stored next to the dex and
+ * tied to it by the dex's SHA-1 signature.
+ *
+ * The header is followed by num_classes offsets into the names, and then by
+ * the NUL-terminated names themselves.
+ */
+constexpr char kIndexMagic[8] = "dexgrp1";
+constexpr const char* kIndexSuffix = ".dexgrep-index";
+
+struct IndexHeader {
+  char magic[8];
+  uint8_t dex_signature[20];
+  uint32_t num_classes;
+  uint32_t names_size;
+};
+
+bool read_dex_header(const char* dexfile, dex_header* header) {
+  FILE* fp = fopen(dexfile, "rb");
+  if (fp == nullptr) {
+    return false;
+  }
+  bool ok = fread(header, sizeof(dex_header), 1, fp) == 1;
+  fclose(fp);
+  return ok;
+}
+
+class MappedIndex {
+ public:
+  // Maps the index at path if it exists and matches the dex.
+  MappedIndex(const std::string& path, const dex_header& dexh) {
+    int fd = open(path.c_str(), O_RDONLY);
+    if (fd < 0) {
+      return;
+    }
+    struct stat st;
+    if (fstat(fd, &st) == 0 && st.st_size >= (off_t)sizeof(IndexHeader)) {
+      m_size = st.st_size;
+      void* map = mmap(nullptr, m_size, PROT_READ, MAP_PRIVATE, fd, 0);
+      if (map != MAP_FAILED) {
+        m_data = static_cast<const char*>(map);
+      }
+    }
+    close(fd);
+    if (m_data != nullptr && !validate(dexh)) {
+      munmap(const_cast<char*>(m_data), m_size);
+      m_data = nullptr;
+    }
+  }
+
+  ~MappedIndex() {
+    if (m_data != nullptr) {
+      munmap(const_cast<char*>(m_data), m_size);
+    }
+  }
+
+  bool valid() const { return m_data != nullptr; }
+
+  uint32_t num_classes() const { return header()->num_classes; }
+
+  const char* class_name(uint32_t i) const {
+    auto offsets = reinterpret_cast<const uint32_t*>(header() + 1);
+    return names() + offsets[i];
+  }
+
+ private:
+  const IndexHeader* header() const {
+    return reinterpret_cast<const IndexHeader*>(m_data);
+  }
+
+  const char* names() const {
+    return m_data + sizeof(IndexHeader) + num_classes() * sizeof(uint32_t);
+  }
+
+  bool validate(const dex_header& dexh) const {
+    auto h = header();
+    if (memcmp(h->magic, kIndexMagic, sizeof(kIndexMagic)) != 0 ||
+        memcmp(h->dex_signature, dexh.signature, sizeof(dexh.signature)) !=
+            0 ||
+        m_size != sizeof(IndexHeader) + h->num_classes * sizeof(uint32_t) +
+                      h->names_size ||
+        (h->names_size != 0 && names()[h->names_size - 1] != '\0')) {
+      return false;
+    }
+    auto offsets = reinterpret_cast<const uint32_t*>(h + 1);
+    for (uint32_t i = 0; i < h->num_classes; i++) {
+      if (offsets[i] >= h->names_size) {
+        return false;
+      }
+    }
+    return true;
+  }
+
+  const char* m_data{nullptr};
+  size_t m_size{0};
+};
+
+// Writes the index of the dex, to a temporary file first so that concurrent
+// queries never see a partial one. Returns the class names.
+std::vector<std::string> write_index(const char* dexfile,
+                                     const std::string& path) {
+  ddump_data rd;
+  open_dex_file(dexfile, &rd);
+  std::vector<std::string> class_names;
+  auto size = rd.dexh->class_defs_size;
+  class_names.reserve(size);
+  for (uint32_t j = 0; j < size; j++) {
+    dex_class_def* cls_def = rd.dex_class_defs + j;
+    class_names.emplace_back(dex_string_by_type_idx(&rd, cls_def->typeidx));
+  }
+
+  IndexHeader header{};
+  memcpy(header.magic, kIndexMagic, sizeof(kIndexMagic));
+  memcpy(header.dex_signature, rd.dexh->signature,
+         sizeof(header.dex_signature));
+  header.num_classes = size;
+  std::vector<uint32_t> offsets;
+  offsets.reserve(size);
+  std::string names;
+  for (const auto& name : class_names) {
+    offsets.push_back(names.size());
+    names += name;
+    names += '\0';
+  }
+  header.names_size = names.size();
+  munmap(rd.dexmmap, rd.dex_size);
+
+  auto tmp_path = path + "." + std::to_string(getpid());
+  FILE* fp = fopen(tmp_path.c_str(), "wb");
+  if (fp == nullptr) {
+    fprintf(stderr, "Cannot write index %s\n", tmp_path.c_str());
+    return class_names;
+  }
+  bool ok = fwrite(&header, sizeof(header), 1, fp) == 1 &&
+            fwrite(offsets.data(), sizeof(uint32_t), offsets.size(), fp) ==
+                offsets.size() &&
+            fwrite(names.data(), 1, names.size(), fp) == names.size();
+  ok = fclose(fp) == 0 && ok;
+  if (!ok || rename(tmp_path.c_str(), path.c_str()) != 0) {
+    fprintf(stderr, "Cannot write index %s\n", path.c_str());
+    unlink(tmp_path.c_str());
+  }
+  return class_names;
+}
+
+// Queries without regex operators are matched with a plain substring search.
+bool is_literal(const char* search_str) {
+  return strpbrk(search_str, "^$\\.*+?()[]{}|") == nullptr;
+}
+
+} // namespace
+
 void print_usage() {
-  fprintf(stderr, "Usage: dexgrep <classname> <dexfile 1> <dexfile 2> ...\n");
+  fprintf(stderr,
+          "Usage: dexgrep [-l] [-i] <classname> <dexfile 1> <dexfile 2> ...\n"
+          "  -l, --files-without-match: only print the matching dex files\n"
+          "  -i, --index: answer from an index of each dex, which is written "
+          "next to it if it is missing or stale\n");
 }
 
 int main(int argc, char* argv[]) {
   bool files_only = false;
+  bool use_index = false;
   char c;
   static const struct option options[] = {
       {"files-without-match", no_argument, nullptr, 'l'},
+      {"index", no_argument, nullptr, 'i'},
+      {nullptr, 0, nullptr, 0},
   };
-  while ((c = getopt_long(argc, argv, "hl", &options[0], nullptr)) != -1) {
+  while ((c = getopt_long(argc, argv, "hli", &options[0], nullptr)) != -1) {
     switch (c) {
     case 'l':
       files_only = true;
       break;
+    case 'i':
+      use_index = true;
+      break;
     case 'h':
       print_usage();
       return 0;
@@ -44,9 +216,46 @@ int main(int argc, char* argv[]) {
 
   const char* search_str = argv[optind];
   std::regex re(search_str);
+  bool literal = is_literal(search_str);
+  auto matches = [&](const char* name) {
+    return literal ? strstr(name, search_str) != nullptr
+                   : std::regex_search(name, re);
+  };
 
   for (int i = optind + 1; i < argc; ++i) {
     const char* dexfile = argv[i];
+    auto report = [&](const char* name) {
+      if (files_only) {
+        printf("%s\n", dexfile);
+      } else {
+        printf("%s: %s\n", dexfile, name);
+      }
+    };
+
+    if (use_index) {
+      dex_header dexh;
+      if (!read_dex_header(dexfile, &dexh)) {
+        fprintf(stderr, "Cannot read dex file %s\n", dexfile);
+        return 1;
+      }
+      auto index_path = std::string(dexfile) + kIndexSuffix;
+      MappedIndex index(index_path, dexh);
+      if (index.valid()) {
+        for (uint32_t j = 0; j < index.num_classes(); j++) {
+          if (matches(index.class_name(j))) {
+            report(index.class_name(j));
+          }
+        }
+      } else {
+        for (const auto& name : write_index(dexfile, index_path)) {
+          if (matches(name.c_str())) {
+            report(name.c_str());
+          }
+        }
+      }
+      continue;
+    }
+
     ddump_data rd;
     open_dex_file(dexfile, &rd);
 
@@ -54,12 +263,8 @@ int main(int argc, char* argv[]) {
     for (uint32_t j = 0; j < size; j++) {
       dex_class_def* cls_def = rd.dex_class_defs + j;
       char* name = dex_string_by_type_idx(&rd, cls_def->typeidx);
-      if (std::regex_search(name, re)) {
-        if (files_only) {
-          printf("%s\n", dexfile);
-        } else {
-          printf("%s: %s\n", dexfile, name);
-        }
+      if (matches(name)) {
+        report(name);
       }
     }
   }
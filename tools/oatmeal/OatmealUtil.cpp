@@ -40,10 +40,13 @@ void stream_file(FileHandle& in, FileHandle& out) {
 }
 
 void write_padding(FileHandle& fh, char byte, size_t num) {
-  // This might be inefficient, but the most padding we ever do at
-  // once is 4k, so this shouldn't be too bad.
-  for (size_t i = 0; i < num; i++) {
-    CHECK(fh.fwrite(&byte, sizeof(char), 1) == sizeof(char));
+  constexpr size_t kChunkSize = 0x1000;
+  char chunk[kChunkSize];
+  memset(chunk, byte, std::min(num, kChunkSize));
+  while (num > 0) {
+    auto len = std::min(num, kChunkSize);
+    write_buf(fh, ConstBuffer{chunk, len});
+    num -= len;
   }
 }
 
@@ -11,9 +11,13 @@
 #include "DexOpcodeDefs.h"
 #include "file-utils.h"
 
+#include <algorithm>
+#include <atomic>
 #include <cstdio>
+#include <cstring>
 #include <memory>
 #include <string>
+#include <thread>
 #include <utility>
 #include <vector>
 
@@ -54,6 +58,33 @@ static void foreach_pair(const T1& t1, const T2& t2, const L& fn) {
   }
 }
 
+// Calls fn(i) for every i in [0, n), spread over the available cores. fn must
+// not touch the memory accounter, which is not thread-safe.
+template <typename L>
+void parallel_for(size_t n, const L& fn) {
+  size_t num_threads = std::min<size_t>(
+      n, std::max<size_t>(std::thread::hardware_concurrency(), 1));
+  if (num_threads <= 1) {
+    for (size_t i = 0; i < n; i++) {
+      fn(i);
+    }
+    return;
+  }
+  std::atomic<size_t> next{0};
+  std::vector<std::thread> threads;
+  threads.reserve(num_threads);
+  for (size_t t = 0; t < num_threads; t++) {
+    threads.emplace_back([&]() {
+      for (size_t i = next++; i < n; i = next++) {
+        fn(i);
+      }
+    });
+  }
+  for (auto& thread : threads) {
+    thread.join();
+  }
+}
+
 template <uint32_t Width>
 uint32_t align(uint32_t in) {
   return (in + (Width - 1)) & -Width;
@@ -113,6 +144,15 @@ struct ConstBuffer {
     CHECK(n < len);
     return ptr[n];
   }
+
+  // Reads the n-th T of the buffer in place, as it may not be aligned.
+  template <typename T>
+  T at(size_t n) const {
+    CHECK((n + 1) * sizeof(T) <= len);
+    T value;
+    memcpy(&value, ptr + n * sizeof(T), sizeof(T));
+    return value;
+  }
 };
 
 void write_buf(FileHandle& fh, ConstBuffer buf);
@@ -167,6 +207,22 @@ struct WritableBuffer {
 
 void write_padding(FileHandle& fh, char byte, size_t num);
 
+// A stdio buffer big enough that the many small writes of the oat builder
+// are coalesced into few syscalls. It must outlive the file it is set on.
+class OutputBuffer {
+ public:
+  static constexpr size_t kSize = 1 << 20;
+
+  OutputBuffer() : buf_(new char[kSize]) {}
+
+  void set_on(FileHandle& fh) {
+    CHECK(setvbuf(fh.get(), buf_.get(), _IOFBF, kSize) == 0);
+  }
+
+ private:
+  std::unique_ptr<char[]> buf_;
+};
+
 template <typename T>
 void write_obj(FileHandle& fh, const T& obj) {
   write_buf(fh, ConstBuffer{reinterpret_cast<const char*>(&obj), sizeof(T)});
@@ -466,46 +466,33 @@ class DexIdBufs {
             uint32_t dex_offset,
             const DexFileHeader& header) {
     dex_buf_ = oat_buf.slice(dex_offset);
-    auto class_defs_buf = dex_buf_.slice(header.class_defs_off);
-    auto type_ids_buf = dex_buf_.slice(header.type_ids_off);
-    auto string_ids_buf = dex_buf_.slice(header.string_ids_off);
-    auto method_ids_buf = dex_buf_.slice(header.method_ids_off);
-
-    // We memcpy into new buffers since the data in the dex may not be aligned.
-    class_defs_.reset(new DexClassDef[header.class_defs_size]);
-    type_ids_.reset(new uint32_t[header.type_ids_size]);
-    string_ids_.reset(new uint32_t[header.string_ids_size]);
-
-    memcpy(class_defs_.get(),
-           class_defs_buf.ptr,
-           header.class_defs_size * sizeof(DexClassDef));
-    memcpy(type_ids_.get(),
-           type_ids_buf.ptr,
-           header.type_ids_size * sizeof(uint32_t));
-    memcpy(string_ids_.get(),
-           string_ids_buf.ptr,
-           header.string_ids_size * sizeof(uint32_t));
+    // The ids are read in place, with memcpy since the data in the dex may not
+    // be aligned.
+    class_defs_ = dex_buf_.slice(header.class_defs_off)
+                      .truncate(header.class_defs_size * sizeof(DexClassDef));
+    type_ids_ = dex_buf_.slice(header.type_ids_off)
+                    .truncate(header.type_ids_size * sizeof(uint32_t));
+    string_ids_ = dex_buf_.slice(header.string_ids_off)
+                      .truncate(header.string_ids_size * sizeof(uint32_t));
+    auto method_ids = dex_buf_.slice(header.method_ids_off)
+                          .truncate(header.method_ids_size * sizeof(MethodId));
 
     // note: method ids are indexed by type, not class, hence must be size of
     // type_ids_size
     class_method_count_.resize(header.type_ids_size, 0);
-    auto method_ids = std::make_unique<MethodId[]>(header.method_ids_size);
-    memcpy(method_ids.get(),
-           method_ids_buf.ptr,
-           header.method_ids_size * sizeof(MethodId));
     for (unsigned int i = 0; i < header.method_ids_size; i++) {
-      class_method_count_.at(method_ids[i].class_idx)++;
+      class_method_count_.at(method_ids.at<MethodId>(i).class_idx)++;
     }
   }
 
   int get_num_methods(int i) const {
-    return class_method_count_[class_defs_[i].class_idx];
+    return class_method_count_[class_defs_.at<DexClassDef>(i).class_idx];
   }
 
   std::string get_class_name(int i) const {
-    const auto class_idx = class_defs_[i].class_idx;
-    const auto string_id = type_ids_[class_idx];
-    const auto string_offset = string_ids_[string_id];
+    const auto class_idx = class_defs_.at<DexClassDef>(i).class_idx;
+    const auto string_id = type_ids_.at<uint32_t>(class_idx);
+    const auto string_offset = string_ids_.at<uint32_t>(string_id);
 
     auto string_buf = dex_buf_.slice(string_offset);
     char* ptr = const_cast<char*>(string_buf.ptr);
@@ -516,9 +503,9 @@ class DexIdBufs {
 
  private:
   ConstBuffer dex_buf_;
-  std::unique_ptr<DexClassDef[]> class_defs_;
-  std::unique_ptr<uint32_t[]> type_ids_;
-  std::unique_ptr<uint32_t[]> string_ids_;
+  ConstBuffer class_defs_;
+  ConstBuffer type_ids_;
+  ConstBuffer string_ids_;
 
   std::vector<int> class_method_count_;
 };
@@ -1366,9 +1353,7 @@ class OatClasses_064 : public OatClasses {
         continue;
       }
       CHECK(file.class_offsets[0] == cksum_fh.bytes_written());
-      for (const auto& info : file.class_info) {
-        write_obj(cksum_fh, info);
-      }
+      write_vec(cksum_fh, file.class_info);
     }
   }
 };
@@ -1479,28 +1464,22 @@ void OatClasses_079::write(const std::vector<DexFileType>& dex_files,
 #endif
 
     // write pointers to ClassInfo.
+    std::vector<uint32_t> class_offsets(num_classes);
     for (size_t i = 0; i < num_classes; i++) {
-      write_word(cksum_fh, table_offset + i * sizeof(uint32_t));
+      class_offsets[i] = table_offset + i * sizeof(uint32_t);
 
 #ifdef DEBUG_LOG
-      printf("#ClassOffsets[%zu] -> %zu\n",
-             i,
-             table_offset + i * sizeof(uint32_t));
+      printf("#ClassOffsets[%zu] -> %u\n", i, class_offsets[i]);
 #endif
     }
+    write_vec(cksum_fh, class_offsets);
     CHECK(table_offset == cksum_fh.bytes_written());
 
     // Write ClassInfo structs.
     OatClasses::ClassInfo info(OatClasses::Status::kStatusVerified,
                                OatClasses::Type::kOatClassNoneCompiled);
-    for (size_t i = 0; i < num_classes; i++) {
-      write_obj(cksum_fh, info);
-
-#ifdef DEBUG_LOG
-      printf("#OatClass[%zu]:%u ::  type: %u\n", i, table_offset, info.type);
-#endif
-      table_offset += sizeof(OatClasses::ClassInfo);
-    }
+    write_vec(cksum_fh, std::vector<OatClasses::ClassInfo>(num_classes, info));
+    table_offset += num_classes * sizeof(OatClasses::ClassInfo);
     CHECK(table_offset == cksum_fh.bytes_written());
     dex_count++;
   }
@@ -1557,20 +1536,25 @@ class SamsungLookupTables {
       const std::vector<DexInput>& dex_input_vec,
       const std::vector<DexFileListing_064::DexFile_064>& dex_files,
       FileHandle& cksum_fh) {
-    foreach_pair(
-        dex_input_vec,
-        dex_files,
-        [&](const DexInput& dex_input,
-            const DexFileListing_064::DexFile_064& dex_file) {
-          CHECK(dex_file.lookup_table_offset == cksum_fh.bytes_written());
-
-          auto table = build_lookup_table(dex_input.filename);
-
-          auto buf =
-              ConstBuffer{reinterpret_cast<const char*>(table.data.get()),
-                          table.byte_size()};
-          write_buf(cksum_fh, buf);
-        });
+    // The tables are independent, so build them all at once and write them
+    // out in order.
+    CHECK(dex_input_vec.size() == dex_files.size());
+    std::vector<std::unique_ptr<LookupTable>> tables(dex_files.size());
+    parallel_for(dex_files.size(), [&](size_t i) {
+      tables[i] = std::make_unique<LookupTable>(
+          build_lookup_table(dex_input_vec[i].filename));
+    });
+    foreach_pair(dex_files,
+                 tables,
+                 [&](const DexFileListing_064::DexFile_064& dex_file,
+                     const std::unique_ptr<LookupTable>& table) {
+                   CHECK(dex_file.lookup_table_offset ==
+                         cksum_fh.bytes_written());
+                   auto buf = ConstBuffer{
+                       reinterpret_cast<const char*>(table->data.get()),
+                       table->byte_size()};
+                   write_buf(cksum_fh, buf);
+                 });
   }
 
  private:
@@ -1777,20 +1761,22 @@ class LookupTables {
   static void write(const std::vector<DexInput>& dex_input_vec,
                     const std::vector<DexFileType>& dex_files,
                     FileHandle& cksum_fh) {
+    // The tables are independent, so build them all at once and write them
+    // out in order.
+    CHECK(dex_input_vec.size() == dex_files.size());
+    std::vector<std::unique_ptr<LookupTableEntry[]>> tables(dex_files.size());
+    parallel_for(dex_files.size(), [&](size_t i) {
+      tables[i] = build_lookup_table(dex_input_vec[i].filename,
+                                     numEntries(dex_files[i].num_classes));
+    });
     foreach_pair(
-        dex_input_vec,
         dex_files,
-        [&](const DexInput& dex_input,
-            const DexFileListing_079::DexFile_079& dex_file) {
+        tables,
+        [&](const DexFileListing_079::DexFile_079& dex_file,
+            const std::unique_ptr<LookupTableEntry[]>& lookup_table_buf) {
           CHECK(dex_file.lookup_table_offset == cksum_fh.bytes_written());
-          const auto num_classes = dex_file.num_classes;
-
-          const auto lookup_table_size = numEntries(num_classes);
           const auto lookup_table_byte_size =
-              lookup_table_size * sizeof(LookupTableEntry);
-
-          auto lookup_table_buf =
-              build_lookup_table(dex_input.filename, lookup_table_size);
+              numEntries(dex_file.num_classes) * sizeof(LookupTableEntry);
           auto buf =
               ConstBuffer{reinterpret_cast<const char*>(lookup_table_buf.get()),
                           lookup_table_byte_size};
@@ -2775,11 +2761,10 @@ std::vector<DexFileListing_064::DexFile_064> DexFileListing_064::build(
       total_lookup_table_size += SamsungLookupTables::rawSize(num_types);
     }
 
-    std::vector<ClassInfo> classes;
-    for (unsigned int i = 0; i < num_classes; i++) {
-      classes.push_back(ClassInfo(OatClasses::Status::kStatusVerified,
-                                  OatClasses::Type::kOatClassNoneCompiled));
-    }
+    std::vector<ClassInfo> classes(
+        num_classes,
+        ClassInfo(OatClasses::Status::kStatusVerified,
+                  OatClasses::Type::kOatClassNoneCompiled));
 
     dex_files.push_back(DexFileListing_064::DexFile_064(
         dex.location,
@@ -3167,10 +3152,12 @@ OatFile::Status build_oatfile(const std::string& oat_file_name,
 
   ////////// Write the file.
 
+  OutputBuffer oat_buf;
   auto oat_fh = FileHandle(fopen(oat_file_name.c_str(), "w"));
   if (oat_fh.get() == nullptr) {
     return OatFile::Status::BUILD_IO_ERROR;
   }
+  oat_buf.set_on(oat_fh);
 
   if (write_elf) {
     write_padding(oat_fh, 0, 0x1000);
@@ -3294,10 +3281,12 @@ OatFile::Status build_vdex_odex_pairs(const std::string& oat_file_name,
 
   ////////// Write the file.
 
+  OutputBuffer oat_buf;
   auto oat_fh = FileHandle(fopen(oat_file_name.c_str(), "w"));
   if (oat_fh.get() == nullptr) {
     return OatFile::Status::BUILD_IO_ERROR;
   }
+  oat_buf.set_on(oat_fh);
 
   if (write_elf) {
     write_padding(oat_fh, 0, 0x1000);
@@ -3347,7 +3336,9 @@ OatFile::Status build_vdex_odex_pairs(const std::string& oat_file_name,
   dex_fh.fread(&dex_checksum, sizeof(uint32_t), 1);
   dex_fh.seek_set(0);
 
+  OutputBuffer vdex_buf;
   auto vdex_fh = FileHandle(fopen(vdex_file_name.c_str(), "w"));
+  vdex_buf.set_on(vdex_fh);
 
   write_vdex_header(
       vdex_fh, vdexVersion(oat_version), 1, dex_file_size, 0, 0, dex_checksum);
@@ -8,9 +8,13 @@
 #include "OatmealUtil.h"
 #include "dump-oat.h"
 #include "memory-accounter.h"
+#include "mmap.h"
 #include "vdex.h"
 
 #include <getopt.h>
+#include <sys/mman.h>
+#include <sys/wait.h>
+#include <unistd.h>
 
 #ifndef ANDROID
 #include <wordexp.h>
@@ -23,6 +27,7 @@
 #include <memory>
 
 #include <string>
+#include <thread>
 #include <vector>
 
 namespace {
@@ -61,6 +66,10 @@ struct Arguments {
 
   // generate samsung compatible oat file.
   bool samsung_mode = false;
+
+  // When set, --dump takes any number of oat files, and dumps up to this many
+  // of them at a time.
+  size_t parallel_jobs = 0;
 };
 
 #ifndef ANDROID
@@ -101,6 +110,7 @@ Arguments parse_args(int argc, char* argv[]) {
       {"samsung-oatformat", no_argument, nullptr, 2},
       {"one-oat-per-dex", no_argument, nullptr, 3},
       {"quickening-data", required_argument, nullptr, 'q'},
+      {"parallel", optional_argument, nullptr, 4},
       {nullptr, 0, nullptr, 0}};
 
   Arguments ret;
@@ -191,6 +201,15 @@ Arguments parse_args(int argc, char* argv[]) {
       ret.quick_data_location = expand(optarg);
       break;
 
+    case 4:
+      ret.parallel_jobs = optarg != nullptr
+                              ? std::strtoul(optarg, nullptr, 10)
+                              : std::thread::hardware_concurrency();
+      if (ret.parallel_jobs == 0) {
+        ret.parallel_jobs = 1;
+      }
+      break;
+
     case ':':
       fprintf(stderr, "ERROR: %s requires an argument\n", argv[optind - 1]);
       exit(1);
@@ -203,6 +222,14 @@ Arguments parse_args(int argc, char* argv[]) {
     }
   }
 
+  if (ret.parallel_jobs != 0 &&
+      (ret.action != Action::DUMP || ret.test_is_oatmeal)) {
+    fprintf(stderr,
+            "--parallel can only be used with -d/--dump, without "
+            "--test-is-oatmeal\n");
+    exit(1);
+  }
+
   if (ret.action != Action::DUMP && ret.print_unverified_classes) {
     fprintf(stderr,
             "-p/--print-unverified-classes can only be used with -d/--dump\n");
@@ -231,13 +258,7 @@ Arguments parse_args(int argc, char* argv[]) {
   return ret;
 }
 
-int dump(const Arguments& args) {
-  if (args.oat_files.size() != 1) {
-    fprintf(stderr, "-o/--oat required (exactly once)\n");
-    return 1;
-  }
-
-  auto const& oat_file_name = args.oat_files[0];
+int dump_file(const Arguments& args, const std::string& oat_file_name) {
   auto oat_file = FileHandle(fopen(oat_file_name.c_str(), "r"));
   if (oat_file.get() == nullptr) {
     fprintf(stderr,
@@ -248,21 +269,28 @@ int dump(const Arguments& args) {
   }
 
   auto oat_file_size = get_filesize(oat_file);
+  if (oat_file_size <= 4) {
+    fprintf(stderr, "File %s is too small\n", oat_file_name.c_str());
+    return 1;
+  }
 
-  // We don't run dumping during install on device, so it is allowed to consume
-  // lots of memory.
-  auto oat_file_contents = std::make_unique<char[]>(oat_file_size);
-  auto oatFileBytesRead =
-      fread(oat_file_contents.get(), 1, oat_file_size, oat_file.get());
-  if (oatFileBytesRead != oat_file_size) {
+  // The file is parsed in place, which also lets the kernel share its pages
+  // with the other oatmeal processes of a batch.
+  std::string error_msg;
+  std::unique_ptr<MappedFile> oat_file_map(
+      MappedFile::mmap_file(oat_file_size, PROT_READ, MAP_PRIVATE,
+                            fileno(oat_file.get()), oat_file_name.c_str(),
+                            &error_msg));
+  if (oat_file_map == nullptr) {
     fprintf(stderr,
-            "Failed to read file %s (%zd)\n",
-            std::strerror(errno),
-            oatFileBytesRead);
+            "Failed to map file %s: %s\n",
+            oat_file_name.c_str(),
+            error_msg.c_str());
     return 1;
   }
 
-  ConstBuffer oatfile_buffer{oat_file_contents.get(), oat_file_size};
+  ConstBuffer oatfile_buffer{
+      reinterpret_cast<const char*>(oat_file_map->begin()), oat_file_size};
   auto ma_scope = MemoryAccounter::NewScope(oatfile_buffer);
 
   CHECK(oatfile_buffer.len > 4);
@@ -294,6 +322,101 @@ int dump(const Arguments& args) {
   return oatfile->status() == OatFile::Status::PARSE_SUCCESS ? 0 : 1;
 }
 
+// Dumps every file in a child process, since the parsing state (e.g. the
+// memory accounter) is global. The output of each child goes to a temporary
+// file, which is copied to stdout in the order of the arguments as soon as the
+// files before it are done. Returns 1 if dumping any of the files failed.
+int dump_files_in_parallel(const Arguments& args) {
+  struct Job {
+    pid_t pid{-1};
+    FILE* out{nullptr};
+    bool done{false};
+    int ret{1};
+  };
+  const auto& files = args.oat_files;
+  std::vector<Job> jobs(files.size());
+
+  size_t next_to_start = 0;
+  size_t next_to_print = 0;
+  size_t running = 0;
+  int ret = 0;
+  while (next_to_print < files.size()) {
+    while (running < args.parallel_jobs && next_to_start < files.size()) {
+      auto& job = jobs[next_to_start];
+      job.out = tmpfile();
+      if (job.out == nullptr) {
+        fprintf(stderr, "tmpfile failed: %s\n", std::strerror(errno));
+        return 1;
+      }
+      // The children must not inherit output that is still buffered.
+      fflush(stdout);
+      fflush(stderr);
+      job.pid = fork();
+      if (job.pid == -1) {
+        fprintf(stderr, "fork failed: %s\n", std::strerror(errno));
+        return 1;
+      }
+      if (job.pid == 0) {
+        dup2(fileno(job.out), STDOUT_FILENO);
+        int child_ret = dump_file(args, files[next_to_start]);
+        fflush(stdout);
+        _exit(child_ret);
+      }
+      next_to_start++;
+      running++;
+    }
+
+    int status;
+    pid_t pid = wait(&status);
+    if (pid == -1) {
+      fprintf(stderr, "wait failed: %s\n", std::strerror(errno));
+      return 1;
+    }
+    for (auto& job : jobs) {
+      if (job.pid == pid) {
+        job.done = true;
+        job.ret = WIFEXITED(status) ? WEXITSTATUS(status) : 1;
+        running--;
+        break;
+      }
+    }
+
+    for (; next_to_print < files.size() && jobs[next_to_print].done;
+         next_to_print++) {
+      auto& job = jobs[next_to_print];
+      printf("==> %s <==\n", files[next_to_print].c_str());
+      rewind(job.out);
+      char buf[0x10000];
+      size_t num_read;
+      while ((num_read = fread(buf, 1, sizeof(buf), job.out)) > 0) {
+        fwrite(buf, 1, num_read, stdout);
+      }
+      fclose(job.out);
+      if (job.ret != 0) {
+        ret = 1;
+      }
+    }
+  }
+  return ret;
+}
+
+int dump(const Arguments& args) {
+  if (args.parallel_jobs != 0) {
+    if (args.oat_files.empty()) {
+      fprintf(stderr, "-o/--oat required\n");
+      return 1;
+    }
+    return dump_files_in_parallel(args);
+  }
+
+  if (args.oat_files.size() != 1) {
+    fprintf(stderr, "-o/--oat required (exactly once)\n");
+    return 1;
+  }
+
+  return dump_file(args, args.oat_files[0]);
+}
+
 int build(const Arguments& args) {
 
   if (args.dex_files.empty()) {
@@ -40,3 +40,21 @@ TEST(OatmealUtil, empty) {
   EXPECT_EQ(0x200000000Lu, roundUpToPowerOfTwo(0x200000000Lu));
   EXPECT_EQ(0x400000000Lu, roundUpToPowerOfTwo(0x200000001Lu));
 }
+
+TEST(OatmealUtil, constBufferAt) {
+  // Unaligned words, as found in ids of dexes embedded in oat files.
+  const char data[] = {0, 1, 0, 0, 0, 2, 0, 0, 0};
+  ConstBuffer buf{data + 1, 8};
+  EXPECT_EQ(1u, buf.at<uint32_t>(0));
+  EXPECT_EQ(2u, buf.at<uint32_t>(1));
+  EXPECT_EQ(0x0200u, buf.slice(3).at<uint16_t>(0));
+}
+
+TEST(OatmealUtil, parallelFor) {
+  std::vector<int> visits(1000);
+  parallel_for(visits.size(), [&](size_t i) { visits[i]++; });
+  for (auto count : visits) {
+    EXPECT_EQ(1, count);
+  }
+  parallel_for(0, [](size_t) { FAIL(); });
+}
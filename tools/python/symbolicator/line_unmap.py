@@ -28,6 +28,8 @@ class PositionMap(object):
             if magic != 0xFACEB000:
                 raise Exception("Magic number mismatch")
             version = struct.unpack("<L", mapping.read(4))[0]
+            if version == 3:
+                return PositionMap.read_v3(mapping)
             if version not in [1, 2]:
                 raise Exception("Version mismatch")
             spool_count = struct.unpack("<L", mapping.read(4))[0]
@@ -54,6 +56,35 @@ class PositionMap(object):
             logging.info("Unpacked %d map entries from line map", pos_count)
             return pmap
 
+    @staticmethod
+    def read_v3(mapping):
+        # See RealPositionMapper::write_map_v2 for the layout.
+        (
+            spool_count,
+            pos_count,
+            offsets_offset,
+            data_offset,
+            data_size,
+            positions_offset,
+        ) = struct.unpack_from("<6L", mapping, 8)
+        offsets = struct.unpack_from(
+            "<%dL" % (spool_count + 1), mapping, offsets_offset
+        )
+        pmap = PositionMap()
+        for i in range(0, spool_count):
+            start = data_offset + offsets[i]
+            end = data_offset + offsets[i + 1]
+            pmap.string_pool.append(mapping[start:end].decode("ascii"))
+        logging.info("Unpacked %d strings from line map", spool_count)
+        for i in range(0, pos_count):
+            pmap.positions.append(
+                MapEntry._make(
+                    struct.unpack_from("<LLLLL", mapping, positions_offset + 20 * i)
+                )
+            )
+        logging.info("Unpacked %d map entries from line map", pos_count)
+        return pmap
+
     def get_stack(self, idx):
         stack = []
         while idx >= 0 and idx < len(self.positions):
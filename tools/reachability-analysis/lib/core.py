@@ -135,18 +135,29 @@ class AbstractGraph(object):
     def list_nodes(self, search_str=None):
         raise NotImplementedError()
 
+    def supports_compact(self):
+        return False
+
     def read_header(self, mapping):
         magic = struct.unpack("<L", mapping.read(4))[0]
         if magic != 0xFACEB000:
             raise Exception("Magic number mismatch")
         version = struct.unpack("<L", mapping.read(4))[0]
+        if version == CompactGraph.VERSION and self.supports_compact():
+            return version
         if version != self.expected_version():
             raise Exception("Version mismatch")
+        return version
+
+    def load_compact(self, compact):
+        raise NotImplementedError()
 
     def load(self, fn):
         with open(fn) as f:
             mapping = mmap.mmap(f.fileno(), 0, prot=mmap.PROT_READ)
-            self.read_header(mapping)
+            if self.read_header(mapping) == CompactGraph.VERSION:
+                self.load_compact(CompactGraph(fn))
+                return
             nodes_count = struct.unpack("<L", mapping.read(4))[0]
             nodes = [None] * nodes_count
             out_edges = [None] * nodes_count
@@ -170,11 +181,140 @@ class AbstractGraph(object):
         return "[" + ",\n".join([self.nodes[k].__repr__() for k in sorted_keys]) + "]"
 
 
+def _align8(offset):
+    return (offset + 7) & ~7
+
+
+class CompactGraph(object):
+    """
+    Reader for the version 2 format written by CompactGraphWriter in
+    BinarySerialization.h. The file is memory-mapped and nothing is decoded up
+    front: labels and edge lists are read from the mapping when asked for, so
+    opening even a very large graph is instantaneous.
+    """
+
+    VERSION = 2
+    HEADER = struct.Struct("<LLLLQQQ")
+
+    def __init__(self, fn):
+        with open(fn, "rb") as f:
+            self.mapping = mmap.mmap(f.fileno(), 0, prot=mmap.PROT_READ)
+        (
+            magic,
+            version,
+            self.node_count,
+            string_count,
+            string_data_size,
+            edge_data_size,
+            reverse_edge_data_size,
+        ) = self.HEADER.unpack_from(self.mapping, 0)
+        if magic != 0xFACEB000:
+            raise Exception("Magic number mismatch")
+        if version != self.VERSION:
+            raise Exception("Version mismatch")
+
+        view = memoryview(self.mapping)
+        offset = self.HEADER.size
+
+        def table(fmt, size, count):
+            nonlocal offset
+            start = offset
+            offset = _align8(offset + size * count)
+            return view[start : start + size * count].cast(fmt)
+
+        self.string_offsets = table("Q", 8, string_count + 1)
+        self.node_strings = table("I", 4, self.node_count)
+        self.node_kinds = table("B", 1, self.node_count)
+        self.edge_offsets = table("Q", 8, self.node_count + 1)
+        self.reverse_edge_offsets = table("Q", 8, self.node_count + 1)
+        self.string_data = offset
+        offset = _align8(offset + string_data_size)
+        self.edge_data = offset
+        offset = _align8(offset + edge_data_size)
+        self.reverse_edge_data = offset
+
+    def __len__(self):
+        return self.node_count
+
+    def kind(self, node):
+        return self.node_kinds[node]
+
+    def label_bytes(self, node):
+        string = self.node_strings[node]
+        start = self.string_data + self.string_offsets[string]
+        end = self.string_data + self.string_offsets[string + 1]
+        return self.mapping[start:end]
+
+    def label(self, node):
+        return self.label_bytes(node).decode("utf-8")
+
+    def find(self, label, kind=None):
+        """
+        Return the IDs of the nodes with the given label (and kind, if given).
+        Nodes are sorted by label, so this is a binary search.
+        """
+        key = label.encode("utf-8")
+        lo, hi = 0, self.node_count
+        while lo < hi:
+            mid = (lo + hi) // 2
+            if self.label_bytes(mid) < key:
+                lo = mid + 1
+            else:
+                hi = mid
+        found = []
+        while lo < self.node_count and self.label_bytes(lo) == key:
+            if kind is None or self.kind(lo) == kind:
+                found.append(lo)
+            lo += 1
+        return found
+
+    def _decode(self, base, offsets, node):
+        start = base + offsets[node]
+        end = base + offsets[node + 1]
+        data = self.mapping[start:end]
+        targets = []
+        value = 0
+        shift = 0
+        prev = 0
+        for byte in data:
+            value |= (byte & 0x7F) << shift
+            if byte & 0x80:
+                shift += 7
+                continue
+            prev += value
+            targets.append(prev)
+            value = 0
+            shift = 0
+        return targets
+
+    def successors(self, node):
+        return self._decode(self.edge_data, self.edge_offsets, node)
+
+    def predecessors(self, node):
+        return self._decode(
+            self.reverse_edge_data, self.reverse_edge_offsets, node
+        )
+
+
 class ReachabilityGraph(AbstractGraph):
     @staticmethod
     def expected_version():
         return 1
 
+    def supports_compact(self):
+        return True
+
+    def load_compact(self, compact):
+        # The writer's successors of an object are its retainers.
+        nodes = [
+            ReachableObject(compact.kind(i), compact.label(i))
+            for i in range(len(compact))
+        ]
+        for i, node in enumerate(nodes):
+            self.add_node(node)
+            node.preds = [nodes[j] for j in compact.successors(i)]
+            node.succs = [nodes[j] for j in compact.predecessors(i)]
+
     def read_node(self, mapping):
         node_type = struct.unpack("<B", mapping.read(1))[0]
         node_name_size = struct.unpack("<L", mapping.read(4))[0]
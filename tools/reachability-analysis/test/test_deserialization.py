@@ -34,6 +34,35 @@ class TestGraphDeserialization(unittest.TestCase):
         assertEdge(cls, method)
         assertEdge(method, field)
 
+    def test_compact_reachability_graph(self):
+        """
+        Check that the memory-mapped reader sees the same edges without
+        loading the whole graph.
+        """
+        graph_file = os.environ["REACHABILITY_GRAPH_FILE"]
+        graph = core.CompactGraph(graph_file)
+
+        def find(name, kind):
+            (node,) = graph.find(name, kind)
+            return node
+
+        seed = find("<SEED>", core.ReachableObjectType.SEED)
+        cls = find("LFoo;", core.ReachableObjectType.CLASS)
+        anno = find("LAnno;", core.ReachableObjectType.ANNO)
+        method = find("LFoo;.method1:()I", core.ReachableObjectType.METHOD)
+        field = find("LFoo;.field1:I", core.ReachableObjectType.FIELD)
+        self.assertEqual(graph.find("LNotThere;"), [])
+
+        def assertEdge(pred, succ):
+            # The serialized successors of an object are its retainers.
+            self.assertIn(pred, graph.successors(succ))
+            self.assertIn(succ, graph.predecessors(pred))
+
+        assertEdge(seed, cls)
+        assertEdge(cls, anno)
+        assertEdge(cls, method)
+        assertEdge(method, field)
+
     def test_method_override_graph(self):
         """
         Check that we are able to recover the same graph serialized in
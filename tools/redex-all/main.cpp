@@ -8,6 +8,7 @@
 #include <cinttypes>
 #include <cstring>
 #include <fstream>
+#include <future>
 #include <iostream>
 #include <memory>
 #include <regex>
@@ -58,9 +59,11 @@
 #include "SanitizersConfig.h"
 #include "Show.h"
 #include "Timer.h"
+#include "TraceTimeline.h"
 #include "ToolsCommon.h"
 #include "Walkers.h"
 #include "Warning.h"
+#include "ZipWriter.h"
 
 namespace {
 
@@ -88,6 +91,9 @@ struct Arguments {
   // command line arguments. For development usage
   Json::Value entry_data;
   boost::optional<int> stop_pass_idx;
+  // Directory of a previous --stop-pass run to continue from.
+  std::string resume_ir_dir;
+  std::string trace_timeline_path;
   RedexOptions redex_options;
 };
 
@@ -318,6 +324,11 @@ Arguments parse_args(int argc, char* argv[]) {
       "    \te.g. -JMyPass.config=[1, 2, 3]\n"
       "Note: Be careful to properly escape JSON parameters, e.g., strings must "
       "be quoted.");
+  od.add_options()(
+      "trace-timeline",
+      po::value<std::string>(),
+      "Record a timeline of all timers and work queue tasks per thread, and "
+      "write it to the given file in the Chrome trace event format.\n");
   od.add_options()("show-passes", "show registered passes");
   od.add_options()("dex-files", po::value<std::vector<std::string>>(),
                    "dex files");
@@ -325,9 +336,15 @@ Arguments parse_args(int argc, char* argv[]) {
   // Development usage only, and Python script will generate the following
   // arguments.
   od.add_options()("stop-pass", po::value<int>(),
-                   "Stop before pass n and output IR to file");
+                   "Stop before pass n and output IR to file. Combined with "
+                   "--resume-ir, only the passes in between are run");
   od.add_options()("output-ir", po::value<std::string>(),
                    "IR output directory, used with --stop-pass");
+  od.add_options()(
+      "resume-ir", po::value<std::string>(),
+      "Continue a pipeline from the IR output directory of a --stop-pass "
+      "run, with the same config: only the passes from the stop pass on are "
+      "run, and the final output is written to --outdir");
 
   po::positional_options_description pod;
   pod.add("dex-files", -1);
@@ -377,7 +394,14 @@ Arguments parse_args(int argc, char* argv[]) {
     exit(EXIT_SUCCESS);
   }
 
-  if (vm.count("dex-files")) {
+  if (vm.count("resume-ir")) {
+    args.resume_ir_dir = vm["resume-ir"].as<std::string>();
+    if (vm.count("dex-files")) {
+      std::cerr << "error: --resume-ir cannot be combined with input dex files"
+                << std::endl;
+      exit(EXIT_FAILURE);
+    }
+  } else if (vm.count("dex-files")) {
     args.dex_files = vm["dex-files"].as<std::vector<std::string>>();
   } else {
     std::cerr << "error: no input dex files" << std::endl << std::endl;
@@ -478,6 +502,11 @@ Arguments parse_args(int argc, char* argv[]) {
   args.redex_options.debug_info_kind =
       parse_debug_info_kind(args.config.get("debug_info_kind", "").asString());
 
+  if (vm.count("trace-timeline")) {
+    args.trace_timeline_path = vm["trace-timeline"].as<std::string>();
+    trace_timeline::enable();
+  }
+
   // Development usage only
   if (vm.count("stop-pass")) {
     args.stop_pass_idx = vm["stop-pass"].as<int>();
@@ -501,6 +530,8 @@ Arguments parse_args(int argc, char* argv[]) {
     if (passes_list.size() > (size_t)idx) {
       passes_list.resize(idx);
     }
+    // Remembered so that --resume-ir knows where to pick up.
+    args.entry_data["stop_pass_idx"] = idx;
     // Append the two passes when `--stop-pass` is enabled.
     passes_list.append("MakePublicPass");
     passes_list.append("RegAllocPass");
@@ -565,6 +596,8 @@ Json::Value get_stats(const dex_stats_t& stats) {
   val["dbg_total_size"] = stats.dbg_total_size;
 
   val["instruction_bytes"] = stats.instruction_bytes;
+  val["num_hot_code_items"] = stats.num_hot_code_items;
+  val["num_hot_code_pages"] = stats.num_hot_code_pages;
 
   val["header_item_count"] = stats.header_item_count;
   val["header_item_bytes"] = stats.header_item_bytes;
@@ -770,15 +803,19 @@ std::string get_dex_magic(std::vector<std::string>& dex_files) {
   return load_dex_magic_from_dex(dex_files[0].c_str());
 }
 
+struct LibraryJars {
+  std::vector<std::string> locations;
+  // Null if a jar couldn't be read.
+  std::shared_ptr<ParsedJars> parsed;
+};
+
 /**
- * Pre processing steps: load dex and configurations
+ * Parses the ProGuard config, and then the class files of the library jars,
+ * both the ones passed on the command line and the ones the config names.
+ * None of this depends on the dexes.
  */
-void redex_frontend(ConfigFiles& conf, /* input */
-                    Arguments& args, /* inout */
-                    keep_rules::ProguardConfiguration& pg_config,
-                    DexStoresVector& stores,
-                    Json::Value& stats) {
-  Timer redex_frontend_timer("Redex_frontend");
+LibraryJars parse_proguard_config_and_jars(
+    Arguments& args, keep_rules::ProguardConfiguration& pg_config) {
   for (const auto& pg_config_path : args.proguard_config_paths) {
     Timer time_pg_parsing("Parsed ProGuard config file");
     keep_rules::proguard_parser::parse_file(pg_config_path, &pg_config);
@@ -801,6 +838,48 @@ void redex_frontend(ConfigFiles& conf, /* input */
     }
   }
 
+  LibraryJars result;
+  if (library_jars.empty()) {
+    return result;
+  }
+  Timer t("Parse library jars");
+  for (const auto& library_jar : library_jars) {
+    TRACE(MAIN, 1, "LIBRARY JAR: %s", library_jar.c_str());
+    if (boost::filesystem::exists(library_jar)) {
+      auto abs_path = boost::filesystem::absolute(library_jar);
+      result.locations.push_back(abs_path.string());
+    } else {
+      // Try again with the basedir
+      result.locations.push_back(pg_config.basedirectory + "/" + library_jar);
+    }
+  }
+  result.parsed = parse_jar_files(result.locations);
+  return result;
+}
+
+/**
+ * Pre processing steps: load dex and configurations
+ *
+ * The steps form a small task graph rather than a sequence, so that startup
+ * takes about as long as the dex loading alone:
+ * - the ProGuard config and then the library jars it names are parsed on a
+ *   background thread;
+ * - the ProGuard map is parsed on another one, started by ConfigFiles;
+ * - the dexes are loaded meanwhile;
+ * - the classes of the jars are only created after the dexes are loaded,
+ *   since the classes of the dexes take precedence over them;
+ * - the deobfuscation then waits for the map.
+ */
+void redex_frontend(ConfigFiles& conf, /* input */
+                    Arguments& args, /* inout */
+                    keep_rules::ProguardConfiguration& pg_config,
+                    DexStoresVector& stores,
+                    Json::Value& stats) {
+  Timer redex_frontend_timer("Redex_frontend");
+  auto library_jars_future =
+      std::async(std::launch::async, parse_proguard_config_and_jars,
+                 std::ref(args), std::ref(pg_config));
+
   DexStore root_store("classes");
   // Only set dex magic to root DexStore since all dex magic
   // should be consistent within one APK.
@@ -821,35 +900,30 @@ void redex_frontend(ConfigFiles& conf, /* input */
 
   Scope external_classes;
   args.entry_data["jars"] = Json::arrayValue;
-  if (!library_jars.empty()) {
+  auto library_jars = library_jars_future.get();
+  if (!library_jars.locations.empty()) {
     Timer t("Load library jars");
-
-    for (const auto& library_jar : library_jars) {
-      TRACE(MAIN, 1, "LIBRARY JAR: %s", library_jar.c_str());
-      if (!load_jar_file(library_jar.c_str(), &external_classes)) {
-        // Try again with the basedir
-        std::string basedir_path = pg_config.basedirectory + "/" + library_jar;
-        if (!load_jar_file(basedir_path.c_str())) {
-          std::cerr << "error: library jar could not be loaded: " << library_jar
-                    << std::endl;
-          exit(EXIT_FAILURE);
-        }
-        args.entry_data["jars"].append(basedir_path);
-      } else {
-        auto abs_path = boost::filesystem::absolute(library_jar);
-        args.entry_data["jars"].append(abs_path.string());
-      }
+    if (library_jars.parsed == nullptr ||
+        !create_jar_classes(library_jars.parsed.get(), &external_classes)) {
+      std::cerr << "error: library jars could not be loaded" << std::endl;
+      exit(EXIT_FAILURE);
+    }
+    for (const auto& location : library_jars.locations) {
+      args.entry_data["jars"].append(location);
     }
   }
 
+  DexStoreClassesIterator it(stores);
+  Scope scope = build_class_scope(it);
   {
     Timer t("Deobfuscating dex elements");
-    for (auto& store : stores) {
-      apply_deobfuscated_names(store.get_dexen(), conf.get_proguard_map());
-    }
+    apply_deobfuscated_names(scope, conf.get_proguard_map());
+  }
+  if (json_config.get("descriptor_index", false)) {
+    // For the string lookups of the configs and profiles that follow.
+    Timer t("Indexing member descriptors");
+    g_redex->build_descriptor_index();
   }
-  DexStoreClassesIterator it(stores);
-  Scope scope = build_class_scope(it);
   {
     Timer t("Processing proguard rules");
 
@@ -873,11 +947,57 @@ void redex_frontend(ConfigFiles& conf, /* input */
   }
 }
 
+/**
+ * Pre processing steps when resuming: load the dexes and IR meta data that a
+ * --stop-pass run dumped, and drop the passes that already ran.
+ */
+void redex_resume_frontend(Arguments& args, DexStoresVector& stores) {
+  Timer t("Redex_resume_frontend");
+  redex::load_all_intermediate(args.resume_ir_dir, stores, &args.entry_data);
+  const auto& dex_list = args.entry_data["dex_list"];
+  if (stores.empty() || dex_list.empty() || dex_list[0]["list"].empty() ||
+      !args.entry_data.isMember("stop_pass_idx")) {
+    std::cerr << "error: not an IR output directory of a --stop-pass run: "
+              << args.resume_ir_dir << std::endl;
+    exit(EXIT_FAILURE);
+  }
+  auto first_dex_path = boost::filesystem::path(args.resume_ir_dir) /
+                        dex_list[0]["list"][0].asString();
+  stores[0].set_dex_magic(load_dex_magic_from_dex(first_dex_path.c_str()));
+  args.redex_options.deserialize(args.entry_data);
+  if (args.entry_data.isMember("apk_dir") && !args.config.isMember("apk_dir")) {
+    args.config["apk_dir"] = args.entry_data["apk_dir"];
+  }
+
+  auto idx = args.entry_data["stop_pass_idx"].asUInt();
+  auto& passes_list = args.config["redex"]["passes"];
+  if (passes_list.size() < idx) {
+    std::cerr << "error: config has fewer passes than the stop pass of "
+              << args.resume_ir_dir << std::endl;
+    exit(EXIT_FAILURE);
+  }
+  if (args.stop_pass_idx != boost::none) {
+    // Only run the passes [idx, stop_pass_idx), and dump the IR again, so
+    // that the next range can start from there.
+    if ((size_t)*args.stop_pass_idx < idx) {
+      std::cerr << "error: --stop-pass is before the stop pass of "
+                << args.resume_ir_dir << std::endl;
+      exit(EXIT_FAILURE);
+    }
+    args.entry_data["stop_pass_idx"] = *args.stop_pass_idx;
+  }
+  Json::Value remaining_passes = Json::arrayValue;
+  for (auto i = idx; i < passes_list.size(); i++) {
+    remaining_passes.append(passes_list[i]);
+  }
+  passes_list = remaining_passes;
+}
+
 /**
  * Post processing steps: write dex and collect stats
  */
 void redex_backend(const std::string& output_dir,
-                   const ConfigFiles& conf,
+                   ConfigFiles& conf,
                    PassManager& manager,
                    DexStoresVector& stores,
                    Json::Value& stats) {
@@ -931,9 +1051,59 @@ void redex_backend(const std::string& output_dir,
     Timer t("Compute initial IODI metadata");
     iodi_metadata.mark_methods(stores);
   }
+  // The dex stats count the pages of the methods in the cold start profile.
+  // Load it up front, as dexes may be written concurrently.
+  conf.get_method_profiles();
+  // Dexes can only be emitted concurrently if no line numbers or addresses
+  // have to be assigned across all of them in emission order.
+  size_t dex_writing_threads;
+  json_config.get("dex_writing_threads", 4, dex_writing_threads);
+  bool parallel_dex_writing = dik == DebugInfoKind::NoCustomSymbolication &&
+                              dex_writing_threads > 1;
+  // With dex_output_archive, the dexes are compressed into that archive of the
+  // output directory as they are written, instead of being left for
+  // repackaging.
+  std::unique_ptr<ZipWriter> dex_archive;
+  auto dex_archive_name = json_config.get("dex_output_archive", std::string());
+  if (!dex_archive_name.empty()) {
+    if (parallel_dex_writing) {
+      dex_archive =
+          std::make_unique<ZipWriter>(output_dir + "/" + dex_archive_name);
+    } else {
+      fprintf(stderr,
+              "warning: dex_output_archive needs parallel dex writing, "
+              "writing dex files instead\n");
+    }
+  }
   for (size_t store_number = 0; store_number < stores.size(); ++store_number) {
     auto& store = stores[store_number];
     Timer t("Writing optimized dexes");
+    if (parallel_dex_writing) {
+      std::vector<std::string> filenames;
+      for (size_t i = 0; i < store.get_dexen().size(); i++) {
+        auto filename = redex::get_dex_output_name(output_dir, store, i);
+        // The entries of the archive are relative to the output directory.
+        filenames.push_back(dex_archive != nullptr
+                                ? filename.substr(output_dir.size() + 1)
+                                : filename);
+      }
+      auto dexes_stats = write_classes_to_dexes(redex_options,
+                                                filenames,
+                                                &store.get_dexen(),
+                                                locator_index,
+                                                store_number,
+                                                conf,
+                                                pos_mapper.get(),
+                                                stores[0].get_dex_magic(),
+                                                post_lowering.get(),
+                                                dex_writing_threads,
+                                                dex_archive.get());
+      for (const auto& this_dex_stats : dexes_stats) {
+        output_totals += this_dex_stats;
+        output_dexes_stats.push_back(this_dex_stats);
+      }
+      continue;
+    }
     for (size_t i = 0; i < store.get_dexen().size(); i++) {
       auto this_dex_stats =
           write_classes_to_dex(redex_options,
@@ -955,6 +1125,11 @@ void redex_backend(const std::string& output_dir,
     }
   }
 
+  if (dex_archive != nullptr) {
+    Timer t("Writing dex archive");
+    dex_archive->finish();
+  }
+
   if (post_lowering) {
     post_lowering->run(stores);
     post_lowering->finalize(manager.apk_manager());
@@ -965,12 +1140,8 @@ void redex_backend(const std::string& output_dir,
     const Json::Value& opt_decisions_args = json_config["opt_decisions"];
     if (opt_decisions_args.get("enable_logs", false).asBool()) {
       auto opt_decisions_output_path = conf.metafile(OPT_DECISIONS);
-      auto opt_data =
-          opt_metadata::OptDataMapper::get_instance().serialize_sql();
-      {
-        std::ofstream opt_data_out(opt_decisions_output_path);
-        opt_data_out << opt_data;
-      }
+      std::ofstream opt_data_out(opt_decisions_output_path);
+      opt_metadata::OptDataMapper::get_instance().write_sql_json(opt_data_out);
     }
   }
 
@@ -1070,6 +1241,7 @@ int main(int argc, char* argv[]) {
   block_multi_asserts(/*block=*/true);
 
   std::string stats_output_path;
+  std::string trace_timeline_path;
   Json::Value stats;
   {
     Timer redex_all_main_timer("redex-all main()");
@@ -1093,7 +1265,14 @@ int main(int argc, char* argv[]) {
 
     auto pg_config = std::make_unique<keep_rules::ProguardConfiguration>();
     DexStoresVector stores;
+    if (!args.resume_ir_dir.empty()) {
+      redex_resume_frontend(args, stores);
+    }
     ConfigFiles conf(args.config, args.out_dir);
+    if (conf.get_json_config().get("prefetch_inputs", false)) {
+      // Read the profiles and class lists while the dexes load.
+      conf.prefetch();
+    }
 
     std::string apk_dir;
     conf.get_json_config().get("apk_dir", "", apk_dir);
@@ -1103,7 +1282,9 @@ int main(int argc, char* argv[]) {
       args.redex_options.min_sdk = *maybe_sdk;
     }
 
-    redex_frontend(conf, args, *pg_config, stores, stats);
+    if (args.resume_ir_dir.empty()) {
+      redex_frontend(conf, args, *pg_config, stores, stats);
+    }
 
     auto const& passes = PassRegistry::get().get_passes();
     PassManager manager(passes, std::move(pg_config), args.config,
@@ -1132,6 +1313,7 @@ int main(int argc, char* argv[]) {
 
     stats_output_path = conf.metafile(
         args.config.get("stats_output", "redex-stats.txt").asString());
+    trace_timeline_path = args.trace_timeline_path;
     {
       Timer t("Freeing global memory");
       delete g_redex;
@@ -1147,6 +1329,11 @@ int main(int argc, char* argv[]) {
     std::ofstream out(stats_output_path);
     out << stats;
   }
+  if (!trace_timeline_path.empty() &&
+      !trace_timeline::write(trace_timeline_path)) {
+    std::cerr << "Failed to write trace timeline to " << trace_timeline_path
+              << std::endl;
+  }
 
   TRACE(MAIN, 1, "Done.");
   if (traceEnabled(MAIN, 1) || traceEnabled(STATS, 1)) {
@@ -7,7 +7,14 @@
 
 #include <boost/filesystem.hpp>
 #include <boost/program_options.hpp>
+#include <cerrno>
+#include <cstdio>
+#include <cstring>
 #include <iostream>
+#include <sys/socket.h>
+#include <sys/un.h>
+#include <sys/wait.h>
+#include <unistd.h>
 
 #include "DexClass.h"
 #include "DexLoader.h"
@@ -25,6 +32,7 @@ struct Arguments {
   std::string config_file;
   std::vector<std::string> s_args;
   std::vector<std::string> j_args;
+  std::string socket_path;
 };
 
 Arguments parse_args(int argc, char* argv[]) {
@@ -67,6 +75,14 @@ Arguments parse_args(int argc, char* argv[]) {
       "Note: Be careful to properly escape JSON parameters, e.g., strings must "
       "be quoted.");
 
+  desc.add_options()(
+      "serve", po::value<std::string>(),
+      "Load the input IR once and run the passes of the requests sent to this "
+      "local socket, each on a forked copy of the loaded program. A request is "
+      "a JSON array of redex-opt arguments on one line, e.g. "
+      "'[\"-p\", \"MyPass\", \"-o\", \"out\"]', and is answered with ok or "
+      "error. The request quit stops the server.");
+
   po::variables_map vm;
   po::store(po::parse_command_line(argc, argv, desc), vm);
   po::notify(vm);
@@ -82,18 +98,25 @@ Arguments parse_args(int argc, char* argv[]) {
     args.input_ir_dir = vm["input-ir"].as<std::string>();
   }
 
+  if (vm.count("serve")) {
+    args.socket_path = vm["serve"].as<std::string>();
+  }
+
   if (vm.count("output-ir")) {
     args.output_ir_dir = vm["output-ir"].as<std::string>();
   }
-  if (args.output_ir_dir.empty()) {
-    std::cerr << "output-dir is empty\n";
-    exit(EXIT_FAILURE);
-  }
-  std::string meta_dir = args.output_ir_dir + "/meta";
-  boost::filesystem::create_directories(meta_dir);
-  if (!boost::filesystem::is_directory(meta_dir)) {
-    std::cerr << "Could not create " << meta_dir << std::endl;
-    exit(EXIT_FAILURE);
+  // When serving, the requests give the output directories.
+  if (args.socket_path.empty()) {
+    if (args.output_ir_dir.empty()) {
+      std::cerr << "output-dir is empty\n";
+      exit(EXIT_FAILURE);
+    }
+    std::string meta_dir = args.output_ir_dir + "/meta";
+    boost::filesystem::create_directories(meta_dir);
+    if (!boost::filesystem::is_directory(meta_dir)) {
+      std::cerr << "Could not create " << meta_dir << std::endl;
+      exit(EXIT_FAILURE);
+    }
   }
 
   if (vm.count("pass-name")) {
@@ -196,6 +219,188 @@ Json::Value process_entry_data(const Json::Value& entry_data,
 
   return config_data;
 }
+
+/**
+ * Run the passes of the arguments on the loaded stores, and write the result
+ * to the output IR directory.
+ */
+void run_passes(Arguments& args,
+                DexStoresVector& stores,
+                Json::Value entry_data) {
+  if (!args.config_file.empty()) {
+    entry_data["config"] = args.config_file;
+  }
+
+  args.redex_options.deserialize(entry_data);
+
+  Json::Value config_data = process_entry_data(entry_data, args);
+  ConfigFiles conf(config_data, args.output_ir_dir);
+
+  const auto& passes = PassRegistry::get().get_passes();
+  PassManager manager(passes, config_data, args.redex_options);
+  manager.set_testing_mode();
+  manager.run_passes(stores, conf);
+
+  redex::write_all_intermediate(conf, args.output_ir_dir, args.redex_options,
+                                stores, entry_data);
+}
+
+std::string read_line(int fd) {
+  std::string line;
+  char c;
+  while (true) {
+    auto n = read(fd, &c, 1);
+    if (n < 0 && errno == EINTR) {
+      continue;
+    }
+    if (n <= 0 || c == '\n') {
+      return line;
+    }
+    line.push_back(c);
+  }
+}
+
+void write_line(int fd, const std::string& line) {
+  std::string data = line + "\n";
+  size_t written = 0;
+  while (written < data.size()) {
+    auto n = write(fd, data.data() + written, data.size() - written);
+    if (n < 0 && errno == EINTR) {
+      continue;
+    }
+    if (n <= 0) {
+      return;
+    }
+    written += n;
+  }
+}
+
+/**
+ * Run one request in a child process. The child gets a copy-on-write view of
+ * the loaded stores, so the passes it runs leave them unchanged for the next
+ * request.
+ */
+bool run_request(const std::string& request,
+                 const Arguments& server_args,
+                 DexStoresVector& stores,
+                 const Json::Value& entry_data) {
+  Json::Value request_args;
+  try {
+    request_args = parse_json_value(request);
+  } catch (const std::exception& e) {
+    std::cerr << "Cannot parse request: " << e.what() << std::endl;
+    return false;
+  }
+  if (!request_args.isArray()) {
+    std::cerr << "A request must be a JSON array of arguments\n";
+    return false;
+  }
+
+  // Nothing may be buffered twice once the process is forked.
+  std::cout.flush();
+  fflush(nullptr);
+  pid_t pid = fork();
+  if (pid < 0) {
+    perror("fork");
+    return false;
+  }
+  if (pid == 0) {
+    std::vector<std::string> words{"redex-opt"};
+    for (const auto& arg : request_args) {
+      words.push_back(arg.asString());
+    }
+    std::vector<char*> argv;
+    for (auto& word : words) {
+      argv.push_back(&word[0]);
+    }
+    Arguments args = parse_args(argv.size(), argv.data());
+    if (!args.socket_path.empty()) {
+      std::cerr << "A request cannot start another server\n";
+      _exit(EXIT_FAILURE);
+    }
+    // The config of the server applies, unless the request overrides it.
+    args.input_ir_dir = server_args.input_ir_dir;
+    if (args.config_file.empty()) {
+      args.config_file = server_args.config_file;
+    }
+    args.s_args.insert(args.s_args.begin(), server_args.s_args.begin(),
+                       server_args.s_args.end());
+    args.j_args.insert(args.j_args.begin(), server_args.j_args.begin(),
+                       server_args.j_args.end());
+    {
+      Timer t("Request");
+      run_passes(args, stores, entry_data);
+    }
+    std::cout.flush();
+    fflush(nullptr);
+    // The server owns the loaded program, so don't tear it down here.
+    _exit(EXIT_SUCCESS);
+  }
+
+  int status;
+  while (waitpid(pid, &status, 0) < 0) {
+    if (errno != EINTR) {
+      perror("waitpid");
+      return false;
+    }
+  }
+  return WIFEXITED(status) && WEXITSTATUS(status) == EXIT_SUCCESS;
+}
+
+/**
+ * Serve requests on a local socket until the request quit, one at a time.
+ */
+int serve(const Arguments& args,
+          DexStoresVector& stores,
+          const Json::Value& entry_data) {
+  const auto& socket_path = args.socket_path;
+  sockaddr_un addr{};
+  if (socket_path.size() >= sizeof(addr.sun_path)) {
+    std::cerr << "Socket path is too long: " << socket_path << std::endl;
+    return EXIT_FAILURE;
+  }
+  addr.sun_family = AF_UNIX;
+  strncpy(addr.sun_path, socket_path.c_str(), sizeof(addr.sun_path) - 1);
+
+  int server = socket(AF_UNIX, SOCK_STREAM, 0);
+  if (server < 0) {
+    perror("socket");
+    return EXIT_FAILURE;
+  }
+  unlink(socket_path.c_str());
+  if (bind(server, reinterpret_cast<sockaddr*>(&addr), sizeof(addr)) < 0 ||
+      listen(server, 1) < 0) {
+    perror(socket_path.c_str());
+    close(server);
+    return EXIT_FAILURE;
+  }
+  std::cerr << "Serving " << args.input_ir_dir << " on " << socket_path
+            << std::endl;
+
+  while (true) {
+    int client = accept(server, nullptr, nullptr);
+    if (client < 0) {
+      if (errno == EINTR) {
+        continue;
+      }
+      perror("accept");
+      break;
+    }
+    auto request = read_line(client);
+    if (request == "quit") {
+      write_line(client, "ok");
+      close(client);
+      break;
+    }
+    bool ok = run_request(request, args, stores, entry_data);
+    write_line(client, ok ? "ok" : "error");
+    close(client);
+  }
+
+  close(server);
+  unlink(socket_path.c_str());
+  return EXIT_SUCCESS;
+}
 } // namespace
 
 int main(int argc, char* argv[]) {
@@ -217,23 +422,13 @@ int main(int argc, char* argv[]) {
     stores[0].set_dex_magic(load_dex_magic_from_dex(first_dex_path.c_str()));
   }
 
-  if (!args.config_file.empty()) {
-    entry_data["config"] = args.config_file;
+  int status = EXIT_SUCCESS;
+  if (!args.socket_path.empty()) {
+    status = serve(args, stores, entry_data);
+  } else {
+    run_passes(args, stores, entry_data);
   }
 
-  args.redex_options.deserialize(entry_data);
-
-  Json::Value config_data = process_entry_data(entry_data, args);
-  ConfigFiles conf(config_data, args.output_ir_dir);
-
-  const auto& passes = PassRegistry::get().get_passes();
-  PassManager manager(passes, config_data, args.redex_options);
-  manager.set_testing_mode();
-  manager.run_passes(stores, conf);
-
-  redex::write_all_intermediate(conf, args.output_ir_dir, args.redex_options,
-                                stores, entry_data);
-
   delete g_redex;
-  return 0;
+  return status;
 }
@@ -0,0 +1,219 @@
+/*
+ * Copyright (c) Facebook, Inc. and its affiliates.
+ *
+ * This source code is licensed under the MIT license found in the
+ * LICENSE file in the root directory of this source tree.
+ */
+
+#include "DexMethodSizes.h"
+
+#include <algorithm>
+#include <boost/filesystem.hpp>
+#include <iterator>
+#include <sys/mman.h>
+
+// Sparta uses assert, which Debug.h undefines.
+#include "WorkQueue.h"
+
+#include "Debug.h"
+#include "DexCommon.h"
+#include "DexEncoding.h"
+#include "DexOpcode.h"
+
+namespace {
+
+uint32_t code_units(OpcodeFormat format) {
+  switch (format) {
+  case FMT_f10x:
+  case FMT_f12x:
+  case FMT_f12x_2:
+  case FMT_f11n:
+  case FMT_f11x_d:
+  case FMT_f11x_s:
+  case FMT_f10t:
+    return 1;
+  case FMT_f20t:
+  case FMT_f20bc:
+  case FMT_f22x:
+  case FMT_f21t:
+  case FMT_f21s:
+  case FMT_f21h:
+  case FMT_f21c_d:
+  case FMT_f21c_s:
+  case FMT_f23x_d:
+  case FMT_f23x_s:
+  case FMT_f22b:
+  case FMT_f22t:
+  case FMT_f22s:
+  case FMT_f22c_d:
+  case FMT_f22c_s:
+  case FMT_f22cs:
+    return 2;
+  case FMT_f30t:
+  case FMT_f32x:
+  case FMT_f31i:
+  case FMT_f31t:
+  case FMT_f31c:
+  case FMT_f35c:
+  case FMT_f35ms:
+  case FMT_f35mi:
+  case FMT_f3rc:
+  case FMT_f3rms:
+  case FMT_f3rmi:
+    return 3;
+  case FMT_f41c_d:
+  case FMT_f41c_s:
+  case FMT_f45cc:
+  case FMT_f4rcc:
+    return 4;
+  case FMT_f51l:
+  case FMT_f52c_d:
+  case FMT_f52c_s:
+  case FMT_f5rc:
+  case FMT_f57c:
+    return 5;
+  case FMT_f00x:
+  case FMT_fopcode:
+  case FMT_iopcode:
+    break;
+  }
+  always_assert_log(false, "Unexpected format %d", format);
+  not_reached();
+}
+
+// Walks the instructions of a code item, skipping over the payloads the same
+// way DexInstruction::make_instruction does.
+void read_code_item(const dex_code_item* code, DexMethodSizeInfo* info) {
+  info->has_code = true;
+  info->registers_size = code->registers_size;
+  auto insns = reinterpret_cast<const uint16_t*>(code + 1);
+  auto end = insns + code->insns_size;
+  while (insns < end) {
+    uint32_t size;
+    switch (*insns) {
+    case FOPCODE_PACKED_SWITCH:
+      size = insns[1] * 2 + 4;
+      break;
+    case FOPCODE_SPARSE_SWITCH:
+      size = insns[1] * 4 + 2;
+      break;
+    case FOPCODE_FILLED_ARRAY: {
+      uint32_t ewidth = insns[1];
+      uint32_t count = insns[2] | (uint32_t(insns[3]) << 16);
+      size = (ewidth * count + 1) / 2 + 4;
+      break;
+    }
+    default: {
+      auto op = static_cast<DexOpcode>(*insns & 0xff);
+      size = code_units(dex_opcode::format(op));
+      info->code_size += size;
+      if (dex_opcode::is_move(op)) {
+        ++info->num_moves;
+        info->moves_size += size;
+      }
+    }
+    }
+    insns += size;
+  }
+}
+
+std::string method_name(ddump_data* rd, uint32_t method_idx) {
+  const auto& method_id = rd->dex_method_ids[method_idx];
+  const auto& proto_id = rd->dex_proto_ids[method_id.protoidx];
+  std::string name = dex_string_by_type_idx(rd, method_id.classidx);
+  name += '.';
+  name += dex_string_by_idx(rd, method_id.nameidx);
+  name += ":(";
+  if (proto_id.param_off != 0) {
+    auto params = reinterpret_cast<const uint32_t*>(rd->dexmmap +
+                                                    proto_id.param_off);
+    auto types = reinterpret_cast<const uint16_t*>(params + 1);
+    for (uint32_t i = 0; i < *params; ++i) {
+      name += dex_string_by_type_idx(rd, types[i]);
+    }
+  }
+  name += ')';
+  name += dex_string_by_type_idx(rd, proto_id.rtypeidx);
+  return name;
+}
+
+} // namespace
+
+std::vector<DexMethodSizeInfo> read_dex_method_sizes(const std::string& path) {
+  ddump_data rd;
+  open_dex_file(path.c_str(), &rd);
+  std::vector<DexMethodSizeInfo> result;
+  for (uint32_t i = 0; i < rd.dexh->class_defs_size; ++i) {
+    const auto& class_def = rd.dex_class_defs[i];
+    if (class_def.class_data_offset == 0) {
+      continue;
+    }
+    auto data = reinterpret_cast<const uint8_t*>(rd.dexmmap) +
+                class_def.class_data_offset;
+    uint32_t sfields_size = read_uleb128(&data);
+    uint32_t ifields_size = read_uleb128(&data);
+    uint32_t dmethods_size = read_uleb128(&data);
+    uint32_t vmethods_size = read_uleb128(&data);
+    for (uint32_t j = 0; j < sfields_size + ifields_size; ++j) {
+      read_uleb128(&data); // field_idx_diff
+      read_uleb128(&data); // access_flags
+    }
+    uint32_t method_idx = 0;
+    for (uint32_t j = 0; j < dmethods_size + vmethods_size; ++j) {
+      // The index is relative to the previous method of the same list.
+      if (j == dmethods_size) {
+        method_idx = 0;
+      }
+      method_idx += read_uleb128(&data);
+      read_uleb128(&data); // access_flags
+      uint32_t code_off = read_uleb128(&data);
+      DexMethodSizeInfo info{method_name(&rd, method_idx),
+                             j >= dmethods_size,
+                             false,
+                             0,
+                             0,
+                             0,
+                             0};
+      if (code_off != 0) {
+        read_code_item(
+            reinterpret_cast<const dex_code_item*>(rd.dexmmap + code_off),
+            &info);
+      }
+      result.push_back(std::move(info));
+    }
+  }
+  munmap(rd.dexmmap, rd.dex_size);
+  return result;
+}
+
+std::vector<DexMethodSizeInfo> read_dexen_dir_method_sizes(
+    const std::string& dir) {
+  namespace fs = boost::filesystem;
+  always_assert_log(fs::is_directory(dir), "%s is not a directory",
+                    dir.c_str());
+  std::vector<std::string> dexen;
+  for (fs::directory_iterator it(dir), end; it != end; ++it) {
+    auto file = it->path();
+    if (fs::is_regular_file(file) && file.extension() == ".dex") {
+      dexen.push_back(file.string());
+    }
+  }
+  std::sort(dexen.begin(), dexen.end());
+
+  std::vector<std::vector<DexMethodSizeInfo>> per_dex(dexen.size());
+  auto wq = workqueue_foreach<size_t>(
+      [&](size_t i) { per_dex[i] = read_dex_method_sizes(dexen[i]); },
+      std::max<size_t>(
+          std::min<size_t>(dexen.size(), redex_parallel::default_num_threads()),
+          1));
+  for (size_t i = 0; i < dexen.size(); ++i) {
+    wq.add_item(i);
+  }
+  wq.run_all();
+
+  std::vector<DexMethodSizeInfo> result;
+  for (auto& infos : per_dex) {
+    std::move(infos.begin(), infos.end(), std::back_inserter(result));
+  }
+  return result;
+}
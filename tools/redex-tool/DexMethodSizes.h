@@ -0,0 +1,39 @@
+/*
+ * Copyright (c) Facebook, Inc. and its affiliates.
+ *
+ * This source code is licensed under the MIT license found in the
+ * LICENSE file in the root directory of this source tree.
+ */
+
+#pragma once
+
+#include <cstdint>
+#include <string>
+#include <vector>
+
+/*
+ * The size information of the methods of a dex, read straight from the code
+ * items of the mapped file. This is much cheaper than loading the classes,
+ * which decodes every instruction into a DexInstruction.
+ */
+struct DexMethodSizeInfo {
+  // The method as show() prints it, e.g. "LFoo;.bar:(I)V".
+  std::string name;
+  bool is_virtual;
+  bool has_code;
+  // In code units, without the switch and array payloads, like
+  // DexCode::size().
+  uint32_t code_size;
+  uint16_t registers_size;
+  uint32_t num_moves;
+  // In code units.
+  uint32_t moves_size;
+};
+
+// Reads the methods of all the classes of a dex, in class def order.
+std::vector<DexMethodSizeInfo> read_dex_method_sizes(const std::string& path);
+
+// Reads the methods of all the dexes of a directory, each dex on its own
+// thread.
+std::vector<DexMethodSizeInfo> read_dexen_dir_method_sizes(
+    const std::string& dir);
@@ -19,10 +19,22 @@ $ sqlite3 dex.db "SELECT COUNT(*) FROM dex;"   # verify sane-looking value
 $ ./native/redex/tools/redex-tool/DexSqlQuery.py dex.db
 <..enter queries..>
 
+For big apps, bulk loading csv files is much faster than running the
+insertion script:
+
+$ buck run  //native/redex:redex-tool -- dex-sql-dump  \
+     --apkdir <APKDIR> --dexendir <DEXEN_DIR> \
+     --jars <ANDROID_JAR> --proguard-map <RENAME_MAP> \
+     --format csv --output dex-csv
+$ cd dex-csv && sqlite3 ../dex.db < schema.sql && sqlite3 ../dex.db < load.sql
+
 */
 
-#include <boost/algorithm/string/replace.hpp>
-#include <queue>
+#include <array>
+#include <boost/filesystem.hpp>
+#include <cstring>
+#include <functional>
+#include <string>
 #include <unordered_map>
 #include <vector>
 
@@ -34,6 +46,7 @@ $ ./native/redex/tools/redex-tool/DexSqlQuery.py dex.db
 #include "Show.h"
 #include "Tool.h"
 #include "Walkers.h"
+#include "WorkQueue.h"
 
 namespace {
 
@@ -42,94 +55,203 @@ static std::unordered_map<DexMethod*, int> method_ids;
 static std::unordered_map<DexField*, int> field_ids;
 static std::unordered_map<DexString*, int> string_ids;
 
-void dump_field_refs(FILE* fdout,
-                     const char* prefix,
-                     DexField* field,
-                     int field_id) {
-  static int next_string_ref = 0;
+// The maps are only read once the ids are assigned, possibly concurrently,
+// so missing items are looked up without inserting them.
+template <typename Item>
+int id_of(const std::unordered_map<Item*, int>& ids, Item* item) {
+  auto it = ids.find(item);
+  return it == ids.end() ? 0 : it->second;
+}
+
+enum class Format {
+  // A sqlite script of multi-row INSERTs.
+  SQL,
+  // One headerless CSV file per table, with a script that imports them.
+  CSV,
+};
+
+enum Table {
+  STRINGS,
+  CLASSES,
+  FIELDS,
+  METHODS,
+  FIELD_STRING_REFS,
+  METHOD_STRING_REFS,
+  METHOD_CLASS_REFS,
+  METHOD_FIELD_REFS,
+  METHOD_METHOD_REFS,
+  IS_A,
+  NUM_TABLES,
+};
+
+constexpr const char* kTableNames[NUM_TABLES] = {
+    "strings",
+    "classes",
+    "fields",
+    "methods",
+    "field_string_refs",
+    "method_string_refs",
+    "method_class_refs",
+    "method_field_refs",
+    "method_method_refs",
+    "is_a",
+};
+
+// sqlite limits the number of terms of a compound SELECT, which a multi-row
+// VALUES is, to 500 by default.
+constexpr size_t kRowsPerInsert = 500;
+
+/*
+ * The encoded rows of a table. With SQL, consecutive rows are grouped into
+ * multi-row INSERTs. The buffers of different parts of a dump are encoded
+ * independently and then concatenated.
+ */
+class TableBuffer {
+ public:
+  TableBuffer(Format format, std::string table)
+      : m_format(format), m_table(std::move(table)) {}
+
+  void begin_row() {
+    if (m_format == Format::SQL) {
+      m_out += m_batch_rows == 0 ? "INSERT INTO " + m_table + " VALUES\n("
+                                 : ",\n(";
+    }
+    m_first_value = true;
+  }
+
+  void num(int64_t value) {
+    separate();
+    m_out += std::to_string(value);
+  }
+
+  void text(const char* value) {
+    // Like printf, which the dump used to be written with.
+    if (value == nullptr) {
+      value = "(null)";
+    }
+    separate();
+    if (m_format == Format::SQL) {
+      quote(value, '\'');
+    } else if (strpbrk(value, "\",\r\n") != nullptr) {
+      quote(value, '"');
+    } else {
+      m_out += value;
+    }
+  }
+
+  void end_row() {
+    if (m_format == Format::SQL) {
+      m_out += ')';
+      if (++m_batch_rows == kRowsPerInsert) {
+        m_out += ";\n";
+        m_batch_rows = 0;
+      }
+    } else {
+      m_out += '\n';
+    }
+  }
+
+  std::string take() {
+    if (m_batch_rows != 0) {
+      m_out += ";\n";
+      m_batch_rows = 0;
+    }
+    return std::move(m_out);
+  }
+
+ private:
+  void separate() {
+    if (!m_first_value) {
+      m_out += ',';
+    }
+    m_first_value = false;
+  }
+
+  // Doubles the quotes, as both SQL and CSV escape them.
+  void quote(const char* value, char q) {
+    m_out += q;
+    for (const char* c = value; *c != '\0'; ++c) {
+      if (*c == q) {
+        m_out += q;
+      }
+      m_out += *c;
+    }
+    m_out += q;
+  }
+
+  Format m_format;
+  std::string m_table;
+  std::string m_out;
+  size_t m_batch_rows{0};
+  bool m_first_value{true};
+};
+
+// A reference from a method or a field to another item: the ids of the
+// referrer and of the referenced item, and the opcode that refers to it.
+using Ref = std::array<int, 3>;
+
+// What each dex contributes to the dump. The items are encoded as soon as
+// their ids are known; the refs once the number of refs of the previous
+// dexes is.
+struct DexDump {
+  const DexClasses* dex;
+  std::string dex_id;
+  std::vector<DexString*> strings;
+  int first_string_id;
+  std::array<std::string, NUM_TABLES> encoded;
+  std::array<std::vector<Ref>, NUM_TABLES> refs;
+};
+
+void gather_field_refs(DexDump& dump, DexField* field, int field_id) {
   auto* static_value = field->get_static_value();
   if (!static_value || (static_value->evtype() != DEVT_STRING)) return;
   auto* static_string_value = static_cast<DexEncodedValueString*>(static_value);
-  auto string_id = string_ids[static_string_value->string()];
-  fprintf(fdout,
-          "INSERT INTO %sfield_string_refs VALUES (%d, %d, %d);\n",
-          prefix,
-          next_string_ref++,
-          field_id,
-          string_id);
+  auto string_id = id_of(string_ids, static_string_value->string());
+  dump.refs[FIELD_STRING_REFS].push_back({field_id, string_id, 0});
 }
 
-void dump_method_refs(FILE* fdout,
-                      const char* prefix,
-                      DexMethod* method,
-                      int method_id) {
+void gather_method_refs(DexDump& dump, DexMethod* method, int method_id) {
   auto code = method->get_code();
   if (!code) return;
 
-  static int next_string_ref = 0;
-  static int next_class_ref = 0;
-  static int next_field_ref = 0;
-  static int next_method_ref = 0;
-
   for (auto& mie : InstructionIterable(code)) {
     auto insn = mie.insn;
     if (insn->has_string()) {
       if (string_ids.count(insn->get_string())) {
-        auto string_id = string_ids[insn->get_string()];
-        fprintf(fdout,
-                "INSERT INTO %smethod_string_refs VALUES (%d, %d, %d, %d);\n",
-                prefix,
-                next_string_ref++,
-                method_id,
-                string_id,
-                insn->opcode());
+        auto string_id = string_ids.at(insn->get_string());
+        dump.refs[METHOD_STRING_REFS].push_back(
+            {method_id, string_id, insn->opcode()});
       }
     }
     if (insn->has_type()) {
       auto cls = type_class(insn->get_type());
       if (cls && class_ids.count(cls)) {
-        auto class_id = class_ids[cls];
-        fprintf(fdout,
-                "INSERT INTO %smethod_class_refs VALUES (%d, %d, %d, %d);\n",
-                prefix,
-                next_class_ref++,
-                method_id,
-                class_id,
-                insn->opcode());
+        auto class_id = class_ids.at(cls);
+        dump.refs[METHOD_CLASS_REFS].push_back(
+            {method_id, class_id, insn->opcode()});
       }
     }
     if (insn->has_field()) {
       auto field = resolve_field(insn->get_field());
       if (field != nullptr && field_ids.count(field)) {
-        auto field_id = field_ids[field];
-        fprintf(fdout,
-                "INSERT INTO %smethod_field_refs VALUES (%d, %d, %d, %d);\n",
-                prefix,
-                next_field_ref++,
-                method_id,
-                field_id,
-                insn->opcode());
+        auto field_id = field_ids.at(field);
+        dump.refs[METHOD_FIELD_REFS].push_back(
+            {method_id, field_id, insn->opcode()});
       }
     }
     if (insn->has_method()) {
       auto meth =
           resolve_method(insn->get_method(), opcode_to_search(insn), method);
       if (meth != nullptr && method_ids.count(meth)) {
-        auto method_ref_id = method_ids[meth];
-        fprintf(fdout,
-                "INSERT INTO %smethod_method_refs VALUES (%d, %d, %d, %d);\n",
-                prefix,
-                next_method_ref++,
-                method_id,
-                method_ref_id,
-                insn->opcode());
+        auto method_ref_id = method_ids.at(meth);
+        dump.refs[METHOD_METHOD_REFS].push_back(
+            {method_id, method_ref_id, insn->opcode()});
       }
     }
   }
 }
 
-void dump_class(FILE* fdout,
-                const char* prefix,
+void dump_class(TableBuffer& out,
                 const char* dex_id,
                 DexClass* cls,
                 int class_id) {
@@ -138,39 +260,32 @@ void dump_class(FILE* fdout,
   // TODO: string usage
   // TODO: size estimate
   const auto& deobfuscated_name = cls->get_deobfuscated_name();
-  fprintf(fdout,
-          "INSERT INTO %sclasses VALUES (%d,'%s','%s','%s',%u);\n",
-          prefix,
-          class_id,
-          dex_id,
-          deobfuscated_name.c_str(),
-          cls->get_name()->c_str(),
-          cls->get_access());
+  out.begin_row();
+  out.num(class_id);
+  out.text(dex_id);
+  out.text(deobfuscated_name.c_str());
+  out.text(cls->get_name()->c_str());
+  out.num(cls->get_access());
+  out.end_row();
 }
 
-void dump_field(FILE* fdout,
-                const char* prefix,
-                int class_id,
-                DexField* field,
-                int field_id) {
+void dump_field(TableBuffer& out, int class_id, DexField* field, int field_id) {
   // TODO: more fixup here on this crapped up name/signature
   // TODO: break down signature
   // TODO: annotations?
   // TODO: string usage (encoded_value for static fields)
   const auto& deobfuscated_name = field->get_deobfuscated_name();
   auto field_name = strchr(deobfuscated_name.c_str(), ';');
-  fprintf(fdout,
-          "INSERT INTO %sfields VALUES(%d, %d, '%s', '%s', %u);\n",
-          prefix,
-          field_id,
-          class_id,
-          field_name,
-          field->get_name()->c_str(),
-          field->get_access());
+  out.begin_row();
+  out.num(field_id);
+  out.num(class_id);
+  out.text(field_name);
+  out.text(field->get_name()->c_str());
+  out.num(field->get_access());
+  out.end_row();
 }
 
-void dump_method(FILE* fdout,
-                 const char* prefix,
+void dump_method(TableBuffer& out,
                  int class_id,
                  DexMethod* method,
                  int method_id) {
@@ -182,22 +297,89 @@ void dump_method(FILE* fdout,
   // TODO: size estimate
   auto deobfuscated_name = method->get_deobfuscated_name();
   auto method_name = strchr(deobfuscated_name.c_str(), ';');
-  fprintf(fdout,
-          "INSERT INTO %smethods VALUES (%d,%d,'%s','%s',%d,%lu);\n",
-          prefix,
-          method_id,
-          class_id,
-          method_name,
-          method->get_name()->c_str(),
-          method->get_access(),
-          method->get_code() ? method->get_code()->sum_opcode_sizes() : 0);
+  out.begin_row();
+  out.num(method_id);
+  out.num(class_id);
+  out.text(method_name);
+  out.text(method->get_name()->c_str());
+  out.num(method->get_access());
+  out.num(method->get_code() ? method->get_code()->sum_opcode_sizes() : 0);
+  out.end_row();
 }
 
-void dump_sql(FILE* fdout,
-              DexStoresVector& stores,
-              ProguardMap& pg_map,
-              const char* prefix) {
-  fprintf(fdout,
+// Encodes the items of a dex, whose ids are assigned, and gathers its refs.
+void dump_dex(DexDump& dump, Format format, const std::string& prefix) {
+  std::vector<TableBuffer> out;
+  for (auto table : {STRINGS, CLASSES, FIELDS, METHODS}) {
+    out.emplace_back(format, prefix + kTableNames[table]);
+  }
+  int string_id = dump.first_string_id;
+  for (auto dexstr : dump.strings) {
+    out[STRINGS].begin_row();
+    out[STRINGS].num(string_id++);
+    out[STRINGS].text(dexstr->c_str());
+    out[STRINGS].end_row();
+  }
+  for (const auto& cls : *dump.dex) {
+    int class_id = class_ids.at(cls);
+    dump_class(out[CLASSES], dump.dex_id.c_str(), cls, class_id);
+    for (auto field : cls->get_ifields()) {
+      dump_field(out[FIELDS], class_id, field, field_ids.at(field));
+    }
+    for (auto field : cls->get_sfields()) {
+      dump_field(out[FIELDS], class_id, field, field_ids.at(field));
+    }
+    for (const auto& meth : cls->get_dmethods()) {
+      dump_method(out[METHODS], class_id, meth, method_ids.at(meth));
+    }
+    for (auto& meth : cls->get_vmethods()) {
+      dump_method(out[METHODS], class_id, meth, method_ids.at(meth));
+    }
+  }
+  for (auto table : {STRINGS, CLASSES, FIELDS, METHODS}) {
+    dump.encoded[table] = out[table].take();
+  }
+
+  for (const auto& cls : *dump.dex) {
+    for (const auto& meth : cls->get_dmethods()) {
+      gather_method_refs(dump, meth, method_ids.at(meth));
+    }
+    for (auto& meth : cls->get_vmethods()) {
+      gather_method_refs(dump, meth, method_ids.at(meth));
+    }
+    for (const auto& field : cls->get_sfields()) {
+      gather_field_refs(dump, field, field_ids.at(field));
+    }
+    for (const auto& field : cls->get_ifields()) {
+      gather_field_refs(dump, field, field_ids.at(field));
+    }
+  }
+}
+
+// Encodes the refs of a table, which are numbered from first_id.
+std::string encode_refs(const std::vector<Ref>& refs,
+                        Table table,
+                        int first_id,
+                        Format format,
+                        const std::string& prefix) {
+  TableBuffer out(format, prefix + kTableNames[table]);
+  int id = first_id;
+  for (const auto& ref : refs) {
+    out.begin_row();
+    out.num(id++);
+    out.num(ref[0]);
+    out.num(ref[1]);
+    if (table != FIELD_STRING_REFS && table != IS_A) {
+      out.num(ref[2]);
+    }
+    out.end_row();
+  }
+  return out.take();
+}
+
+std::string schema(const char* prefix) {
+  std::vector<char> buf(8192);
+  int size = snprintf(buf.data(), buf.size(),
           R"___(
 DROP TABLE IF EXISTS %1$sfield_string_refs;
 DROP TABLE IF EXISTS %1$smethod_string_refs;
@@ -271,113 +453,171 @@ CREATE TABLE %1$smethod_string_refs (
 );
 )___",
           prefix);
-  int next_class_id = 0;
-  int next_method_id = 0;
-  int next_field_id = 0;
-  int next_string_id = 0;
+  always_assert(size > 0 && (size_t)size < buf.size());
+  return std::string(buf.data(), size);
+}
 
-  // Dump all dex items
-  fprintf(fdout, "BEGIN TRANSACTION;\n");
+template <typename Fn>
+void parallel_for(size_t n, const Fn& fn) {
+  auto wq = workqueue_foreach<size_t>(fn);
+  for (size_t i = 0; i < n; ++i) {
+    wq.add_item(i);
+  }
+  wq.run_all();
+}
+
+/*
+ * Dumps all the dexes. The ids are assigned in dex order first, and then each
+ * dex is encoded on its own thread; the output is the same as if it were
+ * written serially.
+ */
+void dump(DexStoresVector& stores,
+          ProguardMap& pg_map,
+          const std::string& prefix,
+          Format format,
+          const std::function<FILE*(Table)>& out) {
+  std::vector<DexDump> dumps;
   for (auto& store : stores) {
     auto store_name = store.get_name();
     auto& dexen = store.get_dexen();
     apply_deobfuscated_names(dexen, pg_map);
     for (size_t dex_idx = 0; dex_idx < dexen.size(); ++dex_idx) {
-      auto& dex = dexen[dex_idx];
-      GatheredTypes gtypes(&dex);
-      auto strings = gtypes.get_cls_order_dexstring_emitlist();
-      for (auto dexstr : strings) {
-        int id = next_string_id++;
-        string_ids[dexstr] = id;
-        // Escape string before inserting. ' -> ''
-        std::string esc(dexstr->c_str());
-        boost::replace_all(esc, "'", "''");
-        fprintf(fdout,
-                "INSERT INTO %sstrings VALUES(%d, '%s');\n",
-                prefix,
-                id,
-                esc.c_str());
+      DexDump dump;
+      dump.dex = &dexen[dex_idx];
+      dump.dex_id = store_name + "/" + std::to_string(dex_idx);
+      dumps.push_back(std::move(dump));
+    }
+  }
+  parallel_for(dumps.size(), [&](size_t i) {
+    GatheredTypes gtypes(const_cast<DexClasses*>(dumps[i].dex));
+    dumps[i].strings = gtypes.get_cls_order_dexstring_emitlist();
+  });
+
+  int next_class_id = 0;
+  int next_method_id = 0;
+  int next_field_id = 0;
+  int next_string_id = 0;
+  for (auto& dump : dumps) {
+    dump.first_string_id = next_string_id;
+    for (auto dexstr : dump.strings) {
+      string_ids[dexstr] = next_string_id++;
+    }
+    for (const auto& cls : *dump.dex) {
+      class_ids[cls] = next_class_id++;
+      for (auto field : cls->get_ifields()) {
+        field_ids[field] = next_field_id++;
+      }
+      for (auto field : cls->get_sfields()) {
+        field_ids[field] = next_field_id++;
       }
-      std::string dex_id_str(store_name + "/" + std::to_string(dex_idx));
-      const char* dex_id = dex_id_str.c_str();
-      for (const auto& cls : dex) {
-        int class_id = next_class_id++;
-        dump_class(fdout, prefix, dex_id, cls, class_id);
-        class_ids[cls] = class_id;
-        for (auto field : cls->get_ifields()) {
-          int field_id = next_field_id++;
-          field_ids[field] = field_id;
-          dump_field(fdout, prefix, class_id, field, field_id);
-        }
-        for (auto field : cls->get_sfields()) {
-          int field_id = next_field_id++;
-          field_ids[field] = field_id;
-          dump_field(fdout, prefix, class_id, field, field_id);
-        }
-        for (const auto& meth : cls->get_dmethods()) {
-          int meth_id = next_method_id++;
-          method_ids[meth] = meth_id;
-          dump_method(fdout, prefix, class_id, meth, meth_id);
-        }
-        for (auto& meth : cls->get_vmethods()) {
-          int meth_id = next_method_id++;
-          method_ids[meth] = meth_id;
-          dump_method(fdout, prefix, class_id, meth, meth_id);
-        }
+      for (const auto& meth : cls->get_dmethods()) {
+        method_ids[meth] = next_method_id++;
+      }
+      for (auto& meth : cls->get_vmethods()) {
+        method_ids[meth] = next_method_id++;
       }
     }
   }
-  fprintf(fdout, "END TRANSACTION;\n");
+  // A string that is in several dexes is referred to by the id of its last
+  // occurrence, so the refs are only gathered once all of them are assigned.
+  parallel_for(dumps.size(),
+               [&](size_t i) { dump_dex(dumps[i], format, prefix); });
 
-  // Dump references
-  fprintf(fdout, "BEGIN TRANSACTION;\n");
-  for (auto& store : stores) {
-    auto& dexen = store.get_dexen();
-    for (size_t dex_idx = 0; dex_idx < dexen.size(); ++dex_idx) {
-      auto& dex = dexen[dex_idx];
-      for (const auto& cls : dex) {
-        for (const auto& meth : cls->get_dmethods()) {
-          int meth_id = method_ids[meth];
-          dump_method_refs(fdout, prefix, meth, meth_id);
-        }
-        for (auto& meth : cls->get_vmethods()) {
-          int meth_id = method_ids[meth];
-          dump_method_refs(fdout, prefix, meth, meth_id);
-        }
-        for (const auto& field : cls->get_sfields()) {
-          int field_id = field_ids[field];
-          dump_field_refs(fdout, prefix, field, field_id);
-        }
-        for (const auto& field : cls->get_ifields()) {
-          int field_id = field_ids[field];
-          dump_field_refs(fdout, prefix, field, field_id);
-        }
-      }
+  const std::array<Table, 5> ref_tables = {
+      FIELD_STRING_REFS, METHOD_STRING_REFS, METHOD_CLASS_REFS,
+      METHOD_FIELD_REFS, METHOD_METHOD_REFS};
+  std::vector<std::array<int, NUM_TABLES>> first_ref_ids(dumps.size());
+  std::array<int, NUM_TABLES> next_ref_ids{};
+  for (size_t i = 0; i < dumps.size(); ++i) {
+    for (auto table : ref_tables) {
+      first_ref_ids[i][table] = next_ref_ids[table];
+      next_ref_ids[table] += dumps[i].refs[table].size();
     }
   }
-  fprintf(fdout, "END TRANSACTION;\n");
+  parallel_for(dumps.size() * ref_tables.size(), [&](size_t i) {
+    auto& dump = dumps[i / ref_tables.size()];
+    auto table = ref_tables[i % ref_tables.size()];
+    dump.encoded[table] =
+        encode_refs(dump.refs[table], table,
+                    first_ref_ids[i / ref_tables.size()][table], format,
+                    prefix);
+    dump.refs[table] = std::vector<Ref>();
+  });
 
   // Dump hierarchy
   auto scope = build_class_scope(stores);
   ClassHierarchy ch = build_type_hierarchy(scope);
-  int next_is_a_id = 0;
-  fprintf(fdout, "BEGIN TRANSACTION;\n");
-  for (auto& cls : scope) {
+  std::vector<std::vector<Ref>> is_a(scope.size());
+  parallel_for(scope.size(), [&](size_t i) {
+    auto cls = scope[i];
     TypeSet results;
     get_all_children_or_implementors(ch, scope, cls, results);
     for (auto type : results) {
       auto type_cls = type_class(type);
       if (type_cls) {
-        fprintf(fdout,
-                "INSERT INTO %sis_a VALUES(%d, %d, %d);\n",
-                prefix,
-                next_is_a_id++,
-                class_ids[type_cls],
-                class_ids[cls]);
+        is_a[i].push_back(
+            {id_of(class_ids, type_cls), id_of(class_ids, cls), 0});
       }
     }
+  });
+  std::vector<Ref> all_is_a;
+  for (auto& refs : is_a) {
+    all_is_a.insert(all_is_a.end(), refs.begin(), refs.end());
+  }
+
+  auto write = [&](Table table, const std::string& text) {
+    fwrite(text.data(), 1, text.size(), out(table));
+  };
+  auto write_sql = [&](const char* text) {
+    if (format == Format::SQL) {
+      fputs(text, out(STRINGS));
+    }
+  };
+  // Dump all dex items
+  write_sql("BEGIN TRANSACTION;\n");
+  for (const auto& dump : dumps) {
+    for (auto table : {STRINGS, CLASSES, FIELDS, METHODS}) {
+      write(table, dump.encoded[table]);
+    }
+  }
+  write_sql("END TRANSACTION;\n");
+  // Dump references
+  write_sql("BEGIN TRANSACTION;\n");
+  for (const auto& dump : dumps) {
+    for (auto table : ref_tables) {
+      write(table, dump.encoded[table]);
+    }
+  }
+  write_sql("END TRANSACTION;\n");
+  write_sql("BEGIN TRANSACTION;\n");
+  write(IS_A, encode_refs(all_is_a, IS_A, 0, format, prefix));
+  write_sql("END TRANSACTION;\n");
+}
+
+const char* csv_load_script() {
+  return R"___(.mode csv
+.import %1$sstrings.csv %1$sstrings
+.import %1$sclasses.csv %1$sclasses
+.import %1$sfields.csv %1$sfields
+.import %1$smethods.csv %1$smethods
+.import %1$sfield_string_refs.csv %1$sfield_string_refs
+.import %1$smethod_string_refs.csv %1$smethod_string_refs
+.import %1$smethod_class_refs.csv %1$smethod_class_refs
+.import %1$smethod_field_refs.csv %1$smethod_field_refs
+.import %1$smethod_method_refs.csv %1$smethod_method_refs
+.import %1$sis_a.csv %1$sis_a
+)___";
+}
+
+FILE* open_or_die(const std::string& filename) {
+  FILE* fd = fopen(filename.c_str(), "w");
+  if (!fd) {
+    fprintf(stderr,
+            "Could not open %s for writing; terminating\n",
+            filename.c_str());
+    exit(EXIT_FAILURE);
   }
-  fprintf(fdout, "END TRANSACTION;\n");
+  return fd;
 }
 
 class DexSqlDump : public Tool {
@@ -393,10 +633,15 @@ class DexSqlDump : public Tool {
         "path to a rename map")(
         "output,o",
         po::value<std::string>()->value_name("dex.sql"),
-        "path to output sql dump file (defaults to stdout)")(
+        "path to output sql dump file (defaults to stdout), or to the output "
+        "directory with --format csv")(
         "table-prefix,t",
         po::value<std::string>()->value_name("pre_"),
-        "prefix to use on all table names");
+        "prefix to use on all table names")(
+        "format,f",
+        po::value<std::string>()->value_name("sql|csv")->default_value("sql"),
+        "sql for an insertion script, csv for a csv file per table along with "
+        "schema.sql and load.sql scripts to import them");
   }
 
   void run(const po::variables_map& options) override {
@@ -406,21 +651,49 @@ class DexSqlDump : public Tool {
     ProguardMap pgmap(options.count("proguard-map")
                           ? options["proguard-map"].as<std::string>()
                           : "/dev/null");
-    const std::string& filename = options["output"].as<std::string>();
-    FILE* fdout =
-        options.count("output") ? fopen(filename.c_str(), "w") : stdout;
     std::string prefix = options.count("table-prefix")
                              ? options["table-prefix"].as<std::string>()
                              : "";
-    if (!fdout) {
-      fprintf(stderr,
-              "Could not open %s for writing; terminating\n",
-              filename.c_str());
+    const auto& format_name = options["format"].as<std::string>();
+    if (format_name != "sql" && format_name != "csv") {
+      fprintf(stderr, "Unknown format %s; terminating\n", format_name.c_str());
       exit(EXIT_FAILURE);
     }
     auto* pfx_cstr = prefix.c_str();
-    dump_sql(fdout, stores, pgmap, pfx_cstr);
-    fclose(fdout);
+
+    if (format_name == "sql") {
+      FILE* fdout = options.count("output")
+                        ? open_or_die(options["output"].as<std::string>())
+                        : stdout;
+      fputs(schema(pfx_cstr).c_str(), fdout);
+      dump(stores, pgmap, prefix, Format::SQL,
+           [&](Table) { return fdout; });
+      fclose(fdout);
+      return;
+    }
+
+    if (!options.count("output")) {
+      fprintf(stderr, "--format csv needs an output directory; terminating\n");
+      exit(EXIT_FAILURE);
+    }
+    boost::filesystem::path dir(options["output"].as<std::string>());
+    boost::filesystem::create_directories(dir);
+    FILE* fdschema = open_or_die((dir / "schema.sql").string());
+    fputs(schema(pfx_cstr).c_str(), fdschema);
+    fclose(fdschema);
+    FILE* fdload = open_or_die((dir / "load.sql").string());
+    fprintf(fdload, csv_load_script(), pfx_cstr);
+    fclose(fdload);
+    std::array<FILE*, NUM_TABLES> fdouts;
+    for (size_t table = 0; table < NUM_TABLES; ++table) {
+      fdouts[table] = open_or_die(
+          (dir / (prefix + kTableNames[table] + ".csv")).string());
+    }
+    dump(stores, pgmap, prefix, Format::CSV,
+         [&](Table table) { return fdouts[table]; });
+    for (auto fdout : fdouts) {
+      fclose(fdout);
+    }
   }
 };
 
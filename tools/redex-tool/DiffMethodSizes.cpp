@@ -6,7 +6,7 @@
  */
 
 #include "DexClass.h"
-#include "DexInstruction.h"
+#include "DexMethodSizes.h"
 #include "DexUtil.h"
 #include "JarLoader.h"
 #include "ProguardConfiguration.h"
@@ -136,52 +136,22 @@ using DexMethodInfoMap =
                                               // it is storing move info.
 
 DexMethodInfoMap load_dex_method_info(const std::string& dir) {
-  DexStore root_store("dex");
-  DexStoresVector stores;
-
-  // Load root dexen
-  load_root_dexen(root_store, dir);
-  stores.emplace_back(std::move(root_store));
   DexMethodInfoMap result;
-
-  walk::methods(build_class_scope(stores), [&result](DexMethod* method) {
-    auto key = show(method);
-    always_assert(result.find(key) == end(result));
-    const auto* code = method->get_dex_code();
-    result.emplace(key,
-                   std::make_tuple((code ? code->size() : 0),
-                                   (code ? code->get_registers_size() : 0)));
-  });
-
+  for (auto& info : read_dexen_dir_method_sizes(dir)) {
+    always_assert(result.find(info.name) == end(result));
+    result.emplace(std::move(info.name),
+                   std::make_tuple(info.code_size, info.registers_size));
+  }
   return result;
 }
 
 DexMethodInfoMap load_dex_method_move_info(const std::string& dir) {
-  DexStore root_store("dex");
-  DexStoresVector stores;
-
-  // Load root dexen
-  load_root_dexen(root_store, dir);
-  stores.emplace_back(std::move(root_store));
   DexMethodInfoMap result;
-
-  walk::methods(build_class_scope(stores), [&result](DexMethod* method) {
-    auto key = show(method);
-    always_assert(result.find(key) == end(result));
-    const auto* code = method->get_dex_code();
-    int num_moves = 0;
-    int moves_size = 0;
-    if (code) {
-      for (const auto& insn : code->get_instructions()) {
-        if (dex_opcode::is_move(insn->opcode())) {
-          ++num_moves;
-          moves_size += insn->size();
-        }
-      }
-    }
-    result.emplace(key, std::make_tuple(num_moves, moves_size));
-  });
-
+  for (auto& info : read_dexen_dir_method_sizes(dir)) {
+    always_assert(result.find(info.name) == end(result));
+    result.emplace(std::move(info.name),
+                   std::make_tuple(info.num_moves, info.moves_size));
+  }
   return result;
 }
 
@@ -202,7 +172,6 @@ void diff_from_two_dexen_dirs(const std::string& dexen_dir_A,
                               bool is_comparing_dex_size) {
   std::cout << "INFO: "
             << "Loading directory " << dexen_dir_A << " ... " << std::endl;
-  RedexContext* A_context = g_redex;
   auto A_info = is_comparing_dex_size ? load_dex_method_info(dexen_dir_A)
                                       : load_dex_method_move_info(dexen_dir_A);
   std::cout << "INFO: " << A_info.size() << " method information loaded"
@@ -210,8 +179,6 @@ void diff_from_two_dexen_dirs(const std::string& dexen_dir_A,
 
   std::cout << "INFO: "
             << "Loading directory " << dexen_dir_B << " ... " << std::endl;
-  std::unique_ptr<RedexContext> B_context(new RedexContext());
-  g_redex = B_context.get();
   auto B_info = is_comparing_dex_size ? load_dex_method_info(dexen_dir_B)
                                       : load_dex_method_move_info(dexen_dir_B);
   std::cout << "INFO: " << B_info.size() << " method information loaded"
@@ -261,8 +228,6 @@ void diff_from_two_dexen_dirs(const std::string& dexen_dir_A,
         << total_num_moves - total_disappear_method_moves << ", move sizes: "
         << total_move_sizes - total_disappear_method_move_sizes << std::endl;
   }
-
-  g_redex = A_context;
 }
 
 void dump_method_move_info_from_dex_dir(const std::string& dex_dir) {
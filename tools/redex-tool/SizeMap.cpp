@@ -6,11 +6,13 @@
  */
 
 #include <ostream>
+#include <sstream>
 
 #include "DexOutput.h"
 #include "Show.h"
 #include "Tool.h"
 #include "Walkers.h"
+#include "WorkQueue.h"
 
 /*
  * This tool dumps method size and property information.
@@ -22,20 +24,34 @@
  */
 namespace {
 void dump_sizes(std::ostream& ofs, DexStoresVector& stores) {
-  auto print = [&](DexMethod* method) {
-    ofs << method->get_fully_deobfuscated_name() << ", "
+  auto scope = build_class_scope(stores);
+  // The lines of each class are formatted in parallel, and then written in
+  // scope order.
+  std::vector<std::string> lines(scope.size());
+  auto print = [](std::ostringstream& out, DexMethod* method) {
+    out << method->get_fully_deobfuscated_name() << ", "
         << (method->get_dex_code() ? method->get_dex_code()->size() : -1)
         << ", " << method->is_virtual() << ", " << method->is_external() << ", "
-        << method->is_concrete() << std::endl;
+        << method->is_concrete() << "\n";
   };
-  walk::classes(build_class_scope(stores), [&](DexClass* cls) {
-    for (auto dmethod : cls->get_dmethods()) {
-      print(dmethod);
+  auto wq = workqueue_foreach<size_t>([&](size_t i) {
+    std::ostringstream out;
+    for (auto dmethod : scope[i]->get_dmethods()) {
+      print(out, dmethod);
     }
-    for (auto vmethod : cls->get_vmethods()) {
-      print(vmethod);
+    for (auto vmethod : scope[i]->get_vmethods()) {
+      print(out, vmethod);
     }
+    lines[i] = out.str();
   });
+  for (size_t i = 0; i < scope.size(); ++i) {
+    wq.add_item(i);
+  }
+  wq.run_all();
+  for (const auto& cls_lines : lines) {
+    ofs << cls_lines;
+  }
+  ofs.flush();
 }
 
 class SizeMap : public Tool {
@@ -6,6 +6,7 @@
  */
 
 #include <queue>
+#include <sstream>
 #include <unordered_map>
 #include <vector>
 
@@ -14,30 +15,50 @@
 #include "Show.h"
 #include "Tool.h"
 #include "Walkers.h"
+#include "WorkQueue.h"
 
 namespace {
 
+std::string method_viz(DexMethod* meth, IRCode& code) {
+  std::ostringstream ss;
+  code.build_cfg(/* editable */ false);
+  const auto& blocks = code.cfg().blocks();
+  ss << "digraph \"" << show(meth) << "\" {\n";
+  for (const auto& block : blocks) {
+    ss << " \"" << block << "\" [label=\"";
+    for (auto mie = block->begin(); mie != block->end(); ++mie) {
+      ss << " " << show(*mie) << " \\n ";
+    }
+    ss << "\"]\n";
+    for (const auto& succ : block->succs()) {
+      ss << " \"" << block << "\" -> \"" << succ->target() << "\"\n";
+    }
+  }
+  ss << "}\n\n";
+  return ss.str();
+}
+
 void dump_viz(const Scope& scope,
               const char* cls_filter,
               const char* meth_filter) {
+  std::vector<std::pair<DexMethod*, IRCode*>> methods;
   walk::code(scope, [&](DexMethod* meth, IRCode& code) {
     if (cls_filter && !strstr(meth->get_class()->c_str(), cls_filter)) return;
     if (meth_filter && !strstr(meth->c_str(), meth_filter)) return;
-    code.build_cfg(/* editable */ false);
-    const auto& blocks = code.cfg().blocks();
-    fprintf(stderr, "digraph \"%s\" {\n", SHOW(meth));
-    for (const auto& block : blocks) {
-      fprintf(stderr, " \"%p\" [label=\"", block);
-      for (auto mie = block->begin(); mie != block->end(); ++mie) {
-        fprintf(stderr, " %s \\n ", SHOW(*mie));
-      }
-      fprintf(stderr, "\"]\n");
-      for (const auto& succ : block->succs()) {
-        fprintf(stderr, " \"%p\" -> \"%p\"\n", block, succ->target());
-      }
-    }
-    fprintf(stderr, "}\n\n");
+    methods.emplace_back(meth, &code);
+  });
+  // The graphs are built in parallel, and written in the order of the scope.
+  std::vector<std::string> graphs(methods.size());
+  auto wq = workqueue_foreach<size_t>([&](size_t i) {
+    graphs[i] = method_viz(methods[i].first, *methods[i].second);
   });
+  for (size_t i = 0; i < methods.size(); ++i) {
+    wq.add_item(i);
+  }
+  wq.run_all();
+  for (const auto& graph : graphs) {
+    fwrite(graph.data(), 1, graph.size(), stderr);
+  }
 }
 
 } // namespace
@@ -5,6 +5,9 @@
  * LICENSE file in the root directory of this source tree.
  */
 
+// Sparta uses assert, which Debug.h undefines.
+#include "WorkQueue.h"
+
 #include "DexDebugInstruction.h"
 #include "DexEncoding.h"
 #include "Formatters.h"
@@ -12,11 +15,51 @@
 #include "RedexDump.h"
 #include "utils/Unicode.h"
 
+#include <algorithm>
 #include <sstream>
+#include <stdio.h>
 #include <string.h>
 #include <string>
 #include <vector>
 
+/**
+ * Call dump_item for every index in [0, size). With several jobs, ranges of
+ * indices are dumped concurrently into buffers which are then printed in
+ * order, so the output is the same.
+ */
+template <typename DumpItem>
+static void dump_in_ranges(uint32_t size, const DumpItem& dump_item) {
+  if (jobs <= 1 || size == 0) {
+    for (uint32_t i = 0; i < size; i++) {
+      dump_item(i);
+    }
+    return;
+  }
+  // A few ranges per job, so that ranges with bigger items don't hold up the
+  // others.
+  uint32_t range_size =
+      std::max<uint32_t>((size + jobs * 4 - 1) / (jobs * 4), 64);
+  uint32_t num_ranges = (size + range_size - 1) / range_size;
+  std::vector<std::string> outputs(num_ranges);
+  auto wq = workqueue_foreach<uint32_t>(
+      [&](uint32_t range) {
+        RedumpBuffer buffer;
+        uint32_t end = std::min(size, (range + 1) * range_size);
+        for (uint32_t i = range * range_size; i < end; i++) {
+          dump_item(i);
+        }
+        outputs[range] = std::move(buffer.str());
+      },
+      std::min<size_t>(jobs, num_ranges));
+  for (uint32_t range = 0; range < num_ranges; range++) {
+    wq.add_item(range);
+  }
+  wq.run_all();
+  for (const auto& output : outputs) {
+    redump("%s", output.c_str());
+  }
+}
+
 /**
  * Return a proto string in the form
  * [shorty] (argTypes)returnType
@@ -601,9 +644,9 @@ void dump_clsdefs(ddump_data* rd, bool print_headers) {
         "\t[file: <filename>] [anno: annotation_off] data: class_data_off "
         "[static values: static_value_off]\n");
   }
-  for (uint32_t i = 0; i < size; i++) {
+  dump_in_ranges(size, [&](uint32_t i) {
     redump(i, "%s\n", get_class_def(rd, i).c_str());
-  }
+  });
 }
 
 void dump_clsdata(ddump_data* rd, bool print_headers) {
@@ -617,13 +660,13 @@ void dump_clsdata(ddump_data* rd, bool print_headers) {
         "dmethods: <count> followed by dmethods\n"
         "vmethods: <count> followed by vmethods\n");
   }
-  for (uint32_t i = 0; i < size; i++) {
+  dump_in_ranges(size, [&](uint32_t i) {
     const dex_class_def* class_defs =
         (dex_class_def*)(rd->dexmmap + rd->dexh->class_defs_off) + i;
     redump(class_defs->class_data_offset,
            "%s",
            get_class_data_item(rd, i).c_str());
-  }
+  });
 }
 
 void dump_callsites(ddump_data* rd, bool print_headers) {
@@ -678,9 +721,51 @@ void dump_methodhandles(ddump_data* rd, bool print_headers) {
   }
 }
 
+/**
+ * Return the sorted offsets of the code items of all the methods in the class
+ * data, which lets the code items be dumped from anywhere in the section.
+ */
+static std::vector<uint32_t> index_code_items(ddump_data* rd) {
+  std::vector<uint32_t> offsets;
+  for (uint32_t i = 0; i < rd->dexh->class_defs_size; i++) {
+    auto cls_off = rd->dex_class_defs[i].class_data_offset;
+    if (!cls_off) continue;
+    const uint8_t* class_data =
+        reinterpret_cast<const uint8_t*>(rd->dexmmap + cls_off);
+    uint32_t sfield_count = read_uleb128(&class_data);
+    uint32_t ifield_count = read_uleb128(&class_data);
+    uint32_t dmethod_count = read_uleb128(&class_data);
+    uint32_t vmethod_count = read_uleb128(&class_data);
+    for (uint32_t j = 0; j < (sfield_count + ifield_count) * 2; j++) {
+      read_uleb128(&class_data);
+    }
+    for (uint32_t j = 0; j < dmethod_count + vmethod_count; j++) {
+      read_uleb128(&class_data);
+      read_uleb128(&class_data);
+      auto code = read_uleb128(&class_data);
+      if (code) offsets.push_back(code);
+    }
+  }
+  std::sort(offsets.begin(), offsets.end());
+  offsets.erase(std::unique(offsets.begin(), offsets.end()), offsets.end());
+  return offsets;
+}
+
 static void dump_code_items(ddump_data* rd,
                             dex_code_item* code_items,
                             uint32_t size) {
+  if (jobs > 1) {
+    auto offsets = index_code_items(rd);
+    auto first = reinterpret_cast<char*>(code_items) - rd->dexmmap;
+    // Code items that no method refers to wouldn't be dumped from the index.
+    if (offsets.size() == size && size != 0 && offsets[0] == first) {
+      dump_in_ranges(size, [&](uint32_t i) {
+        auto code_item = (dex_code_item*)(rd->dexmmap + offsets[i]);
+        redump(offsets[i], "%s", get_code_item(&code_item).c_str());
+      });
+      return;
+    }
+  }
   for (uint32_t i = 0; i < size; i++) {
     auto offset = reinterpret_cast<char*>(code_items) - rd->dexmmap;
     redump(offset, "%s", get_code_item(&code_items).c_str());
@@ -785,9 +870,9 @@ static void dump_class_annotations(ddump_data* rd, dex_class_def* df) {
 }
 
 void dump_anno(ddump_data* rd) {
-  for (uint32_t i = 0; i < rd->dexh->class_defs_size; i++) {
+  dump_in_ranges(rd->dexh->class_defs_size, [&](uint32_t i) {
     dump_class_annotations(rd, &rd->dex_class_defs[i]);
-  }
+  });
 }
 
 void dump_debug(ddump_data* rd) {
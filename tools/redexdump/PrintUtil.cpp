@@ -12,26 +12,57 @@
 bool clean = false;
 bool raw = false;
 bool escape = false;
+size_t jobs = 1;
+
+namespace {
+
+thread_local std::string* current_buffer = nullptr;
+
+void vredump(const char* format, va_list va) {
+  if (current_buffer == nullptr) {
+    vprintf(format, va);
+    return;
+  }
+  va_list va_len;
+  va_copy(va_len, va);
+  int len = vsnprintf(nullptr, 0, format, va_len);
+  va_end(va_len);
+  if (len <= 0) {
+    return;
+  }
+  auto start = current_buffer->size();
+  current_buffer->resize(start + len + 1);
+  vsnprintf(&(*current_buffer)[start], len + 1, format, va);
+  current_buffer->resize(start + len);
+}
+
+} // namespace
 
 void redump(const char* format, ...) {
   va_list va;
   va_start(va, format);
-  vprintf(format, va);
+  vredump(format, va);
   va_end(va);
 }
 
 void redump(uint32_t off, const char* format, ...) {
   va_list va;
   va_start(va, format);
-  if (!clean) printf("[0x%x] ", off);
-  vprintf(format, va);
+  if (!clean) redump("[0x%x] ", off);
+  vredump(format, va);
   va_end(va);
 }
 
 void redump(uint32_t pos, uint32_t off, const char* format, ...) {
   va_list va;
   va_start(va, format);
-  if (!clean) printf("(0x%x) [0x%x] ", pos, off);
-  vprintf(format, va);
+  if (!clean) redump("(0x%x) [0x%x] ", pos, off);
+  vredump(format, va);
   va_end(va);
 }
+
+RedumpBuffer::RedumpBuffer() : m_previous(current_buffer) {
+  current_buffer = &m_buffer;
+}
+
+RedumpBuffer::~RedumpBuffer() { current_buffer = m_previous; }
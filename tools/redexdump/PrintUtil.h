@@ -8,11 +8,32 @@
 #pragma once
 
 #include <stdint.h>
+#include <string>
 
 extern bool clean;
 extern bool raw;
 extern bool escape;
+// The number of threads the dump may use.
+extern size_t jobs;
 
 void redump(const char* format, ...);
 void redump(uint32_t off, const char* format, ...);
 void redump(uint32_t pos, uint32_t off, const char* format, ...);
+
+// While alive, collects everything the current thread redumps instead of
+// printing it, so that parts of a dump can be produced concurrently and then
+// printed in order.
+class RedumpBuffer {
+ public:
+  RedumpBuffer();
+  ~RedumpBuffer();
+
+  RedumpBuffer(const RedumpBuffer&) = delete;
+  RedumpBuffer& operator=(const RedumpBuffer&) = delete;
+
+  std::string& str() { return m_buffer; }
+
+ private:
+  std::string m_buffer;
+  std::string* m_previous;
+};
@@ -5,11 +5,17 @@
  * LICENSE file in the root directory of this source tree.
  */
 
+// Sparta uses assert, which Debug.h undefines.
+#include "WorkQueue.h"
+
 #include "RedexDump.h"
+#include <algorithm>
 #include <getopt.h>
 #include <stdio.h>
 #include <stdlib.h>
 #include <string.h>
+#include <string>
+#include <vector>
 
 #include "Formatters.h"
 #include "PrintUtil.h"
@@ -47,7 +53,8 @@ static const char ddump_usage_string[] =
     "printing options:\n"
     "--clean: suppress indices and offsets\n"
     "--no-headers: suppress headers\n"
-    "--raw: print all bytes, even control characters\n";
+    "--raw: print all bytes, even control characters\n"
+    "-j, --jobs=<n>: dump with n threads; the output is the same\n";
 
 int main(int argc, char* argv[]) {
 
@@ -91,11 +98,12 @@ int main(int argc, char* argv[]) {
       {"raw", no_argument, (int*)&raw, 1},
       {"escape", no_argument, (int*)&escape, 1},
       {"no-headers", no_argument, &no_headers, 1},
+      {"jobs", required_argument, nullptr, 'j'},
       {"help", no_argument, nullptr, 'h'},
       {nullptr, 0, nullptr, 0},
   };
 
-  while ((c = getopt_long(argc, argv, "asStpfmcCxeAdDh", &options[0],
+  while ((c = getopt_long(argc, argv, "asStpfmcCxeAdDhj:", &options[0],
                           nullptr)) != -1) {
     switch (c) {
     case 'a':
@@ -146,6 +154,9 @@ int main(int argc, char* argv[]) {
     case 'D':
       sscanf(optarg, "%x", &ddebug_offset);
       break;
+    case 'j':
+      jobs = std::max(atoi(optarg), 1);
+      break;
     case 'h':
       puts(ddump_usage_string);
       return 0;
@@ -164,8 +175,7 @@ int main(int argc, char* argv[]) {
     return 1;
   }
 
-  while (optind < argc) {
-    const char* dexfile = argv[optind++];
+  auto dump_dex = [&](const char* dexfile) {
     ddump_data rd;
     open_dex_file(dexfile, &rd);
     if (!no_headers) {
@@ -217,8 +227,34 @@ int main(int argc, char* argv[]) {
     if (ddebug_offset != 0) {
       disassemble_debug(&rd, ddebug_offset);
     }
-    fprintf(stdout, "\n");
-    fflush(stdout);
+    redump("\n");
+  };
+
+  std::vector<const char*> dexfiles(argv + optind, argv + argc);
+  if (jobs > 1 && dexfiles.size() > 1) {
+    // Dump each dex on a single thread, and several dexes at once.
+    size_t dex_jobs = std::min(jobs, dexfiles.size());
+    jobs = 1;
+    std::vector<std::string> outputs(dexfiles.size());
+    auto wq = workqueue_foreach<size_t>(
+        [&](size_t i) {
+          RedumpBuffer buffer;
+          dump_dex(dexfiles[i]);
+          outputs[i] = std::move(buffer.str());
+        },
+        dex_jobs);
+    for (size_t i = 0; i < dexfiles.size(); i++) {
+      wq.add_item(i);
+    }
+    wq.run_all();
+    for (const auto& output : outputs) {
+      fputs(output.c_str(), stdout);
+    }
+  } else {
+    for (auto dexfile : dexfiles) {
+      dump_dex(dexfile);
+      fflush(stdout);
+    }
   }
 
   return 0;
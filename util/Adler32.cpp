@@ -0,0 +1,144 @@
+/*
+ * Copyright (c) Facebook, Inc. and its affiliates.
+ *
+ * This source code is licensed under the MIT license found in the
+ * LICENSE file in the root directory of this source tree.
+ */
+
+#include "Adler32.h"
+
+#if (defined(__x86_64__) || defined(__i386__)) && defined(__GNUC__)
+#define ADLER32_X86_SSSE3 1
+#include <cpuid.h>
+#include <immintrin.h>
+#endif
+
+namespace {
+
+// Largest prime smaller than 65536.
+constexpr uint32_t BASE = 65521;
+// Largest n such that 255n(n+1)/2 + (n+1)(BASE-1) fits into 32 bits, i.e. the
+// number of bytes we can sum up before we have to reduce modulo BASE.
+constexpr size_t NMAX = 5552;
+
+uint32_t adler32_portable(uint32_t adler,
+                          const unsigned char* input,
+                          size_t len) {
+  uint32_t s1 = adler & 0xffff;
+  uint32_t s2 = adler >> 16;
+  while (len > 0) {
+    size_t n = len < NMAX ? len : NMAX;
+    len -= n;
+    for (; n >= 8; n -= 8, input += 8) {
+      s1 += input[0];
+      s2 += s1;
+      s1 += input[1];
+      s2 += s1;
+      s1 += input[2];
+      s2 += s1;
+      s1 += input[3];
+      s2 += s1;
+      s1 += input[4];
+      s2 += s1;
+      s1 += input[5];
+      s2 += s1;
+      s1 += input[6];
+      s2 += s1;
+      s1 += input[7];
+      s2 += s1;
+    }
+    for (; n > 0; n--) {
+      s1 += *input++;
+      s2 += s1;
+    }
+    s1 %= BASE;
+    s2 %= BASE;
+  }
+  return (s2 << 16) | s1;
+}
+
+#ifdef ADLER32_X86_SSSE3
+/*
+ * Processes 32-byte blocks: s1 grows by the sum of the bytes, and s2 by 32
+ * times the previous s1 plus the bytes weighted by their distance to the end
+ * of the block.
+ */
+__attribute__((target("ssse3"))) uint32_t adler32_ssse3(
+    uint32_t adler, const unsigned char* input, size_t len) {
+  constexpr size_t BLOCK_SIZE = 32;
+  uint32_t s1 = adler & 0xffff;
+  uint32_t s2 = adler >> 16;
+  size_t blocks = len / BLOCK_SIZE;
+  len -= blocks * BLOCK_SIZE;
+
+  const __m128i tap1 = _mm_setr_epi8(
+      32, 31, 30, 29, 28, 27, 26, 25, 24, 23, 22, 21, 20, 19, 18, 17);
+  const __m128i tap2 =
+      _mm_setr_epi8(16, 15, 14, 13, 12, 11, 10, 9, 8, 7, 6, 5, 4, 3, 2, 1);
+  const __m128i zero = _mm_setzero_si128();
+  const __m128i ones = _mm_set1_epi16(1);
+
+  while (blocks > 0) {
+    size_t n = NMAX / BLOCK_SIZE;
+    if (n > blocks) {
+      n = blocks;
+    }
+    blocks -= n;
+
+    // Sum of s1 at the start of each block, multiplied by 32 below.
+    __m128i v_ps = _mm_set_epi32(0, 0, 0, s1 * n);
+    __m128i v_s2 = _mm_set_epi32(0, 0, 0, s2);
+    __m128i v_s1 = _mm_setzero_si128();
+    for (; n > 0; n--, input += BLOCK_SIZE) {
+      const __m128i bytes1 = _mm_loadu_si128((const __m128i*)input);
+      const __m128i bytes2 = _mm_loadu_si128((const __m128i*)(input + 16));
+      v_ps = _mm_add_epi32(v_ps, v_s1);
+      v_s1 = _mm_add_epi32(v_s1, _mm_sad_epu8(bytes1, zero));
+      v_s2 = _mm_add_epi32(
+          v_s2, _mm_madd_epi16(_mm_maddubs_epi16(bytes1, tap1), ones));
+      v_s1 = _mm_add_epi32(v_s1, _mm_sad_epu8(bytes2, zero));
+      v_s2 = _mm_add_epi32(
+          v_s2, _mm_madd_epi16(_mm_maddubs_epi16(bytes2, tap2), ones));
+    }
+    v_s2 = _mm_add_epi32(v_s2, _mm_slli_epi32(v_ps, 5));
+
+    // Horizontal sums.
+    v_s1 = _mm_add_epi32(v_s1, _mm_shuffle_epi32(v_s1, _MM_SHUFFLE(2, 3, 0, 1)));
+    v_s1 = _mm_add_epi32(v_s1, _mm_shuffle_epi32(v_s1, _MM_SHUFFLE(1, 0, 3, 2)));
+    s1 += _mm_cvtsi128_si32(v_s1);
+    v_s2 = _mm_add_epi32(v_s2, _mm_shuffle_epi32(v_s2, _MM_SHUFFLE(2, 3, 0, 1)));
+    v_s2 = _mm_add_epi32(v_s2, _mm_shuffle_epi32(v_s2, _MM_SHUFFLE(1, 0, 3, 2)));
+    s2 = _mm_cvtsi128_si32(v_s2);
+
+    s1 %= BASE;
+    s2 %= BASE;
+  }
+
+  return adler32_portable((s2 << 16) | s1, input, len);
+}
+
+bool has_ssse3() {
+  unsigned int eax, ebx, ecx, edx;
+  return __get_cpuid(1, &eax, &ebx, &ecx, &edx) && (ecx & bit_SSSE3) != 0;
+}
+#endif
+
+using adler32_fn = uint32_t (*)(uint32_t, const unsigned char*, size_t);
+
+adler32_fn select_adler32() {
+#ifdef ADLER32_X86_SSSE3
+  if (has_ssse3()) {
+    return adler32_ssse3;
+  }
+#endif
+  return adler32_portable;
+}
+
+} // namespace
+
+uint32_t adler32_update(uint32_t adler,
+                        const unsigned char* input,
+                        size_t len) {
+  static const adler32_fn impl = select_adler32();
+  return impl(adler, input, len);
+}
@@ -0,0 +1,22 @@
+/*
+ * Copyright (c) Facebook, Inc. and its affiliates.
+ *
+ * This source code is licensed under the MIT license found in the
+ * LICENSE file in the root directory of this source tree.
+ */
+
+#pragma once
+
+#include <cstddef>
+#include <cstdint>
+
+/*
+ * Initial value of an Adler-32 checksum.
+ */
+constexpr uint32_t ADLER32_INIT = 1;
+
+/*
+ * Continues an Adler-32 checksum with the given bytes. Computes the same
+ * values as zlib's adler32, using SSSE3 when the CPU has it.
+ */
+uint32_t adler32_update(uint32_t adler, const unsigned char* input, size_t len);
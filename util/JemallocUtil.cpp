@@ -9,7 +9,10 @@
 #include <dlfcn.h>
 #endif
 
+#include <cstdint>
+
 #include "Debug.h"
+#include "JemallocUtil.h"
 
 extern "C" {
 
@@ -35,6 +38,11 @@ void set_profile_active(bool active) {
   always_assert_log(err == 0, "mallctl failed with: %d", err);
 }
 
+bool read_size_stat(const char* name, size_t* value) {
+  size_t len = sizeof(*value);
+  return mallctl(name, (void*)value, &len, nullptr, 0) == 0;
+}
+
 } // namespace
 
 namespace jemalloc_util {
@@ -43,4 +51,19 @@ void enable_profiling() { set_profile_active(true); }
 
 void disable_profiling() { set_profile_active(false); }
 
+bool get_stats(Stats* stats) {
+  if (mallctl == nullptr) {
+    return false;
+  }
+  // Statistics are cached by jemalloc, and only refreshed when advancing the
+  // epoch.
+  uint64_t epoch = 1;
+  size_t len = sizeof(epoch);
+  if (mallctl("epoch", (void*)&epoch, &len, (void*)&epoch, len) != 0) {
+    return false;
+  }
+  return read_size_stat("stats.allocated", &stats->allocated) &&
+         read_size_stat("stats.active", &stats->active);
+}
+
 } // namespace jemalloc_util
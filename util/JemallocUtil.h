@@ -5,6 +5,7 @@
  * LICENSE file in the root directory of this source tree.
  */
 
+#include <cstddef>
 #include <cstdio>
 
 namespace jemalloc_util {
@@ -13,6 +14,16 @@ void enable_profiling();
 
 void disable_profiling();
 
+struct Stats {
+  // Bytes allocated by the application.
+  size_t allocated{0};
+  // Bytes in active pages allocated by the application.
+  size_t active{0};
+};
+
+// Returns false if jemalloc is not the allocator.
+bool get_stats(Stats* stats);
+
 class ScopedProfiling final {
  public:
   explicit ScopedProfiling(bool enable) {
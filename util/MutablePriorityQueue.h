@@ -7,63 +7,137 @@
 
 #pragma once
 
+#include <algorithm>
 #include <functional>
-#include <map>
 #include <unordered_map>
+#include <utility>
+#include <vector>
 
 /*
  * Collection type that maintains a set of elements with associated
  * priorities, allowing updating priorities, and enabling efficient
  * retrieval of the element with the highest priority.
  *
+ * The elements are kept in a 4-ary max-heap stored in a vector, along with
+ * the index of each value in the heap, so inserting, erasing and updating are
+ * O(log n) without allocating a node per element, and front() is O(1).
+ *
  * Limitations:
  * - The same value cannot be present twice (even with a different priority)
  * - No two values can exist in the queue with the same priority at the same
- *   time
+ *   time; otherwise, which of them front() returns is unspecified
  */
 template <class Value,
           class Priority,
           class PriorityCompare = std::less<Priority>>
 class MutablePriorityQueue {
  private:
-  std::map<Priority, Value, PriorityCompare> m_values;
-  std::unordered_map<Value, Priority> m_priorities;
+  static constexpr size_t ARITY = 4;
+
+  std::vector<std::pair<Priority, Value>> m_heap;
+  std::unordered_map<Value, size_t> m_indices;
+  PriorityCompare m_compare;
+
+  bool higher(size_t i, size_t j) const {
+    return m_compare(m_heap[j].first, m_heap[i].first);
+  }
+
+  void swap_entries(size_t i, size_t j) {
+    std::swap(m_heap[i], m_heap[j]);
+    m_indices[m_heap[i].second] = i;
+    m_indices[m_heap[j].second] = j;
+  }
+
+  // Moves the entry at i up until its parent has a higher priority, and
+  // returns where it ended up.
+  size_t sift_up(size_t i) {
+    while (i > 0) {
+      auto parent = (i - 1) / ARITY;
+      if (!higher(i, parent)) {
+        break;
+      }
+      swap_entries(i, parent);
+      i = parent;
+    }
+    return i;
+  }
+
+  // Moves the entry at i down until none of its children has a higher
+  // priority.
+  void sift_down(size_t i) {
+    while (true) {
+      auto first_child = i * ARITY + 1;
+      if (first_child >= m_heap.size()) {
+        return;
+      }
+      auto last_child = std::min(first_child + ARITY, m_heap.size());
+      auto highest = i;
+      for (auto child = first_child; child < last_child; ++child) {
+        if (higher(child, highest)) {
+          highest = child;
+        }
+      }
+      if (highest == i) {
+        return;
+      }
+      swap_entries(i, highest);
+      i = highest;
+    }
+  }
+
+  // Restores the heap after the priority of the entry at i changed.
+  void sift(size_t i) {
+    if (sift_up(i) == i) {
+      sift_down(i);
+    }
+  }
 
  public:
   // Inserts a value with a priority; neither value or priority can already be
   // present.
   void insert(const Value& value, const Priority& priority) {
-    auto map_result = m_values.insert({priority, value});
-    always_assert(map_result.second);
-    auto priorities_result = m_priorities.insert({value, priority});
-    always_assert(priorities_result.second);
+    auto indices_result = m_indices.emplace(value, m_heap.size());
+    always_assert(indices_result.second);
+    m_heap.emplace_back(priority, value);
+    sift_up(m_heap.size() - 1);
   }
 
   // Erases a value that's currently in the queue.
   void erase(const Value& value) {
-    auto old_priority_it = m_priorities.find(value);
-    always_assert(old_priority_it != m_priorities.end());
-    const auto erased = m_values.erase(old_priority_it->second);
-    always_assert(erased);
-    m_priorities.erase(old_priority_it);
+    auto it = m_indices.find(value);
+    always_assert(it != m_indices.end());
+    auto i = it->second;
+    m_indices.erase(it);
+    auto last = m_heap.size() - 1;
+    if (i != last) {
+      m_heap[i] = std::move(m_heap[last]);
+      m_indices[m_heap[i].second] = i;
+      m_heap.pop_back();
+      sift(i);
+    } else {
+      m_heap.pop_back();
+    }
   }
 
   // Changes the priority of a value. The value must already be in the queue.
   // No current queue element may already have the new priority.
   void update_priority(const Value& value, const Priority& priority) {
-    erase(value);
-    insert(value, priority);
+    auto it = m_indices.find(value);
+    always_assert(it != m_indices.end());
+    auto i = it->second;
+    m_heap[i].first = priority;
+    sift(i);
   }
 
   // Removes all elements.
   void clear() {
-    m_values.clear();
-    m_priorities.clear();
+    m_heap.clear();
+    m_indices.clear();
   }
 
   // Checks if queue is empty.
-  bool empty() const { return m_values.empty(); }
+  bool empty() const { return m_heap.empty(); }
 
   // Returns element with highest priority.
-  Value front() const { return m_values.rbegin()->second; }
+  Value front() const { return m_heap.front().second; }
 };
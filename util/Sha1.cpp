@@ -12,8 +12,27 @@
 
 #include "Sha1.h"
 
+#include <cstddef>
 #include <cstring>
 
+#if (defined(__x86_64__) || defined(__i386__)) && defined(__GNUC__)
+#define SHA1_X86_SHA_NI 1
+#include <cpuid.h>
+#include <immintrin.h>
+#elif defined(__aarch64__) && defined(__linux__) && defined(__GNUC__)
+#define SHA1_ARMV8_CRYPTO 1
+#include <arm_neon.h>
+#include <sys/auxv.h>
+#ifndef HWCAP_SHA1
+#define HWCAP_SHA1 (1 << 5)
+#endif
+#ifdef __clang__
+#define SHA1_ARMV8_CRYPTO_TARGET "crypto"
+#else
+#define SHA1_ARMV8_CRYPTO_TARGET "+crypto"
+#endif
+#endif
+
 static const unsigned char PADDING[128] = {
     0x80, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0,
     0,    0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0,
@@ -206,6 +225,413 @@ static void sha1_transform(unsigned int state[5],
   memset((unsigned char*)x, 0, sizeof(x));
 }
 
+using sha1_transform_blocks_fn = void (*)(unsigned int state[5],
+                                          const unsigned char* input,
+                                          size_t num_blocks);
+
+static void sha1_transform_blocks_portable(unsigned int state[5],
+                                           const unsigned char* input,
+                                           size_t num_blocks) {
+  for (size_t i = 0; i < num_blocks; i++, input += 64) {
+    sha1_transform(state, input);
+  }
+}
+
+#ifdef SHA1_X86_SHA_NI
+/*
+ * SHA1 transformation of consecutive blocks using the Intel SHA extensions.
+ * Each sha1rnds4 performs four rounds; the message schedule is computed four
+ * words at a time with sha1msg1/sha1msg2.
+ */
+__attribute__((target("sha,sse4.1"))) static void
+sha1_transform_blocks_sha_ni(unsigned int state[5],
+                             const unsigned char* input,
+                             size_t num_blocks) {
+  const __m128i mask =
+      _mm_set_epi64x(0x0001020304050607ULL, 0x08090a0b0c0d0e0fULL);
+  __m128i abcd = _mm_loadu_si128((const __m128i*)state);
+  __m128i e0 = _mm_set_epi32(state[4], 0, 0, 0);
+  abcd = _mm_shuffle_epi32(abcd, 0x1B);
+
+  for (; num_blocks > 0; num_blocks--, input += 64) {
+    __m128i abcd_save = abcd;
+    __m128i e0_save = e0;
+    __m128i e1;
+    __m128i msg[4];
+
+    /* Rounds 0-3 */
+    msg[0] = _mm_shuffle_epi8(
+        _mm_loadu_si128((const __m128i*)(input + 0)), mask);
+    e0 = _mm_add_epi32(e0, msg[0]);
+    e1 = abcd;
+    abcd = _mm_sha1rnds4_epu32(abcd, e0, 0);
+
+    /* Rounds 4-7 */
+    msg[1] = _mm_shuffle_epi8(
+        _mm_loadu_si128((const __m128i*)(input + 16)), mask);
+    e1 = _mm_sha1nexte_epu32(e1, msg[1]);
+    e0 = abcd;
+    abcd = _mm_sha1rnds4_epu32(abcd, e1, 0);
+    msg[0] = _mm_sha1msg1_epu32(msg[0], msg[1]);
+
+    /* Rounds 8-11 */
+    msg[2] = _mm_shuffle_epi8(
+        _mm_loadu_si128((const __m128i*)(input + 32)), mask);
+    e0 = _mm_sha1nexte_epu32(e0, msg[2]);
+    e1 = abcd;
+    abcd = _mm_sha1rnds4_epu32(abcd, e0, 0);
+    msg[1] = _mm_sha1msg1_epu32(msg[1], msg[2]);
+    msg[0] = _mm_xor_si128(msg[0], msg[2]);
+
+    /* Rounds 12-15 */
+    msg[3] = _mm_shuffle_epi8(
+        _mm_loadu_si128((const __m128i*)(input + 48)), mask);
+    e1 = _mm_sha1nexte_epu32(e1, msg[3]);
+    e0 = abcd;
+    msg[0] = _mm_sha1msg2_epu32(msg[0], msg[3]);
+    abcd = _mm_sha1rnds4_epu32(abcd, e1, 0);
+    msg[2] = _mm_sha1msg1_epu32(msg[2], msg[3]);
+    msg[1] = _mm_xor_si128(msg[1], msg[3]);
+
+    /* Rounds 16-19 */
+    e0 = _mm_sha1nexte_epu32(e0, msg[0]);
+    e1 = abcd;
+    msg[1] = _mm_sha1msg2_epu32(msg[1], msg[0]);
+    abcd = _mm_sha1rnds4_epu32(abcd, e0, 0);
+    msg[3] = _mm_sha1msg1_epu32(msg[3], msg[0]);
+    msg[2] = _mm_xor_si128(msg[2], msg[0]);
+
+    /* Rounds 20-23 */
+    e1 = _mm_sha1nexte_epu32(e1, msg[1]);
+    e0 = abcd;
+    msg[2] = _mm_sha1msg2_epu32(msg[2], msg[1]);
+    abcd = _mm_sha1rnds4_epu32(abcd, e1, 1);
+    msg[0] = _mm_sha1msg1_epu32(msg[0], msg[1]);
+    msg[3] = _mm_xor_si128(msg[3], msg[1]);
+
+    /* Rounds 24-27 */
+    e0 = _mm_sha1nexte_epu32(e0, msg[2]);
+    e1 = abcd;
+    msg[3] = _mm_sha1msg2_epu32(msg[3], msg[2]);
+    abcd = _mm_sha1rnds4_epu32(abcd, e0, 1);
+    msg[1] = _mm_sha1msg1_epu32(msg[1], msg[2]);
+    msg[0] = _mm_xor_si128(msg[0], msg[2]);
+
+    /* Rounds 28-31 */
+    e1 = _mm_sha1nexte_epu32(e1, msg[3]);
+    e0 = abcd;
+    msg[0] = _mm_sha1msg2_epu32(msg[0], msg[3]);
+    abcd = _mm_sha1rnds4_epu32(abcd, e1, 1);
+    msg[2] = _mm_sha1msg1_epu32(msg[2], msg[3]);
+    msg[1] = _mm_xor_si128(msg[1], msg[3]);
+
+    /* Rounds 32-35 */
+    e0 = _mm_sha1nexte_epu32(e0, msg[0]);
+    e1 = abcd;
+    msg[1] = _mm_sha1msg2_epu32(msg[1], msg[0]);
+    abcd = _mm_sha1rnds4_epu32(abcd, e0, 1);
+    msg[3] = _mm_sha1msg1_epu32(msg[3], msg[0]);
+    msg[2] = _mm_xor_si128(msg[2], msg[0]);
+
+    /* Rounds 36-39 */
+    e1 = _mm_sha1nexte_epu32(e1, msg[1]);
+    e0 = abcd;
+    msg[2] = _mm_sha1msg2_epu32(msg[2], msg[1]);
+    abcd = _mm_sha1rnds4_epu32(abcd, e1, 1);
+    msg[0] = _mm_sha1msg1_epu32(msg[0], msg[1]);
+    msg[3] = _mm_xor_si128(msg[3], msg[1]);
+
+    /* Rounds 40-43 */
+    e0 = _mm_sha1nexte_epu32(e0, msg[2]);
+    e1 = abcd;
+    msg[3] = _mm_sha1msg2_epu32(msg[3], msg[2]);
+    abcd = _mm_sha1rnds4_epu32(abcd, e0, 2);
+    msg[1] = _mm_sha1msg1_epu32(msg[1], msg[2]);
+    msg[0] = _mm_xor_si128(msg[0], msg[2]);
+
+    /* Rounds 44-47 */
+    e1 = _mm_sha1nexte_epu32(e1, msg[3]);
+    e0 = abcd;
+    msg[0] = _mm_sha1msg2_epu32(msg[0], msg[3]);
+    abcd = _mm_sha1rnds4_epu32(abcd, e1, 2);
+    msg[2] = _mm_sha1msg1_epu32(msg[2], msg[3]);
+    msg[1] = _mm_xor_si128(msg[1], msg[3]);
+
+    /* Rounds 48-51 */
+    e0 = _mm_sha1nexte_epu32(e0, msg[0]);
+    e1 = abcd;
+    msg[1] = _mm_sha1msg2_epu32(msg[1], msg[0]);
+    abcd = _mm_sha1rnds4_epu32(abcd, e0, 2);
+    msg[3] = _mm_sha1msg1_epu32(msg[3], msg[0]);
+    msg[2] = _mm_xor_si128(msg[2], msg[0]);
+
+    /* Rounds 52-55 */
+    e1 = _mm_sha1nexte_epu32(e1, msg[1]);
+    e0 = abcd;
+    msg[2] = _mm_sha1msg2_epu32(msg[2], msg[1]);
+    abcd = _mm_sha1rnds4_epu32(abcd, e1, 2);
+    msg[0] = _mm_sha1msg1_epu32(msg[0], msg[1]);
+    msg[3] = _mm_xor_si128(msg[3], msg[1]);
+
+    /* Rounds 56-59 */
+    e0 = _mm_sha1nexte_epu32(e0, msg[2]);
+    e1 = abcd;
+    msg[3] = _mm_sha1msg2_epu32(msg[3], msg[2]);
+    abcd = _mm_sha1rnds4_epu32(abcd, e0, 2);
+    msg[1] = _mm_sha1msg1_epu32(msg[1], msg[2]);
+    msg[0] = _mm_xor_si128(msg[0], msg[2]);
+
+    /* Rounds 60-63 */
+    e1 = _mm_sha1nexte_epu32(e1, msg[3]);
+    e0 = abcd;
+    msg[0] = _mm_sha1msg2_epu32(msg[0], msg[3]);
+    abcd = _mm_sha1rnds4_epu32(abcd, e1, 3);
+    msg[2] = _mm_sha1msg1_epu32(msg[2], msg[3]);
+    msg[1] = _mm_xor_si128(msg[1], msg[3]);
+
+    /* Rounds 64-67 */
+    e0 = _mm_sha1nexte_epu32(e0, msg[0]);
+    e1 = abcd;
+    msg[1] = _mm_sha1msg2_epu32(msg[1], msg[0]);
+    abcd = _mm_sha1rnds4_epu32(abcd, e0, 3);
+    msg[3] = _mm_sha1msg1_epu32(msg[3], msg[0]);
+    msg[2] = _mm_xor_si128(msg[2], msg[0]);
+
+    /* Rounds 68-71 */
+    e1 = _mm_sha1nexte_epu32(e1, msg[1]);
+    e0 = abcd;
+    msg[2] = _mm_sha1msg2_epu32(msg[2], msg[1]);
+    abcd = _mm_sha1rnds4_epu32(abcd, e1, 3);
+    msg[3] = _mm_xor_si128(msg[3], msg[1]);
+
+    /* Rounds 72-75 */
+    e0 = _mm_sha1nexte_epu32(e0, msg[2]);
+    e1 = abcd;
+    msg[3] = _mm_sha1msg2_epu32(msg[3], msg[2]);
+    abcd = _mm_sha1rnds4_epu32(abcd, e0, 3);
+
+    /* Rounds 76-79 */
+    e1 = _mm_sha1nexte_epu32(e1, msg[3]);
+    e0 = abcd;
+    abcd = _mm_sha1rnds4_epu32(abcd, e1, 3);
+
+    /* Combine state */
+    e0 = _mm_sha1nexte_epu32(e0, e0_save);
+    abcd = _mm_add_epi32(abcd, abcd_save);
+  }
+
+  abcd = _mm_shuffle_epi32(abcd, 0x1B);
+  _mm_storeu_si128((__m128i*)state, abcd);
+  state[4] = _mm_extract_epi32(e0, 3);
+}
+
+static bool has_sha_ni() {
+  unsigned int eax, ebx, ecx, edx;
+  if (!__get_cpuid(1, &eax, &ebx, &ecx, &edx)) {
+    return false;
+  }
+  bool has_sse41 = (ecx & bit_SSE4_1) != 0;
+  bool has_ssse3 = (ecx & bit_SSSE3) != 0;
+  if (!__get_cpuid_count(7, 0, &eax, &ebx, &ecx, &edx)) {
+    return false;
+  }
+  bool has_sha = (ebx & (1 << 29)) != 0;
+  return has_sse41 && has_ssse3 && has_sha;
+}
+#endif
+
+#ifdef SHA1_ARMV8_CRYPTO
+/*
+ * SHA1 transformation of consecutive blocks using the ARMv8 cryptography
+ * extensions. Each sha1c/sha1p/sha1m performs four rounds; the message schedule
+ * is computed four words at a time with sha1su0/sha1su1.
+ */
+__attribute__((target(SHA1_ARMV8_CRYPTO_TARGET))) static void
+sha1_transform_blocks_armv8(unsigned int state[5],
+                            const unsigned char* input,
+                            size_t num_blocks) {
+  static const uint32_t K[4] = {0x5A827999, 0x6ED9EBA1, 0x8F1BBCDC,
+                                0xCA62C1D6};
+  uint32x4_t abcd = vld1q_u32(&state[0]);
+  uint32_t e0 = state[4];
+
+  for (; num_blocks > 0; num_blocks--, input += 64) {
+    uint32x4_t abcd_save = abcd;
+    uint32_t e0_save = e0;
+    uint32_t e1;
+    uint32x4_t msg[4];
+    uint32x4_t tmp[2];
+
+    for (int i = 0; i < 4; i++) {
+      msg[i] = vreinterpretq_u32_u8(vrev32q_u8(vld1q_u8(input + 16 * i)));
+    }
+    tmp[0] = vaddq_u32(msg[0], vdupq_n_u32(K[0]));
+    tmp[1] = vaddq_u32(msg[1], vdupq_n_u32(K[0]));
+
+    /* Rounds 0-3 */
+    e1 = vsha1h_u32(vgetq_lane_u32(abcd, 0));
+    abcd = vsha1cq_u32(abcd, e0, tmp[0]);
+    tmp[0] = vaddq_u32(msg[2], vdupq_n_u32(K[0]));
+    msg[0] = vsha1su0q_u32(msg[0], msg[1], msg[2]);
+
+    /* Rounds 4-7 */
+    e0 = vsha1h_u32(vgetq_lane_u32(abcd, 0));
+    abcd = vsha1cq_u32(abcd, e1, tmp[1]);
+    tmp[1] = vaddq_u32(msg[3], vdupq_n_u32(K[0]));
+    msg[0] = vsha1su1q_u32(msg[0], msg[3]);
+    msg[1] = vsha1su0q_u32(msg[1], msg[2], msg[3]);
+
+    /* Rounds 8-11 */
+    e1 = vsha1h_u32(vgetq_lane_u32(abcd, 0));
+    abcd = vsha1cq_u32(abcd, e0, tmp[0]);
+    tmp[0] = vaddq_u32(msg[0], vdupq_n_u32(K[0]));
+    msg[1] = vsha1su1q_u32(msg[1], msg[0]);
+    msg[2] = vsha1su0q_u32(msg[2], msg[3], msg[0]);
+
+    /* Rounds 12-15 */
+    e0 = vsha1h_u32(vgetq_lane_u32(abcd, 0));
+    abcd = vsha1cq_u32(abcd, e1, tmp[1]);
+    tmp[1] = vaddq_u32(msg[1], vdupq_n_u32(K[1]));
+    msg[2] = vsha1su1q_u32(msg[2], msg[1]);
+    msg[3] = vsha1su0q_u32(msg[3], msg[0], msg[1]);
+
+    /* Rounds 16-19 */
+    e1 = vsha1h_u32(vgetq_lane_u32(abcd, 0));
+    abcd = vsha1cq_u32(abcd, e0, tmp[0]);
+    tmp[0] = vaddq_u32(msg[2], vdupq_n_u32(K[1]));
+    msg[3] = vsha1su1q_u32(msg[3], msg[2]);
+    msg[0] = vsha1su0q_u32(msg[0], msg[1], msg[2]);
+
+    /* Rounds 20-23 */
+    e0 = vsha1h_u32(vgetq_lane_u32(abcd, 0));
+    abcd = vsha1pq_u32(abcd, e1, tmp[1]);
+    tmp[1] = vaddq_u32(msg[3], vdupq_n_u32(K[1]));
+    msg[0] = vsha1su1q_u32(msg[0], msg[3]);
+    msg[1] = vsha1su0q_u32(msg[1], msg[2], msg[3]);
+
+    /* Rounds 24-27 */
+    e1 = vsha1h_u32(vgetq_lane_u32(abcd, 0));
+    abcd = vsha1pq_u32(abcd, e0, tmp[0]);
+    tmp[0] = vaddq_u32(msg[0], vdupq_n_u32(K[1]));
+    msg[1] = vsha1su1q_u32(msg[1], msg[0]);
+    msg[2] = vsha1su0q_u32(msg[2], msg[3], msg[0]);
+
+    /* Rounds 28-31 */
+    e0 = vsha1h_u32(vgetq_lane_u32(abcd, 0));
+    abcd = vsha1pq_u32(abcd, e1, tmp[1]);
+    tmp[1] = vaddq_u32(msg[1], vdupq_n_u32(K[1]));
+    msg[2] = vsha1su1q_u32(msg[2], msg[1]);
+    msg[3] = vsha1su0q_u32(msg[3], msg[0], msg[1]);
+
+    /* Rounds 32-35 */
+    e1 = vsha1h_u32(vgetq_lane_u32(abcd, 0));
+    abcd = vsha1pq_u32(abcd, e0, tmp[0]);
+    tmp[0] = vaddq_u32(msg[2], vdupq_n_u32(K[2]));
+    msg[3] = vsha1su1q_u32(msg[3], msg[2]);
+    msg[0] = vsha1su0q_u32(msg[0], msg[1], msg[2]);
+
+    /* Rounds 36-39 */
+    e0 = vsha1h_u32(vgetq_lane_u32(abcd, 0));
+    abcd = vsha1pq_u32(abcd, e1, tmp[1]);
+    tmp[1] = vaddq_u32(msg[3], vdupq_n_u32(K[2]));
+    msg[0] = vsha1su1q_u32(msg[0], msg[3]);
+    msg[1] = vsha1su0q_u32(msg[1], msg[2], msg[3]);
+
+    /* Rounds 40-43 */
+    e1 = vsha1h_u32(vgetq_lane_u32(abcd, 0));
+    abcd = vsha1mq_u32(abcd, e0, tmp[0]);
+    tmp[0] = vaddq_u32(msg[0], vdupq_n_u32(K[2]));
+    msg[1] = vsha1su1q_u32(msg[1], msg[0]);
+    msg[2] = vsha1su0q_u32(msg[2], msg[3], msg[0]);
+
+    /* Rounds 44-47 */
+    e0 = vsha1h_u32(vgetq_lane_u32(abcd, 0));
+    abcd = vsha1mq_u32(abcd, e1, tmp[1]);
+    tmp[1] = vaddq_u32(msg[1], vdupq_n_u32(K[2]));
+    msg[2] = vsha1su1q_u32(msg[2], msg[1]);
+    msg[3] = vsha1su0q_u32(msg[3], msg[0], msg[1]);
+
+    /* Rounds 48-51 */
+    e1 = vsha1h_u32(vgetq_lane_u32(abcd, 0));
+    abcd = vsha1mq_u32(abcd, e0, tmp[0]);
+    tmp[0] = vaddq_u32(msg[2], vdupq_n_u32(K[2]));
+    msg[3] = vsha1su1q_u32(msg[3], msg[2]);
+    msg[0] = vsha1su0q_u32(msg[0], msg[1], msg[2]);
+
+    /* Rounds 52-55 */
+    e0 = vsha1h_u32(vgetq_lane_u32(abcd, 0));
+    abcd = vsha1mq_u32(abcd, e1, tmp[1]);
+    tmp[1] = vaddq_u32(msg[3], vdupq_n_u32(K[3]));
+    msg[0] = vsha1su1q_u32(msg[0], msg[3]);
+    msg[1] = vsha1su0q_u32(msg[1], msg[2], msg[3]);
+
+    /* Rounds 56-59 */
+    e1 = vsha1h_u32(vgetq_lane_u32(abcd, 0));
+    abcd = vsha1mq_u32(abcd, e0, tmp[0]);
+    tmp[0] = vaddq_u32(msg[0], vdupq_n_u32(K[3]));
+    msg[1] = vsha1su1q_u32(msg[1], msg[0]);
+    msg[2] = vsha1su0q_u32(msg[2], msg[3], msg[0]);
+
+    /* Rounds 60-63 */
+    e0 = vsha1h_u32(vgetq_lane_u32(abcd, 0));
+    abcd = vsha1pq_u32(abcd, e1, tmp[1]);
+    tmp[1] = vaddq_u32(msg[1], vdupq_n_u32(K[3]));
+    msg[2] = vsha1su1q_u32(msg[2], msg[1]);
+    msg[3] = vsha1su0q_u32(msg[3], msg[0], msg[1]);
+
+    /* Rounds 64-67 */
+    e1 = vsha1h_u32(vgetq_lane_u32(abcd, 0));
+    abcd = vsha1pq_u32(abcd, e0, tmp[0]);
+    tmp[0] = vaddq_u32(msg[2], vdupq_n_u32(K[3]));
+    msg[3] = vsha1su1q_u32(msg[3], msg[2]);
+
+    /* Rounds 68-71 */
+    e0 = vsha1h_u32(vgetq_lane_u32(abcd, 0));
+    abcd = vsha1pq_u32(abcd, e1, tmp[1]);
+    tmp[1] = vaddq_u32(msg[3], vdupq_n_u32(K[3]));
+
+    /* Rounds 72-75 */
+    e1 = vsha1h_u32(vgetq_lane_u32(abcd, 0));
+    abcd = vsha1pq_u32(abcd, e0, tmp[0]);
+
+    /* Rounds 76-79 */
+    e0 = vsha1h_u32(vgetq_lane_u32(abcd, 0));
+    abcd = vsha1pq_u32(abcd, e1, tmp[1]);
+
+    /* Combine state */
+    e0 += e0_save;
+    abcd = vaddq_u32(abcd_save, abcd);
+  }
+
+  vst1q_u32(&state[0], abcd);
+  state[4] = e0;
+}
+#endif
+
+/*
+ * Picks the fastest implementation the CPU we're running on supports.
+ */
+static sha1_transform_blocks_fn select_sha1_transform_blocks() {
+#ifdef SHA1_X86_SHA_NI
+  if (has_sha_ni()) {
+    return sha1_transform_blocks_sha_ni;
+  }
+#endif
+#ifdef SHA1_ARMV8_CRYPTO
+  if (getauxval(AT_HWCAP) & HWCAP_SHA1) {
+    return sha1_transform_blocks_armv8;
+  }
+#endif
+  return sha1_transform_blocks_portable;
+}
+
+static void sha1_transform_blocks(unsigned int state[5],
+                                  const unsigned char* input,
+                                  size_t num_blocks) {
+  static const sha1_transform_blocks_fn impl = select_sha1_transform_blocks();
+  impl(state, input, num_blocks);
+}
+
 /*
  * SHA1 initialization. Begins an SHA1 operation, writing a new context.
  */
@@ -245,10 +671,11 @@ void sha1_update(Sha1Context* context,
   if (inputLen >= partLen) {
     memcpy((unsigned char*)&context->buffer[index], (unsigned char*)input,
            partLen);
-    sha1_transform(context->state, context->buffer);
+    sha1_transform_blocks(context->state, context->buffer, 1);
 
-    for (i = partLen; i + 63 < inputLen; i += 64)
-      sha1_transform(context->state, &input[i]);
+    sha1_transform_blocks(
+        context->state, &input[partLen], (inputLen - partLen) / 64);
+    i = partLen + (inputLen - partLen) / 64 * 64;
 
     index = 0;
   } else
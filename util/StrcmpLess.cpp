@@ -0,0 +1,204 @@
+/*
+ * Copyright (c) Facebook, Inc. and its affiliates.
+ *
+ * This source code is licensed under the MIT license found in the
+ * LICENSE file in the root directory of this source tree.
+ */
+
+#include "StrcmpLess.h"
+
+#include <cstdint>
+#include <cstring>
+#include <stdexcept>
+
+#if (defined(__x86_64__) || defined(__i386__)) && defined(__GNUC__)
+#define STRCMP_LESS_X86 1
+#include <immintrin.h>
+#endif
+
+#if defined(__aarch64__) && defined(__ARM_NEON)
+#define STRCMP_LESS_NEON 1
+#include <arm_neon.h>
+#endif
+
+// The vector variants may read past the terminator of a string, though never
+// into the next page. That is fine for the hardware, but not for ASan.
+#if defined(__GNUC__)
+#define STRCMP_LESS_NO_ASAN __attribute__((no_sanitize_address))
+#else
+#define STRCMP_LESS_NO_ASAN
+#endif
+
+namespace {
+
+constexpr uintptr_t kPageSize = 4096;
+
+// Whether a block load at p stays within the page that contains p.
+template <size_t kBlockSize>
+inline bool block_fits_in_page(const char* p) {
+  return (reinterpret_cast<uintptr_t>(p) & (kPageSize - 1)) <=
+         kPageSize - kBlockSize;
+}
+
+// strcmp compares the bytes as unsigned char.
+inline bool less_at(const char* str1, const char* str2, size_t i) {
+  return static_cast<unsigned char>(str1[i]) <
+         static_cast<unsigned char>(str2[i]);
+}
+
+// Whether the comparison is decided at byte i, i.e. the strings differ there
+// or both end there.
+inline bool stops_at(const char* str1, const char* str2, size_t i) {
+  return str1[i] != str2[i] || str1[i] == '\0';
+}
+
+bool strcmp_less_portable(const char* str1, const char* str2) {
+  return strcmp(str1, str2) < 0;
+}
+
+#ifdef STRCMP_LESS_X86
+__attribute__((target("sse4.2"))) STRCMP_LESS_NO_ASAN bool strcmp_less_sse42(
+    const char* str1, const char* str2) {
+  constexpr size_t kBlockSize = 16;
+  // Finds the first index at which the bytes differ or exactly one of the
+  // strings has ended.
+  constexpr int kMode = _SIDD_UBYTE_OPS | _SIDD_CMP_EQUAL_EACH |
+                        _SIDD_NEGATIVE_POLARITY | _SIDD_LEAST_SIGNIFICANT;
+  size_t i = 0;
+  while (true) {
+    if (block_fits_in_page<kBlockSize>(str1 + i) &&
+        block_fits_in_page<kBlockSize>(str2 + i)) {
+      __m128i v1 = _mm_loadu_si128(reinterpret_cast<const __m128i*>(str1 + i));
+      __m128i v2 = _mm_loadu_si128(reinterpret_cast<const __m128i*>(str2 + i));
+      int idx = _mm_cmpistri(v1, v2, kMode);
+      if (idx < static_cast<int>(kBlockSize)) {
+        return less_at(str1, str2, i + idx);
+      }
+      if (_mm_cmpistrz(v1, v2, kMode)) {
+        // Both strings ended within the block, and are equal.
+        return false;
+      }
+      i += kBlockSize;
+    } else {
+      if (stops_at(str1, str2, i)) {
+        return less_at(str1, str2, i);
+      }
+      ++i;
+    }
+  }
+}
+
+__attribute__((target("avx2"))) STRCMP_LESS_NO_ASAN bool strcmp_less_avx2(
+    const char* str1, const char* str2) {
+  constexpr size_t kBlockSize = 32;
+  const __m256i zero = _mm256_setzero_si256();
+  size_t i = 0;
+  while (true) {
+    if (block_fits_in_page<kBlockSize>(str1 + i) &&
+        block_fits_in_page<kBlockSize>(str2 + i)) {
+      __m256i v1 =
+          _mm256_loadu_si256(reinterpret_cast<const __m256i*>(str1 + i));
+      __m256i v2 =
+          _mm256_loadu_si256(reinterpret_cast<const __m256i*>(str2 + i));
+      auto equal =
+          static_cast<uint32_t>(_mm256_movemask_epi8(_mm256_cmpeq_epi8(v1, v2)));
+      auto nul = static_cast<uint32_t>(
+          _mm256_movemask_epi8(_mm256_cmpeq_epi8(v1, zero)));
+      uint32_t stops = ~equal | nul;
+      if (stops != 0) {
+        return less_at(str1, str2, i + __builtin_ctz(stops));
+      }
+      i += kBlockSize;
+    } else {
+      if (stops_at(str1, str2, i)) {
+        return less_at(str1, str2, i);
+      }
+      ++i;
+    }
+  }
+}
+#endif
+
+#ifdef STRCMP_LESS_NEON
+STRCMP_LESS_NO_ASAN bool strcmp_less_neon(const char* str1, const char* str2) {
+  constexpr size_t kBlockSize = 16;
+  size_t i = 0;
+  while (true) {
+    if (block_fits_in_page<kBlockSize>(str1 + i) &&
+        block_fits_in_page<kBlockSize>(str2 + i)) {
+      uint8x16_t v1 = vld1q_u8(reinterpret_cast<const uint8_t*>(str1 + i));
+      uint8x16_t v2 = vld1q_u8(reinterpret_cast<const uint8_t*>(str2 + i));
+      uint8x16_t stops = vorrq_u8(vmvnq_u8(vceqq_u8(v1, v2)), vceqzq_u8(v1));
+      // There is no movemask; narrowing each byte of the mask to a nibble
+      // gives us a 64-bit value to count trailing zeros in.
+      uint64_t bits = vget_lane_u64(
+          vreinterpret_u64_u8(vshrn_n_u16(vreinterpretq_u16_u8(stops), 4)), 0);
+      if (bits != 0) {
+        return less_at(str1, str2, i + (__builtin_ctzll(bits) >> 2));
+      }
+      i += kBlockSize;
+    } else {
+      if (stops_at(str1, str2, i)) {
+        return less_at(str1, str2, i);
+      }
+      ++i;
+    }
+  }
+}
+#endif
+
+strcmp_less_fn select_strcmp_less() {
+  for (auto variant : {StrcmpLessVariant::AVX2, StrcmpLessVariant::SSE42,
+                       StrcmpLessVariant::NEON}) {
+    if (strcmp_less_supported(variant)) {
+      return get_strcmp_less(variant);
+    }
+  }
+  return strcmp_less_portable;
+}
+
+} // namespace
+
+bool strcmp_less_supported(StrcmpLessVariant variant) {
+  switch (variant) {
+  case StrcmpLessVariant::Portable:
+    return true;
+#ifdef STRCMP_LESS_X86
+  case StrcmpLessVariant::SSE42:
+    return __builtin_cpu_supports("sse4.2");
+  case StrcmpLessVariant::AVX2:
+    return __builtin_cpu_supports("avx2");
+#endif
+#ifdef STRCMP_LESS_NEON
+  case StrcmpLessVariant::NEON:
+    // Advanced SIMD is mandatory on AArch64.
+    return true;
+#endif
+  default:
+    return false;
+  }
+}
+
+strcmp_less_fn get_strcmp_less(StrcmpLessVariant variant) {
+  switch (variant) {
+  case StrcmpLessVariant::Portable:
+    return strcmp_less_portable;
+#ifdef STRCMP_LESS_X86
+  case StrcmpLessVariant::SSE42:
+    return strcmp_less_sse42;
+  case StrcmpLessVariant::AVX2:
+    return strcmp_less_avx2;
+#endif
+#ifdef STRCMP_LESS_NEON
+  case StrcmpLessVariant::NEON:
+    return strcmp_less_neon;
+#endif
+  default:
+    throw std::invalid_argument("strcmp_less variant not compiled in");
+  }
+}
+
+bool strcmp_less(const char* str1, const char* str2) {
+  static const strcmp_less_fn impl = select_strcmp_less();
+  return impl(str1, str2);
+}
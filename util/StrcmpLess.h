@@ -0,0 +1,38 @@
+/*
+ * Copyright (c) Facebook, Inc. and its affiliates.
+ *
+ * This source code is licensed under the MIT license found in the
+ * LICENSE file in the root directory of this source tree.
+ */
+
+#pragma once
+
+/*
+ * Returns whether str1 < str2, i.e. strcmp(str1, str2) < 0. Uses the widest
+ * vector unit the CPU offers among AVX2, SSE4.2 and NEON.
+ *
+ * The vector implementations compare a block at a time, but never load a
+ * block that crosses into the page after the one holding the current byte,
+ * so they cannot fault on strings at the very end of a mapping.
+ */
+bool strcmp_less(const char* str1, const char* str2);
+
+enum class StrcmpLessVariant {
+  Portable,
+  SSE42,
+  AVX2,
+  NEON,
+};
+
+using strcmp_less_fn = bool (*)(const char*, const char*);
+
+/*
+ * Whether the given variant was compiled in and can run on this CPU.
+ */
+bool strcmp_less_supported(StrcmpLessVariant variant);
+
+/*
+ * The implementation of the given variant, for tests and benchmarks. The
+ * variant must be supported.
+ */
+strcmp_less_fn get_strcmp_less(StrcmpLessVariant variant);